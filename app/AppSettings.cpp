@@ -81,3 +81,24 @@ void AppSettings::set_render_quality(float new_value) {
     m_url_modifier->set_query_item(URL_PARAMETER_KEY_QUALITY, QString::number(m_render_quality));
     emit render_quality_changed(m_render_quality);
 }
+
+void AppSettings::set_adaptive_render_quality(bool new_value) {
+    if (m_adaptive_render_quality != new_value) {
+        m_adaptive_render_quality = new_value;
+        emit adaptive_render_quality_changed(m_adaptive_render_quality);
+    }
+}
+
+void AppSettings::set_dynamic_resolution(bool new_value) {
+    if (m_dynamic_resolution != new_value) {
+        m_dynamic_resolution = new_value;
+        emit dynamic_resolution_changed(m_dynamic_resolution);
+    }
+}
+
+void AppSettings::set_temporal_upsampling(bool new_value) {
+    if (m_temporal_upsampling != new_value) {
+        m_temporal_upsampling = new_value;
+        emit temporal_upsampling_changed(m_temporal_upsampling);
+    }
+}
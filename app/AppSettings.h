@@ -33,11 +33,17 @@ class AppSettings : public QObject {
     Q_PROPERTY(QDateTime datetime READ datetime WRITE set_datetime NOTIFY datetime_changed)
     Q_PROPERTY(bool gl_sundir_date_link READ gl_sundir_date_link WRITE set_gl_sundir_date_link NOTIFY gl_sundir_date_link_changed)
     Q_PROPERTY(float render_quality READ render_quality WRITE set_render_quality NOTIFY render_quality_changed)
+    Q_PROPERTY(bool adaptive_render_quality READ adaptive_render_quality WRITE set_adaptive_render_quality NOTIFY adaptive_render_quality_changed)
+    Q_PROPERTY(bool dynamic_resolution READ dynamic_resolution WRITE set_dynamic_resolution NOTIFY dynamic_resolution_changed)
+    Q_PROPERTY(bool temporal_upsampling READ temporal_upsampling WRITE set_temporal_upsampling NOTIFY temporal_upsampling_changed)
 
 signals:
     void datetime_changed(const QDateTime& new_datetime);
     void gl_sundir_date_link_changed(bool new_value);
     void render_quality_changed(float new_value);
+    void adaptive_render_quality_changed(bool new_value);
+    void dynamic_resolution_changed(bool new_value);
+    void temporal_upsampling_changed(bool new_value);
 
 public:
 
@@ -54,6 +60,15 @@ public:
     float render_quality() const { return m_render_quality; }
     void set_render_quality(float new_value);
 
+    bool adaptive_render_quality() const { return m_adaptive_render_quality; }
+    void set_adaptive_render_quality(bool new_value);
+
+    bool dynamic_resolution() const { return m_dynamic_resolution; }
+    void set_dynamic_resolution(bool new_value);
+
+    bool temporal_upsampling() const { return m_temporal_upsampling; }
+    void set_temporal_upsampling(bool new_value);
+
 private:
     // Stores date and time for the current rendering (in use for eg. Shadows)
     QDateTime m_datetime = QDateTime::currentDateTime();
@@ -61,6 +76,12 @@ private:
     bool m_gl_sundir_date_link = true;
     // Value which defines the quality of tiles being fetched (values from [0.1-2.0] make sense)
     float m_render_quality = 0.5;
+    // if true the quality adapts to the frame limit, between half and double the level of detail of m_render_quality
+    bool m_adaptive_render_quality = false;
+    // if true the internal resolution drops (down to half) when the gpu can't keep up with the frame limit
+    bool m_dynamic_resolution = false;
+    // if true the image is reconstructed from jittered frames over time (anti-aliasing, and upsampling together with m_dynamic_resolution)
+    bool m_temporal_upsampling = false;
 
     // Parents instance of UrlModififer
     std::shared_ptr<nucleus::utils::UrlModifier> m_url_modifier;
@@ -126,6 +126,30 @@ SettingsPanel {
                     id: lod_slider;
                     from: 0.1; to: 2.0; stepSize: 0.1;
                 }
+
+                CheckBox {
+                    text: qsTr("Adapt level of detail to frame limit")
+                    Layout.fillWidth: true;
+                    Layout.columnSpan: 2;
+                    checked: map.settings.adaptive_render_quality;
+                    onCheckStateChanged: map.settings.adaptive_render_quality = this.checked;
+                }
+
+                CheckBox {
+                    text: qsTr("Lower resolution when slow")
+                    Layout.fillWidth: true;
+                    Layout.columnSpan: 2;
+                    checked: map.settings.dynamic_resolution;
+                    onCheckStateChanged: map.settings.dynamic_resolution = this.checked;
+                }
+
+                CheckBox {
+                    text: qsTr("Temporal upsampling")
+                    Layout.fillWidth: true;
+                    Layout.columnSpan: 2;
+                    checked: map.settings.temporal_upsampling;
+                    onCheckStateChanged: map.settings.temporal_upsampling = this.checked;
+                }
             }
 
             CheckGroup {
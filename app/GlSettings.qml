@@ -39,6 +39,8 @@ SettingsPanel {
         ssao_falloff_to_value.value = conf.ssao_falloff_to_value;
         ssao_blur_kernel_size.value = conf.ssao_blur_kernel_size;
         ssao_range_check.checked = conf.ssao_range_check;
+        ssao_resolution.currentIndex = conf.ssao_resolution;
+        ssao_temporal_enabled.checked = conf.ssao_temporal_enabled;
         csm_enabled.checked = conf.csm_enabled;
         overlay_shadowmaps.checked = conf.overlay_shadowmaps_enabled;
         overlay_mode.currentIndex = overlay_mode.indexOfValue(conf.overlay_mode);
@@ -86,6 +88,10 @@ SettingsPanel {
                 { text: "Zoomlevel",            value: 3    }, // (only in tile.frag)
                 { text: "Vertex-ID",            value: 4    }, // (only in tile.frag)
                 { text: "Vertex Height-Sample", value: 5    }, // (only in tile.frag)
+                { text: "Tile Age",             value: 6    }, // (only in tile.frag)
+                { text: "Tile Residency",       value: 7    }, // (only in tile.frag)
+                { text: "Screen Space Error",   value: 8    }, // (only in tile.frag)
+                { text: "Decode + Upload Cost", value: 9    }, // (only in tile.frag)
                 { text: "Decoded Normals",      value: 100  },
                 { text: "Steepness",            value: 101  },
                 { text: "SSAO Buffer",          value: 102  },
@@ -127,7 +133,7 @@ SettingsPanel {
         ComboBox {
             id: normal_mode;
             Layout.fillWidth: true;
-            model: ["per Fragment", "Finite-Difference"];
+            model: ["per Fragment", "Finite-Difference", "Precomputed"];
             currentIndex: 0; // Init with 0 necessary otherwise onCurrentIndexChanged gets emited on startup (because def:-1)!
             onCurrentIndexChanged:  map.shared_config.normal_mode = currentIndex;
         }
@@ -268,6 +274,23 @@ SettingsPanel {
             onMoved: map.shared_config.ssao_blur_kernel_size = value;
         }
 
+        Label { text: "Resolution:" }
+        ComboBox {
+            id: ssao_resolution;
+            Layout.fillWidth: true;
+            model: ["Full", "Half", "Quarter"];
+            currentIndex: 0; // Init with 0 necessary otherwise onCurrentIndexChanged gets emited on startup (because def:-1)!
+            onCurrentIndexChanged: map.shared_config.ssao_resolution = currentIndex;
+        }
+
+        CheckBox {
+            id: ssao_temporal_enabled;
+            text: "Temporal Accumulation"
+            Layout.fillWidth: true;
+            Layout.columnSpan: 2;
+            onCheckStateChanged: map.shared_config.ssao_temporal_enabled = this.checked;
+        }
+
         CheckBox {
             id: ssao_range_check;
             text: "Range-Check"
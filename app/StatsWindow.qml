@@ -57,7 +57,13 @@ Rectangle {
         }
     }
 
-    Component.onCompleted: responsive_update()
+    Component.onCompleted: {
+        responsive_update();
+        map.timer_manager.active = visible;
+    }
+    // the renderer collects timer measurements only while they are shown
+    onVisibleChanged: map.timer_manager.active = visible
+    Component.onDestruction: map.timer_manager.active = false
 
     Connections {
         target: main
@@ -312,6 +318,37 @@ Rectangle {
                     map.continuous_update = checked
                 }
             }
+            CheckBox {
+                text: "Render as underlay (no FBO copy)"
+                checked: map.underlay
+                onCheckStateChanged: map.underlay = checked
+            }
+            CheckBox {
+                text: "Record trace"
+                checked: map.trace_recording
+                onCheckStateChanged: map.trace_recording = checked
+            }
+            CheckBox {
+                text: "Capture frame spikes"
+                checked: map.spike_capture
+                onCheckStateChanged: map.spike_capture = checked
+            }
+            Button {
+                text: "Save trace"
+                enabled: map.trace_recording
+                onClicked: trace_path_label.text = map.save_trace()
+            }
+            Connections {
+                target: map
+                function onSpike_trace_saved(path) { trace_path_label.text = path }
+            }
+            Label {
+                id: trace_path_label
+                Layout.columnSpan: 2
+                Layout.fillWidth: true
+                wrapMode: Text.WrapAnywhere
+                visible: text !== ""
+            }
 
             Pane {
                 id: stats_timing;
@@ -462,6 +499,31 @@ Rectangle {
                             }
                         }
                     }
+            Label {
+                // gl commands per frame and pass, averaged over the last poll (see gl_engine::GlCounters)
+                Layout.columnSpan: 2
+                Layout.fillWidth: true
+                visible: text !== ""
+                font.family: "monospace"
+                font.pixelSize: 11
+                text: format_command_counts(map.timer_manager.command_counts)
+
+                function format_command_counts(passes) {
+                    if (passes.length === 0)
+                        return "";
+                    const cell = (value, width) => String(value).padStart(width);
+                    const count = (value) => value >= 10000 ? (value / 1000).toFixed(0) + "k" : value.toFixed(0);
+                    const kib = (value) => (value / 1024).toFixed(0);
+                    let text = "pass".padEnd(11) + cell("draws", 6) + cell("inst", 7) + cell("verts", 7) + cell("state", 6)
+                        + cell("tex KiB", 8) + cell("buf KiB", 8) + cell("fbo", 4);
+                    for (const pass of passes) {
+                        text += "\n" + pass.name.padEnd(11) + cell(count(pass.draw_calls), 6) + cell(count(pass.instances), 7)
+                            + cell(count(pass.vertices), 7) + cell(count(pass.state_changes), 6) + cell(kib(pass.texture_bytes), 8)
+                            + cell(kib(pass.buffer_bytes), 8) + cell(count(pass.framebuffer_binds), 4);
+                    }
+                    return text;
+                }
+            }
         }
         CheckGroup {
             id: camera_group
@@ -513,6 +575,26 @@ Rectangle {
                 value: map.queued_tiles
             }
         }
+        CheckGroup {
+            name: "Tile latency"
+            checkBoxEnabled: true
+            checked: false
+            onCheckedChanged: map.tile_latency_tracing = checked
+
+            Label {
+                Layout.columnSpan: 2
+                font.family: "monospace"
+                text: map.tile_latency_report === "" ? qsTr("no quads traced yet") : map.tile_latency_report
+            }
+        }
+        CheckGroup {
+            name: "GPU memory"
+
+            Label {
+                Layout.columnSpan: 2
+                text: map.gpu_memory_report
+            }
+        }
     }
 
 }
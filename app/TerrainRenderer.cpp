@@ -19,8 +19,12 @@
 
 #include "TerrainRenderer.h"
 
+#include <algorithm>
+
 #include <QDateTime>
+#include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
 #include <QOpenGLFramebufferObjectFormat>
 #include <QQuickWindow>
 
@@ -35,6 +39,7 @@ TerrainRenderer::TerrainRenderer()
     m_glWindow = std::make_unique<gl_engine::Window>();
     m_controller = std::make_unique<nucleus::Controller>(m_glWindow.get());
     m_controller->tile_scheduler()->set_ortho_tile_compression_algorithm(m_glWindow->ortho_tile_compression_algorithm());
+    m_controller->tile_scheduler()->set_ortho_tile_mip_levels(m_glWindow->ortho_tile_mip_levels());
     m_glWindow->initialise_gpu();
 #ifdef ALP_ENABLE_TRACK_OBJECT_LIFECYCLE
     qDebug("TerrainRendererItemRenderer()");
@@ -55,8 +60,20 @@ void TerrainRenderer::synchronize(QQuickFramebufferObject *item)
     // the tile scheduler is in an extra thread, there will be races if you write to it.
     m_window = item->window();
     TerrainRendererItem* i = static_cast<TerrainRendererItem*>(item);
+    set_underlay(i->underlay());
     //        m_controller->camera_controller()->set_virtual_resolution_factor(i->render_quality());
-    m_glWindow->set_permissible_screen_space_error(1.0 / i->settings()->render_quality());
+    // the thermal reductions coarsen the base error and relax the frame time target (see TerrainRendererItem::thermal_scaling)
+    const auto base_error = i->thermal_scaling().error_factor / i->settings()->render_quality();
+    const auto target_frame_msecs = 1000.0f / float(i->throttled_frame_limit());
+    m_glWindow->set_screen_space_error_controller_settings({ .enabled = i->settings()->adaptive_render_quality(),
+        .min_error = base_error * 0.5f,
+        .max_error = base_error * 2.0f,
+        .target_frame_msecs = target_frame_msecs });
+    m_glWindow->set_permissible_screen_space_error(base_error);
+    m_glWindow->set_render_scale_settings({ .enabled = i->settings()->dynamic_resolution(),
+        .target_gpu_msecs = target_frame_msecs });
+    m_glWindow->set_temporal_upsampling(i->settings()->temporal_upsampling());
+    m_glWindow->set_spike_capture(i->spike_capture() ? std::optional(nucleus::timing::SpikeDetector::Settings {}) : std::nullopt);
     m_controller->camera_controller()->set_viewport({ i->width(), i->height() });
     m_controller->camera_controller()->set_field_of_view(i->field_of_view());
 
@@ -95,14 +112,55 @@ void TerrainRenderer::synchronize(QQuickFramebufferObject *item)
 void TerrainRenderer::render()
 {
     m_window->beginExternalCommands();
-    m_glWindow->paint(this->framebufferObject());
+    if (m_underlay) {
+        // the terrain was drawn by paint_underlay already, the (1x1) fbo only has to be transparent
+        auto* f = QOpenGLContext::currentContext()->functions();
+        framebufferObject()->bind();
+        f->glClearColor(0, 0, 0, 0);
+        f->glClear(GL_COLOR_BUFFER_BIT);
+    } else {
+        m_glWindow->paint(this->framebufferObject());
+    }
     m_window->endExternalCommands();
     //    qDebug() << "TerrainRenderer::render: " << QDateTime::currentDateTime().time().toString("ss.zzz");
 }
 
+void TerrainRenderer::set_underlay(bool enabled)
+{
+    if (enabled == m_underlay)
+        return;
+    m_underlay = enabled;
+    if (m_underlay) {
+        // the render pass of the window begins after synchronize, the slot is called on the render thread
+        m_underlay_connection = connect(m_window, &QQuickWindow::beforeRenderPassRecording, this, &TerrainRenderer::paint_underlay, Qt::DirectConnection);
+    } else {
+        disconnect(m_underlay_connection);
+        m_underlay_size = {};
+    }
+    invalidateFramebufferObject(); // full size again, or only the transparent 1x1 one
+}
+
+void TerrainRenderer::paint_underlay()
+{
+    const auto size = m_window->size() * m_window->effectiveDevicePixelRatio();
+    m_window->beginExternalCommands();
+    if (size != m_underlay_size) {
+        m_underlay_size = size;
+        m_glWindow->resize_framebuffer(size.width(), size.height());
+    }
+    m_glWindow->paint();
+    // the scene graph draws its opaque items with depth testing, our depth must not hide them
+    auto* f = QOpenGLContext::currentContext()->functions();
+    f->glDepthMask(GL_TRUE);
+    f->glClear(GL_DEPTH_BUFFER_BIT);
+    m_window->endExternalCommands();
+}
+
 QOpenGLFramebufferObject *TerrainRenderer::createFramebufferObject(const QSize &size)
 {
     qDebug() << "QOpenGLFramebufferObject *createFramebufferObject(const QSize& " << size << ")";
+    if (m_underlay)
+        return new QOpenGLFramebufferObject(QSize(1, 1));
     m_window->beginExternalCommands();
     m_glWindow->resize_framebuffer(size.width(), size.height());
     m_window->endExternalCommands();
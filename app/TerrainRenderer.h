@@ -47,7 +47,14 @@ public:
     [[nodiscard]] nucleus::Controller* controller() const;
 
 private:
+    // draws into the window's framebuffer at the start of its render pass, the qml items are drawn on top
+    void paint_underlay();
+    void set_underlay(bool enabled);
+
     QQuickWindow *m_window;
+    bool m_underlay = false;
+    QMetaObject::Connection m_underlay_connection;
+    QSize m_underlay_size;
     std::unique_ptr<gl_engine::Window> m_glWindow;
     std::unique_ptr<nucleus::Controller> m_controller;
 };
@@ -20,6 +20,7 @@
 
 #include "TerrainRendererItem.h"
 
+#include <cmath>
 #include <memory>
 #include <QDebug>
 #include <QOpenGLContext>
@@ -27,6 +28,7 @@
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLFramebufferObjectFormat>
 #include <QQuickWindow>
+#include <QStandardPaths>
 #include <QThread>
 #include <QTimer>
 #include <glm/glm.hpp>
@@ -39,8 +41,10 @@
 #include "nucleus/Controller.h"
 #include "nucleus/tile_scheduler/Scheduler.h"
 #include "nucleus/srs.h"
+#include "nucleus/timing/TraceRecorder.h"
 #include "nucleus/utils/sun_calculations.h"
 #include "nucleus/camera/PositionStorage.h"
+#include "nucleus/utils/FrameScheduler.h"
 #include "nucleus/utils/UrlModifier.h"
 
 namespace {
@@ -56,7 +60,8 @@ overloaded(Ts...) -> overloaded<Ts...>;
 
 TerrainRendererItem::TerrainRendererItem(QQuickItem* parent)
     : QQuickFramebufferObject(parent)
-    , m_update_timer(new QTimer(this))
+    , m_frame_scheduler(new nucleus::utils::FrameScheduler(this))
+    , m_thermal_monitor(new nucleus::utils::ThermalMonitor(this))
 {
 #ifdef ALP_ENABLE_TRACK_OBJECT_LIFECYCLE
     qDebug("TerrainRendererItem()");
@@ -70,19 +75,30 @@ TerrainRendererItem::TerrainRendererItem(QQuickItem* parent)
     connect(m_settings, &AppSettings::datetime_changed, this, &TerrainRendererItem::datetime_changed);
     connect(m_settings, &AppSettings::gl_sundir_date_link_changed, this, &TerrainRendererItem::gl_sundir_date_link_changed);
     connect(m_settings, &AppSettings::render_quality_changed, this, &TerrainRendererItem::schedule_update);
+    connect(m_settings, &AppSettings::adaptive_render_quality_changed, this, &TerrainRendererItem::schedule_update);
+    connect(m_settings, &AppSettings::dynamic_resolution_changed, this, &TerrainRendererItem::schedule_update);
+    connect(m_settings, &AppSettings::temporal_upsampling_changed, this, &TerrainRendererItem::schedule_update);
 
-    m_update_timer->setSingleShot(!m_continuous_update);
-    m_update_timer->setInterval(1000 / m_frame_limit);
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::Normal, unsigned(throttled_frame_limit()));
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::PowerSaving, unsigned(m_power_saving_frame_limit));
+    connect(m_thermal_monitor, &nucleus::utils::ThermalMonitor::level_changed, this, &TerrainRendererItem::apply_thermal_level);
     setMirrorVertically(true);
     setAcceptTouchEvents(true);
     setAcceptedMouseButtons(Qt::MouseButton::AllButtons);
 
-    connect(m_update_timer, &QTimer::timeout, this, [this]() {
+    connect(m_frame_scheduler, &nucleus::utils::FrameScheduler::frame_requested, this, [this]() {
         emit update_camera_requested();
         RenderThreadNotifier::instance()->notify();
     });
 
     connect(this, &TerrainRendererItem::init_after_creation, this, &TerrainRendererItem::init_after_creation_slot);  
+
+#ifndef __EMSCRIPTEN__
+    // deleted on the gui thread, also if the last reference is dropped by the renderer
+    m_upload_surface = std::shared_ptr<QOffscreenSurface>(new QOffscreenSurface(), [](QOffscreenSurface* surface) { surface->deleteLater(); });
+    m_upload_surface->setFormat(QSurfaceFormat::defaultFormat());
+    m_upload_surface->create();
+#endif
 }
 
 
@@ -99,8 +115,10 @@ QQuickFramebufferObject::Renderer* TerrainRendererItem::createRenderer() const
     qDebug() << "rendering thread: " << QThread::currentThread();
     // called on rendering thread.
     auto* r = new TerrainRenderer();
+    if (m_upload_surface)
+        r->glWindow()->enable_background_uploads(m_upload_surface);
     connect(r->glWindow(), &nucleus::AbstractRenderWindow::update_requested, this, &TerrainRendererItem::schedule_update);
-    connect(m_update_timer, &QTimer::timeout, this, &QQuickFramebufferObject::update);
+    connect(m_frame_scheduler, &nucleus::utils::FrameScheduler::frame_requested, this, &QQuickFramebufferObject::update);
 
     connect(this, &TerrainRendererItem::touch_made, r->controller()->camera_controller(), &nucleus::camera::Controller::touch);
     connect(this, &TerrainRendererItem::mouse_pressed, r->controller()->camera_controller(), &nucleus::camera::Controller::mouse_press);
@@ -108,7 +126,7 @@ QQuickFramebufferObject::Renderer* TerrainRendererItem::createRenderer() const
     connect(this, &TerrainRendererItem::wheel_turned, r->controller()->camera_controller(), &nucleus::camera::Controller::wheel_turn);
     connect(this, &TerrainRendererItem::key_pressed, r->controller()->camera_controller(), &nucleus::camera::Controller::key_press);
     connect(this, &TerrainRendererItem::key_released, r->controller()->camera_controller(), &nucleus::camera::Controller::key_release);
-    connect(this, &TerrainRendererItem::update_camera_requested, r->controller()->camera_controller(), &nucleus::camera::Controller::update_camera_request);
+    connect(this, &TerrainRendererItem::update_camera_requested, r->controller(), &nucleus::Controller::update_camera_requests);
     connect(this, &TerrainRendererItem::position_set_by_user, r->controller()->camera_controller(), &nucleus::camera::Controller::fly_to_latitude_longitude);
     connect(this, &TerrainRendererItem::rotation_north_requested, r->controller()->camera_controller(), &nucleus::camera::Controller::rotate_north);
 
@@ -120,10 +138,9 @@ QQuickFramebufferObject::Renderer* TerrainRendererItem::createRenderer() const
     //connect(this, &TerrainRendererItem::ind)
 
     auto* const tile_scheduler = r->controller()->tile_scheduler();
-    connect(this->m_settings, &AppSettings::render_quality_changed, tile_scheduler, [=](float new_render_quality) {
-        const auto permissible_error = 1.0f / new_render_quality;
-        tile_scheduler->set_permissible_screen_space_error(permissible_error);
-    });
+    const_cast<TerrainRendererItem*>(this)->m_latency_tracer = tile_scheduler->latency_tracer();
+    if (m_tile_latency_tracing)
+        m_latency_tracer->set_enabled(true);
     connect(this, &TerrainRendererItem::tile_cache_size_changed, tile_scheduler, &nucleus::tile_scheduler::Scheduler::set_ram_quad_limit);
     connect(tile_scheduler, &nucleus::tile_scheduler::Scheduler::quads_requested, this, [this](const std::vector<tile::Id>& ids) {
         const_cast<TerrainRendererItem*>(this)->set_queued_tiles(unsigned(ids.size()));
@@ -133,6 +150,7 @@ QQuickFramebufferObject::Renderer* TerrainRendererItem::createRenderer() const
     });
     connect(tile_scheduler, &nucleus::tile_scheduler::Scheduler::statistics_updated, this, [this](const nucleus::tile_scheduler::Scheduler::Statistics& stats) {
         const_cast<TerrainRendererItem*>(this)->set_cached_tiles(stats.n_tiles_in_ram_cache);
+        const_cast<TerrainRendererItem*>(this)->set_tile_latency_report(QString::fromStdString(nucleus::tile_scheduler::LatencyTracer::format(stats.tile_latency)));
     });
 
     // connect glWindow to forward key events.
@@ -142,10 +160,9 @@ QQuickFramebufferObject::Renderer* TerrainRendererItem::createRenderer() const
     // connect glWindow for shader hotreload by frontend button
     connect(this, &TerrainRendererItem::reload_shader, r->glWindow(), &gl_engine::Window::reload_shader);
 
-    connect(r->glWindow(), &gl_engine::Window::report_measurements, this->m_timer_manager, &TimerFrontendManager::receive_measurements);
-
-    connect(r->controller()->tile_scheduler(), &nucleus::tile_scheduler::Scheduler::gpu_quads_updated, RenderThreadNotifier::instance(), &RenderThreadNotifier::notify);
-    connect(tile_scheduler, &nucleus::tile_scheduler::Scheduler::gpu_quads_updated, RenderThreadNotifier::instance(), &RenderThreadNotifier::notify);
+    m_timer_manager->set_snapshot(r->glWindow()->measurement_snapshot());
+    connect(r->glWindow(), &gl_engine::Window::gpu_memory_report_changed, this, &TerrainRendererItem::set_gpu_memory_report);
+    connect(r->glWindow(), &gl_engine::Window::frame_spike_captured, this, &TerrainRendererItem::save_spike_trace);
 
     // We now have to initialize everything based on the url, but we need to do this on the thread this instance
     // belongs to. (gui thread?) Therefore we use the following signal to signal the init process
@@ -244,9 +261,7 @@ void TerrainRendererItem::set_gl_preset(const QString& preset_b64_string) {
 void TerrainRendererItem::schedule_update()
 {
     //    qDebug("void TerrainRendererItem::schedule_update()");
-    if (m_update_timer->isActive())
-        return;
-    m_update_timer->start();
+    m_frame_scheduler->request_frame();
 }
 
 int TerrainRendererItem::frame_limit() const
@@ -260,10 +275,42 @@ void TerrainRendererItem::set_frame_limit(int new_frame_limit)
     if (m_frame_limit == new_frame_limit)
         return;
     m_frame_limit = new_frame_limit;
-    m_update_timer->setInterval(1000 / m_frame_limit);
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::Normal, unsigned(throttled_frame_limit()));
     emit frame_limit_changed();
 }
 
+int TerrainRendererItem::thermal_level() const { return int(m_thermal_monitor->level()); }
+
+nucleus::utils::ThermalMonitor::Scaling TerrainRendererItem::thermal_scaling() const
+{
+    return nucleus::utils::ThermalMonitor::scaling(m_thermal_monitor->level());
+}
+
+int TerrainRendererItem::throttled_frame_limit() const
+{
+    return std::max(int(std::lround(float(m_frame_limit) * thermal_scaling().frame_limit_factor)), 1);
+}
+
+void TerrainRendererItem::apply_thermal_level()
+{
+    qInfo() << "TerrainRendererItem: thermal level" << thermal_level();
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::Normal, unsigned(throttled_frame_limit()));
+    emit shared_config_changed(throttled_shared_config());
+    emit thermal_level_changed(thermal_level());
+    schedule_update(); // the renderer picks up the error in synchronize
+}
+
+gl_engine::uboSharedConfig TerrainRendererItem::throttled_shared_config() const
+{
+    const auto scaling = thermal_scaling();
+    auto config = m_shared_config;
+    config.m_ssao_enabled = config.m_ssao_enabled && scaling.ssao;
+    config.m_ssao_kernel = std::min(config.m_ssao_kernel, GLuint(scaling.max_ssao_kernel));
+    config.m_ssao_resolution = std::max(config.m_ssao_resolution, GLuint(scaling.min_ssao_resolution));
+    config.m_csm_enabled = config.m_csm_enabled && scaling.shadows;
+    return config;
+}
+
 nucleus::camera::Definition TerrainRendererItem::camera() const
 {
     return m_camera;
@@ -391,7 +438,7 @@ void TerrainRendererItem::set_shared_config(gl_engine::uboSharedConfig new_share
         m_shared_config = new_shared_config;
         auto data_string = gl_engine::ubo_as_string(m_shared_config);
         m_url_modifier->set_query_item(URL_PARAMETER_KEY_CONFIG, data_string);
-        emit shared_config_changed(m_shared_config);
+        emit shared_config_changed(throttled_shared_config());
     }
 }
 
@@ -440,6 +487,44 @@ void TerrainRendererItem::set_cached_tiles(unsigned int new_cached_tiles)
     emit cached_tiles_changed(m_cached_tiles);
 }
 
+const QString& TerrainRendererItem::gpu_memory_report() const
+{
+    return m_gpu_memory_report;
+}
+
+void TerrainRendererItem::set_gpu_memory_report(const QString& new_gpu_memory_report)
+{
+    if (m_gpu_memory_report == new_gpu_memory_report)
+        return;
+    m_gpu_memory_report = new_gpu_memory_report;
+    emit gpu_memory_report_changed(m_gpu_memory_report);
+}
+
+const QString& TerrainRendererItem::tile_latency_report() const
+{
+    return m_tile_latency_report;
+}
+
+bool TerrainRendererItem::tile_latency_tracing() const { return m_tile_latency_tracing; }
+
+void TerrainRendererItem::set_tile_latency_tracing(bool new_tile_latency_tracing)
+{
+    if (m_tile_latency_tracing == new_tile_latency_tracing)
+        return;
+    m_tile_latency_tracing = new_tile_latency_tracing;
+    if (m_latency_tracer)
+        m_latency_tracer->set_enabled(m_tile_latency_tracing);
+    emit tile_latency_tracing_changed(m_tile_latency_tracing);
+}
+
+void TerrainRendererItem::set_tile_latency_report(const QString& new_tile_latency_report)
+{
+    if (m_tile_latency_report == new_tile_latency_report)
+        return;
+    m_tile_latency_report = new_tile_latency_report;
+    emit tile_latency_report_changed(m_tile_latency_report);
+}
+
 unsigned int TerrainRendererItem::tile_cache_size() const
 {
     return m_tile_cache_size;
@@ -464,7 +549,7 @@ void TerrainRendererItem::set_sun_angles(QVector2D new_sunAngles) {
 
     // Update the direction inside the gls shared_config
     update_gl_sun_dir_from_sun_angles(m_shared_config);
-    emit shared_config_changed(m_shared_config);
+    emit shared_config_changed(throttled_shared_config());
 }
 
 void TerrainRendererItem::recalculate_sun_angles() {
@@ -494,11 +579,107 @@ void TerrainRendererItem::set_continuous_update(bool new_continuous_update)
         return;
     qDebug() << "continuoius update" << m_continuous_update;
     m_continuous_update = new_continuous_update;
-    m_update_timer->setSingleShot(!m_continuous_update);
-    m_update_timer->start();
+    m_frame_scheduler->set_continuous(m_continuous_update);
     emit continuous_update_changed(m_continuous_update);
 }
 
+bool TerrainRendererItem::power_saving() const
+{
+    return m_power_saving;
+}
+
+void TerrainRendererItem::set_power_saving(bool new_power_saving)
+{
+    if (m_power_saving == new_power_saving)
+        return;
+    m_power_saving = new_power_saving;
+    m_frame_scheduler->set_power_saving(m_power_saving);
+    emit power_saving_changed(m_power_saving);
+}
+
+int TerrainRendererItem::power_saving_frame_limit() const
+{
+    return m_power_saving_frame_limit;
+}
+
+void TerrainRendererItem::set_power_saving_frame_limit(int new_power_saving_frame_limit)
+{
+    new_power_saving_frame_limit = std::clamp(new_power_saving_frame_limit, 1, 120);
+    if (m_power_saving_frame_limit == new_power_saving_frame_limit)
+        return;
+    m_power_saving_frame_limit = new_power_saving_frame_limit;
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::PowerSaving, unsigned(m_power_saving_frame_limit));
+    emit power_saving_frame_limit_changed(m_power_saving_frame_limit);
+}
+
+bool TerrainRendererItem::underlay() const
+{
+    return m_underlay;
+}
+
+void TerrainRendererItem::set_underlay(bool new_underlay)
+{
+    if (m_underlay == new_underlay)
+        return;
+    m_underlay = new_underlay;
+    emit underlay_changed(m_underlay);
+    schedule_update();
+}
+
+bool TerrainRendererItem::trace_recording() const
+{
+    return nucleus::timing::TraceRecorder::instance().enabled();
+}
+
+void TerrainRendererItem::set_trace_recording(bool new_trace_recording)
+{
+    auto& recorder = nucleus::timing::TraceRecorder::instance();
+    if (recorder.enabled() == new_trace_recording)
+        return;
+    if (new_trace_recording)
+        recorder.clear();
+    recorder.set_enabled(new_trace_recording);
+    emit trace_recording_changed(new_trace_recording);
+    if (!new_trace_recording)
+        set_spike_capture(false);
+}
+
+bool TerrainRendererItem::spike_capture() const { return m_spike_capture; }
+
+void TerrainRendererItem::set_spike_capture(bool new_spike_capture)
+{
+    if (m_spike_capture == new_spike_capture)
+        return;
+    m_spike_capture = new_spike_capture;
+    if (m_spike_capture)
+        set_trace_recording(true); // the capture is cut out of the recorded timeline
+    emit spike_capture_changed(m_spike_capture);
+    schedule_update();
+}
+
+void TerrainRendererItem::save_spike_trace(const nucleus::timing::SpikeDetector::Capture& capture)
+{
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const auto path = std::filesystem::path(directory.toStdString()) / QDateTime::currentDateTime().toString("'spike_'yyyy-MM-dd_HH-mm-ss-zzz'.json'").toStdString();
+    const auto r = nucleus::timing::TraceRecorder::instance().write_chrome_trace(path, capture.from, capture.to);
+    if (!r.has_value()) {
+        qWarning() << "couldn't save the trace of a frame spike:" << QString::fromStdString(r.error());
+        return;
+    }
+    qDebug() << "frame spike of" << capture.spike_msecs << "ms (median" << capture.median_msecs << "ms), trace saved to" << QString::fromStdString(path.string());
+    emit spike_trace_saved(QString::fromStdString(path.string()));
+}
+
+QString TerrainRendererItem::save_trace()
+{
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const auto path = std::filesystem::path(directory.toStdString()) / QDateTime::currentDateTime().toString("'trace_'yyyy-MM-dd_HH-mm-ss'.json'").toStdString();
+    const auto r = nucleus::timing::TraceRecorder::instance().write_chrome_trace(path);
+    if (!r.has_value())
+        return QString::fromStdString(r.error());
+    return QString::fromStdString(path.string());
+}
+
 void TerrainRendererItem::init_after_creation_slot() {
     // INITIALIZE shared config with URL parameter:
     auto urlmodifier = m_url_modifier.get();
@@ -521,7 +702,7 @@ void TerrainRendererItem::init_after_creation_slot() {
 
     // Maybe shared config is already different (by loading from url)
     // so lets notify the Renderer here to replace the current configuration!
-    emit shared_config_changed(m_shared_config);
+    emit shared_config_changed(throttled_shared_config());
 }
 
 void TerrainRendererItem::datetime_changed(const QDateTime&)
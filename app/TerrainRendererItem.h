@@ -27,17 +27,28 @@
 #include <QVector3D>
 #include <QVector2D>
 #include <QDateTime>
+#include <QOffscreenSurface>
 #include <map>
 
 #include "nucleus/camera/Definition.h"
 #include "nucleus/event_parameter.h"
+#include "nucleus/tile_scheduler/LatencyTracer.h"
+#include "nucleus/timing/SpikeDetector.h"
+#include "nucleus/utils/ThermalMonitor.h"
 #include "gl_engine/UniformBufferObjects.h"
 #include "timing/TimerFrontendManager.h"
 #include "AppSettings.h"
 
+namespace nucleus::utils {
+class FrameScheduler;
+}
+
 class TerrainRendererItem : public QQuickFramebufferObject {
     Q_OBJECT
     Q_PROPERTY(int frame_limit READ frame_limit WRITE set_frame_limit NOTIFY frame_limit_changed)
+    Q_PROPERTY(bool power_saving READ power_saving WRITE set_power_saving NOTIFY power_saving_changed)
+    Q_PROPERTY(int power_saving_frame_limit READ power_saving_frame_limit WRITE set_power_saving_frame_limit NOTIFY power_saving_frame_limit_changed)
+    Q_PROPERTY(int thermal_level READ thermal_level NOTIFY thermal_level_changed)
     Q_PROPERTY(nucleus::camera::Definition camera READ camera NOTIFY camera_changed)
     Q_PROPERTY(int camera_width READ camera_width NOTIFY camera_width_changed)
     Q_PROPERTY(int camera_height READ camera_height NOTIFY camera_height_changed)
@@ -52,11 +63,17 @@ class TerrainRendererItem : public QQuickFramebufferObject {
     Q_PROPERTY(unsigned int in_flight_tiles READ in_flight_tiles NOTIFY in_flight_tiles_changed)
     Q_PROPERTY(unsigned int queued_tiles READ queued_tiles NOTIFY queued_tiles_changed)
     Q_PROPERTY(unsigned int cached_tiles READ cached_tiles NOTIFY cached_tiles_changed)
+    Q_PROPERTY(QString gpu_memory_report READ gpu_memory_report NOTIFY gpu_memory_report_changed)
+    Q_PROPERTY(QString tile_latency_report READ tile_latency_report NOTIFY tile_latency_report_changed)
+    Q_PROPERTY(bool tile_latency_tracing READ tile_latency_tracing WRITE set_tile_latency_tracing NOTIFY tile_latency_tracing_changed)
     Q_PROPERTY(unsigned int tile_cache_size READ tile_cache_size WRITE set_tile_cache_size NOTIFY tile_cache_size_changed)
     Q_PROPERTY(bool render_looped READ render_looped WRITE set_render_looped NOTIFY render_looped_changed)
     Q_PROPERTY(unsigned int selected_camera_position_index MEMBER m_selected_camera_position_index WRITE set_selected_camera_position_index)
     Q_PROPERTY(QVector2D sun_angles READ sun_angles WRITE set_sun_angles NOTIFY sun_angles_changed)
     Q_PROPERTY(bool continuous_update READ continuous_update WRITE set_continuous_update NOTIFY continuous_update_changed)
+    Q_PROPERTY(bool underlay READ underlay WRITE set_underlay NOTIFY underlay_changed)
+    Q_PROPERTY(bool trace_recording READ trace_recording WRITE set_trace_recording NOTIFY trace_recording_changed)
+    Q_PROPERTY(bool spike_capture READ spike_capture WRITE set_spike_capture NOTIFY spike_capture_changed)
 
 public:
     explicit TerrainRendererItem(QQuickItem* parent = 0);
@@ -66,6 +83,9 @@ public:
 signals:
 
     void frame_limit_changed();
+    void power_saving_changed(bool power_saving);
+    void power_saving_frame_limit_changed(int power_saving_frame_limit);
+    void thermal_level_changed(int thermal_level);
 
     void mouse_pressed(const nucleus::event_parameter::Mouse&) const;
     void mouse_moved(const nucleus::event_parameter::Mouse&) const;
@@ -98,6 +118,9 @@ signals:
     void queued_tiles_changed(unsigned new_n);
 
     void cached_tiles_changed(unsigned new_n);
+    void gpu_memory_report_changed(const QString& new_report);
+    void tile_latency_report_changed(const QString& new_report);
+    void tile_latency_tracing_changed(bool tile_latency_tracing);
 
     void tile_cache_size_changed(unsigned new_cache_size);
 
@@ -111,6 +134,14 @@ signals:
 
     void continuous_update_changed(bool continuous_update);
 
+    void underlay_changed(bool underlay);
+
+    void trace_recording_changed(bool trace_recording);
+
+    void spike_capture_changed(bool spike_capture);
+
+    void spike_trace_saved(const QString& path);
+
 protected:
     void touchEvent(QTouchEvent*) override;
     void mousePressEvent(QMouseEvent*) override;
@@ -125,6 +156,9 @@ public slots:
     void set_gl_preset(const QString& preset_b64_string);
     void read_global_position(glm::dvec3 latlonalt);
     void camera_definition_changed(const nucleus::camera::Definition& new_definition); // gets called whenever camera changes
+    // writes the recorded timeline (see nucleus::timing::TraceRecorder) as chrome trace json into the app data location.
+    // returns the path of the file, or an error message.
+    QString save_trace();
 
 private slots:
     void schedule_update();
@@ -137,6 +171,19 @@ public:
     [[nodiscard]] int frame_limit() const;
     void set_frame_limit(int new_frame_limit);
 
+    // e.g., on battery. the frame rate is capped by power_saving_frame_limit then (see nucleus::utils::FrameScheduler)
+    [[nodiscard]] bool power_saving() const;
+    void set_power_saving(bool new_power_saving);
+    [[nodiscard]] int power_saving_frame_limit() const;
+    void set_power_saving_frame_limit(int new_power_saving_frame_limit);
+
+    // thermal status of the device (nucleus::utils::ThermalMonitor::Level). the frame limit, screen space error, ssao and
+    // shadows are reduced on top of the user settings as it rises, so that the os doesn't throttle.
+    [[nodiscard]] int thermal_level() const;
+    [[nodiscard]] nucleus::utils::ThermalMonitor::Scaling thermal_scaling() const;
+    // frame_limit with the thermal reduction
+    [[nodiscard]] int throttled_frame_limit() const;
+
     [[nodiscard]] nucleus::camera::Definition camera() const;
     void set_read_only_camera(const nucleus::camera::Definition& new_camera); // implementation detail
 
@@ -178,6 +225,14 @@ public:
     [[nodiscard]] unsigned int cached_tiles() const;
     void set_cached_tiles(unsigned int new_cached_tiles);
 
+    [[nodiscard]] const QString& gpu_memory_report() const;
+    void set_gpu_memory_report(const QString& new_gpu_memory_report);
+    [[nodiscard]] const QString& tile_latency_report() const;
+    void set_tile_latency_report(const QString& new_tile_latency_report);
+    // the quads are traced (nucleus::tile_scheduler::LatencyTracer) only while the report is shown
+    [[nodiscard]] bool tile_latency_tracing() const;
+    void set_tile_latency_tracing(bool new_tile_latency_tracing);
+
     [[nodiscard]] unsigned int tile_cache_size() const;
     void set_tile_cache_size(unsigned int new_tile_cache_size);
 
@@ -189,19 +244,43 @@ public:
     bool continuous_update() const;
     void set_continuous_update(bool new_continuous_update);
 
+    // renders straight into the window before the qml scene (see TerrainRenderer::paint_underlay), instead of into an fbo that
+    // is composited afterwards. the item must fill the window, and the items below it are covered.
+    bool underlay() const;
+    void set_underlay(bool new_underlay);
+
+    bool trace_recording() const;
+    void set_trace_recording(bool new_trace_recording);
+    // frame spikes are saved as chrome trace json into the app data location, with the timeline around them (see
+    // nucleus::timing::SpikeDetector). turns on the trace recording.
+    bool spike_capture() const;
+    void set_spike_capture(bool new_spike_capture);
+
 private:
     void recalculate_sun_angles();
+    void save_spike_trace(const nucleus::timing::SpikeDetector::Capture& capture);
     void update_gl_sun_dir_from_sun_angles(gl_engine::uboSharedConfig& ubo);
+    void apply_thermal_level();
+    // m_shared_config with the thermal reductions, as sent to the renderer. the url and qml keep the user's config.
+    [[nodiscard]] gl_engine::uboSharedConfig throttled_shared_config() const;
 
     bool m_continuous_update = false;
+    bool m_underlay = false;
+    bool m_spike_capture = false;
     float m_camera_rotation_from_north = 0;
     QPointF m_camera_operation_centre;
     bool m_camera_operation_centre_visibility = false;
     float m_camera_operation_centre_distance = 1;
     float m_field_of_view = 60;
     int m_frame_limit = 30;
+    bool m_power_saving = false;
+    int m_power_saving_frame_limit = 20;
     unsigned m_tile_cache_size = 12000;
     unsigned m_cached_tiles = 0;
+    QString m_gpu_memory_report;
+    QString m_tile_latency_report;
+    bool m_tile_latency_tracing = false;
+    nucleus::tile_scheduler::LatencyTracerPtr m_latency_tracer; // of the scheduler, set in createRenderer
     unsigned m_queued_tiles = 0;
     unsigned m_in_flight_tiles = 0;
     unsigned int m_selected_camera_position_index = 0;
@@ -210,7 +289,8 @@ private:
 
     gl_engine::uboSharedConfig m_shared_config;
 
-    QTimer* m_update_timer = nullptr;
+    nucleus::utils::FrameScheduler* m_frame_scheduler = nullptr; // frames are only rendered on request, see schedule_update
+    nucleus::utils::ThermalMonitor* m_thermal_monitor = nullptr;
     nucleus::camera::Definition m_camera;
     int m_camera_width = 0;
     int m_camera_height = 0;
@@ -225,4 +305,7 @@ private:
     // with the multi-thread nature of this app. So far the url modifier is
     // only necessary in this class and on this thread, so we'll use it here.
     std::shared_ptr<nucleus::utils::UrlModifier> m_url_modifier;
+
+    // for the tile upload context of the renderer. it must be created on the gui thread, the renderer lives on the render thread
+    std::shared_ptr<QOffscreenSurface> m_upload_surface;
 };
@@ -44,10 +44,12 @@
 #include "TerrainRendererItem.h"
 
 #include "nucleus/camera/PositionStorage.h"
+#include "nucleus/timing/StartupTimeline.h"
 #include "nucleus/version.h"
 
 int main(int argc, char **argv)
 {
+    nucleus::timing::StartupTimeline::instance(); // the startup is timed from here, until the first frame
     QQuickWindow::setGraphicsApi(QSGRendererInterface::GraphicsApi::OpenGLRhi);
 #ifdef ALP_ENABLE_DEBUG_GUI
     QApplication app(argc, argv);
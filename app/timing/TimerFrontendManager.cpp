@@ -18,11 +18,18 @@
 
 #include "TimerFrontendManager.h"
 
+#include <algorithm>
+
 #include <QDebug>
+#include <QTimer>
 
 TimerFrontendManager::TimerFrontendManager(QObject* parent)
-    :QObject(parent)
-{}
+    : QObject(parent)
+    , m_poll_timer(new QTimer(this))
+{
+    m_poll_timer->setInterval(poll_interval_msecs);
+    connect(m_poll_timer, &QTimer::timeout, this, &TimerFrontendManager::poll);
+}
 
 TimerFrontendManager::~TimerFrontendManager()
 {
@@ -31,17 +38,90 @@ TimerFrontendManager::~TimerFrontendManager()
 #endif
 }
 
+void TimerFrontendManager::set_snapshot(nucleus::timing::MeasurementSnapshotPtr snapshot)
+{
+    if (m_snapshot)
+        m_snapshot->set_enabled(false);
+    m_snapshot = std::move(snapshot);
+    m_current = {};
+    m_previous = {};
+    if (m_snapshot)
+        m_snapshot->set_enabled(m_active);
+}
+
+bool TimerFrontendManager::active() const { return m_active; }
+
+void TimerFrontendManager::set_active(bool active)
+{
+    if (m_active == active)
+        return;
+    m_active = active;
+    if (m_snapshot)
+        m_snapshot->set_enabled(active);
+    if (active)
+        m_poll_timer->start();
+    else
+        m_poll_timer->stop();
+    emit active_changed(active);
+}
+
 int TimerFrontendManager::current_frame = 0;
-void TimerFrontendManager::receive_measurements(QList<nucleus::timing::TimerReport> values)
+void TimerFrontendManager::poll()
 {
-    for (const auto& report : values) {
-        const char* name = report.timer->get_name().c_str();
+    if (!m_snapshot || !m_snapshot->read(m_current))
+        return;
+    if (m_current.layout_version != m_previous.layout_version) {
+        // timers were (re-)created with a new gpu context, the sums start over
+        m_infos = m_snapshot->timers();
+        m_passes = m_snapshot->passes();
+        m_previous = {};
+        m_previous.layout_version = m_current.layout_version;
+    }
+    const auto n_timers = std::min(size_t(m_current.n_timers), m_infos.size());
+    for (size_t i = 0; i < n_timers; ++i) {
+        const auto& entry = m_current.entries[i];
+        const auto& previous = m_previous.entries[i];
+        if (entry.count <= previous.count)
+            continue;
+        const auto n_new = entry.count - previous.count;
+        const auto value = float((entry.sum - previous.sum) / double(n_new));
+        const auto& info = m_infos[i];
+        const auto name = QString::fromStdString(info.name);
         if (!m_timer_map.contains(name)) {
-            auto tfo = new TimerFrontendObject(this, name, report.timer->get_group().c_str(), report.timer->get_queue_size(), report.timer->get_average_weight(), report.value);
+            auto tfo = new TimerFrontendObject(this, name, QString::fromStdString(info.group), info.queue_size, info.average_weight, value);
             m_timer.append(tfo);
             m_timer_map.insert(name, tfo);
         }
-        m_timer_map[name]->add_measurement(report.value, current_frame++);
+        m_timer_map[name]->add_measurement(value, current_frame++, unsigned(n_new));
     }
+    update_command_counts();
+    m_previous = m_current;
     emit updateTimingList(m_timer);
 }
+
+void TimerFrontendManager::update_command_counts()
+{
+    if (m_current.frame <= m_previous.frame)
+        return;
+    const auto n_frames = double(m_current.frame - m_previous.frame);
+    const auto n_passes = std::min(size_t(m_current.n_passes), m_passes.size());
+    QVariantList counts;
+    for (size_t i = 0; i < n_passes; ++i) {
+        const auto& current = m_current.counts[i];
+        const auto& previous = m_previous.counts[i];
+        const auto per_frame = [&](uint64_t nucleus::timing::CommandCounts::*member) { return double(current.*member - previous.*member) / n_frames; };
+        using Counts = nucleus::timing::CommandCounts;
+        counts.append(QVariantMap {
+            { "name", QString::fromStdString(m_passes[i]) },
+            { "draw_calls", per_frame(&Counts::draw_calls) },
+            { "instances", per_frame(&Counts::instances) },
+            { "vertices", per_frame(&Counts::vertices) },
+            { "state_changes", per_frame(&Counts::state_changes) },
+            { "texture_bytes", per_frame(&Counts::texture_bytes) },
+            { "buffer_bytes", per_frame(&Counts::buffer_bytes) },
+            { "framebuffer_binds", per_frame(&Counts::framebuffer_binds) },
+        });
+    }
+    m_command_counts = counts;
+    emit command_counts_changed();
+}
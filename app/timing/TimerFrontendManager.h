@@ -22,27 +22,54 @@
 #include <QMap>
 #include <QList>
 #include <QString>
+#include <QVariantList>
 
-#include "nucleus/timing/TimerManager.h"
+#include "nucleus/timing/MeasurementSnapshot.h"
 #include "TimerFrontendObject.h"
 
+class QTimer;
+
+/// Polls the measurement snapshot of the render window while active (i.e., while the stats window is visible). Every poll
+/// adds the mean of the new measurements of each timer, and updates the gl command counts per frame of each pass.
 class TimerFrontendManager : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(bool active READ active WRITE set_active NOTIFY active_changed)
+    // a map per pass (name, draw_calls, instances, vertices, state_changes, texture_bytes, buffer_bytes, framebuffer_binds),
+    // averaged over the frames since the last poll
+    Q_PROPERTY(QVariantList command_counts READ command_counts NOTIFY command_counts_changed)
 
 public:
+    static constexpr int poll_interval_msecs = 250;
+
     TimerFrontendManager(QObject* parent = nullptr);
     ~TimerFrontendManager() override;
 
-public slots:
-    void receive_measurements(QList<nucleus::timing::TimerReport> values);
+    // the gui thread must not run concurrently (e.g., set from QQuickFramebufferObject::createRenderer)
+    void set_snapshot(nucleus::timing::MeasurementSnapshotPtr snapshot);
+    [[nodiscard]] bool active() const;
+    void set_active(bool active);
+    [[nodiscard]] QVariantList command_counts() const { return m_command_counts; }
 
 signals:
     void updateTimingList(QList<TimerFrontendObject*> data);
+    void active_changed(bool active);
+    void command_counts_changed();
 
 private:
+    void poll();
+    void update_command_counts();
+
     QList<TimerFrontendObject*> m_timer;
     QMap<QString, TimerFrontendObject*> m_timer_map;
     static int current_frame;
 
+    QTimer* m_poll_timer;
+    bool m_active = false;
+    nucleus::timing::MeasurementSnapshotPtr m_snapshot;
+    nucleus::timing::MeasurementSnapshot::Snapshot m_current;
+    nucleus::timing::MeasurementSnapshot::Snapshot m_previous;
+    std::vector<nucleus::timing::MeasurementSnapshot::TimerInfo> m_infos;
+    std::vector<std::string> m_passes;
+    QVariantList m_command_counts;
 };
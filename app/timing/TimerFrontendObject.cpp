@@ -18,12 +18,16 @@
 
 #include "TimerFrontendObject.h"
 
+#include <cmath>
+
 #include <QDebug>
 
 int TimerFrontendObject::timer_color_index = 0;
 
-void TimerFrontendObject::add_measurement(float value, int frame) {
-    m_quick_average = m_quick_average * m_old_weight + value * m_new_weight;
+void TimerFrontendObject::add_measurement(float value, int frame, unsigned n_measurements) {
+    // value is the mean of n measurements, decay the quick average as if they had been added one by one
+    const float old_weight = n_measurements == 1 ? m_old_weight : std::pow(m_old_weight, float(n_measurements));
+    m_quick_average = m_quick_average * old_weight + value * (1.0f - old_weight);
     m_measurements.append(QVector3D((float)frame, value, m_quick_average));
     if (m_measurements.size() > m_queue_size) m_measurements.removeFirst();
 }
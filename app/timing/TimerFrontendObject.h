@@ -53,7 +53,7 @@ public:
 
     static int timer_color_index;
 
-    void add_measurement(float value, int frame);
+    void add_measurement(float value, int frame, unsigned n_measurements = 1);
     float get_last_measurement();
     float get_average();
     float get_quick_average() { return m_quick_average; }
@@ -22,7 +22,7 @@ if (NOT TARGET Catch2)
 endif()
 alp_add_git_repository(qml_catch2_console URL https://github.com/AlpineMapsOrg/qml_catch2_console.git COMMITISH v24.01.20 DO_NOT_ADD_SUBPROJECT)
 
-if (EMSCRIPTEN AND ALP_ENABLE_THREADING)
+if (EMSCRIPTEN AND (ALP_ENABLE_THREADING OR ALP_ENABLE_DECODE_WORKERS))
     target_compile_options(Catch2 PRIVATE -pthread)
 endif()
 
@@ -38,7 +38,7 @@ function(alp_add_unittest name)
             "$<TARGET_FILE_DIR:${name}>/qtloader.js"
         )
 
-        if (ALP_ENABLE_THREADING)
+        if (ALP_ENABLE_THREADING OR ALP_ENABLE_DECODE_WORKERS)
             list(APPEND ALP_INSTALL_FILES "$<TARGET_FILE_DIR:${name}>/${name}.worker.js")
         endif()
         install(FILES ${ALP_INSTALL_FILES} DESTINATION ${ALP_WWW_INSTALL_DIR})
@@ -0,0 +1,167 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "BackgroundUploader.h"
+
+#include <QDebug>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QThread>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <span>
+#include <utility>
+
+#include "StagingRing.h"
+#include "Texture.h"
+#include "nucleus/timing/TraceRecorder.h"
+
+namespace {
+constexpr size_t STAGING_RING_BYTES = size_t(16) << 20;
+}
+
+bool gl_engine::BackgroundUploader::is_supported()
+{
+#if defined(__EMSCRIPTEN__)
+    return false;
+#else
+    // on desktop and android shared contexts on several threads are reliable (the platform plugin tells otherwise)
+    return QOpenGLContext::supportsThreadedOpenGL() && QOpenGLContext::currentContext() != nullptr;
+#endif
+}
+
+gl_engine::BackgroundUploader::BackgroundUploader(std::shared_ptr<QOffscreenSurface> surface)
+    : m_surface(std::move(surface))
+    , m_owner_thread(QThread::currentThread())
+{
+    assert(is_supported());
+    assert(m_surface && m_surface->isValid());
+    auto* render_context = QOpenGLContext::currentContext();
+    m_context = std::make_unique<QOpenGLContext>();
+    m_context->setFormat(render_context->format());
+    m_context->setShareContext(render_context);
+    if (!m_context->create() || !m_context->shareContext()) {
+        qDebug() << "BackgroundUploader: couldn't create a shared context, uploading on the render thread";
+        m_context.reset();
+        return;
+    }
+    m_thread.reset(QThread::create([this]() { run(); }));
+    m_thread->setObjectName("tile upload");
+    m_context->moveToThread(m_thread.get());
+    m_thread->start();
+}
+
+gl_engine::BackgroundUploader::~BackgroundUploader()
+{
+    if (!m_thread)
+        return;
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake_up.notify_one();
+    m_thread->wait();
+    auto* f = QOpenGLContext::currentContext() ? QOpenGLContext::currentContext()->extraFunctions() : nullptr;
+    for (const auto& finished : m_finished) {
+        if (f)
+            f->glDeleteSync(finished.fence);
+    }
+}
+
+void gl_engine::upload_quad(const BackgroundUploader::Job& job, StagingRing* staging)
+{
+    const nucleus::timing::TraceScope trace("upload_quad", "gl");
+    const auto& tiles = job.quad.tiles;
+    const auto orthos = std::array { tiles[0].ortho.get(), tiles[1].ortho.get(), tiles[2].ortho.get(), tiles[3].ortho.get() };
+    const auto heights = std::array { tiles[0].height.get(), tiles[1].height.get(), tiles[2].height.get(), tiles[3].height.get() };
+    const auto normals = std::array { tiles[0].normals.get(), tiles[1].normals.get(), tiles[2].normals.get(), tiles[3].normals.get() };
+    job.ortho_textures->upload(std::span<const nucleus::utils::ColourTexture* const>(orthos), job.first_layer, staging);
+    job.height_textures->upload(std::span<const nucleus::Raster<uint16_t>* const>(heights), job.first_layer, staging);
+    // computed by the scheduler only when they are needed (Scheduler::set_normal_maps)
+    if (std::none_of(normals.begin(), normals.end(), [](const auto* n) { return n == nullptr; }))
+        job.normal_textures->upload(std::span<const nucleus::Raster<glm::u8vec2>* const>(normals), job.first_layer, staging);
+}
+
+void gl_engine::BackgroundUploader::upload(std::vector<Job> jobs)
+{
+    assert(m_thread);
+    {
+        std::scoped_lock lock(m_mutex);
+        m_jobs.insert(m_jobs.end(), std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+    }
+    m_wake_up.notify_one();
+}
+
+std::vector<gl_engine::BackgroundUploader::Finished> gl_engine::BackgroundUploader::take_finished()
+{
+    std::scoped_lock lock(m_mutex);
+    return std::exchange(m_finished, {});
+}
+
+void gl_engine::BackgroundUploader::set_thread_policy(const nucleus::utils::ThreadPolicy& policy)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_thread_policy = policy;
+    }
+    m_wake_up.notify_one(); // applied without waiting for jobs
+}
+
+void gl_engine::BackgroundUploader::run()
+{
+    if (!m_context->makeCurrent(m_surface.get())) {
+        qDebug() << "BackgroundUploader: couldn't make the upload context current";
+        m_failed = true;
+        m_context->moveToThread(m_owner_thread);
+        return;
+    }
+    auto* f = m_context->extraFunctions();
+    {
+        auto staging_ring = StagingRing::is_supported() ? std::make_unique<StagingRing>(STAGING_RING_BYTES) : nullptr;
+        std::vector<Job> jobs;
+        std::vector<Finished> finished;
+        nucleus::utils::ThreadPolicy policy;
+        while (true) {
+            {
+                std::unique_lock lock(m_mutex);
+                m_wake_up.wait(lock, [&]() { return m_stop || !m_jobs.empty() || m_thread_policy != policy; });
+                if (m_stop)
+                    break;
+                std::swap(jobs, m_jobs);
+                policy = m_thread_policy;
+            }
+            policy.apply_to_current_thread();
+            for (const auto& job : jobs) {
+                const auto start = std::chrono::steady_clock::now();
+                upload_quad(job, staging_ring.get());
+                const auto upload_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                finished.push_back({ job.ticket, f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), upload_ms });
+            }
+            f->glFlush(); // the fences must reach the gpu, otherwise the render context could wait forever
+            jobs.clear();
+            std::scoped_lock lock(m_mutex);
+            m_finished.insert(m_finished.end(), finished.begin(), finished.end());
+            finished.clear();
+        }
+    }
+    m_context->doneCurrent();
+    m_context->moveToThread(m_owner_thread); // destroyed by the owner
+}
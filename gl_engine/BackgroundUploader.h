@@ -0,0 +1,99 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <qopengl.h>
+#ifdef ANDROID
+#include <GLES3/gl3.h>
+#endif
+
+#include <nucleus/tile_scheduler/tile_types.h>
+#include <nucleus/utils/ThreadPolicy.h>
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QThread;
+
+namespace gl_engine {
+class StagingRing;
+class Texture;
+
+/// Uploads the tile textures of quads on a thread of its own, with a context that shares the texture arrays with the render context.
+/// Every job is followed by a fence, the render thread collects the finished jobs (take_finished) and makes the layers
+/// resident once their fence is signalled. Not available on WebGL (no shared contexts), see is_supported().
+class BackgroundUploader {
+public:
+    struct Job {
+        uint64_t ticket = 0;
+        Texture* ortho_textures = nullptr; // must stay alive until the job is finished
+        Texture* height_textures = nullptr;
+        Texture* normal_textures = nullptr;
+        unsigned first_layer = 0; // the tiles of the quad go to consecutive layers
+        nucleus::tile_scheduler::tile_types::GpuTileQuad quad;
+    };
+    struct Finished {
+        uint64_t ticket = 0;
+        GLsync fence = nullptr; // owned by the receiver
+        float upload_ms = 0; // of upload_quad, on the upload thread
+    };
+
+    BackgroundUploader(const BackgroundUploader&) = delete;
+    BackgroundUploader& operator=(const BackgroundUploader&) = delete;
+    /// the render context must be current. the surface must have been created on the gui thread (see QOffscreenSurface::create)
+    /// with the format of the render context.
+    explicit BackgroundUploader(std::shared_ptr<QOffscreenSurface> surface);
+    ~BackgroundUploader();
+
+    [[nodiscard]] static bool is_supported();
+    /// false if the shared context couldn't be created or made current. jobs that were handed over are lost then.
+    [[nodiscard]] bool is_running() const { return m_thread != nullptr && !m_failed; }
+
+    void upload(std::vector<Job> jobs);
+    /// the jobs that were uploaded since the last call, in order
+    [[nodiscard]] std::vector<Finished> take_finished();
+    /// applied by the upload thread before its next jobs
+    void set_thread_policy(const nucleus::utils::ThreadPolicy& policy);
+
+private:
+    void run();
+
+    std::shared_ptr<QOffscreenSurface> m_surface;
+    std::unique_ptr<QOpenGLContext> m_context;
+    QThread* m_owner_thread = nullptr;
+    std::unique_ptr<QThread> m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake_up;
+    std::vector<Job> m_jobs;
+    std::vector<Finished> m_finished;
+    nucleus::utils::ThreadPolicy m_thread_policy;
+    bool m_stop = false;
+    std::atomic<bool> m_failed = false;
+};
+
+/// uploads the four tiles of the job's quad with the current context, one call per texture (and mip level)
+void upload_quad(const BackgroundUploader::Job& job, StagingRing* staging);
+
+} // namespace gl_engine
@@ -0,0 +1,157 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "DepthReadback.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include "Framebuffer.h"
+#include "GlState.h"
+
+namespace gl_engine {
+
+DepthReadback::DepthReadback(unsigned downsampling)
+    : m_downsampling(std::max(downsampling, 1u))
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    m_downsampled = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::RGBA8 });
+    m_downsampled->set_memory_subsystem("depth readback");
+    for (auto& slot : m_slots)
+        f->glGenBuffers(1, &slot.pbo);
+}
+
+DepthReadback::~DepthReadback()
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (auto& slot : m_slots) {
+        if (slot.fence)
+            f->glDeleteSync(GLsync(slot.fence));
+        f->glDeleteBuffers(1, &slot.pbo);
+    }
+}
+
+void DepthReadback::collect()
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    // oldest first, so that m_data ends up with the newest finished read
+    for (unsigned i = 0; i < ring_size; ++i) {
+        auto& slot = m_slots[(m_next_slot + i) % ring_size];
+        if (!slot.fence)
+            continue;
+        const auto status = f->glClientWaitSync(GLsync(slot.fence), 0, 0); // don't wait
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        f->glDeleteSync(GLsync(slot.fence));
+        slot.fence = nullptr;
+
+        const auto n_bytes = GLsizeiptr(slot.size.x * slot.size.y * sizeof(glm::u8vec4));
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const auto* mapped = f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, n_bytes, GL_MAP_READ_BIT);
+        if (mapped) {
+            m_data.resize(slot.size.x * slot.size.y);
+            std::memcpy(m_data.data(), mapped, size_t(n_bytes));
+            m_data_size = slot.size;
+            m_data_camera = slot.camera;
+            m_data_tag = slot.tag;
+            ++m_data_version;
+            f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void DepthReadback::start_read(Framebuffer* source, unsigned attachment, const nucleus::camera::Definition& camera, uint64_t tag)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    collect();
+
+    auto& slot = m_slots[m_next_slot];
+    if (slot.fence) // gpu is more than ring_size frames behind, skip this frame
+        return;
+
+    GLint previous_read_fbo = 0;
+    GLint previous_draw_fbo = 0;
+    GLint previous_viewport[4] = {};
+    f->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_fbo);
+    f->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_draw_fbo);
+    f->glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+    const auto size = glm::max(source->size() / m_downsampling, glm::uvec2(1));
+    if (m_downsampled->size() != size)
+        m_downsampled->resize(size);
+    source->blit_colour_attachment(attachment, m_downsampled.get());
+
+    m_downsampled->bind();
+    f->glReadBuffer(GL_COLOR_ATTACHMENT0);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.size != size) {
+        f->glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size.x * size.y * sizeof(glm::u8vec4)), nullptr, GL_STREAM_READ);
+        slot.size = size;
+    }
+    f->glReadPixels(0, 0, GLsizei(size.x), GLsizei(size.y), GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // into the pbo, returns immediately
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.camera = camera;
+    slot.tag = tag;
+    m_next_slot = (m_next_slot + 1) % ring_size;
+
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previous_read_fbo));
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previous_draw_fbo));
+    f->glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+    GlState::current().invalidate_framebuffer();
+}
+
+std::optional<glm::u8vec4> DepthReadback::pixel(const glm::dvec2& normalised_device_coordinates) const
+{
+    if (m_data.empty())
+        return {};
+    const auto x = std::clamp(int((normalised_device_coordinates.x + 1) / 2 * m_data_size.x), 0, int(m_data_size.x) - 1);
+    const auto y = std::clamp(int((normalised_device_coordinates.y + 1) / 2 * m_data_size.y), 0, int(m_data_size.y) - 1);
+    return m_data[size_t(y) * m_data_size.x + size_t(x)];
+}
+
+const std::vector<glm::u8vec4>& DepthReadback::data() const
+{
+    return m_data;
+}
+
+glm::uvec2 DepthReadback::data_size() const
+{
+    return m_data_size;
+}
+
+const nucleus::camera::Definition& DepthReadback::data_camera() const
+{
+    return m_data_camera;
+}
+
+uint64_t DepthReadback::data_tag() const
+{
+    return m_data_tag;
+}
+
+uint64_t DepthReadback::data_version() const
+{
+    return m_data_version;
+}
+
+}
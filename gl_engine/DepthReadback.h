@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nucleus/camera/Definition.h"
+
+namespace gl_engine {
+
+class Framebuffer;
+
+/// Reads back a downsampled copy of an RGBA8 colour attachment (the encoded depth) without stalling the pipeline.
+/// Every frame a copy is queued into a ring of pixel buffer objects, and the oldest one that the gpu finished is
+/// mapped. pixel() therefore returns the content of a previous frame (typically the last one).
+/// Needs glMapBufferRange and fences, i.e., it is not available on WebGL.
+class DepthReadback
+{
+public:
+    static constexpr unsigned ring_size = 3;
+
+    explicit DepthReadback(unsigned downsampling = 4);
+    ~DepthReadback();
+
+    // call once per frame after the attachment was rendered. collects finished reads and queues a new one.
+    // camera is the one the attachment was rendered with, it is handed out along with the data (as is tag).
+    void start_read(Framebuffer* source, unsigned attachment, const nucleus::camera::Definition& camera, uint64_t tag = 0);
+    // nullopt if no read finished yet
+    [[nodiscard]] std::optional<glm::u8vec4> pixel(const glm::dvec2& normalised_device_coordinates) const;
+
+    // the newest finished read, row major starting with the bottom row. empty if no read finished yet.
+    [[nodiscard]] const std::vector<glm::u8vec4>& data() const;
+    [[nodiscard]] glm::uvec2 data_size() const;
+    [[nodiscard]] const nucleus::camera::Definition& data_camera() const;
+    [[nodiscard]] uint64_t data_tag() const;
+    // incremented whenever data() changed
+    [[nodiscard]] uint64_t data_version() const;
+
+private:
+    struct Slot {
+        unsigned pbo = 0;
+        void* fence = nullptr; // GLsync, nullptr if not in flight
+        glm::uvec2 size = {};
+        nucleus::camera::Definition camera;
+        uint64_t tag = 0;
+    };
+    void collect();
+
+    unsigned m_downsampling;
+    std::unique_ptr<Framebuffer> m_downsampled;
+    std::array<Slot, ring_size> m_slots;
+    unsigned m_next_slot = 0;
+    std::vector<glm::u8vec4> m_data;
+    glm::uvec2 m_data_size = {};
+    nucleus::camera::Definition m_data_camera;
+    uint64_t m_data_tag = 0;
+    uint64_t m_data_version = 0;
+};
+
+}
@@ -0,0 +1,160 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "FarField.h"
+
+#include <array>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Framebuffer.h"
+#include "GlState.h"
+#include "ShaderProgram.h"
+#include "Viewshed.h"
+
+namespace gl_engine {
+
+FarField::FarField(std::shared_ptr<ShaderProgram> program)
+    : m_program(std::move(program))
+{
+    m_uniforms.view_proj = m_program->uniform<glm::mat4>("view_proj");
+    m_uniforms.centre = m_program->uniform<glm::vec3>("centre");
+    m_uniforms.near_distance = m_program->uniform<float>("near_distance");
+    m_f = QOpenGLContext::currentContext()->extraFunctions();
+}
+
+FarField::~FarField() = default;
+
+void FarField::set_settings(const Settings& settings)
+{
+    if (settings == m_settings)
+        return;
+    if (settings.resolution != m_settings.resolution)
+        m_atlas.reset();
+    m_settings = settings;
+    invalidate_cache();
+}
+
+const FarField::Settings& FarField::settings() const { return m_settings; }
+
+bool FarField::update(const glm::dvec3& camera_position, bool tiles_changed, bool moving)
+{
+    if (!m_valid || glm::distance(camera_position, m_centre) > m_settings.max_offset * m_settings.distance) {
+        m_centre = camera_position;
+        m_valid = false;
+    }
+    // while moving, the new tiles are mostly the ones of the near field. they are picked up when the camera comes to rest.
+    if (tiles_changed && !moving)
+        m_valid = false;
+    return !m_valid;
+}
+
+const glm::dvec3& FarField::centre() const { return m_centre; }
+
+double FarField::near_distance() const { return m_settings.distance * (1.0 - m_settings.max_offset); }
+
+// everything nearer than near_distance is discarded, the faces see that at a distance of near_distance / sqrt(3) or more
+double FarField::near_plane() const { return near_distance() * 0.5; }
+
+// the terrain is faded into the atmosphere before (see compose.frag)
+double FarField::far_plane() const { return 1000000.0; }
+
+glm::dmat4 FarField::face_world_to_clip(unsigned face) const
+{
+    return glm::perspective(glm::radians(90.0), 1.0, near_plane(), far_plane()) * Viewshed::face_view(m_centre, face);
+}
+
+void FarField::allocate_atlas()
+{
+    m_atlas = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::Float32,
+        std::vector { Framebuffer::ColourFormat::RGBA8, Framebuffer::ColourFormat::RG16UI },
+        glm::uvec2(3, 2) * m_settings.resolution);
+    m_atlas->set_memory_subsystem("far field");
+}
+
+void FarField::invalidate_cache() { m_valid = false; }
+
+void FarField::draw(TileManager* tile_manager, const TileManager::DrawRange& range, const glm::dvec3& origin)
+{
+    if (m_valid)
+        return;
+    m_valid = true;
+    if (!m_atlas)
+        allocate_atlas();
+
+    auto& state = GlState::current();
+    state.set_enabled(GL_DEPTH_TEST, true);
+    state.set_depth_func(GL_LESS);
+    m_program->bind();
+    m_program->set_uniform(m_uniforms.centre, glm::vec3(m_centre - origin));
+    m_program->set_uniform(m_uniforms.near_distance, float(near_distance()));
+    m_atlas->bind();
+    state.set_enabled(GL_SCISSOR_TEST, true);
+    const auto size = GLsizei(m_settings.resolution);
+    for (unsigned face = 0; face < 6; ++face) {
+        const auto x = GLint((face % 3) * m_settings.resolution);
+        const auto y = GLint((face / 3) * m_settings.resolution);
+        state.set_viewport({ x, y, size, size });
+        m_f->glScissor(x, y, size, size);
+        // alpha 0 and depth 1 where there is no terrain
+        const GLfloat clear_albedo[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        m_f->glClearBufferfv(GL_COLOR, 0, clear_albedo);
+        const GLuint clear_normal[] = { 0u, 0u, 0u, 0u };
+        m_f->glClearBufferuiv(GL_COLOR, 1, clear_normal);
+        m_f->glClear(GL_DEPTH_BUFFER_BIT);
+        // the vertex shader works in coordinates relative to the origin of prepare_draw
+        m_program->set_uniform(m_uniforms.view_proj, glm::mat4(face_world_to_clip(face) * glm::translate(glm::dmat4(1.0), origin)));
+        tile_manager->draw(range);
+    }
+    state.set_enabled(GL_SCISSOR_TEST, false);
+    m_atlas->unbind();
+    m_program->release();
+}
+
+void FarField::bind(ShaderProgram* program, unsigned location, const glm::dvec3& camera_position)
+{
+    if (program != m_compose_program) {
+        m_compose_program = program;
+        m_compose_uniforms.enabled = program->uniform<int>("far_field_enabled");
+        m_compose_uniforms.view_proj = program->uniform<glm::mat4>("far_field_view_proj[0]");
+        m_compose_uniforms.centre = program->uniform<glm::vec3>("far_field_centre");
+        m_compose_uniforms.distance = program->uniform<float>("far_field_distance");
+        m_compose_uniforms.near = program->uniform<float>("far_field_near");
+        m_compose_uniforms.far = program->uniform<float>("far_field_far");
+    }
+    program->set_uniform(m_compose_uniforms.enabled, int(m_atlas != nullptr));
+    if (!m_atlas)
+        return;
+    m_atlas->bind_colour_texture(0, location);
+    m_atlas->bind_colour_texture(1, location + 1);
+    m_atlas->bind_depth_texture(location + 2);
+    // the compose shader works in camera local coordinates
+    const auto camera_local_to_world = glm::translate(glm::dmat4(1.0), camera_position);
+    std::array<glm::mat4, 6> view_proj;
+    for (unsigned face = 0; face < 6; ++face)
+        view_proj[face] = glm::mat4(face_world_to_clip(face) * camera_local_to_world);
+    program->set_uniform_array(m_compose_uniforms.view_proj, view_proj);
+    program->set_uniform(m_compose_uniforms.centre, glm::vec3(m_centre - camera_position));
+    program->set_uniform(m_compose_uniforms.distance, float(m_settings.distance));
+    program->set_uniform(m_compose_uniforms.near, float(near_plane()));
+    program->set_uniform(m_compose_uniforms.far, float(far_plane()));
+}
+
+} // namespace gl_engine
@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+#include "TileManager.h"
+
+class QOpenGLExtraFunctions;
+
+namespace gl_engine {
+
+class Framebuffer;
+
+// far field impostor: the terrain beyond a distance is rendered into the 6 faces of a cube around a centre near the camera (90
+// degree perspective faces in a 3x2 atlas, like the Viewshed), and the gbuffer pass only draws the tiles of the near field. the
+// compose pass looks up the faces where the gbuffer has no terrain. the faces keep albedo, normal and depth, so they are shaded
+// in compose like the gbuffer, and a change of the sun doesn't render them again. they are rendered again if the camera moves
+// farther than max_offset * distance from the centre (which then moves to the camera), or if the tiles changed while the camera
+// is at rest. the tiles are those of the draw list, i.e., fine in the view and coarse elsewhere.
+class FarField {
+public:
+    struct Settings {
+        double distance = 30000; // metres, the near field ends there
+        double max_offset = 0.1; // of distance, the camera can move that far from the centre until the faces are rendered again
+        unsigned resolution = 1024; // per face
+        bool operator==(const Settings&) const = default;
+    };
+
+    explicit FarField(std::shared_ptr<ShaderProgram> program);
+    ~FarField();
+
+    void set_settings(const Settings& settings);
+    [[nodiscard]] const Settings& settings() const;
+    // true if the faces must be rendered this frame (then the far pass needs to be filled, see near_distance), moves the centre
+    // to the camera if it is too far away
+    bool update(const glm::dvec3& camera_position, bool tiles_changed, bool moving);
+    [[nodiscard]] const glm::dvec3& centre() const;
+    // terrain that is nearer to the centre is not in the faces. the near field reaches at least that far around the centre.
+    [[nodiscard]] double near_distance() const;
+    // renders the faces, the tiles are those of the far pass. origin is the one given to prepare_draw.
+    void draw(TileManager* tile_manager, const TileManager::DrawRange& range, const glm::dvec3& origin);
+    void invalidate_cache();
+
+    // sets the far field uniforms of the compose program and binds albedo, normal and depth of the faces to location,
+    // location + 1 and location + 2 (texin_far_field_*, see the sampler layout in ShaderManager)
+    void bind(ShaderProgram* program, unsigned location, const glm::dvec3& camera_position);
+    // world to clip matrix of a face (+x, -x, +y, -y, +z, -z)
+    [[nodiscard]] glm::dmat4 face_world_to_clip(unsigned face) const;
+    [[nodiscard]] double near_plane() const;
+    [[nodiscard]] double far_plane() const;
+
+private:
+    void allocate_atlas();
+
+    Settings m_settings;
+    glm::dvec3 m_centre = {};
+    std::shared_ptr<ShaderProgram> m_program;
+    struct {
+        ShaderProgram::Uniform<glm::mat4> view_proj;
+        ShaderProgram::Uniform<glm::vec3> centre;
+        ShaderProgram::Uniform<float> near_distance;
+    } m_uniforms;
+    ShaderProgram* m_compose_program = nullptr; // of the handles below, resolved on the first bind
+    struct {
+        ShaderProgram::Uniform<int> enabled;
+        ShaderProgram::Uniform<glm::mat4> view_proj; // array of 6
+        ShaderProgram::Uniform<glm::vec3> centre;
+        ShaderProgram::Uniform<float> distance;
+        ShaderProgram::Uniform<float> near;
+        ShaderProgram::Uniform<float> far;
+    } m_compose_uniforms;
+    std::unique_ptr<Framebuffer> m_atlas;
+    bool m_valid = false;
+    QOpenGLExtraFunctions* m_f;
+};
+
+} // namespace gl_engine
@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include "GlState.h"
+
+namespace gl_engine {
+
+FrameCapture::FrameCapture(Sink sink, unsigned ring_size)
+    : m_sink(std::move(sink))
+    , m_slots(std::max(ring_size, 1u))
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (auto& slot : m_slots)
+        f->glGenBuffers(1, &slot.pbo);
+}
+
+FrameCapture::~FrameCapture()
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (auto& slot : m_slots) {
+        if (slot.fence)
+            f->glDeleteSync(GLsync(slot.fence));
+        f->glDeleteBuffers(1, &slot.pbo);
+    }
+}
+
+bool FrameCapture::collect_oldest(bool wait)
+{
+    if (m_n_in_flight == 0)
+        return false;
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    auto& slot = m_slots[m_oldest_slot];
+    // the flush makes sure that the fence is reached eventually, the wait is in steps, as the timeout may be capped
+    const auto timeout = wait ? GLuint64(100'000'000) : GLuint64(0);
+    auto status = f->glClientWaitSync(GLsync(slot.fence), GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+        status = f->glClientWaitSync(GLsync(slot.fence), 0, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+        return false;
+    f->glDeleteSync(GLsync(slot.fence));
+    slot.fence = nullptr;
+    m_oldest_slot = (m_oldest_slot + 1) % unsigned(m_slots.size());
+    --m_n_in_flight;
+    if (status == GL_WAIT_FAILED)
+        return true; // dropped, but the ring moves on
+
+    const auto row_bytes = size_t(slot.size.x) * 4;
+    const auto n_bytes = GLsizeiptr(row_bytes * slot.size.y);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const auto* mapped = static_cast<const uchar*>(f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, n_bytes, GL_MAP_READ_BIT));
+    if (mapped) {
+        // gl rows start at the bottom, flipped while copying
+        QImage image(int(slot.size.x), int(slot.size.y), QImage::Format_RGBA8888);
+        for (unsigned y = 0; y < slot.size.y; ++y)
+            std::memcpy(image.scanLine(int(slot.size.y - 1 - y)), mapped + y * row_bytes, row_bytes);
+        f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_sink(std::move(image), slot.tag);
+    } else {
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    return true;
+}
+
+void FrameCapture::collect(bool wait)
+{
+    // in capture order, the sink gets the frames in sequence
+    while (collect_oldest(wait)) { }
+}
+
+void FrameCapture::capture(unsigned framebuffer, const glm::uvec2& size, uint64_t tag)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    collect();
+    if (m_n_in_flight == m_slots.size())
+        collect_oldest(true); // the gpu is ring_size frames behind, wait instead of dropping the frame
+
+    auto& slot = m_slots[(m_oldest_slot + m_n_in_flight) % unsigned(m_slots.size())];
+    GLint previous_read_fbo = 0;
+    f->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_fbo);
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    f->glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const auto n_bytes = size_t(size.x) * size.y * 4;
+    if (slot.n_allocated_bytes != n_bytes) {
+        f->glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(n_bytes), nullptr, GL_STREAM_READ);
+        slot.n_allocated_bytes = n_bytes;
+    }
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    f->glReadPixels(0, 0, GLsizei(size.x), GLsizei(size.y), GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // into the pbo, returns immediately
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.size = size;
+    slot.tag = tag;
+    ++m_n_in_flight;
+
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previous_read_fbo));
+    GlState::current().invalidate_framebuffer();
+}
+
+unsigned FrameCapture::n_in_flight() const { return m_n_in_flight; }
+
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <QImage>
+#include <glm/glm.hpp>
+
+namespace gl_engine {
+
+/// Reads back whole frames (e.g., for videos and batches of screenshots) without stalling the pipeline. capture() queues a copy
+/// of the framebuffer into a ring of pixel buffer objects, and the frames are handed to the sink in capture order once the gpu
+/// finished them, typically a few frames later. If the ring is full, capture() waits for the oldest frame, so that none is
+/// dropped. Like DepthReadback, it needs glMapBufferRange and fences, i.e., it is not available on WebGL.
+class FrameCapture
+{
+public:
+    // image is RGBA8888, top row first. called on the render thread, with the context current.
+    using Sink = std::function<void(QImage image, uint64_t tag)>;
+
+    explicit FrameCapture(Sink sink, unsigned ring_size = 3);
+    ~FrameCapture(); // the context must be current, frames that are still in flight are dropped
+
+    // call after the frame was drawn into framebuffer (the gl name, 0 is the default framebuffer). tag is handed to the sink.
+    void capture(unsigned framebuffer, const glm::uvec2& size, uint64_t tag = 0);
+    // hands the finished frames to the sink. with wait, it blocks until all frames in flight are finished (e.g., at the end).
+    void collect(bool wait = false);
+    [[nodiscard]] unsigned n_in_flight() const;
+
+private:
+    struct Slot {
+        unsigned pbo = 0;
+        void* fence = nullptr; // GLsync, nullptr if not in flight
+        glm::uvec2 size = {};
+        size_t n_allocated_bytes = 0;
+        uint64_t tag = 0;
+    };
+    bool collect_oldest(bool wait);
+
+    Sink m_sink;
+    std::vector<Slot> m_slots;
+    unsigned m_oldest_slot = 0;
+    unsigned m_n_in_flight = 0;
+};
+
+}
@@ -19,6 +19,7 @@
  *****************************************************************************/
 
 #include "Framebuffer.h"
+#include "GlState.h"
 
 #include <iostream>
 
@@ -35,6 +36,43 @@ namespace gl_engine {
 
 
 
+// estimates for the memory accounting, rgb formats are padded to 4 channels by most drivers
+unsigned bytes_per_pixel(Framebuffer::ColourFormat f)
+{
+    switch (f) {
+    case Framebuffer::ColourFormat::R8:
+        return 1;
+    case Framebuffer::ColourFormat::RGB8:
+    case Framebuffer::ColourFormat::RGBA8:
+    case Framebuffer::ColourFormat::RG16UI:
+    case Framebuffer::ColourFormat::Float32:
+    case Framebuffer::ColourFormat::R32UI:
+        return 4;
+    case Framebuffer::ColourFormat::RGB16F:
+    case Framebuffer::ColourFormat::RGBA16F:
+        return 8;
+    case Framebuffer::ColourFormat::RGBA32F:
+        return 16;
+    }
+    assert(false);
+    return 4;
+}
+
+unsigned bytes_per_pixel(Framebuffer::DepthFormat f)
+{
+    switch (f) {
+    case Framebuffer::DepthFormat::None:
+        return 0;
+    case Framebuffer::DepthFormat::Int16:
+        return 2;
+    case Framebuffer::DepthFormat::Int24: // usually stored with 32 bit
+    case Framebuffer::DepthFormat::Float32:
+        return 4;
+    }
+    assert(false);
+    return 4;
+}
+
 // https://registry.khronos.org/OpenGL-Refpages/es3.0/html/glTexImage2D.xhtml
 QOpenGLTexture::TextureFormat internal_format_qt(Framebuffer::ColourFormat f)
 {
@@ -175,6 +213,7 @@ void Framebuffer::recreate_texture(size_t index)
 {
     if (index == size_t(-1)) {
         if (m_depth_format != DepthFormat::None) {
+            GlState::current().forget_texture(m_depth_texture->textureId());
             m_depth_texture->destroy();
             m_depth_texture->setFormat(internal_format_qt(m_depth_format));
             m_depth_texture->setSize(int(m_size.x), int(m_size.y));
@@ -189,6 +228,7 @@ void Framebuffer::recreate_texture(size_t index)
             m_depth_texture->allocateStorage();
         }
     } else {
+        GlState::current().forget_texture(m_colour_textures[index]->textureId());
         m_colour_textures[index]->destroy();
         m_colour_textures[index]->setFormat(internal_format_qt(m_colour_definitions[index]));
         m_colour_textures[index]->setSize(int(m_size.x), int(m_size.y));
@@ -207,6 +247,11 @@ void Framebuffer::recreate_all_textures() {
     recreate_texture(size_t(-1));
     for (size_t i = 0; i < m_colour_textures.size(); i++)
         recreate_texture(i);
+
+    auto n_bytes_per_pixel = uint64_t(bytes_per_pixel(m_depth_format));
+    for (const auto format : m_colour_definitions)
+        n_bytes_per_pixel += bytes_per_pixel(format);
+    m_memory.set_n_bytes(n_bytes_per_pixel * m_size.x * m_size.y);
 }
 
 Framebuffer::Framebuffer(DepthFormat depth_format, std::vector<Framebuffer::ColourFormat> colour_definitions, glm::uvec2 init_size)
@@ -224,14 +269,20 @@ Framebuffer::Framebuffer(DepthFormat depth_format, std::vector<Framebuffer::Colo
     }
 
     recreate_all_textures();
+    GlState::current().bind_texture(GL_TEXTURE_2D, 0);
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glBindTexture(GL_TEXTURE_2D, 0);
     f->glGenFramebuffers(1, &m_frame_buffer);
     reset_fbo();
 }
 
 Framebuffer::~Framebuffer()
 {
+    auto& state = GlState::current();
+    state.forget_framebuffer(m_frame_buffer);
+    for (const auto& texture : m_colour_textures)
+        state.forget_texture(texture->textureId()); // deleted with the QOpenGLTextures
+    if (m_depth_texture)
+        state.forget_texture(m_depth_texture->textureId());
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
     f->glDeleteFramebuffers(1, &m_frame_buffer);
 }
@@ -243,23 +294,37 @@ void Framebuffer::resize(const glm::uvec2& new_size)
     reset_fbo();
 }
 
+void Framebuffer::set_memory_subsystem(std::string subsystem) { m_memory.set_subsystem(std::move(subsystem)); }
+
 void Framebuffer::bind()
 {
-    QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glViewport(0, 0, int(m_size.x), int(m_size.y));
-    f->glBindFramebuffer(GL_FRAMEBUFFER, m_frame_buffer);
+    auto& state = GlState::current();
+    state.set_viewport({ 0, 0, int(m_size.x), int(m_size.y) });
+    state.bind_framebuffer(m_frame_buffer);
 }
 
 void Framebuffer::bind_colour_texture(unsigned index, unsigned location)
 {
     assert(index < m_colour_textures.size());
-    m_colour_textures[index]->bind(location);
+    GlState::current().bind_texture(location, GL_TEXTURE_2D, m_colour_textures[index]->textureId());
 }
 
 void Framebuffer::bind_depth_texture(unsigned location)
 {
     assert(m_depth_format != DepthFormat::None);
-    m_depth_texture->bind(location);
+    GlState::current().bind_texture(location, GL_TEXTURE_2D, m_depth_texture->textureId());
+}
+
+void Framebuffer::blit_colour_attachment(unsigned index, Framebuffer* target)
+{
+    assert(index < m_colour_textures.size());
+    assert(!target->m_colour_textures.empty());
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frame_buffer);
+    f->glReadBuffer(GL_COLOR_ATTACHMENT0 + index);
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->m_frame_buffer);
+    f->glBlitFramebuffer(0, 0, int(m_size.x), int(m_size.y), 0, 0, int(target->m_size.x), int(target->m_size.y), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    GlState::current().invalidate_framebuffer(); // read and draw differ now
 }
 
 QOpenGLTexture* Framebuffer::depth_texture()
@@ -339,14 +404,14 @@ template glm::u8vec4 Framebuffer::read_colour_attachment_pixel<glm::u8vec4>(unsi
 
 void Framebuffer::unbind()
 {
-    QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // not necessarily 0, e.g., when drawing into a qt quick window (underlay)
+    GlState::current().bind_framebuffer(QOpenGLContext::currentContext()->defaultFramebufferObject());
 }
 
 void Framebuffer::reset_fbo()
 {
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
-    f->glBindFramebuffer(GL_FRAMEBUFFER, m_frame_buffer);
+    GlState::current().bind_framebuffer(m_frame_buffer);
     // unsigned int draw_attachments[m_colour_textures.size()];
     std::vector<unsigned> draw_attachments;
     for (unsigned i = 0; i < m_colour_textures.size(); i++) {
@@ -26,6 +26,8 @@
 #include <QOpenGLTexture>
 #include <QColor>
 
+#include "GpuMemory.h"
+
 
 // There is QOpenGLFramebufferObject, but its API lacks the following:
 // - get depth buffer as a texture
@@ -67,6 +69,7 @@ private:
     //std::unique_ptr<QOpenGLTexture> m_colour_texture;
     unsigned m_frame_buffer = unsigned(-1);
     glm::uvec2 m_size;
+    gpu_memory::Allocation m_memory { "framebuffers" };
     // Recreates the OpenGL-Texture for the given index. An index of -1 recreates the depth-buffer.
     void recreate_texture(size_t index);
     // Calls recreate_texture for all the buffers that are attached to this FBO (depth and colour)
@@ -76,9 +79,14 @@ public:
     Framebuffer(DepthFormat depth_format, std::vector<Framebuffer::ColourFormat> colour_definitions, glm::uvec2 init_size = { 4, 4 });
     ~Framebuffer();
     void resize(const glm::uvec2& new_size);
+    // for the gpu memory accounting (gpu_memory::usage), "framebuffers" by default
+    void set_memory_subsystem(std::string subsystem);
     void bind();
     void bind_colour_texture(unsigned index = 0, unsigned location = 0);
     void bind_depth_texture(unsigned location = 0);
+    // copies (and scales, nearest filtering) colour attachment index into the first colour attachment of target.
+    // leaves both framebuffers bound (read and draw).
+    void blit_colour_attachment(unsigned index, Framebuffer* target);
 
     QOpenGLTexture* depth_texture();
 
@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "GlCounters.h"
+
+namespace gl_engine {
+
+std::vector<std::string> GlCounters::pass_names() { return { "other", "atmosphere", "shadowmap", "viewshed", "far_field", "vector_overlay", "tiles", "ssao", "compose", "upscale", "labels" }; }
+
+GlCounters& GlCounters::current()
+{
+    thread_local GlCounters counters;
+    return counters;
+}
+
+void GlCounters::begin_frame()
+{
+    m_pass = Pass::Other;
+    m_counts = {};
+}
+
+nucleus::timing::CommandCounts GlCounters::total() const
+{
+    nucleus::timing::CommandCounts total;
+    for (const auto& counts : m_counts)
+        total += counts;
+    return total;
+}
+
+} // namespace gl_engine
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nucleus/timing/CommandCounts.h"
+
+namespace gl_engine {
+
+/// Counts the gl commands of the render thread per pass of a frame: draw calls, instances, vertices, state changes, uploads
+/// and framebuffer binds. TileManager, Texture, UniformBuffer, MapLabelManager, the screen quad and GlState report into the
+/// pass that is set, Window publishes the counts with the timer measurements (see nucleus::timing::MeasurementSnapshot).
+/// Counting is a few additions per call, it is always on.
+class GlCounters {
+public:
+    enum class Pass : unsigned { Other, Atmosphere, Shadowmap, Viewshed, FarField, VectorOverlay, Tiles, Ssao, Compose, Upscale, Labels };
+    static constexpr unsigned n_passes = 11;
+    static std::vector<std::string> pass_names();
+
+    /// of the current thread
+    static GlCounters& current();
+
+    void begin_frame(); // resets the counts, the pass is Other again
+    void set_pass(Pass pass) { m_pass = pass; }
+    [[nodiscard]] Pass pass() const { return m_pass; }
+
+    /// n_vertices per instance
+    void count_draw(uint64_t n_vertices, uint64_t n_instances = 1)
+    {
+        count_draw_call();
+        count_instances(n_vertices, n_instances);
+    }
+    void count_draw_call() { ++m_counts[unsigned(m_pass)].draw_calls; }
+    /// of a command of a multi draw, without the call
+    void count_instances(uint64_t n_vertices, uint64_t n_instances)
+    {
+        auto& counts = m_counts[unsigned(m_pass)];
+        counts.instances += n_instances;
+        counts.vertices += n_vertices * n_instances;
+    }
+    void count_state_change() { ++m_counts[unsigned(m_pass)].state_changes; }
+    void count_texture_upload(uint64_t n_bytes) { m_counts[unsigned(m_pass)].texture_bytes += n_bytes; }
+    void count_buffer_write(uint64_t n_bytes) { m_counts[unsigned(m_pass)].buffer_bytes += n_bytes; }
+    void count_framebuffer_bind() { ++m_counts[unsigned(m_pass)].framebuffer_binds; }
+
+    [[nodiscard]] const std::array<nucleus::timing::CommandCounts, n_passes>& counts() const { return m_counts; }
+    [[nodiscard]] nucleus::timing::CommandCounts total() const;
+
+private:
+    Pass m_pass = Pass::Other;
+    std::array<nucleus::timing::CommandCounts, n_passes> m_counts = {};
+};
+
+/// sets the pass for the scope, and restores the previous one afterwards
+class ScopedGlPass {
+public:
+    explicit ScopedGlPass(GlCounters::Pass pass)
+        : m_previous(GlCounters::current().pass())
+    {
+        GlCounters::current().set_pass(pass);
+    }
+    ~ScopedGlPass() { GlCounters::current().set_pass(m_previous); }
+    ScopedGlPass(const ScopedGlPass&) = delete;
+    ScopedGlPass& operator=(const ScopedGlPass&) = delete;
+
+private:
+    GlCounters::Pass m_previous;
+};
+
+} // namespace gl_engine
@@ -0,0 +1,228 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "GlState.h"
+#include "GlCounters.h"
+
+#include <QObject>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+namespace gl_engine {
+
+namespace {
+int capability_index(GLenum capability)
+{
+    switch (capability) {
+    case GL_DEPTH_TEST:
+        return 0;
+    case GL_CULL_FACE:
+        return 1;
+    case GL_BLEND:
+        return 2;
+    case GL_SCISSOR_TEST:
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+int target_index(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_2D_ARRAY:
+        return 1;
+    default:
+        return -1;
+    }
+}
+} // namespace
+
+GlState& GlState::current()
+{
+    thread_local GlState state;
+    auto* context = QOpenGLContext::currentContext();
+    if (state.m_context != context) {
+        state.invalidate();
+        state.m_context = context;
+        state.m_f = context ? context->extraFunctions() : nullptr;
+        // connected once per context, the current context changes every frame with several windows.
+        // a new context can get the address of a destroyed one, therefore it is forgotten on destruction
+        if (context && state.m_watched_contexts.insert(context).second) {
+            QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, [context]() {
+                state.m_watched_contexts.erase(context);
+                if (state.m_context == context)
+                    state.m_context = nullptr;
+            });
+        }
+    }
+    return state;
+}
+
+void GlState::invalidate()
+{
+    m_program.reset();
+    invalidate_framebuffer();
+    m_active_unit.reset();
+    for (auto& unit : m_textures)
+        unit.fill(std::nullopt);
+    m_capabilities.fill(std::nullopt);
+    m_depth_func.reset();
+    m_depth_mask.reset();
+    m_cull_face.reset();
+    m_blend_func.reset();
+}
+
+void GlState::invalidate_framebuffer()
+{
+    m_framebuffer.reset();
+    m_viewport.reset();
+}
+
+void GlState::use_program(GLuint program)
+{
+    if (m_program == program)
+        return;
+    m_f->glUseProgram(program);
+    GlCounters::current().count_state_change();
+    m_program = program;
+}
+
+void GlState::bind_framebuffer(GLuint framebuffer)
+{
+    if (m_framebuffer == framebuffer)
+        return;
+    m_f->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GlCounters::current().count_framebuffer_bind();
+    m_framebuffer = framebuffer;
+}
+
+void GlState::set_viewport(const glm::ivec4& viewport)
+{
+    if (m_viewport == viewport)
+        return;
+    m_f->glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+    GlCounters::current().count_state_change();
+    m_viewport = viewport;
+}
+
+void GlState::activate_unit(unsigned unit)
+{
+    if (m_active_unit == unit)
+        return;
+    m_f->glActiveTexture(GL_TEXTURE0 + unit);
+    GlCounters::current().count_state_change();
+    m_active_unit = unit;
+}
+
+void GlState::bind_texture(unsigned unit, GLenum target, GLuint texture)
+{
+    const auto target_i = target_index(target);
+    if (unit >= n_units || target_i < 0) {
+        activate_unit(unit);
+        m_f->glBindTexture(target, texture);
+        GlCounters::current().count_state_change();
+        return;
+    }
+    auto& bound = m_textures[unit][size_t(target_i)];
+    if (bound == texture)
+        return;
+    activate_unit(unit);
+    m_f->glBindTexture(target, texture);
+    GlCounters::current().count_state_change();
+    bound = texture;
+}
+
+void GlState::bind_texture(GLenum target, GLuint texture) { bind_texture(m_active_unit.value_or(0), target, texture); }
+
+void GlState::set_enabled(GLenum capability, bool enabled)
+{
+    const auto index = capability_index(capability);
+    if (index >= 0 && m_capabilities[size_t(index)] == enabled)
+        return;
+    if (enabled)
+        m_f->glEnable(capability);
+    else
+        m_f->glDisable(capability);
+    GlCounters::current().count_state_change();
+    if (index >= 0)
+        m_capabilities[size_t(index)] = enabled;
+}
+
+void GlState::set_depth_func(GLenum func)
+{
+    if (m_depth_func == func)
+        return;
+    m_f->glDepthFunc(func);
+    GlCounters::current().count_state_change();
+    m_depth_func = func;
+}
+
+void GlState::set_depth_mask(bool enabled)
+{
+    if (m_depth_mask == enabled)
+        return;
+    m_f->glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    GlCounters::current().count_state_change();
+    m_depth_mask = enabled;
+}
+
+void GlState::set_cull_face(GLenum mode)
+{
+    if (m_cull_face == mode)
+        return;
+    m_f->glCullFace(mode);
+    GlCounters::current().count_state_change();
+    m_cull_face = mode;
+}
+
+void GlState::set_blend_func(GLenum source, GLenum destination)
+{
+    const auto func = std::make_pair(source, destination);
+    if (m_blend_func == func)
+        return;
+    m_f->glBlendFunc(source, destination);
+    GlCounters::current().count_state_change();
+    m_blend_func = func;
+}
+
+void GlState::forget_program(GLuint program)
+{
+    if (m_program == program)
+        m_program.reset(); // gl keeps using a deleted program until another one is bound
+}
+
+void GlState::forget_framebuffer(GLuint framebuffer)
+{
+    if (m_framebuffer == framebuffer)
+        m_framebuffer = 0; // deleting the bound framebuffer binds the default one
+}
+
+void GlState::forget_texture(GLuint texture)
+{
+    for (auto& unit : m_textures) {
+        for (auto& bound : unit) {
+            if (bound == texture)
+                bound = 0; // deleting unbinds it from all units
+        }
+    }
+}
+
+} // namespace gl_engine
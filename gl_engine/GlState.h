@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <optional>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+#include <qopengl.h>
+#ifdef ANDROID
+#include <GLES3/gl3.h>
+#endif
+
+class QOpenGLContext;
+class QOpenGLExtraFunctions;
+
+namespace gl_engine {
+
+/// Shadow of the gl state that the passes change most often (program, framebuffer, viewport, texture bindings, depth, cull and
+/// blend state). Redundant calls are not forwarded to gl, which saves driver validation, especially on mobile and webgl.
+/// The forwarded ones are counted (see GlCounters).
+/// Everything is unknown after invalidate(), then the next call goes through. Code that changes this state without going
+/// through here (qt, raw gl) must invalidate it afterwards. Deleted objects must be forgotten, as gl reuses their names.
+class GlState {
+public:
+    /// of the current context, it is reset when the context changes or is destroyed
+    static GlState& current();
+    void invalidate();
+    void invalidate_framebuffer(); // and the viewport, e.g., after a blit or a readback that restores them with raw gl
+
+    void use_program(GLuint program);
+    void bind_framebuffer(GLuint framebuffer); // GL_FRAMEBUFFER, i.e., draw and read
+    void set_viewport(const glm::ivec4& viewport); // x, y, width, height
+    void bind_texture(unsigned unit, GLenum target, GLuint texture);
+    /// on the active unit, e.g., for uploads
+    void bind_texture(GLenum target, GLuint texture);
+
+    /// GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND and GL_SCISSOR_TEST are tracked, other capabilities are passed through
+    void set_enabled(GLenum capability, bool enabled);
+    void set_depth_func(GLenum func);
+    void set_depth_mask(bool enabled);
+    void set_cull_face(GLenum mode);
+    void set_blend_func(GLenum source, GLenum destination);
+
+    void forget_program(GLuint program);
+    void forget_framebuffer(GLuint framebuffer);
+    void forget_texture(GLuint texture);
+
+private:
+    static constexpr unsigned n_units = 16; // guaranteed fragment units in gles 3.0, higher ones are passed through
+    static constexpr unsigned n_targets = 2; // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY
+    void activate_unit(unsigned unit);
+
+    const QOpenGLContext* m_context = nullptr;
+    std::unordered_set<const QOpenGLContext*> m_watched_contexts; // connected to aboutToBeDestroyed, removed when it fires
+    QOpenGLExtraFunctions* m_f = nullptr;
+    std::optional<GLuint> m_program;
+    std::optional<GLuint> m_framebuffer;
+    std::optional<glm::ivec4> m_viewport;
+    std::optional<unsigned> m_active_unit;
+    std::array<std::array<std::optional<GLuint>, n_targets>, n_units> m_textures;
+    std::array<std::optional<bool>, 4> m_capabilities;
+    std::optional<GLenum> m_depth_func;
+    std::optional<bool> m_depth_mask;
+    std::optional<GLenum> m_cull_face;
+    std::optional<std::pair<GLenum, GLenum>> m_blend_func;
+};
+
+} // namespace gl_engine
@@ -20,6 +20,7 @@
 
 #include "GpuAsyncQueryTimer.h"
 #include "QOpenGLContext"
+#include "nucleus/timing/TraceRecorder.h"
 
 namespace gl_engine {
 
@@ -30,6 +31,8 @@ GpuAsyncQueryTimer::GpuAsyncQueryTimer(const std::string& name, const std::strin
         m_qTmr[i] = new QOpenGLTimerQuery(QOpenGLContext::currentContext());
         m_qTmr[i]->create();
     }
+    m_calibration_query = new QOpenGLTimerQuery(QOpenGLContext::currentContext());
+    m_calibration_query->create();
     // Lets record a timestamp for the backbuffer such that we can fetch it and
     // don't have to implement special treatment for the first fetch
     m_qTmr[m_current_bb_offset]->recordTimestamp();
@@ -40,6 +43,7 @@ GpuAsyncQueryTimer::~GpuAsyncQueryTimer() {
     for (int i = 0; i < 4; i++) {
         delete m_qTmr[i];
     }
+    delete m_calibration_query;
 }
 
 void GpuAsyncQueryTimer::_start() {
@@ -56,8 +60,19 @@ float GpuAsyncQueryTimer::_fetch_result() {
         qWarning() << "A timer result is not available yet for timer" << m_name << ". The Thread will be blocked.";
     }
 #endif
-    GLuint64 elapsed_time = m_qTmr[m_current_bb_offset + 1]->waitForResult() - m_qTmr[m_current_bb_offset]->waitForResult();
+    const GLuint64 begin = m_qTmr[m_current_bb_offset]->waitForResult();
+    const GLuint64 end = m_qTmr[m_current_bb_offset + 1]->waitForResult();
+    GLuint64 elapsed_time = end - begin;
     std::swap(m_current_fb_offset, m_current_bb_offset);
+    auto& recorder = nucleus::timing::TraceRecorder::instance();
+    if (recorder.enabled()) {
+        using Clock = nucleus::timing::TraceRecorder::Clock;
+        // the gpu timestamps have an arbitrary origin, but count nanoseconds
+        const auto gpu_now = std::chrono::nanoseconds(int64_t(m_calibration_query->waitForTimestamp()));
+        const auto offset = Clock::now().time_since_epoch() - gpu_now;
+        const auto to_cpu_time = [offset](GLuint64 gpu_time) { return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(int64_t(gpu_time)) + offset)); };
+        recorder.record(m_name, m_group, to_cpu_time(begin), to_cpu_time(end), nucleus::timing::TraceRecorder::Track::Gpu);
+    }
     return elapsed_time / 1000000.0f;
 }
 
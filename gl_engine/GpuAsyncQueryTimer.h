@@ -31,6 +31,8 @@ namespace gl_engine {
 /// The AsyncQueryTimer class works with a front- and a
 /// back-queue to ensure no necessary waiting time for results.
 /// Fetching returns the values of the backbuffer (=> the previous frame)
+/// If the TraceRecorder is enabled, the fetched intervals are recorded on its gpu track, shifted into the cpu clock with
+/// the current gpu timestamp.
 class GpuAsyncQueryTimer : public nucleus::timing::TimerInterface {
 
 public:
@@ -50,6 +52,7 @@ private:
     QOpenGLTimerQuery* m_qTmr[4];
     int m_current_fb_offset = 0;
     int m_current_bb_offset = 2;
+    QOpenGLTimerQuery* m_calibration_query = nullptr; // current gpu time, to align the trace events with the cpu clock
 
 };
 
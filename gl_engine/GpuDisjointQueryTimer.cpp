@@ -0,0 +1,213 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "GpuDisjointQueryTimer.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+#include <QOpenGLContext>
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+namespace gl_engine {
+
+GpuDisjointQueryTimer::GpuDisjointQueryTimer(std::shared_ptr<Timeline> timeline, const std::string& name, const std::string& group, int queue_size, float average_weight)
+    : nucleus::timing::TimerInterface(name, group, queue_size, average_weight)
+    , m_timeline(std::move(timeline))
+{
+    assert(m_timeline);
+    m_index = m_timeline->add_timer();
+}
+
+std::shared_ptr<GpuDisjointQueryTimer::Timeline> GpuDisjointQueryTimer::make_timeline()
+{
+    auto* context = QOpenGLContext::currentContext();
+    if (!context || !context->isOpenGLES() || context->format().majorVersion() < 3)
+        return {};
+    // emscripten reports the webgl extension names with and without the GL_ prefix
+    const auto has_extension = context->hasExtension("GL_EXT_disjoint_timer_query") || context->hasExtension("GL_EXT_disjoint_timer_query_webgl2")
+        || context->hasExtension("EXT_disjoint_timer_query_webgl2");
+    if (!has_extension)
+        return {};
+    const auto get_query_object_ui64v = reinterpret_cast<Timeline::GetQueryObjectui64v>(context->getProcAddress("glGetQueryObjectui64vEXT"));
+    if (!get_query_object_ui64v)
+        return {};
+    return std::make_shared<Timeline>(context->extraFunctions(), get_query_object_ui64v);
+}
+
+void GpuDisjointQueryTimer::_start() { m_timeline->start(m_index); }
+
+void GpuDisjointQueryTimer::_stop() { m_timeline->stop(m_index); }
+
+float GpuDisjointQueryTimer::_fetch_result() { return m_timeline->take_result(m_index); }
+
+bool GpuDisjointQueryTimer::_result_available() { return m_timeline->poll(m_index); }
+
+GpuDisjointQueryTimer::Timeline::Timeline(QOpenGLExtraFunctions* f, GetQueryObjectui64v get_query_object_ui64v)
+    : m_f(f)
+    , m_get_query_object_ui64v(get_query_object_ui64v)
+{
+}
+
+GpuDisjointQueryTimer::Timeline::~Timeline()
+{
+    if (!QOpenGLContext::currentContext())
+        return; // the context is gone, and the queries with it
+    if (m_segment_open)
+        m_f->glEndQuery(GL_TIME_ELAPSED_EXT);
+    release(m_current);
+    for (auto& frame : m_in_flight)
+        release(frame);
+    if (!m_free_queries.empty())
+        m_f->glDeleteQueries(GLsizei(m_free_queries.size()), m_free_queries.data());
+}
+
+unsigned GpuDisjointQueryTimer::Timeline::add_timer()
+{
+    assert(m_results.size() < max_timers);
+    m_results.emplace_back();
+    return unsigned(m_results.size() - 1);
+}
+
+void GpuDisjointQueryTimer::Timeline::start(unsigned timer)
+{
+    if (std::find(m_stack.begin(), m_stack.end(), timer) != m_stack.end())
+        return;
+    end_segment();
+    m_stack.push_back(timer);
+    m_current.timers |= 1u << timer;
+    begin_segment();
+}
+
+void GpuDisjointQueryTimer::Timeline::stop(unsigned timer)
+{
+    const auto it = std::find(m_stack.begin(), m_stack.end(), timer);
+    if (it == m_stack.end())
+        return;
+    end_segment();
+    m_stack.erase(it);
+    if (!m_stack.empty()) {
+        begin_segment();
+        return;
+    }
+    // outermost timer stopped, the frame is complete
+    if (m_in_flight.size() >= max_frames_in_flight) {
+        // the driver is more than max_frames_in_flight behind, give up on the oldest instead of waiting for it
+        release(m_in_flight.front());
+        m_in_flight.pop_front();
+    }
+    m_in_flight.push_back(std::move(m_current));
+    m_current = {};
+}
+
+void GpuDisjointQueryTimer::Timeline::begin_segment()
+{
+    GLuint query = 0;
+    if (m_free_queries.empty()) {
+        m_f->glGenQueries(1, &query);
+    } else {
+        query = m_free_queries.back();
+        m_free_queries.pop_back();
+    }
+    uint32_t timers = 0;
+    for (const auto t : m_stack)
+        timers |= 1u << t;
+    m_f->glBeginQuery(GL_TIME_ELAPSED_EXT, query);
+    m_current.segments.push_back({ query, timers });
+    m_segment_open = true;
+}
+
+void GpuDisjointQueryTimer::Timeline::end_segment()
+{
+    if (!m_segment_open)
+        return;
+    m_f->glEndQuery(GL_TIME_ELAPSED_EXT);
+    m_segment_open = false;
+}
+
+void GpuDisjointQueryTimer::Timeline::release(Frame& frame)
+{
+    for (const auto& segment : frame.segments)
+        m_free_queries.push_back(segment.query);
+    frame.segments.clear();
+}
+
+bool GpuDisjointQueryTimer::Timeline::available(const Frame& frame) const
+{
+    for (const auto& segment : frame.segments) {
+        GLuint available = GL_FALSE;
+        m_f->glGetQueryObjectuiv(segment.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+    }
+    return true;
+}
+
+bool GpuDisjointQueryTimer::Timeline::poll(unsigned timer)
+{
+    GLint disjoint = GL_FALSE;
+    m_f->glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint); // reading resets the flag
+    if (disjoint) {
+        // the results of all queries that were in flight during the event are undefined
+        for (auto& frame : m_in_flight)
+            release(frame);
+        m_in_flight.clear();
+    }
+    while (!m_in_flight.empty() && available(m_in_flight.front())) {
+        auto& frame = m_in_flight.front();
+        std::array<GLuint64, max_timers> elapsed = {};
+        for (const auto& segment : frame.segments) {
+            GLuint64 nsecs = 0;
+            m_get_query_object_ui64v(segment.query, GL_QUERY_RESULT, &nsecs);
+            for (unsigned t = 0; t < m_results.size(); ++t) {
+                if (segment.timers & (1u << t))
+                    elapsed[t] += nsecs;
+            }
+        }
+        for (unsigned t = 0; t < m_results.size(); ++t) {
+            if (!(frame.timers & (1u << t)))
+                continue;
+            auto& results = m_results[t];
+            if (results.size() >= max_frames_in_flight)
+                results.pop_front(); // not fetched (e.g., the timer didn't run again), keep the latest ones
+            results.push_back(float(elapsed[t]) / 1000000.0f);
+        }
+        release(frame);
+        m_in_flight.pop_front();
+    }
+    return !m_results[timer].empty();
+}
+
+float GpuDisjointQueryTimer::Timeline::take_result(unsigned timer)
+{
+    auto& results = m_results[timer];
+    if (results.empty())
+        return 0;
+    const auto msecs = results.front();
+    results.pop_front();
+    return msecs;
+}
+
+} // namespace gl_engine
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <QOpenGLExtraFunctions>
+
+#include "nucleus/timing/TimerInterface.h"
+
+namespace gl_engine {
+
+/// Gpu timer for OpenGL ES and WebGL 2 (EXT_disjoint_timer_query, EXT_disjoint_timer_query_webgl2), where
+/// QOpenGLTimerQuery is not available.
+/// Timestamp queries are often missing there (e.g., disabled in browsers), so it measures with TIME_ELAPSED queries, of
+/// which only one can be active at a time. Therefore, all timers of a context share a Timeline: a nested timer splits the
+/// query of the enclosing one into segments, and every segment counts for all timers that were running during it.
+/// The segments between the outermost start and stop form a frame. Up to max_frames_in_flight frames are read back
+/// later, when their results are available, so fetching never stalls (the results lag a few frames). A disjoint event
+/// (e.g., a gpu frequency change) invalidates the frames in flight, they are dropped.
+class GpuDisjointQueryTimer : public nucleus::timing::TimerInterface {
+public:
+    class Timeline;
+
+    GpuDisjointQueryTimer(std::shared_ptr<Timeline> timeline, const std::string& name, const std::string& group, int queue_size, float average_weight);
+
+    // nullptr if the extension is not available. needs a current context.
+    static std::shared_ptr<Timeline> make_timeline();
+
+protected:
+    void _start() override;
+    void _stop() override;
+    float _fetch_result() override;
+    bool _result_available() override;
+
+private:
+    std::shared_ptr<Timeline> m_timeline;
+    unsigned m_index = 0;
+};
+
+class GpuDisjointQueryTimer::Timeline {
+public:
+    static constexpr unsigned max_timers = 32;
+    static constexpr unsigned max_frames_in_flight = 6;
+    using GetQueryObjectui64v = void(QOPENGLF_APIENTRYP)(GLuint id, GLenum pname, GLuint64* params);
+
+    Timeline(QOpenGLExtraFunctions* f, GetQueryObjectui64v get_query_object_ui64v);
+    ~Timeline();
+    Timeline(const Timeline&) = delete;
+    Timeline& operator=(const Timeline&) = delete;
+
+    unsigned add_timer();
+    void start(unsigned timer);
+    void stop(unsigned timer);
+    // reads back the finished frames, returns true if a result of the timer is ready
+    bool poll(unsigned timer);
+    float take_result(unsigned timer); // msecs
+
+private:
+    struct Segment {
+        GLuint query = 0;
+        uint32_t timers = 0; // bit mask of the timers running during the segment
+    };
+    struct Frame {
+        std::vector<Segment> segments;
+        uint32_t timers = 0; // all timers that ran in the frame
+    };
+    void begin_segment();
+    void end_segment();
+    void release(Frame& frame);
+    [[nodiscard]] bool available(const Frame& frame) const;
+
+    QOpenGLExtraFunctions* m_f;
+    GetQueryObjectui64v m_get_query_object_ui64v;
+    std::vector<GLuint> m_free_queries;
+    std::vector<unsigned> m_stack; // running timers, outermost first
+    bool m_segment_open = false;
+    Frame m_current;
+    std::deque<Frame> m_in_flight;
+    std::vector<std::deque<float>> m_results; // per timer, msecs
+};
+
+} // namespace gl_engine
@@ -0,0 +1,154 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "GpuMemory.h"
+
+#include <atomic>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+namespace {
+constexpr GLenum GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX = 0x9048;
+constexpr GLenum GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX = 0x9049;
+constexpr GLenum TEXTURE_FREE_MEMORY_ATI = 0x87FC;
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, gl_engine::gpu_memory::SubsystemUsage> subsystems;
+    std::atomic<uint64_t> version = 0;
+};
+
+Registry& registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+// n_allocations_delta is +1 for a new entry, -1 for a removed one
+void update(const std::string& subsystem, uint64_t old_n_bytes, uint64_t new_n_bytes, int n_allocations_delta)
+{
+    if (subsystem.empty())
+        return;
+    auto& r = registry();
+    {
+        std::scoped_lock lock(r.mutex);
+        auto& entry = r.subsystems[subsystem];
+        entry.subsystem = subsystem;
+        assert(entry.n_bytes >= old_n_bytes);
+        entry.n_bytes = entry.n_bytes - old_n_bytes + new_n_bytes;
+        entry.n_allocations = unsigned(int(entry.n_allocations) + n_allocations_delta);
+        if (entry.n_allocations == 0)
+            r.subsystems.erase(subsystem);
+    }
+    ++r.version;
+}
+} // namespace
+
+namespace gl_engine::gpu_memory {
+
+std::vector<SubsystemUsage> usage()
+{
+    auto& r = registry();
+    std::scoped_lock lock(r.mutex);
+    std::vector<SubsystemUsage> result;
+    result.reserve(r.subsystems.size());
+    for (const auto& [name, entry] : r.subsystems)
+        result.push_back(entry);
+    return result;
+}
+
+uint64_t total_bytes()
+{
+    auto& r = registry();
+    std::scoped_lock lock(r.mutex);
+    uint64_t sum = 0;
+    for (const auto& [name, entry] : r.subsystems)
+        sum += entry.n_bytes;
+    return sum;
+}
+
+uint64_t version() { return registry().version; }
+
+std::optional<DriverInfo> driver_info()
+{
+    auto* context = QOpenGLContext::currentContext();
+    if (!context || context->isOpenGLES())
+        return {};
+    auto* f = context->functions();
+    if (context->hasExtension("GL_NVX_gpu_memory_info")) {
+        GLint total_kb = 0;
+        GLint available_kb = 0;
+        f->glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total_kb);
+        f->glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available_kb);
+        return DriverInfo { uint64_t(available_kb) * 1024, uint64_t(total_kb) * 1024 };
+    }
+    if (context->hasExtension("GL_ATI_meminfo")) {
+        GLint free_kb[4] = {}; // total free, largest free block, total auxiliary free, largest auxiliary free block
+        f->glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, free_kb);
+        return DriverInfo { uint64_t(free_kb[0]) * 1024, {} };
+    }
+    return {};
+}
+
+Allocation::Allocation(std::string subsystem)
+    : m_subsystem(std::move(subsystem))
+{
+    assert(!m_subsystem.empty());
+    update(m_subsystem, 0, 0, +1);
+}
+
+Allocation::Allocation(Allocation&& other) noexcept
+    : m_subsystem(std::exchange(other.m_subsystem, {}))
+    , m_n_bytes(std::exchange(other.m_n_bytes, 0))
+{
+}
+
+Allocation& Allocation::operator=(Allocation&& other) noexcept
+{
+    if (this != &other) {
+        update(m_subsystem, m_n_bytes, 0, -1);
+        m_subsystem = std::exchange(other.m_subsystem, {});
+        m_n_bytes = std::exchange(other.m_n_bytes, 0);
+    }
+    return *this;
+}
+
+Allocation::~Allocation() { update(m_subsystem, m_n_bytes, 0, -1); }
+
+void Allocation::set_subsystem(std::string subsystem)
+{
+    assert(!subsystem.empty());
+    if (subsystem == m_subsystem)
+        return;
+    update(m_subsystem, m_n_bytes, 0, -1);
+    m_subsystem = std::move(subsystem);
+    update(m_subsystem, 0, m_n_bytes, +1);
+}
+
+void Allocation::set_n_bytes(uint64_t n_bytes)
+{
+    update(m_subsystem, m_n_bytes, n_bytes, 0);
+    m_n_bytes = n_bytes;
+}
+
+} // namespace gl_engine::gpu_memory
@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gl_engine::gpu_memory {
+
+/// Bookkeeping of the gpu memory allocated by Texture, Framebuffer, UniformBuffer and StagingRing, per subsystem.
+/// The sizes are estimates of our own allocations (no padding or driver overhead), the driver side view is in driver_info().
+/// Thread safe, allocations may be reported from the upload thread.
+struct SubsystemUsage {
+    std::string subsystem;
+    uint64_t n_bytes = 0;
+    unsigned n_allocations = 0;
+};
+
+/// sorted by subsystem
+[[nodiscard]] std::vector<SubsystemUsage> usage();
+[[nodiscard]] uint64_t total_bytes();
+/// incremented with every change, for polling
+[[nodiscard]] uint64_t version();
+
+struct DriverInfo {
+    uint64_t available_bytes = 0;
+    std::optional<uint64_t> total_bytes; // only with GL_NVX_gpu_memory_info
+};
+/// GL_NVX_gpu_memory_info or GL_ATI_meminfo (texture pool), with the context current. nullopt if neither is available
+/// (always on gles and webgl).
+[[nodiscard]] std::optional<DriverInfo> driver_info();
+
+/// An entry in the registry, owned by the object that allocates the memory. Move only.
+class Allocation {
+public:
+    explicit Allocation(std::string subsystem);
+    Allocation(const Allocation&) = delete;
+    Allocation& operator=(const Allocation&) = delete;
+    Allocation(Allocation&& other) noexcept;
+    Allocation& operator=(Allocation&& other) noexcept;
+    ~Allocation();
+
+    void set_subsystem(std::string subsystem);
+    void set_n_bytes(uint64_t n_bytes);
+    [[nodiscard]] uint64_t n_bytes() const { return m_n_bytes; }
+    [[nodiscard]] const std::string& subsystem() const { return m_subsystem; }
+
+private:
+    std::string m_subsystem; // empty after moving out
+    uint64_t m_n_bytes = 0;
+};
+
+} // namespace gl_engine::gpu_memory
@@ -0,0 +1,188 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "GpuTileCuller.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLVertexArrayObject>
+
+#include "ShaderProgram.h"
+#include "nucleus/tile_scheduler/utils.h"
+
+namespace gl_engine {
+
+GpuTileCuller::GpuTileCuller(float margin)
+    : m_margin(margin)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    m_program = std::make_unique<ShaderProgram>("tile_cull.vert", "tile_cull.frag", std::vector<std::string> { "visibility" });
+    m_uniforms.frustum_planes = m_program->uniform<glm::vec4>("frustum_planes[0]");
+    m_uniforms.n_views = m_program->uniform<int>("n_views");
+    m_uniforms.camera_position = m_program->uniform<glm::vec3>("camera_position");
+    m_uniforms.margin = m_program->uniform<float>("margin");
+    m_vao = std::make_unique<QOpenGLVertexArrayObject>();
+    m_vao->create();
+    m_box_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
+    m_box_buffer->create();
+    m_box_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+
+    m_vao->bind();
+    m_box_buffer->bind();
+    const auto min_location = m_program->attribute_location("box_min");
+    const auto max_location = m_program->attribute_location("box_max");
+    for (const auto& [location, offset] : { std::pair { min_location, size_t(0) }, std::pair { max_location, sizeof(glm::vec3) } }) {
+        if (location == -1)
+            continue;
+        f->glEnableVertexAttribArray(GLuint(location));
+        f->glVertexAttribPointer(GLuint(location), 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), reinterpret_cast<const void*>(offset));
+    }
+    m_vao->release();
+    m_box_buffer->release();
+
+    for (auto& slot : m_slots)
+        f->glGenBuffers(1, &slot.buffer);
+}
+
+GpuTileCuller::~GpuTileCuller()
+{
+    if (!QOpenGLContext::currentContext()) // can happen during shutdown
+        return;
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (auto& slot : m_slots) {
+        if (slot.fence)
+            f->glDeleteSync(GLsync(slot.fence));
+        f->glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+bool GpuTileCuller::needs_boxes(uint64_t boxes_version, const glm::dvec3& camera_position) const
+{
+    return !m_has_boxes || boxes_version != m_boxes_version || glm::distance(camera_position, m_origin) > rebase_distance;
+}
+
+void GpuTileCuller::set_boxes(std::span<const tile::SrsAndHeightBounds> boxes, uint64_t boxes_version, const glm::dvec3& camera_position)
+{
+    std::vector<glm::vec3> data;
+    data.reserve(boxes.size() * 2);
+    for (const auto& box : boxes) {
+        data.emplace_back(box.min - camera_position);
+        data.emplace_back(box.max - camera_position);
+    }
+    m_box_buffer->bind();
+    m_box_buffer->allocate(data.data(), int(data.size() * sizeof(glm::vec3)));
+    m_box_buffer->release();
+    m_n_boxes = unsigned(boxes.size());
+    m_boxes_version = boxes_version;
+    m_origin = camera_position;
+    m_has_boxes = true;
+}
+
+void GpuTileCuller::collect()
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    // oldest first, so that m_result ends up with the newest finished test
+    for (unsigned i = 0; i < ring_size; ++i) {
+        auto& slot = m_slots[(m_next_slot + i) % ring_size];
+        if (!slot.fence)
+            continue;
+        const auto status = f->glClientWaitSync(GLsync(slot.fence), 0, 0); // don't wait
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        f->glDeleteSync(GLsync(slot.fence));
+        slot.fence = nullptr;
+
+        const auto n_bytes = GLsizeiptr(slot.n_boxes * sizeof(uint32_t));
+        f->glBindBuffer(GL_COPY_READ_BUFFER, slot.buffer);
+        const auto* mapped = n_bytes ? f->glMapBufferRange(GL_COPY_READ_BUFFER, 0, n_bytes, GL_MAP_READ_BIT) : nullptr;
+        if (mapped || n_bytes == 0) {
+            m_result.masks.resize(slot.n_boxes);
+            if (mapped) {
+                std::memcpy(m_result.masks.data(), mapped, size_t(n_bytes));
+                f->glUnmapBuffer(GL_COPY_READ_BUFFER);
+            }
+            m_result.boxes_version = slot.boxes_version;
+            m_result.n_views = slot.n_views;
+            ++m_result_version;
+        }
+        f->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+}
+
+bool GpuTileCuller::start_cull(std::span<const nucleus::camera::Frustum> frusta, const glm::dvec3& camera_position)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    collect();
+
+    auto& slot = m_slots[m_next_slot];
+    if (slot.fence || !m_has_boxes) // gpu is more than ring_size frames behind, skip this frame
+        return false;
+
+    const auto n_views = unsigned(std::min(frusta.size(), size_t(max_views)));
+    m_planes.assign(max_views * 6, glm::vec4(0.0f));
+    for (unsigned view = 0; view < n_views; ++view) {
+        const auto planes = nucleus::tile_scheduler::utils::relative_frustum_planes(frusta[view], m_origin);
+        for (unsigned i = 0; i < 6; ++i)
+            m_planes[view * 6 + i] = glm::vec4(planes.normals[i], planes.offsets[i]);
+    }
+
+    if (slot.capacity < std::max(m_n_boxes, 1u)) {
+        slot.capacity = std::max(m_n_boxes, 1u);
+        f->glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, slot.buffer);
+        f->glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, GLsizeiptr(slot.capacity * sizeof(uint32_t)), nullptr, GL_STREAM_READ);
+        f->glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    }
+
+    m_program->bind();
+    m_program->set_uniform_array(m_uniforms.frustum_planes, m_planes);
+    m_program->set_uniform(m_uniforms.n_views, int(n_views));
+    m_program->set_uniform(m_uniforms.camera_position, glm::vec3(camera_position - m_origin));
+    m_program->set_uniform(m_uniforms.margin, m_margin);
+    m_vao->bind();
+    f->glEnable(GL_RASTERIZER_DISCARD);
+    f->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, slot.buffer);
+    f->glBeginTransformFeedback(GL_POINTS);
+    f->glDrawArrays(GL_POINTS, 0, GLsizei(m_n_boxes));
+    f->glEndTransformFeedback();
+    f->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    f->glDisable(GL_RASTERIZER_DISCARD);
+    m_vao->release();
+    m_program->release();
+
+    slot.fence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.n_boxes = m_n_boxes;
+    slot.boxes_version = m_boxes_version;
+    slot.n_views = n_views;
+    m_next_slot = (m_next_slot + 1) % ring_size;
+    return true;
+}
+
+const GpuTileCuller::Result& GpuTileCuller::result() const { return m_result; }
+
+uint64_t GpuTileCuller::result_version() const { return m_result_version; }
+
+bool GpuTileCuller::in_flight() const
+{
+    return std::any_of(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.fence != nullptr; });
+}
+
+} // namespace gl_engine
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+#include "nucleus/camera/Definition.h"
+#include "radix/tile.h"
+
+class QOpenGLBuffer;
+class QOpenGLVertexArrayObject;
+
+namespace gl_engine {
+
+/// Frustum culling of the resident tiles on the gpu, for the camera and the shadow cascades at once. The boxes are uploaded only
+/// when they change (relative to an origin near the camera, so that float is precise enough). A vertex shader tests them against
+/// up to max_views frusta and writes one visibility mask per box with transform feedback (bit v for frustum v).
+/// GLES 3.0 has neither compute nor geometry shaders, so the masks are not compacted on the gpu, and drawing stays with the
+/// batched instanced draws of TileManager.
+/// Like DepthReadback, the masks are read back from a ring of buffers without stalling, i.e., they are a frame or more old. The
+/// boxes are grown by margin times their distance to the camera, so that tiles coming into view are drawn in time while the
+/// camera turns by up to about margin radians per frame. Needs glMapBufferRange and fences, i.e., it is not available on WebGL.
+class GpuTileCuller {
+public:
+    static constexpr unsigned ring_size = 3;
+    static constexpr unsigned max_views = 8; // MAX_VIEWS in tile_cull.vert
+    static constexpr double rebase_distance = 10'000; // the boxes are uploaded again if the camera is further from their origin
+
+    struct Result {
+        std::vector<uint32_t> masks; // per box, in the order of set_boxes
+        uint64_t boxes_version = 0;
+        unsigned n_views = 0;
+    };
+
+    explicit GpuTileCuller(float margin = 0.05f);
+    ~GpuTileCuller();
+
+    // whether set_boxes must be called before the next start_cull
+    [[nodiscard]] bool needs_boxes(uint64_t boxes_version, const glm::dvec3& camera_position) const;
+    // boxes_version identifies the boxes (and their order), it is handed out with the result
+    void set_boxes(std::span<const tile::SrsAndHeightBounds> boxes, uint64_t boxes_version, const glm::dvec3& camera_position);
+    // collects finished tests and queues a new one, false if that was skipped (the gpu is ring_size tests behind, or there are no
+    // boxes). frusta beyond max_views are ignored.
+    bool start_cull(std::span<const nucleus::camera::Frustum> frusta, const glm::dvec3& camera_position);
+
+    // picks up the finished tests without queuing a new one
+    void collect();
+    // the newest finished test, masks are empty if none finished yet
+    [[nodiscard]] const Result& result() const;
+    // incremented whenever result() changed
+    [[nodiscard]] uint64_t result_version() const;
+    // tests that weren't collected yet
+    [[nodiscard]] bool in_flight() const;
+
+private:
+    struct Slot {
+        unsigned buffer = 0;
+        void* fence = nullptr; // GLsync, nullptr if not in flight
+        unsigned capacity = 0; // in boxes
+        unsigned n_boxes = 0;
+        uint64_t boxes_version = 0;
+        unsigned n_views = 0;
+    };
+
+    float m_margin;
+    std::unique_ptr<ShaderProgram> m_program;
+    struct {
+        ShaderProgram::Uniform<glm::vec4> frustum_planes;
+        ShaderProgram::Uniform<int> n_views;
+        ShaderProgram::Uniform<glm::vec3> camera_position;
+        ShaderProgram::Uniform<float> margin;
+    } m_uniforms;
+    std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
+    std::unique_ptr<QOpenGLBuffer> m_box_buffer;
+    unsigned m_n_boxes = 0;
+    uint64_t m_boxes_version = 0;
+    bool m_has_boxes = false;
+    glm::dvec3 m_origin = glm::dvec3(0.0);
+    std::array<Slot, ring_size> m_slots;
+    unsigned m_next_slot = 0;
+    std::vector<glm::vec4> m_planes; // scratch
+    Result m_result;
+    uint64_t m_result_version = 0;
+};
+
+} // namespace gl_engine
@@ -24,16 +24,32 @@
 #include <GLES3/gl3.h>
 #endif
 
+#include <algorithm>
+#include <iterator>
+
+#include "GlCounters.h"
+#include "GlState.h"
 #include "ShaderProgram.h"
 #include "nucleus/map_label/MapLabel.h"
+#include "nucleus/timing/StartupTimeline.h"
 
 namespace gl_engine {
 
 MapLabelManager::MapLabelManager()
+    : m_pending_labels(nucleus::timing::startup_async("font atlas", []() { return std::make_unique<nucleus::MapLabelManager>(); }))
+{
+}
+
+nucleus::MapLabelManager& MapLabelManager::labels()
 {
+    if (!m_mapLabelManager)
+        m_mapLabelManager = m_pending_labels.get();
+    return *m_mapLabelManager;
 }
+
 void MapLabelManager::init()
 {
+    const nucleus::timing::StartupScope startup_scope("label manager");
     m_vao = std::make_unique<QOpenGLVertexArrayObject>();
     m_vao->create();
     m_vao->bind();
@@ -42,20 +58,19 @@ void MapLabelManager::init()
     m_index_buffer->create();
     m_index_buffer->bind();
     m_index_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
-    m_index_buffer->allocate(m_mapLabelManager.indices().data(), m_mapLabelManager.indices().size() * sizeof(unsigned int));
+    m_index_buffer->allocate(labels().indices().data(), labels().indices().size() * sizeof(unsigned int));
 
     m_vertex_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
     m_vertex_buffer->create();
     m_vertex_buffer->bind();
-    m_vertex_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
-
-    std::vector<nucleus::MapLabel::VertexData> allLabels;
-    for (const auto& label : m_mapLabelManager.labels()) {
-        allLabels.insert(allLabels.end(), label.vertex_data().begin(), label.vertex_data().end());
-    }
+    m_vertex_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
 
-    m_vertex_buffer->allocate(allLabels.data(), allLabels.size() * sizeof(nucleus::MapLabel::VertexData));
-    m_instance_count = allLabels.size();
+    // the buffer is filled with the visible labels in update and grows on demand
+    m_instance_capacity = 0;
+    m_resident_changed = true;
+    m_visible_labels.clear();
+    m_culled_for.reset();
+    m_instance_count = 0;
 
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
 
@@ -79,46 +94,119 @@ void MapLabelManager::init()
     m_vao->release();
 
     // load the font texture
-    const auto& font_atlas = m_mapLabelManager.font_atlas();
-    m_font_texture = std::make_unique<Texture>(Texture::Target::_2d, Texture::Format::RG8);
+    const auto& font_atlas = labels().font_atlas();
+    m_font_texture = std::make_unique<Texture>(Texture::Target::_2d, Texture::Format::R8);
     m_font_texture->setParams(Texture::Filter::MipMapLinear, Texture::Filter::Linear);
+    m_font_texture->set_memory_subsystem("labels");
     m_font_texture->upload(font_atlas);
 
     // load the icon texture
-    QImage icon = m_mapLabelManager.icon();
+    QImage icon = labels().icon();
     m_icon_texture = std::make_unique<QOpenGLTexture>(icon);
     m_icon_texture->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
     m_icon_texture->setMagnificationFilter(QOpenGLTexture::Linear);
 }
 
+void MapLabelManager::update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads)
+{
+    for (const auto& id : deleted_quads)
+        m_resident_changed |= m_quad_labels.erase(id) > 0;
+    for (const auto& quad : new_quads) {
+        std::vector<nucleus::MapLabel> labels;
+        for (const auto& tile : quad.tiles) {
+            if (!tile.labels)
+                continue;
+            auto tile_labels = labels().create_labels(*tile.labels);
+            std::move(tile_labels.begin(), tile_labels.end(), std::back_inserter(labels));
+        }
+        if (labels.empty() && !m_quad_labels.contains(quad.id))
+            continue;
+        m_quad_labels[quad.id] = std::move(labels);
+        m_resident_changed = true;
+    }
+}
+
+void MapLabelManager::clear_streamed_labels()
+{
+    m_resident_changed |= !m_quad_labels.empty();
+    m_quad_labels.clear();
+}
+
+void MapLabelManager::collect_resident_labels()
+{
+    m_resident_labels.clear();
+    m_candidates.clear();
+    const auto add = [this](const nucleus::MapLabel& label) {
+        m_resident_labels.push_back(&label);
+        m_candidates.push_back({ label.world_position(), label.importance(), label.extent_min(), label.extent_max() });
+    };
+    for (const auto& label : labels().labels())
+        add(label);
+    for (const auto& [id, labels] : m_quad_labels) {
+        for (const auto& label : labels)
+            add(label);
+    }
+    // the indices of the visible labels refer to the old list
+    m_visible_labels.clear();
+    m_culled_for.reset();
+    m_instance_count = 0;
+    m_resident_changed = false;
+}
+
+void MapLabelManager::update(const nucleus::camera::Definition& camera)
+{
+    if (m_resident_changed)
+        collect_resident_labels();
+    if (m_culled_for && *m_culled_for == camera)
+        return;
+    m_culled_for = camera;
+
+    auto visible = nucleus::label_culling::visible_labels(m_candidates, camera);
+    if (visible == m_visible_labels)
+        return;
+    m_visible_labels = std::move(visible);
+
+    m_instances.clear();
+    for (const auto index : m_visible_labels)
+        m_instances.insert(m_instances.end(), m_resident_labels[index]->vertex_data().begin(), m_resident_labels[index]->vertex_data().end());
+    m_vertex_buffer->bind();
+    if (m_instances.size() > m_instance_capacity) {
+        m_instance_capacity = std::max(m_instances.size(), m_instance_capacity * 2);
+        m_vertex_buffer->allocate(int(m_instance_capacity * sizeof(nucleus::MapLabel::VertexData)));
+    }
+    m_vertex_buffer->write(0, m_instances.data(), int(m_instances.size() * sizeof(nucleus::MapLabel::VertexData)));
+    GlCounters::current().count_buffer_write(m_instances.size() * sizeof(nucleus::MapLabel::VertexData));
+    m_vertex_buffer->release();
+    m_instance_count = m_instances.size();
+}
+
 void MapLabelManager::draw(Framebuffer* gbuffer, ShaderProgram* shader_program, const nucleus::camera::Definition& camera) const
 {
+    if (m_instance_count == 0)
+        return;
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
 
-    f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    f->glEnable(GL_BLEND);
+    auto& state = GlState::current();
+    state.set_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.set_enabled(GL_BLEND, true);
 
     glm::mat4 inv_view_rot = glm::inverse(camera.local_view_matrix());
     shader_program->set_uniform("inv_view_rot", inv_view_rot);
     shader_program->set_uniform("label_dist_scaling", true);
 
-    shader_program->set_uniform("texin_depth", 0);
     gbuffer->bind_colour_texture(1, 0);
 
-    shader_program->set_uniform("font_sampler", 1);
     m_font_texture->bind(1);
+    shader_program->set_uniform("sdf_edge", nucleus::MapLabelManager::sdf_edge);
+    shader_program->set_uniform("sdf_outline_edge", nucleus::MapLabelManager::sdf_outline_edge);
 
-    shader_program->set_uniform("icon_sampler", 2);
-    m_icon_texture->bind(2);
+    state.bind_texture(2, GL_TEXTURE_2D, m_icon_texture->textureId());
 
     m_vao->bind();
 
-    // if the labels wouldn't collide, we could use an extra buffer, one draw call and
-    // f->glBlendEquationSeparate(GL_MIN, GL_MAX);
-    shader_program->set_uniform("drawing_outline", true);
-    f->glDrawElementsInstanced(GL_TRIANGLES, m_mapLabelManager.indices().size(), GL_UNSIGNED_INT, 0, m_instance_count);
-    shader_program->set_uniform("drawing_outline", false);
-    f->glDrawElementsInstanced(GL_TRIANGLES, m_mapLabelManager.indices().size(), GL_UNSIGNED_INT, 0, m_instance_count);
+    // outline and fill come from the same distance field, one draw
+    f->glDrawElementsInstanced(GL_TRIANGLES, m_mapLabelManager->indices().size(), GL_UNSIGNED_INT, 0, m_instance_count);
+    GlCounters::current().count_draw(m_mapLabelManager->indices().size(), m_instance_count);
 
     m_vao->release();
 }
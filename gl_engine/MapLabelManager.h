@@ -18,6 +18,12 @@
 
 #pragma once
 
+#include <future>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
 #include <QOpenGLBuffer>
 #include <QOpenGLTexture>
 #include <QOpenGLVertexArrayObject>
@@ -26,6 +32,8 @@
 #include "Texture.h"
 #include "nucleus/camera/Definition.h"
 #include "nucleus/map_label/MapLabelManager.h"
+#include "nucleus/map_label/label_culling.h"
+#include "nucleus/tile_scheduler/tile_types.h"
 
 namespace camera {
 class Definition;
@@ -40,6 +48,11 @@ public:
     explicit MapLabelManager();
 
     void init();
+    // label tiles are streamed with the gpu quads (see Window::update_gpu_quads), the labels of all resident quads are drawn
+    void update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads);
+    void clear_streamed_labels();
+    // culls and declutters the labels (nucleus::label_culling). the instance buffer is only rewritten if the visible set changed.
+    void update(const nucleus::camera::Definition& camera);
     void draw(Framebuffer* gbuffer, ShaderProgram* shader_program, const nucleus::camera::Definition& camera) const;
 
 private:
@@ -50,7 +63,20 @@ private:
     std::unique_ptr<QOpenGLBuffer> m_index_buffer;
     std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
     
-    nucleus::MapLabelManager m_mapLabelManager;
-    unsigned long m_instance_count;
+    void collect_resident_labels();
+    nucleus::MapLabelManager& labels(); // waits for the construction
+
+    // constructed in the background (font atlas, built in labels), the gpu initialisation goes on meanwhile
+    std::future<std::unique_ptr<nucleus::MapLabelManager>> m_pending_labels;
+    std::unique_ptr<nucleus::MapLabelManager> m_mapLabelManager;
+    std::unordered_map<tile::Id, std::vector<nucleus::MapLabel>, tile::Id::Hasher> m_quad_labels; // by quad id, quads without labels are omitted
+    bool m_resident_changed = true;
+    std::vector<const nucleus::MapLabel*> m_resident_labels; // built in and streamed labels
+    std::vector<nucleus::label_culling::Candidate> m_candidates; // same order as m_resident_labels
+    std::vector<unsigned> m_visible_labels;
+    std::vector<nucleus::MapLabel::VertexData> m_instances; // of the visible labels, reused
+    std::optional<nucleus::camera::Definition> m_culled_for;
+    unsigned long m_instance_count = 0;
+    size_t m_instance_capacity = 0; // of m_vertex_buffer, grows with the visible labels
 };
 } // namespace gl_engine
@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace gl_engine {
+
+namespace {
+    bool same_formats(const RenderTargetDescription& a, const RenderTargetDescription& b)
+    {
+        return a.depth_format == b.depth_format && a.colour_formats == b.colour_formats && a.exact_size == b.exact_size;
+    }
+} // namespace
+
+RenderTargetPool::RenderTargetPool(std::string memory_subsystem)
+    : m_memory_subsystem(std::move(memory_subsystem))
+{
+}
+
+RenderTargetPool::~RenderTargetPool() = default;
+
+Framebuffer* RenderTargetPool::acquire(const RenderTargetDescription& description)
+{
+    const auto size = glm::max(description.size, glm::uvec2(1));
+    const auto fits = [&](const Entry& e) {
+        return e.description.exact_size ? e.description.size == size : glm::all(glm::greaterThanEqual(e.description.size, size));
+    };
+    const auto area = [](const Entry& e) { return uint64_t(e.description.size.x) * e.description.size.y; };
+    // the smallest free target that fits. otherwise the largest free one is grown, that one is the cheapest to keep around.
+    Entry* fitting = nullptr;
+    Entry* growable = nullptr;
+    for (auto& e : m_entries) {
+        if (e.acquired || !same_formats(e.description, description))
+            continue;
+        if (fits(e) && (!fitting || area(e) < area(*fitting)))
+            fitting = &e;
+        if (!fits(e) && (!growable || area(e) > area(*growable)))
+            growable = &e;
+    }
+    Entry* entry = fitting ? fitting : growable;
+
+    if (!entry) {
+        auto& e = m_entries.emplace_back();
+        e.description = description;
+        e.description.size = size;
+        e.framebuffer = std::make_unique<Framebuffer>(description.depth_format, description.colour_formats, size);
+        e.framebuffer->set_memory_subsystem(m_memory_subsystem);
+        e.oversized_since_frame = m_frame;
+        ++m_n_allocations;
+        entry = &e;
+    } else if (!fits(*entry)) {
+        const auto new_size = entry->description.exact_size ? size : glm::max(entry->description.size, size);
+        entry->description.size = new_size;
+        entry->framebuffer->resize(new_size);
+        entry->oversized_since_frame = m_frame;
+        ++m_n_allocations;
+    } else if (entry->description.size == size) {
+        entry->oversized_since_frame = m_frame;
+    } else if (m_frame - entry->oversized_since_frame >= m_trim_after_frames) {
+        // the window was made smaller a while ago, give the memory back
+        entry->description.size = size;
+        entry->framebuffer->resize(size);
+        entry->oversized_since_frame = m_frame;
+        ++m_n_allocations;
+    }
+    entry->acquired = true;
+    entry->last_used_frame = m_frame;
+    return entry->framebuffer.get();
+}
+
+void RenderTargetPool::release(Framebuffer* target)
+{
+    const auto entry = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) { return e.framebuffer.get() == target; });
+    assert(entry != m_entries.end());
+    assert(entry->acquired);
+    if (entry != m_entries.end())
+        entry->acquired = false;
+}
+
+void RenderTargetPool::end_frame()
+{
+    for (auto& e : m_entries)
+        e.acquired = false;
+    std::erase_if(m_entries, [&](const Entry& e) { return m_frame - e.last_used_frame >= m_trim_after_frames; });
+    ++m_frame;
+}
+
+size_t RenderTargetPool::n_acquired() const
+{
+    return size_t(std::count_if(m_entries.begin(), m_entries.end(), [](const Entry& e) { return e.acquired; }));
+}
+
+} // namespace gl_engine
@@ -0,0 +1,80 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Framebuffer.h"
+
+namespace gl_engine {
+
+struct RenderTargetDescription {
+    Framebuffer::DepthFormat depth_format = Framebuffer::DepthFormat::None;
+    std::vector<Framebuffer::ColourFormat> colour_formats;
+    glm::uvec2 size = { 4, 4 };
+    // full screen passes, that sample their inputs with normalised coordinates, work on a larger target as well.
+    // such targets only grow (see RenderTargetPool), exact targets are reallocated whenever the size changes.
+    bool exact_size = false;
+};
+
+/// Hands out transient framebuffers per pass. A target is acquired for a pass and released once its content was consumed,
+/// after that it can be handed to a later pass with the same formats (aliasing within a frame). Everything still acquired
+/// is released in end_frame(), so targets are reused across frames as well.
+/// Non exact targets only grow, i.e., interactively resizing the window doesn't reallocate every frame. They are shrunk
+/// to the requested size after they were oversized for trim_after_frames() frames, and targets that were not acquired for
+/// that many frames are deleted (e.g. after switching off ssao). Requires a current gl context.
+class RenderTargetPool {
+public:
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+    explicit RenderTargetPool(std::string memory_subsystem = "transient targets");
+    ~RenderTargetPool();
+
+    /// valid until release() or end_frame()
+    [[nodiscard]] Framebuffer* acquire(const RenderTargetDescription& description);
+    void release(Framebuffer* target);
+    void end_frame();
+
+    void set_trim_after_frames(unsigned n_frames) { m_trim_after_frames = n_frames; }
+    [[nodiscard]] unsigned trim_after_frames() const { return m_trim_after_frames; }
+    [[nodiscard]] size_t n_targets() const { return m_entries.size(); }
+    [[nodiscard]] size_t n_acquired() const;
+    /// number of (re)allocations so far, of new targets and resizes
+    [[nodiscard]] unsigned n_allocations() const { return m_n_allocations; }
+
+private:
+    struct Entry {
+        std::unique_ptr<Framebuffer> framebuffer;
+        RenderTargetDescription description; // size is the allocated one
+        bool acquired = false;
+        unsigned last_used_frame = 0;
+        unsigned oversized_since_frame = 0; // last frame in which the target was requested at (at least) its full size
+    };
+    std::vector<Entry> m_entries;
+    std::string m_memory_subsystem;
+    unsigned m_frame = 0;
+    unsigned m_trim_after_frames = 60;
+    unsigned m_n_allocations = 0;
+};
+
+} // namespace gl_engine
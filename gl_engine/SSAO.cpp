@@ -17,19 +17,32 @@
  *****************************************************************************/
 #include "SSAO.h"
 
+#include <algorithm>
 #include <random>
 #include <cmath>
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLTexture>
 #include "Framebuffer.h"
+#include "GlState.h"
+#include "RenderTargetPool.h"
 #include "ShaderProgram.h"
+#include <glm/gtx/transform.hpp>
 
 namespace gl_engine {
 
-SSAO::SSAO(std::shared_ptr<ShaderProgram> program, std::shared_ptr<ShaderProgram> blur_program)
-    :m_ssao_program(program), m_ssao_blur_program(blur_program)
+SSAO::SSAO(std::shared_ptr<ShaderProgram> program, std::shared_ptr<ShaderProgram> blur_program, std::shared_ptr<ShaderProgram> upsample_program, std::shared_ptr<ShaderProgram> temporal_program, RenderTargetPool* render_targets)
+    :m_ssao_program(program), m_ssao_blur_program(blur_program), m_ssao_upsample_program(upsample_program), m_ssao_temporal_program(temporal_program), m_render_targets(render_targets)
 {
      m_f = QOpenGLContext::currentContext()->extraFunctions();
+    m_uniforms.samples = m_ssao_program->uniform<glm::vec3>("samples[0]");
+    m_uniforms.sample_offset = m_ssao_program->uniform<int>("sample_offset");
+    m_uniforms.sample_count = m_ssao_program->uniform<int>("sample_count");
+    m_uniforms.noise_offset = m_ssao_program->uniform<glm::vec2>("noise_offset");
+    m_uniforms.reprojection_matrix = m_ssao_temporal_program->uniform<glm::mat4>("reprojection_matrix");
+    m_uniforms.previous_camera_offset = m_ssao_temporal_program->uniform<glm::vec3>("previous_camera_offset");
+    m_uniforms.current_weight = m_ssao_temporal_program->uniform<float>("current_weight");
+    m_uniforms.history_valid = m_ssao_temporal_program->uniform<int>("history_valid");
+    m_uniforms.direction = m_ssao_blur_program->uniform<int>("direction");
 
     // GENERATE SAMPLE KERNEL
     recreate_kernel();
@@ -54,8 +67,10 @@ SSAO::SSAO(std::shared_ptr<ShaderProgram> program, std::shared_ptr<ShaderProgram
     m_ssao_noise_texture->setData(QOpenGLTexture::RGB, QOpenGLTexture::Float32, &ssaoNoise[0]);
 
     // GENERATE FRAMEBUFFER
-    m_ssaobuffer = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::R8 });
-    m_ssao_blurbuffer = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::R8 });
+    for (auto& history : m_history_buffers) {
+        history = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::RGBA8, Framebuffer::ColourFormat::RGBA8 });
+        history->set_memory_subsystem("ssao");
+    }
 }
 
 void SSAO::recreate_kernel(unsigned int size) {
@@ -83,53 +98,139 @@ SSAO::~SSAO() {
 }
 
 void SSAO::draw(Framebuffer* gbuffer, helpers::ScreenQuadGeometry* geometry,
-    const nucleus::camera::Definition&, unsigned int kernel_size, unsigned int blur_level)
+    const nucleus::camera::Definition& camera, unsigned int kernel_size, unsigned int blur_level, unsigned int resolution_level, bool temporal)
 {
-    m_ssaobuffer->bind();
+    resolution_level = std::min(resolution_level, 2u);
+    if (resolution_level != m_resolution_level) {
+        m_resolution_level = resolution_level;
+        resize_buffers();
+    }
+    if (!temporal)
+        m_history_valid = false;
+
+    const auto ssao_size = glm::max(m_viewport_size >> m_resolution_level, glm::uvec2(1));
+    const RenderTargetDescription ao_target { .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = ssao_size };
+    // the history is owned, everything else goes back to the pool once it was consumed
+    const auto release = [this](Framebuffer* buffer) {
+        if (buffer != m_history_buffers[0].get() && buffer != m_history_buffers[1].get())
+            m_render_targets->release(buffer);
+    };
+
+    auto* ssao_buffer = m_render_targets->acquire(ao_target);
+    ssao_buffer->bind();
     auto p = m_ssao_program.get();
     p->bind();
-    p->set_uniform("texin_position", 0);
+    // texture units as in the sampler layout of the programs (see ShaderManager)
     gbuffer->bind_colour_texture(1,0);
-    p->set_uniform("texin_normal", 1);
     gbuffer->bind_colour_texture(2,1);
-    p->set_uniform("texin_noise", 2);
-    m_ssao_noise_texture->bind(2);
+    GlState::current().bind_texture(2, GL_TEXTURE_2D, m_ssao_noise_texture->textureId());
 
     if (kernel_size != m_ssao_kernel.size()) recreate_kernel(kernel_size);
-    p->set_uniform_array("samples", this->m_ssao_kernel);
+    p->set_uniform_array(m_uniforms.samples, m_ssao_kernel);
+    const auto slice = m_frame_index % SSAO_TEMPORAL_SLICES;
+    if (temporal) {
+        const auto sample_count = (kernel_size + SSAO_TEMPORAL_SLICES - 1) / SSAO_TEMPORAL_SLICES;
+        p->set_uniform(m_uniforms.sample_offset, int(slice * sample_count));
+        p->set_uniform(m_uniforms.sample_count, int(sample_count));
+        // rotate the noise as well, so that the same sample doesn't hit the same pixel every SSAO_TEMPORAL_SLICES frames
+        p->set_uniform(m_uniforms.noise_offset, glm::vec2(float(m_frame_index % 4), float((m_frame_index / 4) % 4)));
+    } else {
+        p->set_uniform(m_uniforms.sample_offset, 0);
+        p->set_uniform(m_uniforms.sample_count, int(kernel_size));
+        p->set_uniform(m_uniforms.noise_offset, glm::vec2(0, 0));
+    }
     geometry->draw();
-    m_ssaobuffer->unbind();
+    ssao_buffer->unbind();
     p->release();
+    m_result = ssao_buffer;
+
+    if (temporal) {
+        auto* history = m_history_buffers[m_frame_index % 2].get();
+        auto* previous_history = m_history_buffers[(m_frame_index + 1) % 2].get();
+        p = m_ssao_temporal_program.get();
+        p->bind();
+        ssao_buffer->bind_colour_texture(0, 0);
+        previous_history->bind_colour_texture(0, 1);
+        previous_history->bind_colour_texture(1, 2);
+        gbuffer->bind_colour_texture(1, 3);
+        gbuffer->bind_colour_texture(2, 4);
+        // computed in double precision, the shader works in camera local coordinates
+        const auto reprojection = m_previous_world_view_projection * glm::translate(glm::dmat4(1.0), camera.position());
+        p->set_uniform(m_uniforms.reprojection_matrix, glm::mat4(reprojection));
+        p->set_uniform(m_uniforms.previous_camera_offset, glm::vec3(m_previous_camera_position - camera.position()));
+        p->set_uniform(m_uniforms.current_weight, 1.0f / SSAO_TEMPORAL_SLICES);
+        p->set_uniform(m_uniforms.history_valid, int(m_history_valid));
+        history->bind();
+        geometry->draw();
+        history->unbind();
+        p->release();
+
+        release(ssao_buffer);
+        m_result = history;
+        m_history_valid = true;
+        m_previous_world_view_projection = camera.world_view_projection_matrix();
+        m_previous_camera_position = camera.position();
+    }
+    m_frame_index++;
 
     if (blur_level > 0) {
         p = m_ssao_blur_program.get();
         p->bind();
-        p->set_uniform("texin_ssao", 0);
+        gbuffer->bind_colour_texture(1, 1); // the sky is skipped
 
         // BLUR HORIZONTAL
-        m_ssao_blurbuffer->bind();
-        m_ssaobuffer->bind_colour_texture(0,0);
-        p->set_uniform("direction", 0);
+        auto* blur_buffer = m_render_targets->acquire(ao_target);
+        blur_buffer->bind();
+        m_result->bind_colour_texture(0,0);
+        p->set_uniform(m_uniforms.direction, 0);
         geometry->draw();
-        m_ssao_blurbuffer->unbind();
+        blur_buffer->unbind();
+        release(m_result);
 
         // BLUR VERTICAL
-        m_ssaobuffer->bind();
-        m_ssao_blurbuffer->bind_colour_texture(0,0);
-        p->set_uniform("direction", 1);
+        auto* blurred = m_render_targets->acquire(ao_target); // aliases the unblurred ao, unless that is the history
+        blurred->bind();
+        blur_buffer->bind_colour_texture(0,0);
+        p->set_uniform(m_uniforms.direction, 1);
         geometry->draw();
-        m_ssaobuffer->unbind();
+        blurred->unbind();
         p->release();
+        m_render_targets->release(blur_buffer);
+        m_result = blurred; // the history stays unblurred
+    }
+
+    if (m_resolution_level > 0) {
+        p = m_ssao_upsample_program.get();
+        p->bind();
+        m_result->bind_colour_texture(0, 0);
+        gbuffer->bind_colour_texture(1, 1);
+        gbuffer->bind_colour_texture(2, 2);
+        auto* upsampled = m_render_targets->acquire({ .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = m_viewport_size });
+        upsampled->bind();
+        geometry->draw();
+        upsampled->unbind();
+        p->release();
+        release(m_result);
+        m_result = upsampled;
     }
 }
 
 void SSAO::resize(glm::uvec2 vp_size) {
-    m_ssaobuffer->resize(vp_size);
-    m_ssao_blurbuffer->resize(vp_size);
+    m_viewport_size = vp_size;
+    resize_buffers();
+}
+
+void SSAO::resize_buffers()
+{
+    const auto ssao_size = glm::max(m_viewport_size >> m_resolution_level, glm::uvec2(1));
+    for (auto& history : m_history_buffers)
+        history->resize(ssao_size);
+    m_history_valid = false;
 }
 
 void SSAO::bind_ssao_texture(unsigned int location) {
-    m_ssaobuffer->bind_colour_texture(0, location);
+    assert(m_result);
+    m_result->bind_colour_texture(0, location);
 }
 
 }
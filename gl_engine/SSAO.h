@@ -15,13 +15,17 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
+#include <array>
 #include <vector>
 #include <glm/glm.hpp>
 #include <memory>
+#include "ShaderProgram.h"
 #include "helpers.h"
 #include "nucleus/camera/Definition.h"
 
 #define MAX_SSAO_KERNEL_SIZE 64 // ALSO CHANGE IN ssao.frag
+// with temporal accumulation, the kernel is split into this many parts, one is evaluated per frame
+#define SSAO_TEMPORAL_SLICES 4
 
 class QOpenGLTexture;
 class QOpenGLExtraFunctions;
@@ -29,35 +33,61 @@ class QOpenGLExtraFunctions;
 namespace gl_engine {
 
 class Framebuffer;
-class ShaderProgram;
+class RenderTargetPool;
 
 class SSAO
 {
 public:
 
-    SSAO(std::shared_ptr<ShaderProgram> program, std::shared_ptr<ShaderProgram> blur_program);
+    // the intermediate buffers are transient targets of render_targets, only the temporal history is owned
+    SSAO(std::shared_ptr<ShaderProgram> program, std::shared_ptr<ShaderProgram> blur_program, std::shared_ptr<ShaderProgram> upsample_program, std::shared_ptr<ShaderProgram> temporal_program, RenderTargetPool* render_targets);
 
     // deletes the GPU Buffer
     ~SSAO();
 
+    // resolution_level: 0...full, 1...half, 2...quarter resolution. reduced resolutions are upsampled to full resolution
+    // with a bilateral filter guided by the gbuffer (position and normal), so that ao doesn't bleed over depth discontinuities.
+    // temporal: only 1 / SSAO_TEMPORAL_SLICES of the kernel is evaluated, and accumulated with the reprojected result of previous frames.
     void draw(Framebuffer* gbuffer, helpers::ScreenQuadGeometry* geometry,
-              const nucleus::camera::Definition& camera, unsigned int kernel_size, unsigned int blur_level);
+              const nucleus::camera::Definition& camera, unsigned int kernel_size, unsigned int blur_level, unsigned int resolution_level = 0, bool temporal = false);
 
     void resize(glm::uvec2 vp_size);
 
+    // the result of the last draw, valid until render_targets.end_frame()
     void bind_ssao_texture(unsigned int location);
 
 private:
 
     std::vector<glm::vec3> m_ssao_kernel;
     std::unique_ptr<QOpenGLTexture> m_ssao_noise_texture;
-    std::unique_ptr<Framebuffer> m_ssaobuffer;
-    std::unique_ptr<Framebuffer> m_ssao_blurbuffer;
+    std::array<std::unique_ptr<Framebuffer>, 2> m_history_buffers; // ping pong, ao + distance and normal for rejection
+    Framebuffer* m_result = nullptr; // ao after blur and upsampling
     std::shared_ptr<ShaderProgram> m_ssao_program;
     std::shared_ptr<ShaderProgram> m_ssao_blur_program;
+    std::shared_ptr<ShaderProgram> m_ssao_upsample_program;
+    std::shared_ptr<ShaderProgram> m_ssao_temporal_program;
+    struct {
+        ShaderProgram::Uniform<glm::vec3> samples;
+        ShaderProgram::Uniform<int> sample_offset;
+        ShaderProgram::Uniform<int> sample_count;
+        ShaderProgram::Uniform<glm::vec2> noise_offset;
+        ShaderProgram::Uniform<glm::mat4> reprojection_matrix; // of the temporal program
+        ShaderProgram::Uniform<glm::vec3> previous_camera_offset;
+        ShaderProgram::Uniform<float> current_weight;
+        ShaderProgram::Uniform<int> history_valid;
+        ShaderProgram::Uniform<int> direction; // of the blur program
+    } m_uniforms;
+    RenderTargetPool* m_render_targets;
+    glm::uvec2 m_viewport_size = { 4, 4 };
+    unsigned int m_resolution_level = 0;
+    unsigned int m_frame_index = 0;
+    bool m_history_valid = false;
+    glm::dmat4 m_previous_world_view_projection = glm::dmat4(1.0);
+    glm::dvec3 m_previous_camera_position = {};
     QOpenGLExtraFunctions *m_f;
 
     void recreate_kernel(unsigned int size = 64);
+    void resize_buffers();
 
 };
 
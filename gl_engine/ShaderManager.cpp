@@ -19,24 +19,59 @@
 
 #include "ShaderManager.h"
 
+#include <algorithm>
+#include <initializer_list>
+
 #include <QOpenGLContext>
 
 #include "ShaderProgram.h"
+#include "UniformBufferObjects.h"
 
 using gl_engine::ShaderManager;
 using gl_engine::ShaderProgram;
+using gl_engine::ShaderCodeSource;
 
 
 ShaderManager::ShaderManager()
 {
+    // compiled in the background, Window draws a blank frame until all are linked (see poll). the tile program is linked right
+    // away, its attribute locations are baked into the vertex arrays of the tiles (TileManager::initilise_attribute_locations).
     m_tile_program = std::make_unique<ShaderProgram>("tile.vert", "tile.frag");
-    m_screen_copy = std::make_unique<ShaderProgram>("screen_pass.vert", "screen_copy.frag");
-    m_atmosphere_bg_program = std::make_unique<ShaderProgram>("screen_pass.vert", "atmosphere_bg.frag");
-    m_compose_program = std::make_unique<ShaderProgram>("screen_pass.vert", "compose.frag");
-    m_ssao_program = std::make_shared<ShaderProgram>("screen_pass.vert", "ssao.frag");
-    m_ssao_blur_program = std::make_shared<ShaderProgram>("screen_pass.vert", "ssao_blur.frag");
-    m_shadowmap_program = std::make_unique<ShaderProgram>("shadowmap.vert", "shadowmap.frag");
-    m_labels_program = std::make_unique<ShaderProgram>("labels.vert", "labels.frag");
+    m_screen_copy = std::make_unique<ShaderProgram>("screen_pass.vert", "screen_copy.frag", ShaderCodeSource::FILE, true);
+    m_atmosphere_bg_program = std::make_unique<ShaderProgram>("screen_pass.vert", "atmosphere_bg.frag", ShaderCodeSource::FILE, true);
+    m_compose_program = std::make_unique<ShaderProgram>("screen_pass.vert", "compose.frag", ShaderCodeSource::FILE, true);
+    m_ssao_program = std::make_shared<ShaderProgram>("screen_pass.vert", "ssao.frag", ShaderCodeSource::FILE, true);
+    m_ssao_blur_program = std::make_shared<ShaderProgram>("screen_pass.vert", "ssao_blur.frag", ShaderCodeSource::FILE, true);
+    m_ssao_upsample_program = std::make_shared<ShaderProgram>("screen_pass.vert", "ssao_upsample.frag", ShaderCodeSource::FILE, true);
+    m_ssao_temporal_program = std::make_shared<ShaderProgram>("screen_pass.vert", "ssao_temporal.frag", ShaderCodeSource::FILE, true);
+    m_shadowmap_program = std::make_unique<ShaderProgram>("shadowmap.vert", "shadowmap.frag", ShaderCodeSource::FILE, true);
+    m_viewshed_program = std::make_shared<ShaderProgram>("viewshed.vert", "shadowmap.frag", ShaderCodeSource::FILE, true);
+    m_far_field_program = std::make_shared<ShaderProgram>("far_field.vert", "far_field.frag", ShaderCodeSource::FILE, true);
+    m_vector_overlay_program = std::make_shared<ShaderProgram>("vector_overlay.vert", "vector_overlay.frag", ShaderCodeSource::FILE, true);
+    m_labels_program = std::make_unique<ShaderProgram>("labels.vert", "labels.frag", ShaderCodeSource::FILE, true);
+    m_upscale_program = std::make_unique<ShaderProgram>("screen_pass.vert", "upscale.frag", ShaderCodeSource::FILE, true);
+    m_temporal_upsampling_program = std::make_shared<ShaderProgram>("screen_pass.vert", "temporal_upsampling.frag", ShaderCodeSource::FILE, true);
+
+    // texture units, assigned once after linking (see ShaderProgram::set_sampler_unit). the passes bind their textures there.
+    const auto set_sampler_units = [](ShaderProgram* program, std::initializer_list<std::pair<const char*, int>> units) {
+        for (const auto& [name, unit] : units)
+            program->set_sampler_unit(name, unit);
+    };
+    for (auto* program : { m_tile_program.get(), m_shadowmap_program.get(), m_viewshed_program.get(), m_far_field_program.get() }) // see TileManager::draw
+        set_sampler_units(program, { { "height_sampler", 1 }, { "ortho_sampler", 2 }, { "normal_sampler", 3 } });
+    set_sampler_units(m_compose_program.get(),
+        { { "texin_albedo", 0 }, { "texin_position", 1 }, { "texin_normal", 2 }, { "texin_atmosphere", 3 }, { "texin_ssao", 4 }, { "texin_csm", 5 },
+            { "texin_csm_depth", 6 }, { "texin_depth", 7 }, { "texin_atmosphere_lut", 8 }, { "texin_viewshed", 9 },
+            { "texin_far_field_albedo", 10 }, { "texin_far_field_normal", 11 }, { "texin_far_field_depth", 12 }, { "texin_vector_overlay", 13 } });
+    set_sampler_units(m_vector_overlay_program.get(), { { "texin_mask", 0 } });
+    set_sampler_units(m_ssao_program.get(), { { "texin_position", 0 }, { "texin_normal", 1 }, { "texin_noise", 2 } });
+    set_sampler_units(m_ssao_temporal_program.get(),
+        { { "texin_ssao", 0 }, { "texin_history", 1 }, { "texin_history_normal", 2 }, { "texin_position", 3 }, { "texin_normal", 4 } });
+    set_sampler_units(m_ssao_blur_program.get(), { { "texin_ssao", 0 }, { "texin_position", 1 } });
+    set_sampler_units(m_ssao_upsample_program.get(), { { "texin_ssao", 0 }, { "texin_position", 1 }, { "texin_normal", 2 } });
+    set_sampler_units(m_labels_program.get(), { { "texin_depth", 0 }, { "font_sampler", 1 }, { "icon_sampler", 2 } });
+    set_sampler_units(m_upscale_program.get(), { { "texin_colour", 0 }, { "texin_depth", 1 } });
+    set_sampler_units(m_temporal_upsampling_program.get(), { { "texin_colour", 0 }, { "texin_position", 1 }, { "texin_history", 2 } });
 
     m_program_list.push_back(m_tile_program.get());
     m_program_list.push_back(m_screen_copy.get());
@@ -44,8 +79,15 @@ ShaderManager::ShaderManager()
     m_program_list.push_back(m_compose_program.get());
     m_program_list.push_back(m_ssao_program.get());
     m_program_list.push_back(m_ssao_blur_program.get());
+    m_program_list.push_back(m_ssao_upsample_program.get());
+    m_program_list.push_back(m_ssao_temporal_program.get());
     m_program_list.push_back(m_shadowmap_program.get());
+    m_program_list.push_back(m_viewshed_program.get());
+    m_program_list.push_back(m_far_field_program.get());
+    m_program_list.push_back(m_vector_overlay_program.get());
     m_program_list.push_back(m_labels_program.get());
+    m_program_list.push_back(m_upscale_program.get());
+    m_program_list.push_back(m_temporal_upsampling_program.get());
 }
 
 ShaderManager::~ShaderManager() = default;
@@ -55,9 +97,51 @@ void ShaderManager::release()
     m_tile_program->release();
 }
 
+QString ShaderManager::feature_defines(const uboSharedConfig& config)
+{
+    const auto boolean = [](auto value) { return value ? QString("true") : QString("false"); };
+    return QString("#define FEATURE_PHONG_ENABLED %1\n").arg(boolean(config.m_phong_enabled))
+        + QString("#define FEATURE_NORMAL_MODE %1u\n").arg(config.m_normal_mode)
+        + QString("#define FEATURE_OVERLAY_MODE %1u\n").arg(config.m_overlay_mode)
+        + QString("#define FEATURE_OVERLAY_POSTSHADING_ENABLED %1\n").arg(boolean(config.m_overlay_postshading_enabled))
+        + QString("#define FEATURE_SSAO_ENABLED %1\n").arg(boolean(config.m_ssao_enabled))
+        + QString("#define FEATURE_CSM_ENABLED %1\n").arg(boolean(config.m_csm_enabled))
+        + QString("#define FEATURE_SNOW_ENABLED %1\n").arg(boolean(config.m_snow_settings_angle.x() != 0.0f))
+        + QString("#define FEATURE_HEIGHT_LINES_ENABLED %1\n").arg(boolean(config.m_height_lines_enabled))
+        + QString("#define FEATURE_OVERLAY_SHADOWMAPS_ENABLED %1\n").arg(boolean(config.m_overlay_shadowmaps_enabled));
+}
+
+bool ShaderManager::set_feature_config(const uboSharedConfig& config)
+{
+    const auto defines = feature_defines(config);
+    if (defines == m_compose_program->defines() && defines == m_tile_program->defines())
+        return false;
+    m_tile_program->set_defines(defines);
+    m_compose_program->set_defines(defines);
+    return true;
+}
+
 void ShaderManager::reload_shaders()
 {
     for (auto* program : m_program_list) {
-        program->reload();
+        program->reload_async();
     }
 }
+
+bool ShaderManager::poll()
+{
+    bool swapped = false;
+    for (auto* program : m_program_list)
+        swapped |= program->poll();
+    return swapped;
+}
+
+bool ShaderManager::compiling() const
+{
+    return std::any_of(m_program_list.begin(), m_program_list.end(), [](const ShaderProgram* p) { return p->is_compiling(); });
+}
+
+bool ShaderManager::ready() const
+{
+    return std::all_of(m_program_list.begin(), m_program_list.end(), [](const ShaderProgram* p) { return p->is_linked(); });
+}
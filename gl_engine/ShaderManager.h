@@ -20,11 +20,13 @@
 #pragma once
 
 #include <QObject>
+#include <QString>
 #include <memory>
 
 // consider removing. the only thing it does atm is a shader list + reloading. erm, so maybe rename into shader reloader..
 namespace gl_engine {
 class ShaderProgram;
+struct uboSharedConfig;
 
 class ShaderManager : public QObject {
     Q_OBJECT
@@ -37,13 +39,36 @@ public:
     [[nodiscard]] ShaderProgram* compose_program() const        { return m_compose_program.get(); }
     [[nodiscard]] ShaderProgram* ssao_program() const           { return m_ssao_program.get(); }
     [[nodiscard]] ShaderProgram* ssao_blur_program() const      { return m_ssao_blur_program.get(); }
+    [[nodiscard]] ShaderProgram* ssao_upsample_program() const  { return m_ssao_upsample_program.get(); }
+    [[nodiscard]] ShaderProgram* ssao_temporal_program() const  { return m_ssao_temporal_program.get(); }
     [[nodiscard]] ShaderProgram* shadowmap_program() const      { return m_shadowmap_program.get(); }
+    [[nodiscard]] ShaderProgram* viewshed_program() const       { return m_viewshed_program.get(); }
+    [[nodiscard]] ShaderProgram* far_field_program() const      { return m_far_field_program.get(); }
+    [[nodiscard]] ShaderProgram* vector_overlay_program() const { return m_vector_overlay_program.get(); }
     [[nodiscard]] ShaderProgram* labels_program() const         { return m_labels_program.get(); }
+    [[nodiscard]] ShaderProgram* upscale_program() const        { return m_upscale_program.get(); }
+    [[nodiscard]] ShaderProgram* temporal_upsampling_program() const { return m_temporal_upsampling_program.get(); }
     [[nodiscard]] std::vector<ShaderProgram*> all() const       { return m_program_list; }
     std::shared_ptr<ShaderProgram> shared_ssao_program()        { return m_ssao_program; }
     std::shared_ptr<ShaderProgram> shared_ssao_blur_program()   { return m_ssao_blur_program; }
+    std::shared_ptr<ShaderProgram> shared_ssao_upsample_program() { return m_ssao_upsample_program; }
+    std::shared_ptr<ShaderProgram> shared_ssao_temporal_program() { return m_ssao_temporal_program; }
     std::shared_ptr<ShaderProgram> shared_shadowmap_program()   { return m_shadowmap_program; }
+    std::shared_ptr<ShaderProgram> shared_viewshed_program()    { return m_viewshed_program; }
+    std::shared_ptr<ShaderProgram> shared_far_field_program()   { return m_far_field_program; }
+    std::shared_ptr<ShaderProgram> shared_vector_overlay_program() { return m_vector_overlay_program; }
+    std::shared_ptr<ShaderProgram> shared_temporal_upsampling_program() { return m_temporal_upsampling_program; }
     void release();
+    // specialises the tile and compose programs for the feature switches of the config (see shared_config.glsl), so that the
+    // disabled features are compiled out instead of branching on the uniform block. returns true if programs were swapped,
+    // the uniform blocks must be bound again then.
+    bool set_feature_config(const uboSharedConfig& config);
+    [[nodiscard]] static QString feature_defines(const uboSharedConfig& config);
+    // programs are compiled asynchronously (ShaderProgram::reload_async). poll once per frame, it returns true if programs were
+    // swapped (the uniform blocks must be bound again then). the previous programs are used while compiling.
+    bool poll();
+    [[nodiscard]] bool compiling() const;
+    [[nodiscard]] bool ready() const; // all programs linked at least once
 public slots:
     void reload_shaders();
 signals:
@@ -56,7 +81,14 @@ private:
     std::unique_ptr<ShaderProgram> m_compose_program;
     std::shared_ptr<ShaderProgram> m_ssao_program;
     std::shared_ptr<ShaderProgram> m_ssao_blur_program;
+    std::shared_ptr<ShaderProgram> m_ssao_upsample_program;
+    std::shared_ptr<ShaderProgram> m_ssao_temporal_program;
     std::shared_ptr<ShaderProgram> m_shadowmap_program;
+    std::shared_ptr<ShaderProgram> m_viewshed_program;
+    std::shared_ptr<ShaderProgram> m_far_field_program;
+    std::shared_ptr<ShaderProgram> m_vector_overlay_program;
     std::shared_ptr<ShaderProgram> m_labels_program;
+    std::unique_ptr<ShaderProgram> m_upscale_program;
+    std::shared_ptr<ShaderProgram> m_temporal_upsampling_program;
 };
 }
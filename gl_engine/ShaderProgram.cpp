@@ -19,9 +19,17 @@
 
 #include "ShaderProgram.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <utility>
 
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
 #include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QTextStream>
 #include <QRegularExpression>
 #include <QOpenGLContext>
@@ -39,10 +47,49 @@
 #include <QNetworkReply>
 #endif
 
+#include "GlState.h"
+#include "ShadowMapping.h"
 #include "helpers.h"
+#include "nucleus/timing/TraceRecorder.h"
 
 using gl_engine::ShaderProgram;
 
+namespace {
+// the file holds the binary format (GLenum), followed by the binary. false if there is none, or the driver rejects it
+// (e.g. after an update), the program has to be compiled then.
+bool load_program_binary(QOpenGLExtraFunctions* f, GLuint program, const QString& path)
+{
+    QFile file(path);
+    if (path.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return false;
+    const auto bytes = file.readAll();
+    GLenum format = 0;
+    if (bytes.size() <= qsizetype(sizeof(format)))
+        return false;
+    std::memcpy(&format, bytes.constData(), sizeof(format));
+    f->glProgramBinary(program, format, bytes.constData() + sizeof(format), GLsizei(bytes.size() - qsizetype(sizeof(format))));
+    GLint linked = GL_FALSE;
+    f->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void store_program_binary(QOpenGLExtraFunctions* f, GLuint program, const QString& path)
+{
+    GLint length = 0;
+    f->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (path.isEmpty() || length <= 0)
+        return;
+    GLenum format = 0;
+    QByteArray bytes(qsizetype(sizeof(format)) + length, '\0');
+    f->glGetProgramBinary(program, length, &length, &format, bytes.data() + sizeof(format));
+    std::memcpy(bytes.data(), &format, sizeof(format));
+    bytes.resize(qsizetype(sizeof(format)) + length);
+    QSaveFile file(path); // replaced atomically, a crash doesn't leave a partial binary
+    if (!file.open(QIODevice::WriteOnly) || file.write(bytes) < 0 || !file.commit())
+        qDebug() << "couldn't write the program binary to" << path;
+}
+} // namespace
+
 
 QString ShaderProgram::get_qrc_or_path_prefix() {
     QString prefix = ":/gl_shaders/";
@@ -58,10 +105,17 @@ QString ShaderProgram::get_shader_code_version() {
         return "#version 330\n";
 }
 
+QString ShaderProgram::get_shader_defines()
+{
+    // constants shared between c++ and glsl. c++ is the source of truth.
+    return QString("#define SHADOW_CASCADES %1\n#define GBUFFER_COMPACT %2\n").arg(SHADOW_CASCADES).arg(ALP_ENABLE_COMPACT_GBUFFER ? 1 : 0);
+}
+
 QByteArray ShaderProgram::make_versioned_shader_code(const QByteArray& src)
 {
     QByteArray versionedSrc;
     versionedSrc.append(get_shader_code_version().toLocal8Bit());
+    versionedSrc.append(get_shader_defines().toLocal8Bit());
     versionedSrc.append(src);
     return versionedSrc;
 }
@@ -69,6 +123,7 @@ QByteArray ShaderProgram::make_versioned_shader_code(const QByteArray& src)
 QByteArray ShaderProgram::make_versioned_shader_code(const QString& src) {
     QByteArray versionedSrc;
     versionedSrc.append(get_shader_code_version().toLocal8Bit());
+    versionedSrc.append(get_shader_defines().toLocal8Bit());
     versionedSrc.append(src.toLocal8Bit());
     return versionedSrc;
 }
@@ -176,19 +231,65 @@ QString ShaderProgram::read_file_content_local(const QString& name) {
 
 // =========== MEMBER DECLARATIONS =======================
 
-ShaderProgram::ShaderProgram(QString vertex_shader, QString fragment_shader, ShaderCodeSource code_source)
+ShaderProgram::LinkedProgram::~LinkedProgram()
+{
+    if (!QOpenGLContext::currentContext())
+        return;
+    GlState::current().forget_program(id()); // the qt program is deleted by its destructor
+    if (raw_program)
+        QOpenGLContext::currentContext()->extraFunctions()->glDeleteProgram(raw_program);
+}
+
+ShaderProgram::PendingCompile::~PendingCompile()
+{
+    if (!QOpenGLContext::currentContext())
+        return;
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    if (vertex_shader)
+        f->glDeleteShader(vertex_shader);
+    if (fragment_shader)
+        f->glDeleteShader(fragment_shader);
+    if (program)
+        f->glDeleteProgram(program);
+}
+
+ShaderProgram::ShaderProgram(QString vertex_shader, QString fragment_shader, ShaderCodeSource code_source, bool compile_async)
     : m_vertex_shader(vertex_shader)
     , m_fragment_shader(fragment_shader)
     , m_code_source(code_source)
+{
+    if (compile_async) {
+        reload_async();
+        return;
+    }
+    reload();
+    assert(m_program);
+}
+
+ShaderProgram::ShaderProgram(QString vertex_shader, QString fragment_shader, std::vector<std::string> feedback_varyings)
+    : m_vertex_shader(vertex_shader)
+    , m_fragment_shader(fragment_shader)
+    , m_code_source(ShaderCodeSource::FILE)
+    , m_feedback_varyings(std::move(feedback_varyings))
 {
     reload();
-    assert(m_q_shader_program);
+    assert(m_program);
+}
+
+void ShaderProgram::set_feedback_varyings(GLuint program) const
+{
+    if (m_feedback_varyings.empty())
+        return;
+    std::vector<const char*> names;
+    for (const auto& name : m_feedback_varyings)
+        names.push_back(name.c_str());
+    QOpenGLContext::currentContext()->extraFunctions()->glTransformFeedbackVaryings(program, GLsizei(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
 }
 
 int ShaderProgram::attribute_location(const std::string& name)
 {
     if (!m_cached_attribs.contains(name))
-        m_cached_attribs[name] = m_q_shader_program->attributeLocation(name.c_str());
+        m_cached_attribs[name] = QOpenGLContext::currentContext()->extraFunctions()->glGetAttribLocation(m_program->id(), name.c_str());
 
     return m_cached_attribs.at(name);
 }
@@ -197,18 +298,20 @@ int ShaderProgram::attribute_location(const std::string& name)
 
 void ShaderProgram::bind()
 {
-    m_q_shader_program->bind();
+    GlState::current().use_program(m_program->id());
 }
 
 void ShaderProgram::release()
 {
-    m_q_shader_program->release();
+    GlState::current().use_program(0);
 }
 
 void ShaderProgram::set_uniform_block(const std::string& name, GLuint location)
 {
+    if (!m_program) // still compiling, the bindings are set again when it's swapped in
+        return;
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
-    auto pId = m_q_shader_program->programId();
+    auto pId = m_program->id();
     unsigned int ubi = f->glGetUniformBlockIndex(pId, name.c_str());
     if (ubi == GL_INVALID_INDEX) {
         //qDebug() << "Uniform Block " << name << " not found in program " << pId;
@@ -217,6 +320,103 @@ void ShaderProgram::set_uniform_block(const std::string& name, GLuint location)
     }
 }
 
+namespace {
+// the uniforms are set on the bound program, like QOpenGLShaderProgram::setUniformValue
+void upload_uniform(QOpenGLExtraFunctions* f, int location, const glm::mat4& value) { f->glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+void upload_uniform(QOpenGLExtraFunctions* f, int location, const glm::vec2& value) { f->glUniform2fv(location, 1, glm::value_ptr(value)); }
+void upload_uniform(QOpenGLExtraFunctions* f, int location, const glm::vec3& value) { f->glUniform3fv(location, 1, glm::value_ptr(value)); }
+void upload_uniform(QOpenGLExtraFunctions* f, int location, const glm::vec4& value) { f->glUniform4fv(location, 1, glm::value_ptr(value)); }
+void upload_uniform(QOpenGLExtraFunctions* f, int location, int value) { f->glUniform1i(location, value); }
+void upload_uniform(QOpenGLExtraFunctions* f, int location, unsigned value) { f->glUniform1ui(location, value); }
+void upload_uniform(QOpenGLExtraFunctions* f, int location, float value) { f->glUniform1f(location, value); }
+void upload_uniform_array(QOpenGLExtraFunctions* f, int location, std::span<const glm::mat4> array)
+{
+    f->glUniformMatrix4fv(location, GLsizei(array.size()), GL_FALSE, reinterpret_cast<const float*>(array.data()));
+}
+void upload_uniform_array(QOpenGLExtraFunctions* f, int location, std::span<const glm::vec3> array)
+{
+    f->glUniform3fv(location, GLsizei(array.size()), reinterpret_cast<const float*>(array.data()));
+}
+void upload_uniform_array(QOpenGLExtraFunctions* f, int location, std::span<const glm::vec4> array)
+{
+    f->glUniform4fv(location, GLsizei(array.size()), reinterpret_cast<const float*>(array.data()));
+}
+} // namespace
+
+template <typename T>
+ShaderProgram::Uniform<T> ShaderProgram::uniform(const std::string& name)
+{
+    const auto existing = std::find(m_uniform_names.begin(), m_uniform_names.end(), name);
+    if (existing != m_uniform_names.end())
+        return { unsigned(existing - m_uniform_names.begin()) };
+    m_uniform_names.push_back(name);
+    if (m_program)
+        resolve_layout(*m_program);
+    return { unsigned(m_uniform_names.size() - 1) };
+}
+
+template <typename T>
+void ShaderProgram::set_uniform(Uniform<T> uniform, const std::type_identity_t<T>& value)
+{
+    if (!m_program || !uniform.valid())
+        return;
+    upload_uniform(QOpenGLContext::currentContext()->extraFunctions(), m_program->uniform_locations[uniform.index], value);
+}
+
+template <typename T>
+void ShaderProgram::set_uniform_array(Uniform<T> uniform, std::span<const std::type_identity_t<T>> array)
+{
+    if (!m_program || !uniform.valid())
+        return;
+    upload_uniform_array(QOpenGLContext::currentContext()->extraFunctions(), m_program->uniform_locations[uniform.index], array);
+}
+
+template ShaderProgram::Uniform<glm::mat4> ShaderProgram::uniform(const std::string&);
+template ShaderProgram::Uniform<glm::vec2> ShaderProgram::uniform(const std::string&);
+template ShaderProgram::Uniform<glm::vec3> ShaderProgram::uniform(const std::string&);
+template ShaderProgram::Uniform<glm::vec4> ShaderProgram::uniform(const std::string&);
+template ShaderProgram::Uniform<int> ShaderProgram::uniform(const std::string&);
+template ShaderProgram::Uniform<unsigned> ShaderProgram::uniform(const std::string&);
+template ShaderProgram::Uniform<float> ShaderProgram::uniform(const std::string&);
+template void ShaderProgram::set_uniform(Uniform<glm::mat4>, const glm::mat4&);
+template void ShaderProgram::set_uniform(Uniform<glm::vec2>, const glm::vec2&);
+template void ShaderProgram::set_uniform(Uniform<glm::vec3>, const glm::vec3&);
+template void ShaderProgram::set_uniform(Uniform<glm::vec4>, const glm::vec4&);
+template void ShaderProgram::set_uniform(Uniform<int>, const int&);
+template void ShaderProgram::set_uniform(Uniform<unsigned>, const unsigned&);
+template void ShaderProgram::set_uniform(Uniform<float>, const float&);
+template void ShaderProgram::set_uniform_array(Uniform<glm::mat4>, std::span<const glm::mat4>);
+template void ShaderProgram::set_uniform_array(Uniform<glm::vec3>, std::span<const glm::vec3>);
+template void ShaderProgram::set_uniform_array(Uniform<glm::vec4>, std::span<const glm::vec4>);
+
+void ShaderProgram::set_sampler_unit(const std::string& name, int unit)
+{
+    if (std::find(m_sampler_units.begin(), m_sampler_units.end(), std::make_pair(name, unit)) != m_sampler_units.end())
+        return;
+    m_sampler_units.emplace_back(name, unit); // a later entry for the same name wins, it is assigned last
+    if (m_program)
+        resolve_layout(*m_program);
+}
+
+void ShaderProgram::resolve_layout(LinkedProgram& program) const
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    const auto id = program.id();
+    while (program.uniform_locations.size() < m_uniform_names.size())
+        program.uniform_locations.push_back(f->glGetUniformLocation(id, m_uniform_names[program.uniform_locations.size()].c_str()));
+    if (program.n_assigned_samplers == m_sampler_units.size())
+        return;
+    // sampler units are program state, set them on this program without disturbing the bound one
+    GLint bound = 0;
+    f->glGetIntegerv(GL_CURRENT_PROGRAM, &bound);
+    f->glUseProgram(id);
+    for (; program.n_assigned_samplers < m_sampler_units.size(); ++program.n_assigned_samplers) {
+        const auto& [name, unit] = m_sampler_units[program.n_assigned_samplers];
+        f->glUniform1i(f->glGetUniformLocation(id, name.c_str()), unit);
+    }
+    f->glUseProgram(GLuint(bound));
+}
+
 void ShaderProgram::set_uniform(const std::string& name, const glm::mat4& matrix)
 {
     set_uniform_template(name, matrix);
@@ -254,21 +454,23 @@ void ShaderProgram::set_uniform(const std::string& name, float value)
 
 void ShaderProgram::set_uniform_array(const std::string& name, const std::vector<glm::vec4>& array)
 {
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
     if (!m_cached_uniforms.contains(name))
-        m_cached_uniforms[name] = m_q_shader_program->uniformLocation(name.c_str());
+        m_cached_uniforms[name] = f->glGetUniformLocation(m_program->id(), name.c_str());
 
     const auto uniform_location = m_cached_uniforms.at(name);
 
-    m_q_shader_program->setUniformValueArray(uniform_location, reinterpret_cast<const float*>(array.data()), int(array.size()), 4);
+    f->glUniform4fv(uniform_location, GLsizei(array.size()), reinterpret_cast<const float*>(array.data()));
 }
 
 void ShaderProgram::set_uniform_array(const std::string& name, const std::vector<glm::vec3>& array)
 {
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
     if (!m_cached_uniforms.contains(name))
-        m_cached_uniforms[name] = m_q_shader_program->uniformLocation(name.c_str());
+        m_cached_uniforms[name] = f->glGetUniformLocation(m_program->id(), name.c_str());
 
     const auto uniform_location = m_cached_uniforms.at(name);
-    m_q_shader_program->setUniformValueArray(uniform_location, reinterpret_cast<const float*>(array.data()), int(array.size()), 3);
+    f->glUniform3fv(uniform_location, GLsizei(array.size()), reinterpret_cast<const float*>(array.data()));
 }
 
 // Helper function because i get frustrated with the shader compile errors...
@@ -309,16 +511,14 @@ void outputMeaningfullErrors(const QString& qtLog, const QString& code, const QS
 #endif
 }
 
-void ShaderProgram::reload()
+std::unique_ptr<QOpenGLShaderProgram> ShaderProgram::compile_and_link(const QString& vertex_code, const QString& fragment_code) const
 {
-    QString vertexCode = load_and_preprocess_shader_code(gl_engine::ShaderType::VERTEX);
-    QString fragmentCode = load_and_preprocess_shader_code(gl_engine::ShaderType::FRAGMENT);
     auto program = std::make_unique<QOpenGLShaderProgram>();
-    if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexCode)) {
-        outputMeaningfullErrors(program->log(), vertexCode, m_vertex_shader);
-    } else if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentCode)) {
-        outputMeaningfullErrors(program->log(), fragmentCode, m_fragment_shader);
-    } else if (!program->link()) {
+    if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertex_code)) {
+        outputMeaningfullErrors(program->log(), vertex_code, m_vertex_shader);
+    } else if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragment_code)) {
+        outputMeaningfullErrors(program->log(), fragment_code, m_fragment_shader);
+    } else if (set_feedback_varyings(program->programId()); !program->link()) {
 #ifdef _MSC_VER
         // when using msvc in github ci qDebug/Critical don't print when an assert fails
         // effectively, we don't see any error
@@ -329,21 +529,192 @@ void ShaderProgram::reload()
         qCritical() << "error linking shader " << m_vertex_shader.toStdString() << "and" << m_fragment_shader.toStdString();
 #endif
     } else {
-        // NO ERROR
-        m_q_shader_program = std::move(program);
-        m_cached_attribs.clear();
-        m_cached_uniforms.clear();
+        return program;
+    }
+    return {};
+}
+
+void ShaderProgram::reload()
+{
+    m_pending.reset();
+    m_variants.clear();
+    compile_current_variant();
+}
+
+bool ShaderProgram::parallel_compile_supported()
+{
+    const auto* context = QOpenGLContext::currentContext();
+    return context->hasExtension("GL_KHR_parallel_shader_compile") || context->hasExtension("GL_ARB_parallel_shader_compile");
+}
+
+void ShaderProgram::reload_async()
+{
+    m_variants.clear(); // linked from the old sources
+    m_pending = std::make_unique<PendingCompile>();
+    m_pending->vertex_code = load_and_preprocess_shader_code(gl_engine::ShaderType::VERTEX);
+    m_pending->fragment_code = load_and_preprocess_shader_code(gl_engine::ShaderType::FRAGMENT);
+    if (!parallel_compile_supported())
+        return; // compiled in poll, after the current frame was shown
+
+    // none of these calls wait for the driver, only querying a status does (except GL_COMPLETION_STATUS_KHR)
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    m_pending->binary_path = program_binary_path(m_pending->vertex_code, m_pending->fragment_code);
+    m_pending->program = f->glCreateProgram();
+    if (load_program_binary(f, m_pending->program, m_pending->binary_path)) {
+        m_pending->from_binary = true; // swapped in with the next poll
+        return;
+    }
+    f->glDeleteProgram(m_pending->program); // a rejected binary leaves the program in an undefined state
+    const auto compile = [f](GLenum type, const QString& code) {
+        const auto shader = f->glCreateShader(type);
+        const auto bytes = code.toUtf8();
+        const char* data = bytes.constData();
+        f->glShaderSource(shader, 1, &data, nullptr);
+        f->glCompileShader(shader);
+        return shader;
+    };
+    m_pending->vertex_shader = compile(GL_VERTEX_SHADER, m_pending->vertex_code);
+    m_pending->fragment_shader = compile(GL_FRAGMENT_SHADER, m_pending->fragment_code);
+    m_pending->program = f->glCreateProgram();
+    f->glAttachShader(m_pending->program, m_pending->vertex_shader);
+    f->glAttachShader(m_pending->program, m_pending->fragment_shader);
+    set_feedback_varyings(m_pending->program);
+    if (!m_pending->binary_path.isEmpty())
+        f->glProgramParameteri(m_pending->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    f->glLinkProgram(m_pending->program);
+}
+
+bool ShaderProgram::poll()
+{
+    if (!m_pending)
+        return false;
+    if (!m_pending->program) { // no parallel compilation
+        m_pending.reset();
+        m_variants.clear();
+        return compile_current_variant();
+    }
+
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    constexpr GLenum completion_status = 0x91B1; // GL_COMPLETION_STATUS_KHR
+    GLint done = GL_FALSE;
+    f->glGetProgramiv(m_pending->program, completion_status, &done);
+    if (!done)
+        return false;
+
+    const auto pending = std::move(m_pending);
+    GLint linked = GL_FALSE;
+    f->glGetProgramiv(pending->program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        const auto report = [f](GLuint shader, const QString& code, const QString& file) {
+            GLint compiled = GL_FALSE;
+            f->glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if (compiled)
+                return false;
+            GLint length = 0;
+            f->glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+            QByteArray log(std::max(length, 1), '\0');
+            f->glGetShaderInfoLog(shader, length, nullptr, log.data());
+            outputMeaningfullErrors(QString::fromUtf8(log), code, file);
+            return true;
+        };
+        if (!report(pending->vertex_shader, pending->vertex_code, m_vertex_shader) && !report(pending->fragment_shader, pending->fragment_code, m_fragment_shader))
+            qCritical() << "error linking shader " << m_vertex_shader.toStdString() << "and" << m_fragment_shader.toStdString();
+        return false; // the previous program stays
+    }
+
+    if (!pending->from_binary) {
+        f->glDetachShader(pending->program, pending->vertex_shader);
+        f->glDetachShader(pending->program, pending->fragment_shader);
+        store_program_binary(f, pending->program, pending->binary_path);
+    }
+    auto program = std::make_shared<LinkedProgram>();
+    program->raw_program = std::exchange(pending->program, 0);
+    m_variants.clear(); // compiled from new sources
+    m_variants.insert(m_defines, program);
+    use_program(std::move(program));
+    return true;
+}
+
+void ShaderProgram::use_program(std::shared_ptr<LinkedProgram> program)
+{
+    m_program = std::move(program);
+    m_cached_attribs.clear();
+    m_cached_uniforms.clear();
+    resolve_layout(*m_program);
+}
+
+void ShaderProgram::set_defines(const QString& defines)
+{
+    if (defines == m_defines)
+        return;
+    const auto previous_defines = std::exchange(m_defines, defines);
+    if (const auto* variant = m_variants.find(m_defines)) {
+        m_pending.reset();
+        use_program(*variant);
+        return;
+    }
+    if (m_pending || !m_program) { // keep compiling in the background, with the new defines
+        reload_async();
+        return;
     }
+    if (!compile_current_variant())
+        m_defines = previous_defines;
+}
+
+bool ShaderProgram::compile_current_variant()
+{
+    const nucleus::timing::TraceScope trace("compile_shader", "gl");
+    QString vertexCode = load_and_preprocess_shader_code(gl_engine::ShaderType::VERTEX);
+    QString fragmentCode = load_and_preprocess_shader_code(gl_engine::ShaderType::FRAGMENT);
+    // the program binary is cached on disk by qt, keyed by the preprocessed sources and the driver. a reload with changed sources
+    // misses the cache and compiles. compilation of cacheable shaders is deferred to link, which doesn't tell which shader
+    // failed. in that case the program is compiled again the usual way, to report the errors per shader.
+    auto qt_program = std::make_unique<QOpenGLShaderProgram>();
+    if (!m_feedback_varyings.empty() && qt_program->create())
+        set_feedback_varyings(qt_program->programId());
+    if (!qt_program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexCode)
+        || !qt_program->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragmentCode) || !qt_program->link()) {
+        qt_program = compile_and_link(vertexCode, fragmentCode);
+    }
+    if (!qt_program)
+        return false;
+    auto program = std::make_shared<LinkedProgram>();
+    program->qt_program = std::move(qt_program);
+    m_variants.insert(m_defines, program);
+    use_program(std::move(program));
+    return true;
 }
 
 template<typename T>
 void ShaderProgram::set_uniform_template(const std::string& name, T value)
 {
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
     if (!m_cached_uniforms.contains(name))
-        m_cached_uniforms[name] = m_q_shader_program->uniformLocation(name.c_str());
+        m_cached_uniforms[name] = f->glGetUniformLocation(m_program->id(), name.c_str());
 
-    const auto uniform_location = m_cached_uniforms.at(name);
-    m_q_shader_program->setUniformValue(uniform_location, gl_engine::helpers::toQtType(value));
+    upload_uniform(f, m_cached_uniforms.at(name), value);
+}
+
+QString ShaderProgram::program_binary_path(const QString& vertex_code, const QString& fragment_code) const
+{
+    if (QCoreApplication::testAttribute(Qt::AA_DisableShaderDiskCache))
+        return {};
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    GLint n_formats = 0;
+    f->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+    if (n_formats <= 0) // e.g. webgl
+        return {};
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        hash.addData(QByteArray(reinterpret_cast<const char*>(f->glGetString(name))));
+    hash.addData(vertex_code.toUtf8());
+    hash.addData(fragment_code.toUtf8());
+    for (const auto& varying : m_feedback_varyings)
+        hash.addData(QByteArray::fromStdString(varying));
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/program_binaries";
+    QDir().mkpath(directory);
+    return directory + "/" + QString::fromLatin1(hash.result().toHex()) + ".bin";
 }
 
 QString ShaderProgram::load_and_preprocess_shader_code(gl_engine::ShaderType type) {
@@ -352,5 +723,5 @@ QString ShaderProgram::load_and_preprocess_shader_code(gl_engine::ShaderType typ
         code = read_file_content(code);
 
     preprocess_shader_content_inplace(code);
-    return make_versioned_shader_code(code);
+    return make_versioned_shader_code(m_defines + code);
 }
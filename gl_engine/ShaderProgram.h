@@ -24,12 +24,16 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <span>
+#include <type_traits>
 
 #include <glm/glm.hpp>
 #include <QOpenGLShaderProgram>
 #include <QUrl>
 #include <QDebug>
 
+#include "nucleus/utils/LruCache.h"
+
 #if ALP_ENABLE_SHADER_NETWORK_HOTRELOAD
 #include <functional>
 #include <QNetworkAccessManager>
@@ -49,12 +53,45 @@ enum class ShaderType {
 
 class ShaderProgram {
 private:
+    // a linked program, either from qt (using its program binary cache) or linked asynchronously with raw gl calls
+    struct LinkedProgram {
+        std::unique_ptr<QOpenGLShaderProgram> qt_program;
+        GLuint raw_program = 0;
+        std::vector<int> uniform_locations; // of m_uniform_names, resolved after link
+        size_t n_assigned_samplers = 0; // of m_sampler_units
+        LinkedProgram() = default;
+        LinkedProgram(const LinkedProgram&) = delete;
+        LinkedProgram& operator=(const LinkedProgram&) = delete;
+        ~LinkedProgram();
+        [[nodiscard]] GLuint id() const { return qt_program ? qt_program->programId() : raw_program; }
+    };
+    struct PendingCompile {
+        GLuint vertex_shader = 0;
+        GLuint fragment_shader = 0;
+        GLuint program = 0;
+        QString vertex_code;
+        QString fragment_code;
+        QString binary_path; // of the program binary, stored after link if it wasn't loaded from there
+        bool from_binary = false;
+        PendingCompile() = default;
+        PendingCompile(const PendingCompile&) = delete;
+        PendingCompile& operator=(const PendingCompile&) = delete;
+        ~PendingCompile(); // deletes the gl objects that weren't handed over
+    };
+
     std::unordered_map<std::string, int> m_cached_uniforms;
     std::unordered_map<std::string, int> m_cached_attribs;
-    std::unique_ptr<QOpenGLShaderProgram> m_q_shader_program;
+    std::vector<std::string> m_uniform_names; // of the handles, indexed by Uniform::index
+    std::vector<std::pair<std::string, int>> m_sampler_units;
+    std::shared_ptr<LinkedProgram> m_program;
+    std::unique_ptr<PendingCompile> m_pending;
     QString m_vertex_shader;    // either filename or native shader code
     QString m_fragment_shader;  // either filename or native shader code
     ShaderCodeSource m_code_source;
+    QString m_defines;
+    std::vector<std::string> m_feedback_varyings; // captured with transform feedback, set before linking
+    // linked programs by defines, so that switching between settings doesn't compile again
+    nucleus::utils::LruCache<QString, std::shared_ptr<LinkedProgram>> m_variants { 8 };
 
 #if ALP_ENABLE_SHADER_NETWORK_HOTRELOAD
     // A temporary cache for the downloaded shader files.
@@ -78,12 +115,48 @@ private:
 
     static QString get_qrc_or_path_prefix();
     static QString get_shader_code_version();
+    static QString get_shader_defines();
     static QByteArray make_versioned_shader_code(const QByteArray& src);
     static QByteArray make_versioned_shader_code(const QString& src);
     static void preprocess_shader_content_inplace(QString& base);
 
 public:
-    ShaderProgram(QString vertex_shader, QString fragment_shader, ShaderCodeSource code_source = ShaderCodeSource::FILE);
+    // with compile_async, the program is compiled with reload_async and can't be used before poll reported it as linked
+    ShaderProgram(QString vertex_shader, QString fragment_shader, ShaderCodeSource code_source = ShaderCodeSource::FILE, bool compile_async = false);
+    // outputs of the vertex shader that are captured with transform feedback (interleaved, in this order)
+    ShaderProgram(QString vertex_shader, QString fragment_shader, std::vector<std::string> feedback_varyings);
+
+    // starts compiling and linking from the (possibly changed) sources without waiting for the driver
+    // (GL_KHR_parallel_shader_compile). the current program stays in use until the new one is linked, see poll.
+    // without the extension the compilation happens in the next poll. like the synchronous path, a cached program binary
+    // is loaded instead of compiling if there is one.
+    void reload_async();
+    // finishes an asynchronous compilation if the driver is done. returns true if a new program was swapped in, the uniform
+    // block bindings must be set again then.
+    bool poll();
+    [[nodiscard]] bool is_linked() const { return bool(m_program); }
+    [[nodiscard]] bool is_compiling() const { return bool(m_pending); }
+    [[nodiscard]] static bool parallel_compile_supported();
+
+    // program specific defines (e.g. "#define FEATURE_SSAO_ENABLED true\n"), inserted after the shared defines. the program is
+    // recompiled, or taken from the variants that were linked before. if compilation fails, the previous program is kept.
+    // the uniform block bindings must be set again afterwards (UniformBuffer::bind_to_shader).
+    void set_defines(const QString& defines);
+    [[nodiscard]] const QString& defines() const { return m_defines; }
+
+    // handle of a uniform (see uniform()), that is set without looking up the name. it stays valid when the program is relinked
+    // (reload, set_defines), the locations are resolved once per linked program.
+    template <typename T>
+    struct Uniform {
+        unsigned index = unsigned(-1);
+        [[nodiscard]] bool valid() const { return index != unsigned(-1); }
+    };
+    // call once during setup, not per frame. for arrays, use the name of the first element (e.g. "matrices[0]").
+    template <typename T>
+    [[nodiscard]] Uniform<T> uniform(const std::string& name);
+    // texture unit of a sampler. it is assigned once after each link, the units are part of the program's layout and don't have
+    // to be set per draw (glsl es 3.0 has no layout(binding) for samplers).
+    void set_sampler_unit(const std::string& name, int unit);
 
     int attribute_location(const std::string& name);
     void bind();
@@ -102,6 +175,13 @@ public:
     void set_uniform_array(const std::string& name, const std::vector<glm::vec4>& array);
     void set_uniform_array(const std::string& name, const std::vector<glm::vec3>& array);
 
+    // the type is deduced from the handle only, so that e.g. an int literal can be passed for a Uniform<float>
+    template <typename T>
+    void set_uniform(Uniform<T> uniform, const std::type_identity_t<T>& value);
+    // uploads array.size() elements, starting at the location of the handle
+    template <typename T>
+    void set_uniform_array(Uniform<T> uniform, std::span<const std::type_identity_t<T>> array);
+
     static void reset_shader_cache();
 
 #if ALP_ENABLE_SHADER_NETWORK_HOTRELOAD
@@ -111,12 +191,23 @@ public:
 #endif
 
 public slots:
+    // compiles from the (possibly changed) sources, the linked variants are dropped
     void reload();
 private:
     template <typename T>
     void set_uniform_template(const std::string& name, T value);
 
     QString load_and_preprocess_shader_code(gl_engine::ShaderType type);
+    // of the raw gl programs. qt's program binary cache is private api, the files are kept next to it with the same keying
+    // (preprocessed sources and driver). an empty string if program binaries are not supported or the disk cache is disabled.
+    [[nodiscard]] QString program_binary_path(const QString& vertex_code, const QString& fragment_code) const;
+    // without the program binary cache, reports compile errors per shader. nullptr on failure.
+    std::unique_ptr<QOpenGLShaderProgram> compile_and_link(const QString& vertex_code, const QString& fragment_code) const;
+    bool compile_current_variant();
+    void set_feedback_varyings(GLuint program) const; // before linking
+    void use_program(std::shared_ptr<LinkedProgram> program);
+    // resolves the uniform locations and assigns the sampler units that were added since the last call
+    void resolve_layout(LinkedProgram& program) const;
 
 };
 }
@@ -18,11 +18,15 @@
  *****************************************************************************/
 #include "ShadowMapping.h"
 
+#include <algorithm>
 #include <random>
 #include <cmath>
+#include <limits>
+#include <QOpenGLContext>
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLTexture>
 #include "Framebuffer.h"
+#include "GlState.h"
 #include "ShaderProgram.h"
 #include "nucleus/tile_scheduler/DrawListGenerator.h"
 #include "TileManager.h"
@@ -31,73 +35,286 @@
 
 namespace gl_engine {
 
-ShadowMapping::ShadowMapping(std::shared_ptr<ShaderProgram> program, std::shared_ptr<UniformBuffer<uboShadowConfig>> shadow_config, std::shared_ptr<UniformBuffer<uboSharedConfig>> shared_config)
-    :m_shadow_program(program), m_shadow_config(shadow_config), m_shared_config(shared_config)
+namespace {
+// name of the extension that allows writing gl_ViewportIndex in the vertex shader, empty if not available. webgl and gles have
+// no viewport arrays (OVR_multiview renders into texture layers, but the cascades are viewports of a single atlas texture).
+QByteArray vertex_shader_viewport_extension()
 {
-     m_f = QOpenGLContext::currentContext()->extraFunctions();
-    for (int i = 0; i < SHADOW_CASCADES; i++) {
-        m_shadowmapbuffer.push_back(std::make_unique<Framebuffer>(Framebuffer::DepthFormat::Float32,
-            std::vector<Framebuffer::ColourFormat> {}, // no colour texture needed (=> depth only)
-            glm::uvec2(SHADOWMAP_WIDTH, SHADOWMAP_HEIGHT)));
+#ifdef __EMSCRIPTEN__
+    return {};
+#else
+    auto* context = QOpenGLContext::currentContext();
+    if (context->isOpenGLES())
+        return {};
+    if (context->format().version() < qMakePair(4, 1) && !context->hasExtension("GL_ARB_viewport_array"))
+        return {};
+    for (const auto* extension : { "GL_ARB_shader_viewport_layer_array", "GL_AMD_vertex_shader_viewport_index" }) {
+        if (context->hasExtension(extension))
+            return extension;
     }
+    return {};
+#endif
+}
+} // namespace
+
+ShadowMapping::Settings ShadowMapping::default_settings()
+{
+#if defined(__ANDROID__)
+    return { .resolution = 2048, .n_cascades = 3, .depth_format = Framebuffer::DepthFormat::Int24 };
+#elif defined(__EMSCRIPTEN__)
+    return { .resolution = 2048, .n_cascades = SHADOW_CASCADES, .depth_format = Framebuffer::DepthFormat::Int24 };
+#else
+    return {};
+#endif
+}
+
+ShadowMapping::ShadowMapping(std::shared_ptr<ShaderProgram> program, std::shared_ptr<UniformBuffer<uboShadowConfig>> shadow_config, std::shared_ptr<UniformBuffer<uboSharedConfig>> shared_config, const Settings& settings)
+    : m_settings(settings), m_shadow_program(program), m_shadow_config(shadow_config), m_shared_config(shared_config)
+{
+    m_f = QOpenGLContext::currentContext()->extraFunctions();
+
+    // the atlas texture itself keeps nearest filtering without comparison (for debug views), this sampler
+    // enables hardware pcf: every tap returns the bilinearly filtered result of 4 depth comparisons.
+    m_f->glGenSamplers(1, &m_compare_sampler);
+    m_f->glSamplerParameteri(m_compare_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_f->glSamplerParameteri(m_compare_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    m_f->glSamplerParameteri(m_compare_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    m_f->glSamplerParameteri(m_compare_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    m_f->glSamplerParameteri(m_compare_sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    m_f->glSamplerParameteri(m_compare_sampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    const auto extension = vertex_shader_viewport_extension();
+    if (!extension.isEmpty())
+        m_viewport_indexedf = reinterpret_cast<ViewportIndexedf>(QOpenGLContext::currentContext()->getProcAddress("glViewportIndexedf"));
+    if (m_viewport_indexedf) {
+        qDebug("shadow cascades are drawn at once (%s)", extension.constData());
+        m_shadow_program->set_defines(QString("#extension %1 : require\n#define SHADOW_VIEWPORT_ARRAY 1\n").arg(QString::fromLatin1(extension)));
+    }
+    m_uniforms.n_views = m_shadow_program->uniform<int>("n_views");
+    m_uniforms.view_cascades = m_shadow_program->uniform<int>("view_cascades");
+    m_uniforms.current_layer = m_shadow_program->uniform<int>("current_layer");
+
+    create_shadow_maps();
 }
 
 ShadowMapping::~ShadowMapping() {
+    m_f->glDeleteSamplers(1, &m_compare_sampler);
+}
+
+void ShadowMapping::create_shadow_maps()
+{
+    assert(m_settings.n_cascades >= 1 && m_settings.n_cascades <= SHADOW_CASCADES);
+    assert(m_settings.depth_format != Framebuffer::DepthFormat::None);
+    const auto n = m_settings.n_cascades;
+    m_atlas_grid = glm::uvec2(n > 1 ? 2 : 1, n > 2 ? 2 : 1);
+
+    GLint max_texture_size = 0;
+    m_f->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    m_cascade_resolution = std::min(m_settings.resolution, unsigned(max_texture_size) / std::max(m_atlas_grid.x, m_atlas_grid.y));
+    if (m_cascade_resolution != m_settings.resolution)
+        qDebug("shadow map resolution reduced to %u (GL_MAX_TEXTURE_SIZE = %i)", m_cascade_resolution, max_texture_size);
 
+    m_shadow_atlas.reset(); // allocated with the first draw, not at startup (and not at all while the shadows are off)
+    invalidate_cache();
+    m_next_far_cascade = 1;
 }
 
-void ShadowMapping::draw(
-        TileManager* tile_manager,
-        const nucleus::tile_scheduler::DrawListGenerator::TileSet draw_tileset,
-        const nucleus::camera::Definition& camera) {
+void ShadowMapping::allocate_shadow_atlas()
+{
+    m_shadow_atlas = std::make_unique<Framebuffer>(m_settings.depth_format,
+        std::vector<Framebuffer::ColourFormat> {}, // no colour texture needed (=> depth only)
+        m_atlas_grid * m_cascade_resolution);
+    m_shadow_atlas->set_memory_subsystem("shadow maps");
+}
+
+glm::uvec2 ShadowMapping::atlas_offset(unsigned cascade) const
+{
+    return glm::uvec2(cascade % m_atlas_grid.x, cascade / m_atlas_grid.x) * m_cascade_resolution;
+}
+
+const ShadowMapping::Settings& ShadowMapping::settings() const { return m_settings; }
+
+void ShadowMapping::set_settings(const Settings& new_settings)
+{
+    if (new_settings == m_settings)
+        return;
+    m_settings = new_settings;
+    m_settings.n_cascades = std::clamp(m_settings.n_cascades, 1u, unsigned(SHADOW_CASCADES));
+    create_shadow_maps();
+}
+
+unsigned ShadowMapping::n_cascades() const { return m_settings.n_cascades; }
+
+bool ShadowMapping::draws_cascades_at_once() const { return m_viewport_indexedf != nullptr; }
 
+void ShadowMapping::update_cascades(const nucleus::camera::Definition& camera, const std::vector<tile::SrsAndHeightBounds>& tile_bounds)
+{
     // NOTE: ReverseZ is not necessary for ShadowMapping since a directional light is using an orthographic projection
     // and therefore the distribution of depth is linear anyway.
 
     float far_plane = 100000; // Similar to camera?
     float near_plane = camera.near_plane(); // Similar to camera?
+    // with fewer cascades, the far ones are dropped (the last active cascade always reaches until far_plane)
+    const auto splits = std::array { far_plane / 50.0f, far_plane / 25.0f, far_plane / 10.0f };
+    const auto n = m_settings.n_cascades;
     m_shadow_config->data.cascade_planes[0].x = near_plane;
-    m_shadow_config->data.cascade_planes[1].x = far_plane / 50.0f;
-    m_shadow_config->data.cascade_planes[2].x = far_plane / 25.0f;
-    m_shadow_config->data.cascade_planes[3].x = far_plane / 10.0f;
-    m_shadow_config->data.cascade_planes[4].x = far_plane;
-    m_shadow_config->data.shadowmap_size = glm::vec2(SHADOWMAP_WIDTH, SHADOWMAP_HEIGHT);
+    for (unsigned i = 1; i <= SHADOW_CASCADES; ++i)
+        m_shadow_config->data.cascade_planes[i].x = i < n ? splits[i - 1] : far_plane;
+    m_shadow_config->data.shadowmap_size = glm::vec2(float(m_cascade_resolution));
+    m_shadow_config->data.cascade_count = n;
+    const auto atlas_size = glm::vec2(m_atlas_grid * m_cascade_resolution);
+    for (unsigned i = 0; i < n; ++i)
+        m_shadow_config->data.atlas_rect[i] = glm::vec4(glm::vec2(atlas_offset(i)) / atlas_size, glm::vec2(float(m_cascade_resolution)) / atlas_size);
 
     auto qlight_dir = m_shared_config->data.m_sun_light_dir;
-    auto light_dir = -glm::vec3(qlight_dir.x(), qlight_dir.y(), qlight_dir.z());
+    auto light_dir = -glm::dvec3(qlight_dir.x(), qlight_dir.y(), qlight_dir.z());
 
-    for (size_t i = 0; i < SHADOW_CASCADES; ++i)
-        m_shadow_config->data.light_space_view_proj_matrix[i] = getLightSpaceMatrix(m_shadow_config->data.cascade_planes[i].x, m_shadow_config->data.cascade_planes[i + 1].x, camera, light_dir);
+    // matrices are kept in world space, so that cached cascades stay valid when the camera origin moves.
+    for (size_t i = 0; i < n; ++i)
+        m_cascade_world_to_clip[i] = getLightSpaceMatrix(m_shadow_config->data.cascade_planes[i].x, m_shadow_config->data.cascade_planes[i + 1].x, camera, light_dir, tile_bounds, m_cascade_resolution);
+}
 
-    m_shadow_config->update_gpu_data();
+bool ShadowMapping::cascade_needs_update(const Cascade& rendered, const glm::dmat4& world_to_clip, const nucleus::tile_scheduler::DrawListGenerator::TileSet& tiles) const
+{
+    if (!rendered.valid || rendered.tiles != tiles)
+        return true;
 
-    m_f->glEnable(GL_DEPTH_TEST);
-    m_f->glDepthFunc(GL_LESS);
-    m_f->glDisable(GL_CULL_FACE);
+    // map the corners of the new light volume into the clip space of the rendered one. if they move less than a texel
+    // (and the depth range stays practically the same), the cached shadow map is still good.
+    const auto desired_to_rendered = rendered.world_to_clip * glm::inverse(world_to_clip);
+    for (const auto x : { -1.0, 1.0 }) {
+        for (const auto y : { -1.0, 1.0 }) {
+            for (const auto z : { -1.0, 1.0 }) {
+                auto p = desired_to_rendered * glm::dvec4(x, y, z, 1.0);
+                p /= p.w;
+                if (std::abs(p.x - x) * m_cascade_resolution * 0.5 > 1.0 || std::abs(p.y - y) * m_cascade_resolution * 0.5 > 1.0 || std::abs(p.z - z) > 0.001)
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ShadowMapping::draw(TileManager* tile_manager,
+    std::span<const TileManager::DrawRange> cascade_ranges,
+    std::span<const nucleus::tile_scheduler::DrawListGenerator::TileSet> cascade_tiles,
+    const nucleus::camera::Definition& camera,
+    const TileManager::DrawRange* all_cascades_range)
+{
+    const auto n = m_settings.n_cascades;
+    assert(cascade_ranges.size() == n);
+    assert(cascade_tiles.size() == n);
+
+    // the near cascade is rendered whenever it changed. of the far cascades, at most one is refreshed per frame (round robin),
+    // unless it was never rendered. for static views and sun, nothing is rendered at all. while the far cascade refresh is
+    // disabled, none of them is refreshed, and all that are out of date are refreshed at once when it is enabled again.
+    std::array<bool, SHADOW_CASCADES> render_cascade = {};
+    for (unsigned i = 0; i < n; ++i) {
+        const auto& rendered = m_rendered_cascades[i];
+        if (!cascade_needs_update(rendered, m_cascade_world_to_clip[i], cascade_tiles[i]))
+            continue;
+        render_cascade[i] = (i == 0 || !rendered.valid);
+    }
+    for (unsigned j = 1; j < n && m_far_cascade_refresh; ++j) {
+        const auto i = m_next_far_cascade;
+        m_next_far_cascade = m_next_far_cascade % (n - 1) + 1;
+        if (render_cascade[i])
+            continue;
+        if (cascade_needs_update(m_rendered_cascades[i], m_cascade_world_to_clip[i], cascade_tiles[i])) {
+            render_cascade[i] = true;
+            if (!m_far_cascades_stale)
+                break;
+        }
+    }
+    m_far_cascades_stale = !m_far_cascade_refresh;
+
+    for (unsigned i = 0; i < n; ++i) {
+        if (!render_cascade[i])
+            continue;
+        m_rendered_cascades[i].world_to_clip = m_cascade_world_to_clip[i];
+        m_rendered_cascades[i].tiles = cascade_tiles[i];
+        m_rendered_cascades[i].valid = true;
+    }
+
+    // the shader works in camera local coordinates, so the (possibly cached) world matrices are shifted to the current camera origin.
+    const auto world_to_camera_local = glm::translate(glm::dmat4(1.0), camera.position());
+    for (unsigned i = 0; i < n; ++i)
+        m_shadow_config->data.light_space_view_proj_matrix[i] = glm::mat4(m_rendered_cascades[i].world_to_clip * world_to_camera_local);
+    m_shadow_config->update_gpu_data(); // no upload if neither the cascades nor the camera moved
+
+    if (std::none_of(render_cascade.begin(), render_cascade.end(), [](bool b) { return b; }))
+        return;
+
+    if (!m_shadow_atlas)
+        allocate_shadow_atlas();
+    auto& state = GlState::current();
+    state.set_enabled(GL_DEPTH_TEST, true);
+    state.set_depth_func(GL_LESS);
+    state.set_enabled(GL_CULL_FACE, false);
     m_shadow_program->bind();
-    for (int i = 0; i < SHADOW_CASCADES; i++) {
-        m_shadowmapbuffer[i]->bind();
-        m_f->glClearColor(0, 0, 0, 0);
-        m_f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        m_shadow_program->set_uniform("current_layer", i);
-        tile_manager->draw(m_shadow_program.get(), camera, draw_tileset, false, glm::dvec3(0.0));
-        m_shadowmapbuffer[i]->unbind();
+    // a single framebuffer for all cascades, the scissor restricts the clear to the cascade's part of the atlas.
+    m_shadow_atlas->bind();
+    state.set_enabled(GL_SCISSOR_TEST, true);
+    if (all_cascades_range && draws_cascades_at_once()) {
+        // one draw for all re-rendered cascades: every tile of the union is repeated once per cascade and routed to its viewport.
+        // tiles outside of a cascade are clipped, which costs vertex work, but saves the per cascade state changes and draws.
+        unsigned n_views = 0;
+        int view_cascades = 0;
+        for (unsigned i = 0; i < n; i++) {
+            if (!render_cascade[i])
+                continue;
+            const auto offset = atlas_offset(i);
+            m_viewport_indexedf(GLuint(i), GLfloat(offset.x), GLfloat(offset.y), GLfloat(m_cascade_resolution), GLfloat(m_cascade_resolution));
+            m_f->glScissor(GLint(offset.x), GLint(offset.y), GLsizei(m_cascade_resolution), GLsizei(m_cascade_resolution));
+            m_f->glClear(GL_DEPTH_BUFFER_BIT);
+            view_cascades |= int(i) << (2 * n_views);
+            ++n_views;
+        }
+        // the scissor test applies per viewport index as well, open it up for the whole atlas
+        const auto atlas_size = m_atlas_grid * m_cascade_resolution;
+        m_f->glScissor(0, 0, GLsizei(atlas_size.x), GLsizei(atlas_size.y));
+        m_shadow_program->set_uniform(m_uniforms.n_views, int(n_views));
+        m_shadow_program->set_uniform(m_uniforms.view_cascades, view_cascades);
+        tile_manager->draw(*all_cascades_range, n_views);
+        m_f->glViewport(0, 0, GLsizei(atlas_size.x), GLsizei(atlas_size.y)); // also resets the viewports of the other indices
+        state.invalidate_framebuffer(); // the indexed viewports are not tracked
+    } else {
+        for (unsigned i = 0; i < n; i++) {
+            if (!render_cascade[i])
+                continue;
+            const auto offset = atlas_offset(i);
+            state.set_viewport({ GLint(offset.x), GLint(offset.y), GLsizei(m_cascade_resolution), GLsizei(m_cascade_resolution) });
+            m_f->glScissor(GLint(offset.x), GLint(offset.y), GLsizei(m_cascade_resolution), GLsizei(m_cascade_resolution));
+            m_f->glClear(GL_DEPTH_BUFFER_BIT);
+
+            m_shadow_program->set_uniform(m_uniforms.current_layer, int(i));
+            tile_manager->draw(cascade_ranges[i]);
+        }
     }
+    state.set_enabled(GL_SCISSOR_TEST, false);
+    m_shadow_atlas->unbind();
     m_shadow_program->release();
-    m_f->glEnable(GL_CULL_FACE);
+    state.set_enabled(GL_CULL_FACE, true);
 }
 
-void ShadowMapping::bind_shadow_maps(ShaderProgram* p, unsigned int start_location) {
-    for (int i = 0; i < SHADOW_CASCADES; i++) {
-        std::string uname = "texin_csm";
-        uname.append(std::to_string(i+1));
-        unsigned int location = start_location + i;
-        p->set_uniform(uname, location);
-        m_shadowmapbuffer[i]->bind_depth_texture(location);
-    }
+void ShadowMapping::invalidate_cache()
+{
+    for (auto& cascade : m_rendered_cascades)
+        cascade.valid = false;
 }
 
+void ShadowMapping::set_far_cascade_refresh(bool enabled) { m_far_cascade_refresh = enabled; }
+
+void ShadowMapping::bind_shadow_maps(unsigned int start_location) {
+    m_f->glBindSampler(start_location, m_compare_sampler);
+    if (!m_shadow_atlas)
+        return; // the shadows are off, the shaders don't sample it
+    m_shadow_atlas->bind_depth_texture(start_location);
+    m_shadow_atlas->bind_depth_texture(start_location + 1);
+}
+
+void ShadowMapping::release_shadow_maps(unsigned int start_location) { m_f->glBindSampler(start_location, 0); }
+
 std::vector<glm::vec4> ShadowMapping::getFrustumCornersWorldSpace(const glm::mat4& projview)
 {
     const auto inv = glm::inverse(projview);
@@ -117,55 +334,77 @@ std::vector<glm::vec4> ShadowMapping::getFrustumCornersWorldSpace(const glm::mat
     return getFrustumCornersWorldSpace(proj * view);
 }
 
-glm::mat4 ShadowMapping::getLightSpaceMatrix(const float nearPlane, const float farPlane, const nucleus::camera::Definition& camera, const glm::vec3& light_dir)
+glm::dmat4 ShadowMapping::getLightSpaceMatrix(const float nearPlane, const float farPlane, const nucleus::camera::Definition& camera, const glm::dvec3& light_dir, const std::vector<tile::SrsAndHeightBounds>& tile_bounds, unsigned cascade_resolution)
 {
     const auto fb_size = camera.viewport_size();
     const auto proj = glm::perspective(glm::radians(camera.field_of_view()), (float)fb_size.x / (float)fb_size.y, nearPlane, farPlane);
     const auto corners = getFrustumCornersWorldSpace(proj, camera.local_view_matrix());
 
-    glm::vec3 center = glm::vec3(0, 0, 0);
+    // bounding sphere of the frustum slice. its radius only depends on the planes and the field of view, so the size of
+    // the light volume doesn't change when the camera rotates. rounding up to whole metres absorbs float noise.
+    glm::dvec3 center = glm::dvec3(0, 0, 0);
     for (const auto& v : corners)
-        center += glm::vec3(v);
-    center /= corners.size();
-
-    const glm::dmat4 lightView = glm::lookAt(center + light_dir, center, glm::vec3(0.0f, 0.0f, 1.0f));
-
-    double minX = std::numeric_limits<double>::max();
-    double maxX = std::numeric_limits<double>::lowest();
-    double minY = std::numeric_limits<double>::max();
-    double maxY = std::numeric_limits<double>::lowest();
-    double minZ = std::numeric_limits<double>::max();
-    double maxZ = std::numeric_limits<double>::lowest();
+        center += glm::dvec3(v);
+    center /= double(corners.size());
+    double radius = 0;
     for (const auto& v : corners)
-    {
-        const auto trf = lightView * v;
-        minX = std::min(minX, trf.x);
-        maxX = std::max(maxX, trf.x);
-        minY = std::min(minY, trf.y);
-        maxY = std::max(maxY, trf.y);
-        minZ = std::min(minZ, trf.z);
-        maxZ = std::max(maxZ, trf.z);
-    }
+        radius = std::max(radius, glm::distance(center, glm::dvec3(v)));
+    radius = std::ceil(radius);
+    center += camera.position(); // world space from here on
+
+    // the orientation of the light space only depends on the light direction. the light looks away from the sun, so +z points
+    // towards it (the casters have larger z than their receivers).
+    const auto up = std::abs(light_dir.z) > 0.99 ? glm::dvec3(0, 1, 0) : glm::dvec3(0, 0, 1);
+    const glm::dmat4 lightView = glm::lookAt(glm::dvec3(0, 0, 0), -light_dir, up);
 
-    // Tune this parameter according to the scene
-    constexpr float zMult = 10.0f;
+    // snap the center to whole texels, so that the shadow map content moves in texel steps (no shimmering).
+    auto center_ls = glm::dvec3(lightView * glm::dvec4(center, 1.0));
+    const auto texel_size = 2.0 * radius / double(cascade_resolution);
+    center_ls.x = std::floor(center_ls.x / texel_size) * texel_size;
+    center_ls.y = std::floor(center_ls.y / texel_size) * texel_size;
 
-    if (minZ < 0) minZ *= zMult;
-    else minZ /= zMult;
+    // depth range (light view looks along -z): receivers are within the sphere, casters can be anywhere between the sphere and the light.
+    // tiles overlapping the light volume in xy bound both ends, so no depth precision is wasted on empty space.
+    double z_towards_light = std::numeric_limits<double>::lowest();
+    double z_away_from_light = std::numeric_limits<double>::max();
+    for (const auto& aabb : tile_bounds) {
+        glm::dvec3 min_ls = glm::dvec3(std::numeric_limits<double>::max());
+        glm::dvec3 max_ls = glm::dvec3(std::numeric_limits<double>::lowest());
+        for (const auto x : { aabb.min.x, aabb.max.x }) {
+            for (const auto y : { aabb.min.y, aabb.max.y }) {
+                for (const auto z : { aabb.min.z, aabb.max.z }) {
+                    const auto p = glm::dvec3(lightView * glm::dvec4(x, y, z, 1.0));
+                    min_ls = glm::min(min_ls, p);
+                    max_ls = glm::max(max_ls, p);
+                }
+            }
+        }
+        if (max_ls.x < center_ls.x - radius || min_ls.x > center_ls.x + radius || max_ls.y < center_ls.y - radius || min_ls.y > center_ls.y + radius)
+            continue;
+        z_towards_light = std::max(z_towards_light, max_ls.z);
+        z_away_from_light = std::min(z_away_from_light, min_ls.z);
+    }
+    if (z_towards_light < z_away_from_light) { // no tiles, use the sphere
+        z_towards_light = center_ls.z + radius;
+        z_away_from_light = center_ls.z - radius;
+    }
+    z_away_from_light = std::max(z_away_from_light, center_ls.z - radius);
+    z_towards_light = std::max(z_towards_light, z_away_from_light + 1.0);
 
-    if (maxZ < 0) maxZ /= zMult;
-    else maxZ *= zMult;
+    // quantise the depth range, so it stays the same for small changes of the tile set or camera (keeps cached cascades valid)
+    const auto z_step = radius / 16.0;
+    z_towards_light = std::ceil(z_towards_light / z_step + 1.0) * z_step;
+    z_away_from_light = std::floor(z_away_from_light / z_step - 1.0) * z_step;
 
-    const glm::dmat4 lightProjection = glm::ortho(minX, maxX, minY, maxY, minZ, maxZ);
-    return lightProjection * lightView;// * glm::translate(camera.position());
+    const glm::dmat4 lightProjection = glm::ortho(center_ls.x - radius, center_ls.x + radius, center_ls.y - radius, center_ls.y + radius, -z_towards_light, -z_away_from_light);
+    return lightProjection * lightView;
 }
 
-nucleus::camera::Frustum ShadowMapping::getFrustum([[maybe_unused]] const nucleus::camera::Definition& camera)
+nucleus::camera::Frustum ShadowMapping::getFrustum(unsigned cascade) const
 {
-    auto frustum = nucleus::camera::Frustum();
-    //TODO set clipping planes and corners according to light source's view frustum
-    // this would be a box covering the entire camera view frustum
-    return frustum;
+    // the box covers the cascade's part of the camera frustum, and extends towards the light, so it also contains the casters.
+    assert(cascade < m_settings.n_cascades);
+    return nucleus::camera::frustum_from_matrix(m_cascade_world_to_clip[cascade]);
 }
 
 }
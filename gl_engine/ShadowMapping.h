@@ -18,17 +18,23 @@
  *****************************************************************************/
 #pragma once
 
+#include <array>
 #include <vector>
 #include <glm/glm.hpp>
 #include <memory>
+#include <span>
+#include <QOpenGLFunctions>
 
 #include "nucleus/camera/Definition.h"
 #include "nucleus/tile_scheduler/DrawListGenerator.h"
+#include "Framebuffer.h"
+#include "ShaderProgram.h"
+#include "TileManager.h"
 #include "UniformBuffer.h"
 
-#define SHADOWMAP_WIDTH 4096
-#define SHADOWMAP_HEIGHT 4096
-#define SHADOW_CASCADES 4           // HAS TO BE THE SAME AS IN shadow_config.glsl!!
+// maximum number of cascades (size of the arrays in uboShadowConfig). it is injected into all shaders by ShaderProgram,
+// the number of active cascades is a runtime setting.
+#define SHADOW_CASCADES 4
 
 class QOpenGLTexture;
 class QOpenGLExtraFunctions;
@@ -36,42 +42,105 @@ class QOpenGLExtraFunctions;
 
 namespace gl_engine {
 
-class Framebuffer;
-class ShaderProgram;
-class TileManager;
 struct uboSharedConfig;
 struct uboShadowConfig;
 
 class ShadowMapping
 {
 public:
+    struct Settings {
+        unsigned resolution = 4096;
+        unsigned n_cascades = SHADOW_CASCADES; // 1 to SHADOW_CASCADES
+        Framebuffer::DepthFormat depth_format = Framebuffer::DepthFormat::Float32;
+        bool operator==(const Settings&) const = default;
+    };
+    // memory and bandwidth budget depends on the device class
+    static Settings default_settings();
 
     ShadowMapping(std::shared_ptr<ShaderProgram> program,
                   std::shared_ptr<UniformBuffer<uboShadowConfig>> shadow_config,
-                  std::shared_ptr<UniformBuffer<uboSharedConfig>> shared_config);
+                  std::shared_ptr<UniformBuffer<uboSharedConfig>> shared_config,
+                  const Settings& settings = default_settings());
 
     ~ShadowMapping();
 
-    void draw(
-        TileManager* tile_manager,
-        const nucleus::tile_scheduler::DrawListGenerator::TileSet draw_tileset,
-        const nucleus::camera::Definition& camera);
-
-    void bind_shadow_maps(ShaderProgram* program, unsigned int start_location);
-    nucleus::camera::Frustum getFrustum(const nucleus::camera::Definition& camera);
+    // computes the light volumes of all cascades for this frame. tile_bounds (world space) are used to fit the depth range
+    // tightly around the terrain, typically the bounds of the whole draw list (so casters outside the camera view are included).
+    void update_cascades(const nucleus::camera::Definition& camera, const std::vector<tile::SrsAndHeightBounds>& tile_bounds);
+    // expects update_cascades and tile_manager->prepare_draw to be called for this frame, one range and tile set per cascade.
+    // cascades are cached and only re-rendered if their light volume moved by more than a texel or their tiles changed.
+    // if draws_cascades_at_once(), all_cascades_range (the union of the cascade tile sets) is drawn once for all re-rendered
+    // cascades, instead of one draw per cascade.
+    void draw(TileManager* tile_manager,
+        std::span<const TileManager::DrawRange> cascade_ranges,
+        std::span<const nucleus::tile_scheduler::DrawListGenerator::TileSet> cascade_tiles,
+        const nucleus::camera::Definition& camera,
+        const TileManager::DrawRange* all_cascades_range = nullptr);
+    // forces a re-render of all cascades in the next frame
+    void invalidate_cache();
+    // if disabled, the far cascades keep their cached maps (unless they were never rendered), e.g., while the camera moves.
+    // the first frame after enabling it again refreshes all far cascades that are out of date.
+    void set_far_cascade_refresh(bool enabled);
+
+    [[nodiscard]] const Settings& settings() const;
+    // recreates the shadow maps if necessary
+    void set_settings(const Settings& new_settings);
+    [[nodiscard]] unsigned n_cascades() const;
+    // the vertex shader can select the viewport (desktop gl with GL_ARB_shader_viewport_layer_array or GL_AMD_vertex_shader_viewport_index),
+    // so that all cascades are rasterised by a single instanced draw.
+    [[nodiscard]] bool draws_cascades_at_once() const;
+
+    // binds the atlas to start_location (with hardware depth comparison, texin_csm) and start_location + 1 (raw depth, texin_csm_depth).
+    // the units must match the sampler layout of the program (see ShaderManager).
+    void bind_shadow_maps(unsigned int start_location);
+    // restores the sampler state of the texture units used by bind_shadow_maps
+    void release_shadow_maps(unsigned int start_location);
+    // world space volume of a cascade (valid after update_cascades), used for culling
+    nucleus::camera::Frustum getFrustum(unsigned cascade) const;
+    // world to clip matrix of the cascade covering [nearPlane, farPlane] of the camera frustum. the light volume is fitted around a bounding
+    // sphere and snapped to texels, so it is invariant to camera rotation and moves in whole texels only (no shimmering, cachable).
+    // light_dir points towards the sun. depth increases away from the light, so casters have smaller depth than their receivers.
+    static glm::dmat4 getLightSpaceMatrix(const float nearPlane, const float farPlane, const nucleus::camera::Definition& camera, const glm::dvec3& light_dir, const std::vector<tile::SrsAndHeightBounds>& tile_bounds, unsigned cascade_resolution);
 
 private:
+    struct Cascade {
+        glm::dmat4 world_to_clip = glm::dmat4(1.0);
+        nucleus::tile_scheduler::DrawListGenerator::TileSet tiles;
+        bool valid = false;
+    };
+    bool cascade_needs_update(const Cascade& rendered, const glm::dmat4& world_to_clip, const nucleus::tile_scheduler::DrawListGenerator::TileSet& tiles) const;
+    void create_shadow_maps();
+    void allocate_shadow_atlas();
+    // position of the cascade in the atlas, in texels
+    glm::uvec2 atlas_offset(unsigned cascade) const;
+
+    Settings m_settings;
+    unsigned m_cascade_resolution = 0; // may be smaller than requested, if the atlas would exceed GL_MAX_TEXTURE_SIZE
+    glm::uvec2 m_atlas_grid = {};
+
+    std::array<glm::dmat4, SHADOW_CASCADES> m_cascade_world_to_clip = {}; // desired for this frame
+    std::array<Cascade, SHADOW_CASCADES> m_rendered_cascades; // contents of the shadow maps
+    unsigned m_next_far_cascade = 1;
+    bool m_far_cascade_refresh = true;
+    bool m_far_cascades_stale = false; // the refresh was disabled in the previous frame
+
+    using ViewportIndexedf = void(QOPENGLF_APIENTRYP)(GLuint index, GLfloat x, GLfloat y, GLfloat w, GLfloat h);
+    ViewportIndexedf m_viewport_indexedf = nullptr; // only resolved if the shader can write gl_ViewportIndex
 
     std::shared_ptr<ShaderProgram> m_shadow_program;
-    std::vector<std::unique_ptr<Framebuffer>> m_shadowmapbuffer;
+    struct {
+        ShaderProgram::Uniform<int> n_views;
+        ShaderProgram::Uniform<int> view_cascades;
+        ShaderProgram::Uniform<int> current_layer;
+    } m_uniforms;
+    std::unique_ptr<Framebuffer> m_shadow_atlas; // all cascades in one depth texture, one viewport per cascade
+    unsigned m_compare_sampler = 0;
     std::shared_ptr<UniformBuffer<uboShadowConfig>> m_shadow_config;
     std::shared_ptr<UniformBuffer<uboSharedConfig>> m_shared_config;
     QOpenGLExtraFunctions *m_f;
 
-    std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& projview);
-    std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view);
-    glm::mat4 getLightSpaceMatrix(const float nearPlane, const float farPlane, const nucleus::camera::Definition& camera, const glm::vec3& light_dir);
-    std::vector<glm::mat4> getLightSpaceMatrices(const nucleus::camera::Definition& camera, const glm::vec3& light_dir);
+    static std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& projview);
+    static std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view);
 
 };
 
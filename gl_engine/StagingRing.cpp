@@ -0,0 +1,184 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace {
+// covers GL_UNPACK_ALIGNMENT and GL_MIN_MAP_BUFFER_ALIGNMENT (64)
+constexpr size_t region_alignment = 256;
+using BufferStorage = void(QOPENGLF_APIENTRYP)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+bool overlaps(size_t begin_a, size_t end_a, size_t begin_b, size_t end_b) { return begin_a < end_b && begin_b < end_a; }
+
+void copy_pieces(uint8_t* destination, std::span<const std::pair<const void*, size_t>> pieces)
+{
+    for (const auto& [data, n_bytes] : pieces) {
+        std::memcpy(destination, data, n_bytes);
+        destination += n_bytes;
+    }
+}
+} // namespace
+
+bool gl_engine::StagingRing::is_supported()
+{
+#if defined(__EMSCRIPTEN__)
+    return false; // webgl has no mapping, and bufferSubData is a copy anyway
+#else
+    const auto* context = QOpenGLContext::currentContext();
+    if (!context)
+        return false;
+    if (context->isOpenGLES())
+        return context->format().majorVersion() >= 3;
+    return context->format().version() >= qMakePair(3, 0) || context->hasExtension("GL_ARB_map_buffer_range");
+#endif
+}
+
+gl_engine::StagingRing::StagingRing(size_t n_bytes)
+    : m_n_bytes(n_bytes)
+{
+    assert(is_supported());
+    m_memory.set_n_bytes(n_bytes);
+    auto* context = QOpenGLContext::currentContext();
+    auto* f = context->extraFunctions();
+    f->glGenBuffers(1, &m_buffer);
+    f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+    // on gles (EXT_buffer_storage is exposed by most android drivers) the mapping is written directly, instead of a copy that
+    // some drivers make of unsynchronised mappings on unmap
+    const auto* buffer_storage_name = "";
+    if (context->isOpenGLES() && context->hasExtension("GL_EXT_buffer_storage"))
+        buffer_storage_name = "glBufferStorageEXT";
+    else if (!context->isOpenGLES() && (context->format().version() >= qMakePair(4, 4) || context->hasExtension("GL_ARB_buffer_storage")))
+        buffer_storage_name = "glBufferStorage";
+    const auto buffer_storage = *buffer_storage_name ? reinterpret_cast<BufferStorage>(context->getProcAddress(buffer_storage_name)) : nullptr;
+    if (buffer_storage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer_storage(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(n_bytes), nullptr, flags);
+        m_persistent_mapping = f->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(n_bytes), flags);
+        if (!m_persistent_mapping) {
+            // immutable storage can't be respecified, start over with a plain buffer
+            f->glDeleteBuffers(1, &m_buffer);
+            f->glGenBuffers(1, &m_buffer);
+            f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+        }
+    }
+    if (!m_persistent_mapping)
+        f->glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(n_bytes), nullptr, GL_STREAM_DRAW);
+    f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+gl_engine::StagingRing::~StagingRing()
+{
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (size_t i = 0; i < m_in_flight.size(); ++i) {
+        if (i + 1 == m_in_flight.size() || m_in_flight[i + 1].fence != m_in_flight[i].fence)
+            f->glDeleteSync(m_in_flight[i].fence);
+    }
+    if (m_persistent_mapping) {
+        f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+        f->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    f->glDeleteBuffers(1, &m_buffer);
+}
+
+std::optional<size_t> gl_engine::StagingRing::stage(const void* data, size_t n_bytes)
+{
+    const auto piece = std::pair { data, n_bytes };
+    return stage(std::span { &piece, 1 });
+}
+
+std::optional<size_t> gl_engine::StagingRing::stage(std::span<const std::pair<const void*, size_t>> pieces)
+{
+    size_t n_bytes = 0;
+    for (const auto& piece : pieces)
+        n_bytes += piece.second;
+    const auto size = (n_bytes + region_alignment - 1) / region_alignment * region_alignment;
+    if (size > m_n_bytes)
+        return {};
+    if (m_head + size > m_n_bytes)
+        m_head = 0;
+    const auto begin = m_head;
+    wait_for(begin, begin + size);
+
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    if (m_persistent_mapping) {
+        copy_pieces(static_cast<uint8_t*>(m_persistent_mapping) + begin, pieces);
+    } else {
+        // unsynchronised, the fences make sure that the gpu is done with the region
+        auto* mapped = f->glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, GLintptr(begin), GLsizeiptr(n_bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!mapped) {
+            f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return {};
+        }
+        copy_pieces(static_cast<uint8_t*>(mapped), pieces);
+        f->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    m_unfenced.emplace_back(begin, begin + size);
+    m_head = begin + size;
+    return begin;
+}
+
+void gl_engine::StagingRing::finish_uploads()
+{
+    fence_unfenced();
+    QOpenGLContext::currentContext()->extraFunctions()->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void gl_engine::StagingRing::fence_unfenced()
+{
+    if (m_unfenced.empty())
+        return;
+    auto* fence = QOpenGLContext::currentContext()->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    for (const auto& [begin, end] : m_unfenced)
+        m_in_flight.push_back({ begin, end, fence });
+    m_unfenced.clear();
+}
+
+void gl_engine::StagingRing::wait_for(size_t begin, size_t end)
+{
+    // only if more than the whole ring is staged between two finish_uploads calls
+    if (std::any_of(m_unfenced.begin(), m_unfenced.end(), [&](const auto& r) { return overlaps(r.first, r.second, begin, end); }))
+        fence_unfenced();
+
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    while (std::any_of(m_in_flight.begin(), m_in_flight.end(), [&](const Region& r) { return overlaps(r.begin, r.end, begin, end); })) {
+        const auto fence = m_in_flight.front().fence;
+        // the fences are signalled in order, so waiting for the oldest one first doesn't wait longer than necessary
+        while (f->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED) { }
+        while (!m_in_flight.empty() && m_in_flight.front().fence == fence)
+            m_in_flight.pop_front();
+        f->glDeleteSync(fence);
+    }
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include <qopengl.h>
+#ifdef ANDROID
+#include <GLES3/gl3.h>
+#endif
+
+#include "GpuMemory.h"
+
+namespace gl_engine {
+
+/// Ring buffer of pixel unpack memory for texture uploads. The data is copied into mapped buffer memory (persistently mapped
+/// with GL_ARB_buffer_storage / gl 4.4 or GL_EXT_buffer_storage on gles, otherwise mapped unsynchronised per upload), and glTex(Sub)Image then reads from the
+/// buffer, i.e., the driver can dma the data instead of copying client memory synchronously on the render thread.
+/// Regions are recycled once the fence behind them is signalled. Not available on WebGL (no buffer mapping), see is_supported().
+class StagingRing {
+public:
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+    explicit StagingRing(size_t n_bytes);
+    ~StagingRing();
+
+    [[nodiscard]] static bool is_supported();
+    [[nodiscard]] bool is_persistently_mapped() const { return m_persistent_mapping != nullptr; }
+    [[nodiscard]] size_t n_bytes() const { return m_n_bytes; }
+
+    /// copies the data into the ring and binds the buffer to GL_PIXEL_UNPACK_BUFFER. returns the offset, which is to be passed
+    /// as the pointer to the gl upload call. nullopt (and nothing bound) if the data doesn't fit, then upload from client memory.
+    [[nodiscard]] std::optional<size_t> stage(const void* data, size_t n_bytes);
+    /// same, the pieces are copied next to each other (e.g., consecutive layers of an array for one upload call)
+    [[nodiscard]] std::optional<size_t> stage(std::span<const std::pair<const void*, size_t>> pieces);
+    /// fences the regions staged since the last call and unbinds the buffer. call it after the upload commands.
+    void finish_uploads();
+
+private:
+    struct Region {
+        size_t begin;
+        size_t end;
+        GLsync fence;
+    };
+    GLuint m_buffer = 0;
+    size_t m_n_bytes = 0;
+    size_t m_head = 0;
+    void* m_persistent_mapping = nullptr;
+    std::vector<std::pair<size_t, size_t>> m_unfenced;
+    std::deque<Region> m_in_flight; // oldest first, consecutive regions can share a fence
+    gpu_memory::Allocation m_memory { "staging buffers" };
+
+    void fence_unfenced();
+    void wait_for(size_t begin, size_t end);
+};
+
+} // namespace gl_engine
@@ -0,0 +1,118 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "TemporalUpsampling.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <glm/gtx/transform.hpp>
+
+#include "Framebuffer.h"
+#include "ShaderProgram.h"
+
+namespace gl_engine {
+
+namespace {
+    double halton(unsigned index, unsigned base)
+    {
+        double result = 0;
+        double fraction = 1.0;
+        for (; index > 0; index /= base) {
+            fraction /= base;
+            result += fraction * (index % base);
+        }
+        return result;
+    }
+} // namespace
+
+TemporalUpsampling::TemporalUpsampling(std::shared_ptr<ShaderProgram> program)
+    : m_program(std::move(program))
+{
+    m_f = QOpenGLContext::currentContext()->extraFunctions();
+    m_uniforms.reprojection_matrix = m_program->uniform<glm::mat4>("reprojection_matrix");
+    m_uniforms.jitter_uv = m_program->uniform<glm::vec2>("jitter_uv");
+    m_uniforms.current_weight = m_program->uniform<float>("current_weight");
+    m_uniforms.history_valid = m_program->uniform<int>("history_valid");
+    for (auto& history : m_history_buffers) {
+        history = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::RGBA8 });
+        history->set_memory_subsystem("temporal upsampling");
+    }
+    m_f->glGenSamplers(1, &m_history_sampler);
+    m_f->glSamplerParameteri(m_history_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_f->glSamplerParameteri(m_history_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    m_f->glSamplerParameteri(m_history_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    m_f->glSamplerParameteri(m_history_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+TemporalUpsampling::~TemporalUpsampling() { m_f->glDeleteSamplers(1, &m_history_sampler); }
+
+glm::dvec2 TemporalUpsampling::next_jitter(const glm::uvec2& internal_size)
+{
+    // the sequence starts at 1, halton(0) would be the corner of the pixel
+    const auto phase = m_frame_index % TEMPORAL_UPSAMPLING_JITTER_PHASES + 1;
+    const auto pixel_offset = glm::dvec2(halton(phase, 2), halton(phase, 3)) - 0.5;
+    m_jitter = pixel_offset * 2.0 / glm::dvec2(internal_size);
+    return m_jitter;
+}
+
+Framebuffer* TemporalUpsampling::resolve(Framebuffer* composed,
+    Framebuffer* gbuffer,
+    helpers::ScreenQuadGeometry* geometry,
+    const nucleus::camera::Definition& camera,
+    const glm::uvec2& output_size)
+{
+    auto* history = m_history_buffers[m_frame_index % 2].get();
+    auto* previous_history = m_history_buffers[(m_frame_index + 1) % 2].get();
+    if (history->size() != output_size) {
+        for (auto& buffer : m_history_buffers)
+            buffer->resize(output_size);
+        m_history_valid = false;
+    }
+    const auto world_view_projection = camera.world_view_projection_matrix();
+    m_static_frames = (m_history_valid && world_view_projection == m_previous_world_view_projection) ? m_static_frames + 1 : 0;
+
+    auto* p = m_program.get();
+    p->bind();
+    // texture units as in the sampler layout of the program (see ShaderManager)
+    composed->bind_colour_texture(0, 0);
+    gbuffer->bind_colour_texture(1, 1);
+    previous_history->bind_colour_texture(0, 2);
+    m_f->glBindSampler(2, m_history_sampler);
+    // computed in double precision, the shader works in camera local coordinates
+    const auto reprojection = m_previous_world_view_projection * glm::translate(glm::dmat4(1.0), camera.position());
+    p->set_uniform(m_uniforms.reprojection_matrix, glm::mat4(reprojection));
+    p->set_uniform(m_uniforms.jitter_uv, glm::vec2(m_jitter * 0.5));
+    p->set_uniform(m_uniforms.current_weight, 1.0f / TEMPORAL_UPSAMPLING_JITTER_PHASES);
+    p->set_uniform(m_uniforms.history_valid, int(m_history_valid));
+    history->bind();
+    geometry->draw();
+    history->unbind();
+    m_f->glBindSampler(2, 0);
+    p->release();
+
+    m_history_valid = true;
+    m_previous_world_view_projection = world_view_projection;
+    m_frame_index++;
+    return history;
+}
+
+void TemporalUpsampling::invalidate_history() { m_history_valid = false; }
+
+bool TemporalUpsampling::converged() const { return m_static_frames >= TEMPORAL_UPSAMPLING_JITTER_PHASES; }
+
+} // namespace gl_engine
@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+#include "helpers.h"
+#include "nucleus/camera/Definition.h"
+
+// length of the jitter sequence, i.e., the number of frames until a static view has converged
+#define TEMPORAL_UPSAMPLING_JITTER_PHASES 8
+
+class QOpenGLExtraFunctions;
+
+namespace gl_engine {
+
+class Framebuffer;
+
+/// Temporal reconstruction of the output image from jittered frames at a (possibly lower) internal resolution. Every frame is
+/// rendered with a sub pixel offset of the projection (see next_jitter), and resolve accumulates it into a history at the
+/// output resolution. The history is reprojected with the previous camera and clamped to the colour neighbourhood of the
+/// current frame, which rejects it where the surface changed (disocclusion, moving over edges).
+class TemporalUpsampling {
+public:
+    explicit TemporalUpsampling(std::shared_ptr<ShaderProgram> program);
+    ~TemporalUpsampling();
+
+    // ndc offset for the projection of this frame, halton(2, 3) within one pixel of the internal resolution
+    [[nodiscard]] glm::dvec2 next_jitter(const glm::uvec2& internal_size);
+    // composed: colour of this frame at the internal resolution, rendered with the last next_jitter. gbuffer: positions of
+    // the same frame. returns the history, which holds the reconstructed image at output_size until the next resolve.
+    Framebuffer* resolve(Framebuffer* composed,
+        Framebuffer* gbuffer,
+        helpers::ScreenQuadGeometry* geometry,
+        const nucleus::camera::Definition& camera,
+        const glm::uvec2& output_size);
+    void invalidate_history();
+    // false while the jitter sequence of a static view was not completed yet, i.e., more frames would still improve the image
+    [[nodiscard]] bool converged() const;
+
+private:
+    std::shared_ptr<ShaderProgram> m_program;
+    struct {
+        ShaderProgram::Uniform<glm::mat4> reprojection_matrix;
+        ShaderProgram::Uniform<glm::vec2> jitter_uv;
+        ShaderProgram::Uniform<float> current_weight;
+        ShaderProgram::Uniform<int> history_valid;
+    } m_uniforms;
+    std::array<std::unique_ptr<Framebuffer>, 2> m_history_buffers; // ping pong
+    unsigned m_history_sampler = 0; // bilinear, the framebuffer textures are nearest
+    unsigned m_frame_index = 0;
+    unsigned m_static_frames = 0;
+    bool m_history_valid = false;
+    glm::dvec2 m_jitter = {};
+    glm::dmat4 m_previous_world_view_projection = glm::dmat4(1.0);
+    QOpenGLExtraFunctions* m_f;
+};
+
+} // namespace gl_engine
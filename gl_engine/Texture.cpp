@@ -17,8 +17,18 @@
  *****************************************************************************/
 
 #include "Texture.h"
+#include "GlCounters.h"
+#include "GlState.h"
+#include "StagingRing.h"
 #include "nucleus/utils/ColourTexture.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <QOpenGLContext>
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #ifdef __EMSCRIPTEN__
@@ -26,6 +36,59 @@
 #include <emscripten/val.h>
 #endif
 
+namespace {
+using CopyImageSubData = void(QOPENGLF_APIENTRYP)(GLuint src_name, GLenum src_target, GLint src_level, GLint src_x, GLint src_y, GLint src_z,
+    GLuint dst_name, GLenum dst_target, GLint dst_level, GLint dst_x, GLint dst_y, GLint dst_z, GLsizei width, GLsizei height, GLsizei depth);
+
+CopyImageSubData copy_image_sub_data()
+{
+#ifdef __EMSCRIPTEN__
+    return nullptr;
+#else
+    auto* context = QOpenGLContext::currentContext();
+    if (context->isOpenGLES()) {
+        if (context->format().version() >= qMakePair(3, 2))
+            return reinterpret_cast<CopyImageSubData>(context->getProcAddress("glCopyImageSubData"));
+        if (context->hasExtension("GL_EXT_copy_image"))
+            return reinterpret_cast<CopyImageSubData>(context->getProcAddress("glCopyImageSubDataEXT"));
+        if (context->hasExtension("GL_OES_copy_image"))
+            return reinterpret_cast<CopyImageSubData>(context->getProcAddress("glCopyImageSubDataOES"));
+        return nullptr;
+    }
+    if (context->format().version() >= qMakePair(4, 3) || context->hasExtension("GL_ARB_copy_image"))
+        return reinterpret_cast<CopyImageSubData>(context->getProcAddress("glCopyImageSubData"));
+    return nullptr;
+#endif
+}
+
+// copies the pieces next to each other into the staging ring. returns the offset into the bound pixel unpack buffer, nullopt
+// if there is no ring or the pieces don't fit. the callers upload layer by layer from client memory then, a gathering copy on
+// the cpu would only add to the copy of the driver (memory bandwidth is scarce on mobile devices).
+std::optional<uintptr_t> gather(std::span<const std::pair<const void*, size_t>> pieces, gl_engine::StagingRing* staging)
+{
+    if (!staging)
+        return {};
+    if (const auto staged = staging->stage(pieces))
+        return uintptr_t(*staged);
+    return {};
+}
+
+uint64_t n_level_bytes(const nucleus::utils::ColourTexture& texture, unsigned n_levels)
+{
+    uint64_t n_bytes = 0;
+    for (unsigned level = 0; level < n_levels; ++level)
+        n_bytes += texture.mip_n_bytes(level);
+    return n_bytes;
+}
+} // namespace
+
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
 gl_engine::Texture::Texture(Target target, Format format)
     : m_target(target)
     , m_format(format)
@@ -37,15 +100,43 @@ gl_engine::Texture::Texture(Target target, Format format)
 gl_engine::Texture::~Texture()
 {
 
+    GlState::current().forget_texture(m_id);
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
     f->glDeleteTextures(1, &m_id);
 }
 
-void gl_engine::Texture::bind(unsigned int texture_unit)
+void gl_engine::Texture::bind(unsigned int texture_unit) { GlState::current().bind_texture(texture_unit, GLenum(m_target), m_id); }
+
+void gl_engine::Texture::set_memory_subsystem(std::string subsystem) { m_memory.set_subsystem(std::move(subsystem)); }
+
+void gl_engine::Texture::account_memory(unsigned width, unsigned height, unsigned n_layers, unsigned n_mip_levels)
 {
-    QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glActiveTexture(GL_TEXTURE0 + texture_unit);
-    f->glBindTexture(GLenum(m_target), m_id);
+    uint64_t n_bytes = 0;
+    for (unsigned level = 0; level < n_mip_levels; ++level) {
+        const auto w = uint64_t(std::max(1u, width >> level));
+        const auto h = uint64_t(std::max(1u, height >> level));
+        switch (m_format) {
+        case Format::CompressedRGBA8: // dxt1 and etc1/2 rgb, 8 bytes per 4x4 block
+            n_bytes += ((w + 3) / 4) * ((h + 3) / 4) * 8;
+            break;
+        case Format::RGBA16F:
+            n_bytes += w * h * 8;
+            break;
+        case Format::RGBA8:
+            n_bytes += w * h * 4;
+            break;
+        case Format::RG8:
+        case Format::R16UI:
+            n_bytes += w * h * 2;
+            break;
+        case Format::R8:
+            n_bytes += w * h;
+            break;
+        case Format::Invalid:
+            break;
+        }
+    }
+    m_memory.set_n_bytes(n_bytes * n_layers);
 }
 
 void gl_engine::Texture::setParams(Filter min_filter, Filter mag_filter)
@@ -53,9 +144,7 @@ void gl_engine::Texture::setParams(Filter min_filter, Filter mag_filter)
     // doesn't make sense, does it?
     assert(mag_filter != Filter::MipMapLinear);
 
-    // add upload functionality for compressed mipmaps to support this
-    assert(m_format != Format::CompressedRGBA8 || min_filter != Filter::MipMapLinear);
-
+    // compressed mipmaps can't be generated on the gpu, they must be uploaded (see ColourTexture::n_mip_levels)
     // webgl supports only nearest filtering for R16UI
     assert(m_format != Format::R16UI || (min_filter == Filter::Nearest && mag_filter == Filter::Nearest));
 
@@ -63,7 +152,7 @@ void gl_engine::Texture::setParams(Filter min_filter, Filter mag_filter)
     m_mag_filter = mag_filter;
 
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glTexParameteri(GLenum(m_target), GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     f->glTexParameteri(GLenum(m_target), GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     f->glTexParameteri(GLenum(m_target), GL_TEXTURE_MIN_FILTER, GLint(m_min_filter));
@@ -78,6 +167,8 @@ void gl_engine::Texture::allocate_array(unsigned int width, unsigned int height,
     auto mip_level_count = 1;
     if (m_min_filter == Filter::MipMapLinear)
         mip_level_count = GLsizei(1 + std::floor(std::log2(std::max(width, height))));
+    if (m_min_filter == Filter::MipMapLinear && m_format == Format::CompressedRGBA8)
+        mip_level_count = GLsizei(nucleus::utils::ColourTexture::max_mip_levels(width, height, compression_algorithm()));
 
     auto internalformat = GLenum(m_format);
     if (m_format == Format::CompressedRGBA8)
@@ -87,53 +178,105 @@ void gl_engine::Texture::allocate_array(unsigned int width, unsigned int height,
     m_height = height;
     m_n_layers = n_layers;
 
+    m_n_mip_levels = unsigned(mip_level_count);
+
     auto* f = QOpenGLContext::currentContext()->extraFunctions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glTexStorage3D(GLenum(m_target), mip_level_count, internalformat, GLsizei(width), GLsizei(height), GLsizei(n_layers));
+    f->glTexParameteri(GLenum(m_target), GL_TEXTURE_MAX_LEVEL, mip_level_count - 1);
+    account_memory(width, height, n_layers, m_n_mip_levels);
+}
+
+void gl_engine::Texture::copy_layers(const Texture& source, std::span<const std::pair<unsigned, unsigned>> layer_moves)
+{
+    assert(m_target == Target::_2dArray && source.m_target == Target::_2dArray);
+    assert(m_format == source.m_format && m_width == source.m_width && m_height == source.m_height);
+    assert(m_n_mip_levels == source.m_n_mip_levels);
+    const auto copy = copy_image_sub_data();
+    assert(copy);
+    if (!copy)
+        return;
+    for (const auto& [from, to] : layer_moves) {
+        assert(from < source.m_n_layers && to < m_n_layers);
+        for (unsigned level = 0; level < m_n_mip_levels; ++level) {
+            const auto width = GLsizei(std::max(1u, m_width >> level));
+            const auto height = GLsizei(std::max(1u, m_height >> level));
+            copy(source.m_id, GLenum(m_target), GLint(level), 0, 0, GLint(from), m_id, GLenum(m_target), GLint(level), 0, 0, GLint(to), width, height, 1);
+        }
+    }
 }
 
+bool gl_engine::Texture::can_copy_layers() { return copy_image_sub_data() != nullptr; }
+
 void gl_engine::Texture::upload(const nucleus::utils::ColourTexture& texture)
 {
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    const auto width = GLsizei(texture.width());
-    const auto height = GLsizei(texture.height());
+    const auto n_levels = m_min_filter == Filter::MipMapLinear ? texture.n_mip_levels() : 1u;
     if (m_format == Format::CompressedRGBA8) {
-        assert(m_min_filter != Filter::MipMapLinear);
+        assert(m_min_filter != Filter::MipMapLinear || texture.n_mip_levels() > 1);
         const auto format = gl_engine::Texture::compressed_texture_format();
-        f->glCompressedTexImage2D(GLenum(m_target), 0, format, width, height, 0, GLsizei(texture.n_bytes()), texture.data());
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glCompressedTexImage2D(GLenum(m_target), GLint(level), format, GLsizei(texture.mip_width(level)), GLsizei(texture.mip_height(level)), 0,
+                GLsizei(texture.mip_n_bytes(level)), texture.mip_data(level));
+        }
+        f->glTexParameteri(GLenum(m_target), GL_TEXTURE_MAX_LEVEL, GLint(n_levels - 1));
     } else if (m_format == Format::RGBA8) {
-        f->glTexImage2D(GLenum(m_target), 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture.data());
-        if (m_min_filter == Filter::MipMapLinear)
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glTexImage2D(GLenum(m_target), GLint(level), GL_RGBA8, GLsizei(texture.mip_width(level)), GLsizei(texture.mip_height(level)), 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, texture.mip_data(level));
+        }
+        if (m_min_filter == Filter::MipMapLinear && n_levels == 1)
             f->glGenerateMipmap(GLenum(m_target));
     } else {
         assert(false);
     }
+    const auto n_allocated_levels = m_min_filter == Filter::MipMapLinear && m_format == Format::RGBA8
+        ? unsigned(1 + std::floor(std::log2(std::max(texture.width(), texture.height()))))
+        : n_levels;
+    account_memory(texture.width(), texture.height(), 1, n_allocated_levels);
+    GlCounters::current().count_texture_upload(n_level_bytes(texture, n_levels));
 }
 
-void gl_engine::Texture::upload(const nucleus::utils::ColourTexture& texture, unsigned int array_index)
+void gl_engine::Texture::upload(const nucleus::utils::ColourTexture& texture, unsigned int array_index, StagingRing* staging)
 {
     assert(texture.width() == m_width);
     assert(texture.height() == m_height);
     assert(array_index < m_n_layers);
 
     auto* f = QOpenGLContext::currentContext()->extraFunctions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    const auto width = GLsizei(texture.width());
-    const auto height = GLsizei(texture.height());
+    // levels that are not provided by the texture are generated (uncompressed) or stay undefined (compressed)
+    const auto n_levels = std::min(m_n_mip_levels, texture.n_mip_levels());
+    // the whole chain is staged at once, the level pointers become offsets into the bound pixel unpack buffer
+    const auto staged = staging ? staging->stage(texture.data(), texture.n_bytes()) : std::nullopt;
+    const auto mip_data = [&](unsigned level) -> const void* {
+        if (!staged)
+            return texture.mip_data(level);
+        return reinterpret_cast<const void*>(*staged + size_t(texture.mip_data(level) - texture.data()));
+    };
     if (m_format == Format::CompressedRGBA8) {
-        assert(m_min_filter != Filter::MipMapLinear);
+        assert(texture.n_mip_levels() >= m_n_mip_levels);
         const auto format = gl_engine::Texture::compressed_texture_format();
-        f->glCompressedTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), width, height, 1, format, GLsizei(texture.n_bytes()), texture.data());
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glCompressedTexSubImage3D(GLenum(m_target), GLint(level), 0, 0, GLint(array_index), GLsizei(texture.mip_width(level)), GLsizei(texture.mip_height(level)),
+                1, format, GLsizei(texture.mip_n_bytes(level)), mip_data(level));
+        }
     } else if (m_format == Format::RGBA8) {
-        f->glTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, texture.data());
-        if (m_min_filter == Filter::MipMapLinear)
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glTexSubImage3D(GLenum(m_target), GLint(level), 0, 0, GLint(array_index), GLsizei(texture.mip_width(level)), GLsizei(texture.mip_height(level)), 1,
+                GL_RGBA, GL_UNSIGNED_BYTE, mip_data(level));
+        }
+        if (n_levels < m_n_mip_levels)
             f->glGenerateMipmap(GLenum(m_target));
     } else {
         assert(false);
     }
+    if (staging)
+        staging->finish_uploads();
+    GlCounters::current().count_texture_upload(n_level_bytes(texture, n_levels));
 }
 
 void gl_engine::Texture::upload(const nucleus::Raster<glm::u8vec2>& texture)
@@ -141,12 +284,50 @@ void gl_engine::Texture::upload(const nucleus::Raster<glm::u8vec2>& texture)
     assert(m_format == Format::RG8);
 
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     f->glTexImage2D(GLenum(m_target), 0, GL_RG8, GLsizei(texture.width()), GLsizei(texture.height()), 0, GL_RG, GL_UNSIGNED_BYTE, texture.bytes());
+    GlCounters::current().count_texture_upload(texture.buffer_length() * sizeof(glm::u8vec2));
 
     if (m_min_filter == Filter::MipMapLinear)
         f->glGenerateMipmap(GLenum(m_target));
+    const auto n_levels = m_min_filter == Filter::MipMapLinear ? unsigned(1 + std::floor(std::log2(std::max(texture.width(), texture.height())))) : 1u;
+    account_memory(unsigned(texture.width()), unsigned(texture.height()), 1, n_levels);
+}
+
+void gl_engine::Texture::upload(const nucleus::Raster<glm::u8vec2>& texture, unsigned int array_index, StagingRing* staging)
+{
+    assert(m_format == Format::RG8);
+    assert(m_min_filter != Filter::MipMapLinear); // the mip levels of arrays are not generated
+    assert(array_index < m_n_layers);
+    assert(texture.width() == m_width);
+    assert(texture.height() == m_height);
+
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    GlState::current().bind_texture(GLenum(m_target), m_id);
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const auto staged = staging ? staging->stage(texture.bytes(), texture.buffer_length() * sizeof(glm::u8vec2)) : std::nullopt;
+    const void* pixels = staged ? reinterpret_cast<const void*>(*staged) : texture.bytes();
+    f->glTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), GLsizei(texture.width()), GLsizei(texture.height()), 1, GL_RG, GL_UNSIGNED_BYTE, pixels);
+    GlCounters::current().count_texture_upload(texture.buffer_length() * sizeof(glm::u8vec2));
+    if (staging)
+        staging->finish_uploads();
+}
+
+void gl_engine::Texture::upload(const nucleus::Raster<uint8_t>& texture)
+{
+    assert(m_format == Format::R8);
+
+    QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+    GlState::current().bind_texture(GLenum(m_target), m_id);
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    f->glTexImage2D(GLenum(m_target), 0, GL_R8, GLsizei(texture.width()), GLsizei(texture.height()), 0, GL_RED, GL_UNSIGNED_BYTE, texture.bytes());
+    GlCounters::current().count_texture_upload(texture.buffer_length());
+
+    if (m_min_filter == Filter::MipMapLinear)
+        f->glGenerateMipmap(GLenum(m_target));
+    const auto n_levels = m_min_filter == Filter::MipMapLinear ? unsigned(1 + std::floor(std::log2(std::max(texture.width(), texture.height())))) : 1u;
+    account_memory(unsigned(texture.width()), unsigned(texture.height()), 1, n_levels);
 }
 
 void gl_engine::Texture::upload(const nucleus::Raster<uint16_t>& texture)
@@ -156,12 +337,14 @@ void gl_engine::Texture::upload(const nucleus::Raster<uint16_t>& texture)
     assert(m_min_filter == Filter::Nearest); // https://registry.khronos.org/OpenGL-Refpages/es3.0/html/glTexStorage2D.xhtml
 
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     f->glTexImage2D(GLenum(m_target), 0, GL_R16UI, GLsizei(texture.width()), GLsizei(texture.height()), 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, texture.bytes());
+    GlCounters::current().count_texture_upload(texture.buffer_length() * sizeof(uint16_t));
+    account_memory(unsigned(texture.width()), unsigned(texture.height()), 1, 1);
 }
 
-void gl_engine::Texture::upload(const nucleus::Raster<uint16_t>& texture, unsigned int array_index)
+void gl_engine::Texture::upload(const nucleus::Raster<uint16_t>& texture, unsigned int array_index, StagingRing* staging)
 {
     assert(m_format == Format::R16UI);
     assert(m_mag_filter == Filter::Nearest); // not filterable according to
@@ -174,41 +357,156 @@ void gl_engine::Texture::upload(const nucleus::Raster<uint16_t>& texture, unsign
     const auto height = GLsizei(texture.height());
 
     auto* f = QOpenGLContext::currentContext()->extraFunctions();
-    f->glBindTexture(GLenum(m_target), m_id);
+    GlState::current().bind_texture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    f->glTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), width, height, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT, texture.bytes());
+    const auto staged = staging ? staging->stage(texture.bytes(), texture.buffer_length() * sizeof(uint16_t)) : std::nullopt;
+    const void* pixels = staged ? reinterpret_cast<const void*>(*staged) : texture.bytes();
+    f->glTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), width, height, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT, pixels);
+    GlCounters::current().count_texture_upload(texture.buffer_length() * sizeof(uint16_t));
+    if (staging)
+        staging->finish_uploads();
+}
+
+void gl_engine::Texture::upload(std::span<const nucleus::utils::ColourTexture* const> textures, unsigned first_layer, StagingRing* staging)
+{
+    assert(!textures.empty());
+    assert(first_layer + textures.size() <= m_n_layers);
+    const auto& first = *textures.front();
+    for ([[maybe_unused]] const auto* texture : textures) {
+        assert(texture->width() == m_width);
+        assert(texture->height() == m_height);
+        assert(texture->n_mip_levels() == first.n_mip_levels());
+    }
+
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    GlState::current().bind_texture(GLenum(m_target), m_id);
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const auto n_levels = std::min(m_n_mip_levels, first.n_mip_levels());
+    const auto depth = GLsizei(textures.size());
+    // staged level by level, the layers of a level are consecutive in the ring
+    std::vector<std::pair<const void*, size_t>> pieces;
+    pieces.reserve(n_levels * textures.size());
+    for (unsigned level = 0; level < n_levels; ++level) {
+        for (const auto* texture : textures)
+            pieces.emplace_back(texture->mip_data(level), texture->mip_n_bytes(level));
+    }
+    const auto format = m_format == Format::CompressedRGBA8 ? gl_engine::Texture::compressed_texture_format() : GLenum(GL_RGBA);
+    const auto sub_image = [&](unsigned level, unsigned layer, unsigned n_layers, const void* data) {
+        const auto n_bytes = first.mip_n_bytes(level) * n_layers;
+        const auto width = GLsizei(first.mip_width(level));
+        const auto height = GLsizei(first.mip_height(level));
+        if (m_format == Format::CompressedRGBA8)
+            f->glCompressedTexSubImage3D(GLenum(m_target), GLint(level), 0, 0, GLint(layer), width, height, GLsizei(n_layers), format, GLsizei(n_bytes), data);
+        else
+            f->glTexSubImage3D(GLenum(m_target), GLint(level), 0, 0, GLint(layer), width, height, GLsizei(n_layers), GL_RGBA, GL_UNSIGNED_BYTE, data);
+    };
+    assert(m_format == Format::CompressedRGBA8 || m_format == Format::RGBA8);
+    assert(m_format != Format::CompressedRGBA8 || first.n_mip_levels() >= m_n_mip_levels);
+    const auto staged = gather(pieces, staging);
+    auto address = staged.value_or(0);
+    for (unsigned level = 0; level < n_levels; ++level) {
+        if (staged) {
+            sub_image(level, first_layer, unsigned(depth), reinterpret_cast<const void*>(address));
+            address += first.mip_n_bytes(level) * textures.size();
+            continue;
+        }
+        for (size_t i = 0; i < textures.size(); ++i)
+            sub_image(level, first_layer + unsigned(i), 1, textures[i]->mip_data(level));
+    }
+    if (m_format == Format::RGBA8 && n_levels < m_n_mip_levels)
+        f->glGenerateMipmap(GLenum(m_target));
+    if (staging)
+        staging->finish_uploads();
+    GlCounters::current().count_texture_upload(n_level_bytes(first, n_levels) * textures.size());
+}
+
+namespace {
+template <typename T>
+void upload_raster_layers(GLenum target, GLuint id, std::span<const nucleus::Raster<T>* const> textures, unsigned first_layer, GLenum format, GLenum type, gl_engine::StagingRing* staging)
+{
+    const auto& first = *textures.front();
+    std::vector<std::pair<const void*, size_t>> pieces;
+    pieces.reserve(textures.size());
+    for (const auto* texture : textures) {
+        assert(texture->width() == first.width());
+        assert(texture->height() == first.height());
+        pieces.emplace_back(texture->bytes(), texture->buffer_length() * sizeof(T));
+    }
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    gl_engine::GlState::current().bind_texture(target, id);
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (const auto address = gather(pieces, staging)) {
+        f->glTexSubImage3D(target, 0, 0, 0, GLint(first_layer), GLsizei(first.width()), GLsizei(first.height()), GLsizei(textures.size()), format, type,
+            reinterpret_cast<const void*>(*address));
+    } else {
+        for (size_t i = 0; i < textures.size(); ++i)
+            f->glTexSubImage3D(target, 0, 0, 0, GLint(first_layer + i), GLsizei(first.width()), GLsizei(first.height()), 1, format, type, pieces[i].first);
+    }
+    if (staging)
+        staging->finish_uploads();
+    gl_engine::GlCounters::current().count_texture_upload(first.buffer_length() * sizeof(T) * textures.size());
+}
+} // namespace
+
+void gl_engine::Texture::upload(std::span<const nucleus::Raster<glm::u8vec2>* const> textures, unsigned first_layer, StagingRing* staging)
+{
+    assert(m_format == Format::RG8);
+    assert(m_min_filter != Filter::MipMapLinear); // the mip levels of arrays are not generated
+    assert(!textures.empty());
+    assert(first_layer + textures.size() <= m_n_layers);
+    assert(textures.front()->width() == m_width);
+    assert(textures.front()->height() == m_height);
+    upload_raster_layers(GLenum(m_target), m_id, textures, first_layer, GL_RG, GL_UNSIGNED_BYTE, staging);
+}
+
+void gl_engine::Texture::upload(std::span<const nucleus::Raster<uint16_t>* const> textures, unsigned first_layer, StagingRing* staging)
+{
+    assert(m_format == Format::R16UI);
+    assert(m_mag_filter == Filter::Nearest);
+    assert(m_min_filter == Filter::Nearest);
+    assert(!textures.empty());
+    assert(first_layer + textures.size() <= m_n_layers);
+    assert(textures.front()->width() == m_width);
+    assert(textures.front()->height() == m_height);
+    upload_raster_layers(GLenum(m_target), m_id, textures, first_layer, GL_RED_INTEGER, GL_UNSIGNED_SHORT, staging);
+}
+
+void gl_engine::Texture::upload(const nucleus::Raster<glm::vec4>& texture, unsigned int array_index)
+{
+    assert(m_format == Format::RGBA16F);
+    assert(array_index < m_n_layers);
+    assert(texture.width() == m_width);
+    assert(texture.height() == m_height);
+
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    GlState::current().bind_texture(GLenum(m_target), m_id);
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // converted to half floats by the driver (gles 3 accepts GL_FLOAT for RGBA16F)
+    f->glTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), GLsizei(texture.width()), GLsizei(texture.height()), 1, GL_RGBA, GL_FLOAT, texture.bytes());
+    GlCounters::current().count_texture_upload(texture.buffer_length() * sizeof(glm::vec4));
 }
 
 GLenum gl_engine::Texture::compressed_texture_format()
 {
-    // select between
-    // DXT1, also called s3tc, old desktop compression
-    // ETC1, old mobile compression
-#if defined(__EMSCRIPTEN__)
-    // clang-format off
-    static int gl_texture_format = EM_ASM_INT({
-        var canvas = document.createElement('canvas');
-        var gl = canvas.getContext("webgl2");
-        const ext = gl.getExtension("WEBGL_compressed_texture_etc");
-        if (ext === null)
-            return 0;
-        return ext.COMPRESSED_RGB8_ETC2;
-    });
-    // qDebug() << "gl_engine::Texture::compressed_texture_format: gl_texture_format from js: " << gl_texture_format;
-    // clang-format on
-    if (gl_texture_format == 0) {
-        gl_texture_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; // not on mobile
+    using Format = nucleus::utils::ColourTexture::Format;
+    switch (compression_algorithm()) {
+    case Format::DXT1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case Format::ETC1:
+    case Format::ETC2:
+        return GL_COMPRESSED_RGB8_ETC2; // etc1 data is valid etc2
+    case Format::Uncompressed_RGBA:
+        break;
     }
-    return gl_texture_format;
-#elif defined(__ANDROID__)
-    return GL_COMPRESSED_RGB8_ETC2;
-#else
+    assert(false);
     return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
-#endif
 }
 
 nucleus::utils::ColourTexture::Format gl_engine::Texture::compression_algorithm()
 {
+    // select between
+    // DXT1, also called s3tc, old desktop compression
+    // ETC2, mandatory in GLES 3.0, WebGL 2 (if exposed by the browser) and gl 4.3
 #if defined(__EMSCRIPTEN__)
     // clang-format off
     static const int gl_texture_format = EM_ASM_INT({
@@ -224,10 +522,18 @@ nucleus::utils::ColourTexture::Format gl_engine::Texture::compression_algorithm(
     if (gl_texture_format == 0) {
         return nucleus::utils::ColourTexture::Format::DXT1;
     }
-    return nucleus::utils::ColourTexture::Format::ETC1;
+    return nucleus::utils::ColourTexture::Format::ETC2;
 #elif defined(__ANDROID__)
-    return nucleus::utils::ColourTexture::Format::ETC1;
+    return nucleus::utils::ColourTexture::Format::ETC2;
 #else
+    // desktop drivers usually expose s3tc, even if they have etc2 (often decoded in software there)
+    const auto* context = QOpenGLContext::currentContext();
+    if (!context)
+        return nucleus::utils::ColourTexture::Format::DXT1;
+    if (context->hasExtension("GL_EXT_texture_compression_s3tc"))
+        return nucleus::utils::ColourTexture::Format::DXT1;
+    if (context->isOpenGLES() || context->format().version() >= qMakePair(4, 3) || context->hasExtension("GL_ARB_ES3_compatibility"))
+        return nucleus::utils::ColourTexture::Format::ETC2;
     return nucleus::utils::ColourTexture::Format::DXT1;
 #endif
 }
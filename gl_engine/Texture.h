@@ -18,20 +18,26 @@
 
 #pragma once
 
+#include <span>
+#include <utility>
+
 #include <QImage>
 #include <qopengl.h>
 #ifdef ANDROID
 #include <GLES3/gl3.h>
 #endif
 
+#include "GpuMemory.h"
 #include <nucleus/Raster.h>
 #include <nucleus/utils/ColourTexture.h>
 
 namespace gl_engine {
+class StagingRing;
+
 class Texture {
 public:
     enum class Target : GLenum { _2d = GL_TEXTURE_2D, _2dArray = GL_TEXTURE_2D_ARRAY };
-    enum class Format : GLenum { RGBA8 = GL_RGBA8, CompressedRGBA8 = GLenum(-2), RG8 = GL_RG8, R16UI = GL_R16UI, Invalid = GLenum(-1) };
+    enum class Format : GLenum { RGBA8 = GL_RGBA8, CompressedRGBA8 = GLenum(-2), RG8 = GL_RG8, R8 = GL_R8, R16UI = GL_R16UI, RGBA16F = GL_RGBA16F, Invalid = GLenum(-1) };
     enum class Filter : GLint { Nearest = GL_NEAREST, Linear = GL_LINEAR, MipMapLinear = GL_LINEAR_MIPMAP_LINEAR };
 
 public:
@@ -43,14 +49,32 @@ public:
     ~Texture();
 
     void bind(unsigned texture_unit);
+    /// for the gpu memory accounting (gpu_memory::usage), "textures" by default
+    void set_memory_subsystem(std::string subsystem);
     void setParams(Filter min_filter, Filter mag_filter);
     void allocate_array(unsigned width, unsigned height, unsigned n_layers);
+    /// copies layers of another array with the same size and format on the gpu, including all mip levels. layer_moves are
+    /// (source layer, destination layer). requires can_copy_layers().
+    void copy_layers(const Texture& source, std::span<const std::pair<unsigned, unsigned>> layer_moves);
     void upload(const nucleus::utils::ColourTexture& texture);
-    void upload(const nucleus::utils::ColourTexture& texture, unsigned array_index);
+    /// with a staging ring, the data is copied into its pixel unpack buffer first (falls back to client memory if it doesn't fit)
+    void upload(const nucleus::utils::ColourTexture& texture, unsigned array_index, StagingRing* staging = nullptr);
     void upload(const nucleus::Raster<glm::u8vec2>& texture);
+    void upload(const nucleus::Raster<glm::u8vec2>& texture, unsigned int array_index, StagingRing* staging = nullptr);
+    void upload(const nucleus::Raster<uint8_t>& texture);
     void upload(const nucleus::Raster<uint16_t>& texture);
-    void upload(const nucleus::Raster<uint16_t>& texture, unsigned int array_index);
+    void upload(const nucleus::Raster<uint16_t>& texture, unsigned int array_index, StagingRing* staging = nullptr);
+    /// consecutive layers starting at first_layer, with one call per mip level (depth textures.size()). the layers are copied
+    /// next to each other, into the staging ring if there is one (client memory otherwise). they must have the same size and
+    /// number of mip levels.
+    void upload(std::span<const nucleus::utils::ColourTexture* const> textures, unsigned first_layer, StagingRing* staging = nullptr);
+    void upload(std::span<const nucleus::Raster<glm::u8vec2>* const> textures, unsigned first_layer, StagingRing* staging = nullptr);
+    void upload(std::span<const nucleus::Raster<uint16_t>* const> textures, unsigned first_layer, StagingRing* staging = nullptr);
+    /// float data, stored as RGBA16F
+    void upload(const nucleus::Raster<glm::vec4>& texture, unsigned int array_index);
 
+    /// glCopyImageSubData (gl 4.3, gles 3.2 or the extensions), not available in webgl
+    static bool can_copy_layers();
     static GLenum compressed_texture_format();
     static nucleus::utils::ColourTexture::Format compression_algorithm();
 
@@ -63,6 +87,10 @@ private:
     unsigned m_width = unsigned(-1);
     unsigned m_height = unsigned(-1);
     unsigned m_n_layers = unsigned(-1);
+    unsigned m_n_mip_levels = 1; // of the allocated array
+    gpu_memory::Allocation m_memory { "textures" };
+
+    void account_memory(unsigned width, unsigned height, unsigned n_layers, unsigned n_mip_levels);
 };
 
 } // namespace gl_engine
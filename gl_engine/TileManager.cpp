@@ -19,16 +19,39 @@
  *****************************************************************************/
 #include "TileManager.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+#include <QOffscreenSurface>
 #include <QOpenGLBuffer>
+#include <QOpenGLContext>
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLVertexArrayObject>
+#include <QThreadPool>
 
+#include "GlCounters.h"
+#include "GpuTileCuller.h"
 #include "ShaderProgram.h"
 #include "nucleus/camera/Definition.h"
+#include "nucleus/tile_scheduler/DepthPyramid.h"
+#include "nucleus/utils/incremental_sort.h"
 #include "nucleus/utils/terrain_mesh_index_generator.h"
 
+#ifndef GL_MAX_ARRAY_TEXTURE_LAYERS
+#define GL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#endif
+#ifndef GL_PRIMITIVE_RESTART_FIXED_INDEX
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
 using gl_engine::TileManager;
 using gl_engine::TileSet;
 
@@ -38,6 +61,22 @@ int bufferLengthInBytes(const std::vector<T>& vec)
 {
     return int(vec.size() * sizeof(T));
 }
+
+// heights are stored in metres above sea level, but in web mercator distances are scaled by 1/cos(latitude).
+// 1/cos(latitude) == cosh(mercator_y * pi / origin_shift), evaluated at the southern and northern tile edge.
+// https://github.com/AlpineMapsOrg/renderer/issues/5
+glm::vec2 altitude_correction_factors(const tile::SrsBounds& bounds)
+{
+    constexpr double pi = 3.1415926535897932384626433;
+    constexpr double origin_shift = 20037508.342789244;
+    return { float(0.125 * std::cosh(bounds.min.y * pi / origin_shift)), float(0.125 * std::cosh(bounds.max.y * pi / origin_shift)) };
+}
+
+// one indirect command per non empty batch
+unsigned n_draw_commands(const TileManager::DrawRange& range)
+{
+    return unsigned(std::count_if(range.batch_counts.begin(), range.batch_counts.end(), [](unsigned count) { return count > 0; }));
+}
 }
 
 TileManager::TileManager(QObject* parent)
@@ -45,58 +84,105 @@ TileManager::TileManager(QObject* parent)
 {
 }
 
+TileManager::~TileManager()
+{
+    wait_for_tilelist();
+    m_uploader.reset(); // joins the upload thread
+    if (!QOpenGLContext::currentContext())
+        return;
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (const auto& upload : m_in_flight_uploads) {
+        if (upload.fence)
+            f->glDeleteSync(upload.fence);
+    }
+    if (m_indirect_buffer)
+        f->glDeleteBuffers(1, &m_indirect_buffer);
+}
+
+bool TileManager::enable_background_uploads(std::shared_ptr<QOffscreenSurface> surface)
+{
+    assert(m_vao); // after init
+    if (m_uploader || !BackgroundUploader::is_supported() || !surface || !surface->isValid())
+        return bool(m_uploader);
+    auto uploader = std::make_unique<BackgroundUploader>(std::move(surface));
+    if (!uploader->is_running())
+        return false;
+    uploader->set_thread_policy(m_upload_thread_policy);
+    m_uploader = std::move(uploader);
+    return true;
+}
+
+bool TileManager::has_background_uploads() const { return m_uploader != nullptr; }
+
 void TileManager::init()
 {
     using nucleus::utils::terrain_mesh_index_generator::surface_quads_with_curtains;
+    using nucleus::utils::terrain_mesh_index_generator::surface_quads_with_curtains_cache_optimised;
     assert(QOpenGLContext::currentContext());
-    const auto indices = surface_quads_with_curtains<uint16_t>(N_EDGE_VERTICES);
-    auto index_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::IndexBuffer);
-    index_buffer->create();
-    index_buffer->bind();
-    index_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
-    index_buffer->allocate(indices.data(), bufferLengthInBytes(indices));
-    index_buffer->release();
-    m_index_buffer.first = std::move(index_buffer);
-    m_index_buffer.second = indices.size();
-
-    m_bounds_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
-    m_bounds_buffer->create();
-    m_bounds_buffer->bind();
-    m_bounds_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_bounds_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(glm::vec4)));
-
-    m_tileset_id_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
-    m_tileset_id_buffer->create();
-    m_tileset_id_buffer->bind();
-    m_tileset_id_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_tileset_id_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(int32_t)));
-
-    m_zoom_level_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
-    m_zoom_level_buffer->create();
-    m_zoom_level_buffer->bind();
-    m_zoom_level_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_zoom_level_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(int32_t)));
-
-    m_texture_layer_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
-    m_texture_layer_buffer->create();
-    m_texture_layer_buffer->bind();
-    m_texture_layer_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_texture_layer_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(int32_t)));
+    // primitive restart with the fixed index is always enabled in GLES 3.0 / WebGL 2. desktop gl needs 4.3 or the extension,
+    // otherwise we fall back to the row by row strips (every vertex is shaded about twice).
+    auto* context = QOpenGLContext::currentContext();
+    const auto primitive_restart = context->isOpenGLES() || context->format().version() >= qMakePair(4, 3)
+        || context->hasExtension("GL_ARB_ES3_compatibility");
+    if (!context->isOpenGLES() && primitive_restart)
+        context->functions()->glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    // every lod has its own curtains, they hide the cracks towards neighbours of another lod (or zoom level). the edges
+    // towards a matching neighbour leave them out per instance, see curtain_edges
+    // the indices are 16 bit (0xffff restarts the strip), that limits the height grid incl. curtains to about 250^2 vertices
+    assert(m_tile_format.valid());
+    assert(m_tile_format.height_size * m_tile_format.height_size + 4 * m_tile_format.height_size < 0xffff);
+    std::vector<uint16_t> indices;
+    for (unsigned lod = 0; lod < N_MESH_LODS; ++lod) {
+        const auto n_edge_vertices = mesh_lod_edge_vertices(lod);
+        const auto lod_indices = primitive_restart ? surface_quads_with_curtains_cache_optimised<uint16_t>(n_edge_vertices)
+                                                   : surface_quads_with_curtains<uint16_t>(n_edge_vertices);
+        m_lod_indices[lod] = { indices.size(), lod_indices.size() };
+        indices.insert(indices.end(), lod_indices.begin(), lod_indices.end());
+    }
+    m_index_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::IndexBuffer);
+    m_index_buffer->create();
+    m_index_buffer->bind();
+    m_index_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_index_buffer->allocate(indices.data(), bufferLengthInBytes(indices));
+    m_index_buffer->release();
+
+    // the base instance of the commands needs 4.2 or the extension as well (it's reserved in plain ARB_draw_indirect)
+    const auto multi_draw_indirect = !context->isOpenGLES()
+        && (context->format().version() >= qMakePair(4, 3)
+            || (context->hasExtension("GL_ARB_multi_draw_indirect") && context->hasExtension("GL_ARB_base_instance")));
+    if (multi_draw_indirect)
+        m_multi_draw_elements_indirect = reinterpret_cast<MultiDrawElementsIndirect>(context->getProcAddress("glMultiDrawElementsIndirect"));
+    if (m_multi_draw_elements_indirect) {
+        context->functions()->glGenBuffers(1, &m_indirect_buffer);
+        m_indirect_draws = true;
+    }
+
+    m_instance_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
+    m_instance_buffer->create();
+    m_instance_buffer->bind();
+    m_instance_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_instance_buffer->allocate(GLsizei(m_n_layers * sizeof(TileInstance)));
 
     m_vao = std::make_unique<QOpenGLVertexArrayObject>();
     m_vao->create();
     m_vao->bind();
-    m_index_buffer.first->bind();
+    m_index_buffer->bind();
     m_vao->release();
 
-    m_ortho_textures = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::CompressedRGBA8);
-    m_ortho_textures->setParams(Texture::Filter::Linear, Texture::Filter::Linear);
-    // TODO: might become larger than GL_MAX_ARRAY_TEXTURE_LAYERS
-    m_ortho_textures->allocate_array(ORTHO_RESOLUTION, ORTHO_RESOLUTION, unsigned(m_loaded_tiles.size()));
+    // mobile gpus often allow only 256 or 2048 layers per array, larger pools are split into pages
+    GLint max_array_layers = 0;
+    context->functions()->glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_array_layers);
+    m_layers_per_page = std::min(m_layers_per_page, unsigned(std::max(max_array_layers, 4)) / 4 * 4);
+    if (m_n_layers > max_n_layers()) {
+        qDebug() << "TileManager: the quad limit is capped to" << max_n_layers() / 4 << "by GL_MAX_ARRAY_TEXTURE_LAYERS";
+        m_n_layers = m_target_n_layers = max_n_layers();
+        reset_free_layers(0);
+        emit quad_limit_changed(m_n_layers / 4);
+    }
+    m_texture_pages = allocate_texture_pages(m_n_layers);
 
-    m_heightmap_textures = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::R16UI);
-    m_heightmap_textures->setParams(Texture::Filter::Nearest, Texture::Filter::Nearest);
-    m_heightmap_textures->allocate_array(HEIGHTMAP_RESOLUTION, HEIGHTMAP_RESOLUTION, unsigned(m_loaded_tiles.size()));
+    if (StagingRing::is_supported())
+        m_staging_ring = std::make_unique<StagingRing>(STAGING_RING_BYTES);
 }
 
 bool compareTileSetPair(std::pair<float, const TileSet*> t1, std::pair<float, const TileSet*> t2)
@@ -104,191 +190,1043 @@ bool compareTileSetPair(std::pair<float, const TileSet*> t1, std::pair<float, co
     return (t1.first < t2.first);
 }
 
-const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::generate_tilelist(const nucleus::camera::Definition& camera) const {
-    return m_draw_list_generator.generate_for(camera);
+void TileManager::start_tilelist(const nucleus::camera::Definition& camera)
+{
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING)
+    Q_UNUSED(camera);
+#else
+    wait_for_tilelist();
+    if (!m_draw_list_dirty && m_draw_list_camera && *m_draw_list_camera == camera)
+        return; // generate_tilelist returns the last list
+    if (!m_draw_list_pool) {
+        m_draw_list_pool = std::make_unique<QThreadPool>();
+        m_draw_list_pool->setMaxThreadCount(1);
+    }
+    m_async_draw_list_camera = camera;
+    m_async_draw_list_stale = false;
+    m_async_quadrant_masks.clear_retaining_storage();
+    m_draw_list_pool->start([this, camera]() { m_draw_list_generator.generate_for(camera, &m_async_draw_list, &m_async_quadrant_masks); });
+#endif
 }
 
-const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Frustum& frustum) const {
-    return m_draw_list_generator.cull(tileset, frustum);
+void TileManager::wait_for_tilelist()
+{
+    if (!m_async_draw_list_camera)
+        return;
+    m_draw_list_pool->waitForDone();
+    m_async_draw_list_camera.reset();
+    m_draw_list_dirty = true; // the list is dropped, unless generate_tilelist takes it
+    for (const auto& [id, available] : m_deferred_tile_changes) {
+        if (available)
+            m_draw_list_generator.add_tile(id);
+        else
+            m_draw_list_generator.remove_tile(id);
+    }
+    m_deferred_tile_changes.clear();
 }
 
-void TileManager::draw(ShaderProgram* shader_program, const nucleus::camera::Definition& camera,
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet& draw_tiles, bool sort_tiles, glm::dvec3 sort_position) const
+void TileManager::set_tile_available(const tile::Id& id, bool available)
 {
-    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
-    shader_program->set_uniform("n_edge_vertices", N_EDGE_VERTICES);
-    shader_program->set_uniform("ortho_sampler", 2);
-    shader_program->set_uniform("height_sampler", 1);
-
-    // Sort depending on distance to sort_position
-    std::vector<std::pair<float, const TileSet*>> tile_list;
-    for (const auto& tileset : m_gpu_tiles) {
-        float dist = 0.0;
-        if (!draw_tiles.contains(tileset.tile_id))
-            continue;
-        if (sort_tiles) {
-            glm::vec2 pos_wrt = glm::vec2(tileset.bounds.min.x - sort_position.x, tileset.bounds.min.y - sort_position.y);
-            dist = glm::length(pos_wrt);
+    if (m_async_draw_list_camera) {
+        m_deferred_tile_changes.emplace_back(id, available);
+        m_async_draw_list_stale |= !available; // the list would contain a tile that's gone
+        return;
+    }
+    if (available)
+        m_draw_list_generator.add_tile(id);
+    else
+        m_draw_list_generator.remove_tile(id);
+}
+
+const nucleus::tile_scheduler::DrawListGenerator::TileSet& TileManager::generate_tilelist(const nucleus::camera::Definition& camera) {
+    if (m_async_draw_list_camera) {
+        const auto usable = *m_async_draw_list_camera == camera && !m_async_draw_list_stale;
+        const auto tiles_added = !m_deferred_tile_changes.empty(); // they are drawn with the next list
+        wait_for_tilelist();
+        if (usable) {
+            std::swap(m_last_draw_list, m_async_draw_list);
+            std::swap(m_quadrant_masks, m_async_quadrant_masks);
+            m_draw_list_camera = camera;
+            m_draw_list_dirty = tiles_added;
+            ++m_draw_list_version;
+            return m_last_draw_list;
         }
-        tile_list.push_back(std::pair<float, const TileSet*>(dist, &tileset));
     }
-    if (sort_tiles) std::sort(tile_list.begin(), tile_list.end(), compareTileSetPair);
+    if (!m_draw_list_dirty && m_draw_list_camera && *m_draw_list_camera == camera)
+        return m_last_draw_list;
+    m_quadrant_masks.clear_retaining_storage();
+    m_draw_list_generator.generate_for(camera, &m_last_draw_list, &m_quadrant_masks);
+    m_draw_list_camera = camera;
+    m_draw_list_dirty = false;
+    ++m_draw_list_version;
+    return m_last_draw_list;
+}
 
-    m_ortho_textures->bind(2);
-    m_heightmap_textures->bind(1);
-    m_vao->bind();
+uint64_t TileManager::draw_list_version() const
+{
+    return m_draw_list_version;
+}
 
-    std::vector<glm::vec4> bounds;
-    bounds.reserve(tile_list.size());
+void TileManager::cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset,
+    const nucleus::camera::Frustum& frustum,
+    nucleus::tile_scheduler::DrawListGenerator::TileSet* visible,
+    std::optional<unsigned> gpu_view) const
+{
+    if (gpu_view && m_gpu_culler) {
+        const auto& result = m_gpu_culler->result();
+        const auto current = result.boxes_version == m_gpu_boxes_version && m_gpu_boxes_resident_version == m_resident_version
+            && m_gpu_boxes_aabb_version == m_draw_list_generator.aabb_decorator()->version();
+        if (current && *gpu_view < result.n_views && result.masks.size() == m_gpu_tiles.size()) {
+            const auto bit = 1u << *gpu_view;
+            visible->clear();
+            for (const auto& id : tileset) {
+                const auto found = m_tile_index.find(id);
+                if (found == m_tile_index.end() || (result.masks[found->second] & bit))
+                    visible->insert(id); // appends for sorted input
+            }
+            return;
+        }
+    }
+    m_draw_list_generator.cull(tileset, frustum, visible);
+}
 
-    std::vector<int32_t> tileset_id;
-    tileset_id.reserve(tile_list.size());
+bool TileManager::set_gpu_culling(bool enabled)
+{
+#ifdef __EMSCRIPTEN__
+    // WebGL has no glMapBufferRange (and getBufferSubData blocks), see DepthReadback
+    Q_UNUSED(enabled);
+    return false;
+#else
+    if (!enabled) {
+        m_gpu_culler.reset();
+        return false;
+    }
+    if (!m_gpu_culler) {
+        m_gpu_culler = std::make_unique<GpuTileCuller>();
+        m_gpu_culled_frusta.clear();
+        m_gpu_result_version = 0;
+    }
+    return true;
+#endif
+}
 
-    std::vector<int32_t> zoom_level;
-    zoom_level.reserve(tile_list.size());
+bool TileManager::gpu_culling() const { return m_gpu_culler != nullptr; }
 
-    std::vector<int32_t> texture_layer;
-    texture_layer.reserve(tile_list.size());
+bool TileManager::start_gpu_culling(std::span<const nucleus::camera::Frustum> frusta, const glm::dvec3& camera_position)
+{
+    if (!m_gpu_culler)
+        return false;
+    m_gpu_culler->collect();
+    const auto new_result = m_gpu_culler->result_version() != m_gpu_result_version;
+    if (new_result) {
+        m_gpu_result_version = m_gpu_culler->result_version();
+        ++m_gpu_culling_version;
+    }
 
-    for (const auto& tileset : tile_list) {
-        bounds.emplace_back(tileset.second->bounds.min.x - camera.position().x, tileset.second->bounds.min.y - camera.position().y,
-            tileset.second->bounds.max.x - camera.position().x, tileset.second->bounds.max.y - camera.position().y);
+    const auto aabb_version = m_draw_list_generator.aabb_decorator()->version();
+    if (m_gpu_boxes_resident_version != m_resident_version || m_gpu_boxes_aabb_version != aabb_version) {
+        m_gpu_boxes_resident_version = m_resident_version;
+        m_gpu_boxes_aabb_version = aabb_version;
+        ++m_gpu_boxes_version;
+    }
+    if (m_gpu_culler->needs_boxes(m_gpu_boxes_version, camera_position)) {
+        const auto& decorator = m_draw_list_generator.aabb_decorator();
+        m_gpu_boxes.clear();
+        for (const auto& tileset : m_gpu_tiles)
+            m_gpu_boxes.push_back(decorator->aabb(tileset.tile_id));
+        m_gpu_culler->set_boxes(m_gpu_boxes, m_gpu_boxes_version, camera_position);
+    }
 
-        tileset_id.emplace_back(tileset.second->tile_id.coords[0] + tileset.second->tile_id.coords[1]);
-        zoom_level.emplace_back(tileset.second->tile_id.zoom_level);
-        texture_layer.emplace_back(tileset.second->texture_layer);
+    const auto same_frusta = std::equal(frusta.begin(), frusta.end(), m_gpu_culled_frusta.begin(), m_gpu_culled_frusta.end(),
+        [](const auto& a, const auto& b) { return a.corners == b.corners; });
+    if ((!same_frusta || m_gpu_culled_boxes_version != m_gpu_boxes_version) && m_gpu_culler->start_cull(frusta, camera_position)) {
+        m_gpu_culled_frusta.assign(frusta.begin(), frusta.end());
+        m_gpu_culled_boxes_version = m_gpu_boxes_version;
     }
+    return new_result || m_gpu_culler->in_flight();
+}
 
-    m_bounds_buffer->bind();
-    m_bounds_buffer->write(0, bounds.data(), GLsizei(bounds.size() * sizeof(decltype(bounds)::value_type)));
+uint64_t TileManager::gpu_culling_version() const { return m_gpu_culling_version; }
 
-    m_tileset_id_buffer->bind();
-    m_tileset_id_buffer->write(0, tileset_id.data(), GLsizei(tileset_id.size() * sizeof(decltype(tileset_id)::value_type)));
+const std::vector<tile::SrsAndHeightBounds>& TileManager::tile_bounds(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset)
+{
+    const auto is_draw_list = &tileset == &m_last_draw_list;
+    if (is_draw_list && m_tile_bounds_version == m_draw_list_version)
+        return m_tile_bounds;
+    m_draw_list_generator.aabbs(tileset, &m_tile_bounds);
+    m_tile_bounds_version = is_draw_list ? m_draw_list_version : 0;
+    return m_tile_bounds;
+}
 
-    m_zoom_level_buffer->bind();
-    m_zoom_level_buffer->write(0, zoom_level.data(), GLsizei(zoom_level.size() * sizeof(decltype(zoom_level)::value_type)));
+void TileManager::cull_occluded(const nucleus::tile_scheduler::DepthPyramid& pyramid,
+    const glm::dvec3& camera_position,
+    nucleus::tile_scheduler::DrawListGenerator::TileSet* tiles,
+    std::vector<tile::Id>* occluded) const
+{
+    m_draw_list_generator.cull_occluded(pyramid, camera_position, tiles, occluded);
+}
 
-    m_texture_layer_buffer->bind();
-    m_texture_layer_buffer->write(0, texture_layer.data(), GLsizei(texture_layer.size() * sizeof(decltype(texture_layer)::value_type)));
+void TileManager::cull_below_horizon(const nucleus::camera::Definition& camera, nucleus::tile_scheduler::DrawListGenerator::TileSet* tiles) const
+{
+    m_draw_list_generator.cull_below_horizon(camera, tiles);
+}
 
-    f->glDrawElementsInstanced(GL_TRIANGLE_STRIP, GLsizei(m_index_buffer.second), GL_UNSIGNED_SHORT, nullptr, GLsizei(tile_list.size()));
+void TileManager::cull_by_distance(const glm::dvec3& position, double min_distance, double max_distance, nucleus::tile_scheduler::DrawListGenerator::TileSet* tiles) const
+{
+    m_draw_list_generator.cull_by_distance(position, min_distance, max_distance, tiles);
+}
+
+const std::vector<TileManager::DrawRange>& TileManager::prepare_draw(const nucleus::camera::Definition& camera,
+    std::span<const nucleus::tile_scheduler::DrawListGenerator::TileSet> passes,
+    glm::dvec3 sort_position)
+{
+    // the tiles of all passes are concatenated into one instance buffer, each pass gets its own range.
+    // within a range, tiles are sorted depending on distance to sort_position (front to back).
+    auto& tile_list = m_draw_tile_list;
+    auto& ranges = m_draw_ranges;
+    auto& pass_tiles = m_pass_tiles;
+    // the order is reused if neither the passes nor the tiles nor the sort position changed (static views, render_looped).
+    const auto lod_scale = camera.to_screen_space(1, 1);
+    const auto order_is_current = !m_prepared_order_dirty && m_prepared_sort_position == sort_position
+        && m_prepared_lod_position == camera.position() && m_prepared_lod_scale == lod_scale
+        && std::equal(passes.begin(), passes.end(), m_prepared_passes.begin(), m_prepared_passes.end());
+    if (!order_is_current) {
+        tile_list.clear();
+        m_draw_tile_lods.clear();
+        m_draw_tile_curtain_edges.clear();
+        ranges.clear();
+        m_pass_orders.resize(passes.size());
+        m_tile_stamps.resize(m_gpu_tiles.size(), 0);
+        for (size_t i = 0; i < passes.size(); ++i) {
+            const auto& pass = passes[i];
+            auto& order = m_pass_orders[i];
+            const auto stamp = ++m_tile_stamp;
+            pass_tiles.clear();
+            const auto add = [&](size_t index) {
+                const auto& tileset = m_gpu_tiles[index];
+                m_tile_stamps[index] = stamp;
+                glm::vec2 pos_wrt = glm::vec2(tileset.bounds.min.x - sort_position.x, tileset.bounds.min.y - sort_position.y);
+                pass_tiles.push_back(std::pair<float, const TileSet*>(glm::length(pos_wrt), &tileset));
+            };
+            // the tiles of the last frame in their last order, followed by the new ones. the order barely changes between frames,
+            // so it only needs a repair (insertion sort, falls back to std::sort if too much changed).
+            for (const auto& id : order) {
+                const auto found = m_tile_index.find(id);
+                if (found != m_tile_index.end() && pass.contains(id))
+                    add(found->second);
+            }
+            for (const auto& id : pass) {
+                const auto found = m_tile_index.find(id);
+                if (found != m_tile_index.end() && m_tile_stamps[found->second] != stamp)
+                    add(found->second);
+            }
+            nucleus::utils::sort_nearly_sorted(pass_tiles.begin(), pass_tiles.end(), compareTileSetPair, 8 * pass_tiles.size());
+
+            // one instanced draw per texture page and mesh lod, so the range is grouped by those (stable, i.e., still front to
+            // back within a batch)
+            DrawRange range { unsigned(tile_list.size()), unsigned(pass_tiles.size()), {} };
+            m_pass_tile_batches.clear();
+            order.clear();
+            for (const auto& t : pass_tiles) {
+                const auto page = t.second->texture_layer / m_layers_per_page;
+                const auto batch = page * N_MESH_LODS + mesh_lod(*t.second, camera);
+                m_pass_tile_batches.push_back(batch);
+                ++range.batch_counts[batch];
+                order.push_back(t.second->tile_id);
+            }
+            auto batch_offsets = std::array<unsigned, N_DRAW_BATCHES> {};
+            for (size_t batch = 1; batch < batch_offsets.size(); ++batch)
+                batch_offsets[batch] = batch_offsets[batch - 1] + range.batch_counts[batch - 1];
+            tile_list.resize(tile_list.size() + pass_tiles.size());
+            m_draw_tile_lods.resize(tile_list.size());
+            for (size_t j = 0; j < pass_tiles.size(); ++j) {
+                const auto batch = m_pass_tile_batches[j];
+                const auto index = range.first + batch_offsets[batch]++;
+                tile_list[index] = pass_tiles[j].second;
+                m_draw_tile_lods[index] = int32_t(batch % N_MESH_LODS);
+            }
+            m_draw_tile_curtain_edges.resize(tile_list.size());
+            for (auto index = size_t(range.first); index < tile_list.size(); ++index)
+                m_draw_tile_curtain_edges[index] = curtain_edges(*tile_list[index], unsigned(m_draw_tile_lods[index]), pass, camera);
+            ranges.push_back(range);
+        }
+        // the commands only change with the ranges
+        m_draw_commands.clear();
+        if (m_indirect_draws) {
+            for (auto& range : ranges) {
+                range.first_command = unsigned(m_draw_commands.size());
+                for (unsigned n_views = 1; n_views <= MAX_INDIRECT_VIEWS; ++n_views) {
+                    auto first = range.first;
+                    for (unsigned batch = 0; batch < N_DRAW_BATCHES; ++batch) {
+                        const auto count = range.batch_counts[batch];
+                        if (count == 0)
+                            continue;
+                        const auto& [first_index, n_indices] = m_lod_indices[batch % N_MESH_LODS];
+                        m_draw_commands.push_back({ uint32_t(n_indices), count * n_views, uint32_t(first_index), 0, first });
+                        first += count;
+                    }
+                }
+            }
+            auto* f = QOpenGLContext::currentContext()->functions();
+            f->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+            f->glBufferData(GL_DRAW_INDIRECT_BUFFER, bufferLengthInBytes(m_draw_commands), m_draw_commands.data(), GL_DYNAMIC_DRAW);
+            f->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            GlCounters::current().count_buffer_write(uint64_t(bufferLengthInBytes(m_draw_commands)));
+        }
+        m_prepared_passes.assign(passes.begin(), passes.end());
+        m_prepared_sort_position = sort_position;
+        m_prepared_lod_position = camera.position();
+        m_prepared_lod_scale = lod_scale;
+        m_prepared_order_dirty = false;
+    }
+
+    // the instance buffer only needs to be rewritten if the tiles (or their order) or the camera origin changed. and every frame
+    // with the overlays of the tile age and screen space error.
+    const auto quadrant_mask = [this](const tile::Id& id) { return drawn_quadrants(id); };
+    const auto instance_data_is_current = [&]() {
+        if (m_instance_buffer_dirty || m_instance_origin != camera.position() || m_instance_layers.size() != tile_list.size())
+            return false;
+        if (m_overlay_mode == 6 || m_overlay_mode == 8)
+            return false;
+        for (size_t i = 0; i < tile_list.size(); ++i) {
+            if (m_instance_layers[i] != tile_list[i]->texture_layer || m_instance_quadrant_masks[i] != quadrant_mask(tile_list[i]->tile_id)
+                || m_instances[i].mesh_lod != m_draw_tile_lods[i] || m_instances[i].curtain_edges != m_draw_tile_curtain_edges[i])
+                return false;
+        }
+        return true;
+    };
+
+    if (!instance_data_is_current()) {
+        auto& instances = m_instances;
+        instances.clear();
+        m_instance_layers.clear();
+        m_instance_quadrant_masks.clear();
+        const auto now = nucleus::tile_scheduler::utils::time_since_epoch();
+        for (size_t i = 0; i < tile_list.size(); ++i) {
+            const auto* tileset = tile_list[i];
+            TileInstance instance;
+            instance.bounds = glm::vec4(tileset->bounds.min.x - camera.position().x, tileset->bounds.min.y - camera.position().y,
+                tileset->bounds.max.x - camera.position().x, tileset->bounds.max.y - camera.position().y);
+            instance.altitude_correction_factor = tileset->altitude_correction_factor;
+            instance.texture_layer = int32_t(tileset->texture_layer % m_layers_per_page);
+            instance.tileset_id = int32_t(tileset->tile_id.coords[0] + tileset->tile_id.coords[1]);
+            instance.zoom_level = int32_t(tileset->tile_id.zoom_level);
+            instance.quadrant_mask = quadrant_mask(tileset->tile_id);
+            instance.mesh_lod = m_draw_tile_lods[i];
+            instance.curtain_edges = m_draw_tile_curtain_edges[i];
+            instance.overlay_value = overlay_value(*tileset, instance.quadrant_mask, camera, now);
+            instances.push_back(instance);
+            m_instance_layers.push_back(tileset->texture_layer);
+            m_instance_quadrant_masks.push_back(instance.quadrant_mask);
+        }
+        m_instance_buffer->bind();
+        // allocate orphans the old storage, so we don't stall on draws that still use it
+        m_instance_buffer->allocate(instances.data(), bufferLengthInBytes(instances));
+        GlCounters::current().count_buffer_write(uint64_t(bufferLengthInBytes(instances)));
+        m_instance_origin = camera.position();
+        m_instance_buffer_dirty = false;
+    }
+    return ranges;
+}
+
+void TileManager::draw(const DrawRange& range, unsigned n_views)
+{
+    assert(range.first + range.count <= m_instance_layers.size()); // prepare_draw must be called before
+    if (range.count == 0)
+        return;
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    auto& counters = GlCounters::current();
+
+    m_vao->bind();
+    if (n_views != 1)
+        set_instance_attribute_divisor(n_views);
+    auto bound_page = unsigned(-1);
+    const auto bind_page = [&](unsigned page) {
+        if (page == bound_page)
+            return;
+        m_texture_pages[page].ortho->bind(2);
+        m_texture_pages[page].heights->bind(1);
+        m_texture_pages[page].normals->bind(3);
+        bound_page = page;
+    };
+    if (m_indirect_draws && n_views <= MAX_INDIRECT_VIEWS) {
+        // all mesh lods of a page at once, the base instance of the commands replaces the attribute pointer offsets
+        if (m_vao_first_instance != 0)
+            set_instance_attribute_pointers(0);
+        f->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+        auto command = range.first_command + (n_views - 1) * n_draw_commands(range);
+        for (unsigned page = 0; page < MAX_TEXTURE_PAGES; ++page) {
+            const auto page_counts = std::span(range.batch_counts).subspan(page * N_MESH_LODS, N_MESH_LODS);
+            const auto n_commands = unsigned(std::count_if(page_counts.begin(), page_counts.end(), [](unsigned count) { return count > 0; }));
+            if (n_commands == 0)
+                continue;
+            bind_page(page);
+            const auto offset = reinterpret_cast<const void*>(command * sizeof(DrawCommand));
+            m_multi_draw_elements_indirect(GL_TRIANGLE_STRIP, GL_UNSIGNED_SHORT, offset, GLsizei(n_commands), 0);
+            counters.count_draw_call();
+            for (unsigned lod = 0; lod < N_MESH_LODS; ++lod) {
+                if (page_counts[lod] > 0)
+                    counters.count_instances(m_lod_indices[lod].second, page_counts[lod] * n_views);
+            }
+            command += n_commands;
+        }
+        f->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        auto first = range.first;
+        for (unsigned batch = 0; batch < N_DRAW_BATCHES; ++batch) {
+            const auto count = range.batch_counts[batch];
+            if (count == 0)
+                continue;
+            bind_page(batch / N_MESH_LODS);
+            const auto& [first_index, n_indices] = m_lod_indices[batch % N_MESH_LODS];
+            // there is no base instance in GLES 3.0, so we offset the attribute pointers instead.
+            if (m_vao_first_instance != first)
+                set_instance_attribute_pointers(first);
+            const auto offset = reinterpret_cast<const void*>(first_index * sizeof(uint16_t));
+            f->glDrawElementsInstanced(GL_TRIANGLE_STRIP, GLsizei(n_indices), GL_UNSIGNED_SHORT, offset, GLsizei(count * n_views));
+            counters.count_draw(n_indices, count * n_views);
+            first += count;
+        }
+        assert(first == range.first + range.count);
+    }
+    if (n_views != 1)
+        set_instance_attribute_divisor(1);
     f->glBindVertexArray(0);
 }
 
-void TileManager::remove_tile(const tile::Id& tile_id)
+bool TileManager::set_indirect_draws(bool enabled)
+{
+    if (enabled && !m_multi_draw_elements_indirect)
+        return false;
+    if (enabled != m_indirect_draws) {
+        m_indirect_draws = enabled;
+        m_prepared_order_dirty = true; // rebuilds the commands
+    }
+    return true;
+}
+
+bool TileManager::indirect_draws() const { return m_indirect_draws; }
+
+std::span<const TileManager::DrawCommand> TileManager::draw_commands(const DrawRange& range, unsigned n_views) const
+{
+    if (!m_indirect_draws || n_views == 0 || n_views > MAX_INDIRECT_VIEWS)
+        return {};
+    const auto n = n_draw_commands(range);
+    return std::span(m_draw_commands).subspan(range.first_command + (n_views - 1) * n, n);
+}
+
+unsigned TileManager::mesh_lod(const TileSet& tileset, const nucleus::camera::Definition& camera) const
+{
+    if (m_mesh_lod_quad_size <= 0)
+        return 0;
+    // the altitude is unknown here, the horizontal distance underestimates the distance, i.e., the lod is rather too fine
+    const auto position = glm::dvec2(camera.position());
+    const auto nearest = glm::clamp(position, tileset.bounds.min, tileset.bounds.max);
+    const auto distance = float(glm::length(position - nearest));
+    const auto size_px = camera.to_screen_space(float(tileset.bounds.size().x), std::max(distance, 1.f));
+    unsigned lod = 0;
+    while (lod + 1 < N_MESH_LODS && size_px / float(mesh_lod_edge_vertices(lod + 1) - 1) <= m_mesh_lod_quad_size)
+        ++lod;
+    return lod;
+}
+
+int32_t TileManager::drawn_quadrants(const tile::Id& id) const
+{
+    const auto it = m_quadrant_masks.find(id);
+    return int32_t(it == m_quadrant_masks.end() ? nucleus::tile_scheduler::DrawListGenerator::all_quadrants : it->second);
+}
+
+float TileManager::overlay_value(const TileSet& tileset, int32_t quadrant_mask, const nucleus::camera::Definition& camera, uint64_t now) const
+{
+    switch (m_overlay_mode) {
+    case 6: // seconds since upload
+        return float(now - std::min(now, tileset.resident_since)) / 1000.f;
+    case 7: // 0 drawn with its own layers, 1 drawn in place of missing children, 2 layers cut out of an ancestor
+        if (tileset.inherited)
+            return 2;
+        return quadrant_mask != nucleus::tile_scheduler::DrawListGenerator::all_quadrants ? 1 : 0;
+    case 8: // relative to the threshold, the tile would be refined above 1
+        return m_draw_list_generator.screen_space_error(camera, tileset.tile_id) / m_draw_list_generator.permissible_screen_space_error();
+    case 9:
+        return tileset.cost_ms;
+    default:
+        return 0;
+    }
+}
+
+void TileManager::set_overlay_mode(unsigned mode)
+{
+    if (mode == m_overlay_mode)
+        return;
+    m_overlay_mode = mode;
+    m_instance_buffer_dirty = true;
+}
+
+int32_t TileManager::curtain_edges(const TileSet& tileset, unsigned lod, const nucleus::tile_scheduler::DrawListGenerator::TileSet& pass,
+    const nucleus::camera::Definition& camera) const
+{
+    // neighbours of the same zoom level and mesh lod have the same vertices along the shared edge (the height tiles share
+    // their border texels). parts of the neighbour that are covered by its children have other vertices though, so its two
+    // quadrants along the edge must be drawn. quadrants as in DrawListGenerator::quadrant_of: 1 sw, 2 se, 4 nw, 8 ne.
+    struct Neighbour {
+        int dx;
+        int dy;
+        int32_t quadrants_along_edge;
+    };
+    constexpr std::array<Neighbour, 4> neighbours = { {
+        { 1, 0, 0b0101 }, // east, its west side
+        { 0, 1, 0b0011 }, // north, its south side
+        { -1, 0, 0b1010 }, // west, its east side
+        { 0, -1, 0b1100 }, // south, its north side
+    } };
+    const auto& id = tileset.tile_id;
+    const auto n_tiles = int64_t(1) << id.zoom_level;
+    int32_t edges = ALL_CURTAIN_EDGES;
+    for (unsigned edge = 0; edge < neighbours.size(); ++edge) {
+        const auto x = int64_t(id.coords.x) + neighbours[edge].dx;
+        const auto y = int64_t(id.coords.y) + neighbours[edge].dy;
+        if (x < 0 || y < 0 || x >= n_tiles || y >= n_tiles)
+            continue;
+        const auto neighbour = tile::Id { id.zoom_level, { unsigned(x), unsigned(y) } };
+        if (!pass.contains(neighbour))
+            continue;
+        const auto found = m_tile_index.find(neighbour);
+        if (found == m_tile_index.end() || mesh_lod(m_gpu_tiles[found->second], camera) != lod)
+            continue;
+        const auto quadrants = neighbours[edge].quadrants_along_edge;
+        if ((drawn_quadrants(neighbour) & quadrants) == quadrants)
+            edges &= ~(1 << edge);
+    }
+    return edges;
+}
+
+int32_t TileManager::curtain_edges(const DrawRange& range, const tile::Id& id) const
+{
+    for (auto i = range.first; i < range.first + range.count && i < m_draw_tile_list.size(); ++i) {
+        if (m_draw_tile_list[i]->tile_id == id)
+            return m_draw_tile_curtain_edges[i];
+    }
+    return 0;
+}
+
+void TileManager::remove_quad(const tile::Id& quad_id)
 {
     if (!QOpenGLContext::currentContext()) // can happen during shutdown.
         return;
 
-    const auto t = std::find(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile_id);
-    assert(t != m_loaded_tiles.end()); // removing a tile that's not here. likely there is a race.
-    *t = tile::Id { unsigned(-1), {} };
-    m_draw_list_generator.remove_tile(tile_id);
+    const auto queued = std::find_if(m_upload_queue.begin(), m_upload_queue.end(), [&](const auto& quad) { return quad.id == quad_id; });
+    if (queued != m_upload_queue.end()) {
+        m_upload_queue.erase(queued); // never made it to the gpu
+        return;
+    }
+    const auto in_flight = std::find_if(m_in_flight_uploads.begin(), m_in_flight_uploads.end(), [&](const auto& u) { return !u.cancelled && u.quad.id == quad_id; });
+    if (in_flight != m_in_flight_uploads.end()) {
+        in_flight->cancelled = true;
+        in_flight->quad = {}; // release the textures
+        return;
+    }
 
-    // clear slot
-    // or remove from list and free resources
-    const auto found_tile = std::find_if(m_gpu_tiles.begin(), m_gpu_tiles.end(), [&tile_id](const TileSet& tileset) { return tileset.tile_id == tile_id; });
-    if (found_tile != m_gpu_tiles.end())
-        m_gpu_tiles.erase(found_tile);
+    const auto found = m_quad_layers.find(quad_id);
+    if (found == m_quad_layers.end() && m_released_quads.erase(quad_id))
+        return; // dropped by a resize, the scheduler didn't know yet
+    assert(found != m_quad_layers.end()); // removing a quad that's not here. likely there is a race.
+    if (found == m_quad_layers.end())
+        return;
+    m_free_quad_layers.push_back(found->second);
+    m_quad_layers.erase(found);
+    for (const auto& id : quad_id.children())
+        remove_resident_tile(id);
+    m_instance_buffer_dirty = true;
+    m_prepared_order_dirty = true;
+    m_draw_list_dirty = true;
 
     emit tiles_changed();
 }
 
+void TileManager::remove_resident_tile(const tile::Id& id)
+{
+    const auto found = m_tile_index.find(id);
+    assert(found != m_tile_index.end());
+    if (found == m_tile_index.end())
+        return;
+    const auto index = found->second;
+    m_tile_index.erase(found);
+    set_tile_available(id, false);
+    m_undrawn_tiles.erase(id);
+
+    // swap-remove from m_gpu_tiles (the order is irrelevant, draw sorts on its own)
+    if (index != m_gpu_tiles.size() - 1) {
+        m_gpu_tiles[index] = m_gpu_tiles.back();
+        m_tile_index[m_gpu_tiles[index].tile_id] = index;
+    }
+    m_gpu_tiles.pop_back();
+    ++m_resident_version;
+}
+
 void TileManager::initilise_attribute_locations(ShaderProgram* program)
 {
-    int bounds = program->attribute_location("bounds");
-    qDebug() << "attrib location for bounds: " << bounds;
-    int tileset_id = program->attribute_location("tileset_id");
-    qDebug() << "attrib location for tileset_id: " << tileset_id;
-    int zoom_level = program->attribute_location("tileset_zoomlevel");
-    qDebug() << "attrib location for zoom_level: " << zoom_level;
-    int texture_layer = program->attribute_location("texture_layer");
-    qDebug() << "attrib location for texture_layer: " << texture_layer;
+    m_attribute_locations.bounds = program->attribute_location("bounds");
+    qDebug() << "attrib location for bounds: " << m_attribute_locations.bounds;
+    m_attribute_locations.tileset_id = program->attribute_location("tileset_id");
+    qDebug() << "attrib location for tileset_id: " << m_attribute_locations.tileset_id;
+    m_attribute_locations.zoom_level = program->attribute_location("tileset_zoomlevel");
+    qDebug() << "attrib location for zoom_level: " << m_attribute_locations.zoom_level;
+    m_attribute_locations.texture_layer = program->attribute_location("texture_layer");
+    qDebug() << "attrib location for texture_layer: " << m_attribute_locations.texture_layer;
+    m_attribute_locations.altitude_correction_factor = program->attribute_location("altitude_correction_factor");
+    qDebug() << "attrib location for altitude_correction_factor: " << m_attribute_locations.altitude_correction_factor;
+    m_attribute_locations.quadrant_mask = program->attribute_location("quadrant_mask");
+    qDebug() << "attrib location for quadrant_mask: " << m_attribute_locations.quadrant_mask;
+    m_attribute_locations.mesh_lod = program->attribute_location("mesh_lod");
+    qDebug() << "attrib location for mesh_lod: " << m_attribute_locations.mesh_lod;
+    m_attribute_locations.curtain_edges = program->attribute_location("curtain_edges");
+    qDebug() << "attrib location for curtain_edges: " << m_attribute_locations.curtain_edges;
+    m_attribute_locations.overlay_value = program->attribute_location("overlay_value");
+    qDebug() << "attrib location for overlay_value: " << m_attribute_locations.overlay_value;
 
     m_vao->bind();
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
-    if (bounds != -1) {
-        m_bounds_buffer->bind();
-        f->glEnableVertexAttribArray(GLuint(bounds));
-        f->glVertexAttribPointer(GLuint(bounds), /*size*/ 4, /*type*/ GL_FLOAT, /*normalised*/ GL_FALSE, /*stride*/ 0, nullptr);
-        f->glVertexAttribDivisor(GLuint(bounds), 1);
-    }
-    if (tileset_id != -1) {
-        m_tileset_id_buffer->bind();
-        f->glEnableVertexAttribArray(GLuint(tileset_id));
-        f->glVertexAttribIPointer(GLuint(tileset_id), /*size*/ 1, /*type*/ GL_INT, /*stride*/ 0, nullptr);
-        f->glVertexAttribDivisor(GLuint(tileset_id), 1);
-    }
-    if (zoom_level != -1) {
-        m_zoom_level_buffer->bind();
-        f->glEnableVertexAttribArray(GLuint(zoom_level));
-        f->glVertexAttribIPointer(GLuint(zoom_level), /*size*/ 1, /*type*/ GL_INT, /*stride*/ 0, nullptr);
-        f->glVertexAttribDivisor(GLuint(zoom_level), 1);
+    for (const auto location : { m_attribute_locations.bounds, m_attribute_locations.altitude_correction_factor, m_attribute_locations.tileset_id,
+             m_attribute_locations.zoom_level, m_attribute_locations.texture_layer, m_attribute_locations.quadrant_mask, m_attribute_locations.mesh_lod,
+             m_attribute_locations.curtain_edges, m_attribute_locations.overlay_value }) {
+        if (location != -1)
+            f->glEnableVertexAttribArray(GLuint(location));
     }
-    if (texture_layer != -1) {
-        m_texture_layer_buffer->bind();
-        f->glEnableVertexAttribArray(GLuint(texture_layer));
-        f->glVertexAttribIPointer(GLuint(texture_layer), /*size*/ 1, /*type*/ GL_INT, /*stride*/ 0, nullptr);
-        f->glVertexAttribDivisor(GLuint(texture_layer), 1);
+    set_instance_attribute_divisor(1);
+    set_instance_attribute_pointers(0);
+    m_vao->release();
+}
+
+void TileManager::set_instance_attribute_divisor(unsigned divisor)
+{
+    // expects m_vao to be bound
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (const auto location : { m_attribute_locations.bounds, m_attribute_locations.altitude_correction_factor, m_attribute_locations.tileset_id,
+             m_attribute_locations.zoom_level, m_attribute_locations.texture_layer, m_attribute_locations.quadrant_mask, m_attribute_locations.mesh_lod,
+             m_attribute_locations.curtain_edges, m_attribute_locations.overlay_value }) {
+        if (location != -1)
+            f->glVertexAttribDivisor(GLuint(location), divisor);
     }
 }
 
+void TileManager::set_instance_attribute_pointers(unsigned first_instance)
+{
+    // expects m_vao to be bound
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    m_instance_buffer->bind();
+    constexpr auto stride = GLsizei(sizeof(TileInstance));
+    const auto offset = [first_instance](size_t member_offset) { return reinterpret_cast<void*>(first_instance * sizeof(TileInstance) + member_offset); };
+    const auto& l = m_attribute_locations;
+    if (l.bounds != -1)
+        f->glVertexAttribPointer(GLuint(l.bounds), /*size*/ 4, /*type*/ GL_FLOAT, /*normalised*/ GL_FALSE, stride, offset(offsetof(TileInstance, bounds)));
+    if (l.altitude_correction_factor != -1)
+        f->glVertexAttribPointer(GLuint(l.altitude_correction_factor), /*size*/ 2, /*type*/ GL_FLOAT, /*normalised*/ GL_FALSE, stride, offset(offsetof(TileInstance, altitude_correction_factor)));
+    if (l.tileset_id != -1)
+        f->glVertexAttribIPointer(GLuint(l.tileset_id), /*size*/ 1, /*type*/ GL_INT, stride, offset(offsetof(TileInstance, tileset_id)));
+    if (l.zoom_level != -1)
+        f->glVertexAttribIPointer(GLuint(l.zoom_level), /*size*/ 1, /*type*/ GL_INT, stride, offset(offsetof(TileInstance, zoom_level)));
+    if (l.texture_layer != -1)
+        f->glVertexAttribIPointer(GLuint(l.texture_layer), /*size*/ 1, /*type*/ GL_INT, stride, offset(offsetof(TileInstance, texture_layer)));
+    if (l.quadrant_mask != -1)
+        f->glVertexAttribIPointer(GLuint(l.quadrant_mask), /*size*/ 1, /*type*/ GL_INT, stride, offset(offsetof(TileInstance, quadrant_mask)));
+    if (l.mesh_lod != -1)
+        f->glVertexAttribIPointer(GLuint(l.mesh_lod), /*size*/ 1, /*type*/ GL_INT, stride, offset(offsetof(TileInstance, mesh_lod)));
+    if (l.curtain_edges != -1)
+        f->glVertexAttribIPointer(GLuint(l.curtain_edges), /*size*/ 1, /*type*/ GL_INT, stride, offset(offsetof(TileInstance, curtain_edges)));
+    if (l.overlay_value != -1)
+        f->glVertexAttribPointer(GLuint(l.overlay_value), /*size*/ 1, /*type*/ GL_FLOAT, /*normalised*/ GL_FALSE, stride, offset(offsetof(TileInstance, overlay_value)));
+    m_vao_first_instance = first_instance;
+}
+
 void TileManager::set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbDecoratorPtr& new_aabb_decorator)
 {
+    wait_for_tilelist();
     m_draw_list_generator.set_aabb_decorator(new_aabb_decorator);
+    m_draw_list_dirty = true;
+}
+
+void TileManager::set_latency_tracer(const nucleus::tile_scheduler::LatencyTracerPtr& tracer)
+{
+    m_latency_tracer = tracer;
+    m_undrawn_tiles.clear();
+}
+
+void TileManager::set_upload_thread_policy(const nucleus::utils::ThreadPolicy& policy)
+{
+    m_upload_thread_policy = policy;
+    if (m_uploader)
+        m_uploader->set_thread_policy(policy);
+}
+
+void TileManager::report_drawn(const nucleus::tile_scheduler::DrawListGenerator::TileSet& drawn)
+{
+    if (m_undrawn_tiles.empty() || !m_latency_tracer)
+        return;
+    std::vector<tile::Id> quads; // siblings repeat their quad, the trace ends with the first one
+    for (const auto& id : drawn) {
+        if (m_undrawn_tiles.erase(id) && id.zoom_level > 0)
+            quads.push_back(id.parent());
+    }
+    m_latency_tracer->mark(quads, nucleus::tile_scheduler::LatencyTracer::Stage::Drawn);
 }
 
 void TileManager::set_quad_limit(unsigned int new_limit)
 {
-    m_loaded_tiles.resize(new_limit * 4);
-    std::fill(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile::Id { unsigned(-1), {} });
+    m_target_n_layers = new_limit * 4;
+    if (!m_vao) { // before init, there are no tiles yet
+        assert(m_gpu_tiles.empty());
+        m_n_layers = m_target_n_layers;
+        reset_free_layers(0);
+        m_tile_index.clear();
+        m_tile_index.reserve(m_n_layers);
+        m_gpu_tiles.reserve(m_n_layers);
+        m_quad_layers.reserve(m_n_layers / 4);
+        emit quad_limit_changed(new_limit);
+        return;
+    }
+    m_target_n_layers = std::min(m_target_n_layers, max_n_layers());
+    // growing is announced once the arrays are reallocated, shrinking right away, so that the scheduler removes the surplus
+    if (m_target_n_layers <= m_n_layers)
+        emit quad_limit_changed(m_target_n_layers / 4);
+}
+
+unsigned TileManager::quad_limit() const { return m_target_n_layers / 4; }
+
+unsigned TileManager::allocated_quad_limit() const { return m_n_layers / 4; }
+
+void TileManager::set_max_layers_per_page(unsigned new_max_layers_per_page)
+{
+    assert(!m_vao); // before init
+    assert(new_max_layers_per_page >= 4);
+    m_layers_per_page = new_max_layers_per_page / 4 * 4;
+}
+
+unsigned TileManager::n_texture_pages() const { return unsigned(m_texture_pages.size()); }
+
+unsigned TileManager::max_n_layers() const { return MAX_TEXTURE_PAGES * m_layers_per_page; }
+
+std::vector<TileManager::TexturePage> TileManager::allocate_texture_pages(unsigned n_layers) const
+{
+    std::vector<TexturePage> pages;
+    for (unsigned first = 0; first < n_layers; first += m_layers_per_page) {
+        const auto n_page_layers = std::min(m_layers_per_page, n_layers - first);
+        TexturePage page;
+        page.ortho = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::CompressedRGBA8);
+        page.ortho->setParams(Texture::Filter::MipMapLinear, Texture::Filter::Linear);
+        page.ortho->set_memory_subsystem("tiles");
+        page.ortho->allocate_array(m_tile_format.ortho_size, m_tile_format.ortho_size, n_page_layers);
+        page.heights = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::R16UI);
+        page.heights->setParams(Texture::Filter::Nearest, Texture::Filter::Nearest);
+        page.heights->set_memory_subsystem("tiles");
+        page.heights->allocate_array(m_tile_format.height_size, m_tile_format.height_size, n_page_layers);
+        page.normals = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::RG8);
+        page.normals->setParams(Texture::Filter::Linear, Texture::Filter::Linear);
+        page.normals->set_memory_subsystem("tiles");
+        page.normals->allocate_array(m_tile_format.height_size, m_tile_format.height_size, n_page_layers);
+        pages.push_back(std::move(page));
+    }
+    return pages;
+}
+
+void TileManager::reset_free_layers(unsigned n_used)
+{
+    assert(n_used * 4 <= m_n_layers);
+    m_free_quad_layers.resize(m_n_layers / 4 - n_used);
+    // reversed, so that slots are handed out starting with the lowest
+    std::generate(m_free_quad_layers.rbegin(), m_free_quad_layers.rend(), [i = n_used * 4]() mutable { return std::exchange(i, i + 4); });
+}
+
+void TileManager::apply_quad_limit()
+{
+    if (m_target_n_layers == m_n_layers || !m_in_flight_uploads.empty()) // uploads in flight write into the current arrays
+        return;
+    if (m_gpu_tiles.size() > m_target_n_layers) // the scheduler didn't delete the surplus yet
+        return;
+
+    auto pages = allocate_texture_pages(m_target_n_layers);
+    if (Texture::can_copy_layers()) {
+        // compacted, the free slots are at the end of the new pages
+        unsigned to = 0;
+        for (auto& [quad_id, first_layer] : m_quad_layers) {
+            const auto& source = m_texture_pages[first_layer / m_layers_per_page];
+            auto& destination = pages[to / m_layers_per_page];
+            std::array<std::pair<unsigned, unsigned>, 4> moves;
+            for (unsigned i = 0; i < 4; ++i)
+                moves[i] = { first_layer % m_layers_per_page + i, to % m_layers_per_page + i };
+            destination.ortho->copy_layers(*source.ortho, moves);
+            destination.heights->copy_layers(*source.heights, moves);
+            destination.normals->copy_layers(*source.normals, moves);
+            for (const auto& id : quad_id.children()) {
+                auto& tileset = m_gpu_tiles[m_tile_index.at(id)];
+                tileset.texture_layer = to + (tileset.texture_layer - first_layer);
+            }
+            first_layer = to;
+            to += 4;
+        }
+    } else if (!m_quad_layers.empty()) {
+        m_released_quads.clear();
+        for (const auto& [quad_id, first_layer] : m_quad_layers)
+            m_released_quads.insert(quad_id);
+        for (const auto& tileset : m_gpu_tiles)
+            set_tile_available(tileset.tile_id, false);
+        m_quad_layers.clear();
+        m_gpu_tiles.clear();
+        ++m_resident_version;
+        m_tile_index.clear();
+        m_undrawn_tiles.clear();
+        emit gpu_tiles_released();
+    }
+    m_texture_pages = std::move(pages);
+    if (m_uploader) // the new textures must be visible in the upload context
+        QOpenGLContext::currentContext()->functions()->glFlush();
+
+    m_n_layers = m_target_n_layers;
+    reset_free_layers(unsigned(m_quad_layers.size()));
+    m_tile_index.reserve(m_n_layers);
+    m_gpu_tiles.reserve(m_n_layers);
+    m_quad_layers.reserve(m_n_layers / 4);
+    m_instance_buffer_dirty = true;
+    m_prepared_order_dirty = true;
+    m_draw_list_dirty = true;
+
+    emit quad_limit_changed(m_n_layers / 4);
+    emit tiles_changed();
 }
 
-void TileManager::add_tile(
-    const tile::Id& id, tile::SrsAndHeightBounds bounds, const nucleus::utils::ColourTexture& ortho_texture, const nucleus::Raster<uint16_t>& height_map)
+void TileManager::add_quad(const nucleus::tile_scheduler::tile_types::GpuTileQuad& quad)
 {
     if (!QOpenGLContext::currentContext()) // can happen during shutdown.
         return;
 
-    TileSet tileset;
-    tileset.tile_id = id;
-    tileset.bounds = tile::SrsBounds(bounds);
+    // take a free slot and upload the textures of all four tiles at once
+    assert(!m_free_quad_layers.empty());
+    assert(!m_quad_layers.contains(quad.id));
+    const auto first_layer = m_free_quad_layers.back();
+    m_free_quad_layers.pop_back();
+    auto& page = m_texture_pages[first_layer / m_layers_per_page];
+    const auto start = std::chrono::steady_clock::now();
+    upload_quad({ 0, page.ortho.get(), page.heights.get(), page.normals.get(), first_layer % m_layers_per_page, quad }, m_staging_ring.get());
+    make_resident(quad, first_layer, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
 
-    // find empty spot and upload texture
-    const auto t = std::find(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile::Id { unsigned(-1), {} });
-    assert(t != m_loaded_tiles.end());
-    *t = id;
-    const auto layer_index = unsigned(t - m_loaded_tiles.begin());
-    tileset.texture_layer = layer_index;
-    m_ortho_textures->upload(ortho_texture, layer_index);
-    m_heightmap_textures->upload(height_map, layer_index);
+void TileManager::make_resident(const nucleus::tile_scheduler::tile_types::GpuTileQuad& quad, unsigned first_layer, float upload_ms)
+{
+    const auto now = nucleus::tile_scheduler::utils::time_since_epoch();
+    assert(!m_quad_layers.contains(quad.id));
+    m_quad_layers[quad.id] = first_layer;
+    for (unsigned i = 0; i < quad.tiles.size(); ++i) {
+        const auto& tile = quad.tiles[i];
+        TileSet tileset;
+        tileset.tile_id = tile.id;
+        tileset.bounds = tile::SrsBounds(tile.bounds);
+        tileset.altitude_correction_factor = altitude_correction_factors(tileset.bounds);
+        tileset.texture_layer = first_layer + i;
+        tileset.resident_since = now;
+        tileset.cost_ms = quad.decode_ms + upload_ms;
+        tileset.inherited = tile.inherited;
 
-    // add to m_gpu_tiles
-    m_gpu_tiles.push_back(tileset);
-    m_draw_list_generator.add_tile(id);
+        // add to m_gpu_tiles
+        assert(!m_tile_index.contains(tile.id));
+        m_tile_index[tile.id] = m_gpu_tiles.size();
+        m_gpu_tiles.push_back(tileset);
+        ++m_resident_version;
+        set_tile_available(tile.id, true);
+        if (m_latency_tracer && m_latency_tracer->enabled()) {
+            m_latency_tracer->mark_tile(tile.id, nucleus::tile_scheduler::LatencyTracer::Stage::Uploaded);
+            m_undrawn_tiles.insert(tile.id);
+        }
+    }
+    m_instance_buffer_dirty = true;
+    m_prepared_order_dirty = true;
+    m_draw_list_dirty = true;
 
     emit tiles_changed();
 }
 
 void TileManager::set_permissible_screen_space_error(float new_permissible_screen_space_error)
 {
+    wait_for_tilelist();
     m_draw_list_generator.set_permissible_screen_space_error(new_permissible_screen_space_error);
+    m_draw_list_dirty = true;
+}
+
+void TileManager::set_min_tile_contribution(float min_size)
+{
+    wait_for_tilelist();
+    m_draw_list_generator.set_min_tile_contribution(min_size);
+    m_draw_list_dirty = true;
+}
+
+unsigned TileManager::ortho_mip_levels(unsigned ortho_size)
+{
+    return nucleus::utils::ColourTexture::max_mip_levels(ortho_size, ortho_size, Texture::compression_algorithm());
+}
+
+void TileManager::set_tile_format(const nucleus::tile_scheduler::tile_types::TileFormat& new_tile_format)
+{
+    assert(new_tile_format.valid());
+    assert(m_texture_pages.empty()); // before init
+    m_tile_format = new_tile_format;
+}
+
+const nucleus::tile_scheduler::tile_types::TileFormat& TileManager::tile_format() const { return m_tile_format; }
+
+unsigned TileManager::mesh_lod_edge_vertices(unsigned lod) const
+{
+    assert(lod < N_MESH_LODS);
+    return ((m_tile_format.height_size - 1) >> lod) + 1;
+}
+
+void TileManager::set_mesh_lod_quad_size(float new_mesh_lod_quad_size)
+{
+    m_mesh_lod_quad_size = new_mesh_lod_quad_size;
+    m_prepared_order_dirty = true;
 }
 
 void TileManager::update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads)
 {
-    for (const auto& quad : deleted_quads) {
-        for (const auto& id : quad.children()) {
-            remove_tile(id);
-        }
-    }
+    for (const auto& quad : deleted_quads)
+        remove_quad(quad);
     for (const auto& quad : new_quads) {
-        for (const auto& tile : quad.tiles) {
+        assert(!m_quad_layers.contains(quad.id));
+        m_released_quads.erase(quad.id);
+        auto queued_quad = quad;
+        for (auto& tile : queued_quad.tiles) {
             // test for validity
             assert(tile.id.zoom_level < 100);
             assert(tile.height);
             assert(tile.ortho);
-            add_tile(tile.id, tile.bounds, *tile.ortho, *tile.height);
+            assert(!m_tile_index.contains(tile.id));
         }
+        const auto queued = std::find_if(m_upload_queue.begin(), m_upload_queue.end(), [&](const auto& q) { return q.id == quad.id; });
+        if (queued != m_upload_queue.end())
+            *queued = std::move(queued_quad);
+        else
+            m_upload_queue.push_back(std::move(queued_quad));
+    }
+}
+
+void TileManager::set_upload_budget(const UploadBudget& new_budget) { m_upload_budget = new_budget; }
+
+const TileManager::UploadBudget& TileManager::upload_budget() const { return m_upload_budget; }
+
+size_t TileManager::n_queued_tiles() const { return m_upload_queue.size() * 4; }
+
+const std::vector<TileSet>& TileManager::tiles() const { return m_gpu_tiles; }
+
+void TileManager::sort_upload_queue(const nucleus::camera::Definition& camera)
+{
+    // zoom level first, the distance (< 1e8 m) to the centre of the quad breaks ties
+    m_upload_order.clear();
+    for (size_t i = 0; i < m_upload_queue.size(); ++i) {
+        auto centre = glm::dvec3(0.0);
+        for (const auto& tile : m_upload_queue[i].tiles)
+            centre += (tile.bounds.min + tile.bounds.max) * 0.125;
+        const auto distance = glm::distance(camera.position(), centre);
+        m_upload_order.emplace_back(double(m_upload_queue[i].id.zoom_level) * 1e8 + std::min(distance, 1e8 - 1), i);
+    }
+    std::sort(m_upload_order.begin(), m_upload_order.end());
+}
+
+void TileManager::erase_from_upload_queue(size_t n_first_in_order)
+{
+    // swap-remove (the queue order is irrelevant, it's sorted every frame). highest index first, so that the swapped in back
+    // element is never one of the erased
+    std::sort(m_upload_order.begin(), m_upload_order.begin() + ptrdiff_t(n_first_in_order), [](const auto& a, const auto& b) { return a.second > b.second; });
+    for (size_t i = 0; i < n_first_in_order; ++i) {
+        std::swap(m_upload_queue[m_upload_order[i].second], m_upload_queue.back());
+        m_upload_queue.pop_back();
+    }
+    m_upload_order.clear();
+}
+
+bool TileManager::process_upload_queue(const nucleus::camera::Definition& camera)
+{
+    apply_quad_limit();
+    if (m_uploader)
+        return process_background_uploads(camera);
+    if (m_upload_queue.empty())
+        return false;
+    const auto start = std::chrono::steady_clock::now();
+    sort_upload_queue(camera);
+
+    size_t n_uploaded = 0;
+    size_t n_bytes = 0;
+    for (const auto& [priority, index] : m_upload_order) {
+        if (m_free_quad_layers.empty())
+            break; // shrinking, the scheduler deletes quads before it sends more
+        const auto& quad = m_upload_queue[index];
+        size_t quad_bytes = 0;
+        for (const auto& tile : quad.tiles)
+            quad_bytes += tile.ortho->n_bytes() + tile.height->buffer_length() * sizeof(uint16_t) + (tile.normals ? tile.normals->buffer_length() * sizeof(glm::u8vec2) : 0);
+        const auto elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const auto over_budget = (m_upload_budget.n_bytes > 0 && n_bytes + quad_bytes > m_upload_budget.n_bytes)
+            || (m_upload_budget.milliseconds > 0 && elapsed_ms >= m_upload_budget.milliseconds);
+        if (n_uploaded > 0 && over_budget)
+            break;
+        add_quad(quad);
+        n_bytes += quad_bytes;
+        ++n_uploaded;
+    }
+    erase_from_upload_queue(n_uploaded);
+    return !m_upload_queue.empty();
+}
+
+bool TileManager::process_background_uploads(const nucleus::camera::Definition& camera)
+{
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+    if (!m_uploader->is_running()) {
+        // the upload thread failed, the quads that it didn't finish go back to the queue
+        for (const auto& upload : m_in_flight_uploads) {
+            m_free_quad_layers.push_back(upload.first_layer);
+            if (upload.fence)
+                f->glDeleteSync(upload.fence);
+            if (!upload.cancelled)
+                m_upload_queue.push_back(upload.quad);
+        }
+        m_in_flight_uploads.clear();
+        m_uploader.reset();
+        return process_upload_queue(camera);
+    }
+
+    for (const auto& finished : m_uploader->take_finished()) {
+        const auto upload = std::find_if(m_in_flight_uploads.begin(), m_in_flight_uploads.end(), [&](const auto& u) { return u.ticket == finished.ticket; });
+        assert(upload != m_in_flight_uploads.end());
+        upload->fence = finished.fence;
+        upload->upload_ms = finished.upload_ms;
+    }
+    // fences are signalled in order, the first pending one ends the scan
+    size_t n_done = 0;
+    for (auto& upload : m_in_flight_uploads) {
+        if (!upload.fence || f->glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+        f->glDeleteSync(upload.fence);
+        if (upload.cancelled)
+            m_free_quad_layers.push_back(upload.first_layer);
+        else
+            make_resident(upload.quad, upload.first_layer, upload.upload_ms);
+        ++n_done;
+    }
+    m_in_flight_uploads.erase(m_in_flight_uploads.begin(), m_in_flight_uploads.begin() + ptrdiff_t(n_done));
+
+    // the render thread doesn't pay for the uploads, so the whole queue is handed over (as long as there are free slots).
+    // nothing while a resize is pending, it waits for the uploads in flight
+    if (m_target_n_layers != m_n_layers)
+        return !m_in_flight_uploads.empty();
+    sort_upload_queue(camera);
+    std::vector<BackgroundUploader::Job> jobs;
+    for (const auto& [priority, index] : m_upload_order) {
+        if (m_free_quad_layers.empty())
+            break; // slots of cancelled uploads are still in use
+        const auto first_layer = m_free_quad_layers.back();
+        m_free_quad_layers.pop_back();
+        const auto ticket = m_next_upload_ticket++;
+        auto& page = m_texture_pages[first_layer / m_layers_per_page];
+        jobs.push_back({ ticket, page.ortho.get(), page.heights.get(), page.normals.get(), first_layer % m_layers_per_page, m_upload_queue[index] });
+        m_in_flight_uploads.push_back({ ticket, first_layer, false, nullptr, m_upload_queue[index] });
     }
+    erase_from_upload_queue(jobs.size());
+    if (!jobs.empty())
+        m_uploader->upload(std::move(jobs));
+    return !m_upload_queue.empty() || !m_in_flight_uploads.empty();
 }
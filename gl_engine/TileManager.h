@@ -20,71 +20,345 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <QObject>
 #include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
 #include <QOpenGLVertexArrayObject>
 
+#include "gl_engine/BackgroundUploader.h"
+#include "gl_engine/StagingRing.h"
 #include "gl_engine/Texture.h"
 #include "gl_engine/TileSet.h"
 #include <nucleus/Tile.h>
 #include <nucleus/tile_scheduler/DrawListGenerator.h>
+#include <nucleus/tile_scheduler/LatencyTracer.h>
 #include <nucleus/tile_scheduler/tile_types.h>
 
 namespace camera {
 class Definition;
 }
 
+class QOffscreenSurface;
 class QOpenGLShaderProgram;
+class QThreadPool;
 
 namespace gl_engine {
 class Atmosphere;
+class GpuTileCuller;
 class ShaderProgram;
 
 class TileManager : public QObject {
     Q_OBJECT
 public:
     explicit TileManager(QObject* parent = nullptr);
+    ~TileManager() override;
     void init(); // needs OpenGL context
+    // after init, with the render context current. the textures are uploaded on a thread with a shared context then, and the
+    // tiles become resident once their fence is signalled. false if that's not supported (webgl, no shared context).
+    bool enable_background_uploads(std::shared_ptr<QOffscreenSurface> surface);
+    [[nodiscard]] bool has_background_uploads() const;
     [[nodiscard]] const std::vector<TileSet>& tiles() const;
-    void draw(ShaderProgram* shader_program, const nucleus::camera::Definition& camera, const nucleus::tile_scheduler::DrawListGenerator::TileSet& draw_tiles, bool sort_tiles, glm::dvec3 sort_position) const;
+    // instance data is uploaded once per frame by prepare_draw and then reused by all passes (shadow cascades, gbuffer).
+    // tiles are drawn with a coarser mesh if its quads would be smaller than the mesh lod quad size on screen. every lod halves
+    // the vertices per edge of the height grid, e.g., 65, 33, 17, 9 for the default format (see mesh_lod_edge_vertices)
+    static constexpr unsigned N_MESH_LODS = 4;
+    // the tile textures are split into several arrays (pages) if the pool doesn't fit GL_MAX_ARRAY_TEXTURE_LAYERS
+    static constexpr unsigned MAX_TEXTURE_PAGES = 8;
+    static constexpr unsigned N_DRAW_BATCHES = MAX_TEXTURE_PAGES * N_MESH_LODS;
+    struct DrawRange {
+        unsigned first = 0;
+        unsigned count = 0;
+        // the range is grouped by texture page, and within a page by mesh lod (finest first). one instanced draw per batch.
+        std::array<unsigned, N_DRAW_BATCHES> batch_counts = {};
+        unsigned first_command = 0; // of the range in the indirect commands of the last prepare_draw (see set_indirect_draws)
+    };
+    // returns one range per pass (valid until the next call). tiles within a range are sorted front to back wrt sort_position
+    // (within each mesh lod).
+    const std::vector<DrawRange>& prepare_draw(const nucleus::camera::Definition& camera,
+        std::span<const nucleus::tile_scheduler::DrawListGenerator::TileSet> passes,
+        glm::dvec3 sort_position);
+    // draws a range of the last prepared draw. with n_views > 1, every tile is drawn n_views times in a row (the shader
+    // tells the copies apart by gl_InstanceID % n_views), e.g., for all shadow cascades in one draw call. the textures are bound
+    // to the sampler units of the tile program layout (see ShaderManager), the program must be bound already.
+    void draw(const DrawRange& range, unsigned n_views = 1);
+    // desktop gl 4.3: a range is drawn with one glMultiDrawElementsIndirect per texture page (usually one) instead of one
+    // instanced draw per batch. the commands are built by prepare_draw for 1 to MAX_INDIRECT_VIEWS views, larger n_views
+    // fall back to the instanced draws. with the context current, returns false if that's not supported (gles, webgl).
+    // on by default where supported.
+    bool set_indirect_draws(bool enabled);
+    [[nodiscard]] bool indirect_draws() const;
+    static constexpr unsigned MAX_INDIRECT_VIEWS = 4;
+    // layout of the commands in GL_DRAW_INDIRECT_BUFFER
+    struct DrawCommand {
+        uint32_t count;
+        uint32_t instance_count;
+        uint32_t first_index;
+        int32_t base_vertex;
+        uint32_t base_instance;
+    };
+    // the commands of a range of the last prepare_draw, one per non empty batch (empty without indirect draws)
+    [[nodiscard]] std::span<const DrawCommand> draw_commands(const DrawRange& range, unsigned n_views = 1) const;
+    // the edges of a tile get a curtain (skirt) only where a crack can appear, i.e., not towards a neighbour of the same pass
+    // with the same zoom level and mesh lod, that is drawn along the whole edge. bits in the order of the curtain vertices:
+    // 1 east, 2 north, 4 west, 8 south. for a tile of a range of the last prepare_draw, 0 if it's not in there.
+    static constexpr int32_t ALL_CURTAIN_EDGES = 0b1111;
+    [[nodiscard]] int32_t curtain_edges(const DrawRange& range, const tile::Id& id) const;
 
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet generate_tilelist(const nucleus::camera::Definition& camera) const;
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Frustum& frustum) const;
+    // also updates the quadrant masks of partially refined tiles, which prepare_draw sends along.
+    // the storage of the draw list (and of the outputs below) is reused between frames, so steady state frames don't allocate.
+    // the last list is returned as is if neither the camera nor the tiles changed (see draw_list_version).
+    const nucleus::tile_scheduler::DrawListGenerator::TileSet& generate_tilelist(const nucleus::camera::Definition& camera);
+    // starts generating the draw list for the camera on a worker thread, so that it overlaps with the gl work of the frame that
+    // doesn't need it (atmosphere, uploads). generate_tilelist waits for it and takes it if the camera is the same. tiles that
+    // become resident meanwhile are added to the generator afterwards and show up in the next list, removed tiles discard it.
+    // until generate_tilelist, the draw list generator must not be used otherwise (culling, tile bounds). no-op without threads.
+    void start_tilelist(const nucleus::camera::Definition& camera);
+    // incremented whenever generate_tilelist actually generated a new list
+    [[nodiscard]] uint64_t draw_list_version() const;
+    // incremented whenever a tile became resident or was released
+    [[nodiscard]] uint64_t resident_version() const { return m_resident_version; }
+    // with gpu culling, gpu_view is the index of the frustum in start_gpu_culling. the masks of the last finished gpu test are
+    // used then, the tiles are tested on the cpu if there is none for the current gpu tiles.
+    void cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset,
+        const nucleus::camera::Frustum& frustum,
+        nucleus::tile_scheduler::DrawListGenerator::TileSet* visible,
+        std::optional<unsigned> gpu_view = {}) const;
+    // frustum culling of the gpu tiles on the gpu (see GpuTileCuller). with the context current, returns false if that's not
+    // supported (webgl). off by default.
+    bool set_gpu_culling(bool enabled);
+    [[nodiscard]] bool gpu_culling() const;
+    // once per frame, with the frusta of the passes. queues a gpu test if they or the gpu tiles changed since the last one.
+    // returns true while a test is in flight or a new result arrived, a later frame picks it up.
+    bool start_gpu_culling(std::span<const nucleus::camera::Frustum> frusta, const glm::dvec3& camera_position);
+    // incremented whenever a new gpu result arrived, the passes are culled again then
+    [[nodiscard]] uint64_t gpu_culling_version() const;
+    const std::vector<tile::SrsAndHeightBounds>& tile_bounds(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset);
+    // hi-z occlusion culling, see nucleus::tile_scheduler::DepthPyramid
+    void cull_occluded(const nucleus::tile_scheduler::DepthPyramid& pyramid,
+        const glm::dvec3& camera_position,
+        nucleus::tile_scheduler::DrawListGenerator::TileSet* tiles,
+        std::vector<tile::Id>* occluded) const;
+    // see nucleus::tile_scheduler::utils::AabbDecorator::set_horizon_culling
+    void cull_below_horizon(const nucleus::camera::Definition& camera, nucleus::tile_scheduler::DrawListGenerator::TileSet* tiles) const;
+    // see DrawListGenerator::cull_by_distance
+    void cull_by_distance(const glm::dvec3& position, double min_distance, double max_distance, nucleus::tile_scheduler::DrawListGenerator::TileSet* tiles) const;
 
     void set_permissible_screen_space_error(float new_permissible_screen_space_error);
+    // in pixels, see DrawListGenerator::set_min_tile_contribution
+    void set_min_tile_contribution(float min_size);
+    // in pixels, 0 draws all tiles with the finest mesh
+    void set_mesh_lod_quad_size(float new_mesh_lod_quad_size);
+    // the ortho textures are mipmapped, the tiles must bring the whole chain (see Scheduler::set_ortho_tile_mip_levels)
+    [[nodiscard]] static unsigned ortho_mip_levels(unsigned ortho_size = nucleus::tile_scheduler::tile_types::TileFormat {}.ortho_size);
+    // before init. the tiles sent by the scheduler must have this format (Scheduler::set_tile_format)
+    void set_tile_format(const nucleus::tile_scheduler::tile_types::TileFormat& new_tile_format);
+    [[nodiscard]] const nucleus::tile_scheduler::tile_types::TileFormat& tile_format() const;
+    [[nodiscard]] unsigned mesh_lod_edge_vertices(unsigned lod) const;
+    // uboSharedConfig::m_overlay_mode. the modes 6 to 9 colour the tiles by a value that is computed per tile and passed with the
+    // instance data (see TileInstance::overlay_value): age since upload, residency, screen space error and decode + upload cost.
+    void set_overlay_mode(unsigned mode);
+
+    // new quads are queued by update_gpu_quads and uploaded by process_upload_queue, within this budget per frame (0 is unlimited).
+    // until a tile is resident, the draw list falls back to its parent.
+    struct UploadBudget {
+        float milliseconds = 4.f;
+        size_t n_bytes = 0;
+    };
+    void set_upload_budget(const UploadBudget& new_budget);
+    [[nodiscard]] const UploadBudget& upload_budget() const;
+    // called once per frame. coarse quads go first (the fallback of their children), then the ones closer to the camera.
+    // at least one quad is uploaded, so that a tiny budget still makes progress. returns true if quads are left in the queue
+    // (or in flight with background uploads, which hand over the whole queue and finish the uploads of previous frames).
+    bool process_upload_queue(const nucleus::camera::Definition& camera);
+    [[nodiscard]] size_t n_queued_tiles() const;
+
+    // the tile pool can be resized at runtime. growing, and shrinking once the scheduler removed the surplus tiles, happens in
+    // process_upload_queue (with the context current). resident layers are copied into the new arrays, where that isn't supported
+    // (webgl) all tiles are dropped and gpu_tiles_released asks the scheduler to send them again.
+    [[nodiscard]] unsigned quad_limit() const;
+    [[nodiscard]] unsigned allocated_quad_limit() const;
+    // before init. the layers per texture page are limited by GL_MAX_ARRAY_TEXTURE_LAYERS, or this if it's lower.
+    // the quad limit is capped to what fits into MAX_TEXTURE_PAGES.
+    void set_max_layers_per_page(unsigned new_max_layers_per_page);
+    [[nodiscard]] unsigned n_texture_pages() const;
 
 signals:
     void tiles_changed();
+    // the scheduler must not send more quads (connected to Scheduler::set_gpu_quad_limit). emitted when shrinking is requested,
+    // and when growing is done.
+    void quad_limit_changed(unsigned new_limit);
+    void gpu_tiles_released();
 
 public slots:
     void update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads);
-    void remove_tile(const tile::Id& tile_id);
+    // removes the four tiles of the quad (they share a slot of consecutive texture layers)
+    void remove_quad(const tile::Id& quad_id);
     void initilise_attribute_locations(ShaderProgram* program);
     void set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbDecoratorPtr& new_aabb_decorator);
     void set_quad_limit(unsigned new_limit);
+    // new tiles are marked as uploaded when they become resident, and as drawn by report_drawn
+    void set_latency_tracer(const nucleus::tile_scheduler::LatencyTracerPtr& tracer);
+    // of the upload thread, kept for an uploader that is enabled later
+    void set_upload_thread_policy(const nucleus::utils::ThreadPolicy& policy);
+    // after the main pass, marks the quads of tiles that are drawn for the first time
+    void report_drawn(const nucleus::tile_scheduler::DrawListGenerator::TileSet& drawn);
 
 private:
-    void add_tile(const tile::Id& id, tile::SrsAndHeightBounds bounds, const nucleus::utils::ColourTexture& ortho, const nucleus::Raster<uint16_t>& heights);
+    // per instance attributes, interleaved in m_instance_buffer. has to match the attribute setup in initilise_attribute_locations.
+    struct TileInstance {
+        glm::vec4 bounds; // relative to the camera position
+        glm::vec2 altitude_correction_factor; // at the southern and northern edge
+        int32_t texture_layer;
+        int32_t tileset_id;
+        int32_t zoom_level;
+        int32_t quadrant_mask; // see DrawListGenerator::QuadrantMasks
+        int32_t mesh_lod; // the shader derives the vertices per edge from it, so that batches of all lods can be drawn at once
+        int32_t curtain_edges; // the curtain vertices of the other edges stay on the surface (degenerate triangles)
+        float overlay_value; // of the debug overlay, 0 unless one of the per tile overlay modes is on (see set_overlay_mode)
+    };
+
+    void set_instance_attribute_pointers(unsigned first_instance);
+    void set_instance_attribute_divisor(unsigned divisor);
+    [[nodiscard]] unsigned mesh_lod(const TileSet& tileset, const nucleus::camera::Definition& camera) const;
+    [[nodiscard]] int32_t drawn_quadrants(const tile::Id& id) const; // of the last generated draw list
+    [[nodiscard]] float overlay_value(const TileSet& tileset, int32_t quadrant_mask, const nucleus::camera::Definition& camera, uint64_t now) const;
+    [[nodiscard]] int32_t curtain_edges(const TileSet& tileset, unsigned lod, const nucleus::tile_scheduler::DrawListGenerator::TileSet& pass,
+        const nucleus::camera::Definition& camera) const;
+    void add_quad(const nucleus::tile_scheduler::tile_types::GpuTileQuad& quad);
+    void make_resident(const nucleus::tile_scheduler::tile_types::GpuTileQuad& quad, unsigned first_layer, float upload_ms);
+    void remove_resident_tile(const tile::Id& id);
+    // add or remove in the draw list generator, deferred while start_tilelist is generating
+    void set_tile_available(const tile::Id& id, bool available);
+    void wait_for_tilelist(); // applies the deferred tile changes
+    void sort_upload_queue(const nucleus::camera::Definition& camera);
+    void erase_from_upload_queue(size_t n_first_in_order);
+    bool process_background_uploads(const nucleus::camera::Definition& camera);
+    void apply_quad_limit();
+    struct TexturePage {
+        std::unique_ptr<Texture> ortho;
+        std::unique_ptr<Texture> heights;
+        std::unique_ptr<Texture> normals; // RG8 octahedral, per texel of heights (FEATURE_NORMAL_MODE 2, stale in the other modes)
+    };
+    [[nodiscard]] std::vector<TexturePage> allocate_texture_pages(unsigned n_layers) const;
+    [[nodiscard]] unsigned max_n_layers() const;
+    void reset_free_layers(unsigned n_used); // n_used quad slots at the start are in use
 
-    static constexpr auto N_EDGE_VERTICES = 65;
-    static constexpr auto ORTHO_RESOLUTION = 256;
-    static constexpr auto HEIGHTMAP_RESOLUTION = 65;
+    nucleus::tile_scheduler::tile_types::TileFormat m_tile_format;
+    static constexpr size_t STAGING_RING_BYTES = size_t(16) << 20; // a few hundred tiles, bursts of new quads don't wait for the gpu
 
-    std::vector<tile::Id> m_loaded_tiles;
-    std::unique_ptr<Texture> m_ortho_textures;
-    std::unique_ptr<Texture> m_heightmap_textures;
+    unsigned m_n_layers = 0;
+    unsigned m_target_n_layers = 0; // differs from m_n_layers while a resize is pending
+    // the tiles of a quad are always added and removed together, and they are stored in a slot of 4 consecutive layers (tile i
+    // of the quad in layer i of the slot). that way a quad is uploaded with one call per texture. slots don't cross pages.
+    std::vector<unsigned> m_free_quad_layers; // stack of the first layers of unused slots
+    std::unordered_map<tile::Id, unsigned, tile::Id::Hasher> m_quad_layers; // resident quad id -> first layer of its slot
+    std::unordered_map<tile::Id, size_t, tile::Id::Hasher> m_tile_index; // tile id -> index into m_gpu_tiles
+    // dropped by a resize without layer copies, deletions of those that the scheduler sent before it knew are ignored
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_released_quads;
+    nucleus::tile_scheduler::LatencyTracerPtr m_latency_tracer;
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_undrawn_tiles; // resident, but not drawn yet. only while tracing
+    // global layer l is layer l % m_layers_per_page of page l / m_layers_per_page
+    std::vector<TexturePage> m_texture_pages;
+    unsigned m_layers_per_page = unsigned(-1) / 4 * 4; // a multiple of 4, so that quad slots don't cross pages
+    std::unique_ptr<StagingRing> m_staging_ring; // nullptr if pixel unpack buffers can't be mapped (webgl)
     std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
-    std::pair<std::unique_ptr<QOpenGLBuffer>, size_t> m_index_buffer;
-    std::unique_ptr<QOpenGLBuffer> m_bounds_buffer;
-    std::unique_ptr<QOpenGLBuffer> m_tileset_id_buffer;
-    std::unique_ptr<QOpenGLBuffer> m_zoom_level_buffer;
-    std::unique_ptr<QOpenGLBuffer> m_texture_layer_buffer;
+    // the meshes of all lods in one buffer (so that indirect commands can pick them), first index and count per mesh lod
+    std::unique_ptr<QOpenGLBuffer> m_index_buffer;
+    std::array<std::pair<size_t, size_t>, N_MESH_LODS> m_lod_indices = {};
+    float m_mesh_lod_quad_size = 4.f;
+    std::unique_ptr<QOpenGLBuffer> m_instance_buffer;
+    std::vector<unsigned> m_instance_layers; // texture layers of the tiles currently in m_instance_buffer, in draw order
+    std::vector<int32_t> m_instance_quadrant_masks; // same order
+    nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks m_quadrant_masks; // of the last generated draw list
+    glm::dvec3 m_instance_origin = glm::dvec3(0.0); // camera position used for the bounds in m_instance_buffer
+    bool m_instance_buffer_dirty = true;
+    unsigned m_overlay_mode = 0;
+    unsigned m_vao_first_instance = 0; // instance the attribute pointers of m_vao currently start at
+    struct {
+        int bounds = -1;
+        int altitude_correction_factor = -1;
+        int tileset_id = -1;
+        int zoom_level = -1;
+        int texture_layer = -1;
+        int quadrant_mask = -1;
+        int mesh_lod = -1;
+        int curtain_edges = -1;
+        int overlay_value = -1;
+    } m_attribute_locations;
 
     std::vector<TileSet> m_gpu_tiles;
+    std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad> m_upload_queue;
+    std::vector<std::pair<double, size_t>> m_upload_order; // scratch, priority and index into m_upload_queue
+    UploadBudget m_upload_budget;
+    struct InFlightUpload {
+        uint64_t ticket = 0;
+        unsigned first_layer = 0;
+        bool cancelled = false; // removed while uploading, the slot is freed when the upload is done
+        GLsync fence = nullptr;
+        nucleus::tile_scheduler::tile_types::GpuTileQuad quad;
+        float upload_ms = 0;
+    };
+    std::unique_ptr<BackgroundUploader> m_uploader;
+    nucleus::utils::ThreadPolicy m_upload_thread_policy = nucleus::utils::ThreadPolicies().upload;
+    std::vector<InFlightUpload> m_in_flight_uploads; // in upload order
+    uint64_t m_next_upload_ticket = 1;
     unsigned m_tiles_per_set = 1;
     nucleus::tile_scheduler::DrawListGenerator m_draw_list_generator;
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet m_last_draw_list; // buffer last generated draw list
+    nucleus::tile_scheduler::DrawListGenerator::TileSet m_last_draw_list; // buffer last generated draw list
+    std::optional<nucleus::camera::Definition> m_draw_list_camera; // camera of m_last_draw_list
+    bool m_draw_list_dirty = true; // tiles or generator settings changed since m_last_draw_list
+    uint64_t m_draw_list_version = 0;
+    // draw list of start_tilelist, generated on m_draw_list_pool (a single thread, created on first use)
+    std::unique_ptr<QThreadPool> m_draw_list_pool;
+    std::optional<nucleus::camera::Definition> m_async_draw_list_camera; // set while generating, until generate_tilelist
+    bool m_async_draw_list_stale = false; // tiles were removed or settings changed meanwhile
+    nucleus::tile_scheduler::DrawListGenerator::TileSet m_async_draw_list;
+    nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks m_async_quadrant_masks;
+    std::vector<std::pair<tile::Id, bool>> m_deferred_tile_changes; // id, available
+    uint64_t m_tile_bounds_version = 0; // draw list version of m_tile_bounds, 0 if they are not of the draw list
+    // passes and sort position of the last prepare_draw, its order is reused if they and the gpu tiles didn't change
+    std::vector<nucleus::tile_scheduler::DrawListGenerator::TileSet> m_prepared_passes;
+    glm::dvec3 m_prepared_sort_position = glm::dvec3(0.0);
+    glm::dvec3 m_prepared_lod_position = glm::dvec3(0.0);
+    float m_prepared_lod_scale = 0; // camera.to_screen_space(1, 1), changes with the field of view and viewport
+    bool m_prepared_order_dirty = true;
+    std::vector<std::vector<tile::Id>> m_pass_orders; // front to back order of the last prepare_draw, per pass
+    std::vector<uint64_t> m_tile_stamps; // per gpu tile, marks the tiles already added to the current pass
+    uint64_t m_tile_stamp = 0;
+    // per frame scratch storage of prepare_draw and tile_bounds
+    std::vector<const TileSet*> m_draw_tile_list;
+    std::vector<std::pair<float, const TileSet*>> m_pass_tiles;
+    std::vector<unsigned> m_pass_tile_batches; // same order, texture page and mesh lod
+    std::vector<int32_t> m_draw_tile_lods; // same order as m_draw_tile_list
+    std::vector<int32_t> m_draw_tile_curtain_edges; // same order
+    std::vector<DrawRange> m_draw_ranges;
+    std::vector<TileInstance> m_instances;
+    std::vector<tile::SrsAndHeightBounds> m_tile_bounds;
+
+    // gpu culling, the masks are indexed like m_gpu_tiles
+    std::unique_ptr<GpuTileCuller> m_gpu_culler;
+    uint64_t m_resident_version = 0; // incremented whenever m_gpu_tiles changed
+    uint64_t m_gpu_boxes_version = 0;
+    uint64_t m_gpu_boxes_resident_version = 0; // of the boxes of m_gpu_boxes_version
+    unsigned m_gpu_boxes_aabb_version = 0; // AabbDecorator::version
+    std::vector<nucleus::camera::Frustum> m_gpu_culled_frusta; // of the last queued test
+    uint64_t m_gpu_culled_boxes_version = 0;
+    uint64_t m_gpu_culling_version = 0;
+    uint64_t m_gpu_result_version = 0; // GpuTileCuller::result_version
+    std::vector<tile::SrsAndHeightBounds> m_gpu_boxes; // scratch
+
+    // indirect draws, commands of a range: MAX_INDIRECT_VIEWS blocks (for 1, 2, .. views) of one command per non empty batch
+    using MultiDrawElementsIndirect = void(QOPENGLF_APIENTRYP)(GLenum mode, GLenum type, const void* indirect, GLsizei draw_count, GLsizei stride);
+    MultiDrawElementsIndirect m_multi_draw_elements_indirect = nullptr; // resolved by init if supported
+    bool m_indirect_draws = false;
+    GLuint m_indirect_buffer = 0; // GL_DRAW_INDIRECT_BUFFER, QOpenGLBuffer doesn't know that type
+    std::vector<DrawCommand> m_draw_commands;
 };
 }
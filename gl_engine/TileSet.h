@@ -19,8 +19,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
+#include <glm/glm.hpp>
+
 #include "radix/tile.h"
 
 // we want to be flexible and have the ability to draw several tiles at once.
@@ -32,6 +35,11 @@ struct TileSet {
     tile::Id tile_id = {};
     tile::SrsBounds bounds = {};
     unsigned texture_layer = unsigned(-1);
+    glm::vec2 altitude_correction_factor = {}; // at bounds.min.y and bounds.max.y
+    // for the debug overlays (see TileManager::set_overlay_mode)
+    uint64_t resident_since = 0; // msecs since epoch
+    float cost_ms = 0; // decoding and uploading its quad
+    bool inherited = false; // see GpuLayeredTile::inherited
     // texture
 };
 } // namespace gl_engine
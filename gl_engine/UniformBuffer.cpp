@@ -17,12 +17,14 @@
  *****************************************************************************/
 #include "UniformBuffer.h"
 #include <QOpenGLExtraFunctions>
+#include "GlCounters.h"
 #include "ShaderProgram.h"
 #include "UniformBufferObjects.h"
 #include <QDebug>
 #include <QByteArray>
 #include <QDataStream>
 #include <QIODevice>
+#include <cstring>
 #if defined(__ANDROID__)
 #include <GLES3/gl3.h>  // for GL_UNIFORM_BUFFER! DONT EXACTLY KNOW WHY I NEED THIS HERE! (on other platforms it works without)
 #endif
@@ -49,6 +51,7 @@ template <typename T> void gl_engine::UniformBuffer<T>::init() {
 
     m_f->glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
     m_f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_memory.set_n_bytes(sizeof(T));
 
     m_f->glBindBufferRange(GL_UNIFORM_BUFFER, m_location, m_id, 0, sizeof(T));
     this->update_gpu_data();
@@ -64,10 +67,19 @@ template <typename T> void gl_engine::UniformBuffer<T>::bind_to_shader(std::vect
     }
 }
 
-template <typename T> void gl_engine::UniformBuffer<T>::update_gpu_data() {
+template <typename T> bool gl_engine::UniformBuffer<T>::update_gpu_data() {
+    if (m_gpu_data_valid && std::memcmp(&m_gpu_data, &data, sizeof(T)) == 0)
+        return false;
+    std::memcpy(&m_gpu_data, &data, sizeof(T));
+    m_gpu_data_valid = true;
+
     m_f->glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+    // orphaning: the old storage stays with pending draws, so the write doesn't sync. the buffer name and binding are unchanged.
+    m_f->glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
     m_f->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
     m_f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GlCounters::current().count_buffer_write(sizeof(T));
+    return true;
 }
 
 template <typename T> QString gl_engine::UniformBuffer<T>::data_as_string() {
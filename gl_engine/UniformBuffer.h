@@ -20,6 +20,7 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <QOpenGLContext>
+#include "GpuMemory.h"
 class QOpenGLExtraFunctions;
 
 namespace gl_engine {
@@ -37,8 +38,9 @@ public:
     void bind_to_shader(ShaderProgram* shader);
     void bind_to_shader(std::vector<ShaderProgram*> shaders);
 
-    // Refills the GPU Buffer
-    void update_gpu_data();
+    // Refills the GPU Buffer, if data changed since the last upload. Returns true if it was uploaded.
+    // The storage is orphaned before writing, so the driver doesn't have to wait for draws that still read the old contents.
+    bool update_gpu_data();
 
     // Returns String representation of buffer data (Base64)
     QString data_as_string();
@@ -65,8 +67,11 @@ private:
     std::string m_name;  // name of the uniform in the shader
     GLuint m_location;          // the binding point/location
     GLuint m_id;                // the gpu buffer ID
+    T m_gpu_data;               // copy of what was last uploaded (dirty tracking)
+    bool m_gpu_data_valid = false;
 
     QOpenGLExtraFunctions* m_f;
+    gpu_memory::Allocation m_memory { "uniform buffers" };
 
 };
 
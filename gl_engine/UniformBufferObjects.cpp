@@ -40,7 +40,9 @@ void serialize_ubo(QDataStream& out, const uboSharedConfig& data) {
         << data.m_ssao_blur_kernel_size
         << data.m_height_lines_enabled
         << data.m_csm_enabled
-        << data.m_overlay_shadowmaps_enabled;
+        << data.m_overlay_shadowmaps_enabled
+        << data.m_ssao_resolution       // added on 2026-10-14 (v3) for half/quarter resolution ssao
+        << data.m_ssao_temporal_enabled; // added on 2026-10-14 (v3) for temporal ssao
 }
 
 void unserialize_ubo(QDataStream& in, uboSharedConfig& data, uint32_t version) {
@@ -70,7 +72,7 @@ void unserialize_ubo(QDataStream& in, uboSharedConfig& data, uint32_t version) {
             >> data.m_csm_enabled
             >> data.m_overlay_shadowmaps_enabled;
 
-    } else if (version == 2) {
+    } else if (version == 2 || version == 3) {
         in
             >> data.m_sun_light
             >> data.m_sun_light_dir
@@ -92,6 +94,8 @@ void unserialize_ubo(QDataStream& in, uboSharedConfig& data, uint32_t version) {
             >> data.m_height_lines_enabled
             >> data.m_csm_enabled
             >> data.m_overlay_shadowmaps_enabled;
+        if (version >= 3)
+            in >> data.m_ssao_resolution >> data.m_ssao_temporal_enabled;
     }
 }
 
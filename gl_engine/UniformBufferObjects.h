@@ -35,7 +35,7 @@
 //      the current instance on alpinemaps.org) this version number needs to be raised and the deserializing
 //      method needs to be adapted to work in a backwards compatible fashion!
 //      NOTE: THIS FUNCTIONALITY WAS NOT IN PLACE FOR VERSION 1. Those links therefore (in the best case) don't work anymore.
-#define CURRENT_UBO_VERSION 2
+#define CURRENT_UBO_VERSION 3
 
 // NOTE: BOOLEANS BEHAVE WEIRD! JUST DONT USE THEM AND STICK TO 32bit Formats!!
 // STD140 ALIGNMENT! USE PADDING IF NECESSARY. EVERY BLOCK OF SAME TYPE MUST BE PADDED
@@ -69,7 +69,7 @@ public:
     GLfloat padf2 = 0.0;
 
     GLuint m_phong_enabled = false;
-    GLuint m_normal_mode = 0;                       // 0...per fragment, 1...FDM
+    GLuint m_normal_mode = 0;                       // 0...per fragment, 1...FDM, 2...precomputed per tile
     GLuint m_overlay_mode = 0;                      // see GlSettings.qml for list of modes
     GLuint m_overlay_postshading_enabled = false;   // see GlSettings.qml for more details
 
@@ -81,7 +81,12 @@ public:
     GLuint m_height_lines_enabled = false;
     GLuint m_csm_enabled = false;
     GLuint m_overlay_shadowmaps_enabled = false;
+    GLuint m_ssao_resolution = 0;                   // 0...full, 1...half, 2...quarter resolution (bilateral upsampling)
+
+    GLuint m_ssao_temporal_enabled = false;         // evaluate a part of the kernel per frame and accumulate over time
     GLuint m_padi1 = 0;
+    GLuint m_padi2 = 0;
+    GLuint m_padi3 = 0;
 
     // WARNING: Don't move the following Q_PROPERTIES to the top, otherwise the MOC
     // will do weird things with the data alignment!!
@@ -105,6 +110,8 @@ public:
     Q_PROPERTY(unsigned int ssao_kernel MEMBER m_ssao_kernel)
     Q_PROPERTY(bool ssao_range_check MEMBER m_ssao_range_check)
     Q_PROPERTY(unsigned int ssao_blur_kernel_size MEMBER m_ssao_blur_kernel_size)
+    Q_PROPERTY(unsigned int ssao_resolution MEMBER m_ssao_resolution)
+    Q_PROPERTY(bool ssao_temporal_enabled MEMBER m_ssao_temporal_enabled)
 
     Q_PROPERTY(bool height_lines_enabled MEMBER m_height_lines_enabled)
     Q_PROPERTY(bool csm_enabled MEMBER m_csm_enabled)
@@ -139,8 +146,10 @@ struct uboCameraConfig {
 struct uboShadowConfig {
     glm::mat4 light_space_view_proj_matrix[SHADOW_CASCADES];
     glm::vec4 cascade_planes[SHADOW_CASCADES + 1];  // vec4 necessary because of alignment (only x will be used)
+    glm::vec4 atlas_rect[SHADOW_CASCADES]; // part of the shadow atlas covered by the cascade in texture coordinates (xy offset, zw size)
     glm::vec2 shadowmap_size;
-    glm::vec2 buff;
+    GLuint cascade_count = SHADOW_CASCADES; // active cascades
+    GLuint buff;
 };
 
 
@@ -0,0 +1,355 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "VectorOverlay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Framebuffer.h"
+#include "GlCounters.h"
+#include "GlState.h"
+#include "ShaderProgram.h"
+
+namespace gl_engine {
+
+namespace {
+// modes of vector_overlay.vert / .frag
+enum class Mode : int { Segments = 0, AreaMask = 1, AreaFill = 2 };
+
+bool overlaps(const glm::dvec2& min, const glm::dvec2& max, const glm::dvec3& window, double margin)
+{
+    return max.x >= window.x - margin && max.y >= window.y - margin && min.x <= window.x + window.z + margin && min.y <= window.y + window.z + margin;
+}
+} // namespace
+
+std::vector<VectorOverlay::Chunk> VectorOverlay::chunks(std::span<const Track> tracks)
+{
+    std::vector<Chunk> chunks;
+    unsigned first_point = 0;
+    for (unsigned track = 0; track < tracks.size(); ++track) {
+        const auto& points = tracks[track].points;
+        const auto n_segments = points.size() < 2 ? 0u : unsigned(points.size() - 1);
+        for (unsigned segment = 0; segment < n_segments; segment += chunk_size) {
+            Chunk chunk { track, first_point + segment, std::min(chunk_size, n_segments - segment), glm::dvec2(std::numeric_limits<double>::max()), glm::dvec2(std::numeric_limits<double>::lowest()) };
+            for (unsigned i = segment; i <= segment + chunk.n_segments; ++i) {
+                chunk.min = glm::min(chunk.min, points[i]);
+                chunk.max = glm::max(chunk.max, points[i]);
+            }
+            chunks.push_back(chunk);
+        }
+        first_point += unsigned(points.size());
+    }
+    return chunks;
+}
+
+glm::dvec3 VectorOverlay::level_window(const glm::dvec2& camera_position, double base_extent, unsigned level)
+{
+    const auto extent = base_extent * std::pow(4.0, double(level));
+    const auto step = extent / 8;
+    const auto centre = glm::round(camera_position / step) * step;
+    return { centre - extent / 2, extent };
+}
+
+VectorOverlay::VectorOverlay(std::shared_ptr<ShaderProgram> program)
+    : m_program(std::move(program))
+{
+    m_uniforms.view_proj = m_program->uniform<glm::mat4>("view_proj");
+    m_uniforms.mode = m_program->uniform<int>("mode");
+    m_uniforms.colour = m_program->uniform<glm::vec4>("colour");
+    m_uniforms.half_width = m_program->uniform<float>("half_width");
+    m_f = QOpenGLContext::currentContext()->extraFunctions();
+    m_f->glGenSamplers(1, &m_sampler);
+    m_f->glSamplerParameteri(m_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_f->glSamplerParameteri(m_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    m_f->glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    m_f->glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+VectorOverlay::~VectorOverlay()
+{
+    if (m_sampler)
+        m_f->glDeleteSamplers(1, &m_sampler);
+}
+
+void VectorOverlay::set_settings(const Settings& settings)
+{
+    if (settings == m_settings)
+        return;
+    m_settings = settings; // the targets are resized in draw
+    invalidate_cache();
+}
+
+const VectorOverlay::Settings& VectorOverlay::settings() const { return m_settings; }
+
+void VectorOverlay::set_data(DataPtr data)
+{
+    if (data && data->tracks.empty() && data->areas.empty())
+        data = nullptr;
+    if (data == m_data)
+        return;
+    m_data = std::move(data); // uploaded in draw, where the context is current
+    invalidate_cache();
+}
+
+void VectorOverlay::upload()
+{
+    m_uploaded = m_data;
+    m_chunks.clear();
+    m_areas.clear();
+    m_segment_vao.reset();
+    m_fan_vao.reset();
+    m_points.reset();
+    m_memory.set_n_bytes(0);
+    if (!m_data)
+        return;
+
+    m_chunks = chunks(m_data->tracks);
+    // tracks first (in the order of the chunks), then the rings of the areas
+    std::vector<glm::dvec2> points;
+    for (const auto& track : m_data->tracks)
+        points.insert(points.end(), track.points.begin(), track.points.end());
+    for (const auto& area : m_data->areas) {
+        AreaRange range { unsigned(points.size()), {}, glm::dvec2(std::numeric_limits<double>::max()), glm::dvec2(std::numeric_limits<double>::lowest()) };
+        for (const auto& ring : area.rings) {
+            range.ring_sizes.push_back(unsigned(ring.size()));
+            for (const auto& point : ring) {
+                range.min = glm::min(range.min, point);
+                range.max = glm::max(range.max, point);
+            }
+            points.insert(points.end(), ring.begin(), ring.end());
+        }
+        m_areas.push_back(std::move(range));
+    }
+    if (points.empty())
+        return;
+
+    // floats relative to the first point keep centimetres over a few hundred kilometres
+    m_origin = points.front();
+    std::vector<glm::vec2> relative;
+    relative.reserve(points.size());
+    for (const auto& point : points)
+        relative.emplace_back(point - m_origin);
+
+    m_points = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
+    m_points->create();
+    m_points->bind();
+    m_points->setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_points->allocate(relative.data(), int(relative.size() * sizeof(glm::vec2)));
+    m_memory.set_n_bytes(relative.size() * sizeof(glm::vec2));
+
+    // the segment pointers are set per chunk (see draw_level), gles has no base instance
+    m_segment_vao = std::make_unique<QOpenGLVertexArrayObject>();
+    m_segment_vao->create();
+    m_segment_vao->bind();
+    m_points->bind();
+    for (GLuint location : { 0u, 1u }) {
+        m_f->glEnableVertexAttribArray(location);
+        m_f->glVertexAttribDivisor(location, 1);
+    }
+    m_segment_vao->release();
+
+    m_fan_vao = std::make_unique<QOpenGLVertexArrayObject>();
+    m_fan_vao->create();
+    m_fan_vao->bind();
+    m_points->bind();
+    m_f->glEnableVertexAttribArray(0);
+    m_f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+    m_fan_vao->release();
+    m_points->release();
+}
+
+bool VectorOverlay::empty() const { return !m_data; }
+
+void VectorOverlay::invalidate_cache() { m_rendered_windows.fill(std::nullopt); }
+
+void VectorOverlay::allocate_targets()
+{
+    const auto resolution = m_settings.resolution;
+    m_atlas = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::RGBA8 }, glm::uvec2(3, 2) * resolution);
+    m_atlas->set_memory_subsystem("vector overlay");
+    m_area_mask = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::R8 }, glm::uvec2(resolution));
+    m_area_mask->set_memory_subsystem("vector overlay");
+}
+
+unsigned VectorOverlay::draw(const glm::dvec3& camera_position)
+{
+    if (m_uploaded != m_data)
+        upload();
+    if (!m_data)
+        return 0;
+    if (!m_atlas || m_atlas->size() != glm::uvec2(3, 2) * m_settings.resolution)
+        allocate_targets();
+
+    unsigned n_drawn = 0;
+    for (unsigned level = 0; level < n_levels; ++level) {
+        const auto window = level_window(camera_position, m_settings.base_extent, level);
+        if (m_rendered_windows[level] == window)
+            continue;
+        if (n_drawn == 0) {
+            auto& state = GlState::current();
+            state.set_enabled(GL_DEPTH_TEST, false);
+            state.set_enabled(GL_CULL_FACE, false);
+            state.set_enabled(GL_SCISSOR_TEST, true);
+            m_program->bind();
+        }
+        draw_level(level, window);
+        m_rendered_windows[level] = window;
+        ++n_drawn;
+    }
+    if (n_drawn == 0)
+        return 0;
+    auto& state = GlState::current();
+    state.set_enabled(GL_SCISSOR_TEST, false);
+    state.set_enabled(GL_BLEND, false);
+    state.set_enabled(GL_CULL_FACE, true);
+    m_atlas->unbind();
+    m_program->release();
+    return n_drawn;
+}
+
+void VectorOverlay::draw_level(unsigned level, const glm::dvec3& window)
+{
+    auto& state = GlState::current();
+    auto& counters = GlCounters::current();
+    const auto resolution = int(m_settings.resolution);
+    const auto level_origin = glm::ivec2(int(level % 3), int(level / 3)) * resolution;
+    const auto texel = window.z / resolution;
+    // texels of the level covered by a box (world space), as a viewport relative scissor rect
+    const auto texel_rect = [&](const glm::dvec2& min, const glm::dvec2& max) {
+        const auto lower = glm::clamp(glm::ivec2(glm::floor((min - glm::dvec2(window)) / texel)) - 1, 0, resolution);
+        const auto upper = glm::clamp(glm::ivec2(glm::ceil((max - glm::dvec2(window)) / texel)) + 1, 0, resolution);
+        return glm::ivec4(lower, upper - lower);
+    };
+
+    m_atlas->bind();
+    state.set_viewport({ level_origin, resolution, resolution });
+    m_f->glScissor(level_origin.x, level_origin.y, resolution, resolution);
+    const GLfloat transparent[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    m_f->glClearBufferfv(GL_COLOR, 0, transparent);
+
+    const auto lower = glm::dvec2(window) - m_origin;
+    const auto upper = lower + window.z;
+    m_program->set_uniform(m_uniforms.view_proj, glm::mat4(glm::ortho(lower.x, upper.x, lower.y, upper.y, -1.0, 1.0)));
+
+    // areas: the fans of the rings toggle the coverage in the mask (even odd rule, without triangulation or a stencil buffer),
+    // which is then blended into the level
+    for (unsigned i = 0; i < m_areas.size(); ++i) {
+        const auto& area = m_areas[i];
+        if (!overlaps(area.min, area.max, window, 0))
+            continue;
+        const auto rect = texel_rect(area.min, area.max);
+        if (rect.z <= 0 || rect.w <= 0)
+            continue;
+
+        m_area_mask->bind();
+        m_f->glScissor(rect.x, rect.y, rect.z, rect.w);
+        m_f->glClearBufferfv(GL_COLOR, 0, transparent);
+        state.set_enabled(GL_BLEND, true);
+        state.set_blend_func(GL_ONE_MINUS_DST_COLOR, GL_ZERO);
+        m_program->set_uniform(m_uniforms.mode, int(Mode::AreaMask));
+        m_fan_vao->bind();
+        auto first = area.first_point;
+        for (const auto n : area.ring_sizes) {
+            if (n >= 3) {
+                m_f->glDrawArrays(GL_TRIANGLE_FAN, GLint(first), GLsizei(n));
+                counters.count_draw(n);
+            }
+            first += n;
+        }
+
+        m_atlas->bind();
+        state.set_viewport({ level_origin, resolution, resolution });
+        m_f->glScissor(level_origin.x + rect.x, level_origin.y + rect.y, rect.z, rect.w);
+        state.set_blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // premultiplied
+        m_area_mask->bind_colour_texture(0, 0);
+        m_program->set_uniform(m_uniforms.mode, int(Mode::AreaFill));
+        m_program->set_uniform(m_uniforms.colour, m_data->areas[i].colour);
+        m_f->glDrawArrays(GL_TRIANGLES, 0, 3);
+        counters.count_draw(3);
+        m_fan_vao->release();
+    }
+    m_f->glScissor(level_origin.x, level_origin.y, resolution, resolution);
+
+    // tracks: replace instead of blending, so that the overlapping ends of the segments don't add up
+    if (m_chunks.empty())
+        return;
+    state.set_enabled(GL_BLEND, false);
+    m_program->set_uniform(m_uniforms.mode, int(Mode::Segments));
+    m_segment_vao->bind();
+    m_points->bind();
+    std::optional<unsigned> bound_track;
+    for (const auto& chunk : m_chunks) {
+        const auto& track = m_data->tracks[chunk.track];
+        if (!overlaps(chunk.min, chunk.max, window, track.width * texel))
+            continue;
+        if (bound_track != chunk.track) {
+            bound_track = chunk.track;
+            m_program->set_uniform(m_uniforms.colour, track.colour);
+            m_program->set_uniform(m_uniforms.half_width, track.width / float(resolution)); // in ndc, i.e., 2 / resolution per texel
+        }
+        const auto offset = reinterpret_cast<const void*>(uintptr_t(chunk.first_point) * sizeof(glm::vec2));
+        m_f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), offset);
+        m_f->glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), static_cast<const char*>(offset) + sizeof(glm::vec2));
+        m_f->glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(chunk.n_segments));
+        counters.count_draw(4, chunk.n_segments);
+    }
+    m_points->release();
+    m_segment_vao->release();
+}
+
+void VectorOverlay::bind(ShaderProgram* program, unsigned location, const glm::dvec3& camera_position, float pixel_angle)
+{
+    if (program != m_compose_program) {
+        m_compose_program = program;
+        m_compose_uniforms.enabled = program->uniform<int>("vector_overlay_enabled");
+        m_compose_uniforms.windows = program->uniform<glm::vec4>("vector_overlay_windows[0]");
+        m_compose_uniforms.resolution = program->uniform<float>("vector_overlay_resolution");
+        m_compose_uniforms.pixel_angle = program->uniform<float>("vector_overlay_pixel_angle");
+    }
+    program->set_uniform(m_compose_uniforms.enabled, int(m_data && m_atlas));
+    if (!m_data || !m_atlas)
+        return;
+    m_atlas->bind_colour_texture(0, location);
+    m_f->glBindSampler(location, m_sampler);
+    // the compose shader works in camera local coordinates, levels that were not drawn yet have no extent
+    std::array<glm::vec4, n_levels> windows = {};
+    for (unsigned level = 0; level < n_levels; ++level) {
+        if (const auto& window = m_rendered_windows[level])
+            windows[level] = glm::vec4(glm::vec2(glm::dvec2(*window) - glm::dvec2(camera_position)), float(window->z), 0.0f);
+    }
+    program->set_uniform_array(m_compose_uniforms.windows, windows);
+    program->set_uniform(m_compose_uniforms.resolution, float(m_settings.resolution));
+    program->set_uniform(m_compose_uniforms.pixel_angle, pixel_angle);
+}
+
+void VectorOverlay::release(unsigned location)
+{
+    if (m_data && m_atlas)
+        m_f->glBindSampler(location, 0);
+}
+
+} // namespace gl_engine
@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GpuMemory.h"
+#include "ShaderProgram.h"
+
+class QOpenGLBuffer;
+class QOpenGLExtraFunctions;
+class QOpenGLVertexArrayObject;
+
+namespace gl_engine {
+
+class Framebuffer;
+
+// vector data (e.g., gpx tracks and area polygons) draped onto the terrain. the data is rasterised top down into nested square
+// windows around the camera (levels, each covering 4 times the extent of the previous one, in a 3x2 atlas), and the compose pass
+// projects them onto the terrain with the gbuffer positions (see vector_overlay_colour in compose.frag). so nothing is meshed
+// against the tiles, and the cost doesn't depend on their lod. a level is rasterised again only if the data changed or the
+// camera left its (snapped) window. the tracks are drawn in chunks of consecutive points, which are culled against the window,
+// so a level draws only the part of a long track that it covers.
+class VectorOverlay {
+public:
+    struct Track {
+        std::vector<glm::dvec2> points; // world space xy (see nucleus::srs::lat_long_to_world)
+        glm::vec4 colour = { 1.0f, 0.25f, 0.0f, 1.0f };
+        float width = 3; // in texels of the level, i.e., about pixels on screen, as compose picks the level by the pixel footprint
+    };
+    struct Area {
+        std::vector<std::vector<glm::dvec2>> rings; // world space xy, outline and holes (even odd rule), not closed explicitly
+        glm::vec4 colour = { 0.0f, 0.45f, 1.0f, 0.3f }; // of the fill, add a track for an outline
+    };
+    struct Data {
+        std::vector<Track> tracks; // drawn over the areas, in order
+        std::vector<Area> areas;
+    };
+    using DataPtr = std::shared_ptr<const Data>;
+
+    struct Settings {
+        unsigned resolution = 1024; // per level
+        double base_extent = 1000; // metres, width of the finest level
+        bool operator==(const Settings&) const = default;
+    };
+    static constexpr unsigned n_levels = 6;
+    static constexpr unsigned chunk_size = 1024; // segments per draw call
+
+    // consecutive segments of a track and their bounds, the unit of culling
+    struct Chunk {
+        unsigned track = 0;
+        unsigned first_point = 0; // in the concatenated points of all tracks
+        unsigned n_segments = 0;
+        glm::dvec2 min = {};
+        glm::dvec2 max = {};
+    };
+    [[nodiscard]] static std::vector<Chunk> chunks(std::span<const Track> tracks);
+    // lower left corner and extent of a level's window. the centre is snapped to an eighth of the extent, so that the window
+    // only moves (and the level is rasterised again) every 125 metres on the finest level with the default settings.
+    [[nodiscard]] static glm::dvec3 level_window(const glm::dvec2& camera_position, double base_extent, unsigned level);
+
+    explicit VectorOverlay(std::shared_ptr<ShaderProgram> program);
+    ~VectorOverlay();
+
+    void set_settings(const Settings& settings);
+    [[nodiscard]] const Settings& settings() const;
+    // nullptr (or no data) turns the overlay off. the points are uploaded with the next draw.
+    void set_data(DataPtr data);
+    [[nodiscard]] bool empty() const;
+    // rasterises the levels whose window moved since the last draw, or all if the data changed. returns the number of levels drawn.
+    unsigned draw(const glm::dvec3& camera_position);
+    void invalidate_cache();
+
+    // sets the overlay uniforms of the compose program and binds the atlas to location (texin_vector_overlay, see the sampler
+    // layout in ShaderManager). pixel_angle is the angle of a screen pixel (radians), the level is picked by the pixel footprint.
+    void bind(ShaderProgram* program, unsigned location, const glm::dvec3& camera_position, float pixel_angle);
+    void release(unsigned location); // the linear sampler of the atlas
+
+private:
+    void upload();
+    void allocate_targets();
+    void draw_level(unsigned level, const glm::dvec3& window);
+
+    Settings m_settings;
+    DataPtr m_data;
+    DataPtr m_uploaded; // m_data once the buffers below are filled
+    std::shared_ptr<ShaderProgram> m_program;
+    struct {
+        ShaderProgram::Uniform<glm::mat4> view_proj;
+        ShaderProgram::Uniform<int> mode;
+        ShaderProgram::Uniform<glm::vec4> colour;
+        ShaderProgram::Uniform<float> half_width;
+    } m_uniforms;
+    ShaderProgram* m_compose_program = nullptr; // of the handles below, resolved on the first bind
+    struct {
+        ShaderProgram::Uniform<int> enabled;
+        ShaderProgram::Uniform<glm::vec4> windows; // array of n_levels
+        ShaderProgram::Uniform<float> resolution;
+        ShaderProgram::Uniform<float> pixel_angle;
+    } m_compose_uniforms;
+
+    glm::dvec2 m_origin = {}; // the points are uploaded as floats relative to it
+    std::vector<Chunk> m_chunks;
+    struct AreaRange {
+        unsigned first_point = 0;
+        std::vector<unsigned> ring_sizes;
+        glm::dvec2 min = {};
+        glm::dvec2 max = {};
+    };
+    std::vector<AreaRange> m_areas;
+    std::unique_ptr<QOpenGLBuffer> m_points;
+    std::unique_ptr<QOpenGLVertexArrayObject> m_segment_vao; // 2 points per instance
+    std::unique_ptr<QOpenGLVertexArrayObject> m_fan_vao; // 1 point per vertex
+    gpu_memory::Allocation m_memory { "vector overlay" };
+
+    std::unique_ptr<Framebuffer> m_atlas; // premultiplied rgba
+    std::unique_ptr<Framebuffer> m_area_mask; // a level, coverage of the area that is drawn
+    unsigned m_sampler = 0;
+    std::array<std::optional<glm::dvec3>, n_levels> m_rendered_windows; // nullopt if the level must be drawn again
+    QOpenGLExtraFunctions* m_f;
+};
+
+} // namespace gl_engine
@@ -0,0 +1,160 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "Viewshed.h"
+
+#include <array>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Framebuffer.h"
+#include "GlState.h"
+#include "ShaderProgram.h"
+
+namespace gl_engine {
+
+namespace {
+// view direction and up vector of the cube faces, in the order of the atlas (3 columns, 2 rows)
+constexpr std::array<std::array<double, 6>, 6> face_directions = { {
+    { 1, 0, 0, 0, 0, 1 },
+    { -1, 0, 0, 0, 0, 1 },
+    { 0, 1, 0, 0, 0, 1 },
+    { 0, -1, 0, 0, 0, 1 },
+    { 0, 0, 1, 0, 1, 0 },
+    { 0, 0, -1, 0, 1, 0 },
+} };
+} // namespace
+
+Viewshed::Viewshed(std::shared_ptr<ShaderProgram> program)
+    : m_program(std::move(program))
+    , m_view_proj(m_program->uniform<glm::mat4>("view_proj"))
+{
+    m_f = QOpenGLContext::currentContext()->extraFunctions();
+}
+
+Viewshed::~Viewshed() = default;
+
+void Viewshed::set_observer(const Observer& observer)
+{
+    if (observer == m_observer)
+        return;
+    if (observer.resolution != m_observer.resolution)
+        m_atlas.reset();
+    m_observer = observer;
+    invalidate_cache();
+}
+
+const Viewshed::Observer& Viewshed::observer() const { return m_observer; }
+
+nucleus::camera::Frustum Viewshed::bounds() const
+{
+    const auto& p = m_observer.position;
+    const auto r = m_observer.range;
+    // the view looks along -z, so near and far are the negated top and bottom
+    return nucleus::camera::frustum_from_matrix(glm::ortho(p.x - r, p.x + r, p.y - r, p.y + r, -(p.z + r), -(p.z - r)));
+}
+
+double Viewshed::near_plane() const { return 1.0; }
+
+glm::dmat4 Viewshed::face_view(const glm::dvec3& position, unsigned face)
+{
+    const auto& d = face_directions[face];
+    const auto direction = glm::dvec3(d[0], d[1], d[2]);
+    const auto up = glm::dvec3(d[3], d[4], d[5]);
+    return glm::lookAt(position, position + direction, up);
+}
+
+glm::dmat4 Viewshed::face_world_to_clip(unsigned face) const
+{
+    return glm::perspective(glm::radians(90.0), 1.0, near_plane(), m_observer.range) * face_view(m_observer.position, face);
+}
+
+void Viewshed::allocate_atlas()
+{
+    m_atlas = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::Float32, std::vector<Framebuffer::ColourFormat> {}, glm::uvec2(3, 2) * m_observer.resolution);
+    m_atlas->set_memory_subsystem("viewshed");
+}
+
+void Viewshed::invalidate_cache() { m_valid = false; }
+
+void Viewshed::draw(TileManager* tile_manager,
+    const TileManager::DrawRange& range,
+    const nucleus::tile_scheduler::DrawListGenerator::TileSet& tiles,
+    const glm::dvec3& origin)
+{
+    if (m_valid && tiles == m_rendered_tiles)
+        return;
+    m_valid = true;
+    m_rendered_tiles = tiles;
+    if (!m_atlas)
+        allocate_atlas();
+
+    auto& state = GlState::current();
+    state.set_enabled(GL_DEPTH_TEST, true);
+    state.set_depth_func(GL_LESS);
+    state.set_enabled(GL_CULL_FACE, false);
+    m_program->bind();
+    m_atlas->bind();
+    state.set_enabled(GL_SCISSOR_TEST, true);
+    const auto size = GLsizei(m_observer.resolution);
+    for (unsigned face = 0; face < 6; ++face) {
+        const auto x = GLint((face % 3) * m_observer.resolution);
+        const auto y = GLint((face / 3) * m_observer.resolution);
+        state.set_viewport({ x, y, size, size });
+        m_f->glScissor(x, y, size, size);
+        m_f->glClear(GL_DEPTH_BUFFER_BIT);
+        // the vertex shader works in coordinates relative to the origin of prepare_draw
+        m_program->set_uniform(m_view_proj, glm::mat4(face_world_to_clip(face) * glm::translate(glm::dmat4(1.0), origin)));
+        tile_manager->draw(range);
+    }
+    state.set_enabled(GL_SCISSOR_TEST, false);
+    m_atlas->unbind();
+    m_program->release();
+    state.set_enabled(GL_CULL_FACE, true);
+}
+
+void Viewshed::bind(ShaderProgram* program, unsigned location, const glm::dvec3& camera_position)
+{
+    if (program != m_compose_program) {
+        m_compose_program = program;
+        m_compose_uniforms.enabled = program->uniform<int>("viewshed_enabled");
+        m_compose_uniforms.view_proj = program->uniform<glm::mat4>("viewshed_view_proj[0]");
+        m_compose_uniforms.observer = program->uniform<glm::vec3>("viewshed_observer");
+        m_compose_uniforms.range = program->uniform<float>("viewshed_range");
+        m_compose_uniforms.near = program->uniform<float>("viewshed_near");
+        m_compose_uniforms.texel_angle = program->uniform<float>("viewshed_texel_angle");
+    }
+    program->set_uniform(m_compose_uniforms.enabled, int(m_atlas != nullptr));
+    if (!m_atlas)
+        return;
+    m_atlas->bind_depth_texture(location);
+    // the compose shader works in camera local coordinates
+    const auto camera_local_to_world = glm::translate(glm::dmat4(1.0), camera_position);
+    std::array<glm::mat4, 6> view_proj;
+    for (unsigned face = 0; face < 6; ++face)
+        view_proj[face] = glm::mat4(face_world_to_clip(face) * camera_local_to_world);
+    program->set_uniform_array(m_compose_uniforms.view_proj, view_proj);
+    program->set_uniform(m_compose_uniforms.observer, glm::vec3(m_observer.position - camera_position));
+    program->set_uniform(m_compose_uniforms.range, float(m_observer.range));
+    program->set_uniform(m_compose_uniforms.near, float(near_plane()));
+    program->set_uniform(m_compose_uniforms.texel_angle, 2.0f / float(m_observer.resolution));
+}
+
+} // namespace gl_engine
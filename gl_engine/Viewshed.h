@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+
+#include <glm/glm.hpp>
+
+#include "nucleus/camera/Definition.h"
+#include "nucleus/tile_scheduler/DrawListGenerator.h"
+#include "ShaderProgram.h"
+#include "TileManager.h"
+
+class QOpenGLExtraFunctions;
+
+namespace gl_engine {
+
+class Framebuffer;
+
+// visibility analysis (viewshed): what can be seen from an observer point. the terrain depth around the observer is rendered into
+// the 6 faces of a cube (one perspective depth map with 90 degree field of view per face, in a 3x2 atlas), and the compose pass
+// tests every pixel against it and tints it as visible or hidden (see viewshed_visibility in compose.frag). like the shadow
+// cascades, the faces are cached and only rendered again if the observer or the tiles changed. the tiles are those of the draw
+// list, i.e., their detail follows the camera.
+class Viewshed {
+public:
+    struct Observer {
+        glm::dvec3 position = {}; // world space, typically a couple of metres above the terrain
+        double range = 10000; // metres, nothing beyond is tinted
+        unsigned resolution = 1024; // per face
+        bool operator==(const Observer&) const = default;
+    };
+
+    explicit Viewshed(std::shared_ptr<ShaderProgram> program);
+    ~Viewshed();
+
+    void set_observer(const Observer& observer);
+    [[nodiscard]] const Observer& observer() const;
+    // world space box around the observer (range in every direction), for culling the tiles of the pass
+    [[nodiscard]] nucleus::camera::Frustum bounds() const;
+    // renders the faces, if the observer or the tiles changed since the last draw. origin is the one given to prepare_draw.
+    void draw(TileManager* tile_manager,
+        const TileManager::DrawRange& range,
+        const nucleus::tile_scheduler::DrawListGenerator::TileSet& tiles,
+        const glm::dvec3& origin);
+    void invalidate_cache();
+
+    // sets the viewshed uniforms of the compose program and binds the atlas to location (texin_viewshed, see the sampler layout
+    // in ShaderManager)
+    void bind(ShaderProgram* program, unsigned location, const glm::dvec3& camera_position);
+    // world to clip matrix of a face (+x, -x, +y, -y, +z, -z)
+    [[nodiscard]] glm::dmat4 face_world_to_clip(unsigned face) const;
+    // view matrix of a cube face at position, in the order of the atlas (3 columns, 2 rows). also used by FarField.
+    [[nodiscard]] static glm::dmat4 face_view(const glm::dvec3& position, unsigned face);
+    [[nodiscard]] double near_plane() const;
+
+private:
+    void allocate_atlas();
+
+    Observer m_observer;
+    std::shared_ptr<ShaderProgram> m_program;
+    ShaderProgram::Uniform<glm::mat4> m_view_proj;
+    ShaderProgram* m_compose_program = nullptr; // of the handles below, resolved on the first bind
+    struct {
+        ShaderProgram::Uniform<int> enabled;
+        ShaderProgram::Uniform<glm::mat4> view_proj; // array of 6
+        ShaderProgram::Uniform<glm::vec3> observer;
+        ShaderProgram::Uniform<float> range;
+        ShaderProgram::Uniform<float> near;
+        ShaderProgram::Uniform<float> texel_angle;
+    } m_compose_uniforms;
+    std::unique_ptr<Framebuffer> m_atlas;
+    nucleus::tile_scheduler::DrawListGenerator::TileSet m_rendered_tiles;
+    bool m_valid = false;
+    QOpenGLExtraFunctions* m_f;
+};
+
+} // namespace gl_engine
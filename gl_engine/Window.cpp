@@ -19,6 +19,11 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
 #include <QCoreApplication>
 
 #include <QDebug>
@@ -32,12 +37,19 @@
 #include <QOpenGLVersionFunctionsFactory>
 
 #include "DebugPainter.h"
+#include "DepthReadback.h"
 #include "Framebuffer.h"
+#include "GlCounters.h"
+#include "GlState.h"
+#include "GpuMemory.h"
 #include "MapLabelManager.h"
+#include "RenderTargetPool.h"
 #include "SSAO.h"
+#include "TemporalUpsampling.h"
 #include "ShaderManager.h"
 #include "ShaderProgram.h"
 #include "ShadowMapping.h"
+#include "Texture.h"
 #include "TileManager.h"
 #include "Window.h"
 #include "helpers.h"
@@ -48,6 +60,7 @@
 #include <QPropertyAnimation>
 #include <QRandomGenerator>
 #include <QSequentialAnimationGroup>
+#include <QStringList>
 #include <QTimer>
 #include <glm/glm.hpp>
 
@@ -58,10 +71,14 @@
 
 #include "nucleus/timing/TimerManager.h"
 #include "nucleus/timing/CpuTimer.h"
+#include "nucleus/timing/StartupTimeline.h"
+#include "nucleus/timing/TraceRecorder.h"
+#include "nucleus/utils/MetricsRegistry.h"
 #include "nucleus/utils/bit_coding.h"
 #if (defined(__linux) && !defined(__ANDROID__)) || defined(_WIN32) || defined(_WIN64)
 #include "GpuAsyncQueryTimer.h"
 #endif
+#include "GpuDisjointQueryTimer.h"
 
 #if (defined(__linux) && !defined(__ANDROID__)) || defined(_WIN32) || defined(_WIN64)
 #include <QOpenGLFunctions_3_3_Core> // for wireframe mode
@@ -74,11 +91,45 @@
  using gl_engine::Window;
  using gl_engine::UniformBuffer;
 
+namespace {
+// the settings that are read by compose (and the shadow and ssao passes before it) only, the gbuffer and the atmosphere
+// background don't depend on them
+bool only_lighting_differs(gl_engine::uboSharedConfig a, const gl_engine::uboSharedConfig& b)
+{
+    a.m_sun_light = b.m_sun_light;
+    a.m_sun_light_dir = b.m_sun_light_dir;
+    a.m_amb_light = b.m_amb_light;
+    a.m_material_light_response = b.m_material_light_response;
+    a.m_snow_settings_angle = b.m_snow_settings_angle;
+    a.m_snow_settings_alt = b.m_snow_settings_alt;
+    a.m_ssao_falloff_to_value = b.m_ssao_falloff_to_value;
+    a.m_phong_enabled = b.m_phong_enabled;
+    a.m_ssao_enabled = b.m_ssao_enabled;
+    a.m_ssao_kernel = b.m_ssao_kernel;
+    a.m_ssao_range_check = b.m_ssao_range_check;
+    a.m_ssao_blur_kernel_size = b.m_ssao_blur_kernel_size;
+    a.m_ssao_resolution = b.m_ssao_resolution;
+    a.m_ssao_temporal_enabled = b.m_ssao_temporal_enabled;
+    a.m_height_lines_enabled = b.m_height_lines_enabled;
+    a.m_csm_enabled = b.m_csm_enabled;
+    a.m_overlay_shadowmaps_enabled = b.m_overlay_shadowmaps_enabled;
+    return a == b;
+}
+} // namespace
+
  Window::Window()
      : m_camera({ 1822577.0, 6141664.0 - 500, 171.28 + 500 }, { 1822577.0, 6141664.0, 171.28 }) // should point right at the stephansdom
  {
      m_tile_manager = std::make_unique<TileManager>();
+     m_tile_manager->set_min_tile_contribution(4.f);
+     connect(m_tile_manager.get(), &TileManager::quad_limit_changed, this, &Window::quad_limit_changed);
+     connect(m_tile_manager.get(), &TileManager::gpu_tiles_released, this, &Window::gpu_tiles_released);
      m_map_label_manager = std::make_unique<MapLabelManager>();
+     // the scheduler sends all quads again after a release, including their labels
+     connect(m_tile_manager.get(), &TileManager::gpu_tiles_released, this, [this]() { m_map_label_manager->clear_streamed_labels(); });
+     m_motion_idle_timer = new QTimer(this);
+     m_motion_idle_timer->setSingleShot(true);
+     connect(m_motion_idle_timer, &QTimer::timeout, this, &Window::update_requested); // the full quality frame
      QTimer::singleShot(1, [this]() { emit update_requested(); });
 }
 
@@ -91,6 +142,7 @@ Window::~Window()
 
 void Window::initialise_gpu()
 {
+    const nucleus::timing::StartupScope startup_scope("initialise gpu");
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
     assert(f->hasOpenGLFeature(QOpenGLExtraFunctions::OpenGLFeature::MultipleRenderTargets));
     Q_UNUSED(f);
@@ -104,9 +156,18 @@ void Window::initialise_gpu()
     logger->startLogging(QOpenGLDebugLogger::SynchronousLogging);
 
     m_debug_painter = std::make_unique<DebugPainter>();
-    m_shader_manager = std::make_unique<ShaderManager>();
-
-    m_tile_manager->init();
+    {
+        const nucleus::timing::StartupScope scope("shader manager"); // the tile program, the others compile in the background
+        m_shader_manager = std::make_unique<ShaderManager>();
+    }
+    m_uniforms.viewshed_enabled = m_shader_manager->compose_program()->uniform<int>("viewshed_enabled");
+    m_uniforms.far_field_enabled = m_shader_manager->compose_program()->uniform<int>("far_field_enabled");
+    m_uniforms.vector_overlay_enabled = m_shader_manager->compose_program()->uniform<int>("vector_overlay_enabled");
+    m_uniforms.sharpness = m_shader_manager->upscale_program()->uniform<float>("sharpness");
+    {
+        const nucleus::timing::StartupScope scope("tile arrays");
+        m_tile_manager->init();
+    }
     m_tile_manager->initilise_attribute_locations(m_shader_manager->tile_shader());
     m_screen_quad_geometry = gl_engine::helpers::create_screen_quad_geometry();
     // NOTE to position buffer: The position can not be recalculated by depth alone. (given the numerical resolution of the depth buffer and
@@ -121,17 +182,33 @@ void Window::initialise_gpu()
     m_gbuffer = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::Float32,
         std::vector {
             Framebuffer::ColourFormat::RGBA8, // Albedo
+#if ALP_ENABLE_COMPACT_GBUFFER
+            Framebuffer::ColourFormat::Float32, // Distance only, the position is reconstructed from the view ray (gbuffer.glsl)
+#else
             Framebuffer::ColourFormat::RGBA32F, // Position WCS and distance (distance is optional, but i use it directly for a little speed improvement)
+#endif
             Framebuffer::ColourFormat::RG16UI, // Octahedron Normals
             Framebuffer::ColourFormat::RGBA8, // Discretized Encoded Depth for readback IMPORTANT: IF YOU MOVE THIS YOU HAVE TO ADAPT THE GET DEPTH FUNCTION
         });
+    m_gbuffer->set_memory_subsystem("gbuffer");
 
+#ifndef __EMSCRIPTEN__
+    // WebGL has no glMapBufferRange (and getBufferSubData blocks), so the asynchronous path is of no use there.
+    m_depth_readback = std::make_unique<DepthReadback>();
+#endif
     m_atmospherebuffer = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::RGBA8 });
-    m_decoration_buffer = std::make_unique<Framebuffer>(Framebuffer::DepthFormat::None, std::vector { Framebuffer::ColourFormat::RGBA8 });
-    f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_gbuffer->depth_texture()->textureId(), 0);
+    m_atmospherebuffer->set_memory_subsystem("atmosphere");
+    m_render_targets = std::make_unique<RenderTargetPool>();
+    update_atmosphere_lut({});
+    f->glGenSamplers(1, &m_upscale_sampler);
+    f->glSamplerParameteri(m_upscale_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    f->glSamplerParameteri(m_upscale_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    f->glSamplerParameteri(m_upscale_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    f->glSamplerParameteri(m_upscale_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     m_shared_config_ubo = std::make_shared<gl_engine::UniformBuffer<gl_engine::uboSharedConfig>>(0, "shared_config");
     m_shared_config_ubo->init();
+    m_shader_manager->set_feature_config(m_shared_config_ubo->data);
     m_shared_config_ubo->bind_to_shader(m_shader_manager->all());
 
     m_camera_config_ubo = std::make_shared<gl_engine::UniformBuffer<gl_engine::uboCameraConfig>>(1, "camera_config");
@@ -142,9 +219,19 @@ void Window::initialise_gpu()
     m_shadow_config_ubo->init();
     m_shadow_config_ubo->bind_to_shader(m_shader_manager->all());
 
-    m_ssao = std::make_unique<gl_engine::SSAO>(m_shader_manager->shared_ssao_program(), m_shader_manager->shared_ssao_blur_program());
+    m_temporal_upsampling = std::make_unique<TemporalUpsampling>(m_shader_manager->shared_temporal_upsampling_program());
+    m_ssao = std::make_unique<gl_engine::SSAO>(m_shader_manager->shared_ssao_program(), m_shader_manager->shared_ssao_blur_program(), m_shader_manager->shared_ssao_upsample_program(), m_shader_manager->shared_ssao_temporal_program(), m_render_targets.get());
 
-    m_shadowmapping = std::make_unique<gl_engine::ShadowMapping>(m_shader_manager->shared_shadowmap_program(), m_shadow_config_ubo, m_shared_config_ubo);
+    m_shadowmapping = std::make_unique<gl_engine::ShadowMapping>(m_shader_manager->shared_shadowmap_program(), m_shadow_config_ubo, m_shared_config_ubo, m_shadow_settings);
+    m_viewshed = std::make_unique<gl_engine::Viewshed>(m_shader_manager->shared_viewshed_program());
+    if (m_viewshed_observer)
+        m_viewshed->set_observer(*m_viewshed_observer);
+    m_far_field = std::make_unique<gl_engine::FarField>(m_shader_manager->shared_far_field_program());
+    if (m_far_field_settings)
+        m_far_field->set_settings(*m_far_field_settings);
+    m_vector_overlay = std::make_unique<gl_engine::VectorOverlay>(m_shader_manager->shared_vector_overlay_program());
+    m_vector_overlay->set_settings(m_vector_overlay_settings);
+    m_vector_overlay->set_data(m_vector_overlay_data);
 
     m_map_label_manager->init();
 
@@ -153,7 +240,7 @@ void Window::initialise_gpu()
         using nucleus::timing::CpuTimer;
         m_timer = std::make_unique<nucleus::timing::TimerManager>();
 
-// GPU Timing Queries not supported on OpenGL ES or Web GL
+        bool gpu_timers = false;
 #if (defined(__linux) && !defined(__ANDROID__)) || defined(_WIN32) || defined(_WIN64)
         m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("ssao", "GPU", 240, 1.0f/60.0f));
         m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("atmosphere", "GPU", 240, 1.0f/60.0f));
@@ -161,10 +248,36 @@ void Window::initialise_gpu()
         m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("shadowmap", "GPU", 240, 1.0f/60.0f));
         m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("compose", "GPU", 240, 1.0f/60.0f));
         m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("labels", "GPU", 240, 1.0f / 60.0f));
+        m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("upscale", "GPU", 240, 1.0f / 60.0f));
         m_timer->add_timer(make_shared<GpuAsyncQueryTimer>("gpu_total", "TOTAL", 240, 1.0f/60.0f));
+        gpu_timers = true;
+#else
+        // OpenGL ES and WebGL: only if the driver / browser exposes EXT_disjoint_timer_query
+        if (const auto timeline = GpuDisjointQueryTimer::make_timeline()) {
+            for (const auto* name : { "ssao", "atmosphere", "tiles", "shadowmap", "compose", "labels", "upscale" })
+                m_timer->add_timer(make_shared<GpuDisjointQueryTimer>(timeline, name, "GPU", 240, 1.0f / 60.0f));
+            m_timer->add_timer(make_shared<GpuDisjointQueryTimer>(timeline, "gpu_total", "TOTAL", 240, 1.0f / 60.0f));
+            gpu_timers = true;
+        }
 #endif
         m_timer->add_timer(make_shared<CpuTimer>("cpu_total", "TOTAL", 240, 1.0f/60.0f));
         m_timer->add_timer(make_shared<CpuTimer>("cpu_b2b", "TOTAL", 240, 1.0f/60.0f));
+        m_timer->add_timer(make_shared<CpuTimer>("draw_list", "CPU", 240, 1.0f / 60.0f));
+
+        m_timers.cpu_total = m_timer->handle("cpu_total");
+        m_timers.cpu_b2b = m_timer->handle("cpu_b2b");
+        m_timers.draw_list = m_timer->handle("draw_list");
+        if (gpu_timers) {
+            m_timers.gpu_total = m_timer->handle("gpu_total");
+            m_timers.atmosphere = m_timer->handle("atmosphere");
+            m_timers.shadowmap = m_timer->handle("shadowmap");
+            m_timers.tiles = m_timer->handle("tiles");
+            m_timers.ssao = m_timer->handle("ssao");
+            m_timers.compose = m_timer->handle("compose");
+            m_timers.upscale = m_timer->handle("upscale");
+            m_timers.labels = m_timer->handle("labels");
+        }
+        m_measurement_snapshot->set_timers(*m_timer, GlCounters::pass_names());
     }
 
     emit gpu_ready_changed(true);
@@ -177,66 +290,408 @@ void Window::resize_framebuffer(int width, int height)
 
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
     if (!f) return;
-    m_gbuffer->resize({ width, height });
-    m_decoration_buffer->resize({ width, height });
-    f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_gbuffer->depth_texture()->textureId(), 0);
+    m_framebuffer_size = { width, height };
+    resize_internal_targets();
+}
+
+glm::uvec2 Window::internal_size() const
+{
+    const auto scaled = glm::round(glm::vec2(m_framebuffer_size) * m_render_scale_controller.scale());
+    return glm::max(glm::uvec2(scaled), glm::uvec2(1));
+}
 
-    m_atmospherebuffer->resize({ 1, height });
-    m_ssao->resize({ width, height });
+void Window::resize_internal_targets()
+{
+    const auto size = internal_size();
+    m_gbuffer->resize(size);
+    m_atmospherebuffer->resize({ 1, size.y });
+    m_ssao->resize(size);
+    m_gbuffer_camera.reset();
+}
+
+void Window::set_render_scale_settings(const nucleus::utils::RenderScaleController::Settings& settings)
+{
+    if (m_render_scale_controller.set_settings(settings) && m_gbuffer) {
+        resize_internal_targets();
+        emit update_requested();
+    }
 }
 
 void Window::paint(QOpenGLFramebufferObject* framebuffer)
 {
-    m_timer->start_timer("cpu_total");
-    m_timer->start_timer("gpu_total");
+    m_timers.cpu_total.start();
+    m_timers.gpu_total.start();
+    // the gl commands per pass, published with the timers. everything between the passes (e.g., uploads) counts as other.
+    auto& counters = GlCounters::current();
+    counters.begin_frame();
+    drain_gpu_quad_mailbox();
 
     QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+    // qt (scene graph, fbo helpers) changes the gl state between frames behind our back
+    auto& state = GlState::current();
+    state.invalidate();
 
-    f->glEnable(GL_CULL_FACE);
-    f->glCullFace(GL_BACK);
+    if (m_shader_manager->poll()) {
+        // NOTE: UBOs need to be reattached to the swapped programs!
+        m_shared_config_ubo->bind_to_shader(m_shader_manager->all());
+        m_camera_config_ubo->bind_to_shader(m_shader_manager->all());
+        m_shadow_config_ubo->bind_to_shader(m_shader_manager->all());
+        m_shadowmapping->invalidate_cache();
+        m_viewshed->invalidate_cache();
+        m_far_field->invalidate_cache();
+        m_vector_overlay->invalidate_cache();
+        m_gbuffer_camera.reset();
+    }
+    if (m_shader_manager->compiling())
+        emit update_requested(); // keep polling
+    if (!m_shader_manager->ready()) {
+        // first frames, while the programs are still compiling in the background
+        if (framebuffer)
+            state.bind_framebuffer(framebuffer->handle());
+        f->glClearColor(0.0, 0.0, 0.0, 1.0);
+        f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_timers.cpu_total.stop();
+        m_timers.gpu_total.stop();
+        return;
+    }
 
-    // UPDATE CAMERA UNIFORM BUFFER
-    // NOTE: Could also just be done on camera or viewport change!
-    uboCameraConfig* cc = &m_camera_config_ubo->data;
-    cc->position = glm::vec4(m_camera.position(), 1.0);
-    cc->view_matrix = m_camera.local_view_matrix();
-    cc->proj_matrix = m_camera.projection_matrix();
-    cc->view_proj_matrix = cc->proj_matrix * cc->view_matrix;
-    cc->inv_view_proj_matrix = glm::inverse(cc->view_proj_matrix);
-    cc->inv_view_matrix = glm::inverse(cc->view_matrix);
-    cc->inv_proj_matrix = glm::inverse(cc->proj_matrix);
-    cc->viewport_size = m_camera.viewport_size();
-    cc->distance_scaling_factor = m_camera.distance_scale_factor();
-    m_camera_config_ubo->update_gpu_data();
+    nucleus::timing::StartupTimeline::instance().finish(); // the first frame that shows something
+
+    // the draw list is generated on a worker, while the atmosphere is drawn and the new tiles are uploaded
+    m_tile_manager->start_tilelist(m_camera);
+
+    state.set_enabled(GL_CULL_FACE, true);
+    state.set_cull_face(GL_BACK);
+
+    // reduced quality while the camera moves, see MotionQualitySettings
+    const auto moving = m_motion_idle_timer->isActive();
+    ++m_frame;
 
+    // UPDATE CAMERA UNIFORM BUFFER (only on camera or viewport change, or with temporal upsampling every frame)
+    const auto temporal_upsampling = m_temporal_upsampling_enabled && m_temporal_upsampling && !m_painting_view;
+    update_camera_ubo(temporal_upsampling ? m_temporal_upsampling->next_jitter(m_gbuffer->size()) : glm::dvec2(0.0));
+
+    // time of day scrubbing and the like: the atmosphere (and below, the gbuffer if the tiles are the same) of the last frame
+    // are still good, the shadows follow the sun by themselves, and compose applies the rest
+    const auto lighting_only = m_lighting_only_change && !m_painting_view && !temporal_upsampling && m_gbuffer_camera && *m_gbuffer_camera == m_camera;
+    m_lighting_only_change = false;
 
     // DRAW ATMOSPHERIC BACKGROUND
-    m_atmospherebuffer->bind();
-    f->glClearColor(0.0, 0.0, 0.0, 1.0);
-    f->glClear(GL_COLOR_BUFFER_BIT);
-    f->glDisable(GL_DEPTH_TEST);
-    f->glDepthFunc(GL_ALWAYS);
     auto p = m_shader_manager->atmosphere_bg_program();
-    p->bind();
-    m_timer->start_timer("atmosphere");
-    m_screen_quad_geometry.draw();
-    m_timer->stop_timer("atmosphere");
-    p->release();
+    if (!lighting_only) {
+        counters.set_pass(GlCounters::Pass::Atmosphere);
+        m_atmospherebuffer->bind();
+        f->glClearColor(0.0, 0.0, 0.0, 1.0);
+        f->glClear(GL_COLOR_BUFFER_BIT);
+        state.set_enabled(GL_DEPTH_TEST, false);
+        state.set_depth_func(GL_ALWAYS);
+        p->bind();
+        m_timers.atmosphere.start();
+        m_screen_quad_geometry.draw();
+        m_timers.atmosphere.stop();
+        p->release();
+        counters.set_pass(GlCounters::Pass::Other);
+    }
+
+    // uploads within the frame budget, the rest is drawn with the parents until the next frames
+    if (!m_painting_view && m_tile_manager->process_upload_queue(m_camera))
+        emit update_requested();
 
     // Generate Draw-List
-    // Note: Could also just be done on camera change
-    m_timer->start_timer("draw_list");
-    const auto tile_set = m_tile_manager->generate_tilelist(m_camera);
-    m_timer->stop_timer("draw_list");
+    // the list is only regenerated on camera or tile changes, the passes only if the list or their frustum changed.
+    m_timers.draw_list.start();
+    const auto& tile_set = m_tile_manager->generate_tilelist(m_camera);
+    const auto draw_list_changed = m_tile_manager->draw_list_version() != m_draw_passes_version;
+    m_draw_passes_version = m_tile_manager->draw_list_version();
+    // with gpu culling, the passes are culled with the masks of a previous frame, and again when newer ones arrived
+    if (m_gpu_culling != m_tile_manager->gpu_culling())
+        m_gpu_culling = m_tile_manager->set_gpu_culling(m_gpu_culling);
+    const auto use_gpu_culling = m_gpu_culling && !m_painting_view;
+    const auto gpu_culling_changed = use_gpu_culling && m_tile_manager->gpu_culling_version() != m_gpu_culling_version;
+    if (use_gpu_culling)
+        m_gpu_culling_version = m_tile_manager->gpu_culling_version();
+    // all passes of this frame share the same instance data. the first pass is the gbuffer, followed by one per shadow cascade
+    // and, if the cascades are drawn at once, their union, the viewshed and the far field. the pass sets are kept between frames,
+    // so that their storage is reused.
+    const auto n_cascades = m_shared_config_ubo->data.m_csm_enabled ? m_shadowmapping->n_cascades() : 0u;
+    const auto shadow_union_pass = m_shared_config_ubo->data.m_csm_enabled && m_shadowmapping->draws_cascades_at_once();
+    const auto viewshed_pass = m_viewshed_observer && !m_painting_view;
+    const auto far_field_pass = m_far_field_settings && !m_painting_view;
+    const auto n_passes = 1 + n_cascades + (shadow_union_pass ? 1u : 0u) + (viewshed_pass ? 1u : 0u) + (far_field_pass ? 1u : 0u);
+    const auto shadow_union_pass_index = 1 + n_cascades;
+    const auto viewshed_pass_index = shadow_union_pass_index + (shadow_union_pass ? 1u : 0u);
+    const auto far_field_pass_index = n_passes - 1;
+    if (m_draw_passes.size() != n_passes) {
+        m_draw_passes.resize(n_passes);
+        m_draw_pass_frusta.assign(n_passes, {}); // forces culling
+    }
+    const auto update_pass = [&](unsigned pass, const nucleus::camera::Frustum& frustum, bool force) {
+        if (!force && !draw_list_changed && !gpu_culling_changed && m_draw_pass_frusta[pass].corners == frustum.corners)
+            return false;
+        m_draw_pass_frusta[pass] = frustum;
+        // the gpu culls the gbuffer and cascade passes only
+        const auto gpu_view = use_gpu_culling && pass < 1 + n_cascades ? std::optional<unsigned>(pass) : std::nullopt;
+        m_tile_manager->cull(tile_set, frustum, &m_draw_passes[pass], gpu_view);
+        return true;
+    };
+    // the gbuffer pass also skips tiles that were hidden behind terrain in a previous frame, and the ones below the horizon. the
+    // shadow passes need them.
+    const auto depth_pyramid_changed = !m_painting_view && update_depth_pyramid();
+    if (!m_painting_view)
+        update_visibility_feedback(tile_set);
+    const auto gbuffer_pass_changed = update_pass(0, m_camera.frustum(), depth_pyramid_changed);
+    if (gbuffer_pass_changed) {
+        // also the tiles below the horizon of the terrain around the camera, and the ones of the far field
+        m_tile_manager->cull_below_horizon(m_camera, &m_draw_passes[0]);
+        if (far_field_pass)
+            m_tile_manager->cull_by_distance(m_camera.position(), 0, m_far_field_settings->distance, &m_draw_passes[0]);
+        if (m_occlusion_culling && !m_painting_view) {
+            m_occluded_tiles.clear();
+            m_tile_manager->cull_occluded(m_depth_pyramid, m_camera.position(), &m_draw_passes[0], &m_occluded_tiles);
+            if (m_occluded_tiles != m_reported_occluded_tiles) {
+                m_reported_occluded_tiles = m_occluded_tiles;
+                emit occluded_tiles_changed(m_reported_occluded_tiles);
+            }
+        }
+    }
+    if (m_shared_config_ubo->data.m_csm_enabled) {
+        m_shadowmapping->update_cascades(m_camera, m_tile_manager->tile_bounds(tile_set));
+        auto cascades_changed = false;
+        for (unsigned i = 0; i < n_cascades; ++i)
+            cascades_changed |= update_pass(i + 1, m_shadowmapping->getFrustum(i), false);
+        if (shadow_union_pass && cascades_changed) {
+            m_shadow_union_scratch.clear();
+            for (unsigned i = 0; i < n_cascades; ++i)
+                m_shadow_union_scratch.insert(m_shadow_union_scratch.end(), m_draw_passes[i + 1].begin(), m_draw_passes[i + 1].end());
+            m_draw_passes[shadow_union_pass_index].assign(m_shadow_union_scratch.begin(), m_shadow_union_scratch.end());
+        }
+    }
+    if (viewshed_pass)
+        update_pass(viewshed_pass_index, m_viewshed->bounds(), false);
+    if (far_field_pass) {
+        // the far pass is empty, unless the faces are rendered in this frame
+        auto& far_tiles = m_draw_passes[far_field_pass_index];
+        far_tiles.clear();
+        if (m_far_field->update(m_camera.position(), draw_list_changed, moving)) {
+            far_tiles.assign(tile_set.begin(), tile_set.end());
+            m_tile_manager->cull_by_distance(m_far_field->centre(), m_far_field->near_distance(), std::numeric_limits<double>::infinity(), &far_tiles);
+        }
+    }
+    if (use_gpu_culling) {
+        // the gbuffer and the cascade frusta, in the order of the passes (without the union and viewshed passes)
+        if (m_tile_manager->start_gpu_culling(std::span(m_draw_pass_frusta).first(1 + n_cascades), m_camera.position()))
+            emit update_requested();
+    }
+    const std::span<const nucleus::tile_scheduler::DrawListGenerator::TileSet> passes = m_draw_passes;
+    const std::span<const TileManager::DrawRange> draw_ranges = m_tile_manager->prepare_draw(m_camera, passes, m_camera.position());
+    m_timers.draw_list.stop();
 
     // DRAW SHADOWMAPS
     if (m_shared_config_ubo->data.m_csm_enabled) {
-        m_timer->start_timer("shadowmap");
-        m_shadowmapping->draw(m_tile_manager.get(), tile_set, m_camera);
-        m_timer->stop_timer("shadowmap");
+        counters.set_pass(GlCounters::Pass::Shadowmap);
+        m_timers.shadowmap.start();
+        m_shadowmapping->set_far_cascade_refresh(!moving);
+        m_shadowmapping->draw(m_tile_manager.get(), draw_ranges.subspan(1, n_cascades), passes.subspan(1, n_cascades), m_camera, shadow_union_pass ? &draw_ranges[shadow_union_pass_index] : nullptr);
+        m_timers.shadowmap.stop();
     }
+    counters.set_pass(GlCounters::Pass::Viewshed);
+    if (viewshed_pass)
+        m_viewshed->draw(m_tile_manager.get(), draw_ranges[viewshed_pass_index], passes[viewshed_pass_index], m_camera.position());
+    counters.set_pass(GlCounters::Pass::FarField);
+    if (far_field_pass)
+        m_far_field->draw(m_tile_manager.get(), draw_ranges[far_field_pass_index], m_camera.position());
+    // independent of the tiles, only if the data changed or the camera left the window of a level
+    counters.set_pass(GlCounters::Pass::VectorOverlay);
+    m_vector_overlay->draw(m_camera.position());
 
     // DRAW GBUFFER
+    const auto reuse_gbuffer = lighting_only && !gbuffer_pass_changed && m_gbuffer_resident_version == m_tile_manager->resident_version();
+    if (!reuse_gbuffer)
+        draw_gbuffer(draw_ranges.front());
+    m_gbuffer_camera = m_painting_view || temporal_upsampling ? std::nullopt : std::optional(m_camera);
+    m_gbuffer_resident_version = m_tile_manager->resident_version();
+
+    if (m_depth_readback && !m_painting_view && !reuse_gbuffer)
+        m_depth_readback->start_read(m_gbuffer.get(), 3, m_camera, m_tile_manager->draw_list_version());
+
+    // the ssao result is a transient target, it is computed again also for a reused gbuffer
+    if (m_shared_config_ubo->data.m_ssao_enabled) {
+        const nucleus::timing::ScopedTimer timer(m_timers.ssao);
+        const ScopedGlPass pass(GlCounters::Pass::Ssao);
+        auto ssao_kernel = m_shared_config_ubo->data.m_ssao_kernel;
+        auto ssao_resolution = m_shared_config_ubo->data.m_ssao_resolution;
+        if (moving) {
+            ssao_kernel = std::min(ssao_kernel, m_motion_quality_settings.ssao_kernel);
+            ssao_resolution = std::max(ssao_resolution, m_motion_quality_settings.ssao_resolution);
+        }
+        m_ssao->draw(m_gbuffer.get(), &m_screen_quad_geometry, m_camera, ssao_kernel, m_shared_config_ubo->data.m_ssao_blur_kernel_size, ssao_resolution, m_shared_config_ubo->data.m_ssao_temporal_enabled);
+    }
+
+    // at a reduced render scale or with temporal upsampling, compose goes into an intermediate target, which is resolved
+    // and / or upscaled into the framebuffer below
+    const auto upscale = m_gbuffer->size() != m_framebuffer_size || temporal_upsampling;
+    counters.set_pass(GlCounters::Pass::Compose);
+    Framebuffer* composed = nullptr;
+    if (upscale) {
+        composed = m_render_targets->acquire({ .depth_format = Framebuffer::DepthFormat::Float32,
+            .colour_formats = { Framebuffer::ColourFormat::RGBA8 },
+            .size = m_gbuffer->size(),
+            .exact_size = true });
+        composed->bind();
+    } else {
+        if (framebuffer)
+            state.bind_framebuffer(framebuffer->handle());
+        else
+            Framebuffer::unbind();
+        // the viewport of the last pass can be anything (transient targets are oversized while resizing)
+        state.set_viewport({ 0, 0, int(m_framebuffer_size.x), int(m_framebuffer_size.y) });
+    }
+
+    p = m_shader_manager->compose_program();
+
+    p->bind();
+    // texture units as in the sampler layout of the compose program (see ShaderManager)
+    m_gbuffer->bind_colour_texture(0, 0);
+    m_gbuffer->bind_colour_texture(1, 1);
+    m_gbuffer->bind_colour_texture(2, 2);
+    m_atmospherebuffer->bind_colour_texture(0, 3);
+    if (m_shared_config_ubo->data.m_ssao_enabled)
+        m_ssao->bind_ssao_texture(4);
+
+    m_shadowmapping->bind_shadow_maps(5);
+    m_gbuffer->bind_depth_texture(7);
+    m_atmosphere_lut->bind(8);
+    if (m_viewshed_observer)
+        m_viewshed->bind(p, 9, m_camera.position());
+    else
+        p->set_uniform(m_uniforms.viewshed_enabled, 0);
+    if (m_far_field_settings && !m_painting_view)
+        m_far_field->bind(p, 10, m_camera.position());
+    else
+        p->set_uniform(m_uniforms.far_field_enabled, 0);
+    if (!m_vector_overlay->empty()) {
+        const auto pixel_angle = 2.0 * std::tan(glm::radians(double(m_camera.field_of_view())) / 2.0) / double(m_gbuffer->size().y);
+        m_vector_overlay->bind(p, 13, m_camera.position(), float(pixel_angle));
+    } else {
+        p->set_uniform(m_uniforms.vector_overlay_enabled, 0);
+    }
+
+    m_timers.compose.start();
+    // compose writes the gbuffer depth into the target, so that the labels are depth tested there directly
+    state.set_depth_func(GL_ALWAYS);
+    state.set_depth_mask(true);
+    m_screen_quad_geometry.draw_with_depth_test();
+    m_timers.compose.stop();
+    m_shadowmapping->release_shadow_maps(5);
+    m_vector_overlay->release(13);
+    counters.set_pass(GlCounters::Pass::Other);
+
+    if (upscale) {
+        const nucleus::timing::ScopedTimer timer(m_timers.upscale);
+        const ScopedGlPass pass(GlCounters::Pass::Upscale);
+        // the history is at the output resolution already, the upscale pass only sharpens and copies the depth then
+        Framebuffer* source = composed;
+        if (temporal_upsampling)
+            source = m_temporal_upsampling->resolve(composed, m_gbuffer.get(), &m_screen_quad_geometry, m_camera, m_framebuffer_size);
+        if (framebuffer)
+            state.bind_framebuffer(framebuffer->handle());
+        else
+            Framebuffer::unbind();
+        state.set_viewport({ 0, 0, int(m_framebuffer_size.x), int(m_framebuffer_size.y) });
+        p = m_shader_manager->upscale_program();
+        p->bind();
+        source->bind_colour_texture(0, 0);
+        f->glBindSampler(0, m_upscale_sampler);
+        composed->bind_depth_texture(1);
+        p->set_uniform(m_uniforms.sharpness, m_render_scale_sharpness);
+        m_screen_quad_geometry.draw_with_depth_test(); // depth func is still GL_ALWAYS
+        f->glBindSampler(0, 0);
+        m_render_targets->release(composed);
+    }
+
+    // DRAW LABELS
+    {
+        const nucleus::timing::ScopedTimer timer(m_timers.labels);
+        const ScopedGlPass pass(GlCounters::Pass::Labels);
+        // the labels are drawn at the output resolution, without jitter
+        update_camera_ubo(glm::dvec2(0.0));
+        // straight into the target, blended by MapLabelManager::draw. the labels write depth as well, so that the text
+        // stays on top of its outline (see labels.frag).
+        state.set_depth_func(GL_LEQUAL);
+        if (!m_painting_view && (!moving || unsigned(m_frame) % std::max(m_motion_quality_settings.label_update_interval, 1u) == 0))
+            m_map_label_manager->update(m_camera);
+        m_shader_manager->labels_program()->bind();
+        m_map_label_manager->draw(m_gbuffer.get(), m_shader_manager->labels_program(), m_camera);
+        m_shader_manager->labels_program()->release();
+        state.set_enabled(GL_BLEND, false);
+        state.set_enabled(GL_DEPTH_TEST, false);
+    }
+
+    m_render_targets->end_frame();
+
+    m_timers.cpu_total.stop();
+    m_timers.gpu_total.stop();
+    if (m_render_looped) {
+        m_timers.cpu_b2b.stop();
+    }
+
+    // uploads and draws next to the scopes in the timeline, to attribute spikes to them
+    if (auto& recorder = nucleus::timing::TraceRecorder::instance(); recorder.enabled() && !m_painting_view) {
+        const auto counts = counters.total();
+        recorder.record_counter("upload bytes", "gl", double(counts.texture_bytes + counts.buffer_bytes));
+        recorder.record_counter("draw calls", "gl", double(counts.draw_calls));
+    }
+
+    const auto& new_values = m_timer->fetch_results();
+    if (!new_values.empty() && !m_painting_view) {
+        if (m_measurement_snapshot->enabled())
+            m_measurement_snapshot->publish(new_values, counters.counts());
+        // the frame is bound by the slower of cpu and gpu (gpu timers are missing on gles and webgl without EXT_disjoint_timer_query)
+        float frame_msecs = 0;
+        for (const auto& report : new_values) {
+            if (report.timer == m_timers.cpu_total.timer() || report.timer == m_timers.gpu_total.timer())
+                frame_msecs = std::max(frame_msecs, report.value);
+        }
+        if (frame_msecs > 0 && m_error_controller.update(frame_msecs, unsigned(m_tile_manager->tiles().size() / 4)))
+            apply_permissible_screen_space_error();
+        if (m_metrics)
+            export_metrics(new_values, frame_msecs);
+        if (m_spike_detector && frame_msecs > 0) {
+            if (const auto capture = m_spike_detector->add_frame(frame_msecs))
+                emit frame_spike_captured(*capture);
+        }
+        // the render scale only changes the gpu cost, i.e., it doesn't react to the cpu time
+        const auto gpu_total = std::find_if(new_values.begin(), new_values.end(), [this](const auto& report) { return report.timer == m_timers.gpu_total.timer(); });
+        if (gpu_total != new_values.end() && m_render_scale_controller.update(gpu_total->value)) {
+            resize_internal_targets();
+            emit update_requested();
+        }
+    }
+    if (gpu_memory::version() != m_reported_gpu_memory_version) {
+        m_reported_gpu_memory_version = gpu_memory::version();
+        emit gpu_memory_report_changed(gpu_memory_report());
+        if (m_metrics) {
+            for (const auto& usage : gpu_memory::usage())
+                m_metrics->set_gauge("alp_gpu_memory_bytes", double(usage.n_bytes), { { "subsystem", usage.subsystem } });
+        }
+    }
+
+    // the jitter sequence is completed for static views, afterwards the history doesn't change anymore
+    if (temporal_upsampling && !m_temporal_upsampling->converged())
+        emit update_requested();
+
+    if (m_render_looped) {
+        m_timers.cpu_b2b.start();
+        emit update_requested();
+    }
+}
+
+void Window::draw_gbuffer(const TileManager::DrawRange& range)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    auto& state = GlState::current();
+    auto& counters = GlCounters::current();
+    counters.set_pass(GlCounters::Pass::Tiles);
     m_gbuffer->bind();
 
     {
@@ -244,7 +699,11 @@ void Window::paint(QOpenGLFramebufferObject* framebuffer)
         const GLfloat clearAlbedoColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
         f->glClearBufferfv(GL_COLOR, 0, clearAlbedoColor);
         // Clear Position-Buffer (IMPORTANT [4] to <0, such that i know by sign if fragment was processed)
+#if ALP_ENABLE_COMPACT_GBUFFER
+        const GLfloat clearPositionColor[4] = { -1.0f, 0.0f, 0.0f, 0.0f }; // distance is in the red channel
+#else
         const GLfloat clearPositionColor[4] = { 0.0f, 0.0f, 0.0f, -1.0f };
+#endif
         f->glClearBufferfv(GL_COLOR, 1, clearPositionColor);
         // Clear Normals-Buffer
         const GLuint clearNormalColor[2] = { 0u, 0u };
@@ -257,9 +716,9 @@ void Window::paint(QOpenGLFramebufferObject* framebuffer)
         f->glClear(GL_DEPTH_BUFFER_BIT);
     }
 
-    f->glEnable(GL_DEPTH_TEST);
-    // f->glDepthFunc(GL_GREATER); // for reverse z
-    f->glDepthFunc(GL_LESS);
+    state.set_enabled(GL_DEPTH_TEST, true);
+    // state.set_depth_func(GL_GREATER); // for reverse z
+    state.set_depth_func(GL_LESS);
 
 #if (defined(__linux) && !defined(__ANDROID__)) || defined(_WIN32) || defined(_WIN64)
     auto funcs = QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_3_3_Core>(QOpenGLContext::currentContext()); // for wireframe mode
@@ -268,10 +727,11 @@ void Window::paint(QOpenGLFramebufferObject* framebuffer)
 #endif
 
     m_shader_manager->tile_shader()->bind();
-    m_timer->start_timer("tiles");
-    auto culled_tile_set = m_tile_manager->cull(tile_set, m_camera.frustum());
-    m_tile_manager->draw(m_shader_manager->tile_shader(), m_camera, culled_tile_set, true, m_camera.position());
-    m_timer->stop_timer("tiles");
+    m_timers.tiles.start();
+    m_tile_manager->draw(range);
+    m_timers.tiles.stop();
+    if (!m_painting_view)
+        m_tile_manager->report_drawn(m_draw_passes[0]);
     m_shader_manager->tile_shader()->release();
 
 #if (defined(__linux) && !defined(__ANDROID__)) || defined(_WIN32) || defined(_WIN64)
@@ -282,80 +742,84 @@ void Window::paint(QOpenGLFramebufferObject* framebuffer)
     m_gbuffer->unbind();
 
     m_shader_manager->tile_shader()->release();
+    counters.set_pass(GlCounters::Pass::Other);
+}
 
-    if (m_shared_config_ubo->data.m_ssao_enabled) {
-        m_timer->start_timer("ssao");
-        m_ssao->draw(m_gbuffer.get(), &m_screen_quad_geometry, m_camera, m_shared_config_ubo->data.m_ssao_kernel, m_shared_config_ubo->data.m_ssao_blur_kernel_size);
-        m_timer->stop_timer("ssao");
-    }
-
-    if (framebuffer)
-        framebuffer->bind();
-
-    p = m_shader_manager->compose_program();
-
-    p->bind();
-    p->set_uniform("texin_albedo", 0);
-    m_gbuffer->bind_colour_texture(0, 0);
-    p->set_uniform("texin_position", 1);
-    m_gbuffer->bind_colour_texture(1, 1);
-    p->set_uniform("texin_normal", 2);
-    m_gbuffer->bind_colour_texture(2, 2);
-    p->set_uniform("texin_atmosphere", 3);
-    m_atmospherebuffer->bind_colour_texture(0, 3);
-    p->set_uniform("texin_ssao", 4);
-    m_ssao->bind_ssao_texture(4);
-
-    m_shadowmapping->bind_shadow_maps(p, 5);
-
-    m_timer->start_timer("compose");
-    m_screen_quad_geometry.draw();
-    m_timer->stop_timer("compose");
-
-    // DRAW LABELS
-    m_timer->start_timer("labels");
-    {
-        m_decoration_buffer->bind();
-        const GLfloat clearAlbedoColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-        f->glClearBufferfv(GL_COLOR, 0, clearAlbedoColor);
-        f->glEnable(GL_DEPTH_TEST);
-        f->glDepthFunc(GL_LEQUAL);
-        // f->glDepthMask(GL_FALSE);
-        m_shader_manager->labels_program()->bind();
-        m_map_label_manager->draw(m_gbuffer.get(), m_shader_manager->labels_program(), m_camera);
-        m_shader_manager->labels_program()->release();
-
-        if (framebuffer)
-            framebuffer->bind();
-        m_shader_manager->screen_copy_program()->bind();
-        m_decoration_buffer->bind_colour_texture(0, 0);
-        f->glEnable(GL_BLEND);
-        f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        m_screen_quad_geometry.draw();
+void Window::paint_view(const nucleus::camera::Definition& camera, QOpenGLFramebufferObject* framebuffer)
+{
+    const auto main_camera = m_camera;
+    const auto main_size = m_framebuffer_size;
+    const auto view_size = glm::uvec2(framebuffer->width(), framebuffer->height());
+    m_painting_view = true;
+    m_camera = camera;
+    m_camera.set_viewport_size(view_size);
+    if (view_size != main_size) {
+        m_framebuffer_size = view_size;
+        resize_internal_targets();
     }
-
-    m_timer->stop_timer("labels");
-
-    m_timer->stop_timer("cpu_total");
-    m_timer->stop_timer("gpu_total");
-    if (m_render_looped) {
-        m_timer->stop_timer("cpu_b2b");
+    paint(framebuffer);
+    if (view_size != main_size) {
+        m_framebuffer_size = main_size;
+        resize_internal_targets();
     }
+    m_camera = main_camera;
+    m_painting_view = false;
+}
 
-    QList<nucleus::timing::TimerReport> new_values = m_timer->fetch_results();
-    if (new_values.size() > 0) {
-        emit report_measurements(new_values);
-    }
+void Window::update_camera_ubo(const glm::dvec2& jitter)
+{
+    if (m_ubo_camera && *m_ubo_camera == m_camera && m_ubo_jitter == jitter)
+        return;
+    uboCameraConfig* cc = &m_camera_config_ubo->data;
+    cc->position = glm::vec4(m_camera.position(), 1.0);
+    cc->view_matrix = m_camera.local_view_matrix();
+    cc->proj_matrix = m_camera.jittered_projection_matrix(jitter);
+    cc->view_proj_matrix = cc->proj_matrix * cc->view_matrix;
+    cc->inv_view_proj_matrix = glm::inverse(cc->view_proj_matrix);
+    cc->inv_view_matrix = glm::inverse(cc->view_matrix);
+    cc->inv_proj_matrix = glm::inverse(cc->proj_matrix);
+    cc->viewport_size = m_camera.viewport_size();
+    cc->distance_scaling_factor = m_camera.distance_scale_factor();
+    m_camera_config_ubo->update_gpu_data();
+    m_ubo_camera = m_camera;
+    m_ubo_jitter = jitter;
+}
 
-    if (m_render_looped) {
-        m_timer->start_timer("cpu_b2b");
-        emit update_requested();
-    }
+void Window::set_temporal_upsampling(bool enabled)
+{
+    if (m_temporal_upsampling_enabled == enabled)
+        return;
+    m_temporal_upsampling_enabled = enabled;
+    if (m_temporal_upsampling)
+        m_temporal_upsampling->invalidate_history();
+    emit update_requested();
 }
 
 void Window::shared_config_changed(gl_engine::uboSharedConfig ubo) {
+    const auto lighting_only = only_lighting_differs(m_shared_config_ubo->data, ubo);
+    m_lighting_only_change = lighting_only;
+    if ((m_shared_config_ubo->data.m_normal_mode == 2) != (ubo.m_normal_mode == 2))
+        emit normal_maps_needed_changed(ubo.m_normal_mode == 2);
     m_shared_config_ubo->data = ubo;
     m_shared_config_ubo->update_gpu_data();
+    m_tile_manager->set_overlay_mode(ubo.m_overlay_mode); // the per tile overlays need values in the instance data
+    if (m_shader_manager->set_feature_config(ubo)) {
+        m_shared_config_ubo->bind_to_shader(m_shader_manager->all());
+        m_camera_config_ubo->bind_to_shader(m_shader_manager->all());
+        m_shadow_config_ubo->bind_to_shader(m_shader_manager->all());
+    }
+    if (lighting_only) {
+        // the shadow maps are updated when the sun moves (ShadowMapping::draw), the far field keeps the albedo only
+        emit update_requested();
+        return;
+    }
+    m_gbuffer_camera.reset();
+    if (m_shadowmapping) // geometry related settings (e.g., curtains) change the shadow maps
+        m_shadowmapping->invalidate_cache();
+    if (m_viewshed)
+        m_viewshed->invalidate_cache();
+    if (m_far_field)
+        m_far_field->invalidate_cache();
     emit update_requested();
 }
 
@@ -363,14 +827,26 @@ void Window::render_looped_changed(bool render_looped_flag) {
     m_render_looped = render_looped_flag;
 }
 
+void Window::update_atmosphere_lut(const nucleus::utils::atmosphere_lut::Parameters& parameters)
+{
+    namespace atmosphere_lut = nucleus::utils::atmosphere_lut;
+    if (m_atmosphere_lut_parameters == parameters)
+        return;
+    m_atmosphere_lut_parameters = parameters;
+    const auto lut = atmosphere_lut::in_scattering(parameters);
+    m_atmosphere_lut = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::RGBA16F);
+    m_atmosphere_lut->set_memory_subsystem("atmosphere");
+    m_atmosphere_lut->setParams(Texture::Filter::Linear, Texture::Filter::Linear);
+    m_atmosphere_lut->allocate_array(atmosphere_lut::n_distances, atmosphere_lut::n_directions, atmosphere_lut::n_heights);
+    for (unsigned i = 0; i < lut.size(); ++i)
+        m_atmosphere_lut->upload(lut[i], i);
+}
+
 void Window::reload_shader() {
     auto do_reload = [this]() {
+        // compiled in the background, the programs are swapped (and the UBOs reattached) in paint once they are linked
         m_shader_manager->reload_shaders();
-        // NOTE: UBOs need to be reattached to the programs!
-        m_shared_config_ubo->bind_to_shader(m_shader_manager->all());
-        m_camera_config_ubo->bind_to_shader(m_shader_manager->all());
-        m_shadow_config_ubo->bind_to_shader(m_shader_manager->all());
-        qDebug("all shaders reloaded");
+        qDebug("shader reload started");
         emit update_requested();
     };
 #if ALP_ENABLE_SHADER_NETWORK_HOTRELOAD
@@ -403,6 +879,7 @@ void Window::keyPressEvent(QKeyEvent* e)
     }
     if (e->key() == Qt::Key::Key_F7) {
         m_wireframe_enabled = !m_wireframe_enabled;
+        m_gbuffer_camera.reset();
         qDebug(m_render_looped ? "Wireframe enabled" : "Wireframe disabled");
     }
     if (e->key() == Qt::Key::Key_F11
@@ -424,32 +901,266 @@ void Window::updateCameraEvent()
     emit update_camera_requested();
 }
 
-void Window::set_permissible_screen_space_error(float new_error) { m_tile_manager->set_permissible_screen_space_error(new_error); }
+void Window::set_permissible_screen_space_error(float new_error)
+{
+    m_error_controller.set_base_error(new_error);
+    apply_permissible_screen_space_error();
+}
+
+void Window::set_screen_space_error_controller_settings(const nucleus::tile_scheduler::ScreenSpaceErrorController::Settings& settings)
+{
+    m_error_controller.set_settings(settings);
+    apply_permissible_screen_space_error();
+}
+
+void Window::apply_permissible_screen_space_error()
+{
+    const auto error = m_error_controller.error();
+    if (error == m_applied_permissible_screen_space_error)
+        return;
+    m_applied_permissible_screen_space_error = error;
+    m_tile_manager->set_permissible_screen_space_error(error);
+    emit permissible_screen_space_error_changed(error);
+}
 
 void Window::set_quad_limit(unsigned int new_limit) { m_tile_manager->set_quad_limit(new_limit); }
 
+void Window::set_tile_format(const nucleus::tile_scheduler::tile_types::TileFormat& new_format) { m_tile_manager->set_tile_format(new_format); }
+
+bool Window::enable_background_uploads(std::shared_ptr<QOffscreenSurface> surface)
+{
+    assert(m_tile_manager);
+    const auto enabled = m_tile_manager->enable_background_uploads(std::move(surface));
+    qDebug() << "Window: background tile uploads" << (enabled ? "enabled" : "not available");
+    return enabled;
+}
+
+void Window::set_shadow_settings(const ShadowMapping::Settings& settings)
+{
+    m_shadow_settings = settings;
+    if (m_shadowmapping) {
+        m_shadowmapping->set_settings(settings);
+        emit update_requested();
+    }
+}
+
+void Window::set_viewshed(const std::optional<Viewshed::Observer>& observer)
+{
+    m_viewshed_observer = observer;
+    if (m_viewshed && observer)
+        m_viewshed->set_observer(*observer);
+    emit update_requested();
+}
+
+void Window::set_far_field(const std::optional<FarField::Settings>& settings)
+{
+    m_far_field_settings = settings;
+    if (m_far_field && settings)
+        m_far_field->set_settings(*settings);
+    m_draw_pass_frusta.assign(m_draw_pass_frusta.size(), {}); // the near field changes
+    emit update_requested();
+}
+
+void Window::set_vector_overlay(VectorOverlay::DataPtr data)
+{
+    m_vector_overlay_data = data;
+    if (m_vector_overlay)
+        m_vector_overlay->set_data(std::move(data));
+    emit update_requested();
+}
+
+void Window::set_vector_overlay_settings(const VectorOverlay::Settings& settings)
+{
+    m_vector_overlay_settings = settings;
+    if (m_vector_overlay)
+        m_vector_overlay->set_settings(settings);
+    emit update_requested();
+}
+
+void Window::set_motion_quality_settings(const MotionQualitySettings& settings)
+{
+    m_motion_quality_settings = settings;
+    if (!settings.enabled && m_motion_idle_timer->isActive()) {
+        m_motion_idle_timer->stop();
+        emit update_requested();
+    }
+}
+
 void Window::update_camera(const nucleus::camera::Definition& new_definition)
 {
     //    qDebug("void Window::update_camera(const nucleus::camera::Definition& new_definition)");
+    if (m_motion_quality_settings.enabled && !(new_definition == m_camera))
+        m_motion_idle_timer->start(int(m_motion_quality_settings.idle_msecs));
     m_camera = new_definition;
     emit update_requested();
 }
 
+std::vector<gl_engine::gpu_memory::SubsystemUsage> Window::gpu_memory_usage() const { return gpu_memory::usage(); }
+
+QString Window::gpu_memory_report() const
+{
+    const auto mib = [](uint64_t n_bytes) { return QString::number(double(n_bytes) / (1024.0 * 1024.0), 'f', 1) + " MiB"; };
+    QStringList lines;
+    for (const auto& entry : gpu_memory::usage())
+        lines.append(QString("%1: %2").arg(QString::fromStdString(entry.subsystem), mib(entry.n_bytes)));
+    lines.append(QString("total: %1").arg(mib(gpu_memory::total_bytes())));
+    if (const auto driver = gpu_memory::driver_info()) {
+        if (driver->total_bytes)
+            lines.append(QString("driver: %1 of %2 available").arg(mib(driver->available_bytes), mib(*driver->total_bytes)));
+        else
+            lines.append(QString("driver: %1 available").arg(mib(driver->available_bytes)));
+    }
+    return lines.join('\n');
+}
+
 void Window::update_debug_scheduler_stats(const QString& stats)
 {
     m_debug_scheduler_stats = stats;
     emit update_requested();
 }
 
-void Window::update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads)
+void Window::update_gpu_quads(const nucleus::tile_scheduler::tile_types::GpuTileQuadBatch& new_quads, const std::vector<tile::Id>& deleted_quads)
 {
     assert(m_tile_manager);
-    m_tile_manager->update_gpu_quads(new_quads, deleted_quads);
+    assert(new_quads);
+    m_tile_manager->update_gpu_quads(*new_quads, deleted_quads);
+    m_map_label_manager->update_gpu_quads(*new_quads, deleted_quads);
+}
+
+void Window::set_gpu_quad_mailbox(const std::shared_ptr<nucleus::tile_scheduler::tile_types::GpuQuadMailbox>& mailbox)
+{
+    m_gpu_quad_mailbox = mailbox;
+}
+
+void Window::drain_gpu_quad_mailbox()
+{
+    if (!m_gpu_quad_mailbox)
+        return;
+    while (auto update = m_gpu_quad_mailbox->pop())
+        update_gpu_quads(update->new_quads, update->deleted_quads);
+}
+
+bool Window::update_depth_pyramid()
+{
+    if (!m_occlusion_culling || !m_depth_readback || m_depth_readback->data_version() == m_depth_pyramid_readback_version)
+        return false;
+    m_depth_pyramid_readback_version = m_depth_readback->data_version();
+    // the depth only needs to be rebuilt if it was rendered from another camera or with other tiles
+    const auto& camera = m_depth_readback->data_camera();
+    if (!m_depth_pyramid.empty() && m_depth_pyramid.camera() == camera && m_depth_pyramid_draw_list_version == m_tile_manager->draw_list_version())
+        return false;
+    m_depth_pyramid_draw_list_version = m_tile_manager->draw_list_version();
+
+    const auto& encoded = m_depth_readback->data();
+    m_depth_pyramid_distances.resize(encoded.size());
+    std::transform(encoded.begin(), encoded.end(), m_depth_pyramid_distances.begin(), [](const glm::u8vec4& e) {
+        if (e == glm::u8vec4(0)) // cleared, no terrain
+            return std::numeric_limits<float>::infinity();
+        return std::exp(nucleus::utils::bit_coding::to_f16f16(e)[0] * 13.f); // see depth()
+    });
+    m_depth_pyramid.build(camera, m_depth_readback->data_size(), m_depth_pyramid_distances);
+    return true;
+}
+
+void Window::update_visibility_feedback(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tile_set)
+{
+    if (!m_visibility_feedback || !m_depth_readback || m_depth_readback->data_version() == m_visibility_readback_version)
+        return;
+    m_visibility_readback_version = m_depth_readback->data_version();
+    // the draw list version changes with the camera and the gpu tiles, i.e., the readback shows exactly the tiles of tile_set
+    if (m_depth_readback->data_tag() != m_tile_manager->draw_list_version())
+        return;
+
+    std::vector<bool> visible_layers;
+    for (const auto& pixel : m_depth_readback->data()) {
+        const auto id = (unsigned(pixel[2]) << 8) | unsigned(pixel[3]); // texture layer + 1, see tile.frag
+        if (id == 0)
+            continue;
+        if (visible_layers.size() < id)
+            visible_layers.resize(id, false);
+        visible_layers[id - 1] = true;
+    }
+    // a quad was seen if a pixel of one of its tiles or descendants was visible, and drawn if a tile below it was in the list.
+    // tiles that are not resident yet are drawn with a resident ancestor, which is marked seen as well.
+    std::unordered_set<tile::Id, tile::Id::Hasher> seen;
+    for (const auto& tile : m_tile_manager->tiles()) {
+        if (tile.texture_layer >= visible_layers.size() || !visible_layers[tile.texture_layer])
+            continue;
+        for (auto id = tile.tile_id; seen.insert(id).second && id.zoom_level > 0;)
+            id = id.parent();
+    }
+    std::unordered_set<tile::Id, tile::Id::Hasher> drawn;
+    for (const auto& tile_id : tile_set) {
+        for (auto id = tile_id; id.zoom_level > 0;) {
+            id = id.parent();
+            if (!drawn.insert(id).second)
+                break;
+        }
+    }
+    std::vector<tile::Id> hidden;
+    for (const auto& id : drawn) {
+        if (seen.contains(id))
+            continue;
+        // only the roots of hidden sub trees, all quads below them are hidden as well
+        if (id.zoom_level > 0 && drawn.contains(id.parent()) && !seen.contains(id.parent()))
+            continue;
+        hidden.push_back(id);
+    }
+    std::sort(hidden.begin(), hidden.end(), nucleus::tile_scheduler::TileIdSet::Less {});
+    if (hidden != m_reported_hidden_quads) {
+        m_reported_hidden_quads = std::move(hidden);
+        emit hidden_quads_changed(m_reported_hidden_quads);
+    }
+}
+
+void Window::set_visibility_feedback(bool enabled)
+{
+    m_visibility_feedback = enabled;
+    m_visibility_readback_version = 0;
+    if (!enabled && !m_reported_hidden_quads.empty()) {
+        m_reported_hidden_quads.clear();
+        emit hidden_quads_changed(m_reported_hidden_quads);
+    }
+}
+
+void Window::set_gpu_culling(bool enabled)
+{
+    m_gpu_culling = enabled; // the tile manager follows in paint, with the context current
+    m_draw_pass_frusta.clear();
+    m_draw_passes.clear(); // forces culling
+    emit update_requested();
+}
+
+void Window::set_min_tile_contribution(float min_size)
+{
+    m_tile_manager->set_min_tile_contribution(min_size);
+    emit update_requested();
+}
+
+void Window::set_occlusion_culling(bool enabled)
+{
+    m_occlusion_culling = enabled;
+    m_depth_pyramid.clear();
+    m_draw_pass_frusta.clear();
+    m_draw_passes.clear(); // forces culling
+    if (!enabled && !m_reported_occluded_tiles.empty()) {
+        m_reported_occluded_tiles.clear();
+        emit occluded_tiles_changed(m_reported_occluded_tiles);
+    }
+    emit update_requested();
 }
 
 float Window::depth(const glm::dvec2& normalised_device_coordinates)
 {
-    const auto read_float = nucleus::utils::bit_coding::to_f16f16(m_gbuffer->read_colour_attachment_pixel<glm::u8vec4>(3, normalised_device_coordinates))[0];
+    // the asynchronous readback returns the depth of a previous frame, but doesn't stall the pipeline
+    const auto encoded = [&]() {
+        if (m_depth_readback) {
+            if (const auto pixel = m_depth_readback->pixel(normalised_device_coordinates))
+                return *pixel;
+        }
+        return m_gbuffer->read_colour_attachment_pixel<glm::u8vec4>(3, normalised_device_coordinates);
+    }();
+    const auto read_float = nucleus::utils::bit_coding::to_f16f16(encoded)[0];
     const auto depth = std::exp(read_float * 13.f);
     return depth;
 }
@@ -465,22 +1176,89 @@ void Window::deinit_gpu()
     m_tile_manager.reset();
     m_debug_painter.reset();
     m_shader_manager.reset();
+    m_depth_readback.reset();
     m_gbuffer.reset();
+    m_ssao.reset();
+    m_temporal_upsampling.reset();
+    m_viewshed.reset();
+    m_far_field.reset();
+    m_vector_overlay.reset();
+    m_render_targets.reset();
     m_screen_quad_geometry = {};
+    if (m_upscale_sampler) {
+        QOpenGLContext::currentContext()->extraFunctions()->glDeleteSamplers(1, &m_upscale_sampler);
+        m_upscale_sampler = 0;
+    }
 }
 
+nucleus::timing::MeasurementSnapshotPtr Window::measurement_snapshot() const { return m_measurement_snapshot; }
+
 void Window::set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbDecoratorPtr& new_aabb_decorator)
 {
     assert(m_tile_manager);
     m_tile_manager->set_aabb_decorator(new_aabb_decorator);
 }
 
+void Window::set_upload_thread_policy(const nucleus::utils::ThreadPolicy& policy)
+{
+    assert(m_tile_manager);
+    m_tile_manager->set_upload_thread_policy(policy);
+}
+
+void Window::set_latency_tracer(const std::shared_ptr<nucleus::tile_scheduler::LatencyTracer>& tracer)
+{
+    assert(m_tile_manager);
+    m_tile_manager->set_latency_tracer(tracer);
+}
+
+void Window::set_spike_capture(const std::optional<nucleus::timing::SpikeDetector::Settings>& settings)
+{
+    if (!settings) {
+        m_spike_detector.reset();
+        return;
+    }
+    if (m_spike_detector && m_spike_detector->settings() == *settings)
+        return;
+    m_spike_detector.emplace(*settings);
+}
+
+void Window::set_metrics(const std::shared_ptr<nucleus::utils::MetricsRegistry>& metrics)
+{
+    using Type = nucleus::utils::MetricsRegistry::Type;
+    m_metrics = metrics;
+    if (!m_metrics)
+        return;
+    m_metrics->describe("alp_frame_seconds", Type::Summary, "frame time, the slower of cpu and gpu");
+    m_metrics->describe("alp_timer_seconds", Type::Summary, "cpu and gpu timers of the frame, per pass");
+    m_metrics->describe("alp_gl_draw_calls", Type::Counter, "gl draw calls");
+    m_metrics->describe("alp_gl_state_changes", Type::Counter, "gl state changes that were not skipped by the state cache");
+    m_metrics->describe("alp_gl_upload_bytes", Type::Counter, "texture and buffer uploads");
+    m_metrics->describe("alp_gpu_memory_bytes", Type::Gauge, "gpu memory allocated by the renderer, per subsystem");
+    m_reported_gpu_memory_version = 0; // the memory gauges are set with the next frame
+}
+
+void Window::export_metrics(const std::vector<nucleus::timing::TimerReport>& reports, float frame_msecs)
+{
+    if (frame_msecs > 0)
+        m_metrics->observe("alp_frame_seconds", frame_msecs / 1000.0);
+    for (const auto& report : reports) {
+        const auto& timer = m_timer->timers()[report.index];
+        m_metrics->observe("alp_timer_seconds", report.value / 1000.0, { { "timer", timer->get_name() }, { "group", timer->get_group() } });
+    }
+    const auto counts = GlCounters::current().total();
+    m_metrics->add("alp_gl_draw_calls", double(counts.draw_calls));
+    m_metrics->add("alp_gl_state_changes", double(counts.state_changes));
+    m_metrics->add("alp_gl_upload_bytes", double(counts.texture_bytes + counts.buffer_bytes));
+}
+
 void Window::remove_tile(const tile::Id& id)
 {
     assert(m_tile_manager);
-    m_tile_manager->remove_tile(id);
+    m_tile_manager->remove_quad(id.parent()); // tiles share a texture slot with their siblings, they go as a quad
 }
 
 nucleus::camera::AbstractDepthTester* Window::depth_tester() { return this; }
 
 nucleus::utils::ColourTexture::Format Window::ortho_tile_compression_algorithm() const { return Texture::compression_algorithm(); }
+
+unsigned Window::ortho_tile_mip_levels() const { return TileManager::ortho_mip_levels(m_tile_manager->tile_format().ortho_size); }
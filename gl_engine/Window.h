@@ -29,16 +29,32 @@
 #include <QMap>
 #include <glm/glm.hpp>
 #include <memory>
+#include <optional>
+#include <vector>
 
+#include "GpuMemory.h"
+#include "ShaderProgram.h"
 #include "UniformBuffer.h"
 #include "UniformBufferObjects.h"
+#include "FarField.h"
+#include "VectorOverlay.h"
+#include "Viewshed.h"
 #include "helpers.h"
 #include "nucleus/AbstractRenderWindow.h"
 #include "nucleus/camera/AbstractDepthTester.h"
 #include "nucleus/camera/Definition.h"
+#include "nucleus/tile_scheduler/DepthPyramid.h"
+#include "nucleus/tile_scheduler/DrawListGenerator.h"
+#include "nucleus/tile_scheduler/ScreenSpaceErrorController.h"
 
+#include "nucleus/timing/MeasurementSnapshot.h"
+#include "nucleus/timing/SpikeDetector.h"
 #include "nucleus/timing/TimerManager.h"
+#include "nucleus/utils/RenderScaleController.h"
+#include "nucleus/utils/atmosphere_lut.h"
 
+class QOffscreenSurface;
+class QTimer;
 class QOpenGLTexture;
 class QOpenGLShaderProgram;
 class QOpenGLBuffer;
@@ -52,55 +68,192 @@ class DebugPainter;
 class ShaderManager;
 class Framebuffer;
 class SSAO;
+class TemporalUpsampling;
 class ShadowMapping;
+class DepthReadback;
+class RenderTargetPool;
+class Texture;
 
 class Window : public nucleus::AbstractRenderWindow, public nucleus::camera::AbstractDepthTester {
     Q_OBJECT
 public:
+    // quality reductions while the camera moves. a full quality frame is rendered once the camera was idle for idle_msecs.
+    struct MotionQualitySettings {
+        bool enabled = true;
+        unsigned idle_msecs = 250;
+        unsigned ssao_kernel = 8; // upper bound for the ssao kernel size
+        unsigned ssao_resolution = 1; // lower bound for the ssao resolution level (see uboSharedConfig::m_ssao_resolution)
+        unsigned label_update_interval = 4; // labels are culled and decluttered every n-th frame only
+        bool operator==(const MotionQualitySettings&) const = default;
+    };
+
     Window();
     ~Window() override;
 
     void initialise_gpu() override;
     void resize_framebuffer(int w, int h) override;
     void paint(QOpenGLFramebufferObject* framebuffer = nullptr) override;
+    // another view of the same gpu tiles (see nucleus::Controller::add_view), with the pipeline of the main view. the state that
+    // depends on the previous frame (temporal history, occlusion culling, depth readback, frame time feedback) is kept for the
+    // main view. views of another size than the main framebuffer resize the internal targets twice per frame.
+    void paint_view(const nucleus::camera::Definition& camera, QOpenGLFramebufferObject* framebuffer);
 
     [[nodiscard]] float depth(const glm::dvec2& normalised_device_coordinates) override;
     [[nodiscard]] glm::dvec3 position(const glm::dvec2& normalised_device_coordinates) override;
     void deinit_gpu() override;
     void set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbDecoratorPtr&) override;
+    void set_latency_tracer(const std::shared_ptr<nucleus::tile_scheduler::LatencyTracer>& tracer) override;
+    void set_metrics(const std::shared_ptr<nucleus::utils::MetricsRegistry>& metrics) override;
+    void set_upload_thread_policy(const nucleus::utils::ThreadPolicy& policy) override;
     void remove_tile(const tile::Id&) override;
     [[nodiscard]] nucleus::camera::AbstractDepthTester* depth_tester() override;
     [[nodiscard]] nucleus::utils::ColourTexture::Format ortho_tile_compression_algorithm() const override;
+    [[nodiscard]] unsigned ortho_tile_mip_levels() const override;
+    void set_gpu_quad_mailbox(const std::shared_ptr<nucleus::tile_scheduler::tile_types::GpuQuadMailbox>& mailbox) override;
     void keyPressEvent(QKeyEvent*);
     void keyReleaseEvent(QKeyEvent*);
     void updateCameraEvent();
+    // the base error (render quality). with the adaptive controller enabled, the actual error moves around it within the
+    // controller's bounds, see permissible_screen_space_error_changed.
     void set_permissible_screen_space_error(float new_error) override;
+    // target frame time and gpu quad count for the adaptive screen space error. disabled by default.
+    void set_screen_space_error_controller_settings(const nucleus::tile_scheduler::ScreenSpaceErrorController::Settings& settings);
     void set_quad_limit(unsigned new_limit) override;
+    void set_tile_format(const nucleus::tile_scheduler::tile_types::TileFormat& new_format) override;
+    // shadow map resolution, number of cascades and depth format. can be changed at any time.
+    void set_shadow_settings(const ShadowMapping::Settings& settings);
+    // tints the terrain that can (green) or can't (red) be seen from the observer (see Viewshed), nullopt turns it off.
+    void set_viewshed(const std::optional<Viewshed::Observer>& observer);
+    // the gbuffer pass draws the terrain up to settings.distance, the rest comes from a cached panorama (see FarField). nullopt
+    // (the default) draws all tiles in the gbuffer pass.
+    void set_far_field(const std::optional<FarField::Settings>& settings);
+    // tracks and areas draped onto the terrain (see VectorOverlay), nullptr turns it off
+    void set_vector_overlay(VectorOverlay::DataPtr data);
+    void set_vector_overlay_settings(const VectorOverlay::Settings& settings);
+    // skips tiles that were hidden behind terrain in a previous frame (needs DepthReadback, i.e., not on WebGL). on by default.
+    void set_occlusion_culling(bool enabled);
+    // frustum culling of the gbuffer and shadow passes on the gpu (see GpuTileCuller), with the result of a previous frame. the
+    // render thread then only looks up a mask per tile. needs DepthReadback's asynchronous readback, i.e., not on WebGL. off by default.
+    void set_gpu_culling(bool enabled);
+    // tiles whose children would project to fewer pixels are not refined, the parent is drawn instead (contribution culling,
+    // see DrawListGenerator::set_min_tile_contribution). 4 pixels by default, 0 turns it off.
+    void set_min_tile_contribution(float min_size);
+    // the gbuffer pass writes the texture layer of each pixel next to the encoded depth (DepthReadback). for static views, the
+    // quads without a visible pixel are reported (hidden_quads_changed), the scheduler evicts and requests them last. on by default.
+    void set_visibility_feedback(bool enabled);
+    // the far shadow cascades keep their cached maps while moving, in addition to the ssao and label reductions
+    void set_motion_quality_settings(const MotionQualitySettings& settings);
+    // resolution of the gbuffer, ssao and compose relative to the framebuffer, optionally driven by the gpu frame time. the
+    // composed image is upscaled (bilinear and contrast adaptive sharpening) into the framebuffer, labels are drawn at full size.
+    void set_render_scale_settings(const nucleus::utils::RenderScaleController::Settings& settings);
+    [[nodiscard]] glm::uvec2 internal_size() const;
+    // renders with a jittered projection and reconstructs the output from the history of previous frames (see TemporalUpsampling),
+    // also at the full render scale. off by default.
+    void set_temporal_upsampling(bool enabled);
+    // frames that take much longer than the recent ones are reported with frame_spike_captured, once the frames after them
+    // are recorded too (see nucleus::timing::SpikeDetector). nullopt disables it. the trace recorder must be enabled for the
+    // window to have content.
+    void set_spike_capture(const std::optional<nucleus::timing::SpikeDetector::Settings>& settings);
+    // moves the tile uploads to a thread with a shared context, see TileManager::enable_background_uploads. after initialise_gpu.
+    bool enable_background_uploads(std::shared_ptr<QOffscreenSurface> surface);
+    // gpu memory of our own allocations per subsystem (see gpu_memory::usage)
+    [[nodiscard]] std::vector<gpu_memory::SubsystemUsage> gpu_memory_usage() const;
+    // one line per subsystem, the total and the driver's view if available (with the context current)
+    [[nodiscard]] QString gpu_memory_report() const;
+    // the timer measurements for the debug gui, which polls and enables it while visible
+    [[nodiscard]] nucleus::timing::MeasurementSnapshotPtr measurement_snapshot() const;
 
 public slots:
     void update_camera(const nucleus::camera::Definition& new_definition) override;
     void update_debug_scheduler_stats(const QString& stats) override;
-    void update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads) override;
+    void update_gpu_quads(const nucleus::tile_scheduler::tile_types::GpuTileQuadBatch& new_quads, const std::vector<tile::Id>& deleted_quads) override;
     void key_press(const QKeyCombination& e); // Slot to connect key-events to
     void shared_config_changed(gl_engine::uboSharedConfig ubo);
     void render_looped_changed(bool render_looped_flag);
     void reload_shader();
 
 signals:
-    void report_measurements(QList<nucleus::timing::TimerReport> values);
+    // sent after a frame in which the gpu memory accounting changed, see gpu_memory_report
+    void gpu_memory_report_changed(const QString& report);
+    void frame_spike_captured(const nucleus::timing::SpikeDetector::Capture& capture);
 
 private:
+    // rebuilds m_depth_pyramid if the readback has new data. returns true if it changed.
+    bool update_depth_pyramid();
+    // evaluates the visibility feedback of the readback if it was rendered with the current draw list (tile_set)
+    void update_visibility_feedback(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tile_set);
+    // uploads the camera (with the projection shifted by jitter, in ndc) if it changed since the last upload
+    void update_camera_ubo(const glm::dvec2& jitter);
+    // clears the gbuffer and draws the tiles of the range into it
+    void draw_gbuffer(const TileManager::DrawRange& range);
+    // resizes the targets that are rendered at internal_size()
+    void resize_internal_targets();
+    // forwards the error of m_error_controller to the draw list generator and the scheduler, if it changed
+    void apply_permissible_screen_space_error();
+    // rebuilds m_atmosphere_lut if the parameters changed (the model has the sun at the zenith, so it doesn't depend on the sun)
+    void update_atmosphere_lut(const nucleus::utils::atmosphere_lut::Parameters& parameters);
+    // uploads the quads that the scheduler sent since the last frame
+    void drain_gpu_quad_mailbox();
+    // frame time, timers, gl command counts and gpu memory of the frame, if a metrics registry is set
+    void export_metrics(const std::vector<nucleus::timing::TimerReport>& reports, float frame_msecs);
+
     std::unique_ptr<TileManager> m_tile_manager; // needs opengl context
+    std::shared_ptr<nucleus::tile_scheduler::tile_types::GpuQuadMailbox> m_gpu_quad_mailbox;
     std::unique_ptr<DebugPainter> m_debug_painter; // needs opengl context
     std::unique_ptr<ShaderManager> m_shader_manager;
     std::unique_ptr<MapLabelManager> m_map_label_manager;
 
     std::unique_ptr<Framebuffer> m_gbuffer;
-    std::unique_ptr<Framebuffer> m_decoration_buffer;
+    std::unique_ptr<DepthReadback> m_depth_readback; // nullptr on WebGL, there depth() reads synchronously
     std::unique_ptr<Framebuffer> m_atmospherebuffer;
+    std::unique_ptr<Texture> m_atmosphere_lut; // in-scattering for compose
+    std::optional<nucleus::utils::atmosphere_lut::Parameters> m_atmosphere_lut_parameters;
+    std::unique_ptr<RenderTargetPool> m_render_targets; // transient targets, e.g. ssao
+    glm::uvec2 m_framebuffer_size = { 4, 4 }; // output size, see resize_framebuffer
+    nucleus::utils::RenderScaleController m_render_scale_controller;
+    float m_render_scale_sharpness = 0.5f;
+    struct {
+        ShaderProgram::Uniform<int> viewshed_enabled; // of the compose program, set by Viewshed::bind if there is an observer
+        ShaderProgram::Uniform<int> far_field_enabled; // of the compose program, set by FarField::bind if it is on
+        ShaderProgram::Uniform<int> vector_overlay_enabled; // of the compose program, set by VectorOverlay::bind if there is data
+        ShaderProgram::Uniform<float> sharpness; // of the upscale program
+    } m_uniforms;
+    unsigned m_upscale_sampler = 0; // bilinear, the framebuffer textures are nearest
+    std::unique_ptr<TemporalUpsampling> m_temporal_upsampling;
+    bool m_temporal_upsampling_enabled = false;
 
     std::unique_ptr<SSAO> m_ssao;
     std::unique_ptr<ShadowMapping> m_shadowmapping;
+    ShadowMapping::Settings m_shadow_settings = ShadowMapping::default_settings();
+    std::unique_ptr<Viewshed> m_viewshed;
+    std::optional<Viewshed::Observer> m_viewshed_observer;
+    std::unique_ptr<FarField> m_far_field;
+    std::optional<FarField::Settings> m_far_field_settings;
+    std::unique_ptr<VectorOverlay> m_vector_overlay;
+    VectorOverlay::DataPtr m_vector_overlay_data;
+    VectorOverlay::Settings m_vector_overlay_settings;
+    std::vector<nucleus::tile_scheduler::DrawListGenerator::TileSet> m_draw_passes; // gbuffer + shadow cascades (+ their union) + viewshed + far field, reused every frame
+    std::vector<tile::Id> m_shadow_union_scratch;
+    std::vector<nucleus::camera::Frustum> m_draw_pass_frusta; // the passes were culled with
+    uint64_t m_draw_passes_version = 0; // TileManager::draw_list_version the passes were culled from
+    bool m_occlusion_culling = true;
+    bool m_gpu_culling = false;
+    uint64_t m_gpu_culling_version = 0; // TileManager::gpu_culling_version the passes were culled with
+    bool m_painting_view = false; // within paint_view
+    // frames that only change the lighting (see shared_config_changed) reuse the gbuffer and the atmosphere background of the
+    // last frame, if it was drawn with the same camera and tiles. nullopt if they can't be reused.
+    bool m_lighting_only_change = false;
+    std::optional<nucleus::camera::Definition> m_gbuffer_camera;
+    uint64_t m_gbuffer_resident_version = 0; // TileManager::resident_version
+    nucleus::tile_scheduler::DepthPyramid m_depth_pyramid; // of a previous frame (DepthReadback)
+    std::vector<float> m_depth_pyramid_distances;
+    uint64_t m_depth_pyramid_readback_version = 0;
+    uint64_t m_depth_pyramid_draw_list_version = 0;
+    std::vector<tile::Id> m_occluded_tiles;
+    std::vector<tile::Id> m_reported_occluded_tiles;
+    bool m_visibility_feedback = true;
+    uint64_t m_visibility_readback_version = 0;
+    std::vector<tile::Id> m_reported_hidden_quads;
 
     std::shared_ptr<UniformBuffer<uboSharedConfig>> m_shared_config_ubo; // needs opengl context
     std::shared_ptr<UniformBuffer<uboCameraConfig>> m_camera_config_ubo;
@@ -109,6 +262,8 @@ private:
     helpers::ScreenQuadGeometry m_screen_quad_geometry;
 
     nucleus::camera::Definition m_camera;
+    std::optional<nucleus::camera::Definition> m_ubo_camera; // the camera uniform buffer was computed for
+    glm::dvec2 m_ubo_jitter = {};
 
     int m_frame = 0;
     bool m_initialised = false;
@@ -116,9 +271,22 @@ private:
     bool m_wireframe_enabled = false;
     QString m_debug_text;
     QString m_debug_scheduler_stats;
+    uint64_t m_reported_gpu_memory_version = 0;
+    nucleus::tile_scheduler::ScreenSpaceErrorController m_error_controller;
+    float m_applied_permissible_screen_space_error = 0; // 0 before the first set_permissible_screen_space_error
 
-    std::unique_ptr<nucleus::timing::TimerManager> m_timer;
+    MotionQualitySettings m_motion_quality_settings;
+    QTimer* m_motion_idle_timer = nullptr; // runs while the camera moves, requests the full quality frame on timeout
 
+    std::unique_ptr<nucleus::timing::TimerManager> m_timer;
+    nucleus::timing::MeasurementSnapshotPtr m_measurement_snapshot = std::make_shared<nucleus::timing::MeasurementSnapshot>();
+    // resolved once in initialise_gpu, paint doesn't look up the timers by name
+    struct FrameTimers {
+        nucleus::timing::TimerHandle cpu_total, gpu_total, cpu_b2b;
+        nucleus::timing::TimerHandle atmosphere, draw_list, shadowmap, tiles, ssao, compose, upscale, labels;
+    } m_timers;
+    std::shared_ptr<nucleus::utils::MetricsRegistry> m_metrics; // optional, see set_metrics
+    std::optional<nucleus::timing::SpikeDetector> m_spike_detector;
 };
 
 } // namespace
@@ -28,6 +28,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "GlCounters.h"
+#include "GlState.h"
+
 namespace gl_engine::helpers {
 inline QMatrix4x4 toQtType(const glm::mat4& mat)
 {
@@ -65,15 +68,17 @@ struct ScreenQuadGeometry {
     inline void draw() const {
         QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
         vao->bind();
-        f->glDisable(GL_DEPTH_TEST);
+        gl_engine::GlState::current().set_enabled(GL_DEPTH_TEST, false);
         f->glDrawElements(GL_TRIANGLE_STRIP, 3, GL_UNSIGNED_SHORT, nullptr);
+        gl_engine::GlCounters::current().count_draw(3);
         vao->release();
     }
     inline void draw_with_depth_test() const {
         QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
         vao->bind();
-        f->glEnable(GL_DEPTH_TEST);
+        gl_engine::GlState::current().set_enabled(GL_DEPTH_TEST, true);
         f->glDrawElements(GL_TRIANGLE_STRIP, 3, GL_UNSIGNED_SHORT, nullptr);
+        gl_engine::GlCounters::current().count_draw(3);
         vao->release();
     }
 };
@@ -101,3 +101,25 @@ highp vec3 calculate_atmospheric_light(highp vec3 ray_origin, highp vec3 ray_dir
 }
 
 
+// precomputed in-scattering (see nucleus/utils/atmosphere_lut.h): a layer per camera height, distance along x and direction along y
+const highp float atmosphere_lut_max_distance = 1000.0;
+
+highp vec3 sample_in_scattering_lut(highp sampler2DArray lut, highp float height, highp float direction_z, highp float distance) {
+    highp vec3 size = vec3(textureSize(lut, 0));
+    highp vec2 uv = vec2(sqrt(clamp(distance / atmosphere_lut_max_distance, 0.0, 1.0)), 0.5 + 0.5 * sign(direction_z) * sqrt(abs(direction_z)));
+    uv = (uv * (size.xy - 1.0) + 0.5) / size.xy;
+    highp float layer = sqrt(clamp(height / atmosphere_height, 0.0, 1.0)) * (size.z - 1.0);
+    highp float layer_0 = min(floor(layer), size.z - 2.0);
+    highp vec3 lower = texture(lut, vec3(uv, layer_0)).rgb;
+    highp vec3 upper = texture(lut, vec3(uv, layer_0 + 1.0)).rgb;
+    return mix(lower, upper, layer - layer_0);
+}
+
+// same as calculate_atmospheric_light, but the in-scattering is looked up instead of integrated
+highp vec3 calculate_atmospheric_light_lut(highp sampler2DArray lut, highp vec3 ray_origin, highp vec3 ray_direction, highp float ray_length, highp vec3 original_colour) {
+    highp vec3 in_scattered_light = sample_in_scattering_lut(lut, ray_origin.z, ray_direction.z, ray_length);
+    highp float view_ray_optical_depth = an_optical_depth(ray_origin.z, ray_direction.z, ray_length);
+    highp vec3 transmittance = exp(-(view_ray_optical_depth) * scattering_coefficients());
+
+    return in_scattered_light + transmittance * original_colour;
+}
@@ -25,6 +25,7 @@ highp float calculate_falloff(highp float dist, highp float from, highp float to
 #include "shared_config.glsl"
 #include "shadow_config.glsl"
 #include "camera_config.glsl"
+#include "gbuffer.glsl"
 #include "hashing.glsl"
 #include "overlay_steepness.glsl"
 #include "snow.glsl"
@@ -35,16 +36,43 @@ in highp vec2 texcoords;
 
 
 uniform sampler2D texin_albedo;             // 8vec3
-uniform highp sampler2D texin_position;     // f32vec4
+uniform highp sampler2D texin_position;     // f32vec4 or f32 (see gbuffer.glsl)
 uniform highp usampler2D texin_normal;      // u16vec2
 
 uniform sampler2D texin_atmosphere;         // 8vec3
+uniform highp sampler2DArray texin_atmosphere_lut; // f16vec4, in-scattering (see atmosphere_implementation.glsl)
 uniform sampler2D texin_ssao;               // 8vec1
 
-uniform highp sampler2D texin_csm1;         // f32vec1
-uniform highp sampler2D texin_csm2;         // f32vec1
-uniform highp sampler2D texin_csm3;         // f32vec1
-uniform highp sampler2D texin_csm4;         // f32vec1
+uniform highp sampler2DShadow texin_csm;    // f32vec1, all cascades in one atlas (see shadow.atlas_rect)
+uniform highp sampler2D texin_csm_depth;    // same texture without comparison (debug overlay)
+uniform highp sampler2D texin_depth;        // gbuffer depth, copied into the target for the label depth test
+
+// viewshed analysis (see Viewshed.h): cube of depth maps around the observer, 3x2 faces in one atlas
+uniform lowp int viewshed_enabled;
+uniform highp sampler2D texin_viewshed;     // f32vec1
+uniform highp mat4 viewshed_view_proj[6];   // camera local to the clip space of the faces (+x, -x, +y, -y, +z, -z)
+uniform highp vec3 viewshed_observer;       // camera local
+uniform highp float viewshed_range;
+uniform highp float viewshed_near;
+uniform highp float viewshed_texel_angle;   // of the depth maps, in radians
+
+// far field impostor (see FarField.h): the terrain beyond the near field, in a cube around far_field_centre, 3x2 faces in one atlas
+uniform lowp int far_field_enabled;
+uniform sampler2D texin_far_field_albedo;       // 8vec4, alpha 0 where there is no terrain
+uniform highp usampler2D texin_far_field_normal; // u16vec2
+uniform highp sampler2D texin_far_field_depth;  // f32vec1
+uniform highp mat4 far_field_view_proj[6];      // camera local to the clip space of the faces (+x, -x, +y, -y, +z, -z)
+uniform highp vec3 far_field_centre;            // camera local
+uniform highp float far_field_distance;         // where the near field ends
+uniform highp float far_field_near;
+uniform highp float far_field_far;
+
+// draped vector overlay (see VectorOverlay.h): tracks and areas rasterised top down into nested levels around the camera, 3x2 in one atlas
+uniform lowp int vector_overlay_enabled;
+uniform sampler2D texin_vector_overlay;         // 8vec4, premultiplied alpha, linear filtering
+uniform highp vec4 vector_overlay_windows[6];   // camera local xy of the lower left corner and extent, the extent is 0 if not drawn
+uniform highp float vector_overlay_resolution;  // texels per level
+uniform highp float vector_overlay_pixel_angle; // of a screen pixel, in radians
 
 
 // Calculates the diffuse and specular illumination contribution for the given
@@ -79,16 +107,76 @@ highp vec3 calculate_illumination(highp vec3 albedo, highp vec3 eyePos, highp ve
     return ambientIllumination + diffAndSpecIllumination * (1.0 - shadow_term);
 }
 
-// Because of limited support I didn't use texture arrays, therefore
-// we need this selector function to sample from a specified shadowmap level
-highp float sample_shadow_texture(lowp int layer, highp vec2 texcoords) {
-    switch (layer) {
-        case 0: return texture(texin_csm1, texcoords).r;
-        case 1: return texture(texin_csm2, texcoords).r;
-        case 2: return texture(texin_csm3, texcoords).r;
-        case 3: return texture(texin_csm4, texcoords).r;
-        default: return 0.0;
+// 1 if the point can be seen from the viewshed observer, 0 if terrain is in between, -1 if it's out of range
+highp float viewshed_visibility(highp vec3 pos_cws, highp vec3 normal) {
+    highp vec3 to_point = pos_cws - viewshed_observer;
+    highp float distance = length(to_point);
+    if (distance > viewshed_range || distance < viewshed_near)
+        return -1.0;
+    highp vec3 a = abs(to_point);
+    lowp int face = 4 + int(to_point.z < 0.0);
+    if (a.x >= a.y && a.x >= a.z)
+        face = int(to_point.x < 0.0);
+    else if (a.y >= a.z)
+        face = 2 + int(to_point.y < 0.0);
+    // the surface is pushed towards its normal by about a texel footprint, otherwise it hides itself at grazing angles
+    highp vec3 offset_point = pos_cws + normal * distance * viewshed_texel_angle * 1.5;
+    highp vec4 clip = viewshed_view_proj[face] * vec4(offset_point, 1.0);
+    highp vec3 ndc = clip.xyz / clip.w;
+    highp vec2 uv = (clamp(ndc.xy * 0.5 + 0.5, 0.0, 1.0) + vec2(float(face % 3), float(face / 3))) / vec2(3.0, 2.0);
+    highp float depth_map = texture(texin_viewshed, uv).r * 2.0 - 1.0;
+    // both depths as distances along the view axis of the face, the perspective depth is far from linear
+    highp float n = viewshed_near;
+    highp float f = viewshed_range;
+    highp float occluder = 2.0 * n * f / (f + n - depth_map * (f - n));
+    highp float receiver = 2.0 * n * f / (f + n - ndc.z * (f - n));
+    return receiver <= occluder * 1.002 ? 1.0 : 0.0;
+}
+
+// the far field terrain in the direction of the (normalised, camera local) ray. false if there is none, i.e., sky.
+bool far_field_surface(highp vec3 ray, out highp vec3 pos_cws, out lowp vec3 albedo, out highp vec3 normal) {
+    // looked up from the centre towards the point where the ray leaves the near field, that hides most of the parallax
+    highp vec3 point = ray * far_field_distance;
+    highp vec3 to_point = point - far_field_centre;
+    highp vec3 a = abs(to_point);
+    lowp int face = 4 + int(to_point.z < 0.0);
+    if (a.x >= a.y && a.x >= a.z)
+        face = int(to_point.x < 0.0);
+    else if (a.y >= a.z)
+        face = 2 + int(to_point.y < 0.0);
+    highp vec4 clip = far_field_view_proj[face] * vec4(point, 1.0);
+    highp vec2 uv = (clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 1.0) + vec2(float(face % 3), float(face / 3))) / vec2(3.0, 2.0);
+    highp vec4 albedo_coverage = texture(texin_far_field_albedo, uv);
+    if (albedo_coverage.a < 0.5)
+        return false;
+    // the depth is the distance along the view axis of the face, i.e., along the major axis of to_point
+    highp float depth = texture(texin_far_field_depth, uv).r * 2.0 - 1.0;
+    highp float n = far_field_near;
+    highp float f = far_field_far;
+    highp float axial = 2.0 * n * f / (f + n - depth * (f - n));
+    pos_cws = far_field_centre + to_point / max(a.x, max(a.y, a.z)) * axial;
+    albedo = albedo_coverage.rgb;
+    normal = octNormalDecode2u16(texture(texin_far_field_normal, uv).xy);
+    return true;
+}
+
+// the overlay colour at the point (premultiplied). the levels are nested, the finest one that contains the point and whose
+// texels are not much smaller than a pixel is sampled, so that the tracks keep about their width on screen.
+lowp vec4 vector_overlay_colour(highp vec3 pos_cws, highp float dist) {
+    highp float footprint = dist * vector_overlay_pixel_angle;
+    for (lowp int level = 0; level < 6; level++) {
+        highp vec4 window = vector_overlay_windows[level];
+        if (window.z <= 0.0 || (window.z / vector_overlay_resolution < 0.5 * footprint && level < 5))
+            continue;
+        highp vec2 uv = (pos_cws.xy - window.xy) / window.z;
+        if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+            continue;
+        // clamped to the level, so that the bilinear footprint never reaches into a neighbouring one
+        highp float half_texel = 0.5 / vector_overlay_resolution;
+        uv = clamp(uv, vec2(half_texel), vec2(1.0 - half_texel));
+        return texture(texin_vector_overlay, (uv + vec2(float(level % 3), float(level / 3))) / vec2(3.0, 2.0));
     }
+    return vec4(0.0);
 }
 
 highp float csm_shadow_term(highp vec4 pos_cws, highp vec3 normal_ws, out lowp int layer) {
@@ -97,15 +185,16 @@ highp float csm_shadow_term(highp vec4 pos_cws, highp vec3 normal_ws, out lowp i
     highp float depth_cam = abs(pos_vs.z);
 
     layer = -1;
-    for (lowp int i = 0; i < SHADOW_CASCADES; i++) {
+    lowp int n_cascades = int(shadow.cascade_count);
+    for (lowp int i = 0; i < n_cascades; i++) {
         if (depth_cam < shadow.cascade_planes[i + 1]) {
             layer = i;
             break;
         }
     }
 
-    highp float depth_fallof_from = shadow.cascade_planes[SHADOW_CASCADES - 1] + (shadow.cascade_planes[SHADOW_CASCADES - 0] - shadow.cascade_planes[SHADOW_CASCADES - 1]) / 2.0;
-    highp float depth_fallof_to = shadow.cascade_planes[SHADOW_CASCADES - 0];
+    highp float depth_fallof_from = shadow.cascade_planes[n_cascades - 1] + (shadow.cascade_planes[n_cascades - 0] - shadow.cascade_planes[n_cascades - 1]) / 2.0;
+    highp float depth_fallof_to = shadow.cascade_planes[n_cascades - 0];
     highp float alpha = calculate_falloff(depth_cam, depth_fallof_from, depth_fallof_to);
 
     highp vec4 pos_ls = shadow.light_space_view_proj_matrix[layer] * pos_cws;
@@ -132,34 +221,56 @@ highp float csm_shadow_term(highp vec4 pos_cws, highp vec3 normal_ws, out lowp i
     //biasModifier = 0.005;
     bias *= 1.0 / (shadow.cascade_planes[layer + 1] * biasModifier);
 
-    highp float term = 0.0;
-    highp vec2 texelSize = 1.0 / shadow.shadowmap_size;
-    for (int x = -1; x <= 1; ++x) {
-        for (int y = -1; y <= 1; ++y) {
-            highp float pcfDepth = sample_shadow_texture(layer, pos_ls_ndc.xy + vec2(x,y) * texelSize);
-            term += (depth_ls - bias) > pcfDepth ? 1.0 : 0.0;
-        }
-    }
-    term /= 9.0;
+    // each tap is filtered by the hardware (2x2 comparisons), 4 taps half a texel apart cover a 3x3 texel footprint.
+    // taps are clamped to the cascade, so the bilinear footprint never reaches into a neighbouring one.
+    highp vec4 rect = shadow.atlas_rect[layer];
+    highp vec2 texel_size = 1.0 / vec2(textureSize(texin_csm, 0));
+    highp vec2 uv_min = rect.xy + 0.5 * texel_size;
+    highp vec2 uv_max = rect.xy + rect.zw - 0.5 * texel_size;
+    highp vec2 uv = rect.xy + pos_ls_ndc.xy * rect.zw;
+    highp float lit = 0.0;
+    lit += texture(texin_csm, vec3(clamp(uv + vec2(-0.5, -0.5) * texel_size, uv_min, uv_max), depth_ls - bias));
+    lit += texture(texin_csm, vec3(clamp(uv + vec2( 0.5, -0.5) * texel_size, uv_min, uv_max), depth_ls - bias));
+    lit += texture(texin_csm, vec3(clamp(uv + vec2(-0.5,  0.5) * texel_size, uv_min, uv_max), depth_ls - bias));
+    lit += texture(texin_csm, vec3(clamp(uv + vec2( 0.5,  0.5) * texel_size, uv_min, uv_max), depth_ls - bias));
+    highp float term = 1.0 - lit / 4.0;
     return mix(term, 1.0, 1.0-alpha);
 }
 
 void main() {
-    lowp vec3 albedo = texture(texin_albedo, texcoords).rgb;
-
-    highp vec4 pos_dist = texture(texin_position, texcoords);
+    gl_FragDepth = texture(texin_depth, texcoords).r;
+    highp vec4 pos_dist = gbuffer_position_distance(texin_position, texcoords);
     highp vec3 pos_cws = pos_dist.xyz;
     highp float dist = pos_dist.w; // negative if sky
+
+    // beyond the near field, the terrain comes from the far field faces
+    bool far_field = false;
+    lowp vec3 far_field_albedo;
+    highp vec3 far_field_normal;
+    if (far_field_enabled != 0 && dist <= 0.0) {
+        far_field = far_field_surface(view_ray_direction_cws(texcoords), pos_cws, far_field_albedo, far_field_normal);
+        if (far_field)
+            dist = length(pos_cws);
+    }
+
+    // the sky is the atmosphere background only. return before the remaining gbuffer and ssao fetches, unless a debug
+    // overlay is drawn over the sky as well.
+    if (dist <= 0.0 && !FEATURE_OVERLAY_POSTSHADING_ENABLED && !FEATURE_OVERLAY_SHADOWMAPS_ENABLED) {
+        out_Color = vec4(texture(texin_atmosphere, texcoords).rgb, 1.0);
+        return;
+    }
+
+    lowp vec3 albedo = far_field ? far_field_albedo : texture(texin_albedo, texcoords).rgb;
     // Alpha-Value for Tile-Overlay (distant linear falloff)
     lowp float alpha = 0.0;
     if (dist > 0.0) alpha = calculate_falloff(dist, 300000.0, 600000.0);
 
-    highp vec3 normal = octNormalDecode2u16(texture(texin_normal, texcoords).xy);
+    highp vec3 normal = far_field ? far_field_normal : octNormalDecode2u16(texture(texin_normal, texcoords).xy);
 
     highp vec3 shaded_color = vec3(0.0f);
     highp float amb_occlusion = 1.0;
     // Gather ambient occlusion from ssao texture
-    if (bool(conf.ssao_enabled)) amb_occlusion = texture(texin_ssao, texcoords).r;
+    if (FEATURE_SSAO_ENABLED && !far_field) amb_occlusion = texture(texin_ssao, texcoords).r;
 
     lowp int sampled_shadow_layer = -1;
 
@@ -170,23 +281,27 @@ void main() {
         highp vec3 ray_direction = pos_cws / dist;
         highp vec4 material_light_response = conf.material_light_response;
 
-        highp vec3 light_through_atmosphere = calculate_atmospheric_light(origin / 1000.0, ray_direction, dist / 1000.0, albedo, 10);
-
         highp float shadow_term = 0.0;
-        if (bool(conf.csm_enabled)) {
+        if (FEATURE_CSM_ENABLED) {
             shadow_term = csm_shadow_term(vec4(pos_cws, 1.0), normal, sampled_shadow_layer);
         }
 
-        if (bool(conf.snow_settings_angle.x)) {
+        if (FEATURE_SNOW_ENABLED) {
             lowp vec4 overlay_color = overlay_snow(normal, pos_ws, dist);
             material_light_response.z += conf.snow_settings_alt.w * overlay_color.a;
             albedo = mix(albedo, overlay_color.rgb, overlay_color.a);
         }
 
+        // painted onto the terrain, i.e., shaded like the albedo
+        if (vector_overlay_enabled != 0) {
+            lowp vec4 overlay_color = vector_overlay_colour(pos_cws, dist);
+            albedo = albedo * (1.0 - overlay_color.a) + overlay_color.rgb;
+        }
+
         // NOTE: PRESHADING OVERLAY ONLY APPLIED ON TILES NOT ON BACKGROUND!!!
-        if (!bool(conf.overlay_postshading_enabled) && conf.overlay_mode >= 100u) {
+        if (!FEATURE_OVERLAY_POSTSHADING_ENABLED && FEATURE_OVERLAY_MODE >= 100u) {
             lowp vec4 overlay_color = vec4(0.0);
-            switch(conf.overlay_mode) {
+            switch(FEATURE_OVERLAY_MODE) {
                 case 100u: overlay_color = vec4(normal * 0.5 + 0.5, 1.0); break;
                 case 101u: overlay_color = overlay_steepness(normal, dist); break;
                 case 102u: overlay_color = vec4(vec3(amb_occlusion), 1.0); break;
@@ -197,10 +312,10 @@ void main() {
         }
 
         shaded_color = albedo;
-        if (bool(conf.phong_enabled)) {
+        if (FEATURE_PHONG_ENABLED) {
             shaded_color = calculate_illumination(shaded_color, origin, pos_ws, normal, conf.sun_light, conf.amb_light, conf.sun_light_dir.xyz, material_light_response, amb_occlusion, shadow_term);
         }
-        shaded_color = calculate_atmospheric_light(origin / 1000.0, ray_direction, dist / 1000.0, shaded_color, 10);
+        shaded_color = calculate_atmospheric_light_lut(texin_atmosphere_lut, origin / 1000.0, ray_direction, dist / 1000.0, shaded_color);
         shaded_color = max(vec3(0.0), shaded_color);
     }
 
@@ -208,9 +323,15 @@ void main() {
     lowp vec3 atmoshperic_color = texture(texin_atmosphere, texcoords).rgb;
     out_Color = vec4(mix(atmoshperic_color, shaded_color, alpha), 1.0);
 
-    if (bool(conf.overlay_postshading_enabled) && conf.overlay_mode >= 100u) {
+    if (viewshed_enabled != 0 && dist > 0.0) {
+        highp float visibility = viewshed_visibility(pos_cws, normal);
+        if (visibility >= 0.0)
+            out_Color.rgb = mix(out_Color.rgb, mix(vec3(0.85, 0.1, 0.1), vec3(0.1, 0.8, 0.2), visibility), 0.45);
+    }
+
+    if (FEATURE_OVERLAY_POSTSHADING_ENABLED && FEATURE_OVERLAY_MODE >= 100u) {
         lowp vec4 overlay_color = vec4(0.0);
-        switch(conf.overlay_mode) {
+        switch(FEATURE_OVERLAY_MODE) {
             case 100u: overlay_color = vec4(normal * 0.5 + 0.5, 1.0); break;
             case 101u: overlay_color = overlay_steepness(normal, dist); break;
             case 102u: overlay_color = vec4(vec3(amb_occlusion), 1.0); break;
@@ -221,14 +342,15 @@ void main() {
     }
 
     // OVERLAY SHADOW MAPS
-    if (bool(conf.overlay_shadowmaps_enabled)) {
-        highp float wsize = 1.0 / float(SHADOW_CASCADES);
+    if (FEATURE_OVERLAY_SHADOWMAPS_ENABLED) {
+        highp float wsize = 1.0 / float(shadow.cascade_count);
         highp float invwsize = 1.0/wsize;
         if (texcoords.x < wsize) {
-            for (int i = 0 ; i < SHADOW_CASCADES; i++)
+            for (int i = 0 ; i < int(shadow.cascade_count); i++)
             {
                 if (texcoords.y < wsize * float(i+1)) {
-                    highp float val = sample_shadow_texture(i, (texcoords - vec2(0.0, wsize*float(i))) * invwsize);
+                    highp vec4 rect = shadow.atlas_rect[i];
+                    highp float val = texture(texin_csm_depth, rect.xy + (texcoords - vec2(0.0, wsize*float(i))) * invwsize * rect.zw).r;
                     out_Color = vec4(val, val, val, 1.0);
                     break;
                 }
@@ -237,7 +359,7 @@ void main() {
     }
 
     // == HEIGHT LINES ==============
-    if (bool(conf.height_lines_enabled) && dist > 0.0) {
+    if (FEATURE_HEIGHT_LINES_ENABLED && dist > 0.0) {
         highp float alpha_line = 1.0 - min((dist / 20000.0), 1.0);
         highp float line_width = (2.0 + dist / 5000.0) * 5.0;
         // Calculate steepness based on fragment normal (this alone gives woobly results)
@@ -32,6 +32,10 @@ lowp vec2 depthWSEncode2n8(highp float depth) {
     mediump uint b = scaled & 255u;
     return vec2(float(r) / 255.f, float(b) / 255.f);
 }
+highp float depthWSDecode2n8(lowp vec2 encoded) {
+    mediump uint scaled = uint(encoded.x * 255.f + 0.5f) * 256u + uint(encoded.y * 255.f + 0.5f);
+    return exp(float(scaled) / 65535.f * 13.0);
+}
 
 // ===== OCTAHEDRON MAPPING FOR NORMALS =====
 // https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
@@ -51,3 +55,12 @@ highp vec3 octNormalDecode2u16(highp uvec2 octNormal16) {
     n.xy += ( n.x >= 0.0 && n.y >= 0.0) ? -t : t;
     return normalize( n );
 }
+// 8 bit per component, for unorm colour attachments (coarse, good enough for comparisons)
+lowp vec2 octNormalEncode2n8(highp vec3 normal) {
+    normal /= ( abs( normal.x ) + abs( normal.y ) + abs( normal.z ) );
+    if (normal.z < 0.0) normal.xy = octWrap( normal.xy );
+    return normal.xy * 0.5 + 0.5;
+}
+highp vec3 octNormalDecode2n8(lowp vec2 octNormal8) {
+    return octNormalDecode2u16(uvec2(octNormal8 * 65535.0));
+}
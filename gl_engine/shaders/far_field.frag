@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "shared_config.glsl"
+#include "camera_config.glsl"
+#include "encoder.glsl"
+
+// surface of the far terrain (see FarField.h), it is shaded in compose
+uniform lowp sampler2DArray ortho_sampler;
+uniform lowp sampler2DArray normal_sampler;
+uniform highp vec3 centre;          // of the faces, relative to the origin of the tiles
+uniform highp float near_distance;  // nearer terrain is drawn in the gbuffer pass
+
+layout (location = 0) out lowp vec4 texout_albedo; // alpha 0 where there is no terrain
+layout (location = 1) out highp uvec2 texout_normal;
+
+in highp vec2 uv;
+in highp vec3 var_pos_cws;
+flat in highp int v_texture_layer;
+flat in highp int v_quadrant_mask;
+
+void main() {
+    // see tile.frag
+    if (v_quadrant_mask != 15) {
+        highp int quadrant = int(uv.x >= 0.5) + 2 * int(uv.y < 0.5);
+        if ((v_quadrant_mask & (1 << quadrant)) == 0)
+            discard;
+    }
+    if (distance(var_pos_cws, centre) < near_distance)
+        discard;
+
+    highp float texture_layer_f = float(v_texture_layer);
+    lowp vec3 albedo = texture(ortho_sampler, vec3(uv, texture_layer_f)).rgb;
+    texout_albedo = vec4(mix(albedo, conf.material_color.rgb, conf.material_color.a), 1.0);
+
+    highp vec3 normal;
+    if (FEATURE_NORMAL_MODE == 2u) {
+        highp vec2 normal_map_size = vec2(textureSize(normal_sampler, 0).xy);
+        highp vec2 normal_uv = (uv * (normal_map_size - 1.0) + 0.5) / normal_map_size;
+        normal = octNormalDecode2n8(texture(normal_sampler, vec3(normal_uv, texture_layer_f)).rg);
+    } else {
+        normal = normalize(cross(dFdx(var_pos_cws), dFdy(var_pos_cws)));
+    }
+    texout_normal = octNormalEncode2u16(normal);
+}
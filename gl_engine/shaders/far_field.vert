@@ -0,0 +1,41 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "shared_config.glsl"
+#include "camera_config.glsl"
+#include "tile.glsl"
+
+// one face of the far field cube (see FarField.h)
+uniform highp mat4 view_proj;
+
+out highp vec2 uv;
+out highp vec3 var_pos_cws;
+flat out highp int v_texture_layer;
+flat out highp int v_quadrant_mask;
+
+void main() {
+    float n_quads_per_direction;
+    float quad_width;
+    float quad_height;
+    float vertex_altitude_correction_factor;
+    var_pos_cws = camera_world_space_position(uv, n_quads_per_direction, quad_width, quad_height, vertex_altitude_correction_factor);
+    gl_Position = view_proj * vec4(var_pos_cws, 1);
+    v_texture_layer = texture_layer;
+    v_quadrant_mask = quadrant_mask;
+}
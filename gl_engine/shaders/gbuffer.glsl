@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+// Access to gbuffer target 1 (texin_position). By default it stores the camera relative world space position and the
+// distance (RGBA32F). With GBUFFER_COMPACT (ALP_ENABLE_COMPACT_GBUFFER) only the distance is stored (R32F), and the
+// position is reconstructed along the view ray of the pixel. The distance is negative for the sky in both cases.
+// Requires camera_config.glsl.
+
+highp vec3 view_ray_direction_cws(highp vec2 tex_coords) {
+    // a point on the near plane, that one is finite also for an infinite far plane
+    return normalize(mat3(camera.inv_view_matrix) * depth_cs_to_pos_vs(0.0, tex_coords));
+}
+
+highp float gbuffer_distance(highp sampler2D texin_position, highp vec2 tex_coords) {
+#if GBUFFER_COMPACT
+    return texture(texin_position, tex_coords).r;
+#else
+    return texture(texin_position, tex_coords).w;
+#endif
+}
+
+// xyz...camera relative world space position, w...distance
+highp vec4 gbuffer_position_distance(highp sampler2D texin_position, highp vec2 tex_coords) {
+#if GBUFFER_COMPACT
+    highp float dist = texture(texin_position, tex_coords).r;
+    return vec4(view_ray_direction_cws(tex_coords) * dist, dist);
+#else
+    return texture(texin_position, tex_coords);
+#endif
+}
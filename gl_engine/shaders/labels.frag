@@ -16,10 +16,11 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
-uniform sampler2D font_sampler;
+uniform sampler2D font_sampler;                 // signed distance field, see nucleus::MapLabelManager
 uniform sampler2D icon_sampler;
 
-uniform bool drawing_outline;
+uniform mediump float sdf_edge;                 // value of the field on the glyph edge
+uniform mediump float sdf_outline_edge;         // and on the outer edge of the outline
 
 in highp vec2 texcoords;
 
@@ -32,23 +33,16 @@ void main() {
 
     if(texcoords.x < 2.0f)
     {
-        if (drawing_outline) {
-            mediump float outline_mask = texture(font_sampler, texcoords).g;
-            if (outline_mask < 150.0 / 255.0)
-                discard;
-            out_Color = vec4(outlineColor * outline_mask, outline_mask);
-            gl_FragDepth = gl_FragCoord.z;
-        }
-        else {
-            mediump float font_mask = texture(font_sampler, texcoords).r;
-            if (font_mask < 10.0 / 255.0)
-                discard;
-            out_Color = vec4(fontColor * font_mask, font_mask);
-            // mediump float outline_mask = texture(font_sampler, texcoords).g;
-            // mediump float font_mask = texture(font_sampler, texcoords).r;
-            // out_Color = vec4(mix(outlineColor, fontColor, font_mask), outline_mask);
-            gl_FragDepth = gl_FragCoord.z * 0.9999999;
-        }
+        // fill and outline in one pass, both are thresholds of the same distance field
+        mediump float dist = texture(font_sampler, texcoords).r;
+        mediump float aa = max(fwidth(dist) * 0.5, 1.0 / 255.0);
+        mediump float outline_alpha = smoothstep(sdf_outline_edge - aa, sdf_outline_edge + aa, dist);
+        if (outline_alpha < 0.5)
+            discard;
+        mediump float fill = smoothstep(sdf_edge - aa, sdf_edge + aa, dist);
+        out_Color = vec4(mix(outlineColor, fontColor, fill), outline_alpha);
+        // the fill is slightly in front (4 steps of a 24 bit depth buffer), so that the outline of the next glyph doesn't cover it
+        gl_FragDepth = fill > 0.5 ? gl_FragCoord.z - 4.0 / 16777216.0 : gl_FragCoord.z;
     }
     else
     {
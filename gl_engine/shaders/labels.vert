@@ -18,9 +18,11 @@
  *****************************************************************************/
 
 #include "camera_config.glsl"
+#include "gbuffer.glsl"
 
 // we interpolate between both far labels depending on importance
 // -> if importance is 1 -> we will show the label from farther away
+// the scaling is mirrored in nucleus::label_culling::screen_scale, keep them in sync
 const float farLabel0 = 50000.0f;
 const float farLabel1 = 500000.0f;
 const float nearLabel = 100.0f;
@@ -30,7 +32,7 @@ const vec2 offset_mask[4] = vec2[4](vec2(0.0f,0.0f), vec2(0.0f,1.0f), vec2(1.0f,
 uniform highp mat4 inv_view_rot;
 uniform bool label_dist_scaling;
 
-uniform sampler2D texin_depth;
+uniform highp sampler2D texin_depth; // gbuffer target 1, see gbuffer.glsl
 
 layout (location = 0) in vec4 pos;
 layout (location = 1) in vec4 vtexcoords;
@@ -39,18 +41,10 @@ layout (location = 3) in float importance;
 
 out highp vec2 texcoords;
 
+// distance, importance and collision culling is done on the cpu (nucleus::label_culling), only occlusion is tested here
 bool label_visible(highp vec3 relative_to_cam, float dist_to_cam) {
-    if (importance < 0.2 && dist_to_cam > 3000.0)
-        return false;
-    if (importance < 0.4 && dist_to_cam > 20000.0)
-        return false;
-    if (importance < 0.6 && dist_to_cam > 250000.0)
-        return false;
-    if (importance < 0.8 && dist_to_cam > 500000.0)
-        return false;
-
     vec3 peakLookup = ws_to_ndc(relative_to_cam) + vec3(0.0f, 0.1f, 0.0f);
-    float depth = texture(texin_depth, peakLookup.xy).w;
+    float depth = gbuffer_distance(texin_depth, peakLookup.xy);
     if(depth <= 0.001f || depth > (dist_to_cam-200.0f))
     {
         return true;
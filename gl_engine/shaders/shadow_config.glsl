@@ -16,12 +16,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
-const highp int SHADOW_CASCADES = 4;             // HAS TO BE THE SAME AS IN ShadowMapping.h!!
-//const int SHADOW_CASCADES_ALIGNED = 2;     // either 4,8,12,16,...
+// SHADOW_CASCADES (maximum number of cascades) is defined by ShaderProgram from the value in ShadowMapping.h
 
 layout (std140) uniform shadow_config {
     highp mat4 light_space_view_proj_matrix[SHADOW_CASCADES];
     highp float cascade_planes[SHADOW_CASCADES + 1];
+    highp vec4 atlas_rect[SHADOW_CASCADES]; // xy offset, zw size in texture coordinates of the atlas
     highp vec2 shadowmap_size;
-    highp vec2 buff;
+    highp uint cascade_count; // active cascades
+    highp uint buff;
 } shadow;
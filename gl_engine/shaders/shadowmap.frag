@@ -16,5 +16,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+in highp vec2 uv;
+flat in highp int v_quadrant_mask;
+
 void main() {
+    // see tile.frag
+    if (v_quadrant_mask != 15) {
+        highp int quadrant = int(uv.x >= 0.5) + 2 * int(uv.y < 0.5);
+        if ((v_quadrant_mask & (1 << quadrant)) == 0)
+            discard;
+    }
 }
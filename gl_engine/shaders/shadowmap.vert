@@ -22,9 +22,30 @@
 #include "shadow_config.glsl"
 #include "tile.glsl"
 
+#if SHADOW_VIEWPORT_ARRAY
+// all cascades in one draw call: every tile instance is repeated n_views times (attribute divisor), copy i goes to the
+// atlas viewport of the cascade in bits 2i..2i+1 of view_cascades.
+uniform lowp int n_views;
+uniform lowp int view_cascades;
+#else
 uniform lowp int current_layer;
+#endif
+
+out highp vec2 uv;
+flat out highp int v_quadrant_mask;
 
 void main() {
-    vec2 uv;
-    gl_Position = shadow.light_space_view_proj_matrix[current_layer] * vec4(camera_world_space_position(), 1);
+    float n_quads_per_direction;
+    float quad_width;
+    float quad_height;
+    float vertex_altitude_correction_factor;
+#if SHADOW_VIEWPORT_ARRAY
+    int cascade = (view_cascades >> (2 * (gl_InstanceID % n_views))) & 3;
+    gl_ViewportIndex = cascade;
+#else
+    int cascade = current_layer;
+#endif
+    gl_Position = shadow.light_space_view_proj_matrix[cascade]
+        * vec4(camera_world_space_position(uv, n_quads_per_direction, quad_width, quad_height, vertex_altitude_correction_factor), 1);
+    v_quadrant_mask = quadrant_mask;
 }
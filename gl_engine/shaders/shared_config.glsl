@@ -51,5 +51,40 @@ layout (std140) uniform shared_config {
     highp uint height_lines_enabled;
     highp uint csm_enabled;
     highp uint overlay_shadowmaps_enabled;
+    highp uint ssao_resolution;
+
+    highp uint ssao_temporal_enabled;
     highp uint padi1;
+    highp uint padi2;
+    highp uint padi3;
 } conf;
+
+// feature switches. ShaderManager::set_feature_config specialises tile and compose for the active settings by defining these
+// as constants, so that the disabled branches are compiled out. without specialisation they read the uniform block.
+#ifndef FEATURE_PHONG_ENABLED
+#define FEATURE_PHONG_ENABLED bool(conf.phong_enabled)
+#endif
+#ifndef FEATURE_NORMAL_MODE
+#define FEATURE_NORMAL_MODE conf.normal_mode
+#endif
+#ifndef FEATURE_OVERLAY_MODE
+#define FEATURE_OVERLAY_MODE conf.overlay_mode
+#endif
+#ifndef FEATURE_OVERLAY_POSTSHADING_ENABLED
+#define FEATURE_OVERLAY_POSTSHADING_ENABLED bool(conf.overlay_postshading_enabled)
+#endif
+#ifndef FEATURE_SSAO_ENABLED
+#define FEATURE_SSAO_ENABLED bool(conf.ssao_enabled)
+#endif
+#ifndef FEATURE_CSM_ENABLED
+#define FEATURE_CSM_ENABLED bool(conf.csm_enabled)
+#endif
+#ifndef FEATURE_SNOW_ENABLED
+#define FEATURE_SNOW_ENABLED bool(conf.snow_settings_angle.x)
+#endif
+#ifndef FEATURE_HEIGHT_LINES_ENABLED
+#define FEATURE_HEIGHT_LINES_ENABLED bool(conf.height_lines_enabled)
+#endif
+#ifndef FEATURE_OVERLAY_SHADOWMAPS_ENABLED
+#define FEATURE_OVERLAY_SHADOWMAPS_ENABLED bool(conf.overlay_shadowmaps_enabled)
+#endif
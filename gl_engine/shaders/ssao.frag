@@ -19,6 +19,7 @@
 #include "camera_config.glsl"
 #include "shared_config.glsl"
 #include "encoder.glsl"
+#include "gbuffer.glsl"
 
 const lowp uint MAX_SSAO_KERNEL_SIZE = 64u;   // also change in SSAO.h
 
@@ -31,6 +32,11 @@ uniform highp usampler2D texin_normal;
 uniform highp sampler2D texin_noise;
 
 uniform highp vec3 samples[MAX_SSAO_KERNEL_SIZE];
+// the samples [sample_offset, sample_offset + sample_count) (mod kernel size) are evaluated. for temporal accumulation
+// this is a different part of the kernel every frame, otherwise the full kernel.
+uniform lowp int sample_offset;
+uniform lowp int sample_count;
+uniform highp vec2 noise_offset;    // in pixels, changes per frame for temporal accumulation
 
 highp float calculate_falloff(highp float dist, highp float from, highp float to) {
     return clamp(1.0 - (dist - from) / (to - from), 0.0, 1.0);
@@ -38,19 +44,19 @@ highp float calculate_falloff(highp float dist, highp float from, highp float to
 
 void main()
 {
-    highp vec4 pos_dist = texture(texin_position, texcoords);
+    highp vec4 pos_dist = gbuffer_position_distance(texin_position, texcoords);
     highp vec3 pos_cws = pos_dist.xyz;
     highp float dist = pos_dist.w; // negative if sky
 
     if (dist < 0.0) {
         out_color = conf.ssao_falloff_to_value;
     } else {
-        // tile noise texture over screen based on screen dimensions divided by noise size
-        highp vec2 noiseScale = camera.viewport_size / 4.0;
+        // tile noise texture over the target pixels (the ssao buffer may have a lower resolution than the viewport)
+        highp vec2 noiseScale = vec2(textureSize(texin_noise, 0));
 
         // get input for SSAO algorithm
         highp vec3 normal_ws = octNormalDecode2u16(texture(texin_normal, texcoords).xy);
-        highp vec3 randomVec = normalize(texture(texin_noise, texcoords * noiseScale).xyz);
+        highp vec3 randomVec = normalize(texture(texin_noise, (gl_FragCoord.xy + noise_offset) / noiseScale).xyz);
 
         // Depth dependet radius.
         highp float radius = dist / 10.0 + 20.0;// / 10.0 + 50.0; //dist / 10.0 + 10.0;
@@ -69,11 +75,11 @@ void main()
             highp mat3 TBN = mat3(tangent, bitangent, normal_ws);
 
             // iterate over the sample kernel and calculate occlusion factor
-            for(lowp int i = 0; i < kernel; ++i)
+            for(lowp int i = 0; i < sample_count; ++i)
             {
 
                 // get sample position in world space
-                highp vec3 sample_pos_cws = TBN * samples[i];
+                highp vec3 sample_pos_cws = TBN * samples[(sample_offset + i) % kernel];
                 sample_pos_cws = pos_cws + sample_pos_cws * radius;
                 highp float sample_gt_dist = length(sample_pos_cws);
 
@@ -81,7 +87,7 @@ void main()
                 highp vec3 sample_pos_ndc = ws_to_ndc(sample_pos_cws);
 
                 // get actual distance to camera for sample point
-                highp float sample_dist = texture(texin_position, sample_pos_ndc.xy).w;
+                highp float sample_dist = gbuffer_distance(texin_position, sample_pos_ndc.xy);
 
                 // range check & accumulate
                 highp float rangeCheck = 1.0;
@@ -90,7 +96,7 @@ void main()
                 }
                 occlusion += (sample_gt_dist >= sample_dist + bias ? 1.0 : 0.0) * rangeCheck;
             }
-            occlusion = 1.0 - (occlusion / float(kernel));
+            occlusion = 1.0 - (occlusion / float(sample_count));
         }
         occlusion = occlusion * occlusion * occlusion;
         out_color = mix(conf.ssao_falloff_to_value, occlusion, falloff);
@@ -18,12 +18,14 @@
 
 #include "shared_config.glsl"
 #include "camera_config.glsl"
+#include "gbuffer.glsl"
 
 layout (location = 0) out highp float out_ssao;
 
 in highp vec2 texcoords;
 
 uniform lowp sampler2D texin_ssao;
+uniform highp sampler2D texin_position;
 
 uniform lowp int direction;  // direction of blur, 0 = horizontal, 1 = vertical
 
@@ -41,18 +43,23 @@ const highp float weight[6] = float[](
 // https://www.rastergrid.com/blog/2010/09/efficient-gaussian-blur-with-linear-sampling/
 void main()
 {
+    // the sky keeps the constant of ssao.frag, compose doesn't read it there
+    if (gbuffer_distance(texin_position, texcoords) < 0.0) {
+        out_ssao = conf.ssao_falloff_to_value;
+        return;
+    }
     lowp int level = int(conf.ssao_blur_kernel_size);
     lowp int aO = int(floor((float(level)+1.0)*(float(level)+1.0)/2.0-1.0));
     out_ssao = texture(texin_ssao, texcoords).x * weight[aO+0];
     if (level == 0) return;
     if (direction == 0) {
-        highp float scale_fact = 1.0 / camera.viewport_size.x;
+        highp float scale_fact = 1.0 / float(textureSize(texin_ssao, 0).x);
         for (lowp int i = 1; i < level + 1; i++) {
             out_ssao += texture(texin_ssao, texcoords + vec2(0.0, offset[aO+i]) * scale_fact).r * weight[aO+i];
             out_ssao += texture(texin_ssao, texcoords - vec2(0.0, offset[aO+i]) * scale_fact).r * weight[aO+i];
         }
     } else {
-        highp float scale_fact = 1.0 / camera.viewport_size.y;
+        highp float scale_fact = 1.0 / float(textureSize(texin_ssao, 0).y);
         for (lowp int i = 1; i < level + 1; i++) {
             out_ssao += texture(texin_ssao, texcoords + vec2(offset[aO+i], 0.0) * scale_fact).r * weight[aO+i];
             out_ssao += texture(texin_ssao, texcoords - vec2(offset[aO+i], 0.0) * scale_fact).r * weight[aO+i];
@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "camera_config.glsl"
+#include "encoder.glsl"
+#include "gbuffer.glsl"
+
+layout (location = 0) out lowp vec4 out_history;           // r...ao, gb...encoded distance
+layout (location = 1) out lowp vec4 out_history_normal;    // rg...encoded normal
+
+in highp vec2 texcoords;
+
+uniform lowp sampler2D texin_ssao;              // this frame's (partial kernel) result
+uniform lowp sampler2D texin_history;
+uniform lowp sampler2D texin_history_normal;
+uniform highp sampler2D texin_position;         // f32vec4 or f32 (see gbuffer.glsl)
+uniform highp usampler2D texin_normal;          // u16vec2
+
+uniform highp mat4 reprojection_matrix;         // current camera local coordinates to clip space of the previous frame
+uniform highp vec3 previous_camera_offset;      // previous camera position relative to the current one
+uniform highp float current_weight;             // exponential moving average
+uniform bool history_valid;
+
+// Accumulates ao over several frames. The history is reprojected with the previous camera and rejected
+// if the surface there doesn't match (disocclusion, moving over edges).
+void main()
+{
+    highp float current = texture(texin_ssao, texcoords).r;
+    highp vec4 pos_dist = gbuffer_position_distance(texin_position, texcoords);
+    highp vec3 pos_cws = pos_dist.xyz;
+    highp float dist = pos_dist.w; // negative if sky
+    if (dist < 0.0) {
+        out_history = vec4(current, 0.0, 0.0, 1.0);
+        out_history_normal = vec4(0.5, 0.5, 0.0, 1.0);
+        return;
+    }
+    highp vec3 normal = octNormalDecode2u16(texture(texin_normal, texcoords).xy);
+
+    highp float ao = current;
+    highp vec4 previous_clip = reprojection_matrix * vec4(pos_cws, 1.0);
+    highp vec2 previous_uv = previous_clip.xy / previous_clip.w * 0.5 + 0.5;
+    if (history_valid && previous_clip.w > 0.0 && all(greaterThanEqual(previous_uv, vec2(0.0))) && all(lessThanEqual(previous_uv, vec2(1.0)))) {
+        lowp vec4 history = texture(texin_history, previous_uv);
+        highp float expected_dist = length(pos_cws - previous_camera_offset);
+        highp float history_dist = history.g + history.b > 0.0 ? depthWSDecode2n8(history.gb) : -1.0;
+        highp vec3 history_normal = octNormalDecode2n8(texture(texin_history_normal, previous_uv).rg);
+        bool same_surface = abs(history_dist - expected_dist) < expected_dist * 0.01 && dot(history_normal, normal) > 0.9;
+        if (same_surface)
+            ao = mix(history.r, current, current_weight);
+    }
+
+    out_history = vec4(ao, depthWSEncode2n8(dist), 1.0);
+    out_history_normal = vec4(octNormalEncode2n8(normal), 0.0, 1.0);
+}
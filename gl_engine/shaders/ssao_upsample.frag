@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "camera_config.glsl"
+#include "encoder.glsl"
+#include "gbuffer.glsl"
+
+layout (location = 0) out highp float out_ssao;
+
+in highp vec2 texcoords;
+
+uniform lowp sampler2D texin_ssao;          // reduced resolution
+uniform highp sampler2D texin_position;     // f32vec4 or f32 (see gbuffer.glsl), full resolution
+uniform highp usampler2D texin_normal;      // u16vec2, full resolution
+
+// Depth aware (joint) bilateral upsampling: the 4 closest low resolution texels are weighted bilinearly,
+// and additionally by how well their gbuffer depth and normal match the full resolution pixel.
+void main()
+{
+    highp float dist = gbuffer_distance(texin_position, texcoords); // negative if sky
+    if (dist < 0.0) {
+        out_ssao = texture(texin_ssao, texcoords).r;
+        return;
+    }
+    highp vec3 normal = octNormalDecode2u16(texture(texin_normal, texcoords).xy);
+
+    highp vec2 low_res_size = vec2(textureSize(texin_ssao, 0));
+    highp vec2 low_res_pos = texcoords * low_res_size - 0.5;
+    highp vec2 base = floor(low_res_pos);
+    highp vec2 f = low_res_pos - base;
+
+    highp float sum = 0.0;
+    highp float weight_sum = 0.0;
+    for (lowp int i = 0; i < 4; i++) {
+        highp vec2 offset = vec2(float(i % 2), float(i / 2));
+        // texel centre, the low resolution pass sampled the gbuffer at the same coordinates
+        highp vec2 uv = (base + offset + 0.5) / low_res_size;
+        highp float sample_dist = gbuffer_distance(texin_position, uv);
+        highp vec3 sample_normal = octNormalDecode2u16(texture(texin_normal, uv).xy);
+
+        highp vec2 bilinear = mix(1.0 - f, f, offset);
+        highp float depth_weight = 1.0 / (0.0001 + abs(dist - sample_dist) / (dist * 0.01));
+        highp float normal_weight = pow(max(dot(normal, sample_normal), 0.0), 8.0);
+        // sky texels have a negative distance and get a very low weight through depth_weight.
+        highp float weight = bilinear.x * bilinear.y * depth_weight * normal_weight;
+        sum += texture(texin_ssao, uv).r * weight;
+        weight_sum += weight;
+    }
+    if (weight_sum < 0.00001)
+        out_ssao = texture(texin_ssao, texcoords).r;
+    else
+        out_ssao = sum / weight_sum;
+}
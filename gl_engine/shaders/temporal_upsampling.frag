@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "camera_config.glsl"
+#include "gbuffer.glsl"
+
+layout (location = 0) out lowp vec4 out_history;
+
+in highp vec2 texcoords;
+
+uniform lowp sampler2D texin_colour;            // this frame, jittered, at the internal resolution
+uniform highp sampler2D texin_position;         // f32vec4 or f32 (see gbuffer.glsl), internal resolution
+uniform lowp sampler2D texin_history;           // output resolution, bilinear sampler
+
+uniform highp mat4 reprojection_matrix;         // current camera local coordinates to clip space of the previous frame
+uniform highp vec2 jitter_uv;                   // offset of this frame's samples in texture coordinates
+uniform highp float current_weight;             // exponential moving average
+uniform bool history_valid;
+
+// Accumulates the jittered frames into the history at the output resolution. The sample of this frame that is closest to
+// the output pixel is weighted by its distance, so the history converges to a full resolution image for static views.
+// The reprojected history is clamped to the 3x3 neighbourhood of the sample, which rejects it on disocclusions.
+void main()
+{
+    highp ivec2 size = textureSize(texin_colour, 0);
+    // the content of the output pixel is at texcoords + jitter_uv in this frame
+    highp vec2 texel_pos = (texcoords + jitter_uv) * vec2(size) - 0.5;
+    highp ivec2 centre = clamp(ivec2(floor(texel_pos + 0.5)), ivec2(0), size - 1);
+    highp float sample_distance = length(texel_pos - vec2(centre));
+
+    lowp vec3 current = texelFetch(texin_colour, centre, 0).rgb;
+    mediump vec3 min_rgb = current;
+    mediump vec3 max_rgb = current;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            lowp vec3 neighbour = texelFetch(texin_colour, clamp(centre + ivec2(x, y), ivec2(0), size - 1), 0).rgb;
+            min_rgb = min(min_rgb, neighbour);
+            max_rgb = max(max_rgb, neighbour);
+        }
+    }
+
+    mediump vec3 colour = current;
+    highp vec2 centre_uv = (vec2(centre) + 0.5) / vec2(size);
+    highp vec4 pos_dist = gbuffer_position_distance(texin_position, centre_uv);
+    // the sky has no parallax, it is taken from the same place (the neighbourhood clamp takes care of rotations)
+    highp vec2 previous_uv = texcoords;
+    bool on_screen = true;
+    if (pos_dist.w >= 0.0) {
+        highp vec4 previous_clip = reprojection_matrix * vec4(pos_dist.xyz, 1.0);
+        previous_uv = previous_clip.xy / previous_clip.w * 0.5 + 0.5;
+        on_screen = previous_clip.w > 0.0 && all(greaterThanEqual(previous_uv, vec2(0.0))) && all(lessThanEqual(previous_uv, vec2(1.0)));
+    }
+    if (history_valid && on_screen) {
+        mediump vec3 history = clamp(texture(texin_history, previous_uv).rgb, min_rgb, max_rgb);
+        // samples far from the output pixel centre (up to 0.7 texels) contribute less
+        colour = mix(history, current, current_weight * exp(-2.0 * sample_distance * sample_distance));
+    }
+    out_history = vec4(colour, 1.0);
+}
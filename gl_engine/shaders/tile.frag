@@ -22,13 +22,19 @@
 #include "encoder.glsl"
 
 uniform lowp sampler2DArray ortho_sampler;
+uniform lowp sampler2DArray normal_sampler; // precomputed per tile, octahedral (FEATURE_NORMAL_MODE 2)
 
 layout (location = 0) out lowp vec3 texout_albedo;
+#if GBUFFER_COMPACT
+layout (location = 1) out highp float texout_position; // distance only, see gbuffer.glsl
+#else
 layout (location = 1) out highp vec4 texout_position;
+#endif
 layout (location = 2) out highp uvec2 texout_normal;
 layout (location = 3) out lowp vec4 texout_depth;
 
 flat in highp int v_texture_layer;
+flat in highp int v_quadrant_mask;
 in highp vec2 uv;
 in highp vec3 var_pos_cws;
 in highp vec3 var_normal;
@@ -53,6 +59,12 @@ void main() {
         discard;
     }
 #endif
+    // partially refined tile, the children draw the other quadrants (uv.y = 0 is the northern edge)
+    if (v_quadrant_mask != 15) {
+        highp int quadrant = int(uv.x >= 0.5) + 2 * int(uv.y < 0.5);
+        if ((v_quadrant_mask & (1 << quadrant)) == 0)
+            discard;
+    }
 
     // Write Albedo (ortho picture) in gbuffer
     highp float texture_layer_f = float(v_texture_layer);
@@ -62,23 +74,34 @@ void main() {
 
     // Write Position (and distance) in gbuffer
     highp float dist = length(var_pos_cws);
+#if GBUFFER_COMPACT
+    texout_position = dist;
+#else
     texout_position = vec4(var_pos_cws, dist);
+#endif
 
     // Write and encode normal in gbuffer
     highp vec3 normal = vec3(0.0);
-    if (conf.normal_mode == 0u) normal = normal_by_fragment_position_interpolation();
+    if (FEATURE_NORMAL_MODE == 0u) normal = normal_by_fragment_position_interpolation();
+    else if (FEATURE_NORMAL_MODE == 2u) {
+        // a texel per height sample, the texel centres are at the vertices
+        highp vec2 normal_map_size = vec2(textureSize(normal_sampler, 0).xy);
+        highp vec2 normal_uv = (uv * (normal_map_size - 1.0) + 0.5) / normal_map_size;
+        normal = octNormalDecode2n8(texture(normal_sampler, vec3(normal_uv, texture_layer_f)).rg);
+    }
     else normal = var_normal;
     texout_normal = octNormalEncode2u16(normal);
 
-    // Write and encode distance for readback
-    texout_depth = vec4(depthWSEncode2n8(dist), 0.0, 0.0);
+    // Write and encode distance for readback, and the texture layer + 1 (16 bit, 0 means no terrain) as visibility feedback
+    highp float feedback_id = float(v_texture_layer + 1);
+    texout_depth = vec4(depthWSEncode2n8(dist), floor(feedback_id / 256.0) / 255.0, mod(feedback_id, 256.0) / 255.0);
 
     // HANDLE OVERLAYS (and mix it with the albedo color) THAT CAN JUST BE DONE IN THIS STAGE
     // (because of DATA thats not forwarded)
     // NOTE: Performancewise its generally better to handle overlays in the compose step! (screenspace effect)
-    if (conf.overlay_mode > 0u && conf.overlay_mode < 100u) {
+    if (FEATURE_OVERLAY_MODE > 0u && FEATURE_OVERLAY_MODE < 100u) {
         lowp vec3 overlay_color = vec3(0.0);
-        switch(conf.overlay_mode) {
+        switch(FEATURE_OVERLAY_MODE) {
             case 1u: overlay_color = normal * 0.5 + 0.5; break;
             default: overlay_color = vertex_color;
         }
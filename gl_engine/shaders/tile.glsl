@@ -21,10 +21,24 @@ layout(location = 0) in highp vec4 bounds;
 layout(location = 1) in highp int texture_layer;
 layout(location = 2) in highp int tileset_id;
 layout(location = 3) in highp int tileset_zoomlevel;
+layout(location = 4) in highp vec2 altitude_correction_factor; // at the southern and northern tile edge, computed on cpu
+layout(location = 5) in highp int quadrant_mask; // quadrants that are drawn, the others are covered by children (DrawListGenerator::QuadrantMasks)
+layout(location = 6) in highp int mesh_lod; // per instance, so that the lods can be drawn in one (indirect) call
+layout(location = 7) in highp int curtain_edges; // edges that need a curtain: 1 east, 2 north, 4 west, 8 south (TileManager::curtain_edges)
+layout(location = 8) in highp float overlay_value; // per tile value of the overlay modes 6 to 9 (TileManager::overlay_value)
 
-uniform highp int n_edge_vertices;
 uniform mediump usampler2DArray height_sampler;
 
+// every mesh lod halves the vertices per edge of the height grid (TileManager::mesh_lod_edge_vertices)
+highp int mesh_lod_edge_vertices() {
+    return ((textureSize(height_sampler, 0).x - 1) >> mesh_lod) + 1;
+}
+
+// (heightmap resolution - 1) / (n_edge_vertices - 1), coarser mesh lods skip texels
+highp int mesh_lod_height_texel_step() {
+    return 1 << mesh_lod;
+}
+
 highp float y_to_lat(highp float y) {
     const highp float pi = 3.1415926535897932384626433;
     const highp float cOriginShift = 20037508.342789244;
@@ -34,7 +48,9 @@ highp float y_to_lat(highp float y) {
     return latRad;
 }
 
-highp vec3 camera_world_space_position(out vec2 uv, out float n_quads_per_direction, out float quad_width, out float quad_height, out float altitude_correction_factor) {
+highp vec3 camera_world_space_position(out vec2 uv, out float n_quads_per_direction, out float quad_width, out float quad_height, out float vertex_altitude_correction_factor) {
+    highp int n_edge_vertices = mesh_lod_edge_vertices();
+    highp int height_texel_step = mesh_lod_height_texel_step();
     highp int n_quads_per_direction_int = n_edge_vertices - 1;
     n_quads_per_direction = float(n_quads_per_direction_int);
     quad_width = (bounds.z - bounds.x) / n_quads_per_direction;
@@ -43,38 +59,47 @@ highp vec3 camera_world_space_position(out vec2 uv, out float n_quads_per_direct
     highp int row = gl_VertexID / n_edge_vertices;
     highp int col = gl_VertexID - (row * n_edge_vertices);
     highp int curtain_vertex_id = gl_VertexID - n_edge_vertices * n_edge_vertices;
+    highp int curtain_edge = 0;
     if (curtain_vertex_id >= 0) {
         if (curtain_vertex_id < n_edge_vertices) {
             row = (n_edge_vertices - 1) - curtain_vertex_id;
             col = (n_edge_vertices - 1);
+            curtain_edge = 1;
         }
         else if (curtain_vertex_id >= n_edge_vertices && curtain_vertex_id < 2 * n_edge_vertices - 1) {
             row = 0;
             col = (n_edge_vertices - 1) - (curtain_vertex_id - n_edge_vertices) - 1;
+            curtain_edge = 2;
         }
         else if (curtain_vertex_id >= 2 * n_edge_vertices - 1 && curtain_vertex_id < 3 * n_edge_vertices - 2) {
             row = curtain_vertex_id - 2 * n_edge_vertices + 2;
             col = 0;
+            curtain_edge = 4;
         }
         else {
             row = (n_edge_vertices - 1);
             col = curtain_vertex_id - 3 * n_edge_vertices + 3;
+            curtain_edge = 8;
         }
     }
-    // Note: for higher zoom levels it would be enough to calculate the altitude_correction_factor on cpu
-    // for lower zoom levels we could bake it into the texture.
-    // but there was no measurable difference despite a cos and a atan, so leaving as is for now.
     highp float var_pos_cws_y = float(n_quads_per_direction_int - row) * float(quad_width) + bounds.y;
-    highp float pos_y = var_pos_cws_y + camera.position.y;
-    altitude_correction_factor = 0.125 / cos(y_to_lat(pos_y)); // https://github.com/AlpineMapsOrg/renderer/issues/5
+    // for higher zoom levels the correction factor is practically linear within a tile (error < 1cm from zoom level 10 on),
+    // so we interpolate the per tile values. larger tiles compute it exactly. https://github.com/AlpineMapsOrg/renderer/issues/5
+    if (tileset_zoomlevel >= 10) {
+        vertex_altitude_correction_factor = mix(altitude_correction_factor.x, altitude_correction_factor.y, float(n_quads_per_direction_int - row) / n_quads_per_direction);
+    } else {
+        highp float pos_y = var_pos_cws_y + camera.position.y;
+        vertex_altitude_correction_factor = 0.125 / cos(y_to_lat(pos_y));
+    }
 
     uv = vec2(float(col) / n_quads_per_direction, float(row) / n_quads_per_direction);
-    float altitude_tex = float(texelFetch(height_sampler, ivec3(col, row, texture_layer), 0).r);
-    float adjusted_altitude = altitude_tex * altitude_correction_factor;
+    float altitude_tex = float(texelFetch(height_sampler, ivec3(col * height_texel_step, row * height_texel_step, texture_layer), 0).r);
+    float adjusted_altitude = altitude_tex * vertex_altitude_correction_factor;
 
     highp vec3 var_pos_cws = vec3(float(col) * quad_width + bounds.x, var_pos_cws_y, adjusted_altitude - camera.position.z);
 
-    if (curtain_vertex_id >= 0) {
+    // without a curtain, the vertex stays on the surface edge and its triangles are degenerate (not rasterised)
+    if ((curtain_edges & curtain_edge) != 0) {
         float curtain_height = CURTAIN_REFERENCE_HEIGHT;
 #if CURTAIN_HEIGHT_MODE == 1
         float dist_factor = clamp(length(var_pos_cws) / 100000.0, 0.2, 1.0);
@@ -91,22 +116,22 @@ highp vec3 camera_world_space_position() {
     float n_quads_per_direction;
     float quad_width;
     float quad_height;
-    float altitude_correction_factor;
-    return camera_world_space_position(uv, n_quads_per_direction, quad_width, quad_height, altitude_correction_factor);
+    float vertex_altitude_correction_factor;
+    return camera_world_space_position(uv, n_quads_per_direction, quad_width, quad_height, vertex_altitude_correction_factor);
 }
 
-highp vec3 normal_by_finite_difference_method(vec2 uv, float edge_vertices_count, float quad_width, float quad_height, float altitude_correction_factor) {
+highp vec3 normal_by_finite_difference_method(vec2 uv, float edge_vertices_count, float quad_width, float quad_height, float vertex_altitude_correction_factor) {
     // from here: https://stackoverflow.com/questions/6656358/calculating-normals-in-a-triangle-mesh/21660173#21660173
     vec2 offset = vec2(1.0, 0.0) / (edge_vertices_count);
     float height = quad_width + quad_height;
     highp float hL = float(texture(height_sampler, vec3(uv - offset.xy, texture_layer)).r);
-    hL *= altitude_correction_factor;
+    hL *= vertex_altitude_correction_factor;
     highp float hR = float(texture(height_sampler, vec3(uv + offset.xy, texture_layer)).r);
-    hR *= altitude_correction_factor;
+    hR *= vertex_altitude_correction_factor;
     highp float hD = float(texture(height_sampler, vec3(uv + offset.yx, texture_layer)).r);
-    hD *= altitude_correction_factor;
+    hD *= vertex_altitude_correction_factor;
     highp float hU = float(texture(height_sampler, vec3(uv - offset.yx, texture_layer)).r);
-    hU *= altitude_correction_factor;
+    hU *= vertex_altitude_correction_factor;
 
     return normalize(vec3(hL - hR, hD - hU, height));
 }
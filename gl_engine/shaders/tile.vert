@@ -26,31 +26,43 @@ out highp vec2 uv;
 out highp vec3 var_pos_cws;
 out highp vec3 var_normal;
 flat out highp int v_texture_layer;
+flat out highp int v_quadrant_mask;
 #if CURTAIN_DEBUG_MODE > 0
 out lowp float is_curtain;
 #endif
 flat out lowp vec3 vertex_color;
 
+// blue (0) over green to red (1)
+lowp vec3 heat_colour(highp float t) {
+    t = clamp(t, 0.0, 1.0);
+    return clamp(vec3(2.0 * t - 0.5, 1.5 - abs(2.0 * t - 1.0) * 2.0, 1.5 - 2.0 * t), 0.0, 1.0);
+}
 
 void main() {
     float n_quads_per_direction;
     float quad_width;
     float quad_height;
-    float altitude_correction_factor;
-    var_pos_cws = camera_world_space_position(uv, n_quads_per_direction, quad_width, quad_height, altitude_correction_factor);
+    float vertex_altitude_correction_factor;
+    var_pos_cws = camera_world_space_position(uv, n_quads_per_direction, quad_width, quad_height, vertex_altitude_correction_factor);
 
-    if (conf.normal_mode == 1u) {
-        var_normal = normal_by_finite_difference_method(uv, n_quads_per_direction, quad_width, quad_height, altitude_correction_factor);
+    if (FEATURE_NORMAL_MODE == 1u) {
+        highp int height_texel_step = mesh_lod_height_texel_step();
+        var_normal = normal_by_finite_difference_method(uv, n_quads_per_direction * float(height_texel_step), quad_width / float(height_texel_step), quad_height / float(height_texel_step), vertex_altitude_correction_factor);
     }
 
     gl_Position = camera.view_proj_matrix * vec4(var_pos_cws, 1);
 
     vertex_color = vec3(0.0);
-    switch(conf.overlay_mode) {
+    switch(FEATURE_OVERLAY_MODE) {
         case 2u: vertex_color = color_from_id_hash(uint(tileset_id)); break;
         case 3u: vertex_color = color_from_id_hash(uint(tileset_zoomlevel)); break;
         case 4u: vertex_color = color_from_id_hash(uint(gl_VertexID)); break;
         case 5u: vertex_color = vec3(texture(height_sampler, vec3(uv, texture_layer)).rrr) / 65535.0; break;
+        case 6u: vertex_color = heat_colour(1.0 - overlay_value / 30.0); break; // red when just uploaded, blue after 30 s
+        case 7u: vertex_color = overlay_value < 0.5 ? vec3(0.1, 0.7, 0.2) : (overlay_value < 1.5 ? vec3(1.0, 0.6, 0.0) : vec3(0.9, 0.1, 0.1)); break;
+        case 8u: vertex_color = heat_colour(overlay_value * 0.5); break; // green at the threshold
+        case 9u: vertex_color = heat_colour(overlay_value / 20.0); break; // red from 20 ms
     }
     v_texture_layer = texture_layer;
+    v_quadrant_mask = quadrant_mask;
 }
@@ -0,0 +1,46 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+// one tile box per vertex, the visibility mask is captured with transform feedback (see GpuTileCuller)
+#define MAX_VIEWS 8 // GpuTileCuller::max_views
+
+in highp vec3 box_min; // relative to the origin of the boxes
+in highp vec3 box_max;
+uniform highp vec4 frustum_planes[MAX_VIEWS * 6]; // normal pointing inside and the signed distance of the origin
+uniform int n_views;
+uniform highp vec3 camera_position; // relative to the origin of the boxes
+uniform highp float margin;
+flat out highp uint visibility;
+
+void main() {
+    highp vec3 centre = (box_min + box_max) * 0.5;
+    highp vec3 half_size = (box_max - box_min) * 0.5 + vec3(margin * distance(centre, camera_position));
+    highp uint mask = 0u;
+    for (int view = 0; view < n_views; ++view) {
+        bool outside = false;
+        for (int i = 0; i < 6 && !outside; ++i) {
+            highp vec4 plane = frustum_planes[view * 6 + i];
+            // the corner of the box that is furthest along the normal is behind the plane
+            outside = dot(plane.xyz, centre) + dot(abs(plane.xyz), half_size) + plane.w < 0.0;
+        }
+        if (!outside)
+            mask |= 1u << uint(view);
+    }
+    visibility = mask;
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
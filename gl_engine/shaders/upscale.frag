@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+layout (location = 0) out lowp vec4 out_colour;
+
+in highp vec2 texcoords;
+
+uniform lowp sampler2D texin_colour;    // composed image at the internal resolution, bilinear sampler
+uniform highp sampler2D texin_depth;    // depth of the composed image
+uniform lowp float sharpness;           // 0 (bilinear only) to 1
+
+// Bilinear upscale followed by contrast adaptive sharpening (after AMD FidelityFX CAS): the sharpening weight of the
+// 4 neighbours shrinks where the local contrast is already high, so edges don't ring and noise isn't amplified.
+void main()
+{
+    highp vec2 texel = 1.0 / vec2(textureSize(texin_colour, 0));
+    lowp vec4 centre = texture(texin_colour, texcoords);
+    lowp vec3 n = texture(texin_colour, texcoords + vec2(0.0, texel.y)).rgb;
+    lowp vec3 s = texture(texin_colour, texcoords - vec2(0.0, texel.y)).rgb;
+    lowp vec3 e = texture(texin_colour, texcoords + vec2(texel.x, 0.0)).rgb;
+    lowp vec3 w = texture(texin_colour, texcoords - vec2(texel.x, 0.0)).rgb;
+
+    mediump vec3 min_rgb = min(centre.rgb, min(min(n, s), min(e, w)));
+    mediump vec3 max_rgb = max(centre.rgb, max(max(n, s), max(e, w)));
+    mediump vec3 amplitude = sqrt(clamp(min(min_rgb, 1.0 - max_rgb) / max(max_rgb, vec3(0.0001)), 0.0, 1.0));
+    mediump vec3 weight = -amplitude * mix(0.125, 0.2, sharpness);
+    mediump vec3 sharpened = (centre.rgb + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+    out_colour = vec4(clamp(sharpened, 0.0, 1.0), centre.a);
+
+    // nearest, interpolated depths would be in between foreground and background
+    highp ivec2 depth_size = textureSize(texin_depth, 0);
+    gl_FragDepth = texelFetch(texin_depth, clamp(ivec2(texcoords * vec2(depth_size)), ivec2(0), depth_size - 1), 0).r;
+}
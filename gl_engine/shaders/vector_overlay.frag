@@ -0,0 +1,35 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+// see vector_overlay.vert. the atlas holds premultiplied colours, the mask is toggled by inverting blending.
+uniform lowp int mode;
+uniform lowp vec4 colour;
+uniform sampler2D texin_mask;
+
+in highp vec2 texcoords;
+layout (location = 0) out lowp vec4 out_Color;
+
+void main() {
+    if (mode == 1) {
+        out_Color = vec4(1.0);
+        return;
+    }
+    if (mode == 2 && texture(texin_mask, texcoords).r < 0.5)
+        discard;
+    out_Color = vec4(colour.rgb * colour.a, colour.a);
+}
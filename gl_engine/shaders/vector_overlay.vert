@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+// rasterises the draped vector overlay into a level of the atlas (see VectorOverlay.h), top down, in metres relative to the
+// origin of the data. mode 0: a track segment per instance, expanded to a quad of 2 * half_width (ndc) with square ends.
+// mode 1: the vertices of a ring, drawn as a fan into the area mask. mode 2: a screen pass over the level that fills the mask.
+uniform highp mat4 view_proj;
+uniform lowp int mode;
+uniform highp float half_width;
+
+layout (location = 0) in highp vec2 a_start;
+layout (location = 1) in highp vec2 a_end;
+
+out highp vec2 texcoords;
+
+void main() {
+    if (mode == 2) {
+        // see screen_pass.vert
+        vec2 vertices[3] = vec2[3](vec2(-1.0, -1.0), vec2(3.0, -1.0), vec2(-1.0, 3.0));
+        gl_Position = vec4(vertices[gl_VertexID], 0.0, 1.0);
+        texcoords = 0.5 * gl_Position.xy + vec2(0.5);
+        return;
+    }
+    texcoords = vec2(0.0);
+    highp vec2 start = (view_proj * vec4(a_start, 0.0, 1.0)).xy;
+    if (mode == 1) {
+        gl_Position = vec4(start, 0.0, 1.0);
+        return;
+    }
+    highp vec2 end = (view_proj * vec4(a_end, 0.0, 1.0)).xy;
+    highp vec2 direction = end - start;
+    highp float length_ = length(direction);
+    direction = length_ > 0.0 ? direction / length_ : vec2(1.0, 0.0);
+    highp vec2 normal = vec2(-direction.y, direction.x);
+    // triangle strip: start right, start left, end right, end left
+    bool at_end = gl_VertexID >= 2;
+    highp float side = (gl_VertexID % 2 == 0) ? -1.0 : 1.0;
+    highp vec2 position = at_end ? end + direction * half_width : start - direction * half_width;
+    gl_Position = vec4(position + normal * side * half_width, 0.0, 1.0);
+}
@@ -0,0 +1,201 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "BatchRenderer.h"
+
+#include <QDebug>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+#include "FrameWriter.h"
+#include "gl_engine/FrameCapture.h"
+#include "gl_engine/Window.h"
+#include "nucleus/Controller.h"
+#include "nucleus/camera/Controller.h"
+#include "nucleus/tile_scheduler/Scheduler.h"
+
+BatchRenderer::BatchRenderer(const glm::uvec2& size, unsigned timeout_msecs)
+    : m_size(size)
+    , m_timeout_msecs(timeout_msecs)
+{
+    m_timeout_timer.setSingleShot(true);
+    connect(&m_timeout_timer, &QTimer::timeout, this, [this]() {
+        m_context->makeCurrent(m_surface);
+        m_window->paint(m_framebuffer.get());
+        finish_job(false);
+    });
+    m_writer_pool.setMaxThreadCount(2);
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    if (m_window)
+        m_context->makeCurrent(m_surface);
+    m_capture.reset();
+    m_writer_pool.waitForDone();
+    if (!m_window)
+        return;
+    m_framebuffer.reset();
+    m_window->deinit_gpu();
+    m_controller.reset();
+    m_window.reset();
+}
+
+bool BatchRenderer::init(QOpenGLContext* context, QOffscreenSurface* surface)
+{
+    m_context = context;
+    m_surface = surface;
+    if (!m_context->makeCurrent(m_surface))
+        return false;
+
+    m_window = std::make_unique<gl_engine::Window>();
+    m_controller = std::make_unique<nucleus::Controller>(m_window.get());
+    auto* scheduler = m_controller->tile_scheduler();
+    scheduler->set_ortho_tile_compression_algorithm(m_window->ortho_tile_compression_algorithm());
+    scheduler->set_ortho_tile_mip_levels(m_window->ortho_tile_mip_levels());
+    // no camera motion to wait for, the quads of a job are needed as soon as possible
+    QMetaObject::invokeMethod(scheduler, [scheduler]() { scheduler->set_update_timeout(10); });
+    m_window->initialise_gpu();
+    m_window->resize_framebuffer(int(m_size.x), int(m_size.y));
+    m_framebuffer = std::make_unique<QOpenGLFramebufferObject>(int(m_size.x), int(m_size.y), QOpenGLFramebufferObject::CombinedDepthStencil);
+    m_capture = std::make_unique<gl_engine::FrameCapture>([this](QImage image, uint64_t tag) { write_frame(std::move(image), tag); });
+
+    connect(m_window.get(), &nucleus::AbstractRenderWindow::update_requested, this, [this]() {
+        m_update_requested = true;
+        schedule_frame();
+    });
+    connect(scheduler, &nucleus::tile_scheduler::Scheduler::gpu_quads_complete, this, &BatchRenderer::set_tiles_complete);
+    return true;
+}
+
+void BatchRenderer::enqueue(const Job& job)
+{
+    m_queue.push_back(job);
+}
+
+void BatchRenderer::set_frame_writer(FrameWriter* writer)
+{
+    m_frame_writer = writer;
+}
+
+const BatchRenderer::Statistics& BatchRenderer::statistics() const
+{
+    return m_statistics;
+}
+
+void BatchRenderer::start()
+{
+    m_total_time.start();
+    start_next_job();
+}
+
+void BatchRenderer::start_next_job()
+{
+    if (m_queue.empty()) {
+        m_context->makeCurrent(m_surface);
+        m_capture->collect(true);
+        m_writer_pool.waitForDone();
+        if (m_frame_writer)
+            m_write_failures += m_frame_writer->finish();
+        m_statistics.n_write_failed = m_write_failures;
+        m_statistics.seconds = double(m_total_time.nsecsElapsed()) / 1'000'000'000.0;
+        emit finished(m_statistics);
+        return;
+    }
+    m_current_job = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_current_job->camera.set_viewport_size(m_size);
+
+    m_job_time.start();
+    m_context->makeCurrent(m_surface);
+    if (m_current_job->config)
+        m_window->shared_config_changed(*m_current_job->config);
+    // an unchanged camera doesn't trigger a scheduler update, the last report still holds then
+    m_tiles_complete = m_complete_camera && *m_complete_camera == m_current_job->camera;
+    m_controller->camera_controller()->set_definition(m_current_job->camera);
+    m_timeout_timer.start(int(m_timeout_msecs));
+    schedule_frame();
+}
+
+void BatchRenderer::schedule_frame()
+{
+    if (m_frame_scheduled)
+        return;
+    m_frame_scheduled = true;
+    QTimer::singleShot(0, this, &BatchRenderer::render_frame);
+}
+
+void BatchRenderer::render_frame()
+{
+    m_frame_scheduled = false;
+    if (!m_current_job)
+        return;
+    m_context->makeCurrent(m_surface);
+    m_update_requested = false;
+    m_window->paint(m_framebuffer.get());
+    // the frame is final once all quads are on the gpu and it didn't ask for another one (uploads, shader compilation)
+    if (m_tiles_complete && !m_update_requested)
+        finish_job(true);
+}
+
+void BatchRenderer::finish_job(bool complete)
+{
+    m_timeout_timer.stop();
+    const auto output = m_current_job->output;
+    // the image arrives a few jobs later, the gpu isn't stalled by the readback
+    m_capture_outputs[m_next_capture_tag] = output;
+    m_capture->capture(m_framebuffer->handle(), m_size, m_next_capture_tag++);
+    ++m_statistics.n_done;
+    if (!complete)
+        ++m_statistics.n_timed_out;
+    m_statistics.n_write_failed = m_write_failures;
+    emit job_finished(output, double(m_job_time.nsecsElapsed()) / 1'000'000.0, complete);
+    m_current_job.reset();
+    QTimer::singleShot(0, this, &BatchRenderer::start_next_job);
+}
+
+void BatchRenderer::write_frame(QImage image, uint64_t tag)
+{
+    const auto found = m_capture_outputs.find(tag);
+    if (found == m_capture_outputs.end())
+        return;
+    const auto output = found->second;
+    m_capture_outputs.erase(found);
+    if (output.isEmpty()) {
+        if (m_frame_writer)
+            m_frame_writer->write(std::move(image)); // blocks if the encoder is behind
+        return;
+    }
+    m_writer_pool.start([this, image = std::move(image), output]() {
+        if (!image.save(output)) {
+            qWarning() << "BatchRenderer: couldn't write" << output;
+            ++m_write_failures;
+        }
+    });
+}
+
+void BatchRenderer::set_tiles_complete(const nucleus::camera::Definition& camera)
+{
+    m_complete_camera = camera;
+    if (!m_current_job || !(camera == m_current_job->camera))
+        return; // a report for the previous job
+    m_tiles_complete = true;
+    schedule_frame();
+}
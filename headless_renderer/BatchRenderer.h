@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "gl_engine/UniformBufferObjects.h"
+#include "nucleus/camera/Definition.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+namespace gl_engine {
+class FrameCapture;
+class Window;
+}
+class FrameWriter;
+namespace nucleus {
+class Controller;
+}
+
+/// Renders a queue of snapshots without a window. The tile pool, the caches and the shaders are kept between jobs, so that
+/// only the tiles that weren't needed before are loaded and uploaded. A job is rendered once the scheduler reports all quads
+/// of its camera on the gpu and a frame didn't request another one (uploads, shader compilation), or after the timeout.
+/// The images are read back asynchronously (gl_engine::FrameCapture) and written on a thread pool, so that the next job starts
+/// right away. Jobs without output are frames of a recording, they go to the frame writer in order (see set_frame_writer).
+class BatchRenderer : public QObject {
+    Q_OBJECT
+public:
+    struct Job {
+        nucleus::camera::Definition camera;
+        std::optional<gl_engine::uboSharedConfig> config; // keeps the previous config if not set
+        QString output; // empty: a frame of the recording
+    };
+    struct Statistics {
+        unsigned n_done = 0;
+        unsigned n_timed_out = 0; // rendered with missing tiles
+        unsigned n_write_failed = 0;
+        double seconds = 0;
+    };
+
+    BatchRenderer(const glm::uvec2& size, unsigned timeout_msecs);
+    ~BatchRenderer() override;
+
+    // the surface and context need to outlive the renderer
+    bool init(QOpenGLContext* context, QOffscreenSurface* surface);
+    void enqueue(const Job& job);
+    // receives the frames of the jobs without output, in order. must outlive the renderer, or until finished.
+    void set_frame_writer(FrameWriter* writer);
+    [[nodiscard]] const Statistics& statistics() const;
+
+public slots:
+    void start();
+
+signals:
+    void job_finished(const QString& output, double msecs, bool complete);
+    void finished(const Statistics& stats);
+
+private:
+    void start_next_job();
+    void schedule_frame();
+    void render_frame();
+    void finish_job(bool complete);
+    void set_tiles_complete(const nucleus::camera::Definition& camera);
+    void write_frame(QImage image, uint64_t tag);
+
+    glm::uvec2 m_size;
+    unsigned m_timeout_msecs;
+    QOpenGLContext* m_context = nullptr;
+    QOffscreenSurface* m_surface = nullptr;
+    std::unique_ptr<gl_engine::Window> m_window;
+    std::unique_ptr<nucleus::Controller> m_controller;
+    std::unique_ptr<QOpenGLFramebufferObject> m_framebuffer;
+    std::unique_ptr<gl_engine::FrameCapture> m_capture;
+    std::map<uint64_t, QString> m_capture_outputs; // frames in flight, by tag
+    uint64_t m_next_capture_tag = 0;
+    FrameWriter* m_frame_writer = nullptr;
+    std::deque<Job> m_queue;
+    std::optional<Job> m_current_job;
+    std::optional<nucleus::camera::Definition> m_complete_camera; // of the last report of the scheduler
+    bool m_tiles_complete = false;
+    bool m_update_requested = false;
+    bool m_frame_scheduled = false;
+    QTimer m_timeout_timer;
+    QElapsedTimer m_job_time;
+    QElapsedTimer m_total_time;
+    QThreadPool m_writer_pool;
+    std::atomic<unsigned> m_write_failures = 0;
+    Statistics m_statistics;
+};
@@ -0,0 +1,470 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "FlythroughBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QThread>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+// windows.h has to come first
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "gl_engine/GpuMemory.h"
+#include "gl_engine/Window.h"
+#include "nucleus/camera/Controller.h"
+#include "nucleus/tile_scheduler/LayerAssembler.h"
+#include "nucleus/tile_scheduler/PackTileSource.h"
+#include "nucleus/tile_scheduler/QuadAssembler.h"
+#include "nucleus/tile_scheduler/TileLoadService.h"
+
+namespace {
+QJsonObject percentiles(std::vector<float> values)
+{
+    QJsonObject json;
+    json["n"] = qint64(values.size());
+    if (values.empty())
+        return json;
+    std::sort(values.begin(), values.end());
+    const auto at = [&values](double percentile) { return double(values[std::min(values.size() - 1, size_t(percentile * double(values.size())))]); };
+    json["mean"] = std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+    json["p50"] = at(0.50);
+    json["p90"] = at(0.90);
+    json["p95"] = at(0.95);
+    json["p99"] = at(0.99);
+    json["max"] = double(values.back());
+    return json;
+}
+
+// high water mark of the resident set size, nullopt if unknown on the platform
+std::optional<uint64_t> peak_resident_bytes()
+{
+#if defined(__linux__)
+    QFile status("/proc/self/status");
+    if (!status.open(QIODeviceBase::ReadOnly | QIODeviceBase::Text))
+        return {};
+    while (!status.atEnd()) {
+        const auto line = status.readLine();
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toULongLong() * 1024; // kB
+    }
+    return {};
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return {};
+    return uint64_t(counters.PeakWorkingSetSize);
+#elif defined(__APPLE__)
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return {};
+    return uint64_t(usage.ru_maxrss); // bytes on macos
+#else
+    return {};
+#endif
+}
+
+// current resident set size, nullopt if unknown on the platform
+std::optional<uint64_t> resident_bytes()
+{
+#if defined(__linux__)
+    QFile status("/proc/self/status");
+    if (!status.open(QIODeviceBase::ReadOnly | QIODeviceBase::Text))
+        return {};
+    while (!status.atEnd()) {
+        const auto line = status.readLine();
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toULongLong() * 1024; // kB
+    }
+    return {};
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return {};
+    return uint64_t(counters.WorkingSetSize);
+#else
+    return {};
+#endif
+}
+
+// the assemblers live on the network thread (if threading is enabled)
+template <typename Assembler> qint64 n_items_in_flight(Assembler* assembler)
+{
+    if (!assembler)
+        return 0;
+    if (assembler->thread() == QThread::currentThread())
+        return qint64(assembler->n_items_in_flight());
+    size_t n = 0;
+    QMetaObject::invokeMethod(assembler, [assembler]() { return assembler->n_items_in_flight(); }, Qt::BlockingQueuedConnection, &n);
+    return qint64(n);
+}
+} // namespace
+
+FlythroughBenchmark::FlythroughBenchmark(const glm::uvec2& size, unsigned settle_timeout_msecs)
+    : m_size(size)
+    , m_settle_timeout_msecs(settle_timeout_msecs)
+{
+    m_settle_timeout.setSingleShot(true);
+    connect(&m_settle_timeout, &QTimer::timeout, this, [this]() { finish_settling(false); });
+    connect(&m_soak_report_timer, &QTimer::timeout, this, &FlythroughBenchmark::emit_soak_report);
+}
+
+FlythroughBenchmark::~FlythroughBenchmark()
+{
+    if (!m_window)
+        return;
+    m_context->makeCurrent(m_surface);
+    m_framebuffer.reset();
+    m_window->deinit_gpu();
+    m_controller.reset();
+    m_window.reset();
+}
+
+bool FlythroughBenchmark::init(QOpenGLContext* context, QOffscreenSurface* surface, const nucleus::Controller::LocalTileSources& local_sources)
+{
+    m_context = context;
+    m_surface = surface;
+    if (!m_context->makeCurrent(m_surface))
+        return false;
+
+    m_window = std::make_unique<gl_engine::Window>();
+    m_controller = std::make_unique<nucleus::Controller>(m_window.get(), local_sources);
+    auto* scheduler = m_controller->tile_scheduler();
+    scheduler->set_ortho_tile_compression_algorithm(m_window->ortho_tile_compression_algorithm());
+    scheduler->set_ortho_tile_mip_levels(m_window->ortho_tile_mip_levels());
+    // the camera moves every frame, the scheduler shouldn't wait for it to rest
+    QMetaObject::invokeMethod(scheduler, [scheduler]() { scheduler->set_update_timeout(10); });
+    m_window->initialise_gpu();
+    m_window->resize_framebuffer(int(m_size.x), int(m_size.y));
+    m_framebuffer = std::make_unique<QOpenGLFramebufferObject>(int(m_size.x), int(m_size.y), QOpenGLFramebufferObject::CombinedDepthStencil);
+    m_measurements = m_window->measurement_snapshot();
+    m_measurements->set_enabled(true);
+
+    connect(m_window.get(), &nucleus::AbstractRenderWindow::update_requested, this, [this]() {
+        m_update_requested = true;
+        if (m_phase == Phase::Settling)
+            schedule_frame();
+    });
+    connect(scheduler, &nucleus::tile_scheduler::Scheduler::gpu_quads_complete, this, &FlythroughBenchmark::set_tiles_complete);
+    connect(scheduler, &nucleus::tile_scheduler::Scheduler::statistics_updated, this, [this](const nucleus::tile_scheduler::Scheduler::Statistics& statistics) {
+        m_scheduler_statistics = statistics;
+    });
+
+    const auto record = [this](nucleus::tile_scheduler::TileLoadService* service, const char* layer) {
+        if (!service)
+            return;
+        // direct, on the network thread
+        connect(service, &nucleus::tile_scheduler::TileLoadService::load_finished, service, [this, layer](const nucleus::tile_scheduler::tile_types::TileLayer& tile) { record_tile(tile, layer); });
+    };
+    record(m_controller->height_service(), "height");
+    record(m_controller->ortho_service(), "ortho");
+    record(m_controller->label_service(), "labels");
+    return true;
+}
+
+void FlythroughBenchmark::set_path(std::vector<Waypoint> path) { m_path = std::move(path); }
+
+void FlythroughBenchmark::set_recording(bool enabled) { m_recording = enabled; }
+
+void FlythroughBenchmark::set_soak(unsigned seconds, unsigned report_interval_seconds)
+{
+    m_soak_seconds = seconds;
+    m_soak_report_timer.setInterval(std::chrono::seconds(std::max(1u, report_interval_seconds)));
+}
+
+void FlythroughBenchmark::record_tile(const nucleus::tile_scheduler::tile_types::TileLayer& tile, const char* layer)
+{
+    using Status = nucleus::tile_scheduler::tile_types::NetworkInfo::Status;
+    if (!m_recording || tile.network_info.status != Status::Good || !tile.data || tile.data->isEmpty())
+        return;
+    std::scoped_lock lock(m_recording_mutex);
+    m_recorded_tiles[layer].emplace_back(tile.id, *tile.data);
+}
+
+tl::expected<void, std::string> FlythroughBenchmark::write_recording(const std::filesystem::path& directory) const
+{
+    std::scoped_lock lock(m_recording_mutex);
+    for (const auto& [layer, tiles] : m_recorded_tiles) {
+        const auto r = nucleus::tile_scheduler::PackTileSource::write(directory / layer, tiles);
+        if (!r.has_value())
+            return tl::unexpected(fmt::format("{}: {}", layer, r.error()));
+    }
+    return {};
+}
+
+nucleus::camera::Definition FlythroughBenchmark::interpolate(const nucleus::camera::Definition& from, const nucleus::camera::Definition& to, double t)
+{
+    return nucleus::camera::interpolate(from, to, t);
+}
+
+void FlythroughBenchmark::start()
+{
+    m_total_time.start();
+    m_running = true;
+    m_waypoint = 0;
+    if (m_soak_seconds > 0)
+        m_soak_report_timer.start();
+    start_segment();
+}
+
+void FlythroughBenchmark::start_segment()
+{
+    if (m_waypoint >= m_path.size() && m_soak_seconds > 0 && m_total_time.elapsed() < qint64(m_soak_seconds) * 1000)
+        m_waypoint = 0; // again, jumping to the first waypoint
+    if (m_waypoint >= m_path.size()) {
+        if (m_soak_seconds > 0) {
+            m_soak_report_timer.stop();
+            emit_soak_report(); // the remainder of the last interval
+        }
+        m_running = false;
+        m_seconds = double(m_total_time.nsecsElapsed()) / 1'000'000'000.0;
+        emit finished();
+        return;
+    }
+    m_flight_frame = 0;
+    m_result_open = false;
+    // the first waypoint is a jump
+    m_phase = m_waypoint > 0 && m_path[m_waypoint].flight_frames > 0 ? Phase::Flying : Phase::Settling;
+    if (m_phase == Phase::Settling) {
+        m_camera = m_path[m_waypoint].camera;
+        m_camera.set_viewport_size(m_size);
+        // an unchanged camera doesn't trigger a scheduler update, the last report still holds then
+        m_tiles_complete = m_complete_camera && *m_complete_camera == m_camera;
+        m_controller->camera_controller()->set_definition(m_camera);
+        m_settle_time.start();
+        m_settle_timeout.start(int(m_settle_timeout_msecs));
+    }
+    schedule_frame();
+}
+
+void FlythroughBenchmark::schedule_frame()
+{
+    if (m_frame_scheduled || !m_running)
+        return;
+    m_frame_scheduled = true;
+    // through the event loop, so that the tiles and the scheduler reports are delivered between the frames
+    QTimer::singleShot(0, this, &FlythroughBenchmark::render_frame);
+}
+
+void FlythroughBenchmark::paint()
+{
+    m_context->makeCurrent(m_surface);
+    m_update_requested = false;
+    ++m_n_frames;
+    m_window->paint(m_framebuffer.get());
+    m_context->functions()->glFinish(); // the frame time includes the gpu
+    sample_measurements();
+}
+
+void FlythroughBenchmark::render_frame()
+{
+    m_frame_scheduled = false;
+    if (!m_running)
+        return;
+    if (m_phase == Phase::Flying) {
+        const auto& waypoint = m_path[m_waypoint];
+        ++m_flight_frame;
+        m_camera = interpolate(m_path[m_waypoint - 1].camera, waypoint.camera, double(m_flight_frame) / double(waypoint.flight_frames));
+        m_camera.set_viewport_size(m_size);
+        m_controller->camera_controller()->set_definition(m_camera);
+        const auto start = std::chrono::steady_clock::now();
+        paint();
+        m_flight_frame_msecs.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (m_flight_frame < waypoint.flight_frames) {
+            schedule_frame();
+            return;
+        }
+        // arrived, from here on the frames are rendered on demand (uploads, shader compilation, tiles)
+        m_phase = Phase::Settling;
+        m_tiles_complete = m_complete_camera && *m_complete_camera == m_camera;
+        m_settle_time.start();
+        m_settle_timeout.start(int(m_settle_timeout_msecs));
+        schedule_frame();
+        return;
+    }
+    paint();
+    ++current_result().settle_frames;
+    // the frame is final once all quads are on the gpu and it didn't ask for another one
+    if (m_tiles_complete && !m_update_requested)
+        finish_settling(true);
+}
+
+void FlythroughBenchmark::finish_settling(bool complete)
+{
+    if (!m_running || m_phase != Phase::Settling)
+        return;
+    m_settle_timeout.stop();
+    if (!complete)
+        paint(); // the frame with the tiles available now
+    auto& result = current_result();
+    result.msecs_to_full_detail = double(m_settle_time.nsecsElapsed()) / 1'000'000.0;
+    result.complete = complete;
+    emit waypoint_reached(QString::fromStdString(result.name), result.msecs_to_full_detail, complete);
+    ++m_waypoint;
+    QTimer::singleShot(0, this, &FlythroughBenchmark::start_segment);
+}
+
+FlythroughBenchmark::WaypointResult& FlythroughBenchmark::current_result()
+{
+    if (!m_result_open) {
+        m_waypoint_results.push_back({ m_path[m_waypoint].name });
+        m_result_open = true;
+    }
+    return m_waypoint_results.back();
+}
+
+void FlythroughBenchmark::set_tiles_complete(const nucleus::camera::Definition& camera)
+{
+    m_complete_camera = camera;
+    if (m_phase != Phase::Settling || !(camera == m_camera))
+        return; // a report for a camera of the flight
+    m_tiles_complete = true;
+    schedule_frame();
+}
+
+void FlythroughBenchmark::sample_measurements()
+{
+    const auto infos = m_measurements->timers();
+    if (m_measurements->read(m_snapshot)) {
+        m_timer_counts.resize(m_snapshot.n_timers, 0);
+        for (unsigned i = 0; i < m_snapshot.n_timers && i < infos.size(); ++i) {
+            const auto& entry = m_snapshot.entries[i];
+            if (entry.count <= m_timer_counts[i])
+                continue;
+            m_timer_counts[i] = entry.count;
+            m_timer_samples[infos[i].group + "/" + infos[i].name].push_back(entry.last);
+        }
+    }
+    m_peak_gpu_bytes = std::max(m_peak_gpu_bytes, gl_engine::gpu_memory::total_bytes());
+    if (const auto driver = gl_engine::gpu_memory::driver_info(); driver && driver->total_bytes)
+        m_peak_driver_used_bytes = std::max(m_peak_driver_used_bytes.value_or(0), *driver->total_bytes - driver->available_bytes);
+}
+
+QJsonObject FlythroughBenchmark::result() const
+{
+    QJsonObject json;
+    json["size"] = QJsonArray { int(m_size.x), int(m_size.y) };
+    json["seconds"] = m_seconds;
+    json["renderer"] = QString::fromLatin1(reinterpret_cast<const char*>(m_context->functions()->glGetString(GL_RENDERER)));
+    json["flight_frame_msecs"] = percentiles(m_flight_frame_msecs);
+
+    QJsonObject timers;
+    for (const auto& [name, samples] : m_timer_samples)
+        timers[QString::fromStdString(name)] = percentiles(samples);
+    json["timers"] = timers;
+
+    QJsonArray waypoints;
+    for (const auto& result : m_waypoint_results) {
+        waypoints.append(QJsonObject {
+            { "name", QString::fromStdString(result.name) },
+            { "msecs_to_full_detail", result.msecs_to_full_detail },
+            { "settle_frames", int(result.settle_frames) },
+            { "complete", result.complete },
+        });
+    }
+    json["waypoints"] = waypoints;
+
+    QJsonObject memory;
+    if (const auto rss = peak_resident_bytes())
+        memory["peak_resident_bytes"] = qint64(*rss);
+    memory["peak_gpu_bytes"] = qint64(m_peak_gpu_bytes);
+    if (m_peak_driver_used_bytes)
+        memory["peak_driver_gpu_bytes"] = qint64(*m_peak_driver_used_bytes);
+    json["memory"] = memory;
+    return json;
+}
+
+void FlythroughBenchmark::emit_soak_report()
+{
+    QJsonObject report;
+    report["report"] = int(m_n_soak_reports++);
+    report["seconds"] = double(m_total_time.nsecsElapsed()) / 1'000'000'000.0;
+    report["frames"] = qint64(m_n_frames);
+    report["flight_frame_msecs"] = percentiles(m_flight_frame_msecs);
+
+    QJsonObject timers;
+    for (const auto& [name, samples] : m_timer_samples)
+        timers[QString::fromStdString(name)] = percentiles(samples);
+    report["timers"] = timers;
+
+    std::vector<float> msecs_to_full_detail;
+    unsigned n_timeouts = 0;
+    const auto n_finished = m_waypoint_results.size() - (m_result_open ? 1 : 0);
+    for (size_t i = 0; i < n_finished; ++i) {
+        msecs_to_full_detail.push_back(float(m_waypoint_results[i].msecs_to_full_detail));
+        n_timeouts += m_waypoint_results[i].complete ? 0 : 1;
+    }
+    report["msecs_to_full_detail"] = percentiles(msecs_to_full_detail);
+    report["settle_timeouts"] = int(n_timeouts);
+
+    QJsonObject memory;
+    if (const auto rss = resident_bytes())
+        memory["resident_bytes"] = qint64(*rss);
+    if (const auto rss = peak_resident_bytes())
+        memory["peak_resident_bytes"] = qint64(*rss);
+    memory["gpu_bytes"] = qint64(gl_engine::gpu_memory::total_bytes());
+    QJsonObject gpu_subsystems;
+    for (const auto& usage : gl_engine::gpu_memory::usage())
+        gpu_subsystems[QString::fromStdString(usage.subsystem)] = qint64(usage.n_bytes);
+    memory["gpu_subsystems"] = gpu_subsystems;
+    if (const auto driver = gl_engine::gpu_memory::driver_info()) {
+        memory["driver_gpu_available_bytes"] = qint64(driver->available_bytes);
+        if (driver->total_bytes)
+            memory["driver_gpu_used_bytes"] = qint64(*driver->total_bytes - driver->available_bytes);
+    }
+    report["memory"] = memory;
+
+    const auto& statistics = m_scheduler_statistics;
+    report["caches"] = QJsonObject {
+        { "ram_tiles", int(statistics.n_tiles_in_ram_cache) },
+        { "ram_bytes", qint64(statistics.n_bytes_in_ram_cache) },
+        { "gpu_tiles", int(statistics.n_tiles_in_gpu_cache) },
+        { "gpu_bytes", qint64(statistics.n_bytes_in_gpu_cache) },
+    };
+    report["persist"] = QJsonObject {
+        { "n", int(statistics.n_persists) },
+        { "last_msecs", double(statistics.last_persist_msecs) },
+        { "max_msecs", double(statistics.max_persist_msecs) },
+    };
+    report["in_flight"] = QJsonObject {
+        { "request_slots", int(statistics.n_request_slots) },
+        { "quad_assembler", n_items_in_flight(m_controller->quad_assembler()) },
+        { "layer_assembler", n_items_in_flight(m_controller->layer_assembler()) },
+    };
+
+    // the next interval starts empty, the memory of the benchmark itself must not grow over a soak
+    m_flight_frame_msecs.clear();
+    m_timer_samples.clear();
+    m_waypoint_results.erase(m_waypoint_results.begin(), m_waypoint_results.begin() + std::ptrdiff_t(n_finished));
+    emit soak_report(report);
+}
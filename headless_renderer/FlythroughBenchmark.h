@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QTimer>
+#include <tl/expected.hpp>
+
+#include "nucleus/Controller.h"
+#include "nucleus/camera/Definition.h"
+#include "nucleus/tile_scheduler/Scheduler.h"
+#include "nucleus/tile_scheduler/tile_types.h"
+#include "nucleus/timing/MeasurementSnapshot.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+namespace gl_engine {
+class Window;
+}
+
+/// Flies a camera along a path of waypoints without a window and measures the renderer, for comparisons across commits and
+/// devices. The camera advances by a fixed number of frames per segment (not by wall time), so every run renders the same
+/// cameras. At every waypoint, it waits until all quads are on the gpu and the frames are final (time to full detail).
+/// With local tile sources (a fixture recorded with set_recording), the loading doesn't depend on the network.
+/// The result is json: frame time percentiles of the flight, the gpu / cpu timers per pass, the time to full detail per
+/// waypoint and the peak ram and gpu memory.
+/// In soak mode (set_soak), the path is flown in a loop for the given time and a report is emitted periodically, to find
+/// leaks and cache churn over hours. The measurements of an interval are dropped after its report, memory stays bounded.
+class FlythroughBenchmark : public QObject {
+    Q_OBJECT
+public:
+    struct Waypoint {
+        nucleus::camera::Definition camera;
+        std::string name;
+        unsigned flight_frames = 0; // from the previous waypoint to this one, 0 jumps
+    };
+
+    FlythroughBenchmark(const glm::uvec2& size, unsigned settle_timeout_msecs);
+    ~FlythroughBenchmark() override;
+
+    // the surface and context need to outlive the benchmark. local_sources empty: tiles are loaded from the servers.
+    bool init(QOpenGLContext* context, QOffscreenSurface* surface, const nucleus::Controller::LocalTileSources& local_sources);
+    void set_path(std::vector<Waypoint> path);
+    // collects the tiles that were loaded from the servers, see write_recording
+    void set_recording(bool enabled);
+    // loops the path until seconds have passed (checked at the waypoints), soak_report every report_interval_seconds
+    void set_soak(unsigned seconds, unsigned report_interval_seconds);
+    // writes the recorded tiles as a fixture (one PackTileSource per layer: height, ortho, labels in directory)
+    [[nodiscard]] tl::expected<void, std::string> write_recording(const std::filesystem::path& directory) const;
+
+    [[nodiscard]] QJsonObject result() const;
+    // valid after init, e.g., for recording the responses of the load services
+    [[nodiscard]] nucleus::Controller* controller() const { return m_controller.get(); }
+
+    // camera between two waypoints, t in [0, 1]: the position is interpolated linearly, the view direction spherically
+    [[nodiscard]] static nucleus::camera::Definition interpolate(const nucleus::camera::Definition& from, const nucleus::camera::Definition& to, double t);
+
+public slots:
+    void start();
+
+signals:
+    void waypoint_reached(const QString& name, double msecs_to_full_detail, bool complete);
+    void soak_report(const QJsonObject& report);
+    void finished();
+
+private:
+    enum class Phase { Flying, Settling };
+    struct WaypointResult {
+        std::string name;
+        double msecs_to_full_detail = 0;
+        unsigned settle_frames = 0;
+        bool complete = false; // false if timed out
+    };
+
+    void schedule_frame();
+    void render_frame();
+    void paint();
+    void start_segment();
+    void finish_settling(bool complete);
+    void set_tiles_complete(const nucleus::camera::Definition& camera);
+    void sample_measurements();
+    void record_tile(const nucleus::tile_scheduler::tile_types::TileLayer& tile, const char* layer);
+    void emit_soak_report();
+    WaypointResult& current_result(); // of the current segment, created on first use
+
+    glm::uvec2 m_size;
+    unsigned m_settle_timeout_msecs;
+    QOpenGLContext* m_context = nullptr;
+    QOffscreenSurface* m_surface = nullptr;
+    std::unique_ptr<gl_engine::Window> m_window;
+    std::unique_ptr<nucleus::Controller> m_controller;
+    std::unique_ptr<QOpenGLFramebufferObject> m_framebuffer;
+    nucleus::timing::MeasurementSnapshotPtr m_measurements;
+
+    std::vector<Waypoint> m_path;
+    size_t m_waypoint = 0; // target of the current segment
+    unsigned m_flight_frame = 0;
+    Phase m_phase = Phase::Settling;
+    nucleus::camera::Definition m_camera;
+    std::optional<nucleus::camera::Definition> m_complete_camera; // of the last report of the scheduler
+    bool m_tiles_complete = false;
+    bool m_update_requested = false;
+    bool m_frame_scheduled = false;
+    bool m_running = false;
+    bool m_result_open = false; // m_waypoint_results.back() belongs to the current segment
+    QTimer m_settle_timeout;
+    QElapsedTimer m_settle_time;
+    QElapsedTimer m_total_time;
+    double m_seconds = 0;
+
+    // results
+    std::vector<float> m_flight_frame_msecs;
+    std::vector<WaypointResult> m_waypoint_results;
+    nucleus::timing::MeasurementSnapshot::Snapshot m_snapshot;
+    std::vector<uint64_t> m_timer_counts; // of the previous sample, per timer
+    std::map<std::string, std::vector<float>> m_timer_samples; // "group/name" -> msecs
+    uint64_t m_peak_gpu_bytes = 0; // own allocations, see gl_engine::gpu_memory
+    std::optional<uint64_t> m_peak_driver_used_bytes;
+
+    // soak mode
+    unsigned m_soak_seconds = 0;
+    QTimer m_soak_report_timer;
+    unsigned m_n_soak_reports = 0;
+    uint64_t m_n_frames = 0;
+    nucleus::tile_scheduler::Scheduler::Statistics m_scheduler_statistics; // the latest
+
+    std::atomic<bool> m_recording = false;
+    mutable std::mutex m_recording_mutex; // the tiles arrive on the network thread
+    std::map<std::string, std::vector<std::pair<tile::Id, QByteArray>>> m_recorded_tiles; // per layer
+};
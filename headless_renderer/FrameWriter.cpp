@@ -0,0 +1,173 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "FrameWriter.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QThread>
+
+FrameWriter::FrameWriter(Settings settings)
+    : m_settings(std::move(settings))
+{
+}
+
+FrameWriter::~FrameWriter() { finish(); }
+
+bool FrameWriter::is_image_sequence(const QString& output) { return output.contains('#'); }
+
+QString FrameWriter::image_path(const QString& pattern, unsigned frame)
+{
+    static const QRegularExpression placeholder("#+");
+    const auto match = placeholder.match(pattern);
+    if (!match.hasMatch())
+        return pattern;
+    auto path = pattern;
+    return path.replace(match.capturedStart(), match.capturedLength(), QString::number(frame).rightJustified(match.capturedLength(), '0'));
+}
+
+bool FrameWriter::start(const glm::uvec2& size)
+{
+    finish();
+    m_size = size;
+    m_stop = false;
+    m_n_written = 0;
+    m_n_failed = 0;
+    m_started.reset();
+    if (is_image_sequence(m_settings.output))
+        QDir().mkpath(QFileInfo(image_path(m_settings.output, 0)).absolutePath());
+    // ffmpeg is started on the thread, QProcess must be used on the thread that created it
+    m_thread.reset(QThread::create([this]() { run(); }));
+    m_thread->setObjectName("frame writer");
+    m_thread->start();
+    std::unique_lock lock(m_mutex);
+    m_changed.wait(lock, [this]() { return m_started.has_value(); });
+    if (*m_started)
+        return true;
+    lock.unlock();
+    m_thread->wait();
+    m_thread.reset();
+    return false;
+}
+
+void FrameWriter::write(QImage frame)
+{
+    if (!m_thread)
+        return;
+    std::unique_lock lock(m_mutex);
+    m_changed.wait(lock, [this]() { return m_queue.size() < std::max(m_settings.max_pending, 1u); });
+    m_queue.push_back(std::move(frame));
+    m_changed.notify_all();
+}
+
+unsigned FrameWriter::finish()
+{
+    if (!m_thread)
+        return m_n_failed;
+    {
+        const std::scoped_lock lock(m_mutex);
+        m_stop = true;
+        m_changed.notify_all();
+    }
+    m_thread->wait();
+    m_thread.reset();
+    return m_n_failed;
+}
+
+void FrameWriter::run()
+{
+    auto started = true;
+    if (!is_image_sequence(m_settings.output)) {
+        m_ffmpeg = std::make_unique<QProcess>();
+        auto arguments = QStringList { "-y", "-loglevel", "error", "-f", "rawvideo", "-pix_fmt", "rgba", "-s",
+            QString("%1x%2").arg(m_size.x).arg(m_size.y), "-r", QString::number(m_settings.fps), "-i", "-" };
+        arguments << m_settings.ffmpeg_arguments << m_settings.output;
+        m_ffmpeg->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        m_ffmpeg->start(m_settings.ffmpeg, arguments);
+        started = m_ffmpeg->waitForStarted();
+        if (!started) {
+            qWarning() << "FrameWriter: couldn't start" << m_settings.ffmpeg << m_ffmpeg->errorString();
+            m_ffmpeg.reset();
+        }
+    }
+    {
+        const std::scoped_lock lock(m_mutex);
+        m_started = started;
+        m_changed.notify_all();
+    }
+    if (!started)
+        return;
+
+    while (true) {
+        QImage frame;
+        {
+            std::unique_lock lock(m_mutex);
+            m_changed.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+                break; // stopped, and all frames are written
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_changed.notify_all(); // room for the next one
+        }
+        if (!write_frame(frame, m_n_written))
+            ++m_n_failed;
+        ++m_n_written;
+    }
+    if (m_ffmpeg) {
+        m_ffmpeg->closeWriteChannel();
+        m_ffmpeg->waitForFinished(-1);
+        if (m_ffmpeg->exitStatus() != QProcess::NormalExit || m_ffmpeg->exitCode() != 0) {
+            qWarning() << "FrameWriter: ffmpeg failed with exit code" << m_ffmpeg->exitCode();
+            m_n_failed = std::max(m_n_failed, 1u);
+        }
+        m_ffmpeg.reset();
+    }
+}
+
+bool FrameWriter::write_frame(const QImage& frame, unsigned index)
+{
+    if (frame.size() != QSize(int(m_size.x), int(m_size.y)))
+        return false;
+    if (!m_ffmpeg) {
+        QImageWriter writer(image_path(m_settings.output, index));
+        writer.setQuality(m_settings.quality);
+        if (!writer.write(frame)) {
+            qWarning() << "FrameWriter: couldn't write" << writer.fileName() << writer.errorString();
+            return false;
+        }
+        return true;
+    }
+    const auto rgba = frame.convertToFormat(QImage::Format_RGBA8888); // no copy if it is already
+    for (int y = 0; y < rgba.height(); ++y) {
+        const auto* line = reinterpret_cast<const char*>(rgba.constScanLine(y));
+        if (m_ffmpeg->write(line, qint64(m_size.x) * 4) < 0)
+            return false;
+    }
+    // the pipe's buffer in QProcess would grow without bound otherwise
+    while (m_ffmpeg->bytesToWrite() > 0) {
+        if (!m_ffmpeg->waitForBytesWritten(-1))
+            return false;
+    }
+    return true;
+}
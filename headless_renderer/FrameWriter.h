@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <glm/glm.hpp>
+
+class QProcess;
+class QThread;
+
+/// Writes the frames of a recording on a thread of its own, either as numbered images or piped into ffmpeg as raw video.
+/// write() blocks while max_pending frames are queued, so that a slow encoder slows the rendering down instead of dropping
+/// frames (the recordings are rendered with a fixed time step, they don't need to keep up with the wall clock).
+class FrameWriter {
+public:
+    struct Settings {
+        // a run of # is replaced by the zero padded frame number (image sequence, e.g., "frames/#####.png", the format by the
+        // suffix). without #, the frames are piped into ffmpeg, which writes the video file (e.g., "flight.mp4").
+        QString output;
+        unsigned fps = 60;
+        int quality = -1; // of the images, see QImageWriter::setQuality
+        QString ffmpeg = "ffmpeg";
+        QStringList ffmpeg_arguments = { "-c:v", "libx264", "-pix_fmt", "yuv420p", "-crf", "18" }; // output options
+        unsigned max_pending = 8;
+    };
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+    explicit FrameWriter(Settings settings);
+    ~FrameWriter(); // finishes
+
+    [[nodiscard]] static bool is_image_sequence(const QString& output);
+    // the file of a frame of an image sequence
+    [[nodiscard]] static QString image_path(const QString& pattern, unsigned frame);
+
+    // frames must have the size given to start. false if ffmpeg couldn't be started.
+    bool start(const glm::uvec2& size);
+    void write(QImage frame);
+    // waits until all frames are written (and ffmpeg exited). returns the number of frames that couldn't be written.
+    unsigned finish();
+
+private:
+    void run();
+    bool write_frame(const QImage& frame, unsigned index);
+
+    Settings m_settings;
+    glm::uvec2 m_size = {};
+    std::unique_ptr<QThread> m_thread;
+    std::unique_ptr<QProcess> m_ffmpeg; // created and destroyed on m_thread
+    std::optional<bool> m_started; // set by the thread
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<QImage> m_queue;
+    unsigned m_n_written = 0;
+    unsigned m_n_failed = 0;
+    bool m_stop = false;
+};
@@ -0,0 +1,398 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <iostream>
+#include <random>
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QThread>
+#include <QTimer>
+#include <fmt/format.h>
+
+#include "FlythroughBenchmark.h"
+#include "nucleus/camera/Controller.h"
+#include "nucleus/camera/PositionStorage.h"
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/NetworkRecording.h"
+#include "nucleus/tile_scheduler/NetworkReplay.h"
+#include "nucleus/tile_scheduler/PackTileSource.h"
+#include "nucleus/tile_scheduler/Scheduler.h"
+#include "nucleus/tile_scheduler/TileLoadService.h"
+
+namespace {
+std::optional<glm::dvec3> parse_lat_long_alt(const QJsonValue& value)
+{
+    const auto array = value.toArray();
+    if (array.size() != 3)
+        return {};
+    return glm::dvec3(array[0].toDouble(), array[1].toDouble(), array[2].toDouble());
+}
+
+// one json object per line:
+// {"camera": "grossglockner"}
+// {"name": "shadow side", "position": [lat, long, alt], "look_at": [lat, long, alt], "field_of_view": 60, "frames": 240}
+// {"name": "schneeberg", "fly_to": [lat, long, alt]} (the end camera of camera::Controller::fly_to_latitude_longitude)
+// frames is the number of frames of the flight from the previous waypoint (0 jumps, the first waypoint is always a jump).
+std::optional<FlythroughBenchmark::Waypoint> parse_waypoint(const QByteArray& line, const nucleus::camera::Definition& previous, QString* error)
+{
+    QJsonParseError parse_error;
+    const auto json = QJsonDocument::fromJson(line, &parse_error).object();
+    if (parse_error.error != QJsonParseError::NoError) {
+        *error = parse_error.errorString();
+        return {};
+    }
+    FlythroughBenchmark::Waypoint waypoint;
+    if (json.contains("camera")) {
+        waypoint.name = json.value("camera").toString().toStdString();
+        waypoint.camera = nucleus::camera::PositionStorage::instance()->get(waypoint.name);
+    } else if (json.contains("fly_to")) {
+        const auto look_at = parse_lat_long_alt(json.value("fly_to"));
+        if (!look_at) {
+            *error = "fly_to needs [lat, long, alt]";
+            return {};
+        }
+        waypoint.camera = nucleus::camera::Controller::fly_to_target(previous, nucleus::srs::lat_long_alt_to_world(*look_at));
+    } else {
+        const auto position = parse_lat_long_alt(json.value("position"));
+        const auto look_at = parse_lat_long_alt(json.value("look_at"));
+        if (!position || !look_at) {
+            *error = "either camera or position and look_at are required";
+            return {};
+        }
+        waypoint.camera = nucleus::camera::Definition(nucleus::srs::lat_long_alt_to_world(*position), nucleus::srs::lat_long_alt_to_world(*look_at));
+    }
+    if (json.contains("name"))
+        waypoint.name = json.value("name").toString().toStdString();
+    if (json.contains("field_of_view"))
+        waypoint.camera.set_field_of_view(float(json.value("field_of_view").toDouble()));
+    waypoint.flight_frames = unsigned(std::max(0, json.value("frames").toInt(240)));
+    return waypoint;
+}
+
+std::vector<FlythroughBenchmark::Waypoint> default_path()
+{
+    const auto storage = nucleus::camera::PositionStorage::instance();
+    std::vector<FlythroughBenchmark::Waypoint> path;
+    for (const auto* name : { "grossglockner", "grossglockner_shadow", "grossglockner_topdown", "grossglockner" })
+        path.push_back({ storage->get(name), name, 240 });
+    return path;
+}
+
+// for soak runs: flights between random points in the alps and the stored positions, reproducible with the seed.
+// the path is looped, so a few hundred waypoints make for enough variety.
+std::vector<FlythroughBenchmark::Waypoint> random_path(unsigned seed, unsigned n_waypoints)
+{
+    const auto storage = nucleus::camera::PositionStorage::instance();
+    const auto stored = std::array { "grossglockner", "grossglockner_topdown", "schneeberg", "karwendel", "weichtalhaus", "hochgrubach_spitze", "wien" };
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> latitude(46.4, 47.8);
+    std::uniform_real_distribution<double> longitude(9.5, 16.5);
+    std::uniform_real_distribution<double> altitude(500, 3000);
+    std::uniform_int_distribution<unsigned> frames(120, 600);
+    std::uniform_int_distribution<size_t> stored_index(0, stored.size() - 1);
+    std::vector<FlythroughBenchmark::Waypoint> path;
+    path.push_back({ storage->get("grossglockner"), "grossglockner", 0 });
+    for (unsigned i = 1; i < n_waypoints; ++i) {
+        // mostly random places (cold tiles, cache churn), now and then a known place (hopefully still cached)
+        if (rng() % 4 == 0) {
+            const auto* name = stored[stored_index(rng)];
+            path.push_back({ storage->get(name), name, frames(rng) });
+            continue;
+        }
+        const auto target = glm::dvec3(latitude(rng), longitude(rng), altitude(rng));
+        const auto camera = nucleus::camera::Controller::fly_to_target(path.back().camera, nucleus::srs::lat_long_alt_to_world(target));
+        path.push_back({ camera, fmt::format("random {:.4f} {:.4f}", target.x, target.y), frames(rng) });
+    }
+    return path;
+}
+
+tl::expected<nucleus::Controller::LocalTileSources, std::string> open_fixture(const std::filesystem::path& directory)
+{
+    using nucleus::tile_scheduler::PackTileSource;
+    const auto open = [&directory](const char* layer) -> tl::expected<std::shared_ptr<PackTileSource>, std::string> {
+        auto source = std::make_shared<PackTileSource>(directory / layer);
+        const auto r = source->open();
+        if (!r.has_value())
+            return tl::unexpected(fmt::format("{}: {}", layer, r.error()));
+        return source;
+    };
+    nucleus::Controller::LocalTileSources sources;
+    const auto height = open("height");
+    if (!height.has_value())
+        return tl::unexpected(height.error());
+    const auto ortho = open("ortho");
+    if (!ortho.has_value())
+        return tl::unexpected(ortho.error());
+    sources.height = *height;
+    sources.ortho = *ortho;
+    if (const auto labels = open("labels"); labels.has_value())
+        sources.labels = *labels; // optional
+    return sources;
+}
+
+constexpr std::array<const char*, 3> network_layers = { "height", "ortho", "labels" };
+
+std::optional<nucleus::tile_scheduler::NetworkProfile> network_profile(const QString& name)
+{
+    using nucleus::tile_scheduler::NetworkProfile;
+    for (const auto& profile : { NetworkProfile::recorded(), NetworkProfile::lte(), NetworkProfile::dsl(), NetworkProfile::fibre() }) {
+        if (name.toStdString() == profile.name)
+            return profile;
+    }
+    return {};
+}
+
+// the recorded responses of all layers, served through one shared link
+tl::expected<nucleus::Controller::LocalTileSources, std::string> open_network_replay(const std::filesystem::path& directory, const nucleus::tile_scheduler::NetworkProfile& profile)
+{
+    using namespace nucleus::tile_scheduler;
+    const auto link = std::make_shared<NetworkLink>(profile);
+    std::array<std::shared_ptr<TileSource>, network_layers.size()> replays;
+    for (size_t i = 0; i < network_layers.size(); ++i) {
+        const auto recording = NetworkRecording::read(directory / network_layers[i]);
+        if (recording.has_value())
+            replays[i] = std::make_shared<NetworkReplay>(*recording, link);
+        else if (i < 2) // labels are optional
+            return tl::unexpected(fmt::format("{}: {}", network_layers[i], recording.error()));
+    }
+    return nucleus::Controller::LocalTileSources { replays[0], replays[1], replays[2] };
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv); // use -platform offscreen (or eglfs) on machines without a display
+    QCoreApplication::setOrganizationName("AlpineMaps.org");
+    QCoreApplication::setApplicationName("AlpineBenchmark"); // own disk cache, it's cleared for cold runs
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Flies along a camera path without a window and reports frame times, pass timings, time to full detail "
+                                     "per waypoint and peak memory as json.");
+    parser.addHelpOption();
+    const QCommandLineOption path_option("path", "File with one waypoint per line (json: camera or position and look_at, name, field_of_view, frames). "
+                                                 "Without, the camera flies between the Grossglockner presets.", "path");
+    const QCommandLineOption tiles_option("tiles", "Fixture directory with the tile packs (height, ortho, optionally labels), instead of the servers.", "directory");
+    const QCommandLineOption record_option("record", "Loads the tiles from the servers and writes them as a fixture into the directory afterwards.", "directory");
+    const QCommandLineOption output_option("output", "Writes the json result into the file instead of the standard output.", "path");
+    const QCommandLineOption size_option("size", "Framebuffer size.", "widthxheight", "1920x1080");
+    const QCommandLineOption timeout_option("timeout", "Maximum time to full detail per waypoint in msecs.", "msecs", "30000");
+    const QCommandLineOption warm_option("warm", "Keeps the disk cache of the previous run (by default, every run starts cold).");
+    const QCommandLineOption record_network_option("record-network", "Loads the tiles from the servers and writes the responses with their timing "
+                                                                     "into the directory afterwards (for --replay-network).", "directory");
+    const QCommandLineOption replay_network_option("replay-network", "Serves the tiles from recorded responses (--record-network) through a simulated network, "
+                                                                     "see --network.", "directory");
+    const QCommandLineOption network_option("network", "Network of --replay-network: recorded (the recorded times), lte, dsl or fibre.", "profile", "recorded");
+    const QCommandLineOption soak_option("soak", "Soak test: loops the path (by default random flights, see --seed) for the given time and prints a json "
+                                                 "report line (memory, caches, requests in flight, persist and frame times) periodically.", "minutes");
+    const QCommandLineOption soak_report_option("soak-report", "Interval of the soak reports.", "seconds", "60");
+    const QCommandLineOption seed_option("seed", "Seed of the random flights of --soak.", "seed", "1");
+    const QCommandLineOption tile_format_option("tile-format", "Ortho and height tile size of the fixture (--tiles or --replay-network), "
+                                                               "e.g. 512x129. The servers serve 256x65.", "orthoxheight", "256x65");
+    parser.addOptions({ path_option, tiles_option, record_option, output_option, size_option, timeout_option, warm_option, record_network_option,
+        replay_network_option, network_option, soak_option, soak_report_option, seed_option, tile_format_option });
+    parser.process(app);
+
+    const auto size_values = parser.value(size_option).split('x');
+    const auto size = size_values.size() == 2 ? glm::uvec2(size_values[0].toUInt(), size_values[1].toUInt()) : glm::uvec2(0);
+    if (size.x == 0 || size.y == 0) {
+        std::cerr << "Broken --size, expected for instance 1920x1080." << std::endl;
+        return 1;
+    }
+    const auto tile_format_values = parser.value(tile_format_option).split('x');
+    const auto tile_format = tile_format_values.size() == 2
+        ? nucleus::tile_scheduler::tile_types::TileFormat { tile_format_values[0].toUInt(), tile_format_values[1].toUInt() }
+        : nucleus::tile_scheduler::tile_types::TileFormat { 0, 0 };
+    if (!tile_format.valid()) {
+        std::cerr << "Broken --tile-format, expected for instance 512x129 (the height size minus one must be a multiple of 8)." << std::endl;
+        return 1;
+    }
+    const auto n_tile_options = int(parser.isSet(tiles_option)) + int(parser.isSet(replay_network_option));
+    const auto n_record_options = int(parser.isSet(record_option)) + int(parser.isSet(record_network_option));
+    if (n_tile_options > 1 || (n_tile_options > 0 && n_record_options > 0)) {
+        std::cerr << "--tiles, --replay-network and recording exclude each other." << std::endl;
+        return 1;
+    }
+    const auto soak_minutes = parser.value(soak_option).toUInt();
+    if (parser.isSet(soak_option) && (soak_minutes == 0 || n_record_options > 0)) {
+        std::cerr << "--soak needs a positive number of minutes and excludes recording (the recording would grow without bound)." << std::endl;
+        return 1;
+    }
+    const auto profile = network_profile(parser.value(network_option));
+    if (!profile) {
+        std::cerr << "Unknown --network, expected recorded, lte, dsl or fibre." << std::endl;
+        return 1;
+    }
+
+    std::vector<FlythroughBenchmark::Waypoint> path;
+    if (parser.isSet(path_option)) {
+        QFile path_file(parser.value(path_option));
+        if (!path_file.open(QIODeviceBase::ReadOnly | QIODeviceBase::Text)) {
+            std::cerr << "Couldn't open the path file (--path)." << std::endl;
+            return 1;
+        }
+        unsigned line_number = 0;
+        while (!path_file.atEnd()) {
+            const auto line = path_file.readLine().trimmed();
+            ++line_number;
+            if (line.isEmpty() || line.startsWith('#'))
+                continue;
+            QString error;
+            const auto previous = path.empty() ? nucleus::camera::stored_positions::grossglockner() : path.back().camera;
+            auto waypoint = parse_waypoint(line, previous, &error);
+            if (!waypoint) {
+                std::cerr << fmt::format("line {}: {}", line_number, error.toStdString()) << std::endl;
+                return 1;
+            }
+            path.push_back(std::move(*waypoint));
+        }
+    } else if (soak_minutes > 0) {
+        path = random_path(parser.value(seed_option).toUInt(), 256);
+    } else {
+        path = default_path();
+    }
+    if (path.empty()) {
+        std::cerr << "The path has no waypoints." << std::endl;
+        return 1;
+    }
+
+    nucleus::Controller::LocalTileSources sources;
+    if (parser.isSet(tiles_option)) {
+        const auto fixture = open_fixture(parser.value(tiles_option).toStdString());
+        if (!fixture.has_value()) {
+            std::cerr << fmt::format("Couldn't open the fixture (--tiles): {}", fixture.error()) << std::endl;
+            return 1;
+        }
+        sources = *fixture;
+    }
+    if (parser.isSet(replay_network_option)) {
+        const auto replay = open_network_replay(parser.value(replay_network_option).toStdString(), *profile);
+        if (!replay.has_value()) {
+            std::cerr << fmt::format("Couldn't open the recording (--replay-network): {}", replay.error()) << std::endl;
+            return 1;
+        }
+        sources = *replay;
+    }
+    if (parser.isSet(tile_format_option) && n_tile_options == 0) {
+        std::cerr << "--tile-format needs --tiles or --replay-network." << std::endl;
+        return 1;
+    }
+    sources.format = tile_format;
+    if (!parser.isSet(warm_option))
+        std::filesystem::remove_all(nucleus::tile_scheduler::Scheduler::disk_cache_path());
+
+    QSurfaceFormat fmt;
+    fmt.setDepthBufferSize(24);
+    if (QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGL) {
+        fmt.setVersion(3, 3);
+        fmt.setProfile(QSurfaceFormat::CoreProfile);
+    } else {
+        fmt.setVersion(3, 0);
+    }
+    fmt.setSwapInterval(0);
+    QSurfaceFormat::setDefaultFormat(fmt);
+
+    QOffscreenSurface surface;
+    surface.setFormat(fmt);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(fmt);
+    if (!context.create()) {
+        std::cerr << "Couldn't create an OpenGL context." << std::endl;
+        return 1;
+    }
+
+    FlythroughBenchmark benchmark(size, parser.value(timeout_option).toUInt());
+    if (!benchmark.init(&context, &surface, sources)) {
+        std::cerr << "Couldn't make the OpenGL context current." << std::endl;
+        return 1;
+    }
+    benchmark.set_path(std::move(path));
+    benchmark.set_recording(parser.isSet(record_option));
+    if (soak_minutes > 0)
+        benchmark.set_soak(soak_minutes * 60, parser.value(soak_report_option).toUInt());
+    std::array<nucleus::tile_scheduler::NetworkRecordingPtr, network_layers.size()> network_recordings;
+    if (parser.isSet(record_network_option)) {
+        const auto services = std::array { benchmark.controller()->height_service(), benchmark.controller()->ortho_service(), benchmark.controller()->label_service() };
+        for (size_t i = 0; i < services.size(); ++i) {
+            if (!services[i])
+                continue; // no labels
+            network_recordings[i] = std::make_shared<nucleus::tile_scheduler::NetworkRecording>();
+            // the services live on the network thread (if threading is enabled), the recording has to be set before the first load
+            const auto connection = services[i]->thread() == QThread::currentThread() ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
+            QMetaObject::invokeMethod(services[i], [service = services[i], recording = network_recordings[i]]() { service->set_recording(recording); }, connection);
+        }
+    }
+
+    QObject::connect(&benchmark, &FlythroughBenchmark::soak_report, [](const QJsonObject& report) {
+        // one line per report, flushed, so that a killed run keeps its reports
+        std::cout << QJsonDocument(report).toJson(QJsonDocument::Compact).toStdString() << std::endl;
+    });
+    QObject::connect(&benchmark, &FlythroughBenchmark::waypoint_reached, [soak = soak_minutes > 0](const QString& name, double msecs, bool complete) {
+        if (soak)
+            return; // thousands of waypoints, they are summarised in the reports
+        std::cerr << fmt::format("{}: {:.0f} ms to full detail{}", name.toStdString(), msecs, complete ? "" : " (timed out)") << std::endl;
+    });
+    QObject::connect(&benchmark, &FlythroughBenchmark::finished, &app, [&]() {
+        int exit_code = 0;
+        if (parser.isSet(record_option)) {
+            const auto r = benchmark.write_recording(parser.value(record_option).toStdString());
+            if (!r.has_value()) {
+                std::cerr << fmt::format("Couldn't write the fixture (--record): {}", r.error()) << std::endl;
+                exit_code = 1;
+            }
+        }
+        if (parser.isSet(record_network_option)) {
+            const auto directory = std::filesystem::path(parser.value(record_network_option).toStdString());
+            for (size_t i = 0; i < network_layers.size(); ++i) {
+                if (!network_recordings[i])
+                    continue;
+                const auto r = network_recordings[i]->write(directory / network_layers[i]);
+                if (!r.has_value()) {
+                    std::cerr << fmt::format("Couldn't write the recording (--record-network): {}", r.error()) << std::endl;
+                    exit_code = 1;
+                }
+            }
+        }
+        auto result = benchmark.result();
+        if (parser.isSet(replay_network_option))
+            result.insert("network", QString::fromStdString(profile->name));
+        const auto json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+        if (parser.isSet(output_option)) {
+            QFile output(parser.value(output_option));
+            if (output.open(QIODeviceBase::WriteOnly)) {
+                output.write(json);
+            } else {
+                std::cerr << "Couldn't write the result (--output)." << std::endl;
+                exit_code = 1;
+            }
+        } else {
+            std::cout << json.toStdString();
+        }
+        QCoreApplication::exit(exit_code);
+    });
+    QTimer::singleShot(0, &benchmark, &FlythroughBenchmark::start);
+    return QGuiApplication::exec();
+}
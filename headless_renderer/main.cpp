@@ -0,0 +1,250 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QTimer>
+#include <fmt/format.h>
+
+#include "BatchRenderer.h"
+#include "FrameWriter.h"
+#include "nucleus/camera/PositionStorage.h"
+#include "nucleus/srs.h"
+
+namespace {
+std::optional<glm::dvec3> parse_lat_long_alt(const QJsonValue& value)
+{
+    const auto array = value.toArray();
+    if (array.size() != 3)
+        return {};
+    return glm::dvec3(array[0].toDouble(), array[1].toDouble(), array[2].toDouble());
+}
+
+std::optional<gl_engine::uboSharedConfig> parse_config(const QString& config)
+{
+    if (config.isEmpty())
+        return {};
+    bool ok = false;
+    const auto ubo = gl_engine::ubo_from_string<gl_engine::uboSharedConfig>(config, &ok);
+    if (!ok)
+        return {};
+    return ubo;
+}
+
+// one json object per line:
+// {"output": "a.png", "camera": "grossglockner"}
+// {"output": "b.png", "position": [lat, long, alt], "look_at": [lat, long, alt], "field_of_view": 60, "config": "<shared config>"}
+// config is the base64 string of a uboSharedConfig (as in the share links of the app).
+// the waypoints of --flight use the same format without output, and with "seconds" (the flight time from the previous one)
+std::optional<BatchRenderer::Job> parse_job(const QByteArray& line, bool needs_output, QString* error, double* seconds)
+{
+    QJsonParseError parse_error;
+    const auto json = QJsonDocument::fromJson(line, &parse_error).object();
+    if (parse_error.error != QJsonParseError::NoError) {
+        *error = parse_error.errorString();
+        return {};
+    }
+    BatchRenderer::Job job;
+    job.output = json.value("output").toString();
+    if (job.output.isEmpty() && needs_output) {
+        *error = "no output";
+        return {};
+    }
+    if (json.contains("camera")) {
+        job.camera = nucleus::camera::PositionStorage::instance()->get(json.value("camera").toString().toStdString());
+    } else {
+        const auto position = parse_lat_long_alt(json.value("position"));
+        const auto look_at = parse_lat_long_alt(json.value("look_at"));
+        if (!position || !look_at) {
+            *error = "either camera or position and look_at are required";
+            return {};
+        }
+        job.camera = nucleus::camera::Definition(nucleus::srs::lat_long_alt_to_world(*position), nucleus::srs::lat_long_alt_to_world(*look_at));
+    }
+    if (json.contains("field_of_view"))
+        job.camera.set_field_of_view(float(json.value("field_of_view").toDouble()));
+    if (json.contains("seconds"))
+        *seconds = std::max(0.0, json.value("seconds").toDouble());
+    if (json.contains("config")) {
+        job.config = parse_config(json.value("config").toString());
+        if (!job.config) {
+            *error = "broken config";
+            return {};
+        }
+    }
+    return job;
+}
+
+// fixed time step, so that the video plays at the speed of the flight regardless of the render time. the first frame is the
+// first waypoint, each waypoint ends its segment. the config of a segment is the one of its waypoint.
+std::vector<BatchRenderer::Job> flight_frames(const std::vector<std::pair<BatchRenderer::Job, double>>& waypoints, unsigned fps)
+{
+    std::vector<BatchRenderer::Job> frames;
+    if (waypoints.empty())
+        return frames;
+    frames.push_back(waypoints.front().first);
+    for (size_t i = 1; i < waypoints.size(); ++i) {
+        const auto& from = waypoints[i - 1].first;
+        const auto& [to, seconds] = waypoints[i];
+        const auto n_frames = std::max(1u, unsigned(std::lround(seconds * fps)));
+        for (unsigned frame = 1; frame <= n_frames; ++frame) {
+            auto job = to;
+            job.camera = nucleus::camera::interpolate(from.camera, to.camera, double(frame) / double(n_frames));
+            job.config = frame == 1 ? to.config : std::nullopt;
+            frames.push_back(std::move(job));
+        }
+    }
+    return frames;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv); // use -platform offscreen (or eglfs) on machines without a display
+    QCoreApplication::setOrganizationName("AlpineMaps.org");
+    QCoreApplication::setApplicationName("AlpineApp"); // same cache location as the app
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders terrain snapshots from a list of cameras, without a window.");
+    parser.addHelpOption();
+    const QCommandLineOption jobs_option("jobs", "File with one job per line (json: output, camera or position and look_at, field_of_view, config).", "path");
+    const QCommandLineOption size_option("size", "Image size.", "widthxheight", "1920x1080");
+    const QCommandLineOption config_option("config", "Shared config (base64, as in the share links of the app) for jobs without one.", "config");
+    const QCommandLineOption timeout_option("timeout", "Maximum time per image in msecs, the image is rendered with the tiles available then.", "msecs", "30000");
+    const QCommandLineOption flight_option("flight", "Records a flight instead of --jobs: file with one waypoint per line (json as the jobs, without output, "
+                                                     "with seconds from the previous waypoint). Every frame is rendered at full detail (or --timeout).", "path");
+    const QCommandLineOption video_option("video", "Output of --flight: a video file (encoded by ffmpeg, which must be in the path), or an image sequence "
+                                                   "where a run of # is the frame number (e.g., frames/#####.png).", "path", "flight.mp4");
+    const QCommandLineOption fps_option("fps", "Frame rate of --flight.", "fps", "60");
+    parser.addOptions({ jobs_option, size_option, config_option, timeout_option, flight_option, video_option, fps_option });
+    parser.process(app);
+
+    const auto size_values = parser.value(size_option).split('x');
+    const auto size = size_values.size() == 2 ? glm::uvec2(size_values[0].toUInt(), size_values[1].toUInt()) : glm::uvec2(0);
+    if (size.x == 0 || size.y == 0) {
+        std::cerr << "Broken --size, expected for instance 1920x1080." << std::endl;
+        return 1;
+    }
+    const auto default_config = parse_config(parser.value(config_option));
+    if (parser.isSet(config_option) && !default_config) {
+        std::cerr << "Broken --config." << std::endl;
+        return 1;
+    }
+
+    const auto flight = parser.isSet(flight_option);
+    const auto fps = parser.value(fps_option).toUInt();
+    if (flight && fps == 0) {
+        std::cerr << "Broken --fps." << std::endl;
+        return 1;
+    }
+    QFile jobs_file(parser.value(flight ? flight_option : jobs_option));
+    if (!jobs_file.open(QIODeviceBase::ReadOnly | QIODeviceBase::Text)) {
+        std::cerr << "Couldn't open the jobs file (--jobs or --flight)." << std::endl;
+        parser.showHelp(1);
+    }
+
+    QSurfaceFormat fmt;
+    fmt.setDepthBufferSize(24);
+    if (QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGL) {
+        fmt.setVersion(3, 3);
+        fmt.setProfile(QSurfaceFormat::CoreProfile);
+    } else {
+        fmt.setVersion(3, 0);
+    }
+    QSurfaceFormat::setDefaultFormat(fmt);
+
+    QOffscreenSurface surface;
+    surface.setFormat(fmt);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(fmt);
+    if (!context.create()) {
+        std::cerr << "Couldn't create an OpenGL context." << std::endl;
+        return 1;
+    }
+
+    BatchRenderer renderer(size, parser.value(timeout_option).toUInt());
+    if (!renderer.init(&context, &surface)) {
+        std::cerr << "Couldn't make the OpenGL context current." << std::endl;
+        return 1;
+    }
+    unsigned line_number = 0;
+    std::vector<std::pair<BatchRenderer::Job, double>> waypoints;
+    while (!jobs_file.atEnd()) {
+        const auto line = jobs_file.readLine().trimmed();
+        ++line_number;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        QString error;
+        double seconds = 2.0;
+        auto job = parse_job(line, !flight, &error, &seconds);
+        if (!job) {
+            std::cerr << fmt::format("line {}: {}", line_number, error.toStdString()) << std::endl;
+            return 1;
+        }
+        if (!job->config && (!flight || waypoints.empty()))
+            job->config = default_config;
+        if (flight)
+            waypoints.emplace_back(std::move(*job), seconds);
+        else
+            renderer.enqueue(*job);
+    }
+
+    FrameWriter frame_writer({ .output = parser.value(video_option), .fps = fps });
+    unsigned frame_number = 0;
+    if (flight) {
+        for (auto& frame : flight_frames(waypoints, fps)) {
+            frame.output.clear();
+            renderer.enqueue(frame);
+        }
+        if (!frame_writer.start(size)) {
+            std::cerr << "Couldn't start the video encoder (ffmpeg), use an image sequence with --video frames/#####.png instead." << std::endl;
+            return 1;
+        }
+        renderer.set_frame_writer(&frame_writer);
+    }
+
+    QObject::connect(&renderer, &BatchRenderer::job_finished, [&frame_number](const QString& output, double msecs, bool complete) {
+        const auto name = output.isEmpty() ? fmt::format("frame {}", frame_number++) : output.toStdString();
+        std::cout << fmt::format("{} ({:.0f} ms{})", name, msecs, complete ? "" : ", timed out with missing tiles") << std::endl;
+    });
+    QObject::connect(&renderer, &BatchRenderer::finished, &app, [](const BatchRenderer::Statistics& stats) {
+        std::cout << fmt::format("done: {} images in {:.1f} s, {:.2f} images/s, {} timed out, {} not written",
+            stats.n_done,
+            stats.seconds,
+            double(stats.n_done) / std::max(stats.seconds, 0.001),
+            stats.n_timed_out,
+            stats.n_write_failed)
+                  << std::endl;
+        QCoreApplication::exit(stats.n_write_failed == 0 ? 0 : 1);
+    });
+    QTimer::singleShot(0, &renderer, &BatchRenderer::start);
+    return QGuiApplication::exec();
+}
@@ -37,6 +37,13 @@ namespace tile_scheduler::utils {
     class AabbDecorator;
     using AabbDecoratorPtr = std::shared_ptr<AabbDecorator>;
 }
+namespace tile_scheduler {
+    class LatencyTracer;
+}
+namespace utils {
+    class MetricsRegistry;
+    struct ThreadPolicy;
+}
 namespace camera {
     class Definition;
     class AbstractDepthTester;
@@ -52,15 +59,26 @@ public:
     virtual void deinit_gpu() = 0;
     virtual void set_permissible_screen_space_error(float new_error) = 0;
     virtual void set_quad_limit(unsigned new_limit) = 0;
+    // before initialise_gpu, the same as Scheduler::set_tile_format
+    virtual void set_tile_format(const tile_scheduler::tile_types::TileFormat& new_format) = 0;
     [[nodiscard]] virtual camera::AbstractDepthTester* depth_tester() = 0;
     [[nodiscard]] virtual utils::ColourTexture::Format ortho_tile_compression_algorithm() const = 0;
+    [[nodiscard]] virtual unsigned ortho_tile_mip_levels() const = 0;
+    // drained at the start of paint, the alternative to update_gpu_quads (see Scheduler::set_gpu_quad_mailbox)
+    virtual void set_gpu_quad_mailbox(const std::shared_ptr<tile_scheduler::tile_types::GpuQuadMailbox>& mailbox) = 0;
 
 public slots:
     virtual void update_camera(const camera::Definition& new_definition) = 0;
     virtual void update_debug_scheduler_stats(const QString& stats) = 0;
     virtual void set_aabb_decorator(const tile_scheduler::utils::AabbDecoratorPtr&) = 0;
+    // the renderer marks the uploads and first draws of the quads (see tile_scheduler::LatencyTracer)
+    virtual void set_latency_tracer(const std::shared_ptr<tile_scheduler::LatencyTracer>&) = 0;
+    // frame times, gpu pass timings, gl command counts and gpu memory are exported there (see Controller, ALP_METRICS_PORT)
+    virtual void set_metrics(const std::shared_ptr<utils::MetricsRegistry>&) = 0;
+    // of the background upload thread, if there is one (see Controller::set_thread_policies)
+    virtual void set_upload_thread_policy(const utils::ThreadPolicy&) = 0;
     virtual void remove_tile(const tile::Id&) = 0;
-    virtual void update_gpu_quads(const std::vector<tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads) = 0;
+    virtual void update_gpu_quads(const tile_scheduler::tile_types::GpuTileQuadBatch& new_quads, const std::vector<tile::Id>& deleted_quads) = 0;
 
 signals:
     void update_requested();
@@ -68,6 +86,19 @@ signals:
     void key_released(const QKeyCombination&) const;
     void gpu_ready_changed(bool ready);
     void update_camera_requested() const;
+    // tiles of the draw list that were hidden behind terrain in the last frame (sorted), sent whenever they changed
+    void occluded_tiles_changed(const std::vector<tile::Id>& tiles);
+    // quads on the gpu that didn't contribute a single pixel in the last evaluated frame (sorted, without descendants of listed
+    // ones), see gl_engine::Window::set_visibility_feedback
+    void hidden_quads_changed(const std::vector<tile::Id>& quads);
+    // the gpu tile pool can be resized at runtime (set_quad_limit), connect to Scheduler::set_gpu_quad_limit
+    void quad_limit_changed(unsigned new_limit);
+    // the tiles were dropped by a resize, connect to Scheduler::release_gpu_quads so that they are sent again
+    void gpu_tiles_released();
+    // the error of the draw list changed (set_permissible_screen_space_error or adaptive quality), the scheduler follows it
+    void permissible_screen_space_error_changed(float new_error);
+    // the per tile normal maps are read by the shading (FEATURE_NORMAL_MODE 2), connect to Scheduler::set_normal_maps
+    void normal_maps_needed_changed(bool needed);
 };
 
 }
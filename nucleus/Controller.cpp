@@ -19,6 +19,8 @@
 #include "Controller.h"
 #include "DataQuerier.h"
 
+#include <filesystem>
+
 #include <QCoreApplication>
 #include <QFile>
 #include <QNetworkReply>
@@ -36,110 +38,419 @@
 #include "nucleus/tile_scheduler/SlotLimiter.h"
 #include "nucleus/tile_scheduler/TileLoadService.h"
 #include "nucleus/tile_scheduler/utils.h"
-#include "radix/TileHeights.h"
+#include "nucleus/timing/StartupTimeline.h"
+#include "nucleus/utils/MemoryPressureMonitor.h"
+#include "nucleus/utils/MetricsRegistry.h"
+#include "nucleus/utils/ThreadPolicy.h"
+#ifndef __EMSCRIPTEN__
+#include "nucleus/utils/MetricsServer.h"
+#endif
+#include "nucleus/utils/tile_conversion.h"
+#include "nucleus/tile_scheduler/HeightBoundsTable.h"
 
 using namespace nucleus::tile_scheduler;
 
 namespace nucleus {
-Controller::Controller(AbstractRenderWindow* render_window)
+Controller::Controller(AbstractRenderWindow* render_window, const LocalTileSources& local_sources)
     : m_render_window(render_window)
 {
+    const nucleus::timing::StartupScope startup_scope("controller");
+    // the height bounds are decoded while the services and the scheduler are set up
+    auto aabb_decorator = nucleus::timing::startup_async("height bounds", []() {
+        QFile file(":/map/height_data.atb");
+        const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+        assert(open);
+        Q_UNUSED(open);
+        // flattened and memory mapped from the cache after the first start, see HeightBoundsTable
+        return nucleus::tile_scheduler::utils::AabbDecorator::make(HeightBoundsTable::load_or_build(file.readAll()));
+    });
     qRegisterMetaType<nucleus::event_parameter::Touch>();
     qRegisterMetaType<nucleus::event_parameter::Mouse>();
     qRegisterMetaType<nucleus::event_parameter::Wheel>();
 
-    m_terrain_service = std::make_unique<TileLoadService>("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZXY, ".png");
-    //    m_ortho_service.reset(new TileLoadService("https://tiles.bergfex.at/styles/bergfex-osm/", TileLoadService::UrlPattern::ZXY_yPointingSouth, ".jpeg"));
-    //    m_ortho_service.reset(new TileLoadService("https://alpinemaps.cg.tuwien.ac.at/tiles/ortho/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg"));
-    // m_ortho_service.reset(new TileLoadService("https://maps%1.wien.gv.at/basemap/bmaporthofoto30cm/normal/google3857/",
+    if (local_sources.height)
+        m_terrain_service = std::make_unique<TileLoadService>(local_sources.height);
+    else
+        m_terrain_service = std::make_unique<TileLoadService>("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZXY, ".png");
+    {
+        // the compact encoding if the server has it, the decoder goes by the magic bytes
+        auto options = m_terrain_service->transport_options();
+        options.accept = nucleus::utils::tile_conversion::accepted_height_media_types();
+        m_terrain_service->set_transport_options(options);
+    }
+    //    m_ortho_services.emplace_back(new TileLoadService("https://tiles.bergfex.at/styles/bergfex-osm/", TileLoadService::UrlPattern::ZXY_yPointingSouth, ".jpeg"));
+    // m_ortho_services.emplace_back(new TileLoadService("https://maps%1.wien.gv.at/basemap/bmaporthofoto30cm/normal/google3857/",
     //                                           TileLoadService::UrlPattern::ZYX_yPointingSouth,
     //                                           ".jpeg",
     //                                           {"", "1", "2", "3", "4"}));
-    m_ortho_service.reset(
-        new TileLoadService("https://gataki.cg.tuwien.ac.at/raw/basemap/tiles/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg"));
+    if (local_sources.ortho) {
+        m_ortho_services.push_back(std::make_unique<TileLoadService>(local_sources.ortho));
+        m_ortho_source_names = { "local" };
+    } else {
+        // the first one is the default, its cache is in Scheduler::disk_cache_path (as before there were several)
+        m_ortho_services.emplace_back(
+            new TileLoadService("https://gataki.cg.tuwien.ac.at/raw/basemap/tiles/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg"));
+        m_ortho_services.emplace_back(
+            new TileLoadService("https://alpinemaps.cg.tuwien.ac.at/tiles/ortho/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg"));
+        m_ortho_source_names = { "basemap", "ortho" };
+        // servers that negotiate the format can send webp (or avif) at the .jpeg urls, the decoders go by the magic bytes
+        for (auto& service : m_ortho_services) {
+            auto options = service->transport_options();
+            options.accept = nucleus::utils::tile_conversion::accepted_ortho_media_types();
+            service->set_transport_options(options);
+        }
+    }
+    if (local_sources.labels)
+        m_label_service = std::make_unique<TileLoadService>(local_sources.labels);
+    else if (!QString(ALP_LABEL_TILE_URL).isEmpty()) // see nucleus/CMakeLists.txt, otherwise the renderer shows its built in labels
+        m_label_service = std::make_unique<TileLoadService>(ALP_LABEL_TILE_URL, TileLoadService::UrlPattern::ZXY, ".alpl");
 
     m_tile_scheduler = std::make_unique<nucleus::tile_scheduler::Scheduler>();
-    m_tile_scheduler->read_disk_cache();
-    m_render_window->set_quad_limit(512); // must be same as scheduler, dynamic resizing is not supported atm
-    m_tile_scheduler->set_gpu_quad_limit(512);
+    m_tile_scheduler->set_tile_sources(m_ortho_source_names);
+    // the renderer owns the limit, it announces resizes once it has the room (or when it needs the scheduler to delete quads)
+    connect(m_render_window, &AbstractRenderWindow::quad_limit_changed, m_tile_scheduler.get(), &Scheduler::set_gpu_quad_limit);
+    connect(m_render_window, &AbstractRenderWindow::gpu_tiles_released, m_tile_scheduler.get(), &Scheduler::release_gpu_quads);
+    m_render_window->set_quad_limit(512);
+    m_tile_scheduler->set_tile_format(local_sources.format);
+    m_render_window->set_tile_format(local_sources.format);
     m_tile_scheduler->set_ram_quad_limit(12000);
     {
-        QFile file(":/map/height_data.atb");
-        const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
-        assert(open);
-        Q_UNUSED(open);
-        const QByteArray data = file.readAll();
-        const auto decorator = nucleus::tile_scheduler::utils::AabbDecorator::make(TileHeights::deserialise(data));
-        m_tile_scheduler->set_aabb_decorator(decorator);
-        m_render_window->set_aabb_decorator(decorator);
+        // the disk keeps many more quads than ram, so that revisited areas don't have to be downloaded again. at most a quarter of
+        // the free space (at startup) is used.
+        std::error_code error;
+        const auto space = std::filesystem::space(Scheduler::disk_cache_path().parent_path(), error);
+        const auto byte_limit = std::min<uint64_t>(uint64_t(8) << 30, error ? uint64_t(512) << 20 : uint64_t(space.available / 4));
+        m_tile_scheduler->set_disk_quad_limit(500000);
+        m_tile_scheduler->set_disk_byte_limit(byte_limit);
+    }
+    m_tile_scheduler->set_prefetch_budget(64);
+    m_tile_scheduler->set_idle_prefetch({ .max_quads = 256 });
+    m_tile_scheduler->set_adaptive_update_cadence(true);
+    {
+        // the quads go straight to the render thread, which might be asleep (qt quick) and is woken by requesting a frame
+        auto mailbox = std::make_shared<tile_scheduler::tile_types::GpuQuadMailbox>();
+        mailbox->set_wake_up([render_window = m_render_window]() { emit render_window->update_requested(); });
+        m_tile_scheduler->set_gpu_quad_mailbox(mailbox);
+        m_render_window->set_gpu_quad_mailbox(mailbox);
     }
-    m_data_querier = std::make_unique<DataQuerier>(&m_tile_scheduler->ram_cache());
+    const auto decorator = aabb_decorator.get();
+    decorator->set_flat_terrain_factor(0.5f); // flat terrain a level coarser, see utils::AabbDecorator::error_size
+    decorator->set_horizon_culling(true); // valleys behind the ridges in low views, see tile_scheduler::HorizonOcclusion
+    m_tile_scheduler->set_aabb_decorator(decorator);
+    m_render_window->set_aabb_decorator(decorator);
+    m_data_querier = std::make_unique<DataQuerier>(&m_tile_scheduler->ram_cache(), decorator);
+    // missing height data of elevation profiles, queued to the scheduler thread
+    m_data_querier->set_quad_fetcher([scheduler = m_tile_scheduler.get()](std::vector<tile::Id> quads) {
+        QMetaObject::invokeMethod(scheduler, [scheduler, quads = std::move(quads)]() { scheduler->request_quads(quads); });
+    });
     m_camera_controller = std::make_unique<nucleus::camera::Controller>(
         nucleus::camera::PositionStorage::instance()->get("grossglockner"),
         m_render_window->depth_tester(),
         m_data_querier.get());
     {
         auto* sch = m_tile_scheduler.get();
-        SlotLimiter* sl = new SlotLimiter(sch);
-        RateLimiter* rl = new RateLimiter(sch);
-        QuadAssembler* qa = new QuadAssembler(sch);
-        LayerAssembler* la = new LayerAssembler(sch);
-        connect(sch, &Scheduler::quads_requested, sl, &SlotLimiter::request_quads);
+        // the loading chain lives next to the load services, on the network thread. the scheduler is reached by queued signals.
+        m_loading_chain = std::make_unique<QObject>();
+        SlotLimiter* sl = new SlotLimiter(m_loading_chain.get());
+        RateLimiter* rl = new RateLimiter(m_loading_chain.get());
+        QuadAssembler* qa = new QuadAssembler(m_loading_chain.get());
+        LayerAssembler* la = new LayerAssembler(m_loading_chain.get());
+        m_quad_assembler = qa;
+        m_layer_assembler = la;
+        sl->set_cancel_stale_requests(true);
+        sl->set_adaptive(true);
+        m_tile_scheduler->set_request_slot_count(sl->limit());
+        connect(sl, &SlotLimiter::limit_changed, sch, &Scheduler::set_request_slot_count);
+        connect(sch, &Scheduler::quad_requests_changed, sl, &SlotLimiter::update_requests);
         connect(sl, &SlotLimiter::quad_requested, rl, &RateLimiter::request_quad);
         connect(rl, &RateLimiter::quad_requested, qa, &QuadAssembler::load);
         connect(qa, &QuadAssembler::tile_requested, la, &LayerAssembler::load);
-        connect(la, &LayerAssembler::tile_requested, m_ortho_service.get(), &TileLoadService::load);
-        connect(la, &LayerAssembler::tile_requested, m_terrain_service.get(), &TileLoadService::load);
+        la->set_layer_selector([sch](const tile::Id& id) { return sch->layers_for_tile(id); });
+        connect(la, &LayerAssembler::ortho_requested, m_ortho_services.front().get(), &TileLoadService::load); // see set_ortho_source
+        connect(la, &LayerAssembler::height_requested, m_terrain_service.get(), &TileLoadService::load);
 
-        connect(m_ortho_service.get(), &TileLoadService::load_finished, la, &LayerAssembler::deliver_ortho);
+        // retired tiles are revalidated with conditional requests instead of downloading them again
+        m_terrain_service->set_cached_tile_lookup([sch](const tile::Id& id) { return sch->cached_height_tile(id); });
+
+        for (unsigned i = 0; i < m_ortho_services.size(); ++i) {
+            auto* service = m_ortho_services[i].get();
+            service->set_cached_tile_lookup([sch, i](const tile::Id& id) { return sch->cached_ortho_tile(id, i); });
+            // tagged, so that the scheduler caches the tile with its source (also the ones that arrive after a switch)
+            connect(service, &TileLoadService::load_finished, la, [la, i](tile_types::TileLayer tile) {
+                tile.source = i;
+                la->deliver_ortho(tile);
+            });
+            connect(la, &LayerAssembler::tiles_cancelled, service, &TileLoadService::cancel);
+        }
         connect(m_terrain_service.get(), &TileLoadService::load_finished, la, &LayerAssembler::deliver_height);
         connect(la, &LayerAssembler::tile_loaded, qa, &QuadAssembler::deliver_tile);
         connect(qa, &QuadAssembler::quad_loaded, sl, &SlotLimiter::deliver_quad);
-        connect(sl, &SlotLimiter::quad_delivered, sch, &Scheduler::receive_quad);
+        connect(sl, &SlotLimiter::quads_delivered, sch, &Scheduler::receive_quads);
+
+        // requests for quads that dropped out of the current view are cancelled along the same chain
+        connect(sl, &SlotLimiter::quads_cancelled, rl, &RateLimiter::cancel_quads);
+        connect(rl, &RateLimiter::quads_cancelled, qa, &QuadAssembler::cancel_quads);
+        connect(qa, &QuadAssembler::tiles_cancelled, la, &LayerAssembler::cancel_tiles);
+        connect(la, &LayerAssembler::tiles_cancelled, m_terrain_service.get(), &TileLoadService::cancel);
+
+        // latency tracing, the stages are marked on the thread of the emitter
+        const auto tracer = m_tile_scheduler->latency_tracer();
+        using Stage = LatencyTracer::Stage;
+        connect(sl, &SlotLimiter::quad_requested, sl, [tracer](const tile::Id& id) { tracer->mark(id, Stage::SlotReleased); });
+        connect(rl, &RateLimiter::quad_requested, rl, [tracer](const tile::Id& id) { tracer->mark(id, Stage::RateReleased); });
+        connect(la, &LayerAssembler::tile_requested, la, [tracer](const tile::Id& id) { tracer->mark_tile(id, Stage::NetworkSent); });
+        connect(la, &LayerAssembler::tile_loaded, la, [tracer](const tile_types::LayeredTile& tile) { tracer->mark_tile(tile.id, Stage::LayersAssembled); });
+        connect(qa, &QuadAssembler::quad_loaded, qa, [tracer](const tile_types::TileQuad& quad) { tracer->mark(quad.id, Stage::QuadAssembled); });
+        std::vector<TileLoadService*> services = { m_terrain_service.get(), m_label_service.get() };
+        for (const auto& service : m_ortho_services)
+            services.push_back(service.get());
+        for (auto* service : services) {
+            if (!service)
+                continue;
+            connect(service, &TileLoadService::response_started, service, [tracer](const tile::Id& id) { tracer->mark_tile(id, Stage::FirstByte); });
+            connect(service, &TileLoadService::load_finished, service, [tracer](const tile_types::TileLayer& tile) { tracer->mark_tile(tile.id, Stage::NetworkFinished); });
+        }
+        m_render_window->set_latency_tracer(tracer);
+
+        if (m_label_service) {
+            la->set_label_zoom_range(label_min_zoom, label_max_zoom);
+            connect(la, &LayerAssembler::labels_requested, m_label_service.get(), &TileLoadService::load);
+            m_label_service->set_cached_tile_lookup([sch](const tile::Id& id) { return sch->cached_label_tile(id); });
+            connect(m_label_service.get(), &TileLoadService::load_finished, la, &LayerAssembler::deliver_labels);
+            connect(la, &LayerAssembler::tiles_cancelled, m_label_service.get(), &TileLoadService::cancel);
+        }
     }
-    if (QNetworkInformation::loadDefaultBackend() && QNetworkInformation::instance()) {
+    // fully local sources are reachable without a network
+    const auto needs_network = !local_sources.height || !local_sources.ortho;
+    if (needs_network && QNetworkInformation::loadDefaultBackend() && QNetworkInformation::instance()) {
         QNetworkInformation* n = QNetworkInformation::instance();
         m_tile_scheduler->set_network_reachability(n->reachability());
         connect(n, &QNetworkInformation::reachabilityChanged, m_tile_scheduler.get(), &Scheduler::set_network_reachability);
+
+        // metered and cellular connections stream less (see nucleus/CMakeLists.txt)
+        if (const auto metered_policy = Scheduler::NetworkPolicy::from_string(ALP_METERED_NETWORK_POLICY))
+            m_tile_scheduler->set_network_policies({}, *metered_policy);
+        else
+            qWarning() << "Controller: invalid ALP_METERED_NETWORK_POLICY" << ALP_METERED_NETWORK_POLICY;
+        for (const auto& service : m_ortho_services)
+            connect(m_tile_scheduler.get(), &Scheduler::bundle_requests_changed, service.get(), &TileLoadService::set_bundle_requests);
+        connect(m_tile_scheduler.get(), &Scheduler::bundle_requests_changed, m_terrain_service.get(), &TileLoadService::set_bundle_requests);
+        const auto update_metered = [n, sch = m_tile_scheduler.get()]() {
+            const auto metered = n->isMetered() || n->transportMedium() == QNetworkInformation::TransportMedium::Cellular;
+            QMetaObject::invokeMethod(sch, [sch, metered]() { sch->set_network_metered(metered); });
+        };
+        update_metered();
+        connect(n, &QNetworkInformation::isMeteredChanged, n, update_metered);
+        connect(n, &QNetworkInformation::transportMediumChanged, n, update_metered);
     }
 
 #ifdef ALP_ENABLE_THREADING
+    // network replies and timers are not delayed by decoding or persisting on the scheduler thread (decoding itself runs on the
+    // decode pool of the scheduler, see Scheduler::set_decode_thread_count).
     m_scheduler_thread = std::make_unique<QThread>();
     m_scheduler_thread->setObjectName("tile_scheduler_thread");
     qDebug() << "scheduler thread: " << m_scheduler_thread.get();
 #ifdef __EMSCRIPTEN__ // make request from main thread on webassembly due to QTBUG-109396
     m_terrain_service->moveToThread(QCoreApplication::instance()->thread());
-    m_ortho_service->moveToThread(QCoreApplication::instance()->thread());
+    for (auto& service : m_ortho_services)
+        service->moveToThread(QCoreApplication::instance()->thread());
+    if (m_label_service)
+        m_label_service->moveToThread(QCoreApplication::instance()->thread());
+    m_loading_chain->moveToThread(QCoreApplication::instance()->thread());
 #else
-    m_terrain_service->moveToThread(m_scheduler_thread.get());
-    m_ortho_service->moveToThread(m_scheduler_thread.get());
+    m_network_thread = std::make_unique<QThread>();
+    m_network_thread->setObjectName("tile_network_thread");
+    qDebug() << "network thread: " << m_network_thread.get();
+    m_terrain_service->moveToThread(m_network_thread.get());
+    for (auto& service : m_ortho_services)
+        service->moveToThread(m_network_thread.get());
+    if (m_label_service)
+        m_label_service->moveToThread(m_network_thread.get());
+    m_loading_chain->moveToThread(m_network_thread.get());
+    m_network_thread->start();
 #endif
     m_tile_scheduler->moveToThread(m_scheduler_thread.get());
     m_scheduler_thread->start();
+#endif
+    if (const auto policies = nucleus::utils::ThreadPolicies::from_string(ALP_THREAD_POLICIES))
+        set_thread_policies(*policies);
+    else
+        qWarning() << "Controller: invalid ALP_THREAD_POLICIES" << ALP_THREAD_POLICIES;
+    // queued on the scheduler thread, the quads are then streamed in from there without blocking the first frame
+    QMetaObject::invokeMethod(m_tile_scheduler.get(), &Scheduler::open_disk_cache);
+#ifdef ALP_BASE_TILE_PACK
+    // the compiled in low zoom quads, so that the first frame doesn't wait for the network
+    QMetaObject::invokeMethod(m_tile_scheduler.get(), [scheduler = m_tile_scheduler.get()]() { scheduler->open_base_pack(":/base_tiles"); });
 #endif
     connect(m_render_window, &AbstractRenderWindow::key_pressed, m_camera_controller.get(), &nucleus::camera::Controller::key_press);
     connect(m_render_window, &AbstractRenderWindow::key_released, m_camera_controller.get(), &nucleus::camera::Controller::key_release);
-    connect(m_render_window, &AbstractRenderWindow::update_camera_requested, m_camera_controller.get(), &nucleus::camera::Controller::update_camera_request);
+    connect(m_render_window, &AbstractRenderWindow::update_camera_requested, this, &Controller::update_camera_requests);
     connect(m_render_window, &AbstractRenderWindow::gpu_ready_changed, m_tile_scheduler.get(), &Scheduler::set_enabled);
+    connect(m_render_window, &AbstractRenderWindow::occluded_tiles_changed, m_tile_scheduler.get(), &Scheduler::set_occluded_tiles);
+    connect(m_render_window, &AbstractRenderWindow::hidden_quads_changed, m_tile_scheduler.get(), &Scheduler::set_hidden_quads);
+    connect(m_render_window, &AbstractRenderWindow::permissible_screen_space_error_changed, m_tile_scheduler.get(), &Scheduler::set_permissible_screen_space_error);
+    connect(m_render_window, &AbstractRenderWindow::normal_maps_needed_changed, m_tile_scheduler.get(), &Scheduler::set_normal_maps);
 
     // NOTICE ME!!!! READ THIS, IF YOU HAVE TROUBLES WITH SIGNALS NOT REACHING THE QML RENDERING THREAD!!!!111elevenone
     // In Qt the rendering thread goes to sleep (at least until Qt 6.5, See RenderThreadNotifier).
     // At the time of writing, an additional connection from tile_ready and tile_expired to the notifier is made.
     // this only works if ALP_ENABLE_THREADING is on, i.e., the tile scheduler is on an extra thread. -> potential issue on webassembly
-    connect(m_camera_controller.get(), &nucleus::camera::Controller::definition_changed, m_tile_scheduler.get(), &Scheduler::update_camera);
+    connect(m_camera_controller.get(), &nucleus::camera::Controller::definition_changed, m_tile_scheduler.get(), &Scheduler::post_camera, Qt::DirectConnection);
+    connect(m_camera_controller.get(), &nucleus::camera::Controller::update_pending, m_render_window, &AbstractRenderWindow::update_requested);
+    connect(m_camera_controller.get(), &nucleus::camera::Controller::animation_target_changed, m_tile_scheduler.get(), &Scheduler::set_prefetch_target);
     connect(m_camera_controller.get(), &nucleus::camera::Controller::definition_changed, m_render_window, &AbstractRenderWindow::update_camera);
 
-    connect(m_tile_scheduler.get(), &Scheduler::gpu_quads_updated, m_render_window, &AbstractRenderWindow::update_gpu_quads);
-    connect(m_tile_scheduler.get(), &Scheduler::gpu_quads_updated, m_render_window, &AbstractRenderWindow::update_requested);
+
+    m_memory_pressure_monitor = std::make_unique<nucleus::utils::MemoryPressureMonitor>();
+#ifdef __ANDROID__
+    m_tile_scheduler->set_release_gpu_when_suspended(true);
+#endif
+    connect(m_memory_pressure_monitor.get(), &nucleus::utils::MemoryPressureMonitor::memory_pressure, m_tile_scheduler.get(), &Scheduler::handle_memory_pressure);
+    connect(m_memory_pressure_monitor.get(), &nucleus::utils::MemoryPressureMonitor::suspended_changed, m_tile_scheduler.get(), &Scheduler::set_suspended);
+
+#ifndef __EMSCRIPTEN__
+    if (const auto port = qEnvironmentVariableIntValue("ALP_METRICS_PORT"); port > 0 && port <= 65535)
+        serve_metrics(quint16(port));
+#endif
 
     m_camera_controller->update();
 }
 
+void Controller::serve_metrics(quint16 port)
+{
+#ifndef __EMSCRIPTEN__
+    using Type = nucleus::utils::MetricsRegistry::Type;
+    m_metrics = std::make_shared<nucleus::utils::MetricsRegistry>();
+    m_metrics_server = std::make_unique<nucleus::utils::MetricsServer>(m_metrics);
+    if (!m_metrics_server->listen(port)) {
+        m_metrics_server.reset();
+        m_metrics.reset();
+        return;
+    }
+    m_tile_scheduler->latency_tracer()->set_enabled(true); // exported below
+    const auto metrics = m_metrics;
+    metrics->describe("alp_cache_tiles", Type::Gauge, "quads in a cache tier");
+    metrics->describe("alp_cache_bytes", Type::Gauge, "bytes in a cache tier");
+    metrics->describe("alp_cache_lookups", Type::Counter, "quads that were looked up in a cache tier");
+    metrics->describe("alp_cache_hits", Type::Counter, "quads that were found in a cache tier");
+    metrics->describe("alp_request_slots", Type::Gauge, "current limit of concurrent quad requests");
+    metrics->describe("alp_tile_latency_seconds", Type::Gauge, "time from the previous stage of a quad request to the stage");
+    metrics->describe("alp_disk_persists", Type::Counter, "writes of the disk cache");
+    metrics->describe("alp_disk_persist_seconds", Type::Gauge, "duration of the last write of the disk cache");
+    metrics->describe("alp_network_bytes", Type::Counter, "payload of the tile responses");
+    metrics->describe("alp_tile_responses", Type::Counter, "tile responses, by status");
+
+    // on the scheduler thread
+    connect(m_tile_scheduler.get(), &Scheduler::statistics_updated, m_tile_scheduler.get(), [metrics](const Scheduler::Statistics& s) {
+        const auto tier = [](const char* name) { return nucleus::utils::MetricsRegistry::Labels { { "tier", name } }; };
+        metrics->set_gauge("alp_cache_tiles", s.n_tiles_in_ram_cache, tier("ram"));
+        metrics->set_gauge("alp_cache_tiles", s.n_tiles_in_gpu_cache, tier("gpu"));
+        metrics->set_gauge("alp_cache_tiles", s.n_tiles_in_warm_cache, tier("warm"));
+        metrics->set_gauge("alp_cache_tiles", s.n_tiles_in_disk_cache, tier("disk"));
+        metrics->set_gauge("alp_cache_bytes", double(s.n_bytes_in_ram_cache), tier("ram"));
+        metrics->set_gauge("alp_cache_bytes", double(s.n_bytes_in_gpu_cache), tier("gpu"));
+        metrics->set_gauge("alp_cache_bytes", double(s.n_bytes_in_warm_cache), tier("warm"));
+        metrics->set_gauge("alp_cache_bytes", double(s.n_bytes_in_disk_cache), tier("disk"));
+        metrics->set_counter("alp_cache_lookups", double(s.n_ram_cache_lookups), tier("ram"));
+        metrics->set_counter("alp_cache_hits", double(s.n_ram_cache_hits), tier("ram"));
+        metrics->set_counter("alp_cache_lookups", double(s.n_warm_cache_lookups), tier("warm"));
+        metrics->set_counter("alp_cache_hits", double(s.n_warm_cache_hits), tier("warm"));
+        metrics->set_gauge("alp_request_slots", s.n_request_slots);
+        metrics->set_counter("alp_disk_persists", s.n_persists);
+        metrics->set_gauge("alp_disk_persist_seconds", s.last_persist_msecs / 1000.0);
+        const auto latency = [&](const char* stage, const LatencyTracer::Percentiles& p) {
+            if (p.n_samples == 0)
+                return;
+            metrics->set_gauge("alp_tile_latency_seconds", p.p50 / 1000.0, { { "stage", stage }, { "quantile", "0.5" } });
+            metrics->set_gauge("alp_tile_latency_seconds", p.p95 / 1000.0, { { "stage", stage }, { "quantile", "0.95" } });
+            metrics->set_gauge("alp_tile_latency_seconds", p.p99 / 1000.0, { { "stage", stage }, { "quantile", "0.99" } });
+        };
+        for (unsigned i = 1; i < LatencyTracer::n_stages; ++i)
+            latency(LatencyTracer::stage_name(LatencyTracer::Stage(i)), s.tile_latency.stages[i]);
+        latency("total", s.tile_latency.total);
+    });
+
+    // on the network thread. the error rate is the share of responses with a status other than good.
+    const auto count_responses = [this, metrics](TileLoadService* service, const std::string& layer) {
+        if (!service)
+            return;
+        connect(service, &TileLoadService::load_finished, service, [metrics, layer](const tile_types::TileLayer& tile) {
+            using Status = tile_types::NetworkInfo::Status;
+            const auto status = tile.network_info.status == Status::Good ? "good" : (tile.network_info.status == Status::NotFound ? "not_found" : "error");
+            metrics->add("alp_tile_responses", 1, { { "layer", layer }, { "status", status } });
+            if (tile.data)
+                metrics->add("alp_network_bytes", double(tile.data->size()), { { "layer", layer } });
+        });
+    };
+    count_responses(m_terrain_service.get(), "height");
+    for (size_t i = 0; i < m_ortho_services.size(); ++i)
+        count_responses(m_ortho_services[i].get(), "ortho_" + (i < m_ortho_source_names.size() ? m_ortho_source_names[i] : std::to_string(i)));
+    count_responses(m_label_service.get(), "labels");
+
+    // frame times, gpu passes and memory
+    m_render_window->set_metrics(metrics);
+#else
+    Q_UNUSED(port);
+#endif
+}
+
+nucleus::camera::Controller* Controller::add_view(const camera::Definition& camera)
+{
+    const auto view_id = m_next_view_id++;
+    auto view = std::make_unique<nucleus::camera::Controller>(camera, m_render_window->depth_tester(), m_data_querier.get());
+    auto* sch = m_tile_scheduler.get();
+    connect(view.get(), &nucleus::camera::Controller::definition_changed, sch, [sch, view_id](const nucleus::camera::Definition& definition) {
+        sch->update_view_camera(view_id, definition);
+    });
+    connect(view.get(), &nucleus::camera::Controller::definition_changed, m_render_window, &AbstractRenderWindow::update_requested);
+    connect(view.get(), &nucleus::camera::Controller::update_pending, m_render_window, &AbstractRenderWindow::update_requested);
+    view->update();
+    return m_views.emplace_back(view_id, std::move(view)).second.get();
+}
+
+void Controller::remove_view(camera::Controller* view)
+{
+    const auto it = std::find_if(m_views.begin(), m_views.end(), [view](const auto& v) { return v.second.get() == view; });
+    if (it == m_views.end())
+        return;
+    QMetaObject::invokeMethod(m_tile_scheduler.get(), [sch = m_tile_scheduler.get(), view_id = it->first]() { sch->remove_view(view_id); });
+    m_views.erase(it);
+}
+
+void Controller::update_camera_requests()
+{
+    // the views coalesce their input like the main camera, it is flushed in the same frame
+    m_camera_controller->update_camera_request();
+    for (const auto& view : m_views)
+        view.second->update_camera_request();
+}
+
+void Controller::set_thread_policies(const nucleus::utils::ThreadPolicies& policies)
+{
+    // applied on the threads themselves, the nice value and affinity on linux are per thread
+    QMetaObject::invokeMethod(m_tile_scheduler.get(), [sch = m_tile_scheduler.get(), policies]() {
+        if (!policies.scheduler.apply_to_current_thread())
+            qDebug() << "Controller: the scheduler thread policy couldn't be applied (fully)";
+        sch->set_thread_policies(policies.decode, policies.io);
+    });
+#if defined(ALP_ENABLE_THREADING) && !defined(__EMSCRIPTEN__)
+    QMetaObject::invokeMethod(m_loading_chain.get(), [network = policies.network]() {
+        if (!network.apply_to_current_thread())
+            qDebug() << "Controller: the network thread policy couldn't be applied (fully)";
+    });
+#endif
+    m_render_window->set_upload_thread_policy(policies.upload);
+}
+
 Controller::~Controller()
 {
 #ifdef ALP_ENABLE_THREADING
     m_scheduler_thread->quit();
     m_scheduler_thread->wait(500); // msec
+    if (m_network_thread) {
+        m_network_thread->quit();
+        m_network_thread->wait(500); // msec
+    }
 #endif
 };
 
@@ -152,4 +463,35 @@ Scheduler* Controller::tile_scheduler() const
 {
     return m_tile_scheduler.get();
 }
+
+TileLoadService* Controller::height_service() const { return m_terrain_service.get(); }
+
+TileLoadService* Controller::ortho_service() const { return m_ortho_services[m_ortho_source].get(); }
+
+const std::vector<std::string>& Controller::ortho_source_names() const { return m_ortho_source_names; }
+
+unsigned Controller::ortho_source() const { return m_ortho_source; }
+
+void Controller::set_ortho_source(unsigned index)
+{
+    assert(index < m_ortho_services.size());
+    if (index == m_ortho_source)
+        return;
+    auto* old_service = m_ortho_services[m_ortho_source].get();
+    auto* new_service = m_ortho_services[index].get();
+    m_ortho_source = index;
+    // rewired on the network thread, so that no request is emitted in between. the ones in flight are finished by the old service.
+    QMetaObject::invokeMethod(m_layer_assembler, [la = m_layer_assembler, old_service, new_service]() {
+        QObject::disconnect(la, &LayerAssembler::ortho_requested, old_service, &TileLoadService::load);
+        QObject::connect(la, &LayerAssembler::ortho_requested, new_service, &TileLoadService::load);
+    });
+    QMetaObject::invokeMethod(m_tile_scheduler.get(), [sch = m_tile_scheduler.get(), index]() { sch->set_tile_source(index); });
+    m_data_querier->set_memory_cache(&m_tile_scheduler->ram_cache(index));
+}
+
+TileLoadService* Controller::label_service() const { return m_label_service.get(); }
+
+QuadAssembler* Controller::quad_assembler() const { return m_quad_assembler; }
+
+LayerAssembler* Controller::layer_assembler() const { return m_layer_assembler; }
 }
@@ -21,38 +21,108 @@
 #include <QNetworkAccessManager>
 #include <QObject>
 #include <memory>
+#include <string>
+#include <vector>
+
+#include "nucleus/tile_scheduler/tile_types.h"
 
 namespace nucleus {
 class AbstractRenderWindow;
 class DataQuerier;
+namespace utils {
+class MemoryPressureMonitor;
+class MetricsRegistry;
+class MetricsServer;
+struct ThreadPolicies;
+}
 namespace tile_scheduler {
 class TileLoadService;
+class TileSource;
+class QuadAssembler;
+class LayerAssembler;
 class Scheduler;
 }
 namespace camera {
 class Controller;
+class Definition;
 }
 
 class Controller : public QObject {
     Q_OBJECT
 public:
-    explicit Controller(AbstractRenderWindow* render_window);
+    // local tile sources (e.g. PackTileSources of a benchmark fixture) instead of the network, per layer. a layer without a
+    // source is loaded from its server. the labels are only loaded with a source or ALP_LABEL_TILE_URL.
+    struct LocalTileSources {
+        std::shared_ptr<tile_scheduler::TileSource> height;
+        std::shared_ptr<tile_scheduler::TileSource> ortho;
+        std::shared_ptr<tile_scheduler::TileSource> labels;
+        tile_scheduler::tile_types::TileFormat format; // of the sources, the servers serve the default format
+    };
+
+    explicit Controller(AbstractRenderWindow* render_window, const LocalTileSources& local_sources = {});
     ~Controller() override;
 
     camera::Controller* camera_controller() const;
 
     tile_scheduler::Scheduler* tile_scheduler() const;
 
+    // the services live on the network thread, connect with a context object there (e.g. the service itself)
+    tile_scheduler::TileLoadService* height_service() const;
+    tile_scheduler::TileLoadService* ortho_service() const; // of the current ortho source
+    tile_scheduler::TileLoadService* label_service() const; // nullptr without labels
+    // part of the loading chain, on the network thread as well (e.g., for the number of requests in flight)
+    tile_scheduler::QuadAssembler* quad_assembler() const;
+    tile_scheduler::LayerAssembler* layer_assembler() const;
+
+    // another camera onto the same tiles (e.g., an overview next to the main view). the quads of all views are scheduled together
+    // and shared on the gpu, render the view with gl_engine::Window::paint_view. the returned controller is owned by this.
+    camera::Controller* add_view(const camera::Definition& camera);
+    void remove_view(camera::Controller* view);
+    // camera::Controller::update_camera_request of the main camera and the added views, call once per frame. connected to
+    // AbstractRenderWindow::update_camera_requested.
+    void update_camera_requests();
+
+    // the ortho providers that can be switched between (only the local one, if there is a local ortho source). the scheduler keeps
+    // a cache per provider, switching back doesn't download the tiles again.
+    [[nodiscard]] const std::vector<std::string>& ortho_source_names() const;
+    [[nodiscard]] unsigned ortho_source() const;
+    void set_ortho_source(unsigned index);
+
+    // priorities and cores of the scheduler, network, decode, io and upload threads (the defaults come from ALP_THREAD_POLICIES).
+    // the workers stay below the render thread, which keeps the priority it was given by the platform.
+    void set_thread_policies(const utils::ThreadPolicies& policies);
+
+    // label tiles are loaded for these zoom levels. labels that are shown from further away are stored in coarser tiles.
+    static constexpr unsigned label_min_zoom = 8;
+    static constexpr unsigned label_max_zoom = 16;
+
 private:
+    // OpenMetrics endpoint on localhost:port (ALP_METRICS_PORT), for monitoring a fleet of renderers
+    void serve_metrics(quint16 port);
+
     AbstractRenderWindow* m_render_window;
     QNetworkAccessManager m_network_manager;
 #ifdef ALP_ENABLE_THREADING
     std::unique_ptr<QThread> m_scheduler_thread;
+    std::unique_ptr<QThread> m_network_thread; // load services and the loading chain, not used on webassembly
 #endif
     std::unique_ptr<tile_scheduler::TileLoadService> m_terrain_service;
-    std::unique_ptr<tile_scheduler::TileLoadService> m_ortho_service;
+    std::vector<std::unique_ptr<tile_scheduler::TileLoadService>> m_ortho_services; // one per ortho source
+    std::vector<std::string> m_ortho_source_names;
+    unsigned m_ortho_source = 0;
+    std::unique_ptr<tile_scheduler::TileLoadService> m_label_service; // only if ALP_LABEL_TILE_URL is set
+    std::unique_ptr<QObject> m_loading_chain; // parent of the limiters and assemblers between scheduler and load services
+    tile_scheduler::QuadAssembler* m_quad_assembler = nullptr; // owned by m_loading_chain
+    tile_scheduler::LayerAssembler* m_layer_assembler = nullptr;
     std::unique_ptr<tile_scheduler::Scheduler> m_tile_scheduler;
     std::unique_ptr<DataQuerier> m_data_querier;
     std::unique_ptr<camera::Controller> m_camera_controller;
+    std::vector<std::pair<unsigned, std::unique_ptr<camera::Controller>>> m_views; // view id (1..) and its camera
+    unsigned m_next_view_id = 1;
+    std::unique_ptr<utils::MemoryPressureMonitor> m_memory_pressure_monitor;
+    std::shared_ptr<utils::MetricsRegistry> m_metrics; // only if ALP_METRICS_PORT is set
+#ifndef __EMSCRIPTEN__
+    std::unique_ptr<utils::MetricsServer> m_metrics_server;
+#endif
 };
 }
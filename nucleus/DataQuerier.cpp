@@ -17,13 +17,98 @@
  *****************************************************************************/
 
 #include "DataQuerier.h"
+
+#include <QMetaObject>
+#include <QPointer>
+#include <QThreadPool>
+
 #include "tile_scheduler/cache_quieries.h"
 
-nucleus::DataQuerier::DataQuerier(tile_scheduler::MemoryCache* cache)
+nucleus::DataQuerier::DataQuerier(tile_scheduler::MemoryCache* cache, tile_scheduler::utils::AabbDecoratorPtr aabb_decorator)
     : m_memory_cache(cache)
-{}
+    , m_aabb_decorator(std::move(aabb_decorator))
+    , m_profile_worker(std::make_unique<QThreadPool>())
+{
+    m_profile_worker->setMaxThreadCount(1); // profiles are computed one after the other, they share the decoded tiles
+}
+
+nucleus::DataQuerier::~DataQuerier() = default;
+
+void nucleus::DataQuerier::set_memory_cache(tile_scheduler::MemoryCache* cache) { m_memory_cache = cache; }
 
 float nucleus::DataQuerier::get_altitude(const glm::dvec2& lat_long) const
 {
-    return tile_scheduler::cache_queries::query_altitude(m_memory_cache, lat_long);
+    return tile_scheduler::cache_queries::query_altitude(m_memory_cache, lat_long, [this](const auto& id, const auto& png) { return decoded_height(id, png); });
+}
+
+std::vector<float> nucleus::DataQuerier::get_altitudes(std::span<const glm::dvec2> lat_longs) const
+{
+    return tile_scheduler::cache_queries::query_altitudes(m_memory_cache, lat_longs, [this](const auto& id, const auto& png) { return decoded_height(id, png); });
+}
+
+std::optional<glm::dvec3> nucleus::DataQuerier::ray_cast(const glm::dvec3& origin, const glm::dvec3& direction) const
+{
+    if (!m_aabb_decorator)
+        return {};
+    return tile_scheduler::cache_queries::ray_cast(m_memory_cache, m_aabb_decorator, origin, glm::normalize(direction), [this](const auto& id, const auto& png) {
+        return decoded_height(id, png);
+    });
+}
+
+std::vector<std::optional<nucleus::DecodedHeightTile>> nucleus::DataQuerier::height_tiles(std::span<const glm::dvec2> world_positions) const
+{
+    std::vector<std::optional<DecodedHeightTile>> result(world_positions.size());
+    if (!m_memory_cache)
+        return result;
+    const auto tiles = tile_scheduler::cache_queries::find_height_tiles(m_memory_cache, world_positions);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (!tiles[i])
+            continue;
+        const auto raster = decoded_height(tiles[i]->id, *tiles[i]->height);
+        if (raster && raster->width() >= 2 && raster->height() >= 2)
+            result[i] = DecodedHeightTile { tiles[i]->id, raster };
+    }
+    return result;
+}
+
+nucleus::ElevationProfile nucleus::DataQuerier::elevation_profile(std::span<const glm::dvec2> polyline, double spacing, unsigned fetch_zoom_level) const
+{
+    return elevation_profile(m_memory_cache, polyline, spacing, fetch_zoom_level);
+}
+
+nucleus::ElevationProfile nucleus::DataQuerier::elevation_profile(tile_scheduler::MemoryCache* cache, std::span<const glm::dvec2> polyline, double spacing, unsigned fetch_zoom_level) const
+{
+    ElevationProfile profile;
+    profile.samples = tile_scheduler::cache_queries::sample_polyline(polyline, spacing);
+    if (!cache)
+        return profile;
+    tile_scheduler::cache_queries::query_profile(
+        cache,
+        profile.samples,
+        [this](const auto& id, const auto& png) { return decoded_height(id, png); },
+        fetch_zoom_level,
+        fetch_zoom_level > 0 ? &profile.missing_quads : nullptr);
+    return profile;
+}
+
+void nucleus::DataQuerier::request_elevation_profile(
+    std::vector<glm::dvec2> polyline, double spacing, unsigned fetch_zoom_level, QObject* context, std::function<void(ElevationProfile)> callback) const
+{
+    // the cache is taken now, set_memory_cache may switch it while the profile is computed
+    m_profile_worker->start([this, cache = m_memory_cache, polyline = std::move(polyline), spacing, fetch_zoom_level, context = QPointer<QObject>(context), callback = std::move(callback), fetcher = m_quad_fetcher]() mutable {
+        auto profile = elevation_profile(cache, polyline, spacing, fetch_zoom_level);
+        if (fetcher && !profile.missing_quads.empty())
+            fetcher(profile.missing_quads);
+        if (!context)
+            return;
+        QMetaObject::invokeMethod(context, [callback = std::move(callback), profile = std::move(profile)]() mutable { callback(std::move(profile)); }, Qt::QueuedConnection);
+    });
+}
+
+void nucleus::DataQuerier::set_quad_fetcher(std::function<void(std::vector<tile::Id>)> quad_fetcher) { m_quad_fetcher = std::move(quad_fetcher); }
+
+std::shared_ptr<const nucleus::Raster<uint16_t>> nucleus::DataQuerier::decoded_height(const tile::Id& id, const QByteArray& png) const
+{
+    std::scoped_lock lock(m_decoded_heights_mutex);
+    return m_decoded_heights.get_or_create(id, [&]() { return tile_scheduler::cache_queries::decode_height(id, png); });
 }
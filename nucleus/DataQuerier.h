@@ -18,18 +18,76 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Raster.h"
 #include "tile_scheduler/Cache.h"
+#include "tile_scheduler/cache_quieries.h"
+#include "tile_scheduler/utils.h"
+#include "utils/LruCache.h"
+
+class QObject;
+class QThreadPool;
 
 namespace nucleus {
 
+struct DecodedHeightTile {
+    tile::Id id;
+    std::shared_ptr<const Raster<uint16_t>> raster;
+};
+
+struct ElevationProfile {
+    std::vector<tile_scheduler::cache_queries::ProfileSample> samples;
+    std::vector<tile::Id> missing_quads; // finer height data that is not cached, coarse first (only with a fetch zoom level)
+};
+
 class DataQuerier
 {
     tile_scheduler::MemoryCache* m_memory_cache = nullptr;
+    tile_scheduler::utils::AabbDecoratorPtr m_aabb_decorator;
+    // decoded height tiles. tiles are immutable once they are in the ram cache, so entries never need to be invalidated.
+    mutable utils::LruCache<tile::Id, std::shared_ptr<const Raster<uint16_t>>, tile::Id::Hasher> m_decoded_heights { 64 };
+    mutable std::mutex m_decoded_heights_mutex;
+    std::function<void(std::vector<tile::Id>)> m_quad_fetcher;
+    std::unique_ptr<QThreadPool> m_profile_worker; // last, so that it waits for running profiles before the rest is destroyed
 
 public:
-    DataQuerier(tile_scheduler::MemoryCache* cache);
+    DataQuerier(tile_scheduler::MemoryCache* cache, tile_scheduler::utils::AabbDecoratorPtr aabb_decorator = {});
+    ~DataQuerier();
+    // e.g., of another tile source (see tile_scheduler::Scheduler::set_tile_source), the heights are the same
+    void set_memory_cache(tile_scheduler::MemoryCache* cache);
 
     [[nodiscard]] float get_altitude(const glm::dvec2& lat_long) const;
+    // batch version of get_altitude, every tile is decoded at most once
+    [[nodiscard]] std::vector<float> get_altitudes(std::span<const glm::dvec2> lat_longs) const;
+    // world space ray against the cached height data. nullopt if nothing was hit or no aabb decorator is set.
+    [[nodiscard]] std::optional<glm::dvec3> ray_cast(const glm::dvec3& origin, const glm::dvec3& direction) const;
+    // the finest decoded height tile for each world space position (xy), nullopt if it is not covered by the cache
+    [[nodiscard]] std::vector<std::optional<DecodedHeightTile>> height_tiles(std::span<const glm::dvec2> world_positions) const;
+
+    // elevation profile of a polyline (lat long, e.g., a gpx track), a sample every spacing metres (see
+    // cache_queries::sample_polyline), with the finest height data in the cache. fetch_zoom_level > 0 collects the missing quads
+    // down to that level.
+    [[nodiscard]] ElevationProfile elevation_profile(std::span<const glm::dvec2> polyline, double spacing, unsigned fetch_zoom_level = 0) const;
+    // the same on a worker thread, the callback runs in the thread of context (not at all if it was destroyed). with
+    // fetch_zoom_level > 0, the missing quads are handed to the quad fetcher. the result has the data that was cached at the time,
+    // request the profile again once the quads arrived (e.g., on tile_scheduler::Scheduler::quad_received).
+    void request_elevation_profile(std::vector<glm::dvec2> polyline,
+        double spacing,
+        unsigned fetch_zoom_level,
+        QObject* context,
+        std::function<void(ElevationProfile)> callback) const;
+    // called on the worker thread, e.g., with a queued call of tile_scheduler::Scheduler::request_quads. set it before requesting profiles.
+    void set_quad_fetcher(std::function<void(std::vector<tile::Id>)> quad_fetcher);
+
+private:
+    [[nodiscard]] std::shared_ptr<const Raster<uint16_t>> decoded_height(const tile::Id& id, const QByteArray& png) const;
+    [[nodiscard]] ElevationProfile elevation_profile(tile_scheduler::MemoryCache* cache, std::span<const glm::dvec2> polyline, double spacing, unsigned fetch_zoom_level) const;
 };
 
 } // namespace nucleus
@@ -18,43 +18,179 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <glm/glm.hpp>
 
+#include "utils/BufferPool.h"
+
 namespace nucleus {
 
+/// Storage of rasters: aligned for simd loads and stores, and the elements are default initialised, i.e., trivial types are
+/// not zeroed (the Raster constructors that promise a value fill explicitly).
+template <typename T>
+struct RasterAllocator {
+    using value_type = T;
+    static constexpr size_t alignment = std::max<size_t>(32, alignof(T));
+
+    RasterAllocator() = default;
+    template <typename U>
+    RasterAllocator(const RasterAllocator<U>&) noexcept { }
+
+    [[nodiscard]] T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment))); }
+    void deallocate(T* p, size_t) noexcept { ::operator delete(p, std::align_val_t(alignment)); }
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+    template <typename U>
+    bool operator==(const RasterAllocator<U>&) const noexcept
+    {
+        return true;
+    }
+};
+
+/// tag for the sized Raster constructor that leaves the pixels uninitialised, for callers that write all of them anyway
+struct Uninitialised { };
+inline constexpr Uninitialised uninitialised {};
+
+/// Non-owning view of width x height pixels in row major order without padding, e.g., of a Raster, of pooled memory or of a
+/// mapped pixel unpack buffer. T may be const. The memory must outlive the view.
+template <typename T>
+class RasterView {
+    T* m_data = nullptr;
+    size_t m_width = 0;
+    size_t m_height = 0;
+
+public:
+    RasterView() = default;
+    RasterView(T* data, const glm::uvec2& size)
+        : m_data(data)
+        , m_width(size.x)
+        , m_height(size.y)
+    {
+    }
+    // mutable to const
+    template <typename U>
+        requires std::is_same_v<const U, T>
+    RasterView(const RasterView<U>& other)
+        : m_data(other.data())
+        , m_width(other.width())
+        , m_height(other.height())
+    {
+    }
+
+    [[nodiscard]] size_t width() const { return m_width; }
+    [[nodiscard]] size_t height() const { return m_height; }
+    [[nodiscard]] glm::uvec2 size() const { return { m_width, m_height }; }
+    [[nodiscard]] size_t buffer_length() const { return m_width * m_height; }
+    [[nodiscard]] bool empty() const { return buffer_length() == 0; }
+    [[nodiscard]] T& pixel(const glm::uvec2& position) const { return m_data[position.x + m_width * position.y]; }
+    [[nodiscard]] T* data() const { return m_data; }
+    [[nodiscard]] auto* bytes() const
+    {
+        if constexpr (std::is_const_v<T>)
+            return reinterpret_cast<const uint8_t*>(m_data);
+        else
+            return reinterpret_cast<uint8_t*>(m_data);
+    }
+    T* begin() const { return m_data; }
+    T* end() const { return m_data + buffer_length(); }
+};
+
 template <typename T>
 class Raster {
-    std::vector<T> m_data;
+    // the buffers of decoded tiles (heights, normals) are recycled, see utils::BufferPool
+    static constexpr bool is_pooled = std::is_same_v<T, uint16_t> || std::is_same_v<T, glm::u8vec2>;
+
+public:
+    using Buffer = std::vector<T, RasterAllocator<T>>;
+    using Pool = utils::BufferPool<T, RasterAllocator<T>>;
+
+private:
+    Buffer m_data;
     size_t m_width = 0;
     size_t m_height = 0;
 
+    static Buffer make_buffer(size_t n_elements)
+    {
+        if constexpr (is_pooled)
+            return Pool::instance().take_uninitialised(n_elements);
+        else
+            return Buffer(n_elements);
+    }
+    static Buffer make_value_initialised_buffer(size_t n_elements)
+    {
+        auto buffer = make_buffer(n_elements);
+        if constexpr (std::is_trivially_default_constructible_v<T>)
+            std::fill(buffer.begin(), buffer.end(), T());
+        return buffer;
+    }
+    static Buffer make_buffer(size_t n_elements, const T& value)
+    {
+        if constexpr (is_pooled)
+            return Pool::instance().take(n_elements, value);
+        else
+            return Buffer(n_elements, value);
+    }
+
 public:
     Raster() = default;
-    Raster(size_t square_side_length, std::vector<T>&& vector)
+    Raster(const Raster&) = default;
+    Raster(Raster&&) noexcept = default;
+    Raster& operator=(const Raster&) = default;
+    Raster& operator=(Raster&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_data = std::move(other.m_data);
+            m_width = other.m_width;
+            m_height = other.m_height;
+        }
+        return *this;
+    }
+    ~Raster() { release(); }
+    Raster(size_t square_side_length, Buffer&& vector)
         : m_data(std::move(vector))
         , m_width(square_side_length)
         , m_height(square_side_length)
     {
         assert(m_data.size() == m_width * m_height);
     }
+    // value initialised (zero for arithmetic types)
     Raster(size_t square_side_length)
-        : m_data(square_side_length * square_side_length)
+        : m_data(make_value_initialised_buffer(square_side_length * square_side_length))
         , m_width(square_side_length)
         , m_height(square_side_length)
     {
     }
     Raster(const glm::uvec2& size)
-        : m_data(size.x * size.y)
+        : m_data(make_value_initialised_buffer(size_t(size.x) * size.y))
         , m_width(size.x)
         , m_height(size.y)
     {
     }
     Raster(const glm::uvec2& size, const T& fill_value)
-        : m_data(size.x * size.y, fill_value)
+        : m_data(make_buffer(size_t(size.x) * size.y, fill_value))
+        , m_width(size.x)
+        , m_height(size.y)
+    {
+    }
+    Raster(const glm::uvec2& size, Uninitialised)
+        : m_data(make_buffer(size_t(size.x) * size.y))
         , m_width(size.x)
         , m_height(size.y)
     {
@@ -62,6 +198,8 @@ public:
 
     [[nodiscard]] const auto& buffer() const { return m_data; }
     [[nodiscard]] auto& buffer() { return m_data; }
+    [[nodiscard]] RasterView<const T> view() const { return { m_data.data(), size() }; }
+    [[nodiscard]] RasterView<T> view() { return { m_data.data(), size() }; }
     [[nodiscard]] size_t width() const { return m_width; }
     [[nodiscard]] size_t height() const { return m_height; }
     [[nodiscard]] glm::uvec2 size() const { return { m_width, m_height }; }
@@ -93,5 +231,12 @@ public:
 
     const T* data() const { return m_data.data(); }
     T* data() { return m_data.data(); }
+
+private:
+    void release()
+    {
+        if constexpr (is_pooled)
+            Pool::instance().give_back(std::move(m_data));
+    }
 };
 }
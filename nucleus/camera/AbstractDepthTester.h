@@ -28,7 +28,7 @@ public:
     [[nodiscard]] virtual float depth(const glm::dvec2& normalised_device_coordinates) = 0;
     [[nodiscard]] virtual glm::dvec3 position(const glm::dvec2& normalised_device_coordinates) = 0;
 
-    //TODO implement this for other directions
-    //[[nodiscard]] virtual glm::dvec3 ray_cast(const Definition& camera, const glm::dvec2& normalised_device_coordinates) = 0;
+    // both methods use the depth buffer, i.e., they only work for rays through the camera origin.
+    // rays in other directions are cast on the cpu against the cached height data, see DataQuerier::ray_cast.
 };
 }
@@ -41,6 +41,7 @@ Controller::Controller(const Definition& camera,
     : m_definition(camera)
     , m_depth_tester(depth_tester)
     , m_data_querier(data_querier)
+    , m_ground_height(data_querier)
     , m_interaction_style(std::make_unique<OrbitInteraction>())
 {
 }
@@ -69,15 +70,21 @@ void Controller::fly_to_latitude_longitude(double latitude, double longitude)
     const auto xy_world_space = srs::lat_long_to_world({latitude, longitude});
     const auto look_at_point = glm::dvec3(xy_world_space,
                                           m_data_querier->get_altitude({latitude, longitude}));
-    const auto camera_position = look_at_point + glm::normalize(glm::dvec3{0, -1, 1}) * 5000.;
-
-    auto end_camera = m_definition;
-    end_camera.look_at(camera_position, look_at_point);
+    const auto end_camera = fly_to_target(m_definition, look_at_point);
 
     m_animation_style = std::make_unique<LinearCameraAnimation>(m_definition, end_camera);
+    emit animation_target_changed(end_camera);
     update();
 }
 
+Definition Controller::fly_to_target(const Definition& camera, const glm::dvec3& look_at_point)
+{
+    const auto camera_position = look_at_point + glm::normalize(glm::dvec3{0, -1, 1}) * 5000.;
+    auto end_camera = camera;
+    end_camera.look_at(camera_position, look_at_point);
+    return end_camera;
+}
+
 void Controller::rotate_north()
 {
     m_animation_style = std::make_unique<RotateNorthAnimation>(m_definition, m_depth_tester);
@@ -110,9 +117,24 @@ void Controller::orbit(const glm::dvec3& centre, const glm::dvec2& degrees)
 
 void Controller::update() const
 {
+    m_update_pending = false;
     emit definition_changed(m_definition);
 }
 
+void Controller::schedule_update()
+{
+    if (m_update_pending)
+        return;
+    m_update_pending = true;
+    emit update_pending();
+}
+
+void Controller::flush()
+{
+    if (m_update_pending)
+        update();
+}
+
 void Controller::mouse_press(const event_parameter::Mouse& e)
 {
     report_global_cursor_position(e.point.position());
@@ -126,7 +148,7 @@ void Controller::mouse_press(const event_parameter::Mouse& e)
     if (!new_definition)
         return;
     m_definition = new_definition.value();
-    update();
+    schedule_update();
 }
 
 void Controller::mouse_move(const event_parameter::Mouse& e)
@@ -141,7 +163,7 @@ void Controller::mouse_move(const event_parameter::Mouse& e)
 
     m_definition = new_definition.value();
 
-    update();
+    schedule_update();
 }
 
 void Controller::wheel_turn(const event_parameter::Wheel& e)
@@ -155,7 +177,7 @@ void Controller::wheel_turn(const event_parameter::Wheel& e)
     if (!new_definition)
         return;
     m_definition = new_definition.value();
-    update();
+    schedule_update();
 }
 
 void Controller::key_press(const QKeyCombination& e)
@@ -169,7 +191,7 @@ void Controller::key_press(const QKeyCombination& e)
         m_interaction_style = std::make_unique<OrbitInteraction>();
     }
     if (e.key() == Qt::Key_2) {
-        m_interaction_style = std::make_unique<FirstPersonInteraction>();
+        m_interaction_style = std::make_unique<FirstPersonInteraction>(&m_ground_height);
     }
     if (e.key() == Qt::Key_3) {
         m_interaction_style = std::make_unique<CadInteraction>();
@@ -181,7 +203,7 @@ void Controller::key_press(const QKeyCombination& e)
     if (!new_definition)
         return;
     m_definition = new_definition.value();
-    update();
+    schedule_update();
 }
 
 void Controller::key_release(const QKeyCombination& e)
@@ -190,7 +212,7 @@ void Controller::key_release(const QKeyCombination& e)
     if (!new_definition)
         return;
     m_definition = new_definition.value();
-    update();
+    schedule_update();
 }
 
 void Controller::touch(const event_parameter::Touch& e)
@@ -204,27 +226,32 @@ void Controller::touch(const event_parameter::Touch& e)
     if (!new_definition)
         return;
     m_definition = new_definition.value();
-    update();
+    schedule_update();
 }
 
 void Controller::update_camera_request()
 {
+    // cheap unless the camera left the centre tile, the hot tiles are used for clamping by the animations and interactions
+    m_ground_height.update(glm::dvec2(m_definition.position()));
     if (m_animation_style) {
         const auto new_camera_definition = m_animation_style->update(m_definition, m_depth_tester);
-        if (!new_camera_definition) {
+        if (new_camera_definition) {
+            m_definition = new_camera_definition.value();
+            m_ground_height.update(glm::dvec2(m_definition.position())); // animations can jump further than the hot tiles
+            m_ground_height.clamp(m_definition, animation_ground_clearance);
+            m_update_pending = true;
+        } else {
             m_animation_style.reset();
             m_interaction_style->reset_interaction(m_definition, m_depth_tester);
-            return;
         }
-        m_definition = new_camera_definition.value();
-        update();
     } else {
         const auto new_definition = m_interaction_style->update(m_definition, m_depth_tester);
-        if (!new_definition)
-            return;
-        m_definition = new_definition.value();
-        update();
+        if (new_definition) {
+            m_definition = new_definition.value();
+            m_update_pending = true;
+        }
     }
+    flush();
 }
 
 std::optional<glm::vec2> Controller::operation_centre()
@@ -29,6 +29,7 @@
 
 #include "AnimationStyle.h"
 #include "Definition.h"
+#include "GroundHeight.h"
 #include "InteractionStyle.h"
 #include "nucleus/event_parameter.h"
 
@@ -52,6 +53,8 @@ public:
     std::optional<float> operation_centre_distance();
 
 	void report_global_cursor_position(const QPointF& screen_pos);
+    /// end camera of fly_to_latitude_longitude: looks at look_at_point (world space) from 5 km south and above
+    [[nodiscard]] static Definition fly_to_target(const Definition& camera, const glm::dvec3& look_at_point);
 
 public slots:
     void set_definition(const Definition& new_definition);
@@ -62,7 +65,10 @@ public slots:
     void set_field_of_view(float fov_degrees);
     void move(const glm::dvec3& v);
     void orbit(const glm::dvec3& centre, const glm::dvec2& degrees);
+    // emits definition_changed immediately
     void update() const;
+    // emits definition_changed if input arrived since the last update
+    void flush();
 
     void mouse_press(const event_parameter::Mouse&);
     void mouse_move(const event_parameter::Mouse&);
@@ -70,22 +76,33 @@ public slots:
     void key_press(const QKeyCombination&);
     void key_release(const QKeyCombination&);
     void touch(const event_parameter::Touch&);
+    // call once per frame. advances animations and interactions, and emits at most one definition_changed for all input since the
+    // last frame
     void update_camera_request();
 
 signals:
     void definition_changed(const Definition& new_definition) const;
+    // input changed the camera. emitted once until the next update, connect to something that requests a frame.
+    void update_pending() const;
     void global_cursor_position_changed(glm::dvec3 pos) const;
+    // where an animation (e.g. fly to) will end, for prefetching
+    void animation_target_changed(const Definition& target) const;
 
 private:
     void set_interaction_style(std::unique_ptr<InteractionStyle> new_style);
     void set_animation_style(std::unique_ptr<InteractionStyle> new_style);
+    // input events only mark the definition as changed, it is emitted with the next update_camera_request
+    void schedule_update();
+    static constexpr double animation_ground_clearance = 20.0; // metres, animations cut through ridges otherwise
 
     Definition m_definition;
     AbstractDepthTester* m_depth_tester;
     DataQuerier* m_data_querier;
+    GroundHeight m_ground_height; // before the interaction style, which can point to it
     std::unique_ptr<InteractionStyle> m_interaction_style;
     std::unique_ptr<AnimationStyle> m_animation_style;
     std::chrono::steady_clock::time_point m_last_frame_time;
+    mutable bool m_update_pending = false;
 };
 
 }
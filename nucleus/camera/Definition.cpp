@@ -20,9 +20,11 @@
 
 #include "Definition.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <QDebug>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtx/transform.hpp>
 
 #include "radix/geometry.h"
@@ -73,6 +75,12 @@ glm::dmat4 Definition::projection_matrix() const
     return m_projection_matrix;
 }
 
+glm::dmat4 Definition::jittered_projection_matrix(const glm::dvec2& ndc_offset) const
+{
+    // the translation is scaled by w, i.e., it is applied after the perspective division
+    return glm::translate(glm::dvec3(ndc_offset, 0.0)) * m_projection_matrix;
+}
+
 glm::mat4 Definition::local_view_matrix() const
 {
     return camera_matrix() * glm::translate(this->position());
@@ -166,6 +174,53 @@ Frustum Definition::frustum() const
     return frustum;
 }
 
+Definition nucleus::camera::interpolate(const Definition& from, const Definition& to, double t)
+{
+    t = std::clamp(t, 0.0, 1.0);
+    auto camera = t < 1.0 ? from : to;
+    const auto from_direction = -from.z_axis();
+    const auto to_direction = -to.z_axis();
+    const auto angle = std::acos(std::clamp(glm::dot(from_direction, to_direction), -1.0, 1.0));
+    auto direction = to_direction;
+    if (angle > 1e-6 && angle < glm::pi<double>() - 1e-6)
+        direction = (std::sin((1.0 - t) * angle) * from_direction + std::sin(t * angle) * to_direction) / std::sin(angle);
+    else if (angle <= 1e-6)
+        direction = from_direction;
+    const auto position = glm::mix(from.position(), to.position(), t);
+    camera.look_at(position, position + direction);
+    camera.set_field_of_view(glm::mix(from.field_of_view(), to.field_of_view(), float(t)));
+    return camera;
+}
+
+Frustum nucleus::camera::frustum_from_matrix(const glm::dmat4& world_to_clip)
+{
+    // Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+    const auto row = [&world_to_clip](int i) { return glm::dvec4(world_to_clip[0][i], world_to_clip[1][i], world_to_clip[2][i], world_to_clip[3][i]); };
+    const auto plane = [](const glm::dvec4& p) {
+        const auto length = glm::length(glm::dvec3(p));
+        return geometry::Plane<double> { glm::dvec3(p) / length, p.w / length };
+    };
+    Frustum frustum;
+    frustum.clipping_planes[0] = plane(row(3) + row(2)); // front
+    frustum.clipping_planes[1] = plane(row(3) - row(2)); // back
+    frustum.clipping_planes[2] = plane(row(3) - row(1)); // top
+    frustum.clipping_planes[3] = plane(row(3) + row(1)); // down
+    frustum.clipping_planes[4] = plane(row(3) + row(0)); // left
+    frustum.clipping_planes[5] = plane(row(3) - row(0)); // right
+
+    const auto inverse = glm::inverse(world_to_clip);
+    const auto unproject = [&inverse](const glm::dvec3& ndc) {
+        const auto p = inverse * glm::dvec4(ndc, 1.0);
+        return glm::dvec3(p) / p.w;
+    };
+    constexpr auto corners_ndc = std::array { glm::dvec2 { -1, 1 }, glm::dvec2 { -1, -1 }, glm::dvec2 { 1, -1 }, glm::dvec2 { 1, 1 } };
+    for (unsigned i = 0; i < 4; ++i) {
+        frustum.corners[i] = unproject({ corners_ndc[i], -1.0 });
+        frustum.corners[i + 4] = unproject({ corners_ndc[i], 1.0 });
+    }
+    return frustum;
+}
+
 std::array<geometry::Plane<double>, 6> Definition::clipping_planes() const
 {
     return frustum().clipping_planes;
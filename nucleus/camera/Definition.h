@@ -33,6 +33,9 @@
      std::array<glm::dvec3, 8> corners; // the order of corners is ccw, starting from top left, front plane -> back plane
 };
 
+// computes the frustum of an arbitrary (e.g., orthographic) world to clip space transformation. planes point inwards.
+Frustum frustum_from_matrix(const glm::dmat4& world_to_clip);
+
 class Definition {
 public:
     Definition();
@@ -41,6 +44,8 @@ public:
     [[nodiscard]] glm::dmat4 camera_space_to_world_matrix() const;
     void set_camera_space_to_world_matrix(const glm::dmat4& new_camera_transformation);
     [[nodiscard]] glm::dmat4 projection_matrix() const;
+    // projection_matrix shifted by ndc_offset (in normalised device coordinates, 2 / size is one pixel), e.g., for temporal upsampling.
+    [[nodiscard]] glm::dmat4 jittered_projection_matrix(const glm::dvec2& ndc_offset) const;
     // transforms from webmercator to clip space. You should use this matrix only in double precision.
     [[nodiscard]] glm::dmat4 world_view_projection_matrix() const;
     // transforms form the local coordinate system (webmercator shifted by origin_offset) to clip space.
@@ -93,4 +98,8 @@ private:
     glm::uvec2 m_viewport_size = { 480, 270 };
 };
 
+// camera between two cameras, t in [0, 1]: the position is interpolated linearly, the view direction spherically. the other
+// parameters (viewport, clipping) are the ones of from, or of to for t = 1.
+Definition interpolate(const Definition& from, const Definition& to, double t);
+
 }
@@ -19,11 +19,17 @@
 
 #include "FirstPersonInteraction.h"
 #include "AbstractDepthTester.h"
+#include "GroundHeight.h"
 
 #include <QDebug>
 
 namespace nucleus::camera {
 
+FirstPersonInteraction::FirstPersonInteraction(const GroundHeight* ground)
+    : m_ground(ground)
+{
+}
+
 std::optional<Definition> FirstPersonInteraction::mouse_move_event(const event_parameter::Mouse& e, Definition camera, AbstractDepthTester*)
 {
 
@@ -139,6 +145,8 @@ std::optional<Definition> FirstPersonInteraction::update(Definition camera, Abst
     } else {
         camera.move(direction * (dt / 30 * m_speed_modifyer));
     }
+    if (m_ground)
+        m_ground->clamp(camera, eye_height);
     return camera;
 }
 }
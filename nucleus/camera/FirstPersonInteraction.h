@@ -23,8 +23,11 @@
 #include "nucleus/utils/Stopwatch.h"
 
 namespace nucleus::camera {
+class GroundHeight;
+
 class FirstPersonInteraction : public InteractionStyle
 {
+    const GroundHeight* m_ground = nullptr;
     utils::Stopwatch m_stopwatch = {};
     float m_speed_modifyer = 13;
     int m_keys_pressed = 0;
@@ -36,6 +39,9 @@ class FirstPersonInteraction : public InteractionStyle
     bool m_key_q = false;
     bool m_key_shift = false;
 public:
+    static constexpr double eye_height = 2.0; // metres above ground
+    // the camera is kept above the terrain if ground is set (it must outlive the interaction)
+    explicit FirstPersonInteraction(const GroundHeight* ground = nullptr);
     std::optional<Definition> mouse_move_event(const event_parameter::Mouse& e, Definition camera, AbstractDepthTester* depth_tester) override;
     std::optional<Definition> wheel_event(const event_parameter::Wheel& e, Definition camera, AbstractDepthTester* depth_tester) override;
     std::optional<Definition> key_press_event(const QKeyCombination& e, Definition camera, AbstractDepthTester* depth_tester) override;
@@ -0,0 +1,101 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "GroundHeight.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "nucleus/DataQuerier.h"
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/cache_quieries.h"
+
+namespace nucleus::camera {
+
+GroundHeight::GroundHeight(const DataQuerier* data_querier)
+    : m_data_querier(data_querier)
+{
+}
+
+void GroundHeight::update(const glm::dvec2& world_xy)
+{
+    if (!m_tiles.empty() && m_tiles.front().bounds.contains(world_xy) && m_since_refresh.total() < m_refresh_interval)
+        return;
+    refresh(world_xy);
+}
+
+void GroundHeight::invalidate() { m_tiles.clear(); }
+
+void GroundHeight::set_refresh_interval(std::chrono::milliseconds interval) { m_refresh_interval = interval; }
+
+void GroundHeight::refresh(const glm::dvec2& world_xy)
+{
+    m_since_refresh.restart();
+    m_tiles.clear();
+    if (!m_data_querier)
+        return;
+    const auto centre = m_data_querier->height_tiles(std::array { world_xy }).front();
+    if (!centre)
+        return;
+    const auto bounds = srs::tile_bounds(centre->id);
+    m_tiles.push_back({ centre->id, bounds, centre->raster });
+
+    // one position in each neighbour of the centre tile. the neighbours can be coarser, then several positions share a tile.
+    const auto size = bounds.size();
+    const auto mid = bounds.min + size * 0.5;
+    std::vector<glm::dvec2> positions;
+    positions.reserve(8);
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            if (x != 0 || y != 0)
+                positions.push_back(mid + glm::dvec2(x, y) * size);
+        }
+    }
+    for (const auto& tile : m_data_querier->height_tiles(positions)) {
+        if (!tile || std::any_of(m_tiles.begin(), m_tiles.end(), [&](const HotTile& t) { return t.id == tile->id; }))
+            continue;
+        m_tiles.push_back({ tile->id, srs::tile_bounds(tile->id), tile->raster });
+    }
+}
+
+std::optional<double> GroundHeight::altitude(const glm::dvec2& world_xy) const
+{
+    for (const auto& tile : m_tiles) {
+        if (tile.bounds.contains(world_xy))
+            return tile_scheduler::cache_queries::detail::sample_altitude(*tile.raster, tile.bounds, world_xy);
+    }
+    return {};
+}
+
+bool GroundHeight::clamp(Definition& camera, double clearance) const
+{
+    const auto position = camera.position();
+    const auto ground = altitude(glm::dvec2(position));
+    if (!ground)
+        return false;
+    // world space is scaled like web mercator, so is the clearance (see cache_queries::detail::sample_altitude)
+    const auto latitude = srs::world_to_lat_long(glm::dvec2(position)).x;
+    const auto min_z = *ground + clearance / std::abs(std::cos(latitude * 3.14159265358979323846 / 180.0));
+    if (position.z >= min_z)
+        return false;
+    camera.move({ 0, 0, min_z - position.z });
+    return true;
+}
+
+} // namespace nucleus::camera
@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <radix/tile.h>
+
+#include "Definition.h"
+#include "nucleus/Raster.h"
+#include "nucleus/utils/Stopwatch.h"
+
+namespace nucleus {
+class DataQuerier;
+}
+
+namespace nucleus::camera {
+
+/// keeps the decoded height tiles under and around the camera hot, so that the ground can be sampled every frame without walking
+/// the cache. update() refreshes the 3x3 neighbourhood of the finest cached tile when the camera leaves it, and every
+/// refresh_interval to pick up finer tiles that arrived in the meantime. queries only touch the hot tiles.
+class GroundHeight
+{
+public:
+    explicit GroundHeight(const DataQuerier* data_querier);
+
+    void update(const glm::dvec2& world_xy);
+    void invalidate();
+    void set_refresh_interval(std::chrono::milliseconds interval);
+
+    // world space altitude (z), bilinearly interpolated. nullopt if the position is not covered by the hot tiles.
+    [[nodiscard]] std::optional<double> altitude(const glm::dvec2& world_xy) const;
+    // moves the camera up, so that it is at least clearance metres above the ground. returns false if it was not moved.
+    bool clamp(Definition& camera, double clearance) const;
+    [[nodiscard]] size_t n_hot_tiles() const { return m_tiles.size(); }
+
+private:
+    struct HotTile {
+        tile::Id id;
+        tile::SrsBounds bounds;
+        std::shared_ptr<const Raster<uint16_t>> raster;
+    };
+    void refresh(const glm::dvec2& world_xy);
+
+    const DataQuerier* m_data_querier;
+    std::vector<HotTile> m_tiles; // the centre tile first
+    utils::Stopwatch m_since_refresh;
+    std::chrono::milliseconds m_refresh_interval = std::chrono::milliseconds(500);
+};
+
+} // namespace nucleus::camera
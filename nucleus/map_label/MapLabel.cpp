@@ -19,6 +19,8 @@
 #include "MapLabel.h"
 
 
+#include <limits>
+
 #include <QDebug>
 #include <stb_slim/stb_truetype.h>
 
@@ -26,18 +28,19 @@
 
 namespace nucleus {
 
-void MapLabel::init(const std::unordered_map<char16_t, const CharData>& character_data, const stbtt_fontinfo* fontinfo, const float uv_width_norm)
+void MapLabel::init(const std::unordered_map<char16_t, const CharData>& character_data, const stbtt_fontinfo* fontinfo, const float uv_width_norm, const float glyph_scale)
 {
     constexpr float offset_y = -font_size / 2.0f + 100.0f;
     constexpr float icon_offset_y = 15.0f;
 
     QString rendered_text = QString("%1 (%2m)").arg(m_text).arg(double(m_altitude), 0, 'f', 0);
 
-    glm::vec3 label_position = nucleus::srs::lat_long_alt_to_world({ m_latitude, m_longitude, m_altitude });
+    m_world_position = nucleus::srs::lat_long_alt_to_world({ m_latitude, m_longitude, m_altitude });
+    glm::vec3 label_position = m_world_position;
 
     auto safe_chars = rendered_text.toStdU16String();
     float text_width = 0;
-    std::vector<float> kerningOffsets = create_text_meta(character_data, fontinfo, &safe_chars, &text_width);
+    std::vector<float> kerningOffsets = create_text_meta(character_data, fontinfo, glyph_scale, &safe_chars, &text_width);
 
     // center the text around the center
     const auto offset_x = -text_width / 2.0f;
@@ -51,10 +54,19 @@ void MapLabel::init(const std::unordered_map<char16_t, const CharData>& characte
 
         const MapLabel::CharData b = character_data.at(safe_chars[i]);
 
-        m_vertex_data.push_back({ glm::vec4(offset_x + kerningOffsets[i] + b.xoff, offset_y - b.yoff, b.width, -b.height), // vertex position + offset
+        m_vertex_data.push_back({ glm::vec4(offset_x + kerningOffsets[i] + b.xoff * glyph_scale, offset_y - b.yoff * glyph_scale, b.width * glyph_scale, -b.height * glyph_scale), // vertex position + offset
             glm::vec4(b.x * uv_width_norm, b.y * uv_width_norm, b.width * uv_width_norm, b.height * uv_width_norm), // uv position + offset
             label_position, m_importance });
     }
+
+    m_extent_min = glm::vec2(std::numeric_limits<float>::max());
+    m_extent_max = glm::vec2(std::numeric_limits<float>::lowest());
+    for (const auto& v : m_vertex_data) {
+        const auto corner_a = glm::vec2(v.position.x, v.position.y);
+        const auto corner_b = corner_a + glm::vec2(v.position.z, v.position.w);
+        m_extent_min = glm::min(m_extent_min, glm::min(corner_a, corner_b));
+        m_extent_max = glm::max(m_extent_max, glm::max(corner_a, corner_b));
+    }
 }
 
 const std::vector<MapLabel::VertexData>& MapLabel::vertex_data() const
@@ -63,7 +75,7 @@ const std::vector<MapLabel::VertexData>& MapLabel::vertex_data() const
 }
 
 // calculate char offsets and text width
-std::vector<float> inline MapLabel::create_text_meta(const std::unordered_map<char16_t, const MapLabel::CharData>& character_data, const stbtt_fontinfo* fontinfo, std::u16string* safe_chars, float* text_width)
+std::vector<float> inline MapLabel::create_text_meta(const std::unordered_map<char16_t, const MapLabel::CharData>& character_data, const stbtt_fontinfo* fontinfo, float glyph_scale, std::u16string* safe_chars, float* text_width)
 {
     std::vector<float> kerningOffsets;
 
@@ -95,7 +107,7 @@ std::vector<float> inline MapLabel::create_text_meta(const std::unordered_map<ch
         }
         const MapLabel::CharData b = character_data.at(safe_chars->back());
 
-        *text_width = xOffset + b.width;
+        *text_width = xOffset + b.width * glyph_scale;
     }
 
     return kerningOffsets;
@@ -52,17 +52,26 @@ public:
     {
     }
 
-    void init(const std::unordered_map<char16_t, const MapLabel::CharData>& character_data, const stbtt_fontinfo* fontinfo, const float uv_width_norm);
+    // glyph_scale: label pixels per atlas pixel (the atlas can be rendered at another font size)
+    void init(const std::unordered_map<char16_t, const MapLabel::CharData>& character_data, const stbtt_fontinfo* fontinfo, const float uv_width_norm, const float glyph_scale = 1.0f);
 
     constexpr static float font_size = 48.0f;
     constexpr static glm::vec2 icon_size = glm::vec2(48.0f);
 
     const std::vector<VertexData>& vertex_data() const;
+    [[nodiscard]] const glm::dvec3& world_position() const { return m_world_position; }
+    [[nodiscard]] float importance() const { return m_importance; }
+    // bounds of all quads relative to the anchor, in label pixels. valid after init.
+    [[nodiscard]] glm::vec2 extent_min() const { return m_extent_min; }
+    [[nodiscard]] glm::vec2 extent_max() const { return m_extent_max; }
 
 private:
-    std::vector<float> inline create_text_meta(const std::unordered_map<char16_t, const CharData>& character_data, const stbtt_fontinfo* fontinfo, std::u16string* safe_chars, float* text_width);
+    std::vector<float> inline create_text_meta(const std::unordered_map<char16_t, const CharData>& character_data, const stbtt_fontinfo* fontinfo, float glyph_scale, std::u16string* safe_chars, float* text_width);
 
     std::vector<VertexData> m_vertex_data;
+    glm::dvec3 m_world_position = {};
+    glm::vec2 m_extent_min = {};
+    glm::vec2 m_extent_max = {};
 
     QString m_text;
     double m_latitude;
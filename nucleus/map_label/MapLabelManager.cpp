@@ -18,12 +18,15 @@
 
 #include "MapLabelManager.h"
 
+#include <algorithm>
+
 #include <QDebug>
 #include <QFile>
 #include <QIcon>
 #include <QSize>
 #include <QStringLiteral>
 
+#include "font_atlas_cache.h"
 #include "nucleus/Raster.h"
 
 #define STBTT_STATIC
@@ -36,6 +39,10 @@ namespace nucleus {
 
 MapLabelManager::MapLabelManager()
 {
+    if (!QString(ALP_LABEL_TILE_URL).isEmpty()) {
+        init();
+        return;
+    }
     //    const char8_t text;
     //    double latitude;
     //    double longitude;
@@ -85,23 +92,34 @@ void MapLabelManager::init()
     m_indices.push_back(2);
     m_indices.push_back(3);
 
-    m_font_atlas = make_outline(make_font_raster());
-    {
-        Raster<glm::u8vec4> rgba_raster = { m_font_atlas.size(), { 255, 255, 0, 255 } };
-        std::transform(m_font_atlas.cbegin(), m_font_atlas.cend(), rgba_raster.begin(), [](const auto& v) { return glm::u8vec4(v.x, v.y, 0, 255); });
-
-        // const auto debug_out = QImage(rgba_raster.bytes(), m_font_atlas_size.width(), m_font_atlas_size.height(), QImage::Format_RGBA8888);
-        // debug_out.save("font_atlas.png");
+    load_font();
+    // rendering the distance fields takes long, the atlas is cached on disk (font_atlas_cache)
+    const auto parameters = QString("%1 %2 %3 %4x%5 %6x%7")
+                                .arg(double(sdf_font_size))
+                                .arg(sdf_padding)
+                                .arg(double(sdf_pixel_dist_scale))
+                                .arg(m_font_atlas_size.width())
+                                .arg(m_font_atlas_size.height())
+                                .arg(m_font_padding.x)
+                                .arg(m_font_padding.y)
+                                .toUtf8();
+    const auto cache_key = font_atlas_cache::key(m_font_file, all_char_list, parameters);
+    if (auto cached = font_atlas_cache::load(cache_key)) {
+        m_font_atlas = std::move(cached->raster);
+        m_char_data = std::move(cached->char_data);
+    } else {
+        m_font_atlas = make_font_atlas();
+        font_atlas_cache::store(cache_key, m_font_atlas, m_char_data);
     }
 
     for (auto& label : m_labels) {
-        label.init(m_char_data, &m_fontinfo, uv_width_norm);
+        label.init(m_char_data, &m_fontinfo, uv_width_norm, MapLabel::font_size / sdf_font_size);
     }
 
     m_icon = QImage(":/map_icons/peak.png");
 }
 
-Raster<uint8_t> MapLabelManager::make_font_raster()
+void MapLabelManager::load_font()
 {
     // load ttf file
     QFile file(":/fonts/Roboto/Roboto-Bold.ttf");
@@ -115,94 +133,70 @@ Raster<uint8_t> MapLabelManager::make_font_raster()
         stbtt_GetFontOffsetForIndex(reinterpret_cast<const uint8_t*>(m_font_file.constData()), 0));
     assert(font_init);
     Q_UNUSED(font_init);
+}
 
+Raster<uint8_t> MapLabelManager::make_font_atlas()
+{
+    m_char_data.clear();
     auto raster = Raster<uint8_t>({ m_font_atlas_size.width(), m_font_atlas_size.height() }, uint8_t(0));
 
     const auto safe_chars = all_char_list.toStdU16String();
 
-    float scale = stbtt_ScaleForPixelHeight(&m_fontinfo, MapLabel::font_size);
+    const float scale = stbtt_ScaleForPixelHeight(&m_fontinfo, sdf_font_size);
 
-    int outline_margin = int(std::ceil(m_font_outline));
-    int x = outline_margin + m_font_padding.x;
-    int y = outline_margin + m_font_padding.y;
-    int bottom_y = outline_margin + m_font_padding.y;
+    int x = m_font_padding.x;
+    int y = m_font_padding.y;
+    int bottom_y = m_font_padding.y;
 
     for (const char16_t& c : safe_chars) {
-        // code adapted from stbtt_BakeFontBitmap()
-        int x0, y0, x1, y1;
+        // the sdf bitmap includes the padding, xoff / yoff are relative to the origin of the glyph
+        int glyph_width = 0, glyph_height = 0, xoff = 0, yoff = 0;
         const int glyph_index = stbtt_FindGlyphIndex(&m_fontinfo, c);
-        stbtt_GetGlyphBitmapBox(&m_fontinfo, glyph_index, scale, scale, &x0, &y0, &x1, &y1);
+        uint8_t* sdf = stbtt_GetGlyphSDF(&m_fontinfo, scale, glyph_index, sdf_padding, 128, sdf_pixel_dist_scale, &glyph_width, &glyph_height, &xoff, &yoff);
+        if (!sdf) { // no outline (e.g. space)
+            glyph_width = 0;
+            glyph_height = 0;
+        }
 
-        const auto glyph_width = x1 - x0;
-        const auto glyph_height = y1 - y0;
-        if (x + glyph_width + 2 * outline_margin + m_font_padding.x >= m_font_atlas_size.width()) {
+        if (x + glyph_width + m_font_padding.x >= m_font_atlas_size.width()) {
             y = bottom_y;
-            x = 2 * outline_margin + m_font_padding.x; // advance to next row
+            x = m_font_padding.x; // advance to next row
         }
-        if (y + glyph_height + outline_margin + m_font_padding.y
-            >= m_font_atlas_size.height()) // check if it fits vertically AFTER potentially moving to next row
+        if (y + glyph_height + m_font_padding.y >= m_font_atlas_size.height()) // check if it fits vertically AFTER potentially moving to next row
         {
             qDebug() << "Font doesnt fit into bitmap";
             assert(false);
+            stbtt_FreeSDF(sdf, nullptr);
             break; // doesnt fit in image
         }
 
-        // clang-format off
-        stbtt_MakeGlyphBitmap(&m_fontinfo, raster.data() + x + y * m_font_atlas_size.width(), glyph_width, glyph_height, m_font_atlas_size.width(), scale, scale, glyph_index);
-        m_char_data.emplace(c, MapLabel::CharData {
-                uint16_t(x - outline_margin),
-                uint16_t(y - outline_margin),
-                uint16_t(glyph_width + outline_margin * 2),
-                uint16_t(glyph_height + outline_margin * 2),
-                float(x0 - outline_margin),
-                float(y0 - outline_margin) });
-        // clang-format on
-
-        x = x + glyph_width + 2 * outline_margin + m_font_padding.x;
-        if (y + glyph_height + outline_margin + m_font_padding.y > bottom_y)
-            bottom_y = y + glyph_height + 2 * outline_margin + m_font_padding.y;
+        for (int j = 0; j < glyph_height; ++j)
+            std::copy_n(sdf + j * glyph_width, glyph_width, raster.data() + x + (y + j) * m_font_atlas_size.width());
+        stbtt_FreeSDF(sdf, nullptr);
+
+        m_char_data.emplace(c, MapLabel::CharData { uint16_t(x), uint16_t(y), uint16_t(glyph_width), uint16_t(glyph_height), float(xoff), float(yoff) });
+
+        x = x + glyph_width + m_font_padding.x;
+        bottom_y = std::max(bottom_y, y + glyph_height + m_font_padding.y);
     }
 
     return raster;
 }
 
-Raster<glm::u8vec2> MapLabelManager::make_outline(const Raster<uint8_t>& input)
+const std::vector<MapLabel>& MapLabelManager::labels() const
 {
-    auto font_bitmap = Raster<glm::u8vec2>(input.size(), { 0, 0 });
-    unsigned outline_margin = unsigned(std::ceil(m_font_outline));
-
-    const auto aa_circle = [&](const glm::uvec2& centre, const glm::uvec2& px) {
-        float distance = glm::distance(glm::vec2(centre), glm::vec2(px));
-        float v = glm::smoothstep(m_font_outline - 1.5f, m_font_outline, distance);
-        return uint8_t((1 - v) * 255);
-    };
-
-    for (unsigned y = 0; y < font_bitmap.height(); ++y) {
-        for (unsigned x = 0; x < m_font_atlas_size.width(); ++x) {
-
-            const uint8_t value = input.pixel({ x, y });
-
-            font_bitmap.pixel({ x, y }).x = value;
-            if (value < 120)
-                continue;
-
-            for (unsigned j = y - outline_margin; j < y + outline_margin; ++j) {
-                if (j >= font_bitmap.height())
-                    continue;
-                for (unsigned i = x - outline_margin; i < x + outline_margin; ++i) {
-                    if (i >= font_bitmap.width())
-                        continue;
-                    font_bitmap.pixel({ i, j }).y = std::max(aa_circle({ x, y }, { i, j }), font_bitmap.pixel({ i, j }).y);
-                }
-            }
-        }
-    }
-    return font_bitmap;
+    return m_labels;
 }
 
-const std::vector<MapLabel>& MapLabelManager::labels() const
+std::vector<MapLabel> MapLabelManager::create_labels(const std::vector<label_tile::LabelRecord>& records) const
 {
-    return m_labels;
+    std::vector<MapLabel> labels;
+    labels.reserve(records.size());
+    for (const auto& record : records) {
+        labels.emplace_back(record.text, record.latitude, record.longitude, record.altitude, record.importance);
+        labels.back().init(m_char_data, &m_fontinfo, uv_width_norm, MapLabel::font_size / sdf_font_size);
+    }
+    return labels;
 }
 
 const std::vector<unsigned int>& MapLabelManager::indices() const
@@ -214,6 +208,6 @@ const QImage& MapLabelManager::icon() const
 {
     return m_icon;
 }
-const Raster<glm::u8vec2>& MapLabelManager::font_atlas() const { return m_font_atlas; }
+const Raster<uint8_t>& MapLabelManager::font_atlas() const { return m_font_atlas; }
 
 } // namespace nucleus
@@ -26,28 +26,40 @@
 #include <vector>
 
 #include "../Raster.h"
+#include "label_tile.h"
 
 namespace nucleus {
 class MapLabelManager {
 public:
+    // the font atlas holds signed distance fields of the glyphs (stbtt_GetGlyphSDF), rendered at sdf_font_size and scaled
+    // to MapLabel::font_size. the fill and the outline are both thresholds of the same field, see labels.frag.
+    static constexpr float sdf_font_size = 32.0f;
+    static constexpr int sdf_padding = 6; // in atlas pixels, the field is clamped to 0 this far outside of the glyph
+    static constexpr float sdf_pixel_dist_scale = 128.0f / sdf_padding;
+    static constexpr float sdf_outline_width = 4.3f; // in atlas pixels
+    // values of the (normalised) field on the glyph edge and on the outer edge of the outline
+    static constexpr float sdf_edge = 128.0f / 255.0f;
+    static constexpr float sdf_outline_edge = (128.0f - sdf_outline_width * sdf_pixel_dist_scale) / 255.0f;
+
     explicit MapLabelManager();
 
+    // the built in labels. empty if the labels are streamed as tiles (ALP_LABEL_TILE_URL, see create_labels)
     const std::vector<MapLabel>& labels() const;
+    // labels of a label tile, ready to be drawn with font_atlas
+    std::vector<MapLabel> create_labels(const std::vector<label_tile::LabelRecord>& records) const;
     const std::vector<unsigned int>& indices() const;
-    const Raster<glm::u8vec2>& font_atlas() const;
+    const Raster<uint8_t>& font_atlas() const;
     const QImage& icon() const;
 
 private:
     void init();
-    Raster<uint8_t> make_font_raster();
-    Raster<glm::u8vec2> make_outline(const Raster<uint8_t>& font_bitmap);
+    void load_font(); // the font info is needed for the kerning, also if the atlas is cached
+    Raster<uint8_t> make_font_atlas();
 
 private:
     // list of all characters that will be available (will be rendered to the font_atlas)
     const QString all_char_list = QString::fromUtf16(u" ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789()[]{},;.:-_!\"§$%&/\\=+-*/#'~°^<>|@€´`öÖüÜäÄß");
 
-    // static constexpr glm::ivec2 m_font_outline = glm::ivec2(3, 3);
-    static constexpr float m_font_outline = 7.2f;
     static constexpr glm::ivec2 m_font_padding = glm::ivec2(2, 2);
     static constexpr QSize m_font_atlas_size = QSize(512, 512);
     static constexpr float uv_width_norm = 1.0f / m_font_atlas_size.width();
@@ -60,7 +72,7 @@ private:
     stbtt_fontinfo m_fontinfo;
     QByteArray m_font_file;
 
-    Raster<glm::u8vec2> m_font_atlas;
+    Raster<uint8_t> m_font_atlas;
     QImage m_icon;
 };
 } // namespace nucleus
@@ -0,0 +1,113 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "font_atlas_cache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace nucleus::font_atlas_cache {
+
+namespace {
+    constexpr quint32 magic = 0x414c5046; // "ALPF"
+    constexpr quint32 format_version = 1;
+
+    QString cache_file_path()
+    {
+        const auto directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        QDir().mkpath(directory);
+        return directory + "/font_atlas.bin";
+    }
+} // namespace
+
+QByteArray key(const QByteArray& font_file, const QString& characters, const QByteArray& parameters)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(font_file);
+    hash.addData(characters.toUtf8());
+    hash.addData(parameters);
+    return hash.result();
+}
+
+QByteArray serialise(const QByteArray& key, const Raster<uint8_t>& raster, const CharDataMap& char_data)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << magic << format_version << key;
+    stream << quint32(raster.width()) << quint32(raster.height());
+    stream.writeRawData(reinterpret_cast<const char*>(raster.buffer().data()), int(raster.buffer_length()));
+    stream << quint32(char_data.size());
+    for (const auto& [c, d] : char_data)
+        stream << quint16(c) << d.x << d.y << d.width << d.height << d.xoff << d.yoff;
+    return data;
+}
+
+std::optional<FontAtlas> deserialise(const QByteArray& key, const QByteArray& data)
+{
+    QDataStream stream(data);
+    quint32 file_magic = 0, version = 0;
+    QByteArray file_key;
+    stream >> file_magic >> version >> file_key;
+    if (stream.status() != QDataStream::Ok || file_magic != magic || version != format_version || file_key != key)
+        return {};
+
+    quint32 width = 0, height = 0;
+    stream >> width >> height;
+    if (stream.status() != QDataStream::Ok || qint64(width) * height > data.size())
+        return {};
+    FontAtlas atlas { Raster<uint8_t>(glm::uvec2(width, height), uninitialised), {} };
+    if (stream.readRawData(reinterpret_cast<char*>(atlas.raster.buffer().data()), int(atlas.raster.buffer_length())) != int(atlas.raster.buffer_length()))
+        return {};
+
+    quint32 n_chars = 0;
+    stream >> n_chars;
+    for (quint32 i = 0; i < n_chars && stream.status() == QDataStream::Ok; ++i) {
+        quint16 c = 0;
+        MapLabel::CharData d {};
+        stream >> c >> d.x >> d.y >> d.width >> d.height >> d.xoff >> d.yoff;
+        atlas.char_data.emplace(char16_t(c), d);
+    }
+    if (stream.status() != QDataStream::Ok)
+        return {};
+    return atlas;
+}
+
+std::optional<FontAtlas> load(const QByteArray& key)
+{
+    QFile file(cache_file_path());
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    auto atlas = deserialise(key, file.readAll());
+    if (!atlas)
+        qDebug() << "font atlas cache is outdated or broken, rendering the atlas again";
+    return atlas;
+}
+
+void store(const QByteArray& key, const Raster<uint8_t>& raster, const CharDataMap& char_data)
+{
+    QSaveFile file(cache_file_path()); // replaced atomically, a crash doesn't leave a partial file
+    if (!file.open(QIODevice::WriteOnly) || file.write(serialise(key, raster, char_data)) < 0 || !file.commit())
+        qDebug() << "couldn't write the font atlas cache to" << cache_file_path();
+}
+
+} // namespace nucleus::font_atlas_cache
@@ -0,0 +1,51 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+
+#include <QByteArray>
+#include <QString>
+
+#include "MapLabel.h"
+#include "nucleus/Raster.h"
+
+// the font atlas is expensive to render (a signed distance field per glyph), it is cached on disk between app starts.
+namespace nucleus::font_atlas_cache {
+
+using CharDataMap = std::unordered_map<char16_t, const MapLabel::CharData>;
+
+struct FontAtlas {
+    Raster<uint8_t> raster;
+    CharDataMap char_data;
+};
+
+// hash of everything the atlas depends on: the font file, the characters and the rendering parameters
+QByteArray key(const QByteArray& font_file, const QString& characters, const QByteArray& parameters);
+
+QByteArray serialise(const QByteArray& key, const Raster<uint8_t>& raster, const CharDataMap& char_data);
+// nullopt if the data is broken, or was made for another key
+std::optional<FontAtlas> deserialise(const QByteArray& key, const QByteArray& data);
+
+// files in QStandardPaths::CacheLocation. failures are reported with qDebug, the atlas is rendered again then.
+std::optional<FontAtlas> load(const QByteArray& key);
+void store(const QByteArray& key, const Raster<uint8_t>& raster, const CharDataMap& char_data);
+
+} // namespace nucleus::font_atlas_cache
@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "label_culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nucleus::label_culling {
+
+float screen_scale(float distance, float importance)
+{
+    const auto dist_scale = 1.0f - ((distance - near_label) / (far_label - near_label)) * 0.4f;
+    // in the shader, the offsets are scaled by 0.5 / viewport_size in ndc, i.e. a quarter of that in pixels
+    return 2.0f * dist_scale * dist_scale * (importance + 1.5f) / 2.5f * 0.25f;
+}
+
+bool in_range(float distance, float importance)
+{
+    if (importance < 0.2f && distance > 3000.0f)
+        return false;
+    if (importance < 0.4f && distance > 20000.0f)
+        return false;
+    if (importance < 0.6f && distance > 250000.0f)
+        return false;
+    if (importance < 0.8f && distance > 500000.0f)
+        return false;
+    return true;
+}
+
+std::vector<unsigned> visible_labels(std::span<const Candidate> candidates, const camera::Definition& camera, float cell_size)
+{
+    struct Placed {
+        unsigned index;
+        float distance;
+        glm::vec2 min;
+        glm::vec2 max;
+    };
+    const auto viewport = glm::vec2(camera.viewport_size());
+    const auto world_to_clip = camera.world_view_projection_matrix();
+    const auto camera_position = camera.position();
+
+    std::vector<Placed> in_view;
+    for (unsigned i = 0; i < candidates.size(); ++i) {
+        const auto& c = candidates[i];
+        const auto distance = float(glm::distance(c.world_position, camera_position));
+        if (!in_range(distance, c.importance))
+            continue;
+        const auto clip = world_to_clip * glm::dvec4(c.world_position + glm::dvec3(0, 0, anchor_height), 1.0);
+        if (clip.w <= 0)
+            continue;
+        const auto anchor = (glm::vec2(clip) / float(clip.w) * 0.5f + 0.5f) * viewport;
+        const auto scale = screen_scale(distance, c.importance);
+        const Placed p { i, distance, anchor + c.extent_min * scale, anchor + c.extent_max * scale };
+        if (p.max.x < 0 || p.max.y < 0 || p.min.x > viewport.x || p.min.y > viewport.y)
+            continue;
+        in_view.push_back(p);
+    }
+    std::stable_sort(in_view.begin(), in_view.end(), [&](const Placed& a, const Placed& b) {
+        const auto& ca = candidates[a.index];
+        const auto& cb = candidates[b.index];
+        return ca.importance != cb.importance ? ca.importance > cb.importance : a.distance < b.distance;
+    });
+
+    const auto n_cells = glm::max(glm::uvec2(glm::ceil(viewport / cell_size)), glm::uvec2(1));
+    std::vector<std::vector<unsigned>> grid(size_t(n_cells.x) * n_cells.y); // indices into placed
+    const auto cell_range = [&](const Placed& p) {
+        const auto lo = glm::uvec2(glm::clamp(glm::floor(p.min / cell_size), glm::vec2(0), glm::vec2(n_cells - 1u)));
+        const auto hi = glm::uvec2(glm::clamp(glm::floor(p.max / cell_size), glm::vec2(0), glm::vec2(n_cells - 1u)));
+        return std::make_pair(lo, hi);
+    };
+
+    std::vector<Placed> placed;
+    for (const auto& p : in_view) {
+        const auto [lo, hi] = cell_range(p);
+        bool overlaps = false;
+        for (auto y = lo.y; y <= hi.y && !overlaps; ++y) {
+            for (auto x = lo.x; x <= hi.x && !overlaps; ++x) {
+                overlaps = std::any_of(grid[y * n_cells.x + x].begin(), grid[y * n_cells.x + x].end(), [&](unsigned j) {
+                    const auto& o = placed[j];
+                    return p.min.x < o.max.x && o.min.x < p.max.x && p.min.y < o.max.y && o.min.y < p.max.y;
+                });
+            }
+        }
+        if (overlaps)
+            continue;
+        for (auto y = lo.y; y <= hi.y; ++y) {
+            for (auto x = lo.x; x <= hi.x; ++x)
+                grid[y * n_cells.x + x].push_back(unsigned(placed.size()));
+        }
+        placed.push_back(p);
+    }
+
+    std::vector<unsigned> result;
+    result.reserve(placed.size());
+    for (const auto& p : placed)
+        result.push_back(p.index);
+    return result;
+}
+
+} // namespace nucleus::label_culling
@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nucleus/camera/Definition.h"
+
+namespace nucleus::label_culling {
+
+struct Candidate {
+    glm::dvec3 world_position;
+    float importance = 0; // 1 -> most important; 0 -> least important
+    glm::vec2 extent_min = {}; // bounds of the quads relative to the anchor, in label pixels (see MapLabel::VertexData)
+    glm::vec2 extent_max = {};
+};
+
+// the following mirror labels.vert
+constexpr float near_label = 100.0f;
+constexpr float far_label = 500000.0f;
+constexpr float anchor_height = 5.0f; // the label is drawn this many metres above its position
+/// factor from label pixels to screen pixels
+[[nodiscard]] float screen_scale(float distance, float importance);
+/// less important labels are only shown when close
+[[nodiscard]] bool in_range(float distance, float importance);
+
+/// Culls labels against the frustum and the distance / importance thresholds, and declutters the rest in screen space:
+/// labels are placed in the order of importance (closer first), and a label is dropped if it overlaps a placed one.
+/// The overlap test uses a grid with cells of cell_size pixels. Returns indices into candidates, in placement order.
+/// Occlusion by the terrain is not tested here, that's done in the shader.
+[[nodiscard]] std::vector<unsigned> visible_labels(std::span<const Candidate> candidates, const camera::Definition& camera, float cell_size = 128.0f);
+
+} // namespace nucleus::label_culling
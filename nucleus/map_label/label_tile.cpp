@@ -0,0 +1,118 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "label_tile.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <QtEndian>
+
+namespace nucleus::label_tile {
+
+namespace {
+    constexpr char magic[4] = { 'A', 'L', 'P', 'L' };
+
+    class Reader {
+        const QByteArray& m_data;
+        qsizetype m_pos = 0;
+
+    public:
+        explicit Reader(const QByteArray& data)
+            : m_data(data)
+        {
+        }
+        [[nodiscard]] bool has(qsizetype n_bytes) const { return n_bytes >= 0 && m_data.size() - m_pos >= n_bytes; }
+        template <typename T>
+        T read()
+        {
+            assert(has(qsizetype(sizeof(T))));
+            const auto value = qFromLittleEndian<T>(m_data.constData() + m_pos);
+            m_pos += qsizetype(sizeof(T));
+            return value;
+        }
+        [[nodiscard]] const char* current() const { return m_data.constData() + m_pos; }
+        void skip(qsizetype n_bytes) { m_pos += n_bytes; }
+    };
+
+    template <typename T>
+    void append(QByteArray* data, T value)
+    {
+        const auto pos = data->size();
+        data->resize(pos + qsizetype(sizeof(T)));
+        qToLittleEndian<T>(value, data->data() + pos);
+    }
+} // namespace
+
+tl::expected<std::vector<LabelRecord>, std::string> decode(const QByteArray& data)
+{
+    if (data.isEmpty())
+        return std::vector<LabelRecord>();
+
+    Reader reader(data);
+    if (!reader.has(12) || std::memcmp(reader.current(), magic, 4) != 0)
+        return tl::unexpected(std::string("not a label tile"));
+    reader.skip(4);
+    const auto version = reader.read<uint32_t>();
+    if (version != format_version)
+        return tl::unexpected("unsupported label tile version " + std::to_string(version));
+    const auto count = reader.read<uint32_t>();
+
+    constexpr qsizetype fixed_size = 2 * sizeof(double) + 2 * sizeof(float) + sizeof(uint32_t);
+    if (!reader.has(qsizetype(count) * fixed_size)) // checked before reserving, the count is untrusted
+        return tl::unexpected(std::string("label tile is truncated"));
+    std::vector<LabelRecord> labels;
+    labels.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!reader.has(fixed_size))
+            return tl::unexpected(std::string("label tile is truncated"));
+        LabelRecord label;
+        label.latitude = reader.read<double>();
+        label.longitude = reader.read<double>();
+        label.altitude = reader.read<float>();
+        label.importance = reader.read<float>();
+        const auto length = qsizetype(reader.read<uint32_t>());
+        if (!reader.has(length * 2))
+            return tl::unexpected(std::string("label tile is truncated"));
+        label.text.resize(length);
+        for (qsizetype c = 0; c < length; ++c)
+            label.text[c] = QChar(reader.read<uint16_t>());
+        labels.push_back(std::move(label));
+    }
+    return labels;
+}
+
+QByteArray encode(const std::vector<LabelRecord>& labels)
+{
+    QByteArray data;
+    data.append(magic, 4);
+    append<uint32_t>(&data, format_version);
+    append<uint32_t>(&data, uint32_t(labels.size()));
+    for (const auto& label : labels) {
+        append<double>(&data, label.latitude);
+        append<double>(&data, label.longitude);
+        append<float>(&data, label.altitude);
+        append<float>(&data, label.importance);
+        append<uint32_t>(&data, uint32_t(label.text.size()));
+        for (const auto c : label.text)
+            append<uint16_t>(&data, c.unicode());
+    }
+    return data;
+}
+
+} // namespace nucleus::label_tile
@@ -0,0 +1,49 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+#include <tl/expected.hpp>
+
+namespace nucleus::label_tile {
+
+// a label as it is stored in a label tile. a label is stored only in the tile of the zoom level from which it is shown
+// (coarser tiles hold the more important labels), so the labels of all resident tiles together form the level of detail.
+struct LabelRecord {
+    QString text;
+    double latitude = 0;
+    double longitude = 0;
+    float altitude = 0;
+    float importance = 0; // 1 -> most important; 0 -> least important
+    bool operator==(const LabelRecord&) const = default;
+};
+
+// binary format, little endian: "ALPL", uint32 version, uint32 count, then per label: float64 latitude, float64 longitude,
+// float32 altitude, float32 importance and the text (uint32 length in utf-16 code units, followed by the code units).
+// an empty byte array is a valid tile without labels.
+inline constexpr uint32_t format_version = 1;
+
+tl::expected<std::vector<LabelRecord>, std::string> decode(const QByteArray& data);
+QByteArray encode(const std::vector<LabelRecord>& labels);
+
+} // namespace nucleus::label_tile
@@ -19,10 +19,16 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <span>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <QFile>
@@ -30,66 +36,262 @@
 #include <tl/expected.hpp>
 #include <zpp_bits.h>
 
+#include "CachePolicy.h"
+#include "FlatTileMap.h"
+#include "ShardedTileMap.h"
+#include "nucleus/utils/ByteArrayInterner.h"
+#include "TilePack.h"
 #include "radix/tile.h"
 #include "tile_types.h"
 #include "utils.h"
 
-namespace glm {
-
-template<typename T>
-constexpr auto serialize(auto & archive, const glm::vec<2, T> & vec)
-{
-    return archive(vec.x, vec.y);
-}
+namespace nucleus::tile_scheduler {
 
-template<typename T>
-constexpr auto serialize(auto & archive, glm::vec<2, T> & vec)
-{
-    return archive(vec.x, vec.y);
-}
+/// Immutable version of a cache's contents. Readers hold on to it via shared_ptr and never block the owner of the cache.
+template <tile_types::NamedTile T>
+struct CacheSnapshot {
+    std::unordered_map<tile::Id, std::shared_ptr<const T>, tile::Id::Hasher> tiles;
+    uint64_t version = 0;
 
-}
+    [[nodiscard]] const T* find(const tile::Id& id) const
+    {
+        const auto it = tiles.find(id);
+        return it == tiles.end() ? nullptr : it->second.get();
+    }
 
-namespace nucleus::tile_scheduler {
+    /// same semantics as Cache::visit_readonly
+    template <typename VisitorFunction>
+    void visit(const VisitorFunction& functor, const tile::Id& node = { 0, { 0, 0 } }) const
+    {
+        const auto* tile = find(node);
+        if (!tile || !functor(*tile))
+            return;
+        for (const auto& id : node.children())
+            visit(functor, id);
+    }
+};
 
-/// This class is thread safe. be careful with the visit method as it writes the cache and therefore locks an internal mutex.
-template<tile_types::NamedTile T>
+/// This class is thread safe. The entries are sharded by quad tree subtree (see ShardedTileMap), each shard has its own mutex.
+/// visit and visit_readonly only take shared locks of the shards they descend into, insert, replace and purge lock the shard of
+/// the changed entry exclusively, and the bookkeeping (eviction heap, pack tier, snapshot) with the data mutex. so inserts and
+/// traversals in different regions don't contend. visit writes the visited stamps atomically (relaxed). disk io locks all shards.
+/// Map selects the storage of a shard (StdTileMap or FlatTileMap), Policy the locking, eviction, persistence and sharding (see
+/// CachePolicy). with NoLocking, the cache must only be used by one thread.
+template <tile_types::NamedTile T, template <typename> class Map = StdTileMap, typename Policy = DefaultCachePolicy>
 class Cache
 {
+    using Mutex = typename Policy::Locking::Mutex;
+
     struct MetaData {
-        uint64_t visited;
+        alignas(std::atomic_ref<uint64_t>::required_alignment) uint64_t visited;
         uint64_t created;
     };
 
     struct CacheObject {
         MetaData meta;
         T data;
+        uint64_t eviction_stamp = 0; // stamp of the live entry in m_eviction_heap
+        uint64_t n_bytes = 0;
+    };
+    uint64_t m_n_bytes = 0;
+
+    // lazy min heap of (visited stamp, id) for purging. visit only updates the stamp in the metadata, outdated entries
+    // are re-inserted with the current stamp when they reach the top, and superseded ones (after re-insert) are dropped.
+    struct EvictionEntry {
+        uint64_t stamp;
+        tile::Id id;
+        bool operator>(const EvictionEntry& other) const { return stamp > other.stamp; }
     };
+    std::vector<EvictionEntry> m_eviction_heap;
+    nucleus::utils::ByteArrayInterner m_interner; // shares identical payloads between entries, if T supports it
 
-    std::unordered_map<tile::Id, CacheObject, tile::Id::Hasher> m_data;
-    mutable std::shared_mutex m_data_mutex;
+    // modified with m_data_mutex and the shard mutex held exclusively. so either of them is enough for reading, except for
+    // the visited stamps, which visits write concurrently (read them with visited_of).
+    ShardedTileMap<CacheObject, Map, Policy::shard_zoom_level, Mutex> m_data;
+    mutable Mutex m_data_mutex;
     std::unordered_map<tile::Id, MetaData, tile::Id::Hasher> m_disk_cached;
-    mutable std::shared_mutex m_disk_cached_mutex;
+    mutable Mutex m_disk_cached_mutex;
+    std::unique_ptr<TilePack> m_pack; // guarded by m_disk_cached_mutex
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_pack_pending; // in the pack, but not loaded yet. guarded by m_data_mutex
+    std::unordered_map<tile::Id, bool, tile::Id::Hasher> m_pack_dirty; // changes since the last write, true for inserted, false for purged. guarded by m_data_mutex
+
+    // disk tier, see set_disk_limits. the demotion maps are guarded by m_data_mutex and handed over to the next write.
+    std::atomic<unsigned> m_disk_quad_limit = 0;
+    std::atomic<uint64_t> m_disk_byte_limit = std::numeric_limits<uint64_t>::max();
+    std::unordered_map<tile::Id, CacheObject, tile::Id::Hasher> m_pack_demoting; // purged before their latest version was written
+    std::unordered_map<tile::Id, uint64_t, tile::Id::Hasher> m_pack_demoted; // purged, but already in the pack. id -> visited stamp
+    std::atomic<bool> m_has_pack = false; // m_pack is open, readable without the disk mutex
+    std::atomic<unsigned> m_n_disk_objects = 0;
+    std::atomic<uint64_t> m_n_disk_bytes = 0;
+
+    // the next snapshot version is maintained incrementally together with m_data (same mutex) and copied on publish.
+    std::unordered_map<tile::Id, std::shared_ptr<const T>, tile::Id::Hasher> m_next_snapshot;
+    bool m_next_snapshot_dirty = true;
+    uint64_t m_snapshot_version = 0;
+    std::shared_ptr<const CacheSnapshot<T>> m_snapshot = std::make_shared<const CacheSnapshot<T>>();
+    mutable typename Policy::Locking::SnapshotMutex m_snapshot_mutex; // only guards the pointer swap / copy
+    std::function<uint64_t()> m_clock = utils::time_since_epoch;
 
 public:
     Cache() = default;
     void insert(const T& tile);
+    /// replaces the data of an existing entry, but keeps its visited stamp (for derived data that shouldn't influence purging).
+    /// it counts as new for the disk cache. does nothing if there is no entry for the id.
+    void replace(const T& tile);
     [[nodiscard]] bool contains(const tile::Id& id) const;
     [[nodiscard]] unsigned n_cached_objects() const;
-    /// functor should return true, if the given tile should be marked visited. stops descending if false is returned. don't do heavy lifting in the functort, as it blocks all other access!
+    /// sum of T::n_bytes() of all entries (0 if T doesn't provide the method)
+    [[nodiscard]] uint64_t n_bytes() const;
+    /// functor should return true, if the given tile should be marked visited. stops descending if false is returned. don't do heavy lifting in the functor, as it blocks inserts and purges in the visited shards!
     template<typename VisitorFunction>
     void visit(const VisitorFunction& functor);
+    /// same as visit, but doesn't mark visited tiles. use it for queries that shouldn't influence purging.
+    template<typename VisitorFunction>
+    void visit_readonly(const VisitorFunction& functor) const;
     const T& peak_at(const tile::Id& id) const;
-    std::vector<T> purge(unsigned remaining_capacity);
+    /// purges least recently visited entries until both limits are met
+    std::vector<T> purge(unsigned remaining_capacity, uint64_t remaining_bytes = std::numeric_limits<uint64_t>::max());
+    /// same, but entries for which keep returns true are only purged if the limits can't be met otherwise
+    template <typename KeepFunction>
+    std::vector<T> purge(unsigned remaining_capacity, uint64_t remaining_bytes, const KeepFunction& keep);
+
+    /// makes the current contents available via snapshot(). call after a batch of inserts / purges. cheap if nothing changed.
+    void publish_snapshot();
+    /// latest published version. it's immutable, so it can be traversed without any locks while the cache changes.
+    [[nodiscard]] std::shared_ptr<const CacheSnapshot<T>> snapshot() const;
 
     [[nodiscard]] tl::expected<void, std::string> write_to_disk(const std::filesystem::path& path);
     [[nodiscard]] tl::expected<void, std::string> read_from_disk(const std::filesystem::path& path);
+    /// same as write_to_disk / read_from_disk, but with a single memory mapped pack file (see TilePack) instead of a file per tile
+    [[nodiscard]] tl::expected<void, std::string> write_to_pack(const std::filesystem::path& path);
+    [[nodiscard]] tl::expected<void, std::string> read_from_pack(const std::filesystem::path& path);
+    /// incremental variant of write_to_pack: only the tiles inserted or purged since the last write are appended to the journal
+    /// of the pack, and the index is rewritten (checkpoint) once the journal gets long. the data mutex is held only for collecting
+    /// the changes, so this can run on an io thread without blocking the scheduler. falls back to write_to_pack if no pack is open.
+    [[nodiscard]] tl::expected<void, std::string> flush_to_pack(const std::filesystem::path& path);
+    /// lazy variant of read_from_pack: only reads the index, the tiles stay pending until they are loaded with load_from_pack.
+    /// inserting a pending tile supersedes the one in the pack. pending tiles are kept in the pack by write_to_pack.
+    [[nodiscard]] tl::expected<void, std::string> open_pack(const std::filesystem::path& path);
+    /// loads the given pending tiles, ids that are not pending are ignored. returns the number of loaded tiles.
+    /// the data mutex is only taken for the final insert, so visits are not blocked while deserialising.
+    [[nodiscard]] tl::expected<unsigned, std::string> load_from_pack(std::span<const tile::Id> ids);
+    /// write / read / lazily open with the persistence backend of the policy (e.g., flush_to_pack, read_from_pack and open_pack)
+    [[nodiscard]] tl::expected<void, std::string> persist(const std::filesystem::path& path) { return Policy::Persistence::persist(*this, path); }
+    [[nodiscard]] tl::expected<void, std::string> restore(const std::filesystem::path& path) { return Policy::Persistence::restore(*this, path); }
+    [[nodiscard]] tl::expected<void, std::string> open_persisted(const std::filesystem::path& path) { return Policy::Persistence::open(*this, path); }
+    [[nodiscard]] std::unordered_set<tile::Id, tile::Id::Hasher> pending_from_pack() const;
+    [[nodiscard]] unsigned n_pending_from_pack() const;
+    [[nodiscard]] bool is_pending_from_pack(const tile::Id& id) const;
+    /// forgets the pending tiles, e.g., after a read error. they are removed from the pack on the next write_to_pack.
+    void discard_pending_from_pack();
+    /// limits of the pack as a second, larger tier. with max_quads == 0 (default), the pack mirrors the cache and purged entries are
+    /// removed from it. otherwise purge demotes entries to the pack (they become pending, see load_from_pack) and the writes remove
+    /// the least recently visited entries that are not in ram once the pack exceeds a limit.
+    void set_disk_limits(unsigned max_quads, uint64_t max_bytes = std::numeric_limits<uint64_t>::max());
+    /// size of the pack as of the last write / open, doesn't block on a running write
+    [[nodiscard]] unsigned n_disk_cached_objects() const;
+    [[nodiscard]] uint64_t n_disk_bytes() const;
+    /// source of the current time (msecs since epoch) for the stamps, utils::time_since_epoch by default. for tests.
+    void set_clock(std::function<uint64_t()> clock) { m_clock = std::move(clock); }
 
 private:
     template<typename VisitorFunction>
     void visit(const tile::Id& start_node,
                const VisitorFunction& functor,
                uint64_t visited_stamp); // must stay private or protected by mutex
+    template<typename VisitorFunction>
+    void visit_readonly(const tile::Id& start_node, const VisitorFunction& functor) const; // must stay private or protected by mutex
+
+    void intern(T& tile)
+    {
+        if constexpr (requires { tile.intern_payloads(m_interner); })
+            tile.intern_payloads(m_interner);
+    }
+
+    static uint64_t visited_of(const CacheObject& object)
+    {
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(object.meta.visited)).load(std::memory_order_relaxed);
+    }
+
+    static uint64_t n_bytes_of(const T& tile)
+    {
+        if constexpr (requires { { tile.n_bytes() } -> utils::convertible_to<uint64_t>; })
+            return tile.n_bytes();
+        else
+            return 0;
+    }
+
+    // requires m_data_mutex. the pack is updated with the next write.
+    void demote(const tile::Id& id, const CacheObject& object)
+    {
+        if (m_disk_quad_limit == 0 || !m_has_pack) {
+            m_pack_dirty[id] = false;
+            return;
+        }
+        const auto dirty = m_pack_dirty.find(id);
+        if (dirty != m_pack_dirty.end() && dirty->second) {
+            m_pack_demoting[id] = object; // the pack has an older version or none, write the current one
+            m_pack_dirty.erase(dirty);
+            return;
+        }
+        m_pack_pending.insert(id);
+        m_pack_demoted[id] = object.meta.visited;
+    }
+
+    // requires m_disk_cached_mutex. removes the least recently visited entries that are not in keep until the pack fits the
+    // disk limits. the caller has to drop the returned ids from m_pack_pending (see finish_pack_write).
+    std::vector<tile::Id> evict_from_pack(const std::unordered_set<tile::Id, tile::Id::Hasher>& keep)
+    {
+        const auto quad_limit = m_disk_quad_limit.load();
+        const auto byte_limit = m_disk_byte_limit.load();
+        if (quad_limit == 0 || (m_pack->index().size() <= quad_limit && m_pack->live_bytes() <= byte_limit))
+            return {};
+        std::vector<std::pair<uint64_t, tile::Id>> candidates;
+        candidates.reserve(m_pack->index().size());
+        for (const auto& [id, entry] : m_pack->index()) {
+            if (!keep.contains(id))
+                candidates.emplace_back(entry.visited, id);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<tile::Id> evicted;
+        for (const auto& [visited, id] : candidates) {
+            if (m_pack->index().size() <= quad_limit && m_pack->live_bytes() <= byte_limit)
+                break;
+            m_pack->remove(id);
+            m_disk_cached.erase(id);
+            evicted.push_back(id);
+        }
+        return evicted;
+    }
+
+    // takes m_data_mutex. the written demoted entries become pending, the evicted ones are gone.
+    void finish_pack_write(const std::vector<tile::Id>& demoted, const std::vector<tile::Id>& evicted)
+    {
+        auto locker = std::scoped_lock(m_data_mutex);
+        for (const auto& id : demoted) {
+            if (!m_data.contains(id) && !m_pack_demoting.contains(id))
+                m_pack_pending.insert(id);
+        }
+        for (const auto& id : evicted) {
+            m_pack_pending.erase(id);
+            if (m_data.contains(id))
+                m_pack_dirty[id] = true; // loaded while the pack was written, write it again
+        }
+    }
+
+    // requires m_disk_cached_mutex
+    void update_disk_counts()
+    {
+        m_has_pack = m_pack && m_pack->is_open();
+        m_n_disk_objects = m_has_pack ? unsigned(m_pack->index().size()) : 0u;
+        m_n_disk_bytes = m_has_pack ? m_pack->live_bytes() : 0u;
+    }
+
+    void push_eviction_entry(const EvictionEntry& entry)
+    {
+        m_eviction_heap.push_back(entry);
+        std::push_heap(m_eviction_heap.begin(), m_eviction_heap.end(), std::greater<> {});
+    }
 
     static std::filesystem::path tile_path(const std::filesystem::path& base_path, const tile::Id& id)
     {
@@ -102,48 +304,115 @@ private:
     }
 };
 
-using MemoryCache = nucleus::tile_scheduler::Cache<nucleus::tile_scheduler::tile_types::TileQuad>;
+using MemoryCache = nucleus::tile_scheduler::Cache<nucleus::tile_scheduler::tile_types::TileQuad, FlatTileMap, PlatformCachePolicy>;
 
-template <tile_types::NamedTile T>
-void Cache<T>::insert(const T& tile)
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+void Cache<T, Map, Policy>::insert(const T& new_tile)
 {
+    auto tile = new_tile;
+    intern(tile);
     auto locker = std::scoped_lock(m_data_mutex);
-    const auto time_stamp = utils::time_since_epoch();
-    m_data[tile.id].meta.visited = time_stamp * 100 - tile.id.zoom_level;
-    m_data[tile.id].meta.created = time_stamp;
-    m_data[tile.id].data = tile;
+    const auto time_stamp = m_clock();
+    {
+        auto shard_locker = std::unique_lock(m_data.shard_mutex(tile.id));
+        auto& object = m_data[tile.id];
+        m_n_bytes -= object.n_bytes; // 0 for new objects
+        object.n_bytes = n_bytes_of(tile);
+        m_n_bytes += object.n_bytes;
+        object.meta.visited = time_stamp * 100 - tile.id.zoom_level;
+        object.meta.created = time_stamp;
+        object.data = tile;
+        object.eviction_stamp = object.meta.visited;
+    }
+    push_eviction_entry({ time_stamp * 100 - tile.id.zoom_level, tile.id });
+    m_next_snapshot[tile.id] = std::make_shared<const T>(tile);
+    m_next_snapshot_dirty = true;
+    m_pack_pending.erase(tile.id);
+    m_pack_demoting.erase(tile.id);
+    m_pack_demoted.erase(tile.id);
+    m_pack_dirty[tile.id] = true;
 }
 
-template <tile_types::NamedTile T>
-bool Cache<T>::contains(const tile::Id& id) const
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+void Cache<T, Map, Policy>::replace(const T& new_tile)
 {
-    auto locker = std::shared_lock(m_data_mutex);
+    auto tile = new_tile;
+    intern(tile);
+    auto locker = std::scoped_lock(m_data_mutex);
+    auto shard_locker = std::unique_lock(m_data.shard_mutex(tile.id));
+    auto* object = m_data.find(tile.id);
+    if (!object)
+        return;
+    m_n_bytes -= object->n_bytes;
+    object->n_bytes = n_bytes_of(tile);
+    m_n_bytes += object->n_bytes;
+    object->meta.created = std::max(m_clock(), object->meta.created + 1); // must differ, disk writes compare it
+    object->data = tile;
+    shard_locker.unlock();
+    m_next_snapshot[tile.id] = std::make_shared<const T>(tile);
+    m_next_snapshot_dirty = true;
+    m_pack_dirty[tile.id] = true;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+void Cache<T, Map, Policy>::publish_snapshot()
+{
+    std::shared_ptr<const CacheSnapshot<T>> snapshot;
+    {
+        auto locker = std::scoped_lock(m_data_mutex);
+        if (!m_next_snapshot_dirty)
+            return;
+        snapshot = std::make_shared<const CacheSnapshot<T>>(CacheSnapshot<T> { m_next_snapshot, ++m_snapshot_version });
+        m_next_snapshot_dirty = false;
+    }
+    auto locker = std::scoped_lock(m_snapshot_mutex);
+    m_snapshot = std::move(snapshot); // the old version is released outside of the data mutex, or by the last reader
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+std::shared_ptr<const CacheSnapshot<T>> Cache<T, Map, Policy>::snapshot() const
+{
+    auto locker = std::scoped_lock(m_snapshot_mutex);
+    return m_snapshot;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+bool Cache<T, Map, Policy>::contains(const tile::Id& id) const
+{
+    auto locker = std::shared_lock(m_data.shard_mutex(id));
     return m_data.contains(id);
 }
 
-template <tile_types::NamedTile T>
-unsigned int Cache<T>::n_cached_objects() const
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+unsigned int Cache<T, Map, Policy>::n_cached_objects() const
 {
-    auto locker = std::shared_lock(m_data_mutex);
     return unsigned(m_data.size());
 }
 
-template <tile_types::NamedTile T>
-const T& Cache<T>::peak_at(const tile::Id& id) const
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+uint64_t Cache<T, Map, Policy>::n_bytes() const
 {
     auto locker = std::shared_lock(m_data_mutex);
+    return m_n_bytes;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+const T& Cache<T, Map, Policy>::peak_at(const tile::Id& id) const
+{
+    auto locker = std::shared_lock(m_data.shard_mutex(id));
     return m_data.at(id).data;
 }
 
-template <tile_types::NamedTile T>
-tl::expected<void, std::string> Cache<T>::write_to_disk(const std::filesystem::path& base_path)
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<void, std::string> Cache<T, Map, Policy>::write_to_disk(const std::filesystem::path& base_path)
 {
     static_assert(tile_types::SerialisableTile<T>);
     std::filesystem::create_directories(base_path);
-    std::unordered_map<tile::Id, CacheObject, tile::Id::Hasher> data;
+    Map<CacheObject> data;
     {
         auto locker = std::scoped_lock(m_data_mutex);
-        data = m_data; // copies only metadata and references to tiles
+        const auto shard_locks = m_data.lock_all(); // exclusive, so that the stamps don't change while copying
+        data = m_data.merged(); // copies only metadata and references to tiles
     }
     auto locker = std::scoped_lock(m_disk_cached_mutex);
 
@@ -222,10 +491,11 @@ tl::expected<void, std::string> Cache<T>::write_to_disk(const std::filesystem::p
         return {};
 }
 
-template <tile_types::NamedTile T>
-tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::path& base_path)
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<void, std::string> Cache<T, Map, Policy>::read_from_disk(const std::filesystem::path& base_path)
 {
     auto locker = std::scoped_lock(m_data_mutex, m_disk_cached_mutex);
+    const auto shard_locks = m_data.lock_all();
     assert(tile_types::SerialisableTile<T>);
     const auto check_version = [](auto* in, const auto& path) -> tl::expected<void, std::string> {
         std::remove_cvref_t<decltype(T::version_information)> version_info = {};
@@ -255,6 +525,12 @@ tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::
     const auto clean_up = [&]() {
         m_disk_cached.clear();
         m_data.clear();
+        m_n_bytes = 0;
+        m_eviction_heap.clear();
+        m_next_snapshot.clear();
+        m_next_snapshot_dirty = true;
+        m_pack_pending.clear();
+        m_pack_dirty.clear();
     };
 
     clean_up();
@@ -309,34 +585,428 @@ tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::
                 return tl::unexpected(std::make_error_code(r).message());
             }
         }
+        intern(d.data);
         d.meta = meta;
+        d.eviction_stamp = meta.visited;
+        d.n_bytes = n_bytes_of(d.data);
+        m_n_bytes += d.n_bytes;
+        m_eviction_heap.push_back({ meta.visited, d.data.id });
         m_data[d.data.id] = d;
+        m_next_snapshot[d.data.id] = std::make_shared<const T>(d.data);
     }
 
+    std::make_heap(m_eviction_heap.begin(), m_eviction_heap.end(), std::greater<> {});
     return {};
 }
 
-template <tile_types::NamedTile T>
-template <typename VisitorFunction>
-void Cache<T>::visit(const VisitorFunction& functor)
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<void, std::string> Cache<T, Map, Policy>::write_to_pack(const std::filesystem::path& base_path)
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    Map<CacheObject> data;
+    std::unordered_set<tile::Id, tile::Id::Hasher> pending;
+    std::unordered_map<tile::Id, CacheObject, tile::Id::Hasher> demoting;
+    std::unordered_map<tile::Id, uint64_t, tile::Id::Hasher> demoted;
+    {
+        auto locker = std::scoped_lock(m_data_mutex);
+        const auto shard_locks = m_data.lock_all(); // exclusive, so that the stamps don't change while copying
+        data = m_data.merged(); // copies only metadata and references to tiles
+        pending = m_pack_pending;
+        m_pack_dirty.clear();
+        std::swap(demoting, m_pack_demoting);
+        std::swap(demoted, m_pack_demoted);
+    }
+    auto locker = std::unique_lock(m_disk_cached_mutex);
+    if (!m_pack || m_pack->base_path() != base_path || !m_pack->is_open()) {
+        m_pack = std::make_unique<TilePack>(base_path, T::version_information);
+        const auto r = m_pack->open(true);
+        if (!r.has_value()) {
+            m_pack.reset();
+            update_disk_counts();
+            return r;
+        }
+    }
+
+    // removing items, that were removed or updated in ram (pending and demoted ones aren't in ram, but stay)
+    std::vector<tile::Id> outdated;
+    for (const auto& [id, entry] : m_pack->index()) {
+        if (!data.contains(id) && !pending.contains(id) && !demoting.contains(id))
+            outdated.push_back(id);
+    }
+    for (const auto& id : outdated)
+        m_pack->remove(id);
+
+    m_disk_cached.clear();
+    m_disk_cached.reserve(data.size() + pending.size());
+    for (const auto& id : pending) {
+        const auto entry = m_pack->index().find(id);
+        if (entry != m_pack->index().end())
+            m_disk_cached[id] = { entry->second.visited, entry->second.created };
+    }
+    for (const auto& [id, cache_object] : data) {
+        m_disk_cached[id] = cache_object.meta;
+        const auto entry = m_pack->index().find(id);
+        if (entry != m_pack->index().end() && entry->second.created == cache_object.meta.created) {
+            m_pack->set_visited(id, cache_object.meta.visited);
+            continue;
+        }
+        std::vector<char> bytes;
+        zpp::bits::out out(bytes);
+        const auto r = out(cache_object.data);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+        const auto r_append = m_pack->append(id, bytes, cache_object.meta.created, cache_object.meta.visited);
+        if (!r_append.has_value())
+            return r_append;
+    }
+    std::vector<tile::Id> demoted_ids;
+    demoted_ids.reserve(demoting.size());
+    for (const auto& [id, cache_object] : demoting) {
+        std::vector<char> bytes;
+        zpp::bits::out out(bytes);
+        const auto r = out(cache_object.data);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+        const auto r_append = m_pack->append(id, bytes, cache_object.meta.created, cache_object.meta.visited);
+        if (!r_append.has_value())
+            return r_append;
+        m_disk_cached[id] = cache_object.meta;
+        demoted_ids.push_back(id);
+    }
+    for (const auto& [id, visited] : demoted)
+        m_pack->set_visited(id, visited);
+    std::vector<tile::Id> evicted;
+    if (m_disk_quad_limit > 0) {
+        std::unordered_set<tile::Id, tile::Id::Hasher> in_ram;
+        in_ram.reserve(data.size());
+        for (const auto& [id, cache_object] : data)
+            in_ram.insert(id);
+        evicted = evict_from_pack(in_ram);
+    }
+    const auto r = m_pack->commit();
+    update_disk_counts();
+    locker.unlock();
+    finish_pack_write(demoted_ids, evicted);
+    return r;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<void, std::string> Cache<T, Map, Policy>::flush_to_pack(const std::filesystem::path& base_path)
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    bool checkpoint = false;
+    bool full_write = false;
+    {
+        auto locker = std::scoped_lock(m_disk_cached_mutex);
+        full_write = !m_pack || m_pack->base_path() != base_path || !m_pack->is_open();
+        checkpoint = !full_write && m_pack->journal_size() > std::max<uint64_t>(1024, m_pack->index().size());
+    }
+    if (full_write)
+        return write_to_pack(base_path); // there is nothing to append to (outside of the lock, write_to_pack takes it)
+
+    std::unordered_map<tile::Id, bool, tile::Id::Hasher> dirty;
+    std::vector<std::pair<MetaData, T>> inserted;
+    std::vector<std::pair<tile::Id, uint64_t>> visited; // only for checkpoints, the journal doesn't track visits
+    std::vector<tile::Id> demoted_ids;
+    std::unordered_map<tile::Id, uint64_t, tile::Id::Hasher> demoted;
+    std::unordered_set<tile::Id, tile::Id::Hasher> in_ram; // only if the disk tier is full
+    {
+        auto locker = std::scoped_lock(m_data_mutex);
+        std::swap(dirty, m_pack_dirty);
+        std::swap(demoted, m_pack_demoted);
+        inserted.reserve(dirty.size() + m_pack_demoting.size());
+        for (const auto& [id, is_inserted] : dirty) {
+            const auto* object = is_inserted ? m_data.find(id) : nullptr;
+            if (object)
+                inserted.emplace_back(MetaData { visited_of(*object), object->meta.created }, object->data);
+        }
+        for (auto& [id, cache_object] : m_pack_demoting) {
+            inserted.emplace_back(cache_object.meta, std::move(cache_object.data));
+            demoted_ids.push_back(id);
+        }
+        m_pack_demoting.clear();
+        if (checkpoint) {
+            visited.reserve(m_data.size());
+            m_data.for_each([&](const tile::Id& id, const CacheObject& cache_object) { visited.emplace_back(id, visited_of(cache_object)); });
+        }
+        const auto quad_limit = m_disk_quad_limit.load();
+        if (quad_limit > 0 && (m_n_disk_objects + inserted.size() > quad_limit || m_n_disk_bytes > m_disk_byte_limit)) {
+            in_ram.reserve(m_data.size());
+            m_data.for_each([&](const tile::Id& id, const CacheObject&) { in_ram.insert(id); });
+        }
+    }
+
+    auto locker = std::unique_lock(m_disk_cached_mutex);
+    if (!m_pack)
+        return tl::unexpected<std::string>("The tile pack was closed while flushing!");
+    const auto fail = [&](std::string message) -> tl::expected<void, std::string> {
+        m_pack.reset(); // the next write starts from scratch
+        update_disk_counts();
+        return tl::unexpected(std::move(message));
+    };
+    for (const auto& [id, is_inserted] : dirty) {
+        if (!is_inserted) {
+            m_pack->remove(id);
+            m_disk_cached.erase(id);
+        }
+    }
+    for (const auto& [meta, tile] : inserted) {
+        std::vector<char> bytes;
+        zpp::bits::out out(bytes);
+        const auto r = out(tile);
+        if (failure(r))
+            return fail(std::make_error_code(r).message());
+        const auto r_append = m_pack->append(tile.id, bytes, meta.created, meta.visited);
+        if (!r_append.has_value())
+            return fail(r_append.error());
+        m_disk_cached[tile.id] = meta;
+    }
+    for (const auto& [id, stamp] : demoted) {
+        m_pack->set_visited(id, stamp); // journaled, the disk tier's lru order survives a restart
+        if (const auto it = m_disk_cached.find(id); it != m_disk_cached.end())
+            it->second.visited = stamp;
+    }
+    const auto evicted = in_ram.empty() ? std::vector<tile::Id> {} : evict_from_pack(in_ram);
+    if (checkpoint) {
+        for (const auto& [id, stamp] : visited)
+            m_pack->set_visited(id, stamp);
+    }
+    const auto r = checkpoint ? m_pack->commit() : m_pack->commit_journal();
+    if (!r.has_value())
+        return fail(r.error());
+    update_disk_counts();
+    locker.unlock();
+    finish_pack_write(demoted_ids, evicted);
+    return r;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<void, std::string> Cache<T, Map, Policy>::read_from_pack(const std::filesystem::path& base_path)
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    auto locker = std::scoped_lock(m_data_mutex, m_disk_cached_mutex);
+    const auto shard_locks = m_data.lock_all();
+    const auto clean_up = [&]() {
+        m_disk_cached.clear();
+        m_data.clear();
+        m_n_bytes = 0;
+        m_eviction_heap.clear();
+        m_next_snapshot.clear();
+        m_next_snapshot_dirty = true;
+        m_pack_pending.clear();
+        m_pack_dirty.clear();
+        m_pack_demoting.clear();
+        m_pack_demoted.clear();
+    };
+    clean_up();
+
+    m_pack = std::make_unique<TilePack>(base_path, T::version_information);
+    {
+        const auto r = m_pack->open(false);
+        if (!r.has_value()) {
+            m_pack.reset();
+            update_disk_counts();
+            return r;
+        }
+    }
+    for (const auto& [id, entry] : m_pack->index()) {
+        const auto bytes = m_pack->bytes(id);
+        if (!bytes) {
+            clean_up();
+            return tl::unexpected(fmt::format("Couldn't read tile {}/{}/{} from the tile pack!", id.zoom_level, id.coords.x, id.coords.y));
+        }
+        zpp::bits::in in(*bytes);
+        CacheObject d;
+        const auto r = in(d.data);
+        if (failure(r)) {
+            clean_up();
+            return tl::unexpected(std::make_error_code(r).message());
+        }
+        intern(d.data);
+        d.meta = { entry.visited, entry.created };
+        d.eviction_stamp = entry.visited;
+        d.n_bytes = n_bytes_of(d.data);
+        m_n_bytes += d.n_bytes;
+        m_eviction_heap.push_back({ entry.visited, id });
+        m_disk_cached[id] = d.meta;
+        m_next_snapshot[id] = std::make_shared<const T>(d.data);
+        m_data[id] = std::move(d);
+    }
+    std::make_heap(m_eviction_heap.begin(), m_eviction_heap.end(), std::greater<> {});
+    update_disk_counts();
+    return {};
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<void, std::string> Cache<T, Map, Policy>::open_pack(const std::filesystem::path& base_path)
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    auto locker = std::scoped_lock(m_data_mutex, m_disk_cached_mutex);
+    const auto shard_locks = m_data.lock_all();
+    m_disk_cached.clear();
+    m_data.clear();
+    m_n_bytes = 0;
+    m_eviction_heap.clear();
+    m_next_snapshot.clear();
+    m_next_snapshot_dirty = true;
+    m_pack_pending.clear();
+    m_pack_dirty.clear();
+    m_pack_demoting.clear();
+    m_pack_demoted.clear();
+
+    m_pack = std::make_unique<TilePack>(base_path, T::version_information);
+    const auto r = m_pack->open(false);
+    if (!r.has_value()) {
+        m_pack.reset();
+        update_disk_counts();
+        return r;
+    }
+    m_pack_pending.reserve(m_pack->index().size());
+    for (const auto& [id, entry] : m_pack->index()) {
+        m_disk_cached[id] = { entry.visited, entry.created };
+        m_pack_pending.insert(id);
+    }
+    update_disk_counts();
+    return {};
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+tl::expected<unsigned, std::string> Cache<T, Map, Policy>::load_from_pack(std::span<const tile::Id> ids)
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    std::vector<tile::Id> requested;
+    {
+        auto locker = std::shared_lock(m_data_mutex);
+        for (const auto& id : ids) {
+            if (m_pack_pending.contains(id))
+                requested.push_back(id);
+        }
+    }
+    if (requested.empty())
+        return 0u;
+
+    std::vector<CacheObject> loaded;
+    loaded.reserve(requested.size());
+    std::vector<tile::Id> evicted; // from the disk tier, after they were requested
+    {
+        auto locker = std::scoped_lock(m_disk_cached_mutex); // bytes() may remap the pack
+        if (!m_pack)
+            return tl::unexpected<std::string>("No tile pack is open!");
+        for (const auto& id : requested) {
+            const auto entry = m_pack->index().find(id);
+            if (entry == m_pack->index().end()) {
+                evicted.push_back(id);
+                continue;
+            }
+            const auto bytes = m_pack->bytes(id);
+            if (!bytes)
+                return tl::unexpected(fmt::format("Couldn't read tile {}/{}/{} from the tile pack!", id.zoom_level, id.coords.x, id.coords.y));
+            zpp::bits::in in(*bytes);
+            CacheObject d;
+            const auto r = in(d.data);
+            if (failure(r))
+                return tl::unexpected(std::make_error_code(r).message());
+            intern(d.data);
+            d.meta = { entry->second.visited, entry->second.created };
+            d.eviction_stamp = entry->second.visited;
+            d.n_bytes = n_bytes_of(d.data);
+            loaded.push_back(std::move(d));
+        }
+    }
+
+    auto locker = std::scoped_lock(m_data_mutex);
+    for (const auto& id : evicted)
+        m_pack_pending.erase(id);
+    unsigned n_loaded = 0;
+    for (auto& d : loaded) {
+        const auto id = d.data.id;
+        if (m_pack_pending.erase(id) == 0)
+            continue; // superseded by an insert in the meantime
+        m_n_bytes += d.n_bytes;
+        push_eviction_entry({ d.meta.visited, id });
+        m_next_snapshot[id] = std::make_shared<const T>(d.data);
+        auto shard_locker = std::unique_lock(m_data.shard_mutex(id));
+        m_data[id] = std::move(d);
+        ++n_loaded;
+    }
+    m_next_snapshot_dirty = m_next_snapshot_dirty || n_loaded > 0;
+    return n_loaded;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+std::unordered_set<tile::Id, tile::Id::Hasher> Cache<T, Map, Policy>::pending_from_pack() const
+{
+    auto locker = std::shared_lock(m_data_mutex);
+    return m_pack_pending;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+unsigned Cache<T, Map, Policy>::n_pending_from_pack() const
+{
+    auto locker = std::shared_lock(m_data_mutex);
+    return unsigned(m_pack_pending.size());
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+bool Cache<T, Map, Policy>::is_pending_from_pack(const tile::Id& id) const
+{
+    auto locker = std::shared_lock(m_data_mutex);
+    return m_pack_pending.contains(id);
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+void Cache<T, Map, Policy>::discard_pending_from_pack()
 {
     auto locker = std::scoped_lock(m_data_mutex);
-    const auto visited = utils::time_since_epoch();
+    m_pack_pending.clear();
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+void Cache<T, Map, Policy>::set_disk_limits(unsigned max_quads, uint64_t max_bytes)
+{
+    m_disk_quad_limit = max_quads;
+    m_disk_byte_limit = max_bytes;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+unsigned Cache<T, Map, Policy>::n_disk_cached_objects() const
+{
+    return m_n_disk_objects;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+uint64_t Cache<T, Map, Policy>::n_disk_bytes() const
+{
+    return m_n_disk_bytes;
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+template <typename VisitorFunction>
+void Cache<T, Map, Policy>::visit(const VisitorFunction& functor)
+{
+    const auto visited = m_clock();
     static_assert(requires { { functor(T()) } -> utils::convertible_to<bool>; }, "VisitorFunction must accept a const NamedTile and return a bool.");
     const auto root = tile::Id { 0, { 0, 0 } };
+    // shared: the map isn't modified, only the stamps (atomically). the shards of the subtrees are locked on the way down
+    auto locker = std::shared_lock(m_data.shard_mutex(root));
     visit(root, functor, visited);
 }
 
-template <tile_types::NamedTile T>
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
 template <typename VisitorFunction>
-void Cache<T>::visit(const tile::Id& node, const VisitorFunction& functor, uint64_t visited_stamp)
+void Cache<T, Map, Policy>::visit(const tile::Id& node, const VisitorFunction& functor, uint64_t visited_stamp)
 {
     static_assert(requires { { functor(T()) } -> utils::convertible_to<bool>; });
-    if (m_data.contains(node)) {
-        const auto should_continue = functor(m_data[node].data);
+    auto shard_locker = std::shared_lock<Mutex>();
+    if (decltype(m_data)::sharded && node.zoom_level == decltype(m_data)::shard_zoom_level)
+        shard_locker = std::shared_lock(m_data.shard_mutex(node));
+    auto* object = m_data.find(node);
+    if (object) {
+        const auto should_continue = functor(std::as_const(object->data));
         if (!should_continue)
             return;
-        m_data[node].meta.visited = visited_stamp * 100 - m_data[node].data.id.zoom_level;
+        if constexpr (Policy::Eviction::refresh_on_visit)
+            std::atomic_ref<uint64_t>(object->meta.visited).store(visited_stamp * 100 - object->data.id.zoom_level, std::memory_order_relaxed);
         const auto children = node.children();
         for (const auto& id : children) {
             visit(id, functor, visited_stamp);
@@ -344,23 +1014,87 @@ void Cache<T>::visit(const tile::Id& node, const VisitorFunction& functor, uint6
     }
 }
 
-template<tile_types::NamedTile T>
-std::vector<T> Cache<T>::purge(unsigned remaining_capacity)
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+template <typename VisitorFunction>
+void Cache<T, Map, Policy>::visit_readonly(const VisitorFunction& functor) const
+{
+    static_assert(requires { { functor(T()) } -> utils::convertible_to<bool>; }, "VisitorFunction must accept a const NamedTile and return a bool.");
+    const auto root = tile::Id { 0, { 0, 0 } };
+    auto locker = std::shared_lock(m_data.shard_mutex(root));
+    visit_readonly(root, functor);
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+template <typename VisitorFunction>
+void Cache<T, Map, Policy>::visit_readonly(const tile::Id& node, const VisitorFunction& functor) const
+{
+    auto shard_locker = std::shared_lock<Mutex>();
+    if (decltype(m_data)::sharded && node.zoom_level == decltype(m_data)::shard_zoom_level)
+        shard_locker = std::shared_lock(m_data.shard_mutex(node));
+    const auto* object = m_data.find(node);
+    if (!object || !functor(object->data))
+        return;
+    for (const auto& id : node.children()) {
+        visit_readonly(id, functor);
+    }
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+std::vector<T> Cache<T, Map, Policy>::purge(unsigned remaining_capacity, uint64_t remaining_bytes)
+{
+    return purge(remaining_capacity, remaining_bytes, [](const T&) { return false; });
+}
+
+template <tile_types::NamedTile T, template <typename> class Map, typename Policy>
+template <typename KeepFunction>
+std::vector<T> Cache<T, Map, Policy>::purge(unsigned remaining_capacity, uint64_t remaining_bytes, const KeepFunction& keep)
 {
+    static_assert(requires { { keep(T()) } -> utils::convertible_to<bool>; }, "KeepFunction must accept a const NamedTile and return a bool.");
     auto locker = std::scoped_lock(m_data_mutex);
-    if (remaining_capacity >= m_data.size())
+    if (remaining_capacity >= m_data.size() && remaining_bytes >= m_n_bytes)
         return {};
-    std::vector<std::pair<tile::Id, uint64_t>> tiles;
-    tiles.reserve(m_data.size());
-    std::transform(m_data.cbegin(), m_data.cend(), std::back_inserter(tiles), [](const auto& entry) { return std::make_pair(entry.first, entry.second.meta.visited); });
-    const auto nth_iter = tiles.begin() + remaining_capacity;
-    std::nth_element(tiles.begin(), nth_iter, tiles.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
     std::vector<T> purged_tiles;
-    purged_tiles.reserve(tiles.size() - remaining_capacity);
-    std::for_each(nth_iter, tiles.end(), [this, &purged_tiles](const auto& v) {
-        purged_tiles.push_back(m_data[v.first].data);
-        m_data.erase(v.first);
-    });
+    purged_tiles.reserve(m_data.size() > remaining_capacity ? m_data.size() - remaining_capacity : 0);
+    // O((n_purge + n_outdated + n_kept) log n), where n_outdated is the number of entries that were visited since their push
+    std::vector<EvictionEntry> kept; // pushed again after purging
+    auto keeping = true;
+    while (m_data.size() > remaining_capacity || m_n_bytes > remaining_bytes) {
+        if (m_eviction_heap.empty()) {
+            // only kept entries are left, the limits take precedence
+            for (const auto& entry : kept)
+                push_eviction_entry(entry);
+            kept.clear();
+            keeping = false;
+        }
+        assert(!m_eviction_heap.empty());
+        std::pop_heap(m_eviction_heap.begin(), m_eviction_heap.end(), std::greater<> {});
+        const auto entry = m_eviction_heap.back();
+        m_eviction_heap.pop_back();
+
+        auto* object = m_data.find(entry.id);
+        if (!object || object->eviction_stamp != entry.stamp)
+            continue; // superseded
+        const auto visited = visited_of(*object);
+        if (visited != entry.stamp) {
+            object->eviction_stamp = visited;
+            push_eviction_entry({ visited, entry.id });
+            continue;
+        }
+        if (keeping && keep(std::as_const(object->data))) {
+            kept.push_back(entry);
+            continue;
+        }
+        auto shard_locker = std::unique_lock(m_data.shard_mutex(entry.id));
+        m_n_bytes -= object->n_bytes;
+        demote(entry.id, *object);
+        purged_tiles.push_back(std::move(object->data));
+        m_data.erase(entry.id);
+        shard_locker.unlock();
+        m_next_snapshot.erase(entry.id);
+    }
+    for (const auto& entry : kept)
+        push_eviction_entry(entry);
+    m_next_snapshot_dirty = true;
     return purged_tiles;
 }
 
@@ -0,0 +1,106 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+#include <tl/expected.hpp>
+
+namespace nucleus::tile_scheduler {
+
+// compile time policies of Cache. they are resolved statically, so a build can specialise the locking, eviction, persistence
+// and sharding without virtual calls on the hot path (visit). the storage of a shard is the Map parameter of Cache.
+
+/// satisfies the (shared) lockable requirements, but doesn't lock. only for caches that are used by a single thread.
+struct NullMutex {
+    void lock() { }
+    void unlock() { }
+    bool try_lock() { return true; }
+    void lock_shared() { }
+    void unlock_shared() { }
+    bool try_lock_shared() { return true; }
+};
+
+/// shared locks for visits, exclusive ones for changes (see Cache)
+struct SharedLocking {
+    using Mutex = std::shared_mutex;
+    using SnapshotMutex = std::mutex;
+    static constexpr bool thread_safe = true;
+};
+
+/// no locking at all, e.g., for wasm builds without threads
+struct NoLocking {
+    using Mutex = NullMutex;
+    using SnapshotMutex = NullMutex;
+    static constexpr bool thread_safe = false;
+};
+
+/// visits refresh the visited stamp, so purge drops the least recently visited quads
+struct LruEviction {
+    static constexpr bool refresh_on_visit = true;
+};
+
+/// visits don't write the stamps, so purge drops the oldest inserts (and visits never write to shared cache lines)
+struct InsertionOrderEviction {
+    static constexpr bool refresh_on_visit = false;
+};
+
+/// single memory mapped pack file, written incrementally (see TilePack and Cache::flush_to_pack)
+struct PackPersistence {
+    template <typename Cache>
+    [[nodiscard]] static tl::expected<void, std::string> persist(Cache& cache, const std::filesystem::path& path) { return cache.flush_to_pack(path); }
+    template <typename Cache>
+    [[nodiscard]] static tl::expected<void, std::string> restore(Cache& cache, const std::filesystem::path& path) { return cache.read_from_pack(path); }
+    /// lazy, the tiles stay pending until they are loaded with Cache::load_from_pack
+    template <typename Cache>
+    [[nodiscard]] static tl::expected<void, std::string> open(Cache& cache, const std::filesystem::path& path) { return cache.open_pack(path); }
+};
+
+/// a file per tile (see Cache::write_to_disk). there is no lazy variant, open reads everything.
+struct FilePersistence {
+    template <typename Cache>
+    [[nodiscard]] static tl::expected<void, std::string> persist(Cache& cache, const std::filesystem::path& path) { return cache.write_to_disk(path); }
+    template <typename Cache>
+    [[nodiscard]] static tl::expected<void, std::string> restore(Cache& cache, const std::filesystem::path& path) { return cache.read_from_disk(path); }
+    template <typename Cache>
+    [[nodiscard]] static tl::expected<void, std::string> open(Cache& cache, const std::filesystem::path& path) { return cache.read_from_disk(path); }
+};
+
+/// ShardZoomLevel 0 keeps all quads in one shard (see ShardedTileMap), which only makes sense without locking.
+template <typename LockingT = SharedLocking, typename EvictionT = LruEviction, typename PersistenceT = PackPersistence, unsigned ShardZoomLevel = 4>
+struct CachePolicy {
+    using Locking = LockingT;
+    using Eviction = EvictionT;
+    using Persistence = PersistenceT;
+    static constexpr unsigned shard_zoom_level = ShardZoomLevel;
+};
+
+using DefaultCachePolicy = CachePolicy<>;
+using SingleThreadCachePolicy = CachePolicy<NoLocking, LruEviction, PackPersistence, 0>;
+
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING) && !defined(ALP_ENABLE_DECODE_WORKERS)
+using PlatformCachePolicy = SingleThreadCachePolicy;
+#else
+using PlatformCachePolicy = DefaultCachePolicy;
+#endif
+
+} // namespace nucleus::tile_scheduler
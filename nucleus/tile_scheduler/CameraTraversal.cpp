@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "CameraTraversal.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace nucleus::tile_scheduler;
+
+CameraTraversal::CameraTraversal(const camera::Definition& camera, utils::AabbDecoratorPtr aabb_decorator, double tile_size)
+    : m_camera(camera)
+    , m_frustum(camera.frustum())
+    , m_local_view_projection(camera.local_view_projection_matrix(camera.position()))
+    , m_relative_planes(utils::relative_frustum_planes(m_frustum, camera.position()))
+    , m_aabb_decorator(std::move(aabb_decorator))
+    , m_tile_size(tile_size)
+{
+    m_aabb_decorator->build_horizon(camera.position(), &m_horizon);
+}
+
+void CameraTraversal::reset(const camera::Definition& camera, utils::AabbDecoratorPtr aabb_decorator)
+{
+    m_camera = camera;
+    m_frustum = camera.frustum();
+    m_local_view_projection = camera.local_view_projection_matrix(camera.position());
+    m_relative_planes = utils::relative_frustum_planes(m_frustum, camera.position());
+    m_aabb_decorator = std::move(aabb_decorator);
+    m_aabb_decorator->build_horizon(camera.position(), &m_horizon);
+    m_nodes.clear_retaining_storage();
+}
+
+const nucleus::camera::Definition& CameraTraversal::camera() const
+{
+    return m_camera;
+}
+
+CameraTraversal::Node CameraTraversal::node(const tile::Id& tile) const
+{
+    const auto it = m_nodes.find(tile);
+    if (it != m_nodes.end())
+        return it->second;
+    if (tile.zoom_level == 0) {
+        const auto aabb = m_aabb_decorator->aabb(tile);
+        return m_nodes[tile] = make_node(tile, aabb, utils::classify_tile_in_frustum(m_frustum, aabb));
+    }
+
+    // siblings are visited together, so they are classified together
+    const auto siblings = tile.parent().children();
+    std::array<tile::SrsAndHeightBounds, 4> aabbs;
+    for (size_t i = 0; i < 4; ++i)
+        aabbs[i] = m_aabb_decorator->aabb(siblings[i]);
+    // boxes inside the box of a parent that is entirely inside or outside don't need the test (utils::inherited_frustum_classification)
+    std::array<std::optional<utils::FrustumClassification>, 4> inherited;
+    if (const auto parent = m_nodes.find(tile.parent()); parent != m_nodes.end()) {
+        for (size_t i = 0; i < 4; ++i)
+            inherited[i] = utils::inherited_frustum_classification(parent->second.frustum, parent->second.aabb, aabbs[i]);
+    }
+    const auto all_inherited = std::all_of(inherited.begin(), inherited.end(), [](const auto& c) { return c.has_value(); });
+    const auto classifications = all_inherited ? std::array<utils::FrustumClassification, 4> {} : utils::classify_tiles_in_frustum(m_frustum, m_relative_planes, aabbs);
+    for (size_t i = 0; i < 4; ++i) {
+        if (!m_nodes.contains(siblings[i]))
+            m_nodes[siblings[i]] = make_node(siblings[i], aabbs[i], inherited[i] ? *inherited[i] : classifications[i]);
+    }
+    return m_nodes.at(tile);
+}
+
+CameraTraversal::Node CameraTraversal::make_node(const tile::Id& tile, const tile::SrsAndHeightBounds& aabb, utils::FrustumClassification frustum) const
+{
+    Node node { aabb, frustum, false, 0 };
+    if (frustum != utils::FrustumClassification::Outside)
+        node.below_horizon = m_aabb_decorator->below_horizon(tile, m_horizon);
+    if (frustum != utils::FrustumClassification::Outside && !node.below_horizon) {
+        const auto distance = float(geometry::distance(aabb, m_camera.position()));
+        node.screen_space_error = m_camera.to_screen_space(m_aabb_decorator->error_size(tile, aabb, m_tile_size), distance);
+    }
+    return node;
+}
+
+float CameraTraversal::screen_space_error(const tile::Id& tile) const
+{
+    return node(tile).screen_space_error;
+}
+
+bool CameraTraversal::refine(const tile::Id& tile, float error_threshold_px) const
+{
+    if (tile.zoom_level >= 18)
+        return false;
+    const auto n = node(tile);
+    return n.frustum != utils::FrustumClassification::Outside && !n.below_horizon && n.screen_space_error >= error_threshold_px;
+}
+
+float CameraTraversal::projected_size(const tile::Id& tile) const
+{
+    const auto aabb = node(tile).aabb;
+    const auto min = glm::vec3(aabb.min - m_camera.position());
+    const auto max = glm::vec3(aabb.max - m_camera.position());
+    auto ndc_min = glm::vec2(std::numeric_limits<float>::max());
+    auto ndc_max = glm::vec2(std::numeric_limits<float>::lowest());
+    for (unsigned i = 0; i < 8; ++i) {
+        const auto corner = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        const auto clip = m_local_view_projection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0)
+            return std::numeric_limits<float>::infinity();
+        const auto ndc = glm::vec2(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+    }
+    const auto size = (ndc_max - ndc_min) * 0.5f * glm::vec2(m_camera.viewport_size());
+    return std::max(size.x, size.y);
+}
+
+size_t CameraTraversal::n_evaluated_tiles() const
+{
+    return m_nodes.size();
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+
+#include "FlatTileMap.h"
+#include "HorizonOcclusion.h"
+#include "nucleus/camera/Definition.h"
+#include "radix/tile.h"
+#include "utils.h"
+
+namespace nucleus::tile_scheduler {
+
+/// The quad tree evaluation of one camera: frustum classification and screen space error per tile, memoised, so that the
+/// traversals of the same camera (requests, gpu update, purge, disk cache streaming) evaluate each tile only once.
+/// The four children of a quad are classified together (utils::classify_tiles_in_frustum), in float relative to the camera.
+/// Children whose box is inside the box of a parent that is entirely inside or outside skip the frustum test (as long as the
+/// parent was evaluated first, which is the case for top down traversals). Tiles below the horizon of the terrain around the
+/// camera count as invisible, if the decorator has horizon culling enabled. Not thread safe.
+class CameraTraversal {
+public:
+    struct Node {
+        tile::SrsAndHeightBounds aabb = {};
+        utils::FrustumClassification frustum = utils::FrustumClassification::Outside;
+        bool below_horizon = false; // see utils::AabbDecorator::set_horizon_culling, only tested inside of the frustum
+        float screen_space_error = 0; // in pixels, 0 outside of the frustum and below the horizon
+    };
+
+    CameraTraversal(const camera::Definition& camera, utils::AabbDecoratorPtr aabb_decorator, double tile_size = 256);
+
+    /// starts over for another camera. the memo keeps its storage, so a traversal that is reused every frame doesn't allocate.
+    void reset(const camera::Definition& camera, utils::AabbDecoratorPtr aabb_decorator);
+
+    [[nodiscard]] const camera::Definition& camera() const;
+    [[nodiscard]] Node node(const tile::Id& tile) const;
+    [[nodiscard]] float screen_space_error(const tile::Id& tile) const;
+    /// same decision as utils::refineFunctor
+    [[nodiscard]] bool refine(const tile::Id& tile, float error_threshold_px) const;
+    [[nodiscard]] auto refine_functor(float error_threshold_px) const
+    {
+        return [this, error_threshold_px](const tile::Id& tile) { return refine(tile, error_threshold_px); };
+    }
+    /// larger side of the screen space rectangle of the tile's box, in pixels. infinite if the box reaches behind the camera.
+    /// not memoised, unlike the screen space error.
+    [[nodiscard]] float projected_size(const tile::Id& tile) const;
+    [[nodiscard]] size_t n_evaluated_tiles() const;
+
+private:
+    [[nodiscard]] Node make_node(const tile::Id& tile, const tile::SrsAndHeightBounds& aabb, utils::FrustumClassification frustum) const;
+
+    camera::Definition m_camera;
+    camera::Frustum m_frustum;
+    glm::mat4 m_local_view_projection; // relative to the camera position
+    utils::RelativeFrustumPlanes m_relative_planes;
+    HorizonOcclusion m_horizon;
+    utils::AabbDecoratorPtr m_aabb_decorator;
+    double m_tile_size;
+    mutable FlatTileMap<Node> m_nodes;
+};
+
+} // namespace nucleus::tile_scheduler
@@ -0,0 +1,136 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "DepthPyramid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "radix/geometry.h"
+
+using nucleus::tile_scheduler::DepthPyramid;
+
+void DepthPyramid::build(const camera::Definition& camera, const glm::uvec2& size, std::span<const float> distances)
+{
+    assert(distances.size() == size_t(size.x) * size.y);
+    clear();
+    if (size.x == 0 || size.y == 0)
+        return;
+    m_camera = camera;
+    m_max_distances.assign(distances.begin(), distances.end());
+    m_level_sizes.push_back(size);
+    m_level_offsets.push_back(0);
+    while (m_level_sizes.back() != glm::uvec2(1)) {
+        const auto fine_size = m_level_sizes.back();
+        const auto fine_offset = m_level_offsets.back();
+        const auto coarse_size = (fine_size + 1u) / 2u;
+        const auto coarse_offset = m_max_distances.size();
+        m_max_distances.resize(coarse_offset + size_t(coarse_size.x) * coarse_size.y);
+        for (unsigned y = 0; y < coarse_size.y; ++y) {
+            for (unsigned x = 0; x < coarse_size.x; ++x) {
+                const auto x0 = 2 * x;
+                const auto y0 = 2 * y;
+                const auto x1 = std::min(x0 + 1, fine_size.x - 1);
+                const auto y1 = std::min(y0 + 1, fine_size.y - 1);
+                const auto fine = [&](unsigned fx, unsigned fy) { return m_max_distances[fine_offset + size_t(fy) * fine_size.x + fx]; };
+                m_max_distances[coarse_offset + size_t(y) * coarse_size.x + x] = std::max({ fine(x0, y0), fine(x1, y0), fine(x0, y1), fine(x1, y1) });
+            }
+        }
+        m_level_sizes.push_back(coarse_size);
+        m_level_offsets.push_back(coarse_offset);
+    }
+}
+
+void DepthPyramid::clear()
+{
+    m_level_sizes.clear();
+    m_level_offsets.clear();
+    m_max_distances.clear();
+}
+
+bool DepthPyramid::empty() const
+{
+    return m_level_sizes.empty();
+}
+
+const nucleus::camera::Definition& DepthPyramid::camera() const
+{
+    return m_camera;
+}
+
+unsigned DepthPyramid::n_levels() const
+{
+    return unsigned(m_level_sizes.size());
+}
+
+glm::uvec2 DepthPyramid::level_size(unsigned level) const
+{
+    return m_level_sizes.at(level);
+}
+
+float DepthPyramid::max_distance(unsigned level, const glm::uvec2& cell) const
+{
+    const auto size = m_level_sizes.at(level);
+    assert(cell.x < size.x && cell.y < size.y);
+    return m_max_distances[m_level_offsets[level] + size_t(cell.y) * size.x + cell.x];
+}
+
+bool DepthPyramid::occludes(const tile::SrsAndHeightBounds& aabb, double camera_offset) const
+{
+    if (empty())
+        return false;
+    const auto near_distance = geometry::distance(aabb, m_camera.position());
+    if (near_distance <= 0)
+        return false;
+
+    // screen space rectangle of the box
+    const auto world_to_clip = m_camera.world_view_projection_matrix();
+    auto ndc_min = glm::dvec2(std::numeric_limits<double>::max());
+    auto ndc_max = glm::dvec2(std::numeric_limits<double>::lowest());
+    for (unsigned i = 0; i < 8; ++i) {
+        const auto corner = glm::dvec3((i & 1) ? aabb.max.x : aabb.min.x, (i & 2) ? aabb.max.y : aabb.min.y, (i & 4) ? aabb.max.z : aabb.min.z);
+        const auto clip = world_to_clip * glm::dvec4(corner, 1.0);
+        if (clip.w <= 0)
+            return false; // behind the camera, the rectangle is unbounded
+        const auto ndc = glm::dvec2(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+    }
+    if (ndc_min.x < -1 || ndc_min.y < -1 || ndc_max.x > 1 || ndc_max.y > 1)
+        return false; // not entirely in the stored view, the depth outside of it is unknown
+
+    // the level with at most 2x2 cells covering the rectangle
+    const auto size = glm::dvec2(m_level_sizes.front());
+    const auto to_pixel = [&](const glm::dvec2& ndc) { return glm::min(glm::uvec2((ndc + 1.0) * 0.5 * size), m_level_sizes.front() - 1u); };
+    auto first = to_pixel(ndc_min);
+    auto last = to_pixel(ndc_max);
+    unsigned level = 0;
+    while (level + 1 < n_levels() && (last.x - first.x > 1 || last.y - first.y > 1)) {
+        first /= 2u;
+        last /= 2u;
+        ++level;
+    }
+    float max_distance_behind = 0;
+    for (auto y = first.y; y <= last.y; ++y) {
+        for (auto x = first.x; x <= last.x; ++x)
+            max_distance_behind = std::max(max_distance_behind, max_distance(level, { x, y }));
+    }
+    return near_distance > double(max_distance_behind) * (1.0 + relative_margin) + camera_offset;
+}
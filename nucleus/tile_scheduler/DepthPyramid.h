@@ -0,0 +1,59 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nucleus/camera/Definition.h"
+#include "radix/tile.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Hierarchical depth (max distance per cell, every level halves the resolution) of a previous frame, used to skip tiles
+/// that are hidden behind terrain (hi-z occlusion culling). The test is done in the view of the stored camera. For a
+/// camera that moved since, it is approximate: the distance moved is added to the margin, and boxes that reach outside of
+/// the stored view are never occluded.
+class DepthPyramid {
+public:
+    static constexpr float relative_margin = 0.01f; // covers the quantisation of the encoded depth
+
+    /// distances in metres from camera.position(), row major starting with the bottom row (like glReadPixels).
+    /// infinity where there is no terrain. the storage is kept between builds.
+    void build(const camera::Definition& camera, const glm::uvec2& size, std::span<const float> distances);
+    void clear();
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] const camera::Definition& camera() const;
+    [[nodiscard]] unsigned n_levels() const;
+    [[nodiscard]] glm::uvec2 level_size(unsigned level) const;
+    [[nodiscard]] float max_distance(unsigned level, const glm::uvec2& cell) const;
+
+    /// camera_offset: distance between the current camera and camera()
+    [[nodiscard]] bool occludes(const tile::SrsAndHeightBounds& aabb, double camera_offset = 0) const;
+
+private:
+    camera::Definition m_camera;
+    std::vector<glm::uvec2> m_level_sizes;
+    std::vector<size_t> m_level_offsets;
+    std::vector<float> m_max_distances; // all levels, the finest first
+};
+
+} // namespace nucleus::tile_scheduler
@@ -19,8 +19,10 @@
 
 #include "DrawListGenerator.h"
 
-#include "radix/iterator.h"
-#include "radix/quad_tree.h"
+#include <algorithm>
+
+#include "CameraTraversal.h"
+#include "DepthPyramid.h"
 
 using nucleus::tile_scheduler::DrawListGenerator;
 
@@ -31,44 +33,266 @@ DrawListGenerator::DrawListGenerator()
     set_aabb_decorator(tile_scheduler::utils::AabbDecorator::make(std::move(h)));
 }
 
+DrawListGenerator::~DrawListGenerator() = default;
+
 void DrawListGenerator::set_permissible_screen_space_error(float new_permissible_screen_space_error)
 {
     m_permissible_screen_space_error = new_permissible_screen_space_error;
+    invalidate_refinement();
+}
+
+void DrawListGenerator::set_min_tile_contribution(float min_size)
+{
+    m_min_tile_contribution = min_size;
+    invalidate_refinement();
 }
 
 void DrawListGenerator::set_aabb_decorator(const tile_scheduler::utils::AabbDecoratorPtr& new_aabb_decorator)
 {
     m_aabb_decorator = new_aabb_decorator;
+    invalidate_refinement();
 }
 
 void DrawListGenerator::add_tile(const tile::Id& id)
 {
-    m_available_tiles.insert(id);
+    if (m_available_tiles.insert(id).second)
+        record_change(id);
 }
 
 void DrawListGenerator::remove_tile(const tile::Id& id)
 {
-    m_available_tiles.erase(id);
+    if (m_available_tiles.erase(id))
+        record_change(id);
 }
 
-DrawListGenerator::TileSet DrawListGenerator::generate_for(const nucleus::camera::Definition& camera) const
+void DrawListGenerator::record_change(const tile::Id& tile)
 {
-    const auto tile_refine_functor
-        = tile_scheduler::utils::refineFunctor(camera,
-                                               m_aabb_decorator,
-                                               m_permissible_screen_space_error);
-    const auto draw_refine_functor = [&tile_refine_functor, this](const tile::Id &tile) {
-        bool all = true;
-        for (const auto &child : tile.children()) {
-            all = all && m_available_tiles.contains(child);
-        }
-        return all && tile_refine_functor(tile);
-    };
+    if (!m_refinement_camera)
+        return;
+    if (m_changed_roots.size() >= max_changed_roots) {
+        invalidate_refinement();
+        return;
+    }
+    // the tile decides about its own refinement and the one of its parent
+    m_changed_roots.insert(tile.zoom_level == 0 ? tile : tile.parent());
+}
 
-    const auto all_leaves = quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, draw_refine_functor, [](const tile::Id& v) { return v.children(); });
+void DrawListGenerator::invalidate_refinement()
+{
+    m_refinement_camera.reset();
+    m_changed_roots.clear();
+}
+
+bool DrawListGenerator::refine(const CameraTraversal& traversal, const tile::Id& tile) const
+{
+    if (tile.zoom_level > 0 && !m_available_tiles.contains(tile))
+        return false; // missing children couldn't fall back to it
+    const auto children = tile.children();
+    const auto any = std::any_of(children.begin(), children.end(), [this](const tile::Id& child) { return m_available_tiles.contains(child); });
+    if (!any || !traversal.refine(tile, m_permissible_screen_space_error))
+        return false;
+    // the children have about half the size of the parent
+    return m_min_tile_contribution <= 0 || traversal.projected_size(tile) >= 2 * m_min_tile_contribution;
+}
 
+DrawListGenerator::TileSet DrawListGenerator::generate_for(const nucleus::camera::Definition& camera, QuadrantMasks* partial_tiles) const
+{
     TileSet tileset;
-    tileset.reserve(all_leaves.size());
-    std::copy(all_leaves.begin(), all_leaves.end(), radix::unordered_inserter(tileset));
+    generate_for(camera, &tileset, partial_tiles);
     return tileset;
 }
+
+void DrawListGenerator::generate_for(const nucleus::camera::Definition& camera, TileSet* draw_list, QuadrantMasks* partial_tiles) const
+{
+    // the memo of m_traversal is still valid for the same camera and boxes
+    m_last_was_incremental = m_traversal && m_refinement_camera && *m_refinement_camera == camera && m_refinement_aabb_version == m_aabb_decorator->version();
+    if (m_last_was_incremental) {
+        update_refinement();
+    } else {
+        // subtrees that are fully inside the frustum are not tested again
+        if (m_traversal)
+            m_traversal->reset(camera, m_aabb_decorator);
+        else
+            m_traversal = std::make_unique<CameraTraversal>(camera, m_aabb_decorator);
+        const auto make_draw_refine_functor = [this](const CameraTraversal& traversal) {
+            return [&traversal, this](const tile::Id& tile) { return refine(traversal, tile); };
+        };
+        // wide views are traversed in parallel, with a traversal for each thread (kept, like m_traversal)
+        const auto make_runner_refine_functor = [&](unsigned runner) {
+            if (m_runner_traversals.size() < runner)
+                m_runner_traversals.resize(runner);
+            auto& traversal = m_runner_traversals[runner - 1];
+            if (traversal)
+                traversal->reset(camera, m_aabb_decorator);
+            else
+                traversal = std::make_unique<CameraTraversal>(camera, m_aabb_decorator);
+            return make_draw_refine_functor(*traversal);
+        };
+        m_parallel_traversal.traverse(make_draw_refine_functor(*m_traversal), make_runner_refine_functor, &m_inner_nodes, &m_leaves);
+        m_refinement_camera = camera;
+        m_refinement_aabb_version = m_aabb_decorator->version();
+        m_refinement_filled = false;
+    }
+    m_changed_roots.clear();
+
+    m_draw_leaves.assign(m_leaves.begin(), m_leaves.end());
+    for (auto& leaf : m_draw_leaves) {
+        if (leaf.zoom_level == 0 || m_available_tiles.contains(leaf))
+            continue;
+        // not loaded yet, the parent is drawn in its place
+        if (partial_tiles)
+            (*partial_tiles)[leaf.parent()] |= uint8_t(1u << quadrant_of(leaf));
+        leaf = leaf.parent();
+    }
+    draw_list->assign(m_draw_leaves.begin(), m_draw_leaves.end());
+}
+
+void DrawListGenerator::update_refinement() const
+{
+    if (m_changed_roots.empty())
+        return; // m_leaves is the last list
+    if (!m_refinement_filled) {
+        m_refinement.clear_retaining_storage();
+        for (const auto& tile : m_inner_nodes)
+            m_refinement[tile] = true;
+        for (const auto& tile : m_leaves)
+            m_refinement[tile] = false;
+        m_refinement_filled = true;
+    }
+    // coarser roots first, the subtrees of finer ones below them are traversed again, with the same result
+    for (const auto& root : m_changed_roots) {
+        if (!m_refinement.contains(root))
+            continue; // below a leaf, or outside of the traversed tree
+        m_stack.assign(1, root);
+        while (!m_stack.empty()) {
+            const auto tile = m_stack.back();
+            m_stack.pop_back();
+            const auto refined = m_refinement.at(tile);
+            m_refinement.erase(tile);
+            if (!refined)
+                continue;
+            for (const auto& child : tile.children())
+                m_stack.push_back(child);
+        }
+        // the ancestors are evaluated first, as in the traversal from the root (inherited frustum classification, see
+        // CameraTraversal). the ones that were evaluated by the threads of m_parallel_traversal are not in the memo.
+        for (auto ancestor = root; ancestor.zoom_level > 0;)
+            m_stack.push_back(ancestor = ancestor.parent());
+        for (auto it = m_stack.rbegin(); it != m_stack.rend(); ++it)
+            (void)m_traversal->node(*it);
+        m_stack.assign(1, root);
+        while (!m_stack.empty()) {
+            const auto tile = m_stack.back();
+            m_stack.pop_back();
+            const auto refined = refine(*m_traversal, tile);
+            m_refinement[tile] = refined;
+            if (!refined)
+                continue;
+            for (const auto& child : tile.children())
+                m_stack.push_back(child);
+        }
+    }
+    m_leaves.clear();
+    for (const auto& [tile, refined] : m_refinement) {
+        if (!refined)
+            m_leaves.push_back(tile);
+    }
+}
+
+unsigned DrawListGenerator::quadrant_of(const tile::Id& child)
+{
+    return (child.coords.x & 1) + 2 * (child.coords.y & 1);
+}
+
+nucleus::tile_scheduler::utils::FrustumClassification DrawListGenerator::classify(const tile::Id& tile, CullContext& context) const
+{
+    if (const auto it = context.memo.find(tile); it != context.memo.end())
+        return it->second.classification;
+    if (tile.zoom_level == 0) {
+        const auto aabb = m_aabb_decorator->aabb(tile);
+        const auto classification = utils::classify_tile_in_frustum(context.frustum, aabb);
+        context.memo[tile] = { aabb, classification };
+        return classification;
+    }
+
+    // the siblings are classified together, see utils::classify_tiles_in_frustum
+    const auto parent = tile.parent();
+    const auto parent_classification = classify(parent, context);
+    const auto parent_aabb = context.memo.at(parent).aabb;
+    const auto siblings = parent.children();
+    std::array<tile::SrsAndHeightBounds, 4> aabbs;
+    std::array<std::optional<utils::FrustumClassification>, 4> inherited;
+    for (size_t i = 0; i < 4; ++i) {
+        aabbs[i] = m_aabb_decorator->aabb(siblings[i]);
+        inherited[i] = utils::inherited_frustum_classification(parent_classification, parent_aabb, aabbs[i]);
+    }
+    const auto all_inherited = std::all_of(inherited.begin(), inherited.end(), [](const auto& c) { return c.has_value(); });
+    const auto classifications = all_inherited ? std::array<utils::FrustumClassification, 4> {} : utils::classify_tiles_in_frustum(context.frustum, context.planes, aabbs);
+    for (size_t i = 0; i < 4; ++i) {
+        if (!context.memo.contains(siblings[i]))
+            context.memo[siblings[i]] = CullNode { aabbs[i], inherited[i] ? *inherited[i] : classifications[i] };
+    }
+    return context.memo.at(tile).classification;
+}
+
+void DrawListGenerator::cull_occluded(const DepthPyramid& pyramid, const glm::dvec3& camera_position, TileSet* tiles, std::vector<tile::Id>* occluded) const
+{
+    if (pyramid.empty())
+        return;
+    const auto camera_offset = glm::distance(camera_position, pyramid.camera().position());
+    tiles->erase_if([&](const tile::Id& tile) {
+        if (!pyramid.occludes(m_aabb_decorator->aabb(tile), camera_offset))
+            return false;
+        occluded->push_back(tile);
+        return true;
+    });
+}
+
+void DrawListGenerator::cull_below_horizon(const camera::Definition& camera, TileSet* tiles) const
+{
+    if (!m_aabb_decorator->horizon_culling())
+        return;
+    m_aabb_decorator->build_horizon(camera.position(), &m_horizon);
+    tiles->erase_if([this](const tile::Id& tile) { return m_aabb_decorator->below_horizon(tile, m_horizon); });
+}
+
+void DrawListGenerator::cull_by_distance(const glm::dvec3& position, double min_distance, double max_distance, TileSet* tiles) const
+{
+    tiles->erase_if([&](const tile::Id& tile) {
+        const auto aabb = m_aabb_decorator->aabb(tile);
+        if (geometry::distance(aabb, position) > max_distance)
+            return true;
+        // the farthest corner
+        const auto farthest = glm::max(glm::abs(aabb.min - position), glm::abs(aabb.max - position));
+        return glm::length(farthest) < min_distance;
+    });
+}
+
+float DrawListGenerator::screen_space_error(const camera::Definition& camera, const tile::Id& tile) const
+{
+    const auto aabb = m_aabb_decorator->aabb(tile);
+    const auto distance = float(geometry::distance(aabb, camera.position()));
+    return camera.to_screen_space(m_aabb_decorator->error_size(tile, aabb, 256), distance);
+}
+
+glm::dvec3 DrawListGenerator::frustum_centre(const camera::Frustum& frustum)
+{
+    glm::dvec3 centre = {};
+    for (const auto& corner : frustum.corners)
+        centre += corner;
+    return centre / double(frustum.corners.size());
+}
+
+std::vector<tile::SrsAndHeightBounds> DrawListGenerator::aabbs(const TileSet& tileset) const
+{
+    std::vector<tile::SrsAndHeightBounds> bounds;
+    aabbs(tileset, &bounds);
+    return bounds;
+}
+
+void DrawListGenerator::aabbs(const TileSet& tileset, std::vector<tile::SrsAndHeightBounds>* bounds) const
+{
+    bounds->clear();
+    bounds->reserve(tileset.size());
+    std::transform(tileset.begin(), tileset.end(), std::back_inserter(*bounds), [this](const tile::Id& id) { return m_aabb_decorator->aabb(id); });
+}
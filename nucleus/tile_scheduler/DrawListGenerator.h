@@ -19,43 +19,137 @@
 
 #pragma once
 
+#include "FlatTileMap.h"
+#include "HorizonOcclusion.h"
+#include "ParallelTraversal.h"
+#include "TileIdSet.h"
 #include "nucleus/camera/Definition.h"
-#include "radix/iterator.h"
 #include "utils.h"
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <unordered_set>
+#include <vector>
 
 namespace nucleus::tile_scheduler {
+class CameraTraversal;
+class DepthPyramid;
+
+/// The draw list is generated on the render thread every frame. The scratch storage (traversal, memos) is kept between calls,
+/// and the overloads with an output parameter reuse the storage of the given set, so steady state frames don't allocate.
+/// The refinement of the last camera is kept as well. As long as the camera doesn't change, tile events only re-traverse the
+/// subtree below the parent of the tile (its refinement is the only one that depends on the tile), so streaming in tiles
+/// with a camera at rest costs in proportion to the change. A moved camera changes the screen space error of every node,
+/// and is traversed from the root. Not thread safe, also not the const functions.
 class DrawListGenerator
 {
 public:
-    using TileSet = std::unordered_set<tile::Id, tile::Id::Hasher>;
+    using TileSet = TileIdSet;
+    // bit quadrant_of(child) is set if the tile is drawn in the area of that child
+    using QuadrantMasks = FlatTileMap<uint8_t>;
+    static constexpr uint8_t all_quadrants = 0b1111;
 
     DrawListGenerator();
+    ~DrawListGenerator();
 
     void set_permissible_screen_space_error(float new_permissible_screen_space_error);
+    [[nodiscard]] float permissible_screen_space_error() const { return m_permissible_screen_space_error; }
+    /// contribution culling: tiles are not refined if their children would project to less than min_size pixels (see
+    /// CameraTraversal::projected_size), the parent is drawn in their place. such tiles still pass the screen space error
+    /// test at grazing angles (curtains, far slopes), but cost an instance each. 0 turns it off (the default).
+    void set_min_tile_contribution(float min_size);
     void set_aabb_decorator(const utils::AabbDecoratorPtr& new_aabb_decorator);
+    [[nodiscard]] const utils::AabbDecoratorPtr& aabb_decorator() const { return m_aabb_decorator; }
     void add_tile(const tile::Id& id);
     void remove_tile(const tile::Id& id);
-    [[nodiscard]] TileSet generate_for(const camera::Definition& camera) const;
+    /// tiles are refined as soon as one of their children is available. the parent stays in the list for the missing ones
+    /// and is drawn only in their quadrants (partial_tiles, tiles that are drawn fully are not in there).
+    [[nodiscard]] TileSet generate_for(const camera::Definition& camera, QuadrantMasks* partial_tiles = nullptr) const;
+    void generate_for(const camera::Definition& camera, TileSet* draw_list, QuadrantMasks* partial_tiles = nullptr) const;
+    /// whether the last generate_for updated the previous refinement, instead of traversing from the root
+    [[nodiscard]] bool last_was_incremental() const { return m_last_was_incremental; }
+    /// (x & 1) + 2 * (y & 1), i.e. south west, south east, north west, north east
+    [[nodiscard]] static unsigned quadrant_of(const tile::Id& child);
+    [[nodiscard]] std::vector<tile::SrsAndHeightBounds> aabbs(const TileSet& tileset) const;
+    void aabbs(const TileSet& tileset, std::vector<tile::SrsAndHeightBounds>* bounds) const;
 
+    /// hierarchical: the ancestors of the tiles are classified top down, tiles below an ancestor that is entirely inside or
+    /// outside of the frustum don't need the frustum test. in wide views only the tiles on the boundary are tested.
+    /// siblings are tested together (utils::classify_tiles_in_frustum).
     template<class TileIdContainerType>
     TileSet cull(const TileIdContainerType& tileset, const camera::Frustum& frustum) const
     {
         TileSet visible_leaves;
-        visible_leaves.reserve(tileset.size());
-
-        const auto is_visible = [frustum, this](const tile::Id& tile) {
-            return tile_scheduler::utils::camera_frustum_contains_tile(frustum, m_aabb_decorator->aabb(tile));
-        };
-
-        std::copy_if(tileset.begin(), tileset.end(), radix::unordered_inserter(visible_leaves), is_visible);
+        cull(tileset, frustum, &visible_leaves);
         return visible_leaves;
     }
+    template <class TileIdContainerType>
+    void cull(const TileIdContainerType& tileset, const camera::Frustum& frustum, TileSet* visible_leaves) const
+    {
+        visible_leaves->clear();
+        // relative to the centre, so that the boxes can be tested in float (also for the frusta of the shadow cascades)
+        CullContext context { frustum, utils::relative_frustum_planes(frustum, frustum_centre(frustum)), m_cull_memo };
+        context.memo.clear_retaining_storage();
+        context.memo.reserve(tileset.size() * 2);
+        for (const auto& tile : tileset) {
+            if (classify(tile, context) != utils::FrustumClassification::Outside)
+                visible_leaves->insert(tile); // appends for sorted input
+        }
+    }
+
+    /// removes the tiles that are hidden in the depth pyramid (see DepthPyramid::occludes) and appends them to occluded
+    void cull_occluded(const DepthPyramid& pyramid, const glm::dvec3& camera_position, TileSet* tiles, std::vector<tile::Id>* occluded) const;
+    /// removes the tiles that are hidden behind the terrain around the camera (see utils::AabbDecorator::set_horizon_culling).
+    /// generate_for doesn't refine them, this removes the coarse ones that are left.
+    void cull_below_horizon(const camera::Definition& camera, TileSet* tiles) const;
+    /// keeps the tiles that reach into the shell between min_distance and max_distance around position, i.e., removes the ones
+    /// that are entirely nearer or entirely farther (used for splitting the view into a near and a far field, see
+    /// gl_engine::FarField)
+    void cull_by_distance(const glm::dvec3& position, double min_distance, double max_distance, TileSet* tiles) const;
+    /// in pixels, as the refinement sees it (without the frustum and horizon tests). not memoised, for the debug overlays.
+    [[nodiscard]] float screen_space_error(const camera::Definition& camera, const tile::Id& tile) const;
 
 private:
+    struct CullNode {
+        tile::SrsAndHeightBounds aabb = {};
+        utils::FrustumClassification classification = utils::FrustumClassification::Outside;
+    };
+    struct CullContext {
+        const camera::Frustum& frustum;
+        utils::RelativeFrustumPlanes planes;
+        FlatTileMap<CullNode>& memo;
+    };
+    utils::FrustumClassification classify(const tile::Id& tile, CullContext& context) const;
+    [[nodiscard]] bool refine(const CameraTraversal& traversal, const tile::Id& tile) const;
+    void record_change(const tile::Id& tile);
+    void invalidate_refinement();
+    // re-traverses the subtrees of m_changed_roots in m_refinement, and collects its leaves in m_leaves
+    void update_refinement() const;
+    static glm::dvec3 frustum_centre(const camera::Frustum& frustum);
+
     utils::AabbDecoratorPtr m_aabb_decorator;
-    TileSet m_available_tiles;
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_available_tiles;
     float m_permissible_screen_space_error = 2.0;
+    float m_min_tile_contribution = 0;
+    // scratch storage, reused between calls
+    mutable std::unique_ptr<CameraTraversal> m_traversal;
+    mutable std::vector<std::unique_ptr<CameraTraversal>> m_runner_traversals; // of the other threads of m_parallel_traversal
+    mutable ParallelTraversal m_parallel_traversal;
+    mutable std::vector<tile::Id> m_leaves; // of the refinement, the missing ones are replaced by their parent in m_draw_leaves
+    mutable std::vector<tile::Id> m_inner_nodes;
+    mutable std::vector<tile::Id> m_draw_leaves;
+    mutable std::vector<tile::Id> m_stack;
+    // the refinement of the last camera: true for inner nodes, false for leaves. filled from m_inner_nodes and m_leaves on
+    // the first local update after a traversal from the root (most of those are followed by another camera).
+    mutable FlatTileMap<bool> m_refinement;
+    mutable bool m_refinement_filled = false;
+    mutable std::optional<camera::Definition> m_refinement_camera; // reset if the refinement can't be updated locally
+    mutable unsigned m_refinement_aabb_version = 0;
+    mutable bool m_last_was_incremental = false;
+    mutable TileIdSet m_changed_roots; // parents of the tiles that were added or removed since the last generate_for
+    static constexpr size_t max_changed_roots = 512; // more are traversed from the root
+    mutable FlatTileMap<CullNode> m_cull_memo;
+    mutable HorizonOcclusion m_horizon;
 };
 }
@@ -0,0 +1,237 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "radix/tile.h"
+
+namespace nucleus::tile_scheduler {
+
+/// default storage of Cache
+template <typename Value>
+using StdTileMap = std::unordered_map<tile::Id, Value, tile::Id::Hasher>;
+
+/// Open addressing (linear probing) hash map for tile ids, with the subset of the std::unordered_map api used by Cache.
+/// The hash keeps the 4 siblings of a node in 4 consecutive slots, so a quad tree traversal touches contiguous memory
+/// and resolves each node with a single probe sequence. Erasing uses backward shifting, there are no tombstones.
+/// References and iterators are invalidated by insertion and erasure (unlike std::unordered_map).
+template <typename Value>
+class FlatTileMap {
+public:
+    using key_type = tile::Id;
+    using mapped_type = Value;
+    using value_type = std::pair<tile::Id, Value>;
+
+private:
+    std::vector<value_type> m_slots;
+    std::vector<uint8_t> m_occupied;
+    size_t m_size = 0;
+
+    template <bool is_const>
+    class Iterator {
+        using Map = std::conditional_t<is_const, const FlatTileMap, FlatTileMap>;
+        Map* m_map = nullptr;
+        size_t m_index = 0;
+        friend class FlatTileMap;
+
+        void skip_empty()
+        {
+            while (m_index < m_map->m_slots.size() && !m_map->m_occupied[m_index])
+                ++m_index;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatTileMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<is_const, const value_type*, value_type*>;
+        using reference = std::conditional_t<is_const, const value_type&, value_type&>;
+
+        Iterator() = default;
+        Iterator(Map* map, size_t index)
+            : m_map(map)
+            , m_index(index)
+        {
+            skip_empty();
+        }
+        operator Iterator<true>() const { return { m_map, m_index }; }
+
+        reference operator*() const { return m_map->m_slots[m_index]; }
+        pointer operator->() const { return &m_map->m_slots[m_index]; }
+        Iterator& operator++()
+        {
+            ++m_index;
+            skip_empty();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+        bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+    };
+
+public:
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static uint64_t hash(const tile::Id& id)
+    {
+        const auto spread = [](uint64_t v) { // morton interleaving of 32 bits
+            v &= 0xffffffff;
+            v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+            v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+            v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+            v = (v | (v << 2)) & 0x3333333333333333ull;
+            v = (v | (v << 1)) & 0x5555555555555555ull;
+            return v;
+        };
+        const uint64_t x = id.coords.x;
+        const uint64_t y = id.coords.y;
+        // siblings share the parent, which is scrambled (fibonacci hashing) to avoid clustering of neighbouring regions
+        auto parent = (spread(x >> 1) | (spread(y >> 1) << 1)) ^ (uint64_t(id.zoom_level) << 59);
+        parent *= 0x9E3779B97F4A7C15ull;
+        parent ^= parent >> 31;
+        return (parent << 2) | (x & 1) | ((y & 1) << 1);
+    }
+
+    [[nodiscard]] size_t size() const { return m_size; }
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+
+    iterator begin() { return { this, 0 }; }
+    iterator end() { return { this, m_slots.size() }; }
+    const_iterator begin() const { return { this, 0 }; }
+    const_iterator end() const { return { this, m_slots.size() }; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    iterator find(const tile::Id& id) { return { this, find_index(id) }; }
+    const_iterator find(const tile::Id& id) const { return { this, find_index(id) }; }
+    [[nodiscard]] bool contains(const tile::Id& id) const { return find_index(id) != m_slots.size(); }
+
+    Value& at(const tile::Id& id)
+    {
+        const auto index = find_index(id);
+        if (index == m_slots.size())
+            throw std::out_of_range("FlatTileMap::at: id not found");
+        return m_slots[index].second;
+    }
+    const Value& at(const tile::Id& id) const { return const_cast<FlatTileMap*>(this)->at(id); }
+
+    Value& operator[](const tile::Id& id)
+    {
+        const auto found = find_index(id);
+        if (found != m_slots.size())
+            return m_slots[found].second;
+        if ((m_size + 1) * 2 > m_slots.size())
+            rehash(std::max<size_t>(16, m_slots.size() * 2));
+        auto index = hash(id) & mask();
+        while (m_occupied[index])
+            index = (index + 1) & mask();
+        m_occupied[index] = 1;
+        m_slots[index].first = id;
+        ++m_size;
+        return m_slots[index].second;
+    }
+
+    size_t erase(const tile::Id& id)
+    {
+        auto hole = find_index(id);
+        if (hole == m_slots.size())
+            return 0;
+        // backward shift: move entries of the probe sequence into the hole, if their home slot allows it
+        for (auto j = (hole + 1) & mask(); m_occupied[j]; j = (j + 1) & mask()) {
+            const auto home = hash(m_slots[j].first) & mask();
+            const auto home_in_range = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+            if (home_in_range)
+                continue;
+            m_slots[hole] = std::move(m_slots[j]);
+            hole = j;
+        }
+        m_slots[hole] = {}; // release the value right away
+        m_occupied[hole] = 0;
+        --m_size;
+        return 1;
+    }
+
+    void clear()
+    {
+        m_slots.clear();
+        m_occupied.clear();
+        m_size = 0;
+    }
+
+    /// like clear, but the slots are kept, so refilling the map to the same size doesn't allocate
+    void clear_retaining_storage()
+    {
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            if (m_occupied[i])
+                m_slots[i] = {};
+        }
+        std::fill(m_occupied.begin(), m_occupied.end(), uint8_t(0));
+        m_size = 0;
+    }
+
+    void reserve(size_t n)
+    {
+        size_t capacity = 16;
+        while (capacity < n * 2)
+            capacity *= 2;
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+private:
+    [[nodiscard]] size_t mask() const { return m_slots.size() - 1; }
+
+    [[nodiscard]] size_t find_index(const tile::Id& id) const
+    {
+        if (m_slots.empty())
+            return 0;
+        for (auto index = hash(id) & mask(); m_occupied[index]; index = (index + 1) & mask()) {
+            if (m_slots[index].first == id)
+                return index;
+        }
+        return m_slots.size();
+    }
+
+    void rehash(size_t capacity)
+    {
+        assert((capacity & (capacity - 1)) == 0);
+        auto old_slots = std::exchange(m_slots, std::vector<value_type>(capacity));
+        auto old_occupied = std::exchange(m_occupied, std::vector<uint8_t>(capacity, 0));
+        m_size = 0;
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (old_occupied[i])
+                (*this)[old_slots[i].first] = std::move(old_slots[i].second);
+        }
+    }
+};
+
+} // namespace nucleus::tile_scheduler
@@ -0,0 +1,196 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "HeightBoundsTable.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "radix/TileHeights.h"
+
+namespace nucleus::tile_scheduler {
+
+namespace {
+    QString cache_file_path()
+    {
+        const auto directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        QDir().mkpath(directory);
+        return directory + "/height_bounds.bin";
+    }
+
+    constexpr size_t padded(size_t n_bytes) { return (n_bytes + 3) & ~size_t(3); }
+
+    struct Bounds {
+        glm::uvec2 min = glm::uvec2(std::numeric_limits<unsigned>::max());
+        glm::uvec2 max = glm::uvec2(0);
+    };
+} // namespace
+
+HeightBoundsTable::HeightBoundsTable(QByteArray data)
+    : m_bytes(std::move(data))
+{
+}
+
+HeightBoundsTable HeightBoundsTable::build(const TileHeights& heights, const QByteArray& key)
+{
+    // TileHeights can only be queried, and a query of a tile that is not stored returns its ancestor. so the quad tree is walked
+    // from the root, and the children of a tile are visited if the tile differs from its parent (is stored). a stored tile
+    // that happens to have the range of its parent cuts its subtree off, the coarser range is used there then (conservative).
+    std::vector<Bounds> level_bounds;
+    float min_height = std::numeric_limits<float>::max();
+    float max_height = std::numeric_limits<float>::lowest();
+    std::vector<std::pair<tile::Id, std::pair<float, float>>> stack = { { tile::Id { 0, { 0, 0 } }, heights.query({ 0, { 0, 0 } }) } };
+    while (!stack.empty()) {
+        const auto [id, range] = stack.back();
+        stack.pop_back();
+        if (level_bounds.size() <= id.zoom_level)
+            level_bounds.resize(id.zoom_level + 1);
+        auto& bounds = level_bounds[id.zoom_level];
+        bounds.min = glm::min(bounds.min, id.coords);
+        bounds.max = glm::max(bounds.max, id.coords);
+        min_height = std::min(min_height, range.first);
+        max_height = std::max(max_height, range.second);
+        if (id.zoom_level >= 30)
+            continue;
+        for (const auto& child : id.children()) {
+            const auto child_range = heights.query({ child.zoom_level, child.coords });
+            if (child_range != range)
+                stack.emplace_back(tile::Id { child.zoom_level, child.coords }, child_range);
+        }
+    }
+
+    std::vector<Level> levels;
+    uint64_t n_entries = 0;
+    for (unsigned zoom_level = 0; zoom_level < level_bounds.size(); ++zoom_level) {
+        const auto& bounds = level_bounds[zoom_level];
+        const auto extent = std::max(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y) + 1;
+        const auto extent_log2 = unsigned(std::bit_width(std::bit_ceil(extent)) - 1);
+        const auto n_level_entries = uint64_t(1) << (2 * extent_log2);
+        if (n_level_entries > max_level_entries)
+            break;
+        levels.push_back({ bounds.min.x, bounds.min.y, extent_log2, uint32_t(n_entries) });
+        n_entries += n_level_entries;
+    }
+
+    const float height_offset = std::floor(min_height);
+    const float height_step = std::max((std::ceil(max_height) - height_offset) / 65535.0f, 1.0f / 1024.0f);
+    const auto quantise = [&](std::pair<float, float> range) {
+        const auto min = std::clamp(std::floor((range.first - height_offset) / height_step), 0.0f, 65535.0f);
+        const auto max = std::clamp(std::ceil((range.second - height_offset) / height_step), 0.0f, 65535.0f);
+        return uint32_t(min) | (uint32_t(max) << 16);
+    };
+
+    const auto key_offset = sizeof(Header);
+    const auto levels_offset = key_offset + padded(size_t(key.size()));
+    const auto entries_offset = levels_offset + levels.size() * sizeof(Level);
+    QByteArray data(qsizetype(entries_offset + n_entries * sizeof(uint32_t)), Qt::Uninitialized);
+    const Header header { magic, format_version, uint32_t(levels.size()), uint32_t(n_entries), height_offset, height_step, uint32_t(key.size()), 0 };
+    std::memcpy(data.data(), &header, sizeof(Header));
+    std::memset(data.data() + key_offset, 0, levels_offset - key_offset);
+    std::memcpy(data.data() + key_offset, key.constData(), size_t(key.size()));
+    std::memcpy(data.data() + levels_offset, levels.data(), levels.size() * sizeof(Level));
+
+    auto* entries = reinterpret_cast<uint32_t*>(data.data() + entries_offset);
+    for (unsigned zoom_level = 0; zoom_level < levels.size(); ++zoom_level) {
+        const auto& level = levels[zoom_level];
+        const auto extent = 1u << level.extent_log2;
+        const auto last = unsigned((uint64_t(1) << zoom_level) - 1); // the square can reach past the edge of the map
+        for (unsigned y = 0; y < extent; ++y) {
+            for (unsigned x = 0; x < extent; ++x) {
+                const auto coords = glm::uvec2(std::min(level.x0 + x, last), std::min(level.y0 + y, last));
+                entries[level.first_entry + morton(x, y)] = quantise(heights.query({ zoom_level, coords }));
+            }
+        }
+    }
+
+    HeightBoundsTable table(std::move(data));
+    [[maybe_unused]] const auto valid = table.bind(key);
+    assert(valid);
+    return table;
+}
+
+std::optional<HeightBoundsTable> HeightBoundsTable::from_bytes(QByteArray data, const QByteArray& key)
+{
+    HeightBoundsTable table(std::move(data));
+    if (!table.bind(key))
+        return {};
+    return table;
+}
+
+bool HeightBoundsTable::bind(const QByteArray& key)
+{
+    const auto size = size_t(m_bytes.size());
+    if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(m_bytes.constData()) % alignof(Header) != 0)
+        return false;
+    Header header;
+    std::memcpy(&header, m_bytes.constData(), sizeof(Header));
+    if (header.magic != magic || header.version != format_version || header.n_levels == 0 || header.n_levels > 31)
+        return false;
+    const auto levels_offset = sizeof(Header) + padded(header.key_size);
+    const auto entries_offset = levels_offset + header.n_levels * sizeof(Level);
+    if (header.key_size != size_t(key.size()) || entries_offset + uint64_t(header.n_entries) * sizeof(uint32_t) != size)
+        return false;
+    if (std::memcmp(m_bytes.constData() + sizeof(Header), key.constData(), size_t(key.size())) != 0)
+        return false;
+
+    const auto* levels = reinterpret_cast<const Level*>(m_bytes.constData() + levels_offset);
+    for (unsigned i = 0; i < header.n_levels; ++i) {
+        if (levels[i].extent_log2 > 16 || uint64_t(levels[i].first_entry) + (uint64_t(1) << (2 * levels[i].extent_log2)) > header.n_entries)
+            return false;
+    }
+    m_levels = levels;
+    m_entries = reinterpret_cast<const uint32_t*>(m_bytes.constData() + entries_offset);
+    m_n_levels = header.n_levels;
+    m_height_offset = header.height_offset;
+    m_height_step = header.height_step;
+    return true;
+}
+
+HeightBoundsTable HeightBoundsTable::load_or_build(const QByteArray& tile_heights_file)
+{
+    const auto key = QCryptographicHash::hash(tile_heights_file, QCryptographicHash::Sha1);
+    auto file = std::make_shared<QFile>(cache_file_path());
+    if (file->open(QIODevice::ReadOnly)) {
+        if (const auto* mapping = file->map(0, file->size())) {
+            if (auto table = from_bytes(QByteArray::fromRawData(reinterpret_cast<const char*>(mapping), qsizetype(file->size())), key)) {
+                table->m_mapped_file = std::move(file);
+                return std::move(*table);
+            }
+        }
+        qDebug() << "height bounds table is outdated or broken, building it again";
+    }
+    file.reset();
+
+    auto table = build(TileHeights::deserialise(tile_heights_file), key);
+    QSaveFile save_file(cache_file_path()); // replaced atomically, a crash doesn't leave a partial file
+    if (!save_file.open(QIODevice::WriteOnly) || save_file.write(table.bytes()) < 0 || !save_file.commit())
+        qDebug() << "couldn't write the height bounds table to" << cache_file_path();
+    return table;
+}
+
+} // namespace nucleus::tile_scheduler
@@ -0,0 +1,136 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <QByteArray>
+
+#include "radix/tile.h"
+
+class QFile;
+class TileHeights;
+
+namespace nucleus::tile_scheduler {
+
+/// The precomputed height range of the tiles (radix TileHeights) as one flat buffer, which is used as is when it is read from
+/// a memory mapped file (no deserialisation). Per zoom level, there is a dense grid over the bounding square of the stored
+/// tiles, in morton order, so that a lookup is an index computation and siblings are neighbours in memory. A tile outside
+/// the square of its level (or finer than the last level) uses its closest ancestor that is inside, which is conservative.
+/// Heights are quantised to 16 bit, min rounded down and max rounded up.
+/// The buffer is a header, the level descriptors and the entries, all 32 bit and in native byte order.
+class HeightBoundsTable {
+public:
+    static constexpr uint32_t format_version = 1;
+    // levels whose grid would be larger are left out (16 MiB), their tiles use the coarser levels
+    static constexpr uint64_t max_level_entries = uint64_t(1) << 22;
+
+    HeightBoundsTable() = default;
+
+    /// key identifies the source data (e.g., a hash of the TileHeights file) and is stored in the buffer, see from_bytes
+    [[nodiscard]] static HeightBoundsTable build(const TileHeights& heights, const QByteArray& key = {});
+    /// uses data without copying (e.g., QByteArray::fromRawData of a mapping). nullopt if the data is broken, or made for another key.
+    [[nodiscard]] static std::optional<HeightBoundsTable> from_bytes(QByteArray data, const QByteArray& key = {});
+    /// the table of the TileHeights file, from a memory mapped copy in QStandardPaths::CacheLocation. it is built (and written
+    /// there) if that is missing, or made from other data. failures are reported with qDebug.
+    [[nodiscard]] static HeightBoundsTable load_or_build(const QByteArray& tile_heights_file);
+
+    /// min and max height of the tile, or of its closest ancestor in the table
+    [[nodiscard]] std::pair<float, float> query(const tile::Id& id) const
+    {
+        assert(!empty());
+        const auto level = query_level(id);
+        const auto entry = m_entries[level.first_entry + morton(level.x, level.y)];
+        return { m_height_offset + float(entry & 0xffff) * m_height_step, m_height_offset + float(entry >> 16) * m_height_step };
+    }
+
+    [[nodiscard]] bool empty() const { return m_n_levels == 0; }
+    [[nodiscard]] unsigned n_levels() const { return m_n_levels; }
+    [[nodiscard]] const QByteArray& bytes() const { return m_bytes; }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t n_levels;
+        uint32_t n_entries;
+        float height_offset;
+        float height_step;
+        uint32_t key_size;
+        uint32_t reserved;
+    };
+    struct Level {
+        uint32_t x0;
+        uint32_t y0;
+        uint32_t extent_log2; // the grid covers 2^extent_log2 tiles in both directions
+        uint32_t first_entry;
+    };
+    struct LevelCoords {
+        uint32_t first_entry;
+        uint32_t x;
+        uint32_t y;
+    };
+    static constexpr uint32_t magic = 0x48504c41; // "ALPH"
+
+    explicit HeightBoundsTable(QByteArray data);
+    [[nodiscard]] bool bind(const QByteArray& key); // sets the pointers into m_bytes, false if the data is broken
+
+    [[nodiscard]] LevelCoords query_level(const tile::Id& id) const
+    {
+        unsigned zoom_level = std::min(id.zoom_level, m_n_levels - 1);
+        glm::uvec2 coords = id.coords >> (id.zoom_level - zoom_level);
+        // the squares of the finer levels are inside the coarser ones, usually the first one matches
+        for (;; --zoom_level, coords >>= 1u) {
+            const auto& level = m_levels[zoom_level];
+            const auto x = coords.x - level.x0; // wraps around when left of the square
+            const auto y = coords.y - level.y0;
+            if ((x >> level.extent_log2) == 0 && (y >> level.extent_log2) == 0)
+                return { level.first_entry, x, y };
+            if (zoom_level == 0)
+                return { level.first_entry, 0, 0 };
+        }
+    }
+    static uint32_t morton(uint32_t x, uint32_t y)
+    {
+        const auto spread = [](uint32_t v) { // same interleaving as FlatTileMap::hash, 16 bit per coordinate are enough here
+            v &= 0xffff;
+            v = (v | (v << 8)) & 0x00ff00ffu;
+            v = (v | (v << 4)) & 0x0f0f0f0fu;
+            v = (v | (v << 2)) & 0x33333333u;
+            v = (v | (v << 1)) & 0x55555555u;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1);
+    }
+
+    QByteArray m_bytes;
+    std::shared_ptr<QFile> m_mapped_file; // keeps the mapping alive, if m_bytes is a view into it
+    const Level* m_levels = nullptr;
+    const uint32_t* m_entries = nullptr; // min in the lower, max in the upper 16 bit
+    unsigned m_n_levels = 0;
+    float m_height_offset = 0;
+    float m_height_step = 1;
+};
+
+} // namespace nucleus::tile_scheduler
@@ -0,0 +1,194 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "HorizonOcclusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "nucleus/srs.h"
+
+using nucleus::tile_scheduler::HorizonOcclusion;
+
+namespace {
+constexpr double pi = 3.1415926535897932384626433;
+constexpr double sector_width = 2 * pi / HorizonOcclusion::n_sectors;
+// occluders are tiles that are small compared to their distance, so that they cover a few sectors entirely
+constexpr double max_relative_occluder_size = 0.25;
+constexpr unsigned max_occluder_zoom_level = 18;
+
+unsigned wrap_sector(int sector)
+{
+    const auto n = int(HorizonOcclusion::n_sectors);
+    return unsigned(((sector % n) + n) % n);
+}
+} // namespace
+
+void HorizonOcclusion::build(const glm::dvec3& camera_position, const HeightBoundsTable& heights)
+{
+    m_camera_position = camera_position;
+    m_horizon.assign(size_t(n_rings) * n_sectors, -std::numeric_limits<float>::infinity());
+    m_n_occluders = 0;
+    if (heights.empty())
+        return;
+
+    const auto camera = glm::dvec2(camera_position);
+    const auto max_distance = ring_distance(n_rings - 1);
+    std::vector<tile::Id> stack = { tile::Id { 0, { 0, 0 } } };
+    while (!stack.empty()) {
+        const auto id = stack.back();
+        stack.pop_back();
+        const auto bounds = srs::tile_bounds(id);
+        const auto min = bounds.min - camera;
+        const auto max = bounds.max - camera;
+        const auto near_distance = glm::length(glm::clamp(glm::dvec2(0.0), min, max));
+        if (near_distance > max_distance)
+            continue;
+        const auto centre = (min + max) * 0.5;
+        const auto size = max.x - min.x;
+        if (near_distance > 0 && size <= glm::length(centre) * max_relative_occluder_size) {
+            const auto floor = heights.query(id).first;
+            // world space altitudes are scaled by 1/cos(latitude), the unscaled one is a lower bound above sea level
+            if (floor >= 0)
+                add_occluder(centre, size * 0.5, std::max(0.0f, floor - 0.5f));
+            continue;
+        }
+        if (id.zoom_level >= max_occluder_zoom_level)
+            continue; // too close to the camera
+        for (const auto& child : id.children())
+            stack.push_back(child);
+    }
+
+    // a box behind ring k is also behind the occluders of the nearer rings
+    for (unsigned ring = 1; ring < n_rings; ++ring) {
+        for (unsigned sector = 0; sector < n_sectors; ++sector) {
+            auto& h = m_horizon[size_t(ring) * n_sectors + sector];
+            h = std::max(h, m_horizon[size_t(ring - 1) * n_sectors + sector]);
+        }
+    }
+}
+
+void HorizonOcclusion::add_occluder(const glm::dvec2& centre, double half_size, float floor)
+{
+    // the disk inscribed into the tile is the occluder. a ray at an angle phi from the centre crosses it over a chord, the
+    // interval [a, b] of horizontal distances is crossed by all rays of a sector. a ray is blocked, if it is below the floor
+    // somewhere in there, i.e., if its slope is below (floor - camera height) / distance, at a (floor above the camera) or b.
+    const auto distance = glm::length(centre);
+    const auto centre_angle = std::atan2(centre.y, centre.x);
+    const auto half_angle = std::asin(std::min(1.0, half_size / distance));
+    const auto first = int(std::ceil((centre_angle - half_angle + pi) / sector_width));
+    const auto last = int(std::floor((centre_angle + half_angle + pi) / sector_width)) - 1;
+    const auto height = double(floor) - m_camera_position.z;
+    bool added = false;
+    for (int s = first; s <= last; ++s) {
+        const auto edge = double(s) * sector_width - pi;
+        const auto phi = std::max(std::abs(edge - centre_angle), std::abs(edge + sector_width - centre_angle));
+        const auto offset = distance * std::sin(phi);
+        const auto half_chord = std::sqrt(std::max(0.0, half_size * half_size - offset * offset));
+        const auto a = distance - half_chord;
+        const auto b = distance * std::cos(phi) + half_chord;
+        if (a >= b)
+            continue;
+        auto ring = unsigned(std::max(0.0, std::ceil(2.0 * std::log2(b / first_ring_distance))));
+        while (ring < n_rings && ring_distance(ring) < b)
+            ++ring;
+        if (ring >= n_rings)
+            continue;
+        auto& h = m_horizon[size_t(ring) * n_sectors + wrap_sector(s)];
+        h = std::max(h, float(height / (height > 0 ? a : b)));
+        added = true;
+    }
+    m_n_occluders += added ? 1 : 0;
+}
+
+void HorizonOcclusion::clear()
+{
+    m_horizon.clear();
+    m_n_occluders = 0;
+}
+
+bool HorizonOcclusion::empty() const
+{
+    return m_horizon.empty();
+}
+
+const glm::dvec3& HorizonOcclusion::camera_position() const
+{
+    return m_camera_position;
+}
+
+double HorizonOcclusion::ring_distance(unsigned ring)
+{
+    return first_ring_distance * std::exp2(ring * 0.5);
+}
+
+float HorizonOcclusion::horizon(unsigned sector, unsigned ring) const
+{
+    return m_horizon.at(size_t(ring) * n_sectors + sector);
+}
+
+unsigned HorizonOcclusion::n_occluders() const
+{
+    return m_n_occluders;
+}
+
+bool HorizonOcclusion::occludes(const tile::SrsAndHeightBounds& aabb) const
+{
+    if (empty())
+        return false;
+    const auto camera = glm::dvec2(m_camera_position);
+    const auto min = glm::dvec2(aabb.min) - camera;
+    const auto max = glm::dvec2(aabb.max) - camera;
+    const auto near_distance = glm::length(glm::clamp(glm::dvec2(0.0), min, max));
+    if (near_distance < first_ring_distance)
+        return false;
+    auto ring = unsigned(std::min(double(n_rings - 1), std::floor(2.0 * std::log2(near_distance / first_ring_distance))));
+    while (ring > 0 && ring_distance(ring) > near_distance)
+        --ring;
+    if (ring_distance(ring) > near_distance)
+        return false;
+
+    // the steepest ray from the camera to a point of the box
+    const auto far_distance = glm::length(glm::max(glm::abs(min), glm::abs(max)));
+    const auto height = aabb.max.z - m_camera_position.z;
+    const auto slope = float(height / (height > 0 ? near_distance : far_distance));
+
+    // the box doesn't contain the camera, so its corners span less than half of the circle around the centre direction
+    const auto centre = (min + max) * 0.5;
+    const auto centre_angle = std::atan2(centre.y, centre.x);
+    auto min_angle = std::numeric_limits<double>::max();
+    auto max_angle = std::numeric_limits<double>::lowest();
+    for (const auto& corner : { min, max, glm::dvec2(min.x, max.y), glm::dvec2(max.x, min.y) }) {
+        auto angle = std::atan2(corner.y, corner.x) - centre_angle;
+        if (angle > pi)
+            angle -= 2 * pi;
+        else if (angle < -pi)
+            angle += 2 * pi;
+        min_angle = std::min(min_angle, angle);
+        max_angle = std::max(max_angle, angle);
+    }
+    const auto first = int(std::floor((centre_angle + min_angle + pi) / sector_width));
+    const auto last = int(std::floor((centre_angle + max_angle + pi) / sector_width));
+    const auto* horizon = m_horizon.data() + size_t(ring) * n_sectors;
+    for (int s = first; s <= last; ++s) {
+        if (!(slope < horizon[wrap_sector(s)]))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "HeightBoundsTable.h"
+#include "radix/tile.h"
+
+namespace nucleus::tile_scheduler {
+
+/// The horizon of the terrain around a camera, used to skip tiles that are hidden behind it (e.g., the valleys behind the
+/// ridge in front of a camera near the ground). The terrain is drawn flat in web mercator, so there is no curvature of the
+/// earth to hide behind. Instead, the lower bound of the precomputed height range of the tiles around the camera is the
+/// occluder: the terrain can't be lower than that anywhere in the tile, also not in finer tiles.
+/// The horizon is stored in camera relative space, as the largest elevation slope (height over horizontal distance) of the
+/// occluders per sector of the azimuth and per distance ring. A box is hidden if it is below the horizon of all the sectors it
+/// spans, in the ring of occluders that are entirely in front of it. The test is conservative.
+class HorizonOcclusion {
+public:
+    static constexpr unsigned n_sectors = 256;
+    static constexpr unsigned n_rings = 24; // ring k ends at ring_distance(k), the distances grow by sqrt(2)
+    static constexpr double first_ring_distance = 50.0;
+
+    /// the storage is kept between builds
+    void build(const glm::dvec3& camera_position, const HeightBoundsTable& heights);
+    void clear();
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] const glm::dvec3& camera_position() const;
+    [[nodiscard]] static double ring_distance(unsigned ring);
+    /// elevation slope of the horizon of a sector, for boxes that are further away than ring_distance(ring)
+    [[nodiscard]] float horizon(unsigned sector, unsigned ring) const;
+    [[nodiscard]] unsigned n_occluders() const;
+
+    /// the box must contain the terrain of the tile and its descendants (see utils::AabbDecorator::subtree_aabb)
+    [[nodiscard]] bool occludes(const tile::SrsAndHeightBounds& aabb) const;
+
+private:
+    void add_occluder(const glm::dvec2& centre, double half_size, float floor);
+
+    glm::dvec3 m_camera_position = {};
+    std::vector<float> m_horizon; // n_rings * n_sectors, ring major
+    unsigned m_n_occluders = 0;
+};
+
+} // namespace nucleus::tile_scheduler
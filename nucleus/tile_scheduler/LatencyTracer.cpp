@@ -0,0 +1,222 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "LatencyTracer.h"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+namespace nucleus::tile_scheduler {
+
+namespace {
+    // traces that didn't finish within this time are dropped once the map is full (the quad was never drawn, or cancelled)
+    constexpr auto stale_trace_age = std::chrono::seconds(60);
+} // namespace
+
+LatencyTracer::LatencyTracer(unsigned n_samples_per_stage, unsigned max_traces)
+    : m_n_samples(std::max(n_samples_per_stage, 1u))
+    , m_max_traces(max_traces)
+{
+}
+
+void LatencyTracer::set_enabled(bool enabled)
+{
+    m_enabled = enabled;
+    if (!enabled) {
+        std::scoped_lock lock(m_mutex);
+        m_traces.clear();
+    }
+}
+
+bool LatencyTracer::enabled() const { return m_enabled; }
+
+void LatencyTracer::mark(const tile::Id& quad_id, Stage stage) { mark(quad_id, stage, Clock::now()); }
+
+void LatencyTracer::mark(const tile::Id& quad_id, Stage stage, Clock::time_point time)
+{
+    if (!m_enabled)
+        return;
+    std::scoped_lock lock(m_mutex);
+    mark_locked(quad_id, stage, time);
+}
+
+void LatencyTracer::mark(std::span<const tile::Id> quad_ids, Stage stage)
+{
+    if (!m_enabled || quad_ids.empty())
+        return;
+    const auto now = Clock::now();
+    std::scoped_lock lock(m_mutex);
+    for (const auto& id : quad_ids)
+        mark_locked(id, stage, now);
+}
+
+void LatencyTracer::mark_tile(const tile::Id& tile_id, Stage stage)
+{
+    if (tile_id.zoom_level == 0)
+        return; // not part of a quad
+    mark(tile_id.parent(), stage);
+}
+
+void LatencyTracer::mark_locked(const tile::Id& quad_id, Stage stage, Clock::time_point time)
+{
+    if (stage == Stage::Requested) {
+        if (m_traces.size() >= m_max_traces)
+            prune(time);
+        const auto [it, inserted] = m_traces.try_emplace(quad_id);
+        if (!inserted)
+            return; // requested again (e.g., reprioritised), the first request counts
+        it->second.stamps[0] = time;
+        it->second.marked[0] = true;
+        return;
+    }
+    const auto it = m_traces.find(quad_id);
+    if (it == m_traces.end())
+        return; // not traced, e.g., from the disk cache or requested before tracing was enabled
+    auto& trace = it->second;
+    trace.stamps[unsigned(stage)] = time; // the last tile of the quad counts
+    trace.marked[unsigned(stage)] = true;
+    if (stage == Stage::Drawn) {
+        finish(trace);
+        m_traces.erase(it);
+    }
+}
+
+void LatencyTracer::finish(const Trace& trace)
+{
+    const auto msecs = [](Clock::time_point from, Clock::time_point to) {
+        return std::max(0.f, std::chrono::duration<float, std::milli>(to - from).count());
+    };
+    auto previous = trace.stamps[0];
+    for (unsigned s = 1; s < n_stages; ++s) {
+        if (!trace.marked[s])
+            continue;
+        add_sample(m_stage_samples[s], msecs(previous, trace.stamps[s]));
+        previous = std::max(previous, trace.stamps[s]);
+    }
+    add_sample(m_total_samples, msecs(trace.stamps[0], trace.stamps[unsigned(Stage::Drawn)]));
+    ++m_n_finished;
+}
+
+void LatencyTracer::add_sample(Samples& samples, float msecs)
+{
+    if (samples.values.size() < m_n_samples) {
+        samples.values.push_back(msecs);
+        return;
+    }
+    samples.values[samples.next] = msecs;
+    samples.next = (samples.next + 1) % m_n_samples;
+}
+
+void LatencyTracer::prune(Clock::time_point now)
+{
+    std::erase_if(m_traces, [now](const auto& entry) { return now - entry.second.stamps[0] > stale_trace_age; });
+    if (m_traces.size() >= m_max_traces)
+        m_traces.clear(); // a burst of requests that are all recent, start over rather than growing without bound
+}
+
+LatencyTracer::Percentiles LatencyTracer::percentiles(const Samples& samples)
+{
+    if (samples.values.empty())
+        return {};
+    auto values = samples.values;
+    const auto at = [&values](float percentile) {
+        const auto index = std::min(values.size() - 1, size_t(percentile * float(values.size())));
+        std::nth_element(values.begin(), values.begin() + ptrdiff_t(index), values.end());
+        return values[index];
+    };
+    return { at(0.50f), at(0.95f), at(0.99f), unsigned(values.size()) };
+}
+
+LatencyTracer::Report LatencyTracer::report() const
+{
+    std::scoped_lock lock(m_mutex);
+    Report report;
+    for (unsigned s = 0; s < n_stages; ++s)
+        report.stages[s] = percentiles(m_stage_samples[s]);
+    report.total = percentiles(m_total_samples);
+    return report;
+}
+
+size_t LatencyTracer::n_traces() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_traces.size();
+}
+
+uint64_t LatencyTracer::n_finished() const { return m_n_finished; }
+
+void LatencyTracer::clear()
+{
+    std::scoped_lock lock(m_mutex);
+    m_traces.clear();
+    m_stage_samples = {};
+    m_total_samples = {};
+    ++m_n_finished;
+}
+
+const char* LatencyTracer::stage_name(Stage stage)
+{
+    switch (stage) {
+    case Stage::Requested:
+        return "requested";
+    case Stage::SlotReleased:
+        return "slot limiter";
+    case Stage::RateReleased:
+        return "rate limiter";
+    case Stage::NetworkSent:
+        return "sent";
+    case Stage::FirstByte:
+        return "first byte";
+    case Stage::NetworkFinished:
+        return "download";
+    case Stage::LayersAssembled:
+        return "layer assembly";
+    case Stage::QuadAssembled:
+        return "quad assembly";
+    case Stage::Received:
+        return "received";
+    case Stage::Decoded:
+        return "decoded";
+    case Stage::Uploaded:
+        return "uploaded";
+    case Stage::Drawn:
+        return "drawn";
+    }
+    return "";
+}
+
+std::string LatencyTracer::format(const Report& report)
+{
+    std::string text;
+    const auto line = [&text](const char* name, const Percentiles& p) {
+        if (p.n_samples == 0)
+            return;
+        if (!text.empty())
+            text += '\n';
+        text += fmt::format("{:<15} {:>7.1f} {:>7.1f} {:>7.1f} ms", name, p.p50, p.p95, p.p99);
+    };
+    for (unsigned s = 1; s < n_stages; ++s)
+        line(stage_name(Stage(s)), report.stages[s]);
+    line("total", report.total);
+    if (text.empty())
+        return text;
+    return fmt::format("{:<15} {:>7} {:>7} {:>7}\n", "stage", "p50", "p95", "p99") + text;
+}
+
+} // namespace nucleus::tile_scheduler
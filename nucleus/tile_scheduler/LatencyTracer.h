@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <radix/tile.h>
+
+namespace nucleus::tile_scheduler {
+
+/// Follows quad requests through the loading chain and the renderer, and aggregates the time spent between the stages into
+/// percentiles, e.g., to tell whether the network, the decoding or the uploads are slow.
+/// A trace starts with Requested and ends with the first draw. Stages of single tiles (network, layer assembly, uploads) are
+/// attributed to their quad, the last tile of the quad counts. Stages that a quad skipped (e.g., everything before Received
+/// for quads from the disk cache, which are not traced at all) are left out, the time is attributed to the next stage.
+/// Thread safe, the stages are marked on the scheduler, network and render threads. Off by default, it is turned on while the
+/// report is shown (stats window) or exported (metrics server).
+class LatencyTracer {
+public:
+    using Clock = std::chrono::steady_clock;
+    enum class Stage : unsigned {
+        Requested, // Scheduler::send_quad_requests
+        SlotReleased, // SlotLimiter
+        RateReleased, // RateLimiter
+        NetworkSent, // LayerAssembler -> TileLoadService
+        FirstByte, // response headers received
+        NetworkFinished,
+        LayersAssembled, // LayerAssembler
+        QuadAssembled, // QuadAssembler
+        Received, // Scheduler::receive_quads
+        Decoded, // Scheduler::to_gpu_quad
+        Uploaded, // gl_engine::TileManager, resident on the gpu
+        Drawn, // first frame that drew a tile of the quad
+    };
+    static constexpr unsigned n_stages = unsigned(Stage::Drawn) + 1;
+
+    struct Percentiles {
+        float p50 = 0; // msecs
+        float p95 = 0;
+        float p99 = 0;
+        unsigned n_samples = 0;
+    };
+    struct Report {
+        // stages[s] is the time from the previous stage of the trace to s. stages[Requested] stays empty.
+        std::array<Percentiles, n_stages> stages = {};
+        Percentiles total; // requested to drawn
+    };
+
+    explicit LatencyTracer(unsigned n_samples_per_stage = 512, unsigned max_traces = 8192);
+
+    // disabled by default, marking takes a mutex. disabling drops the running traces.
+    void set_enabled(bool enabled);
+    [[nodiscard]] bool enabled() const;
+
+    void mark(const tile::Id& quad_id, Stage stage);
+    void mark(const tile::Id& quad_id, Stage stage, Clock::time_point time);
+    void mark(std::span<const tile::Id> quad_ids, Stage stage);
+    // attributes the stage to the quad of the tile
+    void mark_tile(const tile::Id& tile_id, Stage stage);
+
+    [[nodiscard]] Report report() const;
+    [[nodiscard]] size_t n_traces() const; // running
+    [[nodiscard]] uint64_t n_finished() const; // since construction, changes whenever report() might have changed
+    void clear();
+
+    [[nodiscard]] static const char* stage_name(Stage stage);
+    // one line per stage with samples, e.g. for the debug gui
+    [[nodiscard]] static std::string format(const Report& report);
+
+private:
+    struct Trace {
+        std::array<Clock::time_point, n_stages> stamps = {};
+        std::array<bool, n_stages> marked = {};
+    };
+    struct Samples {
+        std::vector<float> values; // ring buffer
+        size_t next = 0;
+    };
+    void mark_locked(const tile::Id& quad_id, Stage stage, Clock::time_point time);
+    void finish(const Trace& trace);
+    void add_sample(Samples& samples, float msecs);
+    void prune(Clock::time_point now);
+    [[nodiscard]] static Percentiles percentiles(const Samples& samples);
+
+    const unsigned m_n_samples;
+    const unsigned m_max_traces;
+    std::atomic<bool> m_enabled = false;
+    std::atomic<uint64_t> m_n_finished = 0;
+    mutable std::mutex m_mutex;
+    std::unordered_map<tile::Id, Trace, tile::Id::Hasher> m_traces;
+    std::array<Samples, n_stages> m_stage_samples;
+    Samples m_total_samples;
+};
+using LatencyTracerPtr = std::shared_ptr<LatencyTracer>;
+
+} // namespace nucleus::tile_scheduler
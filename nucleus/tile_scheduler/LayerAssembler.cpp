@@ -27,7 +27,18 @@ LayerAssembler::LayerAssembler(QObject* parent)
 
 size_t LayerAssembler::n_items_in_flight() const
 {
-    return m_height_data.size() + m_ortho_data.size();
+    return m_height_data.size() + m_ortho_data.size() + m_label_data.size();
+}
+
+tile_types::LayeredTile LayerAssembler::join(const tile_types::TileLayer& ortho_tile, const tile_types::TileLayer& height_tile, const tile_types::TileLayer& label_tile)
+{
+    assert(ortho_tile.id == label_tile.id);
+    auto tile = join(ortho_tile, height_tile);
+    if (tile.network_info.status == tile_types::NetworkInfo::Status::Good && label_tile.network_info.status == tile_types::NetworkInfo::Status::Good && label_tile.data) {
+        tile.labels = label_tile.data;
+        tile.labels_validator = label_tile.validator;
+    }
+    return tile;
 }
 
 tile_types::LayeredTile LayerAssembler::join(const tile_types::TileLayer& ortho_tile, const tile_types::TileLayer& height_tile)
@@ -40,15 +51,46 @@ tile_types::LayeredTile LayerAssembler::join(const tile_types::TileLayer& ortho_
         return std::make_shared<QByteArray>();
     };
 
-    return {ortho_tile.id,
-            network_info,
-            data_filter(ortho_tile.data),
-            data_filter(height_tile.data)};
+    tile_types::LayeredTile tile { ortho_tile.id, network_info, data_filter(ortho_tile.data), data_filter(height_tile.data) };
+    if (network_info.status == tile_types::NetworkInfo::Status::Good) {
+        tile.ortho_validator = ortho_tile.validator;
+        tile.height_validator = height_tile.validator;
+    }
+    tile.ortho_inherited = ortho_tile.inherited;
+    tile.height_inherited = height_tile.inherited;
+    tile.ortho_source = ortho_tile.source;
+    return tile;
+}
+
+void LayerAssembler::set_layer_selector(LayerSelector selector)
+{
+    m_layer_selector = std::move(selector);
+}
+
+void LayerAssembler::set_label_zoom_range(unsigned min_zoom, unsigned max_zoom)
+{
+    m_label_min_zoom = min_zoom;
+    m_label_max_zoom = max_zoom;
 }
 
 void LayerAssembler::load(const tile::Id& tile_id)
 {
     emit tile_requested(tile_id);
+    const auto layers = m_layer_selector ? m_layer_selector(tile_id) : tile_types::LayerSelection {};
+    if (layers.ortho)
+        emit ortho_requested(tile_id);
+    if (layers.height)
+        emit height_requested(tile_id);
+    if (labels_enabled(tile_id))
+        emit labels_requested(tile_id);
+
+    const auto inherited_layer = [&tile_id]() {
+        return tile_types::TileLayer { tile_id, { tile_types::NetworkInfo::Status::Good, utils::time_since_epoch() }, std::make_shared<QByteArray>(), {}, true };
+    };
+    if (!layers.ortho)
+        deliver_ortho(inherited_layer());
+    if (!layers.height)
+        deliver_height(inherited_layer());
 }
 
 void LayerAssembler::deliver_ortho(const tile_types::TileLayer& tile)
@@ -63,11 +105,38 @@ void LayerAssembler::deliver_height(const tile_types::TileLayer& tile)
     check_and_emit(tile.id);
 }
 
+void LayerAssembler::deliver_labels(const tile_types::TileLayer& tile)
+{
+    m_label_data[tile.id] = tile;
+    check_and_emit(tile.id);
+}
+
+void LayerAssembler::cancel_tiles(const std::vector<tile::Id>& tile_ids)
+{
+    for (const auto& id : tile_ids) {
+        m_ortho_data.erase(id);
+        m_height_data.erase(id);
+        m_label_data.erase(id);
+    }
+    emit tiles_cancelled(tile_ids);
+}
+
+bool LayerAssembler::labels_enabled(const tile::Id& tile_id) const
+{
+    return tile_id.zoom_level >= m_label_min_zoom && tile_id.zoom_level <= m_label_max_zoom;
+}
+
 void LayerAssembler::check_and_emit(const tile::Id& tile_id)
 {
-    if (m_ortho_data.contains(tile_id) && m_height_data.contains(tile_id)) {
+    if (!m_ortho_data.contains(tile_id) || !m_height_data.contains(tile_id))
+        return;
+    if (!labels_enabled(tile_id))
         emit tile_loaded(join(m_ortho_data[tile_id], m_height_data[tile_id]));
-        m_ortho_data.erase(tile_id);
-        m_height_data.erase(tile_id);
-    }
+    else if (m_label_data.contains(tile_id))
+        emit tile_loaded(join(m_ortho_data[tile_id], m_height_data[tile_id], m_label_data[tile_id]));
+    else
+        return;
+    m_ortho_data.erase(tile_id);
+    m_height_data.erase(tile_id);
+    m_label_data.erase(tile_id);
 }
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <functional>
 #include <unordered_map>
 
 #include <QObject>
@@ -32,23 +33,48 @@ class LayerAssembler : public QObject {
 
     TileId2DataMap m_ortho_data;
     TileId2DataMap m_height_data;
+    TileId2DataMap m_label_data;
 
 public:
+    using LayerSelector = std::function<tile_types::LayerSelection(const tile::Id& tile_id)>;
+
     explicit LayerAssembler(QObject* parent = nullptr);
+    // layers that are not selected for a tile are not requested, they are delivered right away as inherited layers
+    // (e.g. Scheduler::layers_for_tile). all layers are loaded by default.
+    void set_layer_selector(LayerSelector selector);
+    // labels are requested for tiles with min_zoom <= zoom_level <= max_zoom, other tiles are emitted without labels.
+    // disabled by default (min_zoom > max_zoom).
+    void set_label_zoom_range(unsigned min_zoom, unsigned max_zoom);
     [[nodiscard]] size_t n_items_in_flight() const;
+    // a missing or broken label layer doesn't affect the network info of the tile, the tile just has no labels
+    static tile_types::LayeredTile join(const tile_types::TileLayer& ortho_tile, const tile_types::TileLayer& height_tile, const tile_types::TileLayer& label_tile);
     static tile_types::LayeredTile join(const tile_types::TileLayer& ortho_tile, const tile_types::TileLayer& height_tile);
 
 public slots:
     void load(const tile::Id& tile_id);
     void deliver_ortho(const tile_types::TileLayer& tile);
     void deliver_height(const tile_types::TileLayer& tile);
+    void deliver_labels(const tile_types::TileLayer& tile);
+    // forgets the layers that were delivered already and forwards the cancellation to the load services
+    void cancel_tiles(const std::vector<tile::Id>& tile_ids);
 
 signals:
+    // emitted for every load. ortho_requested / height_requested are emitted only for the selected layers, labels_requested
+    // only within the label zoom range.
     void tile_requested(const tile::Id& tile_id);
+    void ortho_requested(const tile::Id& tile_id);
+    void height_requested(const tile::Id& tile_id);
+    void labels_requested(const tile::Id& tile_id);
     void tile_loaded(const tile_types::LayeredTile& tile);
+    void tiles_cancelled(const std::vector<tile::Id>& tile_ids);
 
 private:
     void check_and_emit(const tile::Id& tile_id);
+    [[nodiscard]] bool labels_enabled(const tile::Id& tile_id) const;
+
+    LayerSelector m_layer_selector;
+    unsigned m_label_min_zoom = 1;
+    unsigned m_label_max_zoom = 0;
 };
 
 } // namespace nucleus::tile_scheduler
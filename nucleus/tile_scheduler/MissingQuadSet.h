@@ -0,0 +1,234 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <QFile>
+#include <fmt/format.h>
+#include <tl/expected.hpp>
+#include <zpp_bits.h>
+
+#include "radix/tile.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Quads that the server doesn't have (all four tiles not found, without any data), e.g., outside of the coverage area.
+/// Per zoom level, an interval set over the morton order of the quad coordinates: siblings and neighbouring regions
+/// merge into a few intervals, so a large missing area costs neither ram cache slots nor disk cache entries.
+/// Every interval keeps the oldest timestamp of its quads, so that it's retired (asked for again) as a whole.
+/// Not thread safe.
+class MissingQuadSet {
+public:
+    static constexpr std::array<char, 25> version_information = { "MissingQuadSet, vers. 1" };
+
+    struct Interval {
+        uint64_t last = 0; // morton code, inclusive
+        uint64_t timestamp = 0;
+    };
+    // one record per interval, for serialisation
+    struct Record {
+        unsigned zoom_level = 0;
+        uint64_t first = 0;
+        uint64_t last = 0;
+        uint64_t timestamp = 0;
+    };
+
+    static uint64_t morton(const glm::uvec2& coords)
+    {
+        const auto spread = [](uint64_t v) { // same interleaving as FlatTileMap::hash
+            v &= 0xffffffff;
+            v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+            v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+            v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+            v = (v | (v << 2)) & 0x3333333333333333ull;
+            v = (v | (v << 1)) & 0x5555555555555555ull;
+            return v;
+        };
+        return spread(coords.x) | (spread(coords.y) << 1);
+    }
+
+    [[nodiscard]] bool contains(const tile::Id& id) const
+    {
+        if (id.zoom_level >= m_levels.size())
+            return false;
+        const auto& level = m_levels[id.zoom_level];
+        const auto code = morton(id.coords);
+        auto it = level.upper_bound(code);
+        if (it == level.begin())
+            return false;
+        --it;
+        return code <= it->second.last;
+    }
+
+    /// returns false if it was already known
+    bool insert(const tile::Id& id, uint64_t timestamp)
+    {
+        if (contains(id))
+            return false;
+        if (id.zoom_level >= m_levels.size())
+            m_levels.resize(id.zoom_level + 1);
+        auto& level = m_levels[id.zoom_level];
+        const auto code = morton(id.coords);
+        auto next = level.upper_bound(code);
+        auto first = code;
+        Interval interval { code, timestamp };
+        if (next != level.begin()) {
+            const auto previous = std::prev(next);
+            if (previous->second.last + 1 == code) {
+                first = previous->first;
+                interval.timestamp = std::min(interval.timestamp, previous->second.timestamp);
+                level.erase(previous);
+            }
+        }
+        if (next != level.end() && next->first == code + 1) {
+            interval.last = next->second.last;
+            interval.timestamp = std::min(interval.timestamp, next->second.timestamp);
+            level.erase(next);
+        }
+        level[first] = interval;
+        ++m_n_quads;
+        return true;
+    }
+
+    /// e.g., when the quad was delivered after all. splits the interval. returns false if it wasn't in the set
+    bool erase(const tile::Id& id)
+    {
+        if (!contains(id))
+            return false;
+        auto& level = m_levels[id.zoom_level];
+        const auto code = morton(id.coords);
+        const auto it = std::prev(level.upper_bound(code));
+        const auto first = it->first;
+        const auto interval = it->second;
+        level.erase(it);
+        if (first < code)
+            level[first] = { code - 1, interval.timestamp };
+        if (code < interval.last)
+            level[code + 1] = { interval.last, interval.timestamp };
+        --m_n_quads;
+        return true;
+    }
+
+    /// removes the intervals that contain a quad older than the given timestamp, returns the number of removed quads
+    uint64_t retire(uint64_t older_than)
+    {
+        uint64_t n_removed = 0;
+        for (auto& level : m_levels) {
+            std::erase_if(level, [&](const auto& entry) {
+                if (entry.second.timestamp >= older_than)
+                    return false;
+                n_removed += entry.second.last - entry.first + 1;
+                return true;
+            });
+        }
+        m_n_quads -= n_removed;
+        return n_removed;
+    }
+
+    void clear()
+    {
+        m_levels.clear();
+        m_n_quads = 0;
+    }
+
+    [[nodiscard]] uint64_t n_quads() const { return m_n_quads; }
+    [[nodiscard]] size_t n_intervals() const
+    {
+        size_t n = 0;
+        for (const auto& level : m_levels)
+            n += level.size();
+        return n;
+    }
+    [[nodiscard]] bool empty() const { return m_n_quads == 0; }
+
+    [[nodiscard]] std::vector<Record> records() const
+    {
+        std::vector<Record> records;
+        records.reserve(n_intervals());
+        for (unsigned zoom_level = 0; zoom_level < m_levels.size(); ++zoom_level) {
+            for (const auto& [first, interval] : m_levels[zoom_level])
+                records.push_back({ zoom_level, first, interval.last, interval.timestamp });
+        }
+        return records;
+    }
+
+    void assign(const std::vector<Record>& records)
+    {
+        clear();
+        for (const auto& record : records) {
+            if (record.last < record.first)
+                continue;
+            if (record.zoom_level >= m_levels.size())
+                m_levels.resize(record.zoom_level + 1);
+            m_levels[record.zoom_level][record.first] = { record.last, record.timestamp };
+            m_n_quads += record.last - record.first + 1;
+        }
+    }
+
+    [[nodiscard]] tl::expected<void, std::string> write_to_file(const std::filesystem::path& path) const
+    {
+        std::vector<char> bytes;
+        zpp::bits::out out(bytes);
+        if (const auto r = out(version_information, records()); failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+        std::filesystem::create_directories(path.parent_path());
+        QFile file(path);
+        if (!file.open(QIODeviceBase::WriteOnly))
+            return tl::unexpected<std::string>(fmt::format("Couldn't open file '{}' for writing!", path.string()));
+        file.write(bytes.data(), qint64(bytes.size()));
+        return {};
+    }
+
+    /// a missing file is not an error, the set stays empty then
+    [[nodiscard]] tl::expected<void, std::string> read_from_file(const std::filesystem::path& path)
+    {
+        clear();
+        QFile file(path);
+        if (!file.exists())
+            return {};
+        if (!file.open(QIODeviceBase::ReadOnly))
+            return tl::unexpected<std::string>(fmt::format("Couldn't open file '{}' for reading!", path.string()));
+        const auto bytes = file.readAll();
+        zpp::bits::in in(std::span(bytes.data(), size_t(bytes.size())));
+        std::remove_cvref_t<decltype(version_information)> version = {};
+        std::vector<Record> records;
+        if (const auto r = in(version, records); failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+        if (version != version_information)
+            return tl::unexpected<std::string>(fmt::format("File '{}' has an incompatible version.", path.string()));
+        assign(records);
+        return {};
+    }
+
+private:
+    std::vector<std::map<uint64_t, Interval>> m_levels; // zoom level -> first morton code -> interval
+    uint64_t m_n_quads = 0;
+};
+
+} // namespace nucleus::tile_scheduler
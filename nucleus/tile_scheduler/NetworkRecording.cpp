@@ -0,0 +1,94 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "NetworkRecording.h"
+
+#include <vector>
+
+#include <zpp_bits.h>
+
+#include "TilePack.h"
+
+using namespace nucleus::tile_scheduler;
+
+void NetworkRecording::add(const tile::Id& id, const Response& response)
+{
+    std::scoped_lock lock(m_mutex);
+    m_responses[id] = response;
+}
+
+std::optional<NetworkRecording::Response> NetworkRecording::find(const tile::Id& id) const
+{
+    std::scoped_lock lock(m_mutex);
+    const auto it = m_responses.find(id);
+    if (it == m_responses.end())
+        return {};
+    return it->second;
+}
+
+size_t NetworkRecording::size() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_responses.size();
+}
+
+// an entry of the pack is the status and the time (zpp_bits), followed by the data as is
+tl::expected<void, std::string> NetworkRecording::write(const std::filesystem::path& base_path) const
+{
+    std::filesystem::create_directories(base_path);
+    TilePack pack(base_path, version_information);
+    const auto r = pack.open(true);
+    if (!r.has_value())
+        return r;
+    std::scoped_lock lock(m_mutex);
+    std::vector<char> bytes;
+    for (const auto& [id, response] : m_responses) {
+        bytes.clear();
+        zpp::bits::out out(bytes);
+        if (failure(out(uint8_t(response.status), uint32_t(response.msecs))))
+            return tl::unexpected(std::string("Couldn't serialise a response."));
+        if (response.data)
+            bytes.insert(bytes.end(), response.data->cbegin(), response.data->cend());
+        const auto r_append = pack.append(id, bytes, 0, 0);
+        if (!r_append.has_value())
+            return r_append;
+    }
+    return pack.commit();
+}
+
+tl::expected<std::shared_ptr<NetworkRecording>, std::string> NetworkRecording::read(const std::filesystem::path& base_path)
+{
+    TilePack pack(base_path, version_information);
+    const auto r = pack.open(false);
+    if (!r.has_value())
+        return tl::unexpected(r.error());
+    auto recording = std::make_shared<NetworkRecording>();
+    for (const auto& [id, entry] : pack.index()) {
+        const auto bytes = pack.bytes(id);
+        if (!bytes)
+            continue;
+        zpp::bits::in in(*bytes);
+        uint8_t status = 0;
+        uint32_t msecs = 0;
+        if (failure(in(status, msecs)) || status > uint8_t(tile_types::NetworkInfo::Status::NetworkError))
+            return tl::unexpected(std::string("Broken response in the recording."));
+        const auto data = bytes->subspan(in.position());
+        recording->m_responses[id] = { tile_types::NetworkInfo::Status(status), msecs, std::make_shared<QByteArray>(data.data(), qsizetype(data.size())) };
+    }
+    return recording;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <QByteArray>
+#include <tl/expected.hpp>
+
+#include "radix/tile.h"
+#include "tile_types.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Responses of a TileLoadService (one layer), recorded with TileLoadService::set_recording and replayed with NetworkReplay.
+/// Per tile, the latest response is kept: status, the time from the request to the delivery, and the data.
+/// On disk, it is a TilePack. This class is thread safe.
+class NetworkRecording {
+public:
+    static constexpr std::array<char, 25> version_information = { "NetworkRecording, v0.1" };
+    struct Response {
+        tile_types::NetworkInfo::Status status = tile_types::NetworkInfo::Status::Good;
+        unsigned msecs = 0; // from the request to the delivery
+        std::shared_ptr<QByteArray> data;
+    };
+
+    void add(const tile::Id& id, const Response& response);
+    [[nodiscard]] std::optional<Response> find(const tile::Id& id) const;
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] tl::expected<void, std::string> write(const std::filesystem::path& base_path) const;
+    [[nodiscard]] static tl::expected<std::shared_ptr<NetworkRecording>, std::string> read(const std::filesystem::path& base_path);
+
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<tile::Id, Response, tile::Id::Hasher> m_responses;
+};
+using NetworkRecordingPtr = std::shared_ptr<NetworkRecording>;
+
+} // namespace nucleus::tile_scheduler
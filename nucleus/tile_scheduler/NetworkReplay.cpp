@@ -0,0 +1,80 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "NetworkReplay.h"
+
+#include <algorithm>
+
+using namespace nucleus::tile_scheduler;
+
+NetworkLink::NetworkLink(NetworkProfile profile)
+    : m_profile(std::move(profile))
+    , m_rng(m_profile.seed)
+{
+}
+
+NetworkLink::Transfer NetworkLink::transfer(size_t n_bytes, unsigned recorded_msecs)
+{
+    if (m_profile.recorded_timing)
+        return { recorded_msecs, false };
+
+    std::scoped_lock lock(m_mutex);
+    const auto now = Clock::now();
+    auto latency = double(m_profile.latency_msecs);
+    if (m_profile.jitter_msecs > 0)
+        latency += std::uniform_real_distribution<double>(-double(m_profile.jitter_msecs), double(m_profile.jitter_msecs))(m_rng);
+    if (m_profile.loss_rate > 0 && std::bernoulli_distribution(m_profile.loss_rate)(m_rng))
+        latency += double(m_profile.retransmission_msecs);
+    const auto failed = m_profile.error_rate > 0 && std::bernoulli_distribution(m_profile.error_rate)(m_rng);
+
+    // the response starts after the latency, but not before the link finished the previous ones
+    const auto first_byte = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(std::max(0.0, latency)));
+    auto done = first_byte;
+    if (m_profile.bytes_per_second > 0 && !failed) {
+        const auto start = std::max(first_byte, m_busy_until);
+        done = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(double(n_bytes) / m_profile.bytes_per_second));
+        m_busy_until = done;
+    }
+    const auto msecs = std::chrono::ceil<std::chrono::milliseconds>(done - now).count();
+    return { unsigned(std::max<int64_t>(1, msecs)), failed };
+}
+
+NetworkReplay::NetworkReplay(std::shared_ptr<const NetworkRecording> recording, NetworkLinkPtr link)
+    : m_recording(std::move(recording))
+    , m_link(std::move(link))
+{
+}
+
+std::shared_ptr<QByteArray> NetworkReplay::read(const tile::Id& id)
+{
+    const auto response = m_recording->find(id);
+    if (!response || response->status != tile_types::NetworkInfo::Status::Good)
+        return {};
+    return response->data;
+}
+
+TileSource::Delivery NetworkReplay::delivery(const tile::Id& id)
+{
+    using Status = tile_types::NetworkInfo::Status;
+    const auto response = m_recording->find(id);
+    const auto n_bytes = response && response->data ? size_t(response->data->size()) : 0;
+    const auto transfer = m_link->transfer(n_bytes, response ? response->msecs : 0);
+    if (transfer.failed)
+        return { transfer.delay_msecs, Status::NetworkError };
+    return { transfer.delay_msecs, response ? response->status : Status::NotFound };
+}
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "NetworkRecording.h"
+#include "TileSource.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Access link of a simulated network, e.g. for load tests of the streaming pipeline with a NetworkRecording.
+struct NetworkProfile {
+    std::string name;
+    bool recorded_timing = false; // true: replay with the recorded times, everything below is ignored
+    unsigned latency_msecs = 0; // from the request to the first byte
+    unsigned jitter_msecs = 0; // uniformly distributed, +-
+    double bytes_per_second = 0; // downstream, shared by all requests of the link. 0 is unlimited
+    float loss_rate = 0; // probability that a response is delayed by a retransmission
+    unsigned retransmission_msecs = 0;
+    float error_rate = 0; // probability that a response fails (NetworkError)
+    unsigned seed = 42;
+
+    static NetworkProfile recorded() { return { "recorded", true }; }
+    static NetworkProfile lte() { return { "lte", false, 60, 25, 20e6 / 8, 0.01f, 250, 0.f }; }
+    static NetworkProfile dsl() { return { "dsl", false, 25, 5, 16e6 / 8, 0.001f, 200, 0.f }; }
+    static NetworkProfile fibre() { return { "fibre", false, 8, 2, 300e6 / 8, 0.f, 200, 0.f }; }
+    bool operator==(const NetworkProfile&) const = default;
+};
+
+/// Shapes the responses of all NetworkReplays that share it: latency, jitter, bandwidth (the responses are queued on the
+/// link) and loss. The random numbers come from the seed of the profile, i.e., the same order of requests gives the same times.
+/// This class is thread safe.
+class NetworkLink {
+public:
+    explicit NetworkLink(NetworkProfile profile);
+    [[nodiscard]] const NetworkProfile& profile() const { return m_profile; }
+
+    struct Transfer {
+        unsigned delay_msecs = 0;
+        bool failed = false;
+    };
+    /// reserves the link for a response of n_bytes that is requested now. recorded_msecs is used with recorded timing.
+    /// cancelled requests keep their reservation (their data is on the way already).
+    [[nodiscard]] Transfer transfer(size_t n_bytes, unsigned recorded_msecs);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    NetworkProfile m_profile;
+    std::mutex m_mutex;
+    std::mt19937 m_rng;
+    Clock::time_point m_busy_until = {};
+};
+using NetworkLinkPtr = std::shared_ptr<NetworkLink>;
+
+/// Serves the responses of a NetworkRecording to a TileLoadService (see TileLoadService(std::shared_ptr<TileSource>)), with
+/// the timing of the link. Tiles that are not in the recording are not found (after the latency of the link).
+class NetworkReplay : public TileSource {
+public:
+    NetworkReplay(std::shared_ptr<const NetworkRecording> recording, NetworkLinkPtr link);
+
+    [[nodiscard]] std::shared_ptr<QByteArray> read(const tile::Id& id) override;
+    [[nodiscard]] Delivery delivery(const tile::Id& id) override;
+
+private:
+    std::shared_ptr<const NetworkRecording> m_recording;
+    NetworkLinkPtr m_link;
+};
+
+} // namespace nucleus::tile_scheduler
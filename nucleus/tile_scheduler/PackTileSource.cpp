@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "PackTileSource.h"
+
+#include "TilePack.h"
+
+using namespace nucleus::tile_scheduler;
+
+PackTileSource::PackTileSource(std::filesystem::path base_path)
+    : m_base_path(std::move(base_path))
+{
+}
+
+PackTileSource::~PackTileSource() = default;
+
+tl::expected<void, std::string> PackTileSource::open()
+{
+    auto pack = std::make_shared<TilePack>(m_base_path, version_information);
+    const auto r = pack->open(false);
+    if (!r.has_value())
+        return r;
+    m_pack = std::move(pack);
+    return {};
+}
+
+size_t PackTileSource::size() const { return m_pack ? m_pack->index().size() : 0; }
+
+std::shared_ptr<QByteArray> PackTileSource::read(const tile::Id& id)
+{
+    if (!m_pack)
+        return {};
+    const auto bytes = m_pack->bytes(id);
+    if (!bytes)
+        return {};
+    // the deleter holds a reference, so the mapping outlives the view, even if the source is destroyed
+    return std::shared_ptr<QByteArray>(new QByteArray(QByteArray::fromRawData(bytes->data(), qsizetype(bytes->size()))), [pack = m_pack](QByteArray* view) {
+        delete view;
+    });
+}
+
+tl::expected<void, std::string> PackTileSource::write(const std::filesystem::path& base_path, const std::vector<std::pair<tile::Id, QByteArray>>& tiles)
+{
+    TilePack pack(base_path, version_information);
+    const auto r = pack.open(true);
+    if (!r.has_value())
+        return r;
+    for (const auto& [id, bytes] : tiles) {
+        const auto r_append = pack.append(id, std::span<const char>(bytes.constData(), size_t(bytes.size())), 0, 0);
+        if (!r_append.has_value())
+            return r_append;
+    }
+    return pack.commit();
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include "TileSource.h"
+
+namespace nucleus::tile_scheduler {
+class TilePack;
+
+/// Serves the tiles of a single layer from a memory mapped TilePack, in which every entry holds the encoded bytes of one tile.
+/// The data is not copied, the returned byte arrays are views into the mapping (QByteArray::fromRawData) and keep the pack alive.
+/// The pack is only read, so the views stay valid (see TilePack::bytes).
+class PackTileSource : public TileSource {
+public:
+    static constexpr std::array<char, 25> version_information = { "TileLayer, version 0.1" };
+
+    explicit PackTileSource(std::filesystem::path base_path);
+    ~PackTileSource() override;
+
+    [[nodiscard]] tl::expected<void, std::string> open();
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] std::shared_ptr<QByteArray> read(const tile::Id& id) override;
+
+    /// writes (or extends) a layer pack, e.g. from a directory of tiles. overwrites existing entries.
+    [[nodiscard]] static tl::expected<void, std::string> write(const std::filesystem::path& base_path, const std::vector<std::pair<tile::Id, QByteArray>>& tiles);
+
+private:
+    std::filesystem::path m_base_path;
+    std::shared_ptr<TilePack> m_pack;
+};
+
+} // namespace nucleus::tile_scheduler
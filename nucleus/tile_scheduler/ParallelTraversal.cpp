@@ -0,0 +1,123 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ParallelTraversal.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+using namespace nucleus::tile_scheduler;
+
+ParallelTraversal::ParallelTraversal()
+{
+#if !defined(__EMSCRIPTEN__) || defined(ALP_ENABLE_THREADING)
+    m_max_thread_count = unsigned(std::max(1, QThread::idealThreadCount()));
+#endif
+    m_stacks.resize(1);
+}
+
+ParallelTraversal::~ParallelTraversal()
+{
+    if (m_pool)
+        m_pool->waitForDone(); // the runners are done when run() returns, this only waits for them to return to the pool
+}
+
+void ParallelTraversal::set_node_threshold(size_t new_node_threshold) { m_node_threshold = new_node_threshold; }
+
+void ParallelTraversal::set_max_thread_count(unsigned new_max_thread_count)
+{
+    m_max_thread_count = std::max(1u, new_max_thread_count);
+    if (m_pool)
+        m_pool->setMaxThreadCount(int(m_max_thread_count - 1));
+}
+
+void ParallelTraversal::expand_serial_levels(const std::function<bool(const tile::Id&)>& refine, std::vector<tile::Id>* inner_nodes, std::vector<tile::Id>* leaves)
+{
+    if (inner_nodes)
+        inner_nodes->clear();
+    if (leaves)
+        leaves->clear();
+    m_n_nodes = 0;
+    m_roots.assign(1, tile::Id { 0, { 0, 0 } });
+    for (unsigned level = 0; level < serial_levels && !m_roots.empty(); ++level) {
+        m_next_roots.clear();
+        for (const auto& tile : m_roots) {
+            ++m_n_nodes;
+            if (!refine(tile)) {
+                if (leaves)
+                    leaves->push_back(tile);
+                continue;
+            }
+            if (inner_nodes)
+                inner_nodes->push_back(tile);
+            const auto children = tile.children();
+            m_next_roots.insert(m_next_roots.end(), children.begin(), children.end());
+        }
+        std::swap(m_roots, m_next_roots);
+    }
+}
+
+unsigned ParallelTraversal::runner_count()
+{
+    // the size of the previous traversal predicts the size of this one, the camera moves only a bit between two updates
+    if (m_max_thread_count <= 1 || m_roots.size() <= 1 || m_n_nodes_previous < m_node_threshold)
+        return 1;
+    return unsigned(std::min<size_t>(m_max_thread_count, m_roots.size()));
+}
+
+void ParallelTraversal::run(unsigned n_runners, const std::function<void(unsigned, size_t)>& task)
+{
+    if (!m_pool) {
+        m_pool = std::make_unique<QThreadPool>();
+        m_pool->setMaxThreadCount(int(m_max_thread_count - 1));
+    }
+    if (m_stacks.size() < n_runners)
+        m_stacks.resize(n_runners);
+
+    std::atomic<size_t> next_subtree = 0;
+    const auto n_subtrees = m_roots.size();
+    const auto work = [&](unsigned runner) {
+        for (auto i = next_subtree++; i < n_subtrees; i = next_subtree++)
+            task(runner, i);
+    };
+    QSemaphore done;
+    for (unsigned runner = 1; runner < n_runners; ++runner) {
+        m_pool->start([&work, &done, runner]() {
+            work(runner);
+            done.release();
+        });
+    }
+    work(0); // if the pool is slow to start, the calling thread takes the subtrees that are left
+    done.acquire(int(n_runners - 1));
+}
+
+void ParallelTraversal::merge_subtrees(std::vector<tile::Id>* inner_nodes, std::vector<tile::Id>* leaves)
+{
+    for (const auto& subtree : m_subtrees) {
+        m_n_nodes += subtree.inner_nodes.size() + subtree.leaves.size();
+        if (inner_nodes)
+            inner_nodes->insert(inner_nodes->end(), subtree.inner_nodes.begin(), subtree.inner_nodes.end());
+        if (leaves)
+            leaves->insert(leaves->end(), subtree.leaves.begin(), subtree.leaves.end());
+    }
+    m_n_nodes_previous = m_n_nodes;
+}
@@ -0,0 +1,133 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <radix/tile.h>
+
+class QThreadPool;
+
+namespace nucleus::tile_scheduler {
+
+/// Top down quad tree traversal (same decisions as quad_tree::onTheFlyTraverse), that expands the first levels on the calling
+/// thread and traverses the subtrees below them in parallel. The subtrees are handed out one by one to the threads that are
+/// idle, the calling thread takes part, and the results are concatenated in subtree order. The output is therefore the same
+/// for any number of threads, and the same as with the serial fallback, which is used as long as the previous traversal had
+/// fewer nodes than the threshold (most views are small, and the threads aren't worth it there). Not thread safe.
+class ParallelTraversal {
+public:
+    static constexpr unsigned serial_levels = 3; // up to 64 subtrees
+
+    ParallelTraversal();
+    ~ParallelTraversal();
+
+    void set_node_threshold(size_t new_node_threshold);
+    void set_max_thread_count(unsigned new_max_thread_count); // 1 disables the parallel traversal
+    [[nodiscard]] unsigned max_thread_count() const { return m_max_thread_count; }
+    [[nodiscard]] size_t n_nodes() const { return m_n_nodes; } // evaluated by the last traversal
+    [[nodiscard]] bool last_was_parallel() const { return m_last_was_parallel; }
+
+    /// refine is used on the calling thread, make_refine(runner) is called there as well (runner = 1, 2, ..) and gives the
+    /// refine functor of another thread. it must not share unsynchronised state with the others (e.g., a CameraTraversal
+    /// each). the ancestors of a subtree are evaluated before the subtree, as in a serial top down traversal, so that
+    /// memoising functors take the same decisions. inner_nodes or leaves may be null.
+    template <typename Refine, typename MakeRefine>
+    void traverse(const Refine& refine, const MakeRefine& make_refine, std::vector<tile::Id>* inner_nodes, std::vector<tile::Id>* leaves)
+    {
+        expand_serial_levels(std::cref(refine), inner_nodes, leaves);
+        const auto n_runners = runner_count();
+        m_last_was_parallel = n_runners > 1;
+        m_subtrees.resize(m_roots.size());
+        if (n_runners <= 1) {
+            for (size_t i = 0; i < m_roots.size(); ++i)
+                traverse_subtree(refine, m_roots[i], &m_subtrees[i], &m_stacks[0]);
+        } else {
+            std::vector<decltype(make_refine(1u))> refines;
+            refines.reserve(n_runners - 1);
+            for (unsigned runner = 1; runner < n_runners; ++runner)
+                refines.push_back(make_refine(runner));
+            run(n_runners, [&](unsigned runner, size_t i) {
+                if (runner == 0)
+                    traverse_subtree(refine, m_roots[i], &m_subtrees[i], &m_stacks[0]);
+                else
+                    traverse_subtree(refines[runner - 1], m_roots[i], &m_subtrees[i], &m_stacks[runner]);
+            });
+        }
+        merge_subtrees(inner_nodes, leaves);
+    }
+
+private:
+    struct Subtree {
+        std::vector<tile::Id> inner_nodes;
+        std::vector<tile::Id> leaves;
+    };
+
+    template <typename Refine>
+    static void traverse_subtree(const Refine& refine, const tile::Id& root, Subtree* subtree, std::vector<tile::Id>* stack)
+    {
+        subtree->inner_nodes.clear();
+        subtree->leaves.clear();
+        // warms the memo of the functor, the decisions about the ancestors were taken already
+        std::array<tile::Id, serial_levels> ancestors;
+        auto ancestor = root;
+        for (unsigned i = 0; i < root.zoom_level; ++i)
+            ancestors[i] = ancestor = ancestor.parent();
+        for (unsigned i = root.zoom_level; i > 0; --i)
+            (void)refine(ancestors[i - 1]);
+        // depth first, like quad_tree::onTheFlyTraverse
+        stack->clear();
+        stack->push_back(root);
+        while (!stack->empty()) {
+            const auto tile = stack->back();
+            stack->pop_back();
+            if (!refine(tile)) {
+                subtree->leaves.push_back(tile);
+                continue;
+            }
+            subtree->inner_nodes.push_back(tile);
+            const auto children = tile.children();
+            stack->insert(stack->end(), children.begin(), children.end());
+        }
+    }
+
+    void expand_serial_levels(const std::function<bool(const tile::Id&)>& refine, std::vector<tile::Id>* inner_nodes, std::vector<tile::Id>* leaves);
+    [[nodiscard]] unsigned runner_count();
+    // runs task(runner, subtree) for all subtrees, on n_runners threads (runner 0 is the calling thread)
+    void run(unsigned n_runners, const std::function<void(unsigned, size_t)>& task);
+    void merge_subtrees(std::vector<tile::Id>* inner_nodes, std::vector<tile::Id>* leaves);
+
+    std::unique_ptr<QThreadPool> m_pool; // created on first use
+    size_t m_node_threshold = 8192;
+    unsigned m_max_thread_count = 1;
+    size_t m_n_nodes = 0;
+    size_t m_n_nodes_previous = 0; // decides whether the next traversal is parallel
+    bool m_last_was_parallel = false;
+    // scratch storage, reused between calls
+    std::vector<tile::Id> m_roots;
+    std::vector<tile::Id> m_next_roots;
+    std::vector<Subtree> m_subtrees;
+    std::vector<std::vector<tile::Id>> m_stacks; // one per runner
+};
+
+} // namespace nucleus::tile_scheduler
@@ -18,21 +18,57 @@
 
 #include "QuadAssembler.h"
 
+#include <algorithm>
+
+#include <QTimer>
+
 using namespace nucleus::tile_scheduler;
 
 QuadAssembler::QuadAssembler(QObject *parent)
     : QObject{parent}
+    , m_deadline_timer(std::make_unique<QTimer>(this))
+    , m_clock([]() { return utils::time_since_epoch(); })
 {
+    connect(m_deadline_timer.get(), &QTimer::timeout, this, &QuadAssembler::check_deadlines);
 }
 
+QuadAssembler::~QuadAssembler() = default;
+
 size_t QuadAssembler::n_items_in_flight() const
 {
     return m_quads.size();
 }
 
+void QuadAssembler::set_assembly_timeout(unsigned timeout, unsigned max_retries)
+{
+    m_assembly_timeout = timeout;
+    m_max_retries = max_retries;
+    if (m_assembly_timeout == 0)
+        m_deadline_timer->stop();
+}
+
+unsigned QuadAssembler::assembly_timeout() const
+{
+    return m_assembly_timeout;
+}
+
+unsigned QuadAssembler::n_timeouts() const
+{
+    return m_n_timeouts;
+}
+
+void QuadAssembler::set_clock(std::function<uint64_t()> clock)
+{
+    m_clock = std::move(clock);
+}
+
 void QuadAssembler::load(const tile::Id& tile_id)
 {
-    m_quads[tile_id].id = tile_id;
+    auto& assembly = m_quads[tile_id];
+    assembly.quad.id = tile_id;
+    assembly.deadline = deadline_for(0);
+    if (m_assembly_timeout > 0 && !m_deadline_timer->isActive())
+        m_deadline_timer->start(int(std::clamp(m_assembly_timeout / 4, 1u, 1000u)));
     for (const auto& child_id : tile_id.children()) {
         emit tile_requested(child_id);
     }
@@ -40,10 +76,72 @@ void QuadAssembler::load(const tile::Id& tile_id)
 
 void QuadAssembler::deliver_tile(const tile_types::LayeredTile& tile)
 {
-    auto& quad = m_quads[tile.id.parent()];
+    const auto it = m_quads.find(tile.id.parent());
+    if (it == m_quads.end())
+        return; // cancelled, but the delivery was already on its way
+    auto& quad = it->second.quad;
+    // a late reply for a tile that was requested again after a timeout
+    if (std::any_of(quad.tiles.begin(), quad.tiles.begin() + quad.n_tiles, [&tile](const auto& t) { return t.id == tile.id; }))
+        return;
     quad.tiles[quad.n_tiles++] = tile;
     if (quad.n_tiles == 4) {
         emit quad_loaded(quad);
-        m_quads.erase(quad.id);
+        m_quads.erase(it);
+    }
+}
+
+void QuadAssembler::check_deadlines()
+{
+    if (m_assembly_timeout == 0)
+        return;
+    const auto now = m_clock();
+    std::vector<tile::Id> expired;
+    for (const auto& [id, assembly] : m_quads) {
+        if (assembly.deadline <= now)
+            expired.push_back(id);
+    }
+    for (const auto& quad_id : expired) {
+        auto& assembly = m_quads.at(quad_id);
+        auto& quad = assembly.quad;
+        std::vector<tile::Id> missing;
+        for (const auto& child_id : quad_id.children()) {
+            if (std::none_of(quad.tiles.begin(), quad.tiles.begin() + quad.n_tiles, [&child_id](const auto& t) { return t.id == child_id; }))
+                missing.push_back(child_id);
+        }
+        ++m_n_timeouts;
+        emit tiles_cancelled(missing); // drops the partial layers and the requests that got lost
+
+        if (assembly.n_retries < m_max_retries) {
+            ++assembly.n_retries;
+            assembly.deadline = deadline_for(assembly.n_retries);
+            for (const auto& child_id : missing)
+                emit tile_requested(child_id);
+            continue;
+        }
+        for (const auto& child_id : missing)
+            quad.tiles[quad.n_tiles++] = tile_types::LayeredTile { child_id, { tile_types::NetworkInfo::Status::NetworkError, now }, std::make_shared<QByteArray>(), std::make_shared<QByteArray>() };
+        const auto failed = quad;
+        m_quads.erase(quad_id);
+        emit quad_loaded(failed);
+    }
+    if (m_quads.empty())
+        m_deadline_timer->stop();
+}
+
+uint64_t QuadAssembler::deadline_for(unsigned n_retries) const
+{
+    return m_clock() + (uint64_t(m_assembly_timeout) << std::min(n_retries, 16u));
+}
+
+void QuadAssembler::cancel_quads(const std::vector<tile::Id>& quad_ids)
+{
+    std::vector<tile::Id> tile_ids;
+    for (const auto& quad_id : quad_ids) {
+        if (m_quads.erase(quad_id) == 0)
+            continue;
+        for (const auto& child_id : quad_id.children())
+            tile_ids.push_back(child_id);
     }
+    if (!tile_ids.empty())
+        emit tiles_cancelled(tile_ids);
 }
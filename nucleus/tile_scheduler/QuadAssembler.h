@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <unordered_map>
 
 #include <QObject>
@@ -25,25 +27,54 @@
 #include "radix/tile.h"
 #include "tile_types.h"
 
+class QTimer;
+
 namespace nucleus::tile_scheduler {
 
 class QuadAssembler : public QObject {
     Q_OBJECT
-    using TileId2QuadMap = std::unordered_map<tile::Id, tile_types::TileQuad, tile::Id::Hasher>;
+    struct Assembly {
+        tile_types::TileQuad quad;
+        uint64_t deadline = 0; // msecs since epoch
+        unsigned n_retries = 0;
+    };
+    using TileId2QuadMap = std::unordered_map<tile::Id, Assembly, tile::Id::Hasher>;
 
     TileId2QuadMap m_quads;
+    unsigned m_assembly_timeout = 60 * 1000;
+    unsigned m_max_retries = 2;
+    unsigned m_n_timeouts = 0;
+    std::unique_ptr<QTimer> m_deadline_timer;
+    std::function<uint64_t()> m_clock; // msecs since epoch
 
 public:
     explicit QuadAssembler(QObject* parent = nullptr);
+    ~QuadAssembler() override;
     [[nodiscard]] size_t n_items_in_flight() const;
+    // quads that are not complete after the timeout (msecs) get their missing tiles cancelled and requested again, with the timeout
+    // doubling on each retry. after max_retries the quad is delivered as a network error, which frees its slot, and the scheduler
+    // requests it again later. 0 disables the timeout.
+    void set_assembly_timeout(unsigned timeout, unsigned max_retries = 2);
+    [[nodiscard]] unsigned assembly_timeout() const;
+    [[nodiscard]] unsigned n_timeouts() const; // since construction, including retries
+    // source of the current time (msecs since epoch) for the deadlines, utils::time_since_epoch by default. for tests.
+    void set_clock(std::function<uint64_t()> clock);
 
 public slots:
     void load(const tile::Id& tile_id);
     void deliver_tile(const tile_types::LayeredTile& tile);
+    // forgets the partially assembled quads and cancels their tiles (see tiles_cancelled)
+    void cancel_quads(const std::vector<tile::Id>& quad_ids);
+    // retries or evicts the partial quads whose deadline has passed. runs on a timer while quads are in flight.
+    void check_deadlines();
 
 signals:
     void tile_requested(const tile::Id& tile_id);
     void quad_loaded(const tile_types::TileQuad& tile);
+    void tiles_cancelled(const std::vector<tile::Id>& tile_ids);
+
+private:
+    [[nodiscard]] uint64_t deadline_for(unsigned n_retries) const;
 };
 
 }
@@ -18,6 +18,8 @@
 
 #include "RateLimiter.h"
 
+#include <algorithm>
+
 #include <QTimer>
 
 #include "utils.h"
@@ -58,6 +60,22 @@ void RateLimiter::request_quad(const tile::Id& id)
     process_request_queue();
 }
 
+void RateLimiter::cancel_quads(const std::vector<tile::Id>& ids)
+{
+    std::vector<tile::Id> sent_on;
+    for (const auto& id : ids) {
+        const auto it = std::find(m_request_queue.begin(), m_request_queue.end(), id);
+        if (it == m_request_queue.end())
+            sent_on.push_back(id);
+        else
+            m_request_queue.erase(it);
+    }
+    if (m_request_queue.empty())
+        m_update_timer->stop();
+    if (!sent_on.empty())
+        emit quads_cancelled(sent_on);
+}
+
 void RateLimiter::process_request_queue()
 {
     const auto current_msecs = utils::time_since_epoch();
@@ -0,0 +1,224 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "RegionSeeder.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+#include <zpp_bits.h>
+
+#include "TilePack.h"
+#include "nucleus/srs.h"
+#include "utils.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+bool polygon_contains(std::span<const glm::dvec2> polygon, const glm::dvec2& p)
+{
+    // even odd rule
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const auto& a = polygon[i];
+        const auto& b = polygon[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)
+            inside = !inside;
+    }
+    return inside;
+}
+
+bool segments_intersect(const glm::dvec2& p1, const glm::dvec2& p2, const glm::dvec2& q1, const glm::dvec2& q2)
+{
+    const auto cross = [](const glm::dvec2& o, const glm::dvec2& a, const glm::dvec2& b) { return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x); };
+    const auto d1 = cross(q1, q2, p1);
+    const auto d2 = cross(q1, q2, p2);
+    const auto d3 = cross(p1, p2, q1);
+    const auto d4 = cross(p1, p2, q2);
+    return ((d1 > 0) != (d2 > 0)) && ((d3 > 0) != (d4 > 0));
+}
+
+bool polygon_overlaps(std::span<const glm::dvec2> polygon, const tile::SrsBounds& bounds)
+{
+    const std::array<glm::dvec2, 4> corners = { bounds.min, glm::dvec2(bounds.max.x, bounds.min.y), bounds.max, glm::dvec2(bounds.min.x, bounds.max.y) };
+    if (std::any_of(polygon.begin(), polygon.end(), [&](const auto& p) { return bounds.contains(p); }))
+        return true;
+    if (std::any_of(corners.begin(), corners.end(), [&](const auto& c) { return polygon_contains(polygon, c); }))
+        return true;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        for (size_t k = 0; k < 4; ++k) {
+            if (segments_intersect(polygon[j], polygon[i], corners[k], corners[(k + 1) % 4]))
+                return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+RegionSeeder::RegionSeeder(QObject* parent)
+    : QObject { parent }
+{
+}
+
+RegionSeeder::~RegionSeeder() = default;
+
+std::vector<tile::Id> RegionSeeder::quads_in_polygon(std::span<const glm::dvec2> lat_long_polygon, unsigned max_zoom_level)
+{
+    if (lat_long_polygon.size() < 3 || max_zoom_level == 0)
+        return {};
+    std::vector<glm::dvec2> polygon;
+    polygon.reserve(lat_long_polygon.size());
+    for (const auto& lat_long : lat_long_polygon)
+        polygon.push_back(srs::lat_long_to_world(lat_long));
+
+    // breadth first, so that coarse quads are downloaded first (they are useful even if the run is cancelled)
+    std::vector<tile::Id> quads;
+    std::vector<tile::Id> front = { tile::Id { 0, { 0, 0 } } };
+    while (!front.empty()) {
+        std::vector<tile::Id> next;
+        for (const auto& id : front) {
+            if (!polygon_overlaps(polygon, srs::tile_bounds(id)))
+                continue;
+            quads.push_back(id);
+            if (id.zoom_level + 1 < max_zoom_level) {
+                for (const auto& child : id.children())
+                    next.push_back(child);
+            }
+        }
+        front = std::move(next);
+    }
+    return quads;
+}
+
+void RegionSeeder::set_concurrency(unsigned new_concurrency)
+{
+    assert(new_concurrency > 0);
+    m_concurrency = new_concurrency;
+}
+
+void RegionSeeder::set_commit_interval(unsigned new_commit_interval)
+{
+    assert(new_commit_interval > 0);
+    m_commit_interval = new_commit_interval;
+}
+
+tl::expected<void, std::string> RegionSeeder::prepare(const std::filesystem::path& pack_path, std::vector<tile::Id> quads)
+{
+    m_pack = std::make_unique<TilePack>(pack_path, tile_types::TileQuad::version_information);
+    const auto r = m_pack->open(true);
+    if (!r.has_value()) {
+        m_pack.reset();
+        return r;
+    }
+    m_statistics = {};
+    m_statistics.n_quads_total = quads.size();
+    std::erase_if(quads, [this](const tile::Id& id) { return m_pack->index().contains(id); });
+    m_statistics.n_quads_skipped = m_statistics.n_quads_total - quads.size();
+    m_todo = std::move(quads);
+    m_next = 0;
+    m_outstanding.clear();
+    m_finished = false;
+    return {};
+}
+
+const RegionSeeder::Statistics& RegionSeeder::statistics() const { return m_statistics; }
+
+bool RegionSeeder::is_finished() const { return m_finished; }
+
+void RegionSeeder::start()
+{
+    assert(m_pack);
+    m_start_time = std::chrono::steady_clock::now();
+    if (m_todo.empty()) {
+        finish();
+        return;
+    }
+    request_next_window();
+}
+
+void RegionSeeder::receive_quad(const tile_types::TileQuad& quad)
+{
+    if (m_finished || m_outstanding.erase(quad.id) == 0)
+        return;
+
+    if (quad.network_info().status == tile_types::NetworkInfo::Status::NetworkError) {
+        ++m_statistics.n_quads_failed; // not written, so the next run retries it
+    } else {
+        std::vector<char> bytes;
+        zpp::bits::out out(bytes);
+        if (failure(out(quad))) {
+            emit failed(QString("Couldn't serialise quad %1/%2/%3.").arg(quad.id.zoom_level).arg(quad.id.coords.x).arg(quad.id.coords.y));
+            return;
+        }
+        const auto now = utils::time_since_epoch();
+        const auto r = m_pack->append(quad.id, bytes, now, now * 100 - quad.id.zoom_level);
+        if (!r.has_value()) {
+            emit failed(QString::fromStdString(r.error()));
+            return;
+        }
+        for (const auto& tile : quad.tiles) {
+            m_statistics.n_bytes_downloaded += tile.ortho ? uint64_t(tile.ortho->size()) : 0;
+            m_statistics.n_bytes_downloaded += tile.height ? uint64_t(tile.height->size()) : 0;
+        }
+        ++m_statistics.n_quads_written;
+        if (++m_n_uncommitted >= m_commit_interval) {
+            m_n_uncommitted = 0;
+            const auto r_commit = m_pack->commit_journal();
+            if (!r_commit.has_value()) {
+                emit failed(QString::fromStdString(r_commit.error()));
+                return;
+            }
+        }
+    }
+
+    emit progress(current_statistics());
+    if (m_outstanding.empty() && m_next >= m_todo.size()) {
+        finish();
+        return;
+    }
+    if (m_outstanding.size() < m_concurrency)
+        request_next_window();
+}
+
+void RegionSeeder::request_next_window()
+{
+    while (m_outstanding.size() < size_t(m_concurrency) * 2 && m_next < m_todo.size())
+        m_outstanding.insert(m_todo[m_next++]);
+    // the slot limiter replaces its queue with every request, therefore all outstanding quads are sent again (in flight ones are skipped)
+    emit quads_requested({ m_outstanding.begin(), m_outstanding.end() });
+}
+
+void RegionSeeder::finish()
+{
+    m_finished = true;
+    const auto r = m_pack->commit(); // checkpoint, the app reads the index directly
+    if (!r.has_value()) {
+        emit failed(QString::fromStdString(r.error()));
+        return;
+    }
+    m_statistics = current_statistics();
+    emit finished(m_statistics);
+}
+
+RegionSeeder::Statistics RegionSeeder::current_statistics() const
+{
+    auto stats = m_statistics;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start_time).count();
+    return stats;
+}
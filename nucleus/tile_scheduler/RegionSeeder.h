@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <QObject>
+#include <glm/glm.hpp>
+#include <tl/expected.hpp>
+
+#include "radix/tile.h"
+#include "tile_types.h"
+
+namespace nucleus::tile_scheduler {
+class TilePack;
+
+/// Downloads all quads of a region into a tile pack (the disk cache format of Scheduler), e.g. for offline use.
+/// Quads that are already in the pack are skipped, so an interrupted run can be resumed. Requests are emitted in windows of
+/// the given concurrency, connect quads_requested to a SlotLimiter (or the rest of the loading chain) and the result to
+/// receive_quad.
+class RegionSeeder : public QObject {
+    Q_OBJECT
+public:
+    struct Statistics {
+        size_t n_quads_total = 0;
+        size_t n_quads_skipped = 0; // already in the pack
+        size_t n_quads_written = 0;
+        size_t n_quads_failed = 0; // network errors, retried on the next run
+        uint64_t n_bytes_downloaded = 0;
+        double seconds = 0;
+    };
+
+    explicit RegionSeeder(QObject* parent = nullptr);
+    ~RegionSeeder() override;
+
+    /// all quads (ids of the parents) that overlap the polygon, up to and including tiles of max_zoom_level
+    static std::vector<tile::Id> quads_in_polygon(std::span<const glm::dvec2> lat_long_polygon, unsigned max_zoom_level);
+
+    void set_concurrency(unsigned new_concurrency);
+    // the journal is committed every n quads, so that progress survives a crash
+    void set_commit_interval(unsigned new_commit_interval);
+
+    /// opens (or creates) the pack and filters out the quads that it already contains
+    [[nodiscard]] tl::expected<void, std::string> prepare(const std::filesystem::path& pack_path, std::vector<tile::Id> quads);
+    [[nodiscard]] const Statistics& statistics() const;
+    [[nodiscard]] bool is_finished() const;
+
+public slots:
+    void start();
+    void receive_quad(const tile_types::TileQuad& quad);
+
+signals:
+    void quads_requested(const std::vector<tile::Id>& ids);
+    void progress(const Statistics& stats);
+    void finished(const Statistics& stats);
+    void failed(const QString& message);
+
+private:
+    void request_next_window();
+    void finish();
+    [[nodiscard]] Statistics current_statistics() const;
+
+    std::unique_ptr<TilePack> m_pack;
+    std::vector<tile::Id> m_todo;
+    size_t m_next = 0;
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_outstanding;
+    unsigned m_concurrency = 16;
+    unsigned m_commit_interval = 256;
+    unsigned m_n_uncommitted = 0;
+    bool m_finished = false;
+    Statistics m_statistics;
+    std::chrono::steady_clock::time_point m_start_time;
+};
+
+} // namespace nucleus::tile_scheduler
@@ -18,23 +18,134 @@
 
 #include "Scheduler.h"
 
+#include <algorithm>
+#include <cmath>
+#include <tuple>
 #include <unordered_set>
 
 #include <QBuffer>
 #include <QDebug>
+#include <QImage>
+#include <QMetaMethod>
 #include <QNetworkInformation>
 #include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 
+#include "nucleus/map_label/label_tile.h"
+#include "nucleus/tile_scheduler/CameraTraversal.h"
 #include "nucleus/tile_scheduler/utils.h"
+#include "nucleus/timing/StartupTimeline.h"
+#include "nucleus/timing/TraceRecorder.h"
+#include "nucleus/utils/jpeg_transcoder.h"
+#include "nucleus/utils/ktx2.h"
+#include "nucleus/utils/normal_map.h"
 #include "nucleus/utils/tile_conversion.h"
-#include "radix/quad_tree.h"
 
 using namespace nucleus::tile_scheduler;
 
+namespace {
+// decodes outside of the lock, so that the decode pool isn't serialised. two threads may decode the same data, that's harmless.
+template <typename Memo, typename Factory>
+auto memoised_decode(std::mutex& mutex, Memo& memo, const std::shared_ptr<QByteArray>& source, unsigned generation, const Factory& factory)
+{
+    {
+        auto locker = std::scoped_lock(mutex);
+        if (const auto* memoised = memo.find(source.get()); memoised && memoised->generation == generation)
+            return memoised->decoded;
+    }
+    auto decoded = factory();
+    auto locker = std::scoped_lock(mutex);
+    memo.insert(source.get(), { source, decoded, generation });
+    return decoded;
+}
+
+// decoded image in a buffer of the (decode worker) thread, valid until the next call on that thread. tiles of a layer have
+// the same size and format, so the pixel buffer is reused, and the consumers read it without copying (see ColourTexture).
+const QImage& decode_with_thread_buffer(const QByteArray& data)
+{
+    thread_local QImage image;
+    nucleus::utils::tile_conversion::decode_into(data, &image);
+    return image;
+}
+
+// closest ancestor that has its own data for the layer (in the snapshot of the ram cache)
+template <typename Snapshot>
+std::optional<std::pair<tile::Id, std::shared_ptr<QByteArray>>> ancestor_layer(const Snapshot& snapshot,
+    tile::Id tile_id,
+    std::shared_ptr<QByteArray> tile_types::LayeredTile::*data,
+    bool tile_types::LayeredTile::*inherited)
+{
+    while (tile_id.zoom_level > 1) { // the root tile is not part of a quad
+        tile_id = tile_id.parent();
+        const auto* quad = snapshot.find(tile_id.parent());
+        if (!quad)
+            return {};
+        const auto tile = std::find_if(quad->tiles.begin(), quad->tiles.end(), [&tile_id](const auto& t) { return t.id == tile_id; });
+        if (tile == quad->tiles.end())
+            return {};
+        const auto& bytes = (*tile).*data;
+        if (!((*tile).*inherited) && bytes && !bytes->isEmpty())
+            return std::make_pair(tile_id, bytes);
+    }
+    return {};
+}
+
+// position of a descendant within an ancestor: n x n subdivisions, column from the west and row from the north (image order)
+struct SubTile {
+    unsigned n;
+    unsigned column;
+    unsigned row;
+};
+SubTile sub_tile(const tile::Id& ancestor_id, const tile::Id& tile_id)
+{
+    assert(tile_id.zoom_level > ancestor_id.zoom_level);
+    const auto depth = std::min(tile_id.zoom_level - ancestor_id.zoom_level, 16u);
+    const auto n = 1u << depth;
+    const auto y = tile_id.coords.y - (ancestor_id.coords.y << depth);
+    return { n, tile_id.coords.x - (ancestor_id.coords.x << depth), n - 1 - y };
+}
+
+QImage crop_ortho(const QImage& ancestor, const SubTile& part, unsigned size)
+{
+    const auto width = std::max(1, ancestor.width() / int(part.n));
+    const auto height = std::max(1, ancestor.height() / int(part.n));
+    const auto cropped = ancestor.copy(int(part.column) * width, int(part.row) * height, width, height);
+    return cropped.scaled(int(size), int(size), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+// bilinear. the pixels are on the tile borders, so neighbouring tiles share the edge samples.
+nucleus::Raster<uint16_t> crop_height(const nucleus::Raster<uint16_t>& ancestor, const SubTile& part)
+{
+    const auto width = ancestor.width();
+    const auto height = ancestor.height();
+    if (width < 2 || height < 2)
+        return nucleus::Raster<uint16_t>(glm::uvec2(width, height));
+    nucleus::Raster<uint16_t> raster(glm::uvec2(width, height), nucleus::uninitialised);
+    const auto span_x = double(width - 1) / double(part.n);
+    const auto span_y = double(height - 1) / double(part.n);
+    for (unsigned row = 0; row < height; ++row) {
+        for (unsigned col = 0; col < width; ++col) {
+            const auto x = (double(part.column) + double(col) / double(width - 1)) * span_x;
+            const auto y = (double(part.row) + double(row) / double(height - 1)) * span_y;
+            const auto x0 = std::min(unsigned(x), unsigned(width - 2));
+            const auto y0 = std::min(unsigned(y), unsigned(height - 2));
+            const auto fx = x - double(x0);
+            const auto fy = y - double(y0);
+            const auto top = std::lerp(double(ancestor.pixel({ x0, y0 })), double(ancestor.pixel({ x0 + 1, y0 })), fx);
+            const auto bottom = std::lerp(double(ancestor.pixel({ x0, y0 + 1 })), double(ancestor.pixel({ x0 + 1, y0 + 1 })), fx);
+            raster.pixel({ col, row }) = uint16_t(std::lround(std::lerp(top, bottom, fy)));
+        }
+    }
+    return raster;
+}
+} // namespace
+
 Scheduler::Scheduler(QObject* parent)
-    : Scheduler { white_jpeg_tile(m_ortho_tile_size), black_png_tile(m_height_tile_size), parent }
+    : Scheduler { white_jpeg_tile(tile_types::TileFormat {}.ortho_size), black_png_tile(tile_types::TileFormat {}.height_size), parent }
 {
+    m_generated_default_tiles = true;
 }
 
 Scheduler::Scheduler(const QByteArray& default_ortho_tile, const QByteArray& default_height_tile, QObject* parent)
@@ -42,9 +153,21 @@ Scheduler::Scheduler(const QByteArray& default_ortho_tile, const QByteArray& def
 {
     m_update_timer = std::make_unique<QTimer>(this);
     m_update_timer->setSingleShot(true);
+    connect(m_update_timer.get(), &QTimer::timeout, this, [this]() { m_last_update = m_clock(); });
     connect(m_update_timer.get(), &QTimer::timeout, this, &Scheduler::send_quad_requests);
     connect(m_update_timer.get(), &QTimer::timeout, this, &Scheduler::update_gpu_quads);
 
+    m_settle_timer = std::make_unique<QTimer>(this);
+    m_settle_timer->setSingleShot(true);
+    connect(m_settle_timer.get(), &QTimer::timeout, this, [this]() {
+        if (m_enabled)
+            m_update_timer->start(0);
+    });
+
+    m_idle_prefetch_timer = std::make_unique<QTimer>(this);
+    m_idle_prefetch_timer->setSingleShot(true);
+    connect(m_idle_prefetch_timer.get(), &QTimer::timeout, this, &Scheduler::schedule_update);
+
     m_purge_timer = std::make_unique<QTimer>(this);
     m_purge_timer->setSingleShot(true);
     connect(m_purge_timer.get(), &QTimer::timeout, this, &Scheduler::purge_ram_cache);
@@ -53,51 +176,199 @@ Scheduler::Scheduler(const QByteArray& default_ortho_tile, const QByteArray& def
     m_persist_timer->setSingleShot(true);
     connect(m_persist_timer.get(), &QTimer::timeout, this, &Scheduler::persist_tiles);
 
+    m_disk_load_timer = std::make_unique<QTimer>(this);
+    m_disk_load_timer->setSingleShot(true);
+    connect(m_disk_load_timer.get(), &QTimer::timeout, this, &Scheduler::load_disk_cache_batch);
+
+    m_warm_gpu_quads.set_byte_limit(uint64_t(128) << 20);
+    m_sources.push_back(std::make_unique<SourceCache>());
+
     m_default_ortho_tile = std::make_shared<QByteArray>(default_ortho_tile);
     m_default_height_tile = std::make_shared<QByteArray>(default_height_tile);
+
+    m_decode_pool = std::make_unique<QThreadPool>();
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING) && !defined(ALP_ENABLE_DECODE_WORKERS)
+    m_decode_thread_count = 1;
+#else
+    m_decode_thread_count = unsigned(std::max(1, QThread::idealThreadCount() - 1));
+#endif
+    m_decode_pool->setMaxThreadCount(int(m_decode_thread_count));
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING) && defined(ALP_ENABLE_DECODE_WORKERS)
+    m_asynchronous_decoding = true; // the scheduler is on the browser's main thread, the workers decode
+#endif
+
+    m_io_pool = std::make_unique<QThreadPool>();
+    m_io_pool->setMaxThreadCount(1);
 }
 
-Scheduler::~Scheduler() = default;
+Scheduler::~Scheduler()
+{
+    // only the changes since the last persist are written, so this is quick
+    if (m_persistence_used)
+        flush_disk_cache();
+    m_io_pool->waitForDone(); // the cache must outlive the io thread
+    m_decode_pool->waitForDone(); // asynchronous decodes use the memos and caches
+}
 
 void Scheduler::update_camera(const camera::Definition& camera)
 {
-    m_current_camera = camera;
+    const auto now = m_clock();
+    const auto dt = now - std::min(now, m_last_camera_update);
+    const auto was_at_rest = m_last_camera_update == 0 || dt >= camera_rest_msecs;
+    if (was_at_rest) {
+        m_camera_velocity = {};
+    } else if (dt > 0) {
+        m_camera_velocity = glm::mix(m_camera_velocity, (camera.position() - m_current_camera.position()) / double(dt), 0.5);
+    }
+    m_last_camera_update = now;
+    cancel_idle_prefetch();
+    if (m_prefetch_target && glm::distance(camera.position(), m_prefetch_target->position()) < 1.0)
+        m_prefetch_target.reset();
+    {
+        std::scoped_lock lock(m_layer_selection_mutex);
+        m_current_camera = camera;
+    }
+    m_camera_traversal.reset();
+    schedule_camera_update(was_at_rest);
+}
+
+void Scheduler::update_view_camera(unsigned view, const camera::Definition& camera)
+{
+    if (view == 0) {
+        update_camera(camera);
+        return;
+    }
+    {
+        std::scoped_lock lock(m_layer_selection_mutex);
+        m_view_cameras.insert_or_assign(view, camera);
+    }
+    m_view_traversals.erase(view);
+    schedule_update();
+}
+
+void Scheduler::remove_view(unsigned view)
+{
+    {
+        std::scoped_lock lock(m_layer_selection_mutex);
+        if (m_view_cameras.erase(view) == 0)
+            return;
+    }
+    m_view_traversals.erase(view);
     schedule_update();
 }
 
+size_t Scheduler::n_views() const { return 1 + m_view_cameras.size(); }
+
+void Scheduler::post_camera(const camera::Definition& camera)
+{
+    std::scoped_lock lock(m_posted_camera_mutex);
+    const auto delivery_queued = m_posted_camera.has_value();
+    m_posted_camera = camera;
+    if (!delivery_queued)
+        QMetaObject::invokeMethod(this, &Scheduler::take_posted_camera, Qt::QueuedConnection);
+}
+
+void Scheduler::take_posted_camera()
+{
+    std::optional<camera::Definition> camera;
+    {
+        std::scoped_lock lock(m_posted_camera_mutex);
+        std::swap(camera, m_posted_camera);
+    }
+    if (camera)
+        update_camera(*camera);
+}
+
 void Scheduler::receive_quad(const tile_types::TileQuad& new_quad)
+{
+    if (!insert_received_quad(new_quad))
+        return;
+    schedule_purge();
+    schedule_update();
+    schedule_persist();
+    update_stats();
+}
+
+void Scheduler::receive_quads(const tile_types::TileQuadBatch& new_quads)
+{
+    assert(new_quads);
+    bool inserted = false;
+    for (const auto& quad : *new_quads)
+        inserted = insert_received_quad(quad) || inserted;
+    if (!inserted)
+        return;
+    schedule_purge();
+    schedule_update();
+    schedule_persist();
+    update_stats();
+}
+
+namespace {
+// the ortho source of the quad's tiles, the current one if all of them inherit their ortho. nullopt if the tiles are of several
+// sources.
+std::optional<unsigned> ortho_source(const tile_types::TileQuad& quad, unsigned current_source)
+{
+    std::optional<unsigned> source;
+    for (unsigned i = 0; i < quad.n_tiles; ++i) {
+        const auto& tile = quad.tiles[i];
+        if (tile.ortho_inherited)
+            continue;
+        if (source && *source != tile.ortho_source)
+            return {};
+        source = tile.ortho_source;
+    }
+    return source.value_or(current_source);
+}
+} // namespace
+
+bool Scheduler::insert_received_quad(const tile_types::TileQuad& new_quad)
 {
     using Status = tile_types::NetworkInfo::Status;
+    m_sent_requests.erase(new_quad.id); // requested again with the next diff, if it's still needed
 #ifdef __EMSCRIPTEN__
     // webassembly doesn't report 404 (well, probably it does, but not if there is a cors failure as well).
     // so we'll simply treat any 404 as network error.
     // however, we need to pass tiles with zoomlevel < 10, otherwise the top of the tree won't be built.
-    if (new_quad.network_info().status == Status::Good || new_quad.id.zoom_level < 10) {
-        m_ram_cache.insert(new_quad);
-        schedule_purge();
-        schedule_update();
-        schedule_persist();
-        emit quad_received(new_quad.id);
-    }
+    if (new_quad.network_info().status != Status::Good && new_quad.id.zoom_level >= 10)
+        return false;
 #else
-    switch (new_quad.network_info().status) {
-    case Status::Good:
-    case Status::NotFound:
-        m_ram_cache.insert(new_quad);
-        schedule_purge();
-        schedule_update();
-        schedule_persist();
-        emit quad_received(new_quad.id);
-        update_stats();
-        break;
-    case Status::NetworkError:
-        // do not persist the tile.
-        // do not reschedule retrieval (wait for user input or a reconnect signal).
-        // do not purge (nothing was added, so no need to check).
-        // do nothing.
-        break;
-    }
+    // network errors are not persisted and not rescheduled (wait for user input or a reconnect signal).
+    // nothing was added, so no need to purge either.
+    if (new_quad.network_info().status == Status::NetworkError)
+        return false;
 #endif
+    const auto source = ortho_source(new_quad, m_tile_source);
+    if (!source)
+        return false; // the source was switched while the quad was loading, it's requested again
+    assert(*source < m_sources.size());
+    m_latency_tracer->mark(new_quad.id, LatencyTracer::Stage::Received);
+    if (is_missing(new_quad)) {
+        // remembered compactly instead of taking a ram cache slot. the quad tree is not refined into it (see refine)
+        std::scoped_lock lock(m_missing_quads_mutex);
+        m_sources[*source]->missing.insert(new_quad.id, new_quad.network_info().timestamp);
+    } else {
+        if (!m_sources[*source]->missing.empty()) {
+            std::scoped_lock lock(m_missing_quads_mutex);
+            m_sources[*source]->missing.erase(new_quad.id);
+        }
+        auto& cache = m_sources[*source]->ram;
+        auto quad = new_quad;
+        keep_unchanged_gpu_payloads(quad, cache);
+        cache.insert(quad);
+    }
+    emit quad_received(new_quad.id);
+    return true;
+}
+
+bool Scheduler::is_missing(const tile_types::TileQuad& quad)
+{
+    // partially covered quads are kept, the tiles that were found are shown
+    if (quad.n_tiles != 4)
+        return false;
+    const auto is_empty = [](const std::shared_ptr<QByteArray>& data) { return !data || data->isEmpty(); };
+    return std::all_of(quad.tiles.begin(), quad.tiles.end(), [&](const tile_types::LayeredTile& tile) {
+        return tile.network_info.status == tile_types::NetworkInfo::Status::NotFound && is_empty(tile.ortho) && is_empty(tile.height);
+    });
 }
 
 void Scheduler::set_network_reachability(QNetworkInformation::Reachability reachability)
@@ -118,122 +389,1000 @@ void Scheduler::set_network_reachability(QNetworkInformation::Reachability reach
     }
 }
 
+void Scheduler::set_network_metered(bool metered)
+{
+    if (metered == m_network_metered)
+        return;
+    const auto bundle_requests = network_policy().bundle_requests;
+    qDebug() << "network metered:" << metered;
+    m_network_metered = metered;
+    if (network_policy().bundle_requests != bundle_requests)
+        emit bundle_requests_changed(network_policy().bundle_requests);
+    schedule_update();
+}
+
+void Scheduler::set_network_policies(const NetworkPolicy& unmetered, const NetworkPolicy& metered)
+{
+    const auto bundle_requests = network_policy().bundle_requests;
+    m_unmetered_network_policy = unmetered;
+    m_metered_network_policy = metered;
+    if (network_policy().bundle_requests != bundle_requests)
+        emit bundle_requests_changed(network_policy().bundle_requests);
+    schedule_update();
+}
+
+const Scheduler::NetworkPolicy& Scheduler::network_policy() const { return m_network_metered ? m_metered_network_policy : m_unmetered_network_policy; }
+
+std::optional<Scheduler::NetworkPolicy> Scheduler::NetworkPolicy::from_string(const QString& string)
+{
+    NetworkPolicy policy;
+    for (const auto& pair : string.split(',', Qt::SkipEmptyParts)) {
+        const auto key_value = pair.split('=');
+        if (key_value.size() != 2)
+            return {};
+        const auto key = key_value[0].trimmed();
+        bool ok = false;
+        if (key == "prefetch")
+            policy.prefetch = key_value[1].toUInt(&ok) != 0;
+        else if (key == "max_zoom")
+            policy.max_zoom_level = key_value[1].toUInt(&ok);
+        else if (key == "error_factor")
+            policy.error_factor = key_value[1].toFloat(&ok);
+        else if (key == "bundles")
+            policy.bundle_requests = key_value[1].toUInt(&ok) != 0;
+        if (!ok)
+            return {};
+    }
+    if (policy.error_factor < 1.0f)
+        return {};
+    return policy;
+}
+
 void Scheduler::update_gpu_quads()
 {
-    const auto should_refine = tile_scheduler::utils::refineFunctor(m_current_camera, m_aabb_decorator, m_permissible_screen_space_error, m_ortho_tile_size);
+    if (m_suspended)
+        return;
+    const nucleus::timing::TraceScope trace("update_gpu_quads", "scheduler");
+    ram_cache().publish_snapshot(); // update runs after a batch of received quads
+    const auto should_refine = refine_functor(m_permissible_screen_space_error);
+    // quads on the gpu are coarsened at a lower threshold (hysteresis)
+    const auto should_stay_refined = refine_functor(m_permissible_screen_space_error * m_refinement_hysteresis);
     std::vector<tile_types::TileQuad> gpu_candidates;
-    m_ram_cache.visit([this, &gpu_candidates, &should_refine](const tile_types::TileQuad& quad) {
+    ram_cache().visit([this, &gpu_candidates, &should_refine, &should_stay_refined](const tile_types::TileQuad& quad) {
+        if (m_gpu_cached.contains(quad.id))
+            return should_stay_refined(quad.id);
         if (!should_refine(quad.id))
             return false;
-        if (m_gpu_cached.contains(quad.id))
-            return true;
 
         gpu_candidates.push_back(quad);
         return true;
     });
 
-    for (const auto& q : gpu_candidates) {
-        m_gpu_cached.insert(tile_types::GpuCacheInfo { q.id });
-    }
+    const auto quad_n_bytes = gpu_quad_n_bytes();
+    const auto now = m_clock();
+    // quads that went onto the gpu recently are kept, the new candidates are dropped instead (and tried again later)
+    const auto keep = [this, now](const tile_types::GpuCacheInfo& quad) {
+        return quad.resident_since < now && (now - quad.resident_since < m_gpu_min_residency || is_pinned(quad.id));
+    };
+    std::unordered_map<tile::Id, bool, tile::Id::Hasher> needed_resident; // -> keep
+    m_gpu_cached.visit([this, &should_stay_refined, &needed_resident, &keep](const tile_types::GpuCacheInfo& quad) {
+        const auto needed = should_stay_refined(quad.id) && !is_hidden(quad.id);
+        if (needed)
+            needed_resident[quad.id] = keep(quad);
+        return needed;
+    });
 
-    m_gpu_cached.visit([&should_refine](const tile_types::GpuCacheInfo& quad) {
-        return should_refine(quad.id);
+    // over the budget, the needed quads with the largest benefit per cost are selected (select_gpu_quads). otherwise all of them.
+    const auto capacity = std::min<uint64_t>(m_gpu_quad_limit, m_gpu_byte_limit / std::max<uint64_t>(1, quad_n_bytes));
+    std::unordered_set<tile::Id, tile::Id::Hasher> selected;
+    if (needed_resident.size() + gpu_candidates.size() > capacity) {
+        selected = select_gpu_quads(needed_resident, gpu_candidates, unsigned(capacity));
+        const auto n_candidates = gpu_candidates.size();
+        std::erase_if(gpu_candidates, [&selected](const auto& quad) { return !selected.contains(quad.id); });
+        const auto n_kept = std::count_if(needed_resident.begin(), needed_resident.end(), [](const auto& r) { return r.second; });
+        if (gpu_candidates.size() < n_candidates && n_kept > 0)
+            schedule_update(); // the kept quads give way to the dropped candidates once their residency is over
+    } else {
+        for (const auto& [id, kept] : needed_resident)
+            selected.insert(id);
+        for (const auto& q : gpu_candidates)
+            selected.insert(q.id);
+    }
+    for (const auto& q : gpu_candidates)
+        m_gpu_cached.insert(tile_types::GpuCacheInfo { q.id, quad_n_bytes, now });
+    // the quads that are not needed any more go first, least recently needed first. the selected ones fit, unless the resident
+    // quads are larger than the new ones (e.g., after a change of the ortho compression)
+    const auto superfluous_quads = m_gpu_cached.purge(m_gpu_quad_limit, m_gpu_byte_limit, [&selected](const tile_types::GpuCacheInfo& quad) {
+        return selected.contains(quad.id);
     });
+    std::vector<tile::Id> deleted_ids;
+    deleted_ids.reserve(superfluous_quads.size() + m_replaced_gpu_quads.size());
+    for (const auto& quad : superfluous_quads) {
+        const auto candidate = !selected.contains(quad.id)
+            ? gpu_candidates.end()
+            : std::find_if(gpu_candidates.begin(), gpu_candidates.end(), [&quad](const auto& q) { return q.id == quad.id; });
+        if (candidate != gpu_candidates.end())
+            gpu_candidates.erase(candidate); // never sent
+        else
+            deleted_ids.push_back(quad.id);
+    }
+    deleted_ids.insert(deleted_ids.end(), m_replaced_gpu_quads.cbegin(), m_replaced_gpu_quads.cend()); // removed before the new ones are added
+    m_replaced_gpu_quads.clear();
+    if (gpu_candidates.empty()) {
+        publish_gpu_quads(std::make_shared<const std::vector<tile_types::GpuTileQuad>>(), std::move(deleted_ids));
+        report_gpu_completeness();
+        update_stats();
+        return;
+    }
 
-    const auto superfluous_quads = m_gpu_cached.purge(m_gpu_quad_limit);
+    if (m_asynchronous_decoding) {
+        // deleted quads are sent right away, the decoded ones follow batch by batch (finish_decode_batch)
+        auto warm_quads = std::make_shared<std::vector<tile_types::GpuTileQuad>>();
+        const auto batch_size = m_decode_batch_size == 0 ? size_t(m_decode_thread_count) : size_t(m_decode_batch_size);
+        std::shared_ptr<DecodeBatch> batch;
+        for (auto& quad : gpu_candidates) {
+            if (m_decoding.contains(quad.id))
+                continue; // evicted and selected again while its decode is pending
+            if (const auto* warm = find_warm_gpu_quad(quad)) {
+                warm_quads->push_back(*warm);
+                continue;
+            }
+            if (!batch)
+                batch = std::make_shared<DecodeBatch>();
+            m_decoding.insert(quad.id);
+            batch->quads.push_back(std::move(quad));
+            if (batch->quads.size() == batch_size)
+                start_decode_batch(std::move(batch));
+        }
+        if (batch)
+            start_decode_batch(std::move(batch));
+        publish_gpu_quads(warm_quads, std::move(deleted_ids));
+        report_gpu_completeness();
+        update_stats();
+        return;
+    }
+
+    // decoding is done in batches, each batch is emitted as soon as it is ready. deleted quads are sent with the first batch,
+    // so that the gpu has enough space for the new ones.
+    const auto batch_size = m_decode_batch_size == 0 ? gpu_candidates.size() : size_t(m_decode_batch_size);
+    for (size_t batch_start = 0; batch_start < gpu_candidates.size(); batch_start += batch_size) {
+        const auto batch_end = std::min(batch_start + batch_size, gpu_candidates.size());
+        auto new_gpu_quads_storage = std::make_shared<std::vector<tile_types::GpuTileQuad>>(batch_end - batch_start);
+        auto& new_gpu_quads = *new_gpu_quads_storage;
+        // quads that were on the gpu a moment ago are handed over as they are
+        std::vector<size_t> to_decode;
+        to_decode.reserve(batch_end - batch_start);
+        for (size_t i = batch_start; i < batch_end; ++i) {
+            if (const auto* warm = find_warm_gpu_quad(gpu_candidates[i]))
+                new_gpu_quads[i - batch_start] = *warm;
+            else
+                to_decode.push_back(i);
+        }
+        const auto settings = decode_settings();
+        if (m_decode_thread_count <= 1 || to_decode.size() <= 1) {
+            const nucleus::timing::TraceScope decode_trace("decode", "scheduler");
+            for (const auto i : to_decode)
+                new_gpu_quads[i - batch_start] = to_gpu_quad(gpu_candidates[i], settings);
+        } else {
+            const nucleus::timing::TraceScope decode_trace("decode", "scheduler");
+            for (const auto i : to_decode) {
+                m_decode_pool->start([this, &gpu_candidates, &new_gpu_quads, &settings, i, batch_start, policy = m_decode_thread_policy]() {
+                    policy.apply_to_current_thread();
+                    new_gpu_quads[i - batch_start] = to_gpu_quad(gpu_candidates[i], settings);
+                });
+            }
+            m_decode_pool->waitForDone();
+        }
+        for (const auto i : to_decode)
+            keep_warm_gpu_quad(gpu_candidates[i], new_gpu_quads[i - batch_start]);
+        if (m_latency_tracer->enabled()) {
+            std::vector<tile::Id> decoded_ids(new_gpu_quads.size());
+            std::transform(new_gpu_quads.begin(), new_gpu_quads.end(), decoded_ids.begin(), [](const auto& quad) { return quad.id; });
+            m_latency_tracer->mark(decoded_ids, LatencyTracer::Stage::Decoded);
+        }
+        publish_gpu_quads(new_gpu_quads_storage, std::move(deleted_ids)); // shared with the receivers, not copied
+        deleted_ids.clear();
+        for (size_t i = batch_start; i < batch_end; ++i) {
+            if (should_store_gpu_payload(gpu_candidates[i]))
+                store_gpu_payload(gpu_candidates[i], new_gpu_quads[i - batch_start]);
+        }
+    }
+    if (m_aabb_decorator->version() != m_aabb_version) {
+        // the decoded height rasters tightened the bounds, the next traversals evaluate the tiles again
+        m_aabb_version = m_aabb_decorator->version();
+        m_camera_traversal.reset();
+        m_view_traversals.clear();
+    }
+    report_gpu_completeness();
+    update_stats();
+}
+
+std::unordered_set<tile::Id, tile::Id::Hasher> Scheduler::select_gpu_quads(
+    const std::unordered_map<tile::Id, bool, tile::Id::Hasher>& resident, const std::vector<tile_types::TileQuad>& candidates, unsigned capacity) const
+{
+    // a quad replaces its parent's tile with four finer ones, which reduces the error on screen by a part of its screen space error.
+    // the cost is the memory (the same for all quads) and, for the candidates, the upload. a quad can only be drawn with its parent,
+    // so the selection grows from the roots: the best quad at the border of the selection is added, until the budget is used up.
+    // the errors of children are smaller than their parents', so this is the same as taking the best ones overall.
+    constexpr float upload_cost = 2.0f; // relative to the memory. also a hysteresis, a candidate replaces only a clearly worse quad
+    std::unordered_map<tile::Id, float, tile::Id::Hasher> priorities;
+    priorities.reserve(resident.size() + candidates.size());
+    for (const auto& [id, kept] : resident)
+        priorities[id] = kept ? std::numeric_limits<float>::infinity() : screen_space_error(id);
+    for (const auto& quad : candidates)
+        priorities[quad.id] = screen_space_error(quad.id) / upload_cost;
+
+    using Entry = std::pair<float, tile::Id>;
+    const auto lower_priority = [](const Entry& a, const Entry& b) { return a.first < b.first; };
+    std::vector<Entry> border;
+    for (const auto& [id, priority] : priorities) {
+        if (id.zoom_level == 0 || !priorities.contains(id.parent()))
+            border.emplace_back(priority, id);
+    }
+    std::make_heap(border.begin(), border.end(), lower_priority);
+    std::unordered_set<tile::Id, tile::Id::Hasher> selected;
+    selected.reserve(capacity);
+    while (!border.empty() && selected.size() < capacity) {
+        std::pop_heap(border.begin(), border.end(), lower_priority);
+        const auto id = border.back().second;
+        border.pop_back();
+        selected.insert(id);
+        for (const auto& child : id.children()) {
+            if (const auto it = priorities.find(child); it != priorities.end()) {
+                border.emplace_back(it->second, child);
+                std::push_heap(border.begin(), border.end(), lower_priority);
+            }
+        }
+    }
+    return selected;
+}
+
+struct Scheduler::DecodeBatch {
+    std::vector<tile_types::TileQuad> quads;
+    std::vector<tile_types::GpuTileQuad> gpu_quads;
+    std::atomic<size_t> n_pending = 0;
+    unsigned generation = 0; // see m_decode_generation
+    DecodeSettings settings; // read by the workers instead of the members, which the scheduler thread may change meanwhile
+};
 
-    // elimitate double entries (happens when the gpu has not enough space for all quads selected above)
-    std::unordered_set<tile::Id, tile::Id::Hasher> superfluous_ids;
-    superfluous_ids.reserve(superfluous_quads.size());
-    for (const auto& quad : superfluous_quads)
-        superfluous_ids.insert(quad.id);
+void Scheduler::start_decode_batch(std::shared_ptr<DecodeBatch> batch)
+{
+    batch->gpu_quads.resize(batch->quads.size());
+    batch->n_pending = batch->quads.size();
+    batch->generation = m_decode_generation;
+    batch->settings = decode_settings();
+    for (size_t i = 0; i < batch->quads.size(); ++i) {
+        m_decode_pool->start([this, batch, i, policy = m_decode_thread_policy]() {
+            policy.apply_to_current_thread();
+            batch->gpu_quads[i] = to_gpu_quad(batch->quads[i], batch->settings);
+            if (batch->n_pending.fetch_sub(1) == 1) // the last one hands the batch back to the scheduler's thread
+                QMetaObject::invokeMethod(this, [this, batch]() { finish_decode_batch(*batch); }, Qt::QueuedConnection);
+        });
+    }
+}
 
-    std::erase_if(gpu_candidates, [&superfluous_ids](const auto& quad) {
-        if (superfluous_ids.contains(quad.id)) {
-            superfluous_ids.erase(quad.id);
+void Scheduler::finish_decode_batch(DecodeBatch& batch)
+{
+    const nucleus::timing::TraceScope trace("finish_decode_batch", "scheduler");
+    const auto stale = batch.generation != m_decode_generation; // of the previous tile source, its quads were replaced
+    if (batch.settings.generation != m_format_generation) {
+        // decoded in a format that was changed meanwhile. neither sent nor kept warm, the quads that are still selected for
+        // the gpu are decoded again in the current format.
+        if (stale)
+            return;
+        auto again = std::make_shared<DecodeBatch>();
+        for (auto& quad : batch.quads) {
+            if (m_gpu_cached.contains(quad.id))
+                again->quads.push_back(std::move(quad));
+            else
+                m_decoding.erase(quad.id);
+        }
+        if (!again->quads.empty())
+            start_decode_batch(std::move(again));
+        report_gpu_completeness();
+        return;
+    }
+    auto new_gpu_quads = std::make_shared<std::vector<tile_types::GpuTileQuad>>();
+    new_gpu_quads->reserve(batch.quads.size());
+    std::vector<size_t> sent;
+    for (size_t i = 0; i < batch.quads.size(); ++i) {
+        const auto& quad = batch.quads[i];
+        if (!stale)
+            m_decoding.erase(quad.id);
+        keep_warm_gpu_quad(quad, batch.gpu_quads[i]);
+        // evicted while decoding (or released), its deletion was sent already. it's kept warm in case it comes back.
+        if (stale || !m_gpu_cached.contains(quad.id))
+            continue;
+        new_gpu_quads->push_back(batch.gpu_quads[i]);
+        sent.push_back(i);
+    }
+    if (m_latency_tracer->enabled()) {
+        std::vector<tile::Id> decoded_ids(new_gpu_quads->size());
+        std::transform(new_gpu_quads->begin(), new_gpu_quads->end(), decoded_ids.begin(), [](const auto& quad) { return quad.id; });
+        m_latency_tracer->mark(decoded_ids, LatencyTracer::Stage::Decoded);
+    }
+    if (!new_gpu_quads->empty())
+        publish_gpu_quads(new_gpu_quads, {});
+    for (const auto i : sent) {
+        if (should_store_gpu_payload(batch.quads[i]))
+            store_gpu_payload(batch.quads[i], batch.gpu_quads[i]);
+    }
+    if (m_aabb_decorator->version() != m_aabb_version) {
+        m_aabb_version = m_aabb_decorator->version();
+        m_camera_traversal.reset();
+        m_view_traversals.clear();
+    }
+    report_gpu_completeness();
+    update_stats();
+}
+
+namespace {
+// the warm entry stays valid while the ram cache quad holds the same payloads. labels count, they are decoded into the gpu quad.
+std::array<std::shared_ptr<QByteArray>, 12> warm_sources(const tile_types::TileQuad& quad)
+{
+    std::array<std::shared_ptr<QByteArray>, 12> sources;
+    for (unsigned i = 0; i < quad.n_tiles; ++i) {
+        sources[i * 3 + 0] = quad.tiles[i].ortho;
+        sources[i * 3 + 1] = quad.tiles[i].height;
+        sources[i * 3 + 2] = quad.tiles[i].labels;
+    }
+    return sources;
+}
+
+uint64_t n_bytes_of(const tile_types::GpuTileQuad& quad)
+{
+    uint64_t n_bytes = 0;
+    for (const auto& tile : quad.tiles) {
+        n_bytes += tile.ortho ? tile.ortho->n_bytes() : 0;
+        n_bytes += tile.height ? tile.height->buffer().size() * sizeof(uint16_t) : 0;
+        n_bytes += tile.normals ? tile.normals->buffer().size() * sizeof(glm::u8vec2) : 0;
+        n_bytes += tile.labels ? tile.labels->size() * sizeof(nucleus::label_tile::LabelRecord) : 0;
+    }
+    return n_bytes;
+}
+} // namespace
+
+const tile_types::GpuTileQuad* Scheduler::find_warm_gpu_quad(const tile_types::TileQuad& quad)
+{
+    ++m_statistics.n_warm_cache_lookups;
+    const auto* warm = m_warm_gpu_quads.find(quad.id);
+    if (!warm)
+        return nullptr;
+    const auto sources = warm_sources(quad);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        // a live weak pointer can't be to another array at the same address
+        if (warm->sources[i].lock() != sources[i]) {
+            m_warm_gpu_quads.erase(quad.id);
+            return nullptr;
+        }
+    }
+    ++m_statistics.n_warm_cache_hits;
+    return &warm->quad;
+}
+
+void Scheduler::keep_warm_gpu_quad(const tile_types::TileQuad& quad, const tile_types::GpuTileQuad& gpu_quad)
+{
+    const auto inherits = std::any_of(quad.tiles.begin(), quad.tiles.begin() + quad.n_tiles, [](const auto& t) { return t.ortho_inherited || t.height_inherited; });
+    if (inherits)
+        return;
+    WarmGpuQuad warm { gpu_quad, {} };
+    const auto sources = warm_sources(quad);
+    std::copy(sources.begin(), sources.end(), warm.sources.begin());
+    m_warm_gpu_quads.insert(quad.id, std::move(warm), n_bytes_of(gpu_quad));
+}
+
+void Scheduler::report_gpu_completeness()
+{
+    if (!isSignalConnected(QMetaMethod::fromSignal(&Scheduler::gpu_quads_complete)))
+        return;
+    const auto needed = tiles_for_current_camera_position();
+    if (std::all_of(needed.begin(), needed.end(), [this](const tile::Id& id) { return m_gpu_cached.contains(id) && !m_decoding.contains(id); }))
+        emit gpu_quads_complete(m_current_camera);
+}
+
+namespace {
+std::shared_ptr<const std::vector<nucleus::label_tile::LabelRecord>> decode_labels(const tile_types::LayeredTile& tile)
+{
+    if (!tile.labels || tile.labels->isEmpty())
+        return {};
+    auto labels = nucleus::label_tile::decode(*tile.labels);
+    if (!labels) {
+        qDebug() << "Scheduler: broken label tile" << tile.id.zoom_level << tile.id.coords.x << tile.id.coords.y << QString::fromStdString(labels.error());
+        return {};
+    }
+    if (labels->empty())
+        return {};
+    return std::make_shared<const std::vector<nucleus::label_tile::LabelRecord>>(std::move(*labels));
+}
+
+// precomputed for FEATURE_NORMAL_MODE 2 (see set_normal_maps), so the gbuffer pass reads them instead of taking differences every frame
+std::shared_ptr<const nucleus::Raster<glm::u8vec2>> compute_normals(const nucleus::Raster<uint16_t>& heights, const tile::SrsAndHeightBounds& bounds)
+{
+    return std::make_shared<const nucleus::Raster<glm::u8vec2>>(nucleus::utils::normal_map::compute(heights, tile::SrsBounds(bounds)));
+}
+
+// in metres, the height tiles store 1/8 m steps
+std::pair<float, float> height_range(const nucleus::Raster<uint16_t>& heights)
+{
+    const auto& buffer = heights.buffer();
+    if (buffer.empty())
+        return { 0.f, 0.f };
+    const auto [min, max] = std::minmax_element(buffer.begin(), buffer.end());
+    return { float(*min) * 0.125f, float(*max) * 0.125f };
+}
+
+// in metres, the largest deviation of the raster from its bilinear interpolation at half the resolution. an estimate of the
+// geometric error between the tile and a coarser one, small for lakes and valley floors (see utils::AabbDecorator::error_size).
+float raster_roughness(const nucleus::Raster<uint16_t>& heights)
+{
+    const auto width = unsigned(heights.width());
+    const auto height = unsigned(heights.height());
+    if (width < 3 || height < 3)
+        return -1.f;
+    const auto coarse = [](unsigned i, unsigned size) {
+        const auto i0 = i & ~1u;
+        const auto i1 = std::min(i0 + 2, (size - 1) & ~1u);
+        return std::tuple { i0, i1, i1 == i0 ? 0.f : float(i - i0) / float(i1 - i0) };
+    };
+    float deviation = 0;
+    for (unsigned y = 0; y < height; ++y) {
+        const auto [y0, y1, ty] = coarse(y, height);
+        for (unsigned x = 0; x < width; ++x) {
+            const auto [x0, x1, tx] = coarse(x, width);
+            const auto top = glm::mix(float(heights.pixel({ x0, y0 })), float(heights.pixel({ x1, y0 })), tx);
+            const auto bottom = glm::mix(float(heights.pixel({ x0, y1 })), float(heights.pixel({ x1, y1 })), tx);
+            deviation = std::max(deviation, std::abs(float(heights.pixel({ x, y })) - glm::mix(top, bottom, ty)));
+        }
+    }
+    return deviation * 0.125f;
+}
+} // namespace
+
+Scheduler::DecodeSettings Scheduler::decode_settings() const
+{
+    return { m_tile_format, m_ortho_tile_compression_algorithm, m_ortho_tile_mip_levels, m_normal_maps, m_default_ortho_tile, m_default_height_tile, m_format_generation };
+}
+
+tile_types::GpuTileQuad Scheduler::to_gpu_quad(const tile_types::TileQuad& quad, const DecodeSettings& settings) const
+{
+    const nucleus::timing::TraceScope trace("decode_quad", "scheduler");
+    const auto start = std::chrono::steady_clock::now();
+    // create GpuQuad based on cpu quad. called from the decode pool, therefore it must not touch mutable scheduler state
+    // (the format and default tiles come with the settings).
+    tile_types::GpuTileQuad gpu_quad;
+    gpu_quad.id = quad.id;
+    assert(quad.n_tiles == 4);
+    for (unsigned i = 0; i < 4; ++i) {
+        gpu_quad.tiles[i].id = quad.tiles[i].id;
+        gpu_quad.tiles[i].labels = decode_labels(quad.tiles[i]);
+        gpu_quad.tiles[i].inherited = quad.tiles[i].ortho_inherited || quad.tiles[i].height_inherited;
+
+        const auto& payload = quad.tiles[i].gpu;
+        if (payload && payload->ortho_format == settings.ortho_compression && payload->ortho_mip_levels == settings.ortho_mip_levels
+            && payload->ortho_width == settings.tile_format.ortho_size && payload->height_width == settings.tile_format.height_size) {
+            // transcoded in an earlier session
+            gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(
+                payload->ortho, payload->ortho_width, payload->ortho_height, payload->ortho_format, payload->ortho_mip_levels);
+            auto heightraster = nucleus::Raster<uint16_t>(glm::uvec2(payload->height_width, payload->height_height), nucleus::uninitialised);
+            assert(payload->height.size() == heightraster.buffer_length());
+            std::copy(payload->height.begin(), payload->height.end(), heightraster.begin());
+            gpu_quad.tiles[i].height = std::make_shared<nucleus::Raster<uint16_t>>(std::move(heightraster));
+            gpu_quad.tiles[i].bounds = tighten_bounds(quad.tiles[i].id, *gpu_quad.tiles[i].height);
+            if (settings.normal_maps)
+                gpu_quad.tiles[i].normals = compute_normals(*gpu_quad.tiles[i].height, gpu_quad.tiles[i].bounds);
+            continue;
+        }
+
+        // layers with a coarser level of detail are cut out of the closest ancestor that has them (see layers_for_tile)
+        const auto decode_height = [this, &settings](const std::shared_ptr<QByteArray>& data) {
+            return memoised_decode(m_decode_memo_mutex, m_height_memo, data, settings.generation, [&]() {
+                return std::make_shared<const nucleus::Raster<uint16_t>>(nucleus::utils::tile_conversion::decode_height(*data));
+            });
+        };
+        if (quad.tiles[i].ortho_inherited || quad.tiles[i].height_inherited) {
+            const auto snapshot = ram_cache().snapshot(); // published by update_gpu_quads
+            const auto& id = quad.tiles[i].id;
+            if (quad.tiles[i].ortho_inherited) {
+                const auto source = ancestor_layer(*snapshot, id, &tile_types::LayeredTile::ortho, &tile_types::LayeredTile::ortho_inherited);
+                if (source && !nucleus::utils::ktx2::is_ktx2(*source->second)) { // compressed blocks can't be cropped, the default tile is used instead
+                    const auto image = crop_ortho(decode_with_thread_buffer(*source->second), sub_tile(source->first, id), settings.tile_format.ortho_size);
+                    gpu_quad.tiles[i].ortho = std::make_shared<const nucleus::utils::ColourTexture>(image, settings.ortho_compression, settings.ortho_mip_levels);
+                }
+            }
+            if (quad.tiles[i].height_inherited) {
+                if (const auto source = ancestor_layer(*snapshot, id, &tile_types::LayeredTile::height, &tile_types::LayeredTile::height_inherited))
+                    gpu_quad.tiles[i].height = std::make_shared<const nucleus::Raster<uint16_t>>(crop_height(*decode_height(source->second), sub_tile(source->first, id)));
+            }
+        }
+
+        // unpacking the byte data takes long
+        if (!gpu_quad.tiles[i].ortho) {
+            const auto& ortho_data = quad.tiles[i].ortho->size() ? quad.tiles[i].ortho : settings.default_ortho_tile;
+            gpu_quad.tiles[i].ortho = memoised_decode(m_decode_memo_mutex, m_ortho_memo, ortho_data, settings.generation, [&]() {
+                if (nucleus::utils::ktx2::is_ktx2(*ortho_data)) {
+                    // precompressed on the server, used as is if it's in the format of the gpu and has the mip chain
+                    auto texture = nucleus::utils::ktx2::to_colour_texture(*ortho_data, settings.ortho_mip_levels);
+                    if (texture && texture->format() == settings.ortho_compression && texture->n_mip_levels() == settings.ortho_mip_levels
+                        && texture->width() == settings.tile_format.ortho_size && texture->height() == settings.tile_format.ortho_size)
+                        return std::make_shared<const nucleus::utils::ColourTexture>(std::move(*texture));
+                    qDebug() << "Scheduler: unusable ktx2 ortho tile" << quad.tiles[i].id.zoom_level << quad.tiles[i].id.coords.x << quad.tiles[i].id.coords.y
+                             << (texture ? QString("(format or size doesn't match)") : QString::fromStdString(texture.error()));
+                    return std::make_shared<const nucleus::utils::ColourTexture>(
+                        decode_with_thread_buffer(*settings.default_ortho_tile), settings.ortho_compression, settings.ortho_mip_levels);
+                }
+                if (settings.ortho_compression != nucleus::utils::ColourTexture::Format::Uncompressed_RGBA) {
+                    // decoded and compressed strip by strip, falls back to the full image for odd sizes
+                    auto texture = nucleus::utils::jpeg_transcoder::to_colour_texture(*ortho_data, settings.ortho_compression, settings.tile_format.ortho_size, settings.ortho_mip_levels);
+                    if (texture)
+                        return std::make_shared<const nucleus::utils::ColourTexture>(std::move(*texture));
+                }
+                thread_local QImage image;
+                nucleus::utils::tile_conversion::decode_ortho_into(*ortho_data, settings.tile_format.ortho_size, &image);
+                return std::make_shared<const nucleus::utils::ColourTexture>(image, settings.ortho_compression, settings.ortho_mip_levels);
+            });
+        }
+
+        if (gpu_quad.tiles[i].height) {
+            gpu_quad.tiles[i].bounds = tighten_bounds(quad.tiles[i].id, *gpu_quad.tiles[i].height); // cropped from an ancestor
+        } else if (quad.tiles[i].height->size()) {
+            gpu_quad.tiles[i].height = decode_height(quad.tiles[i].height);
+            gpu_quad.tiles[i].bounds = tighten_bounds(quad.tiles[i].id, *gpu_quad.tiles[i].height);
+        } else {
+            gpu_quad.tiles[i].height = decode_height(settings.default_height_tile); // says nothing about the terrain
+            gpu_quad.tiles[i].bounds = m_aabb_decorator->aabb(quad.tiles[i].id);
+        }
+        if (settings.normal_maps)
+            gpu_quad.tiles[i].normals = compute_normals(*gpu_quad.tiles[i].height, gpu_quad.tiles[i].bounds);
+    }
+    gpu_quad.decode_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return gpu_quad;
+}
+
+tile::SrsAndHeightBounds Scheduler::tighten_bounds(const tile::Id& id, const nucleus::Raster<uint16_t>& heights) const
+{
+    const auto [min, max] = height_range(heights);
+    m_aabb_decorator->set_exact_heights(id, min, max, raster_roughness(heights));
+    return m_aabb_decorator->aabb(id);
+}
+
+bool Scheduler::should_store_gpu_payload(const tile_types::TileQuad& quad) const
+{
+    if (!m_gpu_payload_caching || m_ortho_tile_compression_algorithm == nucleus::utils::ColourTexture::Format::Uncompressed_RGBA)
+        return false;
+    for (unsigned i = 0; i < quad.n_tiles; ++i) {
+        const auto& tile = quad.tiles[i];
+        const auto has_data = tile.ortho && !tile.ortho->isEmpty() && tile.height && !tile.height->isEmpty(); // defaults are not stored
+        if (has_data
+            && (!tile.gpu || tile.gpu->ortho_format != m_ortho_tile_compression_algorithm || tile.gpu->ortho_mip_levels != m_ortho_tile_mip_levels
+                || tile.gpu->ortho_width != m_tile_format.ortho_size || tile.gpu->height_width != m_tile_format.height_size))
+            return true;
+    }
+    return false;
+}
+
+void Scheduler::store_gpu_payload(tile_types::TileQuad quad, const tile_types::GpuTileQuad& gpu_quad)
+{
+    for (unsigned i = 0; i < quad.n_tiles; ++i) {
+        auto& tile = quad.tiles[i];
+        const auto& gpu_tile = gpu_quad.tiles[i];
+        if (!tile.ortho || tile.ortho->isEmpty() || !tile.height || tile.height->isEmpty() || !gpu_tile.ortho || !gpu_tile.height)
+            continue;
+        auto payload = std::make_shared<tile_types::GpuTilePayload>();
+        payload->ortho_format = gpu_tile.ortho->format();
+        payload->ortho_width = gpu_tile.ortho->width();
+        payload->ortho_height = gpu_tile.ortho->height();
+        payload->ortho_mip_levels = gpu_tile.ortho->n_mip_levels();
+        payload->ortho.assign(gpu_tile.ortho->data(), gpu_tile.ortho->data() + gpu_tile.ortho->n_bytes());
+        payload->height_width = unsigned(gpu_tile.height->width());
+        payload->height_height = unsigned(gpu_tile.height->height());
+        payload->height.assign(gpu_tile.height->begin(), gpu_tile.height->end());
+        tile.gpu = std::move(payload);
+    }
+    ram_cache().replace(quad);
+    schedule_persist();
+}
+
+void Scheduler::send_quad_requests()
+{
+    if (!m_network_requests_enabled || m_suspended)
+        return;
+    const auto current_time = m_clock();
+    if (auto& missing = m_sources[m_tile_source]->missing; !missing.empty() && current_time > m_retirement_age_for_tile_cache) {
+        std::scoped_lock lock(m_missing_quads_mutex);
+        missing.retire(current_time - m_retirement_age_for_tile_cache); // asked for again, like retired quads in the ram cache
+    }
+    auto currently_active_tiles = tiles_for_current_camera_position();
+    bool needs_disk = false;
+    std::vector<tile::Id> from_base_pack;
+    const auto is_available = [this, current_time, &needs_disk, &from_base_pack](const tile::Id& id) {
+        if (ram_cache().is_pending_from_pack(id)) {
+            needs_disk = true;
+            return true; // will be loaded from disk shortly
+        }
+        if (!ram_cache().contains(id)) {
+            if (m_tile_source != 0 || !m_base_pack || !m_base_pack->index().contains(id))
+                return false;
+            from_base_pack.push_back(id); // purged, the base pack is closer than the network. outdated ones are requested next time
             return true;
         }
+        const auto& quad = ram_cache().peak_at(id);
+        if (quad.network_info().timestamp + m_retirement_age_for_tile_cache <= current_time)
+            return false;
+        // a layer that was inherited might be needed now
+        const auto inherits = std::any_of(quad.tiles.begin(), quad.tiles.begin() + quad.n_tiles, [](const auto& t) { return t.ortho_inherited || t.height_inherited; });
+        if (!inherits)
+            return true;
+        const auto layers = layers_for_tile(quad.tiles[0].id);
+        return std::none_of(quad.tiles.begin(), quad.tiles.begin() + quad.n_tiles, [&layers](const auto& t) {
+            return (t.ortho_inherited && layers.ortho) || (t.height_inherited && layers.height);
+        });
+    };
+    m_statistics.n_ram_cache_lookups += currently_active_tiles.size();
+    m_statistics.n_ram_cache_hits += std::erase_if(currently_active_tiles, is_available);
+    // pending quads are loaded on demand, the disk tier may hold many more than fit into ram
+    if (needs_disk && !m_disk_load_timer->isActive())
+        m_disk_load_timer->start(0);
+    // the limiters keep the order, so the most important quads are fetched first (see utils::screen_space_error_functor)
+    const auto screen_space_error = [this](const tile::Id& id) { return this->screen_space_error(id); };
+    // on metered connections the network gets only the coarser quads, the cached ones above are kept
+    const auto& policy = network_policy();
+    const auto min_request_error = m_permissible_screen_space_error * policy.error_factor;
+    // tiles hidden behind terrain (as reported by the renderer) come last
+    std::vector<tile_types::QuadRequest> requests;
+    requests.reserve(currently_active_tiles.size());
+    for (const auto& id : currently_active_tiles) {
+        const auto error = screen_space_error(id);
+        if (id.zoom_level + 1 > policy.max_zoom_level || (policy.error_factor > 1.0f && error < min_request_error))
+            continue;
+        requests.push_back({ id, is_occluded(id) ? tile_types::QuadRequest::Tier::Occluded : tile_types::QuadRequest::Tier::Visible, error });
+    }
+    std::sort(requests.begin(), requests.end(), tile_types::QuadRequest::Before {});
+
+    std::unordered_set<tile::Id, tile::Id::Hasher> requested;
+    const auto prefetch_budget = policy.prefetch ? m_prefetch_budget : 0u;
+    if (prefetch_budget > 0 || !m_pinned_quad_list.empty() || !m_requested_quads.empty())
+        requested.insert(currently_active_tiles.begin(), currently_active_tiles.end());
+    if (prefetch_budget > 0) {
+        unsigned n_prefetched = 0;
+        for (const auto& camera : predicted_cameras()) {
+            auto predicted_tiles = tiles_for_camera(camera);
+            std::stable_sort(predicted_tiles.begin(), predicted_tiles.end(), [](const tile::Id& a, const tile::Id& b) { return a.zoom_level < b.zoom_level; });
+            for (const auto& id : predicted_tiles) {
+                if (n_prefetched >= prefetch_budget)
+                    break;
+                if (requested.contains(id) || is_available(id))
+                    continue;
+                requested.insert(id);
+                requests.push_back({ id, tile_types::QuadRequest::Tier::Prefetch, 0.f });
+                ++n_prefetched;
+            }
+        }
+    }
+    // pinned quads are loaded whether a view needs them or not, after the others
+    for (const auto& id : m_pinned_quad_list) {
+        if (requested.contains(id) || missing_quads().contains(id) || is_available(id))
+            continue;
+        requested.insert(id);
+        requests.push_back({ id, tile_types::QuadRequest::Tier::Prefetch, 0.f });
+    }
+    // one-off requests, forgotten once they are available
+    std::erase_if(m_requested_quads, [&](const tile::Id& id) { return missing_quads().contains(id) || is_available(id); });
+    for (const auto& id : m_requested_quads) {
+        if (requested.insert(id).second)
+            requests.push_back({ id, tile_types::QuadRequest::Tier::Prefetch, 0.f });
+    }
+    // the network is idle: the view is loaded and the camera at rest
+    const auto at_rest_for = current_time - std::min(current_time, m_last_camera_update);
+    const auto ram_has_room = float(ram_cache().n_cached_objects()) < float(m_ram_quad_limit) * m_idle_prefetch.ram_fraction
+        && double(ram_cache().n_bytes()) < double(m_ram_byte_limit) * double(m_idle_prefetch.ram_fraction);
+    if (policy.prefetch && m_idle_prefetch.max_quads > 0 && requests.empty() && at_rest_for >= m_idle_prefetch.delay && ram_has_room) {
+        unsigned n_in_flight = 0;
+        for (const auto& id : m_idle_prefetched) {
+            if (missing_quads().contains(id) || is_available(id))
+                continue;
+            requested.insert(id);
+            requests.push_back({ id, tile_types::QuadRequest::Tier::Idle, 0.f });
+            ++n_in_flight;
+        }
+        for (const auto& camera : idle_prefetch_cameras()) {
+            auto idle_tiles = tiles_for_camera(camera);
+            std::stable_sort(idle_tiles.begin(), idle_tiles.end(), [](const tile::Id& a, const tile::Id& b) { return a.zoom_level < b.zoom_level; });
+            for (const auto& id : idle_tiles) {
+                if (n_in_flight >= m_idle_prefetch.max_in_flight || m_idle_prefetched.size() >= m_idle_prefetch.max_quads)
+                    break;
+                if (requested.contains(id) || m_idle_prefetched.contains(id) || is_available(id))
+                    continue;
+                requested.insert(id);
+                m_idle_prefetched.insert(id);
+                requests.push_back({ id, tile_types::QuadRequest::Tier::Idle, 0.f });
+                ++n_in_flight;
+            }
+        }
+    } else if (policy.prefetch && m_idle_prefetch.max_quads > 0 && at_rest_for < m_idle_prefetch.delay) {
+        m_idle_prefetch_timer->start(int(m_idle_prefetch.delay - at_rest_for)); // the update after the delay starts it
+    }
+
+    // after all lookups, the prefetched and requested ones may be in the base pack as well
+    load_from_base_pack(from_base_pack);
+
+    currently_active_tiles.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i)
+        currently_active_tiles[i] = requests[i].id;
+    emit quads_requested(currently_active_tiles);
+    emit_request_diff(requests);
+}
+
+void Scheduler::request_quads(const std::vector<tile::Id>& quads)
+{
+    std::unordered_set<tile::Id, tile::Id::Hasher> known(m_requested_quads.begin(), m_requested_quads.end());
+    for (const auto& id : quads) {
+        if (known.insert(id).second)
+            m_requested_quads.push_back(id);
+    }
+    schedule_update();
+}
+
+void Scheduler::cancel_idle_prefetch()
+{
+    m_idle_prefetched.clear();
+    m_idle_prefetch_timer->stop();
+    // removed from the limiters right away, the next update may be postponed during camera motion
+    tile_types::QuadRequestDiff diff;
+    for (const auto& [id, request] : m_sent_requests) {
+        if (request.tier == tile_types::QuadRequest::Tier::Idle)
+            diff.removed.push_back(id);
+    }
+    if (diff.empty())
+        return;
+    for (const auto& id : diff.removed)
+        m_sent_requests.erase(id);
+    emit quad_requests_changed(diff);
+}
+
+void Scheduler::emit_request_diff(const std::vector<tile_types::QuadRequest>& requests)
+{
+    // small changes of the screen space error (camera motion) don't reorder the queue of the limiter noticeably
+    const auto changed = [](const tile_types::QuadRequest& a, const tile_types::QuadRequest& b) {
+        return a.tier != b.tier || std::abs(a.screen_space_error - b.screen_space_error) > 0.25f * std::max(a.screen_space_error, b.screen_space_error);
+    };
+    tile_types::QuadRequestDiff diff;
+    std::vector<tile::Id> new_ids;
+    std::unordered_map<tile::Id, tile_types::QuadRequest, tile::Id::Hasher> sent;
+    sent.reserve(requests.size());
+    for (const auto& request : requests) {
+        const auto previous = m_sent_requests.find(request.id);
+        if (previous == m_sent_requests.end())
+            new_ids.push_back(request.id);
+        if (previous == m_sent_requests.end() || changed(previous->second, request)) {
+            diff.added.push_back(request);
+            sent[request.id] = request;
+        } else {
+            sent[request.id] = previous->second; // the limiter has this one, small changes accumulate until they are sent
+        }
+    }
+    for (const auto& [id, request] : m_sent_requests) {
+        if (!sent.contains(id))
+            diff.removed.push_back(id);
+    }
+    m_sent_requests = std::move(sent);
+    m_latency_tracer->mark(new_ids, LatencyTracer::Stage::Requested);
+    if (!diff.empty())
+        emit quad_requests_changed(diff);
+}
+
+std::vector<nucleus::camera::Definition> Scheduler::predicted_cameras() const
+{
+    std::vector<camera::Definition> cameras;
+    if (m_prefetch_target)
+        cameras.push_back(*m_prefetch_target);
+    const auto now = m_clock();
+    if (glm::length(m_camera_velocity) > 0 && now - std::min(now, m_last_camera_update) < camera_rest_msecs) {
+        auto camera = m_current_camera;
+        camera.move(m_camera_velocity * double(m_prefetch_horizon));
+        cameras.push_back(camera);
+    }
+    return cameras;
+}
+
+std::vector<nucleus::camera::Definition> Scheduler::idle_prefetch_cameras() const
+{
+    // the ring: a wider field of view at the same resolution. the centre: half the field of view on the same viewport, which
+    // doubles the pixels per metre, and so refines the tiles there by one more level.
+    const auto fov = double(m_current_camera.field_of_view());
+    const auto ring_fov = std::min(160.0, fov * double(m_idle_prefetch.ring_factor));
+    const auto scale = std::tan(glm::radians(ring_fov) / 2) / std::tan(glm::radians(fov) / 2);
+    auto ring = m_current_camera;
+    ring.set_perspective_params(float(ring_fov), glm::uvec2(glm::dvec2(m_current_camera.viewport_size()) * scale), m_current_camera.near_plane());
+    auto centre = m_current_camera;
+    centre.set_field_of_view(float(fov / 2));
+    return { centre, ring };
+}
+
+void Scheduler::set_prefetch_target(const camera::Definition& camera)
+{
+    m_prefetch_target = camera;
+    schedule_update();
+}
+
+void Scheduler::set_occluded_tiles(const std::vector<tile::Id>& tiles)
+{
+    m_occluded_tiles.clear();
+    m_occluded_tiles.insert(tiles.begin(), tiles.end());
+}
+
+void Scheduler::set_hidden_quads(const std::vector<tile::Id>& quads)
+{
+    m_hidden_quads.clear();
+    m_hidden_quads.insert(quads.begin(), quads.end());
+}
+
+bool Scheduler::is_hidden(tile::Id id) const
+{
+    // like the occlusion, the visibility is reported for the main camera only
+    if (m_hidden_quads.empty() || !m_view_cameras.empty())
         return false;
-    });
+    while (true) {
+        if (m_hidden_quads.contains(id))
+            return true;
+        if (id.zoom_level == 0)
+            return false;
+        id = id.parent();
+    }
+}
+
+bool Scheduler::is_occluded(tile::Id id) const
+{
+    if (is_hidden(id))
+        return true;
+    // the occlusion is reported for the main camera, the tile might be visible in another view
+    if (m_occluded_tiles.empty() || !m_view_cameras.empty())
+        return false;
+    while (true) {
+        if (m_occluded_tiles.contains(id))
+            return true;
+        if (id.zoom_level == 0)
+            return false;
+        id = id.parent();
+    }
+}
+
+void Scheduler::set_prefetch_budget(unsigned int new_prefetch_budget)
+{
+    m_prefetch_budget = new_prefetch_budget;
+}
+
+void Scheduler::set_prefetch_horizon(unsigned int new_prefetch_horizon)
+{
+    m_prefetch_horizon = new_prefetch_horizon;
+}
+
+void Scheduler::set_idle_prefetch(const IdlePrefetch& new_idle_prefetch)
+{
+    m_idle_prefetch = new_idle_prefetch;
+    schedule_update();
+}
+
+void Scheduler::purge_ram_cache()
+{
+    // 5% tolerance, saturating (the byte limit defaults to the max, i.e., no limit)
+    const auto byte_threshold = m_ram_byte_limit + std::min(m_ram_byte_limit / 20, std::numeric_limits<uint64_t>::max() - m_ram_byte_limit);
+    if (ram_cache().n_cached_objects() <= unsigned(float(m_ram_quad_limit) * 1.05f) && ram_cache().n_bytes() <= byte_threshold) {
+        return;
+    }
+
+    const nucleus::timing::TraceScope trace("purge", "scheduler");
+    const auto should_refine = refine_functor(m_permissible_screen_space_error * m_refinement_hysteresis);
+    ram_cache().visit(
+        [&should_refine](const tile_types::TileQuad& quad) { return should_refine(quad.id); });
+    ram_cache().purge(m_ram_quad_limit, m_ram_byte_limit, [this](const tile_types::TileQuad& quad) { return is_pinned(quad.id); });
+    ram_cache().publish_snapshot();
+    update_stats();
+}
 
-    std::vector<tile_types::GpuTileQuad> new_gpu_quads;
-    new_gpu_quads.reserve(gpu_candidates.size());
-    std::transform(gpu_candidates.cbegin(),
-                   gpu_candidates.cend(),
-                   std::back_inserter(new_gpu_quads),
-                   [this](const auto& quad) {
-                       // create GpuQuad based on cpu quad
-                       tile_types::GpuTileQuad gpu_quad;
-                       gpu_quad.id = quad.id;
-                       assert(quad.n_tiles == 4);
-                       for (unsigned i = 0; i < 4; ++i) {
-                           gpu_quad.tiles[i].id = quad.tiles[i].id;
-                           gpu_quad.tiles[i].bounds = m_aabb_decorator->aabb(quad.tiles[i].id);
-
-                           // unpacking the byte data takes long
-                           const auto* ortho_data = m_default_ortho_tile.get();
-                           if (quad.tiles[i].ortho->size()) {
-                               ortho_data = quad.tiles[i].ortho.get();
-                           }
-                           const auto ortho_qimage = nucleus::utils::tile_conversion::toQImage(*ortho_data);
-                           gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(ortho_qimage, m_ortho_tile_compression_algorithm);
-
-                           const auto* height_data = m_default_height_tile.get();
-                           if (quad.tiles[i].height->size()) {
-                               height_data = quad.tiles[i].height.get();
-                           }
-                           auto heightraster = nucleus::utils::tile_conversion::qImage2uint16Raster(nucleus::utils::tile_conversion::toQImage(*height_data));
-                           gpu_quad.tiles[i].height = std::make_shared<nucleus::Raster<uint16_t>>(
-                               std::move(heightraster));
-                       }
-                       return gpu_quad;
-                   });
-
-    emit gpu_quads_updated(new_gpu_quads, { superfluous_ids.cbegin(), superfluous_ids.cend() });
+void Scheduler::handle_memory_pressure()
+{
+    // flush first, so that the purged quads can be restored from disk instead of the network
+    m_persistence_used = true;
+    flush_disk_cache();
+    for (auto& source : m_sources) {
+        const auto current = &source->ram == &ram_cache();
+        if (current)
+            source->ram.purge(std::min(m_ram_low_water_mark, m_ram_quad_limit), std::numeric_limits<uint64_t>::max(), [this](const tile_types::TileQuad& quad) { return is_pinned(quad.id); });
+        else
+            source->ram.purge(0);
+        source->ram.publish_snapshot();
+    }
+    m_warm_gpu_quads.clear();
+    qDebug() << QString("Scheduler::handle_memory_pressure: ram cache purged to %1 quads.").arg(ram_cache().n_cached_objects());
     update_stats();
 }
 
-void Scheduler::send_quad_requests()
+void Scheduler::set_request_slot_count(unsigned new_request_slot_count)
 {
-    if (!m_network_requests_enabled)
-        return;
-    auto currently_active_tiles = tiles_for_current_camera_position();
-    const auto current_time = utils::time_since_epoch();
-    std::erase_if(currently_active_tiles, [this, current_time](const tile::Id& id) {
-        return m_ram_cache.contains(id) && m_ram_cache.peak_at(id).network_info().timestamp + m_retirement_age_for_tile_cache > current_time;
-    });
-    emit quads_requested(currently_active_tiles);
+    m_statistics.n_request_slots = new_request_slot_count;
+    update_stats();
 }
 
-void Scheduler::purge_ram_cache()
+void Scheduler::set_suspended(bool new_suspended)
 {
-    if (m_ram_cache.n_cached_objects() <= unsigned(float(m_ram_quad_limit) * 1.05f)){
+    if (m_suspended == new_suspended)
+        return;
+    m_suspended = new_suspended;
+    if (!m_suspended) {
+        schedule_update();
         return;
     }
-
-    const auto should_refine = tile_scheduler::utils::refineFunctor(m_current_camera, m_aabb_decorator, m_permissible_screen_space_error, m_ortho_tile_size);
-    m_ram_cache.visit(
-        [&should_refine](const tile_types::TileQuad& quad) { return should_refine(quad.id); });
-    m_ram_cache.purge(m_ram_quad_limit);
-    update_stats();
+    handle_memory_pressure();
+    if (m_release_gpu_when_suspended) {
+        const auto released = m_gpu_cached.purge(0);
+        std::vector<tile::Id> released_ids;
+        released_ids.reserve(released.size());
+        for (const auto& quad : released)
+            released_ids.push_back(quad.id);
+        released_ids.insert(released_ids.end(), m_replaced_gpu_quads.cbegin(), m_replaced_gpu_quads.cend());
+        m_replaced_gpu_quads.clear();
+        publish_gpu_quads(std::make_shared<const std::vector<tile_types::GpuTileQuad>>(), std::move(released_ids));
+        update_stats();
+    }
 }
 
 void Scheduler::persist_tiles()
 {
+    m_persistence_used = true;
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING)
+    flush_disk_cache();
+#else
+    if (m_persist_queued.exchange(true))
+        return; // the queued write will pick up the latest changes
+    m_io_pool->start([this, policy = m_io_thread_policy]() {
+        policy.apply_to_current_thread();
+        m_persist_queued = false;
+        write_disk_cache();
+    });
+#endif
+}
+
+void Scheduler::flush_disk_cache()
+{
+    m_io_pool->waitForDone();
+    write_disk_cache();
+}
+
+void Scheduler::write_disk_cache()
+{
+    const nucleus::timing::TraceScope trace("persist", "scheduler");
     const auto start = std::chrono::steady_clock::now();
-    const auto r = m_ram_cache.write_to_disk(disk_cache_path());
+    tl::expected<void, std::string> r;
+    std::filesystem::path failed_path;
+    for (unsigned i = 0; i < m_sources.size() && r.has_value(); ++i) {
+        // the others were not used since the start
+        if (i != m_tile_source && !m_sources[i]->pack_opened)
+            continue;
+        r = m_sources[i]->ram.persist(disk_cache_path(i));
+        failed_path = disk_cache_path(i);
+        if (r.has_value()) {
+            std::scoped_lock lock(m_missing_quads_mutex); // a few intervals, quick to write
+            r = m_sources[i]->missing.write_to_file(missing_quads_path(i));
+            failed_path = missing_quads_path(i);
+        }
+    }
     const auto diff = std::chrono::steady_clock::now() - start;
+    const auto msecs = std::chrono::duration<float, std::milli>(diff).count();
+    m_last_persist_msecs = msecs;
+    // single writer (the io pool has one thread), no compare exchange needed
+    m_max_persist_msecs = std::max(m_max_persist_msecs.load(), msecs);
+    ++m_n_persists;
 
     if (diff > std::chrono::milliseconds(50))
-        qDebug() << QString("Scheduler::persist_tiles took %1ms for %2 quads.")
+        qDebug() << QString("Scheduler::write_disk_cache took %1ms for %2 quads.")
                         .arg(std::chrono::duration_cast<std::chrono::milliseconds>(diff).count())
-                        .arg(m_ram_cache.n_cached_objects());
+                        .arg(ram_cache().n_cached_objects());
 
     if (!r.has_value()) {
         qDebug() << QString("Writing tiles to disk into %1 failed: %2. Removing all files.")
-                        .arg(QString::fromStdString(disk_cache_path().string()))
+                        .arg(QString::fromStdString(failed_path.string()))
                         .arg(QString::fromStdString(r.error()));
-        std::filesystem::remove_all(disk_cache_path());
+        std::filesystem::remove_all(failed_path);
     }
 }
 
@@ -244,6 +1393,48 @@ void Scheduler::schedule_update()
         m_update_timer->start(int(m_update_timeout));
 }
 
+void Scheduler::publish_gpu_quads(tile_types::GpuTileQuadBatch new_quads, std::vector<tile::Id> deleted_quads)
+{
+    if (!m_gpu_quad_mailbox) {
+        emit gpu_quads_updated(new_quads, deleted_quads);
+        return;
+    }
+    m_gpu_quad_mailbox->push({ std::move(new_quads), std::move(deleted_quads) });
+    m_gpu_quad_mailbox->wake_up();
+}
+
+void Scheduler::schedule_camera_update(bool camera_was_at_rest)
+{
+    if (!m_adaptive_update_cadence) {
+        schedule_update();
+        return;
+    }
+    if (!m_enabled)
+        return;
+    m_settle_timer->start(int(camera_rest_msecs));
+    if (camera_was_at_rest) {
+        m_update_timer->start(0); // still through the event loop, so that changes of the same batch are collected
+        return;
+    }
+    const auto now = m_clock();
+    const auto since_last_update = now - std::min(now, m_last_update);
+    const auto interval = camera_update_interval();
+    const auto wait = int(interval - std::min<uint64_t>(interval, since_last_update));
+    // a faster camera can bring the pending update forward, but doesn't postpone it
+    if (!m_update_timer->isActive() || m_update_timer->remainingTime() > wait)
+        m_update_timer->start(wait);
+}
+
+unsigned Scheduler::camera_update_interval() const
+{
+    // the screen space errors change with the distance to the terrain, the altitude of the camera is a cheap stand-in for it.
+    // at rest (or only rotating) the update timeout, with every altitude per second a quarter of that.
+    const auto altitude = std::max(100.0, std::abs(m_current_camera.position().z));
+    const auto altitudes_per_second = glm::length(m_camera_velocity) * 1000.0 / altitude;
+    const auto interval = double(m_update_timeout) / (1.0 + 4.0 * altitudes_per_second);
+    return unsigned(std::clamp(interval, double(std::min(m_min_update_interval, m_update_timeout)), double(m_update_timeout)));
+}
+
 void Scheduler::schedule_purge()
 {
     assert(m_purge_timeout < unsigned(std::numeric_limits<int>::max()));
@@ -262,40 +1453,308 @@ void Scheduler::schedule_persist()
 
 void Scheduler::update_stats()
 {
-    m_statistics.n_tiles_in_ram_cache = m_ram_cache.n_cached_objects();
+    // of all tile sources
+    m_statistics.n_tiles_in_ram_cache = 0;
+    m_statistics.n_bytes_in_ram_cache = 0;
+    m_statistics.n_tiles_in_disk_cache = 0;
+    m_statistics.n_bytes_in_disk_cache = 0;
+    for (const auto& source : m_sources) {
+        m_statistics.n_tiles_in_ram_cache += source->ram.n_cached_objects();
+        m_statistics.n_bytes_in_ram_cache += source->ram.n_bytes();
+        m_statistics.n_tiles_in_disk_cache += source->ram.n_disk_cached_objects();
+        m_statistics.n_bytes_in_disk_cache += source->ram.n_disk_bytes();
+    }
     m_statistics.n_tiles_in_gpu_cache = m_gpu_cached.n_cached_objects();
+    m_statistics.n_bytes_in_gpu_cache = m_gpu_cached.n_bytes();
+    m_statistics.n_tiles_in_warm_cache = m_warm_gpu_quads.size();
+    m_statistics.n_bytes_in_warm_cache = m_warm_gpu_quads.n_bytes();
+    m_statistics.n_persists = m_n_persists;
+    m_statistics.last_persist_msecs = m_last_persist_msecs;
+    m_statistics.max_persist_msecs = m_max_persist_msecs;
+    if (m_latency_tracer->n_finished() != m_latency_report_version) {
+        m_latency_report_version = m_latency_tracer->n_finished();
+        m_statistics.tile_latency = m_latency_tracer->report();
+    }
     emit statistics_updated(m_statistics);
 }
 
 void Scheduler::read_disk_cache()
 {
-    const auto r = m_ram_cache.read_from_disk(disk_cache_path());
+    read_missing_quads(m_tile_source);
+    m_disk_cache_opened = true;
+    m_sources[m_tile_source]->pack_opened = true;
+    const auto path = disk_cache_path(m_tile_source);
+    const auto r = ram_cache().restore(path);
+    ram_cache().publish_snapshot();
     if (r.has_value()) {
         update_stats();
     } else {
         qDebug() << QString("Reading tiles from disk cache (%1) failed: \n%2\nRemoving all files.")
-                        .arg(QString::fromStdString(disk_cache_path().string()))
+                        .arg(QString::fromStdString(path.string()))
                         .arg(QString::fromStdString(r.error()));
-        std::filesystem::remove_all(disk_cache_path());
+        std::filesystem::remove_all(path);
     }
 }
 
-std::vector<tile::Id> Scheduler::tiles_for_current_camera_position() const
+void Scheduler::read_missing_quads(unsigned source)
 {
-    std::vector<tile::Id> all_inner_nodes;
-    const auto all_leaves = quad_tree::onTheFlyTraverse(
-        tile::Id{0, {0, 0}},
-        tile_scheduler::utils::refineFunctor(m_current_camera,
-                                             m_aabb_decorator,
-                                             m_permissible_screen_space_error,
-                                             m_ortho_tile_size),
-        [&all_inner_nodes](const tile::Id &v) {
-            all_inner_nodes.push_back(v);
-            return v.children();
-        });
+    std::scoped_lock lock(m_missing_quads_mutex);
+    auto& missing = m_sources[source]->missing;
+    const auto r = missing.read_from_file(missing_quads_path(source));
+    if (!r.has_value()) {
+        qDebug() << QString("Reading the missing quads (%1) failed: %2").arg(QString::fromStdString(missing_quads_path(source).string())).arg(QString::fromStdString(r.error()));
+        missing.clear();
+    }
+}
+
+void Scheduler::open_disk_cache()
+{
+    const nucleus::timing::StartupScope startup_scope("open disk cache"); // queued by the controller, runs on the scheduler thread
+    m_disk_cache_opened = true;
+    open_pack(m_tile_source); // the packs of the other sources are opened when switching to them
+}
+
+void Scheduler::open_pack(unsigned source)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto& cache = m_sources[source]->ram;
+    const auto path = disk_cache_path(source);
+    m_sources[source]->pack_opened = true;
+    read_missing_quads(source);
+    const auto r = cache.open_persisted(path);
+    cache.publish_snapshot();
+    if (!r.has_value()) {
+        qDebug() << QString("Opening the disk cache (%1) failed: \n%2\nRemoving all files.")
+                        .arg(QString::fromStdString(path.string()))
+                        .arg(QString::fromStdString(r.error()));
+        std::filesystem::remove_all(path);
+        return;
+    }
+    const auto diff = std::chrono::steady_clock::now() - start;
+    qDebug() << QString("Scheduler::open_pack took %1ms for the index of %2 quads.")
+                    .arg(std::chrono::duration_cast<std::chrono::milliseconds>(diff).count())
+                    .arg(cache.n_pending_from_pack());
+    update_stats();
+    if (cache.n_pending_from_pack() > 0)
+        m_disk_load_timer->start(0);
+}
+
+void Scheduler::open_base_pack(const std::filesystem::path& path)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto pack = std::make_unique<TilePack>(path, tile_types::TileQuad::version_information);
+    const auto r = pack->open_read_only();
+    if (!r.has_value()) {
+        qDebug() << QString("Opening the base tile pack (%1) failed: %2").arg(QString::fromStdString(path.string())).arg(QString::fromStdString(r.error()));
+        return;
+    }
+    m_base_pack = std::move(pack);
+    std::vector<tile::Id> ids;
+    ids.reserve(m_base_pack->index().size());
+    for (const auto& [id, entry] : m_base_pack->index())
+        ids.push_back(id);
+    const auto n_loaded = load_from_base_pack(ids);
+    const auto diff = std::chrono::steady_clock::now() - start;
+    qDebug() << QString("Scheduler::open_base_pack took %1ms for %2 of %3 quads.")
+                    .arg(std::chrono::duration_cast<std::chrono::milliseconds>(diff).count())
+                    .arg(n_loaded)
+                    .arg(ids.size());
+}
+
+unsigned Scheduler::load_from_base_pack(std::span<const tile::Id> ids)
+{
+    if (!m_base_pack)
+        return 0;
+    auto& cache = m_sources[0]->ram; // the base pack holds the ortho of the default source
+    unsigned n_loaded = 0;
+    for (const auto& id : ids) {
+        if (cache.contains(id) || cache.is_pending_from_pack(id))
+            continue; // the disk cache has the same or a newer version
+        const auto bytes = m_base_pack->bytes(id);
+        if (!bytes)
+            continue;
+        zpp::bits::in in(*bytes);
+        tile_types::TileQuad quad;
+        if (failure(in(quad)))
+            continue;
+        cache.insert(quad);
+        ++n_loaded;
+    }
+    if (n_loaded == 0)
+        return 0;
+    cache.publish_snapshot();
+    schedule_update();
+    schedule_purge();
+    update_stats();
+    return n_loaded;
+}
+
+std::filesystem::path Scheduler::disk_cache_path(unsigned source) const
+{
+    if (source == 0)
+        return disk_cache_path();
+    return disk_cache_path().parent_path() / ("tile_cache_" + m_sources[source]->name);
+}
+
+void Scheduler::load_disk_cache_batch()
+{
+    if (ram_cache().n_pending_from_pack() == 0)
+        return;
+
+    std::vector<tile::Id> batch;
+    batch.reserve(m_disk_load_batch_size);
+
+    // first the quads that the current camera needs, breadth first, so that coarse quads are shown as soon as possible.
+    // the traversal continues through quads that are already loaded, but stops at missing ones (they can't be shown anyway).
+    if (m_aabb_decorator) {
+        const auto should_refine = refine_functor(m_permissible_screen_space_error);
+        std::vector<tile::Id> front = { tile::Id { 0, { 0, 0 } } };
+        while (!front.empty() && batch.size() < m_disk_load_batch_size) {
+            std::vector<tile::Id> next;
+            for (const auto& id : front) {
+                if (batch.size() >= m_disk_load_batch_size)
+                    break;
+                const auto is_pending = ram_cache().is_pending_from_pack(id);
+                if ((!is_pending && !ram_cache().contains(id)) || !should_refine(id))
+                    continue;
+                if (is_pending)
+                    batch.push_back(id);
+                for (const auto& child : id.children())
+                    next.push_back(child);
+            }
+            front = std::move(next);
+        }
+    }
+
+    // top up with the rest while there is room in ram, coarse ones first (they are the most likely to be needed after the camera
+    // moves). the disk tier can be much larger than the ram cache, the remaining ones stay pending until the camera needs them.
+    const auto n_in_ram = ram_cache().n_cached_objects() + unsigned(batch.size());
+    const auto room = m_ram_quad_limit > n_in_ram ? m_ram_quad_limit - n_in_ram : 0u;
+    if (batch.size() < m_disk_load_batch_size && room > 0) {
+        auto pending = ram_cache().pending_from_pack();
+        for (const auto& id : batch)
+            pending.erase(id);
+        std::vector<tile::Id> rest(pending.begin(), pending.end());
+        const auto n = std::min({ size_t(m_disk_load_batch_size - batch.size()), size_t(room), rest.size() });
+        std::partial_sort(rest.begin(), rest.begin() + long(n), rest.end(), [](const tile::Id& a, const tile::Id& b) { return a.zoom_level < b.zoom_level; });
+        for (size_t i = 0; i < n; ++i)
+            batch.push_back(rest[i]);
+    }
+
+    const auto r = ram_cache().load_from_pack(batch);
+    if (!r.has_value()) {
+        qDebug() << QString("Reading tiles from disk cache (%1) failed: \n%2\nDiscarding the remaining ones.")
+                        .arg(QString::fromStdString(disk_cache_path(m_tile_source).string()))
+                        .arg(QString::fromStdString(r.error()));
+        ram_cache().discard_pending_from_pack();
+    }
+    ram_cache().publish_snapshot();
+    update_stats();
+    schedule_update();
+    if (!batch.empty() && ram_cache().n_pending_from_pack() > 0)
+        m_disk_load_timer->start(0); // let other events (camera updates, network replies) through between batches
+}
+
+void Scheduler::set_disk_load_batch_size(unsigned int new_disk_load_batch_size)
+{
+    assert(new_disk_load_batch_size > 0);
+    m_disk_load_batch_size = new_disk_load_batch_size;
+}
 
+std::vector<tile::Id> Scheduler::tiles_for_current_camera_position() const
+{
+    const nucleus::timing::TraceScope trace("traversal", "scheduler");
+    const auto threshold = m_permissible_screen_space_error;
+    const auto make_refine = [this, threshold](unsigned) {
+        // the traversals of the current camera aren't thread safe, the other threads get their own
+        std::vector<CameraTraversal> traversals;
+        traversals.emplace_back(m_current_camera, m_aabb_decorator, m_tile_format.ortho_size);
+        for (const auto& [view, camera] : m_view_cameras)
+            traversals.emplace_back(camera, m_aabb_decorator, m_tile_format.ortho_size);
+        return [this, threshold, traversals = std::move(traversals)](const tile::Id& id) {
+            if (missing_quads().contains(id))
+                return false;
+            return std::any_of(traversals.begin(), traversals.end(), [&](const CameraTraversal& t) { return t.refine(id, threshold); });
+        };
+    };
     // not adding leaves, because they we will be fetching quads, which also fetch their children
-    return all_inner_nodes;
+    std::vector<tile::Id> inner_nodes;
+    m_parallel_traversal.traverse(refine_functor(threshold), make_refine, &inner_nodes, nullptr);
+    return inner_nodes;
+}
+
+std::vector<tile::Id> Scheduler::tiles_for_camera(const camera::Definition& camera) const
+{
+    const auto refine = tile_scheduler::utils::refineFunctor(camera, m_aabb_decorator, m_permissible_screen_space_error, m_tile_format.ortho_size);
+    const auto refine_available = [&](const tile::Id& id) { return !missing_quads().contains(id) && refine(id); };
+    std::vector<tile::Id> inner_nodes;
+    m_parallel_traversal.traverse(refine_available, [&](unsigned) { return refine_available; }, &inner_nodes, nullptr); // stateless
+    return inner_nodes;
+}
+
+const CameraTraversal& Scheduler::camera_traversal() const
+{
+    if (!m_camera_traversal)
+        m_camera_traversal = std::make_unique<CameraTraversal>(m_current_camera, m_aabb_decorator, m_tile_format.ortho_size);
+    return *m_camera_traversal;
+}
+
+bool Scheduler::refine(const tile::Id& id, float error_threshold_px) const
+{
+    if (missing_quads().contains(id))
+        return false; // the traversals are top down, so descendants of missing quads are not reached either
+    if (camera_traversal().refine(id, error_threshold_px))
+        return true;
+    for (const auto& [view, camera] : m_view_cameras) {
+        auto& traversal = m_view_traversals[view];
+        if (!traversal)
+            traversal = std::make_unique<CameraTraversal>(camera, m_aabb_decorator, m_tile_format.ortho_size);
+        if (traversal->refine(id, error_threshold_px))
+            return true;
+    }
+    return false;
+}
+
+float Scheduler::screen_space_error(const tile::Id& id) const
+{
+    auto error = camera_traversal().screen_space_error(id);
+    for (const auto& [view, camera] : m_view_cameras) {
+        auto& traversal = m_view_traversals[view];
+        if (!traversal)
+            traversal = std::make_unique<CameraTraversal>(camera, m_aabb_decorator, m_tile_format.ortho_size);
+        error = std::max(error, traversal->screen_space_error(id));
+    }
+    return error;
+}
+
+bool Scheduler::gpu_payload_caching() const { return m_gpu_payload_caching; }
+
+void Scheduler::set_gpu_payload_caching(bool new_gpu_payload_caching) { m_gpu_payload_caching = new_gpu_payload_caching; }
+
+void Scheduler::set_clock(std::function<uint64_t()> clock)
+{
+    m_clock = clock;
+    m_gpu_cached.set_clock(std::move(clock));
+}
+
+bool Scheduler::normal_maps() const { return m_normal_maps; }
+
+void Scheduler::set_normal_maps(bool new_normal_maps)
+{
+    if (new_normal_maps == m_normal_maps)
+        return;
+    m_normal_maps = new_normal_maps;
+    ++m_format_generation;
+    if (!m_normal_maps)
+        return; // the quads on the gpu keep their normals until they are replaced
+    // decoded again with normals. like in set_tile_source, the deletions are sent together with the new quads
+    m_warm_gpu_quads.clear();
+    for (const auto& quad : m_gpu_cached.purge(0))
+        m_replaced_gpu_quads.push_back(quad.id);
+    m_decoding.clear();
+    ++m_decode_generation;
+    update_stats();
+    schedule_update();
 }
 
 nucleus::utils::ColourTexture::Format Scheduler::ortho_tile_compression_algorithm() const { return m_ortho_tile_compression_algorithm; }
@@ -303,13 +1762,126 @@ nucleus::utils::ColourTexture::Format Scheduler::ortho_tile_compression_algorith
 void Scheduler::set_ortho_tile_compression_algorithm(nucleus::utils::ColourTexture::Format new_ortho_tile_compression_algorithm)
 {
     m_ortho_tile_compression_algorithm = new_ortho_tile_compression_algorithm;
+    ++m_format_generation;
+    m_warm_gpu_quads.clear();
+    auto locker = std::scoped_lock(m_decode_memo_mutex);
+    m_ortho_memo.clear();
+}
+
+unsigned Scheduler::ortho_tile_mip_levels() const { return m_ortho_tile_mip_levels; }
+
+void Scheduler::set_ortho_tile_mip_levels(unsigned new_ortho_tile_mip_levels)
+{
+    assert(new_ortho_tile_mip_levels >= 1);
+    m_ortho_tile_mip_levels = new_ortho_tile_mip_levels;
+    ++m_format_generation;
+    m_warm_gpu_quads.clear();
+    auto locker = std::scoped_lock(m_decode_memo_mutex);
+    m_ortho_memo.clear();
+}
+
+const tile_types::TileFormat& Scheduler::tile_format() const { return m_tile_format; }
+
+void Scheduler::set_tile_format(const tile_types::TileFormat& new_tile_format)
+{
+    assert(new_tile_format.valid());
+    if (new_tile_format == m_tile_format)
+        return;
+    m_tile_format = new_tile_format;
+    if (m_generated_default_tiles) {
+        m_default_ortho_tile = std::make_shared<QByteArray>(white_jpeg_tile(m_tile_format.ortho_size));
+        m_default_height_tile = std::make_shared<QByteArray>(black_png_tile(m_tile_format.height_size));
+    }
+    m_camera_traversal.reset(); // created with the ortho size
+    m_view_traversals.clear();
+    ++m_format_generation;
+    m_warm_gpu_quads.clear();
+    auto locker = std::scoped_lock(m_decode_memo_mutex);
+    m_ortho_memo.clear();
+    m_height_memo.clear();
+}
+
+bool Scheduler::asynchronous_decoding() const { return m_asynchronous_decoding; }
+
+void Scheduler::set_asynchronous_decoding(bool new_asynchronous_decoding) { m_asynchronous_decoding = new_asynchronous_decoding; }
+
+unsigned int Scheduler::decode_thread_count() const { return m_decode_thread_count; }
+
+void Scheduler::set_decode_thread_count(unsigned int new_decode_thread_count)
+{
+    assert(new_decode_thread_count > 0);
+    assert(new_decode_thread_count < unsigned(std::numeric_limits<int>::max()));
+    m_decode_thread_count = std::max(1u, new_decode_thread_count);
+    m_decode_pool->setMaxThreadCount(int(m_decode_thread_count));
+}
+
+void Scheduler::set_thread_policies(const nucleus::utils::ThreadPolicy& decode, const nucleus::utils::ThreadPolicy& io)
+{
+    m_decode_thread_policy = decode;
+    m_io_thread_policy = io;
 }
 
+unsigned int Scheduler::decode_batch_size() const { return m_decode_batch_size; }
+
+void Scheduler::set_decode_batch_size(unsigned int new_decode_batch_size) { m_decode_batch_size = new_decode_batch_size; }
+
 void Scheduler::set_retirement_age_for_tile_cache(unsigned int new_retirement_age_for_tile_cache)
 {
     m_retirement_age_for_tile_cache = new_retirement_age_for_tile_cache;
 }
 
+namespace {
+std::optional<tile_types::TileLayer> cached_layer(const MemoryCache& cache,
+    const tile::Id& tile_id,
+    std::shared_ptr<QByteArray> tile_types::LayeredTile::*data,
+    tile_types::CacheValidator tile_types::LayeredTile::*validator)
+{
+    if (tile_id.zoom_level == 0)
+        return {};
+    const auto snapshot = cache.snapshot();
+    const auto* quad = snapshot->find(tile_id.parent());
+    if (!quad)
+        return {};
+    for (const auto& tile : quad->tiles) {
+        const auto& bytes = tile.*data;
+        if (tile.id == tile_id && tile.network_info.status == tile_types::NetworkInfo::Status::Good && bytes && !bytes->isEmpty())
+            return tile_types::TileLayer { tile.id, tile.network_info, bytes, tile.*validator };
+    }
+    return {};
+}
+} // namespace
+
+std::optional<tile_types::TileLayer> Scheduler::cached_ortho_tile(const tile::Id& tile_id) const { return cached_ortho_tile(tile_id, m_tile_source); }
+
+std::optional<tile_types::TileLayer> Scheduler::cached_ortho_tile(const tile::Id& tile_id, unsigned source) const
+{
+    assert(source < m_sources.size());
+    return cached_layer(m_sources[source]->ram, tile_id, &tile_types::LayeredTile::ortho, &tile_types::LayeredTile::ortho_validator);
+}
+
+std::optional<tile_types::TileLayer> Scheduler::cached_height_tile(const tile::Id& tile_id) const
+{
+    return cached_layer(ram_cache(), tile_id, &tile_types::LayeredTile::height, &tile_types::LayeredTile::height_validator);
+}
+
+std::optional<tile_types::TileLayer> Scheduler::cached_label_tile(const tile::Id& tile_id) const
+{
+    return cached_layer(ram_cache(), tile_id, &tile_types::LayeredTile::labels, &tile_types::LayeredTile::labels_validator);
+}
+
+void Scheduler::keep_unchanged_gpu_payloads(tile_types::TileQuad& quad, const MemoryCache& cache) const
+{
+    if (!cache.contains(quad.id))
+        return;
+    const auto& old_quad = cache.peak_at(quad.id);
+    for (unsigned i = 0; i < quad.n_tiles; ++i) {
+        auto& tile = quad.tiles[i];
+        const auto& old_tile = old_quad.tiles[i];
+        if (!tile.gpu && old_tile.gpu && tile.id == old_tile.id && tile.ortho == old_tile.ortho && tile.height == old_tile.height)
+            tile.gpu = old_tile.gpu;
+    }
+}
+
 unsigned int Scheduler::persist_timeout() const
 {
     return m_persist_timeout;
@@ -325,14 +1897,66 @@ void Scheduler::set_persist_timeout(unsigned int new_persist_timeout)
     }
 }
 
-const Cache<tile_types::TileQuad>& Scheduler::ram_cache() const
+const MissingQuadSet& Scheduler::missing_quads() const { return m_sources[m_tile_source]->missing; }
+
+const LatencyTracerPtr& Scheduler::latency_tracer() const { return m_latency_tracer; }
+
+const MemoryCache& Scheduler::ram_cache() const
+{
+    return m_sources[m_tile_source]->ram;
+}
+
+MemoryCache& Scheduler::ram_cache()
 {
-    return m_ram_cache;
+    return m_sources[m_tile_source]->ram;
 }
 
-Cache<tile_types::TileQuad>& Scheduler::ram_cache()
+MemoryCache& Scheduler::ram_cache(unsigned source)
 {
-    return m_ram_cache;
+    assert(source < m_sources.size());
+    return m_sources[source]->ram;
+}
+
+void Scheduler::set_tile_sources(const std::vector<std::string>& names)
+{
+    assert(!names.empty());
+    assert(!m_disk_cache_opened);
+    assert(m_tile_source == 0);
+    m_sources.resize(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (!m_sources[i]) {
+            m_sources[i] = std::make_unique<SourceCache>();
+            m_sources[i]->ram.set_disk_limits(m_disk_quad_limit, m_disk_byte_limit);
+        }
+        m_sources[i]->name = names[i];
+    }
+}
+
+unsigned Scheduler::tile_source() const { return m_tile_source; }
+
+void Scheduler::set_tile_source(unsigned source)
+{
+    assert(source < m_sources.size());
+    if (source == m_tile_source)
+        return;
+    // written first, so that the quads purged from ram can be loaded from disk when switching back
+    if (m_persistence_used)
+        flush_disk_cache();
+    ram_cache().purge(std::min(m_ram_low_water_mark, m_ram_quad_limit));
+    ram_cache().publish_snapshot();
+    m_tile_source = source;
+
+    // the deletions of the old gpu quads are sent together with the new quads, so that nothing flickers in between
+    for (const auto& quad : m_gpu_cached.purge(0))
+        m_replaced_gpu_quads.push_back(quad.id);
+    m_decoding.clear();
+    ++m_decode_generation;
+    if (m_disk_cache_opened && !m_sources[source]->pack_opened)
+        open_pack(source);
+    else if (ram_cache().n_pending_from_pack() > 0)
+        m_disk_load_timer->start(0);
+    update_stats();
+    schedule_update();
 }
 
 QByteArray Scheduler::white_jpeg_tile(unsigned int size)
@@ -364,6 +1988,8 @@ std::filesystem::path Scheduler::disk_cache_path()
     return  base_path / "tile_cache";
 }
 
+std::filesystem::path Scheduler::missing_quads_path(unsigned source) const { return disk_cache_path(source) / "missing_quads.alp"; }
+
 void Scheduler::set_purge_timeout(unsigned int new_purge_timeout)
 {
     assert(new_purge_timeout < unsigned(std::numeric_limits<int>::max()));
@@ -381,17 +2007,162 @@ void Scheduler::set_ram_quad_limit(unsigned int new_ram_quad_limit)
 
 void Scheduler::set_gpu_quad_limit(unsigned int new_gpu_quad_limit)
 {
+    if (m_gpu_quad_limit == new_gpu_quad_limit)
+        return;
     m_gpu_quad_limit = new_gpu_quad_limit;
+    schedule_update();
+}
+
+void Scheduler::release_gpu_quads()
+{
+    m_gpu_cached.purge(0);
+    m_replaced_gpu_quads.clear();
+    update_stats();
+    schedule_update();
+}
+
+void Scheduler::set_gpu_byte_limit(uint64_t new_gpu_byte_limit)
+{
+    m_gpu_byte_limit = new_gpu_byte_limit;
+}
+
+void Scheduler::set_ram_byte_limit(uint64_t new_ram_byte_limit)
+{
+    m_ram_byte_limit = new_ram_byte_limit;
+}
+
+void Scheduler::set_disk_quad_limit(unsigned int new_disk_quad_limit)
+{
+    m_disk_quad_limit = new_disk_quad_limit;
+    for (auto& source : m_sources)
+        source->ram.set_disk_limits(m_disk_quad_limit, m_disk_byte_limit);
+}
+
+void Scheduler::set_disk_byte_limit(uint64_t new_disk_byte_limit)
+{
+    m_disk_byte_limit = new_disk_byte_limit;
+    for (auto& source : m_sources)
+        source->ram.set_disk_limits(m_disk_quad_limit, m_disk_byte_limit);
+}
+
+void Scheduler::set_warm_cache_byte_limit(uint64_t new_warm_cache_byte_limit)
+{
+    if (new_warm_cache_byte_limit == 0)
+        m_warm_gpu_quads.clear();
+    m_warm_gpu_quads.set_byte_limit(new_warm_cache_byte_limit);
+}
+
+void Scheduler::set_ram_low_water_mark(unsigned int new_ram_low_water_mark)
+{
+    m_ram_low_water_mark = new_ram_low_water_mark;
+}
+
+void Scheduler::set_release_gpu_when_suspended(bool new_release_gpu_when_suspended)
+{
+    m_release_gpu_when_suspended = new_release_gpu_when_suspended;
+}
+
+uint64_t Scheduler::gpu_quad_n_bytes() const
+{
+    const uint64_t ortho_bytes = nucleus::utils::ColourTexture::n_bytes_for(m_tile_format.ortho_size, m_tile_format.ortho_size, m_ortho_tile_compression_algorithm, m_ortho_tile_mip_levels);
+    const uint64_t height_bytes = m_tile_format.height_size * m_tile_format.height_size * sizeof(uint16_t);
+    return 4 * (ortho_bytes + height_bytes);
 }
 
 void Scheduler::set_aabb_decorator(const utils::AabbDecoratorPtr& new_aabb_decorator)
 {
     m_aabb_decorator = new_aabb_decorator;
+    m_aabb_version = m_aabb_decorator ? m_aabb_decorator->version() : 0;
+    m_camera_traversal.reset();
+    m_view_traversals.clear();
+    m_warm_gpu_quads.clear(); // the bounds are of the old decorator
 }
 
 void Scheduler::set_permissible_screen_space_error(float new_permissible_screen_space_error)
 {
+    std::scoped_lock lock(m_layer_selection_mutex);
     m_permissible_screen_space_error = new_permissible_screen_space_error;
+    m_ortho_permissible_screen_space_error = new_permissible_screen_space_error;
+    m_height_permissible_screen_space_error = new_permissible_screen_space_error;
+}
+
+void Scheduler::set_refinement_hysteresis(float new_refinement_hysteresis)
+{
+    assert(new_refinement_hysteresis > 0 && new_refinement_hysteresis <= 1);
+    m_refinement_hysteresis = new_refinement_hysteresis;
+}
+
+void Scheduler::set_gpu_min_residency(unsigned int new_gpu_min_residency)
+{
+    m_gpu_min_residency = new_gpu_min_residency;
+}
+
+void Scheduler::set_pinned_levels(unsigned int n_levels)
+{
+    assert(n_levels <= 8); // 21845 quads
+    m_pinned_levels = n_levels;
+    update_pinned_quads();
+}
+
+void Scheduler::set_pinned_quads(const std::vector<tile::Id>& quads)
+{
+    m_pinned_region_quads = quads;
+    update_pinned_quads();
+}
+
+bool Scheduler::is_pinned(const tile::Id& id) const { return m_pinned_quads.contains(id); }
+
+void Scheduler::update_pinned_quads()
+{
+    m_pinned_quad_list.clear();
+    m_pinned_quads.clear();
+    const auto add = [this](const tile::Id& id) {
+        if (m_pinned_quads.insert(id).second)
+            m_pinned_quad_list.push_back(id);
+    };
+    for (unsigned zoom_level = 0; zoom_level < m_pinned_levels; ++zoom_level) {
+        const auto n = 1u << zoom_level;
+        for (unsigned y = 0; y < n; ++y) {
+            for (unsigned x = 0; x < n; ++x)
+                add(tile::Id { zoom_level, { x, y } });
+        }
+    }
+    for (const auto& id : m_pinned_region_quads)
+        add(id);
+    std::stable_sort(m_pinned_quad_list.begin(), m_pinned_quad_list.end(), [](const tile::Id& a, const tile::Id& b) { return a.zoom_level < b.zoom_level; });
+    schedule_update();
+}
+
+void Scheduler::set_layer_permissible_screen_space_errors(float ortho, float height)
+{
+    std::scoped_lock lock(m_layer_selection_mutex);
+    m_ortho_permissible_screen_space_error = ortho;
+    m_height_permissible_screen_space_error = height;
+    m_permissible_screen_space_error = std::min(ortho, height);
+}
+
+tile_types::LayerSelection Scheduler::layers_for_tile(const tile::Id& tile_id) const
+{
+    if (tile_id.zoom_level <= 1)
+        return {};
+    std::unique_lock lock(m_layer_selection_mutex);
+    if (m_ortho_permissible_screen_space_error == m_height_permissible_screen_space_error)
+        return {};
+    std::vector<camera::Definition> cameras = { m_current_camera };
+    for (const auto& [view, camera] : m_view_cameras)
+        cameras.push_back(camera);
+    const auto ortho_error = m_ortho_permissible_screen_space_error;
+    const auto height_error = m_height_permissible_screen_space_error;
+    lock.unlock();
+    const auto quad_id = tile_id.parent();
+    tile_types::LayerSelection layers { .ortho = false, .height = false };
+    for (const auto& camera : cameras) {
+        layers.ortho = layers.ortho || utils::refineFunctor(camera, m_aabb_decorator, ortho_error, m_tile_format.ortho_size)(quad_id);
+        layers.height = layers.height || utils::refineFunctor(camera, m_aabb_decorator, height_error, m_tile_format.ortho_size)(quad_id);
+    }
+    if (!layers.ortho && !layers.height)
+        return {}; // the camera moved since the request
+    return layers;
 }
 
 bool Scheduler::enabled() const
@@ -405,6 +2176,23 @@ void Scheduler::set_enabled(bool new_enabled)
     schedule_update();
 }
 
+void Scheduler::set_gpu_quad_mailbox(const std::shared_ptr<tile_types::GpuQuadMailbox>& new_gpu_quad_mailbox)
+{
+    m_gpu_quad_mailbox = new_gpu_quad_mailbox;
+}
+
+void Scheduler::set_adaptive_update_cadence(bool new_adaptive_update_cadence)
+{
+    m_adaptive_update_cadence = new_adaptive_update_cadence;
+    if (!m_adaptive_update_cadence)
+        m_settle_timer->stop();
+}
+
+void Scheduler::set_min_update_interval(unsigned int new_min_update_interval)
+{
+    m_min_update_interval = new_min_update_interval;
+}
+
 void Scheduler::set_update_timeout(unsigned new_update_timeout)
 {
     assert(m_update_timeout < unsigned(std::numeric_limits<int>::max()));
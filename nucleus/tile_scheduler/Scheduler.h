@@ -18,16 +18,34 @@
 
 #pragma once
 
+#include <atomic>
+#include <array>
+#include <functional>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <QNetworkInformation>
 #include <QObject>
 
 #include "Cache.h"
+#include "LatencyTracer.h"
+#include "MissingQuadSet.h"
+#include "ParallelTraversal.h"
 #include "nucleus/camera/Definition.h"
+#include "nucleus/utils/LruCache.h"
+#include "nucleus/utils/ThreadPolicy.h"
 #include "radix/tile.h"
 #include "tile_types.h"
 
+class QThreadPool;
 class QTimer;
 
 namespace nucleus::tile_scheduler {
@@ -35,6 +53,7 @@ namespace utils {
     class AabbDecorator;
     using AabbDecoratorPtr = std::shared_ptr<AabbDecorator>;
 }
+class CameraTraversal;
 
 class Scheduler : public QObject {
     Q_OBJECT
@@ -42,6 +61,48 @@ public:
     struct Statistics {
         unsigned n_tiles_in_ram_cache = 0;
         unsigned n_tiles_in_gpu_cache = 0;
+        uint64_t n_bytes_in_ram_cache = 0;
+        uint64_t n_bytes_in_gpu_cache = 0;
+        unsigned n_tiles_in_warm_cache = 0; // decoded quads kept for re-promotion to the gpu
+        uint64_t n_bytes_in_warm_cache = 0;
+        unsigned n_tiles_in_disk_cache = 0; // as of the last persist
+        uint64_t n_bytes_in_disk_cache = 0;
+        unsigned n_request_slots = 0; // current limit of the SlotLimiter (it adapts to the link, if enabled)
+        LatencyTracer::Report tile_latency; // per stage, from the request of a quad to its first draw
+        unsigned n_persists = 0; // disk cache writes since the start
+        float last_persist_msecs = 0;
+        float max_persist_msecs = 0;
+        // since the start. ram: needed quads that were cached, of all needed ones per update. warm: re-promotions to the gpu
+        // without decoding, of all quads that were sent to the gpu.
+        uint64_t n_ram_cache_lookups = 0;
+        uint64_t n_ram_cache_hits = 0;
+        uint64_t n_warm_cache_lookups = 0;
+        uint64_t n_warm_cache_hits = 0;
+    };
+
+    // what is loaded over the network, per kind of connection (see set_network_policies)
+    struct NetworkPolicy {
+        bool prefetch = true; // see set_prefetch_budget
+        unsigned max_zoom_level = 18; // of the requested tiles
+        // quads are requested from the network only at a screen space error of permissible * error_factor. the cached quads
+        // (ram and disk) are still used at the permissible error.
+        float error_factor = 1.0f;
+        bool bundle_requests = true; // see TileLoadService::set_bundle_url, forwarded with bundle_requests_changed
+        bool operator==(const NetworkPolicy&) const = default;
+
+        // comma separated key=value pairs (prefetch, max_zoom, error_factor, bundles), e.g. "prefetch=0,max_zoom=16". missing
+        // keys keep their default, nullopt if a pair doesn't parse.
+        [[nodiscard]] static std::optional<NetworkPolicy> from_string(const QString& string);
+    };
+
+    // while the camera is at rest and the view is loaded, the quads of a wider view (the ring around it) and of a narrower one
+    // (one level deeper in the centre) are requested, so that the next small pan or zoom is served from the cache
+    struct IdlePrefetch {
+        unsigned max_quads = 0; // per rest of the camera, 0 disables idle prefetching (default)
+        unsigned max_in_flight = 4; // requested at a time, so that they take only a part of the bandwidth
+        float ram_fraction = 0.75f; // of the ram cache limits, nothing is prefetched while the cache is fuller than that
+        unsigned delay = 1000; // msecs at rest before the first request
+        float ring_factor = 1.5f; // field of view of the ring, relative to the camera's
     };
 
     explicit Scheduler(QObject* parent = nullptr);
@@ -49,22 +110,87 @@ public:
     ~Scheduler() override;
 
     void set_update_timeout(unsigned int new_update_timeout);
+    // camera changes: the first one after the camera was at rest is handled right away, during motion the updates run at a
+    // rate that follows the camera speed (between min_update_interval and the update timeout, e.g., 10 Hz when hovering, 60 Hz
+    // when flying low and fast), and once the camera comes to rest, a final update drops the requests for its predicted
+    // path. off by default (every change waits for the update timeout).
+    void set_adaptive_update_cadence(bool new_adaptive_update_cadence);
+    // the gpu quads are pushed into the mailbox instead of being emitted with gpu_quads_updated (the renderer drains it at the
+    // start of a frame). set it before the scheduler is moved to its thread, the scheduler is the only producer.
+    void set_gpu_quad_mailbox(const std::shared_ptr<tile_types::GpuQuadMailbox>& new_gpu_quad_mailbox);
+    void set_min_update_interval(unsigned int new_min_update_interval);
 
     [[nodiscard]] bool enabled() const;
     void set_enabled(bool new_enabled);
 
     void set_permissible_screen_space_error(float new_permissible_screen_space_error);
+    // thresholds per layer. a layer is loaded for the children of a quad only if the quad needs refinement for that layer,
+    // otherwise the children use a part of the closest ancestor's layer. the quad tree is refined with the finer threshold.
+    // set_permissible_screen_space_error sets both.
+    void set_layer_permissible_screen_space_errors(float ortho, float height);
+    // quads are refined at the permissible error, but quads that are on the gpu (or in ram) are only coarsened once their error
+    // drops below permissible error * factor (in (0, 1], 1 disables it). tiles at the boundary don't flip on small camera moves.
+    void set_refinement_hysteresis(float new_refinement_hysteresis);
+    // quads stay on the gpu for at least this long, unless the gpu cache limits can't be met otherwise. new quads wait for
+    // space instead. 0 disables it.
+    void set_gpu_min_residency(unsigned int new_gpu_min_residency); // msecs
+    // pinned quads are requested right away (not only when a view needs them) and are never purged from ram, nor from the gpu
+    // once a view brought them there, unless the limits can't be met otherwise. keep them well below the quad limits.
+    // levels: all quads up to zoom level n_levels - 1 (tiles up to n_levels, at most 8). quads: e.g., the quads of an area of
+    // operations (RegionSeeder::quads_in_polygon). both are pinned.
+    void set_pinned_levels(unsigned int n_levels);
+    void set_pinned_quads(const std::vector<tile::Id>& quads);
+    [[nodiscard]] bool is_pinned(const tile::Id& id) const;
+    // for LayerAssembler::set_layer_selector, uses the current camera. thread safe (the loading chain runs on the network thread).
+    [[nodiscard]] tile_types::LayerSelection layers_for_tile(const tile::Id& tile_id) const;
 
     void set_aabb_decorator(const utils::AabbDecoratorPtr& new_aabb_decorator);
 
+    // connect to AbstractRenderWindow::quad_limit_changed, the renderer can resize its tile pool at runtime
     void set_gpu_quad_limit(unsigned int new_gpu_quad_limit);
 
     void set_ram_quad_limit(unsigned int new_ram_quad_limit);
 
+    // byte budgets, enforced in addition to the quad limits. ram counts the encoded tiles, gpu the textures and height rasters.
+    void set_gpu_byte_limit(uint64_t new_gpu_byte_limit);
+    void set_ram_byte_limit(uint64_t new_ram_byte_limit);
+    // size of one quad on the gpu with the current compression
+    [[nodiscard]] uint64_t gpu_quad_n_bytes() const;
+
+    // disk tier: with a quad limit > 0, quads purged from ram stay on disk (and are loaded from there when the camera needs them
+    // again) until the disk cache exceeds a limit, then its least recently used ones are removed. 0 (default): the disk cache
+    // mirrors the ram cache.
+    void set_disk_quad_limit(unsigned int new_disk_quad_limit);
+    void set_disk_byte_limit(uint64_t new_disk_byte_limit);
+
+    // recently decoded gpu quads are kept up to this size, so that quads that come back onto the gpu shortly after their eviction
+    // (e.g., while orbiting) are handed over without decoding them again. 0 disables it.
+    void set_warm_cache_byte_limit(uint64_t new_warm_cache_byte_limit);
+
+    // number of quads the ram cache is purged to under memory pressure
+    void set_ram_low_water_mark(unsigned int new_ram_low_water_mark);
+    // if set, all gpu quads are deleted while the app is suspended (they are reloaded from the ram / disk cache on resume)
+    void set_release_gpu_when_suspended(bool new_release_gpu_when_suspended);
+
     void set_purge_timeout(unsigned int new_purge_timeout);
 
-    const Cache<tile_types::TileQuad>& ram_cache() const;
-    Cache<tile_types::TileQuad>& ram_cache();
+    // of the current tile source
+    const MemoryCache& ram_cache() const;
+    MemoryCache& ram_cache();
+    MemoryCache& ram_cache(unsigned source);
+    // the ortho sources that can be switched between (e.g., providers), with a ram and disk cache each, so that switching back is
+    // served from the caches instead of the network. the heights are cached along with every source. call before the disk cache
+    // is opened. by default, there is a single source.
+    void set_tile_sources(const std::vector<std::string>& names);
+    [[nodiscard]] unsigned tile_source() const;
+    // the quads of the previous source stay cached (in ram up to the low water mark, and on disk), the gpu quads are replaced
+    // with the next update. the quads that are still loading are stored with the source that served them (TileLayer::source).
+    void set_tile_source(unsigned source);
+    // quads that the server doesn't have. they are not stored in the ram cache and the quad tree isn't refined into them.
+    const MissingQuadSet& missing_quads() const;
+    // traces the quads from the request to the first draw. the stages outside of the scheduler are marked by the loading chain and
+    // the renderer (see nucleus::Controller), the percentiles are reported with the statistics.
+    [[nodiscard]] const LatencyTracerPtr& latency_tracer() const;
 
     static QByteArray white_jpeg_tile(unsigned size);
     static QByteArray black_png_tile(unsigned size);
@@ -74,56 +200,327 @@ public:
     void set_persist_timeout(unsigned int new_persist_timeout);
 
     void read_disk_cache();
+    // writes the changes since the last persist on the calling thread, after waiting for a running background write
+    void flush_disk_cache();
+    // quads loaded from the disk cache per event loop iteration (see open_disk_cache)
+    void set_disk_load_batch_size(unsigned int new_disk_load_batch_size);
 
     void set_retirement_age_for_tile_cache(unsigned int new_retirement_age_for_tile_cache);
+    // the cached layers of a tile (from the latest snapshot of the ram cache), for the conditional requests of TileLoadService.
+    // thread safe. nullopt if the tile is not cached or has no data.
+    [[nodiscard]] std::optional<tile_types::TileLayer> cached_ortho_tile(const tile::Id& tile_id) const;
+    [[nodiscard]] std::optional<tile_types::TileLayer> cached_ortho_tile(const tile::Id& tile_id, unsigned source) const;
+    [[nodiscard]] std::optional<tile_types::TileLayer> cached_height_tile(const tile::Id& tile_id) const;
+    [[nodiscard]] std::optional<tile_types::TileLayer> cached_label_tile(const tile::Id& tile_id) const;
     
     nucleus::utils::ColourTexture::Format ortho_tile_compression_algorithm() const;
     void set_ortho_tile_compression_algorithm(nucleus::utils::ColourTexture::Format new_ortho_tile_compression_algorithm);
+    // the mip chains are computed (and compressed) by the decode workers. 1 means no mipmaps.
+    [[nodiscard]] unsigned ortho_tile_mip_levels() const;
+    void set_ortho_tile_mip_levels(unsigned new_ortho_tile_mip_levels);
+    // must match the tiles of the sources and the render window (AbstractRenderWindow::set_tile_format). the generated default
+    // tiles are replaced, cached gpu payloads of another format are decoded again.
+    [[nodiscard]] const tile_types::TileFormat& tile_format() const;
+    void set_tile_format(const tile_types::TileFormat& new_tile_format);
+
+    // if enabled, the transcoded textures and height rasters are stored in the ram and disk cache, so that quads are decoded only
+    // once. trades memory and disk space for cpu: a payload is about 160 KiB per quad, which counts against the ram byte limit
+    // (see set_ram_byte_limit), but not the quad limit. off by default, the warm tier (see set_warm_cache_byte_limit) already
+    // keeps the recently decoded quads within its own budget. uncompressed textures are never stored (4 bytes per pixel).
+    [[nodiscard]] bool gpu_payload_caching() const;
+    void set_gpu_payload_caching(bool new_gpu_payload_caching);
+
+    // the decode workers compute a normal map per tile (utils::normal_map) only if enabled, they are read by FEATURE_NORMAL_MODE 2
+    // only (AbstractRenderWindow::normal_maps_needed_changed). enabling it replaces the gpu quads, so that they are decoded again
+    // with normals. off by default.
+    [[nodiscard]] bool normal_maps() const;
+    void set_normal_maps(bool new_normal_maps);
+
+    // source of the current time (msecs since epoch) for the timeouts and the stamps of the gpu cache, utils::time_since_epoch
+    // by default. for tests.
+    void set_clock(std::function<uint64_t()> clock);
+
+    // prefetching: quads for the predicted view (the target of a camera animation, and the camera motion extrapolated by the horizon)
+    // are requested after the ones of the current view, at most budget quads per update. 0 disables prefetching (default).
+    void set_prefetch_budget(unsigned int new_prefetch_budget);
+    void set_prefetch_horizon(unsigned int new_prefetch_horizon); // msecs
+    // the idle requests come after all others, and are cancelled as soon as the camera moves. off with NetworkPolicy::prefetch.
+    void set_idle_prefetch(const IdlePrefetch& new_idle_prefetch);
+    [[nodiscard]] std::vector<camera::Definition> idle_prefetch_cameras() const; // the ring and the centre
+
+    // the policy follows set_network_metered. by default, the metered policy doesn't restrict anything either.
+    void set_network_policies(const NetworkPolicy& unmetered, const NetworkPolicy& metered);
+    [[nodiscard]] const NetworkPolicy& network_policy() const; // the active one
+    [[nodiscard]] std::vector<camera::Definition> predicted_cameras() const;
+
+    // number of threads used for decoding tiles before they are sent to the gpu. 1 means decoding on the scheduler thread.
+    [[nodiscard]] unsigned int decode_thread_count() const;
+    void set_decode_thread_count(unsigned int new_decode_thread_count);
+    // applied by the decode and io workers at the start of each task (see utils::ThreadPolicy)
+    void set_thread_policies(const nucleus::utils::ThreadPolicy& decode, const nucleus::utils::ThreadPolicy& io);
+
+    // decoded quads are emitted in batches of this size. 0 means all quads of one update are emitted together.
+    [[nodiscard]] unsigned int decode_batch_size() const;
+    void set_decode_batch_size(unsigned int new_decode_batch_size);
+
+    // the decode pool finishes the quads in the background and they are emitted from the scheduler's event loop, instead of
+    // update_gpu_quads waiting for the pool. for a scheduler on the browser's main thread (webassembly with
+    // ALP_ENABLE_DECODE_WORKERS), which must not block on the web workers. batches default to one quad per decode thread.
+    [[nodiscard]] bool asynchronous_decoding() const;
+    void set_asynchronous_decoding(bool new_asynchronous_decoding);
+
+    // thread safe. latest value wins: cameras posted while a delivery is queued replace the queued one, so a busy scheduler
+    // thread doesn't work through a backlog of outdated cameras. connect with Qt::DirectConnection.
+    void post_camera(const nucleus::camera::Definition& camera);
+
+    // 1 + the number of additional views
+    [[nodiscard]] size_t n_views() const;
 
 signals:
     void statistics_updated(Statistics stats);
     void quad_received(const tile::Id& ids);
+    // all needed quads that are not available, in the order of priority
     void quads_requested(const std::vector<tile::Id>& ids);
-    void gpu_quads_updated(const std::vector<tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads);
+    // the same, as changes since the last emission (for SlotLimiter::update_requests). a request is sent again if its priority
+    // changed noticeably, or if the quad was delivered but is still needed (e.g., after a network error).
+    void quad_requests_changed(const nucleus::tile_scheduler::tile_types::QuadRequestDiff& diff);
+    void gpu_quads_updated(const tile_types::GpuTileQuadBatch& new_quads, const std::vector<tile::Id>& deleted_quads);
+    // after a gpu update in which all quads of the current camera (and the views) were on the gpu already, or sent with the
+    // update. only evaluated if connected. quads that fail to load and the gpu quad limit can keep it from being emitted.
+    void gpu_quads_complete(const nucleus::camera::Definition& camera);
+    // bundle_requests of the active network policy, connect to TileLoadService::set_bundle_requests
+    void bundle_requests_changed(bool bundle_requests);
 
 public slots:
     void update_camera(const nucleus::camera::Definition& camera);
+    // additional views (e.g., an overview next to the main camera) share the caches and the gpu quads. the union of the quads of
+    // all views is requested and kept on the gpu. view 0 is the main camera (same as update_camera).
+    void update_view_camera(unsigned view, const nucleus::camera::Definition& camera);
+    void remove_view(unsigned view);
     void receive_quad(const tile_types::TileQuad& new_quad);
+    // connect to SlotLimiter::quads_delivered. the whole batch is inserted before scheduling a single update
+    void receive_quads(const tile_types::TileQuadBatch& new_quads);
     void set_network_reachability(QNetworkInformation::Reachability reachability);
+    // metered connections (QNetworkInformation::isMetered, or cellular) use the metered network policy
+    void set_network_metered(bool metered);
     void update_gpu_quads();
     void send_quad_requests();
     void purge_ram_cache();
+    // queues an incremental write of the ram cache on the io thread (see Cache::persist, flush_to_pack by default)
     void persist_tiles();
+    // lazy variant of read_disk_cache: reads only the index and streams the quads in afterwards, in batches, prioritised by the
+    // refine traversal of the current camera. returns immediately, so it doesn't block the first frame.
+    void open_disk_cache();
+    // mounts a read only tile pack (e.g., compiled into the resources, see ALP_BASE_TILE_PACK) as the lowest cache tier of the
+    // default source. its quads are inserted right away unless the ram or disk cache has them, so that the first frame shows the
+    // coarse terrain without waiting for the network. quads that were purged since are taken from it again before asking the
+    // network. call after open_disk_cache. the stored network timestamps are kept, so outdated quads are refreshed when online.
+    void open_base_pack(const std::filesystem::path& path);
+    // persists the ram cache and purges it to the low water mark
+    void handle_memory_pressure();
+    // no updates while suspended. memory pressure is handled on suspend, as mobile os's kill background apps with large footprints.
+    void set_suspended(bool new_suspended);
+    // connect to AbstractRenderWindow::gpu_tiles_released. forgets the quads on the gpu, they are sent again with the next update.
+    void release_gpu_quads();
+    // for the statistics, connect to SlotLimiter::limit_changed
+    void set_request_slot_count(unsigned new_request_slot_count);
+    // connect to camera::Controller::animation_target_changed. dropped when the camera arrives.
+    void set_prefetch_target(const nucleus::camera::Definition& camera);
+    // connect to AbstractRenderWindow::occluded_tiles_changed. requests for these tiles and their descendants are sent last.
+    void set_occluded_tiles(const std::vector<tile::Id>& tiles);
+    // connect to AbstractRenderWindow::hidden_quads_changed. these quads and their descendants are evicted from the gpu first
+    // (they are not marked visited) and requested last.
+    void set_hidden_quads(const std::vector<tile::Id>& quads);
+    // one-off requests, e.g., for elevation profiles (see DataQuerier::set_quad_fetcher). they are sent after the pinned quads
+    // until they arrived or are known to be missing. they are not pinned, so they are purged like the others.
+    void request_quads(const std::vector<tile::Id>& quads);
 
 protected:
+    [[nodiscard]] bool is_occluded(tile::Id id) const;
+    [[nodiscard]] bool is_hidden(tile::Id id) const;
+    void update_pinned_quads();
     void schedule_update();
+    void schedule_camera_update(bool camera_was_at_rest);
+    void publish_gpu_quads(tile_types::GpuTileQuadBatch new_quads, std::vector<tile::Id> deleted_quads);
+    [[nodiscard]] unsigned camera_update_interval() const; // msecs, see set_adaptive_update_cadence
     void schedule_purge();
     void schedule_persist();
     void update_stats();
+    bool insert_received_quad(const tile_types::TileQuad& new_quad); // false if the quad was dropped
+    void load_disk_cache_batch();
+    void take_posted_camera();
+    void report_gpu_completeness();
+    void cancel_idle_prefetch();
+    // the needed quads (the resident ones, with whether their residency is kept, and the candidates) with the largest benefit per
+    // cost, at most capacity. always contains the parents of the selected quads.
+    [[nodiscard]] std::unordered_set<tile::Id, tile::Id::Hasher> select_gpu_quads(const std::unordered_map<tile::Id, bool, tile::Id::Hasher>& resident,
+        const std::vector<tile_types::TileQuad>& candidates, unsigned capacity) const;
+    void emit_request_diff(const std::vector<tile_types::QuadRequest>& requests);
+    void write_disk_cache(); // thread safe, runs on the io thread
+    [[nodiscard]] std::filesystem::path disk_cache_path(unsigned source) const;
+    void open_pack(unsigned source);
+    unsigned load_from_base_pack(std::span<const tile::Id> ids); // returns the number of inserted quads
     std::vector<tile::Id> tiles_for_current_camera_position() const;
+    std::vector<tile::Id> tiles_for_camera(const camera::Definition& camera) const;
+    // shared by the traversals of the current camera, recreated when the camera changes
+    [[nodiscard]] const CameraTraversal& camera_traversal() const;
+    // union of all views: a quad is refined if any of the views refines it
+    [[nodiscard]] bool refine(const tile::Id& id, float error_threshold_px) const;
+    [[nodiscard]] auto refine_functor(float error_threshold_px) const
+    {
+        return [this, error_threshold_px](const tile::Id& id) { return refine(id, error_threshold_px); };
+    }
+    // the largest of all views
+    [[nodiscard]] float screen_space_error(const tile::Id& id) const;
+    // all four tiles not found and without data (outside of the coverage area)
+    static bool is_missing(const tile_types::TileQuad& quad);
+    [[nodiscard]] std::filesystem::path missing_quads_path(unsigned source) const;
+    void read_missing_quads(unsigned source);
+    // what a decode depends on besides the quad. copied into each decode batch, so that the setters (set_tile_format,
+    // set_ortho_tile_compression_algorithm, ...) on the scheduler thread don't race with the decode workers.
+    struct DecodeSettings {
+        tile_types::TileFormat tile_format;
+        nucleus::utils::ColourTexture::Format ortho_compression = nucleus::utils::ColourTexture::Format::Uncompressed_RGBA;
+        unsigned ortho_mip_levels = 1;
+        bool normal_maps = false;
+        std::shared_ptr<QByteArray> default_ortho_tile;
+        std::shared_ptr<QByteArray> default_height_tile;
+        unsigned generation = 0; // m_format_generation at the time of the copy
+    };
+    [[nodiscard]] DecodeSettings decode_settings() const;
+    tile_types::GpuTileQuad to_gpu_quad(const tile_types::TileQuad& quad, const DecodeSettings& settings) const;
+    // hands the exact height range of a decoded raster to the aabb decorator, returns the tightened bounds
+    tile::SrsAndHeightBounds tighten_bounds(const tile::Id& id, const nucleus::Raster<uint16_t>& heights) const;
+    [[nodiscard]] bool should_store_gpu_payload(const tile_types::TileQuad& quad) const;
+    void store_gpu_payload(tile_types::TileQuad quad, const tile_types::GpuTileQuad& gpu_quad);
+    // revalidated tiles (304) come back with the cached payloads, their transcoded data is still valid
+    void keep_unchanged_gpu_payloads(tile_types::TileQuad& quad, const MemoryCache& cache) const;
+    struct DecodeBatch; // of the asynchronous decoding
+    void start_decode_batch(std::shared_ptr<DecodeBatch> batch);
+    void finish_decode_batch(DecodeBatch& batch);
 
 private:
     unsigned m_retirement_age_for_tile_cache = 10u * 24u * 3600u * 1000u; // 10 days
     float m_permissible_screen_space_error = 2;
+    float m_ortho_permissible_screen_space_error = 2;
+    float m_height_permissible_screen_space_error = 2;
+    float m_refinement_hysteresis = 0.8f;
+    unsigned m_gpu_min_residency = 500;
     unsigned m_update_timeout = 100;
     unsigned m_purge_timeout = 1000;
     unsigned m_persist_timeout = 10000;
     unsigned m_gpu_quad_limit = 300;
     unsigned m_ram_quad_limit = 15000;
-    static constexpr unsigned m_ortho_tile_size = 256;
-    static constexpr unsigned m_height_tile_size = 65;
+    uint64_t m_gpu_byte_limit = std::numeric_limits<uint64_t>::max();
+    uint64_t m_ram_byte_limit = std::numeric_limits<uint64_t>::max();
+    unsigned m_ram_low_water_mark = 2000;
+    unsigned m_disk_quad_limit = 0;
+    uint64_t m_disk_byte_limit = std::numeric_limits<uint64_t>::max();
+    bool m_release_gpu_when_suspended = false;
+    bool m_suspended = false;
+    unsigned m_decode_thread_count = 1;
+    unsigned m_decode_batch_size = 0;
+    unsigned m_disk_load_batch_size = 64;
+    bool m_gpu_payload_caching = false;
+    bool m_normal_maps = false;
+    tile_types::TileFormat m_tile_format;
+    bool m_generated_default_tiles = false; // replaced by set_tile_format
+    mutable std::unique_ptr<CameraTraversal> m_camera_traversal;
+    mutable std::map<unsigned, std::unique_ptr<CameraTraversal>> m_view_traversals; // created on demand, like m_camera_traversal
+    mutable ParallelTraversal m_parallel_traversal; // for tiles_for_current_camera_position and tiles_for_camera
+    unsigned m_aabb_version = 0; // of the aabb decorator, when the traversals were last reset
     bool m_enabled = false;
     bool m_network_requests_enabled = true;
+    bool m_network_metered = false;
+    NetworkPolicy m_unmetered_network_policy;
+    NetworkPolicy m_metered_network_policy;
     Statistics m_statistics;
+    LatencyTracerPtr m_latency_tracer = std::make_shared<LatencyTracer>();
+    uint64_t m_latency_report_version = 0; // LatencyTracer::n_finished of m_statistics.tile_latency
     std::unique_ptr<QTimer> m_update_timer;
+    std::unique_ptr<QTimer> m_settle_timer; // fires once the camera is at rest, adaptive update cadence only
+    static constexpr unsigned camera_rest_msecs = 500; // no camera changes for this long: the camera is at rest
+    bool m_adaptive_update_cadence = false;
+    unsigned m_min_update_interval = 16;
+    uint64_t m_last_update = 0; // msecs since epoch, when the update timer fired
+    std::function<uint64_t()> m_clock = utils::time_since_epoch;
+    std::shared_ptr<tile_types::GpuQuadMailbox> m_gpu_quad_mailbox;
     std::unique_ptr<QTimer> m_purge_timer;
     std::unique_ptr<QTimer> m_persist_timer;
+    std::unique_ptr<QTimer> m_disk_load_timer;
+    std::unique_ptr<QThreadPool> m_decode_pool;
+    bool m_asynchronous_decoding = false;
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_decoding; // asynchronously, results pending
+    unsigned m_decode_generation = 0; // incremented when the tile source or the normal maps change, older batches are dropped
+    unsigned m_format_generation = 0; // incremented when DecodeSettings change, older batches are decoded again
+    std::unique_ptr<QThreadPool> m_io_pool; // a single thread, so that writes don't overlap
+    nucleus::utils::ThreadPolicy m_decode_thread_policy = nucleus::utils::ThreadPolicies().decode;
+    nucleus::utils::ThreadPolicy m_io_thread_policy = nucleus::utils::ThreadPolicies().io;
+    std::atomic<bool> m_persist_queued = false;
+    std::atomic<unsigned> m_n_persists = 0; // written on the io thread, copied into m_statistics by update_stats
+    std::atomic<float> m_last_persist_msecs = 0;
+    std::atomic<float> m_max_persist_msecs = 0;
+    bool m_persistence_used = false;
     camera::Definition m_current_camera;
+    std::map<unsigned, camera::Definition> m_view_cameras; // additional views, written under m_layer_selection_mutex
+    glm::dvec3 m_camera_velocity = {}; // world units per msec, smoothed
+    uint64_t m_last_camera_update = 0;
+    std::optional<camera::Definition> m_prefetch_target;
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_occluded_tiles;
+    std::unordered_map<tile::Id, tile_types::QuadRequest, tile::Id::Hasher> m_sent_requests; // as of the last quad_requests_changed
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_hidden_quads;
+    unsigned m_pinned_levels = 0;
+    std::vector<tile::Id> m_pinned_region_quads; // as set
+    std::vector<tile::Id> m_pinned_quad_list; // levels and regions, coarse first (request order)
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_pinned_quads; // same
+    std::vector<tile::Id> m_requested_quads; // see request_quads, in the order of the calls
+    unsigned m_prefetch_budget = 0;
+    unsigned m_prefetch_horizon = 1000;
+    IdlePrefetch m_idle_prefetch;
+    std::unique_ptr<QTimer> m_idle_prefetch_timer; // fires after the delay at rest
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_idle_prefetched; // requested during this rest of the camera
     utils::AabbDecoratorPtr m_aabb_decorator;
-    Cache<tile_types::TileQuad> m_ram_cache;
-    Cache<tile_types::GpuCacheInfo> m_gpu_cached;
+    struct SourceCache {
+        std::string name;
+        MemoryCache ram;
+        // not found by this source. changed on the scheduler thread under m_missing_quads_mutex, written to disk on the io thread
+        MissingQuadSet missing;
+        std::atomic<bool> pack_opened = false; // read on the io thread
+    };
+    std::vector<std::unique_ptr<SourceCache>> m_sources; // fixed once the disk cache is opened
+    std::atomic<unsigned> m_tile_source = 0;
+    bool m_disk_cache_opened = false;
+    std::unique_ptr<TilePack> m_base_pack; // read only, see open_base_pack
+    std::vector<tile::Id> m_replaced_gpu_quads; // of the previous tile source, deleted with the next update
+    mutable std::mutex m_missing_quads_mutex; // guards SourceCache::missing of all sources
+    Cache<tile_types::GpuCacheInfo, FlatTileMap> m_gpu_cached;
+    // decoded tiles by (interned) payload, so that identical tiles (defaults, ocean, not found) are decoded only once.
+    // the source is kept alive, so that its address can't be reused while it's a key.
+    template <typename Decoded>
+    struct MemoisedDecode {
+        std::shared_ptr<QByteArray> source;
+        std::shared_ptr<const Decoded> decoded;
+        unsigned generation = 0; // DecodeSettings::generation, a decode that finished after a format change is not reused
+    };
+    mutable std::mutex m_decode_memo_mutex;
+    // layers_for_tile is called from the network thread. guards the writes of the camera and the thresholds, and reads off thread.
+    mutable std::mutex m_layer_selection_mutex;
+    std::mutex m_posted_camera_mutex;
+    std::optional<camera::Definition> m_posted_camera;
+    mutable nucleus::utils::LruCache<const QByteArray*, MemoisedDecode<nucleus::utils::ColourTexture>> m_ortho_memo { 32 };
+    mutable nucleus::utils::LruCache<const QByteArray*, MemoisedDecode<nucleus::Raster<uint16_t>>> m_height_memo { 32 };
+    // decoded quads by id, valid as long as the ram cache quad still has the payloads it was decoded from (scheduler thread only).
+    // quads with inherited layers are not kept, their source is an ancestor.
+    struct WarmGpuQuad {
+        tile_types::GpuTileQuad quad;
+        std::array<std::weak_ptr<QByteArray>, 12> sources; // ortho, height and labels of the four tiles
+    };
+    nucleus::utils::LruCache<tile::Id, WarmGpuQuad, tile::Id::Hasher> m_warm_gpu_quads { std::numeric_limits<unsigned>::max() };
+    [[nodiscard]] const tile_types::GpuTileQuad* find_warm_gpu_quad(const tile_types::TileQuad& quad);
+    void keep_warm_gpu_quad(const tile_types::TileQuad& quad, const tile_types::GpuTileQuad& gpu_quad);
     std::shared_ptr<QByteArray> m_default_ortho_tile;
     std::shared_ptr<QByteArray> m_default_height_tile;
     nucleus::utils::ColourTexture::Format m_ortho_tile_compression_algorithm = nucleus::utils::ColourTexture::Format::Uncompressed_RGBA;
+    unsigned m_ortho_tile_mip_levels = 1;
 };
 }
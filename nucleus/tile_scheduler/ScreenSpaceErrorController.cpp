@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ScreenSpaceErrorController.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace nucleus::tile_scheduler {
+
+namespace {
+    constexpr float frame_time_smoothing = 0.2f; // weight of a new measurement
+    constexpr float coarsen_above_load = 1.1f;
+    constexpr float refine_below_load = 0.8f;
+    constexpr float report_threshold = 0.05f; // relative change of the error before it is reported
+} // namespace
+
+ScreenSpaceErrorController::ScreenSpaceErrorController(const Settings& settings)
+    : m_settings(settings)
+{
+    reset();
+}
+
+const ScreenSpaceErrorController::Settings& ScreenSpaceErrorController::settings() const { return m_settings; }
+
+void ScreenSpaceErrorController::set_settings(const Settings& new_settings)
+{
+    assert(new_settings.min_error > 0 && new_settings.min_error <= new_settings.max_error);
+    if (new_settings == m_settings)
+        return;
+    m_settings = new_settings;
+    reset();
+}
+
+void ScreenSpaceErrorController::set_base_error(float new_base_error)
+{
+    if (new_base_error == m_base_error)
+        return;
+    m_base_error = new_base_error;
+    reset();
+}
+
+float ScreenSpaceErrorController::base_error() const { return m_base_error; }
+
+float ScreenSpaceErrorController::error() const { return m_error; }
+
+float ScreenSpaceErrorController::load() const { return m_load; }
+
+void ScreenSpaceErrorController::reset()
+{
+    m_desired_error = m_settings.enabled ? std::clamp(m_base_error, m_settings.min_error, m_settings.max_error) : m_base_error;
+    m_error = m_desired_error;
+    m_has_measurement = false;
+    m_load = 1.0f;
+}
+
+bool ScreenSpaceErrorController::update(float frame_msecs, unsigned n_gpu_quads)
+{
+    if (!m_settings.enabled)
+        return false;
+
+    m_smoothed_frame_msecs = m_has_measurement ? std::lerp(m_smoothed_frame_msecs, frame_msecs, frame_time_smoothing) : frame_msecs;
+    m_has_measurement = true;
+    m_load = m_smoothed_frame_msecs / m_settings.target_frame_msecs;
+    if (m_settings.target_gpu_quads > 0)
+        m_load = std::max(m_load, float(n_gpu_quads) / float(m_settings.target_gpu_quads));
+
+    // the step is proportional to the distance from the target, but at most gain
+    if (m_load > coarsen_above_load)
+        m_desired_error *= 1.0f + m_settings.gain * std::min(m_load - 1.0f, 1.0f);
+    else if (m_load < refine_below_load)
+        m_desired_error /= 1.0f + m_settings.gain * std::min(1.0f - m_load, 1.0f);
+    m_desired_error = std::clamp(m_desired_error, m_settings.min_error, m_settings.max_error);
+
+    const auto at_bound = m_desired_error == m_settings.min_error || m_desired_error == m_settings.max_error;
+    if (m_desired_error == m_error || (!at_bound && std::abs(m_desired_error / m_error - 1.0f) < report_threshold))
+        return false;
+    m_error = m_desired_error;
+    return true;
+}
+
+} // namespace nucleus::tile_scheduler
@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+namespace nucleus::tile_scheduler {
+
+/// Feedback controller for the permissible screen space error. It coarsens the tiles if the frame time or the number of
+/// gpu quads exceed their target, and refines them again if there is headroom, always within [min_error, max_error].
+/// Updates are multiplicative and have a dead band around the target (refining raises the load, a single threshold would
+/// oscillate), and the error is only reported as changed once it moved noticeably, so that the draw list isn't regenerated
+/// every frame. Not thread safe, the renderer owns it and forwards changes to the scheduler.
+class ScreenSpaceErrorController {
+public:
+    struct Settings {
+        bool enabled = false; // if disabled, error() is the base error
+        float min_error = 1.0f; // in pixels, user set bounds
+        float max_error = 8.0f;
+        float target_frame_msecs = 1000.0f / 60.0f;
+        unsigned target_gpu_quads = 0; // 0 ignores the quad count
+        float gain = 0.1f; // maximal relative change per update
+        bool operator==(const Settings&) const = default;
+    };
+
+    ScreenSpaceErrorController() = default;
+    explicit ScreenSpaceErrorController(const Settings& settings);
+
+    [[nodiscard]] const Settings& settings() const;
+    void set_settings(const Settings& new_settings);
+
+    /// the error set by the user (render quality). the controller restarts from there if it changed.
+    void set_base_error(float new_base_error);
+    [[nodiscard]] float base_error() const;
+
+    /// feeds the measurements of a frame, returns true if error() changed
+    bool update(float frame_msecs, unsigned n_gpu_quads);
+    /// the error that should be used by the scheduler and the draw list generator
+    [[nodiscard]] float error() const;
+    /// smoothed ratio between the measurements and their targets (1 is on target), for debugging.
+    [[nodiscard]] float load() const;
+
+private:
+    void reset();
+
+    Settings m_settings;
+    float m_base_error = 2.0f;
+    float m_error = 2.0f; // reported
+    float m_desired_error = 2.0f; // continuous
+    float m_smoothed_frame_msecs = 0.0f;
+    bool m_has_measurement = false;
+    float m_load = 1.0f;
+};
+
+} // namespace nucleus::tile_scheduler
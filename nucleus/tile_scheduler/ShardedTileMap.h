@@ -0,0 +1,136 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "radix/tile.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Tile map split into quad tree subtrees (shards), each with its own mutex, so that threads working in different regions
+/// don't contend. A tile is in the shard of its ancestor at shard_zoom_level, the coarser tiles are in shard 0. The shards
+/// are a fixed array, so finding the one of a tile is arithmetic and doesn't need a lock.
+/// The map doesn't lock by itself: the owner takes shard_mutex(id) (or lock_all) for the accesses that need it. lock_all locks
+/// in index order, a top down traversal locks the coarse shard before the one of a subtree, so the two don't deadlock.
+/// ShardZoomLevel 0 keeps everything in a single shard (e.g., for a single thread, see CachePolicy).
+template <typename Value, template <typename> class Map, unsigned ShardZoomLevel = 4, typename Mutex = std::shared_mutex>
+class ShardedTileMap {
+public:
+    static constexpr unsigned shard_zoom_level = ShardZoomLevel;
+    static constexpr bool sharded = shard_zoom_level > 0;
+    static constexpr size_t n_shards = sharded ? (size_t(1) << (2 * shard_zoom_level)) + 1 : 1;
+
+    [[nodiscard]] static size_t shard_index(const tile::Id& id)
+    {
+        if (!sharded || id.zoom_level < shard_zoom_level)
+            return 0;
+        const auto shift = id.zoom_level - shard_zoom_level;
+        return 1 + ((size_t(id.coords.x >> shift) << shard_zoom_level) | size_t(id.coords.y >> shift));
+    }
+
+    [[nodiscard]] Mutex& shard_mutex(const tile::Id& id) const { return m_shards[shard_index(id)].mutex; }
+
+    /// exclusive locks of all shards, e.g., for bulk loads or for copying the whole map
+    [[nodiscard]] std::vector<std::unique_lock<Mutex>> lock_all() const
+    {
+        std::vector<std::unique_lock<Mutex>> locks;
+        locks.reserve(n_shards);
+        for (auto& shard : m_shards)
+            locks.emplace_back(shard.mutex);
+        return locks;
+    }
+
+    /// sum over all shards, readable without a lock
+    [[nodiscard]] size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] Value* find(const tile::Id& id)
+    {
+        auto& map = m_shards[shard_index(id)].map;
+        const auto it = map.find(id);
+        return it == map.end() ? nullptr : &it->second;
+    }
+    [[nodiscard]] const Value* find(const tile::Id& id) const { return const_cast<ShardedTileMap*>(this)->find(id); }
+    [[nodiscard]] bool contains(const tile::Id& id) const { return find(id) != nullptr; }
+
+    [[nodiscard]] const Value& at(const tile::Id& id) const
+    {
+        const auto* value = find(id);
+        if (!value)
+            throw std::out_of_range("ShardedTileMap::at: id not found");
+        return *value;
+    }
+
+    Value& operator[](const tile::Id& id)
+    {
+        auto& map = m_shards[shard_index(id)].map;
+        const auto n = map.size();
+        auto& value = map[id];
+        m_size.fetch_add(map.size() - n, std::memory_order_relaxed);
+        return value;
+    }
+
+    size_t erase(const tile::Id& id)
+    {
+        const auto n = m_shards[shard_index(id)].map.erase(id);
+        m_size.fetch_sub(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    void clear()
+    {
+        for (auto& shard : m_shards)
+            shard.map.clear();
+        m_size = 0;
+    }
+
+    /// functor(id, value) for all entries, shard by shard
+    template <typename Functor>
+    void for_each(const Functor& functor) const
+    {
+        for (const auto& shard : m_shards) {
+            for (const auto& [id, value] : shard.map)
+                functor(id, value);
+        }
+    }
+
+    /// copy of all entries in a single map
+    [[nodiscard]] Map<Value> merged() const
+    {
+        Map<Value> map;
+        for_each([&map](const tile::Id& id, const Value& value) { map[id] = value; });
+        return map;
+    }
+
+private:
+    struct Shard {
+        Map<Value> map;
+        mutable Mutex mutex;
+    };
+    std::array<Shard, n_shards> m_shards;
+    std::atomic<size_t> m_size = 0;
+};
+
+} // namespace nucleus::tile_scheduler
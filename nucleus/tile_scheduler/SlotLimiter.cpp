@@ -18,6 +18,11 @@
 
 #include "SlotLimiter.h"
 
+#include <algorithm>
+#include <utility>
+
+#include "utils.h"
+
 using namespace nucleus::tile_scheduler;
 
 SlotLimiter::SlotLimiter(QObject* parent)
@@ -41,29 +46,145 @@ unsigned SlotLimiter::slots_taken() const
     return unsigned(m_in_flight.size());
 }
 
+void SlotLimiter::set_cancel_stale_requests(bool new_cancel_stale_requests)
+{
+    m_cancel_stale_requests = new_cancel_stale_requests;
+}
+
+void SlotLimiter::set_adaptive(bool new_adaptive, unsigned min_limit, unsigned max_limit)
+{
+    assert(min_limit > 0);
+    assert(min_limit <= max_limit);
+    m_adaptive = new_adaptive;
+    m_min_limit = min_limit;
+    m_max_limit = max_limit;
+    if (m_adaptive)
+        m_limit = std::clamp(m_limit, m_min_limit, m_max_limit);
+}
+
+bool SlotLimiter::adaptive() const
+{
+    return m_adaptive;
+}
+
+SlotLimiter::Statistics SlotLimiter::statistics() const
+{
+    return { m_limit, slots_taken(), m_smoothed_round_trip_msecs };
+}
+
 void SlotLimiter::request_quads(const std::vector<tile::Id>& ids)
 {
     m_request_queue.clear();
-    for (const tile::Id& id : ids) {
-        if (m_in_flight.contains(id))
-            continue;
-        if (m_in_flight.size() >= m_limit) {
-            m_request_queue.push_back(id);
-        } else {
-            m_in_flight.insert(id);
-            emit quad_requested(id);
+    m_queued.clear();
+    if (m_cancel_stale_requests && !m_in_flight.empty()) {
+        const std::unordered_set<tile::Id, tile::Id::Hasher> requested(ids.begin(), ids.end());
+        std::vector<tile::Id> stale;
+        for (const auto& [id, request_time] : m_in_flight) {
+            if (!requested.contains(id))
+                stale.push_back(id);
         }
+        for (const auto& id : stale)
+            m_in_flight.erase(id);
+        if (!stale.empty())
+            emit quads_cancelled(stale);
+    }
+    // the position in the list is the priority
+    for (size_t i = 0; i < ids.size(); ++i)
+        enqueue({ ids[i], tile_types::QuadRequest::Tier::Visible, float(ids.size() - i) });
+    request_from_queue();
+}
+
+void SlotLimiter::update_requests(const tile_types::QuadRequestDiff& diff)
+{
+    std::vector<tile::Id> stale;
+    for (const auto& id : diff.removed) {
+        dequeue(id);
+        if (m_cancel_stale_requests && m_in_flight.erase(id) > 0)
+            stale.push_back(id);
     }
+    if (!stale.empty())
+        emit quads_cancelled(stale);
+    for (const auto& request : diff.added)
+        enqueue(request);
+    request_from_queue();
+}
+
+void SlotLimiter::enqueue(const tile_types::QuadRequest& request)
+{
+    if (m_in_flight.contains(request.id))
+        return;
+    dequeue(request.id);
+    m_request_queue.insert(request);
+    m_queued[request.id] = request;
+}
+
+void SlotLimiter::dequeue(const tile::Id& id)
+{
+    const auto it = m_queued.find(id);
+    if (it == m_queued.end())
+        return;
+    m_request_queue.erase(it->second);
+    m_queued.erase(it);
 }
 
 void SlotLimiter::deliver_quad(const tile_types::TileQuad& tile)
 {
-    m_in_flight.erase(tile.id);
+    const auto in_flight = m_in_flight.find(tile.id);
+    if (in_flight != m_in_flight.end()) {
+        const auto now = utils::time_since_epoch();
+        if (m_adaptive)
+            adapt_limit(tile.network_info().status, now - std::min(now, in_flight->second), now);
+        m_in_flight.erase(in_flight);
+    }
     emit quad_delivered(tile);
-    if (m_request_queue.empty())
+    if (m_delivery_batch.empty())
+        QMetaObject::invokeMethod(this, &SlotLimiter::flush_deliveries, Qt::QueuedConnection);
+    m_delivery_batch.push_back(tile);
+    request_from_queue();
+}
+
+void SlotLimiter::flush_deliveries()
+{
+    if (m_delivery_batch.empty())
         return;
+    emit quads_delivered(std::make_shared<const std::vector<tile_types::TileQuad>>(std::exchange(m_delivery_batch, {})));
+}
 
-    m_in_flight.insert(m_request_queue.front());
-    emit quad_requested(m_request_queue.front());
-    m_request_queue.erase(m_request_queue.cbegin());
+void SlotLimiter::adapt_limit(tile_types::NetworkInfo::Status status, uint64_t round_trip_msecs, uint64_t now)
+{
+    const auto old_limit = m_limit;
+    if (status == tile_types::NetworkInfo::Status::NetworkError) {
+        // errors of requests that were in flight together are one congestion event
+        if (now - m_last_decrease_msecs >= uint64_t(m_smoothed_round_trip_msecs)) {
+            m_limit = std::max(m_min_limit, m_limit / 2);
+            m_last_decrease_msecs = now;
+            m_increase_credit = 0;
+        }
+    } else {
+        const auto rtt = float(round_trip_msecs);
+        m_smoothed_round_trip_msecs = m_smoothed_round_trip_msecs == 0 ? rtt : 0.875f * m_smoothed_round_trip_msecs + 0.125f * rtt;
+        m_min_round_trip_msecs = std::min(m_min_round_trip_msecs, rtt);
+        const auto queueing = m_smoothed_round_trip_msecs > 3 * m_min_round_trip_msecs + 100;
+        if (!queueing) {
+            m_increase_credit += 1.f / float(m_limit);
+            if (m_increase_credit >= 1) {
+                m_increase_credit = 0;
+                m_limit = std::min(m_max_limit, m_limit + 1);
+            }
+        }
+    }
+    if (m_limit != old_limit)
+        emit limit_changed(m_limit);
+}
+
+void SlotLimiter::request_from_queue()
+{
+    const auto now = utils::time_since_epoch();
+    while (!m_request_queue.empty() && m_in_flight.size() < m_limit) {
+        const auto id = m_request_queue.begin()->id;
+        m_request_queue.erase(m_request_queue.begin());
+        m_queued.erase(id);
+        m_in_flight[id] = now;
+        emit quad_requested(id);
+    }
 }
@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <limits>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <QObject>
@@ -32,23 +35,66 @@ class SlotLimiter : public QObject {
     Q_OBJECT
 
     unsigned m_limit = 16;
-    std::unordered_set<tile::Id, tile::Id::Hasher> m_in_flight;
-    std::vector<tile::Id> m_request_queue;
+    bool m_cancel_stale_requests = false;
+    std::unordered_map<tile::Id, uint64_t, tile::Id::Hasher> m_in_flight; // request time in msecs
+    // persistent priority queue, updated by the diffs of the scheduler (or rebuilt by request_quads)
+    std::set<tile_types::QuadRequest, tile_types::QuadRequest::Before> m_request_queue;
+    std::unordered_map<tile::Id, tile_types::QuadRequest, tile::Id::Hasher> m_queued; // the entries of m_request_queue by id
+    std::vector<tile_types::TileQuad> m_delivery_batch; // flushed once per event loop iteration
+
+    // adaptive mode (additive increase, multiplicative decrease)
+    bool m_adaptive = false;
+    unsigned m_min_limit = 2;
+    unsigned m_max_limit = 64;
+    float m_smoothed_round_trip_msecs = 0;
+    float m_min_round_trip_msecs = std::numeric_limits<float>::max();
+    float m_increase_credit = 0;
+    uint64_t m_last_decrease_msecs = 0;
 
 public:
+    struct Statistics {
+        unsigned limit = 0;
+        unsigned slots_taken = 0;
+        float smoothed_round_trip_msecs = 0;
+    };
+
     explicit SlotLimiter(QObject* parent = nullptr);
 
     void set_limit(unsigned int new_limit);
     [[nodiscard]] unsigned int limit() const;
     unsigned int slots_taken() const;
+    // if enabled, quads in flight that are missing from a new request list are cancelled (see quads_cancelled) and free their slot
+    void set_cancel_stale_requests(bool new_cancel_stale_requests);
+
+    // if enabled, the limit adapts to the link: it grows by one slot per window of successful deliveries (i.e., per limit
+    // quads), is held while the round trip time rises well above the fastest observed one (queueing), and is halved on network
+    // errors (at most once per round trip). set_limit sets the starting point.
+    void set_adaptive(bool new_adaptive, unsigned min_limit = 2, unsigned max_limit = 64);
+    [[nodiscard]] bool adaptive() const;
+    [[nodiscard]] Statistics statistics() const;
 
 public slots:
+    // replaces all requests, the list is in the order of priority
     void request_quads(const std::vector<tile::Id>& id);
+    // incremental variant (connect to Scheduler::quad_requests_changed): added requests are queued by their priority (or
+    // reprioritised), removed ones are dropped from the queue, and cancelled if in flight and stale requests are cancelled.
+    void update_requests(const tile_types::QuadRequestDiff& diff);
     void deliver_quad(const tile_types::TileQuad& tile);
 
 signals:
     void quad_requested(const tile::Id& tile_id);
     void quad_delivered(const tile_types::TileQuad& id);
+    // all quads delivered during one event loop iteration, emitted from the event loop after quad_delivered
+    void quads_delivered(const tile_types::TileQuadBatch& quads);
+    void quads_cancelled(const std::vector<tile::Id>& ids);
+    void limit_changed(unsigned limit);
+
+private:
+    void adapt_limit(tile_types::NetworkInfo::Status status, uint64_t round_trip_msecs, uint64_t now);
+    void enqueue(const tile_types::QuadRequest& request);
+    void dequeue(const tile::Id& id);
+    void request_from_queue();
+    void flush_deliveries();
 };
 
 }
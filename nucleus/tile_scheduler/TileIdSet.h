@@ -0,0 +1,95 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <tuple>
+#include <vector>
+
+#include "radix/tile.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Set of tile ids in a sorted vector. clear() keeps the storage, so a set that is refilled every frame (draw lists)
+/// doesn't allocate once it has grown to its working size. contains() is a binary search.
+/// Inserting ids in ascending order appends, anything else shifts the tail (use assign() for bulk unsorted input).
+class TileIdSet {
+public:
+    using value_type = tile::Id;
+    using const_iterator = std::vector<tile::Id>::const_iterator;
+    using iterator = const_iterator;
+
+    struct Less {
+        bool operator()(const tile::Id& a, const tile::Id& b) const
+        {
+            return std::tie(a.zoom_level, a.coords.x, a.coords.y) < std::tie(b.zoom_level, b.coords.x, b.coords.y);
+        }
+    };
+
+    TileIdSet() = default;
+    TileIdSet(std::initializer_list<tile::Id> ids) { assign(ids.begin(), ids.end()); }
+
+    [[nodiscard]] const_iterator begin() const { return m_ids.begin(); }
+    [[nodiscard]] const_iterator end() const { return m_ids.end(); }
+    [[nodiscard]] size_t size() const { return m_ids.size(); }
+    [[nodiscard]] bool empty() const { return m_ids.empty(); }
+    [[nodiscard]] size_t capacity() const { return m_ids.capacity(); }
+
+    [[nodiscard]] bool contains(const tile::Id& id) const { return std::binary_search(m_ids.begin(), m_ids.end(), id, Less {}); }
+
+    bool insert(const tile::Id& id)
+    {
+        if (m_ids.empty() || Less {}(m_ids.back(), id)) {
+            m_ids.push_back(id);
+            return true;
+        }
+        const auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id, Less {});
+        if (it != m_ids.end() && *it == id)
+            return false;
+        m_ids.insert(it, id);
+        return true;
+    }
+
+    /// replaces the content, the input doesn't need to be sorted or unique
+    template <typename Iterator>
+    void assign(Iterator first, Iterator last)
+    {
+        m_ids.assign(first, last);
+        std::sort(m_ids.begin(), m_ids.end(), Less {});
+        m_ids.erase(std::unique(m_ids.begin(), m_ids.end()), m_ids.end());
+    }
+
+    /// keeps the order, returns the number of removed ids
+    template <typename Predicate>
+    size_t erase_if(Predicate predicate)
+    {
+        return std::erase_if(m_ids, predicate);
+    }
+
+    void clear() { m_ids.clear(); }
+    void reserve(size_t n) { m_ids.reserve(n); }
+
+    bool operator==(const TileIdSet& other) const { return m_ids == other.m_ids; }
+
+private:
+    std::vector<tile::Id> m_ids;
+};
+
+} // namespace nucleus::tile_scheduler
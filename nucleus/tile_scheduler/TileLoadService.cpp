@@ -18,80 +18,505 @@
 
 #include "TileLoadService.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include <QDebug>
 #include <QImage>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QPointer>
+#include <QTimer>
+#include <QThread>
 #include <QtVersionChecks>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+#include <QHttp1Configuration>
+#endif
 
 #include "../srs.h"
+#include "NetworkRecording.h"
+#include "TileSource.h"
 
 using namespace nucleus::tile_scheduler;
 
+namespace {
+// per thread, because a QNetworkAccessManager has to be used on its thread
+thread_local std::unordered_map<QString, std::weak_ptr<QNetworkAccessManager>> shared_network_managers;
+} // namespace
+
 TileLoadService::TileLoadService(const QString& base_url, UrlPattern url_pattern, const QString& file_ending, const LoadBalancingTargets& load_balancing_targets)
-    : m_network_manager(new QNetworkAccessManager(this))
-    , m_base_url(base_url)
+    : m_base_url(base_url)
     , m_url_pattern(url_pattern)
     , m_file_ending(file_ending)
     , m_load_balancing_targets(load_balancing_targets)
+    , m_target_statistics(load_balancing_targets.size())
 {
 }
 
-TileLoadService::~TileLoadService() = default;
+TileLoadService::TileLoadService(std::shared_ptr<TileSource> source)
+    : m_source(std::move(source))
+{
+    assert(m_source);
+}
+
+TileLoadService::~TileLoadService()
+{
+    // the network manager may be shared and outlive this service (see network_manager). outstanding replies are aborted like
+    // cancelled ones, their finished handlers only delete them.
+    auto in_flight = std::move(m_in_flight);
+    auto bundles = std::move(m_bundles);
+    m_in_flight.clear();
+    m_bundles.clear();
+    for (const auto& [id, replies] : in_flight) {
+        for (auto* reply : replies)
+            reply->abort();
+    }
+    for (const auto& [id, bundle] : bundles) {
+        if (bundle.reply)
+            bundle.reply->abort();
+    }
+}
 
 void TileLoadService::load(const tile::Id& tile_id)
 {
-    QNetworkRequest request(QUrl(build_tile_url(tile_id)));
-    request.setTransferTimeout(int(m_transfer_timeout));
-    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
-#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
-    request.setAttribute(QNetworkRequest::UseCredentialsAttribute, false);
-#endif
+    if (m_recording)
+        m_recording_request_times.try_emplace(tile_id, std::chrono::steady_clock::now());
+    if (m_source) {
+        // queued like a network reply, so that the limiters don't recurse when a delivery triggers the next request
+        m_in_flight[tile_id] = {};
+        const auto delivery = m_source->delivery(tile_id);
+        const auto deliver = [tile_id, delivery, this]() {
+            if (m_in_flight.erase(tile_id) == 0)
+                return; // cancelled
+            const auto timestamp = utils::time_since_epoch();
+            auto tile = delivery.status == tile_types::NetworkInfo::Status::Good ? m_source->read(tile_id) : nullptr;
+            if (tile)
+                emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::Good, timestamp }, std::move(tile) });
+            else if (delivery.status == tile_types::NetworkInfo::Status::NetworkError)
+                emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::NetworkError, timestamp }, std::make_shared<QByteArray>() });
+            else
+                emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::NotFound, timestamp }, std::make_shared<QByteArray>() });
+        };
+        if (delivery.delay_msecs > 0)
+            QTimer::singleShot(std::chrono::milliseconds(delivery.delay_msecs), Qt::PreciseTimer, this, deliver);
+        else
+            QMetaObject::invokeMethod(this, deliver, Qt::QueuedConnection);
+        return;
+    }
+
+    if (bundles_enabled() && tile_id.zoom_level > 0) {
+        load_bundled(tile_id);
+        return;
+    }
+
+    auto cached = m_cached_tile_lookup ? m_cached_tile_lookup(tile_id) : std::nullopt;
+    if (cached && (cached->validator.empty() || !cached->data))
+        cached.reset();
+    const auto target = m_load_balancing_targets.empty() ? std::nullopt : std::optional<unsigned>(select_target(tile_id));
+    send_request(tile_id, target, cached, 0);
+}
+
+void TileLoadService::send_request(const tile::Id& tile_id, std::optional<unsigned> target_index, const std::optional<tile_types::TileLayer>& cached, unsigned attempt)
+{
+    QNetworkRequest request(QUrl(target_index ? build_tile_url(tile_id, *target_index) : build_tile_url(tile_id)));
+    configure(&request, cached.has_value());
+    if (cached) {
+        if (!cached->validator.etag.isEmpty())
+            request.setRawHeader("If-None-Match", cached->validator.etag);
+        if (!cached->validator.last_modified.isEmpty())
+            request.setRawHeader("If-Modified-Since", cached->validator.last_modified);
+    }
+
+    QNetworkReply* reply = network_manager()->get(request);
+    m_in_flight[tile_id].push_back(reply);
+    const auto start_time = utils::time_since_epoch();
+    const auto can_use_second_target = m_hedging_enabled && target_index && attempt == 0 && m_load_balancing_targets.size() > 1;
+
+    if (can_use_second_target) {
+        if (const auto deadline = hedge_deadline(*target_index)) {
+            // the reply is the context, so the timer is dropped with it. it may outlive this service (see the destructor)
+            QTimer::singleShot(int(*deadline), reply, [tile_id, reply, target_index, cached, self = QPointer<TileLoadService>(this), this]() {
+                if (!self)
+                    return;
+                const auto in_flight = m_in_flight.find(tile_id);
+                if (in_flight == m_in_flight.end() || in_flight->second.size() != 1 || in_flight->second.front() != reply)
+                    return; // finished, cancelled or already hedged
+                send_request(tile_id, select_target(tile_id, *target_index), cached, 1);
+            });
+        }
+    }
+
+    connect(reply, &QNetworkReply::metaDataChanged, this, [tile_id, this]() { emit response_started(tile_id); });
+    connect(reply, &QNetworkReply::finished, this, [tile_id, reply, cached, target_index, start_time, can_use_second_target, this]() {
+        reply->deleteLater();
+        const auto in_flight = m_in_flight.find(tile_id);
+        if (in_flight == m_in_flight.end())
+            return; // aborted by cancel
+        auto& replies = in_flight->second;
+        const auto reply_it = std::find(replies.begin(), replies.end(), reply);
+        if (reply_it == replies.end())
+            return; // aborted, the other request of a hedged pair won
+        replies.erase(reply_it);
 
-    QNetworkReply* reply = m_network_manager->get(request);
-    connect(reply, &QNetworkReply::finished, [tile_id, reply, this]() {
         const auto error = reply->error();
         const auto timestamp = utils::time_since_epoch();
-        if (error == QNetworkReply::NoError) {
+        const auto not_modified = cached && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304;
+        const auto failed = !not_modified && error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError;
+        if (target_index)
+            record_target_response(*target_index, failed, timestamp - std::min(timestamp, start_time));
+
+        if (failed) {
+            if (!replies.empty())
+                return; // the hedged request is still running
+            m_in_flight.erase(in_flight);
+            if (can_use_second_target) { // failover
+                send_request(tile_id, select_target(tile_id, *target_index), cached, 1);
+                return;
+            }
+            //            qDebug() << reply->url() << ": " << error;
+            emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::NetworkError, timestamp }, std::make_shared<QByteArray>() });
+            return;
+        }
+
+        const auto others = std::move(replies);
+        m_in_flight.erase(in_flight);
+        for (auto* other : others)
+            other->abort();
+
+        const auto validator = tile_types::CacheValidator { reply->rawHeader("ETag"), reply->rawHeader("Last-Modified") };
+        if (not_modified) {
+            // only the timestamp is refreshed. the server may send updated validators.
+            emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::Good, timestamp }, cached->data, validator.empty() ? cached->validator : validator });
+        } else if (error == QNetworkReply::NoError) {
             auto tile = std::make_shared<QByteArray>(reply->readAll());
-            emit load_finished({tile_id, {tile_types::NetworkInfo::Status::Good, timestamp}, tile});
-        } else if (error == QNetworkReply::ContentNotFoundError) {
-            auto tile = std::make_shared<QByteArray>();
-            emit load_finished({tile_id, {tile_types::NetworkInfo::Status::NotFound, timestamp}, tile});
+            emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::Good, timestamp }, tile, validator });
         } else {
-            //            qDebug() << reply->url() << ": " << error;
             auto tile = std::make_shared<QByteArray>();
-            emit load_finished({tile_id, {tile_types::NetworkInfo::Status::NetworkError, timestamp}, tile});
+            emit load_finished({ tile_id, { tile_types::NetworkInfo::Status::NotFound, timestamp }, tile });
         }
+    });
+}
+
+void TileLoadService::configure(QNetworkRequest* request, bool conditional) const
+{
+    request->setTransferTimeout(int(m_transfer_timeout));
+    if (m_network_cache_policy == NetworkCachePolicy::SchedulerCacheOnly) {
+        request->setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        request->setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    } else {
+        request->setAttribute(QNetworkRequest::CacheLoadControlAttribute, conditional ? QNetworkRequest::AlwaysNetwork : QNetworkRequest::PreferCache);
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    request->setAttribute(QNetworkRequest::UseCredentialsAttribute, false);
+    QHttp1Configuration http1_configuration;
+    http1_configuration.setNumberOfConnectionsPerHost(qsizetype(std::max(1u, m_transport_options.max_connections_per_host)));
+    request->setHttp1Configuration(http1_configuration);
+#endif
+    // connections are kept alive by qt. with http/2, all requests to a host are multiplexed over one of them.
+    request->setAttribute(QNetworkRequest::Http2AllowedAttribute, m_transport_options.http2_allowed);
+    if (!m_transport_options.accept.isEmpty())
+        request->setRawHeader("Accept", m_transport_options.accept);
+}
+
+QNetworkAccessManager* TileLoadService::network_manager()
+{
+    if (m_network_manager)
+        return m_network_manager.get();
+    assert(QThread::currentThread() == thread());
+    const auto host = m_base_url.section('/', 0, 2); // scheme and authority
+    if (m_transport_options.share_network_manager) {
+        auto& shared = shared_network_managers[host];
+        m_network_manager = shared.lock();
+        if (!m_network_manager) {
+            m_network_manager = std::make_shared<QNetworkAccessManager>();
+            shared = m_network_manager;
+        }
+    } else {
+        m_network_manager = std::make_shared<QNetworkAccessManager>();
+    }
+    return m_network_manager.get();
+}
+
+void TileLoadService::load_bundled(const tile::Id& tile_id)
+{
+    const auto quad_id = tile_id.parent();
+    auto& bundle = m_bundles[quad_id];
+    if (std::find(bundle.tiles.begin(), bundle.tiles.end(), tile_id) != bundle.tiles.end())
+        return;
+    bundle.tiles.push_back(tile_id);
+    if (bundle.reply)
+        return; // joins the running request
+    // QuadAssembler requests all 4 children at once. partial quads are sent on the next event loop iteration.
+    if (bundle.tiles.size() == 4)
+        send_bundle_request(quad_id);
+    else if (bundle.tiles.size() == 1)
+        QMetaObject::invokeMethod(this, [quad_id, this]() { send_bundle_request(quad_id); }, Qt::QueuedConnection);
+}
+
+void TileLoadService::send_bundle_request(const tile::Id& quad_id)
+{
+    const auto it = m_bundles.find(quad_id);
+    if (it == m_bundles.end() || it->second.reply)
+        return; // cancelled or sent already
+    const auto target_index = m_load_balancing_targets.empty() ? std::nullopt : std::optional<unsigned>(select_target(quad_id));
+    auto url = m_bundle_base_url;
+    if (target_index)
+        url = url.arg(m_load_balancing_targets[*target_index]);
+    QNetworkRequest request(QUrl(url + tile_address(quad_id) + m_bundle_file_ending));
+    configure(&request, false);
+    QNetworkReply* reply = network_manager()->get(request);
+    it->second.reply = reply;
+    const auto start_time = utils::time_since_epoch();
+
+    connect(reply, &QNetworkReply::metaDataChanged, this, [quad_id, this]() {
+        const auto bundle = m_bundles.find(quad_id);
+        if (bundle == m_bundles.end())
+            return;
+        for (const auto& id : bundle->second.tiles)
+            emit response_started(id);
+    });
+    connect(reply, &QNetworkReply::finished, this, [quad_id, reply, target_index, start_time, this]() {
         reply->deleteLater();
+        const auto bundle = m_bundles.find(quad_id);
+        if (bundle == m_bundles.end() || bundle->second.reply != reply)
+            return; // aborted by cancel
+        const auto tiles = std::move(bundle->second.tiles);
+        m_bundles.erase(bundle);
+
+        const auto error = reply->error();
+        const auto timestamp = utils::time_since_epoch();
+        const auto failed = error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError;
+        if (target_index)
+            record_target_response(*target_index, failed, timestamp - std::min(timestamp, start_time));
+
+        std::optional<std::array<QByteArray, 4>> data;
+        auto status = tile_types::NetworkInfo::Status::NotFound;
+        if (failed) {
+            status = tile_types::NetworkInfo::Status::NetworkError;
+        } else if (error == QNetworkReply::NoError) {
+            auto unpacked = unpack_bundle(reply->readAll());
+            if (unpacked.has_value()) {
+                data = std::move(unpacked.value());
+            } else {
+                qDebug() << reply->url() << ": " << unpacked.error();
+                status = tile_types::NetworkInfo::Status::NetworkError;
+            }
+        }
+
+        const auto children = quad_id.children();
+        for (const auto& id : tiles) {
+            const auto index = size_t(std::find(children.begin(), children.end(), id) - children.begin());
+            assert(index < 4);
+            if (data && !(*data)[index].isEmpty())
+                emit load_finished({ id, { tile_types::NetworkInfo::Status::Good, timestamp }, std::make_shared<QByteArray>(std::move((*data)[index])) });
+            else
+                emit load_finished({ id, { data ? tile_types::NetworkInfo::Status::NotFound : status, timestamp }, std::make_shared<QByteArray>() });
+        }
     });
 }
 
-QString TileLoadService::build_tile_url(const tile::Id& tile_id) const
+QByteArray TileLoadService::pack_bundle(const std::array<QByteArray, 4>& tiles)
+{
+    QByteArray bundle;
+    for (const auto& tile : tiles) {
+        const auto size = uint32_t(tile.size());
+        const char size_bytes[4] = { char(size & 0xff), char((size >> 8) & 0xff), char((size >> 16) & 0xff), char((size >> 24) & 0xff) };
+        bundle.append(size_bytes, 4);
+        bundle.append(tile);
+    }
+    return bundle;
+}
+
+tl::expected<std::array<QByteArray, 4>, std::string> TileLoadService::unpack_bundle(const QByteArray& bundle)
+{
+    std::array<QByteArray, 4> tiles;
+    qsizetype offset = 0;
+    for (auto& tile : tiles) {
+        if (bundle.size() - offset < 4)
+            return tl::unexpected(std::string("TileLoadService::unpack_bundle: truncated header"));
+        const auto* header = reinterpret_cast<const uint8_t*>(bundle.constData() + offset);
+        const auto size = qsizetype(uint32_t(header[0]) | (uint32_t(header[1]) << 8) | (uint32_t(header[2]) << 16) | (uint32_t(header[3]) << 24));
+        offset += 4;
+        if (bundle.size() - offset < size)
+            return tl::unexpected(std::string("TileLoadService::unpack_bundle: truncated tile"));
+        tile = bundle.mid(offset, size);
+        offset += size;
+    }
+    if (offset != bundle.size())
+        return tl::unexpected(std::string("TileLoadService::unpack_bundle: trailing data"));
+    return tiles;
+}
+
+void TileLoadService::set_bundle_url(const QString& base_url, const QString& file_ending)
+{
+    m_bundle_base_url = base_url;
+    m_bundle_file_ending = file_ending;
+}
+
+void TileLoadService::set_recording(std::shared_ptr<NetworkRecording> recording)
+{
+    m_recording = std::move(recording);
+    m_recording_request_times.clear();
+    if (!m_recording || m_recording_connection)
+        return;
+    m_recording_connection = connect(this, &TileLoadService::load_finished, this, [this](const tile_types::TileLayer& tile) {
+        const auto request_time = m_recording_request_times.find(tile.id);
+        if (!m_recording || request_time == m_recording_request_times.end())
+            return;
+        const auto msecs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - request_time->second).count();
+        m_recording_request_times.erase(request_time);
+        m_recording->add(tile.id, { tile.network_info.status, unsigned(msecs), tile.data });
+    });
+}
+
+bool TileLoadService::bundles_enabled() const
+{
+    return !m_source && !m_bundle_base_url.isEmpty() && m_bundle_requests;
+}
+
+void TileLoadService::set_bundle_requests(bool enabled) { m_bundle_requests = enabled; }
+
+QString TileLoadService::build_bundle_url(const tile::Id& quad_id) const
+{
+    if (!m_load_balancing_targets.empty())
+        return m_bundle_base_url.arg(m_load_balancing_targets[select_target(quad_id)]) + tile_address(quad_id) + m_bundle_file_ending;
+    return m_bundle_base_url + tile_address(quad_id) + m_bundle_file_ending;
+}
+
+void TileLoadService::cancel(const std::vector<tile::Id>& tile_ids)
+{
+    for (const auto& id : tile_ids) {
+        m_recording_request_times.erase(id);
+        if (id.zoom_level > 0) {
+            const auto bundle = m_bundles.find(id.parent());
+            if (bundle != m_bundles.end()) {
+                auto& tiles = bundle->second.tiles;
+                tiles.erase(std::remove(tiles.begin(), tiles.end(), id), tiles.end());
+                if (tiles.empty()) {
+                    auto* reply = bundle->second.reply;
+                    m_bundles.erase(bundle);
+                    if (reply)
+                        reply->abort();
+                }
+                continue;
+            }
+        }
+        const auto it = m_in_flight.find(id);
+        if (it == m_in_flight.end())
+            continue;
+        const auto replies = std::move(it->second);
+        m_in_flight.erase(it);
+        for (auto* reply : replies)
+            reply->abort();
+    }
+}
+
+QString TileLoadService::tile_address(const tile::Id& tile_id) const
 {
-    QString tile_address;
     const auto n_y_tiles = srs::number_of_vertical_tiles_for_zoom_level(tile_id.zoom_level);
     switch (m_url_pattern) {
     case UrlPattern::ZXY:
-        tile_address = QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
-        break;
+        return QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
     case UrlPattern::ZYX:
-        tile_address = QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
-        break;
+        return QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
     case UrlPattern::ZXY_yPointingSouth:
-        tile_address = QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
-        break;
+        return QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
     case UrlPattern::ZYX_yPointingSouth:
-        tile_address = QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
-        break;
+        return QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
     }
-    if (!m_load_balancing_targets.empty()) {
-        const unsigned hash = qHash(tile_address) % 1024;
-        const auto index = unsigned((float(hash) / 1024.1f) * float(m_load_balancing_targets.size()));
-        assert(index < m_load_balancing_targets.size());
-        return m_base_url.arg(m_load_balancing_targets[index]) + tile_address + m_file_ending;
+    return {};
+}
+
+QString TileLoadService::build_tile_url(const tile::Id& tile_id) const
+{
+    if (!m_load_balancing_targets.empty())
+        return build_tile_url(tile_id, select_target(tile_id));
+    return m_base_url + tile_address(tile_id) + m_file_ending;
+}
+
+QString TileLoadService::build_tile_url(const tile::Id& tile_id, unsigned target_index) const
+{
+    assert(target_index < m_load_balancing_targets.size());
+    return m_base_url.arg(m_load_balancing_targets[target_index]) + tile_address(tile_id) + m_file_ending;
+}
+
+unsigned TileLoadService::select_target(const tile::Id& tile_id, std::optional<unsigned> excluded) const
+{
+    assert(!m_load_balancing_targets.empty());
+    // targets without measurements get the mean latency of the others
+    float latency_sum = 0;
+    unsigned n_latencies = 0;
+    for (const auto& stats : m_target_statistics) {
+        if (stats.latency_msecs > 0) {
+            latency_sum += stats.latency_msecs;
+            ++n_latencies;
+        }
     }
-    return m_base_url + tile_address + m_file_ending;
+    const auto reference_latency = n_latencies ? latency_sum / float(n_latencies) : 1.f;
+
+    const auto address = tile_address(tile_id);
+    unsigned best = excluded && *excluded == 0 && m_load_balancing_targets.size() > 1 ? 1 : 0;
+    double best_score = -1;
+    for (unsigned i = 0; i < m_load_balancing_targets.size(); ++i) {
+        if (excluded && *excluded == i && m_load_balancing_targets.size() > 1)
+            continue;
+        const auto& stats = m_target_statistics[i];
+        const auto latency = stats.latency_msecs > 0 ? stats.latency_msecs : reference_latency;
+        const auto health = std::max(0.01f, 1.f - stats.error_rate);
+        const auto weight = double(health * health / std::max(1.f, latency));
+        const auto hash = qHash(address, size_t(i) * 0x9E3779B9u + 1);
+        const auto u = (double(hash % 1'000'000u) + 0.5) / 1'000'000.0; // in (0, 1)
+        const auto score = -weight / std::log(u);
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+const std::vector<TileLoadService::TargetStatistics>& TileLoadService::target_statistics() const
+{
+    return m_target_statistics;
+}
+
+void TileLoadService::record_target_response(unsigned target_index, bool failed, uint64_t latency_msecs)
+{
+    assert(target_index < m_target_statistics.size());
+    auto& stats = m_target_statistics[target_index];
+    constexpr auto alpha = 0.125f;
+    stats.error_rate = stats.n_responses == 0 ? float(failed) : (1 - alpha) * stats.error_rate + alpha * float(failed);
+    ++stats.n_responses;
+    if (failed)
+        return;
+    const auto latency = std::max(1.f, float(latency_msecs));
+    if (stats.latency_msecs == 0) {
+        stats.latency_msecs = latency;
+        stats.latency_deviation_msecs = latency / 2;
+        return;
+    }
+    stats.latency_deviation_msecs = 0.75f * stats.latency_deviation_msecs + 0.25f * std::abs(latency - stats.latency_msecs);
+    stats.latency_msecs = (1 - alpha) * stats.latency_msecs + alpha * latency;
+}
+
+std::optional<unsigned> TileLoadService::hedge_deadline(unsigned target_index) const
+{
+    assert(target_index < m_target_statistics.size());
+    const auto& stats = m_target_statistics[target_index];
+    if (stats.n_responses < 8 || stats.latency_msecs == 0)
+        return {};
+    // same estimate as the tcp retransmission timeout
+    return unsigned(std::max(50.f, std::min(stats.latency_msecs + 4 * stats.latency_deviation_msecs, float(m_transfer_timeout))));
+}
+
+bool TileLoadService::hedging_enabled() const
+{
+    return m_hedging_enabled;
+}
+
+void TileLoadService::set_hedging_enabled(bool new_hedging_enabled)
+{
+    m_hedging_enabled = new_hedging_enabled;
 }
 
 unsigned int TileLoadService::transfer_timeout() const
@@ -104,3 +529,29 @@ void TileLoadService::set_transfer_timeout(unsigned int new_transfer_timeout)
     assert(new_transfer_timeout < unsigned(std::numeric_limits<int>::max()));
     m_transfer_timeout = new_transfer_timeout;
 }
+
+void TileLoadService::set_cached_tile_lookup(CachedTileLookup lookup)
+{
+    m_cached_tile_lookup = std::move(lookup);
+}
+
+TileLoadService::NetworkCachePolicy TileLoadService::network_cache_policy() const
+{
+    return m_network_cache_policy;
+}
+
+void TileLoadService::set_network_cache_policy(NetworkCachePolicy new_network_cache_policy)
+{
+    m_network_cache_policy = new_network_cache_policy;
+}
+
+const TileLoadService::TransportOptions& TileLoadService::transport_options() const
+{
+    return m_transport_options;
+}
+
+void TileLoadService::set_transport_options(const TransportOptions& new_transport_options)
+{
+    assert(!m_network_manager); // only used for new connections
+    m_transport_options = new_transport_options;
+}
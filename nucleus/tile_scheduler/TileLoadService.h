@@ -18,16 +18,27 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
 
 #include <QObject>
+#include <tl/expected.hpp>
 
 #include "constants.h"
 #include "tile_types.h"
 
 class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
 
 namespace nucleus::tile_scheduler {
+class NetworkRecording;
+class TileSource;
 
 class TileLoadService : public QObject {
     Q_OBJECT
@@ -38,27 +49,126 @@ public:
         ZXY_yPointingSouth,
         ZYX_yPointingSouth // y=0 is the northern most tile
     };
+    enum class NetworkCachePolicy {
+        SchedulerCacheOnly, // tiles are stored once, in the ram / disk cache of Scheduler. qt's http cache is neither read nor written.
+        PreferNetworkCache // uses the QAbstractNetworkCache of the network manager, if there is one (qt's default behaviour)
+    };
     using LoadBalancingTargets = std::vector<QString>;
+    struct TargetStatistics {
+        float latency_msecs = 0; // smoothed, 0 until the first successful response
+        float latency_deviation_msecs = 0;
+        float error_rate = 0; // smoothed, 0..1
+        unsigned n_responses = 0;
+    };
+    struct TransportOptions {
+        bool http2_allowed = true;
+        // one QNetworkAccessManager per host and thread, so that services on the same host (e.g. ortho and height) share connections
+        bool share_network_manager = true;
+        unsigned max_connections_per_host = 6; // http/1 only (http/2 multiplexes over one connection). requires Qt >= 6.5
+        // Accept header of the requests, for servers that negotiate the image format (e.g. webp instead of jpeg at the same url, the
+        // file ending of the url doesn't matter then). see tile_conversion::accepted_ortho_media_types. empty: no Accept header.
+        QByteArray accept = {};
+    };
+    /// returns the cached version of a tile, if there is one (e.g. Scheduler::cached_ortho_tile). called on the thread of the service.
+    using CachedTileLookup = std::function<std::optional<tile_types::TileLayer>(const tile::Id&)>;
 
     TileLoadService(const QString& base_url, UrlPattern url_pattern, const QString& file_ending, const LoadBalancingTargets& load_balancing_targets = {});
+    /// serves the tiles from a local source (e.g. a PackTileSource) instead of the network. tiles that are not in the source are reported as NotFound.
+    explicit TileLoadService(std::shared_ptr<TileSource> source);
     ~TileLoadService() override;
+    /// url on the currently preferred load balancing target (see select_target)
     [[nodiscard]] QString build_tile_url(const tile::Id& tile_id) const;
+    [[nodiscard]] QString build_tile_url(const tile::Id& tile_id, unsigned target_index) const;
+
+    /// weighted rendezvous hashing: a tile stays on the same target (good for http caches) while the weights don't change, and
+    /// the weights favour targets with low latency and few errors. excluded is skipped, e.g. for failover.
+    [[nodiscard]] unsigned select_target(const tile::Id& tile_id, std::optional<unsigned> excluded = {}) const;
+    [[nodiscard]] const std::vector<TargetStatistics>& target_statistics() const;
+    /// called for every response of a load balancing target. public for testing.
+    void record_target_response(unsigned target_index, bool failed, uint64_t latency_msecs);
+    /// deadline after which a pending request is hedged (sent to a second target), ~ a high percentile of the target's latency.
+    /// nullopt until enough responses were observed.
+    [[nodiscard]] std::optional<unsigned> hedge_deadline(unsigned target_index) const;
+
+    // hedged requests and failover to a second target, if there are several load balancing targets. enabled by default.
+    [[nodiscard]] bool hedging_enabled() const;
+    void set_hedging_enabled(bool new_hedging_enabled);
 
     [[nodiscard]] unsigned int transfer_timeout() const;
     void set_transfer_timeout(unsigned int new_transfer_timeout);
 
+    /// enables conditional requests: if the cached tile has validators (ETag / Last-Modified), they are sent along, and a
+    /// 304 Not Modified response delivers the cached data with a fresh timestamp.
+    void set_cached_tile_lookup(CachedTileLookup lookup);
+
+    [[nodiscard]] NetworkCachePolicy network_cache_policy() const;
+    void set_network_cache_policy(NetworkCachePolicy new_network_cache_policy);
+
+    /// has to be set before the first load. the network manager is created on the first load, on the thread of the service.
+    [[nodiscard]] const TransportOptions& transport_options() const;
+    void set_transport_options(const TransportOptions& new_transport_options);
+
+    /// enables quad bundles: the 4 children of a quad are fetched with a single request to base_url + address of the quad + file_ending
+    /// (base_url takes the load balancing target like the tile url). the response is a bundle (see pack_bundle), it is unpacked into
+    /// the usual TileLayers. bundled requests are not conditional and not hedged. an empty base_url disables bundles.
+    void set_bundle_url(const QString& base_url, const QString& file_ending);
+    [[nodiscard]] bool bundles_enabled() const;
+    [[nodiscard]] QString build_bundle_url(const tile::Id& quad_id) const;
+
+    /// record mode: every delivered tile (status, data and the time from the request to the delivery) is added to the recording,
+    /// which can be written to disk and served by a NetworkReplay later. nullptr stops recording.
+    void set_recording(std::shared_ptr<NetworkRecording> recording);
+
+    /// bundle format: for each child in the order of tile::Id::children() a 32 bit little endian size followed by the data.
+    /// size 0 means the tile is not available.
+    [[nodiscard]] static QByteArray pack_bundle(const std::array<QByteArray, 4>& tiles);
+    [[nodiscard]] static tl::expected<std::array<QByteArray, 4>, std::string> unpack_bundle(const QByteArray& bundle);
+
 public slots:
     void load(const tile::Id& tile_id);
+    // aborts the requests. nothing is delivered for cancelled tiles.
+    void cancel(const std::vector<tile::Id>& tile_ids);
+    /// with a bundle url, the bundles are used only while this is set (default), e.g. only on metered connections (see
+    /// Scheduler::NetworkPolicy). requests that are running are not affected.
+    void set_bundle_requests(bool enabled);
 
 signals:
     void load_finished(tile_types::TileLayer tile);
+    // the response headers arrived (time to first byte), emitted per reply. not emitted for tiles of the local source.
+    void response_started(const tile::Id& tile_id);
 
 private:
+    void send_request(const tile::Id& tile_id, std::optional<unsigned> target_index, const std::optional<tile_types::TileLayer>& cached, unsigned attempt);
+    [[nodiscard]] QString tile_address(const tile::Id& tile_id) const;
+    void configure(QNetworkRequest* request, bool conditional) const;
+    QNetworkAccessManager* network_manager();
+    void load_bundled(const tile::Id& tile_id);
+    void send_bundle_request(const tile::Id& quad_id);
+
+    struct Bundle {
+        QNetworkReply* reply = nullptr; // nullptr until the request is sent
+        std::vector<tile::Id> tiles; // requested children
+    };
+
     unsigned m_transfer_timeout = tile_scheduler::constants::default_network_timeout;
     std::shared_ptr<QNetworkAccessManager> m_network_manager;
     QString m_base_url;
-    UrlPattern m_url_pattern;
+    UrlPattern m_url_pattern = UrlPattern::ZXY;
     QString m_file_ending;
     LoadBalancingTargets m_load_balancing_targets;
+    std::shared_ptr<TileSource> m_source;
+    CachedTileLookup m_cached_tile_lookup;
+    std::unordered_map<tile::Id, std::vector<QNetworkReply*>, tile::Id::Hasher> m_in_flight; // empty for reads from the local source
+    std::vector<TargetStatistics> m_target_statistics;
+    bool m_hedging_enabled = true;
+    QString m_bundle_base_url;
+    QString m_bundle_file_ending;
+    bool m_bundle_requests = true;
+    std::unordered_map<tile::Id, Bundle, tile::Id::Hasher> m_bundles; // key is the quad
+    NetworkCachePolicy m_network_cache_policy = NetworkCachePolicy::SchedulerCacheOnly;
+    TransportOptions m_transport_options;
+    std::shared_ptr<NetworkRecording> m_recording;
+    std::unordered_map<tile::Id, std::chrono::steady_clock::time_point, tile::Id::Hasher> m_recording_request_times;
+    QMetaObject::Connection m_recording_connection;
 };
 }
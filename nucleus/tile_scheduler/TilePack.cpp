@@ -0,0 +1,445 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "TilePack.h"
+
+#include <cassert>
+#include <vector>
+
+#include <fmt/format.h>
+#include <zpp_bits.h>
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+constexpr uint64_t header_size = 32; // version, padded
+constexpr uint64_t min_garbage_for_compaction = 4 * 1024 * 1024;
+
+tl::expected<void, std::string> write_file(const std::filesystem::path& path, std::span<const char> bytes)
+{
+    QFile file(path);
+    if (!file.open(QIODeviceBase::WriteOnly | QIODeviceBase::Truncate))
+        return tl::unexpected(fmt::format("Couldn't open file '{}' for writing!", path.string()));
+    if (file.write(bytes.data(), qint64(bytes.size())) != qint64(bytes.size()))
+        return tl::unexpected(fmt::format("Couldn't write to '{}'!", path.string()));
+    return {};
+}
+
+// writes to a temporary file first, so that a crash doesn't leave a half written file behind
+tl::expected<void, std::string> replace_file(const std::filesystem::path& path, std::span<const char> bytes)
+{
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    const auto r = write_file(tmp_path, bytes);
+    if (!r.has_value())
+        return r;
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec)
+        return tl::unexpected(fmt::format("Couldn't move '{}' to '{}': {}", tmp_path.string(), path.string(), ec.message()));
+    return {};
+}
+} // namespace
+
+TilePack::TilePack(std::filesystem::path base_path, const Version& version)
+    : m_base_path(std::move(base_path))
+    , m_version(version)
+{
+}
+
+TilePack::~TilePack() { unmap(); }
+
+std::filesystem::path TilePack::pack_path(const std::filesystem::path& base_path) { return base_path / "tiles.alp_pack"; }
+
+std::filesystem::path TilePack::index_path(const std::filesystem::path& base_path) { return base_path / "tiles.alp_index"; }
+
+std::filesystem::path TilePack::journal_path(const std::filesystem::path& base_path) { return base_path / "tiles.alp_journal"; }
+
+uint64_t TilePack::journal_size() const { return m_journal_size; }
+
+bool TilePack::is_open() const { return m_file.isOpen(); }
+
+bool TilePack::is_read_only() const { return m_read_only; }
+
+const std::filesystem::path& TilePack::base_path() const { return m_base_path; }
+
+const TilePack::Index& TilePack::index() const { return m_index; }
+
+uint64_t TilePack::pack_size() const { return m_pack_size; }
+
+uint64_t TilePack::live_bytes() const { return m_live_bytes; }
+
+tl::expected<void, std::string> TilePack::open(bool create_if_missing)
+{
+    unmap();
+    m_file.close();
+    m_journal.close();
+    m_index.clear();
+    m_live_bytes = 0;
+    m_pack_size = 0;
+    m_generation = 0;
+    m_journal_size = 0;
+    m_uncommitted.clear();
+    m_read_only = false;
+
+    const auto pack = pack_path(m_base_path);
+    const auto index = index_path(m_base_path);
+    if (!std::filesystem::exists(pack) || !std::filesystem::exists(index)) {
+        if (!create_if_missing)
+            return tl::unexpected(fmt::format("No tile pack in '{}'!", m_base_path.string()));
+        std::filesystem::create_directories(m_base_path);
+        std::vector<char> header(header_size, 0);
+        std::copy(m_version.begin(), m_version.end(), header.begin());
+        const auto r = write_file(pack, header);
+        if (!r.has_value())
+            return r;
+        m_pack_size = header_size;
+        const auto r_index = write_index();
+        if (!r_index.has_value())
+            return r_index;
+        const auto r_journal = reset_journal();
+        if (!r_journal.has_value())
+            return r_journal;
+    } else {
+        const auto r = read_index(index);
+        if (!r.has_value())
+            return r;
+        replay_journal();
+    }
+
+    m_file.setFileName(pack);
+    if (!m_file.open(QIODeviceBase::ReadWrite))
+        return tl::unexpected(fmt::format("Couldn't open file '{}'!", pack.string()));
+    if (uint64_t(m_file.size()) < m_pack_size) {
+        m_file.close();
+        m_index.clear();
+        return tl::unexpected(fmt::format("Tile pack '{}' is shorter than its index!", pack.string()));
+    }
+    if (uint64_t(m_file.size()) > m_pack_size)
+        m_file.resize(qint64(m_pack_size)); // appended, but the index wasn't written (e.g. crash)
+
+    for (const auto& [id, entry] : m_index) {
+        if (entry.offset + entry.length > m_pack_size) {
+            m_file.close();
+            m_index.clear();
+            return tl::unexpected(fmt::format("Tile pack index '{}' is corrupted!", index.string()));
+        }
+        m_live_bytes += entry.length;
+    }
+    if (!m_journal.isOpen()) {
+        if (!std::filesystem::exists(journal_path(m_base_path))) {
+            const auto r = reset_journal();
+            if (!r.has_value())
+                return r;
+        } else {
+            m_journal.setFileName(journal_path(m_base_path));
+            if (!m_journal.open(QIODeviceBase::WriteOnly | QIODeviceBase::Append))
+                return tl::unexpected(fmt::format("Couldn't open file '{}'!", journal_path(m_base_path).string()));
+        }
+    }
+    return map();
+}
+
+tl::expected<void, std::string> TilePack::open_read_only()
+{
+    unmap();
+    m_file.close();
+    m_journal.close();
+    m_index.clear();
+    m_live_bytes = 0;
+    m_pack_size = 0;
+    m_generation = 0;
+    m_journal_size = 0;
+    m_uncommitted.clear();
+    m_read_only = true;
+
+    // no std::filesystem here, it doesn't know the resource paths
+    const auto pack = pack_path(m_base_path);
+    const auto index = index_path(m_base_path);
+    const auto r = read_index(index);
+    if (!r.has_value())
+        return r;
+    m_file.setFileName(pack);
+    if (!m_file.open(QIODeviceBase::ReadOnly))
+        return tl::unexpected(fmt::format("Couldn't open file '{}'!", pack.string()));
+    if (uint64_t(m_file.size()) < m_pack_size) {
+        m_file.close();
+        m_index.clear();
+        return tl::unexpected(fmt::format("Tile pack '{}' is shorter than its index!", pack.string()));
+    }
+    for (const auto& [id, entry] : m_index) {
+        if (entry.offset + entry.length > m_pack_size) {
+            m_file.close();
+            m_index.clear();
+            return tl::unexpected(fmt::format("Tile pack index '{}' is corrupted!", index.string()));
+        }
+        m_live_bytes += entry.length;
+    }
+    return map();
+}
+
+tl::expected<void, std::string> TilePack::read_index(const std::filesystem::path& path)
+{
+    QFile file(path);
+    if (!file.open(QIODeviceBase::ReadOnly))
+        return tl::unexpected(fmt::format("Couldn't open file '{}' for reading!", path.string()));
+    const auto bytes = file.readAll();
+    zpp::bits::in in(bytes);
+    Version version = {};
+    if (failure(in(version)))
+        return tl::unexpected(fmt::format("Couldn't read the version of '{}'!", path.string()));
+    if (version != m_version) {
+        version[version.size() - 1] = 0; // make sure that the string is 0 terminated.
+        return tl::unexpected(fmt::format("Tile pack '{}' has incompatible version! Disk version is '{}', but we expected '{}'.",
+            path.string(),
+            version.data(),
+            m_version.data()));
+    }
+    const auto r = in(m_pack_size, m_generation, m_index);
+    if (failure(r)) {
+        m_index.clear();
+        return tl::unexpected(std::make_error_code(r).message());
+    }
+    return {};
+}
+
+std::optional<std::span<const char>> TilePack::bytes(const tile::Id& id)
+{
+    const auto it = m_index.find(id);
+    if (it == m_index.end())
+        return {};
+    const auto& entry = it->second;
+    if (entry.offset + entry.length > m_mapped_size) {
+        unmap();
+        if (!map().has_value())
+            return {};
+    }
+    return std::span<const char>(m_mapping + entry.offset, entry.length);
+}
+
+tl::expected<void, std::string> TilePack::append(const tile::Id& id, std::span<const char> bytes, uint64_t created, uint64_t visited)
+{
+    assert(is_open() && !m_read_only);
+    if (!m_file.seek(qint64(m_pack_size)) || m_file.write(bytes.data(), qint64(bytes.size())) != qint64(bytes.size()))
+        return tl::unexpected(fmt::format("Couldn't append to '{}'!", m_file.fileName().toStdString()));
+    const auto old = m_index.find(id);
+    if (old != m_index.end())
+        m_live_bytes -= old->second.length; // replaced, the put record supersedes it in the journal
+    const auto entry = Entry { m_pack_size, bytes.size(), created, visited };
+    m_index[id] = entry;
+    m_pack_size += bytes.size();
+    m_live_bytes += bytes.size();
+    m_uncommitted.push_back({ JournalRecord::Op::Put, id, entry, m_pack_size });
+    return {};
+}
+
+void TilePack::remove(const tile::Id& id)
+{
+    const auto it = m_index.find(id);
+    if (it == m_index.end())
+        return;
+    m_live_bytes -= it->second.length;
+    m_index.erase(it);
+    m_uncommitted.push_back({ JournalRecord::Op::Remove, id, {}, m_pack_size });
+}
+
+void TilePack::set_visited(const tile::Id& id, uint64_t visited)
+{
+    const auto it = m_index.find(id);
+    if (it == m_index.end() || it->second.visited == visited)
+        return;
+    it->second.visited = visited;
+    m_uncommitted.push_back({ JournalRecord::Op::Visit, id, it->second, m_pack_size });
+}
+
+tl::expected<void, std::string> TilePack::commit()
+{
+    assert(is_open() && !m_read_only);
+    const auto garbage = m_pack_size - header_size - m_live_bytes;
+    if (garbage > m_live_bytes && garbage > min_garbage_for_compaction) {
+        const auto r = compact();
+        if (!r.has_value())
+            return r;
+    }
+    m_file.flush(); // data must be on disk before the index references it
+    ++m_generation;
+    const auto r = write_index();
+    if (!r.has_value())
+        return r;
+    return reset_journal();
+}
+
+tl::expected<void, std::string> TilePack::commit_journal()
+{
+    assert(is_open() && !m_read_only);
+    if (m_uncommitted.empty())
+        return {};
+    std::vector<char> bytes;
+    zpp::bits::out out(bytes);
+    for (const auto& record : m_uncommitted) {
+        const auto r = out(record);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+    }
+    m_file.flush(); // data must be on disk before the journal references it
+    if (m_journal.write(bytes.data(), qint64(bytes.size())) != qint64(bytes.size()))
+        return tl::unexpected(fmt::format("Couldn't append to '{}'!", m_journal.fileName().toStdString()));
+    m_journal.flush();
+    m_journal_size += m_uncommitted.size();
+    m_uncommitted.clear();
+    return {};
+}
+
+void TilePack::replay_journal()
+{
+    QFile file(journal_path(m_base_path));
+    if (!file.open(QIODeviceBase::ReadWrite))
+        return;
+    const auto bytes = file.readAll();
+    zpp::bits::in in(bytes);
+    uint64_t generation = 0;
+    if (failure(in(generation)) || generation != m_generation) {
+        file.close();
+        std::filesystem::remove(journal_path(m_base_path)); // stale, e.g. crash between writing the index and resetting the journal
+        return;
+    }
+    auto valid_size = in.position();
+    while (in.position() < size_t(bytes.size())) {
+        JournalRecord record;
+        if (failure(in(record)))
+            break; // torn write at the end
+        switch (record.op) {
+        case JournalRecord::Op::Put:
+            m_index[record.id] = record.entry;
+            break;
+        case JournalRecord::Op::Remove:
+            m_index.erase(record.id);
+            break;
+        case JournalRecord::Op::Visit: {
+            const auto it = m_index.find(record.id);
+            if (it != m_index.end())
+                it->second.visited = record.entry.visited;
+            break;
+        }
+        }
+        m_pack_size = record.pack_size;
+        valid_size = in.position();
+        ++m_journal_size;
+    }
+    if (valid_size < size_t(bytes.size()))
+        file.resize(qint64(valid_size));
+}
+
+tl::expected<void, std::string> TilePack::reset_journal()
+{
+    m_journal.close();
+    std::vector<char> bytes;
+    zpp::bits::out out(bytes);
+    const auto r = out(m_generation);
+    if (failure(r))
+        return tl::unexpected(std::make_error_code(r).message());
+    const auto r_write = replace_file(journal_path(m_base_path), bytes);
+    if (!r_write.has_value())
+        return r_write;
+    m_journal_size = 0;
+    m_uncommitted.clear();
+    m_journal.setFileName(journal_path(m_base_path));
+    if (!m_journal.open(QIODeviceBase::WriteOnly | QIODeviceBase::Append))
+        return tl::unexpected(fmt::format("Couldn't open file '{}'!", journal_path(m_base_path).string()));
+    return {};
+}
+
+tl::expected<void, std::string> TilePack::map()
+{
+    m_mapping = nullptr;
+    m_mapped_size = 0;
+    if (!m_file.isOpen())
+        return tl::unexpected(std::string("Tile pack is not open!"));
+    if (!m_read_only)
+        m_file.flush();
+    auto* mapping = m_file.map(0, qint64(m_pack_size));
+    if (mapping) {
+        m_mapping = reinterpret_cast<const char*>(mapping);
+    } else {
+        m_file.seek(0);
+        m_unmappable_fallback = m_file.read(qint64(m_pack_size));
+        if (uint64_t(m_unmappable_fallback.size()) != m_pack_size)
+            return tl::unexpected(fmt::format("Couldn't read '{}'!", m_file.fileName().toStdString()));
+        m_mapping = m_unmappable_fallback.constData();
+    }
+    m_mapped_size = m_pack_size;
+    return {};
+}
+
+void TilePack::unmap()
+{
+    if (m_mapping && m_unmappable_fallback.isEmpty())
+        m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_mapping)));
+    m_unmappable_fallback.clear();
+    m_mapping = nullptr;
+    m_mapped_size = 0;
+}
+
+tl::expected<void, std::string> TilePack::compact()
+{
+    auto tmp_path = pack_path(m_base_path);
+    tmp_path += ".tmp";
+    QFile out(tmp_path);
+    if (!out.open(QIODeviceBase::WriteOnly | QIODeviceBase::Truncate))
+        return tl::unexpected(fmt::format("Couldn't open file '{}' for writing!", tmp_path.string()));
+    std::vector<char> header(header_size, 0);
+    std::copy(m_version.begin(), m_version.end(), header.begin());
+    out.write(header.data(), qint64(header.size()));
+
+    Index compacted;
+    compacted.reserve(m_index.size());
+    uint64_t offset = header_size;
+    for (const auto& [id, entry] : m_index) {
+        const auto data = bytes(id);
+        if (!data)
+            return tl::unexpected(std::string("Couldn't read a tile while compacting the tile pack!"));
+        if (out.write(data->data(), qint64(data->size())) != qint64(data->size()))
+            return tl::unexpected(fmt::format("Couldn't write to '{}'!", tmp_path.string()));
+        compacted[id] = Entry { offset, entry.length, entry.created, entry.visited };
+        offset += entry.length;
+    }
+    out.close();
+
+    // the old file must be unmapped and closed before it can be replaced (windows)
+    unmap();
+    m_file.close();
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, pack_path(m_base_path), ec);
+    if (ec)
+        return tl::unexpected(fmt::format("Couldn't replace the tile pack: {}", ec.message()));
+    m_index = std::move(compacted);
+    m_pack_size = offset;
+    if (!m_file.open(QIODeviceBase::ReadWrite))
+        return tl::unexpected(fmt::format("Couldn't open file '{}'!", m_file.fileName().toStdString()));
+    return map();
+}
+
+tl::expected<void, std::string> TilePack::write_index()
+{
+    std::vector<char> bytes;
+    zpp::bits::out out(bytes);
+    const auto r = out(m_version, m_pack_size, m_generation, m_index);
+    if (failure(r))
+        return tl::unexpected(std::make_error_code(r).message());
+    return replace_file(index_path(m_base_path), bytes);
+}
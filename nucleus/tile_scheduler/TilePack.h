@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <glm/glm.hpp>
+#include <tl/expected.hpp>
+
+#include "radix/tile.h"
+
+namespace glm {
+
+template<typename T>
+constexpr auto serialize(auto & archive, const glm::vec<2, T> & vec)
+{
+    return archive(vec.x, vec.y);
+}
+
+template<typename T>
+constexpr auto serialize(auto & archive, glm::vec<2, T> & vec)
+{
+    return archive(vec.x, vec.y);
+}
+
+}
+
+namespace nucleus::tile_scheduler {
+
+/// Single file disk storage for serialised tiles: an append-only pack file plus an index (tile::Id -> offset / length).
+/// The pack is memory mapped, so only the index is read eagerly and tile bytes are paged in by the os on access.
+/// Replaced or removed tiles leave garbage in the pack, which is compacted when it exceeds the live data.
+/// Changes can either be committed as a whole (rewriting the index), or appended to a journal, which is replayed on open.
+/// A pack can also be opened read only, e.g., one that is compiled into the Qt resources. Not thread safe.
+class TilePack {
+public:
+    using Version = std::array<char, 25>;
+    struct Entry {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        uint64_t created = 0;
+        uint64_t visited = 0;
+    };
+    using Index = std::unordered_map<tile::Id, Entry, tile::Id::Hasher>;
+    struct JournalRecord {
+        enum class Op : uint8_t { Put, Remove, Visit };
+        Op op = Op::Put;
+        tile::Id id;
+        Entry entry;
+        uint64_t pack_size = 0;
+    };
+
+    TilePack(std::filesystem::path base_path, const Version& version);
+    ~TilePack();
+    TilePack(const TilePack&) = delete;
+    TilePack& operator=(const TilePack&) = delete;
+
+    /// reads the index and maps the pack. creates empty files if create_if_missing is true and there are none.
+    [[nodiscard]] tl::expected<void, std::string> open(bool create_if_missing);
+    /// reads the index and maps the pack without writing anything, base_path may be a resource path (":/..."). the journal is
+    /// ignored, so the pack must be committed. append, remove, set_visited and the commits must not be called.
+    [[nodiscard]] tl::expected<void, std::string> open_read_only();
+    [[nodiscard]] bool is_open() const;
+    [[nodiscard]] bool is_read_only() const;
+    [[nodiscard]] const std::filesystem::path& base_path() const;
+
+    [[nodiscard]] const Index& index() const;
+    /// view into the mapping. valid until the next call to a non-const method.
+    [[nodiscard]] std::optional<std::span<const char>> bytes(const tile::Id& id);
+
+    [[nodiscard]] tl::expected<void, std::string> append(const tile::Id& id, std::span<const char> bytes, uint64_t created, uint64_t visited);
+    void remove(const tile::Id& id);
+    void set_visited(const tile::Id& id, uint64_t visited);
+    /// checkpoint: compacts the pack if necessary, writes the index and clears the journal. call after a batch of appends / removes.
+    [[nodiscard]] tl::expected<void, std::string> commit();
+    /// appends the changes since the last commit to the journal, much cheaper than commit for a small batch.
+    [[nodiscard]] tl::expected<void, std::string> commit_journal();
+    /// number of records in the journal file, i.e., since the last checkpoint
+    [[nodiscard]] uint64_t journal_size() const;
+
+    [[nodiscard]] uint64_t pack_size() const;
+    [[nodiscard]] uint64_t live_bytes() const;
+
+    static std::filesystem::path pack_path(const std::filesystem::path& base_path);
+    static std::filesystem::path index_path(const std::filesystem::path& base_path);
+    static std::filesystem::path journal_path(const std::filesystem::path& base_path);
+
+private:
+    [[nodiscard]] tl::expected<void, std::string> map();
+    void unmap();
+    [[nodiscard]] tl::expected<void, std::string> compact();
+    [[nodiscard]] tl::expected<void, std::string> write_index();
+    void replay_journal();
+    [[nodiscard]] tl::expected<void, std::string> reset_journal();
+    [[nodiscard]] tl::expected<void, std::string> read_index(const std::filesystem::path& path);
+
+    std::filesystem::path m_base_path;
+    Version m_version;
+    Index m_index;
+    QFile m_file;
+    const char* m_mapping = nullptr;
+    uint64_t m_mapped_size = 0;
+    QByteArray m_unmappable_fallback; // platforms without mmap support (e.g. webassembly)
+    uint64_t m_pack_size = 0;
+    uint64_t m_live_bytes = 0;
+    uint64_t m_generation = 0; // incremented by every checkpoint, journals of other generations are stale
+    bool m_read_only = false;
+    QFile m_journal;
+    uint64_t m_journal_size = 0;
+    std::vector<JournalRecord> m_uncommitted;
+};
+
+} // namespace nucleus::tile_scheduler
@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+
+#include "radix/tile.h"
+#include "tile_types.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Local source of tile data (e.g. an archive on a local disk), which TileLoadService can use instead of the network.
+/// Reads are synchronous and happen on the thread of the TileLoadService.
+class TileSource {
+public:
+    virtual ~TileSource() = default;
+    /// the encoded tile (png, jpeg, ..), or nullptr if the source doesn't contain it. the bytes may be a view into memory
+    /// of the source, which stays valid as long as the returned pointer (or a copy of it) is alive.
+    [[nodiscard]] virtual std::shared_ptr<QByteArray> read(const tile::Id& id) = 0;
+
+    struct Delivery {
+        unsigned delay_msecs = 0;
+        tile_types::NetworkInfo::Status status = tile_types::NetworkInfo::Status::Good; // NotFound if read returns nullptr
+    };
+    /// when and how the tile is delivered, called when the tile is requested. the tile is read once the delay passed.
+    /// sources that simulate a network (see NetworkReplay) override it, local sources deliver right away.
+    [[nodiscard]] virtual Delivery delivery(const tile::Id&) { return {}; }
+};
+
+} // namespace nucleus::tile_scheduler
@@ -18,43 +18,349 @@
 
 #pragma once
 
+#include "nucleus/Raster.h"
 #include "nucleus/srs.h"
 #include "nucleus/tile_scheduler/Cache.h"
-#include "radix/height_encoding.h"
+#include "nucleus/tile_scheduler/utils.h"
+#include "nucleus/utils/tile_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <QImage>
 
 namespace nucleus::tile_scheduler::cache_queries {
 
-inline float query_altitude(MemoryCache* cache, const glm::dvec2& lat_long)
+using HeightRasterPtr = std::shared_ptr<const Raster<uint16_t>>;
+/// decodes a height tile (png or compact, see tile_conversion::decode_height). can be replaced to cache the decoded rasters (see DataQuerier)
+using HeightDecoder = std::function<HeightRasterPtr(const tile::Id&, const QByteArray&)>;
+
+inline HeightRasterPtr decode_height(const tile::Id&, const QByteArray& data)
 {
-    const auto world_space = srs::lat_long_to_world(lat_long);
-    nucleus::tile_scheduler::tile_types::TileQuad selected_quad;
-    cache->visit([&](const nucleus::tile_scheduler::tile_types::TileQuad& tile) {
-        if (srs::tile_bounds(tile.id).contains(world_space)) {
-            selected_quad = tile;
-            return true;
-        }
-        return false;
+    return std::make_shared<const Raster<uint16_t>>(nucleus::utils::tile_conversion::decode_height(data));
+}
+
+struct HeightTile {
+    tile::Id id;
+    std::shared_ptr<QByteArray> height;
+};
+
+/// finds the finest height tile in the cache for each world space position, using a single visit.
+/// nullopt for positions which are not covered by the cache.
+inline std::vector<std::optional<HeightTile>> find_height_tiles(MemoryCache* cache, std::span<const glm::dvec2> world_positions)
+{
+    // quads outside of the bounding box are rejected without testing every position (e.g., long elevation profiles)
+    auto positions_min = glm::dvec2(std::numeric_limits<double>::max());
+    auto positions_max = glm::dvec2(std::numeric_limits<double>::lowest());
+    for (const auto& p : world_positions) {
+        positions_min = glm::min(positions_min, p);
+        positions_max = glm::max(positions_max, p);
+    }
+    std::unordered_map<tile::Id, tile_types::TileQuad, tile::Id::Hasher> quads;
+    cache->visit_readonly([&](const tile_types::TileQuad& quad) {
+        const auto bounds = srs::tile_bounds(quad.id);
+        if (glm::any(glm::greaterThan(bounds.min, positions_max)) || glm::any(glm::lessThan(bounds.max, positions_min)))
+            return false;
+        if (std::none_of(world_positions.begin(), world_positions.end(), [&](const auto& p) { return bounds.contains(p); }))
+            return false;
+        quads[quad.id] = quad;
+        return true;
     });
 
-    for (const auto& layered_tile : selected_quad.tiles) {
-        if (srs::tile_bounds(layered_tile.id).contains(world_space)) {
-            const auto bounds = srs::tile_bounds(layered_tile.id);
-            const auto uv = (world_space - bounds.min) / bounds.size();
-            const auto height_tile = QImage::fromData(*layered_tile.height);
-            assert(!height_tile.isNull());
-            if (height_tile.isNull())
-                return 1000;
-            const auto x = int(uv.x * height_tile.width());
-            const auto y = int((1 - uv.y) * height_tile.height());
-            const auto rgb = QColor(height_tile.pixel(x, y));
-            return radix::height_encoding::to_float({rgb.red(), rgb.green(), rgb.blue()});
+    std::vector<std::optional<HeightTile>> result(world_positions.size());
+    for (size_t i = 0; i < world_positions.size(); ++i) {
+        auto quad = quads.find(tile::Id { 0, { 0, 0 } });
+        while (quad != quads.end()) {
+            const auto& tiles = quad->second.tiles;
+            const auto tile = std::find_if(tiles.begin(), tiles.begin() + quad->second.n_tiles, [&](const tile_types::LayeredTile& t) {
+                return srs::tile_bounds(t.id).contains(world_positions[i]);
+            });
+            if (tile == tiles.begin() + quad->second.n_tiles)
+                break;
+            if (tile->height && !tile->height->isEmpty())
+                result[i] = HeightTile { tile->id, tile->height }; // keep the coarser one if a tile has no data
+            quad = quads.find(tile->id);
         }
     }
+    return result;
+}
+
+namespace detail {
+    // slab test, returns the ray parameters of entry and exit
+    inline std::optional<std::pair<double, double>> ray_aabb_intersection(const glm::dvec3& origin, const glm::dvec3& inv_direction, const tile::SrsAndHeightBounds& aabb)
+    {
+        double t_min = 0;
+        double t_max = std::numeric_limits<double>::max();
+        for (int i = 0; i < 3; ++i) {
+            auto t0 = (aabb.min[i] - origin[i]) * inv_direction[i];
+            auto t1 = (aabb.max[i] - origin[i]) * inv_direction[i];
+            if (std::isnan(t0) || std::isnan(t1)) { // direction is 0 and origin on the boundary
+                t0 = -std::numeric_limits<double>::max();
+                t1 = std::numeric_limits<double>::max();
+            }
+            if (t0 > t1)
+                std::swap(t0, t1);
+            t_min = std::max(t_min, t0);
+            t_max = std::min(t_max, t1);
+            if (t_max < t_min)
+                return {};
+        }
+        return std::make_pair(t_min, t_max);
+    }
+
+    // altitude in metres, bilinearly interpolated
+    inline double sample_height(const Raster<uint16_t>& raster, const tile::SrsBounds& bounds, const glm::dvec2& world_xy)
+    {
+        const auto uv = glm::clamp((world_xy - bounds.min) / bounds.size(), 0.0, 1.0);
+        // the pixels are at the vertices of the tile mesh, i.e., the first and last pixel are on the tile border
+        const auto x = uv.x * double(raster.width() - 1);
+        const auto y = (1.0 - uv.y) * double(raster.height() - 1);
+        const auto x0 = std::min(unsigned(x), unsigned(raster.width() - 1));
+        const auto y0 = std::min(unsigned(y), unsigned(raster.height() - 1));
+        const auto x1 = std::min(x0 + 1, unsigned(raster.width() - 1));
+        const auto y1 = std::min(y0 + 1, unsigned(raster.height() - 1));
+        const auto fx = x - double(x0);
+        const auto fy = y - double(y0);
+        const auto top = std::lerp(double(raster.pixel({ x0, y0 })), double(raster.pixel({ x1, y0 })), fx);
+        const auto bottom = std::lerp(double(raster.pixel({ x0, y1 })), double(raster.pixel({ x1, y1 })), fx);
+        return std::lerp(top, bottom, fy) * 0.125; // 16 bit red/green of the height encoding, 1/8 m resolution
+    }
+
+    // world space altitude (including the web mercator scaling)
+    inline double sample_altitude(const Raster<uint16_t>& raster, const tile::SrsBounds& bounds, const glm::dvec2& world_xy)
+    {
+        const auto latitude = srs::world_to_lat_long(world_xy).x;
+        return sample_height(raster, bounds, world_xy) / std::abs(std::cos(latitude * 3.14159265358979323846 / 180.0));
+    }
+
+    // marches through the tile in steps of half a pixel and refines the first crossing by bisection
+    inline std::optional<double> ray_march_tile(const glm::dvec3& origin, const glm::dvec3& direction, double t_entry, double t_exit, const Raster<uint16_t>& raster, const tile::SrsBounds& bounds)
+    {
+        if (raster.width() < 2 || raster.height() < 2)
+            return {};
+        const auto above_terrain = [&](double t) {
+            const auto p = origin + direction * t;
+            return p.z > sample_altitude(raster, bounds, glm::dvec2(p));
+        };
+        const auto pixel_size = std::min(bounds.size().x / double(raster.width() - 1), bounds.size().y / double(raster.height() - 1));
+        const auto step = pixel_size * 0.5;
+        if (!above_terrain(t_entry))
+            return t_entry;
+        auto t_previous = t_entry;
+        for (auto t = std::min(t_entry + step, t_exit); ; t = std::min(t + step, t_exit)) {
+            if (!above_terrain(t)) {
+                auto lo = t_previous;
+                auto hi = t;
+                for (int i = 0; i < 16; ++i) {
+                    const auto mid = (lo + hi) * 0.5;
+                    if (above_terrain(mid))
+                        lo = mid;
+                    else
+                        hi = mid;
+                }
+                return hi;
+            }
+            if (t >= t_exit)
+                return {};
+            t_previous = t;
+        }
+    }
+} // namespace detail
+
+namespace detail {
+    // altitudes in metres (left as they are for positions that are not covered), grouped by tile, so that every tile is decoded
+    // at most once. returns the sampled tiles.
+    inline std::vector<std::optional<tile::Id>> sample_altitudes(MemoryCache* cache, std::span<const glm::dvec2> world_positions, const HeightDecoder& decoder, std::span<float> altitudes)
+    {
+        const auto tiles = find_height_tiles(cache, world_positions);
+        std::unordered_map<tile::Id, std::vector<size_t>, tile::Id::Hasher> queries_per_tile;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            if (tiles[i])
+                queries_per_tile[tiles[i]->id].push_back(i);
+        }
+
+        std::vector<std::optional<tile::Id>> sampled(world_positions.size());
+        for (const auto& [id, indices] : queries_per_tile) {
+            const auto raster = decoder(id, *tiles[indices.front()]->height);
+            if (!raster || raster->width() < 2 || raster->height() < 2)
+                continue;
+            const auto bounds = srs::tile_bounds(id);
+            for (const auto i : indices) {
+                altitudes[i] = float(sample_height(*raster, bounds, world_positions[i]));
+                sampled[i] = id;
+            }
+        }
+        return sampled;
+    }
+
+    // great circle distance in metres
+    inline double distance(const glm::dvec2& lat_long_a, const glm::dvec2& lat_long_b)
+    {
+        constexpr auto earth_radius = 6371000.0; // mean
+        constexpr auto to_radians = 3.14159265358979323846 / 180.0;
+        const auto a = lat_long_a * to_radians;
+        const auto b = lat_long_b * to_radians;
+        const auto h = std::pow(std::sin((b.x - a.x) * 0.5), 2) + std::cos(a.x) * std::cos(b.x) * std::pow(std::sin((b.y - a.y) * 0.5), 2);
+        return 2 * earth_radius * std::asin(std::sqrt(std::min(h, 1.0)));
+    }
+} // namespace detail
+
+/// Altitudes in metres for a batch of positions. Queries are grouped by tile, so that every tile is decoded at most once.
+/// Positions that are not covered by the cache get 1000 m.
+inline std::vector<float> query_altitudes(MemoryCache* cache, std::span<const glm::dvec2> lat_longs, const HeightDecoder& decoder = decode_height)
+{
+    std::vector<glm::dvec2> world_positions;
+    world_positions.reserve(lat_longs.size());
+    for (const auto& lat_long : lat_longs)
+        world_positions.push_back(srs::lat_long_to_world(lat_long));
 
-    assert(false);
-    return 1000;
+    std::vector<float> altitudes(lat_longs.size(), 1000.f);
+    detail::sample_altitudes(cache, world_positions, decoder, altitudes);
+    return altitudes;
+}
+
+struct ProfileSample {
+    glm::dvec2 lat_long;
+    double distance = 0; // metres along the polyline
+    float altitude = 1000; // metres, 1000 if not covered by the cache (as query_altitudes)
+    int zoom_level = -1; // of the sampled height tile, -1 if not covered by the cache
+};
+
+/// Points along a polyline (lat long) every spacing metres (great circle distance), and at all vertices. The segments are
+/// interpolated linearly in lat long, which is close enough for the short segments of gps tracks. Only the vertices if spacing <= 0.
+inline std::vector<ProfileSample> sample_polyline(std::span<const glm::dvec2> polyline, double spacing)
+{
+    std::vector<ProfileSample> samples;
+    if (polyline.empty())
+        return samples;
+    samples.push_back({ polyline.front() });
+    double distance = 0;
+    for (size_t i = 1; i < polyline.size(); ++i) {
+        const auto& a = polyline[i - 1];
+        const auto& b = polyline[i];
+        const auto length = detail::distance(a, b);
+        const auto n_steps = spacing > 0 ? std::max(1u, unsigned(std::ceil(length / spacing))) : 1u;
+        for (unsigned step = 1; step <= n_steps; ++step) {
+            const auto t = double(step) / double(n_steps);
+            samples.push_back({ glm::mix(a, b, t), distance + length * t });
+        }
+        distance += length;
+    }
+    return samples;
+}
+
+/// Altitudes and zoom levels of the samples, with the finest height data in the cache (grouped by tile like query_altitudes).
+/// If missing_quads is given, it receives the quads down to fetch_zoom_level (tiles up to it) that would refine the samples, but
+/// are not in the cache, coarse first. Request them (e.g., Scheduler::request_quads) and query again once they arrived.
+inline void query_profile(MemoryCache* cache,
+    std::span<ProfileSample> samples,
+    const HeightDecoder& decoder = decode_height,
+    unsigned fetch_zoom_level = 0,
+    std::vector<tile::Id>* missing_quads = nullptr)
+{
+    std::vector<glm::dvec2> world_positions;
+    world_positions.reserve(samples.size());
+    for (const auto& sample : samples)
+        world_positions.push_back(srs::lat_long_to_world(sample.lat_long));
+    std::vector<float> altitudes(samples.size(), 1000.f);
+    const auto sampled = detail::sample_altitudes(cache, world_positions, decoder, altitudes);
+
+    std::unordered_set<tile::Id, tile::Id::Hasher> missing;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i].altitude = altitudes[i];
+        samples[i].zoom_level = sampled[i] ? int(sampled[i]->zoom_level) : -1;
+        if (!missing_quads)
+            continue;
+        // the quad of the sampled tile is not in the cache (otherwise a finer tile would have been sampled), nor its descendants
+        auto quad = sampled[i].value_or(tile::Id { 0, { 0, 0 } });
+        while (quad.zoom_level < fetch_zoom_level) {
+            missing.insert(quad);
+            const auto children = quad.children();
+            const auto child = std::find_if(children.begin(), children.end(), [&](const tile::Id& id) { return srs::tile_bounds(id).contains(world_positions[i]); });
+            if (child == children.end())
+                break;
+            quad = *child;
+        }
+    }
+    if (missing_quads) {
+        missing_quads->assign(missing.begin(), missing.end());
+        std::sort(missing_quads->begin(), missing_quads->end(), [](const tile::Id& a, const tile::Id& b) {
+            return std::tie(a.zoom_level, a.coords.x, a.coords.y) < std::tie(b.zoom_level, b.coords.x, b.coords.y);
+        });
+    }
+}
+
+inline float query_altitude(MemoryCache* cache, const glm::dvec2& lat_long, const HeightDecoder& decoder = decode_height)
+{
+    return query_altitudes(cache, std::span<const glm::dvec2>(&lat_long, 1), decoder).front();
+}
+
+/// Casts a ray against the height data in the cache (world space, direction must be normalised). The quad tree is traversed
+/// using the aabbs of the decorator, so that only tiles along the ray are decoded. Returns the first hit or nullopt.
+/// Only reads the cache, so it can run on any thread (e.g. the scheduler thread), no gl context required.
+inline std::optional<glm::dvec3> ray_cast(MemoryCache* cache,
+    const utils::AabbDecoratorPtr& aabb_decorator,
+    const glm::dvec3& origin,
+    const glm::dvec3& direction,
+    const HeightDecoder& decoder = decode_height)
+{
+    const auto inv_direction = 1.0 / direction;
+    std::vector<tile_types::TileQuad> quads;
+    cache->visit_readonly([&](const tile_types::TileQuad& quad) {
+        if (!detail::ray_aabb_intersection(origin, inv_direction, aabb_decorator->aabb(quad.id)))
+            return false;
+        quads.push_back(quad);
+        return true;
+    });
+
+    // tiles for which no quad with finer data was visited are leaves
+    std::unordered_set<tile::Id, tile::Id::Hasher> refined;
+    for (const auto& quad : quads)
+        refined.insert(quad.id);
+
+    struct Candidate {
+        double t_entry;
+        double t_exit;
+        const tile_types::LayeredTile* tile;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto& quad : quads) {
+        for (unsigned i = 0; i < quad.n_tiles; ++i) {
+            const auto& tile = quad.tiles[i];
+            if (refined.contains(tile.id) || !tile.height || tile.height->isEmpty())
+                continue;
+            const auto interval = detail::ray_aabb_intersection(origin, inv_direction, aabb_decorator->aabb(tile.id));
+            if (interval)
+                candidates.push_back({ interval->first, interval->second, &tile });
+        }
+    }
+    // leaves don't overlap in xy, so the first hit is in the earliest tile along the ray (unless the aabbs overlap in t)
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.t_entry < b.t_entry; });
+
+    std::optional<double> best_t;
+    for (const auto& candidate : candidates) {
+        if (best_t && candidate.t_entry > *best_t)
+            break;
+        const auto raster = decoder(candidate.tile->id, *candidate.tile->height);
+        if (!raster)
+            continue;
+        const auto t = detail::ray_march_tile(origin, direction, candidate.t_entry, candidate.t_exit, *raster, srs::tile_bounds(candidate.tile->id));
+        if (t && (!best_t || *t < *best_t))
+            best_t = t;
+    }
+    if (!best_t)
+        return {};
+    return origin + direction * *best_t;
 }
 
 } // namespace nucleus::tile_scheduler::cache_queries
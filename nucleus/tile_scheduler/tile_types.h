@@ -18,10 +18,15 @@
 
 #pragma once
 
+#include <memory>
+#include <tuple>
+#include <vector>
+
 #include <QByteArray>
 
 #include "nucleus/tile_scheduler/utils.h"
 #include "nucleus/utils/ColourTexture.h"
+#include "nucleus/utils/SpscMailbox.h"
 #include <radix/tile.h>
 
 class QImage;
@@ -29,6 +34,9 @@ namespace nucleus {
 template <typename T>
 class Raster;
 }
+namespace nucleus::label_tile {
+struct LabelRecord;
+}
 
 namespace nucleus::tile_scheduler::tile_types {
 
@@ -68,18 +76,67 @@ concept SerialisableTile = requires(T t) {
     requires std::is_same<std::remove_reference_t<decltype(T::version_information)>, const std::array<char, 25>>::value;
 };
 
+// http cache validators of a layer (response headers). they are sent with a conditional request when the tile is retired,
+// so that an unchanged tile is only refreshed instead of downloaded again (see TileLoadService::set_cached_tile_lookup).
+struct CacheValidator {
+    QByteArray etag;
+    QByteArray last_modified;
+    [[nodiscard]] bool empty() const { return etag.isEmpty() && last_modified.isEmpty(); }
+};
+
 struct TileLayer {
     tile::Id id;
     NetworkInfo network_info;
     std::shared_ptr<QByteArray> data;
+    CacheValidator validator = {};
+    bool inherited = false; // not loaded, a part of the closest ancestor's layer is used (see LayerAssembler::set_layer_selector)
+    unsigned source = 0; // index of the ortho source that served it (see Scheduler::set_tile_sources)
 };
 static_assert(NamedTile<TileLayer>);
 
+// the layers that are loaded for a tile
+struct LayerSelection {
+    bool ortho = true;
+    bool height = true;
+};
+
+// sizes of the tiles served by the sources. larger tiles (e.g., 512 px ortho and 129 height vertices) cover the same area with a
+// quarter of the tiles, and so with fewer draw instances and requests. the height tiles are decoded into (and drawn as) grids of
+// height_size^2 vertices, height_size - 1 must be a multiple of 8 for the coarser mesh lods (see gl_engine::TileManager).
+struct TileFormat {
+    unsigned ortho_size = 256;
+    unsigned height_size = 65;
+    [[nodiscard]] bool valid() const { return ortho_size > 0 && height_size > 8 && (height_size - 1) % 8 == 0; }
+    bool operator==(const TileFormat&) const = default;
+};
+
+// transcoded (gpu ready) version of a LayeredTile, so that the decoding can be skipped when the tile is loaded from disk again
+struct GpuTilePayload {
+    nucleus::utils::ColourTexture::Format ortho_format = nucleus::utils::ColourTexture::Format::Uncompressed_RGBA;
+    unsigned ortho_width = 0;
+    unsigned ortho_height = 0;
+    unsigned ortho_mip_levels = 1; // ortho contains the whole chain, see ColourTexture::n_mip_levels
+    std::vector<uint8_t> ortho;
+    unsigned height_width = 0;
+    unsigned height_height = 0;
+    std::vector<uint16_t> height;
+    uint64_t n_bytes() const { return sizeof(GpuTilePayload) + ortho.size() + height.size() * sizeof(uint16_t); }
+};
+
 struct LayeredTile {
     tile::Id id;
     NetworkInfo network_info;
     std::shared_ptr<QByteArray> ortho;
     std::shared_ptr<QByteArray> height;
+    std::shared_ptr<GpuTilePayload> gpu; // optional, see Scheduler::set_gpu_payload_caching
+    CacheValidator ortho_validator = {};
+    CacheValidator height_validator = {};
+    bool ortho_inherited = false; // see TileLayer::inherited
+    bool height_inherited = false;
+    unsigned ortho_source = 0; // see TileLayer::source, the scheduler caches the quads per ortho source
+    // encoded labels (see label_tile::decode). empty if the label layer is disabled, or the zoom level has no labels.
+    std::shared_ptr<QByteArray> labels = std::make_shared<QByteArray>();
+    CacheValidator labels_validator = {};
 };
 static_assert(NamedTile<LayeredTile>);
 
@@ -90,13 +147,38 @@ struct TileQuad {
     NetworkInfo network_info() const {
         return NetworkInfo::join(tiles[0].network_info, tiles[1].network_info, tiles[2].network_info, tiles[3].network_info);
     }
-    static constexpr std::array<char, 25> version_information = {"TileQuad, version 0.3"};
+    // encoded size, used for the byte budget of the ram cache
+    uint64_t n_bytes() const
+    {
+        uint64_t n = sizeof(TileQuad);
+        for (const auto& tile : tiles) {
+            n += tile.ortho ? uint64_t(tile.ortho->size()) : 0;
+            n += tile.height ? uint64_t(tile.height->size()) : 0;
+            n += tile.labels ? uint64_t(tile.labels->size()) : 0;
+            n += tile.gpu ? tile.gpu->n_bytes() : 0;
+        }
+        return n;
+    }
+    // shares identical payloads with other quads (see utils::ByteArrayInterner)
+    template <typename Interner>
+    void intern_payloads(Interner& interner)
+    {
+        for (auto& tile : tiles) {
+            tile.ortho = interner.intern(tile.ortho);
+            tile.height = interner.intern(tile.height);
+            tile.labels = interner.intern(tile.labels);
+        }
+    }
+    static constexpr std::array<char, 25> version_information = {"TileQuad, version 0.9"};
 };
 static_assert(NamedTile<TileQuad>);
 static_assert(SerialisableTile<TileQuad>);
 
 struct GpuCacheInfo {
     tile::Id id;
+    uint64_t n_bytes_on_gpu = 0; // textures and height raster, used for the byte budget of the gpu cache
+    uint64_t resident_since = 0; // msecs since epoch, see Scheduler::set_gpu_min_residency
+    uint64_t n_bytes() const { return n_bytes_on_gpu; }
 };
 static_assert(NamedTile<GpuCacheInfo>);
 
@@ -105,13 +187,60 @@ struct GpuLayeredTile {
     tile::SrsAndHeightBounds bounds = {};
     std::shared_ptr<const nucleus::utils::ColourTexture> ortho;
     std::shared_ptr<const nucleus::Raster<uint16_t>> height;
+    std::shared_ptr<const std::vector<nucleus::label_tile::LabelRecord>> labels; // decoded, null if the tile has no labels
+    std::shared_ptr<const nucleus::Raster<glm::u8vec2>> normals; // of height, octahedral (see utils/normal_map.h)
+    bool inherited = false; // a layer is cut out of an ancestor (see LayeredTile::ortho_inherited)
 };
 static_assert(NamedTile<GpuLayeredTile>);
 
 struct GpuTileQuad {
     tile::Id id;
     std::array<GpuLayeredTile, 4> tiles;
+    float decode_ms = 0; // time spent in Scheduler::to_gpu_quad, shown by the cost overlay (see gl_engine::TileManager::set_overlay_mode)
 };
 static_assert(NamedTile<GpuTileQuad>);
 
+// a quad that the scheduler needs, with its priority. the limiters serve the requests in this order.
+struct QuadRequest {
+    enum class Tier : uint8_t {
+        Visible = 0,
+        Occluded = 1, // hidden behind terrain, as reported by the renderer
+        Prefetch = 2, // for the predicted view
+        Idle = 3, // around the view while the camera is at rest (see Scheduler::set_idle_prefetch)
+    };
+    tile::Id id;
+    Tier tier = Tier::Visible;
+    float screen_space_error = 0;
+
+    // strict total order, the more important request first: tier, larger screen space error, coarser zoom level, coordinates
+    struct Before {
+        bool operator()(const QuadRequest& a, const QuadRequest& b) const
+        {
+            if (a.tier != b.tier)
+                return a.tier < b.tier;
+            if (a.screen_space_error != b.screen_space_error)
+                return a.screen_space_error > b.screen_space_error;
+            return std::tie(a.id.zoom_level, a.id.coords.x, a.id.coords.y) < std::tie(b.id.zoom_level, b.id.coords.x, b.id.coords.y);
+        }
+    };
+};
+
+// changes of the needed quads since the last update (see Scheduler::quad_requests_changed)
+struct QuadRequestDiff {
+    std::vector<QuadRequest> added; // new requests, and the ones whose priority changed
+    std::vector<tile::Id> removed; // not needed any more
+    [[nodiscard]] bool empty() const { return added.empty() && removed.empty(); }
+};
+
+// batches are handed between the pipeline stages (and threads) without copying the quads, the receivers only read them
+using TileQuadBatch = std::shared_ptr<const std::vector<TileQuad>>;
+using GpuTileQuadBatch = std::shared_ptr<const std::vector<GpuTileQuad>>;
+
+// the changes of the gpu quads, as sent by Scheduler::gpu_quads_updated, or through a mailbox (see Scheduler::set_gpu_quad_mailbox)
+struct GpuQuadUpdate {
+    GpuTileQuadBatch new_quads;
+    std::vector<tile::Id> deleted_quads;
+};
+using GpuQuadMailbox = nucleus::utils::SpscMailbox<GpuQuadUpdate>;
+
 } // namespace nucleus::tile_scheduler::tile_types
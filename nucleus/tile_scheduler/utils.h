@@ -22,11 +22,24 @@
 #include <concepts>
 #endif
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+
 #include <QByteArray>
 
+#include "HeightBoundsTable.h"
+#include "HorizonOcclusion.h"
 #include "constants.h"
 #include "nucleus/camera/Definition.h"
 #include "nucleus/srs.h"
+#include "nucleus/utils/LruCache.h"
 #include "radix/TileHeights.h"
 #include "radix/geometry.h"
 
@@ -115,23 +128,167 @@ namespace utils {
 
     class AabbDecorator;
     using AabbDecoratorPtr = std::shared_ptr<AabbDecorator>;
+    /// Bounds of the tiles, from the precomputed TileHeights (flattened into a HeightBoundsTable). Once the height raster of a tile is decoded, its exact range
+    /// replaces the precomputed one (set_exact_heights). A parent whose four children are known, but that has no raster of its
+    /// own yet, gets the union of the children (intersected with the precomputed range). The exact ranges are not handed down
+    /// to descendants, as finer rasters can reach higher than the filtered coarse ones.
+    /// The refinement of flat tiles can be relaxed by their roughness (see set_flat_terrain_factor and error_size), and tiles
+    /// hidden behind the terrain around the camera can be skipped (see set_horizon_culling).
     class AabbDecorator {
-        TileHeights tile_heights;
+        struct ExactHeights {
+            float min = 0;
+            float max = 0;
+            bool from_raster = false; // otherwise the union of the children
+            float roughness = -1; // in srs units like the bounds, negative if unknown (see set_exact_heights)
+        };
+        HeightBoundsTable m_heights;
+        // the refine traversals of the scheduler, the gpu update, the purge and the draw list visit mostly the same nodes.
+        // thread safe, as they run on different threads.
+        mutable std::mutex m_memo_mutex;
+        mutable nucleus::utils::LruCache<tile::Id, tile::SrsAndHeightBounds, tile::Id::Hasher> m_memo { 1 << 14 };
+        mutable nucleus::utils::LruCache<tile::Id, ExactHeights, tile::Id::Hasher> m_exact { 1 << 16 }; // guarded by m_memo_mutex
+        std::atomic<unsigned> m_version = 0;
+        std::atomic<float> m_flat_terrain_factor = 1.0f;
+        std::atomic<bool> m_horizon_culling = false;
 
     public:
-        explicit inline AabbDecorator(TileHeights tile_heights)
-            : tile_heights(std::move(tile_heights))
+        explicit inline AabbDecorator(HeightBoundsTable heights)
+            : m_heights(std::move(heights))
+        {
+        }
+        explicit inline AabbDecorator(const TileHeights& tile_heights)
+            : m_heights(HeightBoundsTable::build(tile_heights))
         {
         }
         inline tile::SrsAndHeightBounds aabb(const tile::Id& id) const
         {
-            const auto heights = tile_heights.query({ id.zoom_level, id.coords });
+            {
+                std::scoped_lock lock(m_memo_mutex);
+                if (const auto* bounds = m_memo.find(id))
+                    return *bounds;
+            }
+            const auto bounds = compute_aabb(id); // outside of the lock, the math is what we want to avoid blocking on
+            std::scoped_lock lock(m_memo_mutex);
+            m_memo.insert(id, bounds);
+            return bounds;
+        }
+        inline tile::SrsAndHeightBounds compute_aabb(const tile::Id& id) const
+        {
+            const auto heights = m_heights.query(id);
+            {
+                std::scoped_lock lock(m_memo_mutex);
+                if (const auto* exact = m_exact.find(id)) {
+                    if (exact->from_raster)
+                        return make_bounds(id, exact->min, exact->max);
+                    return make_bounds(id, std::max(heights.first, exact->min), std::min(heights.second, exact->max));
+                }
+            }
+            return make_bounds(id, heights.first, heights.second);
+        }
+        /// min and max altitude (in metres) of the decoded height raster of a tile, and optionally its roughness (in metres, see
+        /// raster_roughness). thread safe.
+        inline void set_exact_heights(const tile::Id& id, float min_height, float max_height, float roughness = -1)
+        {
+            // scaled like the altitudes of the bounds, so that it compares to their size
+            const auto srs_roughness = roughness < 0 ? -1.f : make_bounds(id, 0, roughness).max.z - 0.5f;
+            std::scoped_lock lock(m_memo_mutex);
+            if (const auto* exact = m_exact.find(id);
+                exact && exact->from_raster && exact->min == min_height && exact->max == max_height && exact->roughness == srs_roughness)
+                return;
+            m_exact.insert(id, { min_height, max_height, true, srs_roughness });
+            m_memo.erase(id);
+            auto child = id;
+            while (child.zoom_level > 0) {
+                const auto parent = child.parent();
+                const auto* parent_exact = m_exact.find(parent);
+                if (parent_exact && parent_exact->from_raster)
+                    break;
+                ExactHeights merged { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), false };
+                bool complete = true;
+                for (const auto& sibling : parent.children()) {
+                    const auto* sibling_exact = m_exact.find(sibling);
+                    if (!sibling_exact) {
+                        complete = false;
+                        break;
+                    }
+                    merged.min = std::min(merged.min, sibling_exact->min);
+                    merged.max = std::max(merged.max, sibling_exact->max);
+                }
+                if (!complete)
+                    break;
+                m_exact.insert(parent, merged);
+                m_memo.erase(parent);
+                child = parent;
+            }
+            ++m_version;
+        }
+        /// incremented whenever bounds got tighter, so that memoised traversals can start over
+        [[nodiscard]] inline unsigned version() const { return m_version; }
+
+        /// the smallest fraction of the footprint error (the size of an ortho pixel) that is kept for flat tiles, clamped to
+        /// [0.5, 1]. 1 (default) refines by the footprint only, 0.5 leaves lakes and valley floors a level coarser than peaks.
+        /// not below 0.5, so that a parent keeps a larger error than its children.
+        inline void set_flat_terrain_factor(float factor)
+        {
+            m_flat_terrain_factor = std::clamp(factor, 0.5f, 1.0f);
+            ++m_version;
+        }
+        [[nodiscard]] inline float flat_terrain_factor() const { return m_flat_terrain_factor; }
+        /// world space size of the error of a tile, which is projected to screen space for the refinement decision: the size
+        /// of an ortho pixel, reduced to the geometric error of flat terrain. that is the roughness of the decoded height raster
+        /// if known, otherwise the height range of the tile (the terrain can't deviate further from a flat surface inside it).
+        inline float error_size(const tile::Id& id, const tile::SrsAndHeightBounds& aabb, double tile_size) const
+        {
+            constexpr auto sqrt2 = 1.414213562373095;
+            const auto footprint = float(sqrt2 * aabb.size().x / tile_size);
+            const auto factor = m_flat_terrain_factor.load();
+            if (factor >= 1.0f)
+                return footprint;
+            auto [min, max] = m_heights.query(id);
+            {
+                std::scoped_lock lock(m_memo_mutex);
+                if (const auto* exact = m_exact.find(id)) {
+                    if (exact->from_raster && exact->roughness >= 0)
+                        return std::clamp(exact->roughness, footprint * factor, footprint);
+                    min = exact->from_raster ? exact->min : std::max(min, exact->min); // as in compute_aabb
+                    max = exact->from_raster ? exact->max : std::min(max, exact->max);
+                }
+            }
+            // scaled like the altitudes of the bounds (aabb.size().z also contains the scaling of the altitude itself)
+            const auto geometric_error = make_bounds(id, 0, max - min).max.z - 0.5f;
+            return std::clamp(geometric_error, footprint * factor, footprint);
+        }
+        /// bounds of the tile and all its descendants, from the precomputed range only (the exact ranges are not handed down)
+        inline tile::SrsAndHeightBounds subtree_aabb(const tile::Id& id) const
+        {
+            const auto heights = m_heights.query(id);
             return make_bounds(id, heights.first, heights.second);
         }
-        static inline AabbDecoratorPtr make(TileHeights heights)
+        [[nodiscard]] inline const HeightBoundsTable& height_bounds() const { return m_heights; }
+
+        /// tiles whose subtree is below the horizon of the terrain around the camera are neither refined nor drawn (see
+        /// HorizonOcclusion). off by default.
+        inline void set_horizon_culling(bool enabled)
+        {
+            m_horizon_culling = enabled;
+            ++m_version;
+        }
+        [[nodiscard]] inline bool horizon_culling() const { return m_horizon_culling; }
+        /// the horizon around the camera, empty if horizon culling is off (it occludes nothing then)
+        inline void build_horizon(const glm::dvec3& camera_position, HorizonOcclusion* horizon) const
+        {
+            if (m_horizon_culling)
+                horizon->build(camera_position, m_heights);
+            else
+                horizon->clear();
+        }
+        /// whether the tile is hidden behind the horizon, see set_horizon_culling
+        inline bool below_horizon(const tile::Id& id, const HorizonOcclusion& horizon) const
         {
-            return std::make_shared<AabbDecorator>(std::move(heights));
+            return !horizon.empty() && horizon.occludes(subtree_aabb(id));
         }
+        static inline AabbDecoratorPtr make(const TileHeights& heights) { return std::make_shared<AabbDecorator>(heights); }
+        static inline AabbDecoratorPtr make(HeightBoundsTable heights) { return std::make_shared<AabbDecorator>(std::move(heights)); }
     };
 
     inline auto camera_frustum_contains_tile_old(const nucleus::camera::Frustum& frustum, const tile::SrsAndHeightBounds& aabb)
@@ -143,7 +300,9 @@ namespace utils {
         return !triangles.empty();
     }
 
-    inline auto camera_frustum_contains_tile(const nucleus::camera::Frustum& frustum, const tile::SrsAndHeightBounds& aabb)
+    enum class FrustumClassification : uint8_t { Outside, Intersecting, Inside };
+
+    inline FrustumClassification classify_tile_in_frustum(const nucleus::camera::Frustum& frustum, const tile::SrsAndHeightBounds& aabb)
     {
         // loosely based on https://bruop.github.io/improved_frustum_culling/
         struct Range {
@@ -168,16 +327,16 @@ namespace utils {
         bool all_inside = true;
         for (const auto& p : frustum.clipping_planes) {
             if (distance(p, aabb_corner_in_direction(p.normal)) <= 0)
-                return false;
+                return FrustumClassification::Outside;
             all_inside = all_inside && (distance(p, aabb_corner_in_direction(-p.normal)) > 0);
         }
 
         if (all_inside)
-            return true;
+            return FrustumClassification::Inside;
 
         for (const auto& p : frustum.corners)
             if (aabb.contains(p))
-                return true;
+                return FrustumClassification::Intersecting;
 
         const auto position_along_direction = [](const glm::dvec3& position, const glm::dvec3& direction) { return glm::dot(position, direction); };
 
@@ -223,7 +382,7 @@ namespace utils {
 
         for (const auto& direction : aabb_edges) {
             if (!frustum_and_aabb_ranges_overlap_along_direction(direction))
-                return false;
+                return FrustumClassification::Outside;
         }
 
         for (const auto& fe : frustum_edges) {
@@ -234,10 +393,99 @@ namespace utils {
                     && std::abs(direction.z) < geometry::epsilon<double>)
                     continue; // parallel
                 if (!frustum_and_aabb_ranges_overlap_along_direction(direction))
-                    return false;
+                    return FrustumClassification::Outside;
             }
         }
-        return true;
+        return FrustumClassification::Intersecting;
+    }
+
+    /// for hierarchical culling: the classification of a parent carries over to a child whose box is inside the parent's box
+    /// (the frustum is convex), Outside and Inside only. nullopt if the frustum test is needed.
+    inline std::optional<FrustumClassification> inherited_frustum_classification(
+        FrustumClassification parent, const tile::SrsAndHeightBounds& parent_aabb, const tile::SrsAndHeightBounds& aabb)
+    {
+        if (parent == FrustumClassification::Intersecting)
+            return {};
+        if (!glm::all(glm::greaterThanEqual(aabb.min, parent_aabb.min)) || !glm::all(glm::lessThanEqual(aabb.max, parent_aabb.max)))
+            return {};
+        return parent;
+    }
+
+    inline auto camera_frustum_contains_tile(const nucleus::camera::Frustum& frustum, const tile::SrsAndHeightBounds& aabb)
+    {
+        return classify_tile_in_frustum(frustum, aabb) != FrustumClassification::Outside;
+    }
+
+    /// the planes of a frustum relative to an origin (usually the camera position), so that the boxes of the tiles around the
+    /// camera can be tested in float.
+    struct RelativeFrustumPlanes {
+        glm::dvec3 origin = {};
+        std::array<glm::vec3, 6> normals = {};
+        std::array<float, 6> offsets = {};
+    };
+
+    inline RelativeFrustumPlanes relative_frustum_planes(const nucleus::camera::Frustum& frustum, const glm::dvec3& origin)
+    {
+        RelativeFrustumPlanes planes;
+        planes.origin = origin;
+        for (size_t i = 0; i < frustum.clipping_planes.size(); ++i) {
+            planes.normals[i] = glm::vec3(frustum.clipping_planes[i].normal);
+            planes.offsets[i] = float(distance(frustum.clipping_planes[i], origin));
+        }
+        return planes;
+    }
+
+    /// classifies 4 boxes (usually the children of a quad) at once. the plane test runs in float on the boxes in structure of
+    /// arrays layout, the loops over the 4 lanes are written for auto vectorisation (sse, neon, wasm simd if enabled, scalar
+    /// otherwise). boxes that are close to a plane (within the float precision), and boxes that intersect the planes, fall back
+    /// to classify_tile_in_frustum, so the result is the same as testing one box at a time.
+    inline std::array<FrustumClassification, 4> classify_tiles_in_frustum(
+        const nucleus::camera::Frustum& frustum, const RelativeFrustumPlanes& planes, const std::array<tile::SrsAndHeightBounds, 4>& aabbs)
+    {
+        alignas(16) std::array<float, 4> min_x, min_y, min_z, max_x, max_y, max_z;
+        for (size_t i = 0; i < 4; ++i) {
+            const auto min = glm::vec3(aabbs[i].min - planes.origin);
+            const auto max = glm::vec3(aabbs[i].max - planes.origin);
+            min_x[i] = min.x;
+            min_y[i] = min.y;
+            min_z[i] = min.z;
+            max_x[i] = max.x;
+            max_y[i] = max.y;
+            max_z[i] = max.z;
+        }
+        alignas(16) std::array<int, 4> outside = { 0, 0, 0, 0 };
+        alignas(16) std::array<int, 4> inside = { 1, 1, 1, 1 };
+        constexpr float relative_precision = 1e-5f;
+        for (size_t p = 0; p < 6; ++p) {
+            const auto n = planes.normals[p];
+            const auto d = planes.offsets[p];
+            for (size_t i = 0; i < 4; ++i) {
+                // corners furthest along the normal and against it
+                const auto far_x = n.x > 0 ? max_x[i] : min_x[i];
+                const auto far_y = n.y > 0 ? max_y[i] : min_y[i];
+                const auto far_z = n.z > 0 ? max_z[i] : min_z[i];
+                const auto near_x = n.x > 0 ? min_x[i] : max_x[i];
+                const auto near_y = n.y > 0 ? min_y[i] : max_y[i];
+                const auto near_z = n.z > 0 ? min_z[i] : max_z[i];
+                const auto far_distance = n.x * far_x + n.y * far_y + n.z * far_z + d;
+                const auto near_distance = n.x * near_x + n.y * near_y + n.z * near_z + d;
+                const auto margin = relative_precision
+                    * (std::abs(d) + std::abs(n.x) * std::max(std::abs(min_x[i]), std::abs(max_x[i])) + std::abs(n.y) * std::max(std::abs(min_y[i]), std::abs(max_y[i]))
+                        + std::abs(n.z) * std::max(std::abs(min_z[i]), std::abs(max_z[i])));
+                outside[i] |= int(far_distance < -margin);
+                inside[i] &= int(near_distance > margin);
+            }
+        }
+        std::array<FrustumClassification, 4> result;
+        for (size_t i = 0; i < 4; ++i) {
+            if (outside[i])
+                result[i] = FrustumClassification::Outside;
+            else if (inside[i])
+                result[i] = FrustumClassification::Inside;
+            else
+                result[i] = classify_tile_in_frustum(frustum, aabbs[i]);
+        }
+        return result;
     }
 
     inline auto refine_functor_float(const nucleus::camera::Definition &camera,
@@ -245,23 +493,24 @@ namespace utils {
                                      float error_threshold_px,
                                      float tile_size = 256)
     {
-        constexpr auto sqrt2 = 1.414213562373095f;
         const auto camera_frustum = camera.frustum();
+        const auto horizon = std::make_shared<HorizonOcclusion>();
+        aabb_decorator->build_horizon(camera.position(), horizon.get());
         auto refine =
-            [camera_frustum, camera, error_threshold_px, tile_size, aabb_decorator](const tile::Id& tile) {
+            [camera_frustum, camera, error_threshold_px, tile_size, aabb_decorator, horizon](const tile::Id& tile) {
                 if (tile.zoom_level >= 18)
                     return false;
 
                 auto aabb = aabb_decorator->aabb(tile);
                 if (!tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabb))
                     return false;
+                if (aabb_decorator->below_horizon(tile, *horizon))
+                    return false;
                 const auto aabb_float = geometry::Aabb<3, float>{aabb.min - camera.position(),
                                                                  aabb.max - camera.position()};
 
                 const auto distance = geometry::distance(aabb_float, glm::vec3{0, 0, 0});
-                const auto pixel_size = sqrt2 * aabb_float.size().x / tile_size;
-
-                return camera.to_screen_space(pixel_size, distance) >= error_threshold_px;
+                return camera.to_screen_space(aabb_decorator->error_size(tile, aabb, tile_size), distance) >= error_threshold_px;
             };
         return refine;
     }
@@ -271,24 +520,44 @@ namespace utils {
         float error_threshold_px,
         double tile_size = 256)
     {
-        constexpr auto sqrt2 = 1.414213562373095;
         const auto camera_frustum = camera.frustum();
-        auto refine = [&camera, camera_frustum, error_threshold_px, tile_size, aabb_decorator](const tile::Id& tile) {
+        const auto horizon = std::make_shared<HorizonOcclusion>();
+        aabb_decorator->build_horizon(camera.position(), horizon.get());
+        auto refine = [&camera, camera_frustum, error_threshold_px, tile_size, aabb_decorator, horizon](const tile::Id& tile) {
             if (tile.zoom_level >= 18)
                 return false;
 
             const auto aabb = aabb_decorator->aabb(tile);
             if (!tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabb))
                 return false;
+            if (aabb_decorator->below_horizon(tile, *horizon))
+                return false;
 
             const auto distance = float(geometry::distance(aabb, camera.position()));
-            const auto pixel_size = float(sqrt2 * aabb.size().x / tile_size);
-
-            return camera.to_screen_space(pixel_size, distance) >= error_threshold_px;
+            return camera.to_screen_space(aabb_decorator->error_size(tile, aabb, tile_size), distance) >= error_threshold_px;
         };
         return refine;
     }
 
+    /// projected screen space error of a tile in pixels, 0 outside the frustum and below the horizon. used as request priority: a
+    /// parent always has a larger error than its children, so sorting by it descending fetches coarse before fine and the
+    /// foreground before the distance.
+    inline auto screen_space_error_functor(const nucleus::camera::Definition& camera, const AabbDecoratorPtr& aabb_decorator, double tile_size = 256)
+    {
+        const auto camera_frustum = camera.frustum();
+        const auto horizon = std::make_shared<HorizonOcclusion>();
+        aabb_decorator->build_horizon(camera.position(), horizon.get());
+        return [camera, camera_frustum, tile_size, aabb_decorator, horizon](const tile::Id& tile) {
+            const auto aabb = aabb_decorator->aabb(tile);
+            if (!tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabb))
+                return 0.f;
+            if (aabb_decorator->below_horizon(tile, *horizon))
+                return 0.f;
+            const auto distance = float(geometry::distance(aabb, camera.position()));
+            return camera.to_screen_space(aabb_decorator->error_size(tile, aabb, tile_size), distance);
+        };
+    }
+
     inline uint64_t time_since_epoch()
     {
         return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
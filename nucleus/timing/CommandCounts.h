@@ -0,0 +1,50 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+namespace nucleus::timing {
+
+/// Counts of the gl commands of a frame, or a pass of it (see gl_engine::GlCounters). Next to the timers, they make changes
+/// in the amount of work visible, e.g., a pass that suddenly uploads five times as much.
+struct CommandCounts {
+    uint64_t draw_calls = 0;
+    uint64_t instances = 0;
+    uint64_t vertices = 0; // submitted, i.e., per instance
+    uint64_t state_changes = 0; // the ones that reach gl, see gl_engine::GlState
+    uint64_t texture_bytes = 0; // uploaded
+    uint64_t buffer_bytes = 0; // written
+    uint64_t framebuffer_binds = 0;
+
+    CommandCounts& operator+=(const CommandCounts& other)
+    {
+        draw_calls += other.draw_calls;
+        instances += other.instances;
+        vertices += other.vertices;
+        state_changes += other.state_changes;
+        texture_bytes += other.texture_bytes;
+        buffer_bytes += other.buffer_bytes;
+        framebuffer_binds += other.framebuffer_binds;
+        return *this;
+    }
+    bool operator==(const CommandCounts&) const = default;
+};
+
+} // namespace nucleus::timing
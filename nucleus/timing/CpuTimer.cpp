@@ -26,11 +26,12 @@ CpuTimer::CpuTimer(const std::string &name, const std::string& group, int queue_
 }
 
 void CpuTimer::_start() {
-    m_ticks[0] = std::chrono::high_resolution_clock::now();
+    m_ticks[0] = TraceRecorder::Clock::now();
 }
 
 void CpuTimer::_stop() {
-    m_ticks[1] = std::chrono::high_resolution_clock::now();
+    m_ticks[1] = TraceRecorder::Clock::now();
+    TraceRecorder::instance().record(m_name, m_group, m_ticks[0], m_ticks[1]);
 }
 
 float CpuTimer::_fetch_result() {
@@ -19,11 +19,12 @@
 #pragma once
 
 #include "TimerInterface.h"
-#include "chrono"
+#include "TraceRecorder.h"
 
 namespace nucleus::timing {
 
-/// The CpuTimer class measures times on the c++ side using the std::chronos library
+/// The CpuTimer class measures times on the c++ side using the std::chronos library. The measurements are also recorded
+/// into the TraceRecorder, if it is enabled.
 class CpuTimer : public TimerInterface {
 public:
     CpuTimer(const std::string& name, const std::string& group, int queue_size, float average_weight);
@@ -37,7 +38,7 @@ protected:
     float _fetch_result() override;
 
 private:
-    std::chrono::time_point<std::chrono::high_resolution_clock> m_ticks[2];
+    TraceRecorder::Clock::time_point m_ticks[2]; // the clock of the trace recorder, so that the events line up
 };
 
 }
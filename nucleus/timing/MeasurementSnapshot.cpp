@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "MeasurementSnapshot.h"
+
+#include <algorithm>
+
+namespace nucleus::timing {
+
+void MeasurementSnapshot::set_enabled(bool enabled) { m_enabled = enabled; }
+
+void MeasurementSnapshot::set_timers(const TimerManager& manager, std::vector<std::string> passes)
+{
+    std::vector<TimerInfo> infos;
+    for (const auto& timer : manager.timers()) {
+        if (infos.size() == max_timers)
+            break;
+        infos.push_back({ timer->get_name(), timer->get_group(), timer->get_queue_size(), timer->get_average_weight() });
+    }
+    if (passes.size() > max_passes)
+        passes.resize(max_passes);
+    const auto n_timers = unsigned(infos.size());
+    const auto n_passes = unsigned(passes.size());
+    {
+        std::scoped_lock lock(m_info_mutex);
+        m_infos = std::move(infos);
+        m_passes = std::move(passes);
+    }
+    const auto layout_version = m_accumulated.layout_version + 1;
+    m_accumulated = {};
+    m_accumulated.layout_version = layout_version;
+    m_accumulated.n_timers = n_timers;
+    m_accumulated.n_passes = n_passes;
+    publish({});
+}
+
+void MeasurementSnapshot::publish(const std::vector<TimerReport>& reports, std::span<const CommandCounts> counts)
+{
+    for (const auto& report : reports) {
+        if (report.index >= m_accumulated.n_timers)
+            continue;
+        auto& entry = m_accumulated.entries[report.index];
+        entry.last = report.value;
+        entry.sum += report.value;
+        ++entry.count;
+    }
+    for (size_t i = 0; i < std::min(counts.size(), size_t(m_accumulated.n_passes)); ++i)
+        m_accumulated.counts[i] += counts[i];
+    ++m_accumulated.frame;
+    m_buffers[m_write_index] = m_accumulated;
+    m_write_index = m_middle.exchange(m_write_index | fresh_bit, std::memory_order_acq_rel) & ~fresh_bit;
+}
+
+bool MeasurementSnapshot::read(Snapshot& snapshot)
+{
+    if (!(m_middle.load(std::memory_order_relaxed) & fresh_bit))
+        return false;
+    m_read_index = m_middle.exchange(m_read_index, std::memory_order_acq_rel) & ~fresh_bit;
+    snapshot = m_buffers[m_read_index];
+    return true;
+}
+
+std::vector<MeasurementSnapshot::TimerInfo> MeasurementSnapshot::timers() const
+{
+    std::scoped_lock lock(m_info_mutex);
+    return m_infos;
+}
+
+std::vector<std::string> MeasurementSnapshot::passes() const
+{
+    std::scoped_lock lock(m_info_mutex);
+    return m_passes;
+}
+
+} // namespace nucleus::timing
@@ -0,0 +1,94 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "CommandCounts.h"
+#include "TimerManager.h"
+
+namespace nucleus::timing {
+
+/// The timer measurements of the render thread for the debug gui, which polls them at its own rate instead of receiving a
+/// signal per frame. Publishing is lock and allocation free: a triple buffer, the render thread never waits for the gui
+/// and the gui always reads a complete snapshot. Per timer, the count and sum of all measurements are kept, so that the
+/// reader can average over its polling interval. The gl command counts of the passes are summed up the same way.
+/// Collection is disabled by default, i.e., while the hud is hidden the render thread publishes nothing.
+/// One writer (render thread) and one reader (gui thread).
+class MeasurementSnapshot {
+public:
+    static constexpr unsigned max_timers = 32;
+    static constexpr unsigned max_passes = 16;
+    struct TimerInfo {
+        std::string name;
+        std::string group;
+        int queue_size = 0;
+        float average_weight = 0;
+    };
+    struct Entry {
+        float last = 0; // msecs
+        double sum = 0; // msecs, of all measurements since set_timers
+        uint64_t count = 0;
+    };
+    struct Snapshot {
+        uint64_t layout_version = 0; // changes with set_timers, see timers()
+        uint64_t frame = 0; // number of publishes since set_timers
+        unsigned n_timers = 0;
+        std::array<Entry, max_timers> entries = {}; // in the order of timers()
+        unsigned n_passes = 0;
+        std::array<CommandCounts, max_passes> counts = {}; // sums of all published frames, in the order of passes()
+    };
+
+    void set_enabled(bool enabled);
+    [[nodiscard]] bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // writer, at setup. resets the accumulated measurements. passes are the names of the command count passes.
+    void set_timers(const TimerManager& manager, std::vector<std::string> passes = {});
+    // writer, per frame. counts are the command counts of the frame, in the order of the passes.
+    void publish(const std::vector<TimerReport>& reports, std::span<const CommandCounts> counts = {});
+
+    // reader. returns false if nothing was published since the last read, snapshot is left untouched then.
+    bool read(Snapshot& snapshot);
+    [[nodiscard]] std::vector<TimerInfo> timers() const;
+    [[nodiscard]] std::vector<std::string> passes() const;
+
+private:
+    static constexpr unsigned fresh_bit = 4;
+    std::atomic<bool> m_enabled = false;
+
+    mutable std::mutex m_info_mutex; // only for the timer infos, which change at setup
+    std::vector<TimerInfo> m_infos;
+    std::vector<std::string> m_passes;
+
+    Snapshot m_accumulated; // writer only
+    std::array<Snapshot, 3> m_buffers = {};
+    unsigned m_write_index = 0; // writer only
+    unsigned m_read_index = 1; // reader only
+    std::atomic<unsigned> m_middle = 2; // index of the buffer in between, | fresh_bit if the writer swapped since the last read
+};
+using MeasurementSnapshotPtr = std::shared_ptr<MeasurementSnapshot>;
+
+} // namespace nucleus::timing
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "SpikeDetector.h"
+
+#include <algorithm>
+
+namespace nucleus::timing {
+
+SpikeDetector::SpikeDetector(const Settings& settings) { set_settings(settings); }
+
+void SpikeDetector::set_settings(const Settings& settings)
+{
+    m_settings = settings;
+    m_settings.n_median_frames = std::max(m_settings.n_median_frames, 1u);
+    m_frames.clear();
+    m_next = 0;
+    m_pending.reset();
+    m_n_frames_after = 0;
+    m_cooldown = 0;
+}
+
+float SpikeDetector::median_msecs() const
+{
+    if (m_frames.empty())
+        return 0;
+    auto frames = m_frames;
+    const auto middle = frames.begin() + ptrdiff_t(frames.size() / 2);
+    std::nth_element(frames.begin(), middle, frames.end());
+    return *middle;
+}
+
+std::optional<SpikeDetector::Capture> SpikeDetector::add_frame(float msecs, Clock::time_point end)
+{
+    const auto judged = m_frames.size() == m_settings.n_median_frames && m_cooldown == 0;
+    const auto median = judged ? median_msecs() : 0.0f;
+    const auto is_spike = judged && msecs >= m_settings.min_msecs && msecs >= m_settings.factor * median;
+
+    if (m_frames.size() < m_settings.n_median_frames) {
+        m_frames.push_back(msecs);
+    } else {
+        m_frames[m_next] = msecs;
+        m_next = (m_next + 1) % m_frames.size();
+    }
+    if (m_cooldown > 0)
+        --m_cooldown;
+
+    if (is_spike) {
+        const auto begin = end - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(msecs + m_settings.before_msecs));
+        if (!m_pending)
+            m_pending = Capture { begin, end, msecs, median };
+        m_pending->spike_msecs = std::max(m_pending->spike_msecs, msecs);
+        m_n_frames_after = 0;
+        return {};
+    }
+    if (!m_pending)
+        return {};
+    if (++m_n_frames_after < m_settings.n_frames_after)
+        return {};
+    auto capture = *m_pending;
+    capture.to = end;
+    m_pending.reset();
+    m_cooldown = m_settings.cooldown_frames;
+    return capture;
+}
+
+} // namespace nucleus::timing
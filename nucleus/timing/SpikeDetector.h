@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "TraceRecorder.h"
+
+namespace nucleus::timing {
+
+/// Finds frames that take much longer than the recent ones (hitches), which the rolling averages of the TimerManager hide. A
+/// frame is a spike if it takes factor times the median of the last n_median_frames frames, and at least min_msecs. The
+/// capture window reaches from before_msecs before the spike to n_frames_after frames after it (the gpu timers and the
+/// aftermath arrive later), spikes within a pending window extend it. After a capture, detection pauses for cooldown_frames.
+/// The window is meant to be cut out of the TraceRecorder (TraceRecorder::write_chrome_trace with from and to).
+class SpikeDetector {
+public:
+    using Clock = TraceRecorder::Clock;
+    struct Settings {
+        float factor = 3.0f;
+        float min_msecs = 25.0f;
+        unsigned n_median_frames = 120; // no frame is judged before there are this many
+        float before_msecs = 1000.0f;
+        unsigned n_frames_after = 10;
+        unsigned cooldown_frames = 600;
+        bool operator==(const Settings&) const = default;
+    };
+    struct Capture {
+        Clock::time_point from;
+        Clock::time_point to;
+        float spike_msecs = 0; // the longest spike of the window
+        float median_msecs = 0; // before it
+    };
+
+    SpikeDetector() = default;
+    explicit SpikeDetector(const Settings& settings);
+    void set_settings(const Settings& settings); // restarts the detection
+    [[nodiscard]] const Settings& settings() const { return m_settings; }
+
+    /// a frame that took msecs and ended at end. returns the capture once its window is complete.
+    [[nodiscard]] std::optional<Capture> add_frame(float msecs, Clock::time_point end = Clock::now());
+    [[nodiscard]] float median_msecs() const;
+
+private:
+    Settings m_settings;
+    std::vector<float> m_frames; // ring buffer
+    size_t m_next = 0;
+    std::optional<Capture> m_pending;
+    unsigned m_n_frames_after = 0; // since the last spike of the pending capture
+    unsigned m_cooldown = 0;
+};
+
+} // namespace nucleus::timing
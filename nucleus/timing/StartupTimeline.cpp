@@ -0,0 +1,107 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "StartupTimeline.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QFile>
+#include <fmt/format.h>
+
+namespace nucleus::timing {
+
+namespace {
+    double msecs_between(StartupTimeline::Clock::time_point from, StartupTimeline::Clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+} // namespace
+
+StartupTimeline::StartupTimeline() { m_recorder.set_enabled(true); }
+
+StartupTimeline& StartupTimeline::instance()
+{
+    static StartupTimeline timeline;
+    return timeline;
+}
+
+void StartupTimeline::record(const char* name, Clock::time_point begin, Clock::time_point end)
+{
+    if (!finished())
+        m_recorder.record(name, "startup", begin, end);
+}
+
+bool StartupTimeline::finish(Clock::time_point first_frame)
+{
+    if (m_finished.load(std::memory_order_relaxed))
+        return false;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_first_frame)
+            return false;
+        m_first_frame = first_frame;
+        m_finished = true;
+    }
+    m_recorder.record("first frame", "startup", m_epoch, first_frame);
+    qDebug().noquote() << QString::fromStdString(report());
+    if (const auto path = qEnvironmentVariable("ALP_STARTUP_TRACE"); !path.isEmpty()) {
+        QFile file(path);
+        if (file.open(QIODeviceBase::WriteOnly))
+            file.write(QByteArray::fromStdString(to_chrome_trace_json()));
+        else
+            qDebug() << "StartupTimeline: couldn't write" << path;
+    }
+    return true;
+}
+
+bool StartupTimeline::finished() const { return m_finished; }
+
+std::optional<double> StartupTimeline::first_frame_msecs() const
+{
+    std::scoped_lock lock(m_mutex);
+    if (!m_first_frame)
+        return {};
+    return msecs_between(m_epoch, *m_first_frame);
+}
+
+std::vector<StartupTimeline::Phase> StartupTimeline::phases() const
+{
+    const auto events = m_recorder.events();
+    const auto names = m_recorder.names();
+    const auto threads = m_recorder.threads();
+    // the recorder counts from its own construction, right after m_epoch
+    std::vector<Phase> phases;
+    phases.reserve(events.size());
+    for (const auto& e : events)
+        phases.push_back({ names[e.name], threads[e.thread], double(e.begin_ns) / 1e6, double(e.duration_ns) / 1e6 });
+    std::stable_sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) { return a.begin_msecs < b.begin_msecs; });
+    return phases;
+}
+
+std::string StartupTimeline::report() const
+{
+    std::string report = "startup timeline (msecs since start, duration, thread):";
+    for (const auto& phase : phases())
+        report += fmt::format("\n  {:8.1f} {:8.1f}  {} ({})", phase.begin_msecs, phase.msecs, phase.name, phase.thread);
+    return report;
+}
+
+std::string StartupTimeline::to_chrome_trace_json() const { return m_recorder.to_chrome_trace_json(); }
+
+} // namespace nucleus::timing
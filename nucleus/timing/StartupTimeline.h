@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "TraceRecorder.h"
+
+namespace nucleus::timing {
+
+/// Phases of the cold start until the first frame (reading the height data, compiling the shaders, allocating the tile arrays, ..),
+/// so that regressions of the startup time show up. The phases are recorded always, there are only a few, and concurrent ones are
+/// recorded with their thread. Times are relative to the construction of the timeline (instance() is called first thing in main).
+/// When the first frame is marked (finish), the timeline is printed, and written as chrome trace json into the file given by the
+/// environment variable ALP_STARTUP_TRACE, if set. Later phases are not recorded. Thread safe.
+class StartupTimeline {
+public:
+    using Clock = TraceRecorder::Clock;
+    struct Phase {
+        std::string name;
+        std::string thread;
+        double begin_msecs = 0;
+        double msecs = 0;
+    };
+
+    StartupTimeline();
+    static StartupTimeline& instance();
+
+    void record(const char* name, Clock::time_point begin, Clock::time_point end);
+    // the first frame, only the first call counts. returns true for it.
+    bool finish(Clock::time_point first_frame = Clock::now());
+    [[nodiscard]] bool finished() const;
+    [[nodiscard]] std::optional<double> first_frame_msecs() const;
+
+    [[nodiscard]] std::vector<Phase> phases() const; // in order of their begin
+    // one line per phase, e.g., for the log
+    [[nodiscard]] std::string report() const;
+    [[nodiscard]] std::string to_chrome_trace_json() const;
+
+private:
+    const Clock::time_point m_epoch = Clock::now();
+    TraceRecorder m_recorder { 256 };
+    mutable std::mutex m_mutex;
+    std::optional<Clock::time_point> m_first_frame;
+    std::atomic<bool> m_finished = false; // finish is called every frame, this is the quick check
+};
+
+/// Records the lifetime of the scope as a startup phase, and into the TraceRecorder (if enabled). name must outlive the scope.
+class StartupScope {
+public:
+    explicit StartupScope(const char* name, StartupTimeline& timeline = StartupTimeline::instance())
+        : m_timeline(timeline)
+        , m_name(name)
+    {
+    }
+    ~StartupScope()
+    {
+        const auto end = StartupTimeline::Clock::now();
+        m_timeline.record(m_name, m_begin, end);
+        TraceRecorder::instance().record(m_name, "startup", m_begin, end);
+    }
+    StartupScope(const StartupScope&) = delete;
+    StartupScope& operator=(const StartupScope&) = delete;
+
+private:
+    StartupTimeline& m_timeline;
+    const char* m_name;
+    StartupTimeline::Clock::time_point m_begin = StartupTimeline::Clock::now();
+};
+
+/// Runs an independent step of the startup concurrently, recorded as a phase. Its result is waited for with get(). On webassembly
+/// without threading, the step runs when the result is needed.
+template <typename Function>
+auto startup_async(const char* name, Function function)
+{
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING)
+    constexpr auto policy = std::launch::deferred;
+#else
+    constexpr auto policy = std::launch::async;
+#endif
+    return std::async(policy, [name, function = std::move(function)]() mutable {
+        const StartupScope scope(name);
+        return function();
+    });
+}
+
+} // namespace nucleus::timing
@@ -39,6 +39,8 @@ void TimerInterface::stop() {
 
 bool TimerInterface::fetch_result() {
     if (m_state == TimerStates::STOPPED) {
+        if (!_result_available())
+            return false;
         float val = _fetch_result();
         this->m_last_measurement = val;
         m_state = TimerStates::READY;
@@ -63,6 +63,8 @@ protected:
     virtual void _start() = 0;
     virtual void _stop() = 0;
     virtual float _fetch_result() = 0;
+    // asynchronous timers return false while the result of the last measurement is still in flight, fetching is retried later
+    virtual bool _result_available() { return true; }
 
 private:
 
@@ -38,6 +38,17 @@ void TimerManager::warn_about_timer(const std::string& name) {
 }
 #endif
 
+TimerHandle TimerManager::handle(const std::string& name)
+{
+    const auto it = m_timer.find(name);
+    if (it != m_timer.end())
+        return TimerHandle(it->second.get());
+#ifdef QT_DEBUG
+    warn_about_timer(name);
+#endif
+    return {};
+}
+
 void TimerManager::start_timer(const std::string &name)
 {
     auto it = m_timer.find(name);
@@ -56,15 +67,16 @@ void TimerManager::stop_timer(const std::string &name)
 #endif
 }
 
-QList<TimerReport> TimerManager::fetch_results()
+const std::vector<TimerReport>& TimerManager::fetch_results()
 {
-    QList<TimerReport> new_values;
-    for (const auto& tmr : m_timer_in_order) {
+    m_reports.clear();
+    for (unsigned i = 0; i < m_timer_in_order.size(); ++i) {
+        const auto& tmr = m_timer_in_order[i];
         if (tmr->fetch_result()) {
-            new_values.push_back({ tmr->get_last_measurement(), tmr });
+            m_reports.push_back({ tmr->get_last_measurement(), tmr.get(), i });
         }
     }
-    return new_values;
+    return m_reports;
 }
 
 std::shared_ptr<TimerInterface> TimerManager::add_timer(std::shared_ptr<TimerInterface> tmr) {
@@ -38,11 +38,37 @@ namespace nucleus::timing {
 struct TimerReport {
     // value inside timer could be different by now, thats why we send a copy of the value
     float value;
-    // Note: Somehow I need the timer definition in the front-end, like name, group, queue_size.
-    // I don't want to send all of those values every time, so I'll just send it as shared pointer.
-    // Might not be as fast as sending just a pointer, but otherwise it's possible to have a
-    // memory issue at deconstruction time of the app.
-    std::shared_ptr<TimerInterface> timer;
+    // owned by the TimerManager, valid as long as it. index is the position in TimerManager::timers().
+    const TimerInterface* timer;
+    unsigned index;
+};
+
+// a timer resolved once by name (TimerManager::handle), for the frame path: no string building and no map lookups.
+// empty if there is no such timer (e.g. gpu timers on gles), starting and stopping does nothing then.
+class TimerHandle {
+public:
+    TimerHandle() = default;
+    explicit TimerHandle(TimerInterface* timer) : m_timer(timer) {}
+
+    void start() const { if (m_timer) m_timer->start(); }
+    void stop() const { if (m_timer) m_timer->stop(); }
+    [[nodiscard]] bool valid() const { return m_timer != nullptr; }
+    [[nodiscard]] const TimerInterface* timer() const { return m_timer; }
+
+private:
+    TimerInterface* m_timer = nullptr; // owned by the TimerManager
+};
+
+// starts the timer on construction and stops it at the end of the scope
+class ScopedTimer {
+public:
+    explicit ScopedTimer(TimerHandle handle) : m_handle(handle) { m_handle.start(); }
+    ~ScopedTimer() { m_handle.stop(); }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    TimerHandle m_handle;
 };
 
 class TimerManager
@@ -52,14 +78,20 @@ public:
     // adds the given timer
     std::shared_ptr<TimerInterface> add_timer(std::shared_ptr<TimerInterface> tmr);
 
-    // Start timer with given name
+    // Returns a handle for the timer with the given name (setup only, the handle is valid as long as the manager)
+    TimerHandle handle(const std::string& name);
+
+    // Start timer with given name (prefer handles on hot paths)
     void start_timer(const std::string &name);
 
     // Stops the currently running timer
     void stop_timer(const std::string &name);
 
-    // Fetches the results of all timers and returns the new values
-    QList<TimerReport> fetch_results();
+    // Fetches the results of all timers and returns the new values (valid until the next call, the storage is reused)
+    const std::vector<TimerReport>& fetch_results();
+
+    // in the order of adding
+    [[nodiscard]] const std::vector<std::shared_ptr<TimerInterface>>& timers() const { return m_timer_in_order; }
 
     TimerManager();
 
@@ -74,6 +106,7 @@ private:
     std::vector<std::shared_ptr<TimerInterface>> m_timer_in_order;
     // Contains the timer as map for fast access by name
     std::map<std::string, std::shared_ptr<TimerInterface>> m_timer;
+    std::vector<TimerReport> m_reports;
 
 #ifdef QT_DEBUG
     // Contains the timer name if a warning for this timer was already published
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <QFile>
+#include <QThread>
+#include <fmt/format.h>
+
+namespace nucleus::timing {
+
+namespace {
+    std::string escaped(std::string_view text)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (const auto c : text) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if (static_cast<unsigned char>(c) < 0x20)
+                continue;
+            out += c;
+        }
+        return out;
+    }
+} // namespace
+
+TraceRecorder::TraceRecorder(size_t capacity)
+    : m_capacity(std::max(capacity, size_t(1)))
+    , m_threads({ "gpu" })
+{
+}
+
+TraceRecorder& TraceRecorder::instance()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+void TraceRecorder::set_enabled(bool enabled) { m_enabled = enabled; }
+
+void TraceRecorder::set_capacity(size_t capacity)
+{
+    std::scoped_lock lock(m_mutex);
+    m_capacity = std::max(capacity, size_t(1));
+    m_events.clear();
+    m_next = 0;
+}
+
+size_t TraceRecorder::capacity() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_capacity;
+}
+
+void TraceRecorder::record(std::string_view name, std::string_view category, Clock::time_point begin, Clock::time_point end, Track track)
+{
+    if (!enabled())
+        return;
+    std::scoped_lock lock(m_mutex);
+    Event event;
+    event.name = intern(name);
+    event.category = intern(category);
+    event.thread = track == Track::Gpu ? 0 : current_thread();
+    event.begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - m_epoch).count();
+    event.duration_ns = std::max(int64_t(0), int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+    push(event);
+}
+
+void TraceRecorder::record_counter(std::string_view name, std::string_view category, double value, Clock::time_point time)
+{
+    if (!enabled())
+        return;
+    std::scoped_lock lock(m_mutex);
+    Event event;
+    event.name = intern(name);
+    event.category = intern(category);
+    event.thread = current_thread();
+    event.begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_epoch).count();
+    event.duration_ns = -1;
+    event.value = value;
+    push(event);
+}
+
+void TraceRecorder::push(const Event& event)
+{
+    if (m_events.size() < m_capacity) {
+        m_events.push_back(event);
+        return;
+    }
+    m_events[m_next] = event;
+    m_next = (m_next + 1) % m_capacity;
+}
+
+uint32_t TraceRecorder::intern(std::string_view name)
+{
+    // names are short, the key copy stays in the small string buffer
+    const auto [it, inserted] = m_name_index.try_emplace(std::string(name), uint32_t(m_names.size()));
+    if (inserted)
+        m_names.emplace_back(name);
+    return it->second;
+}
+
+uint32_t TraceRecorder::current_thread()
+{
+    const auto* thread = QThread::currentThread();
+    const auto [it, inserted] = m_thread_index.try_emplace(thread, uint32_t(m_threads.size()));
+    if (inserted) {
+        const auto name = thread ? thread->objectName().toStdString() : std::string();
+        m_threads.push_back(name.empty() ? fmt::format("thread {}", it->second) : name);
+    }
+    return it->second;
+}
+
+std::vector<TraceRecorder::Event> TraceRecorder::events() const
+{
+    std::scoped_lock lock(m_mutex);
+    std::vector<Event> events;
+    events.reserve(m_events.size());
+    events.insert(events.end(), m_events.begin() + ptrdiff_t(m_next), m_events.end());
+    events.insert(events.end(), m_events.begin(), m_events.begin() + ptrdiff_t(m_next));
+    return events;
+}
+
+std::vector<std::string> TraceRecorder::names() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_names;
+}
+
+std::vector<std::string> TraceRecorder::threads() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_threads;
+}
+
+void TraceRecorder::clear()
+{
+    std::scoped_lock lock(m_mutex);
+    m_events.clear();
+    m_next = 0;
+}
+
+std::string TraceRecorder::to_chrome_trace_json() const { return to_chrome_trace_json(Clock::time_point::min(), Clock::time_point::max()); }
+
+std::string TraceRecorder::to_chrome_trace_json(Clock::time_point from, Clock::time_point to) const
+{
+    const auto since_epoch = [this](Clock::time_point t) {
+        if (t == Clock::time_point::min())
+            return std::numeric_limits<int64_t>::min();
+        if (t == Clock::time_point::max())
+            return std::numeric_limits<int64_t>::max();
+        return int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t - m_epoch).count());
+    };
+    const auto from_ns = since_epoch(from);
+    const auto to_ns = since_epoch(to);
+    auto events = this->events();
+    std::erase_if(events, [&](const Event& e) { return e.begin_ns + std::max(e.duration_ns, int64_t(0)) < from_ns || e.begin_ns > to_ns; });
+    const auto names = this->names();
+    const auto threads = this->threads();
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    const auto separator = [&first]() {
+        const auto s = first ? "\n" : ",\n";
+        first = false;
+        return s;
+    };
+    for (size_t i = 0; i < threads.size(); ++i)
+        json += fmt::format(R"({}{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", separator(), i, escaped(threads[i]));
+    for (const auto& e : events) {
+        // timestamps are in microseconds
+        if (e.duration_ns < 0) {
+            json += fmt::format(R"({}{{"name":"{}","cat":"{}","ph":"C","pid":1,"tid":{},"ts":{:.3f},"args":{{"value":{}}}}})",
+                separator(),
+                escaped(names[e.name]),
+                escaped(names[e.category]),
+                e.thread,
+                double(e.begin_ns) / 1000.0,
+                e.value);
+            continue;
+        }
+        json += fmt::format(R"({}{{"name":"{}","cat":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+            separator(),
+            escaped(names[e.name]),
+            escaped(names[e.category]),
+            e.thread,
+            double(e.begin_ns) / 1000.0,
+            double(e.duration_ns) / 1000.0);
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+tl::expected<void, std::string> TraceRecorder::write_chrome_trace(const std::filesystem::path& path) const
+{
+    return write_chrome_trace(path, Clock::time_point::min(), Clock::time_point::max());
+}
+
+tl::expected<void, std::string> TraceRecorder::write_chrome_trace(const std::filesystem::path& path, Clock::time_point from, Clock::time_point to) const
+{
+    const auto json = to_chrome_trace_json(from, to);
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+    QFile file(path);
+    if (!file.open(QIODeviceBase::WriteOnly))
+        return tl::unexpected<std::string>(fmt::format("Couldn't open file '{}' for writing!", path.string()));
+    file.write(json.data(), qint64(json.size()));
+    return {};
+}
+
+} // namespace nucleus::timing
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+namespace nucleus::timing {
+
+/// Timeline of named scopes for profiling, in contrast to the rolling averages of the TimerManager. The CPU timers, the GPU
+/// timers (aligned to the CPU clock) and TraceScopes record into it. Recording is off by default and toggled at runtime; while
+/// on, the events go into a bounded ring buffer, where the oldest ones are overwritten.
+/// Counters (e.g., upload bytes per frame) are recorded as values at a point in time, they are shown as graphs.
+/// The export is chrome trace json, which chrome://tracing and ui.perfetto.dev open. Thread safe.
+class TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+    enum class Track { CurrentThread, Gpu };
+    struct Event {
+        uint32_t name = 0; // index into names()
+        uint32_t category = 0; // also an index into names()
+        uint32_t thread = 0; // index into threads()
+        int64_t begin_ns = 0; // since the construction of the recorder
+        int64_t duration_ns = 0; // -1 for counters
+        double value = 0; // of counters
+    };
+
+    explicit TraceRecorder(size_t capacity = 1 << 16);
+    static TraceRecorder& instance();
+
+    void set_enabled(bool enabled);
+    [[nodiscard]] bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    // drops the recorded events
+    void set_capacity(size_t capacity);
+    [[nodiscard]] size_t capacity() const;
+
+    void record(std::string_view name, std::string_view category, Clock::time_point begin, Clock::time_point end, Track track = Track::CurrentThread);
+    void record_counter(std::string_view name, std::string_view category, double value, Clock::time_point time = Clock::now());
+
+    [[nodiscard]] std::vector<Event> events() const; // oldest first
+    [[nodiscard]] std::vector<std::string> names() const;
+    [[nodiscard]] std::vector<std::string> threads() const;
+    void clear();
+
+    [[nodiscard]] std::string to_chrome_trace_json() const;
+    [[nodiscard]] tl::expected<void, std::string> write_chrome_trace(const std::filesystem::path& path) const;
+    // only the events that overlap [from, to], e.g., around a frame spike (see SpikeDetector)
+    [[nodiscard]] std::string to_chrome_trace_json(Clock::time_point from, Clock::time_point to) const;
+    [[nodiscard]] tl::expected<void, std::string> write_chrome_trace(const std::filesystem::path& path, Clock::time_point from, Clock::time_point to) const;
+
+private:
+    void push(const Event& event);
+    uint32_t intern(std::string_view name);
+    uint32_t current_thread();
+
+    const Clock::time_point m_epoch = Clock::now();
+    std::atomic<bool> m_enabled = false;
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_events; // ring buffer
+    size_t m_capacity;
+    size_t m_next = 0;
+    std::vector<std::string> m_names;
+    std::unordered_map<std::string, uint32_t> m_name_index;
+    std::vector<std::string> m_threads; // 0 is the gpu
+    std::unordered_map<const void*, uint32_t> m_thread_index; // by QThread
+};
+
+/// Records the lifetime of the scope, if the recorder is enabled. name and category must outlive the scope (use literals).
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category, TraceRecorder& recorder = TraceRecorder::instance())
+        : m_recorder(recorder)
+        , m_name(name)
+        , m_category(category)
+    {
+        if (m_recorder.enabled())
+            m_begin = TraceRecorder::Clock::now();
+    }
+    ~TraceScope()
+    {
+        if (m_begin != TraceRecorder::Clock::time_point {})
+            m_recorder.record(m_name, m_category, m_begin, TraceRecorder::Clock::now());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceRecorder& m_recorder;
+    const char* m_name;
+    const char* m_category;
+    TraceRecorder::Clock::time_point m_begin = {};
+};
+
+} // namespace nucleus::timing
@@ -0,0 +1,117 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nucleus::utils {
+
+/// Recycles the storage of decoded tile buffers (see ColourTexture and Raster). They are allocated on the decoding thread and
+/// freed after the upload on the render thread, a few hundred per second in only a handful of sizes, which churns and fragments
+/// the heap (notably with the android allocator). Buffers are kept per size class (the exact capacity), up to a byte limit.
+/// Thread safe.
+template <typename T, typename Allocator = std::allocator<T>>
+class BufferPool {
+public:
+    using Buffer = std::vector<T, Allocator>;
+
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<size_t, std::vector<Buffer>> m_free; // capacity -> buffers
+    size_t m_n_bytes = 0;
+    size_t m_byte_limit = size_t(16) << 20;
+
+public:
+    /// never destroyed, buffers can be given back during static destruction
+    static BufferPool& instance()
+    {
+        static auto* pool = new BufferPool();
+        return *pool;
+    }
+
+    /// a buffer of n_elements, set to value. reuses a buffer of that capacity if one is free.
+    [[nodiscard]] Buffer take(size_t n_elements, const T& value)
+    {
+        auto buffer = take_uninitialised(n_elements);
+        std::fill(buffer.begin(), buffer.end(), value);
+        return buffer;
+    }
+
+    /// same, but the contents are whatever the last user left there, or as the allocator constructs them if the buffer is new
+    /// (for buffers that are written completely anyway)
+    [[nodiscard]] Buffer take_uninitialised(size_t n_elements)
+    {
+        Buffer buffer;
+        {
+            std::scoped_lock lock(m_mutex);
+            const auto found = m_free.find(n_elements);
+            if (found != m_free.end() && !found->second.empty()) {
+                buffer = std::move(found->second.back());
+                found->second.pop_back();
+                m_n_bytes -= n_elements * sizeof(T);
+            }
+        }
+        buffer.resize(n_elements); // no allocation if recycled
+        return buffer;
+    }
+
+    /// keeps the storage for the next take of the same size, or frees it if the pool is full
+    void give_back(Buffer&& buffer)
+    {
+        const auto n_bytes = buffer.capacity() * sizeof(T);
+        if (n_bytes == 0 || n_bytes > m_byte_limit / 16) // large buffers are rare, they'd crowd out the tile sizes
+            return;
+        std::scoped_lock lock(m_mutex);
+        if (m_n_bytes + n_bytes > m_byte_limit)
+            return;
+        m_free[buffer.capacity()].push_back(std::move(buffer));
+        m_n_bytes += n_bytes;
+    }
+
+    void set_byte_limit(size_t n_bytes)
+    {
+        std::scoped_lock lock(m_mutex);
+        m_byte_limit = n_bytes;
+        if (m_n_bytes > m_byte_limit) {
+            m_free.clear();
+            m_n_bytes = 0;
+        }
+    }
+
+    [[nodiscard]] size_t n_bytes() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_n_bytes;
+    }
+
+    void clear()
+    {
+        std::scoped_lock lock(m_mutex);
+        m_free.clear();
+        m_n_bytes = 0;
+    }
+};
+
+} // namespace nucleus::utils
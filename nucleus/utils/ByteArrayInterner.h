@@ -0,0 +1,83 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+
+namespace nucleus::utils {
+
+/// Shares byte arrays with identical content (e.g. empty, not found or uniform ocean tiles), so that they are stored only once.
+/// Only weak references are kept, the interner doesn't extend the lifetime of the arrays. Thread safe.
+class ByteArrayInterner {
+    std::unordered_map<size_t, std::vector<std::weak_ptr<QByteArray>>> m_entries; // content hash -> arrays with that hash
+    std::mutex m_mutex;
+    size_t m_n_entries = 0;
+    size_t m_sweep_threshold = 1024;
+
+public:
+    /// returns a previously interned array with the same content, or registers and returns the given one
+    std::shared_ptr<QByteArray> intern(const std::shared_ptr<QByteArray>& data)
+    {
+        if (!data)
+            return data;
+        const auto hash = size_t(qHash(*data));
+        auto locker = std::scoped_lock(m_mutex);
+        auto& candidates = m_entries[hash];
+        for (const auto& candidate : candidates) {
+            auto existing = candidate.lock();
+            if (existing && (existing == data || *existing == *data))
+                return existing;
+        }
+        candidates.push_back(data);
+        if (++m_n_entries > m_sweep_threshold)
+            sweep();
+        return data;
+    }
+
+    /// number of arrays that are still alive
+    [[nodiscard]] size_t n_alive()
+    {
+        auto locker = std::scoped_lock(m_mutex);
+        sweep();
+        return m_n_entries;
+    }
+
+private:
+    // removes expired entries. amortised, the threshold doubles with the number of live entries.
+    void sweep()
+    {
+        m_n_entries = 0;
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            std::erase_if(it->second, [](const auto& entry) { return entry.expired(); });
+            m_n_entries += it->second.size();
+            it = it->second.empty() ? m_entries.erase(it) : std::next(it);
+        }
+        m_sweep_threshold = std::max<size_t>(1024, m_n_entries * 2);
+    }
+};
+
+} // namespace nucleus::utils
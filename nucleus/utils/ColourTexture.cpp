@@ -17,6 +17,8 @@
  *****************************************************************************/
 
 #include "ColourTexture.h"
+#include "BufferPool.h"
+#include "pixel_kernels.h"
 
 #include <array>
 #include <cstdint>
@@ -26,113 +28,174 @@
 
 
 namespace {
-std::vector<uint8_t> to_dxt1(const QImage& qimage)
+struct alignas(16) AlignedBlock {
+    std::array<uint8_t, 16> data;
+};
+static_assert(sizeof(AlignedBlock) == 16);
+
+// writes the pixels in r, g, b, a byte order (alpha is 255 for formats without alpha). returns false for unhandled formats.
+bool write_rgba(const QImage& qimage, uint8_t* out)
 {
-    if (qimage.format() != QImage::Format_RGBA8888 && qimage.format() != QImage::Format_RGBX8888) {
-        // format is ARGB32 most of the time. we could implement on-the-fly transformation in goofy::compressDXT1 if this is too slow.
-        return to_dxt1(qimage.convertedTo(QImage::Format_RGBX8888));
+    const auto width = qimage.width();
+    switch (qimage.format()) {
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBX8888:
+        for (int row = 0; row < qimage.height(); ++row)
+            std::copy(qimage.constScanLine(row), qimage.constScanLine(row) + width * 4, out + size_t(row) * size_t(width) * 4);
+        return true;
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB32:
+        // 0xAARRGGBB in native byte order, which is what most decoders produce (jpeg always)
+        for (int row = 0; row < qimage.height(); ++row) {
+            const auto* in = reinterpret_cast<const uint32_t*>(qimage.constScanLine(row));
+            nucleus::utils::pixel_kernels::argb32_to_rgba8(in, out + size_t(row) * size_t(width) * 4, size_t(width), qimage.format() == QImage::Format_RGB32);
+        }
+        return true;
+    default:
+        return false;
     }
-    assert(qimage.width() == qimage.height());
-    assert(qimage.width() % 16 == 0);
-    assert(qimage.bytesPerLine() * qimage.height() == qimage.width() * qimage.height() * 4);
-    assert(qimage.sizeInBytes() == qimage.width() * qimage.height() * 4);
-
-    struct alignas(16) AlignedBlock
-    {
-        std::array<uint8_t, 16> data;
-    };
-    static_assert(sizeof(AlignedBlock) == 16);
+}
 
-    const auto n_bytes_in = size_t(qimage.sizeInBytes());
-    const auto n_bytes_out = qimage.width() * qimage.height() / 2;
-    assert(n_bytes_in % sizeof(AlignedBlock) == 0);
+// rgbx pixels for the block compressors (16 byte aligned, no row padding). that's the image itself if possible, otherwise
+// they are written into a buffer of the thread, which is reused for the next tile (same size), i.e., no allocation.
+const uint8_t* aligned_rgbx(const QImage& qimage)
+{
+    const auto is_rgbx = qimage.format() == QImage::Format_RGBA8888 || qimage.format() == QImage::Format_RGBX8888;
+    if (is_rgbx && qimage.bytesPerLine() == qimage.width() * 4 && reinterpret_cast<uintptr_t>(qimage.constBits()) % alignof(AlignedBlock) == 0)
+        return qimage.constBits();
+
+    thread_local std::vector<AlignedBlock> buffer;
+    buffer.resize(size_t(qimage.width()) * size_t(qimage.height()) * 4 / sizeof(AlignedBlock));
+    auto* data_ptr = reinterpret_cast<uint8_t*>(buffer.data());
+    if (!write_rgba(qimage, data_ptr)) {
+        // rare formats (e.g. indexed png), converting costs an extra copy
+        const auto converted = qimage.convertedTo(QImage::Format_RGBX8888);
+        write_rgba(converted, data_ptr);
+    }
+    return data_ptr;
+}
 
-    auto aligned_in = std::vector<AlignedBlock>(n_bytes_in / sizeof(AlignedBlock));
-    auto data_ptr = reinterpret_cast<uchar*>(aligned_in.data());
-    std::copy(qimage.constBits(), qimage.constBits() + n_bytes_in, data_ptr);
+// the compressors write directly into the mip chain, out must hold ColourTexture::n_bytes_for the level
+void to_dxt1(const QImage& qimage, uint8_t* out)
+{
+    assert(qimage.width() == qimage.height());
+    assert(qimage.width() % 16 == 0);
 
-    std::vector<uint8_t> compressed(n_bytes_out);
-    const auto result = goofy::compressDXT1(compressed.data(), data_ptr, qimage.width(), qimage.height(), qimage.width() * 4);
+    const auto result = goofy::compressDXT1(out, aligned_rgbx(qimage), qimage.width(), qimage.height(), qimage.width() * 4);
     assert(result == 0);
     Q_UNUSED(result);
-
-    // std::copy(data_ptr, data_ptr + n_bytes, compressed.begin());
-
-    return compressed;
 }
 
-std::vector<uint8_t> to_etc1(const QImage& qimage)
+void to_etc1(const QImage& qimage, uint8_t* out)
 {
-    if (qimage.format() != QImage::Format_RGBA8888 && qimage.format() != QImage::Format_RGBX8888) {
-        // format is ARGB32 most of the time. we could implement on-the-fly transformation in goofy::compressDXT1 if this is too slow.
-        return to_etc1(qimage.convertedTo(QImage::Format_RGBX8888));
-    }
     assert(qimage.width() == qimage.height());
     assert(qimage.width() % 16 == 0);
-    assert(qimage.bytesPerLine() * qimage.height() == qimage.width() * qimage.height() * 4);
-    assert(qimage.sizeInBytes() == qimage.width() * qimage.height() * 4);
-
-    struct alignas(16) AlignedBlock
-    {
-        std::array<uint8_t, 16> data;
-    };
-    static_assert(sizeof(AlignedBlock) == 16);
 
-    const auto n_bytes_in = size_t(qimage.sizeInBytes());
-    const auto n_bytes_out = qimage.width() * qimage.height() / 2;
-    assert(n_bytes_in % sizeof(AlignedBlock) == 0);
-
-    auto aligned_in = std::vector<AlignedBlock>(n_bytes_in / sizeof(AlignedBlock));
-    auto data_ptr = reinterpret_cast<uchar*>(aligned_in.data());
-    std::copy(qimage.constBits(), qimage.constBits() + n_bytes_in, data_ptr);
-
-    std::vector<uint8_t> compressed(n_bytes_out);
-    const auto result = goofy::compressETC1(compressed.data(), data_ptr, qimage.width(), qimage.height(), qimage.width() * 4);
+    const auto result = goofy::compressETC1(out, aligned_rgbx(qimage), qimage.width(), qimage.height(), qimage.width() * 4);
     assert(result == 0);
     Q_UNUSED(result);
-
-    // std::copy(data_ptr, data_ptr + n_bytes, compressed.begin());
-
-    return compressed;
 }
 
-std::vector<uint8_t> to_uncompressed_rgba(const QImage& qimage)
+void to_uncompressed_rgba(const QImage& qimage, uint8_t* out)
 {
-    if (qimage.format() != QImage::Format_RGBA8888 && qimage.format() != QImage::Format_RGBX8888) {
-        // qimage.save("to_uncompressed_rgba1.png");
-        return to_uncompressed_rgba(qimage.convertedTo(QImage::Format_RGBA8888));
-    }
-    assert(qimage.sizeInBytes() == qimage.width() * qimage.height() * 4);
-    std::vector<uint8_t> data;
-    data.resize(size_t(qimage.sizeInBytes()));
-    auto* data_ptr = reinterpret_cast<uchar*>(data.data());
-    const auto* bits = qimage.constScanLine(0);
-    Q_UNUSED(bits);
-    std::copy(qimage.constBits(), qimage.constBits() + qimage.sizeInBytes(), data_ptr);
-    return data;
+    if (!write_rgba(qimage, out))
+        write_rgba(qimage.convertedTo(QImage::Format_RGBA8888), out);
 }
 
-std::vector<uint8_t> to_compressed(const QImage& image, nucleus::utils::ColourTexture::Format algorithm)
+void to_compressed(const QImage& image, nucleus::utils::ColourTexture::Format algorithm, uint8_t* out)
 {
     using Algorithm = nucleus::utils::ColourTexture::Format;
 
     switch (algorithm) {
     case Algorithm::DXT1:
-        return to_dxt1(image);
+        return to_dxt1(image, out);
     case Algorithm::ETC1:
-        return to_etc1(image);
+    case Algorithm::ETC2:
+        return to_etc1(image, out);
     case Algorithm::Uncompressed_RGBA:
-        return to_uncompressed_rgba(image);
+        return to_uncompressed_rgba(image, out);
     }
     assert(false);
-    return to_uncompressed_rgba(image);
+    to_uncompressed_rgba(image, out);
+}
+
+std::vector<uint8_t> to_compressed_mip_chain(const QImage& image, nucleus::utils::ColourTexture::Format algorithm, unsigned n_mip_levels)
+{
+    using nucleus::utils::ColourTexture;
+    const auto width = unsigned(image.width());
+    const auto height = unsigned(image.height());
+    auto data = nucleus::utils::BufferPool<uint8_t>::instance().take_uninitialised(ColourTexture::n_bytes_for(width, height, algorithm, n_mip_levels));
+    to_compressed(image, algorithm, data.data());
+    auto level = image;
+    for (unsigned i = 1; i < n_mip_levels; ++i) {
+        // downscaling by 2 with smooth transformation averages the 2x2 pixels (box filter)
+        level = level.scaled(std::max(1, level.width() / 2), std::max(1, level.height() / 2), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        to_compressed(level, algorithm, data.data() + ColourTexture::n_bytes_for(width, height, algorithm, i));
+    }
+    return data;
 }
 } // namespace
 
-nucleus::utils::ColourTexture::ColourTexture(const QImage& image, Format format)
-    : m_data(to_compressed(image, format))
+nucleus::utils::ColourTexture::ColourTexture(const QImage& image, Format format, unsigned n_mip_levels)
+    : m_data(to_compressed_mip_chain(image, format, n_mip_levels))
     , m_width(unsigned(image.width()))
     , m_height(unsigned(image.height()))
     , m_format(format)
+    , m_n_mip_levels(n_mip_levels)
+{
+    assert(n_mip_levels >= 1 && n_mip_levels <= max_mip_levels(m_width, m_height, format));
+}
+
+nucleus::utils::ColourTexture::ColourTexture(std::vector<uint8_t> data, unsigned width, unsigned height, Format format, unsigned n_mip_levels)
+    : m_data(std::move(data))
+    , m_width(width)
+    , m_height(height)
+    , m_format(format)
+    , m_n_mip_levels(n_mip_levels)
+{
+    assert(n_mip_levels >= 1);
+}
+
+nucleus::utils::ColourTexture& nucleus::utils::ColourTexture::operator=(ColourTexture&& other) noexcept
+{
+    if (this != &other) {
+        BufferPool<uint8_t>::instance().give_back(std::move(m_data));
+        m_data = std::move(other.m_data);
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_format = other.m_format;
+        m_n_mip_levels = other.m_n_mip_levels;
+    }
+    return *this;
+}
+
+nucleus::utils::ColourTexture::~ColourTexture() { BufferPool<uint8_t>::instance().give_back(std::move(m_data)); }
+
+const uint8_t* nucleus::utils::ColourTexture::mip_data(unsigned level) const
+{
+    assert(level < m_n_mip_levels);
+    return m_data.data() + n_bytes_for(m_width, m_height, m_format, level);
+}
+
+size_t nucleus::utils::ColourTexture::n_bytes_for(unsigned width, unsigned height, Format format)
+{
+    // rgba has 4 bytes per pixel, dxt1 and etc1 half a byte
+    return format == Format::Uncompressed_RGBA ? size_t(width) * height * 4 : size_t(width) * height / 2;
+}
+
+size_t nucleus::utils::ColourTexture::n_bytes_for(unsigned width, unsigned height, Format format, unsigned n_mip_levels)
+{
+    size_t n = 0;
+    for (unsigned i = 0; i < n_mip_levels; ++i)
+        n += n_bytes_for(std::max(1u, width >> i), std::max(1u, height >> i), format);
+    return n;
+}
+
+unsigned nucleus::utils::ColourTexture::max_mip_levels(unsigned width, unsigned height, Format format)
 {
+    const auto min_size = format == Format::Uncompressed_RGBA ? 1u : 16u;
+    unsigned n = 1;
+    while ((width >> n) >= min_size && (height >> n) >= min_size && ((width >> n) << n) == width && ((height >> n) << n) == height)
+        ++n;
+    return n;
 }
@@ -19,27 +19,51 @@
 #pragma once
 
 #include <QImage>
+#include <algorithm>
 #include <vector>
 
 namespace nucleus::utils {
 
 class ColourTexture {
 public:
-    enum class Format { Uncompressed_RGBA, DXT1, ETC1 };
+    // ETC2 is encoded with the ETC1 subset (valid ETC2 data, same size), but it is uploaded as GL_COMPRESSED_RGB8_ETC2
+    enum class Format { Uncompressed_RGBA, DXT1, ETC1, ETC2 };
 
 private:
-    std::vector<uint8_t> m_data;
+    std::vector<uint8_t> m_data; // all mip levels, finest first
     unsigned m_width = 0;
     unsigned m_height = 0;
     Format m_format = Format::Uncompressed_RGBA;
+    unsigned m_n_mip_levels = 1;
 
 public:
-    explicit ColourTexture(const QImage& image, Format format);
+    /// the mip levels are downsampled from the image and compressed one by one (can be expensive, call it on a worker thread)
+    explicit ColourTexture(const QImage& image, Format format, unsigned n_mip_levels = 1);
+    /// takes already compressed data, e.g. from the disk cache
+    ColourTexture(std::vector<uint8_t> data, unsigned width, unsigned height, Format format, unsigned n_mip_levels = 1);
+    ColourTexture(const ColourTexture&) = default;
+    ColourTexture(ColourTexture&&) noexcept = default;
+    ColourTexture& operator=(const ColourTexture&) = default;
+    ColourTexture& operator=(ColourTexture&& other) noexcept;
+    /// the data goes back to the BufferPool, for the next texture of the same size
+    ~ColourTexture();
     [[nodiscard]] const uint8_t* data() const { return m_data.data(); }
     [[nodiscard]] size_t n_bytes() const { return m_data.size(); }
     [[nodiscard]] unsigned width() const { return m_width; }
     [[nodiscard]] unsigned height() const { return m_height; }
     [[nodiscard]] Format format() const { return m_format; }
+    [[nodiscard]] unsigned n_mip_levels() const { return m_n_mip_levels; }
+    [[nodiscard]] const uint8_t* mip_data(unsigned level) const;
+    [[nodiscard]] size_t mip_n_bytes(unsigned level) const { return n_bytes_for(mip_width(level), mip_height(level), m_format); }
+    [[nodiscard]] unsigned mip_width(unsigned level) const { return std::max(1u, m_width >> level); }
+    [[nodiscard]] unsigned mip_height(unsigned level) const { return std::max(1u, m_height >> level); }
+
+    /// size of a single level
+    [[nodiscard]] static size_t n_bytes_for(unsigned width, unsigned height, Format format);
+    /// size of the mip chain
+    [[nodiscard]] static size_t n_bytes_for(unsigned width, unsigned height, Format format, unsigned n_mip_levels);
+    /// the block compressors need multiples of 16 pixels, so compressed chains stop at 16x16
+    [[nodiscard]] static unsigned max_mip_levels(unsigned width, unsigned height, Format format);
 };
 
 } // namespace nucleus::utils
@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+#include <QGuiApplication>
+#include <QTimer>
+
+using namespace nucleus::utils;
+
+FrameScheduler::FrameScheduler(QObject* parent)
+    : QObject { parent }
+    , m_timer(std::make_unique<QTimer>())
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer.get(), &QTimer::timeout, this, &FrameScheduler::emit_frame);
+    if (auto* app = qobject_cast<QGuiApplication*>(QCoreApplication::instance())) {
+        connect(app, &QGuiApplication::applicationStateChanged, this, [this](Qt::ApplicationState state) {
+            set_application_visible(state != Qt::ApplicationSuspended && state != Qt::ApplicationHidden);
+        });
+    }
+}
+
+FrameScheduler::~FrameScheduler() = default;
+
+void FrameScheduler::set_max_fps(PowerState state, unsigned fps)
+{
+    m_max_fps[unsigned(state)] = fps;
+    reschedule();
+}
+
+unsigned FrameScheduler::max_fps(PowerState state) const { return m_max_fps[unsigned(state)]; }
+
+void FrameScheduler::set_power_saving(bool power_saving)
+{
+    m_power_saving = power_saving;
+    reschedule();
+}
+
+FrameScheduler::PowerState FrameScheduler::power_state() const
+{
+    if (!m_application_visible)
+        return PowerState::Background;
+    return m_power_saving ? PowerState::PowerSaving : PowerState::Normal;
+}
+
+void FrameScheduler::set_continuous(bool continuous)
+{
+    m_continuous = continuous;
+    if (m_continuous)
+        request_frame();
+}
+
+bool FrameScheduler::frame_pending() const { return m_pending; }
+
+void FrameScheduler::request_frame()
+{
+    m_pending = true;
+    if (!m_timer->isActive())
+        reschedule();
+}
+
+void FrameScheduler::set_application_visible(bool visible)
+{
+    m_application_visible = visible;
+    reschedule();
+}
+
+void FrameScheduler::reschedule()
+{
+    m_timer->stop();
+    const auto fps = max_fps(power_state());
+    if (!m_pending || fps == 0)
+        return;
+    // a timeout of 0 still merges the requests of the current event loop iteration
+    const auto interval = qint64(1000 / fps);
+    const auto elapsed = m_since_last_frame.isValid() ? m_since_last_frame.elapsed() : interval;
+    m_timer->start(int(std::clamp(interval - elapsed, qint64(0), interval)));
+}
+
+void FrameScheduler::emit_frame()
+{
+    m_pending = false;
+    m_since_last_frame.start();
+    emit frame_requested();
+    if (m_continuous)
+        request_frame();
+}
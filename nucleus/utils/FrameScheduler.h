@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QObject>
+
+class QTimer;
+
+namespace nucleus::utils {
+
+/// Renders on demand. Frames are requested by whatever changed the image (camera, tile arrival, animation, settings), and
+/// frame_requested() is emitted once for all requests until the next frame is due. Requests within one event loop iteration
+/// are always merged. The frame rate is capped per power state:
+/// - Normal: the frame limit of the app
+/// - PowerSaving: set by the platform integration (e.g., on battery)
+/// - Background: the application is hidden or suspended, requests are kept until it is visible again
+class FrameScheduler : public QObject {
+    Q_OBJECT
+public:
+    enum class PowerState { Normal = 0, PowerSaving, Background };
+
+    explicit FrameScheduler(QObject* parent = nullptr);
+    ~FrameScheduler() override;
+
+    // 0 pauses rendering in that state
+    void set_max_fps(PowerState state, unsigned fps);
+    [[nodiscard]] unsigned max_fps(PowerState state) const;
+    void set_power_saving(bool power_saving);
+    [[nodiscard]] PowerState power_state() const;
+    // requests the next frame with every frame (still capped), e.g., for profiling
+    void set_continuous(bool continuous);
+    [[nodiscard]] bool frame_pending() const;
+
+public slots:
+    void request_frame();
+
+signals:
+    void frame_requested();
+
+private:
+    void set_application_visible(bool visible);
+    void reschedule();
+    void emit_frame();
+
+    std::array<unsigned, 3> m_max_fps = { 60, 30, 0 };
+    bool m_power_saving = false;
+    bool m_application_visible = true;
+    bool m_continuous = false;
+    bool m_pending = false;
+    QElapsedTimer m_since_last_frame;
+    std::unique_ptr<QTimer> m_timer;
+};
+
+} // namespace nucleus::utils
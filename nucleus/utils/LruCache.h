@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace nucleus::utils {
+
+/// Small least recently used cache. Not thread safe, guard it with a mutex if necessary.
+/// Optionally, entries carry a size (see insert), and the cache is limited to a number of bytes in addition to the capacity.
+template <typename Key, typename Value, typename Hasher = std::hash<Key>>
+class LruCache {
+    struct Entry {
+        Key first;
+        Value second;
+        uint64_t n_bytes = 0;
+    };
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hasher> m_index;
+    unsigned m_capacity;
+    uint64_t m_byte_limit = std::numeric_limits<uint64_t>::max();
+    uint64_t m_n_bytes = 0;
+
+    void evict_for(uint64_t n_bytes)
+    {
+        while (!m_entries.empty() && (m_entries.size() >= m_capacity || m_n_bytes + n_bytes > m_byte_limit)) {
+            m_n_bytes -= m_entries.back().n_bytes;
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+    }
+
+public:
+    explicit LruCache(unsigned capacity)
+        : m_capacity(capacity)
+    {
+        assert(capacity > 0);
+    }
+
+    /// returns the cached value, or creates it with the factory (evicting the least recently used entry if full)
+    template <typename Factory>
+    const Value& get_or_create(const Key& key, const Factory& factory)
+    {
+        const auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return it->second->second;
+        }
+        evict_for(0);
+        m_entries.push_front({ key, factory() });
+        m_index[key] = m_entries.begin();
+        return m_entries.front().second;
+    }
+
+    /// returns the cached value (and marks it as used), or nullptr. the pointer is valid until the next insertion.
+    const Value* find(const Key& key)
+    {
+        const auto it = m_index.find(key);
+        if (it == m_index.end())
+            return nullptr;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return &it->second->second;
+    }
+
+    /// inserts or overwrites, evicting least recently used entries until it fits. for values that are created outside of a lock.
+    /// an entry larger than the byte limit is not stored.
+    void insert(const Key& key, Value value, uint64_t n_bytes = 0)
+    {
+        erase(key);
+        if (n_bytes > m_byte_limit)
+            return;
+        evict_for(n_bytes);
+        m_entries.push_front({ key, std::move(value), n_bytes });
+        m_index[key] = m_entries.begin();
+        m_n_bytes += n_bytes;
+    }
+
+    void erase(const Key& key)
+    {
+        const auto it = m_index.find(key);
+        if (it == m_index.end())
+            return;
+        m_n_bytes -= it->second->n_bytes;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    [[nodiscard]] bool contains(const Key& key) const { return m_index.contains(key); }
+    [[nodiscard]] unsigned size() const { return unsigned(m_entries.size()); }
+    [[nodiscard]] unsigned capacity() const { return m_capacity; }
+    /// sum of the sizes given to insert
+    [[nodiscard]] uint64_t n_bytes() const { return m_n_bytes; }
+
+    void set_byte_limit(uint64_t byte_limit)
+    {
+        m_byte_limit = byte_limit;
+        while (!m_entries.empty() && m_n_bytes > m_byte_limit)
+            erase(m_entries.back().first);
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+        m_n_bytes = 0;
+    }
+};
+
+} // namespace nucleus::utils
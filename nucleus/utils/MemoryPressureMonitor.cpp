@@ -0,0 +1,92 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "MemoryPressureMonitor.h"
+
+#include <QFile>
+#include <QGuiApplication>
+#include <QTimer>
+
+using namespace nucleus::utils;
+
+namespace {
+constexpr auto psi_path = "/proc/pressure/memory";
+}
+
+MemoryPressureMonitor::MemoryPressureMonitor(QObject* parent)
+    : QObject { parent }
+{
+    if (auto* app = qobject_cast<QGuiApplication*>(QCoreApplication::instance())) {
+        connect(app, &QGuiApplication::applicationStateChanged, this, [this](Qt::ApplicationState state) {
+            const auto suspended = state == Qt::ApplicationSuspended || state == Qt::ApplicationHidden;
+            if (suspended == m_suspended)
+                return;
+            m_suspended = suspended;
+            emit suspended_changed(m_suspended);
+        });
+    }
+
+#if defined(__linux__) && !defined(__ANDROID__)
+    if (QFile::exists(psi_path)) {
+        m_psi_timer = std::make_unique<QTimer>(this);
+        m_psi_timer->setInterval(5000);
+        connect(m_psi_timer.get(), &QTimer::timeout, this, &MemoryPressureMonitor::poll_psi);
+        m_psi_timer->start();
+    }
+#endif
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor() = default;
+
+void MemoryPressureMonitor::set_psi_threshold(float new_psi_threshold) { m_psi_threshold = new_psi_threshold; }
+
+bool MemoryPressureMonitor::suspended() const { return m_suspended; }
+
+std::optional<float> MemoryPressureMonitor::parse_psi_some_avg10(const QByteArray& psi)
+{
+    // format: "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\nfull avg10=0.00 ..."
+    for (const auto& line : psi.split('\n')) {
+        if (!line.startsWith("some "))
+            continue;
+        for (const auto& field : line.split(' ')) {
+            if (!field.startsWith("avg10="))
+                continue;
+            bool ok = false;
+            const auto value = field.mid(6).toFloat(&ok);
+            if (ok)
+                return value;
+            return {};
+        }
+    }
+    return {};
+}
+
+void MemoryPressureMonitor::poll_psi()
+{
+    QFile file(psi_path);
+    if (!file.open(QIODeviceBase::ReadOnly))
+        return;
+    const auto avg10 = parse_psi_some_avg10(file.readAll());
+    if (!avg10)
+        return;
+    // only emit on the rising edge, the 10s average stays high for a while
+    const auto under_pressure = *avg10 > m_psi_threshold;
+    if (under_pressure && !m_under_pressure)
+        emit memory_pressure();
+    m_under_pressure = under_pressure;
+}
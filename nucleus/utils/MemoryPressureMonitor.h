@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include <QByteArray>
+#include <QObject>
+
+class QTimer;
+
+namespace nucleus::utils {
+
+/// Translates platform signals into memory_pressure() and suspended_changed().
+/// - application state (all platforms with a QGuiApplication): Suspended / Hidden count as suspended, which is what
+///   Android and iOS report when the app goes to the background.
+/// - Linux pressure stall information (/proc/pressure/memory), polled if available.
+class MemoryPressureMonitor : public QObject {
+    Q_OBJECT
+public:
+    explicit MemoryPressureMonitor(QObject* parent = nullptr);
+    ~MemoryPressureMonitor() override;
+
+    // "some avg10" percentage above which memory_pressure() is emitted
+    void set_psi_threshold(float new_psi_threshold);
+    [[nodiscard]] bool suspended() const;
+
+    // parses the "some avg10=x" value from the contents of /proc/pressure/memory
+    static std::optional<float> parse_psi_some_avg10(const QByteArray& psi);
+
+signals:
+    void memory_pressure();
+    void suspended_changed(bool suspended);
+
+private slots:
+    void poll_psi();
+
+private:
+    float m_psi_threshold = 10.f;
+    bool m_suspended = false;
+    bool m_under_pressure = false;
+    std::unique_ptr<QTimer> m_psi_timer;
+};
+
+} // namespace nucleus::utils
@@ -0,0 +1,171 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "MetricsRegistry.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <fmt/format.h>
+
+namespace nucleus::utils {
+
+namespace {
+    std::string number(double v)
+    {
+        if (std::isnan(v))
+            return "NaN";
+        if (std::isinf(v))
+            return v > 0 ? "+Inf" : "-Inf";
+        return fmt::format("{}", v);
+    }
+
+    std::string escaped(const std::string& s)
+    {
+        std::string r;
+        r.reserve(s.size());
+        for (const auto c : s) {
+            if (c == '\\' || c == '"')
+                r += '\\';
+            if (c == '\n') {
+                r += "\\n";
+                continue;
+            }
+            r += c;
+        }
+        return r;
+    }
+
+    std::string label_set(const MetricsRegistry::Labels& labels, const std::string& extra = {})
+    {
+        if (labels.empty() && extra.empty())
+            return {};
+        std::string r = "{";
+        for (const auto& [key, value] : labels) {
+            if (r.size() > 1)
+                r += ',';
+            r += key + "=\"" + escaped(value) + '"';
+        }
+        if (!extra.empty())
+            r += (r.size() > 1 ? "," : "") + extra;
+        return r + '}';
+    }
+
+    const char* type_name(MetricsRegistry::Type type)
+    {
+        switch (type) {
+        case MetricsRegistry::Type::Gauge:
+            return "gauge";
+        case MetricsRegistry::Type::Counter:
+            return "counter";
+        case MetricsRegistry::Type::Summary:
+            return "summary";
+        }
+        return "unknown";
+    }
+} // namespace
+
+void MetricsRegistry::describe(const std::string& name, Type type, const std::string& help)
+{
+    std::scoped_lock lock(m_mutex);
+    auto& family = m_families[name];
+    family.type = type;
+    family.help = help;
+}
+
+MetricsRegistry::Series* MetricsRegistry::series(const std::string& name, Type type, const Labels& labels)
+{
+    const auto it = m_families.find(name);
+    if (it == m_families.end() || it->second.type != type)
+        return nullptr;
+    return &it->second.series[labels];
+}
+
+void MetricsRegistry::set_gauge(const std::string& name, double value, const Labels& labels)
+{
+    std::scoped_lock lock(m_mutex);
+    if (auto* s = series(name, Type::Gauge, labels))
+        s->value = value;
+}
+
+void MetricsRegistry::set_counter(const std::string& name, double total, const Labels& labels)
+{
+    std::scoped_lock lock(m_mutex);
+    if (auto* s = series(name, Type::Counter, labels))
+        s->value = total;
+}
+
+void MetricsRegistry::add(const std::string& name, double increment, const Labels& labels)
+{
+    std::scoped_lock lock(m_mutex);
+    if (auto* s = series(name, Type::Counter, labels))
+        s->value += increment;
+}
+
+void MetricsRegistry::observe(const std::string& name, double value, const Labels& labels)
+{
+    std::scoped_lock lock(m_mutex);
+    auto* s = series(name, Type::Summary, labels);
+    if (!s)
+        return;
+    if (s->window.size() < n_summary_samples) {
+        s->window.push_back(value);
+    } else {
+        s->window[s->next] = value;
+        s->next = (s->next + 1) % n_summary_samples;
+    }
+    ++s->count;
+    s->sum += value;
+}
+
+std::string MetricsRegistry::render() const
+{
+    std::scoped_lock lock(m_mutex);
+    std::string r;
+    std::vector<double> sorted;
+    for (const auto& [name, family] : m_families) {
+        r += "# TYPE " + name + ' ' + type_name(family.type) + '\n';
+        if (!family.help.empty())
+            r += "# HELP " + name + ' ' + escaped(family.help) + '\n';
+        for (const auto& [labels, s] : family.series) {
+            switch (family.type) {
+            case Type::Gauge:
+                r += name + label_set(labels) + ' ' + number(s.value) + '\n';
+                break;
+            case Type::Counter:
+                r += name + "_total" + label_set(labels) + ' ' + number(s.value) + '\n';
+                break;
+            case Type::Summary:
+                sorted = s.window;
+                std::sort(sorted.begin(), sorted.end());
+                for (const auto q : quantiles) {
+                    if (sorted.empty())
+                        break;
+                    const auto index = std::min(sorted.size() - 1, size_t(q * double(sorted.size())));
+                    r += name + label_set(labels, "quantile=\"" + number(q) + '"') + ' ' + number(sorted[index]) + '\n';
+                }
+                r += name + "_count" + label_set(labels) + ' ' + std::to_string(s.count) + '\n';
+                r += name + "_sum" + label_set(labels) + ' ' + number(s.sum) + '\n';
+                break;
+            }
+        }
+    }
+    return r + "# EOF\n";
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nucleus::utils {
+
+/// Metrics for an OpenMetrics (Prometheus) scraper, see MetricsServer. Values are set from any thread, render() formats the
+/// current state in the text exposition format. Families are described once, samples of families that were not described are
+/// ignored. Counters are cumulative (set_counter takes the running total, add increments it). Summaries keep the last
+/// n_summary_samples observations for the quantiles, the count and sum cover all observations.
+class MetricsRegistry {
+public:
+    enum class Type { Gauge, Counter, Summary };
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+    static constexpr unsigned n_summary_samples = 1024;
+    static constexpr std::array<double, 3> quantiles = { 0.5, 0.9, 0.99 };
+
+    // name without the _total suffix of counters
+    void describe(const std::string& name, Type type, const std::string& help);
+    void set_gauge(const std::string& name, double value, const Labels& labels = {});
+    void set_counter(const std::string& name, double total, const Labels& labels = {});
+    void add(const std::string& name, double increment, const Labels& labels = {});
+    void observe(const std::string& name, double value, const Labels& labels = {});
+
+    [[nodiscard]] std::string render() const;
+
+private:
+    struct Series {
+        double value = 0; // gauge and counter
+        std::vector<double> window; // summary, ring buffer
+        size_t next = 0;
+        uint64_t count = 0;
+        double sum = 0;
+    };
+    struct Family {
+        Type type = Type::Gauge;
+        std::string help;
+        std::map<Labels, Series> series;
+    };
+    Series* series(const std::string& name, Type type, const Labels& labels);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family> m_families;
+};
+
+} // namespace nucleus::utils
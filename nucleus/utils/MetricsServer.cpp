@@ -0,0 +1,101 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "MetricsServer.h"
+
+#include <QDebug>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "MetricsRegistry.h"
+
+namespace nucleus::utils {
+
+namespace {
+    constexpr qint64 max_request_size = 8 * 1024;
+
+    QByteArray response(const QByteArray& status, const QByteArray& content_type, const QByteArray& body)
+    {
+        return "HTTP/1.1 " + status + "\r\nContent-Type: " + content_type + "\r\nContent-Length: " + QByteArray::number(body.size())
+            + "\r\nConnection: close\r\n\r\n" + body;
+    }
+} // namespace
+
+MetricsServer::MetricsServer(std::shared_ptr<const MetricsRegistry> registry, QObject* parent)
+    : QObject(parent)
+    , m_registry(std::move(registry))
+    , m_server(std::make_unique<QTcpServer>())
+{
+    connect(m_server.get(), &QTcpServer::newConnection, this, &MetricsServer::accept_connections);
+}
+
+MetricsServer::~MetricsServer() = default;
+
+bool MetricsServer::listen(quint16 port, const QHostAddress& address)
+{
+    if (!m_server->listen(address, port)) {
+        qWarning() << "metrics server could not listen on" << address << port << ":" << m_server->errorString();
+        return false;
+    }
+    qDebug() << "metrics are served on" << address << m_server->serverPort();
+    return true;
+}
+
+quint16 MetricsServer::port() const { return m_server->serverPort(); }
+
+QByteArray MetricsServer::response_to(const QByteArray& request, const MetricsRegistry& registry)
+{
+    if (!request.contains("\r\n\r\n"))
+        return {};
+    const auto request_line = request.left(request.indexOf("\r\n")).split(' ');
+    if (request_line.size() != 3 || (request_line[0] != "GET" && request_line[0] != "HEAD"))
+        return response("405 Method Not Allowed", "text/plain", "only GET is supported\n");
+    const auto path = request_line[1].left(request_line[1].indexOf('?'));
+    if (path != "/metrics")
+        return response("404 Not Found", "text/plain", "see /metrics\n");
+    const auto body = QByteArray::fromStdString(registry.render());
+    auto r = response("200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", body);
+    if (request_line[0] == "HEAD")
+        r.chop(body.size());
+    return r;
+}
+
+void MetricsServer::accept_connections()
+{
+    while (auto* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { read_request(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void MetricsServer::read_request(QTcpSocket* socket)
+{
+    // the request is small, it stays in the socket buffer until the header is complete
+    const auto request = socket->peek(max_request_size);
+    auto r = response_to(request, *m_registry);
+    if (r.isEmpty() && request.size() < max_request_size)
+        return;
+    if (r.isEmpty())
+        r = response("431 Request Header Fields Too Large", "text/plain", {});
+    socket->readAll();
+    socket->disconnect(this);
+    socket->write(r);
+    socket->disconnectFromHost();
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QObject>
+
+class QTcpServer;
+class QTcpSocket;
+
+namespace nucleus::utils {
+class MetricsRegistry;
+
+/// Serves the metrics of a MetricsRegistry on GET /metrics (OpenMetrics text format), for scraping by Prometheus or a
+/// compatible agent. It is bound to localhost by default, every connection is answered once and closed. Not available on
+/// webassembly.
+class MetricsServer : public QObject {
+    Q_OBJECT
+public:
+    explicit MetricsServer(std::shared_ptr<const MetricsRegistry> registry, QObject* parent = nullptr);
+    ~MetricsServer() override;
+
+    bool listen(quint16 port, const QHostAddress& address = QHostAddress::LocalHost);
+    [[nodiscard]] quint16 port() const;
+
+    // complete http response to a request (header block), empty while the header is incomplete
+    static QByteArray response_to(const QByteArray& request, const MetricsRegistry& registry);
+
+private slots:
+    void accept_connections();
+
+private:
+    void read_request(QTcpSocket* socket);
+
+    std::shared_ptr<const MetricsRegistry> m_registry;
+    std::unique_ptr<QTcpServer> m_server;
+};
+
+} // namespace nucleus::utils
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "RenderScaleController.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace nucleus::utils {
+
+namespace {
+    constexpr float gpu_time_smoothing = 0.2f; // weight of a new measurement
+    constexpr float shrink_above_load = 1.05f;
+    constexpr float grow_below_load = 0.75f;
+    constexpr float grow_to_load = 0.85f; // the scale grows such that the expected load stays below the target
+} // namespace
+
+RenderScaleController::RenderScaleController(const Settings& settings)
+{
+    set_settings(settings);
+}
+
+const RenderScaleController::Settings& RenderScaleController::settings() const { return m_settings; }
+
+bool RenderScaleController::set_settings(const Settings& new_settings)
+{
+    assert(new_settings.min_scale > 0 && new_settings.min_scale <= new_settings.max_scale && new_settings.step > 0);
+    if (new_settings == m_settings)
+        return false;
+    m_settings = new_settings;
+    m_has_measurement = false;
+    m_hold = 0;
+    const auto previous_scale = m_scale;
+    m_scale = m_settings.enabled ? std::clamp(m_scale, m_settings.min_scale, m_settings.max_scale) : m_settings.max_scale;
+    return m_scale != previous_scale;
+}
+
+float RenderScaleController::scale() const { return m_scale; }
+
+float RenderScaleController::quantise(float scale) const
+{
+    scale = std::floor(scale / m_settings.step + 0.001f) * m_settings.step;
+    return std::clamp(scale, m_settings.min_scale, m_settings.max_scale);
+}
+
+bool RenderScaleController::update(float gpu_msecs)
+{
+    if (!m_settings.enabled || gpu_msecs <= 0)
+        return false;
+    if (m_hold > 0) {
+        --m_hold;
+        return false;
+    }
+    m_smoothed_gpu_msecs = m_has_measurement ? std::lerp(m_smoothed_gpu_msecs, gpu_msecs, gpu_time_smoothing) : gpu_msecs;
+    m_has_measurement = true;
+
+    const auto load = m_smoothed_gpu_msecs / m_settings.target_gpu_msecs;
+    auto new_scale = m_scale;
+    if (load > shrink_above_load)
+        new_scale = std::min(quantise(m_scale * std::sqrt(1.0f / load)), m_scale - m_settings.step); // at least one step
+    else if (load < grow_below_load)
+        new_scale = std::min(quantise(m_scale * std::sqrt(grow_to_load / load)), m_scale + m_settings.step); // at most one step
+    new_scale = std::clamp(new_scale, m_settings.min_scale, m_settings.max_scale);
+    if (std::abs(new_scale - m_scale) < m_settings.step * 0.5f)
+        return false;
+
+    // the time was measured at the old scale, the smoothed value is carried over to the expected one at the new scale
+    m_smoothed_gpu_msecs *= (new_scale * new_scale) / (m_scale * m_scale);
+    m_scale = new_scale;
+    m_hold = m_settings.hold_frames;
+    return true;
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+namespace nucleus::utils {
+
+/// Chooses the internal render resolution (as a factor of the window size) from the gpu frame time. The gpu cost of the
+/// full screen passes is roughly proportional to the number of pixels, so the scale follows sqrt(target / time). The scale is
+/// quantised and held for a few frames after every change (the targets are reallocated, and the timers lag behind), and it
+/// only grows again with clear headroom, so that it doesn't oscillate around the target.
+class RenderScaleController {
+public:
+    struct Settings {
+        bool enabled = false; // if disabled, scale() is max_scale
+        float min_scale = 0.5f;
+        float max_scale = 1.0f;
+        float target_gpu_msecs = 1000.0f / 60.0f;
+        float step = 0.05f; // quantisation of the scale
+        unsigned hold_frames = 10; // measurements that are ignored after a change
+        bool operator==(const Settings&) const = default;
+    };
+
+    RenderScaleController() = default;
+    explicit RenderScaleController(const Settings& settings);
+
+    [[nodiscard]] const Settings& settings() const;
+    /// returns true if scale() changed
+    bool set_settings(const Settings& new_settings);
+
+    /// feeds the gpu time of a frame, returns true if scale() changed
+    bool update(float gpu_msecs);
+    [[nodiscard]] float scale() const;
+
+private:
+    [[nodiscard]] float quantise(float scale) const;
+
+    Settings m_settings;
+    float m_scale = 1.0f;
+    float m_smoothed_gpu_msecs = 0.0f;
+    bool m_has_measurement = false;
+    unsigned m_hold = 0;
+};
+
+} // namespace nucleus::utils
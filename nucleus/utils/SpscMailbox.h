@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <utility>
+
+namespace nucleus::utils {
+
+/// Unbounded lock-free single producer, single consumer queue (a linked list with a stub node). The producer pushes and then
+/// calls wake_up(), the consumer drains with pop() whenever it gets to it. Items are moved in and out, never copied, and
+/// nothing is dropped, also if the consumer doesn't run for a while (e.g., the render thread while the window is hidden).
+/// push/wake_up must only be called from one thread at a time, pop from one (other) thread at a time.
+template <typename T>
+class SpscMailbox {
+    struct Node {
+        std::optional<T> value;
+        std::atomic<Node*> next = nullptr;
+    };
+    Node* m_head; // consumer side, the stub: its value was taken already
+    Node* m_tail; // producer side
+    std::function<void()> m_wake_up;
+    std::atomic<size_t> m_n_pushed = 0;
+    std::atomic<size_t> m_n_popped = 0;
+
+public:
+    SpscMailbox()
+        : m_head(new Node())
+        , m_tail(m_head)
+    {
+    }
+    ~SpscMailbox()
+    {
+        while (m_head) {
+            auto* next = m_head->next.load(std::memory_order_relaxed);
+            delete m_head;
+            m_head = next;
+        }
+    }
+    SpscMailbox(const SpscMailbox&) = delete;
+    SpscMailbox& operator=(const SpscMailbox&) = delete;
+
+    /// called by wake_up(), on the producer thread. set it before the producer starts.
+    void set_wake_up(std::function<void()> wake_up) { m_wake_up = std::move(wake_up); }
+
+    void push(T value)
+    {
+        auto* node = new Node();
+        node->value = std::move(value);
+        m_n_pushed.fetch_add(1, std::memory_order_relaxed); // before it can be popped, so that size() doesn't underflow
+        m_tail->next.store(node, std::memory_order_release);
+        m_tail = node;
+    }
+
+    void wake_up() const
+    {
+        if (m_wake_up)
+            m_wake_up();
+    }
+
+    [[nodiscard]] std::optional<T> pop()
+    {
+        auto* next = m_head->next.load(std::memory_order_acquire);
+        if (!next)
+            return {};
+        std::optional<T> value = std::move(next->value);
+        next->value.reset(); // next is the new stub
+        delete m_head;
+        m_head = next;
+        m_n_popped.fetch_add(1, std::memory_order_relaxed);
+        return value;
+    }
+
+    /// approximate if called while the other side is busy
+    [[nodiscard]] size_t size() const
+    {
+        const auto n_popped = m_n_popped.load(std::memory_order_relaxed);
+        return m_n_pushed.load(std::memory_order_relaxed) - n_popped;
+    }
+};
+
+} // namespace nucleus::utils
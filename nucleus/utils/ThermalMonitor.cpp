@@ -0,0 +1,133 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ThermalMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QTimer>
+
+#if defined(__ANDROID__)
+#include <QCoreApplication>
+#include <QJniObject>
+#elif defined(__APPLE__)
+#include <TargetConditionals.h>
+#endif
+
+#if defined(__APPLE__) && TARGET_OS_IOS
+namespace nucleus::utils::detail {
+int ios_thermal_state(); // ThermalMonitor_ios.mm
+}
+#endif
+
+using namespace nucleus::utils;
+
+namespace {
+constexpr int poll_msecs = 5000;
+#if defined(__ANDROID__)
+constexpr int headroom_forecast_seconds = 10;
+
+std::optional<ThermalMonitor::Level> read_level()
+{
+    const auto sdk = QNativeInterface::QAndroidApplication::sdkVersion();
+    if (sdk < 29)
+        return {};
+    const QJniObject context(QNativeInterface::QAndroidApplication::context());
+    const auto service_name = QJniObject::fromString("power");
+    const auto power_manager = context.callObjectMethod("getSystemService", "(Ljava/lang/String;)Ljava/lang/Object;", service_name.object<jstring>());
+    if (!power_manager.isValid())
+        return {};
+    const auto status = power_manager.callMethod<jint>("getCurrentThermalStatus");
+    auto headroom = std::nanf("");
+    if (sdk >= 30)
+        headroom = power_manager.callMethod<jfloat>("getThermalHeadroom", "(I)F", jint(headroom_forecast_seconds));
+    return ThermalMonitor::level_from_android(status, headroom);
+}
+#elif defined(__APPLE__) && TARGET_OS_IOS
+std::optional<ThermalMonitor::Level> read_level() { return ThermalMonitor::level_from_ios(nucleus::utils::detail::ios_thermal_state()); }
+#else
+std::optional<ThermalMonitor::Level> read_level() { return {}; }
+#endif
+} // namespace
+
+ThermalMonitor::ThermalMonitor(QObject* parent)
+    : QObject { parent }
+{
+    if (!read_level())
+        return;
+    m_timer = std::make_unique<QTimer>(this);
+    m_timer->setInterval(poll_msecs);
+    connect(m_timer.get(), &QTimer::timeout, this, &ThermalMonitor::poll);
+    m_timer->start();
+    poll();
+}
+
+ThermalMonitor::~ThermalMonitor() = default;
+
+bool ThermalMonitor::available() const { return m_timer != nullptr; }
+
+ThermalMonitor::Level ThermalMonitor::level() const { return m_level; }
+
+ThermalMonitor::Scaling ThermalMonitor::scaling(Level level)
+{
+    switch (level) {
+    case Level::Nominal:
+        return {};
+    case Level::Fair:
+        return { .frame_limit_factor = 0.75f, .error_factor = 1.25f, .max_ssao_kernel = 16, .min_ssao_resolution = 1 };
+    case Level::Serious:
+        return { .frame_limit_factor = 0.5f, .error_factor = 1.5f, .max_ssao_kernel = 8, .min_ssao_resolution = 2, .shadows = false };
+    case Level::Critical:
+        return { .frame_limit_factor = 0.5f, .error_factor = 2.0f, .max_ssao_kernel = 8, .min_ssao_resolution = 2, .ssao = false, .shadows = false };
+    }
+    return {};
+}
+
+ThermalMonitor::Level ThermalMonitor::level_from_android(int status, float headroom)
+{
+    // THERMAL_STATUS_NONE = 0, LIGHT, MODERATE, SEVERE, CRITICAL, EMERGENCY, SHUTDOWN = 6
+    auto level = Level::Nominal;
+    if (status >= 4)
+        level = Level::Critical;
+    else if (status == 3)
+        level = Level::Serious;
+    else if (status >= 1)
+        level = Level::Fair;
+    // the forecast headroom reaches 1 when severe throttling starts, reduce the load before
+    if (!std::isnan(headroom)) {
+        const auto forecast = headroom >= 1.0f ? Level::Serious : (headroom >= 0.85f ? Level::Fair : Level::Nominal);
+        level = std::max(level, forecast);
+    }
+    return level;
+}
+
+ThermalMonitor::Level ThermalMonitor::level_from_ios(int thermal_state)
+{
+    // NSProcessInfoThermalStateNominal = 0, Fair, Serious, Critical
+    return Level(std::clamp(thermal_state, 0, int(Level::Critical)));
+}
+
+void ThermalMonitor::poll()
+{
+    const auto level = read_level();
+    if (!level || *level == m_level)
+        return;
+    m_level = *level;
+    emit level_changed(m_level);
+}
@@ -0,0 +1,75 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include <QObject>
+
+class QTimer;
+
+namespace nucleus::utils {
+
+/// Polls the thermal status of the device and emits level_changed(), so that the quality can be reduced before the os
+/// throttles the cpu and gpu (the frame rate collapses unpredictably then).
+/// - Android: PowerManager.getCurrentThermalStatus (api 29), and the forecast of PowerManager.getThermalHeadroom (api 30,
+///   adpf), which rises before the status does.
+/// - iOS: NSProcessInfo.thermalState.
+/// Elsewhere the level stays Nominal and available() is false.
+class ThermalMonitor : public QObject {
+    Q_OBJECT
+public:
+    enum class Level { Nominal = 0, Fair, Serious, Critical };
+
+    // quality reductions per level, applied on top of the user settings (see scaling)
+    struct Scaling {
+        float frame_limit_factor = 1.0f;
+        float error_factor = 1.0f; // of the permissible screen space error
+        unsigned max_ssao_kernel = 64; // upper bound
+        unsigned min_ssao_resolution = 0; // lower bound for the level (see uboSharedConfig::m_ssao_resolution)
+        bool ssao = true;
+        bool shadows = true;
+        bool operator==(const Scaling&) const = default;
+    };
+
+    explicit ThermalMonitor(QObject* parent = nullptr);
+    ~ThermalMonitor() override;
+
+    [[nodiscard]] bool available() const;
+    [[nodiscard]] Level level() const;
+
+    [[nodiscard]] static Scaling scaling(Level level);
+    // status as PowerManager.THERMAL_STATUS_*, headroom as returned by getThermalHeadroom (1 is severe throttling, nan if unknown)
+    [[nodiscard]] static Level level_from_android(int status, float headroom);
+    // NSProcessInfoThermalState
+    [[nodiscard]] static Level level_from_ios(int thermal_state);
+
+signals:
+    void level_changed(nucleus::utils::ThermalMonitor::Level level);
+
+private slots:
+    void poll();
+
+private:
+    Level m_level = Level::Nominal;
+    std::unique_ptr<QTimer> m_timer;
+};
+
+} // namespace nucleus::utils
@@ -0,0 +1,174 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <array>
+
+#include <QFile>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace nucleus::utils {
+
+namespace {
+    constexpr std::array<std::pair<const char*, QThread::Priority>, 8> priority_names = { {
+        { "idle", QThread::IdlePriority },
+        { "lowest", QThread::LowestPriority },
+        { "low", QThread::LowPriority },
+        { "normal", QThread::NormalPriority },
+        { "high", QThread::HighPriority },
+        { "highest", QThread::HighestPriority },
+        { "time_critical", QThread::TimeCriticalPriority },
+        { "inherit", QThread::InheritPriority },
+    } };
+    constexpr std::array<std::pair<const char*, ThreadPolicy::Cores>, 3> cores_names = { {
+        { "any", ThreadPolicy::Cores::Any },
+        { "performance", ThreadPolicy::Cores::Performance },
+        { "efficiency", ThreadPolicy::Cores::Efficiency },
+    } };
+
+#if defined(__linux__)
+    // android's THREAD_PRIORITY_* are nice values as well (background 10, display -4, urgent display -8)
+    int nice_value(QThread::Priority priority)
+    {
+        switch (priority) {
+        case QThread::IdlePriority:
+            return 19;
+        case QThread::LowestPriority:
+            return 10;
+        case QThread::LowPriority:
+            return 5;
+        case QThread::HighPriority:
+            return -4;
+        case QThread::HighestPriority:
+            return -8;
+        case QThread::TimeCriticalPriority:
+            return -10;
+        default:
+            return 0;
+        }
+    }
+
+    const std::vector<uint64_t>& max_core_frequencies()
+    {
+        static const auto frequencies = []() {
+            std::vector<uint64_t> frequencies;
+            const auto n_cores = std::max(0L, sysconf(_SC_NPROCESSORS_CONF));
+            for (long core = 0; core < n_cores; ++core) {
+                QFile file(QString("/sys/devices/system/cpu/cpu%1/cpufreq/cpuinfo_max_freq").arg(core));
+                frequencies.push_back(file.open(QIODevice::ReadOnly) ? file.readAll().trimmed().toULongLong() : 0);
+            }
+            return frequencies;
+        }();
+        return frequencies;
+    }
+#endif
+} // namespace
+
+std::optional<ThreadPolicy> ThreadPolicy::from_string(const QString& string)
+{
+    ThreadPolicy policy;
+    for (const auto& part : string.split('/', Qt::SkipEmptyParts)) {
+        const auto name = part.trimmed().toLower().toStdString();
+        const auto priority = std::find_if(priority_names.begin(), priority_names.end(), [&](const auto& p) { return name == p.first; });
+        const auto cores = std::find_if(cores_names.begin(), cores_names.end(), [&](const auto& c) { return name == c.first; });
+        if (priority != priority_names.end())
+            policy.priority = priority->second;
+        else if (cores != cores_names.end())
+            policy.cores = cores->second;
+        else
+            return {};
+    }
+    return policy;
+}
+
+std::vector<unsigned> ThreadPolicy::select_cores(const std::vector<uint64_t>& max_frequencies, Cores cores)
+{
+    std::vector<unsigned> selected;
+    const auto [min, max] = std::minmax_element(max_frequencies.begin(), max_frequencies.end());
+    for (unsigned core = 0; core < max_frequencies.size(); ++core) {
+        if (cores == Cores::Any || *min == *max || (cores == Cores::Performance && max_frequencies[core] == *max)
+            || (cores == Cores::Efficiency && max_frequencies[core] == *min))
+            selected.push_back(core);
+    }
+    return selected;
+}
+
+bool ThreadPolicy::apply_to_current_thread() const
+{
+    thread_local std::optional<ThreadPolicy> applied;
+    if (applied == *this)
+        return true;
+    auto ok = true;
+#if defined(__linux__)
+    if (priority != QThread::InheritPriority)
+        ok &= setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), nice_value(priority)) == 0;
+    if (cores != Cores::Any || (applied && applied->cores != Cores::Any)) {
+        const auto& frequencies = max_core_frequencies();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (const auto core : select_cores(frequencies, cores)) {
+            if (core < CPU_SETSIZE)
+                CPU_SET(core, &set);
+        }
+        ok &= !frequencies.empty() && sched_setaffinity(0, sizeof(set), &set) == 0; // 0 is the calling thread
+    }
+#else
+    if (priority != QThread::InheritPriority)
+        QThread::currentThread()->setPriority(priority);
+    ok = cores == Cores::Any;
+#endif
+    applied = *this;
+    return ok;
+}
+
+std::optional<ThreadPolicies> ThreadPolicies::from_string(const QString& string)
+{
+    ThreadPolicies policies;
+    for (const auto& pair : string.split(',', Qt::SkipEmptyParts)) {
+        const auto role_policy = pair.split('=');
+        if (role_policy.size() != 2)
+            return {};
+        const auto policy = ThreadPolicy::from_string(role_policy[1]);
+        if (!policy)
+            return {};
+        const auto role = role_policy[0].trimmed();
+        if (role == "scheduler")
+            policies.scheduler = *policy;
+        else if (role == "network")
+            policies.network = *policy;
+        else if (role == "decode")
+            policies.decode = *policy;
+        else if (role == "io")
+            policies.io = *policy;
+        else if (role == "upload")
+            policies.upload = *policy;
+        else
+            return {};
+    }
+    return policies;
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <QString>
+#include <QThread>
+
+namespace nucleus::utils {
+
+/// Priority and core placement of a thread. The workers of the tile pipeline run below the render thread, so that decode
+/// bursts don't delay frames. On big.LITTLE socs (most phones), threads can be kept on (or off) the fast cores.
+/// - Linux and Android: the priority is the nice value of the thread (QThread::setPriority has no effect for normal threads
+///   there), the cores are set with sched_setaffinity. Raising the priority above normal may be denied on desktop linux.
+/// - Elsewhere: QThread::setPriority, the cores are not supported.
+struct ThreadPolicy {
+    enum class Cores : uint8_t {
+        Any = 0,
+        Performance, // the cores with the highest maximum frequency
+        Efficiency, // the ones with the lowest
+    };
+    QThread::Priority priority = QThread::InheritPriority; // inherit leaves the priority as is
+    Cores cores = Cores::Any;
+    bool operator==(const ThreadPolicy&) const = default;
+
+    // a priority, a core kind, or both separated by '/', e.g., "low", "efficiency", "lowest/efficiency". priorities: idle,
+    // lowest, low, normal, high, highest, time_critical, inherit. cores: any, performance, efficiency.
+    [[nodiscard]] static std::optional<ThreadPolicy> from_string(const QString& string);
+    // applies it to the calling thread, unless it already has it. returns false if (a part of) it couldn't be applied.
+    // also meant for the threads of a QThreadPool (which has no hook for its threads), at the start of each task.
+    bool apply_to_current_thread() const;
+
+    // the cores of a kind, by their maximum frequencies (index is the core). all of them if they are alike.
+    [[nodiscard]] static std::vector<unsigned> select_cores(const std::vector<uint64_t>& max_frequencies, Cores cores);
+};
+
+// the threads of the tile pipeline (see Controller::set_thread_policies)
+struct ThreadPolicies {
+    ThreadPolicy scheduler = { QThread::NormalPriority };
+    ThreadPolicy network = { QThread::NormalPriority };
+    ThreadPolicy decode = { QThread::LowPriority }; // all cores, for throughput
+    ThreadPolicy io = { QThread::LowestPriority, ThreadPolicy::Cores::Efficiency }; // disk cache
+    ThreadPolicy upload = { QThread::LowPriority }; // background uploads, see gl_engine::BackgroundUploader
+    bool operator==(const ThreadPolicies&) const = default;
+
+    // comma separated role=policy pairs, e.g. "decode=low,io=lowest/efficiency". the roles that are not given keep the defaults.
+    [[nodiscard]] static std::optional<ThreadPolicies> from_string(const QString& string);
+};
+
+} // namespace nucleus::utils
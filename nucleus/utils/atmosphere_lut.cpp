@@ -0,0 +1,135 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "atmosphere_lut.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace {
+using namespace nucleus::utils::atmosphere_lut;
+
+glm::dvec3 scattering_coefficients(const Parameters& p) { return glm::pow(400.0 / glm::dvec3(p.wavelengths), glm::dvec3(4.0)) * double(p.scattering_scale); }
+
+double density_at_height(const Parameters& p, double height) { return std::exp(-height * double(p.density_falloff)); }
+
+// closed form integral of the density along a ray (an_optical_depth in the shader)
+double optical_depth(const Parameters& p, double origin_height, double h_delta, double distance)
+{
+    const auto end_height = origin_height + h_delta * distance;
+    if (std::abs(h_delta) < 0.001)
+        return distance * 0.5 * (density_at_height(p, origin_height) + density_at_height(p, end_height));
+    return (density_at_height(p, origin_height) - density_at_height(p, end_height)) / (double(p.density_falloff) * h_delta);
+}
+
+// sun light scattered at distance s along the ray, attenuated on its way to the origin (before the scattering coefficients)
+glm::dvec3 scattered_light(const Parameters& p, const glm::dvec3& beta, double origin_height, double direction_z, double s)
+{
+    const auto height = origin_height + direction_z * s;
+    const auto sun_ray_optical_depth = optical_depth(p, height, 1.0, double(p.atmosphere_height) - height);
+    const auto view_ray_optical_depth = optical_depth(p, origin_height, direction_z, s);
+    return density_at_height(p, height) * glm::exp(-(sun_ray_optical_depth + view_ray_optical_depth) * beta);
+}
+
+// simpson's 1/3 rule, n_steps must be even
+glm::dvec3 simpson(const Parameters& p, const glm::dvec3& beta, double origin_height, double direction_z, double from, double to, unsigned n_steps)
+{
+    if (to <= from)
+        return glm::dvec3(0.0);
+    const auto step_size = (to - from) / double(n_steps);
+    auto sum = scattered_light(p, beta, origin_height, direction_z, from) + scattered_light(p, beta, origin_height, direction_z, to);
+    for (unsigned i = 1; i < n_steps; ++i)
+        sum += ((i & 1) ? 4.0 : 2.0) * scattered_light(p, beta, origin_height, direction_z, from + double(i) * step_size);
+    return sum * (step_size / 3.0);
+}
+
+double phase_function(double direction_z) { return 0.75 * (1.0 + direction_z * direction_z); }
+
+double square(double v) { return v * v; }
+
+// lut coordinates in [0, 1], the inverses are used for building it
+float height_coordinate(const Parameters& p, float height) { return std::sqrt(std::clamp(height / p.atmosphere_height, 0.f, 1.f)); }
+float direction_coordinate(float direction_z)
+{
+    const auto z = std::clamp(direction_z, -1.f, 1.f);
+    return 0.5f + 0.5f * std::copysign(std::sqrt(std::abs(z)), z);
+}
+float distance_coordinate(float distance) { return std::sqrt(std::clamp(distance / max_distance, 0.f, 1.f)); }
+
+// linear filtering with the texel centres at the borders (as with GL_CLAMP_TO_EDGE)
+glm::vec3 bilinear(const nucleus::Raster<glm::vec4>& layer, float u, float v)
+{
+    const auto x = u * float(layer.width() - 1);
+    const auto y = v * float(layer.height() - 1);
+    const auto x0 = std::min(unsigned(x), unsigned(layer.width() - 2));
+    const auto y0 = std::min(unsigned(y), unsigned(layer.height() - 2));
+    const auto fx = x - float(x0);
+    const auto fy = y - float(y0);
+    const auto top = glm::mix(layer.pixel({ x0, y0 }), layer.pixel({ x0 + 1, y0 }), fx);
+    const auto bottom = glm::mix(layer.pixel({ x0, y0 + 1 }), layer.pixel({ x0 + 1, y0 + 1 }), fx);
+    return glm::vec3(glm::mix(top, bottom, fy));
+}
+
+} // namespace
+
+namespace nucleus::utils::atmosphere_lut {
+
+Lut in_scattering(const Parameters& parameters)
+{
+    const auto beta = scattering_coefficients(parameters);
+    Lut lut(n_heights, Raster<glm::vec4>({ n_distances, n_directions }));
+    for (unsigned i = 0; i < n_heights; ++i) {
+        const auto origin_height = double(parameters.atmosphere_height) * square(double(i) / double(n_heights - 1));
+        for (unsigned j = 0; j < n_directions; ++j) {
+            const auto x = 2.0 * double(j) / double(n_directions - 1) - 1.0;
+            const auto direction_z = std::copysign(x * x, x);
+            // rays going down end in the terrain. the integral is stopped 1 km below sea level, where the density would explode.
+            const auto reachable = direction_z < 0 ? (origin_height + 1.0) / -direction_z : std::numeric_limits<double>::max();
+            auto integral = glm::dvec3(0.0);
+            auto previous_distance = 0.0;
+            for (unsigned k = 0; k < n_distances; ++k) {
+                const auto distance = std::min(double(max_distance) * square(double(k) / double(n_distances - 1)), reachable);
+                integral += simpson(parameters, beta, origin_height, direction_z, previous_distance, distance, 8);
+                previous_distance = distance;
+                lut[i].pixel({ k, j }) = glm::vec4(glm::vec3(integral * beta * phase_function(direction_z)), 1.f);
+            }
+        }
+    }
+    return lut;
+}
+
+glm::vec3 integrate_in_scattering(const Parameters& parameters, float height, float direction_z, float distance, unsigned n_steps)
+{
+    const auto beta = scattering_coefficients(parameters);
+    const auto integral = simpson(parameters, beta, double(height), double(direction_z), 0.0, double(distance), n_steps);
+    return glm::vec3(integral * beta * phase_function(double(direction_z)));
+}
+
+glm::vec3 sample(const Lut& lut, const Parameters& parameters, float height, float direction_z, float distance)
+{
+    assert(lut.size() == n_heights);
+    const auto u = distance_coordinate(distance);
+    const auto v = direction_coordinate(direction_z);
+    const auto layer = height_coordinate(parameters, height) * float(n_heights - 1);
+    const auto l0 = std::min(unsigned(layer), n_heights - 2);
+    return glm::mix(bilinear(lut[l0], u, v), bilinear(lut[l0 + 1], u, v), layer - float(l0));
+}
+
+} // namespace nucleus::utils::atmosphere_lut
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nucleus/Raster.h"
+
+namespace nucleus::utils::atmosphere_lut {
+
+/// parameters of the atmosphere model in atmosphere_implementation.glsl (heights and distances in km). the defaults must match
+/// the constants there.
+struct Parameters {
+    glm::vec3 wavelengths = { 700.f, 560.f, 440.f }; // nm
+    float scattering_scale = 0.04f;
+    float density_falloff = 0.13f; // 1/km
+    float atmosphere_height = 100.f;
+    bool operator==(const Parameters&) const = default;
+};
+
+/// the lut has one layer per camera height, the distance along x and the view direction (z component) along y.
+/// the coordinates are non-linear, with more resolution close to the ground, near the horizon and for short distances.
+constexpr unsigned n_heights = 32;
+constexpr unsigned n_directions = 64;
+constexpr unsigned n_distances = 64;
+constexpr float max_distance = 1000.f; // longer rays are clamped
+
+using Lut = std::vector<Raster<glm::vec4>>;
+
+/// light scattered into a ray of the given length (rgb, phase function and scattering coefficients applied), i.e.,
+/// calculate_atmospheric_light without the attenuated colour. the sun is at the zenith in this model. alpha is 1.
+Lut in_scattering(const Parameters& parameters);
+
+/// numerical integration along the ray (simpson), reference for the lut
+glm::vec3 integrate_in_scattering(const Parameters& parameters, float height, float direction_z, float distance, unsigned n_steps);
+
+/// interpolated lookup, the same way as compose.frag samples the texture
+glm::vec3 sample(const Lut& lut, const Parameters& parameters, float height, float direction_z, float distance);
+
+} // namespace nucleus::utils::atmosphere_lut
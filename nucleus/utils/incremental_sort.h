@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace nucleus::utils {
+
+/// Sorts a range that is nearly sorted already, e.g. the order of the last frame with a few new elements appended.
+/// Insertion sort, which is linear in the number of inversions. If more than max_shifts element moves would be necessary,
+/// it falls back to std::sort. Returns false in that case. Doesn't allocate.
+template <typename RandomAccessIterator, typename Less>
+bool sort_nearly_sorted(RandomAccessIterator first, RandomAccessIterator last, Less less, size_t max_shifts)
+{
+    size_t n_shifts = 0;
+    for (auto i = first; i != last; ++i) {
+        auto value = std::move(*i);
+        auto hole = i;
+        while (hole != first && less(value, *std::prev(hole))) {
+            if (++n_shifts > max_shifts) {
+                *hole = std::move(value);
+                std::sort(first, last, less);
+                return false;
+            }
+            *hole = std::move(*std::prev(hole));
+            --hole;
+        }
+        *hole = std::move(value);
+    }
+    return true;
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "jpeg_transcoder.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <GoofyTC/goofy_tc.h>
+
+#include "tile_conversion.h"
+
+#ifdef ALP_ENABLE_TURBOJPEG
+#include <csetjmp>
+#include <cstdio> // jpeglib.h uses FILE without including it
+#include <jpeglib.h>
+#endif
+
+namespace {
+using nucleus::utils::ColourTexture;
+
+// one mcu row with 4:2:0 subsampling, and a multiple of the 4 pixel blocks
+constexpr unsigned strip_height = 16;
+
+struct alignas(16) AlignedPixels {
+    std::array<uint8_t, 16> data;
+};
+
+// receives the rgbx rows strip by strip (top to bottom), compresses them into the first level and box filters them into the second
+class StripCompressor {
+    ColourTexture::Format m_format;
+    unsigned m_size;
+    std::vector<uint8_t> m_level_0;
+    QImage m_level_1;
+
+    static std::vector<AlignedPixels>& strip_buffer()
+    {
+        thread_local std::vector<AlignedPixels> buffer;
+        return buffer;
+    }
+
+public:
+    StripCompressor(ColourTexture::Format format, unsigned size, unsigned n_mip_levels)
+        : m_format(format)
+        , m_size(size)
+        , m_level_0(ColourTexture::n_bytes_for(size, size, format))
+    {
+        strip_buffer().resize(size_t(size) * strip_height * 4 / sizeof(AlignedPixels));
+        if (n_mip_levels > 1) {
+            m_level_1 = QImage(int(size / 2), int(size / 2), QImage::Format_RGBX8888);
+        }
+    }
+
+    // 16 byte aligned, row r of the current strip
+    [[nodiscard]] uint8_t* row(unsigned r) { return reinterpret_cast<uint8_t*>(strip_buffer().data()) + size_t(r) * m_size * 4; }
+
+    void compress_strip(unsigned strip)
+    {
+        const auto* pixels = row(0);
+        auto* out = m_level_0.data() + ColourTexture::n_bytes_for(m_size, strip_height, m_format) * strip;
+        const auto result = m_format == ColourTexture::Format::DXT1 ? goofy::compressDXT1(out, pixels, int(m_size), int(strip_height), int(m_size * 4))
+                                                                    : goofy::compressETC1(out, pixels, int(m_size), int(strip_height), int(m_size * 4));
+        assert(result == 0);
+        Q_UNUSED(result);
+
+        if (m_level_1.isNull())
+            return;
+        for (unsigned r = 0; r < strip_height / 2; ++r) {
+            const auto* top = row(r * 2);
+            const auto* bottom = row(r * 2 + 1);
+            auto* o = m_level_1.scanLine(int(strip * strip_height / 2 + r));
+            for (unsigned c = 0; c < m_size / 2; ++c) {
+                for (unsigned channel = 0; channel < 3; ++channel) {
+                    const auto sum = unsigned(top[c * 8 + channel]) + top[c * 8 + 4 + channel] + bottom[c * 8 + channel] + bottom[c * 8 + 4 + channel];
+                    o[c * 4 + channel] = uint8_t((sum + 2) / 4);
+                }
+                o[c * 4 + 3] = 255;
+            }
+        }
+    }
+
+    ColourTexture finish(unsigned n_mip_levels)
+    {
+        auto data = std::move(m_level_0);
+        if (n_mip_levels > 1) {
+            const auto coarser = ColourTexture(m_level_1, m_format, n_mip_levels - 1);
+            data.insert(data.end(), coarser.data(), coarser.data() + coarser.n_bytes());
+        }
+        return ColourTexture(std::move(data), m_size, m_size, m_format, n_mip_levels);
+    }
+};
+
+#ifdef ALP_ENABLE_TURBOJPEG
+struct ErrorManager {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+[[noreturn]] void error_exit(j_common_ptr info) { std::longjmp(reinterpret_cast<ErrorManager*>(info->err)->jump, 1); }
+void ignore_message(j_common_ptr) { }
+
+// everything that may longjmp. the frame of the setjmp (decode_strips) has no locals that are touched in here.
+bool decode_strips_unguarded(jpeg_decompress_struct* info, const QByteArray& jpeg, unsigned size, StripCompressor* compressor)
+{
+    jpeg_mem_src(info, reinterpret_cast<const unsigned char*>(jpeg.constData()), static_cast<unsigned long>(jpeg.size()));
+    if (jpeg_read_header(info, TRUE) != JPEG_HEADER_OK)
+        return false;
+    info->out_color_space = JCS_EXT_RGBX;
+    info->dct_method = JDCT_IFAST;
+    // libjpeg-turbo scales by n/8 in the idct, which is much cheaper than decoding the full size and downsampling
+    info->scale_num = 8;
+    info->scale_denom = 8;
+    for (unsigned num = 1; num < 8; ++num) {
+        if (info->image_width * num == size * 8 && info->image_height * num == size * 8)
+            info->scale_num = num;
+    }
+    jpeg_calc_output_dimensions(info);
+    if (info->output_width != size || info->output_height != size)
+        return false;
+
+    jpeg_start_decompress(info);
+    while (info->output_scanline < info->output_height) {
+        const auto row_in_strip = info->output_scanline % strip_height;
+        std::array<JSAMPROW, strip_height> rows = {};
+        for (unsigned i = row_in_strip; i < strip_height; ++i)
+            rows[i - row_in_strip] = compressor->row(i);
+        jpeg_read_scanlines(info, rows.data(), strip_height - row_in_strip);
+        if (info->output_scanline % strip_height == 0)
+            compressor->compress_strip(info->output_scanline / strip_height - 1);
+    }
+    jpeg_finish_decompress(info);
+    return true;
+}
+
+bool decode_strips(const QByteArray& jpeg, unsigned size, StripCompressor* compressor)
+{
+    jpeg_decompress_struct info = {};
+    ErrorManager error = {};
+    info.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = error_exit; // the default calls exit()
+    error.pub.output_message = ignore_message;
+    jpeg_create_decompress(&info);
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+    const auto success = decode_strips_unguarded(&info, jpeg, size, compressor);
+    jpeg_destroy_decompress(&info);
+    return success;
+}
+#endif
+
+// without libjpeg (or for webp / avif) the image is decoded as a whole, but it's still compressed from a strip of the thread (no full size copy)
+bool decode_strips_with_qimage(const QByteArray& jpeg, unsigned size, StripCompressor* compressor)
+{
+    thread_local QImage image;
+    nucleus::utils::tile_conversion::decode_ortho_into(jpeg, size, &image);
+    if (image.width() != int(size) || image.height() != int(size))
+        return false;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_RGBX8888
+        && image.format() != QImage::Format_RGBA8888)
+        image.convertTo(QImage::Format_RGBX8888);
+
+    const auto is_rgbx = image.format() == QImage::Format_RGBX8888 || image.format() == QImage::Format_RGBA8888;
+    for (unsigned strip = 0; strip < size / strip_height; ++strip) {
+        for (unsigned r = 0; r < strip_height; ++r) {
+            const auto* in = image.constScanLine(int(strip * strip_height + r));
+            auto* out = compressor->row(r);
+            if (is_rgbx) {
+                std::memcpy(out, in, size_t(size) * 4);
+                continue;
+            }
+            const auto* in_argb = reinterpret_cast<const uint32_t*>(in); // 0xAARRGGBB in native byte order
+            for (unsigned c = 0; c < size; ++c) {
+                out[c * 4 + 0] = uint8_t(in_argb[c] >> 16);
+                out[c * 4 + 1] = uint8_t(in_argb[c] >> 8);
+                out[c * 4 + 2] = uint8_t(in_argb[c]);
+                out[c * 4 + 3] = 255;
+            }
+        }
+        compressor->compress_strip(strip);
+    }
+    return true;
+}
+} // namespace
+
+namespace nucleus::utils::jpeg_transcoder {
+
+tl::expected<ColourTexture, std::string> to_colour_texture(const QByteArray& jpeg, ColourTexture::Format format, unsigned size, unsigned n_mip_levels)
+{
+    if (format == ColourTexture::Format::Uncompressed_RGBA)
+        return tl::unexpected("jpeg_transcoder: uncompressed textures don't need a transcoder");
+    if (size == 0 || size % 16 != 0)
+        return tl::unexpected("jpeg_transcoder: the size must be a multiple of 16");
+    if (n_mip_levels < 1 || n_mip_levels > ColourTexture::max_mip_levels(size, size, format))
+        return tl::unexpected("jpeg_transcoder: invalid number of mip levels");
+
+    StripCompressor compressor(format, size, n_mip_levels);
+#ifdef ALP_ENABLE_TURBOJPEG
+    // falls back for jpegs that libjpeg can't scale to the size (qt fails for those as well, unless it's a libjpeg error)
+    const auto is_jpeg = nucleus::utils::tile_conversion::image_format(jpeg) == nucleus::utils::tile_conversion::ImageFormat::Jpeg;
+    const auto success = (is_jpeg && decode_strips(jpeg, size, &compressor)) || decode_strips_with_qimage(jpeg, size, &compressor);
+#else
+    const auto success = decode_strips_with_qimage(jpeg, size, &compressor);
+#endif
+    if (!success)
+        return tl::unexpected("jpeg_transcoder: the data is not a jpeg of the requested size");
+    return compressor.finish(n_mip_levels);
+}
+
+} // namespace nucleus::utils::jpeg_transcoder
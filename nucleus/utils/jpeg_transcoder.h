@@ -0,0 +1,39 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <tl/expected.hpp>
+
+#include <string>
+
+#include "ColourTexture.h"
+
+/// Block streaming jpeg to DXT1 / ETC transcoder. The jpeg is decoded in strips of 16 rows (one MCU row for 4:2:0
+/// subsampling), and every strip is block compressed right away, so the rgba data of a tile is never in memory as a whole.
+/// The strips are also box filtered into the second mip level, the coarser levels are compressed from that.
+/// With ALP_ENABLE_TURBOJPEG the strips come from libjpeg(-turbo) scanline decoding (dct scaling to the requested size),
+/// otherwise the jpeg is decoded by QImage and only the compression is streamed. Other ortho formats (webp, avif) take the
+/// second path as well, decoded by tile_conversion::decode_ortho_into.
+namespace nucleus::utils::jpeg_transcoder {
+
+/// fails for uncompressed formats, undecodable data, and images that are not (and can't be dct scaled to) size x size
+[[nodiscard]] tl::expected<ColourTexture, std::string> to_colour_texture(const QByteArray& jpeg, ColourTexture::Format format, unsigned size, unsigned n_mip_levels = 1);
+
+} // namespace nucleus::utils::jpeg_transcoder
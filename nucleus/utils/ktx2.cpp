@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ktx2.h"
+
+#include <array>
+#include <cstring>
+
+#include <fmt/format.h>
+
+namespace {
+constexpr std::array<uint8_t, 12> identifier = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+constexpr size_t header_size = 12 + 9 * 4; // identifier, vkFormat .. supercompressionScheme
+constexpr size_t index_size = 4 * 4 + 2 * 8; // dfd, kvd (32 bit offset and length), sgd (64 bit)
+constexpr size_t level_index_entry_size = 3 * 8;
+
+// vk formats (https://registry.khronos.org/vulkan/specs/1.3/html/vkspec.html#VkFormat)
+constexpr uint32_t VK_FORMAT_R8G8B8A8_UNORM = 37;
+constexpr uint32_t VK_FORMAT_R8G8B8A8_SRGB = 43;
+constexpr uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+constexpr uint32_t VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132;
+constexpr uint32_t VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK = 147;
+constexpr uint32_t VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK = 148;
+
+// ktx2 is little endian
+uint64_t read_le(const QByteArray& data, size_t offset, size_t n_bytes)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < n_bytes; ++i)
+        v |= uint64_t(uint8_t(data[qsizetype(offset + i)])) << (8 * i);
+    return v;
+}
+} // namespace
+
+namespace nucleus::utils::ktx2 {
+
+bool is_ktx2(const QByteArray& data)
+{
+    return data.size() >= qsizetype(identifier.size()) && std::memcmp(data.constData(), identifier.data(), identifier.size()) == 0;
+}
+
+std::optional<ColourTexture::Format> to_colour_texture_format(uint32_t vk_format)
+{
+    switch (vk_format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return ColourTexture::Format::Uncompressed_RGBA;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return ColourTexture::Format::DXT1;
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return ColourTexture::Format::ETC2;
+    default:
+        return {};
+    }
+}
+
+tl::expected<ColourTexture, std::string> to_colour_texture(const QByteArray& data, unsigned max_mip_levels)
+{
+    if (!is_ktx2(data))
+        return tl::unexpected(std::string("ktx2: missing identifier"));
+    if (size_t(data.size()) < header_size + index_size)
+        return tl::unexpected(std::string("ktx2: truncated header"));
+
+    const auto u32 = [&](size_t offset) { return uint32_t(read_le(data, offset, 4)); };
+    const auto vk_format = u32(12);
+    const auto width = u32(20);
+    const auto height = u32(24);
+    const auto depth = u32(28);
+    const auto n_layers = u32(32);
+    const auto n_faces = u32(36);
+    const auto n_levels = std::max(1u, u32(40)); // 0 asks the loader to generate the mips
+    const auto supercompression = u32(44);
+
+    const auto format = to_colour_texture_format(vk_format);
+    if (!format)
+        return tl::unexpected(fmt::format("ktx2: unsupported vkFormat {} (basis universal needs a transcoder)", vk_format));
+    if (supercompression != 0)
+        return tl::unexpected(fmt::format("ktx2: unsupported supercompression scheme {}", supercompression));
+    if (depth > 1 || n_layers > 1 || n_faces != 1 || width == 0 || height == 0)
+        return tl::unexpected(std::string("ktx2: only single 2d images are supported"));
+    if (uint64_t(data.size()) < header_size + index_size + uint64_t(n_levels) * level_index_entry_size)
+        return tl::unexpected(std::string("ktx2: truncated level index"));
+
+    const auto n_mip_levels = std::min({ n_levels, max_mip_levels, ColourTexture::max_mip_levels(width, height, *format) });
+    std::vector<uint8_t> levels;
+    levels.reserve(ColourTexture::n_bytes_for(width, height, *format, n_mip_levels));
+    for (unsigned level = 0; level < n_mip_levels; ++level) {
+        const auto entry = header_size + index_size + level * level_index_entry_size;
+        const auto offset = read_le(data, entry, 8);
+        const auto length = read_le(data, entry + 8, 8);
+        const auto expected_length = ColourTexture::n_bytes_for(std::max(1u, width >> level), std::max(1u, height >> level), *format);
+        if (length != expected_length)
+            return tl::unexpected(fmt::format("ktx2: level {} has {} bytes, expected {}", level, length, expected_length));
+        // untrusted, offset + length may wrap around
+        if (offset > uint64_t(data.size()) || length > uint64_t(data.size()) - offset)
+            return tl::unexpected(fmt::format("ktx2: level {} is out of bounds", level));
+        const auto* begin = reinterpret_cast<const uint8_t*>(data.constData()) + offset;
+        levels.insert(levels.end(), begin, begin + length);
+    }
+    return ColourTexture(std::move(levels), width, height, *format, n_mip_levels);
+}
+
+} // namespace nucleus::utils::ktx2
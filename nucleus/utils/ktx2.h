@@ -0,0 +1,42 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <tl/expected.hpp>
+
+#include <optional>
+#include <string>
+
+#include "ColourTexture.h"
+
+/// Reader for precompressed ortho tiles in the KTX2 container (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html).
+/// The blocks are taken as they are, there is no rgba intermediate. Only formats that ColourTexture can upload are
+/// supported (BC1, ETC2 RGB and RGBA8), without supercompression. Basis Universal (BasisLZ / UASTC) needs a transcoder.
+namespace nucleus::utils::ktx2 {
+
+[[nodiscard]] bool is_ktx2(const QByteArray& data);
+
+/// nullopt for vk formats that have no ColourTexture equivalent
+[[nodiscard]] std::optional<ColourTexture::Format> to_colour_texture_format(uint32_t vk_format);
+
+/// the mip levels of the container, finest first. the result has at most max_mip_levels levels (if the container has more).
+[[nodiscard]] tl::expected<ColourTexture, std::string> to_colour_texture(const QByteArray& data, unsigned max_mip_levels = unsigned(-1));
+
+} // namespace nucleus::utils::ktx2
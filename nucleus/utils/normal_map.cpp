@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "normal_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "nucleus/srs.h"
+
+namespace nucleus::utils::normal_map {
+
+glm::u8vec2 encode(const glm::vec3& normal)
+{
+    auto n = glm::vec2(normal) / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+    if (normal.z < 0)
+        n = (1.f - glm::abs(glm::vec2(n.y, n.x))) * ((n.x >= 0 && n.y >= 0) ? 1.f : -1.f);
+    const auto unorm = glm::clamp(n * 0.5f + 0.5f, 0.f, 1.f);
+    return glm::u8vec2(glm::round(unorm * 255.f));
+}
+
+glm::vec3 decode(const glm::u8vec2& encoded)
+{
+    const auto f = glm::vec2(encoded) / 255.f * 2.f - 1.f;
+    auto n = glm::vec3(f, 1.f - std::abs(f.x) - std::abs(f.y));
+    const auto t = std::clamp(-n.z, 0.f, 1.f);
+    const auto shift = (n.x >= 0 && n.y >= 0) ? -t : t;
+    n.x += shift;
+    n.y += shift;
+    return glm::normalize(n);
+}
+
+Raster<glm::u8vec2> compute(const Raster<uint16_t>& heights, const tile::SrsBounds& bounds)
+{
+    const auto width = unsigned(heights.width());
+    const auto height = unsigned(heights.height());
+    Raster<glm::u8vec2> normals(glm::uvec2(width, height), uninitialised);
+    if (width < 2 || height < 2) {
+        normals.fill(encode({ 0, 0, 1 }));
+        return normals;
+    }
+    const auto texel_size = bounds.size() / glm::dvec2(width - 1, height - 1);
+    // row 0 is the northern edge
+    std::vector<double> altitude_scale(height);
+    for (unsigned row = 0; row < height; ++row) {
+        const auto y = bounds.max.y - double(row) * texel_size.y;
+        const auto latitude = srs::world_to_lat_long({ bounds.min.x, y }).x;
+        altitude_scale[row] = 0.125 / std::cos(latitude * 3.14159265358979323846 / 180.0);
+    }
+    const auto altitude = [&](unsigned col, unsigned row) { return double(heights.pixel({ col, row })) * altitude_scale[row]; };
+
+    for (unsigned row = 0; row < height; ++row) {
+        const auto north = row == 0 ? row : row - 1;
+        const auto south = std::min(row + 1, height - 1);
+        for (unsigned col = 0; col < width; ++col) {
+            const auto west = col == 0 ? col : col - 1;
+            const auto east = std::min(col + 1, width - 1);
+            const auto dz_dx = (altitude(east, row) - altitude(west, row)) / (double(east - west) * texel_size.x);
+            const auto dz_dy = (altitude(col, north) - altitude(col, south)) / (double(south - north) * texel_size.y);
+            normals.pixel({ col, row }) = encode(glm::vec3(glm::normalize(glm::dvec3(-dz_dx, -dz_dy, 1.0))));
+        }
+    }
+    return normals;
+}
+
+} // namespace nucleus::utils::normal_map
@@ -0,0 +1,38 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "nucleus/Raster.h"
+#include "radix/tile.h"
+
+namespace nucleus::utils::normal_map {
+
+/// octahedral encoding in two unorm bytes, decoded by octNormalDecode2n8 (encoder.glsl)
+glm::u8vec2 encode(const glm::vec3& normal);
+glm::vec3 decode(const glm::u8vec2& encoded);
+
+/// world space normals of a height tile (same resolution, central differences, one-sided at the borders). the heights are
+/// in 1/8 m and scaled by 1/cos(latitude) like the vertices in tile.glsl.
+/// the neighbours are not known when a tile is decoded, so the shared border samples of two tiles get different one-sided
+/// normals. this shows as a faint seam in the shading along the tile borders on steep terrain.
+Raster<glm::u8vec2> compute(const Raster<uint16_t>& heights, const tile::SrsBounds& bounds);
+
+} // namespace nucleus::utils::normal_map
@@ -0,0 +1,270 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "pixel_kernels.h"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define ALP_PIXEL_KERNELS_WASM
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ALP_PIXEL_KERNELS_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ALP_PIXEL_KERNELS_NEON
+#endif
+
+namespace nucleus::utils::pixel_kernels {
+
+namespace scalar {
+    void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque)
+    {
+        const auto alpha_mask = opaque ? 0xff000000u : 0u;
+        for (size_t i = 0; i < n_pixels; ++i) {
+            const auto p = in[i] | alpha_mask;
+            out[i * 4 + 0] = uint8_t(p >> 16);
+            out[i * 4 + 1] = uint8_t(p >> 8);
+            out[i * 4 + 2] = uint8_t(p);
+            out[i * 4 + 3] = uint8_t(p >> 24);
+        }
+    }
+
+    void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels)
+    {
+        for (size_t i = 0; i < n_pixels; ++i)
+            out[i] = uint16_t(in[i] >> 8);
+    }
+
+    void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels)
+    {
+        for (size_t i = 0; i < n_pixels; ++i)
+            out[i] = uint16_t((in[i * 4] << 8) | in[i * 4 + 1]);
+    }
+
+    void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start)
+    {
+        auto height = start;
+        for (size_t i = 0; i < n_values; ++i) {
+            height = uint16_t(height + ((in[i] >> 1) ^ -(in[i] & 1)));
+            out[i] = height;
+        }
+    }
+} // namespace scalar
+
+// the vector loops handle 8 (argb32_to_height, rgba8_to_height, zigzag_deltas_to_height) or 4 (argb32_to_rgba8) pixels per
+// iteration with unaligned loads and stores, the remaining pixels go through the scalar versions. the prefix sum adds the lanes
+// shifted by 1, 2 and 4 (log steps), plus the last height of the previous iteration.
+#if defined(ALP_PIXEL_KERNELS_WASM)
+
+const char* simd_target() { return "wasm simd128"; }
+
+void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque)
+{
+    const auto alpha = wasm_i32x4_splat(opaque ? int32_t(0xff000000u) : 0);
+    size_t i = 0;
+    for (; i + 4 <= n_pixels; i += 4) {
+        const auto p = wasm_v128_or(wasm_v128_load(in + i), alpha);
+        // bytes b, g, r, a -> r, g, b, a
+        wasm_v128_store(out + i * 4, wasm_i8x16_shuffle(p, p, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15));
+    }
+    scalar::argb32_to_rgba8(in + i, out + i * 4, n_pixels - i, opaque);
+}
+
+void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels)
+{
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        const auto a = wasm_v128_load(in + i);
+        const auto b = wasm_v128_load(in + i + 4);
+        // bytes g, r of every pixel
+        wasm_v128_store(out + i, wasm_i8x16_shuffle(a, b, 1, 2, 5, 6, 9, 10, 13, 14, 17, 18, 21, 22, 25, 26, 29, 30));
+    }
+    scalar::argb32_to_height(in + i, out + i, n_pixels - i);
+}
+
+void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels)
+{
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        const auto a = wasm_v128_load(in + i * 4);
+        const auto b = wasm_v128_load(in + i * 4 + 16);
+        wasm_v128_store(out + i, wasm_i8x16_shuffle(a, b, 1, 0, 5, 4, 9, 8, 13, 12, 17, 16, 21, 20, 25, 24, 29, 28));
+    }
+    scalar::rgba8_to_height(in + i * 4, out + i, n_pixels - i);
+}
+
+void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start)
+{
+    const auto zero = wasm_i16x8_splat(0);
+    const auto one = wasm_i16x8_splat(1);
+    auto carry = wasm_i16x8_splat(int16_t(start));
+    size_t i = 0;
+    for (; i + 8 <= n_values; i += 8) {
+        const auto z = wasm_v128_load(in + i);
+        auto d = wasm_v128_xor(wasm_u16x8_shr(z, 1), wasm_i16x8_neg(wasm_v128_and(z, one)));
+        d = wasm_i16x8_add(d, wasm_i8x16_shuffle(zero, d, 0, 1, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29));
+        d = wasm_i16x8_add(d, wasm_i8x16_shuffle(zero, d, 0, 1, 2, 3, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27));
+        d = wasm_i16x8_add(d, wasm_i8x16_shuffle(zero, d, 0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23));
+        d = wasm_i16x8_add(d, carry);
+        wasm_v128_store(out + i, d);
+        carry = wasm_i16x8_shuffle(d, d, 7, 7, 7, 7, 7, 7, 7, 7);
+    }
+    scalar::zigzag_deltas_to_height(in + i, out + i, n_values - i, i > 0 ? out[i - 1] : start);
+}
+
+#elif defined(ALP_PIXEL_KERNELS_SSE2)
+
+const char* simd_target() { return "sse2"; }
+
+void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque)
+{
+    const auto alpha = _mm_set1_epi32(opaque ? int(0xff000000u) : 0);
+    const auto green_alpha = _mm_set1_epi32(int(0xff00ff00u));
+    const auto low_byte = _mm_set1_epi32(0xff);
+    size_t i = 0;
+    for (; i + 4 <= n_pixels; i += 4) {
+        const auto p = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), alpha);
+        // swaps the bytes 0 and 2 of every pixel, there is no byte shuffle in sse2
+        const auto red = _mm_and_si128(_mm_srli_epi32(p, 16), low_byte);
+        const auto blue = _mm_slli_epi32(_mm_and_si128(p, low_byte), 16);
+        const auto rgba = _mm_or_si128(_mm_and_si128(p, green_alpha), _mm_or_si128(red, blue));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), rgba);
+    }
+    scalar::argb32_to_rgba8(in + i, out + i * 4, n_pixels - i, opaque);
+}
+
+void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels)
+{
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+        // bytes 1 and 2 as a sign extended 16 bit value, so that the signed saturating pack keeps them exactly
+        const auto a16 = _mm_srai_epi32(_mm_slli_epi32(a, 8), 16);
+        const auto b16 = _mm_srai_epi32(_mm_slli_epi32(b, 8), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a16, b16));
+    }
+    scalar::argb32_to_height(in + i, out + i, n_pixels - i);
+}
+
+void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels)
+{
+    const auto low_byte = _mm_set1_epi32(0xff);
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        const auto to_height = [&](__m128i p) {
+            // red (byte 0) to the high byte, green (byte 1) to the low byte, then sign extended like above
+            const auto v = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, low_byte), 8), _mm_and_si128(_mm_srli_epi32(p, 8), low_byte));
+            return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+        };
+        const auto a = to_height(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4)));
+        const auto b = to_height(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4 + 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));
+    }
+    scalar::rgba8_to_height(in + i * 4, out + i, n_pixels - i);
+}
+
+void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start)
+{
+    const auto zero = _mm_setzero_si128();
+    const auto one = _mm_set1_epi16(1);
+    auto carry = _mm_set1_epi16(int16_t(start));
+    size_t i = 0;
+    for (; i + 8 <= n_values; i += 8) {
+        const auto z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        auto d = _mm_xor_si128(_mm_srli_epi16(z, 1), _mm_sub_epi16(zero, _mm_and_si128(z, one)));
+        d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+        d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi16(d, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), d);
+        const auto last = _mm_shufflehi_epi16(d, 0xff); // lane 7 in the upper half
+        carry = _mm_unpackhi_epi64(last, last);
+    }
+    scalar::zigzag_deltas_to_height(in + i, out + i, n_values - i, i > 0 ? out[i - 1] : start);
+}
+
+#elif defined(ALP_PIXEL_KERNELS_NEON)
+
+const char* simd_target() { return "neon"; }
+
+void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque)
+{
+    size_t i = 0;
+    for (; i + 16 <= n_pixels; i += 16) {
+        // deinterleaved into b, g, r, a
+        const auto p = vld4q_u8(reinterpret_cast<const uint8_t*>(in + i));
+        const auto rgba = uint8x16x4_t { { p.val[2], p.val[1], p.val[0], opaque ? vdupq_n_u8(255) : p.val[3] } };
+        vst4q_u8(out + i * 4, rgba);
+    }
+    scalar::argb32_to_rgba8(in + i, out + i * 4, n_pixels - i, opaque);
+}
+
+void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels)
+{
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        const auto a = vshrn_n_u32(vld1q_u32(in + i), 8); // narrowing keeps the low 16 bits, i.e., bytes 1 and 2
+        const auto b = vshrn_n_u32(vld1q_u32(in + i + 4), 8);
+        vst1q_u16(out + i, vcombine_u16(a, b));
+    }
+    scalar::argb32_to_height(in + i, out + i, n_pixels - i);
+}
+
+void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels)
+{
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        const auto p = vld4_u8(in + i * 4); // deinterleaved into r, g, b, a
+        vst1q_u16(out + i, vorrq_u16(vshll_n_u8(p.val[0], 8), vmovl_u8(p.val[1])));
+    }
+    scalar::rgba8_to_height(in + i * 4, out + i, n_pixels - i);
+}
+
+void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start)
+{
+    const auto zero = vdupq_n_u16(0);
+    const auto one = vdupq_n_u16(1);
+    auto carry = vdupq_n_u16(start);
+    size_t i = 0;
+    for (; i + 8 <= n_values; i += 8) {
+        const auto z = vld1q_u16(in + i);
+        const auto sign = vreinterpretq_u16_s16(vnegq_s16(vreinterpretq_s16_u16(vandq_u16(z, one))));
+        auto d = veorq_u16(vshrq_n_u16(z, 1), sign);
+        d = vaddq_u16(d, vextq_u16(zero, d, 7));
+        d = vaddq_u16(d, vextq_u16(zero, d, 6));
+        d = vaddq_u16(d, vextq_u16(zero, d, 4));
+        d = vaddq_u16(d, carry);
+        vst1q_u16(out + i, d);
+        carry = vdupq_n_u16(vgetq_lane_u16(d, 7));
+    }
+    scalar::zigzag_deltas_to_height(in + i, out + i, n_values - i, i > 0 ? out[i - 1] : start);
+}
+
+#else
+
+const char* simd_target() { return "scalar"; }
+
+void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque) { scalar::argb32_to_rgba8(in, out, n_pixels, opaque); }
+void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels) { scalar::argb32_to_height(in, out, n_pixels); }
+void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels) { scalar::rgba8_to_height(in, out, n_pixels); }
+void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start) { scalar::zigzag_deltas_to_height(in, out, n_values, start); }
+
+#endif
+
+} // namespace nucleus::utils::pixel_kernels
@@ -0,0 +1,51 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// the per pixel loops of the tile decoding (channel swizzles and the height encoding). they are vectorised with the simd
+/// instructions of the target: sse2 (x86-64), neon (arm64 / android) and simd128 (webassembly, built with -msimd128), chosen
+/// at compile time. other targets use the scalar versions, which are also the reference for the tests and benchmarks.
+/// the block compressors (dxt1 / etc1, GoofyTC) bring their own sse2 and neon code, webassembly translates the sse2 (-msse2).
+/// all kernels assume a little endian target, any alignment and any number of pixels.
+namespace nucleus::utils::pixel_kernels {
+
+/// "sse2", "neon", "wasm simd128" or "scalar"
+[[nodiscard]] const char* simd_target();
+
+/// 0xAARRGGBB pixels in native byte order (QImage::Format_ARGB32 / RGB32) to bytes in r, g, b, a order. opaque sets alpha to 255.
+void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque);
+/// height encoding, red is the high and green the low byte (see alppineRedGreen2uint16)
+void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels);
+/// bytes in r, g, b, a order
+void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels);
+/// zigzag coded deltas (of the compact height encoding, see tile_conversion::encode_height) back to heights, i.e., a prefix sum
+/// (wrapping). start is the height before in[0], 0 for the first value of a tile.
+void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start = 0);
+
+namespace scalar {
+    void argb32_to_rgba8(const uint32_t* in, uint8_t* out, size_t n_pixels, bool opaque);
+    void argb32_to_height(const uint32_t* in, uint16_t* out, size_t n_pixels);
+    void rgba8_to_height(const uint8_t* in, uint16_t* out, size_t n_pixels);
+    void zigzag_deltas_to_height(const uint16_t* in, uint16_t* out, size_t n_values, uint16_t start = 0);
+} // namespace scalar
+
+} // namespace nucleus::utils::pixel_kernels
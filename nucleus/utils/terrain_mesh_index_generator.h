@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 #include <vector>
@@ -66,40 +67,98 @@ std::vector<Index> surface_quads(unsigned vertex_side_length)
     return indices;
 }
 
+namespace detail {
+    // appends the curtain strip, starting with the last surface vertex. curtain vertices follow the surface vertices.
+    template <typename Index>
+    void append_curtains(std::vector<Index>& indices, unsigned vertex_side_length)
+    {
+        const auto height = vertex_side_length;
+        const auto width = vertex_side_length;
+        const auto index_for = [&width](auto row, auto col) { return Index(col + row * width); };
+        auto curtain_index = Index(width * height);
+        const auto first_curtain_index = curtain_index;
+
+        for (size_t row = height - 1; row >= 1; row--) {
+            indices.push_back(index_for(row, width - 1));
+            indices.push_back(curtain_index++);
+        }
+
+        for (size_t col = width - 1; col >= 1; col--) {
+            indices.push_back(index_for(0, col));
+            indices.push_back(curtain_index++);
+        }
+
+        for (size_t row = 0; row < height - 1; row++) {
+            indices.push_back(index_for(row, 0));
+            indices.push_back(curtain_index++);
+        }
+
+        for (size_t col = 0; col < width - 1; col++) {
+            indices.push_back(index_for(height - 1, col));
+            indices.push_back(curtain_index++);
+        }
+        indices.push_back(index_for(height - 1, width - 1));
+        indices.push_back(first_curtain_index);
+    }
+} // namespace detail
+
 template<typename Index>
 std::vector<Index> surface_quads_with_curtains(unsigned vertex_side_length)
 {
     assert(vertex_side_length >= 2);
     assert(vertex_side_length * vertex_side_length < std::numeric_limits<Index>::max());
     std::vector<Index> indices = surface_quads<Index>(vertex_side_length);
-    const auto height = vertex_side_length;
-    const auto width = vertex_side_length;
-    const auto index_for = [&width](auto row, auto col) { return col + row * width; };
-    auto curtain_index = indices.back() + 1;
-    const auto first_curtain_index = curtain_index;
-
-    for (size_t row = height - 1; row >= 1; row--) {
-        indices.push_back(index_for(row, width - 1));
-        indices.push_back(curtain_index++);
-    }
+    detail::append_curtains(indices, vertex_side_length);
+    return indices;
+}
 
-    for (size_t col = width - 1; col >= 1; col--) {
-        indices.push_back(index_for(0, col));
-        indices.push_back(curtain_index++);
-    }
+// index that starts a new strip, as used by GL_PRIMITIVE_RESTART_FIXED_INDEX (always enabled in GLES 3.0 and WebGL 2)
+template <typename Index>
+constexpr Index primitive_restart_index()
+{
+    return std::numeric_limits<Index>::max();
+}
 
-    for (size_t row = 0; row < height - 1; row++) {
-        indices.push_back(index_for(row, 0));
-        indices.push_back(curtain_index++);
-    }
+// like surface_quads, but the grid is split into vertical bands, which are small enough for the post-transform vertex
+// cache. within a band, every row is a strip, and strips are separated by the primitive restart index. with a fifo cache of
+// cache_size entries, the vertices of the lower row of a strip are still cached when the next strip uses them, so nearly
+// every vertex is shaded once (only the columns shared by neighbouring bands are shaded twice).
+// i.e., for 4x4 with bands of 2 quads: 0, 4, 1, 5, 2, 6, R, 4, 8, 5, 9, 6, 10, R, 8, 12, 9, 13, 10, 14, R, 2, 6, 3, 7, R, ..
+// all strips start on an even position, so the winding order is the same as in surface_quads.
+template <typename Index>
+std::vector<Index> surface_quads_cache_optimised(unsigned vertex_side_length, unsigned cache_size = 24)
+{
+    assert(vertex_side_length >= 2);
+    assert(size_t(vertex_side_length) * vertex_side_length < size_t(primitive_restart_index<Index>()));
+    assert(cache_size >= 4);
+    std::vector<Index> indices;
+    const auto height = vertex_side_length;
+    const auto width = vertex_side_length;
+    const auto index_for = [&width](auto row, auto col) { return Index(col + row * width); };
+    // the first strip of a band inserts both of its rows (2 * (band_width + 1) vertices), the lower one must survive until the next strip
+    const auto band_width = std::max(1u, cache_size / 2 - 1);
 
-    for (size_t col = 0; col < width - 1; col++) {
-        indices.push_back(index_for(height - 1, col));
-        indices.push_back(curtain_index++);
+    for (unsigned band_start = 0; band_start < width - 1; band_start += band_width) {
+        const auto band_end = std::min(band_start + band_width, width - 1);
+        for (size_t row = 0; row < height - 1; row++) {
+            if (!indices.empty())
+                indices.push_back(primitive_restart_index<Index>());
+            for (auto col = band_start; col <= band_end; col++) {
+                indices.push_back(index_for(row, col));
+                indices.push_back(index_for(row + 1, col));
+            }
+        }
     }
-    indices.push_back(index_for(height - 1, width - 1));
-    indices.push_back(first_curtain_index);
+    return indices;
+}
 
+template <typename Index>
+std::vector<Index> surface_quads_with_curtains_cache_optimised(unsigned vertex_side_length, unsigned cache_size = 24)
+{
+    assert(size_t(vertex_side_length) * vertex_side_length + 4 * (vertex_side_length - 1) < size_t(primitive_restart_index<Index>()));
+    std::vector<Index> indices = surface_quads_cache_optimised<Index>(vertex_side_length, cache_size);
+    indices.push_back(primitive_restart_index<Index>());
+    detail::append_curtains(indices, vertex_side_length);
     return indices;
 }
 }
@@ -17,35 +17,357 @@
  *****************************************************************************/
 
 #include "tile_conversion.h"
+#include "pixel_kernels.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QScopeGuard>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef ALP_ENABLE_SPNG
+#include <spng.h>
+#endif
+#ifdef ALP_ENABLE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+#ifdef ALP_ENABLE_WEBP
+#include <webp/decode.h>
+#endif
+#ifdef ALP_ENABLE_AVIF
+#include <avif/avif.h>
+#endif
+#ifdef ALP_ENABLE_ZSTD
+#include <zstd.h>
+#endif
 
 namespace nucleus::utils::tile_conversion {
 
+ImageFormat image_format(const QByteArray& byte_array)
+{
+    const auto starts_with = [&](qsizetype offset, const char* magic) { return byte_array.sliced(std::min(offset, byte_array.size())).startsWith(magic); };
+    if (starts_with(0, "\xff\xd8\xff"))
+        return ImageFormat::Jpeg;
+    if (starts_with(0, "\x89PNG\r\n\x1a\n"))
+        return ImageFormat::Png;
+    if (starts_with(0, "RIFF") && starts_with(8, "WEBP"))
+        return ImageFormat::WebP;
+    if (starts_with(4, "ftypavif") || starts_with(4, "ftypavis"))
+        return ImageFormat::Avif;
+    return ImageFormat::Unknown;
+}
+
+QByteArray accepted_ortho_media_types()
+{
+    const auto qt_types = QImageReader::supportedMimeTypes();
+#ifdef ALP_ENABLE_WEBP
+    const auto webp = true;
+#else
+    const auto webp = qt_types.contains("image/webp");
+#endif
+#ifdef ALP_ENABLE_AVIF
+    const auto avif = true;
+#else
+    const auto avif = qt_types.contains("image/avif");
+#endif
+    QByteArray types;
+    if (webp)
+        types += "image/webp,";
+    types += "image/jpeg;q=0.9,image/png;q=0.8";
+    if (avif)
+        types += ",image/avif;q=0.5";
+    return types;
+}
+
+namespace {
+constexpr qsizetype compact_height_header_size = 12;
+
+uint16_t read_u16(const QByteArray& data, qsizetype offset) { return uint16_t(uint8_t(data[offset]) | (uint8_t(data[offset + 1]) << 8)); }
+
+Raster<uint16_t> decode_compact_height(const QByteArray& byte_array)
+{
+    if (byte_array.size() < compact_height_header_size)
+        return {};
+    const auto size = glm::uvec2(read_u16(byte_array, 4), read_u16(byte_array, 6));
+    const auto n_bytes = size_t(size.x) * size.y * sizeof(uint16_t);
+    const auto payload = QByteArrayView(byte_array).sliced(compact_height_header_size);
+    thread_local std::vector<uint16_t> deltas;
+    deltas.resize(size_t(size.x) * size.y);
+    switch (HeightCodec(byte_array[8])) {
+    case HeightCodec::Raw:
+        if (size_t(payload.size()) != n_bytes)
+            return {};
+        std::memcpy(deltas.data(), payload.data(), n_bytes);
+        break;
+    case HeightCodec::Deflate: {
+        const auto inflated = qUncompress(reinterpret_cast<const uchar*>(payload.data()), payload.size());
+        if (size_t(inflated.size()) != n_bytes)
+            return {};
+        std::memcpy(deltas.data(), inflated.constData(), n_bytes);
+        break;
+    }
+    case HeightCodec::Zstd:
+#ifdef ALP_ENABLE_ZSTD
+        if (ZSTD_decompress(deltas.data(), n_bytes, payload.data(), size_t(payload.size())) != n_bytes)
+            return {};
+        break;
+#else
+        return {};
+#endif
+    default:
+        return {};
+    }
+    Raster<uint16_t> raster(size, uninitialised);
+    pixel_kernels::zigzag_deltas_to_height(deltas.data(), raster.data(), deltas.size());
+    return raster;
+}
+} // namespace
+
+QByteArray encode_height(const Raster<uint16_t>& raster, HeightCodec codec)
+{
+    assert(raster.width() <= 0xffff && raster.height() <= 0xffff);
+    QByteArray deltas(qsizetype(raster.buffer_length() * sizeof(uint16_t)), Qt::Uninitialized);
+    auto* out = reinterpret_cast<uchar*>(deltas.data());
+    uint16_t previous = 0;
+    for (const auto height : raster) {
+        const auto delta = int16_t(uint16_t(height - previous));
+        const auto zigzag = uint16_t((delta << 1) ^ (delta >> 15));
+        *out++ = uchar(zigzag);
+        *out++ = uchar(zigzag >> 8);
+        previous = height;
+    }
+#ifndef ALP_ENABLE_ZSTD
+    if (codec == HeightCodec::Zstd)
+        codec = HeightCodec::Deflate;
+#endif
+    QByteArray payload;
+    switch (codec) {
+    case HeightCodec::Raw:
+        payload = deltas;
+        break;
+    case HeightCodec::Deflate:
+        payload = qCompress(deltas, 9);
+        break;
+    case HeightCodec::Zstd:
+#ifdef ALP_ENABLE_ZSTD
+        payload.resize(qsizetype(ZSTD_compressBound(size_t(deltas.size()))));
+        payload.resize(qsizetype(ZSTD_compress(payload.data(), size_t(payload.size()), deltas.constData(), size_t(deltas.size()), 19)));
+#endif
+        break;
+    }
+    QByteArray encoded("ALH1");
+    for (const auto v : { uint16_t(raster.width()), uint16_t(raster.height()) }) {
+        encoded.append(char(v & 0xff));
+        encoded.append(char(v >> 8));
+    }
+    encoded.append(char(codec));
+    encoded.append(3, '\0');
+    return encoded + payload;
+}
+
+bool is_compact_height(const QByteArray& byte_array) { return byte_array.size() >= compact_height_header_size && byte_array.startsWith("ALH1"); }
+
+QByteArray accepted_height_media_types()
+{
+#ifdef ALP_ENABLE_ZSTD
+    return "application/x-alpine-height+zstd,application/x-alpine-height+deflate;q=0.95,image/png;q=0.9";
+#else
+    return "application/x-alpine-height+deflate,image/png;q=0.9";
+#endif
+}
+
 Raster<glm::u8vec4> toRasterRGBA(const QByteArray& byte_array)
 {
     const auto qimage = toQImage(byte_array).convertedTo(QImage::Format_RGBA8888);
-    Raster<glm::u8vec4> retval({ qimage.width(), qimage.height() });
+    Raster<glm::u8vec4> retval({ qimage.width(), qimage.height() }, uninitialised);
     std::copy(qimage.constBits(), qimage.constBits() + qimage.sizeInBytes(), reinterpret_cast<uchar*>(&(retval.begin()->x)));
     return retval;
 }
 
-Raster<uint16_t> qImage2uint16Raster(const QImage& qimage)
+void decode_into(const QByteArray& byte_array, QImage* image)
+{
+    QBuffer buffer;
+    buffer.setData(byte_array); // shallow copy
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    // the jpeg and png handlers write into the existing image, if it's unshared and has the size and format of the tile
+    if (!reader.read(image))
+        *image = QImage();
+}
+
+Raster<uint16_t> decode_height(const QByteArray& byte_array)
+{
+    if (is_compact_height(byte_array))
+        return decode_compact_height(byte_array);
+#ifdef ALP_ENABLE_SPNG
+    auto* ctx = spng_ctx_new(0);
+    const auto free_ctx = qScopeGuard([&]() { spng_ctx_free(ctx); });
+    spng_ihdr ihdr = {};
+    if (ctx && spng_set_png_buffer(ctx, byte_array.constData(), size_t(byte_array.size())) == 0 && spng_get_ihdr(ctx, &ihdr) == 0
+        && spng_decode_image(ctx, nullptr, 0, SPNG_FMT_RGBA8, SPNG_DECODE_PROGRESSIVE) == 0) {
+        Raster<uint16_t> raster({ ihdr.width, ihdr.height }, uninitialised);
+        thread_local std::vector<uint8_t> row;
+        row.resize(size_t(ihdr.width) * 4);
+        auto* raster_pointer = raster.data();
+        for (unsigned r = 0; r < ihdr.height; ++r) {
+            const auto result = spng_decode_row(ctx, row.data(), row.size());
+            if (result != 0 && result != SPNG_EOI)
+                return qImage2uint16Raster(toQImage(byte_array)); // e.g. truncated, let qt handle it the usual way
+            pixel_kernels::rgba8_to_height(row.data(), raster_pointer, ihdr.width);
+            raster_pointer += ihdr.width;
+        }
+        return raster;
+    }
+#endif
+    thread_local QImage image;
+    decode_into(byte_array, &image);
+    return qImage2uint16Raster(image);
+}
+
+namespace {
+#ifdef ALP_ENABLE_WEBP
+bool decode_webp(const QByteArray& byte_array, unsigned max_size, QImage* image)
 {
-    if (qimage.format() != QImage::Format_ARGB32 && qimage.format() != QImage::Format_RGB32) {
-        // let's hope that the format is always ARGB32
-        // if not, please implement the conversion, that'll give better performance.
-        // the assert will be disabled in release, just as a backup.
-        assert(false);
-        return qImage2uint16Raster(qimage.convertedTo(QImage::Format_ARGB32));
+    const auto* data = reinterpret_cast<const uint8_t*>(byte_array.constData());
+    const auto size = size_t(byte_array.size());
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(data, size, &config.input) != VP8_STATUS_OK)
+        return false;
+    auto scaled_size = QSize(config.input.width, config.input.height);
+    if (max_size > 0 && std::min(scaled_size.width(), scaled_size.height()) > int(max_size)) {
+        // the smaller side becomes max_size, the decoder scales while decoding (cheaper than scaling the full image afterwards)
+        scaled_size = scaled_size.scaled(int(max_size), int(max_size), Qt::KeepAspectRatioByExpanding);
+        config.options.use_scaling = 1;
+        config.options.scaled_width = scaled_size.width();
+        config.options.scaled_height = scaled_size.height();
     }
-    Raster<uint16_t> raster({ qimage.width(), qimage.height() });
+    if (image->size() != scaled_size || image->format() != QImage::Format_RGBA8888)
+        *image = QImage(scaled_size, QImage::Format_RGBA8888);
+    config.output.colorspace = MODE_RGBA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = image->bits();
+    config.output.u.RGBA.stride = int(image->bytesPerLine());
+    config.output.u.RGBA.size = size_t(image->sizeInBytes());
+    const auto status = WebPDecode(data, size, &config);
+    WebPFreeDecBuffer(&config.output); // external memory stays
+    return status == VP8_STATUS_OK;
+}
+#endif
 
-    const auto* image_pointer = reinterpret_cast<const uint32_t*>(qimage.constBits());
-    for (uint16_t& r : raster) {
-        r = uint16_t((*image_pointer) >> 8);
-        ++image_pointer;
+#ifdef ALP_ENABLE_AVIF
+bool decode_avif(const QByteArray& byte_array, QImage* image)
+{
+    const auto decoder = std::unique_ptr<avifDecoder, void (*)(avifDecoder*)>(avifDecoderCreate(), &avifDecoderDestroy);
+    if (!decoder)
+        return false;
+    decoder->maxThreads = 1; // tiles are decoded in parallel by the decode pool already
+    decoder->ignoreExif = AVIF_TRUE;
+    decoder->ignoreXMP = AVIF_TRUE;
+    if (avifDecoderSetIOMemory(decoder.get(), reinterpret_cast<const uint8_t*>(byte_array.constData()), size_t(byte_array.size())) != AVIF_RESULT_OK
+        || avifDecoderParse(decoder.get()) != AVIF_RESULT_OK || avifDecoderNextImage(decoder.get()) != AVIF_RESULT_OK)
+        return false;
+    avifRGBImage rgb;
+    avifRGBImageSetDefaults(&rgb, decoder->image);
+    rgb.format = AVIF_RGB_FORMAT_RGBA;
+    rgb.depth = 8;
+    const auto decoded_size = QSize(int(rgb.width), int(rgb.height));
+    if (image->size() != decoded_size || image->format() != QImage::Format_RGBA8888)
+        *image = QImage(decoded_size, QImage::Format_RGBA8888);
+    rgb.pixels = image->bits();
+    rgb.rowBytes = uint32_t(image->bytesPerLine());
+    return avifImageYUVToRGB(decoder->image, &rgb) == AVIF_RESULT_OK;
+}
+#endif
+} // namespace
+
+void decode_ortho_into(const QByteArray& byte_array, unsigned max_size, QImage* image)
+{
+#ifdef ALP_ENABLE_WEBP
+    if (image_format(byte_array) == ImageFormat::WebP && decode_webp(byte_array, max_size, image))
+        return;
+#endif
+#ifdef ALP_ENABLE_AVIF
+    if (image_format(byte_array) == ImageFormat::Avif && decode_avif(byte_array, image))
+        return;
+#endif
+#ifdef ALP_ENABLE_TURBOJPEG
+    thread_local const auto handle = std::unique_ptr<void, int (*)(tjhandle)>(tjInitDecompress(), &tjDestroy);
+    const auto* data = reinterpret_cast<const unsigned char*>(byte_array.constData());
+    const auto size = static_cast<unsigned long>(byte_array.size());
+    int width = 0;
+    int height = 0;
+    int subsampling = 0;
+    int colourspace = 0;
+    if (handle && tjDecompressHeader3(handle.get(), data, size, &width, &height, &subsampling, &colourspace) == 0) {
+        // the smallest dct scaling that is still at least max_size
+        int n_factors = 0;
+        const auto* factors = tjGetScalingFactors(&n_factors);
+        auto best = tjscalingfactor { 1, 1 };
+        for (int i = 0; i < n_factors; ++i) {
+            const auto w = TJSCALED(width, factors[i]);
+            const auto h = TJSCALED(height, factors[i]);
+            if (w >= int(max_size) && h >= int(max_size) && w * h < TJSCALED(width, best) * TJSCALED(height, best))
+                best = factors[i];
+        }
+        const auto scaled_size = QSize(TJSCALED(width, best), TJSCALED(height, best));
+        if (image->size() != scaled_size || image->format() != QImage::Format_RGBX8888)
+            *image = QImage(scaled_size, QImage::Format_RGBX8888);
+        if (tjDecompress2(handle.get(), data, size, image->bits(), scaled_size.width(), int(image->bytesPerLine()), scaled_size.height(), TJPF_RGBX, TJFLAG_FASTDCT) == 0)
+            return;
     }
+#endif
+    Q_UNUSED(max_size);
+    decode_into(byte_array, image);
+}
 
+Raster<uint16_t> qImage2uint16Raster(const QImage& qimage)
+{
+    Raster<uint16_t> raster({ qimage.width(), qimage.height() }, uninitialised);
+    qImage2uint16Raster(qimage, raster.view());
     return raster;
 }
 
+void qImage2uint16Raster(const QImage& qimage, RasterView<uint16_t> out)
+{
+    assert(out.size() == glm::uvec2(qimage.width(), qimage.height()));
+    auto* raster_pointer = out.data();
+    switch (qimage.format()) {
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB32:
+        // 0xAARRGGBB in native byte order
+        for (int row = 0; row < qimage.height(); ++row) {
+            pixel_kernels::argb32_to_height(reinterpret_cast<const uint32_t*>(qimage.constScanLine(row)), raster_pointer, size_t(qimage.width()));
+            raster_pointer += qimage.width();
+        }
+        break;
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGB888:
+    {
+        // bytes in r, g, b(, a) order
+        const auto n_channels = qimage.format() == QImage::Format_RGB888 ? 3 : 4;
+        for (int row = 0; row < qimage.height(); ++row) {
+            const auto* image_pointer = qimage.constScanLine(row);
+            if (n_channels == 4) {
+                pixel_kernels::rgba8_to_height(image_pointer, raster_pointer, size_t(qimage.width()));
+                raster_pointer += qimage.width();
+                continue;
+            }
+            for (int col = 0; col < qimage.width(); ++col)
+                *raster_pointer++ = alppineRedGreen2uint16(image_pointer[col * n_channels], image_pointer[col * n_channels + 1]);
+        }
+        break;
+    }
+    default:
+        if (qimage.isNull())
+            return;
+        // not seen for png height tiles so far, implement a direct path if it shows up in a profile.
+        qImage2uint16Raster(qimage.convertedTo(QImage::Format_ARGB32), out);
+    }
+}
+
 }
@@ -26,9 +26,42 @@
 
 namespace nucleus::utils::tile_conversion {
 
+enum class ImageFormat { Unknown, Jpeg, Png, WebP, Avif };
+/// from the magic bytes. the file ending of the url and the content type of the response say nothing once the server negotiates.
+ImageFormat image_format(const QByteArray& byte_array);
+/// media types of the ortho formats that can be decoded, for the Accept header of the tile requests (see
+/// TileLoadService::TransportOptions::accept). webp is preferred over jpeg (smaller at the same quality, and similarly fast to
+/// decode with libwebp). avif is smaller still, but decodes several times slower, so it's accepted with the lowest weight only.
+/// webp and avif are listed if there is a native decoder (ALP_ENABLE_WEBP, ALP_ENABLE_AVIF) or a qt image plugin for them.
+QByteArray accepted_ortho_media_types();
+
+/// compact height tiles (application/x-alpine-height), instead of pngs: a 12 byte header ("ALH1", width and height as 16 bit little
+/// endian, the codec, 3 reserved bytes), followed by the row major heights as zigzag coded deltas to the previous height (16 bit
+/// little endian), compressed with the codec. deflate is the output of qCompress (always available), zstd needs ALP_ENABLE_ZSTD.
+enum class HeightCodec : uint8_t { Raw = 0, Deflate = 1, Zstd = 2 };
+/// zstd falls back to deflate without ALP_ENABLE_ZSTD
+QByteArray encode_height(const Raster<uint16_t>& raster, HeightCodec codec);
+bool is_compact_height(const QByteArray& byte_array);
+/// for the Accept header of the height requests (see TileLoadService::TransportOptions::accept), the compact encoding before png
+QByteArray accepted_height_media_types();
+
 inline QImage toQImage(const QByteArray& byte_array) { return QImage::fromData(byte_array); }
+/// decodes into image, reusing its pixel buffer if size and format match (e.g. a thread_local image of a decode worker,
+/// tiles of a layer all have the same size and format). the image is null if decoding failed.
+void decode_into(const QByteArray& byte_array, QImage* image);
+/// height png straight into the raster (red and green, see alppineRedGreen2uint16). with ALP_ENABLE_SPNG the rows are decoded by libspng
+/// without an image in between, otherwise it goes through QImage and qImage2uint16Raster. compact height tiles (see encode_height) are
+/// decompressed and prefix summed into the raster (empty if the data is corrupt).
+Raster<uint16_t> decode_height(const QByteArray& byte_array);
+/// like decode_into, but the image is at most max_size x max_size. with ALP_ENABLE_TURBOJPEG, jpegs are decoded straight into rgbx and
+/// scaled in the dct domain (by 1/2, 1/4 or 1/8, the result may be larger than max_size), otherwise larger images are decoded at full size.
+/// with ALP_ENABLE_WEBP, webps are decoded by libwebp into rgba (and scaled by the decoder to max_size), with ALP_ENABLE_AVIF, avifs by
+/// libavif (dav1d) into rgba. everything else goes through QImageReader.
+void decode_ortho_into(const QByteArray& byte_array, unsigned max_size, QImage* image);
 Raster<glm::u8vec4> toRasterRGBA(const QByteArray& byte_array);
 Raster<uint16_t> qImage2uint16Raster(const QImage& byte_array);
+/// same, but writes into memory of the caller (e.g. pooled or mapped), out must have the size of the image
+void qImage2uint16Raster(const QImage& qimage, RasterView<uint16_t> out);
 
 inline glm::u8vec4 float2alpineRGBA(float height)
 {
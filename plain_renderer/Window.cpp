@@ -18,10 +18,14 @@
 
 #include "Window.h"
 
+#include <algorithm>
+
 Window::Window()
 {
     m_gl_window = new gl_engine::Window();
-    connect(m_gl_window, &gl_engine::Window::update_requested, this, qOverload<>(&QOpenGLWindow::update));
+    connect(m_gl_window, &gl_engine::Window::update_requested, m_frame_scheduler, &nucleus::utils::FrameScheduler::request_frame);
+    connect(m_frame_scheduler, &nucleus::utils::FrameScheduler::frame_requested, this, qOverload<>(&QOpenGLWindow::update));
+    set_frame_limit(m_frame_limit);
     connect(m_timer, &QTimer::timeout, this, &Window::key_timer);
 }
 
@@ -40,6 +44,8 @@ void Window::resizeGL(int w, int h)
 
 void Window::paintGL()
 {
+    // input since the last frame is applied to the camera once, here
+    m_gl_window->updateCameraEvent();
     m_gl_window->paint();
 }
 
@@ -48,6 +54,13 @@ gl_engine::Window* Window::render_window()
     return m_gl_window;
 }
 
+void Window::set_frame_limit(int new_frame_limit)
+{
+    m_frame_limit = std::clamp(new_frame_limit, 1, 120);
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::Normal, unsigned(m_frame_limit));
+    m_frame_scheduler->set_max_fps(nucleus::utils::FrameScheduler::PowerState::PowerSaving, unsigned(m_frame_limit));
+}
+
 void Window::closeEvent(QCloseEvent*)
 {
     // NOTE: The following fixes the bug where the plain_renderer crashes if m_gl_window was set as a direct member variable
@@ -79,7 +92,7 @@ void Window::keyPressEvent(QKeyEvent* e)
     }
     m_keys_pressed++;
     if (!m_timer->isActive()) {
-        m_timer->start(1000.0f / 30.0f);
+        m_timer->start(1000 / m_frame_limit);
     }
     if (m_gl_window)
         m_gl_window->keyPressEvent(e);
@@ -24,6 +24,7 @@
 
 #include "gl_engine/Window.h"
 #include "nucleus/event_parameter.h"
+#include "nucleus/utils/FrameScheduler.h"
 
 class Window : public QOpenGLWindow
 {
@@ -36,6 +37,8 @@ public:
     void paintGL() override;
 
     [[nodiscard]] gl_engine::Window* render_window();
+    // caps the frames requested by the renderer and the camera updates of held keys
+    void set_frame_limit(int new_frame_limit);
 
 protected:
     void mousePressEvent(QMouseEvent*) override;
@@ -59,6 +62,8 @@ private slots:
 private:
     gl_engine::Window* m_gl_window = nullptr;
     QTimer *m_timer = new QTimer(this);
+    nucleus::utils::FrameScheduler* m_frame_scheduler = new nucleus::utils::FrameScheduler(this);
+    int m_frame_limit = 60;
     int m_keys_pressed = 0;
     bool m_closing = false;
 };
@@ -50,6 +50,7 @@
 
 #include <iostream>
 
+#include <QCommandLineParser>
 #include <QGuiApplication>
 #include <QObject>
 #include <QOpenGLContext>
@@ -61,6 +62,7 @@
 #include "Window.h"
 #include "nucleus/Controller.h"
 #include "nucleus/camera/Controller.h"
+#include "nucleus/timing/StartupTimeline.h"
 
 
 // This example demonstrates easy, cross-platform usage of OpenGL ES 3.0 functions via
@@ -73,10 +75,17 @@
 
 int main(int argc, char* argv[])
 {
+    nucleus::timing::StartupTimeline::instance(); // the startup is timed from here, until the first frame
     QGuiApplication app(argc, argv);
     QCoreApplication::setOrganizationName("AlpineMaps.org");
     QCoreApplication::setApplicationName("PlainRenderer");
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption frame_limit_option("frame-limit", "Maximum frames per second (1 to 120), frames are only rendered on change.", "fps", "60");
+    parser.addOption(frame_limit_option);
+    parser.process(app);
+
     QSurfaceFormat fmt;
     fmt.setDepthBufferSize(24);
     fmt.setOption(QSurfaceFormat::DebugContext);
@@ -94,6 +103,7 @@ int main(int argc, char* argv[])
     QSurfaceFormat::setDefaultFormat(fmt);
 
     Window glWindow;
+    glWindow.set_frame_limit(parser.value(frame_limit_option).toInt());
     nucleus::Controller controller(glWindow.render_window());
 
     QObject::connect(&glWindow, &Window::mouse_moved, controller.camera_controller(), &nucleus::camera::Controller::mouse_move);
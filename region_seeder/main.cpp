@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <iostream>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+#include <fmt/format.h>
+
+#include "nucleus/tile_scheduler/LayerAssembler.h"
+#include "nucleus/tile_scheduler/QuadAssembler.h"
+#include "nucleus/tile_scheduler/RateLimiter.h"
+#include "nucleus/tile_scheduler/RegionSeeder.h"
+#include "nucleus/tile_scheduler/Scheduler.h"
+#include "nucleus/tile_scheduler/SlotLimiter.h"
+#include "nucleus/tile_scheduler/TileLoadService.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+// "lat,long;lat,long;..." or a bounding box "lat_min,long_min,lat_max,long_max"
+std::vector<glm::dvec2> parse_polygon(const QString& polygon, const QString& bbox)
+{
+    std::vector<glm::dvec2> result;
+    if (!bbox.isEmpty()) {
+        const auto values = bbox.split(',');
+        if (values.size() != 4)
+            return {};
+        const auto lat_min = values[0].toDouble();
+        const auto long_min = values[1].toDouble();
+        const auto lat_max = values[2].toDouble();
+        const auto long_max = values[3].toDouble();
+        return { { lat_min, long_min }, { lat_min, long_max }, { lat_max, long_max }, { lat_max, long_min } };
+    }
+    for (const auto& point : polygon.split(';', Qt::SkipEmptyParts)) {
+        const auto values = point.split(',');
+        if (values.size() != 2)
+            return {};
+        result.emplace_back(values[0].toDouble(), values[1].toDouble());
+    }
+    return result;
+}
+
+std::string format_statistics(const RegionSeeder::Statistics& stats)
+{
+    const auto n_done = stats.n_quads_written + stats.n_quads_failed;
+    const auto n_todo = stats.n_quads_total - stats.n_quads_skipped;
+    const auto seconds = std::max(stats.seconds, 0.001);
+    return fmt::format("{}/{} quads ({} already cached, {} failed), {:.1f} MB downloaded, {:.1f} quads/s, {:.2f} MB/s",
+        n_done,
+        n_todo,
+        stats.n_quads_skipped,
+        stats.n_quads_failed,
+        double(stats.n_bytes_downloaded) / (1024.0 * 1024.0),
+        double(n_done) / seconds,
+        double(stats.n_bytes_downloaded) / (1024.0 * 1024.0) / seconds);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("AlpineMaps.org");
+    QCoreApplication::setApplicationName("AlpineApp"); // same cache location as the app
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Downloads the tiles of a region into a tile pack, which the app uses as its disk cache.");
+    parser.addHelpOption();
+    const QCommandLineOption polygon_option("polygon", "Region as lat,long pairs separated by ';'.", "polygon");
+    const QCommandLineOption bbox_option("bbox", "Region as bounding box lat_min,long_min,lat_max,long_max.", "bbox");
+    const QCommandLineOption zoom_option("max-zoom", "Highest zoom level of the downloaded tiles.", "zoom", "16");
+    const QCommandLineOption concurrency_option("concurrency", "Number of quads in flight.", "n", "16");
+    const QCommandLineOption rate_option("rate", "Maximum number of quad requests per second.", "n", "100");
+    const QCommandLineOption output_option("output", "Directory of the tile pack.", "path", QString::fromStdString(Scheduler::disk_cache_path().string()));
+    parser.addOptions({ polygon_option, bbox_option, zoom_option, concurrency_option, rate_option, output_option });
+    parser.process(app);
+
+    const auto polygon = parse_polygon(parser.value(polygon_option), parser.value(bbox_option));
+    if (polygon.size() < 3) {
+        std::cerr << "A region is required, either --polygon or --bbox." << std::endl;
+        parser.showHelp(1);
+    }
+    const auto max_zoom = parser.value(zoom_option).toUInt();
+    const auto concurrency = std::max(1u, parser.value(concurrency_option).toUInt());
+    const auto rate = std::max(1u, parser.value(rate_option).toUInt());
+
+    // same sources and loading chain as nucleus::Controller
+    TileLoadService terrain_service("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZXY, ".png");
+    TileLoadService ortho_service("https://gataki.cg.tuwien.ac.at/raw/basemap/tiles/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg");
+    RegionSeeder seeder;
+    SlotLimiter slot_limiter;
+    RateLimiter rate_limiter;
+    QuadAssembler quad_assembler;
+    LayerAssembler layer_assembler;
+    seeder.set_concurrency(concurrency);
+    slot_limiter.set_limit(concurrency);
+    rate_limiter.set_limit(rate, 1000);
+
+    QObject::connect(&seeder, &RegionSeeder::quads_requested, &slot_limiter, &SlotLimiter::request_quads);
+    QObject::connect(&slot_limiter, &SlotLimiter::quad_requested, &rate_limiter, &RateLimiter::request_quad);
+    QObject::connect(&rate_limiter, &RateLimiter::quad_requested, &quad_assembler, &QuadAssembler::load);
+    QObject::connect(&quad_assembler, &QuadAssembler::tile_requested, &layer_assembler, &LayerAssembler::load);
+    QObject::connect(&layer_assembler, &LayerAssembler::tile_requested, &ortho_service, &TileLoadService::load);
+    QObject::connect(&layer_assembler, &LayerAssembler::tile_requested, &terrain_service, &TileLoadService::load);
+    QObject::connect(&ortho_service, &TileLoadService::load_finished, &layer_assembler, &LayerAssembler::deliver_ortho);
+    QObject::connect(&terrain_service, &TileLoadService::load_finished, &layer_assembler, &LayerAssembler::deliver_height);
+    QObject::connect(&layer_assembler, &LayerAssembler::tile_loaded, &quad_assembler, &QuadAssembler::deliver_tile);
+    QObject::connect(&quad_assembler, &QuadAssembler::quad_loaded, &slot_limiter, &SlotLimiter::deliver_quad);
+    QObject::connect(&slot_limiter, &SlotLimiter::quad_delivered, &seeder, &RegionSeeder::receive_quad);
+    // partial quads that time out in the quad assembler cancel their missing tiles
+    QObject::connect(&quad_assembler, &QuadAssembler::tiles_cancelled, &layer_assembler, &LayerAssembler::cancel_tiles);
+    QObject::connect(&layer_assembler, &LayerAssembler::tiles_cancelled, &ortho_service, &TileLoadService::cancel);
+    QObject::connect(&layer_assembler, &LayerAssembler::tiles_cancelled, &terrain_service, &TileLoadService::cancel);
+
+    const auto output = std::filesystem::path(parser.value(output_option).toStdString());
+    const auto prepared = seeder.prepare(output, RegionSeeder::quads_in_polygon(polygon, max_zoom));
+    if (!prepared.has_value()) {
+        std::cerr << "Couldn't open the tile pack in " << output << ": " << prepared.error() << std::endl;
+        return 1;
+    }
+    std::cout << fmt::format("seeding {} quads up to zoom level {} into {}", seeder.statistics().n_quads_total, max_zoom, output.string()) << std::endl;
+
+    QTimer report_timer;
+    RegionSeeder::Statistics last_progress = seeder.statistics();
+    QObject::connect(&seeder, &RegionSeeder::progress, [&last_progress](const RegionSeeder::Statistics& stats) { last_progress = stats; });
+    QObject::connect(&report_timer, &QTimer::timeout, [&last_progress]() { std::cout << format_statistics(last_progress) << std::endl; });
+    report_timer.start(1000);
+
+    QObject::connect(&seeder, &RegionSeeder::finished, &app, [](const RegionSeeder::Statistics& stats) {
+        std::cout << "done: " << format_statistics(stats) << std::endl;
+        QCoreApplication::exit(stats.n_quads_failed == 0 ? 0 : 2); // 2: run again to retry the failed quads
+    });
+    QObject::connect(&seeder, &RegionSeeder::failed, &app, [](const QString& message) {
+        std::cerr << "seeding failed: " << message.toStdString() << std::endl;
+        QCoreApplication::exit(1);
+    });
+    QTimer::singleShot(0, &seeder, &RegionSeeder::start);
+    return QCoreApplication::exec();
+}
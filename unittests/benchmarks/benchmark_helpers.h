@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <random>
+#include <vector>
+
+#include <QFile>
+
+#include "nucleus/camera/PositionStorage.h"
+#include "nucleus/tile_scheduler/utils.h"
+#include "radix/TileHeights.h"
+#include "radix/tile.h"
+
+namespace benchmark_helpers {
+
+// all inputs are derived from this seed, so that every run (and every commit) measures the same work
+constexpr unsigned seed = 20260101;
+
+/// a connected quad tree with at least n_tiles tiles (root included): leaves are refined in random order, which gives
+/// deep and shallow branches similar to a cache filled by several cameras.
+inline std::vector<tile::Id> random_quad_tree(unsigned n_tiles, unsigned max_zoom_level = 18)
+{
+    std::mt19937 rng(seed);
+    std::vector<tile::Id> tiles = { tile::Id { 0, { 0, 0 } } };
+    std::vector<tile::Id> leaves = tiles;
+    while (tiles.size() < n_tiles && !leaves.empty()) {
+        const auto index = std::uniform_int_distribution<size_t>(0, leaves.size() - 1)(rng);
+        const auto leaf = leaves[index];
+        leaves[index] = leaves.back();
+        leaves.pop_back();
+        if (leaf.zoom_level >= max_zoom_level)
+            continue;
+        for (const auto& child : leaf.children()) {
+            tiles.push_back(child);
+            leaves.push_back(child);
+        }
+    }
+    return tiles;
+}
+
+/// the height bounds that ship with the renderer (also used by the scheduler)
+inline nucleus::tile_scheduler::utils::AabbDecoratorPtr aabb_decorator()
+{
+    QFile file(":/map/height_data.atb");
+    const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+    assert(open);
+    Q_UNUSED(open);
+    return nucleus::tile_scheduler::utils::AabbDecorator::make(TileHeights::deserialise(file.readAll()));
+}
+
+/// mountains, a valley, a city and a close up, at 1080p
+inline std::vector<nucleus::camera::Definition> cameras()
+{
+    auto cameras = std::vector {
+        nucleus::camera::stored_positions::grossglockner(),
+        nucleus::camera::stored_positions::karwendel(),
+        nucleus::camera::stored_positions::oestl_hochgrubach_spitze(),
+        nucleus::camera::stored_positions::schneeberg(),
+        nucleus::camera::stored_positions::wien(),
+        nucleus::camera::stored_positions::stephansdom_closeup(),
+    };
+    for (auto& camera : cameras)
+        camera.set_viewport_size({ 1920, 1080 });
+    return cameras;
+}
+
+} // namespace benchmark_helpers
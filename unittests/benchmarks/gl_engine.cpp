@@ -0,0 +1,240 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <random>
+
+#include <QImage>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "UnittestGLContext.h"
+#include "benchmark_helpers.h"
+#include "gl_engine/Framebuffer.h"
+#include "gl_engine/ShaderProgram.h"
+#include "gl_engine/StagingRing.h"
+#include "gl_engine/Texture.h"
+#include "gl_engine/TileManager.h"
+#include "nucleus/tile_scheduler/tile_types.h"
+#include "nucleus/utils/ColourTexture.h"
+
+using gl_engine::Framebuffer;
+using gl_engine::Texture;
+using nucleus::utils::ColourTexture;
+
+namespace {
+// noise compresses badly and can't be special cased by the driver
+QImage random_image(unsigned size)
+{
+    std::mt19937 rng(benchmark_helpers::seed);
+    QImage image(int(size), int(size), QImage::Format_RGBX8888);
+    for (int row = 0; row < image.height(); ++row) {
+        auto* line = image.scanLine(row);
+        for (int i = 0; i < image.bytesPerLine(); ++i)
+            line[i] = uchar(rng());
+    }
+    return image;
+}
+
+nucleus::Raster<uint16_t> random_heights(unsigned size)
+{
+    std::mt19937 rng(benchmark_helpers::seed);
+    nucleus::Raster<uint16_t> raster(glm::uvec2(size, size));
+    for (auto& v : raster)
+        v = uint16_t(rng());
+    return raster;
+}
+
+void finish() { QOpenGLContext::currentContext()->functions()->glFinish(); }
+
+std::string mega_bytes(size_t n_bytes) { return std::to_string(n_bytes / 1024 / 1024) + "." + std::to_string(n_bytes * 10 / 1024 / 1024 % 10) + " MB"; }
+
+// the instance attributes of the tile shader and nothing else, i.e., the cpu side of TileManager::draw
+const char* const tile_vertex_source = R"(
+layout(location = 0) in highp vec4 bounds;
+void main() {
+    gl_Position = vec4(bounds.xy * 0.0, 0.0, 1.0);
+})";
+const char* const tile_fragment_source = R"(
+out lowp vec4 out_color;
+void main() {
+    out_color = vec4(1.0);
+})";
+} // namespace
+
+TEST_CASE("gl_engine/Texture upload benchmarks")
+{
+    UnittestGLContext::initialise();
+
+    constexpr unsigned ortho_size = 256;
+    constexpr unsigned height_size = 65;
+    const auto image = random_image(ortho_size);
+    const auto mip_levels = gl_engine::TileManager::ortho_mip_levels(ortho_size);
+    const auto rgba = ColourTexture(image, ColourTexture::Format::Uncompressed_RGBA, mip_levels);
+    // the driver supports one of dxt1 and etc1/2 (see Texture::compression_algorithm), that's the one that's measured
+    const auto compressed = ColourTexture(image, Texture::compression_algorithm(), mip_levels);
+    const auto compressed_name = Texture::compression_algorithm() == ColourTexture::Format::DXT1 ? std::string("DXT1") : std::string("ETC1");
+    const auto heights = random_heights(height_size);
+
+    for (const unsigned n_layers : { 1u, 64u, 512u }) {
+        const auto layers = " x " + std::to_string(n_layers) + " layers";
+
+        {
+            Texture texture(Texture::Target::_2dArray, Texture::Format::RGBA8);
+            texture.setParams(Texture::Filter::MipMapLinear, Texture::Filter::Linear);
+            texture.allocate_array(ortho_size, ortho_size, n_layers);
+            BENCHMARK("upload RGBA8, " + mega_bytes(rgba.n_bytes() * n_layers) + layers)
+            {
+                for (unsigned i = 0; i < n_layers; ++i)
+                    texture.upload(rgba, i);
+                finish();
+            };
+        }
+        {
+            Texture texture(Texture::Target::_2dArray, Texture::Format::CompressedRGBA8);
+            texture.setParams(Texture::Filter::MipMapLinear, Texture::Filter::Linear);
+            texture.allocate_array(ortho_size, ortho_size, n_layers);
+            BENCHMARK("upload " + compressed_name + ", " + mega_bytes(compressed.n_bytes() * n_layers) + layers)
+            {
+                for (unsigned i = 0; i < n_layers; ++i)
+                    texture.upload(compressed, i);
+                finish();
+            };
+            gl_engine::StagingRing staging(4 * 1024 * 1024);
+            BENCHMARK("upload " + compressed_name + " via StagingRing, " + mega_bytes(compressed.n_bytes() * n_layers) + layers)
+            {
+                for (unsigned i = 0; i < n_layers; ++i)
+                    texture.upload(compressed, i, &staging);
+                finish();
+            };
+        }
+        {
+            Texture texture(Texture::Target::_2dArray, Texture::Format::R16UI);
+            texture.setParams(Texture::Filter::Nearest, Texture::Filter::Nearest);
+            texture.allocate_array(height_size, height_size, n_layers);
+            BENCHMARK("upload R16UI, " + mega_bytes(heights.buffer_length() * sizeof(uint16_t) * n_layers) + layers)
+            {
+                for (unsigned i = 0; i < n_layers; ++i)
+                    texture.upload(heights, i);
+                finish();
+            };
+        }
+    }
+}
+
+TEST_CASE("gl_engine/Framebuffer benchmarks")
+{
+    UnittestGLContext::initialise();
+    auto* f = QOpenGLContext::currentContext()->extraFunctions();
+
+    {
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 1920, 1080 });
+        b.bind();
+        f->glClearColor(0.5f, 0.25f, 0.125f, 1.f);
+        BENCHMARK("read_colour_attachment_pixel RGBA8, after a clear")
+        {
+            f->glClear(GL_COLOR_BUFFER_BIT);
+            return b.read_colour_attachment_pixel<glm::u8vec4>(0, glm::dvec2(0.0, 0.0));
+        };
+        BENCHMARK("read_colour_attachment_pixel RGBA8, idle")
+        {
+            return b.read_colour_attachment_pixel<glm::u8vec4>(0, glm::dvec2(0.0, 0.0));
+        };
+    }
+    {
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA32F }, { 1920, 1080 });
+        b.bind();
+        BENCHMARK("read_colour_attachment_pixel RGBA32F, after a clear")
+        {
+            f->glClear(GL_COLOR_BUFFER_BIT);
+            return b.read_colour_attachment_pixel<glm::vec4>(0, glm::dvec2(0.0, 0.0));
+        };
+    }
+    {
+        // the gbuffer of the renderer
+        Framebuffer b(Framebuffer::DepthFormat::Float32,
+            { Framebuffer::ColourFormat::RGB8, Framebuffer::ColourFormat::RGBA32F, Framebuffer::ColourFormat::RG16UI, Framebuffer::ColourFormat::R32UI },
+            { 1920, 1080 });
+        bool toggle = false;
+        BENCHMARK("resize, depth + 4 colour attachments, 1920x1080 <-> 1280x720")
+        {
+            toggle = !toggle;
+            b.resize(toggle ? glm::uvec2(1280, 720) : glm::uvec2(1920, 1080));
+            finish();
+        };
+    }
+    Framebuffer::unbind();
+}
+
+TEST_CASE("gl_engine/TileManager draw benchmarks")
+{
+    UnittestGLContext::initialise();
+
+    const auto image = random_image(256);
+    const auto ortho = std::make_shared<const ColourTexture>(image, Texture::compression_algorithm(), gl_engine::TileManager::ortho_mip_levels());
+    const auto height = std::make_shared<const nucleus::Raster<uint16_t>>(random_heights(65));
+    const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+
+    gl_engine::ShaderProgram shader(tile_vertex_source, tile_fragment_source, gl_engine::ShaderCodeSource::PLAINTEXT);
+    Framebuffer framebuffer(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 256, 256 });
+    framebuffer.bind();
+    shader.bind();
+
+    for (const unsigned n_quads : { 64u, 256u, 1024u }) {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(n_quads);
+        tile_manager.init();
+        tile_manager.initilise_attribute_locations(&shader);
+        tile_manager.set_upload_budget({ 0.f, 0 });
+
+        std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad> quads;
+        for (unsigned i = 0; i < n_quads; ++i) {
+            nucleus::tile_scheduler::tile_types::GpuTileQuad quad;
+            quad.id = tile::Id { 10, { 500 + i % 32, 600 + i / 32 } };
+            const auto children = quad.id.children();
+            for (size_t j = 0; j < 4; ++j)
+                quad.tiles[j] = { children[j], {}, ortho, height };
+            quads.push_back(std::move(quad));
+        }
+        tile_manager.update_gpu_quads(quads, {});
+        tile_manager.process_upload_queue(camera);
+        REQUIRE(tile_manager.tiles().size() == n_quads * 4);
+
+        nucleus::tile_scheduler::DrawListGenerator::TileSet pass;
+        for (const auto& tileset : tile_manager.tiles())
+            pass.insert(tileset.tile_id);
+        const auto n_tiles = " " + std::to_string(pass.size()) + " tiles";
+
+        BENCHMARK("prepare_draw," + n_tiles)
+        {
+            return tile_manager.prepare_draw(camera, { &pass, 1 }, camera.position()).size();
+        };
+        const auto ranges = tile_manager.prepare_draw(camera, { &pass, 1 }, camera.position());
+        BENCHMARK("draw," + n_tiles)
+        {
+            tile_manager.draw(ranges.front());
+        };
+        BENCHMARK("draw, 4 views," + n_tiles)
+        {
+            tile_manager.draw(ranges.front(), 4);
+        };
+        finish();
+    }
+    Framebuffer::unbind();
+}
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+#include <vector>
+
+#include <QFile>
+#include <QImage>
+
+#include "nucleus/utils/ColourTexture.h"
+#include "nucleus/utils/pixel_kernels.h"
+#include "nucleus/utils/tile_conversion.h"
+
+namespace {
+QByteArray read_test_file(const char* name)
+{
+    QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, name));
+    const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+    REQUIRE(open);
+    return file.readAll();
+}
+} // namespace
+
+TEST_CASE("nucleus/utils/ColourTexture benchmarks")
+{
+    using nucleus::utils::ColourTexture;
+    const auto ortho = nucleus::utils::tile_conversion::toQImage(read_test_file("test-tile_ortho.jpeg"));
+    REQUIRE(!ortho.isNull());
+    const auto ortho_rgbx = ortho.convertedTo(QImage::Format_RGBX8888);
+    const auto size = std::to_string(ortho.width()) + "x" + std::to_string(ortho.height());
+
+    BENCHMARK("DXT1, " + size)
+    {
+        return ColourTexture(ortho_rgbx, ColourTexture::Format::DXT1);
+    };
+    BENCHMARK("ETC1, " + size)
+    {
+        return ColourTexture(ortho_rgbx, ColourTexture::Format::ETC1);
+    };
+    // as decoded by qt (argb32), includes the conversion to rgbx
+    BENCHMARK("DXT1 from decoded jpeg, " + size)
+    {
+        return ColourTexture(ortho, ColourTexture::Format::DXT1);
+    };
+}
+
+TEST_CASE("nucleus/utils/tile_conversion benchmarks")
+{
+    const auto height = nucleus::utils::tile_conversion::toQImage(read_test_file("test-tile.png"));
+    REQUIRE(!height.isNull());
+
+    BENCHMARK("qImage2uint16Raster, " + std::to_string(height.width()) + "x" + std::to_string(height.height()))
+    {
+        return nucleus::utils::tile_conversion::qImage2uint16Raster(height);
+    };
+}
+
+TEST_CASE("nucleus/utils/pixel_kernels benchmarks")
+{
+    namespace kernels = nucleus::utils::pixel_kernels;
+    // a 512 px ortho tile, and the same number of height texels
+    constexpr size_t n_pixels = 512 * 512;
+    std::vector<uint32_t> argb(n_pixels);
+    uint32_t state = 1234567;
+    for (auto& p : argb)
+        p = state = state * 1664525u + 1013904223u;
+    std::vector<uint8_t> rgba(n_pixels * 4);
+    std::vector<uint16_t> heights(n_pixels);
+    const auto simd = std::string(" (") + kernels::simd_target() + ")";
+
+    BENCHMARK("argb32_to_rgba8, scalar")
+    {
+        kernels::scalar::argb32_to_rgba8(argb.data(), rgba.data(), n_pixels, true);
+        return rgba[0];
+    };
+    BENCHMARK("argb32_to_rgba8" + simd)
+    {
+        kernels::argb32_to_rgba8(argb.data(), rgba.data(), n_pixels, true);
+        return rgba[0];
+    };
+    BENCHMARK("argb32_to_height, scalar")
+    {
+        kernels::scalar::argb32_to_height(argb.data(), heights.data(), n_pixels);
+        return heights[0];
+    };
+    BENCHMARK("argb32_to_height" + simd)
+    {
+        kernels::argb32_to_height(argb.data(), heights.data(), n_pixels);
+        return heights[0];
+    };
+    const auto* bytes = reinterpret_cast<const uint8_t*>(argb.data());
+    BENCHMARK("rgba8_to_height, scalar")
+    {
+        kernels::scalar::rgba8_to_height(bytes, heights.data(), n_pixels);
+        return heights[0];
+    };
+    BENCHMARK("rgba8_to_height" + simd)
+    {
+        kernels::rgba8_to_height(bytes, heights.data(), n_pixels);
+        return heights[0];
+    };
+}
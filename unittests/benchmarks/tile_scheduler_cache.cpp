@@ -0,0 +1,132 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <filesystem>
+#include <random>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <QStandardPaths>
+
+#include "benchmark_helpers.h"
+#include "nucleus/tile_scheduler/Cache.h"
+
+namespace {
+struct VisitTile {
+    tile::Id id;
+};
+struct DiskTile {
+    tile::Id id;
+    std::shared_ptr<QByteArray> data;
+    static constexpr std::array<char, 25> version_information = { "benchmark DiskTile" };
+};
+static_assert(nucleus::tile_scheduler::tile_types::SerialisableTile<DiskTile>);
+
+template <typename T, typename Make>
+void fill(nucleus::tile_scheduler::Cache<T>& cache, const std::vector<tile::Id>& ids, const Make& make)
+{
+    for (const auto& id : ids)
+        cache.insert(make(id));
+}
+
+// visits random subtrees a couple of times, so that the visited stamps (and therefore the purge order) are mixed
+template <typename T>
+void age(nucleus::tile_scheduler::Cache<T>& cache)
+{
+    std::mt19937 rng(benchmark_helpers::seed);
+    std::bernoulli_distribution descend(0.8);
+    for (int i = 0; i < 8; ++i)
+        cache.visit([&](const T&) { return descend(rng); });
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/Cache benchmarks")
+{
+    for (const unsigned n_tiles : { 10000u, 50000u }) {
+        const auto ids = benchmark_helpers::random_quad_tree(n_tiles);
+        const auto n = std::to_string(ids.size());
+
+        nucleus::tile_scheduler::Cache<VisitTile> cache;
+        fill(cache, ids, [](const tile::Id& id) { return VisitTile { id }; });
+        REQUIRE(cache.n_cached_objects() == ids.size());
+
+        BENCHMARK("visit all, " + n + " tiles")
+        {
+            unsigned n_visited = 0;
+            cache.visit([&](const VisitTile&) {
+                ++n_visited;
+                return true;
+            });
+            return n_visited;
+        };
+
+        BENCHMARK("visit_readonly to zoom level 10, " + n + " tiles")
+        {
+            unsigned n_visited = 0;
+            cache.visit_readonly([&](const VisitTile& tile) {
+                ++n_visited;
+                return tile.id.zoom_level < 10;
+            });
+            return n_visited;
+        };
+
+        BENCHMARK_ADVANCED("purge to half, " + n + " tiles")(Catch::Benchmark::Chronometer meter)
+        {
+            // every run needs a full cache, they are filled outside of the measurement
+            std::vector<nucleus::tile_scheduler::Cache<VisitTile>> caches(size_t(meter.runs()));
+            for (auto& c : caches) {
+                fill(c, ids, [](const tile::Id& id) { return VisitTile { id }; });
+                age(c);
+            }
+            meter.measure([&](int i) { return caches[size_t(i)].purge(unsigned(ids.size() / 2)); });
+        };
+    }
+}
+
+TEST_CASE("nucleus/tile_scheduler/Cache disk benchmarks")
+{
+    const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "benchmark_tile_cache";
+    std::filesystem::remove_all(path);
+
+    // 2000 tiles with 20 kb each, roughly the size of a compressed ortho + height quad
+    const auto ids = benchmark_helpers::random_quad_tree(2000);
+    std::mt19937 rng(benchmark_helpers::seed);
+    nucleus::tile_scheduler::Cache<DiskTile> cache;
+    fill(cache, ids, [&](const tile::Id& id) {
+        auto data = std::make_shared<QByteArray>(20 * 1024, Qt::Uninitialized);
+        for (auto& c : *data)
+            c = char(rng());
+        return DiskTile { id, std::move(data) };
+    });
+    const auto n = std::to_string(ids.size());
+
+    BENCHMARK("write_to_disk, " + n + " tiles")
+    {
+        std::filesystem::remove_all(path);
+        return cache.write_to_disk(path).has_value();
+    };
+
+    REQUIRE(cache.write_to_disk(path).has_value());
+    BENCHMARK("read_from_disk, " + n + " tiles")
+    {
+        nucleus::tile_scheduler::Cache<DiskTile> read_cache;
+        const auto result = read_cache.read_from_disk(path);
+        return result.has_value() && read_cache.n_cached_objects() == ids.size();
+    };
+    std::filesystem::remove_all(path);
+}
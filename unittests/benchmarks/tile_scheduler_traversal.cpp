@@ -0,0 +1,122 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "benchmark_helpers.h"
+#include "nucleus/tile_scheduler/DrawListGenerator.h"
+#include "radix/quad_tree.h"
+
+namespace {
+std::vector<tile::Id> refined_tiles(const nucleus::camera::Definition& camera, const nucleus::tile_scheduler::utils::AabbDecoratorPtr& decorator, float error_threshold_px)
+{
+    std::vector<tile::Id> tiles;
+    quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, nucleus::tile_scheduler::utils::refineFunctor(camera, decorator, error_threshold_px), [&tiles](const tile::Id& v) {
+        tiles.push_back(v);
+        return v.children();
+    });
+    return tiles;
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/utils benchmarks")
+{
+    const auto decorator = benchmark_helpers::aabb_decorator();
+    const auto cameras = benchmark_helpers::cameras();
+
+    BENCHMARK("refineFunctor traversal, " + std::to_string(cameras.size()) + " cameras, 2 px")
+    {
+        size_t n_tiles = 0;
+        for (const auto& camera : cameras)
+            n_tiles += refined_tiles(camera, decorator, 2).size();
+        return n_tiles;
+    };
+
+    // the boxes of all tiles the scheduler would consider for the cameras, and a random tree for boxes outside
+    std::vector<tile::SrsAndHeightBounds> aabbs;
+    for (const auto& camera : cameras) {
+        for (const auto& id : refined_tiles(camera, decorator, 2))
+            aabbs.push_back(decorator->aabb(id));
+    }
+    for (const auto& id : benchmark_helpers::random_quad_tree(10000, 14))
+        aabbs.push_back(decorator->aabb(id));
+
+    std::vector<nucleus::camera::Frustum> frustums;
+    for (const auto& camera : cameras)
+        frustums.push_back(camera.frustum());
+
+    BENCHMARK("camera_frustum_contains_tile, " + std::to_string(aabbs.size() * frustums.size()) + " tests")
+    {
+        unsigned n_contained = 0;
+        for (const auto& frustum : frustums) {
+            for (const auto& aabb : aabbs)
+                n_contained += nucleus::tile_scheduler::utils::camera_frustum_contains_tile(frustum, aabb);
+        }
+        return n_contained;
+    };
+}
+
+TEST_CASE("nucleus/tile_scheduler/DrawListGenerator benchmarks")
+{
+    const auto decorator = benchmark_helpers::aabb_decorator();
+    const auto cameras = benchmark_helpers::cameras();
+
+    // the gpu tiles after flying to all cameras (as in the draw list generator unittest)
+    nucleus::tile_scheduler::DrawListGenerator draw_list_generator;
+    draw_list_generator.set_aabb_decorator(decorator);
+    quad_tree::onTheFlyTraverse(
+        tile::Id { 0, { 0, 0 } }, [](const tile::Id& v) { return v.zoom_level < 7; },
+        [&](const tile::Id& v) {
+            draw_list_generator.add_tile(v);
+            return v.children();
+        });
+    for (const auto& camera : cameras) {
+        for (const auto& id : refined_tiles(camera, decorator, 1))
+            draw_list_generator.add_tile(id);
+    }
+
+    nucleus::tile_scheduler::DrawListGenerator::TileSet list;
+    nucleus::tile_scheduler::DrawListGenerator::TileSet culled;
+    nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks partial_tiles;
+
+    BENCHMARK("generate_for, " + std::to_string(cameras.size()) + " cameras")
+    {
+        size_t n_tiles = 0;
+        for (const auto& camera : cameras) {
+            partial_tiles.clear_retaining_storage();
+            draw_list_generator.generate_for(camera, &list, &partial_tiles);
+            n_tiles += list.size();
+        }
+        return n_tiles;
+    };
+
+    std::vector<nucleus::tile_scheduler::DrawListGenerator::TileSet> lists;
+    for (const auto& camera : cameras)
+        lists.push_back(draw_list_generator.generate_for(camera));
+
+    BENCHMARK("cull, " + std::to_string(cameras.size()) + " cameras")
+    {
+        size_t n_tiles = 0;
+        for (size_t i = 0; i < cameras.size(); ++i) {
+            draw_list_generator.cull(lists[i], cameras[i].frustum(), &culled);
+            n_tiles += culled.size();
+        }
+        return n_tiles;
+    };
+}
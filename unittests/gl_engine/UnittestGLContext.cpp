@@ -27,6 +27,8 @@
 #include <QTimer>
 #include <catch2/catch_test_macros.hpp>
 
+#include "gl_engine/GlState.h"
+
 UnittestGLContext::UnittestGLContext()
 {
     QSurfaceFormat surface_format;
@@ -73,4 +75,5 @@ void UnittestGLContext::initialise()
 {
     static std::unique_ptr<UnittestGLContext> s_instance = std::unique_ptr<UnittestGLContext>(new UnittestGLContext());
     QObject::connect(QCoreApplication::instance(), &QCoreApplication::destroyed, []() { s_instance.reset(); });
+    gl_engine::GlState::current().invalidate(); // the tests mix raw gl calls with the engine's
 }
@@ -25,6 +25,7 @@
 #include <QFile>
 #include <QGuiApplication>
 #include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
 #include <QOpenGLDebugLogger>
 #include <QOpenGLExtraFunctions>
 #include <QRgb>
@@ -33,7 +34,11 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include "gl_engine/FrameCapture.h"
 #include "gl_engine/Framebuffer.h"
+#include "gl_engine/GlCounters.h"
+#include "gl_engine/GlState.h"
+#include "gl_engine/RenderTargetPool.h"
 #include "gl_engine/ShaderProgram.h"
 #include "gl_engine/helpers.h"
 #include "nucleus/utils/bit_coding.h"
@@ -95,6 +100,121 @@ TEST_CASE("gl framebuffer")
         }
         CHECK(good);
     }
+    SECTION("shader defines")
+    {
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 4, 4 });
+        b.bind();
+        ShaderProgram shader = create_debug_shader(R"(
+            #ifndef DEBUG_COLOUR
+            #define DEBUG_COLOUR vec4(1.0, 0.0, 0.0, 1.0)
+            #endif
+            out lowp vec4 out_Color;
+            void main() {
+                out_Color = DEBUG_COLOUR;
+            })");
+        const auto draw_and_read = [&]() {
+            shader.bind();
+            gl_engine::helpers::create_screen_quad_geometry().draw();
+            return b.read_colour_attachment(0).pixel(1, 1);
+        };
+        CHECK(draw_and_read() == qRgba(255, 0, 0, 255));
+        shader.set_defines("#define DEBUG_COLOUR vec4(0.0, 1.0, 0.0, 1.0)\n");
+        CHECK(draw_and_read() == qRgba(0, 255, 0, 255));
+        shader.set_defines("");
+        CHECK(draw_and_read() == qRgba(255, 0, 0, 255)); // the generic variant is reused
+        shader.set_defines("#define DEBUG_COLOUR broken\n");
+        CHECK(shader.defines().isEmpty()); // compilation failed, the previous program stays
+        CHECK(draw_and_read() == qRgba(255, 0, 0, 255));
+        Framebuffer::unbind();
+    }
+    SECTION("uniform handles")
+    {
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 4, 4 });
+        b.bind();
+        ShaderProgram shader = create_debug_shader(R"(
+            uniform lowp vec4 colours[2];
+            uniform lowp float scale;
+            out lowp vec4 out_Color;
+            void main() {
+            #ifdef SECOND
+                out_Color = colours[1] * scale;
+            #else
+                out_Color = colours[0] * scale;
+            #endif
+            })");
+        const auto colours = shader.uniform<glm::vec4>("colours[0]");
+        const auto scale = shader.uniform<float>("scale");
+        CHECK(shader.uniform<float>("scale").index == scale.index);
+        const auto draw_and_read = [&]() {
+            shader.bind();
+            shader.set_uniform_array(colours, std::vector { glm::vec4(1, 0, 0, 1), glm::vec4(0, 0, 1, 1) });
+            shader.set_uniform(scale, 1);
+            gl_engine::helpers::create_screen_quad_geometry().draw();
+            return b.read_colour_attachment(0).pixel(1, 1);
+        };
+        CHECK(draw_and_read() == qRgba(255, 0, 0, 255));
+        shader.set_defines("#define SECOND\n"); // the handles are resolved for the new variant
+        CHECK(draw_and_read() == qRgba(0, 0, 255, 255));
+        Framebuffer::unbind();
+    }
+    SECTION("gl state")
+    {
+        auto& state = gl_engine::GlState::current();
+        const auto bound = [&](GLenum binding) {
+            GLint value = -1;
+            f->glGetIntegerv(binding, &value);
+            return value;
+        };
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 4, 4 });
+        b.bind();
+        CHECK(bound(GL_FRAMEBUFFER_BINDING) != 0);
+        f->glBindFramebuffer(GL_FRAMEBUFFER, 0); // behind the cache's back
+        b.bind();
+        CHECK(bound(GL_FRAMEBUFFER_BINDING) == 0); // elided
+        state.invalidate();
+        b.bind();
+        CHECK(bound(GL_FRAMEBUFFER_BINDING) != 0);
+
+        b.bind_colour_texture(0, 3);
+        f->glActiveTexture(GL_TEXTURE3);
+        const auto texture = bound(GL_TEXTURE_BINDING_2D);
+        CHECK(texture != 0);
+        state.invalidate();
+        state.bind_texture(3, GL_TEXTURE_2D, 0);
+        CHECK(bound(GL_TEXTURE_BINDING_2D) == 0);
+        b.bind_colour_texture(0, 3);
+        CHECK(bound(GL_TEXTURE_BINDING_2D) == texture);
+
+        state.set_enabled(GL_BLEND, true);
+        CHECK(f->glIsEnabled(GL_BLEND));
+        state.set_enabled(GL_BLEND, false);
+        CHECK(!f->glIsEnabled(GL_BLEND));
+        Framebuffer::unbind();
+    }
+    SECTION("gl counters")
+    {
+        auto& counters = gl_engine::GlCounters::current();
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 4, 4 });
+        b.bind();
+        ShaderProgram shader = create_debug_shader();
+        shader.bind();
+        const auto quad = gl_engine::helpers::create_screen_quad_geometry();
+        quad.draw(); // disables the depth test, the draws below don't change any state
+        counters.begin_frame();
+        {
+            const gl_engine::ScopedGlPass pass(gl_engine::GlCounters::Pass::Compose);
+            quad.draw();
+            quad.draw();
+        }
+        quad.draw();
+        const auto& compose = counters.counts()[unsigned(gl_engine::GlCounters::Pass::Compose)];
+        CHECK(compose.draw_calls == 2);
+        CHECK(compose.vertices == 6);
+        CHECK(counters.counts()[unsigned(gl_engine::GlCounters::Pass::Other)].draw_calls == 1);
+        CHECK(counters.total().draw_calls == 3);
+        CHECK(counters.total().state_changes == 0);
+        Framebuffer::unbind();
+    }
     // Only color renderable on WEBGL with EXT_color_buffer_float extension
     SECTION("rgba32f color format")
     {
@@ -226,6 +346,39 @@ TEST_CASE("gl framebuffer")
             return b.read_colour_attachment(0);
         };
     }
+#endif
+#ifndef __EMSCRIPTEN__
+    SECTION("asynchronous frame capture")
+    {
+        QOpenGLFramebufferObject fbo(64, 32);
+        fbo.bind();
+        std::vector<std::pair<QImage, uint64_t>> frames;
+        gl_engine::FrameCapture capture([&](QImage image, uint64_t tag) { frames.emplace_back(std::move(image), tag); }, 2);
+        for (uint64_t i = 0; i < 5; ++i) {
+            // blue, with a red top half
+            f->glDisable(GL_SCISSOR_TEST);
+            f->glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
+            f->glClear(GL_COLOR_BUFFER_BIT);
+            f->glEnable(GL_SCISSOR_TEST);
+            f->glScissor(0, 16, 64, 16);
+            f->glClearColor(1.0f, 0.0f, float(i) / 255.0f, 1.0f);
+            f->glClear(GL_COLOR_BUFFER_BIT);
+            f->glDisable(GL_SCISSOR_TEST);
+            capture.capture(fbo.handle(), { 64, 32 }, i);
+            CHECK(capture.n_in_flight() <= 2); // waits instead of dropping
+        }
+        capture.collect(true);
+        CHECK(capture.n_in_flight() == 0);
+        fbo.release();
+        REQUIRE(frames.size() == 5);
+        for (uint64_t i = 0; i < 5; ++i) {
+            CHECK(frames[i].second == i);
+            const auto& image = frames[i].first;
+            REQUIRE(image.size() == QSize(64, 32));
+            CHECK(image.pixel(10, 2) == qRgba(255, 0, int(i), 255)); // top row first
+            CHECK(image.pixel(10, 30) == qRgba(0, 0, 255, 255));
+        }
+    }
 #endif
     SECTION("read pixel")
     {
@@ -243,6 +396,31 @@ TEST_CASE("gl framebuffer")
         CHECK(pixel[2] == unsigned(1.0f * 255));
         CHECK(pixel[3] == unsigned(0.8f * 255));
     }
+    SECTION("blit colour attachment")
+    {
+        Framebuffer b(Framebuffer::DepthFormat::None, {Framebuffer::ColourFormat::RGBA8, Framebuffer::ColourFormat::RGBA8}, {512, 256});
+        b.bind();
+        ShaderProgram shader = create_debug_shader(R"(
+            layout (location = 0) out lowp vec4 out_Color;
+            layout (location = 1) out lowp vec4 out_Color2;
+            void main() {
+                out_Color = vec4(0.0, 0.0, 0.0, 0.0);
+                out_Color2 = vec4(0.2, 0.0, 1.0, 0.8);
+            }
+        )");
+        shader.bind();
+        gl_engine::helpers::create_screen_quad_geometry().draw();
+
+        Framebuffer target(Framebuffer::DepthFormat::None, {Framebuffer::ColourFormat::RGBA8}, {128, 64});
+        b.blit_colour_attachment(1, &target);
+        auto pixel = target.read_colour_attachment_pixel<glm::u8vec4>(0, glm::dvec2(0.5, -0.5));
+
+        Framebuffer::unbind();
+        CHECK(pixel[0] == unsigned(0.2f * 255));
+        CHECK(pixel[1] == unsigned(0.0f * 255));
+        CHECK(pixel[2] == unsigned(1.0f * 255));
+        CHECK(pixel[3] == unsigned(0.8f * 255));
+    }
     SECTION("f32 depth buffer")
     {
         QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
@@ -279,4 +457,54 @@ TEST_CASE("gl framebuffer")
         const auto value_at_0_0 = b2.read_colour_attachment_pixel<glm::vec4>(0, glm::dvec2(-1.0, -1.0));
         CHECK(value_at_0_0.x == Catch::Approx(0.42));
     }
+    SECTION("render target pool")
+    {
+        using gl_engine::RenderTargetDescription;
+        gl_engine::RenderTargetPool pool;
+        pool.set_trim_after_frames(3);
+        const RenderTargetDescription r8 { .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = { 64, 32 } };
+
+        // targets released within a frame are handed to the next pass (aliasing)
+        auto* a = pool.acquire(r8);
+        auto* b = pool.acquire(r8);
+        CHECK(a != b);
+        pool.release(a);
+        CHECK(pool.acquire(r8) == a);
+        auto* rgba = pool.acquire({ .colour_formats = { Framebuffer::ColourFormat::RGBA8 }, .size = { 64, 32 } });
+        CHECK(rgba != a);
+        CHECK(rgba != b);
+        CHECK(pool.n_targets() == 3);
+        CHECK(pool.n_acquired() == 3);
+        pool.end_frame();
+        CHECK(pool.n_acquired() == 0);
+        CHECK(pool.n_allocations() == 3);
+
+        // and across frames, non exact targets only grow
+        CHECK(pool.acquire(r8) == a);
+        CHECK(pool.acquire({ .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = { 128, 16 } }) == b);
+        CHECK(b->size() == glm::uvec2(128, 32));
+        CHECK(pool.n_allocations() == 4);
+        pool.end_frame();
+        CHECK(pool.acquire({ .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = { 60, 30 } }) == a);
+        CHECK(a->size() == glm::uvec2(64, 32));
+        CHECK(pool.n_allocations() == 4);
+
+        // exact targets are reallocated on every change
+        const RenderTargetDescription exact { .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = { 60, 30 }, .exact_size = true };
+        auto* c = pool.acquire(exact);
+        CHECK(c != a);
+        CHECK(c != b);
+        CHECK(c->size() == glm::uvec2(60, 30));
+        pool.end_frame();
+
+        // oversized targets are trimmed, unused ones deleted
+        for (int i = 0; i < 3; ++i) {
+            CHECK(pool.acquire({ .colour_formats = { Framebuffer::ColourFormat::R8 }, .size = { 60, 30 } }) == a);
+            CHECK(pool.acquire(exact) == c);
+            pool.end_frame();
+        }
+        CHECK(a->size() == glm::uvec2(60, 30));
+        CHECK(pool.n_targets() == 2); // b and the rgba target were deleted
+        Framebuffer::unbind();
+    }
 }
@@ -0,0 +1,49 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+#include <glm/glm.hpp>
+
+#include "gl_engine/ShadowMapping.h"
+#include "nucleus/camera/Definition.h"
+
+using gl_engine::ShadowMapping;
+
+TEST_CASE("gl_engine/shadow_mapping")
+{
+    SECTION("casters get a smaller light space depth than their receivers")
+    {
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        const std::vector<tile::SrsAndHeightBounds> tile_bounds = { { { -1000, -1000, 0 }, { 1000, 1000, 500 } } };
+        for (const auto& light_dir : { glm::dvec3(0, 0, 1), glm::normalize(glm::dvec3(1, 0, 1)), glm::normalize(glm::dvec3(-1, 2, 1)) }) {
+            const auto world_to_clip = ShadowMapping::getLightSpaceMatrix(1.0f, 200.0f, camera, light_dir, tile_bounds, 1024);
+            const auto receiver = glm::dvec3(world_to_clip * glm::dvec4(0, 0, 0, 1));
+            const auto caster = glm::dvec3(world_to_clip * glm::dvec4(glm::dvec3(0, 0, 0) + light_dir * 100.0, 1));
+            // further towards the sun than the bounding sphere of the cascade, but within the tile bounds
+            const auto far_caster = glm::dvec3(world_to_clip * glm::dvec4(glm::dvec3(0, 0, 0) + light_dir * 400.0, 1));
+            CHECK(caster.z < receiver.z);
+            CHECK(far_caster.z < caster.z);
+            for (const auto& p : { receiver, caster, far_caster }) {
+                CHECK(p.z >= -1.0);
+                CHECK(p.z <= 1.0);
+            }
+            CHECK(std::abs(caster.x - receiver.x) < 1e-6); // along the light direction, so the same texel
+            CHECK(std::abs(caster.y - receiver.y) < 1e-6);
+        }
+    }
+}
@@ -30,7 +30,9 @@
 
 #include "UnittestGLContext.h"
 #include "gl_engine/Framebuffer.h"
+#include "gl_engine/GpuMemory.h"
 #include "gl_engine/ShaderProgram.h"
+#include "gl_engine/StagingRing.h"
 #include "gl_engine/helpers.h"
 #include "nucleus/utils/ColourTexture.h"
 
@@ -98,10 +100,26 @@ TEST_CASE("gl texture")
             const auto compressed = ColourTexture(test_texture, ColourTexture::Format::ETC1);
             CHECK(compressed.n_bytes() == 256 * 128);
         }
+        {
+            const auto compressed = ColourTexture(test_texture, ColourTexture::Format::ETC2);
+            CHECK(compressed.n_bytes() == 256 * 128);
+        }
         {
             const auto compressed = ColourTexture(test_texture, ColourTexture::Format::Uncompressed_RGBA);
             CHECK(compressed.n_bytes() == 256 * 256 * 4);
         }
+        {
+            // compressed chains stop at 16x16: 256, 128, 64, 32, 16
+            CHECK(ColourTexture::max_mip_levels(256, 256, ColourTexture::Format::DXT1) == 5);
+            CHECK(ColourTexture::max_mip_levels(256, 256, ColourTexture::Format::Uncompressed_RGBA) == 9);
+            const auto compressed = ColourTexture(test_texture, ColourTexture::Format::DXT1, 5);
+            CHECK(compressed.n_mip_levels() == 5);
+            CHECK(compressed.n_bytes() == (256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16) / 2);
+            CHECK(compressed.mip_width(4) == 16);
+            CHECK(compressed.mip_n_bytes(4) == 16 * 16 / 2);
+            CHECK(compressed.mip_data(1) == compressed.data() + 256 * 128);
+            CHECK(std::equal(compressed.data(), compressed.data() + 256 * 128, ColourTexture(test_texture, ColourTexture::Format::DXT1).data()));
+        }
     }
 
     SECTION("verify test methodology")
@@ -334,6 +352,50 @@ TEST_CASE("gl texture")
         }
     }
 
+    SECTION("compressed rgba array with mipmaps")
+    {
+        Framebuffer framebuffer(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8 }, { 16, 16 });
+        framebuffer.bind();
+
+        gl_engine::Texture opengl_texture(gl_engine::Texture::Target::_2dArray, gl_engine::Texture::Format::CompressedRGBA8);
+        opengl_texture.bind(0);
+        opengl_texture.setParams(gl_engine::Texture::Filter::MipMapLinear, gl_engine::Texture::Filter::Linear);
+        opengl_texture.allocate_array(256, 256, 2);
+        const auto n_levels = ColourTexture::max_mip_levels(256, 256, gl_engine::Texture::compression_algorithm());
+        {
+            QImage test_texture(256, 256, QImage::Format_ARGB32);
+            test_texture.fill(qRgba(222, 111, 0, 255));
+            opengl_texture.upload(ColourTexture(test_texture, gl_engine::Texture::compression_algorithm(), n_levels), 0);
+        }
+        {
+            // a checker board of 1 pixel is grey in the coarsest level
+            QImage test_texture(256, 256, QImage::Format_ARGB32);
+            for (int i = 0; i < 256; ++i) {
+                for (int j = 0; j < 256; ++j)
+                    test_texture.setPixel(i, j, (i + j) % 2 ? qRgba(255, 255, 255, 255) : qRgba(0, 0, 0, 255));
+            }
+            opengl_texture.upload(ColourTexture(test_texture, gl_engine::Texture::compression_algorithm(), n_levels), 1);
+        }
+        ShaderProgram shader = create_debug_shader(R"(
+            uniform lowp sampler2DArray texture_sampler;
+            in highp vec2 texcoords;
+            layout (location = 0) out lowp vec4 out_color_0;
+            void main() {
+                lowp vec4 a = textureLod(texture_sampler, vec3(texcoords.x, 1.0 - texcoords.y, 0.0), 4.0);
+                lowp vec4 b = textureLod(texture_sampler, vec3(texcoords.x, 1.0 - texcoords.y, 1.0), 4.0);
+                out_color_0 = vec4(a.rg, b.r, 1.0);
+            }
+        )");
+        shader.bind();
+        gl_engine::helpers::create_screen_quad_geometry().draw();
+
+        const QImage render_result = framebuffer.read_colour_attachment(0);
+        Framebuffer::unbind();
+        CHECK(std::abs(qRed(render_result.pixel(8, 8)) - 222) < 8);
+        CHECK(std::abs(qGreen(render_result.pixel(8, 8)) - 111) < 8);
+        CHECK(std::abs(qBlue(render_result.pixel(8, 8)) - 128) < 16);
+    }
+
     SECTION("red16 array")
     {
         Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8, Framebuffer::ColourFormat::RGBA8 }, { 1, 1 });
@@ -383,4 +445,82 @@ TEST_CASE("gl texture")
             CHECK(qAlpha(render_result.pixel(0, 0)) == 255);
         }
     }
+    SECTION("array uploads through the staging ring")
+    {
+        if (!gl_engine::StagingRing::is_supported())
+            return; // webgl
+        Framebuffer b(Framebuffer::DepthFormat::None, { Framebuffer::ColourFormat::RGBA8, Framebuffer::ColourFormat::RGBA8 }, { 1, 1 });
+        b.bind();
+
+        // tiny, so that it wraps around and waits for the fences. the heights fit, the 16x16 rgba texture doesn't (client memory fallback)
+        gl_engine::StagingRing staging(512);
+        gl_engine::Texture heights(gl_engine::Texture::Target::_2dArray, gl_engine::Texture::Format::R16UI);
+        heights.allocate_array(1, 1, 2);
+        heights.setParams(gl_engine::Texture::Filter::Nearest, gl_engine::Texture::Filter::Nearest);
+        gl_engine::Texture colours(gl_engine::Texture::Target::_2dArray, gl_engine::Texture::Format::RGBA8);
+        colours.setParams(gl_engine::Texture::Filter::Nearest, gl_engine::Texture::Filter::Nearest);
+        colours.allocate_array(16, 16, 1);
+        for (int i = 0; i < 10; ++i) {
+            heights.upload(nucleus::Raster<uint16_t>({ 1, 1 }, uint16_t(((120 + i) * 65535) / 255)), 0, &staging);
+            heights.upload(nucleus::Raster<uint16_t>({ 1, 1 }, uint16_t(((180 + i) * 65535) / 255)), 1, &staging);
+        }
+        QImage colour_image(16, 16, QImage::Format_ARGB32);
+        colour_image.fill(qRgba(42, 142, 242, 255));
+        colours.upload(ColourTexture(colour_image, ColourTexture::Format::Uncompressed_RGBA), 0, &staging);
+
+        ShaderProgram shader = create_debug_shader(R"(
+            uniform mediump usampler2DArray texture_sampler;
+            uniform lowp sampler2DArray colour_sampler;
+            layout (location = 0) out lowp vec4 out_color1;
+            layout (location = 1) out lowp vec4 out_color2;
+            void main() {
+                highp float v0 = float(texture(texture_sampler, vec3(0.5, 0.5, 0)).r);
+                highp float v1 = float(texture(texture_sampler, vec3(0.5, 0.5, 1)).r);
+                out_color1 = vec4(v0 / 65535.0, v1 / 65535.0, 0, 1);
+                out_color2 = texture(colour_sampler, vec3(0.5, 0.5, 0));
+            }
+        )");
+        shader.set_sampler_unit("texture_sampler", 0);
+        shader.set_sampler_unit("colour_sampler", 1); // assigned without binding the program
+        shader.bind();
+        heights.bind(0);
+        colours.bind(1);
+        gl_engine::helpers::create_screen_quad_geometry().draw();
+
+        const QImage heights_result = b.read_colour_attachment(0);
+        CHECK(qRed(heights_result.pixel(0, 0)) == 129);
+        CHECK(qGreen(heights_result.pixel(0, 0)) == 189);
+        const QImage colours_result = b.read_colour_attachment(1);
+        CHECK(qRed(colours_result.pixel(0, 0)) == 42);
+        CHECK(qGreen(colours_result.pixel(0, 0)) == 142);
+        CHECK(qBlue(colours_result.pixel(0, 0)) == 242);
+    }
+    SECTION("gpu memory accounting")
+    {
+        const auto bytes_of = [](const std::string& subsystem) -> uint64_t {
+            for (const auto& entry : gl_engine::gpu_memory::usage()) {
+                if (entry.subsystem == subsystem)
+                    return entry.n_bytes;
+            }
+            return 0;
+        };
+        const auto total = gl_engine::gpu_memory::total_bytes();
+        {
+            gl_engine::Texture heights(gl_engine::Texture::Target::_2dArray, gl_engine::Texture::Format::R16UI);
+            heights.set_memory_subsystem("test heights");
+            heights.setParams(gl_engine::Texture::Filter::Nearest, gl_engine::Texture::Filter::Nearest);
+            heights.allocate_array(64, 32, 3);
+            CHECK(bytes_of("test heights") == 64 * 32 * 2 * 3);
+
+            Framebuffer b(Framebuffer::DepthFormat::Float32, { Framebuffer::ColourFormat::RGBA8, Framebuffer::ColourFormat::R8 }, { 8, 4 });
+            b.set_memory_subsystem("test framebuffer");
+            CHECK(bytes_of("test framebuffer") == 8 * 4 * (4 + 4 + 1));
+            b.resize({ 16, 4 });
+            CHECK(bytes_of("test framebuffer") == 16 * 4 * (4 + 4 + 1));
+            CHECK(gl_engine::gpu_memory::total_bytes() == total + 64 * 32 * 2 * 3 + 16 * 4 * 9);
+        }
+        CHECK(bytes_of("test heights") == 0);
+        CHECK(bytes_of("test framebuffer") == 0);
+        CHECK(gl_engine::gpu_memory::total_bytes() == total);
+    }
 }
@@ -0,0 +1,385 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <array>
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QThread>
+#include <catch2/catch_test_macros.hpp>
+
+#include "UnittestGLContext.h"
+#include "gl_engine/Texture.h"
+#include "gl_engine/TileManager.h"
+#include "nucleus/tile_scheduler/tile_types.h"
+#include "radix/TileHeights.h"
+
+using nucleus::tile_scheduler::tile_types::GpuTileQuad;
+
+namespace {
+GpuTileQuad make_quad(const tile::Id& id, const nucleus::tile_scheduler::tile_types::TileFormat& format = {})
+{
+    QImage image(int(format.ortho_size), int(format.ortho_size), QImage::Format_ARGB32);
+    image.fill(qRgba(42, 142, 242, 255));
+    const auto ortho = std::make_shared<const nucleus::utils::ColourTexture>(
+        image, gl_engine::Texture::compression_algorithm(), gl_engine::TileManager::ortho_mip_levels(format.ortho_size));
+    const auto height = std::make_shared<const nucleus::Raster<uint16_t>>(glm::uvec2(format.height_size), uint16_t(0));
+    GpuTileQuad quad;
+    quad.id = id;
+    const auto children = id.children();
+    for (size_t i = 0; i < 4; ++i)
+        quad.tiles[i] = { children[i], {}, ortho, height };
+    return quad;
+}
+} // namespace
+
+TEST_CASE("gl_engine/tile_manager")
+{
+    UnittestGLContext::initialise();
+
+    SECTION("uploads are queued and spread over frames, coarse tiles first")
+    {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        tile_manager.set_upload_budget({ 0.f, 1 }); // one quad per frame
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+
+        const auto root = tile::Id { 0, { 0, 0 } };
+        const auto child = tile::Id { 1, { 0, 0 } };
+        tile_manager.update_gpu_quads({ make_quad(child), make_quad(root) }, {});
+        CHECK(tile_manager.tiles().empty());
+        CHECK(tile_manager.n_queued_tiles() == 8);
+
+        CHECK(tile_manager.process_upload_queue(camera));
+        REQUIRE(tile_manager.tiles().size() == 4);
+        // the tiles of a quad are in consecutive layers, in the order of the quad
+        const auto children = root.children();
+        for (unsigned i = 0; i < 4; ++i) {
+            CHECK(tile_manager.tiles()[i].tile_id == children[i]);
+            CHECK(tile_manager.tiles()[i].texture_layer == tile_manager.tiles()[0].texture_layer + i);
+        }
+        CHECK(tile_manager.tiles()[0].texture_layer % 4 == 0);
+        CHECK(tile_manager.n_queued_tiles() == 4);
+
+        // queued tiles of deleted quads never reach the gpu
+        tile_manager.update_gpu_quads({}, { child });
+        CHECK(tile_manager.n_queued_tiles() == 0);
+        CHECK(tile_manager.tiles().size() == 4);
+        CHECK(!tile_manager.process_upload_queue(camera));
+
+        // unlimited
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        tile_manager.update_gpu_quads({ make_quad(child) }, {});
+        CHECK(!tile_manager.process_upload_queue(camera));
+        CHECK(tile_manager.tiles().size() == 8);
+    }
+    SECTION("background uploads with a shared context")
+    {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        auto surface = std::make_shared<QOffscreenSurface>();
+        surface->setFormat(QOpenGLContext::currentContext()->format());
+        surface->create();
+        if (!tile_manager.enable_background_uploads(surface))
+            return; // webgl, or the platform doesn't share contexts
+        CHECK(tile_manager.has_background_uploads());
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+
+        const auto root = tile::Id { 0, { 0, 0 } };
+        const auto child = tile::Id { 1, { 0, 0 } };
+        tile_manager.update_gpu_quads({ make_quad(root), make_quad(child) }, {});
+        CHECK(tile_manager.n_queued_tiles() == 8);
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.n_queued_tiles() == 0); // handed over at once
+
+        // removed while in flight, the layer comes back after the upload
+        tile_manager.update_gpu_quads({}, { child });
+        for (int i = 0; i < 1000 && tile_manager.process_upload_queue(camera); ++i)
+            QThread::msleep(1);
+        CHECK(!tile_manager.process_upload_queue(camera));
+        CHECK(tile_manager.tiles().size() == 4);
+
+        tile_manager.update_gpu_quads({ make_quad(child) }, {});
+        for (int i = 0; i < 1000 && tile_manager.process_upload_queue(camera); ++i)
+            QThread::msleep(1);
+        CHECK(tile_manager.tiles().size() == 8);
+    }
+    SECTION("the tile pool is resized at runtime")
+    {
+        gl_engine::TileManager tile_manager;
+        std::vector<unsigned> announced_limits;
+        unsigned n_releases = 0;
+        QObject::connect(&tile_manager, &gl_engine::TileManager::quad_limit_changed, [&](unsigned limit) { announced_limits.push_back(limit); });
+        QObject::connect(&tile_manager, &gl_engine::TileManager::gpu_tiles_released, [&]() { ++n_releases; });
+        tile_manager.set_quad_limit(1);
+        tile_manager.init();
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        const auto root = tile::Id { 0, { 0, 0 } };
+        const auto child = tile::Id { 1, { 0, 0 } };
+        tile_manager.update_gpu_quads({ make_quad(root) }, {});
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.tiles().size() == 4);
+        CHECK(announced_limits == std::vector<unsigned> { 1 });
+
+        // growing is announced once the arrays are reallocated
+        tile_manager.set_quad_limit(2);
+        CHECK(announced_limits.size() == 1);
+        CHECK(tile_manager.allocated_quad_limit() == 1);
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.allocated_quad_limit() == 2);
+        CHECK(announced_limits.back() == 2);
+        if (gl_engine::Texture::can_copy_layers()) {
+            CHECK(tile_manager.tiles().size() == 4);
+            CHECK(n_releases == 0);
+        } else {
+            CHECK(tile_manager.tiles().empty());
+            CHECK(n_releases == 1);
+            tile_manager.update_gpu_quads({ make_quad(root) }, {}); // the scheduler sends them again
+        }
+        tile_manager.update_gpu_quads({ make_quad(child) }, {});
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.tiles().size() == 8);
+
+        // shrinking is announced right away, and waits for the scheduler to delete the surplus
+        tile_manager.set_quad_limit(1);
+        CHECK(announced_limits.back() == 1);
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.allocated_quad_limit() == 2);
+        tile_manager.update_gpu_quads({}, { root });
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.allocated_quad_limit() == 1);
+        if (gl_engine::Texture::can_copy_layers()) {
+            REQUIRE(tile_manager.tiles().size() == 4);
+            for (const auto& tileset : tile_manager.tiles()) {
+                CHECK(tileset.tile_id.zoom_level == 2);
+                CHECK(tileset.texture_layer < 4);
+            }
+        } else {
+            CHECK(tile_manager.tiles().empty());
+            tile_manager.update_gpu_quads({}, { child }); // sent before the scheduler knew, ignored
+        }
+    }
+    SECTION("pools beyond the array layer limit are split into pages")
+    {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_max_layers_per_page(4);
+        tile_manager.set_quad_limit(2);
+        tile_manager.init();
+        CHECK(tile_manager.n_texture_pages() == 2);
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        const auto root = tile::Id { 0, { 0, 0 } };
+        const auto child = tile::Id { 1, { 0, 0 } };
+        tile_manager.update_gpu_quads({ make_quad(root), make_quad(child) }, {});
+        tile_manager.process_upload_queue(camera);
+        REQUIRE(tile_manager.tiles().size() == 8);
+
+        nucleus::tile_scheduler::DrawListGenerator::TileSet pass;
+        for (const auto& tileset : tile_manager.tiles())
+            pass.insert(tileset.tile_id);
+        const auto& ranges = tile_manager.prepare_draw(camera, { &pass, 1 }, camera.position());
+        REQUIRE(ranges.size() == 1);
+        CHECK(ranges.front().count == 8);
+        const auto n_lods = gl_engine::TileManager::N_MESH_LODS;
+        for (unsigned page = 0; page < gl_engine::TileManager::MAX_TEXTURE_PAGES; ++page) {
+            unsigned n_page_tiles = 0;
+            for (unsigned lod = 0; lod < n_lods; ++lod)
+                n_page_tiles += ranges.front().batch_counts[page * n_lods + lod];
+            CHECK(n_page_tiles == (page < 2 ? 4u : 0u));
+        }
+
+        // capped to what fits into the pages
+        tile_manager.set_quad_limit(1000);
+        CHECK(tile_manager.quad_limit() == gl_engine::TileManager::MAX_TEXTURE_PAGES);
+    }
+
+    SECTION("indirect draw commands cover the batches of a range")
+    {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        if (!tile_manager.set_indirect_draws(true))
+            return; // gles, webgl
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        tile_manager.update_gpu_quads({ make_quad(tile::Id { 0, { 0, 0 } }), make_quad(tile::Id { 1, { 0, 0 } }) }, {});
+        tile_manager.process_upload_queue(camera);
+        REQUIRE(tile_manager.tiles().size() == 8);
+
+        nucleus::tile_scheduler::DrawListGenerator::TileSet all;
+        for (const auto& tileset : tile_manager.tiles())
+            all.insert(tileset.tile_id);
+        const std::array passes = { all, all };
+        const auto& ranges = tile_manager.prepare_draw(camera, passes, camera.position());
+        REQUIRE(ranges.size() == 2);
+        for (const auto& range : ranges) {
+            for (unsigned n_views = 1; n_views <= gl_engine::TileManager::MAX_INDIRECT_VIEWS; ++n_views) {
+                const auto commands = tile_manager.draw_commands(range, n_views);
+                REQUIRE(!commands.empty());
+                auto first = range.first;
+                for (const auto& command : commands) {
+                    CHECK(command.base_instance == first);
+                    CHECK(command.instance_count % n_views == 0);
+                    CHECK(command.count > 0);
+                    first += command.instance_count / n_views;
+                }
+                CHECK(first == range.first + range.count);
+            }
+            CHECK(tile_manager.draw_commands(range, gl_engine::TileManager::MAX_INDIRECT_VIEWS + 1).empty());
+        }
+
+        tile_manager.set_indirect_draws(false);
+        const auto& instanced_ranges = tile_manager.prepare_draw(camera, passes, camera.position());
+        CHECK(tile_manager.draw_commands(instanced_ranges.front()).empty());
+    }
+
+    SECTION("gpu culling gives the same tiles as the cpu, once the result is back")
+    {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        if (!tile_manager.set_gpu_culling(true))
+            return; // webgl
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        const auto root = tile::Id { 0, { 0, 0 } };
+        tile_manager.update_gpu_quads({ make_quad(root), make_quad(tile::Id { 1, { 0, 0 } }) }, {});
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        tile_manager.process_upload_queue(camera);
+        REQUIRE(tile_manager.tiles().size() == 8);
+
+        nucleus::tile_scheduler::DrawListGenerator::TileSet all;
+        for (const auto& tileset : tile_manager.tiles())
+            all.insert(tileset.tile_id);
+        nucleus::tile_scheduler::DrawListGenerator::TileSet cpu;
+        tile_manager.cull(all, camera.frustum(), &cpu);
+        REQUIRE(!cpu.empty());
+
+        const std::array frusta = { camera.frustum() };
+        const auto version = tile_manager.gpu_culling_version();
+        for (int i = 0; i < 1000 && tile_manager.start_gpu_culling(frusta, camera.position()) && tile_manager.gpu_culling_version() == version; ++i)
+            QOpenGLContext::currentContext()->functions()->glFinish();
+        CHECK(tile_manager.gpu_culling_version() != version);
+
+        // the gpu boxes are grown by the margin, so it can keep more tiles, but never fewer
+        nucleus::tile_scheduler::DrawListGenerator::TileSet gpu;
+        tile_manager.cull(all, camera.frustum(), &gpu, 0u);
+        for (const auto& id : cpu)
+            CHECK(gpu.contains(id));
+        CHECK(gpu.size() <= all.size());
+
+        // the masks are dropped when the gpu tiles change
+        tile_manager.update_gpu_quads({}, { tile::Id { 1, { 0, 0 } } });
+        nucleus::tile_scheduler::DrawListGenerator::TileSet after_removal;
+        tile_manager.cull(all, camera.frustum(), &after_removal, 0u);
+        nucleus::tile_scheduler::DrawListGenerator::TileSet cpu_after_removal;
+        tile_manager.cull(all, camera.frustum(), &cpu_after_removal);
+        CHECK(after_removal == cpu_after_removal);
+    }
+
+    SECTION("curtains only on edges without a matching neighbour")
+    {
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        tile_manager.set_mesh_lod_quad_size(0); // all tiles on the finest lod
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        tile_manager.update_gpu_quads({ make_quad(tile::Id { 0, { 0, 0 } }) }, {});
+        tile_manager.process_upload_queue(camera);
+        REQUIRE(tile_manager.tiles().size() == 4);
+
+        constexpr auto east = 1, north = 2, west = 4, south = 8;
+        const auto south_west = tile::Id { 1, { 0, 0 } };
+        const auto north_east = tile::Id { 1, { 1, 1 } };
+        const std::array passes = {
+            nucleus::tile_scheduler::DrawListGenerator::TileSet { south_west, { 1, { 1, 0 } }, { 1, { 0, 1 } }, north_east },
+            nucleus::tile_scheduler::DrawListGenerator::TileSet { south_west, north_east }, // only diagonal neighbours
+        };
+        const auto& ranges = tile_manager.prepare_draw(camera, passes, camera.position());
+        REQUIRE(ranges.size() == 2);
+        CHECK(tile_manager.curtain_edges(ranges[0], south_west) == (west | south));
+        CHECK(tile_manager.curtain_edges(ranges[0], north_east) == (east | north));
+        CHECK(tile_manager.curtain_edges(ranges[1], south_west) == gl_engine::TileManager::ALL_CURTAIN_EDGES);
+        CHECK(tile_manager.curtain_edges(ranges[1], north_east) == gl_engine::TileManager::ALL_CURTAIN_EDGES);
+    }
+
+    SECTION("the draw list is generated on a worker thread during the frame")
+    {
+#if defined(__EMSCRIPTEN__) && !defined(ALP_ENABLE_THREADING)
+        return; // generated on the render thread
+#endif
+        gl_engine::TileManager tile_manager;
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        TileHeights heights;
+        heights.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+        tile_manager.set_aabb_decorator(nucleus::tile_scheduler::utils::AabbDecorator::make(heights));
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        const auto root = tile::Id { 0, { 0, 0 } };
+        const auto child = tile::Id { 1, { 0, 0 } };
+        tile_manager.update_gpu_quads({ make_quad(root) }, {});
+        tile_manager.process_upload_queue(camera);
+        const auto coarse = tile_manager.generate_tilelist(camera);
+        REQUIRE(!coarse.empty());
+
+        // tiles that become resident meanwhile are in the next list
+        const auto moved = nucleus::camera::Definition({ 0, -110, 100 }, { 0, 0, 0 });
+        const auto version = tile_manager.draw_list_version();
+        tile_manager.start_tilelist(moved);
+        tile_manager.update_gpu_quads({ make_quad(child) }, {});
+        tile_manager.process_upload_queue(moved);
+        CHECK(tile_manager.generate_tilelist(moved) == coarse);
+        CHECK(tile_manager.draw_list_version() == version + 1);
+        const auto fine = tile_manager.generate_tilelist(moved);
+        CHECK(tile_manager.draw_list_version() == version + 2);
+        CHECK(std::any_of(fine.begin(), fine.end(), [](const tile::Id& id) { return id.zoom_level == 2; }));
+
+        // a list of another camera, or with tiles that were removed meanwhile, is not used
+        tile_manager.start_tilelist(camera);
+        CHECK(tile_manager.generate_tilelist(moved) == fine);
+        tile_manager.start_tilelist(camera);
+        tile_manager.update_gpu_quads({}, { child });
+        CHECK(tile_manager.generate_tilelist(camera) == coarse);
+    }
+
+    SECTION("larger tile formats")
+    {
+        gl_engine::TileManager tile_manager;
+        CHECK(tile_manager.mesh_lod_edge_vertices(0) == 65);
+        CHECK(tile_manager.mesh_lod_edge_vertices(3) == 9);
+        const auto format = nucleus::tile_scheduler::tile_types::TileFormat { 512, 129 };
+        tile_manager.set_tile_format(format);
+        CHECK(tile_manager.mesh_lod_edge_vertices(0) == 129);
+        CHECK(tile_manager.mesh_lod_edge_vertices(1) == 65);
+        CHECK(tile_manager.mesh_lod_edge_vertices(3) == 17);
+        tile_manager.set_quad_limit(4);
+        tile_manager.init();
+        tile_manager.set_upload_budget({ 0.f, 0 });
+        const auto camera = nucleus::camera::Definition({ 0, -100, 100 }, { 0, 0, 0 });
+        tile_manager.update_gpu_quads({ make_quad(tile::Id { 0, { 0, 0 } }, format) }, {});
+        tile_manager.process_upload_queue(camera);
+        CHECK(tile_manager.tiles().size() == 4);
+    }
+}
@@ -182,6 +182,17 @@ TEST_CASE("gl uniformbuffer")
         const auto value_at_0_0 = b.read_colour_attachment_pixel<glm::u8vec4>(0, glm::dvec2(-1.0, -1.0));
         CHECK(value_at_0_0.x == 255u);
     }
+    SECTION("only changed data is uploaded")
+    {
+        auto ubo = std::make_unique<gl_engine::UniformBuffer<gl_engine::uboShadowConfig>>(0, "shadow_config");
+        ubo->init();
+        CHECK(ubo->update_gpu_data() == false);
+        ubo->data.shadowmap_size.y = 400.0;
+        CHECK(ubo->update_gpu_data() == true);
+        CHECK(ubo->update_gpu_data() == false);
+        ubo->data.shadowmap_size.y = 400.0;
+        CHECK(ubo->update_gpu_data() == false);
+    }
     SECTION("encode decode shared buffer as base64 string")
     {
         auto byteLength = sizeof(gl_engine::uboSharedConfig);
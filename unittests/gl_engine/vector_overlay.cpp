@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "gl_engine/VectorOverlay.h"
+
+using gl_engine::VectorOverlay;
+
+TEST_CASE("gl_engine/vector_overlay")
+{
+    SECTION("tracks are split into chunks of consecutive segments with their bounds")
+    {
+        std::vector<VectorOverlay::Track> tracks(3);
+        for (unsigned i = 0; i < 2500; ++i)
+            tracks[0].points.push_back({ double(i), -double(i) });
+        tracks[1].points = { { 5.0, 5.0 } }; // no segment
+        tracks[2].points = { { 10.0, 20.0 }, { -10.0, 30.0 } };
+
+        const auto chunks = VectorOverlay::chunks(tracks);
+        REQUIRE(chunks.size() == 4);
+        CHECK(chunks[0].track == 0);
+        CHECK(chunks[0].first_point == 0);
+        CHECK(chunks[0].n_segments == VectorOverlay::chunk_size);
+        CHECK(chunks[1].first_point == VectorOverlay::chunk_size); // the last point of a chunk starts the next one
+        CHECK(chunks[2].n_segments == 2499 - 2 * VectorOverlay::chunk_size);
+        CHECK(chunks[1].min == glm::dvec2(1024, -2048));
+        CHECK(chunks[1].max == glm::dvec2(2048, -1024));
+
+        CHECK(chunks[3].track == 2);
+        CHECK(chunks[3].first_point == 2501);
+        CHECK(chunks[3].n_segments == 1);
+        CHECK(chunks[3].min == glm::dvec2(-10, 20));
+        CHECK(chunks[3].max == glm::dvec2(10, 30));
+    }
+
+    SECTION("level windows are nested, and only move in steps of an eighth of their extent")
+    {
+        const auto camera = glm::dvec2(1500010.0, 5900010.0);
+        for (unsigned level = 0; level < VectorOverlay::n_levels; ++level) {
+            const auto window = VectorOverlay::level_window(camera, 1000, level);
+            CHECK(window.z == 1000 * double(1u << (2 * level)));
+            // the camera is well inside
+            CHECK(camera.x - window.x >= window.z * 7 / 16);
+            CHECK(window.x + window.z - camera.x >= window.z * 7 / 16);
+            CHECK(camera.y - window.y >= window.z * 7 / 16);
+            CHECK(window.y + window.z - camera.y >= window.z * 7 / 16);
+        }
+        const auto window = VectorOverlay::level_window(camera, 1000, 0);
+        CHECK(VectorOverlay::level_window(camera + glm::dvec2(40, -40), 1000, 0) == window);
+        CHECK(VectorOverlay::level_window(camera + glm::dvec2(200, 0), 1000, 0) != window);
+        CHECK(VectorOverlay::level_window(camera + glm::dvec2(200, 0), 1000, 1) == VectorOverlay::level_window(camera, 1000, 1));
+    }
+}
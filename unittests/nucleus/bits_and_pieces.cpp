@@ -16,10 +16,31 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <limits>
+
+#include <QBuffer>
+#include <QThread>
 #include <QTimer>
 #include <QtTest/QSignalSpy>
 #include <catch2/catch_test_macros.hpp>
 
+#include "nucleus/utils/MemoryPressureMonitor.h"
+#include "nucleus/utils/SpscMailbox.h"
+#include "nucleus/utils/ThermalMonitor.h"
+#include "nucleus/utils/ThreadPolicy.h"
+#include "nucleus/utils/incremental_sort.h"
+#include "nucleus/utils/jpeg_transcoder.h"
+#include "nucleus/utils/ktx2.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
 #ifdef NDEBUG
 constexpr bool asserts_are_enabled = false;
 #else
@@ -50,3 +71,275 @@ TEST_CASE("nucleus/bits_and_pieces: qt signals and slots")
     spy.wait(20);
     CHECK(spy.size() == 1);
 }
+
+TEST_CASE("nucleus/bits_and_pieces: parsing linux pressure stall information")
+{
+    using nucleus::utils::MemoryPressureMonitor;
+    const QByteArray psi = "some avg10=12.50 avg60=3.00 avg300=0.50 total=123456\nfull avg10=1.00 avg60=0.00 avg300=0.00 total=1234\n";
+    REQUIRE(MemoryPressureMonitor::parse_psi_some_avg10(psi).has_value());
+    CHECK(MemoryPressureMonitor::parse_psi_some_avg10(psi).value() == 12.5f);
+    CHECK(!MemoryPressureMonitor::parse_psi_some_avg10("").has_value());
+    CHECK(!MemoryPressureMonitor::parse_psi_some_avg10("full avg10=1.00 avg60=0.00 avg300=0.00 total=1234").has_value());
+}
+
+TEST_CASE("nucleus/bits_and_pieces: thermal levels")
+{
+    using nucleus::utils::ThermalMonitor;
+    using Level = ThermalMonitor::Level;
+    const auto nan = std::nanf("");
+    CHECK(ThermalMonitor::level_from_android(0, nan) == Level::Nominal);
+    CHECK(ThermalMonitor::level_from_android(2, nan) == Level::Fair);
+    CHECK(ThermalMonitor::level_from_android(3, nan) == Level::Serious);
+    CHECK(ThermalMonitor::level_from_android(6, nan) == Level::Critical);
+    // the forecast raises the level before the status does
+    CHECK(ThermalMonitor::level_from_android(0, 0.5f) == Level::Nominal);
+    CHECK(ThermalMonitor::level_from_android(0, 0.9f) == Level::Fair);
+    CHECK(ThermalMonitor::level_from_android(1, 1.1f) == Level::Serious);
+    CHECK(ThermalMonitor::level_from_android(4, 0.1f) == Level::Critical);
+    CHECK(ThermalMonitor::level_from_ios(2) == Level::Serious);
+    CHECK(ThermalMonitor::level_from_ios(7) == Level::Critical);
+
+    // the reductions only grow with the level
+    for (const auto level : { Level::Fair, Level::Serious, Level::Critical }) {
+        const auto lower = ThermalMonitor::scaling(Level(int(level) - 1));
+        const auto scaling = ThermalMonitor::scaling(level);
+        CHECK(scaling.frame_limit_factor <= lower.frame_limit_factor);
+        CHECK(scaling.error_factor >= lower.error_factor);
+        CHECK(scaling.max_ssao_kernel <= lower.max_ssao_kernel);
+        CHECK(scaling.min_ssao_resolution >= lower.min_ssao_resolution);
+        CHECK((!scaling.shadows || lower.shadows));
+        CHECK((!scaling.ssao || lower.ssao));
+    }
+    CHECK(ThermalMonitor::scaling(Level::Nominal) == ThermalMonitor::Scaling {});
+}
+
+TEST_CASE("nucleus/bits_and_pieces: sorting nearly sorted ranges")
+{
+    using nucleus::utils::sort_nearly_sorted;
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+
+    SECTION("few inversions are repaired without the fallback")
+    {
+        std::swap(values[10], values[11]);
+        std::swap(values[500], values[503]);
+        values.push_back(250); // appended new element
+        CHECK(sort_nearly_sorted(values.begin(), values.end(), std::less<int> {}, values.size()));
+        CHECK(std::is_sorted(values.begin(), values.end()));
+        CHECK(values.size() == 1001);
+    }
+
+    SECTION("too many inversions fall back to std::sort")
+    {
+        std::shuffle(values.begin(), values.end(), std::mt19937(42));
+        CHECK(!sort_nearly_sorted(values.begin(), values.end(), std::less<int> {}, values.size()));
+        CHECK(std::is_sorted(values.begin(), values.end()));
+        for (int i = 0; i < int(values.size()); ++i)
+            CHECK(values[size_t(i)] == i);
+    }
+
+    SECTION("empty and single element ranges")
+    {
+        std::vector<int> empty;
+        CHECK(sort_nearly_sorted(empty.begin(), empty.end(), std::less<int> {}, 0));
+        std::vector<int> one = { 1 };
+        CHECK(sort_nearly_sorted(one.begin(), one.end(), std::less<int> {}, 0));
+    }
+}
+
+TEST_CASE("nucleus/bits_and_pieces: reading ktx2 containers")
+{
+    using nucleus::utils::ColourTexture;
+    namespace ktx2 = nucleus::utils::ktx2;
+    // minimal container with the level data right after the level index (dfd and kvd are not read)
+    const auto make_ktx2 = [](uint32_t vk_format, uint32_t size, uint32_t n_levels, uint32_t supercompression = 0) {
+        QByteArray bytes;
+        const auto put = [&](uint64_t v, int n_bytes) {
+            for (int i = 0; i < n_bytes; ++i)
+                bytes.append(char((v >> (8 * i)) & 0xff));
+        };
+        bytes.append(QByteArray::fromHex("AB4B5458203230BB0D0A1A0A"));
+        for (const auto v : { vk_format, 1u, size, size, 0u, 0u, 1u, n_levels, supercompression })
+            put(v, 4);
+        for (int i = 0; i < 4; ++i)
+            put(0, 4);
+        put(0, 8);
+        put(0, 8);
+        const auto level_bytes = [&](uint32_t level) { return uint64_t(std::max(1u, size >> level)) * std::max(1u, size >> level) / 2; };
+        uint64_t offset = uint64_t(bytes.size()) + n_levels * 24;
+        for (uint32_t level = 0; level < n_levels; ++level) {
+            put(offset, 8);
+            put(level_bytes(level), 8);
+            put(level_bytes(level), 8);
+            offset += level_bytes(level);
+        }
+        for (uint32_t level = 0; level < n_levels; ++level)
+            bytes.append(QByteArray(qsizetype(level_bytes(level)), char(level + 1)));
+        return bytes;
+    };
+
+    CHECK(ktx2::is_ktx2(make_ktx2(131, 256, 1)));
+    CHECK(!ktx2::is_ktx2(QByteArray("\xff\xd8\xff\xe0 jpeg")));
+
+    const auto dxt1 = ktx2::to_colour_texture(make_ktx2(131, 256, 5));
+    REQUIRE(dxt1.has_value());
+    CHECK(dxt1->format() == ColourTexture::Format::DXT1);
+    CHECK(dxt1->width() == 256);
+    CHECK(dxt1->n_mip_levels() == 5);
+    CHECK(dxt1->n_bytes() == ColourTexture::n_bytes_for(256, 256, ColourTexture::Format::DXT1, 5));
+    CHECK(dxt1->mip_data(0)[0] == 1);
+    CHECK(dxt1->mip_data(4)[0] == 5);
+
+    const auto truncated_chain = ktx2::to_colour_texture(make_ktx2(147, 256, 5), 3);
+    REQUIRE(truncated_chain.has_value());
+    CHECK(truncated_chain->format() == ColourTexture::Format::ETC2);
+    CHECK(truncated_chain->n_mip_levels() == 3);
+
+    CHECK(!ktx2::to_colour_texture(make_ktx2(0, 256, 1, 1)).has_value()); // basis lz
+    CHECK(!ktx2::to_colour_texture(make_ktx2(131, 256, 1, 2)).has_value()); // zstd
+    CHECK(!ktx2::to_colour_texture(make_ktx2(131, 256, 2).left(200)).has_value());
+
+    // offset + length of the level wraps around to a small value
+    auto overflowing = make_ktx2(131, 256, 1);
+    const auto level_length = uint64_t(256 * 256 / 2);
+    const auto wrapping_offset = std::numeric_limits<uint64_t>::max() - level_length + 17;
+    for (int i = 0; i < 8; ++i)
+        overflowing[80 + i] = char((wrapping_offset >> (8 * i)) & 0xff);
+    const auto overflowed = ktx2::to_colour_texture(overflowing);
+    REQUIRE(!overflowed.has_value());
+    CHECK(overflowed.error().find("out of bounds") != std::string::npos);
+}
+
+TEST_CASE("nucleus/bits_and_pieces: streaming jpeg transcoder")
+{
+    using nucleus::utils::ColourTexture;
+    namespace jpeg_transcoder = nucleus::utils::jpeg_transcoder;
+    QImage source(256, 256, QImage::Format_RGB32);
+    for (int y = 0; y < 256; ++y) {
+        for (int x = 0; x < 256; ++x)
+            source.setPixel(x, y, qRgb(x, y, (x * y) % 256));
+    }
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    source.save(&buffer, "JPEG", 95);
+    REQUIRE(jpeg.size() > 0);
+
+    for (const auto format : { ColourTexture::Format::DXT1, ColourTexture::Format::ETC2 }) {
+        const auto texture = jpeg_transcoder::to_colour_texture(jpeg, format, 256, 5);
+        REQUIRE(texture.has_value());
+        CHECK(texture->format() == format);
+        CHECK(texture->width() == 256);
+        CHECK(texture->height() == 256);
+        CHECK(texture->n_mip_levels() == 5);
+        CHECK(texture->n_bytes() == ColourTexture::n_bytes_for(256, 256, format, 5));
+#ifndef ALP_ENABLE_TURBOJPEG
+        // same pixels as the full image path (libjpeg-turbo idct differs slightly from qt's decoder)
+        const auto reference = ColourTexture(QImage::fromData(jpeg), format);
+        CHECK(std::equal(reference.data(), reference.data() + reference.n_bytes(), texture->data()));
+#endif
+    }
+
+    CHECK(!jpeg_transcoder::to_colour_texture(jpeg, ColourTexture::Format::Uncompressed_RGBA, 256).has_value());
+    CHECK(!jpeg_transcoder::to_colour_texture(jpeg, ColourTexture::Format::DXT1, 112).has_value()); // not a n/8 scale
+    CHECK(!jpeg_transcoder::to_colour_texture(jpeg, ColourTexture::Format::DXT1, 256, 6).has_value());
+    CHECK(!jpeg_transcoder::to_colour_texture(QByteArray("not a jpeg"), ColourTexture::Format::DXT1, 256).has_value());
+#ifdef ALP_ENABLE_TURBOJPEG
+    CHECK(jpeg_transcoder::to_colour_texture(jpeg, ColourTexture::Format::DXT1, 128).has_value()); // dct scaling
+#endif
+}
+
+TEST_CASE("nucleus/bits_and_pieces: single producer, single consumer mailbox")
+{
+    nucleus::utils::SpscMailbox<std::unique_ptr<int>> mailbox; // move only
+    unsigned n_wake_ups = 0;
+    mailbox.set_wake_up([&]() { ++n_wake_ups; });
+    CHECK(!mailbox.pop());
+    mailbox.push(std::make_unique<int>(1));
+    mailbox.push(std::make_unique<int>(2));
+    mailbox.wake_up();
+    CHECK(n_wake_ups == 1);
+    CHECK(mailbox.size() == 2);
+    CHECK(**mailbox.pop() == 1);
+    CHECK(**mailbox.pop() == 2);
+    CHECK(!mailbox.pop());
+    CHECK(mailbox.size() == 0);
+
+    SECTION("items arrive in order across threads")
+    {
+        constexpr int n = 100000;
+        std::thread producer([&]() {
+            for (int i = 0; i < n; ++i)
+                mailbox.push(std::make_unique<int>(i));
+        });
+        int expected = 0;
+        while (expected < n) {
+            if (auto item = mailbox.pop()) {
+                if (**item != expected)
+                    break;
+                ++expected;
+            }
+        }
+        producer.join();
+        CHECK(expected == n);
+        CHECK(!mailbox.pop());
+    }
+
+    SECTION("items that are not popped are freed with the mailbox")
+    {
+        auto shared = std::make_shared<int>(3);
+        {
+            nucleus::utils::SpscMailbox<std::shared_ptr<int>> other;
+            other.push(shared);
+            other.push(shared);
+            CHECK(shared.use_count() == 3);
+        }
+        CHECK(shared.use_count() == 1);
+    }
+}
+
+TEST_CASE("nucleus/bits_and_pieces: thread policies")
+{
+    using nucleus::utils::ThreadPolicies;
+    using nucleus::utils::ThreadPolicy;
+
+    SECTION("parsing")
+    {
+        CHECK(ThreadPolicy::from_string("low") == ThreadPolicy { QThread::LowPriority });
+        CHECK(ThreadPolicy::from_string("efficiency") == ThreadPolicy { QThread::InheritPriority, ThreadPolicy::Cores::Efficiency });
+        CHECK(ThreadPolicy::from_string("Lowest/performance") == ThreadPolicy { QThread::LowestPriority, ThreadPolicy::Cores::Performance });
+        CHECK(!ThreadPolicy::from_string("fast"));
+
+        const auto policies = ThreadPolicies::from_string("decode=idle, io=normal/any");
+        REQUIRE(policies);
+        CHECK(policies->decode == ThreadPolicy { QThread::IdlePriority });
+        CHECK(policies->io == ThreadPolicy { QThread::NormalPriority });
+        CHECK(policies->scheduler == ThreadPolicies().scheduler);
+        CHECK(ThreadPolicies::from_string("") == ThreadPolicies());
+        CHECK(!ThreadPolicies::from_string("render=high"));
+        CHECK(!ThreadPolicies::from_string("decode"));
+        CHECK(!ThreadPolicies::from_string("decode=fast"));
+    }
+
+    SECTION("core selection by maximum frequency")
+    {
+        const std::vector<uint64_t> big_little = { 1800000, 1800000, 1800000, 1800000, 2400000, 2400000, 3000000, 3000000 };
+        CHECK(ThreadPolicy::select_cores(big_little, ThreadPolicy::Cores::Efficiency) == std::vector<unsigned> { 0, 1, 2, 3 });
+        CHECK(ThreadPolicy::select_cores(big_little, ThreadPolicy::Cores::Performance) == std::vector<unsigned> { 6, 7 });
+        CHECK(ThreadPolicy::select_cores(big_little, ThreadPolicy::Cores::Any).size() == 8);
+        const std::vector<uint64_t> uniform = { 3000000, 3000000 };
+        CHECK(ThreadPolicy::select_cores(uniform, ThreadPolicy::Cores::Efficiency).size() == 2);
+        CHECK(ThreadPolicy::select_cores({}, ThreadPolicy::Cores::Performance).empty());
+    }
+
+    SECTION("lowering the priority of a thread")
+    {
+        bool applied = false;
+        std::thread thread([&]() {
+            applied = ThreadPolicy { QThread::LowPriority }.apply_to_current_thread();
+            applied = applied && ThreadPolicy { QThread::LowPriority }.apply_to_current_thread(); // already applied
+        });
+        thread.join();
+        CHECK(applied);
+    }
+}
@@ -16,16 +16,23 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include "nucleus/DataQuerier.h"
+#include "nucleus/camera/GroundHeight.h"
 #include "nucleus/tile_scheduler/Cache.h"
 #include "nucleus/tile_scheduler/Scheduler.h"
 #include "nucleus/tile_scheduler/cache_quieries.h"
 #include "nucleus/tile_scheduler/tile_types.h"
+#include "nucleus/tile_scheduler/utils.h"
+#include "nucleus/utils/ByteArrayInterner.h"
+#include "nucleus/utils/LruCache.h"
 #include "radix/height_encoding.h"
 
 #include <catch2/catch_test_macros.hpp>
 
 #include <QBuffer>
+#include <QCoreApplication>
 #include <QImage>
+#include <QThread>
 
 using namespace nucleus::tile_scheduler;
 
@@ -64,7 +71,7 @@ tile_types::TileQuad example_tile_quad_for(const tile::Id& id, float altitude)
 
 TEST_CASE("cache_queries")
 {
-    Cache<tile_types::TileQuad> cache;
+    MemoryCache cache;
     cache.insert(example_tile_quad_for(tile::Id{0, {0, 0}}, 1000.0f));
     cache.insert(example_tile_quad_for(tile::Id{1, {0, 0}}, 3000.0f));
     cache.insert(example_tile_quad_for(tile::Id{1, {0, 1}}, 1000.0f));
@@ -77,4 +84,205 @@ TEST_CASE("cache_queries")
     CHECK(cache_queries::query_altitude(&cache, {47.5587933, -12.3450985}) == 1000);
     CHECK(cache_queries::query_altitude(&cache, {-47.5587933, -12.3450985}) == 3000);
     CHECK(cache_queries::query_altitude(&cache, {47.5587933, 12.3450985}) == 2000);
+
+    SECTION("batch query")
+    {
+        const std::vector<glm::dvec2> lat_longs = { { 47.5587933, 12.3450985 }, { 47.5587933, -12.3450985 }, { -47.5587933, -12.3450985 }, { 47.6, 12.4 } };
+        std::vector<tile::Id> decoded;
+        const auto altitudes = cache_queries::query_altitudes(&cache, lat_longs, [&](const tile::Id& id, const QByteArray& png) {
+            decoded.push_back(id);
+            return cache_queries::decode_height(id, png);
+        });
+        REQUIRE(altitudes.size() == 4);
+        CHECK(altitudes[0] == 2000);
+        CHECK(altitudes[1] == 1000);
+        CHECK(altitudes[2] == 3000);
+        CHECK(altitudes[3] == 2000);
+        CHECK(decoded.size() == 3); // the first and last query share a tile
+    }
+
+    SECTION("ray cast")
+    {
+        TileHeights h;
+        h.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+        const auto decorator = utils::AabbDecorator::make(std::move(h));
+
+        const auto origin = nucleus::srs::lat_long_alt_to_world({ 47.5587933, 12.3450985, 10000 });
+        const auto expected = nucleus::srs::lat_long_alt_to_world({ 47.5587933, 12.3450985, 2000 });
+        const auto hit = cache_queries::ray_cast(&cache, decorator, origin, { 0, 0, -1 });
+        REQUIRE(hit.has_value());
+        CHECK(std::abs(hit->x - expected.x) < 0.001);
+        CHECK(std::abs(hit->y - expected.y) < 0.001);
+        CHECK(std::abs(hit->z - expected.z) < 1.0);
+
+        const auto diagonal = glm::normalize(glm::dvec3(1, 1, -1));
+        const auto diagonal_hit = cache_queries::ray_cast(&cache, decorator, expected - diagonal * (1000 / -diagonal.z), diagonal);
+        REQUIRE(diagonal_hit.has_value());
+        CHECK(std::abs(diagonal_hit->z - expected.z) < 1.0);
+
+        CHECK(!cache_queries::ray_cast(&cache, decorator, origin, { 0, 0, 1 }).has_value());
+    }
+}
+
+TEST_CASE("ground height")
+{
+    MemoryCache cache;
+    cache.insert(example_tile_quad_for(tile::Id{0, {0, 0}}, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id{1, {1, 1}}, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id{2, {2, 2}}, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id{3, {4, 5}}, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id{4, {8, 10}}, 2000.0f));
+    nucleus::DataQuerier querier(&cache);
+    nucleus::camera::GroundHeight ground(&querier);
+
+    const auto position = nucleus::srs::lat_long_to_world({ 47.5587933, 12.3450985 });
+    CHECK(!ground.altitude(position).has_value());
+    ground.update(position);
+    CHECK(ground.n_hot_tiles() > 1); // the centre and (coarser) neighbours
+    const auto expected = nucleus::srs::lat_long_alt_to_world({ 47.5587933, 12.3450985, 2000 });
+    REQUIRE(ground.altitude(position).has_value());
+    CHECK(std::abs(*ground.altitude(position) - expected.z) < 1.0);
+
+    SECTION("clamp")
+    {
+        auto below = nucleus::camera::Definition(expected - glm::dvec3(0, 0, 500), expected + glm::dvec3(100, 0, -500));
+        CHECK(ground.clamp(below, 2.0));
+        CHECK(below.position().z > expected.z);
+        CHECK(below.position().z < expected.z + 10.0);
+        auto above = nucleus::camera::Definition(expected + glm::dvec3(0, 0, 500), expected);
+        CHECK(!ground.clamp(above, 2.0));
+    }
+
+    SECTION("no cache")
+    {
+        nucleus::camera::GroundHeight empty(nullptr);
+        empty.update(position);
+        CHECK(empty.n_hot_tiles() == 0);
+        CHECK(!empty.altitude(position).has_value());
+    }
+}
+
+TEST_CASE("elevation profile")
+{
+    SECTION("polyline sampling")
+    {
+        const std::vector<glm::dvec2> polyline = { { 47.0, 12.0 }, { 47.0, 12.01 }, { 47.01, 12.01 } };
+        const auto length_a = cache_queries::detail::distance(polyline[0], polyline[1]);
+        const auto length_b = cache_queries::detail::distance(polyline[1], polyline[2]);
+        CHECK(std::abs(length_a - 758.3) < 1.0); // 0.01 degree of longitude at 47 degrees
+        CHECK(std::abs(length_b - 1111.9) < 1.0);
+
+        const auto samples = cache_queries::sample_polyline(polyline, 100);
+        REQUIRE(samples.size() == 1 + 8 + 12);
+        CHECK(samples.front().lat_long == polyline.front());
+        CHECK(samples.front().distance == 0);
+        CHECK(samples[8].lat_long == polyline[1]); // the vertices are sampled
+        CHECK(samples.back().lat_long == polyline.back());
+        CHECK(std::abs(samples.back().distance - (length_a + length_b)) < 0.001);
+        for (size_t i = 1; i < samples.size(); ++i) {
+            CHECK(samples[i].distance > samples[i - 1].distance);
+            CHECK(samples[i].distance - samples[i - 1].distance <= 100.0);
+        }
+
+        CHECK(cache_queries::sample_polyline(polyline, 0).size() == 3);
+        CHECK(cache_queries::sample_polyline(std::span<const glm::dvec2>(), 100).empty());
+    }
+
+    MemoryCache cache;
+    cache.insert(example_tile_quad_for(tile::Id { 0, { 0, 0 } }, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id { 1, { 1, 1 } }, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id { 2, { 2, 2 } }, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id { 3, { 4, 5 } }, 1000.0f));
+    cache.insert(example_tile_quad_for(tile::Id { 4, { 8, 10 } }, 2000.0f));
+    const std::vector<glm::dvec2> track = { { 47.5587933, 12.3450985 }, { 47.6, 12.4 } };
+
+    SECTION("best data in the cache, and the quads that are missing for finer data")
+    {
+        auto samples = cache_queries::sample_polyline(track, 500);
+        std::vector<tile::Id> missing;
+        cache_queries::query_profile(&cache, samples, cache_queries::decode_height, 7, &missing);
+        for (const auto& sample : samples) {
+            CHECK(sample.altitude == 2000);
+            CHECK(sample.zoom_level == 5);
+        }
+        REQUIRE(missing.size() >= 2);
+        CHECK(missing.front().zoom_level == 5); // the quad of the sampled tile first
+        CHECK(missing.back().zoom_level == 6);
+        for (const auto& id : missing)
+            CHECK(!cache.contains(id));
+    }
+
+    SECTION("data querier, synchronous and on the worker")
+    {
+        nucleus::DataQuerier querier(&cache);
+        const auto profile = querier.elevation_profile(track, 500);
+        REQUIRE(profile.samples.size() > 2);
+        CHECK(profile.samples.front().altitude == 2000);
+        CHECK(profile.missing_quads.empty()); // no fetch level
+
+        std::vector<tile::Id> fetched;
+        querier.set_quad_fetcher([&fetched](std::vector<tile::Id> quads) { fetched = std::move(quads); });
+        QObject context;
+        std::optional<nucleus::ElevationProfile> result;
+        querier.request_elevation_profile(track, 500, 7, &context, [&result](nucleus::ElevationProfile profile) { result = std::move(profile); });
+        for (int i = 0; i < 500 && !result; ++i) {
+            QCoreApplication::processEvents();
+            QThread::msleep(1);
+        }
+        REQUIRE(result.has_value());
+        CHECK(result->samples.size() == profile.samples.size());
+        CHECK(!result->missing_quads.empty());
+        CHECK(fetched == result->missing_quads);
+    }
+}
+
+TEST_CASE("lru cache")
+{
+    nucleus::utils::LruCache<int, int> lru(2);
+    unsigned n_created = 0;
+    const auto make = [&](int v) { return [&n_created, v]() { ++n_created; return v; }; };
+    CHECK(lru.get_or_create(1, make(10)) == 10);
+    CHECK(lru.get_or_create(2, make(20)) == 20);
+    CHECK(lru.get_or_create(1, make(11)) == 10);
+    CHECK(n_created == 2);
+    CHECK(lru.get_or_create(3, make(30)) == 30); // evicts 2, as 1 was used more recently
+    CHECK(lru.size() == 2);
+    CHECK(lru.contains(1));
+    CHECK(!lru.contains(2));
+    CHECK(lru.contains(3));
+    lru.clear();
+    CHECK(lru.size() == 0);
+
+    SECTION("byte limit")
+    {
+        nucleus::utils::LruCache<int, int> sized(100);
+        sized.set_byte_limit(1000);
+        sized.insert(1, 10, 400);
+        sized.insert(2, 20, 400);
+        CHECK(sized.n_bytes() == 800);
+        CHECK(sized.find(1) != nullptr);
+        sized.insert(3, 30, 400); // evicts 2
+        CHECK(sized.n_bytes() == 800);
+        CHECK(!sized.contains(2));
+        sized.insert(4, 40, 2000); // too large, not stored
+        CHECK(!sized.contains(4));
+        sized.insert(1, 11, 100); // overwrites
+        CHECK(sized.n_bytes() == 500);
+        CHECK(*sized.find(1) == 11);
+        sized.set_byte_limit(200);
+        CHECK(sized.size() == 1);
+        CHECK(sized.contains(1));
+    }
+}
+
+TEST_CASE("byte array interner")
+{
+    nucleus::utils::ByteArrayInterner interner;
+    const auto a = interner.intern(std::make_shared<QByteArray>("ocean"));
+    const auto b = interner.intern(std::make_shared<QByteArray>("ocean"));
+    const auto c = interner.intern(std::make_shared<QByteArray>("glacier"));
+    CHECK(a == b);
+    CHECK(a != c);
+    CHECK(interner.n_alive() == 2);
+    CHECK(!interner.intern(nullptr));
 }
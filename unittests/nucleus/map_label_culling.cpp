@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/camera/Definition.h"
+#include "nucleus/map_label/label_culling.h"
+
+using nucleus::label_culling::Candidate;
+
+TEST_CASE("nucleus/map_label/label_culling")
+{
+    nucleus::camera::Definition camera({ 0, -1000, 0 }, { 0, 0, 0 });
+    camera.set_viewport_size({ 1920, 1080 });
+    const glm::vec2 extent_min = { -100, -20 };
+    const glm::vec2 extent_max = { 100, 50 };
+
+    SECTION("frustum and distance")
+    {
+        const std::vector<Candidate> candidates = {
+            { { 0, 0, 0 }, 1.0f, extent_min, extent_max }, // visible
+            { { 0, -2000, 0 }, 1.0f, extent_min, extent_max }, // behind the camera
+            { { 0, 30000, 0 }, 0.1f, extent_min, extent_max }, // too far for its importance
+            { { 50000, 0, 0 }, 1.0f, extent_min, extent_max }, // outside of the viewport
+            { { 8000, 30000, 0 }, 1.0f, extent_min, extent_max }, // far, but important
+        };
+        const auto visible = nucleus::label_culling::visible_labels(candidates, camera);
+        CHECK(visible == std::vector<unsigned> { 0, 4 });
+    }
+
+    SECTION("declutter keeps the more important label")
+    {
+        const std::vector<Candidate> candidates = {
+            { { 1, 0, 0 }, 0.5f, extent_min, extent_max },
+            { { 0, 0, 0 }, 1.0f, extent_min, extent_max },
+            { { 300, 0, 0 }, 0.5f, extent_min, extent_max }, // far enough to the right
+            { { 0, 0, 1 }, 1.0f, extent_min, extent_max }, // same importance, but further away
+        };
+        const auto visible = nucleus::label_culling::visible_labels(candidates, camera);
+        CHECK(visible == std::vector<unsigned> { 1, 2 });
+    }
+
+    SECTION("overlaps are found across grid cells")
+    {
+        // the labels are ~100 px wide on screen, larger than the cells
+        const std::vector<Candidate> candidates = {
+            { { 0, 0, 0 }, 1.0f, extent_min, extent_max },
+            { { 20, 0, 0 }, 0.5f, extent_min, extent_max },
+        };
+        CHECK(nucleus::label_culling::visible_labels(candidates, camera, 8.0f).size() == 1);
+        CHECK(nucleus::label_culling::visible_labels(candidates, camera, 4096.0f).size() == 1);
+    }
+}
@@ -0,0 +1,63 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/map_label/font_atlas_cache.h"
+
+using namespace nucleus;
+
+TEST_CASE("nucleus/map_label/font_atlas_cache")
+{
+    const auto key = font_atlas_cache::key("font file", "abc", "32 6");
+    Raster<uint8_t> raster({ 4, 3 }, uint8_t(7));
+    raster.pixel({ 1, 2 }) = 200;
+    font_atlas_cache::CharDataMap char_data;
+    char_data.emplace(u'a', MapLabel::CharData { 1, 2, 3, 4, 0.5f, -7.25f });
+    char_data.emplace(u'ß', MapLabel::CharData { 10, 20, 30, 40, -1.0f, 2.0f });
+
+    SECTION("keys depend on all inputs")
+    {
+        CHECK(key == font_atlas_cache::key("font file", "abc", "32 6"));
+        CHECK(key != font_atlas_cache::key("other font", "abc", "32 6"));
+        CHECK(key != font_atlas_cache::key("font file", "abcd", "32 6"));
+        CHECK(key != font_atlas_cache::key("font file", "abc", "48 6"));
+    }
+
+    SECTION("round trip")
+    {
+        const auto atlas = font_atlas_cache::deserialise(key, font_atlas_cache::serialise(key, raster, char_data));
+        REQUIRE(atlas.has_value());
+        CHECK(atlas->raster.size() == raster.size());
+        CHECK(atlas->raster.buffer() == raster.buffer());
+        REQUIRE(atlas->char_data.size() == 2);
+        const auto& d = atlas->char_data.at(u'ß');
+        CHECK(d.x == 10);
+        CHECK(d.height == 40);
+        CHECK(d.xoff == -1.0f);
+        CHECK(atlas->char_data.at(u'a').yoff == -7.25f);
+    }
+
+    SECTION("other keys and broken data are rejected")
+    {
+        const auto data = font_atlas_cache::serialise(key, raster, char_data);
+        CHECK(!font_atlas_cache::deserialise(font_atlas_cache::key("other font", "abc", "32 6"), data));
+        CHECK(!font_atlas_cache::deserialise(key, data.left(data.size() - 3)));
+        CHECK(!font_atlas_cache::deserialise(key, QByteArray()));
+    }
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/map_label/label_tile.h"
+
+using nucleus::label_tile::LabelRecord;
+using namespace Qt::Literals::StringLiterals;
+
+TEST_CASE("nucleus/map_label/label_tile")
+{
+    SECTION("round trip")
+    {
+        const std::vector<LabelRecord> labels = {
+            { u"Großglockner"_s, 47.07455, 12.69388, 3798, 1 },
+            { u"Östliche Hochgrubachspitze"_s, 47.5587933, 12.3450985, 2284, 0 },
+            { QString(), -33.5, 151.25, -2.5f, 0.5f },
+        };
+        const auto encoded = nucleus::label_tile::encode(labels);
+        const auto decoded = nucleus::label_tile::decode(encoded);
+        REQUIRE(decoded.has_value());
+        CHECK(decoded.value() == labels);
+    }
+
+    SECTION("an empty tile has no labels")
+    {
+        const auto decoded = nucleus::label_tile::decode(QByteArray());
+        REQUIRE(decoded.has_value());
+        CHECK(decoded->empty());
+        CHECK(nucleus::label_tile::decode(nucleus::label_tile::encode({})).value().empty());
+    }
+
+    SECTION("broken tiles are rejected")
+    {
+        CHECK(!nucleus::label_tile::decode(QByteArray("<html>not found</html>")).has_value());
+
+        const auto encoded = nucleus::label_tile::encode({ { u"Piz Buin"_s, 46.84412, 10.11889, 3312, 0.56f } });
+        CHECK(!nucleus::label_tile::decode(encoded.left(encoded.size() - 2)).has_value());
+        CHECK(!nucleus::label_tile::decode(encoded.left(20)).has_value());
+
+        auto wrong_version = encoded;
+        wrong_version[4] = char(99);
+        CHECK(!nucleus::label_tile::decode(wrong_version).has_value());
+
+        auto huge_count = encoded;
+        huge_count[8] = char(0xff);
+        huge_count[9] = char(0xff);
+        huge_count[10] = char(0xff);
+        huge_count[11] = char(0x7f);
+        CHECK(!nucleus::label_tile::decode(huge_count).has_value());
+    }
+}
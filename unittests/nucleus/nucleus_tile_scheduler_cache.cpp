@@ -16,14 +16,20 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <atomic>
+#include <thread>
 #include <unordered_set>
 #include <sstream>
+#include <utility>
 
+#include <catch2/catch_template_test_macros.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <QStandardPaths>
 #include <QThread>
 
 #include "nucleus/tile_scheduler/Cache.h"
+#include "nucleus/tile_scheduler/MissingQuadSet.h"
+#include "nucleus/tile_scheduler/ShardedTileMap.h"
 #include "radix/tile.h"
 
 
@@ -32,6 +38,11 @@ struct TestTile {
     tile::Id id;
     std::string data;
 };
+struct SizedTestTile {
+    tile::Id id;
+    uint64_t size = 0;
+    uint64_t n_bytes() const { return size; }
+};
 struct DiskWriteTestTileInner {
     tile::Id id;
     std::shared_ptr<QByteArray> data;
@@ -51,13 +62,29 @@ struct DiskWriteTestTile2 {
     static constexpr const std::array<char, 25> version_information = {"DiskWriteTestTile2"};
 };
 static_assert(nucleus::tile_scheduler::tile_types::SerialisableTile<DiskWriteTestTile2>);
+
+struct StdStorage {
+    template <typename Value>
+    using Map = nucleus::tile_scheduler::StdTileMap<Value>;
+    using Policy = nucleus::tile_scheduler::DefaultCachePolicy;
+};
+struct FlatStorage {
+    template <typename Value>
+    using Map = nucleus::tile_scheduler::FlatTileMap<Value>;
+    using Policy = nucleus::tile_scheduler::DefaultCachePolicy;
+};
+struct SingleThreadStorage {
+    template <typename Value>
+    using Map = nucleus::tile_scheduler::FlatTileMap<Value>;
+    using Policy = nucleus::tile_scheduler::SingleThreadCachePolicy;
+};
 }
 
-TEST_CASE("nucleus/tile_scheduler/cache")
+TEMPLATE_TEST_CASE("nucleus/tile_scheduler/cache", "", StdStorage, FlatStorage, SingleThreadStorage)
 {
     SECTION("api")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.insert(TestTile { { 0, { 0, 0 } }, "root" });
         CHECK(cache.contains({ 0, { 0, 0 } }));
         CHECK(cache.n_cached_objects() == 1);
@@ -67,7 +94,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
 
     SECTION("insert and visit")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.visit([](const TestTile &) {
             CHECK(false);
             return true;
@@ -120,9 +147,47 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         CHECK(visited.contains({ 3, { 0, 0 } }));
     }
 
+    SECTION("inserts in one subtree and visits of another run concurrently")
+    {
+        if constexpr (!TestType::Policy::Locking::thread_safe)
+            return;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
+        for (unsigned zoom = 0; zoom <= 6; ++zoom)
+            cache.insert(TestTile { { zoom, { 0, 0 } }, "visited" });
+
+        std::atomic<bool> done = false;
+        std::thread inserter([&]() {
+            for (unsigned i = 0; i < 64; ++i) {
+                for (unsigned j = 0; j < 64; ++j)
+                    cache.insert(TestTile { { 10, { 512 + i, 512 + j } }, "inserted" });
+            }
+            done = true;
+        });
+        unsigned n_visits = 0;
+        while (!done || n_visits == 0) {
+            unsigned n_visited = 0;
+            cache.visit([&n_visited](const TestTile& t) {
+                CHECK(t.data == "visited");
+                ++n_visited;
+                return true;
+            });
+            CHECK(n_visited == 7);
+            ++n_visits;
+        }
+        inserter.join();
+        CHECK(cache.n_cached_objects() == 7 + 64 * 64);
+        cache.visit([](const TestTile&) { return true; }); // after the inserts, so that the others are purged first
+        CHECK(cache.contains({ 10, { 575, 575 } }));
+
+        const auto purged = cache.purge(7);
+        CHECK(purged.size() == 64 * 64);
+        CHECK(cache.contains({ 6, { 0, 0 } }));
+        CHECK(!cache.contains({ 10, { 512, 512 } }));
+    }
+
     SECTION("visit can refuse to visit certain tiles")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.insert(TestTile { { 0, { 0, 0 } }, "green" });
         cache.insert(TestTile { { 1, { 0, 0 } }, "orange" });
         cache.insert(TestTile { { 1, { 0, 1 } }, "orange" });
@@ -147,7 +212,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
 
     SECTION("purge: all elements equal, large zoom levels first")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.insert(TestTile { { 2, { 0, 0 } }, "green" });
         cache.insert(TestTile { { 3, { 0, 0 } }, "green" });
         cache.insert(TestTile { { 6, { 4, 3 } }, "red" });
@@ -170,7 +235,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
 
     SECTION("purge: elements coming in earlier are purged first")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
 
         cache.insert(TestTile { { 0, { 0, 0 } }, "red" });
         cache.insert(TestTile { { 1, { 0, 1 } }, "red" });
@@ -190,7 +255,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
 
     SECTION("purge: visit updates the time")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.insert(TestTile { { 0, { 0, 0 } }, "older" });
 
         QThread::msleep(2);
@@ -212,9 +277,65 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         CHECK(cache.contains({ 0, { 0, 0 } }));
     }
 
+    SECTION("purge: visit_readonly doesn't update the time")
+    {
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
+        cache.insert(TestTile { { 0, { 0, 0 } }, "older" });
+
+        QThread::msleep(2);
+        cache.insert(TestTile { { 1, { 0, 0 } }, "newer" });
+        cache.insert(TestTile { { 1, { 0, 1 } }, "newer" });
+
+        QThread::msleep(2);
+        std::unordered_set<tile::Id, tile::Id::Hasher> visited;
+        std::as_const(cache).visit_readonly([&visited](const TestTile& t) {
+            visited.insert(t.id);
+            return true;
+        });
+        CHECK(visited.size() == 3);
+        const auto purged = cache.purge(2);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].id == tile::Id { 0, { 0, 0 } });
+    }
+
+    SECTION("snapshot")
+    {
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
+        const auto empty = cache.snapshot();
+        REQUIRE(empty);
+        CHECK(empty->tiles.empty());
+
+        cache.insert(TestTile { { 0, { 0, 0 } }, "root" });
+        cache.insert(TestTile { { 1, { 0, 0 } }, "child" });
+        CHECK(cache.snapshot()->tiles.empty()); // not published yet
+        cache.publish_snapshot();
+        const auto first = cache.snapshot();
+        CHECK(first->tiles.size() == 2);
+        CHECK(first->version > empty->version);
+        cache.publish_snapshot();
+        CHECK(cache.snapshot() == first); // nothing changed
+
+        cache.insert(TestTile { { 1, { 0, 0 } }, "updated" });
+        cache.purge(1);
+        cache.publish_snapshot();
+        const auto second = cache.snapshot();
+        CHECK(second->tiles.size() == 1);
+        // the old version is unchanged
+        REQUIRE(first->find({ 1, { 0, 0 } }));
+        CHECK(first->find({ 1, { 0, 0 } })->data == "child");
+        CHECK(first->find({ 0, { 0, 0 } }));
+
+        std::unordered_set<tile::Id, tile::Id::Hasher> visited;
+        first->visit([&visited](const TestTile& t) {
+            visited.insert(t.id);
+            return true;
+        });
+        CHECK(visited.size() == 2);
+    }
+
     SECTION("purge: visited elements are purged later than others")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.insert(TestTile { { 0, { 0, 0 } }, "green" });
         cache.insert(TestTile { { 2, { 0, 0 } }, "orange" });
 
@@ -251,9 +372,121 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         CHECK(cache.contains({ 1, { 0, 0 } }));
     }
 
+    SECTION("purge: repeated purges with visits and overwriting inserts in between")
+    {
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
+        cache.insert(TestTile { { 0, { 0, 0 } }, "root" });
+        cache.insert(TestTile { { 1, { 0, 0 } }, "a" });
+        cache.insert(TestTile { { 1, { 0, 1 } }, "b" });
+        QThread::msleep(2);
+        cache.insert(TestTile { { 1, { 0, 0 } }, "a2" }); // newer now
+        cache.insert(TestTile { { 1, { 1, 1 } }, "c" });
+        QThread::msleep(2);
+        cache.visit([](const TestTile& t) { return t.id.zoom_level == 0; }); // only the root gets stamped
+
+        auto purged = cache.purge(3);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].id == tile::Id { 1, { 0, 1 } }); // inserted earliest and not overwritten
+        CHECK(cache.n_cached_objects() == 3);
+
+        QThread::msleep(2);
+        cache.insert(TestTile { { 3, { 0, 0 } }, "d" });
+        QThread::msleep(2);
+        cache.visit([](const TestTile&) { return true; });
+        purged = cache.purge(3);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].id == tile::Id { 3, { 0, 0 } }); // not reachable, so never visited
+        CHECK(cache.contains({ 1, { 0, 0 } }));
+        CHECK(cache.peak_at({ 1, { 0, 0 } }).data == "a2");
+        CHECK(cache.n_cached_objects() == 3);
+    }
+
+    SECTION("purge: byte budget")
+    {
+        nucleus::tile_scheduler::Cache<SizedTestTile, TestType::template Map, typename TestType::Policy> cache;
+        cache.insert(SizedTestTile { { 0, { 0, 0 } }, 100 });
+        QThread::msleep(2);
+        cache.insert(SizedTestTile { { 1, { 0, 0 } }, 1000 });
+        cache.insert(SizedTestTile { { 1, { 0, 1 } }, 10 });
+        CHECK(cache.n_bytes() == 1110);
+        cache.insert(SizedTestTile { { 1, { 0, 1 } }, 20 }); // overwriting replaces the size
+        CHECK(cache.n_bytes() == 1120);
+
+        CHECK(cache.purge(10, 2000).empty());
+        auto purged = cache.purge(10, 1050);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].id == tile::Id { 0, { 0, 0 } }); // oldest first, even though it's small
+        CHECK(cache.n_bytes() == 1020);
+
+        purged = cache.purge(10, 500);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].id == tile::Id { 1, { 0, 0 } });
+        CHECK(cache.n_bytes() == 20);
+        CHECK(cache.n_cached_objects() == 1);
+
+        // quad limit still applies, and tiles without n_bytes() count as 0
+        CHECK(cache.purge(0).size() == 1);
+        CHECK(cache.n_bytes() == 0);
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> unsized;
+        unsized.insert(TestTile { { 0, { 0, 0 } }, "root" });
+        CHECK(unsized.n_bytes() == 0);
+    }
+
+    SECTION("purge: kept entries go last, unless the limits can't be met otherwise")
+    {
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
+        cache.insert(TestTile { { 0, { 0, 0 } }, "kept" });
+        cache.insert(TestTile { { 1, { 0, 0 } }, "kept" });
+        QThread::msleep(2);
+        cache.insert(TestTile { { 1, { 0, 1 } }, "new" });
+        cache.insert(TestTile { { 1, { 1, 1 } }, "new" });
+        const auto is_kept = [](const TestTile& tile) { return tile.data == "kept"; };
+
+        auto purged = cache.purge(3, std::numeric_limits<uint64_t>::max(), is_kept);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].data == "new");
+        CHECK(cache.contains({ 0, { 0, 0 } }));
+        CHECK(cache.contains({ 1, { 0, 0 } }));
+
+        purged = cache.purge(1, std::numeric_limits<uint64_t>::max(), is_kept);
+        REQUIRE(purged.size() == 2);
+        CHECK(purged[0].data == "new");
+        CHECK(purged[1].data == "kept");
+        CHECK(cache.n_cached_objects() == 1);
+    }
+
+    SECTION("insert: identical payloads are shared")
+    {
+        using nucleus::tile_scheduler::tile_types::TileQuad;
+        nucleus::tile_scheduler::Cache<TileQuad, TestType::template Map, typename TestType::Policy> cache;
+        const auto make_quad = [](const tile::Id& id, const QByteArray& ortho) {
+            TileQuad quad;
+            quad.id = id;
+            quad.n_tiles = 4;
+            const auto children = id.children();
+            for (unsigned i = 0; i < 4; ++i) {
+                quad.tiles[i].id = children[i];
+                quad.tiles[i].ortho = std::make_shared<QByteArray>(ortho);
+                quad.tiles[i].height = std::make_shared<QByteArray>();
+            }
+            return quad;
+        };
+        cache.insert(make_quad({ 0, { 0, 0 } }, "ocean"));
+        cache.insert(make_quad({ 1, { 0, 0 } }, "ocean"));
+        cache.insert(make_quad({ 1, { 1, 0 } }, "glacier"));
+        const auto& a = cache.peak_at({ 0, { 0, 0 } });
+        const auto& b = cache.peak_at({ 1, { 0, 0 } });
+        const auto& c = cache.peak_at({ 1, { 1, 0 } });
+        CHECK(a.tiles[0].ortho == a.tiles[3].ortho);
+        CHECK(a.tiles[0].ortho == b.tiles[2].ortho);
+        CHECK(a.tiles[0].height == c.tiles[1].height);
+        CHECK(a.tiles[0].ortho != c.tiles[0].ortho);
+        CHECK(*c.tiles[0].ortho == "glacier");
+    }
+
     SECTION("insert: insert overwrites existing objects")
     {
-        nucleus::tile_scheduler::Cache<TestTile> cache;
+        nucleus::tile_scheduler::Cache<TestTile, TestType::template Map, typename TestType::Policy> cache;
         cache.insert(TestTile { { 0, { 0, 0 } }, "green" });
         cache.insert(TestTile { { 1, { 0, 1 } }, "green" });
 
@@ -304,7 +537,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
         std::filesystem::remove_all(path);
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             cache.insert(create_test_tile({ 0, { 0, 0 } }));
             cache.insert(create_test_tile({ 356, { 20, 564 } }));
             for (unsigned i = 1; i < 10; ++i) {
@@ -320,7 +553,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
             CHECK(r.has_value());
         }
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
 
             CHECK(cache.read_from_disk(path).has_value());
             verify_tile(cache, {0, {0, 0}});
@@ -335,17 +568,209 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         std::filesystem::remove_all(path);
     }
 
+    SECTION("write to pack and read back, with updates, purges and compaction")
+    {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_pack";
+        std::filesystem::remove_all(path);
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            cache.insert(create_test_tile({ 0, { 0, 0 } }, 1));
+            for (unsigned i = 1; i < 10; ++i)
+                cache.insert(create_test_tile({ i, { 0, 0 } }, 1));
+            CHECK(cache.write_to_pack(path).has_value());
+            CHECK(std::filesystem::exists(nucleus::tile_scheduler::TilePack::pack_path(path)));
+            CHECK(std::filesystem::exists(nucleus::tile_scheduler::TilePack::index_path(path)));
+
+            QThread::msleep(2);
+            cache.insert(create_test_tile({ 0, { 0, 0 } }, 2));
+            cache.visit([](const auto&) { return true; });
+            cache.purge(5);
+            CHECK(cache.write_to_pack(path).has_value());
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            REQUIRE(cache.read_from_pack(path).has_value());
+            CHECK(cache.n_cached_objects() == 5);
+            verify_tile(cache, { 0, { 0, 0 } }, 2);
+            for (unsigned i = 1; i < 5; ++i)
+                verify_tile(cache, { i, { 0, 0 } }, 1);
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile2, TestType::template Map, typename TestType::Policy> cache;
+            CHECK(!cache.read_from_pack(path).has_value());
+        }
+        {
+            // many updates produce garbage, which is compacted eventually
+            nucleus::tile_scheduler::TilePack pack(path, DiskWriteTestTile::version_information);
+            REQUIRE(pack.open(false).has_value());
+            const std::vector<char> blob(1024 * 1024, 'x');
+            for (int i = 0; i < 10; ++i)
+                REQUIRE(pack.append({ 20, { 1, 1 } }, blob, 1, 1).has_value());
+            REQUIRE(pack.commit().has_value());
+            CHECK(pack.pack_size() < 2 * 1024 * 1024 + pack.live_bytes());
+            const auto bytes = pack.bytes({ 20, { 1, 1 } });
+            REQUIRE(bytes.has_value());
+            CHECK(bytes->size() == blob.size());
+            CHECK((*bytes)[1000] == 'x');
+        }
+        std::filesystem::remove_all(path);
+    }
+
+    SECTION("open pack lazily and load the pending tiles in batches")
+    {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_pack";
+        std::filesystem::remove_all(path);
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            for (unsigned i = 0; i < 4; ++i)
+                cache.insert(create_test_tile({ i, { 0, 0 } }, 1));
+            CHECK(cache.write_to_pack(path).has_value());
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            REQUIRE(cache.open_pack(path).has_value());
+            CHECK(cache.n_cached_objects() == 0);
+            CHECK(cache.n_pending_from_pack() == 4);
+            CHECK(cache.is_pending_from_pack({ 2, { 0, 0 } }));
+
+            const std::vector<tile::Id> batch = { { 0, { 0, 0 } }, { 1, { 0, 0 } }, { 7, { 0, 0 } } };
+            const auto n_loaded = cache.load_from_pack(batch);
+            REQUIRE(n_loaded.has_value());
+            CHECK(*n_loaded == 2);
+            CHECK(cache.n_cached_objects() == 2);
+            CHECK(cache.n_pending_from_pack() == 2);
+            verify_tile(cache, { 0, { 0, 0 } }, 1);
+            verify_tile(cache, { 1, { 0, 0 } }, 1);
+
+            // inserts supersede pending tiles, and pending tiles survive a write
+            cache.insert(create_test_tile({ 2, { 0, 0 } }, 2));
+            CHECK(!cache.is_pending_from_pack({ 2, { 0, 0 } }));
+            CHECK(cache.write_to_pack(path).has_value());
+            const std::vector<tile::Id> rest = { { 2, { 0, 0 } }, { 3, { 0, 0 } } };
+            CHECK(cache.load_from_pack(rest).value() == 1);
+            CHECK(cache.n_pending_from_pack() == 0);
+            verify_tile(cache, { 2, { 0, 0 } }, 2);
+            verify_tile(cache, { 3, { 0, 0 } }, 1);
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            REQUIRE(cache.read_from_pack(path).has_value());
+            CHECK(cache.n_cached_objects() == 4);
+            verify_tile(cache, { 2, { 0, 0 } }, 2);
+            verify_tile(cache, { 3, { 0, 0 } }, 1);
+        }
+        std::filesystem::remove_all(path);
+    }
+
+    SECTION("incremental writes to the pack journal are replayed on open")
+    {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_pack";
+        std::filesystem::remove_all(path);
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            for (unsigned i = 0; i < 4; ++i)
+                cache.insert(create_test_tile({ i, { 0, 0 } }, 1));
+            CHECK(cache.flush_to_pack(path).has_value()); // no pack open yet -> full write
+            CHECK(std::filesystem::exists(nucleus::tile_scheduler::TilePack::journal_path(path)));
+
+            QThread::msleep(2);
+            cache.insert(create_test_tile({ 1, { 0, 0 } }, 2));
+            cache.insert(create_test_tile({ 4, { 0, 0 } }, 1));
+            cache.purge(4); // removes tile 3, the oldest one with the highest zoom level
+            CHECK(cache.flush_to_pack(path).has_value());
+        }
+        {
+            // only the journal was written, the index is still the one of the first write
+            nucleus::tile_scheduler::TilePack pack(path, DiskWriteTestTile::version_information);
+            REQUIRE(pack.open(false).has_value());
+            CHECK(pack.journal_size() == 3);
+            CHECK(pack.index().size() == 4);
+            CHECK(!pack.index().contains({ 3, { 0, 0 } }));
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            REQUIRE(cache.read_from_pack(path).has_value());
+            CHECK(cache.n_cached_objects() == 4);
+            verify_tile(cache, { 0, { 0, 0 } }, 1);
+            verify_tile(cache, { 1, { 0, 0 } }, 2);
+            verify_tile(cache, { 2, { 0, 0 } }, 1);
+            verify_tile(cache, { 4, { 0, 0 } }, 1);
+
+            // a torn record at the end of the journal is dropped
+            QFile journal(nucleus::tile_scheduler::TilePack::journal_path(path));
+            REQUIRE(journal.open(QIODeviceBase::WriteOnly | QIODeviceBase::Append));
+            journal.write("garbage");
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            REQUIRE(cache.read_from_pack(path).has_value());
+            CHECK(cache.n_cached_objects() == 4);
+            verify_tile(cache, { 1, { 0, 0 } }, 2);
+        }
+        std::filesystem::remove_all(path);
+    }
+
+    SECTION("disk tier keeps purged tiles and evicts its own least recently visited ones")
+    {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_pack";
+        std::filesystem::remove_all(path);
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            cache.set_disk_limits(6);
+            for (unsigned i = 0; i < 4; ++i) {
+                cache.insert(create_test_tile({ i, { 0, 0 } }, 1));
+                QThread::msleep(2);
+            }
+            CHECK(cache.flush_to_pack(path).has_value());
+            CHECK(cache.n_disk_cached_objects() == 4);
+
+            // tiles that are already on disk become pending
+            cache.insert(create_test_tile({ 4, { 0, 0 } }, 1));
+            cache.purge(2);
+            CHECK(cache.n_cached_objects() == 2);
+            CHECK(cache.n_pending_from_pack() == 3);
+            CHECK(cache.is_pending_from_pack({ 0, { 0, 0 } }));
+
+            // tile 4 isn't on disk yet, it is written with the next flush
+            QThread::msleep(2);
+            cache.insert(create_test_tile({ 5, { 0, 0 } }, 1));
+            QThread::msleep(2);
+            cache.insert(create_test_tile({ 6, { 0, 0 } }, 1));
+            cache.purge(2);
+            CHECK(cache.n_pending_from_pack() == 4);
+            CHECK(!cache.is_pending_from_pack({ 4, { 0, 0 } }));
+
+            // 7 quads on disk, the oldest one that isn't in ram goes
+            CHECK(cache.flush_to_pack(path).has_value());
+            CHECK(cache.n_disk_cached_objects() == 6);
+            CHECK(cache.is_pending_from_pack({ 4, { 0, 0 } }));
+            CHECK(!cache.is_pending_from_pack({ 0, { 0, 0 } }));
+            CHECK(cache.n_pending_from_pack() == 4);
+
+            const std::vector<tile::Id> batch = { { 0, { 0, 0 } }, { 4, { 0, 0 } } };
+            CHECK(cache.load_from_pack(batch).value() == 1);
+            verify_tile(cache, { 4, { 0, 0 } }, 1);
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
+            REQUIRE(cache.open_pack(path).has_value());
+            CHECK(cache.n_pending_from_pack() == 6);
+            CHECK(!cache.is_pending_from_pack({ 0, { 0, 0 } }));
+        }
+        std::filesystem::remove_all(path);
+    }
+
     SECTION("reading disk cache back fails on bad version") {
         const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
         std::filesystem::remove_all(path);
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             cache.insert(create_test_tile({ 0, { 0, 0 } }));
             cache.insert(create_test_tile({ 356, { 20, 564 } }));
             CHECK(cache.write_to_disk(path).has_value());
         }
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile2> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile2, TestType::template Map, typename TestType::Policy> cache;
             CHECK(!cache.read_from_disk(path).has_value());
         }
         std::filesystem::remove_all(path);
@@ -355,13 +780,13 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
         std::filesystem::remove_all(path);
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             cache.insert(create_test_tile({ 0, { 0, 0 } }));
             cache.insert(create_test_tile({ 1, { 0, 0 } }));
             CHECK(cache.write_to_disk(path).has_value());
         }
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             CHECK(cache.read_from_disk(path).has_value());
             CHECK(cache.n_cached_objects() == 2);
             verify_tile(cache, {0, {0, 0}});
@@ -371,7 +796,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
             CHECK(cache.write_to_disk(path).has_value());
         }
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             CHECK(cache.read_from_disk(path).has_value());
             CHECK(cache.n_cached_objects() == 4);
             verify_tile(cache, {0, {0, 0}});
@@ -387,7 +812,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
             CHECK(cache.write_to_disk(path).has_value());
         }
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             CHECK(cache.read_from_disk(path).has_value());
             CHECK(cache.n_cached_objects() == 3);
             verify_tile(cache, {0, {0, 0}});
@@ -401,7 +826,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
         std::filesystem::remove_all(path);
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             cache.insert(create_test_tile({ 0, { 0, 0 } }, 1));
             cache.insert(create_test_tile({ 1, { 0, 0 } }, 1));
             CHECK(cache.write_to_disk(path).has_value());
@@ -412,7 +837,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
             CHECK(cache.write_to_disk(path).has_value());
         }
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             CHECK(cache.read_from_disk(path).has_value());
             CHECK(cache.n_cached_objects() == 2);
             verify_tile(cache, {0, {0, 0}}, 2);
@@ -426,7 +851,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
         std::filesystem::remove_all(path);
         {
-            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
             cache.insert(create_test_tile({ 3, { 0, 0 } }));
             cache.insert(create_test_tile({ 2, { 0, 0 } }));
             cache.insert(create_test_tile({ 1, { 0, 0 } }));
@@ -438,7 +863,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
             verify_tile(cache, { 1, { 0, 0 } });
             CHECK(cache.write_to_disk(path).has_value());
             {
-                nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+                nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
                 CHECK(cache.read_from_disk(path).has_value());
                 CHECK(cache.n_cached_objects() == 2);
                 verify_tile(cache, {0, {0, 0}});
@@ -454,7 +879,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
 
             CHECK(cache.write_to_disk(path).has_value());
             {
-                nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+                nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
                 CHECK(cache.read_from_disk(path).has_value());
                 CHECK(cache.n_cached_objects() == 4);
                 verify_tile(cache, {0, {0, 0}});
@@ -469,7 +894,7 @@ TEST_CASE("nucleus/tile_scheduler/cache")
             verify_tile(cache, {1, {0, 0}});
             CHECK(cache.write_to_disk(path).has_value());
             {
-                nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+                nucleus::tile_scheduler::Cache<DiskWriteTestTile, TestType::template Map, typename TestType::Policy> cache;
                 CHECK(cache.read_from_disk(path).has_value());
                 CHECK(cache.n_cached_objects() == 2);
                 verify_tile(cache, {0, {0, 0}});
@@ -479,3 +904,190 @@ TEST_CASE("nucleus/tile_scheduler/cache")
         std::filesystem::remove_all(path);
     }
 }
+
+TEST_CASE("nucleus/tile_scheduler/cache policies")
+{
+    using namespace nucleus::tile_scheduler;
+
+    SECTION("insertion order eviction ignores visits")
+    {
+        using Policy = CachePolicy<NoLocking, InsertionOrderEviction, PackPersistence, 0>;
+        Cache<TestTile, FlatTileMap, Policy> cache;
+        cache.insert(TestTile { { 0, { 0, 0 } }, "older" });
+        QThread::msleep(2);
+        cache.insert(TestTile { { 1, { 0, 0 } }, "newer" });
+        QThread::msleep(2);
+        cache.visit([](const TestTile&) { return true; });
+        const auto purged = cache.purge(1);
+        REQUIRE(purged.size() == 1);
+        CHECK(purged[0].id == tile::Id { 0, { 0, 0 } });
+    }
+
+    SECTION("persist and restore go through the persistence policy")
+    {
+        using Policy = CachePolicy<SharedLocking, LruEviction, FilePersistence>;
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache_policy";
+        std::filesystem::remove_all(path);
+        const auto create_tile = [](const tile::Id& id) {
+            DiskWriteTestTile t { id, 7, 4, {} };
+            const auto children = id.children();
+            for (unsigned i = 0; i < 4; ++i)
+                t.tiles[i] = { children[i], std::make_shared<QByteArray>("data") };
+            return t;
+        };
+        {
+            Cache<DiskWriteTestTile, StdTileMap, Policy> cache;
+            cache.insert(create_tile({ 0, { 0, 0 } }));
+            cache.insert(create_tile({ 1, { 1, 0 } }));
+            CHECK(cache.persist(path).has_value());
+        }
+        CHECK(std::filesystem::is_directory(path)); // a file per tile, not a pack
+        {
+            Cache<DiskWriteTestTile, StdTileMap, Policy> cache;
+            CHECK(cache.restore(path).has_value());
+            CHECK(cache.n_cached_objects() == 2);
+            REQUIRE(cache.contains({ 1, { 1, 0 } }));
+            CHECK(cache.peak_at({ 1, { 1, 0 } }).meta_data == 7);
+        }
+        std::filesystem::remove_all(path);
+    }
+}
+
+TEST_CASE("nucleus/tile_scheduler/flat_tile_map")
+{
+    nucleus::tile_scheduler::FlatTileMap<int> map;
+    CHECK(map.empty());
+    CHECK(map.find({ 0, { 0, 0 } }) == map.end());
+    CHECK(map.erase({ 0, { 0, 0 } }) == 0);
+
+    std::vector<tile::Id> ids;
+    for (unsigned zoom = 0; zoom < 6; ++zoom) {
+        for (unsigned x = 0; x < (1u << zoom); ++x) {
+            for (unsigned y = 0; y < (1u << zoom); ++y)
+                ids.push_back({ zoom, { x, y } });
+        }
+    }
+    for (unsigned i = 0; i < ids.size(); ++i)
+        map[ids[i]] = int(i);
+    REQUIRE(map.size() == ids.size());
+    for (unsigned i = 0; i < ids.size(); ++i) {
+        REQUIRE(map.contains(ids[i]));
+        CHECK(map.at(ids[i]) == int(i));
+    }
+    CHECK(unsigned(std::distance(map.begin(), map.end())) == ids.size());
+
+    // erase every other element, the rest must stay reachable (backward shifting)
+    for (unsigned i = 0; i < ids.size(); i += 2)
+        CHECK(map.erase(ids[i]) == 1);
+    CHECK(map.size() == ids.size() / 2);
+    for (unsigned i = 0; i < ids.size(); ++i) {
+        CHECK(map.contains(ids[i]) == (i % 2 == 1));
+        if (i % 2)
+            CHECK(map.find(ids[i])->second == int(i));
+    }
+    CHECK_THROWS_AS(map.at(ids[0]), std::out_of_range);
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(!map.contains(ids[1]));
+}
+
+TEST_CASE("nucleus/tile_scheduler/sharded_tile_map")
+{
+    using ShardedMap = nucleus::tile_scheduler::ShardedTileMap<int, nucleus::tile_scheduler::FlatTileMap>;
+    // coarse tiles share the first shard, finer ones are in the shard of their zoom level 4 ancestor
+    CHECK(ShardedMap::shard_index({ 0, { 0, 0 } }) == 0);
+    CHECK(ShardedMap::shard_index({ 3, { 7, 7 } }) == 0);
+    CHECK(ShardedMap::shard_index({ 4, { 0, 0 } }) == 1);
+    CHECK(ShardedMap::shard_index({ 4, { 15, 15 } }) == ShardedMap::n_shards - 1);
+    CHECK(ShardedMap::shard_index({ 9, { 100, 200 } }) == ShardedMap::shard_index({ 4, { 100 >> 5, 200 >> 5 } }));
+    CHECK(ShardedMap::shard_index({ 18, { 140000, 91000 } }) == ShardedMap::shard_index({ 17, { 70000, 45500 } }));
+
+    ShardedMap map;
+    map[{ 0, { 0, 0 } }] = 1;
+    map[{ 5, { 3, 4 } }] = 2;
+    map[{ 12, { 4000, 10 } }] = 3;
+    map[{ 12, { 4000, 10 } }] = 4;
+    CHECK(map.size() == 3);
+    CHECK(map.at({ 12, { 4000, 10 } }) == 4);
+    CHECK(!map.contains({ 5, { 3, 5 } }));
+    CHECK_THROWS_AS(map.at({ 5, { 3, 5 } }), std::out_of_range);
+
+    const auto merged = map.merged();
+    CHECK(merged.size() == 3);
+    CHECK(merged.at({ 5, { 3, 4 } }) == 2);
+
+    CHECK(map.erase({ 5, { 3, 4 } }) == 1);
+    CHECK(map.erase({ 5, { 3, 4 } }) == 0);
+    CHECK(map.size() == 2);
+    map.clear();
+    CHECK(map.size() == 0);
+    CHECK(!map.contains({ 0, { 0, 0 } }));
+
+    // a single shard, e.g., without locking
+    using SingleShardMap = nucleus::tile_scheduler::ShardedTileMap<int, nucleus::tile_scheduler::FlatTileMap, 0>;
+    CHECK(SingleShardMap::n_shards == 1);
+    CHECK(SingleShardMap::shard_index({ 0, { 0, 0 } }) == 0);
+    CHECK(SingleShardMap::shard_index({ 18, { 140000, 91000 } }) == 0);
+}
+
+TEST_CASE("nucleus/tile_scheduler/missing_quad_set")
+{
+    nucleus::tile_scheduler::MissingQuadSet set;
+    CHECK(set.empty());
+    CHECK(!set.contains({ 5, { 3, 4 } }));
+
+    // the four siblings are consecutive in morton order and merge into one interval
+    const auto siblings = tile::Id { 4, { 1, 2 } }.children();
+    CHECK(set.insert(siblings[0], 100));
+    CHECK(set.insert(siblings[3], 50));
+    CHECK(set.n_intervals() == 2);
+    CHECK(set.insert(siblings[1], 200));
+    CHECK(set.insert(siblings[2], 300));
+    CHECK(!set.insert(siblings[2], 300));
+    CHECK(set.n_quads() == 4);
+    CHECK(set.n_intervals() == 1);
+    for (const auto& id : siblings)
+        CHECK(set.contains(id));
+    CHECK(!set.contains({ 5, { 4, 4 } }));
+    CHECK(!set.contains({ 4, { 1, 2 } })); // other zoom levels are not affected
+    CHECK(!set.contains({ 6, { 4, 8 } }));
+
+    SECTION("erase splits the interval")
+    {
+        CHECK(set.erase(siblings[1]));
+        CHECK(!set.erase(siblings[1]));
+        CHECK(!set.contains(siblings[1]));
+        CHECK(set.contains(siblings[0]));
+        CHECK(set.contains(siblings[2]));
+        CHECK(set.contains(siblings[3]));
+        CHECK(set.n_quads() == 3);
+        CHECK(set.n_intervals() == 2);
+    }
+
+    SECTION("an interval is retired as a whole, by its oldest quad")
+    {
+        CHECK(set.insert({ 5, { 20, 20 } }, 1000));
+        CHECK(set.retire(51) == 4);
+        CHECK(set.n_quads() == 1);
+        CHECK(!set.contains(siblings[1]));
+        CHECK(set.contains({ 5, { 20, 20 } }));
+    }
+
+    SECTION("written to and read from a file")
+    {
+        set.insert({ 12, { 2234, 2675 } }, 1000);
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_missing_quads.alp";
+        REQUIRE(set.write_to_file(path).has_value());
+        nucleus::tile_scheduler::MissingQuadSet read;
+        REQUIRE(read.read_from_file(path).has_value());
+        CHECK(read.n_quads() == set.n_quads());
+        CHECK(read.n_intervals() == set.n_intervals());
+        CHECK(read.contains({ 12, { 2234, 2675 } }));
+        for (const auto& id : siblings)
+            CHECK(read.contains(id));
+        std::filesystem::remove(path);
+        CHECK(read.read_from_file(path).has_value()); // a missing file is an empty set
+        CHECK(read.empty());
+    }
+}
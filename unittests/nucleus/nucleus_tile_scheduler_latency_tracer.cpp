@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/tile_scheduler/LatencyTracer.h"
+
+using nucleus::tile_scheduler::LatencyTracer;
+using Stage = LatencyTracer::Stage;
+
+TEST_CASE("nucleus/tile_scheduler/latency tracer")
+{
+    const auto t0 = LatencyTracer::Clock::now();
+    const auto at = [t0](int msecs) { return t0 + std::chrono::milliseconds(msecs); };
+    const auto quad = tile::Id { 10, { 300, 400 } };
+
+    SECTION("stages are timed from the previous stage of the trace")
+    {
+        LatencyTracer tracer;
+        tracer.set_enabled(true);
+        tracer.mark(quad, Stage::Requested, at(0));
+        tracer.mark(quad, Stage::SlotReleased, at(10));
+        tracer.mark(quad, Stage::NetworkFinished, at(110)); // stages in between were skipped
+        tracer.mark(quad, Stage::Received, at(115));
+        CHECK(tracer.n_traces() == 1);
+        CHECK(tracer.n_finished() == 0);
+        tracer.mark(quad, Stage::Drawn, at(140));
+        CHECK(tracer.n_traces() == 0);
+        CHECK(tracer.n_finished() == 1);
+
+        const auto report = tracer.report();
+        CHECK(report.stages[unsigned(Stage::Requested)].n_samples == 0);
+        CHECK(report.stages[unsigned(Stage::SlotReleased)].p50 == 10.f);
+        CHECK(report.stages[unsigned(Stage::RateReleased)].n_samples == 0);
+        CHECK(report.stages[unsigned(Stage::NetworkFinished)].p50 == 100.f);
+        CHECK(report.stages[unsigned(Stage::Received)].p50 == 5.f);
+        CHECK(report.stages[unsigned(Stage::Drawn)].p50 == 25.f);
+        CHECK(report.total.p50 == 140.f);
+        CHECK(report.total.n_samples == 1);
+    }
+
+    SECTION("untraced quads and repeated requests are ignored")
+    {
+        LatencyTracer tracer;
+        tracer.set_enabled(true);
+        tracer.mark(quad, Stage::Received, at(0)); // e.g., from the disk cache
+        tracer.mark(quad, Stage::Drawn, at(5));
+        CHECK(tracer.n_finished() == 0);
+
+        tracer.mark(quad, Stage::Requested, at(10));
+        tracer.mark(quad, Stage::Requested, at(50)); // reprioritised, the first request counts
+        tracer.mark(quad, Stage::Drawn, at(60));
+        CHECK(tracer.report().total.p50 == 50.f);
+    }
+
+    SECTION("tile stages are attributed to their quad, the last tile counts")
+    {
+        LatencyTracer tracer;
+        tracer.set_enabled(true);
+        tracer.mark(quad, Stage::Requested, at(0));
+        const auto children = quad.children();
+        for (const auto& child : children)
+            tracer.mark_tile(child, Stage::NetworkFinished);
+        CHECK(tracer.n_traces() == 1);
+        tracer.mark_tile(children[2], Stage::Drawn);
+        CHECK(tracer.n_traces() == 0);
+        CHECK(tracer.report().stages[unsigned(Stage::NetworkFinished)].n_samples == 1);
+    }
+
+    SECTION("percentiles over many quads")
+    {
+        LatencyTracer tracer(1000);
+        tracer.set_enabled(true);
+        for (unsigned i = 0; i < 100; ++i) {
+            const auto id = tile::Id { 12, { i, 0 } };
+            tracer.mark(id, Stage::Requested, at(0));
+            tracer.mark(id, Stage::Drawn, at(int(i) + 1)); // 1 .. 100 msecs
+        }
+        const auto total = tracer.report().total;
+        CHECK(total.n_samples == 100);
+        CHECK(total.p50 == 51.f);
+        CHECK(total.p95 == 96.f);
+        CHECK(total.p99 == 100.f);
+        CHECK(!LatencyTracer::format(tracer.report()).empty());
+    }
+
+    SECTION("the sample ring keeps the latest samples")
+    {
+        LatencyTracer tracer(4);
+        tracer.set_enabled(true);
+        for (unsigned i = 0; i < 10; ++i) {
+            const auto id = tile::Id { 12, { i, 0 } };
+            tracer.mark(id, Stage::Requested, at(0));
+            tracer.mark(id, Stage::Drawn, at(i < 6 ? 1000 : 10));
+        }
+        const auto total = tracer.report().total;
+        CHECK(total.n_samples == 4);
+        CHECK(total.p99 == 10.f);
+    }
+
+    SECTION("the tracer is disabled by default, stale traces are pruned")
+    {
+        LatencyTracer tracer(16, 4);
+        CHECK(!tracer.enabled());
+        tracer.mark(quad, Stage::Requested, at(0));
+        CHECK(tracer.n_traces() == 0);
+        CHECK(LatencyTracer::format(tracer.report()).empty());
+
+        tracer.set_enabled(true);
+        for (unsigned i = 0; i < 4; ++i)
+            tracer.mark(tile::Id { 12, { i, 0 } }, Stage::Requested, at(0));
+        CHECK(tracer.n_traces() == 4);
+        tracer.mark(quad, Stage::Requested, at(61 * 1000));
+        CHECK(tracer.n_traces() == 1);
+    }
+}
@@ -62,6 +62,18 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
             CHECK(joined.ortho->isEmpty());
             CHECK(joined.height->isEmpty());
         }
+        {
+            auto ortho = good_tile({ 0, { 0, 0 } }, "ortho");
+            ortho.validator = { "\"ortho etag\"", "Wed, 21 Oct 2015 07:28:00 GMT" };
+            auto height = good_tile({ 0, { 0, 0 } }, "height");
+            height.validator.etag = "\"height etag\"";
+            const auto joined = LayerAssembler::join(ortho, height);
+            CHECK(joined.ortho_validator.etag == "\"ortho etag\"");
+            CHECK(joined.ortho_validator.last_modified == "Wed, 21 Oct 2015 07:28:00 GMT");
+            CHECK(joined.height_validator.etag == "\"height etag\"");
+            CHECK(joined.height_validator.last_modified.isEmpty());
+            CHECK(LayerAssembler::join(ortho, missing_tile({ 0, { 0, 0 } })).ortho_validator.empty());
+        }
     }
 
     SECTION("request only once")
@@ -75,6 +87,34 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
         CHECK(spy_loaded.empty());
     }
 
+    SECTION("layers that are not selected are inherited")
+    {
+        assembler.set_layer_selector([](const tile::Id& id) { return nucleus::tile_scheduler::tile_types::LayerSelection { .ortho = id.zoom_level < 2, .height = true }; });
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_ortho(&assembler, &LayerAssembler::ortho_requested);
+        QSignalSpy spy_height(&assembler, &LayerAssembler::height_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+
+        assembler.load(tile::Id { 1, { 0, 0 } });
+        assembler.load(tile::Id { 2, { 0, 0 } });
+        CHECK(spy_requested.size() == 2);
+        REQUIRE(spy_ortho.size() == 1);
+        CHECK(spy_ortho.constFirst().constFirst().value<tile::Id>() == tile::Id { 1, { 0, 0 } });
+        CHECK(spy_height.size() == 2);
+        CHECK(spy_loaded.empty());
+
+        assembler.deliver_height(good_tile({ 2, { 0, 0 } }, "height 2"));
+        REQUIRE(spy_loaded.size() == 1);
+        const auto loaded_tile = spy_loaded.constFirst().constFirst().value<LayeredTile>();
+        CHECK(loaded_tile.id == tile::Id { 2, { 0, 0 } });
+        CHECK(loaded_tile.network_info.status == NetworkInfo::Status::Good);
+        CHECK(loaded_tile.ortho_inherited);
+        CHECK(!loaded_tile.height_inherited);
+        CHECK(loaded_tile.ortho->isEmpty());
+        CHECK(*loaded_tile.height == QByteArray("height 2"));
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
     SECTION("assemble 1 (ortho, height)")
     {
         QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
@@ -195,4 +235,60 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
         REQUIRE(!loaded_tile.height->size());
         CHECK(assembler.n_items_in_flight() == 0);
     }
+
+    SECTION("cancel forgets delivered layers")
+    {
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+        QSignalSpy spy_cancelled(&assembler, &LayerAssembler::tiles_cancelled);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.deliver_ortho(good_tile({ 0, { 0, 0 } }, "ortho"));
+        CHECK(assembler.n_items_in_flight() == 1);
+
+        assembler.cancel_tiles({ tile::Id { 0, { 0, 0 } } });
+        CHECK(assembler.n_items_in_flight() == 0);
+        REQUIRE(spy_cancelled.size() == 1);
+        CHECK(spy_cancelled[0][0].value<std::vector<tile::Id>>() == std::vector { tile::Id { 0, { 0, 0 } } });
+
+        assembler.deliver_height(good_tile({ 0, { 0, 0 } }, "height"));
+        CHECK(spy_loaded.empty());
+    }
+
+    SECTION("labels are loaded within the zoom range")
+    {
+        assembler.set_label_zoom_range(1, 1);
+        QSignalSpy spy_labels(&assembler, &LayerAssembler::labels_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.load(tile::Id { 1, { 0, 0 } });
+        REQUIRE(spy_labels.size() == 1);
+        CHECK(spy_labels.constFirst().constFirst().value<tile::Id>() == tile::Id { 1, { 0, 0 } });
+
+        assembler.deliver_ortho(good_tile({ 0, { 0, 0 } }, "ortho 0"));
+        assembler.deliver_height(good_tile({ 0, { 0, 0 } }, "height 0"));
+        REQUIRE(spy_loaded.size() == 1); // outside of the range, emitted without labels
+        CHECK(spy_loaded.constFirst().constFirst().value<LayeredTile>().labels->isEmpty());
+
+        assembler.deliver_ortho(good_tile({ 1, { 0, 0 } }, "ortho 1"));
+        assembler.deliver_height(good_tile({ 1, { 0, 0 } }, "height 1"));
+        CHECK(spy_loaded.size() == 1);
+        CHECK(assembler.n_items_in_flight() == 2);
+
+        assembler.deliver_labels(good_tile({ 1, { 0, 0 } }, "labels 1"));
+        REQUIRE(spy_loaded.size() == 2);
+        const auto loaded_tile = spy_loaded.at(1).constFirst().value<LayeredTile>();
+        CHECK(*loaded_tile.ortho == QByteArray("ortho 1"));
+        CHECK(*loaded_tile.labels == QByteArray("labels 1"));
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
+    SECTION("missing labels don't affect the tile")
+    {
+        const tile::Id id = { 0, { 0, 0 } };
+        const auto joined = LayerAssembler::join(good_tile(id, "ortho"), good_tile(id, "height"), missing_tile(id));
+        CHECK(joined.network_info.status == NetworkInfo::Status::Good);
+        CHECK(*joined.ortho == "ortho");
+        CHECK(joined.labels->isEmpty());
+        CHECK(*LayerAssembler::join(good_tile(id, "ortho"), good_tile(id, "height"), good_tile(id, "labels")).labels == "labels");
+        CHECK(LayerAssembler::join(good_tile(id, "ortho"), missing_tile(id), good_tile(id, "labels")).labels->isEmpty());
+    }
 }
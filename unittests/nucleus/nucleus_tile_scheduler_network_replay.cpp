@@ -0,0 +1,167 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <filesystem>
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/tile_scheduler/NetworkRecording.h"
+#include "nucleus/tile_scheduler/NetworkReplay.h"
+#include "nucleus/tile_scheduler/PackTileSource.h"
+#include "nucleus/tile_scheduler/TileLoadService.h"
+
+using namespace nucleus::tile_scheduler;
+using nucleus::tile_scheduler::tile_types::TileLayer;
+using Status = nucleus::tile_scheduler::tile_types::NetworkInfo::Status;
+
+TEST_CASE("nucleus/tile_scheduler/NetworkReplay")
+{
+    const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_network_recording";
+    std::filesystem::remove_all(path);
+    const auto id = tile::Id { .zoom_level = 9, .coords = { 273, 177 } };
+    const auto missing = tile::Id { .zoom_level = 10, .coords = { 0, 0 } };
+    const auto broken = tile::Id { .zoom_level = 10, .coords = { 1, 0 } };
+
+    SECTION("record mode of TileLoadService")
+    {
+        const auto pack_path = path / "pack";
+        REQUIRE(PackTileSource::write(pack_path, { { id, QByteArray("jpeg bytes") } }).has_value());
+        auto source = std::make_shared<PackTileSource>(pack_path);
+        REQUIRE(source->open().has_value());
+        TileLoadService service(source);
+        auto recording = std::make_shared<NetworkRecording>();
+        service.set_recording(recording);
+        QSignalSpy spy(&service, &TileLoadService::load_finished);
+        service.load(id);
+        service.load(missing);
+        while (spy.count() < 2 && spy.wait(100)) { }
+        REQUIRE(spy.count() == 2);
+        REQUIRE(recording->size() == 2);
+        CHECK(recording->find(id)->status == Status::Good);
+        CHECK(*recording->find(id)->data == "jpeg bytes");
+        CHECK(recording->find(missing)->status == Status::NotFound);
+
+        // cancelled requests are not recorded
+        service.set_recording(nullptr);
+        recording = std::make_shared<NetworkRecording>();
+        service.set_recording(recording);
+        service.load(id);
+        service.cancel({ id });
+        spy.wait(50);
+        CHECK(recording->size() == 0);
+    }
+
+    SECTION("write and read back")
+    {
+        NetworkRecording recording;
+        recording.add(id, { Status::Good, 120, std::make_shared<QByteArray>("jpeg bytes") });
+        recording.add(broken, { Status::NetworkError, 5000, std::make_shared<QByteArray>() });
+        REQUIRE(recording.write(path).has_value());
+        CHECK(!NetworkRecording::read(path / "missing").has_value());
+
+        const auto read = NetworkRecording::read(path);
+        REQUIRE(read.has_value());
+        REQUIRE((*read)->size() == 2);
+        CHECK((*read)->find(id)->status == Status::Good);
+        CHECK((*read)->find(id)->msecs == 120);
+        CHECK(*(*read)->find(id)->data == "jpeg bytes");
+        CHECK((*read)->find(broken)->status == Status::NetworkError);
+        CHECK((*read)->find(broken)->msecs == 5000);
+        CHECK(!(*read)->find(missing));
+    }
+
+    SECTION("link shaping")
+    {
+        // 100 kb/s: a 10 kb response takes 100 msecs on the link, the second one is queued behind the first
+        auto profile = NetworkProfile { "test", false, 20, 0, 100000, 0.f, 0, 0.f };
+        NetworkLink link(profile);
+        const auto first = link.transfer(10000, 0);
+        const auto second = link.transfer(10000, 0);
+        CHECK(!first.failed);
+        CHECK(first.delay_msecs >= 120);
+        CHECK(first.delay_msecs <= 125);
+        CHECK(second.delay_msecs >= 215); // minus the time between the two calls
+        CHECK(second.delay_msecs <= 230);
+
+        // the same seed gives the same times
+        profile.jitter_msecs = 10;
+        profile.loss_rate = 0.5f;
+        profile.retransmission_msecs = 200;
+        profile.bytes_per_second = 0;
+        NetworkLink a(profile);
+        NetworkLink b(profile);
+        unsigned n_retransmissions = 0;
+        for (int i = 0; i < 20; ++i) {
+            const auto ta = a.transfer(1000, 0);
+            const auto tb = b.transfer(1000, 0);
+            CHECK(ta.delay_msecs >= 10);
+            CHECK(ta.delay_msecs <= 231);
+            CHECK(std::abs(int(ta.delay_msecs) - int(tb.delay_msecs)) <= 1);
+            n_retransmissions += ta.delay_msecs > 100;
+        }
+        CHECK(n_retransmissions > 0);
+        CHECK(n_retransmissions < 20);
+
+        const auto recorded = NetworkLink(NetworkProfile::recorded()).transfer(1000, 321);
+        CHECK(recorded.delay_msecs == 321);
+    }
+
+    SECTION("replay through TileLoadService")
+    {
+        auto recording = std::make_shared<NetworkRecording>();
+        recording->add(id, { Status::Good, 80, std::make_shared<QByteArray>("jpeg bytes") });
+        recording->add(broken, { Status::NetworkError, 10, std::make_shared<QByteArray>() });
+        TileLoadService service(std::make_shared<NetworkReplay>(recording, std::make_shared<NetworkLink>(NetworkProfile::recorded())));
+        QSignalSpy spy(&service, &TileLoadService::load_finished);
+        QElapsedTimer timer;
+        timer.start();
+        service.load(id);
+        service.load(broken);
+        service.load(missing);
+        while (spy.count() < 3 && spy.wait(200)) { }
+        REQUIRE(spy.count() == 3);
+        CHECK(timer.elapsed() >= 80);
+        // in the order of the recorded times
+        {
+            const auto tile = spy.takeFirst().at(0).value<TileLayer>();
+            CHECK(tile.id == missing);
+            CHECK(tile.network_info.status == Status::NotFound);
+        }
+        {
+            const auto tile = spy.takeFirst().at(0).value<TileLayer>();
+            CHECK(tile.id == broken);
+            CHECK(tile.network_info.status == Status::NetworkError);
+        }
+        {
+            const auto tile = spy.takeFirst().at(0).value<TileLayer>();
+            CHECK(tile.id == id);
+            CHECK(tile.network_info.status == Status::Good);
+            CHECK(*tile.data == "jpeg bytes");
+        }
+
+        // cancelled requests are not delivered
+        service.load(id);
+        service.cancel({ id });
+        spy.wait(150);
+        CHECK(spy.count() == 0);
+    }
+    std::filesystem::remove_all(path);
+}
@@ -233,4 +233,79 @@ TEST_CASE("nucleus/tile_scheduler/quad assembler")
         CHECK(loaded_tile.id == tile::Id { 0, { 0, 0 } });
         CHECK(loaded_tile.network_info().status == NetworkInfo::Status::NotFound);
     }
+
+    SECTION("cancel")
+    {
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+        QSignalSpy spy_cancelled(&assembler, &QuadAssembler::tiles_cancelled);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100"));
+
+        assembler.cancel_quads({ tile::Id { 0, { 0, 0 } }, tile::Id { 3, { 4, 5 } } });
+        CHECK(assembler.n_items_in_flight() == 0);
+        REQUIRE(spy_cancelled.size() == 1);
+        CHECK(spy_cancelled[0][0].value<std::vector<tile::Id>>().size() == 4); // only the quad that was in flight
+
+        // late deliveries are dropped
+        assembler.deliver_tile(good_tile({ 1, { 0, 1 } }, "ortho 101", "height 101"));
+        CHECK(assembler.n_items_in_flight() == 0);
+
+        // a new request starts from scratch
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        for (const auto& id : tile::Id { 0, { 0, 0 } }.children())
+            assembler.deliver_tile(good_tile(id, "ortho", "height"));
+        REQUIRE(spy_loaded.size() == 1);
+        CHECK(spy_loaded[0][0].value<TileQuad>().n_tiles == 4);
+    }
+
+    SECTION("partial quads time out, are retried with backoff and finally delivered as network error")
+    {
+        QSignalSpy spy_requested(&assembler, &QuadAssembler::tile_requested);
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+        QSignalSpy spy_cancelled(&assembler, &QuadAssembler::tiles_cancelled);
+        uint64_t now = 1000;
+        assembler.set_clock([&now]() { return now; });
+        assembler.set_assembly_timeout(5, 1);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100"));
+        REQUIRE(spy_requested.size() == 4);
+
+        assembler.check_deadlines();
+        CHECK(spy_cancelled.empty()); // not yet
+        now = 1004;
+        assembler.check_deadlines();
+        CHECK(spy_cancelled.empty());
+
+        now = 1005;
+        assembler.check_deadlines();
+        REQUIRE(spy_cancelled.size() == 1);
+        CHECK(spy_cancelled[0][0].value<std::vector<tile::Id>>().size() == 3);
+        CHECK(spy_requested.size() == 7); // the missing tiles are requested again
+        CHECK(assembler.n_items_in_flight() == 1);
+
+        now = 1014;
+        assembler.check_deadlines();
+        CHECK(spy_cancelled.size() == 1); // the timeout doubled
+
+        now = 1015;
+        assembler.check_deadlines();
+        CHECK(spy_cancelled.size() == 2);
+        CHECK(spy_requested.size() == 7);
+        CHECK(assembler.n_items_in_flight() == 0);
+        CHECK(assembler.n_timeouts() == 2);
+        REQUIRE(spy_loaded.size() == 1);
+        const auto quad = spy_loaded[0][0].value<TileQuad>();
+        CHECK(quad.n_tiles == 4);
+        CHECK(quad.network_info().status == NetworkInfo::Status::NetworkError);
+    }
+
+    SECTION("duplicated deliveries don't complete a quad")
+    {
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        for (int i = 0; i < 4; ++i)
+            assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100"));
+        CHECK(spy_loaded.empty());
+        CHECK(assembler.n_items_in_flight() == 1);
+    }
 }
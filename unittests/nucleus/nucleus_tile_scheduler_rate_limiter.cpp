@@ -181,6 +181,24 @@ TEST_CASE("nucleus/tile_scheduler/rate limiter")
         }
     }
 
+    SECTION("cancelling drops queued requests and forwards the others")
+    {
+        RateLimiter rl;
+        rl.set_limit(1, 1000 * timing_multiplicator);
+        QSignalSpy spy(&rl, &RateLimiter::quad_requested);
+        QSignalSpy spy_cancelled(&rl, &RateLimiter::quads_cancelled);
+        rl.request_quad(tile::Id { 0, { 0, 0 } });
+        rl.request_quad(tile::Id { 1, { 0, 0 } });
+        rl.request_quad(tile::Id { 1, { 0, 1 } });
+        CHECK(spy.size() == 1);
+        CHECK(rl.queue_size() == 2);
+
+        rl.cancel_quads({ tile::Id { 0, { 0, 0 } }, tile::Id { 1, { 0, 0 } } });
+        CHECK(rl.queue_size() == 1);
+        REQUIRE(spy_cancelled.size() == 1);
+        CHECK(spy_cancelled[0][0].value<std::vector<tile::Id>>() == std::vector { tile::Id { 0, { 0, 0 } } });
+    }
+
     SECTION("fuzzy load test")
     {
         std::mt19937 mt(42);
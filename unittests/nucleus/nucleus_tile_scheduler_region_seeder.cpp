@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <unordered_set>
+
+#include <catch2/catch_test_macros.hpp>
+#include <QSignalSpy>
+#include <QStandardPaths>
+
+#include "nucleus/tile_scheduler/Cache.h"
+#include "nucleus/tile_scheduler/RegionSeeder.h"
+#include "nucleus/tile_scheduler/TilePack.h"
+
+using nucleus::tile_scheduler::RegionSeeder;
+using namespace nucleus::tile_scheduler::tile_types;
+
+namespace {
+TileQuad quad_for(const tile::Id& id, NetworkInfo::Status status = NetworkInfo::Status::Good)
+{
+    TileQuad quad;
+    quad.id = id;
+    quad.n_tiles = 4;
+    const auto children = id.children();
+    for (unsigned i = 0; i < 4; ++i) {
+        quad.tiles[i].id = children[i];
+        quad.tiles[i].network_info = { status, 0 };
+        quad.tiles[i].ortho = std::make_shared<QByteArray>("ortho");
+        quad.tiles[i].height = std::make_shared<QByteArray>("height");
+    }
+    return quad;
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/region_seeder")
+{
+    // around the grossglockner
+    const std::vector<glm::dvec2> polygon = { { 47.0, 12.6 }, { 47.0, 12.8 }, { 47.2, 12.8 }, { 47.2, 12.6 } };
+
+    SECTION("quads in polygon")
+    {
+        const auto quads = RegionSeeder::quads_in_polygon(polygon, 10);
+        REQUIRE(!quads.empty());
+        CHECK(quads.front() == tile::Id { 0, { 0, 0 } });
+        std::unordered_set<tile::Id, tile::Id::Hasher> unique(quads.begin(), quads.end());
+        CHECK(unique.size() == quads.size());
+        for (const auto& id : quads) {
+            CHECK(id.zoom_level < 10);
+            if (id.zoom_level > 0)
+                CHECK(unique.contains(id.parent()));
+        }
+        CHECK(RegionSeeder::quads_in_polygon(polygon, 12).size() > quads.size());
+        CHECK(RegionSeeder::quads_in_polygon({}, 12).empty());
+    }
+
+    SECTION("writes into a tile pack and resumes")
+    {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_region_seeder";
+        std::filesystem::remove_all(path);
+        const auto quads = RegionSeeder::quads_in_polygon(polygon, 6);
+
+        const auto run = [&](bool fail_root) {
+            RegionSeeder seeder;
+            seeder.set_concurrency(2);
+            seeder.set_commit_interval(2);
+            REQUIRE(seeder.prepare(path, quads).has_value());
+            std::vector<tile::Id> requested;
+            QObject::connect(&seeder, &RegionSeeder::quads_requested, [&](const std::vector<tile::Id>& ids) { requested = ids; });
+            QSignalSpy finished(&seeder, &RegionSeeder::finished);
+            seeder.start();
+            while (!seeder.is_finished()) {
+                REQUIRE(!requested.empty());
+                CHECK(requested.size() <= 4);
+                const auto id = requested.front();
+                const auto fail = fail_root && id == tile::Id { 0, { 0, 0 } };
+                seeder.receive_quad(quad_for(id, fail ? NetworkInfo::Status::NetworkError : NetworkInfo::Status::Good));
+                std::erase(requested, id);
+            }
+            CHECK(finished.size() == 1);
+            return seeder.statistics();
+        };
+
+        const auto first = run(true);
+        CHECK(first.n_quads_total == quads.size());
+        CHECK(first.n_quads_written == quads.size() - 1);
+        CHECK(first.n_quads_failed == 1);
+        CHECK(first.n_bytes_downloaded == first.n_quads_written * 4 * (5 + 6));
+
+        const auto second = run(false);
+        CHECK(second.n_quads_skipped == quads.size() - 1);
+        CHECK(second.n_quads_written == 1);
+
+        // the app can read it as disk cache
+        nucleus::tile_scheduler::MemoryCache cache;
+        REQUIRE(cache.read_from_pack(path).has_value());
+        CHECK(cache.n_cached_objects() == quads.size());
+        CHECK(*cache.peak_at({ 0, { 0, 0 } }).tiles[0].ortho == "ortho");
+        std::filesystem::remove_all(path);
+    }
+}
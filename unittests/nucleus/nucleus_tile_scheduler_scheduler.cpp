@@ -16,10 +16,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <limits>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <QCoreApplication>
 #include <QSignalSpy>
 #include <QThread>
 
@@ -32,6 +35,7 @@
 #include "radix/TileHeights.h"
 #include "test_helpers.h"
 
+using nucleus::tile_scheduler::MissingQuadSet;
 using nucleus::tile_scheduler::Scheduler;
 using namespace nucleus::tile_scheduler::tile_types;
 
@@ -270,6 +274,78 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         CHECK(spy.size() == 1);
     }
 
+    SECTION("adaptive update cadence: first change after rest right away, a settle update when the camera stops")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_update_timeout(300); // below the rest threshold of 500 msecs, independent of the timing multiplicator
+        scheduler->set_adaptive_update_cadence(true);
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        test_helpers::process_events_for(2 * timing_multiplicator);
+        CHECK(spy.size() == 1);
+
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        test_helpers::process_events_for(2 * timing_multiplicator);
+        CHECK(spy.size() == 1); // in motion, but not moving: waits for the update timeout
+
+        test_helpers::process_events_for(1000);
+        CHECK(spy.size() == 3); // update timeout and settle update
+    }
+
+    SECTION("posted cameras are delivered queued, latest value wins")
+    {
+        auto reference = default_scheduler();
+        QSignalSpy reference_spy(reference.get(), &Scheduler::quads_requested);
+        reference->update_camera(nucleus::camera::stored_positions::grossglockner());
+        reference->send_quad_requests();
+        REQUIRE(reference_spy.size() == 1);
+
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->post_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->post_camera(nucleus::camera::stored_positions::oestl_hochgrubach_spitze());
+        scheduler->post_camera(nucleus::camera::stored_positions::grossglockner());
+        QCoreApplication::processEvents();
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().constFirst().value<std::vector<tile::Id>>() == reference_spy.constFirst().constFirst().value<std::vector<tile::Id>>());
+    }
+
+    SECTION("the quads of all views are requested together")
+    {
+        const auto requested_for = [](const std::vector<nucleus::camera::Definition>& cameras) {
+            auto scheduler = default_scheduler();
+            QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+            scheduler->update_camera(cameras.front());
+            for (unsigned i = 1; i < cameras.size(); ++i)
+                scheduler->update_view_camera(i, cameras[i]);
+            CHECK(scheduler->n_views() == cameras.size());
+            scheduler->send_quad_requests();
+            REQUIRE(spy.size() == 1);
+            const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+            return std::unordered_set<tile::Id, tile::Id::Hasher>(quads.begin(), quads.end());
+        };
+        const auto stephansdom = requested_for({ nucleus::camera::stored_positions::stephansdom() });
+        const auto grossglockner = requested_for({ nucleus::camera::stored_positions::grossglockner() });
+        const auto both = requested_for({ nucleus::camera::stored_positions::stephansdom(), nucleus::camera::stored_positions::grossglockner() });
+
+        auto expected = stephansdom;
+        expected.insert(grossglockner.begin(), grossglockner.end());
+        CHECK(both == expected);
+        CHECK(both.size() > stephansdom.size());
+
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_view_camera(1, nucleus::camera::stored_positions::grossglockner());
+        scheduler->remove_view(1);
+        CHECK(scheduler->n_views() == 1);
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        CHECK(std::unordered_set<tile::Id, tile::Id::Hasher>(quads.begin(), quads.end()) == stephansdom);
+    }
+
     SECTION("quads are being requested")
     {
         auto scheduler = default_scheduler();
@@ -302,6 +378,259 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
               == quads.end());
     }
 
+    SECTION("quads are requested by priority, parents first, the foreground before the background")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        const auto camera = nucleus::camera::stored_positions::stephansdom();
+        scheduler->update_camera(camera);
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        REQUIRE(quads.size() >= 5);
+        CHECK(quads.front() == tile::Id { 0, { 0, 0 } });
+
+        std::unordered_map<tile::Id, size_t, tile::Id::Hasher> position;
+        for (size_t i = 0; i < quads.size(); ++i)
+            position[quads[i]] = i;
+        for (const auto& id : quads) {
+            if (id.zoom_level > 0)
+                CHECK(position.at(id.parent()) < position.at(id));
+        }
+        TileHeights h;
+        h.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+        const auto error = nucleus::tile_scheduler::utils::screen_space_error_functor(camera, nucleus::tile_scheduler::utils::AabbDecorator::make(std::move(h)));
+        for (size_t i = 1; i < quads.size(); ++i)
+            CHECK(error(quads[i - 1]) >= error(quads[i]));
+    }
+
+    SECTION("occluded quads and their descendants are requested last")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        REQUIRE(quads.size() >= 5);
+        const auto occluded = quads[1];
+        const auto below_occluded = [&occluded](tile::Id id) {
+            while (id.zoom_level > occluded.zoom_level)
+                id = id.parent();
+            return id == occluded;
+        };
+
+        scheduler->set_occluded_tiles({ occluded });
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 2);
+        const auto prioritised = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        REQUIRE(prioritised.size() == quads.size());
+        CHECK(prioritised.front() == tile::Id { 0, { 0, 0 } });
+        const auto first_occluded = std::find_if(prioritised.begin(), prioritised.end(), below_occluded);
+        REQUIRE(first_occluded != prioritised.end());
+        CHECK(std::all_of(first_occluded, prioritised.end(), below_occluded));
+
+        scheduler->set_occluded_tiles({});
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 3);
+        CHECK(spy.constLast().constFirst().value<std::vector<tile::Id>>() == quads);
+    }
+
+    SECTION("requests are also emitted as changes since the last update")
+    {
+        auto scheduler = scheduler_with_aabb(); // not enabled, so no requests were sent yet
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        QSignalSpy spy_diff(scheduler.get(), &Scheduler::quad_requests_changed);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        REQUIRE(spy_diff.size() == 1);
+        const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        const auto first = spy_diff.constFirst().constFirst().value<QuadRequestDiff>();
+        REQUIRE(first.added.size() == quads.size());
+        for (size_t i = 0; i < quads.size(); ++i)
+            CHECK(first.added[i].id == quads[i]);
+        CHECK(first.removed.empty());
+
+        // nothing changed
+        scheduler->send_quad_requests();
+        CHECK(spy_diff.size() == 1);
+
+        // a delivered quad went through the limiter, there is nothing to tell it
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+        scheduler->send_quad_requests();
+        CHECK(spy.constLast().constFirst().value<std::vector<tile::Id>>().size() == quads.size() - 1);
+        CHECK(spy_diff.size() == 1);
+
+        // a quad that failed to load is requested again
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 1, { 1, 1 } }, 4, NetworkInfo::Status::NetworkError));
+        scheduler->send_quad_requests();
+        REQUIRE(spy_diff.size() == 2);
+        const auto second = spy_diff.constLast().constFirst().value<QuadRequestDiff>();
+        REQUIRE(second.added.size() == 1);
+        CHECK(second.added.front().id == tile::Id { 1, { 1, 1 } });
+        CHECK(second.removed.empty());
+
+        // the camera moved away
+        scheduler->update_camera(nucleus::camera::stored_positions::grossglockner());
+        scheduler->send_quad_requests();
+        REQUIRE(spy_diff.size() == 3);
+        CHECK(!spy_diff.constLast().constFirst().value<QuadRequestDiff>().removed.empty());
+    }
+
+    SECTION("quads of the predicted view are prefetched after the current ones, within the budget")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->set_prefetch_target(nucleus::camera::stored_positions::grossglockner());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto current = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        CHECK(scheduler->predicted_cameras().size() == 1); // prefetching is disabled by default
+
+        scheduler->set_prefetch_budget(10);
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 2);
+        const auto with_prefetch = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        REQUIRE(with_prefetch.size() == current.size() + 10);
+        CHECK(std::equal(current.begin(), current.end(), with_prefetch.begin()));
+        for (auto i = current.size(); i < with_prefetch.size(); ++i)
+            CHECK(std::find(current.begin(), current.end(), with_prefetch[i]) == current.end());
+
+        // arrived
+        scheduler->update_camera(nucleus::camera::stored_positions::grossglockner());
+        CHECK(scheduler->predicted_cameras().size() <= 1); // at most the extrapolated motion
+    }
+
+    SECTION("a ring around the loaded view is prefetched at rest, and cancelled when the camera moves")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        QSignalSpy spy_diff(scheduler.get(), &Scheduler::quad_requests_changed);
+        scheduler->set_idle_prefetch({ .max_quads = 6, .max_in_flight = 4, .delay = 0 });
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto visible = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        REQUIRE(!visible.empty());
+        for (const auto& id : visible)
+            scheduler->receive_quad(example_tile_quad_for(id));
+
+        // the view is loaded, at most max_in_flight of the ring and centre are requested
+        scheduler->send_quad_requests();
+        const auto first_idle = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        REQUIRE(first_idle.size() == 4);
+        for (const auto& id : first_idle)
+            CHECK(std::find(visible.begin(), visible.end(), id) == visible.end());
+        const auto diff = spy_diff.constLast().constFirst().value<QuadRequestDiff>();
+        REQUIRE(!diff.added.empty());
+        CHECK(std::all_of(diff.added.begin(), diff.added.end(), [](const QuadRequest& r) { return r.tier == QuadRequest::Tier::Idle; }));
+
+        // two arrived, the remaining two of the budget follow
+        scheduler->receive_quad(example_tile_quad_for(first_idle[0]));
+        scheduler->receive_quad(example_tile_quad_for(first_idle[1]));
+        scheduler->send_quad_requests();
+        const auto second_idle = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        CHECK(second_idle.size() == 4);
+        for (const auto& id : second_idle) {
+            CHECK(id != first_idle[0]);
+            CHECK(id != first_idle[1]);
+        }
+
+        // the camera moves: the limiters are told right away, before the next update
+        const auto n_diffs = spy_diff.size();
+        auto moved = nucleus::camera::stored_positions::stephansdom();
+        moved.move({ 100, 0, 0 });
+        scheduler->update_camera(moved);
+        REQUIRE(spy_diff.size() == n_diffs + 1);
+        const auto cancelled = spy_diff.constLast().constFirst().value<QuadRequestDiff>();
+        CHECK(cancelled.added.empty());
+        CHECK(cancelled.removed.size() == second_idle.size());
+
+        // nothing idle while the cache is (almost) full
+        scheduler->set_idle_prefetch({ .max_quads = 6, .ram_fraction = 0.0f, .delay = 0 });
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        CHECK(spy.constLast().constFirst().value<std::vector<tile::Id>>().empty());
+    }
+
+    SECTION("metered connections request fewer quads from the network, the cached ones are still used")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        QSignalSpy spy_bundles(scheduler.get(), &Scheduler::bundle_requests_changed);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->set_prefetch_target(nucleus::camera::stored_positions::grossglockner());
+        scheduler->set_prefetch_budget(10);
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto unmetered = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+
+        const auto metered_policy = Scheduler::NetworkPolicy::from_string("prefetch=0,max_zoom=12,error_factor=2,bundles=0");
+        REQUIRE(metered_policy.has_value());
+        scheduler->set_network_policies({}, *metered_policy);
+        CHECK(spy_bundles.empty()); // not metered yet
+        scheduler->set_network_metered(true);
+        REQUIRE(spy_bundles.size() == 1);
+        CHECK(!spy_bundles.constFirst().constFirst().toBool());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 2);
+        const auto metered = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        CHECK(!metered.empty());
+        CHECK(metered.size() < unmetered.size() - 10);
+        for (const auto& id : metered) {
+            CHECK(id.zoom_level < 12);
+            CHECK(std::find(unmetered.begin(), unmetered.end(), id) != unmetered.end());
+        }
+
+        scheduler->set_network_metered(false);
+        CHECK(spy_bundles.size() == 2);
+        scheduler->send_quad_requests();
+        CHECK(spy.constLast().constFirst().value<std::vector<tile::Id>>() == unmetered);
+    }
+
+    SECTION("network policies are parsed from key value pairs")
+    {
+        const auto policy = Scheduler::NetworkPolicy::from_string("prefetch=0, max_zoom=15,error_factor=1.5");
+        REQUIRE(policy.has_value());
+        CHECK(!policy->prefetch);
+        CHECK(policy->max_zoom_level == 15);
+        CHECK(policy->error_factor == 1.5f);
+        CHECK(policy->bundle_requests);
+        CHECK(Scheduler::NetworkPolicy::from_string("") == Scheduler::NetworkPolicy {});
+        CHECK(!Scheduler::NetworkPolicy::from_string("max_zoom").has_value());
+        CHECK(!Scheduler::NetworkPolicy::from_string("max_zoom=high").has_value());
+        CHECK(!Scheduler::NetworkPolicy::from_string("error_factor=0.5").has_value());
+        CHECK(!Scheduler::NetworkPolicy::from_string("colour=blue").has_value());
+    }
+
+    SECTION("layers have their own level of detail")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        for (const auto& id : quads) {
+            const auto layers = scheduler->layers_for_tile(id.children().front());
+            CHECK(layers.ortho);
+            CHECK(layers.height);
+        }
+
+        // coarser imagery, the tree is refined for the height
+        scheduler->set_layer_permissible_screen_space_errors(8, 2);
+        unsigned n_inherited_orthos = 0;
+        for (const auto& id : quads) {
+            const auto layers = scheduler->layers_for_tile(id.children().front());
+            CHECK(layers.height);
+            n_inherited_orthos += layers.ortho ? 0 : 1;
+        }
+        CHECK(n_inherited_orthos > 0);
+        CHECK(n_inherited_orthos < quads.size());
+    }
+
     SECTION("quads are not requested if there is no network")
     {
         auto scheduler = default_scheduler();
@@ -339,6 +668,21 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 4, { 8, 10 } }) != quads.end());
     }
 
+    SECTION("delivered batches are inserted like single quads")
+    {
+        auto scheduler = default_scheduler();
+        QSignalSpy received_spy(scheduler.get(), &Scheduler::quad_received);
+        scheduler->receive_quads(std::make_shared<const std::vector<TileQuad>>(std::vector<TileQuad> {
+            example_tile_quad_for(tile::Id { 0, { 0, 0 } }),
+            example_tile_quad_for(tile::Id { 1, { 1, 1 } }, 4, NetworkInfo::Status::NetworkError),
+            example_tile_quad_for(tile::Id { 2, { 2, 2 } }),
+        }));
+        CHECK(received_spy.size() == 2);
+        CHECK(scheduler->ram_cache().contains(tile::Id { 0, { 0, 0 } }));
+        CHECK(!scheduler->ram_cache().contains(tile::Id { 1, { 1, 1 } }));
+        CHECK(scheduler->ram_cache().contains(tile::Id { 2, { 2, 2 } }));
+    }
+
     SECTION("network failed tiles are ignored, not found tiles are not ignored")
     {
         auto scheduler = default_scheduler();
@@ -364,6 +708,101 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 4, { 8, 10 } }) != quads.end());
     }
 
+    SECTION("missing quads are remembered compactly, and neither they nor their descendants are requested")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 1, { 1, 1 } }));
+        auto missing = example_tile_quad_for(tile::Id { 2, { 2, 2 } }, 4, NetworkInfo::Status::NotFound);
+        for (auto& tile : missing.tiles) {
+            tile.ortho = std::make_shared<QByteArray>();
+            tile.height = std::make_shared<QByteArray>();
+        }
+        scheduler->receive_quad(missing);
+        CHECK(scheduler->missing_quads().contains(tile::Id { 2, { 2, 2 } }));
+        CHECK(!scheduler->ram_cache().contains(tile::Id { 2, { 2, 2 } }));
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 2, { 2, 2 } }) == quads.end());
+        CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 3, { 4, 5 } }) == quads.end());
+        CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 4, { 8, 10 } }) == quads.end());
+
+        // delivered after all (e.g., the coverage grew)
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 2, { 2, 2 } }));
+        CHECK(!scheduler->missing_quads().contains(tile::Id { 2, { 2, 2 } }));
+        CHECK(scheduler->ram_cache().contains(tile::Id { 2, { 2, 2 } }));
+    }
+
+    SECTION("missing quads are asked for again after they get too old, and persisted")
+    {
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+        {
+            auto scheduler = default_scheduler();
+            scheduler->set_retirement_age_for_tile_cache(5 * timing_multiplicator);
+            auto missing = example_tile_quad_for(tile::Id { 2, { 2, 2 } }, 4, NetworkInfo::Status::NotFound);
+            for (auto& tile : missing.tiles) {
+                tile.ortho = std::make_shared<QByteArray>();
+                tile.height = std::make_shared<QByteArray>();
+            }
+            scheduler->receive_quad(missing);
+            scheduler->flush_disk_cache();
+        }
+        auto scheduler = scheduler_with_disk_cache();
+        CHECK(scheduler->missing_quads().contains(tile::Id { 2, { 2, 2 } }));
+        CHECK(scheduler->ram_cache().n_cached_objects() == 0);
+
+        scheduler->set_retirement_age_for_tile_cache(5 * timing_multiplicator);
+        QThread::msleep(10 * timing_multiplicator);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        CHECK(!scheduler->missing_quads().contains(tile::Id { 2, { 2, 2 } }));
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+    }
+
+    SECTION("every tile source has its own missing quads, persisted in its own file")
+    {
+        const auto ortho_cache_path = Scheduler::disk_cache_path().parent_path() / "tile_cache_ortho";
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+        std::filesystem::remove_all(ortho_cache_path);
+        auto missing = example_tile_quad_for(tile::Id { 2, { 2, 2 } }, 4, NetworkInfo::Status::NotFound);
+        for (auto& tile : missing.tiles) {
+            tile.ortho = std::make_shared<QByteArray>();
+            tile.height = std::make_shared<QByteArray>();
+            tile.ortho_source = 1;
+        }
+        {
+            auto scheduler = default_scheduler();
+            scheduler->set_tile_sources({ "basemap", "ortho" });
+            scheduler->set_tile_source(1);
+            scheduler->receive_quad(missing);
+            CHECK(scheduler->missing_quads().contains(missing.id));
+            scheduler->set_tile_source(0);
+            CHECK(!scheduler->missing_quads().contains(missing.id)); // the other source may have it
+
+            QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+            scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+            scheduler->send_quad_requests();
+            REQUIRE(spy.size() == 1);
+            const auto quads = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+            CHECK(std::find(quads.cbegin(), quads.cend(), missing.id) != quads.end());
+
+            scheduler->set_tile_source(1);
+            scheduler->flush_disk_cache();
+        }
+        MissingQuadSet of_ortho;
+        REQUIRE(of_ortho.read_from_file(ortho_cache_path / "missing_quads.alp").has_value());
+        CHECK(of_ortho.contains(missing.id));
+        MissingQuadSet of_basemap; // a missing file reads as empty
+        REQUIRE(of_basemap.read_from_file(Scheduler::disk_cache_path() / "missing_quads.alp").has_value());
+        CHECK(of_basemap.empty());
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+        std::filesystem::remove_all(ortho_cache_path);
+    }
+
     SECTION("delivered tiles are requested again after they get too old")
     {
         auto scheduler = default_scheduler();
@@ -405,7 +844,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
         spy.wait(2 * timing_multiplicator);
         REQUIRE(spy.size() == 1);
-        const auto gpu_quads = spy.constFirst().constFirst().value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+        const auto gpu_quads = *spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
         REQUIRE(gpu_quads.size() == 3);
         CHECK(gpu_quads[0].id == tile::Id { 0, { 0, 0 } }); // order does not matter
         CHECK(gpu_quads[1].id == tile::Id { 1, { 1, 1 } });
@@ -417,7 +856,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         scheduler->receive_quad(example_tile_quad_for(tile::Id { 7, { 69, 83 } }));
         spy.wait(2 * timing_multiplicator);
         REQUIRE(spy.size() == 2);
-        const auto new_gpu_quads = spy[1].front().value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+        const auto new_gpu_quads = *spy[1].front().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
         REQUIRE(new_gpu_quads.size() == 5);
         CHECK(new_gpu_quads[0].id == tile::Id { 3, { 4, 5 } }); // order does not matter
         CHECK(new_gpu_quads[1].id == tile::Id { 4, { 8, 10 } });
@@ -443,7 +882,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
         scheduler->update_gpu_quads();
         REQUIRE(spy.size() == 1);
-        const auto gpu_quads = spy.constFirst().constFirst().value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+        const auto gpu_quads = *spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
         REQUIRE(gpu_quads.size() == 1);
         CHECK(gpu_quads[0].id == tile::Id { 0, { 0, 0 } });
         CHECK(gpu_quads[0].tiles[0].id == tile::Id { 1, { 0, 0 } });
@@ -465,7 +904,275 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
             REQUIRE(gpu_quads[0].tiles[i].height);
             CHECK(gpu_quads[0].tiles[i].height->width() == 64);
             CHECK(gpu_quads[0].tiles[i].height->height() == 64);
+            CHECK(!gpu_quads[0].tiles[i].inherited);
+        }
+        CHECK(gpu_quads[0].decode_ms >= 0);
+    }
+
+    SECTION("gpu quads are decoded in parallel and emitted in batches")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_decode_thread_count(4);
+        scheduler->set_decode_batch_size(5);
+        scheduler->set_gpu_quad_limit(17);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 4); // 17 quads in batches of 5
+        std::unordered_set<tile::Id, tile::Id::Hasher> received_ids;
+        for (const auto& emission : spy) {
+            const auto new_quads = *emission[0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
+            CHECK(new_quads.size() <= 5);
+            for (const auto& quad : new_quads) {
+                received_ids.insert(quad.id);
+                for (const auto& tile : quad.tiles) {
+                    REQUIRE(tile.ortho);
+                    CHECK(tile.ortho->width() == 256);
+                    REQUIRE(tile.height);
+                    CHECK(tile.height->width() == 64);
+                }
+            }
+        }
+        CHECK(received_ids.size() == 17);
+    }
+
+    SECTION("asynchronous decoding doesn't block the update, the quads follow from the event loop")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_decode_thread_count(4);
+        scheduler->set_decode_batch_size(5);
+        scheduler->set_asynchronous_decoding(true);
+        scheduler->set_gpu_quad_limit(17);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1); // deletions (none) and warm quads (none) right away
+        CHECK(spy.front()[0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>()->empty());
+        while (spy.size() < 5 && spy.wait(1000 * timing_multiplicator)) { }
+        REQUIRE(spy.size() == 5); // 17 quads in batches of 5
+        std::unordered_set<tile::Id, tile::Id::Hasher> received_ids;
+        for (const auto& emission : spy) {
+            for (const auto& quad : *emission[0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>())
+                received_ids.insert(quad.id);
         }
+        CHECK(received_ids.size() == 17);
+
+        // the delivered quads are not decoded again
+        scheduler->update_gpu_quads();
+        CHECK(spy.size() == 6);
+        CHECK(spy.back()[0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>()->empty());
+    }
+
+    SECTION("quads decoded asynchronously before a format change are decoded again")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_decode_thread_count(4);
+        scheduler->set_decode_batch_size(5);
+        scheduler->set_asynchronous_decoding(true);
+        scheduler->set_gpu_quad_limit(17);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        scheduler->set_ortho_tile_mip_levels(3); // the batches finish on the event loop, so after this
+        std::unordered_set<tile::Id, tile::Id::Hasher> received_ids;
+        while (received_ids.size() < 17 && spy.wait(1000 * timing_multiplicator)) {
+            for (const auto& quad : *spy.back()[0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>()) {
+                received_ids.insert(quad.id);
+                for (const auto& tile : quad.tiles) {
+                    REQUIRE(tile.ortho);
+                    CHECK(tile.ortho->n_mip_levels() == 3);
+                }
+            }
+        }
+        CHECK(received_ids.size() == 17);
+    }
+
+    SECTION("the gpu quad limit follows the renderer at runtime")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_gpu_quad_limit(17);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>()->size() == 17);
+
+        // shrinking deletes the surplus
+        spy.clear();
+        scheduler->set_gpu_quad_limit(5);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>()->empty());
+        CHECK(spy.constFirst().constLast().value<std::vector<tile::Id>>().size() == 12);
+
+        // the renderer dropped its tiles (resize without layer copies), they are sent again
+        spy.clear();
+        scheduler->release_gpu_quads();
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>()->size() == 5);
+        CHECK(spy.constFirst().constLast().value<std::vector<tile::Id>>().empty());
+    }
+
+    SECTION("over the gpu quad limit, the quads with the largest screen space error are selected")
+    {
+        using nucleus::tile_scheduler::tile_types::GpuTileQuadBatch;
+        const auto camera = nucleus::camera::stored_positions::stephansdom();
+        const auto sent_ids = [&](unsigned limit) {
+            auto scheduler = default_scheduler();
+            scheduler->set_gpu_quad_limit(limit);
+            QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+            for (const auto& q : example_quads_for_steffl_and_gg())
+                scheduler->receive_quad(q);
+            scheduler->update_camera(camera);
+            scheduler->update_gpu_quads();
+            REQUIRE(spy.size() == 1);
+            CHECK(spy.constFirst().constLast().value<std::vector<tile::Id>>().empty()); // nothing inserted and evicted again
+            std::unordered_set<tile::Id, tile::Id::Hasher> ids;
+            for (const auto& quad : *spy.constFirst().constFirst().value<GpuTileQuadBatch>())
+                ids.insert(quad.id);
+            return ids;
+        };
+        const auto all = sent_ids(1000);
+        const auto selected = sent_ids(10);
+        REQUIRE(all.size() > 10);
+        REQUIRE(selected.size() == 10);
+
+        TileHeights h;
+        h.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+        const auto error = nucleus::tile_scheduler::utils::screen_space_error_functor(camera, nucleus::tile_scheduler::utils::AabbDecorator::make(std::move(h)));
+        auto min_selected_error = std::numeric_limits<float>::max();
+        for (const auto& id : selected) {
+            CHECK(all.contains(id));
+            if (id.zoom_level > 0)
+                CHECK(selected.contains(id.parent())); // drawable
+            min_selected_error = std::min(min_selected_error, error(id));
+        }
+        for (const auto& id : all) {
+            if (!selected.contains(id))
+                CHECK(error(id) <= min_selected_error);
+        }
+    }
+
+    SECTION("quads that return to the gpu shortly after their eviction are not decoded again")
+    {
+        using nucleus::tile_scheduler::tile_types::GpuTileQuadBatch;
+        const auto shrink_and_grow = [](Scheduler* scheduler, QSignalSpy* spy) {
+            scheduler->set_gpu_quad_limit(5);
+            scheduler->update_gpu_quads();
+            spy->clear();
+            scheduler->set_gpu_quad_limit(17);
+            scheduler->update_gpu_quads();
+            REQUIRE(spy->size() == 1);
+            return spy->constFirst().constFirst().value<GpuTileQuadBatch>();
+        };
+        auto scheduler = default_scheduler();
+        scheduler->set_gpu_quad_limit(17);
+        scheduler->set_normal_maps(true);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto first = spy.constFirst().constFirst().value<GpuTileQuadBatch>();
+        const auto find_first = [&first](const tile::Id& id) { return std::find_if(first->begin(), first->end(), [&id](const auto& q) { return q.id == id; }); };
+
+        // the normals are computed for every decode, the same pointer means that the quad was handed over
+        const auto returned = shrink_and_grow(scheduler.get(), &spy);
+        REQUIRE(returned->size() == 12);
+        for (const auto& quad : *returned) {
+            const auto original = find_first(quad.id);
+            REQUIRE(original != first->end());
+            CHECK(quad.tiles[0].normals == original->tiles[0].normals);
+        }
+
+        scheduler->set_warm_cache_byte_limit(0);
+        const auto decoded = shrink_and_grow(scheduler.get(), &spy);
+        REQUIRE(decoded->size() == 12);
+        for (const auto& quad : *decoded)
+            CHECK(quad.tiles[0].normals != find_first(quad.id)->tiles[0].normals);
+    }
+
+    SECTION("normal maps are computed only when enabled")
+    {
+        using nucleus::tile_scheduler::tile_types::GpuTileQuadBatch;
+        auto scheduler = default_scheduler();
+        scheduler->set_gpu_quad_limit(17);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto first = spy.constFirst().constFirst().value<GpuTileQuadBatch>();
+        REQUIRE(!first->empty());
+        for (const auto& quad : *first) {
+            for (const auto& tile : quad.tiles)
+                CHECK(!tile.normals);
+        }
+
+        // the quads on the gpu are replaced by ones with normals, in the same update
+        spy.clear();
+        scheduler->set_normal_maps(true);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto replaced = spy.constFirst().constFirst().value<GpuTileQuadBatch>();
+        const auto deleted = spy.constFirst().constLast().value<std::vector<tile::Id>>();
+        CHECK(replaced->size() == first->size());
+        CHECK(deleted.size() == first->size());
+        for (const auto& quad : *replaced) {
+            for (const auto& tile : quad.tiles) {
+                REQUIRE(tile.normals);
+                CHECK(tile.normals->size() == tile.height->size());
+            }
+        }
+    }
+
+    SECTION("hidden quads are evicted from the gpu first")
+    {
+        auto scheduler = default_scheduler();
+        uint64_t now = 1000;
+        scheduler->set_clock([&now]() { return now; }); // the visited stamps are in msecs
+        scheduler->set_gpu_quad_limit(17);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        std::vector<tile::Id> sent;
+        for (const auto& quad : *spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>())
+            sent.push_back(quad.id);
+        const auto is_below = [](tile::Id id, const tile::Id& ancestor) {
+            while (id.zoom_level > ancestor.zoom_level)
+                id = id.parent();
+            return id == ancestor;
+        };
+        // a quad without sent descendants, that is not among the finest ones (those are evicted first anyway)
+        const auto max_zoom = std::max_element(sent.begin(), sent.end(), [](const auto& a, const auto& b) { return a.zoom_level < b.zoom_level; })->zoom_level;
+        const auto hidden = std::find_if(sent.begin(), sent.end(), [&](const tile::Id& id) {
+            return id.zoom_level < max_zoom && std::none_of(sent.begin(), sent.end(), [&](const tile::Id& other) { return other != id && is_below(other, id); });
+        });
+        REQUIRE(hidden != sent.end());
+
+        now += 2; // a later visit, but within the minimum residency (the resident quads are kept, no candidate replaces them)
+        spy.clear();
+        scheduler->set_hidden_quads({ *hidden });
+        scheduler->set_gpu_quad_limit(16);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto deleted = spy.constFirst().constLast().value<std::vector<tile::Id>>();
+        REQUIRE(deleted.size() == 1);
+        CHECK(deleted.front() == *hidden);
     }
 
     SECTION("incomplete tiles are replaced with default ones, when sending to gpu")
@@ -480,7 +1187,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
         scheduler->update_gpu_quads();
         REQUIRE(spy.size() == 1);
-        const auto gpu_quads = spy.constFirst().constFirst().value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+        const auto gpu_quads = *spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
         REQUIRE(gpu_quads.size() == 1);
         for (auto i = 0u; i < 3; ++i) {
             REQUIRE(gpu_quads[0].tiles[i].ortho);
@@ -492,6 +1199,30 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         }
     }
 
+    SECTION("the generated default tiles follow the tile format")
+    {
+        Scheduler scheduler;
+        TileHeights h;
+        h.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+        scheduler.set_aabb_decorator(nucleus::tile_scheduler::utils::AabbDecorator::make(std::move(h)));
+        scheduler.set_tile_format({ 512, 129 });
+        CHECK(scheduler.tile_format() == nucleus::tile_scheduler::tile_types::TileFormat { 512, 129 });
+        QSignalSpy spy(&scheduler, &Scheduler::gpu_quads_updated);
+        auto quad = example_tile_quad_for({ 0, { 0, 0 } }, 4);
+        for (auto i = 0u; i < 4; ++i) {
+            quad.tiles[i].ortho->resize(0);
+            quad.tiles[i].height->resize(0);
+        }
+        scheduler.receive_quad(quad);
+        scheduler.update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler.update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto gpu_quads = *spy.constFirst().constFirst().value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
+        REQUIRE(gpu_quads.size() == 1);
+        CHECK(gpu_quads[0].tiles[0].ortho->width() == 512);
+        CHECK(gpu_quads[0].tiles[0].height->width() == 129);
+    }
+
     SECTION("gpu quads are updated when serving from cache")
     {
         auto scheduler = default_scheduler();
@@ -522,7 +1253,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
             scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
             scheduler->update_gpu_quads();
             REQUIRE(spy.size() == 1);
-            const auto new_quads = spy[0][0].value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+            const auto new_quads = *spy[0][0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
             const auto deleted_quads = spy[0][1].value<std::vector<tile::Id>>();
             CHECK(new_quads.size() == 17);
             CHECK(deleted_quads.empty());
@@ -546,7 +1277,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
             scheduler->update_camera(nucleus::camera::stored_positions::grossglockner());
             scheduler->update_gpu_quads();
             REQUIRE(spy.size() == 2);
-            const auto new_quads = spy[1][0].value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+            const auto new_quads = *spy[1][0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
             const auto deleted_quads = spy[1][1].value<std::vector<tile::Id>>();
             CHECK(new_quads.size() == deleted_quads.size());
             CHECK(!new_quads.empty());
@@ -591,7 +1322,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
         scheduler->update_gpu_quads();
         REQUIRE(spy.size() == 1);
-        const auto new_quads = spy[0][0].value<std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>>();
+        const auto new_quads = *spy[0][0].value<nucleus::tile_scheduler::tile_types::GpuTileQuadBatch>();
         for (const auto& tile : new_quads) {
             cached_tiles.insert(tile.id);
         }
@@ -602,6 +1333,135 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         CHECK(cached_tiles.contains({ 12, { 2234, 2675 } }));
     }
 
+    SECTION("every tile source has its own cache, switching doesn't flush the others")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_tile_sources({ "basemap", "ortho" });
+        scheduler->set_gpu_quad_limit(17);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+        const auto n_quads = scheduler->ram_cache().n_cached_objects();
+        REQUIRE(n_quads > 0);
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        scheduler->set_tile_source(1);
+        CHECK(scheduler->ram_cache().n_cached_objects() == 0);
+        CHECK(scheduler->ram_cache(0).n_cached_objects() == n_quads);
+        CHECK(spy.empty()); // the old quads stay on the gpu until the new ones are there
+
+        for (auto q : example_quads_for_steffl_and_gg()) {
+            for (auto& tile : q.tiles)
+                tile.ortho_source = 1;
+            scheduler->receive_quad(q);
+        }
+        CHECK(scheduler->ram_cache().n_cached_objects() == n_quads);
+        CHECK(scheduler->cached_ortho_tile(example_quads_for_steffl_and_gg().front().tiles[0].id, 1));
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().at(0).value<GpuTileQuadBatch>()->size() == 17);
+        CHECK(spy.constFirst().at(1).value<std::vector<tile::Id>>().size() == 17);
+
+        // loaded while switching, requested again
+        auto mixed = example_tile_quad_for(tile::Id { 5, { 1, 1 } });
+        mixed.tiles[0].ortho_source = 1;
+        scheduler->receive_quad(mixed);
+        CHECK(!scheduler->ram_cache(0).contains(mixed.id));
+        CHECK(!scheduler->ram_cache(1).contains(mixed.id));
+
+        // switching back is served from the cache
+        spy.clear();
+        scheduler->set_tile_source(0);
+        CHECK(scheduler->ram_cache().n_cached_objects() == n_quads);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().at(0).value<GpuTileQuadBatch>()->size() == 17);
+    }
+
+    SECTION("memory pressure purges the ram cache to the low water mark")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_ram_low_water_mark(5);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        REQUIRE(scheduler->ram_cache().n_cached_objects() > 5);
+        scheduler->handle_memory_pressure();
+        CHECK(scheduler->ram_cache().n_cached_objects() == 5);
+    }
+
+    SECTION("pinned quads are requested right away and stay in ram")
+    {
+        auto scheduler = default_scheduler();
+        const auto far_away = tile::Id { 12, { 0, 0 } };
+        scheduler->set_pinned_levels(1);
+        scheduler->set_pinned_quads({ far_away });
+        CHECK(scheduler->is_pinned({ 0, { 0, 0 } }));
+        CHECK(!scheduler->is_pinned({ 1, { 1, 0 } }));
+        CHECK(scheduler->is_pinned(far_away));
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        const auto requested = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+        CHECK(std::find(requested.begin(), requested.end(), far_away) != requested.end());
+        CHECK(std::find(requested.begin(), requested.end(), tile::Id { 0, { 0, 0 } }) != requested.end());
+
+        scheduler->receive_quad(example_tile_quad_for(far_away));
+        scheduler->set_ram_low_water_mark(5);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->handle_memory_pressure();
+        CHECK(scheduler->ram_cache().n_cached_objects() == 5);
+        CHECK(scheduler->ram_cache().contains(far_away));
+    }
+
+    SECTION("one-off quad requests are sent until they arrived")
+    {
+        auto scheduler = default_scheduler();
+        const auto far_away = tile::Id { 12, { 0, 0 } };
+        scheduler->request_quads({ far_away, far_away });
+        CHECK(!scheduler->is_pinned(far_away));
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        auto requested = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        CHECK(std::count(requested.begin(), requested.end(), far_away) == 1);
+
+        scheduler->receive_quad(example_tile_quad_for(far_away));
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 2);
+        requested = spy.constLast().constFirst().value<std::vector<tile::Id>>();
+        CHECK(std::find(requested.begin(), requested.end(), far_away) == requested.end());
+    }
+
+    SECTION("suspending releases gpu quads, if enabled, and stops updates")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_gpu_quad_limit(17);
+        scheduler->set_release_gpu_when_suspended(true);
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->update_gpu_quads();
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        scheduler->set_suspended(true);
+        REQUIRE(spy.size() == 1);
+        CHECK(spy.constFirst().at(0).value<GpuTileQuadBatch>()->empty());
+        CHECK(spy.constFirst().at(1).value<std::vector<tile::Id>>().size() == 17);
+
+        scheduler->update_gpu_quads();
+        CHECK(spy.size() == 1);
+        scheduler->set_suspended(false);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 2);
+        CHECK(spy.constLast().at(0).value<GpuTileQuadBatch>()->size() == 17);
+    }
+
     SECTION("ram tiles are purged")
     {
         auto scheduler = default_scheduler();
@@ -649,6 +1509,24 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         CHECK(scheduler->ram_cache().n_cached_objects() == limit);
     }
 
+    SECTION("purging ram tiles with byte limit tolerance")
+    {
+        auto scheduler = default_scheduler();
+        for (const auto& q : example_quads_for_steffl_and_gg())
+            scheduler->receive_quad(q);
+        const auto n_quads = scheduler->ram_cache().n_cached_objects();
+        const auto n_bytes = scheduler->ram_cache().n_bytes();
+        scheduler->set_ram_byte_limit(std::numeric_limits<uint64_t>::max()); // no limit
+        scheduler->purge_ram_cache();
+        CHECK(scheduler->ram_cache().n_cached_objects() == n_quads);
+        scheduler->set_ram_byte_limit(n_bytes - n_bytes / 50); // within the tolerance
+        scheduler->purge_ram_cache();
+        CHECK(scheduler->ram_cache().n_cached_objects() == n_quads);
+        scheduler->set_ram_byte_limit(n_bytes / 2);
+        scheduler->purge_ram_cache();
+        CHECK(scheduler->ram_cache().n_bytes() <= n_bytes / 2);
+    }
+
     SECTION("purging happens with a delay (collects purge events) and the timer is not restarted on tile delivery")
     {
         auto scheduler = default_scheduler();
@@ -765,6 +1643,186 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         std::filesystem::remove_all(Scheduler::disk_cache_path());
     }
 
+    SECTION("disk cache is loaded lazily, coarse quads along the camera first")
+    {
+        {
+            auto scheduler = default_scheduler();
+            scheduler->receive_quad(example_tile_quad_for(tile::Id { 2, { 2, 2 } }));
+            scheduler->receive_quad(example_tile_quad_for(tile::Id { 1, { 1, 1 } }));
+            scheduler->receive_quad(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+            scheduler->persist_tiles();
+        }
+        auto scheduler = default_scheduler();
+        scheduler->set_disk_load_batch_size(1);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->open_disk_cache();
+        CHECK(scheduler->ram_cache().n_cached_objects() == 0);
+        CHECK(scheduler->ram_cache().n_pending_from_pack() == 3);
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::statistics_updated);
+        REQUIRE(spy.wait(2 * timing_multiplicator));
+        CHECK(scheduler->ram_cache().n_cached_objects() == 1);
+        CHECK(scheduler->ram_cache().contains(tile::Id { 0, { 0, 0 } }));
+        while (scheduler->ram_cache().n_pending_from_pack() > 0 && spy.wait(2 * timing_multiplicator)) { }
+        CHECK(scheduler->ram_cache().n_cached_objects() == 3);
+        check_persited_tiles(scheduler, std::vector { tile::Id { 0, { 0, 0 } }, tile::Id { 1, { 1, 1 } }, tile::Id { 2, { 2, 2 } } });
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+    }
+
+    SECTION("a read only base pack is the lowest cache tier")
+    {
+        const auto base_path = std::filesystem::temp_directory_path() / "alpine_renderer_test_base_pack";
+        std::filesystem::remove_all(base_path);
+        {
+            nucleus::tile_scheduler::MemoryCache cache;
+            cache.insert(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+            cache.insert(example_tile_quad_for(tile::Id { 1, { 1, 1 } }));
+            REQUIRE(cache.write_to_pack(base_path).has_value());
+        }
+        auto scheduler = default_scheduler();
+        scheduler->open_base_pack(base_path / "does_not_exist");
+        CHECK(scheduler->ram_cache().n_cached_objects() == 0);
+
+        scheduler->open_base_pack(base_path);
+        CHECK(scheduler->ram_cache().n_cached_objects() == 2);
+        check_persited_tiles(scheduler, std::vector { tile::Id { 0, { 0, 0 } }, tile::Id { 1, { 1, 1 } } });
+
+        // purged quads are taken from the pack again instead of the network
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->ram_cache().purge(0);
+        CHECK(scheduler->ram_cache().n_cached_objects() == 0);
+        scheduler->send_quad_requests();
+        CHECK(scheduler->ram_cache().contains(tile::Id { 0, { 0, 0 } }));
+        CHECK(scheduler->ram_cache().contains(tile::Id { 1, { 1, 1 } }));
+        std::filesystem::remove_all(base_path);
+    }
+
+    SECTION("transcoded tiles are not stored by default")
+    {
+        using nucleus::utils::ColourTexture;
+        auto scheduler = default_scheduler();
+        CHECK(!scheduler->gpu_payload_caching());
+        scheduler->set_ortho_tile_compression_algorithm(ColourTexture::Format::DXT1);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+        const auto n_bytes = scheduler->ram_cache().n_bytes();
+        scheduler->update_gpu_quads();
+        CHECK(!scheduler->ram_cache().peak_at(tile::Id { 0, { 0, 0 } }).tiles[0].gpu);
+        CHECK(scheduler->ram_cache().n_bytes() == n_bytes);
+    }
+
+    SECTION("transcoded tiles are stored in the ram cache and reused")
+    {
+        using nucleus::utils::ColourTexture;
+        auto scheduler = default_scheduler();
+        scheduler->set_gpu_payload_caching(true);
+        scheduler->set_ortho_tile_compression_algorithm(ColourTexture::Format::DXT1);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        {
+            const auto& stored = scheduler->ram_cache().peak_at(tile::Id { 0, { 0, 0 } });
+            REQUIRE(stored.tiles[0].gpu);
+            CHECK(stored.tiles[0].gpu->ortho_format == ColourTexture::Format::DXT1);
+            CHECK(stored.tiles[0].gpu->ortho.size() == 256 * 256 / 2);
+            CHECK(stored.tiles[0].gpu->height.size() == stored.tiles[0].gpu->height_width * stored.tiles[0].gpu->height_height);
+            const auto gpu_quads = *spy.constFirst().at(0).value<GpuTileQuadBatch>();
+            REQUIRE(gpu_quads.size() == 1);
+            CHECK(std::equal(stored.tiles[0].gpu->ortho.begin(), stored.tiles[0].gpu->ortho.end(), gpu_quads.front().tiles[0].ortho->data()));
+        }
+
+        // a stored payload for the active format is used instead of decoding the tiles
+        auto quad = example_tile_quad_for(tile::Id { 1, { 1, 1 } });
+        auto payload = std::make_shared<GpuTilePayload>();
+        payload->ortho_format = ColourTexture::Format::DXT1;
+        payload->ortho_width = 256;
+        payload->ortho_height = 256;
+        payload->ortho = std::vector<uint8_t>(256 * 256 / 2, 0x42);
+        payload->height_width = 65;
+        payload->height_height = 65;
+        payload->height = std::vector<uint16_t>(65 * 65, 7);
+        for (auto& tile : quad.tiles)
+            tile.gpu = payload;
+        scheduler->receive_quad(quad);
+        spy.clear();
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto gpu_quads = *spy.constFirst().at(0).value<GpuTileQuadBatch>();
+        REQUIRE(gpu_quads.size() == 1);
+        CHECK(gpu_quads.front().id == tile::Id { 1, { 1, 1 } });
+        CHECK(gpu_quads.front().tiles[3].ortho->data()[100] == 0x42);
+        CHECK(gpu_quads.front().tiles[3].height->pixel({ 10, 10 }) == 7);
+    }
+
+    SECTION("transcoded tiles contain the mip chain")
+    {
+        using nucleus::utils::ColourTexture;
+        auto scheduler = default_scheduler();
+        scheduler->set_gpu_payload_caching(true);
+        scheduler->set_ortho_tile_compression_algorithm(ColourTexture::Format::DXT1);
+        scheduler->set_ortho_tile_mip_levels(5);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        auto quad = example_tile_quad_for(tile::Id { 0, { 0, 0 } });
+        auto payload = std::make_shared<GpuTilePayload>(); // without mipmaps, must be transcoded again
+        payload->ortho_format = ColourTexture::Format::DXT1;
+        payload->ortho_width = 256;
+        payload->ortho_height = 256;
+        payload->ortho = std::vector<uint8_t>(256 * 256 / 2, 0x42);
+        quad.tiles[0].gpu = payload;
+        scheduler->receive_quad(quad);
+        QSignalSpy spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        scheduler->update_gpu_quads();
+        REQUIRE(spy.size() == 1);
+        const auto gpu_quads = *spy.constFirst().at(0).value<GpuTileQuadBatch>();
+        REQUIRE(gpu_quads.size() == 1);
+        const auto& ortho = *gpu_quads.front().tiles[0].ortho;
+        CHECK(ortho.n_mip_levels() == 5);
+        CHECK(ortho.n_bytes() == ColourTexture::n_bytes_for(256, 256, ColourTexture::Format::DXT1, 5));
+        const auto& stored = scheduler->ram_cache().peak_at(tile::Id { 0, { 0, 0 } });
+        REQUIRE(stored.tiles[0].gpu);
+        CHECK(stored.tiles[0].gpu->ortho_mip_levels == 5);
+        CHECK(stored.tiles[0].gpu->ortho.size() == ortho.n_bytes());
+    }
+
+    SECTION("cached tiles are provided for revalidation, unchanged ones keep their transcoded data")
+    {
+        auto scheduler = default_scheduler();
+        auto quad = example_tile_quad_for(tile::Id { 0, { 0, 0 } });
+        quad.tiles[2].ortho_validator.etag = "\"abc\"";
+        quad.tiles[2].height_validator.last_modified = "Wed, 21 Oct 2015 07:28:00 GMT";
+        quad.tiles[2].gpu = std::make_shared<GpuTilePayload>();
+        scheduler->receive_quad(quad);
+        scheduler->ram_cache().publish_snapshot();
+
+        const auto ortho = scheduler->cached_ortho_tile(quad.tiles[2].id);
+        REQUIRE(ortho);
+        CHECK(ortho->id == quad.tiles[2].id);
+        CHECK(ortho->validator.etag == "\"abc\"");
+        CHECK(*ortho->data == *quad.tiles[2].ortho);
+        const auto height = scheduler->cached_height_tile(quad.tiles[2].id);
+        REQUIRE(height);
+        CHECK(height->validator.last_modified == "Wed, 21 Oct 2015 07:28:00 GMT");
+        CHECK(!scheduler->cached_ortho_tile(tile::Id { 0, { 0, 0 } }));
+        CHECK(!scheduler->cached_ortho_tile(tile::Id { 2, { 0, 0 } }));
+
+        // a 304 delivers the cached payloads with a new timestamp
+        auto revalidated = scheduler->ram_cache().peak_at(quad.id);
+        for (auto& tile : revalidated.tiles) {
+            tile.gpu.reset();
+            tile.network_info.timestamp += 1000;
+        }
+        scheduler->receive_quad(revalidated);
+        CHECK(scheduler->ram_cache().peak_at(quad.id).tiles[2].gpu);
+        CHECK(scheduler->ram_cache().peak_at(quad.id).tiles[2].network_info.timestamp == quad.tiles[2].network_info.timestamp + 1000);
+
+        // changed data has to be transcoded again
+        revalidated.tiles[2].ortho = std::make_shared<QByteArray>("changed");
+        scheduler->receive_quad(revalidated);
+        CHECK(!scheduler->ram_cache().peak_at(quad.id).tiles[2].gpu);
+    }
+
     SECTION("notification, when a tile is received")
     {
         auto scheduler = default_scheduler();
@@ -834,6 +1892,7 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler benchmarks")
         }
         BENCHMARK("write cache to disk") {
             scheduler->persist_tiles();
+            scheduler->flush_disk_cache();
         };
     }
 
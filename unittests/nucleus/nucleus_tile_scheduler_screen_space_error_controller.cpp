@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/tile_scheduler/ScreenSpaceErrorController.h"
+
+using nucleus::tile_scheduler::ScreenSpaceErrorController;
+
+TEST_CASE("nucleus/tile_scheduler/screen space error controller")
+{
+    const auto settings = ScreenSpaceErrorController::Settings { .enabled = true, .min_error = 1.0f, .max_error = 8.0f, .target_frame_msecs = 10.0f, .target_gpu_quads = 0 };
+
+    SECTION("disabled controller uses the base error")
+    {
+        ScreenSpaceErrorController controller;
+        controller.set_base_error(3.0f);
+        CHECK(!controller.update(100.0f, 1000));
+        CHECK(controller.error() == 3.0f);
+    }
+
+    SECTION("base error is clamped to the bounds")
+    {
+        ScreenSpaceErrorController controller(settings);
+        controller.set_base_error(20.0f);
+        CHECK(controller.error() == 8.0f);
+        controller.set_base_error(0.5f);
+        CHECK(controller.error() == 1.0f);
+    }
+
+    SECTION("slow frames coarsen up to the upper bound")
+    {
+        ScreenSpaceErrorController controller(settings);
+        controller.set_base_error(2.0f);
+        auto previous = controller.error();
+        for (int i = 0; i < 10; ++i) {
+            controller.update(30.0f, 0);
+            CHECK(controller.error() >= previous);
+            previous = controller.error();
+        }
+        CHECK(controller.error() > 2.0f);
+        for (int i = 0; i < 200; ++i)
+            controller.update(30.0f, 0);
+        CHECK(controller.error() == 8.0f);
+    }
+
+    SECTION("fast frames refine down to the lower bound")
+    {
+        ScreenSpaceErrorController controller(settings);
+        controller.set_base_error(4.0f);
+        for (int i = 0; i < 200; ++i)
+            controller.update(2.0f, 0);
+        CHECK(controller.error() == 1.0f);
+    }
+
+    SECTION("frames on target keep the error")
+    {
+        ScreenSpaceErrorController controller(settings);
+        controller.set_base_error(4.0f);
+        for (int i = 0; i < 100; ++i)
+            CHECK(!controller.update(i % 2 ? 9.0f : 10.5f, 0));
+        CHECK(controller.error() == 4.0f);
+    }
+
+    SECTION("small changes are not reported")
+    {
+        ScreenSpaceErrorController controller(settings);
+        controller.set_base_error(4.0f);
+        unsigned n_changes = 0;
+        for (int i = 0; i < 20; ++i)
+            n_changes += controller.update(12.0f, 0) ? 1 : 0; // 20% over target => about 2% per update
+        CHECK(n_changes > 0);
+        CHECK(n_changes < 20);
+    }
+
+    SECTION("too many gpu quads coarsen, even with fast frames")
+    {
+        auto quad_settings = settings;
+        quad_settings.target_gpu_quads = 100;
+        ScreenSpaceErrorController controller(quad_settings);
+        controller.set_base_error(2.0f);
+        for (int i = 0; i < 20; ++i)
+            controller.update(2.0f, 300);
+        CHECK(controller.error() > 2.0f);
+    }
+
+    SECTION("a new base error restarts the controller")
+    {
+        ScreenSpaceErrorController controller(settings);
+        controller.set_base_error(2.0f);
+        for (int i = 0; i < 50; ++i)
+            controller.update(30.0f, 0);
+        REQUIRE(controller.error() > 2.0f);
+        controller.set_base_error(3.0f);
+        CHECK(controller.error() == 3.0f);
+    }
+}
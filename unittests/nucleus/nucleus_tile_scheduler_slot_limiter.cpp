@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <QCoreApplication>
 #include <QSignalSpy>
 #include <QThread>
 #include <catch2/catch_test_macros.hpp>
@@ -209,4 +210,130 @@ TEST_CASE("nucleus/tile_scheduler/slot limiter")
         REQUIRE(spy.size() == 2);
         CHECK(spy[1][0].value<tile_types::TileQuad>().id == tile::Id { 1, { 2, 3 } });
     }
+
+    SECTION("quads delivered in one event loop iteration are sent on as one batch")
+    {
+        SlotLimiter sl;
+        QSignalSpy spy(&sl, &SlotLimiter::quads_delivered);
+        sl.deliver_quad(tile_types::TileQuad { tile::Id { 0, { 0, 0 } }, 4, {} });
+        sl.deliver_quad(tile_types::TileQuad { tile::Id { 1, { 2, 3 } }, 4, {} });
+        CHECK(spy.empty());
+        QCoreApplication::processEvents();
+        REQUIRE(spy.size() == 1);
+        const auto batch = spy[0][0].value<tile_types::TileQuadBatch>();
+        REQUIRE(batch);
+        REQUIRE(batch->size() == 2);
+        CHECK(batch->at(0).id == tile::Id { 0, { 0, 0 } });
+        CHECK(batch->at(1).id == tile::Id { 1, { 2, 3 } });
+
+        sl.deliver_quad(tile_types::TileQuad { tile::Id { 2, { 1, 1 } }, 4, {} });
+        QCoreApplication::processEvents();
+        REQUIRE(spy.size() == 2);
+        CHECK(spy[1][0].value<tile_types::TileQuadBatch>()->size() == 1);
+    }
+
+    SECTION("stale requests are cancelled, if enabled")
+    {
+        SlotLimiter sl;
+        sl.set_limit(2);
+        sl.set_cancel_stale_requests(true);
+        QSignalSpy spy(&sl, &SlotLimiter::quad_requested);
+        QSignalSpy spy_cancelled(&sl, &SlotLimiter::quads_cancelled);
+        sl.request_quads({ tile::Id { 0, { 0, 0 } }, tile::Id { 1, { 0, 0 } }, tile::Id { 1, { 0, 1 } } });
+        REQUIRE(spy.size() == 2);
+        CHECK(spy_cancelled.empty());
+
+        // camera moved, 1/0/0 is not needed any more
+        sl.request_quads({ tile::Id { 0, { 0, 0 } }, tile::Id { 2, { 3, 3 } } });
+        REQUIRE(spy_cancelled.size() == 1);
+        CHECK(spy_cancelled[0][0].value<std::vector<tile::Id>>() == std::vector { tile::Id { 1, { 0, 0 } } });
+        REQUIRE(spy.size() == 3); // the freed slot is used right away
+        CHECK(spy[2][0].value<tile::Id>() == tile::Id { 2, { 3, 3 } });
+        CHECK(sl.slots_taken() == 2);
+
+        sl.request_quads({ tile::Id { 0, { 0, 0 } }, tile::Id { 2, { 3, 3 } } });
+        CHECK(spy_cancelled.size() == 1);
+        CHECK(spy.size() == 3);
+    }
+
+    SECTION("incremental updates keep the queue, in the order of priority")
+    {
+        using Tier = tile_types::QuadRequest::Tier;
+        SlotLimiter sl;
+        sl.set_limit(1);
+        sl.set_cancel_stale_requests(true);
+        QSignalSpy spy(&sl, &SlotLimiter::quad_requested);
+        QSignalSpy spy_cancelled(&sl, &SlotLimiter::quads_cancelled);
+        sl.update_requests({ .added = { { tile::Id { 2, { 0, 0 } }, Tier::Visible, 4.f },
+                                 { tile::Id { 0, { 0, 0 } }, Tier::Visible, 10.f },
+                                 { tile::Id { 2, { 1, 0 } }, Tier::Occluded, 100.f },
+                                 { tile::Id { 1, { 0, 0 } }, Tier::Visible, 8.f } },
+            .removed = {} });
+        REQUIRE(spy.size() == 1);
+        CHECK(spy[0][0].value<tile::Id>() == tile::Id { 0, { 0, 0 } });
+
+        // reprioritised and new requests, unchanged ones stay queued
+        sl.update_requests({ .added = { { tile::Id { 2, { 0, 0 } }, Tier::Visible, 9.f }, { tile::Id { 3, { 0, 0 } }, Tier::Prefetch, 50.f } }, .removed = {} });
+        CHECK(spy.size() == 1);
+        sl.deliver_quad(tile_types::TileQuad { tile::Id { 0, { 0, 0 } } });
+        REQUIRE(spy.size() == 2);
+        CHECK(spy[1][0].value<tile::Id>() == tile::Id { 2, { 0, 0 } });
+
+        // removed requests leave the queue, and are cancelled if in flight
+        sl.update_requests({ .added = {}, .removed = { tile::Id { 1, { 0, 0 } }, tile::Id { 2, { 0, 0 } } } });
+        REQUIRE(spy_cancelled.size() == 1);
+        CHECK(spy_cancelled[0][0].value<std::vector<tile::Id>>() == std::vector { tile::Id { 2, { 0, 0 } } });
+        REQUIRE(spy.size() == 3);
+        CHECK(spy[2][0].value<tile::Id>() == tile::Id { 2, { 1, 0 } }); // occluded before prefetch
+        sl.deliver_quad(tile_types::TileQuad { tile::Id { 2, { 1, 0 } } });
+        REQUIRE(spy.size() == 4);
+        CHECK(spy[3][0].value<tile::Id>() == tile::Id { 3, { 0, 0 } });
+        sl.deliver_quad(tile_types::TileQuad { tile::Id { 3, { 0, 0 } } });
+        CHECK(spy.size() == 4);
+        CHECK(sl.slots_taken() == 0);
+    }
+
+    SECTION("adaptive limit: additive increase, multiplicative decrease")
+    {
+        SlotLimiter sl;
+        sl.set_limit(4);
+        sl.set_adaptive(true, 2, 6);
+        CHECK(sl.adaptive());
+        QSignalSpy spy(&sl, &SlotLimiter::quad_requested);
+        QSignalSpy spy_limit(&sl, &SlotLimiter::limit_changed);
+        std::vector<tile::Id> ids;
+        for (unsigned i = 0; i < 64; ++i)
+            ids.push_back(tile::Id { 10, { i, 0 } });
+        sl.request_quads(ids);
+        REQUIRE(spy.size() == 4);
+
+        const auto deliver_next = [&](tile_types::NetworkInfo::Status status) {
+            const auto id = spy.takeFirst().constFirst().value<tile::Id>();
+            tile_types::TileQuad quad { id, 4, {} };
+            for (auto& tile : quad.tiles)
+                tile.network_info.status = status;
+            sl.deliver_quad(quad);
+        };
+        // one more slot after a window of successful deliveries
+        for (unsigned i = 0; i < 4; ++i)
+            deliver_next(tile_types::NetworkInfo::Status::Good);
+        CHECK(sl.limit() == 5);
+        CHECK(sl.slots_taken() == 5);
+        REQUIRE(spy_limit.size() == 1);
+        CHECK(spy_limit[0][0].value<unsigned>() == 5);
+
+        // capped at the maximum
+        for (unsigned i = 0; i < 20; ++i)
+            deliver_next(tile_types::NetworkInfo::Status::Good);
+        CHECK(sl.limit() == 6);
+
+        // halved on errors, but not below the minimum
+        deliver_next(tile_types::NetworkInfo::Status::NetworkError);
+        CHECK(sl.limit() == 3);
+        CHECK(sl.statistics().limit == 3);
+        deliver_next(tile_types::NetworkInfo::Status::NetworkError);
+        deliver_next(tile_types::NetworkInfo::Status::NetworkError);
+        CHECK(sl.limit() == 2);
+        CHECK(sl.slots_taken() <= 6); // in flight requests are not cancelled, they just aren't replaced
+    }
 }
@@ -18,11 +18,15 @@
 
 
 #include <algorithm>
+#include <array>
+#include <filesystem>
 
 #include <QRegularExpression>
 #include <QSignalSpy>
+#include <QStandardPaths>
 #include <catch2/catch_test_macros.hpp>
 
+#include "nucleus/tile_scheduler/PackTileSource.h"
 #include "nucleus/tile_scheduler/TileLoadService.h"
 #include "nucleus/utils/tile_conversion.h"
 
@@ -114,6 +118,89 @@ TEST_CASE("nucleus/tile_scheduler/TileLoadService")
         }
     }
 
+    SECTION("load balancing prefers fast and healthy targets")
+    {
+        TileLoadService service("https://maps%1.wien.gv.at/basemap/bmaporthofoto30cm/normal/google3857/", TileLoadService::UrlPattern::ZXY, ".jpeg", {"1", "2", "3", "4"});
+        REQUIRE(service.target_statistics().size() == 4);
+        CHECK(service.hedging_enabled());
+        CHECK(!service.hedge_deadline(0));
+
+        std::vector<tile::Id> ids;
+        for (unsigned x = 0; x < 32; ++x) {
+            for (unsigned y = 0; y < 32; ++y)
+                ids.push_back({ 10, { x, y } });
+        }
+        std::array<unsigned, 4> counts = {};
+        for (const auto& id : ids)
+            ++counts[service.select_target(id)];
+        for (const auto count : counts)
+            CHECK(count > 100); // roughly uniform without measurements
+
+        for (unsigned i = 0; i < 10; ++i) {
+            service.record_target_response(0, false, 400);
+            service.record_target_response(1, false, 40);
+            service.record_target_response(2, false, 40);
+            service.record_target_response(3, true, 40);
+        }
+        CHECK(service.target_statistics()[0].latency_msecs > service.target_statistics()[1].latency_msecs);
+        CHECK(service.target_statistics()[3].error_rate > 0.5f);
+        REQUIRE(service.hedge_deadline(1));
+        CHECK(*service.hedge_deadline(1) >= 50);
+        CHECK(*service.hedge_deadline(0) > *service.hedge_deadline(1));
+
+        counts = {};
+        for (const auto& id : ids)
+            ++counts[service.select_target(id)];
+        CHECK(counts[1] > 4 * counts[0]);
+        CHECK(counts[2] > 4 * counts[0]);
+        CHECK(counts[1] > 4 * counts[3]);
+
+        for (const auto& id : ids) {
+            CHECK(service.select_target(id) == service.select_target(id));
+            CHECK(service.select_target(id, 1) != 1);
+        }
+    }
+
+    SECTION("quad bundles")
+    {
+        TileLoadService service("https://maps%1.wien.gv.at/tiles/", TileLoadService::UrlPattern::ZXY, ".jpeg", {"1", "2"});
+        CHECK(!service.bundles_enabled());
+        service.set_bundle_url("https://maps%1.wien.gv.at/bundles/", ".bundle");
+        CHECK(service.bundles_enabled());
+        CHECK(service.build_bundle_url({ 2, { 1, 3 } }).contains(QRegularExpression("https://maps[1-2]\\.wien\\.gv\\.at/bundles/2/1/3.bundle")));
+
+        const std::array<QByteArray, 4> tiles = { QByteArray("ortho 0"), QByteArray(), QByteArray(1000, 'x'), QByteArray("3") };
+        const auto bundle = TileLoadService::pack_bundle(tiles);
+        CHECK(bundle.size() == 4 * 4 + 7 + 1000 + 1);
+        const auto unpacked = TileLoadService::unpack_bundle(bundle);
+        REQUIRE(unpacked.has_value());
+        CHECK(unpacked.value() == tiles);
+
+        CHECK(!TileLoadService::unpack_bundle(bundle.left(bundle.size() - 1)).has_value());
+        CHECK(!TileLoadService::unpack_bundle(bundle + "x").has_value());
+        CHECK(!TileLoadService::unpack_bundle(QByteArray()).has_value());
+    }
+
+    SECTION("network cache policy")
+    {
+        TileLoadService service("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZXY, ".png");
+        // the scheduler caches the tiles, there shouldn't be a second copy in qt's http cache
+        CHECK(service.network_cache_policy() == TileLoadService::NetworkCachePolicy::SchedulerCacheOnly);
+        service.set_network_cache_policy(TileLoadService::NetworkCachePolicy::PreferNetworkCache);
+        CHECK(service.network_cache_policy() == TileLoadService::NetworkCachePolicy::PreferNetworkCache);
+    }
+
+    SECTION("transport options")
+    {
+        TileLoadService service("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZXY, ".png");
+        CHECK(service.transport_options().http2_allowed);
+        CHECK(service.transport_options().share_network_manager);
+        service.set_transport_options({ .http2_allowed = false, .share_network_manager = false, .max_connections_per_host = 2 });
+        CHECK(!service.transport_options().http2_allowed);
+        CHECK(!service.transport_options().share_network_manager);
+        CHECK(service.transport_options().max_connections_per_host == 2);
+    }
+
     SECTION("network network info struct") {
         using nucleus::tile_scheduler::tile_types::NetworkInfo;
         {
@@ -233,6 +320,60 @@ TEST_CASE("nucleus/tile_scheduler/TileLoadService")
         REQUIRE(image.sizeInBytes() == 0);
     }
 
+    SECTION("local pack source")
+    {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_pack_tile_source";
+        std::filesystem::remove_all(path);
+        const auto id = tile::Id { .zoom_level = 9, .coords = { 273, 177 } };
+        REQUIRE(PackTileSource::write(path, { { id, QByteArray("jpeg bytes") }, { { 0, { 0, 0 } }, QByteArray("root") } }).has_value());
+        CHECK(!PackTileSource(path / "missing").open().has_value());
+
+        auto source = std::make_shared<PackTileSource>(path);
+        REQUIRE(source->open().has_value());
+        CHECK(source->size() == 2);
+        TileLoadService service(source);
+        source.reset(); // the service keeps it alive
+        QSignalSpy spy(&service, &TileLoadService::load_finished);
+        service.load(id);
+        service.load({ .zoom_level = 10, .coords = { 0, 0 } });
+        CHECK(spy.count() == 0); // delivered through the event loop, like network replies
+        while (spy.count() < 2 && spy.wait(100)) { }
+        REQUIRE(spy.count() == 2);
+        {
+            const auto tile = spy.takeFirst().at(0).value<TileLayer>();
+            CHECK(tile.id == id);
+            CHECK(tile.network_info.status == tile_types::NetworkInfo::Status::Good);
+            CHECK(*tile.data == "jpeg bytes");
+        }
+        {
+            const auto tile = spy.takeFirst().at(0).value<TileLayer>();
+            CHECK(tile.network_info.status == tile_types::NetworkInfo::Status::NotFound);
+            CHECK(tile.data->isEmpty());
+        }
+
+        // cancelled requests are not delivered
+        service.load(id);
+        service.cancel({ id });
+        spy.wait(50);
+        CHECK(spy.count() == 0);
+        std::filesystem::remove_all(path);
+    }
+
+    SECTION("outstanding requests don't outlive the service on a shared network manager")
+    {
+        TileLoadService other("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZYX, ".png");
+        other.set_transfer_timeout(1);
+        {
+            auto service = std::make_unique<TileLoadService>("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZYX, ".png");
+            service->load({ .zoom_level = 90, .coords = { 273, 177 } });
+            service.reset(); // the reply is aborted, its handler must not touch the service
+        }
+        QSignalSpy spy(&other, &TileLoadService::load_finished);
+        other.load({ .zoom_level = 90, .coords = { 273, 178 } }); // same manager, keeps its event loop going
+        spy.wait(20);
+        CHECK(spy.count() == 1);
+    }
+
     SECTION("notifies of timeout")
     {
         TileLoadService service("https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/",
@@ -16,6 +16,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
 #include <QBuffer>
 #include <QFile>
 #include <QImage>
@@ -26,6 +32,12 @@
 #include <nucleus/camera/Definition.h>
 
 #include "nucleus/camera/PositionStorage.h"
+#include "nucleus/tile_scheduler/CameraTraversal.h"
+#include "nucleus/tile_scheduler/DepthPyramid.h"
+#include "nucleus/tile_scheduler/HeightBoundsTable.h"
+#include "nucleus/tile_scheduler/HorizonOcclusion.h"
+#include "nucleus/tile_scheduler/ParallelTraversal.h"
+#include "nucleus/tile_scheduler/TileIdSet.h"
 #include "nucleus/tile_scheduler/utils.h"
 #include "nucleus/utils/tile_conversion.h"
 #include "radix/quad_tree.h"
@@ -89,6 +101,387 @@ TEST_CASE("tile_scheduler/utils/refine_functor")
     };
 }
 
+TEST_CASE("tile_scheduler/utils/aabb decorator")
+{
+    QFile file(":/map/height_data.atb");
+    const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+    assert(open);
+    Q_UNUSED(open);
+    const QByteArray data = file.readAll();
+    const auto decorator = nucleus::tile_scheduler::utils::AabbDecorator::make(TileHeights::deserialise(data));
+
+    SECTION("memoised bounds are the computed ones")
+    {
+        for (const auto& id : { tile::Id { 0, { 0, 0 } }, tile::Id { 8, { 139, 167 } }, tile::Id { 14, { 8936, 10731 } } }) {
+            const auto computed = decorator->compute_aabb(id);
+            for (int i = 0; i < 2; ++i) { // first miss, then hit
+                const auto memoised = decorator->aabb(id);
+                CHECK(memoised.min == computed.min);
+                CHECK(memoised.max == computed.max);
+            }
+        }
+    }
+
+    SECTION("concurrent lookups")
+    {
+        std::vector<std::unique_ptr<QThread>> threads;
+        std::atomic<int> n_mismatches = 0;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back(QThread::create([&]() {
+                for (unsigned x = 0; x < 256; ++x) {
+                    const auto id = tile::Id { 8, { x, 167 } };
+                    if (decorator->aabb(id).max != decorator->compute_aabb(id).max)
+                        ++n_mismatches;
+                }
+            }));
+            threads.back()->start();
+        }
+        for (auto& thread : threads)
+            thread->wait();
+        CHECK(n_mismatches == 0);
+    }
+
+    SECTION("exact heights of decoded rasters tighten the bounds")
+    {
+        const auto parent = tile::Id { 13, { 4468, 5365 } };
+        const auto precomputed = decorator->aabb(parent);
+        const auto version = decorator->version();
+
+        const auto children = parent.children();
+        decorator->set_exact_heights(children[0], 10, 11);
+        CHECK(decorator->version() != version);
+        CHECK(decorator->aabb(children[0]).min.z == Approx(9.5));
+        CHECK(decorator->aabb(children[0]).max.z == decorator->compute_aabb(children[0]).max.z);
+        CHECK(decorator->aabb(children[0]).max.z < precomputed.max.z);
+        CHECK(decorator->aabb(parent).max.z == precomputed.max.z); // not all children known yet
+
+        decorator->set_exact_heights(children[1], 12, 13);
+        decorator->set_exact_heights(children[2], 10.5f, 12.5f);
+        decorator->set_exact_heights(children[3], 11, 11.5f);
+        const auto merged = decorator->aabb(parent);
+        CHECK(merged.min.z >= precomputed.min.z);
+        CHECK(merged.max.z <= precomputed.max.z);
+        CHECK(merged.max.z == nucleus::tile_scheduler::utils::make_bounds(parent, 0, 13).max.z);
+
+        // the own raster of the parent wins over the children
+        decorator->set_exact_heights(parent, 10.1f, 12.9f);
+        CHECK(decorator->aabb(parent).max.z == nucleus::tile_scheduler::utils::make_bounds(parent, 0, 12.9f).max.z);
+        decorator->set_exact_heights(children[1], 12, 13.1f);
+        CHECK(decorator->aabb(parent).max.z == nucleus::tile_scheduler::utils::make_bounds(parent, 0, 12.9f).max.z);
+
+        const auto unchanged = decorator->version();
+        decorator->set_exact_heights(children[1], 12, 13.1f);
+        CHECK(decorator->version() == unchanged);
+    }
+
+    SECTION("flat terrain is refined less than rough terrain")
+    {
+        const auto id = tile::Id { 14, { 8936, 10731 } };
+        const auto footprint = float(1.414213562373095 * decorator->aabb(id).size().x / 256);
+        CHECK(decorator->error_size(id, decorator->aabb(id), 256) == Approx(footprint));
+
+        const auto version = decorator->version();
+        decorator->set_flat_terrain_factor(0.2f); // clamped
+        CHECK(decorator->flat_terrain_factor() == 0.5f);
+        CHECK(decorator->version() != version);
+
+        // the roughness of a decoded raster replaces the height range
+        decorator->set_exact_heights(id, 100, 2000, 0);
+        CHECK(decorator->error_size(id, decorator->aabb(id), 256) == Approx(footprint * 0.5f));
+        decorator->set_exact_heights(id, 100, 2000, 1000);
+        CHECK(decorator->error_size(id, decorator->aabb(id), 256) == Approx(footprint));
+        decorator->set_exact_heights(id, 100, 2000, footprint * 0.6f);
+        CHECK(decorator->error_size(id, decorator->aabb(id), 256) > footprint * 0.55f);
+        CHECK(decorator->error_size(id, decorator->aabb(id), 256) < footprint);
+
+        // a parent keeps a larger error than its children
+        const auto parent = decorator->error_size(id.parent(), decorator->aabb(id.parent()), 256);
+        for (const auto& child : id.children())
+            CHECK(parent >= decorator->error_size(child, decorator->aabb(child), 256));
+
+        // on a plain, fewer tiles for the same error
+        TileHeights h;
+        h.emplace({ 0, { 0, 0 } }, { 170, 171 });
+        const auto plain = nucleus::tile_scheduler::utils::AabbDecorator::make(std::move(h));
+        const auto camera = nucleus::camera::stored_positions::stephansdom();
+        const auto count_leaves = [&]() {
+            return quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, utils::refineFunctor(camera, plain, 1.0), [](const tile::Id& v) { return v.children(); }).size();
+        };
+        const auto n_leaves = count_leaves();
+        plain->set_flat_terrain_factor(0.5f);
+        CHECK(count_leaves() < n_leaves);
+    }
+}
+
+TEST_CASE("tile_scheduler/height bounds table")
+{
+    TileHeights heights;
+    heights.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+    heights.emplace({ 1, { 1, 1 } }, { 200, 3000 });
+    heights.emplace({ 2, { 2, 3 } }, { 300, 2000 });
+    heights.emplace({ 2, { 3, 3 } }, { 400, 2500 });
+    heights.emplace({ 3, { 5, 6 } }, { 500, 1000 });
+
+    const auto table = HeightBoundsTable::build(heights, "key");
+    REQUIRE(table.n_levels() == 4);
+
+    SECTION("same ranges as the tile heights, or wider by the quantisation")
+    {
+        for (const auto& id : { tile::Id { 0, { 0, 0 } }, tile::Id { 1, { 1, 1 } }, tile::Id { 1, { 0, 1 } }, tile::Id { 2, { 3, 3 } },
+                 tile::Id { 2, { 3, 2 } }, tile::Id { 3, { 5, 6 } }, tile::Id { 3, { 4, 6 } }, tile::Id { 3, { 0, 0 } },
+                 tile::Id { 9, { 5 * 64 + 3, 6 * 64 + 60 } }, tile::Id { 12, { 300, 4000 } } }) {
+            const auto expected = heights.query({ id.zoom_level, id.coords });
+            const auto [min, max] = table.query(id);
+            CHECK(min <= expected.first);
+            CHECK(min > expected.first - 0.1f);
+            CHECK(max >= expected.second);
+            CHECK(max < expected.second + 0.1f);
+        }
+    }
+
+    SECTION("the buffer is used as is, and only for the same key")
+    {
+        const auto copy = QByteArray(table.bytes().constData(), table.bytes().size()); // aligned, unlike a sub range
+        const auto view = HeightBoundsTable::from_bytes(QByteArray::fromRawData(copy.constData(), copy.size()), "key");
+        REQUIRE(view.has_value());
+        CHECK(view->bytes().constData() == copy.constData());
+        CHECK(view->query({ 3, { 5, 6 } }) == table.query({ 3, { 5, 6 } }));
+        CHECK(view->query({ 2, { 2, 3 } }) == table.query({ 2, { 2, 3 } }));
+
+        CHECK(!HeightBoundsTable::from_bytes(copy, "other key").has_value());
+        CHECK(!HeightBoundsTable::from_bytes(copy.left(copy.size() - 4), "key").has_value());
+        CHECK(!HeightBoundsTable::from_bytes(QByteArray(), "key").has_value());
+    }
+
+    SECTION("the real data")
+    {
+        QFile file(":/map/height_data.atb");
+        REQUIRE(file.open(QIODeviceBase::OpenModeFlag::ReadOnly));
+        const auto real_heights = TileHeights::deserialise(file.readAll());
+        const auto real_table = HeightBoundsTable::build(real_heights);
+        for (const auto& id : { tile::Id { 0, { 0, 0 } }, tile::Id { 8, { 139, 167 } }, tile::Id { 13, { 4468, 5365 } }, tile::Id { 14, { 8936, 10731 } } }) {
+            const auto expected = real_heights.query({ id.zoom_level, id.coords });
+            const auto [min, max] = real_table.query(id);
+            CHECK(min <= expected.first);
+            CHECK(max >= expected.second);
+        }
+    }
+}
+
+TEST_CASE("tile_scheduler/camera traversal")
+{
+    QFile file(":/map/height_data.atb");
+    const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+    assert(open);
+    Q_UNUSED(open);
+    const QByteArray data = file.readAll();
+    const auto decorator = nucleus::tile_scheduler::utils::AabbDecorator::make(TileHeights::deserialise(data));
+
+    SECTION("same decisions as the refine functor")
+    {
+        for (const auto horizon_culling : { false, true }) {
+            decorator->set_horizon_culling(horizon_culling);
+            for (const auto& camera : { nucleus::camera::stored_positions::stephansdom_closeup(), nucleus::camera::stored_positions::grossglockner() }) {
+                const nucleus::tile_scheduler::CameraTraversal traversal(camera, decorator);
+                const auto refine_functor = utils::refineFunctor(camera, decorator, 1.0);
+                const auto screen_space_error = utils::screen_space_error_functor(camera, decorator);
+                std::vector<tile::Id> visited;
+                const auto leaves = quad_tree::onTheFlyTraverse(
+                    tile::Id { 0, { 0, 0 } },
+                    [&](const tile::Id& id) {
+                        visited.push_back(id);
+                        return traversal.refine(id, 1.0);
+                    },
+                    [](const tile::Id& v) { return v.children(); });
+                CHECK(leaves.size() > 10);
+                for (const auto& id : visited) {
+                    CHECK(traversal.refine(id, 1.0) == refine_functor(id));
+                    CHECK(traversal.screen_space_error(id) == screen_space_error(id));
+                }
+            }
+        }
+    }
+
+    SECTION("tiles are evaluated once")
+    {
+        const nucleus::tile_scheduler::CameraTraversal traversal(nucleus::camera::stored_positions::stephansdom_closeup(), decorator);
+        const auto traverse = [&]() {
+            return quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, traversal.refine_functor(1.0), [](const tile::Id& v) { return v.children(); });
+        };
+        const auto leaves = traverse();
+        const auto n_evaluated = traversal.n_evaluated_tiles();
+        CHECK(traverse().size() == leaves.size());
+        CHECK(traversal.n_evaluated_tiles() == n_evaluated);
+    }
+
+    SECTION("a reset traversal gives the same decisions as a new one")
+    {
+        nucleus::tile_scheduler::CameraTraversal traversal(nucleus::camera::stored_positions::grossglockner(), decorator);
+        const auto leaves = [](const nucleus::tile_scheduler::CameraTraversal& t) {
+            return quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, t.refine_functor(1.0), [](const tile::Id& v) { return v.children(); });
+        };
+        CHECK(!leaves(traversal).empty());
+        const auto camera = nucleus::camera::stored_positions::stephansdom_closeup();
+        traversal.reset(camera, decorator);
+        CHECK(traversal.n_evaluated_tiles() == 0);
+        CHECK(leaves(traversal) == leaves(nucleus::tile_scheduler::CameraTraversal(camera, decorator)));
+    }
+
+    SECTION("parallel traversal: same nodes as the serial one, in the same order")
+    {
+        const auto camera = nucleus::camera::stored_positions::grossglockner();
+        const auto make_refine = [&](unsigned) {
+            return [traversal = std::make_shared<nucleus::tile_scheduler::CameraTraversal>(camera, decorator)](const tile::Id& id) { return traversal->refine(id, 1.0); };
+        };
+        std::vector<tile::Id> serial_inner_nodes, serial_leaves;
+        ParallelTraversal serial;
+        serial.set_max_thread_count(1);
+        serial.set_node_threshold(0);
+        serial.traverse(make_refine(0), make_refine, &serial_inner_nodes, &serial_leaves);
+        CHECK(!serial.last_was_parallel());
+        CHECK(serial.n_nodes() == serial_inner_nodes.size() + serial_leaves.size());
+
+        const nucleus::tile_scheduler::CameraTraversal reference_traversal(camera, decorator);
+        auto reference_leaves = quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, reference_traversal.refine_functor(1.0), [](const tile::Id& v) { return v.children(); });
+        auto sorted_leaves = serial_leaves;
+        std::sort(reference_leaves.begin(), reference_leaves.end(), TileIdSet::Less {});
+        std::sort(sorted_leaves.begin(), sorted_leaves.end(), TileIdSet::Less {});
+        CHECK(sorted_leaves == reference_leaves);
+
+        ParallelTraversal parallel;
+        parallel.set_max_thread_count(4);
+        parallel.set_node_threshold(serial.n_nodes());
+        for (const auto expect_parallel : { false, true }) { // the first one has no previous traversal to go by
+            std::vector<tile::Id> inner_nodes, leaves;
+            parallel.traverse(make_refine(0), make_refine, &inner_nodes, &leaves);
+            CHECK(parallel.last_was_parallel() == expect_parallel);
+            CHECK(inner_nodes == serial_inner_nodes);
+            CHECK(leaves == serial_leaves);
+        }
+    }
+}
+
+TEST_CASE("tile_scheduler/depth pyramid")
+{
+    auto camera = nucleus::camera::Definition({ 0, 0, 1000 }, { 0, 10000, 1000 });
+    camera.set_viewport_size({ 64, 36 });
+    const auto direction = camera.ray_direction({ 0, 0 });
+    const auto box_at = [&](double distance) {
+        const auto centre = camera.position() + direction * distance;
+        return tile::SrsAndHeightBounds { centre - glm::dvec3(5), centre + glm::dvec3(5) };
+    };
+    nucleus::tile_scheduler::DepthPyramid pyramid;
+    CHECK(pyramid.empty());
+    CHECK(!pyramid.occludes(box_at(2000)));
+
+    SECTION("levels hold the max distance")
+    {
+        std::vector<float> distances(64 * 36, 1000.f);
+        distances[5] = 3000.f;
+        pyramid.build(camera, { 64, 36 }, distances);
+        REQUIRE(pyramid.n_levels() == 7);
+        CHECK(pyramid.level_size(1) == glm::uvec2(32, 18));
+        CHECK(pyramid.level_size(6) == glm::uvec2(1, 1));
+        CHECK(pyramid.max_distance(1, { 2, 0 }) == 3000.f);
+        CHECK(pyramid.max_distance(1, { 3, 0 }) == 1000.f);
+        CHECK(pyramid.max_distance(6, { 0, 0 }) == 3000.f);
+    }
+
+    SECTION("boxes behind the depth are occluded")
+    {
+        pyramid.build(camera, { 64, 36 }, std::vector<float>(64 * 36, 1000.f));
+        CHECK(pyramid.occludes(box_at(2000)));
+        CHECK(!pyramid.occludes(box_at(500)));
+        CHECK(!pyramid.occludes(box_at(1005))); // within the margin
+        CHECK(!pyramid.occludes(box_at(-2000))); // behind the camera
+        CHECK(!pyramid.occludes(tile::SrsAndHeightBounds { { -100000, 1000, 0 }, { 100000, 1100, 2000 } })); // reaches outside of the view
+        CHECK(!pyramid.occludes(box_at(2000), 1500)); // the camera moved too far
+    }
+
+    SECTION("no terrain doesn't occlude")
+    {
+        pyramid.build(camera, { 64, 36 }, std::vector<float>(64 * 36, std::numeric_limits<float>::infinity()));
+        CHECK(!pyramid.occludes(box_at(2000)));
+        CHECK(!pyramid.occludes(box_at(100000)));
+        pyramid.clear();
+        CHECK(pyramid.empty());
+    }
+}
+
+TEST_CASE("tile_scheduler/horizon occlusion")
+{
+    SECTION("boxes below a plateau are hidden")
+    {
+        TileHeights heights;
+        heights.emplace({ 0, { 0, 0 } }, { 1000, 1000 });
+        // off the grid lines of the tiles, the rays along them are not covered by the occluders (they are the disks inside the tiles)
+        const auto position = glm::dvec3(1234, 567, 1010);
+        const auto box = [&](double x, double y, double top) {
+            return tile::SrsAndHeightBounds { { position.x + x - 100, position.y + y - 100, 0 }, { position.x + x + 100, position.y + y + 100, top } };
+        };
+        HorizonOcclusion horizon;
+        CHECK(horizon.empty());
+        CHECK(!horizon.occludes(box(0, 30000, 990)));
+        horizon.build(position, HeightBoundsTable::build(heights));
+        CHECK(horizon.n_occluders() > 0);
+        CHECK(horizon.occludes(box(0, 30000, 990)));
+        CHECK(horizon.occludes(box(-30000, 0, 990))); // across the wrap around of the angle
+        CHECK(!horizon.occludes(box(0, 30000, 1005))); // above the plateau
+        CHECK(!horizon.occludes(box(0, 120, 990))); // too close
+        CHECK(!horizon.occludes(box(0, 0, 990))); // contains the camera
+        horizon.clear();
+        CHECK(!horizon.occludes(box(0, 30000, 990)));
+    }
+
+    SECTION("a ridge around the camera hides the valleys behind it")
+    {
+        // the camera is in a low tile at zoom level 12, surrounded by 8 tiles that are 2000 m high. the tiles above are in the
+        // table, so that it is walked down to them.
+        const auto centre = tile::Id { 12, { 2201, 1401 } };
+        TileHeights heights;
+        for (auto ancestor = tile::Id { 10, { 550, 350 } };; ancestor = ancestor.parent()) {
+            heights.emplace({ ancestor.zoom_level, ancestor.coords }, { 0, 1000.f + float(ancestor.zoom_level) });
+            if (ancestor.zoom_level == 0)
+                break;
+        }
+        for (unsigned x = 1100; x <= 1101; ++x) {
+            for (unsigned y = 700; y <= 701; ++y)
+                heights.emplace({ 11, { x, y } }, { 0, 2000 });
+        }
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dy = -1; dy <= 1; ++dy)
+                heights.emplace({ 12, { centre.coords.x + dx, centre.coords.y + dy } }, dx == 0 && dy == 0 ? std::pair { 0.f, 100.f } : std::pair { 2000.f, 2000.f });
+        }
+        const auto decorator = utils::AabbDecorator::make(heights);
+        const auto bounds = nucleus::srs::tile_bounds(centre);
+        const auto position = glm::dvec3((bounds.min + bounds.max) * 0.5 + glm::dvec2(1234, 567), 200.0); // off the grid lines, see above
+        const auto behind = tile::Id { 12, { centre.coords.x + 4, centre.coords.y } };
+
+        HorizonOcclusion horizon;
+        horizon.build(position, decorator->height_bounds());
+        CHECK(horizon.occludes(decorator->subtree_aabb(behind)));
+        CHECK(!horizon.occludes(decorator->subtree_aabb({ 12, { centre.coords.x + 1, centre.coords.y } }))); // the ridge itself
+        CHECK(!horizon.occludes(decorator->subtree_aabb({ 10, { 550, 350 } })));
+
+        // not refined behind the ridge
+        const auto behind_bounds = nucleus::srs::tile_bounds(behind);
+        const auto camera = nucleus::camera::Definition(position, glm::dvec3((behind_bounds.min + behind_bounds.max) * 0.5, 200.0));
+        const auto leaves = [&]() {
+            const CameraTraversal traversal(camera, decorator);
+            return quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, traversal.refine_functor(1.0), [](const tile::Id& v) { return v.children(); });
+        };
+        const auto all_leaves = leaves();
+        decorator->set_horizon_culling(true);
+        const auto visible_leaves = leaves();
+        CHECK(visible_leaves.size() < all_leaves.size());
+        const CameraTraversal traversal(camera, decorator);
+        CHECK(traversal.node(behind).below_horizon);
+        CHECK(traversal.screen_space_error(behind) == 0);
+        CHECK(!traversal.refine(behind, 1.0));
+        CHECK(!utils::refineFunctor(camera, decorator, 1.0)(behind));
+    }
+}
+
 TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
 {
     QFile file(":/map/height_data.atb");
@@ -182,6 +575,21 @@ TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
             }
         }
 
+        // the batched test of 4 siblings gives the same classification as testing them one by one
+        for (const auto& camera : camera_positions) {
+            const auto camera_frustum = camera.frustum();
+            const auto planes = nucleus::tile_scheduler::utils::relative_frustum_planes(camera_frustum, camera.position());
+            for (const auto& tile_id : tile_ids) {
+                const auto children = tile_id.children();
+                std::array<tile::SrsAndHeightBounds, 4> aabbs;
+                for (size_t i = 0; i < 4; ++i)
+                    aabbs[i] = decorator->aabb(children[i]);
+                const auto batched = nucleus::tile_scheduler::utils::classify_tiles_in_frustum(camera_frustum, planes, aabbs);
+                for (size_t i = 0; i < 4; ++i)
+                    CHECK(batched[i] == nucleus::tile_scheduler::utils::classify_tile_in_frustum(camera_frustum, aabbs[i]));
+            }
+        }
+
         BENCHMARK("camera_frustum_contains_tile")
         {
             bool retval = false;
@@ -195,6 +603,24 @@ TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
             return retval;
         };
 
+        BENCHMARK("classify_tiles_in_frustum (4 children at once)")
+        {
+            int n_visible = 0;
+            for (const auto& camera : camera_positions) {
+                const auto camera_frustum = camera.frustum();
+                const auto planes = nucleus::tile_scheduler::utils::relative_frustum_planes(camera_frustum, camera.position());
+                for (const auto& tile_id : tile_ids) {
+                    const auto children = tile_id.children();
+                    std::array<tile::SrsAndHeightBounds, 4> aabbs;
+                    for (size_t i = 0; i < 4; ++i)
+                        aabbs[i] = decorator->aabb(children[i]);
+                    for (const auto c : nucleus::tile_scheduler::utils::classify_tiles_in_frustum(camera_frustum, planes, aabbs))
+                        n_visible += int(c != nucleus::tile_scheduler::utils::FrustumClassification::Outside);
+                }
+            }
+            return n_visible;
+        };
+
         BENCHMARK("camera_frustum_contains_tile_old")
         {
             bool retval = false;
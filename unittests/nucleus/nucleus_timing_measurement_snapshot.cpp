@@ -0,0 +1,139 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <thread>
+
+#include "nucleus/timing/CpuTimer.h"
+#include "nucleus/timing/MeasurementSnapshot.h"
+
+using nucleus::timing::CpuTimer;
+using nucleus::timing::MeasurementSnapshot;
+using nucleus::timing::TimerManager;
+using nucleus::timing::TimerReport;
+
+TEST_CASE("nucleus/timing/measurement snapshot")
+{
+    TimerManager manager;
+    manager.add_timer(std::make_shared<CpuTimer>("a", "CPU", 60, 1.0f / 60.0f));
+    manager.add_timer(std::make_shared<CpuTimer>("b", "GPU", 30, 1.0f / 30.0f));
+    MeasurementSnapshot snapshot;
+    CHECK(!snapshot.enabled());
+    snapshot.set_timers(manager);
+    const auto a = manager.timers()[0].get();
+    const auto b = manager.timers()[1].get();
+
+    SECTION("timer infos")
+    {
+        const auto infos = snapshot.timers();
+        REQUIRE(infos.size() == 2);
+        CHECK(infos[0].name == "a");
+        CHECK(infos[0].group == "CPU");
+        CHECK(infos[1].name == "b");
+        CHECK(infos[1].queue_size == 30);
+    }
+
+    SECTION("reads the latest publish only once")
+    {
+        MeasurementSnapshot::Snapshot s;
+        CHECK(snapshot.read(s)); // set_timers publishes the empty layout
+        CHECK(s.n_timers == 2);
+        CHECK(s.entries[0].count == 0);
+        CHECK(!snapshot.read(s));
+
+        snapshot.publish({ TimerReport { 2.0f, a, 0 } });
+        snapshot.publish({ TimerReport { 4.0f, a, 0 }, TimerReport { 1.0f, b, 1 } });
+        CHECK(snapshot.read(s));
+        CHECK(s.frame == 3);
+        CHECK(s.entries[0].count == 2);
+        CHECK(s.entries[0].sum == 6.0);
+        CHECK(s.entries[0].last == 4.0f);
+        CHECK(s.entries[1].count == 1);
+        CHECK(!snapshot.read(s));
+    }
+
+    SECTION("set_timers starts over with a new layout")
+    {
+        MeasurementSnapshot::Snapshot s;
+        snapshot.publish({ TimerReport { 2.0f, a, 0 } });
+        CHECK(snapshot.read(s));
+        const auto version = s.layout_version;
+        snapshot.set_timers(manager);
+        CHECK(snapshot.read(s));
+        CHECK(s.layout_version != version);
+        CHECK(s.entries[0].count == 0);
+    }
+
+    SECTION("command counts")
+    {
+        snapshot.set_timers(manager, { "tiles", "labels" });
+        CHECK(snapshot.passes() == std::vector<std::string> { "tiles", "labels" });
+        nucleus::timing::CommandCounts tiles;
+        tiles.draw_calls = 2;
+        tiles.texture_bytes = 1000;
+        nucleus::timing::CommandCounts labels;
+        labels.draw_calls = 1;
+        const std::vector counts = { tiles, labels, labels }; // the third pass is not in the layout
+        snapshot.publish({}, counts);
+        snapshot.publish({}, counts);
+        MeasurementSnapshot::Snapshot s;
+        CHECK(snapshot.read(s));
+        CHECK(s.n_passes == 2);
+        CHECK(s.counts[0].draw_calls == 4);
+        CHECK(s.counts[0].texture_bytes == 2000);
+        CHECK(s.counts[1].draw_calls == 2);
+        CHECK(s.counts[2].draw_calls == 0);
+    }
+
+    SECTION("reports outside of the layout are ignored")
+    {
+        MeasurementSnapshot::Snapshot s;
+        snapshot.publish({ TimerReport { 2.0f, a, 5 } });
+        CHECK(snapshot.read(s));
+        CHECK(s.entries[0].count == 0);
+    }
+
+    SECTION("concurrent reader sees consistent snapshots")
+    {
+        // the writer keeps both entries equal, a torn read would break that
+        std::atomic<bool> done = false;
+        std::thread writer([&]() {
+            for (int i = 0; i < 20000; ++i)
+                snapshot.publish({ TimerReport { float(i), a, 0 }, TimerReport { float(i), b, 1 } });
+            done = true;
+        });
+        MeasurementSnapshot::Snapshot s;
+        uint64_t last_frame = 0;
+        bool consistent = true;
+        bool monotonic = true;
+        while (!done) {
+            if (!snapshot.read(s))
+                continue;
+            consistent = consistent && s.entries[0].count == s.entries[1].count && s.entries[0].sum == s.entries[1].sum;
+            monotonic = monotonic && s.frame >= last_frame;
+            last_frame = s.frame;
+        }
+        writer.join();
+        CHECK(consistent);
+        CHECK(monotonic);
+        snapshot.read(s); // the reader might have seen the last publish already
+        CHECK(s.entries[0].count == 20000);
+    }
+}
@@ -0,0 +1,223 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "nucleus/timing/SpikeDetector.h"
+#include "nucleus/timing/StartupTimeline.h"
+#include "nucleus/timing/TraceRecorder.h"
+
+using nucleus::timing::SpikeDetector;
+using nucleus::timing::StartupScope;
+using nucleus::timing::StartupTimeline;
+using nucleus::timing::TraceRecorder;
+using nucleus::timing::TraceScope;
+
+TEST_CASE("nucleus/timing/trace recorder")
+{
+    const auto t0 = TraceRecorder::Clock::now();
+    const auto at = [t0](int msecs) { return t0 + std::chrono::milliseconds(msecs); };
+
+    SECTION("records only while enabled")
+    {
+        TraceRecorder recorder;
+        CHECK(!recorder.enabled());
+        recorder.record("a", "cpu", at(0), at(1));
+        {
+            const TraceScope scope("scope", "test", recorder);
+        }
+        CHECK(recorder.events().empty());
+
+        recorder.set_enabled(true);
+        recorder.record("a", "cpu", at(0), at(2));
+        {
+            const TraceScope scope("scope", "test", recorder);
+        }
+        const auto events = recorder.events();
+        REQUIRE(events.size() == 2);
+        const auto names = recorder.names();
+        CHECK(names[events[0].name] == "a");
+        CHECK(names[events[0].category] == "cpu");
+        CHECK(events[0].duration_ns == 2'000'000);
+        CHECK(names[events[1].name] == "scope");
+        CHECK(events[1].thread != 0); // 0 is the gpu track
+    }
+
+    SECTION("the ring buffer keeps the latest events, in order")
+    {
+        TraceRecorder recorder(3);
+        recorder.set_enabled(true);
+        for (int i = 0; i < 5; ++i)
+            recorder.record("e", "cpu", at(i), at(i + 1));
+        const auto events = recorder.events();
+        REQUIRE(events.size() == 3);
+        CHECK(events[0].begin_ns + 1'000'000 == events[1].begin_ns);
+        CHECK(events[1].begin_ns + 1'000'000 == events[2].begin_ns);
+        CHECK(events[2].begin_ns - events[0].begin_ns == 2'000'000);
+
+        recorder.clear();
+        CHECK(recorder.events().empty());
+    }
+
+    SECTION("chrome trace json")
+    {
+        TraceRecorder recorder;
+        recorder.set_enabled(true);
+        recorder.record("tiles", "GPU", at(0), at(3), TraceRecorder::Track::Gpu);
+        recorder.record("a \"quoted\" name", "cpu", at(1), at(2));
+
+        QJsonParseError error;
+        const auto json = QJsonDocument::fromJson(QByteArray::fromStdString(recorder.to_chrome_trace_json()), &error);
+        REQUIRE(error.error == QJsonParseError::NoError);
+        const auto trace_events = json.object().value("traceEvents").toArray();
+        unsigned n_complete = 0;
+        bool gpu_track_named = false;
+        for (const auto& value : trace_events) {
+            const auto event = value.toObject();
+            if (event.value("ph").toString() == "M" && event.value("tid").toInt() == 0)
+                gpu_track_named = event.value("args").toObject().value("name").toString() == "gpu";
+            if (event.value("ph").toString() != "X")
+                continue;
+            ++n_complete;
+            if (event.value("name").toString() == "tiles") {
+                CHECK(event.value("tid").toInt() == 0);
+                CHECK(event.value("dur").toDouble() == 3000.0); // microseconds
+            } else {
+                CHECK(event.value("name").toString() == "a \"quoted\" name");
+            }
+        }
+        CHECK(n_complete == 2);
+        CHECK(gpu_track_named);
+    }
+
+    SECTION("counters and time windows")
+    {
+        TraceRecorder recorder;
+        recorder.set_enabled(true);
+        recorder.record("early", "cpu", at(0), at(1));
+        recorder.record("late", "cpu", at(10), at(12));
+        recorder.record_counter("upload bytes", "gl", 4096, at(11));
+
+        QJsonParseError error;
+        const auto json = QJsonDocument::fromJson(QByteArray::fromStdString(recorder.to_chrome_trace_json(at(5), at(20))), &error);
+        REQUIRE(error.error == QJsonParseError::NoError);
+        QStringList names;
+        for (const auto& value : json.object().value("traceEvents").toArray()) {
+            const auto event = value.toObject();
+            if (event.value("ph").toString() == "C")
+                CHECK(event.value("args").toObject().value("value").toDouble() == 4096.0);
+            if (event.value("ph").toString() != "M")
+                names.append(event.value("name").toString());
+        }
+        CHECK(names == QStringList { "late", "upload bytes" });
+    }
+}
+
+TEST_CASE("nucleus/timing/spike detector")
+{
+    SpikeDetector detector({ .factor = 3.0f, .min_msecs = 25.0f, .n_median_frames = 10, .before_msecs = 100.0f, .n_frames_after = 3, .cooldown_frames = 5 });
+    auto now = SpikeDetector::Clock::now();
+    const auto frame = [&](float msecs) {
+        now += std::chrono::microseconds(int64_t(msecs * 1000));
+        return detector.add_frame(msecs, now);
+    };
+
+    SECTION("no spikes before the median is known, nor in steady frames")
+    {
+        CHECK(!frame(100.0f));
+        for (unsigned i = 0; i < 30; ++i)
+            CHECK(!frame(10.0f));
+        CHECK(detector.median_msecs() == 10.0f);
+    }
+
+    SECTION("captured after the frames that follow the spike")
+    {
+        for (unsigned i = 0; i < 10; ++i)
+            CHECK(!frame(10.0f));
+        const auto spike_end = now + std::chrono::milliseconds(40);
+        CHECK(!frame(40.0f));
+        CHECK(!frame(45.0f)); // extends the pending capture
+        CHECK(!frame(10.0f));
+        CHECK(!frame(10.0f));
+        const auto capture = frame(10.0f);
+        REQUIRE(capture);
+        CHECK(capture->spike_msecs == 45.0f);
+        CHECK(capture->median_msecs == 10.0f);
+        CHECK(capture->to == now);
+        CHECK(capture->from == spike_end - std::chrono::milliseconds(140));
+
+        // cooldown
+        CHECK(!frame(100.0f));
+        for (unsigned i = 0; i < 10; ++i)
+            CHECK(!frame(10.0f));
+    }
+
+    SECTION("short frames are no spikes, even if they are much longer than the median")
+    {
+        for (unsigned i = 0; i < 10; ++i)
+            CHECK(!frame(2.0f));
+        CHECK(!frame(20.0f));
+        for (unsigned i = 0; i < 5; ++i)
+            CHECK(!frame(2.0f));
+    }
+}
+
+TEST_CASE("nucleus/timing/startup timeline")
+{
+    StartupTimeline timeline;
+    const auto start = StartupTimeline::Clock::now();
+    const auto at = [&](int msecs) { return start + std::chrono::milliseconds(msecs); };
+    timeline.record("compile shaders", at(5), at(30));
+    timeline.record("read height data", at(1), at(20));
+    {
+        const StartupScope scope("scoped", timeline);
+    }
+
+    const auto phases = timeline.phases();
+    REQUIRE(phases.size() == 3);
+    CHECK(phases[0].name == "read height data");
+    CHECK(phases[1].name == "compile shaders");
+    CHECK(phases[2].name == "scoped");
+    CHECK(phases[0].begin_msecs < phases[1].begin_msecs);
+    CHECK(std::abs(phases[1].msecs - 25.0) < 0.01);
+    CHECK(!phases[0].thread.empty());
+
+    const auto report = timeline.report();
+    CHECK(report.find("read height data") != std::string::npos);
+    CHECK(report.find("compile shaders") != std::string::npos);
+
+    CHECK(!timeline.finished());
+    CHECK(!timeline.first_frame_msecs().has_value());
+    CHECK(timeline.finish(at(40)));
+    CHECK(timeline.finished());
+    CHECK(!timeline.finish(at(50))); // only the first frame counts
+    REQUIRE(timeline.first_frame_msecs().has_value());
+    CHECK(timeline.first_frame_msecs().value() >= 40.0);
+
+    timeline.record("too late", at(60), at(70));
+    const auto final_phases = timeline.phases();
+    CHECK(final_phases.size() == 4); // + first frame
+    CHECK(std::none_of(final_phases.begin(), final_phases.end(), [](const auto& p) { return p.name == "too late"; }));
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <cmath>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/atmosphere_lut.h"
+
+using namespace nucleus::utils;
+
+TEST_CASE("nucleus/utils/atmosphere_lut")
+{
+    const atmosphere_lut::Parameters parameters;
+    const auto lut = atmosphere_lut::in_scattering(parameters);
+
+    SECTION("layout")
+    {
+        REQUIRE(lut.size() == atmosphere_lut::n_heights);
+        for (const auto& layer : lut) {
+            CHECK(layer.width() == atmosphere_lut::n_distances);
+            CHECK(layer.height() == atmosphere_lut::n_directions);
+        }
+    }
+
+    SECTION("no in-scattering without distance")
+    {
+        for (const auto& layer : lut) {
+            for (unsigned j = 0; j < atmosphere_lut::n_directions; ++j) {
+                CHECK(layer.pixel({ 0, j }).r == 0.f);
+                CHECK(layer.pixel({ 0, j }).a == 1.f);
+            }
+        }
+    }
+
+    SECTION("grows along the ray")
+    {
+        for (const auto& layer : lut) {
+            for (unsigned j = 0; j < atmosphere_lut::n_directions; ++j) {
+                for (unsigned k = 1; k < atmosphere_lut::n_distances; ++k)
+                    CHECK(layer.pixel({ k, j }).b >= layer.pixel({ k - 1, j }).b);
+            }
+        }
+    }
+
+    SECTION("sampling matches the numerical integration")
+    {
+        for (const auto height : { 0.2f, 1.f, 3.f, 10.f, 30.f }) {
+            for (const auto direction_z : { -0.9f, -0.05f, 0.f, 0.01f, 0.1f, 0.5f, 1.f }) {
+                for (const auto distance : { 0.3f, 1.f, 5.f, 20.f, 80.f, 300.f }) {
+                    if (height + direction_z * distance < 0.f)
+                        continue; // in the ground
+                    const auto reference = atmosphere_lut::integrate_in_scattering(parameters, height, direction_z, distance, 1000);
+                    const auto sampled = atmosphere_lut::sample(lut, parameters, height, direction_z, distance);
+                    for (int c = 0; c < 3; ++c)
+                        CHECK(std::abs(sampled[c] - reference[c]) < 0.005f); // about an 8 bit step
+                }
+            }
+        }
+    }
+}
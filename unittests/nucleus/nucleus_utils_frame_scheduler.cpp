@@ -0,0 +1,101 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <QElapsedTimer>
+#include <QtTest/QSignalSpy>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/FrameScheduler.h"
+
+using nucleus::utils::FrameScheduler;
+
+TEST_CASE("nucleus/utils/frame scheduler")
+{
+    SECTION("no frames without requests")
+    {
+        FrameScheduler scheduler;
+        QSignalSpy spy(&scheduler, &FrameScheduler::frame_requested);
+        CHECK(!spy.wait(50));
+        CHECK(!scheduler.frame_pending());
+    }
+
+    SECTION("requests of one event loop iteration are merged")
+    {
+        FrameScheduler scheduler;
+        QSignalSpy spy(&scheduler, &FrameScheduler::frame_requested);
+        for (int i = 0; i < 10; ++i)
+            scheduler.request_frame();
+        CHECK(scheduler.frame_pending());
+        CHECK(spy.wait(50));
+        spy.wait(50);
+        CHECK(spy.size() == 1);
+        CHECK(!scheduler.frame_pending());
+    }
+
+    SECTION("frames are capped by the power state")
+    {
+        FrameScheduler scheduler;
+        scheduler.set_max_fps(FrameScheduler::PowerState::Normal, 100);
+        scheduler.set_max_fps(FrameScheduler::PowerState::PowerSaving, 10);
+        QSignalSpy spy(&scheduler, &FrameScheduler::frame_requested);
+        scheduler.request_frame();
+        REQUIRE(spy.wait(50));
+
+        QElapsedTimer timer;
+        timer.start();
+        scheduler.request_frame();
+        REQUIRE(spy.wait(100));
+        CHECK(timer.elapsed() >= 9);
+
+        scheduler.set_power_saving(true);
+        CHECK(scheduler.power_state() == FrameScheduler::PowerState::PowerSaving);
+        timer.start();
+        scheduler.request_frame();
+        REQUIRE(spy.wait(500));
+        CHECK(timer.elapsed() >= 90);
+    }
+
+    SECTION("a cap of 0 keeps the request until it is raised")
+    {
+        FrameScheduler scheduler;
+        scheduler.set_max_fps(FrameScheduler::PowerState::Normal, 0);
+        QSignalSpy spy(&scheduler, &FrameScheduler::frame_requested);
+        scheduler.request_frame();
+        CHECK(!spy.wait(50));
+        CHECK(scheduler.frame_pending());
+        scheduler.set_max_fps(FrameScheduler::PowerState::Normal, 60);
+        CHECK(spy.wait(50));
+        CHECK(spy.size() == 1);
+    }
+
+    SECTION("continuous mode requests frames until disabled")
+    {
+        FrameScheduler scheduler;
+        scheduler.set_max_fps(FrameScheduler::PowerState::Normal, 100);
+        QSignalSpy spy(&scheduler, &FrameScheduler::frame_requested);
+        scheduler.set_continuous(true);
+        spy.wait(200);
+        spy.wait(200);
+        spy.wait(200);
+        CHECK(spy.size() >= 3);
+        scheduler.set_continuous(false);
+        spy.wait(50); // the last requested one
+        spy.clear();
+        CHECK(!spy.wait(50));
+    }
+}
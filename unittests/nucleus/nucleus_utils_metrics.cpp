@@ -0,0 +1,103 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <QTcpSocket>
+#include <QtTest/QSignalSpy>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/MetricsRegistry.h"
+#ifndef __EMSCRIPTEN__
+#include "nucleus/utils/MetricsServer.h"
+#endif
+
+using nucleus::utils::MetricsRegistry;
+
+TEST_CASE("nucleus/utils/metrics")
+{
+    MetricsRegistry metrics;
+    metrics.describe("alp_frame_seconds", MetricsRegistry::Type::Summary, "frame time");
+    metrics.describe("alp_network_bytes", MetricsRegistry::Type::Counter, "payload \"of\" the responses");
+    metrics.describe("alp_request_slots", MetricsRegistry::Type::Gauge, "");
+
+    SECTION("text format")
+    {
+        metrics.set_gauge("alp_request_slots", 12);
+        metrics.set_gauge("alp_undescribed", 1); // ignored
+        metrics.add("alp_request_slots", 1); // wrong type, ignored
+        metrics.add("alp_network_bytes", 100, { { "layer", "ortho" } });
+        metrics.add("alp_network_bytes", 28, { { "layer", "ortho" } });
+        metrics.add("alp_network_bytes", 5, { { "layer", "height" } });
+        const auto text = metrics.render();
+        CHECK(text
+            == "# TYPE alp_frame_seconds summary\n"
+               "# HELP alp_frame_seconds frame time\n"
+               "# TYPE alp_network_bytes counter\n"
+               "# HELP alp_network_bytes payload \\\"of\\\" the responses\n"
+               "alp_network_bytes_total{layer=\"height\"} 5\n"
+               "alp_network_bytes_total{layer=\"ortho\"} 128\n"
+               "# TYPE alp_request_slots gauge\n"
+               "alp_request_slots 12\n"
+               "# EOF\n");
+    }
+
+    SECTION("summary quantiles over the last samples")
+    {
+        for (unsigned i = 0; i < MetricsRegistry::n_summary_samples; ++i)
+            metrics.observe("alp_frame_seconds", 1000.0); // pushed out of the window
+        for (unsigned i = 1; i <= MetricsRegistry::n_summary_samples; ++i)
+            metrics.observe("alp_frame_seconds", i / 1024.0);
+        const auto text = metrics.render();
+        CHECK(text.find("alp_frame_seconds{quantile=\"0.5\"} 0.5009765625\n") != std::string::npos);
+        CHECK(text.find("alp_frame_seconds{quantile=\"0.99\"} 0.990234375\n") != std::string::npos);
+        CHECK(text.find("alp_frame_seconds_count 2048\n") != std::string::npos);
+        CHECK(text.find("alp_frame_seconds_sum 1024512.5\n") != std::string::npos);
+    }
+
+#ifndef __EMSCRIPTEN__
+    SECTION("http responses")
+    {
+        using nucleus::utils::MetricsServer;
+        CHECK(MetricsServer::response_to("GET /metrics HTTP/1.1\r\nHost: localhost", metrics).isEmpty()); // incomplete
+        const auto ok = MetricsServer::response_to("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", metrics);
+        CHECK(ok.startsWith("HTTP/1.1 200 OK\r\n"));
+        CHECK(ok.contains("Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"));
+        CHECK(ok.endsWith("# EOF\n"));
+        CHECK(MetricsServer::response_to("GET / HTTP/1.1\r\n\r\n", metrics).startsWith("HTTP/1.1 404"));
+        CHECK(MetricsServer::response_to("POST /metrics HTTP/1.1\r\n\r\n", metrics).startsWith("HTTP/1.1 405"));
+    }
+
+    SECTION("served on localhost")
+    {
+        auto shared = std::make_shared<MetricsRegistry>();
+        shared->describe("alp_request_slots", MetricsRegistry::Type::Gauge, "");
+        shared->set_gauge("alp_request_slots", 3);
+        nucleus::utils::MetricsServer server(shared);
+        REQUIRE(server.listen(0));
+        // the server runs on this thread, the spies spin the event loop
+        QTcpSocket socket;
+        QSignalSpy connected(&socket, &QTcpSocket::connected);
+        QSignalSpy disconnected(&socket, &QTcpSocket::disconnected);
+        socket.connectToHost(QHostAddress::LocalHost, server.port());
+        REQUIRE(connected.wait(1000));
+        socket.write("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        REQUIRE(disconnected.wait(1000));
+        const auto response = socket.readAll();
+        CHECK(response.contains("\r\n\r\n# TYPE alp_request_slots gauge\nalp_request_slots 3\n# EOF\n"));
+    }
+#endif
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <cmath>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/srs.h"
+#include "nucleus/utils/normal_map.h"
+
+using namespace nucleus::utils;
+
+TEST_CASE("nucleus/utils/normal_map")
+{
+    const auto bounds = nucleus::srs::tile_bounds(tile::Id { 12, { 2200, 2800 } });
+
+    SECTION("encoding round trip")
+    {
+        for (const auto& n : { glm::vec3(0, 0, 1), glm::vec3(1, 0, 1), glm::vec3(-1, 2, 1), glm::vec3(0.3f, -0.2f, 1), glm::vec3(-1, -1, 0.1f) }) {
+            const auto normal = glm::normalize(n);
+            CHECK(glm::dot(normal_map::decode(normal_map::encode(normal)), normal) > 0.999f);
+        }
+    }
+
+    SECTION("flat tile")
+    {
+        const auto normals = normal_map::compute(nucleus::Raster<uint16_t>(glm::uvec2(65, 65), uint16_t(8000)), bounds);
+        REQUIRE(normals.size() == glm::uvec2(65, 65));
+        for (const auto& encoded : normals)
+            CHECK(normal_map::decode(encoded).z > 0.999f);
+    }
+
+    SECTION("slopes")
+    {
+        nucleus::Raster<uint16_t> rising_to_the_east(glm::uvec2(65, 65));
+        nucleus::Raster<uint16_t> rising_to_the_north(glm::uvec2(65, 65));
+        for (unsigned row = 0; row < 65; ++row) {
+            for (unsigned col = 0; col < 65; ++col) {
+                rising_to_the_east.pixel({ col, row }) = uint16_t(8000 + col * 200);
+                rising_to_the_north.pixel({ col, row }) = uint16_t(8000 + (64 - row) * 200); // row 0 is the northern edge
+            }
+        }
+        const auto east = normal_map::compute(rising_to_the_east, bounds);
+        const auto north = normal_map::compute(rising_to_the_north, bounds);
+        for (const auto& position : { glm::uvec2(0, 0), glm::uvec2(32, 32), glm::uvec2(64, 10) }) {
+            const auto n_east = normal_map::decode(east.pixel(position));
+            CHECK(n_east.x < -0.1f);
+            CHECK(std::abs(n_east.y) < 0.02f);
+            CHECK(n_east.z > 0.f);
+            const auto n_north = normal_map::decode(north.pixel(position));
+            CHECK(n_north.y < -0.1f);
+            CHECK(std::abs(n_north.x) < 0.02f);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2026 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/RenderScaleController.h"
+
+using nucleus::utils::RenderScaleController;
+
+TEST_CASE("nucleus/utils/render scale controller")
+{
+    const auto settings = RenderScaleController::Settings { .enabled = true, .min_scale = 0.5f, .max_scale = 1.0f, .target_gpu_msecs = 10.0f, .step = 0.05f, .hold_frames = 0 };
+
+    SECTION("disabled controller renders at the maximal scale")
+    {
+        RenderScaleController controller;
+        CHECK(controller.scale() == 1.0f);
+        CHECK(!controller.update(100.0f));
+        CHECK(controller.scale() == 1.0f);
+        auto fixed = controller.settings();
+        fixed.max_scale = 0.75f;
+        CHECK(controller.set_settings(fixed));
+        CHECK(controller.scale() == 0.75f);
+    }
+
+    SECTION("slow frames shrink down to the minimal scale")
+    {
+        RenderScaleController controller(settings);
+        CHECK(controller.update(20.0f));
+        CHECK(controller.scale() < 1.0f);
+        CHECK(controller.scale() >= 0.5f);
+        for (int i = 0; i < 100; ++i)
+            controller.update(40.0f);
+        CHECK(controller.scale() == 0.5f);
+    }
+
+    SECTION("the scale follows the pixel cost")
+    {
+        RenderScaleController controller(settings);
+        controller.update(20.0f); // twice the target => 1 / sqrt(2) of the resolution
+        CHECK(controller.scale() > 0.65f);
+        CHECK(controller.scale() < 0.75f);
+    }
+
+    SECTION("fast frames grow back one step at a time")
+    {
+        RenderScaleController controller(settings);
+        for (int i = 0; i < 100; ++i)
+            controller.update(40.0f);
+        REQUIRE(controller.scale() == 0.5f);
+        auto changed = false;
+        for (int i = 0; i < 20 && !changed; ++i)
+            changed = controller.update(1.0f); // the smoothed time has to come down first
+        CHECK(changed);
+        CHECK(controller.scale() > 0.5f);
+        CHECK(controller.scale() < 0.56f);
+        for (int i = 0; i < 100; ++i)
+            controller.update(1.0f);
+        CHECK(controller.scale() == 1.0f);
+    }
+
+    SECTION("frames on target keep the scale")
+    {
+        RenderScaleController controller(settings);
+        for (int i = 0; i < 100; ++i)
+            CHECK(!controller.update(i % 2 ? 9.0f : 10.2f));
+        CHECK(controller.scale() == 1.0f);
+    }
+
+    SECTION("measurements are ignored for a few frames after a change")
+    {
+        auto holding = settings;
+        holding.hold_frames = 3;
+        RenderScaleController controller(holding);
+        CHECK(controller.update(20.0f));
+        const auto scale = controller.scale();
+        for (int i = 0; i < 3; ++i)
+            CHECK(!controller.update(40.0f));
+        CHECK(controller.scale() == scale);
+        CHECK(controller.update(40.0f));
+        CHECK(controller.scale() < scale);
+    }
+}
@@ -17,8 +17,11 @@
  *****************************************************************************/
 
 
+#include <QSignalSpy>
 #include <catch2/catch_test_macros.hpp>
 
+#include "nucleus/camera/AbstractDepthTester.h"
+#include "nucleus/camera/Controller.h"
 #include "nucleus/camera/Definition.h"
 #include "radix/geometry.h"
 #include "test_helpers.h"
@@ -30,6 +33,13 @@ glm::vec3 divideByW(const glm::vec4& vec)
 {
     return { vec.x / vec.w, vec.y / vec.w, vec.z / vec.w };
 }
+
+// flat ground at the origin
+class FlatDepthTester : public nucleus::camera::AbstractDepthTester {
+public:
+    float depth(const glm::dvec2&) override { return 0.5f; }
+    glm::dvec3 position(const glm::dvec2&) override { return { 0, 0, 0 }; }
+};
 }
 
 TEST_CASE("nucleus/camera: Definition")
@@ -79,6 +89,21 @@ TEST_CASE("nucleus/camera: Definition")
         CHECK(clip_space_v.y == Approx(0.0f).scale(50));
         CHECK(clip_space_v.z > 0);
     }
+    SECTION("jittered projection matrix")
+    {
+        auto c = nucleus::camera::Definition({ 0, 0, 0 }, { 10, 10, 0 });
+        c.set_perspective_params(90.0, { 100, 100 }, 1);
+        const auto offset = glm::dvec2(0.5, -0.25) * 2.0 / 100.0; // half a pixel right, a quarter down
+        for (const auto& point : { glm::dvec4(10, 10, 0, 1), glm::dvec4(20, 5, 3, 1), glm::dvec4(-3, 40, 10, 1) }) {
+            const auto view_point = c.camera_matrix() * point;
+            const auto reference = c.projection_matrix() * view_point;
+            const auto jittered = c.jittered_projection_matrix(offset) * view_point;
+            CHECK(jittered.x / jittered.w == Approx(reference.x / reference.w + offset.x));
+            CHECK(jittered.y / jittered.w == Approx(reference.y / reference.w + offset.y));
+            CHECK(jittered.z / jittered.w == Approx(reference.z / reference.w));
+        }
+        CHECK(c.jittered_projection_matrix({}) == c.projection_matrix());
+    }
     SECTION("local coordinate system offset")
     {
         // see doc/gl_render_design.svg, this tests that the camera returns the local view projection matrix, i.e., offset such, that the floats are smaller
@@ -334,4 +359,57 @@ TEST_CASE("nucleus/camera: Definition")
             CHECK(equals(frustum.corners[7], geometry::intersection(geometry::intersection(right, top).value(), back).value()));  // tr
         }
     }
+
+    SECTION("frustum from matrix")
+    {
+        auto c = nucleus::camera::Definition({ 10, 10, 0 }, { 0, 0, 0 });
+        c.set_perspective_params(90, { 100, 100 }, 0.5);
+        const auto reference = c.frustum();
+        const auto frustum = nucleus::camera::frustum_from_matrix(c.world_view_projection_matrix());
+        for (unsigned i = 0; i < 6; ++i) {
+            CHECK(equals(frustum.clipping_planes[i].normal, reference.clipping_planes[i].normal));
+            CHECK(frustum.clipping_planes[i].distance == Approx(reference.clipping_planes[i].distance).scale(1).epsilon(0.0001));
+        }
+        for (unsigned i = 0; i < 4; ++i)
+            CHECK(equals(frustum.corners[i], reference.corners[i]));
+        for (unsigned i = 4; i < 8; ++i)
+            CHECK(equals(frustum.corners[i], reference.corners[i], 1000)); // far plane is 500km away
+    }
+}
+
+TEST_CASE("nucleus/camera: Controller")
+{
+    SECTION("input in one frame results in a single update")
+    {
+        auto camera = nucleus::camera::Definition({ 0, -1000, 1000 }, { 0, 0, 0 });
+        camera.set_viewport_size({ 800, 600 });
+        FlatDepthTester depth_tester;
+        nucleus::camera::Controller controller(camera, &depth_tester, nullptr);
+        QSignalSpy changed(&controller, &nucleus::camera::Controller::definition_changed);
+        QSignalSpy pending(&controller, &nucleus::camera::Controller::update_pending);
+
+        nucleus::event_parameter::Wheel wheel;
+        wheel.angle_delta = QPoint(0, 120);
+        controller.wheel_turn(wheel);
+        controller.key_press(QKeyCombination(Qt::Key_Shift));
+        controller.wheel_turn(wheel);
+        controller.key_release(QKeyCombination(Qt::Key_Shift));
+        controller.wheel_turn(wheel);
+        CHECK(changed.empty());
+        CHECK(pending.size() == 1); // a single frame is requested
+
+        controller.update_camera_request();
+        REQUIRE(changed.size() == 1);
+        CHECK(glm::distance(controller.definition().position(), camera.position()) > 1.0); // all three zoom steps went in
+
+        // nothing new in the next frame
+        controller.update_camera_request();
+        CHECK(changed.size() == 1);
+
+        // input after the frame requests the next one
+        controller.wheel_turn(wheel);
+        CHECK(pending.size() == 2);
+        controller.update_camera_request();
+        CHECK(changed.size() == 2);
+    }
 }
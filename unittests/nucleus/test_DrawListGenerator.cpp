@@ -21,6 +21,8 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <QFile>
+#include <algorithm>
+#include <limits>
 
 #include "nucleus/camera/PositionStorage.h"
 #include "nucleus/tile_scheduler/DrawListGenerator.h"
@@ -62,6 +64,24 @@ TEST_CASE("nucleus/tile_scheduler/DrawListGenerator")
         CHECK(culled_list.contains(tile::Id { 1, { 1, 1 } }));
     }
 
+    SECTION("partial refinement, the parent is drawn in the quadrants of missing children")
+    {
+        draw_list_generator.add_tile(tile::Id { 0, { 0, 0 } });
+
+        draw_list_generator.add_tile(tile::Id { 1, { 0, 0 } });
+        draw_list_generator.add_tile(tile::Id { 1, { 1, 0 } });
+        draw_list_generator.add_tile(tile::Id { 1, { 1, 1 } });
+        nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks partial_tiles;
+        const auto list = draw_list_generator.generate_for(camera, &partial_tiles);
+        REQUIRE(list.size() == 4);
+        CHECK(list.contains(tile::Id { 0, { 0, 0 } }));
+        CHECK(list.contains(tile::Id { 1, { 1, 1 } }));
+        CHECK(!list.contains(tile::Id { 1, { 0, 1 } }));
+        REQUIRE(partial_tiles.size() == 1);
+        CHECK(partial_tiles.at(tile::Id { 0, { 0, 0 } }) == 1u << nucleus::tile_scheduler::DrawListGenerator::quadrant_of(tile::Id { 1, { 0, 1 } }));
+        CHECK(nucleus::tile_scheduler::DrawListGenerator::quadrant_of(tile::Id { 1, { 0, 1 } }) == 2); // north west
+    }
+
     SECTION("removal")
     {
         draw_list_generator.add_tile(tile::Id { 0, { 0, 0 } });
@@ -81,6 +101,85 @@ TEST_CASE("nucleus/tile_scheduler/DrawListGenerator")
         CHECK(list.contains(tile::Id { 0, { 0, 0 } }));
     }
 
+    SECTION("aabbs")
+    {
+        const auto tiles = nucleus::tile_scheduler::DrawListGenerator::TileSet { tile::Id { 1, { 0, 0 } }, tile::Id { 1, { 1, 1 } } };
+        const auto aabbs = draw_list_generator.aabbs(tiles);
+        REQUIRE(aabbs.size() == 2);
+        for (const auto& aabb : aabbs) {
+            CHECK(aabb.min.z < 100.0);
+            CHECK(aabb.max.z > 4000.0);
+            CHECK(aabb.size().x > 0);
+            CHECK(aabb.size().y > 0);
+        }
+    }
+
+    SECTION("distance culling")
+    {
+        const auto tiles = nucleus::tile_scheduler::DrawListGenerator::TileSet { tile::Id { 10, { 545, 669 } }, tile::Id { 10, { 200, 300 } } };
+        const auto aabb = draw_list_generator.aabbs(tiles).front(); // sorted, the first one is at x 200
+        const auto position = (aabb.min + aabb.max) * 0.5 + glm::dvec3(0, 0, 10000);
+
+        auto near = tiles;
+        draw_list_generator.cull_by_distance(position, 0, 50000, &near);
+        REQUIRE(near.size() == 1);
+        CHECK(near.contains(tile::Id { 10, { 200, 300 } }));
+
+        auto far = tiles;
+        draw_list_generator.cull_by_distance(position, 50000, std::numeric_limits<double>::infinity(), &far);
+        REQUIRE(far.size() == 1);
+        CHECK(far.contains(tile::Id { 10, { 545, 669 } }));
+
+        auto all = tiles;
+        draw_list_generator.cull_by_distance(position, 0, std::numeric_limits<double>::infinity(), &all);
+        CHECK(all.size() == 2);
+    }
+
+    SECTION("tile set is sorted and unique")
+    {
+        nucleus::tile_scheduler::DrawListGenerator::TileSet set { tile::Id { 1, { 1, 1 } }, tile::Id { 0, { 0, 0 } }, tile::Id { 1, { 1, 1 } } };
+        REQUIRE(set.size() == 2);
+        CHECK(*set.begin() == tile::Id { 0, { 0, 0 } });
+        CHECK(set.insert(tile::Id { 1, { 0, 1 } }));
+        CHECK(!set.insert(tile::Id { 1, { 0, 1 } }));
+        CHECK(set.size() == 3);
+        CHECK(set.contains(tile::Id { 1, { 0, 1 } }));
+        CHECK(!set.contains(tile::Id { 1, { 1, 0 } }));
+        CHECK(std::is_sorted(set.begin(), set.end(), nucleus::tile_scheduler::TileIdSet::Less {}));
+        const auto capacity = set.capacity();
+        set.clear();
+        CHECK(set.empty());
+        CHECK(set.capacity() == capacity);
+    }
+
+    SECTION("reused output sets give the same result and keep their storage")
+    {
+        draw_list_generator.add_tile(tile::Id { 0, { 0, 0 } });
+        for (const auto& child : tile::Id { 0, { 0, 0 } }.children())
+            draw_list_generator.add_tile(child);
+        draw_list_generator.add_tile(tile::Id { 2, { 2, 2 } });
+        draw_list_generator.add_tile(tile::Id { 2, { 3, 3 } });
+
+        nucleus::tile_scheduler::DrawListGenerator::TileSet list;
+        nucleus::tile_scheduler::DrawListGenerator::TileSet culled;
+        nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks partial_tiles;
+        draw_list_generator.generate_for(camera, &list, &partial_tiles);
+        draw_list_generator.cull(list, camera.frustum(), &culled);
+        CHECK(list == draw_list_generator.generate_for(camera));
+        CHECK(culled == draw_list_generator.cull(list, camera.frustum()));
+
+        const auto list_storage = &*list.begin();
+        const auto culled_capacity = culled.capacity();
+        for (int i = 0; i < 3; ++i) {
+            partial_tiles.clear_retaining_storage();
+            draw_list_generator.generate_for(camera, &list, &partial_tiles);
+            draw_list_generator.cull(list, camera.frustum(), &culled);
+        }
+        CHECK(&*list.begin() == list_storage);
+        CHECK(culled.capacity() == culled_capacity);
+        CHECK(list == draw_list_generator.generate_for(camera));
+        CHECK(culled == draw_list_generator.cull(list, camera.frustum()));
+    }
 }
 
 TEST_CASE("nucleus/tile_scheduler/DrawListGenerator benchmark")
@@ -126,6 +225,72 @@ TEST_CASE("nucleus/tile_scheduler/DrawListGenerator benchmark")
         draw_list_generator.add_tile(id);
     }
 
+    SECTION("hierarchical culling gives the same result as testing every tile")
+    {
+        for (const auto& camera_position : camera_positions) {
+            const auto list = draw_list_generator.generate_for(camera_position);
+            const auto culled = draw_list_generator.cull(list, camera_position.frustum());
+            for (const auto& id : list) {
+                const auto visible = nucleus::tile_scheduler::utils::camera_frustum_contains_tile(camera_position.frustum(), decorator->aabb(id));
+                CHECK(culled.contains(id) == visible);
+            }
+        }
+    }
+
+    SECTION("contribution culling draws the parents of small tiles, and covers the same area")
+    {
+        for (const auto& camera_position : camera_positions) {
+            const auto list = draw_list_generator.generate_for(camera_position);
+            draw_list_generator.set_min_tile_contribution(16);
+            const auto coarse = draw_list_generator.generate_for(camera_position);
+            draw_list_generator.set_min_tile_contribution(0);
+            CHECK(coarse.size() <= list.size());
+            for (auto id : list) {
+                while (!coarse.contains(id) && id.zoom_level > 0)
+                    id = id.parent();
+                CHECK(coarse.contains(id));
+            }
+        }
+    }
+
+    SECTION("tile events update the refinement of the last camera, with the same result as a traversal from the root")
+    {
+        std::vector<tile::Id> removed;
+        for (size_t i = 0; i < all_inner_nodes.size(); i += 7) {
+            if (all_inner_nodes[i].zoom_level >= 4)
+                removed.push_back(all_inner_nodes[i]);
+        }
+        REQUIRE(!removed.empty());
+        for (const auto& camera_position : camera_positions) {
+            nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks partial_tiles;
+            const auto list = draw_list_generator.generate_for(camera_position, &partial_tiles);
+            CHECK(!draw_list_generator.last_was_incremental());
+
+            for (const auto& id : removed)
+                draw_list_generator.remove_tile(id);
+            nucleus::tile_scheduler::DrawListGenerator reference;
+            reference.set_aabb_decorator(decorator);
+            for (const auto& id : all_inner_nodes)
+                reference.add_tile(id);
+            for (const auto& id : removed)
+                reference.remove_tile(id);
+            nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks reduced_partial_tiles;
+            const auto reduced = draw_list_generator.generate_for(camera_position, &reduced_partial_tiles);
+            CHECK(draw_list_generator.last_was_incremental());
+            nucleus::tile_scheduler::DrawListGenerator::QuadrantMasks reference_partial_tiles;
+            CHECK(reduced == reference.generate_for(camera_position, &reference_partial_tiles));
+            CHECK(reduced_partial_tiles.size() == reference_partial_tiles.size());
+            for (const auto& [id, mask] : reference_partial_tiles)
+                CHECK(reduced_partial_tiles.at(id) == mask);
+
+            for (const auto& id : removed)
+                draw_list_generator.add_tile(id);
+            partial_tiles.clear_retaining_storage();
+            CHECK(list == draw_list_generator.generate_for(camera_position, &partial_tiles));
+            CHECK(draw_list_generator.last_was_incremental());
+        }
+    }
+
     BENCHMARK("generate_for")
     {
         nucleus::tile_scheduler::DrawListGenerator::TileSet set;
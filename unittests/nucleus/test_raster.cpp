@@ -16,6 +16,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <algorithm>
+#include <array>
+#include <utility>
+
 #include <catch2/catch_test_macros.hpp>
 #include <glm/glm.hpp>
 
@@ -60,7 +64,7 @@ TEST_CASE("nucleus/Raster")
 
     SECTION("move vector into raster")
     {
-        std::vector<test_helpers::FailOnCopy> vector(1);
+        Raster<test_helpers::FailOnCopy>::Buffer vector(1);
         const Raster<test_helpers::FailOnCopy> raster(1, std::move(vector));
         CHECK(raster.width() == 1);
         CHECK(raster.height() == 1);
@@ -119,4 +123,55 @@ TEST_CASE("nucleus/Raster")
             CHECK(p == 657);
         }
     }
+
+    SECTION("uninitialised and aligned storage")
+    {
+        Raster<uint16_t> raster(glm::uvec2(65, 65), nucleus::uninitialised);
+        CHECK(raster.buffer_length() == 65 * 65);
+        CHECK(reinterpret_cast<uintptr_t>(raster.data()) % 32 == 0);
+        const Raster<float> floats(glm::uvec2(3, 3));
+        CHECK(reinterpret_cast<uintptr_t>(floats.data()) % 32 == 0);
+        CHECK(floats.pixel({ 2, 2 }) == 0.f); // the value initialising constructors still zero
+    }
+
+    SECTION("views")
+    {
+        Raster<int> raster({ 3, 4 }, 1);
+        const nucleus::RasterView<int> view = raster.view();
+        CHECK(view.size() == raster.size());
+        view.pixel({ 2, 1 }) = 21;
+        CHECK(raster.pixel({ 2, 1 }) == 21);
+        const nucleus::RasterView<const int> const_view = view;
+        CHECK(const_view.pixel({ 2, 1 }) == 21);
+        CHECK(const_view.data() == std::as_const(raster).view().data());
+        CHECK(std::count(const_view.begin(), const_view.end(), 1) == 11);
+
+        // foreign memory
+        std::array<uint16_t, 6> memory = {};
+        const nucleus::RasterView<uint16_t> foreign(memory.data(), { 3, 2 });
+        foreign.pixel({ 0, 1 }) = 42;
+        CHECK(memory[3] == 42);
+        CHECK(foreign.buffer_length() == 6);
+    }
+
+    SECTION("the buffers of height rasters are recycled")
+    {
+        auto& pool = Raster<uint16_t>::Pool::instance();
+        pool.clear();
+        const uint16_t* storage = nullptr;
+        {
+            Raster<uint16_t> raster({ 65, 65 }, 7);
+            storage = raster.data();
+        }
+        CHECK(pool.n_bytes() == 65 * 65 * sizeof(uint16_t));
+        const Raster<uint16_t> raster(glm::uvec2(65, 65));
+        CHECK(raster.data() == storage);
+        CHECK(raster.pixel({ 64, 64 }) == 0); // initialised like a new one
+        CHECK(pool.n_bytes() == 0);
+
+        Raster<uint16_t> other({ 65, 65 }, 1);
+        other = Raster<uint16_t>({ 65, 65 }, 2); // the old buffer goes back
+        CHECK(pool.n_bytes() == 65 * 65 * sizeof(uint16_t));
+        pool.clear();
+    }
 }
@@ -16,10 +16,62 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <set>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 #include "nucleus/utils/terrain_mesh_index_generator.h"
 
+namespace {
+using namespace nucleus::utils::terrain_mesh_index_generator;
+
+// non degenerate triangles of a strip with primitive restarts, rotated so that the smallest index is first (keeps the winding)
+template <typename Index>
+std::set<std::array<Index, 3>> triangles(const std::vector<Index>& strip)
+{
+    std::set<std::array<Index, 3>> result;
+    size_t strip_start = 0;
+    for (size_t i = 0; i < strip.size(); ++i) {
+        if (strip[i] == primitive_restart_index<Index>()) {
+            strip_start = i + 1;
+            continue;
+        }
+        if (i < strip_start + 2)
+            continue;
+        auto t = std::array<Index, 3> { strip[i - 2], strip[i - 1], strip[i] };
+        if ((i - strip_start) % 2)
+            std::swap(t[0], t[1]);
+        if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2])
+            continue;
+        std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        result.insert(t);
+    }
+    return result;
+}
+
+// vertex shader invocations with a fifo post-transform cache
+template <typename Index>
+unsigned vertex_shader_invocations(const std::vector<Index>& strip, unsigned cache_size)
+{
+    std::deque<Index> cache;
+    unsigned invocations = 0;
+    for (const auto index : strip) {
+        if (index == primitive_restart_index<Index>() || std::find(cache.begin(), cache.end(), index) != cache.end())
+            continue;
+        ++invocations;
+        cache.push_back(index);
+        if (cache.size() > cache_size)
+            cache.pop_front();
+    }
+    return invocations;
+}
+} // namespace
+
 TEST_CASE("nucleus/utils/terrain_mesh_index_generator")
 {
     using namespace nucleus::utils::terrain_mesh_index_generator;
@@ -52,4 +104,51 @@ TEST_CASE("nucleus/utils/terrain_mesh_index_generator")
         CHECK(indices == std::vector({0, 3,  1, 4,  2, 5,  5, 3,  3, 6,  4, 7,  5, 8,  8, 9,
                                       5, 10, 2, 11, 1, 12, 0, 13, 3, 14, 6, 15, 7, 16, 8, 9}));
     }
+    SECTION("cache optimised surface quads 4x4")
+    {
+        const auto indices = surface_quads_cache_optimised<int>(4, 6);
+        const auto R = primitive_restart_index<int>();
+        const auto gt = std::vector({ 0, 4, 1, 5, 2, 6, R, 4, 8, 5, 9, 6, 10, R, 8, 12, 9, 13, 10, 14, R, 2, 6, 3, 7, R, 6, 10, 7, 11, R, 10, 14, 11, 15 });
+        CHECK(indices == gt);
+    }
+    SECTION("cache optimised surface quads have the same triangles and winding")
+    {
+        for (const auto n : { 2u, 3u, 4u, 17u, 65u }) {
+            for (const auto cache_size : { 4u, 16u, 32u }) {
+                CHECK(triangles(surface_quads_cache_optimised<uint16_t>(n, cache_size)) == triangles(surface_quads<uint16_t>(n)));
+                CHECK(triangles(surface_quads_with_curtains_cache_optimised<uint16_t>(n, cache_size)) == triangles(surface_quads_with_curtains<uint16_t>(n)));
+            }
+        }
+    }
+    SECTION("cache optimised surface quads need fewer vertex shader invocations")
+    {
+        const auto n_vertices = 65u * 65u + 4u * 64u;
+        for (const auto cache_size : { 16u, 24u, 32u }) {
+            const auto strips = vertex_shader_invocations(surface_quads_with_curtains<uint16_t>(65), cache_size);
+            const auto optimised = vertex_shader_invocations(surface_quads_with_curtains_cache_optimised<uint16_t>(65, cache_size), cache_size);
+            CHECK(strips > n_vertices * 19 / 10); // nearly every vertex shaded twice
+            CHECK(optimised < n_vertices * 12 / 10);
+        }
+    }
+}
+
+TEST_CASE("nucleus/utils/terrain_mesh_index_generator benchmarks")
+{
+    using namespace nucleus::utils::terrain_mesh_index_generator;
+    BENCHMARK("surface quads with curtains 65x65")
+    {
+        return surface_quads_with_curtains<uint16_t>(65);
+    };
+    BENCHMARK("cache optimised surface quads with curtains 65x65")
+    {
+        return surface_quads_with_curtains_cache_optimised<uint16_t>(65);
+    };
+    BENCHMARK("vertex shader invocations (fifo 24), strips")
+    {
+        return vertex_shader_invocations(surface_quads_with_curtains<uint16_t>(65), 24);
+    };
+    BENCHMARK("vertex shader invocations (fifo 24), cache optimised")
+    {
+        return vertex_shader_invocations(surface_quads_with_curtains_cache_optimised<uint16_t>(65), 24);
+    };
 }
@@ -16,13 +16,40 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <QBuffer>
 #include <QFile>
+#include <QImageWriter>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 #include "catch2_helpers.h"
+#include "nucleus/utils/pixel_kernels.h"
 #include "nucleus/utils/tile_conversion.h"
 
 namespace {
+QByteArray read_test_file(const char* name)
+{
+    QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, name));
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+// encoded by qt, if it has a plugin for the format (e.g. webp from qtimageformats). empty otherwise.
+QByteArray encode(const QImage& image, const char* format)
+{
+    if (!QImageWriter::supportedImageFormats().contains(format))
+        return {};
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, format, 90);
+    return data;
+}
+
 auto check_alpine_raster_format_for(const glm::u8vec4& v)
 {
     const auto float_v = nucleus::utils::tile_conversion::alppineRGBA2float(v);
@@ -128,6 +155,41 @@ TEST_CASE("nucleus/utils/tile_conversion")
         check_uint16_conversion_for({ 255, 255, 0, 255 });
     }
 
+    SECTION("simd pixel kernels give the same result as the scalar ones")
+    {
+        namespace kernels = nucleus::utils::pixel_kernels;
+        UNSCOPED_INFO(kernels::simd_target());
+        // odd counts and offsets, so that the vector loops start unaligned and leave a remainder
+        std::vector<uint32_t> pixels(4226);
+        uint32_t state = 1234567;
+        for (auto& p : pixels)
+            p = state = state * 1664525u + 1013904223u;
+        for (const size_t n : { size_t(0), size_t(1), size_t(7), size_t(8), size_t(17), size_t(4225) }) {
+            for (const bool opaque : { false, true }) {
+                std::vector<uint8_t> simd(n * 4), scalar(n * 4);
+                kernels::argb32_to_rgba8(pixels.data() + 1, simd.data(), n, opaque);
+                kernels::scalar::argb32_to_rgba8(pixels.data() + 1, scalar.data(), n, opaque);
+                CHECK(simd == scalar);
+            }
+            std::vector<uint16_t> simd(n), scalar(n);
+            kernels::argb32_to_height(pixels.data() + 1, simd.data(), n);
+            kernels::scalar::argb32_to_height(pixels.data() + 1, scalar.data(), n);
+            CHECK(simd == scalar);
+            const auto* bytes = reinterpret_cast<const uint8_t*>(pixels.data()) + 1;
+            kernels::rgba8_to_height(bytes, simd.data(), n);
+            kernels::scalar::rgba8_to_height(bytes, scalar.data(), n);
+            CHECK(simd == scalar);
+            const auto* deltas = reinterpret_cast<const uint16_t*>(pixels.data()) + 1;
+            kernels::zigzag_deltas_to_height(deltas, simd.data(), n, 4321);
+            kernels::scalar::zigzag_deltas_to_height(deltas, scalar.data(), n, 4321);
+            CHECK(simd == scalar);
+        }
+        const uint8_t rgba[] = { 201, 133, 7, 255 };
+        uint16_t height = 0;
+        kernels::scalar::rgba8_to_height(rgba, &height, 1);
+        CHECK(height == nucleus::utils::tile_conversion::alppineRGBA2uint16({ 201, 133, 7, 255 }));
+    }
+
     SECTION("byte array to raster unsigned short")
     {
         QString filepath = QString("%1%2").arg(ALP_TEST_DATA_DIR, "test-tile.png");
@@ -141,4 +203,169 @@ TEST_CASE("nucleus/utils/tile_conversion")
         CHECK(raster.buffer()[0] == 23 * 256 + 216);
         CHECK(raster.buffer()[1] == 22 * 256 + 33);
     }
+
+    SECTION("decoding into a reused image")
+    {
+        QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, "test-tile.png"));
+        file.open(QIODevice::ReadOnly);
+        const QByteArray ba = file.readAll();
+        REQUIRE(ba.size() > 0);
+        QImage image;
+        nucleus::utils::tile_conversion::decode_into(ba, &image);
+        REQUIRE(!image.isNull());
+        const auto* bits = image.constBits();
+        nucleus::utils::tile_conversion::decode_into(ba, &image);
+        CHECK(image.constBits() == bits); // same size and format, the pixel buffer is reused
+        CHECK(image == nucleus::utils::tile_conversion::toQImage(ba));
+
+        nucleus::utils::tile_conversion::decode_into(QByteArray("not an image"), &image);
+        CHECK(image.isNull());
+    }
+
+    SECTION("compact height encoding")
+    {
+        using nucleus::utils::tile_conversion::HeightCodec;
+        const auto png = read_test_file("test-tile.png");
+        const auto reference = nucleus::utils::tile_conversion::decode_height(png);
+        REQUIRE(reference.width() == 64);
+        for (const auto codec : { HeightCodec::Raw, HeightCodec::Deflate, HeightCodec::Zstd }) {
+            const auto encoded = nucleus::utils::tile_conversion::encode_height(reference, codec);
+            CHECK(nucleus::utils::tile_conversion::is_compact_height(encoded));
+            if (codec != HeightCodec::Raw)
+                CHECK(encoded.size() < png.size());
+            const auto decoded = nucleus::utils::tile_conversion::decode_height(encoded);
+            CHECK(decoded.size() == reference.size());
+            CHECK(decoded.buffer() == reference.buffer());
+            // truncated
+            CHECK(nucleus::utils::tile_conversion::decode_height(encoded.first(encoded.size() - 1)).buffer_length() == 0);
+        }
+        CHECK(!nucleus::utils::tile_conversion::is_compact_height(png));
+        CHECK(nucleus::utils::tile_conversion::accepted_height_media_types().contains("image/png"));
+    }
+
+    SECTION("raster unsigned short from other image formats")
+    {
+        QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, "test-tile.png"));
+        file.open(QIODevice::ReadOnly);
+        const auto image = nucleus::utils::tile_conversion::toQImage(file.readAll()).convertedTo(QImage::Format_ARGB32);
+        const auto reference = nucleus::utils::tile_conversion::qImage2uint16Raster(image);
+        for (const auto format : { QImage::Format_RGBA8888, QImage::Format_RGBX8888, QImage::Format_RGB888, QImage::Format_Grayscale16 }) {
+            const auto raster = nucleus::utils::tile_conversion::qImage2uint16Raster(image.convertedTo(format));
+            if (format != QImage::Format_Grayscale16) // lossy, but must not assert
+                CHECK(raster.buffer() == reference.buffer());
+        }
+    }
+
+    SECTION("fast decoders give the same result as the QImage path")
+    {
+        const auto png = read_test_file("test-tile.png");
+        REQUIRE(png.size() > 0);
+        const auto raster = nucleus::utils::tile_conversion::decode_height(png);
+        CHECK(raster.buffer() == nucleus::utils::tile_conversion::qImage2uint16Raster(nucleus::utils::tile_conversion::toQImage(png)).buffer());
+
+        const auto jpeg = read_test_file("170px-Jeune_bouquetin_de_face.jpg");
+        REQUIRE(jpeg.size() > 0);
+        QImage image;
+        nucleus::utils::tile_conversion::decode_ortho_into(jpeg, 256, &image);
+        CHECK(image.size() == QSize(170, 227)); // never scaled below max_size
+        QImage scaled;
+        nucleus::utils::tile_conversion::decode_ortho_into(jpeg, 64, &scaled);
+        CHECK(scaled.width() >= 64);
+        CHECK(scaled.height() >= 64);
+        CHECK(scaled.width() <= 170);
+    }
+}
+
+TEST_CASE("nucleus/utils/tile_conversion image formats")
+{
+    using nucleus::utils::tile_conversion::ImageFormat;
+    using nucleus::utils::tile_conversion::image_format;
+
+    SECTION("format from the magic bytes")
+    {
+        CHECK(image_format(read_test_file("test-tile.png")) == ImageFormat::Png);
+        CHECK(image_format(read_test_file("170px-Jeune_bouquetin_de_face.jpg")) == ImageFormat::Jpeg);
+        CHECK(image_format(QByteArray("RIFF\x10\0\0\0WEBPVP8 ", 16)) == ImageFormat::WebP);
+        CHECK(image_format(QByteArray("\0\0\0\x1c" "ftypavif", 12)) == ImageFormat::Avif);
+        CHECK(image_format(QByteArray("RIFF")) == ImageFormat::Unknown);
+        CHECK(image_format(QByteArray()) == ImageFormat::Unknown);
+    }
+
+    SECTION("accepted media types")
+    {
+        const auto types = nucleus::utils::tile_conversion::accepted_ortho_media_types();
+        CHECK(types.contains("image/jpeg"));
+#ifdef ALP_ENABLE_WEBP
+        CHECK(types.startsWith("image/webp"));
+#endif
+#ifdef ALP_ENABLE_AVIF
+        CHECK(types.contains("image/avif"));
+#endif
+    }
+
+    SECTION("webp ortho tiles")
+    {
+        QImage source(256, 256, QImage::Format_RGB32);
+        for (int y = 0; y < 256; ++y) {
+            for (int x = 0; x < 256; ++x)
+                source.setPixel(x, y, qRgb(x, y, 128));
+        }
+        const auto webp = encode(source, "webp");
+        if (webp.isEmpty())
+            return; // qt has no webp plugin
+        CHECK(image_format(webp) == ImageFormat::WebP);
+        QImage image;
+        nucleus::utils::tile_conversion::decode_ortho_into(webp, 256, &image);
+        REQUIRE(image.size() == QSize(256, 256));
+        const auto pixel = image.pixelColor(100, 50);
+        CHECK(std::abs(pixel.red() - 100) < 8); // lossy
+        CHECK(std::abs(pixel.green() - 50) < 8);
+        QImage scaled;
+        nucleus::utils::tile_conversion::decode_ortho_into(webp, 128, &scaled);
+        CHECK(scaled.width() >= 128);
+        CHECK(scaled.width() <= 256);
+    }
+}
+
+TEST_CASE("nucleus/utils/tile_conversion benchmarks")
+{
+    const auto png = read_test_file("test-tile.png");
+    const auto jpeg = read_test_file("170px-Jeune_bouquetin_de_face.jpg");
+    BENCHMARK("height png: QImage + qImage2uint16Raster")
+    {
+        return nucleus::utils::tile_conversion::qImage2uint16Raster(nucleus::utils::tile_conversion::toQImage(png));
+    };
+    BENCHMARK("height png: decode_height")
+    {
+        return nucleus::utils::tile_conversion::decode_height(png);
+    };
+    const auto compact = nucleus::utils::tile_conversion::encode_height(nucleus::utils::tile_conversion::decode_height(png), nucleus::utils::tile_conversion::HeightCodec::Zstd);
+    BENCHMARK("height compact (" + std::to_string(compact.size()) + " bytes vs " + std::to_string(png.size()) + " png): decode_height")
+    {
+        return nucleus::utils::tile_conversion::decode_height(compact);
+    };
+    BENCHMARK("ortho jpeg: QImage")
+    {
+        return nucleus::utils::tile_conversion::toQImage(jpeg);
+    };
+    QImage image;
+    BENCHMARK("ortho jpeg: decode_ortho_into (reused image)")
+    {
+        nucleus::utils::tile_conversion::decode_ortho_into(jpeg, 256, &image);
+        return image.width();
+    };
+
+    // the same pixels as webp and avif (if qt can encode them), to choose the formats per platform (see accepted_ortho_media_types)
+    const auto ortho = nucleus::utils::tile_conversion::toQImage(jpeg);
+    for (const auto* format : { "webp", "avif" }) {
+        const auto encoded = encode(ortho, format);
+        if (encoded.isEmpty())
+            continue;
+        BENCHMARK(std::string("ortho ") + format + ": decode_ortho_into (reused image, " + std::to_string(encoded.size()) + " bytes vs "
+            + std::to_string(jpeg.size()) + " jpeg)")
+        {
+            nucleus::utils::tile_conversion::decode_ortho_into(encoded, 256, &image);
+            return image.width();
+        };
+    }
 }